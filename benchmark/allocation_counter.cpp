@@ -0,0 +1,92 @@
+#include "allocation_counter.h"
+
+#ifdef DD_TRACE_BENCHMARK_COUNT_ALLOCATIONS
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// The counters are trivially initialized, so that an allocation made before
+// or during the initialization of other objects can be counted.
+thread_local std::uint64_t allocation_count;
+thread_local std::uint64_t allocated_bytes;
+
+void record(std::size_t size) noexcept {
+  ++allocation_count;
+  allocated_bytes += size;
+}
+
+}  // namespace
+
+#if defined(__GLIBC__)
+
+// glibc provides its allocator under these names too, so that the standard
+// names can be interposed.
+extern "C" {
+void* __libc_malloc(std::size_t);
+void* __libc_calloc(std::size_t, std::size_t);
+void* __libc_realloc(void*, std::size_t);
+
+void* malloc(std::size_t size) {
+  record(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) {
+  record(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, std::size_t size) {
+  record(size);
+  return __libc_realloc(pointer, size);
+}
+}  // extern "C"
+
+#else
+
+// The other forms of `operator new`, except the aligned forms, call these.
+void* operator new(std::size_t size) {
+  record(size);
+  if (void* pointer = std::malloc(size ? size : 1)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  record(size);
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+#endif  // defined(__GLIBC__)
+
+namespace benchmark_allocations {
+
+bool enabled() { return true; }
+
+AllocationTotals this_thread_totals() {
+  return AllocationTotals{allocation_count, allocated_bytes};
+}
+
+}  // namespace benchmark_allocations
+
+#else
+
+namespace benchmark_allocations {
+
+bool enabled() { return false; }
+
+AllocationTotals this_thread_totals() { return AllocationTotals{}; }
+
+}  // namespace benchmark_allocations
+
+#endif  // defined DD_TRACE_BENCHMARK_COUNT_ALLOCATIONS
@@ -0,0 +1,73 @@
+#pragma once
+
+// This component provides a `class`, `AllocationCounter`, that reports the
+// heap allocations made by a benchmark as Google Benchmark counters.
+//
+// Allocations are counted only if the benchmark program is built with the
+// `DD_TRACE_BENCHMARK_COUNT_ALLOCATIONS` preprocessor macro defined (see the
+// `DD_TRACE_BENCHMARK_COUNT_ALLOCATIONS` CMake option), in which case
+// `allocation_counter.cpp` interposes the allocation functions.  On glibc,
+// `malloc`, `calloc`, and `realloc` are interposed, which includes the
+// allocations made by `operator new` and by C libraries such as libcurl.
+// Elsewhere, `operator new` is replaced.  Otherwise, `AllocationCounter` does
+// nothing, and the counters are not reported.
+//
+// Allocations are counted per thread, so an `AllocationCounter` counts only
+// the allocations of the thread that created it, and not those of, e.g., a
+// collector's background thread.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace benchmark_allocations {
+
+struct AllocationTotals {
+  std::uint64_t count = 0;
+  std::uint64_t bytes = 0;
+};
+
+// Return whether allocations are counted.
+bool enabled();
+
+// Return the number and total size of the allocations made by the calling
+// thread so far.
+AllocationTotals this_thread_totals();
+
+// `AllocationCounter` measures the allocations made by the calling thread
+// during its lifetime, and then reports them as the "allocs_per_iter" and
+// "bytes_per_iter" counters of a benchmark.  Create it just before the
+// benchmark loop, so that setup is not counted.
+class AllocationCounter {
+  benchmark::State& state_;
+  AllocationTotals start_;
+  AllocationTotals paused_;
+
+ public:
+  explicit AllocationCounter(benchmark::State& state)
+      : state_(state), start_(this_thread_totals()) {}
+
+  ~AllocationCounter() {
+    if (!enabled()) return;
+    const auto end = this_thread_totals();
+    state_.counters["allocs_per_iter"] = benchmark::Counter(
+        double(end.count - start_.count), benchmark::Counter::kAvgIterations);
+    state_.counters["bytes_per_iter"] = benchmark::Counter(
+        double(end.bytes - start_.bytes), benchmark::Counter::kAvgIterations);
+  }
+
+  // Do not count the allocations made between a call to `pause` and the
+  // following call to `resume`, such as while the benchmark's timing is
+  // paused.
+  void pause() { paused_ = this_thread_totals(); }
+  void resume() {
+    const auto now = this_thread_totals();
+    start_.count += now.count - paused_.count;
+    start_.bytes += now.bytes - paused_.bytes;
+  }
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+};
+
+}  // namespace benchmark_allocations
@@ -1,25 +1,17 @@
 #include <benchmark/benchmark.h>
 #include <datadog/collector.h>
-#include <datadog/logger.h>
 #include <datadog/span_data.h>
 #include <datadog/tracer.h>
 
 #include <memory>
 
+#include "fixture.h"
 #include "hasher.h"
 
 namespace {
 
 namespace dd = datadog::tracing;
 
-// `NullLogger` doesn't log. It avoids `log_startup` spam in the benchmark.
-struct NullLogger : public dd::Logger {
-  void log_error(const LogFunc&) override {}
-  void log_startup(const LogFunc&) override {}
-  void log_error(const dd::Error&) override {}
-  void log_error(dd::StringView) override {}
-};
-
 // `SerializingCollector` immediately MessagePack-serializes spans sent to it.
 // This allows us to track the overhead of the serialization code, without
 // having to use HTTP as is done in the default collector, `DatadogAgent`.
@@ -31,6 +23,8 @@ struct SerializingCollector : public dd::Collector {
     return dd::msgpack_encode(buffer, spans);
   }
 
+  bool accepts_shared_tags() const override { return true; }
+
   std::string config() const override {
     return R"({"type": "SerializingCollector"})";
   }
@@ -41,9 +35,7 @@ struct SerializingCollector : public dd::Collector {
 // `./tinycc`. It's similar to what is done in `../example`.
 void BM_TraceTinyCCSource(benchmark::State& state) {
   for (auto _ : state) {
-    dd::TracerConfig config;
-    config.service = "benchmark";
-    config.logger = std::make_shared<NullLogger>();
+    auto config = benchmark_fixture::tracer_config();
     config.collector = std::make_shared<SerializingCollector>();
     const auto valid_config = dd::finalize_config(config);
     dd::Tracer tracer{*valid_config};
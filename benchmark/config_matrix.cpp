@@ -0,0 +1,165 @@
+// These benchmarks run one span lifecycle workload, a server span with an
+// HTTP client child whose context is injected into outgoing headers, under a
+// matrix of tracer configurations.  Each configuration differs from the
+// baseline, the default configuration, by one toggle, so that the cost of
+// the toggle is the difference between its time and the baseline's.  The
+// baseline runs first, and each other configuration reports that difference
+// as "delta_per_trace", in seconds, and as "delta_ratio", relative to the
+// baseline.
+//
+// Telemetry is initialized once per process, by the first tracer (see
+// `fixture.h`), so it cannot be toggled within one run.  Each benchmark is
+// labeled "telemetry:on" or "telemetry:off" instead, and the telemetry toggle
+// is measured by running the program a second time with
+// `DD_INSTRUMENTATION_TELEMETRY_ENABLED=false`.
+
+#include <benchmark/benchmark.h>
+#include <datadog/dict_writer.h>
+#include <datadog/propagation_style.h>
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/span_sampler_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <string>
+
+#include "allocation_counter.h"
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+using benchmark_allocations::AllocationCounter;
+
+enum Toggle {
+  BASELINE,
+  TRACE_ID_64_BIT,
+  INJECT_DATADOG_ONLY,
+  INJECT_ALL_STYLES,
+  SPAN_SAMPLING_RULES,
+  RESOURCE_RENAMING,
+  REPORT_HOSTNAME,
+};
+
+const char* const toggle_names[] = {
+    "baseline",
+    "generate_128bit_trace_ids=false",
+    "injection_styles=datadog",
+    "injection_styles=datadog,b3,tracecontext",
+    "span_sampler.rules=2",
+    "resource_renaming_enabled=true",
+    "report_hostname=true",
+};
+
+// `NullWriter` discards the headers injected into it.
+struct NullWriter : public dd::DictWriter {
+  void set(dd::StringView, dd::StringView) override {}
+};
+
+// Return the benchmark tracer configuration modified by the specified
+// `toggle`.  The trace sampler keeps half of the traces in every
+// configuration, so that the span sampling rules are consulted for the other
+// half.
+dd::TracerConfig toggled_config(Toggle toggle) {
+  auto config = tracer_config();
+  config.trace_sampler.sample_rate = 0.5;
+  switch (toggle) {
+    case BASELINE:
+      break;
+    case TRACE_ID_64_BIT:
+      config.generate_128bit_trace_ids = false;
+      break;
+    case INJECT_DATADOG_ONLY:
+      config.injection_styles = {dd::PropagationStyle::DATADOG};
+      break;
+    case INJECT_ALL_STYLES:
+      config.injection_styles = {dd::PropagationStyle::DATADOG,
+                                 dd::PropagationStyle::B3,
+                                 dd::PropagationStyle::W3C};
+      break;
+    case SPAN_SAMPLING_RULES: {
+      // One rule that matches no span, and one that matches the client span.
+      dd::SpanSamplerConfig::Rule unmatched;
+      unmatched.service = "other";
+      unmatched.name = "db.query";
+      dd::SpanSamplerConfig::Rule matched;
+      matched.name = "http.client.request";
+      matched.max_per_second = 100;
+      config.span_sampler.rules = {unmatched, matched};
+    } break;
+    case RESOURCE_RENAMING:
+      config.resource_renaming_enabled = true;
+      break;
+    case REPORT_HOSTNAME:
+      config.report_hostname = true;
+      break;
+  }
+  return config;
+}
+
+// The time per trace of the baseline, or zero if it has not run.
+double baseline_seconds_per_trace = 0;
+
+// Create a server span tagged as an HTTP integration tags it, create a child
+// client span, inject the child's context into outgoing headers, and finish
+// the trace, all under the configuration given by the toggle that is the
+// benchmark's argument.
+void BM_ConfigMatrix(benchmark::State& state) {
+  const auto toggle = static_cast<Toggle>(state.range(0));
+  const auto config = dd::finalize_config(toggled_config(toggle));
+  if (!config) {
+    state.SkipWithError(config.error().message.c_str());
+    return;
+  }
+  dd::Tracer tracer{*config};
+  NullWriter writer;
+  dd::SpanConfig server_config;
+  server_config.name = "http.server.request";
+  server_config.resource = "GET /api/v1/users/42";
+  dd::SpanConfig client_config;
+  client_config.name = "http.client.request";
+
+  AllocationCounter allocations{state};
+  const auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    auto server = tracer.create_span(server_config);
+    server.set_tag("span.kind", "server");
+    server.set_tag("http.method", "GET");
+    server.set_tag("http.url", "https://example.com/api/v1/users/42");
+    {
+      auto client = server.create_child(client_config);
+      client.set_tag("span.kind", "client");
+      client.set_tag("http.method", "GET");
+      client.set_tag("http.url", "https://users-api/v2/users/42/profile");
+      client.inject(writer);
+      client.set_tag("http.status_code", "200");
+    }
+    server.set_tag("http.status_code", "200");
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::string label = toggle_names[toggle];
+  label += config->telemetry.enabled ? " telemetry:on" : " telemetry:off";
+  state.SetLabel(label);
+  state.SetItemsProcessed(state.iterations());
+
+  const double seconds_per_trace =
+      elapsed.count() / static_cast<double>(state.iterations());
+  if (toggle == BASELINE) {
+    baseline_seconds_per_trace = seconds_per_trace;
+  } else if (baseline_seconds_per_trace > 0) {
+    state.counters["delta_per_trace"] =
+        seconds_per_trace - baseline_seconds_per_trace;
+    state.counters["delta_ratio"] =
+        seconds_per_trace / baseline_seconds_per_trace - 1;
+  }
+}
+BENCHMARK(BM_ConfigMatrix)
+    ->DenseRange(BASELINE, REPORT_HOSTNAME)
+    ->ArgName("toggle");
+
+}  // namespace
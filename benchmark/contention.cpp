@@ -0,0 +1,209 @@
+// These benchmarks measure contention: each runs the same operation on one
+// shared object from an increasing number of threads.  Besides the total
+// "items_per_second", each reports "items_per_second_per_thread", which stays
+// constant as threads are added only if the threads do not contend.
+//
+// The shared object is created by the first thread before the benchmark loop
+// and destroyed by it after the loop.  Google Benchmark starts and ends the
+// loop on all threads together.
+
+#include <benchmark/benchmark.h>
+#include <datadog/clock.h>
+#include <datadog/datadog_agent.h>
+#include <datadog/datadog_agent_config.h>
+#include <datadog/runtime_id.h>
+#include <datadog/span.h>
+#include <datadog/span_data.h>
+#include <datadog/span_sampler.h>
+#include <datadog/span_sampler_config.h>
+#include <datadog/telemetry/telemetry.h>
+#include <datadog/telemetry_metrics.h>
+#include <datadog/trace_sampler.h>
+#include <datadog/trace_sampler_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_signature.h>
+
+#include <memory>
+#include <vector>
+
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+
+constexpr int max_threads = 16;
+
+void report_throughput(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations());
+  state.counters["items_per_second_per_thread"] = benchmark::Counter(
+      double(state.iterations()),
+      benchmark::Counter::kIsRate | benchmark::Counter::kAvgThreads);
+}
+
+dd::SpanData make_span_data() {
+  dd::SpanData span;
+  span.service = "benchmark";
+  span.name = "span.lifecycle";
+  span.resource = "GET /api/v2/users/profile";
+  return span;
+}
+
+// Create and finish child spans of one root span, so that every thread
+// registers spans with, and reports finished spans to, one trace segment.
+// The segment keeps every finished span until the root finishes, so the
+// number of iterations is fixed.
+void BM_TraceSegmentContention(benchmark::State& state) {
+  static std::unique_ptr<dd::Tracer> tracer;
+  static std::unique_ptr<dd::Span> root;
+  if (state.thread_index() == 0) {
+    tracer =
+        std::make_unique<dd::Tracer>(*dd::finalize_config(tracer_config()));
+    root = std::make_unique<dd::Span>(tracer->create_span());
+  }
+  for (auto _ : state) {
+    root->create_child();
+  }
+  if (state.thread_index() == 0) {
+    root.reset();
+    tracer.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_TraceSegmentContention)
+    ->Iterations(20'000)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+// Make sampling decisions with one trace sampler whose rule keeps half of
+// the traces, subject to its limiter.
+void BM_TraceSamplerContention(benchmark::State& state) {
+  static std::unique_ptr<dd::TraceSampler> sampler;
+  if (state.thread_index() == 0) {
+    dd::TraceSamplerConfig config;
+    config.sample_rate = 0.5;
+    config.max_per_second = 1'000'000;
+    sampler = std::make_unique<dd::TraceSampler>(*dd::finalize_config(config),
+                                                 dd::default_clock);
+  }
+  const auto span = make_span_data();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sampler->decide(span));
+  }
+  if (state.thread_index() == 0) {
+    sampler.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_TraceSamplerContention)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+// Make sampling decisions with one span sampler rule that has a limiter.
+void BM_SpanSamplerContention(benchmark::State& state) {
+  static std::unique_ptr<dd::SpanSampler> sampler;
+  if (state.thread_index() == 0) {
+    dd::SpanSamplerConfig config;
+    dd::SpanSamplerConfig::Rule rule;
+    rule.max_per_second = 1'000'000;
+    config.rules.push_back(rule);
+    NullLogger logger;
+    sampler = std::make_unique<dd::SpanSampler>(
+        *dd::finalize_config(config, logger), dd::default_clock);
+  }
+  const auto span = make_span_data();
+  for (auto _ : state) {
+    auto* rule = sampler->match(span);
+    benchmark::DoNotOptimize(rule->decide(span));
+  }
+  if (state.thread_index() == 0) {
+    sampler.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_SpanSamplerContention)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+// Increment one telemetry counter by name and tags.  The tracer initializes
+// telemetry.
+void BM_TelemetryCounterIncrement(benchmark::State& state) {
+  static std::unique_ptr<dd::Tracer> tracer;
+  if (state.thread_index() == 0) {
+    tracer =
+        std::make_unique<dd::Tracer>(*dd::finalize_config(tracer_config()));
+  }
+  const std::vector<std::string> tags{"integration_name:datadog"};
+  for (auto _ : state) {
+    datadog::telemetry::counter::increment(dd::metrics::tracer::spans_created,
+                                      tags);
+  }
+  if (state.thread_index() == 0) {
+    tracer.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_TelemetryCounterIncrement)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+// Increment one telemetry counter through a handle, as is done for every
+// span.
+void BM_TelemetryCounterHandle(benchmark::State& state) {
+  static std::unique_ptr<dd::Tracer> tracer;
+  if (state.thread_index() == 0) {
+    tracer =
+        std::make_unique<dd::Tracer>(*dd::finalize_config(tracer_config()));
+  }
+  const auto counter = datadog::telemetry::counter::handle(
+      dd::metrics::tracer::spans_created, {"integration_name:datadog"});
+  for (auto _ : state) {
+    counter.increment();
+  }
+  if (state.thread_index() == 0) {
+    tracer.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_TelemetryCounterHandle)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+// Send one-span trace chunks to one `DatadogAgent`, which buffers them and
+// flushes them every 10 milliseconds to an HTTP client that discards them.
+void BM_DatadogAgentSendContention(benchmark::State& state) {
+  static std::unique_ptr<dd::DatadogAgent> agent;
+  static std::shared_ptr<dd::TraceSampler> sampler;
+  if (state.thread_index() == 0) {
+    dd::DatadogAgentConfig config;
+    config.http_client = std::make_shared<NullHTTPClient>();
+    config.remote_configuration_enabled = false;
+    config.flush_interval_milliseconds = 10;
+    const auto logger = std::make_shared<NullLogger>();
+    const auto finalized =
+        dd::finalize_config(config, logger, dd::default_clock);
+    agent = std::make_unique<dd::DatadogAgent>(
+        *finalized, logger,
+        dd::TracerSignature{dd::RuntimeID::generate(), "benchmark", "none"},
+        std::vector<std::shared_ptr<datadog::remote_config::Listener>>{});
+    sampler = std::make_shared<dd::TraceSampler>(
+        *dd::finalize_config(dd::TraceSamplerConfig{}), dd::default_clock);
+  }
+  const auto span = make_span_data();
+  for (auto _ : state) {
+    std::vector<std::unique_ptr<dd::SpanData>> chunk;
+    chunk.push_back(std::make_unique<dd::SpanData>(span));
+    benchmark::DoNotOptimize(agent->send(std::move(chunk), sampler));
+  }
+  if (state.thread_index() == 0) {
+    agent.reset();
+    sampler.reset();
+  }
+  report_throughput(state);
+}
+BENCHMARK(BM_DatadogAgentSendContention)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+}  // namespace
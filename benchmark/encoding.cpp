@@ -0,0 +1,60 @@
+// These benchmarks measure the MessagePack encoding of trace chunks, as the
+// `DatadogAgent` collector does before sending them.  They are parameterized
+// by the number of spans in the chunk and the number of tags on each span.
+
+#include <benchmark/benchmark.h>
+#include <datadog/span_data.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+using benchmark_allocations::AllocationCounter;
+
+std::vector<std::unique_ptr<dd::SpanData>> make_chunk(int span_count,
+                                                      int tag_count) {
+  const auto names = tag_names(tag_count);
+  std::vector<std::unique_ptr<dd::SpanData>> spans;
+  for (int i = 0; i < span_count; ++i) {
+    auto span = std::make_unique<dd::SpanData>();
+    span->service = "benchmark";
+    span->service_type = "web";
+    span->name = "span.lifecycle";
+    span->resource = "GET /api/v2/users/profile";
+    span->trace_id = dd::TraceID(0x1234);
+    span->span_id = i + 1;
+    span->parent_id = i;
+    span->duration = std::chrono::microseconds(i);
+    for (const auto& name : names) {
+      span->tags[name] = tag_value();
+    }
+    span->numeric_tags["_dd.measured"] = 1;
+    spans.push_back(std::move(span));
+  }
+  return spans;
+}
+
+void BM_EncodeChunk(benchmark::State& state) {
+  const auto spans = make_chunk(state.range(0), state.range(1));
+  std::string buffer;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    buffer.clear();
+    const auto result = dd::msgpack_encode(buffer, spans);
+    benchmark::DoNotOptimize(result);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * spans.size());
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_EncodeChunk)->ArgsProduct({{1, 10, 100, 1000}, {0, 4, 16}});
+
+}  // namespace
@@ -0,0 +1,86 @@
+// These benchmarks measure inferring `http.endpoint` from the URL paths of a
+// corpus of requests typical of HTTP services, both directly with
+// `infer_endpoint` and through an `EndpointCache`.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "endpoint_inferral.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+std::vector<std::string> make_paths() {
+  // Paths of the shapes commonly seen by web services and APIs, with the
+  // identifiers varying from one request to the next.
+  const char* const shapes[] = {
+      "/",
+      "/health",
+      "/api/v1/users/%d",
+      "/api/v1/users/%d/orders/%d",
+      "/api/v2/accounts/%x%x/settings",
+      "/static/js/app.%x%x.js",
+      "/products/category/shoes/item-%d",
+      "/search/results/page/%d",
+      "/v3/repos/datadog/dd-trace-cpp/commits/%x%x%x%x",
+      "/files/2024-06-%d/report_%d.pdf",
+      "/oauth/authorize/callback",
+      "/graphql",
+      "/blog/2023/11/how-we-reduced-tracer-overhead-by-half",
+      "/images/%d/thumbnail@2x.png",
+  };
+
+  std::vector<std::string> paths;
+  unsigned state = 12345;
+  for (int i = 0; i < 1024; ++i) {
+    state = state * 1103515245 + 12345;
+    const char* const shape = shapes[state % std::size(shapes)];
+    std::string path;
+    for (const char* c = shape; *c; ++c) {
+      if (*c != '%') {
+        path += *c;
+        continue;
+      }
+      // "%d" is a decimal number, and "%x" is eight hexadecimal digits.
+      const bool decimal = *++c == 'd';
+      state = state * 1103515245 + 12345;
+      char buffer[16];
+      std::snprintf(buffer, sizeof buffer, decimal ? "%u" : "%08x",
+                    decimal ? (state >> 8) % 100000 : state);
+      path += buffer;
+    }
+    paths.push_back(std::move(path));
+  }
+  return paths;
+}
+
+void BM_InferEndpoint(benchmark::State& state) {
+  const auto paths = make_paths();
+  for (auto _ : state) {
+    for (const auto& path : paths) {
+      benchmark::DoNotOptimize(dd::infer_endpoint(path));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * paths.size());
+}
+BENCHMARK(BM_InferEndpoint);
+
+void BM_InferEndpointCached(benchmark::State& state) {
+  const auto paths = make_paths();
+  dd::EndpointCache cache{dd::EndpointCache::max_shards, 256};
+  for (auto _ : state) {
+    for (const auto& path : paths) {
+      benchmark::DoNotOptimize(cache.infer(path));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * paths.size());
+}
+BENCHMARK(BM_InferEndpointCached);
+
+}  // namespace
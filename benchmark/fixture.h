@@ -0,0 +1,118 @@
+#pragma once
+
+// This file defines what the span lifecycle benchmarks have in common: a
+// `Logger`, a `Collector`, an `HTTPClient` and an `EventScheduler` that do
+// nothing, a tracer configuration that uses them, and the names and values of
+// the tags that the benchmarks set.  None of it does I/O, so that the
+// benchmarks measure only the tracer.
+
+#include <datadog/collector.h>
+#include <datadog/dict_reader.h>
+#include <datadog/event_scheduler.h>
+#include <datadog/http_client.h>
+#include <datadog/logger.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace benchmark_fixture {
+
+namespace dd = datadog::tracing;
+
+// `NullLogger` doesn't log. It avoids `log_startup` spam in the benchmark.
+struct NullLogger : public dd::Logger {
+  void log_error(const LogFunc&) override {}
+  void log_startup(const LogFunc&) override {}
+  void log_error(const dd::Error&) override {}
+  void log_error(dd::StringView) override {}
+};
+
+// `NullCollector` discards the trace chunks sent to it.
+struct NullCollector : public dd::Collector {
+  dd::Expected<void> send(
+      std::vector<std::unique_ptr<dd::SpanData>>&&,
+      const std::shared_ptr<dd::TraceSampler>&) override {
+    return {};
+  }
+
+  bool accepts_shared_tags() const override { return true; }
+
+  std::string config() const override {
+    return R"({"type": "NullCollector"})";
+  }
+};
+
+// `NullHTTPClient` responds to every request, immediately and on the calling
+// thread, with an empty successful response.
+struct NullHTTPClient : public dd::HTTPClient {
+  struct NoHeaders : public dd::DictReader {
+    dd::Optional<dd::StringView> lookup(dd::StringView) const override {
+      return dd::nullopt;
+    }
+    void visit(const std::function<void(dd::StringView, dd::StringView)>&)
+        const override {}
+  };
+
+  using HTTPClient::post;
+
+  dd::Expected<void> post(const URL&, HeadersSetter, std::string,
+                          ResponseHandler on_response, ErrorHandler,
+                          std::chrono::steady_clock::time_point) override {
+    on_response(200, NoHeaders{}, "{}");
+    return {};
+  }
+
+  void drain(std::chrono::steady_clock::time_point) override {}
+
+  std::string config() const override {
+    return R"({"type": "NullHTTPClient"})";
+  }
+};
+
+// `NullEventScheduler` never invokes the events scheduled with it.
+struct NullEventScheduler : public dd::EventScheduler {
+  Cancel schedule_recurring_event(std::chrono::steady_clock::duration,
+                                  std::function<void()>) override {
+    return []() {};
+  }
+
+  std::string config() const override {
+    return R"({"type": "NullEventScheduler"})";
+  }
+};
+
+// Return a tracer configuration that uses a `NullLogger` and a
+// `NullCollector`.  Telemetry is enabled, as it is by default, so that its
+// metrics are recorded, but it is never sent.  Telemetry is initialized once
+// per process, by the first tracer, so every benchmark uses this
+// configuration.
+inline dd::TracerConfig tracer_config() {
+  dd::TracerConfig config;
+  config.service = "benchmark";
+  config.logger = std::make_shared<NullLogger>();
+  config.collector = std::make_shared<NullCollector>();
+  config.agent.http_client = std::make_shared<NullHTTPClient>();
+  config.agent.event_scheduler = std::make_shared<NullEventScheduler>();
+  return config;
+}
+
+// Return the specified `count` distinct tag names, e.g. "tag.0", "tag.1".
+inline std::vector<std::string> tag_names(int count) {
+  std::vector<std::string> names;
+  for (int i = 0; i < count; ++i) {
+    names.push_back("tag." + std::to_string(i));
+  }
+  return names;
+}
+
+// A tag value of a typical length, such as of a URL path or a database name.
+inline const std::string& tag_value() {
+  static const std::string value = "/api/v2/users/profile";
+  return value;
+}
+
+}  // namespace benchmark_fixture
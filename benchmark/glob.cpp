@@ -0,0 +1,71 @@
+// These benchmarks measure matching span names against the glob patterns of
+// sampling rules, both interpreted by `glob_match` and compiled as
+// `GlobPattern`s.  They are parameterized by the kind of the rules' patterns:
+// literals, prefixes, suffixes, or general patterns.
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "glob.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+// Each rule set is typical of the sampling rules that match one kind of name.
+const std::vector<std::vector<std::string>> rule_sets{
+    {"web-store", "checkout", "payments-api", "Inventory", "search"},
+    {"web-*", "checkout-*", "payments*", "inventory-*", "search.*"},
+    {"*-worker", "*.internal", "*_consumer", "*-db", "*-cache"},
+    {"web-?-*", "*-canary-*", "n?-ingress-*", "*db?", "api-*-v?"},
+};
+
+const char* const labels[] = {"literal", "prefix", "suffix", "glob"};
+
+// Names of the services, operations, and resources that spans commonly have.
+const std::vector<std::string> subjects{
+    "web-store",       "checkout-service", "payments-api",
+    "inventory-db",    "search.query",     "email-worker",
+    "orders.internal", "kafka_consumer",   "user-profile-cache",
+    "web-1-frontend",  "api-gateway-v2",   "ny-ingress-leader",
+    "http.request",    "mysql.query",      "GET /api/v1/users/?",
+};
+
+void BM_GlobMatch(benchmark::State& state) {
+  const auto& patterns = rule_sets[state.range(0)];
+  state.SetLabel(labels[state.range(0)]);
+  for (auto _ : state) {
+    for (const auto& subject : subjects) {
+      for (const auto& pattern : patterns) {
+        benchmark::DoNotOptimize(dd::glob_match(pattern, subject));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * subjects.size() *
+                          patterns.size());
+}
+BENCHMARK(BM_GlobMatch)->DenseRange(0, std::size(labels) - 1);
+
+void BM_GlobPattern(benchmark::State& state) {
+  std::vector<dd::GlobPattern> patterns;
+  for (const auto& pattern : rule_sets[state.range(0)]) {
+    patterns.emplace_back(pattern);
+  }
+  state.SetLabel(labels[state.range(0)]);
+  for (auto _ : state) {
+    for (const auto& subject : subjects) {
+      for (const auto& pattern : patterns) {
+        benchmark::DoNotOptimize(pattern.match(subject));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * subjects.size() *
+                          patterns.size());
+}
+BENCHMARK(BM_GlobPattern)->DenseRange(0, std::size(labels) - 1);
+
+}  // namespace
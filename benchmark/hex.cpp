@@ -0,0 +1,106 @@
+// These benchmarks compare the table-driven hexadecimal formatting and
+// parsing in `hex.h` with the `std::to_chars` and `std::from_chars` based
+// implementations that they replaced.
+
+#include <benchmark/benchmark.h>
+#include <datadog/hex.h>
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+std::vector<std::uint64_t> make_ids() {
+  // A fixed sequence of IDs that have varying numbers of leading zeroes.
+  std::vector<std::uint64_t> ids;
+  std::uint64_t state = 0x9e3779b97f4a7c15;
+  for (int i = 0; i < 1024; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    ids.push_back(state >> (i % 64));
+  }
+  return ids;
+}
+
+void append_hex_padded_to_chars(std::string& destination,
+                                std::uint64_t value) {
+  char buffer[16];
+  const auto result =
+      std::to_chars(std::begin(buffer), std::end(buffer), value, 16);
+  destination.append(sizeof(buffer) - (result.ptr - std::begin(buffer)), '0');
+  destination.append(std::begin(buffer), result.ptr);
+}
+
+std::uint64_t parse_hex_from_chars(dd::StringView digits) {
+  std::uint64_t value = 0;
+  std::from_chars(digits.data(), digits.data() + digits.size(), value, 16);
+  return value;
+}
+
+void BM_AppendHexPaddedToChars(benchmark::State& state) {
+  const auto ids = make_ids();
+  std::string buffer;
+  for (auto _ : state) {
+    buffer.clear();
+    for (const auto id : ids) {
+      append_hex_padded_to_chars(buffer, id);
+    }
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_AppendHexPaddedToChars);
+
+void BM_AppendHexPadded(benchmark::State& state) {
+  const auto ids = make_ids();
+  std::string buffer;
+  for (auto _ : state) {
+    buffer.clear();
+    for (const auto id : ids) {
+      dd::append_hex_padded(buffer, id);
+    }
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_AppendHexPadded);
+
+void BM_ParseHexFromChars(benchmark::State& state) {
+  std::string digits;
+  for (const auto id : make_ids()) {
+    dd::append_hex_padded(digits, id);
+  }
+  for (auto _ : state) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < digits.size(); i += 16) {
+      sum += parse_hex_from_chars(dd::StringView(digits).substr(i, 16));
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (digits.size() / 16));
+}
+BENCHMARK(BM_ParseHexFromChars);
+
+void BM_ParseHex(benchmark::State& state) {
+  std::string digits;
+  for (const auto id : make_ids()) {
+    dd::append_hex_padded(digits, id);
+  }
+  for (auto _ : state) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < digits.size(); i += 16) {
+      sum += *dd::parse_hex(dd::StringView(digits).substr(i, 16));
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (digits.size() / 16));
+}
+BENCHMARK(BM_ParseHex);
+
+}  // namespace
@@ -0,0 +1,362 @@
+// These benchmarks compare the payload formats in which a collector can send
+// trace chunks to the Datadog Agent, so that the default for a deployment can
+// be chosen by what its traces cost to encode and to send.
+//
+// Each iteration encodes one payload of a corpus of trace chunks, as one flush
+// of `DatadogAgent` would, in either the v0.4 format (see `msgpack_encode` in
+// `span_data.h`) or the v0.5 format (see `trace_encoder_v05.h`), and then
+// optionally gzip compresses it at a given level.  The benchmarks report
+// `time_per_span`, the time to encode and compress per span, and
+// `bytes_per_span`, the size of the payload per span, and are labeled with
+// the workload and format, so that the output is a table of the two.
+//
+// The workloads are:
+//
+// - "nginx", traces shaped like those of the nginx module: a request span
+//   and a location span, with HTTP tags whose URLs vary from trace to trace,
+// - "grpc", traces shaped like those of a gRPC service: a server span, client
+//   spans to other services, and database and cache spans, and
+// - "capture", the traces recorded by a `RecordingCollector` in the capture
+//   file named by the `DD_TRACE_BENCHMARK_CAPTURE` environment variable (see
+//   `capture_file.h`).  It is skipped if the variable is not set.
+
+#include <benchmark/benchmark.h>
+#include <datadog/capture_file.h>
+#include <datadog/compression.h>
+#include <datadog/msgpack.h>
+#include <datadog/span_data.h>
+#include <datadog/trace_encoder_v05.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+using Chunk = std::vector<std::unique_ptr<dd::SpanData>>;
+
+// The number of traces in each payload of the synthetic workloads.  A busy
+// service flushes a few hundred traces every two seconds.
+const int traces_per_payload = 200;
+
+enum Workload { NGINX, GRPC, CAPTURE };
+const char* const workload_names[] = {"nginx", "grpc", "capture"};
+
+std::unique_ptr<dd::SpanData> make_span(std::uint64_t trace_id,
+                                        std::uint64_t span_id,
+                                        std::uint64_t parent_id) {
+  auto span = std::make_unique<dd::SpanData>();
+  span->trace_id = dd::TraceID(trace_id, 0x6720a8c600000000);
+  span->span_id = span_id;
+  span->parent_id = parent_id;
+  span->start.wall = std::chrono::system_clock::time_point(
+      std::chrono::nanoseconds(1730000000000000000 + trace_id * 1000003));
+  span->duration = std::chrono::microseconds(150 + trace_id % 1000);
+  return span;
+}
+
+// Add to the specified `span` the tags that a tracer adds to the root span of
+// every trace chunk.
+void add_root_tags(dd::SpanData& span) {
+  span.tags["_dd.p.dm"] = "-0";
+  span.tags["_dd.p.tid"] = "6720a8c600000000";
+  span.tags["language"] = "cpp";
+  span.tags["runtime-id"] = "4e3f8b9c-5d2a-4c1e-9f7b-2a6d8e0c1b3a";
+  span.numeric_tags["_dd.agent_psr"] = 1;
+  span.numeric_tags["_sampling_priority_v1"] = 1;
+  span.numeric_tags["process_id"] = 4242;
+}
+
+Chunk nginx_trace(std::uint64_t i) {
+  static const char* const paths[] = {"/api/v2/users/", "/api/v2/orders/",
+                                      "/static/js/app.", "/healthz?probe="};
+  const std::string url = std::string(paths[i % 4]) + std::to_string(i * 7919);
+
+  Chunk chunk;
+  auto request = make_span(i + 1, (i + 1) * 2, 0);
+  request->service = "nginx";
+  request->service_type = "web";
+  request->name = "nginx.request";
+  request->resource = "GET /api/v2";
+  request->tags["component"] = "nginx";
+  request->tags["env"] = "prod";
+  request->tags["version"] = "1.27.2";
+  request->tags["span.kind"] = "server";
+  request->tags["http.method"] = "GET";
+  request->tags["http.url"] = "https://shop.example.com" + url;
+  request->tags["http.status_code"] = i % 50 ? "200" : "404";
+  request->tags["http.useragent"] =
+      "Mozilla/5.0 (X11; Linux x86_64; rv:131.0) Gecko/20100101 Firefox/131.0";
+  request->tags["http.client_ip"] = "10.0.3." + std::to_string(i % 256);
+  request->tags["nginx.location"] = "/api/";
+  add_root_tags(*request);
+  request->numeric_tags["_dd.top_level"] = 1;
+
+  auto location = make_span(i + 1, (i + 1) * 2 + 1, (i + 1) * 2);
+  location->service = "nginx";
+  location->service_type = "web";
+  location->name = "nginx.handle";
+  location->resource = "/api/";
+  location->tags["component"] = "nginx";
+  location->tags["env"] = "prod";
+  location->tags["version"] = "1.27.2";
+  location->tags["nginx.upstream"] = "10.0.7.12:8080";
+
+  chunk.push_back(std::move(request));
+  chunk.push_back(std::move(location));
+  return chunk;
+}
+
+Chunk grpc_trace(std::uint64_t i) {
+  static const char* const methods[] = {"GetUser", "ListOrders", "PlaceOrder",
+                                        "GetInventory"};
+  const std::string method = methods[i % 4];
+  const std::uint64_t root = (i + 1) * 8;
+
+  Chunk chunk;
+  auto server = make_span(i + 1, root, 0);
+  server->service = "checkout";
+  server->service_type = "rpc";
+  server->name = "grpc.server";
+  server->resource = "/shop.v1.Checkout/" + method;
+  server->tags["component"] = "grpc";
+  server->tags["env"] = "prod";
+  server->tags["version"] = "2024.10.3";
+  server->tags["span.kind"] = "server";
+  server->tags["rpc.system"] = "grpc";
+  server->tags["rpc.service"] = "shop.v1.Checkout";
+  server->tags["rpc.method"] = method;
+  server->tags["grpc.status.code"] = "0";
+  server->tags["peer.address"] = "10.0.4." + std::to_string(i % 256);
+  add_root_tags(*server);
+  server->numeric_tags["_dd.top_level"] = 1;
+  chunk.push_back(std::move(server));
+
+  static const char* const services[] = {"users", "inventory", "pricing"};
+  for (std::uint64_t j = 0; j < 3; ++j) {
+    auto client = make_span(i + 1, root + 1 + j, root);
+    client->service = "checkout";
+    client->service_type = "rpc";
+    client->name = "grpc.client";
+    client->resource = std::string("/shop.v1.") + services[j] + "/Get";
+    client->tags["component"] = "grpc";
+    client->tags["env"] = "prod";
+    client->tags["version"] = "2024.10.3";
+    client->tags["span.kind"] = "client";
+    client->tags["rpc.system"] = "grpc";
+    client->tags["rpc.service"] = std::string("shop.v1.") + services[j];
+    client->tags["rpc.method"] = "Get";
+    client->tags["grpc.status.code"] = "0";
+    client->tags["peer.service"] = services[j];
+    client->tags["out.host"] = std::string(services[j]) + ".svc.cluster.local";
+    client->numeric_tags["network.destination.port"] = 50051;
+    chunk.push_back(std::move(client));
+  }
+
+  auto query = make_span(i + 1, root + 4, root);
+  query->service = "checkout-postgres";
+  query->service_type = "sql";
+  query->name = "postgres.query";
+  query->resource = "SELECT * FROM orders WHERE customer_id = ? LIMIT ?";
+  query->tags["component"] = "libpq";
+  query->tags["env"] = "prod";
+  query->tags["span.kind"] = "client";
+  query->tags["db.system"] = "postgresql";
+  query->tags["db.name"] = "orders";
+  query->tags["db.user"] = "checkout";
+  query->tags["out.host"] = "orders-db.internal";
+  query->numeric_tags["db.row_count"] = static_cast<double>(i % 20);
+  query->numeric_tags["_dd.top_level"] = 1;
+  chunk.push_back(std::move(query));
+
+  auto cache = make_span(i + 1, root + 5, root);
+  cache->service = "checkout-redis";
+  cache->service_type = "redis";
+  cache->name = "redis.command";
+  cache->resource = "GET";
+  cache->tags["component"] = "hiredis";
+  cache->tags["env"] = "prod";
+  cache->tags["span.kind"] = "client";
+  cache->tags["db.system"] = "redis";
+  cache->tags["redis.raw_command"] = "GET cart:" + std::to_string(i * 31);
+  cache->tags["out.host"] = "cache.internal";
+  cache->numeric_tags["_dd.top_level"] = 1;
+  chunk.push_back(std::move(cache));
+
+  return chunk;
+}
+
+// Append to the specified `corpus` the trace chunks of the specified v0.4
+// `payload`.  Span links and span events are not decoded.
+void decode_payload(std::vector<Chunk>& corpus, dd::StringView payload) {
+  const auto chunks = nlohmann::json::from_msgpack(
+      payload.data(), payload.data() + payload.size());
+  for (const auto& encoded_chunk : chunks) {
+    Chunk chunk;
+    for (const auto& encoded : encoded_chunk) {
+      auto span = std::make_unique<dd::SpanData>();
+      span->service = encoded.value("service", "");
+      span->service_type = encoded.value("type", "");
+      span->name = encoded.value("name", "");
+      span->resource = encoded.value("resource", "");
+      span->trace_id = dd::TraceID(encoded.value("trace_id", std::uint64_t(0)));
+      span->span_id = encoded.value("span_id", std::uint64_t(0));
+      span->parent_id = encoded.value("parent_id", std::uint64_t(0));
+      span->start.wall = std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::nanoseconds(encoded.value("start", 0ll))));
+      span->duration = std::chrono::nanoseconds(encoded.value("duration", 0ll));
+      span->error = encoded.value("error", 0) != 0;
+      if (const auto meta = encoded.find("meta"); meta != encoded.end()) {
+        for (const auto& [key, value] : meta->items()) {
+          span->tags[key] = value.get<std::string>();
+        }
+      }
+      if (const auto metrics = encoded.find("metrics");
+          metrics != encoded.end()) {
+        for (const auto& [key, value] : metrics->items()) {
+          span->numeric_tags[key] = value.get<double>();
+        }
+      }
+      chunk.push_back(std::move(span));
+    }
+    corpus.push_back(std::move(chunk));
+  }
+}
+
+// Return the trace chunks of the capture named by the
+// `DD_TRACE_BENCHMARK_CAPTURE` environment variable, or return an empty
+// corpus if it is not set.  Exit if the capture cannot be read.
+std::vector<Chunk> load_capture() {
+  std::vector<Chunk> corpus;
+  const char* const path = std::getenv("DD_TRACE_BENCHMARK_CAPTURE");
+  if (path == nullptr || *path == '\0') {
+    return corpus;
+  }
+
+  auto capture = dd::CaptureFile::open(path);
+  if (auto* error = capture.if_error()) {
+    fprintf(stderr, "Unable to read the capture %s: %s\n", path,
+            error->message.c_str());
+    std::exit(1);
+  }
+  std::uint64_t position = 0;
+  dd::CaptureFile::Record record;
+  while ((*capture)->next(position, record)) {
+    decode_payload(corpus, record.payload);
+  }
+  return corpus;
+}
+
+const std::vector<Chunk>& corpus(Workload workload) {
+  static const auto make = [](Chunk (*make_trace)(std::uint64_t)) {
+    std::vector<Chunk> corpus;
+    for (int i = 0; i < traces_per_payload; ++i) {
+      corpus.push_back(make_trace(i));
+    }
+    return corpus;
+  };
+  static const std::vector<Chunk> nginx = make(nginx_trace);
+  static const std::vector<Chunk> grpc = make(grpc_trace);
+
+  switch (workload) {
+    case NGINX:
+      return nginx;
+    case GRPC:
+      return grpc;
+    default: {
+      static const std::vector<Chunk> capture = load_capture();
+      return capture;
+    }
+  }
+}
+
+// Encode the specified `chunks` as one payload of the specified `format`
+// (4 or 5), into the specified `payload`.
+dd::Expected<void> encode(std::string& payload, int format,
+                          const std::vector<Chunk>& chunks) {
+  if (format == 5) {
+    dd::TraceEncoderV05 encoder(payload.capacity());
+    for (const auto& chunk : chunks) {
+      auto result = encoder.add_chunk(chunk);
+      if (dd::Error* error = result.if_error()) {
+        return *error;
+      }
+    }
+    return encoder.finish(payload);
+  }
+
+  auto result = dd::msgpack::pack_array(payload, chunks.size());
+  for (const auto& chunk : chunks) {
+    if (!result) {
+      break;
+    }
+    result = dd::msgpack_encode(payload, chunk);
+  }
+  return result;
+}
+
+// The arguments are the workload, the format (4 or 5), and the gzip
+// compression level, where zero means no compression.
+void BM_EncodePayload(benchmark::State& state) {
+  const auto workload = static_cast<Workload>(state.range(0));
+  const int format = static_cast<int>(state.range(1));
+  const int gzip_level = static_cast<int>(state.range(2));
+
+  const auto& chunks = corpus(workload);
+  if (chunks.empty()) {
+    state.SkipWithError("DD_TRACE_BENCHMARK_CAPTURE is not set");
+    return;
+  }
+  if (gzip_level != 0 && !dd::gzip_available()) {
+    state.SkipWithError("gzip compression is not available in this build");
+    return;
+  }
+  std::size_t span_count = 0;
+  for (const auto& chunk : chunks) {
+    span_count += chunk.size();
+  }
+
+  std::string payload;
+  std::string compressed;
+  for (auto _ : state) {
+    payload.clear();
+    auto result = encode(payload, format, chunks);
+    if (result && gzip_level != 0) {
+      compressed.clear();
+      result = dd::gzip_compress(compressed, payload, gzip_level);
+    }
+    if (!result) {
+      state.SkipWithError(result.error().message.c_str());
+      return;
+    }
+    benchmark::DoNotOptimize(payload.data());
+    benchmark::DoNotOptimize(compressed.data());
+  }
+
+  const auto size = gzip_level != 0 ? compressed.size() : payload.size();
+  std::string label = workload_names[workload];
+  label += format == 5 ? " v0.5" : " v0.4";
+  if (gzip_level != 0) {
+    label += " gzip-" + std::to_string(gzip_level);
+  }
+  state.SetLabel(label);
+  state.SetItemsProcessed(state.iterations() * span_count);
+  state.counters["time_per_span"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * span_count),
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["bytes_per_span"] =
+      static_cast<double>(size) / static_cast<double>(span_count);
+}
+BENCHMARK(BM_EncodePayload)
+    ->ArgsProduct({{NGINX, GRPC, CAPTURE}, {4, 5}, {0, 1, 6}})
+    ->ArgNames({"workload", "format", "gzip"});
+
+}  // namespace
@@ -0,0 +1,180 @@
+// These benchmarks measure trace context propagation: `Span::inject` and
+// `Tracer::extract_span` for each of the Datadog, B3, and W3C propagation
+// styles.  They are parameterized by the style and by the number of
+// propagated trace tags ("_dd.p.*"), which the Datadog and W3C styles carry.
+// `Tracer::extract_span` is also measured on headers from which no span can be
+// extracted, because most requests that a server traces carry no context.
+
+#include <benchmark/benchmark.h>
+#include <datadog/dict_reader.h>
+#include <datadog/dict_writer.h>
+#include <datadog/propagation_style.h>
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+using benchmark_allocations::AllocationCounter;
+
+const dd::PropagationStyle styles[] = {dd::PropagationStyle::DATADOG,
+                                       dd::PropagationStyle::B3,
+                                       dd::PropagationStyle::W3C};
+
+// `Headers` is a list of header names and values that is reused across
+// iterations, so that writing to it allocates only when a value outgrows the
+// previous one.
+class Headers : public dd::DictReader, public dd::DictWriter {
+  std::vector<std::pair<std::string, std::string>> headers_;
+  std::size_t size_ = 0;
+
+ public:
+  void clear() { size_ = 0; }
+
+  void set(dd::StringView key, dd::StringView value) override {
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (headers_[i].first == key) {
+        headers_[i].second.assign(value.data(), value.size());
+        return;
+      }
+    }
+    if (size_ == headers_.size()) {
+      headers_.emplace_back();
+    }
+    auto& header = headers_[size_++];
+    header.first.assign(key.data(), key.size());
+    header.second.assign(value.data(), value.size());
+  }
+
+  dd::Optional<dd::StringView> lookup(dd::StringView key) const override {
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (headers_[i].first == key) {
+        return dd::StringView(headers_[i].second);
+      }
+    }
+    return dd::nullopt;
+  }
+
+  void visit(const std::function<void(dd::StringView key,
+                                      dd::StringView value)>& visitor)
+      const override {
+    for (std::size_t i = 0; i < size_; ++i) {
+      visitor(headers_[i].first, headers_[i].second);
+    }
+  }
+};
+
+// Return Datadog style headers for a trace that has the specified number of
+// propagated trace tags.
+Headers datadog_headers(int trace_tag_count) {
+  Headers headers;
+  headers.set("x-datadog-trace-id", "1234567890");
+  headers.set("x-datadog-parent-id", "987654321");
+  headers.set("x-datadog-sampling-priority", "1");
+  headers.set("x-datadog-origin", "synthetics");
+  std::string trace_tags = "_dd.p.dm=-4";
+  for (int i = 0; i < trace_tag_count; ++i) {
+    trace_tags += ",_dd.p.tag" + std::to_string(i) + "=value";
+  }
+  headers.set("x-datadog-tags", trace_tags);
+  return headers;
+}
+
+dd::Tracer make_tracer(dd::PropagationStyle style) {
+  auto config = tracer_config();
+  config.injection_styles = {style};
+  config.extraction_styles = {dd::PropagationStyle::DATADOG, style};
+  return dd::Tracer{*dd::finalize_config(config)};
+}
+
+void BM_Inject(benchmark::State& state) {
+  const auto style = styles[state.range(0)];
+  state.SetLabel(std::string(dd::to_string_view(style)));
+  auto tracer = make_tracer(style);
+  const auto parent = tracer.extract_span(datadog_headers(state.range(1)));
+  const auto span = parent->create_child();
+  Headers headers;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    headers.clear();
+    span.inject(headers);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Inject)->ArgsProduct({{0, 1, 2}, {0, 4, 16}});
+
+// Extract a span from headers of one style.  Each extracted span is the root
+// of its trace segment, so the measurement includes finishing the segment.
+void BM_ExtractSpan(benchmark::State& state) {
+  const auto style = styles[state.range(0)];
+  state.SetLabel(std::string(dd::to_string_view(style)));
+  Headers headers;
+  {
+    // Produce the headers by injecting a span of a trace that has the trace
+    // tags.
+    auto injector = make_tracer(style);
+    const auto parent =
+        injector.extract_span(datadog_headers(state.range(1)));
+    parent->inject(headers);
+  }
+  auto config = tracer_config();
+  config.extraction_styles = {style};
+  dd::Tracer tracer{*dd::finalize_config(config)};
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    auto span = tracer.extract_span(headers);
+    benchmark::DoNotOptimize(span);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractSpan)->ArgsProduct({{0, 1, 2}, {0, 4, 16}});
+
+// Extract a span from headers that have no trace context, that have a trace ID
+// but no parent ID, or that have a malformed trace ID, using `extract_span`,
+// which describes the error, or `extract_or_create_span`, which discards it
+// and creates a root span instead.
+void BM_ExtractSpanMalformed(benchmark::State& state) {
+  Headers headers;
+  headers.set("content-type", "text/plain");
+  switch (state.range(0)) {
+    case 0:
+      state.SetLabel("no context");
+      break;
+    case 1:
+      state.SetLabel("no parent");
+      headers.set("x-datadog-trace-id", "1234567890");
+      break;
+    default:
+      state.SetLabel("malformed");
+      headers.set("x-datadog-trace-id", "12345x7890");
+      headers.set("x-datadog-parent-id", "987654321");
+  }
+  const bool create = state.range(1);
+  auto config = tracer_config();
+  config.extraction_styles = {dd::PropagationStyle::DATADOG,
+                              dd::PropagationStyle::W3C};
+  dd::Tracer tracer{*dd::finalize_config(config)};
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    if (create) {
+      auto span = tracer.extract_or_create_span(headers);
+      benchmark::DoNotOptimize(span);
+    } else {
+      auto span = tracer.extract_span(headers);
+      benchmark::DoNotOptimize(span);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractSpanMalformed)->ArgsProduct({{0, 1, 2}, {0, 1}});
+
+}  // namespace
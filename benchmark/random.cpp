@@ -0,0 +1,36 @@
+// These benchmarks compare the generator behind `random_uint64`, which is
+// used for trace IDs and span IDs, with the `std::mt19937_64` based generator
+// that it replaced.  Each reports, as the "state_bytes" counter, the size of
+// the generator's state, which every thread that creates spans has a copy of.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+
+#include "random.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+void BM_MersenneTwister(benchmark::State& state) {
+  thread_local std::mt19937_64 generator{std::random_device{}()};
+  thread_local std::uniform_int_distribution<std::uint64_t> distribution;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(distribution(generator));
+  }
+  state.counters["state_bytes"] = sizeof(generator) + sizeof(distribution);
+}
+BENCHMARK(BM_MersenneTwister);
+
+void BM_RandomUint64(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dd::random_uint64());
+  }
+  // The four 64-bit words of xoshiro256** (see `random.cpp`).
+  state.counters["state_bytes"] = 4 * sizeof(std::uint64_t);
+}
+BENCHMARK(BM_RandomUint64);
+
+}  // namespace
@@ -0,0 +1,297 @@
+// These benchmarks measure the span lifecycle: creating root and child spans,
+// setting tags and metrics on them, and finishing traces, which includes
+// making a sampling decision.  Each is parameterized by the number of tags
+// set on each span and, where it applies, by the depth of the trace, so that
+// a regression can be attributed to one of them.
+
+#include <benchmark/benchmark.h>
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/span_schema.h>
+#include <datadog/tracer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+using benchmark_allocations::AllocationCounter;
+
+// The number of child spans that `BM_CreateChildSpan` creates in a trace
+// before it starts another, so that a trace does not grow without bound.
+constexpr int children_per_trace = 1024;
+
+void set_tags(dd::Span& span, const std::vector<std::string>& names) {
+  for (const auto& name : names) {
+    span.set_tag(name, tag_value());
+  }
+}
+
+// Create, tag, and finish a trace whose only span is the root.
+void BM_CreateRootSpan(benchmark::State& state) {
+  const auto names = tag_names(state.range(0));
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    auto root = tracer.create_span();
+    set_tags(root, names);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateRootSpan)->Arg(0)->Arg(4)->Arg(16);
+
+// Create and finish a root span whose name, resource, and tags are given by
+// string literals, in a `SpanConfig` (argument 0) or in a `SpanConfigView`
+// (argument 1).  Building the configuration is part of the measurement.
+void BM_CreateRootSpanWithConfig(benchmark::State& state) {
+  const bool use_view = state.range(0);
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    if (use_view) {
+      static const dd::SpanConfigView::Tag tags[] = {
+          {"http.method", "GET"},
+          {"http.route", "/api/v1/users/{user_id}/preferences"},
+          {"component", "benchmark"}};
+      dd::SpanConfigView span_config;
+      span_config.name = "http.request.server.handler";
+      span_config.resource = "GET /api/v1/users/{user_id}/preferences";
+      span_config.tags = tags;
+      auto root = tracer.create_span(span_config);
+    } else {
+      dd::SpanConfig span_config;
+      span_config.name = "http.request.server.handler";
+      span_config.resource = "GET /api/v1/users/{user_id}/preferences";
+      span_config.tags = {
+          {"http.method", "GET"},
+          {"http.route", "/api/v1/users/{user_id}/preferences"},
+          {"component", "benchmark"}};
+      auto root = tracer.create_span(span_config);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateRootSpanWithConfig)->Arg(0)->Arg(1);
+
+// Create, tag, and finish a child span whose parent is at the specified
+// depth below the root.  The trace is finished, outside of the measurement,
+// every `children_per_trace` children.
+void BM_CreateChildSpan(benchmark::State& state) {
+  const auto depth = state.range(0);
+  const auto names = tag_names(state.range(1));
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  std::vector<dd::Span> ancestors;
+  int children = 0;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    if (children++ % children_per_trace == 0) {
+      state.PauseTiming();
+      allocations.pause();
+      while (!ancestors.empty()) {
+        ancestors.pop_back();
+      }
+      ancestors.push_back(tracer.create_span());
+      for (int i = 0; i < depth; ++i) {
+        ancestors.push_back(ancestors.back().create_child());
+      }
+      allocations.resume();
+      state.ResumeTiming();
+    }
+    auto child = ancestors.back().create_child();
+    set_tags(child, names);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateChildSpan)->ArgsProduct({{0, 4, 16}, {0, 4, 16}});
+
+// Create a trace of the specified number of spans, each having the specified
+// number of tags, and keep all of its spans in flight until the trace is
+// finished outside of the measurement.  If allocations are counted (see
+// `allocation_counter.h`), report "bytes_per_span", the heap memory allocated
+// per in-flight span, which includes the span's `SpanData` and its share of
+// the trace segment.
+void BM_InFlightSpanMemory(benchmark::State& state) {
+  const auto span_count = static_cast<std::size_t>(state.range(0));
+  const auto names = tag_names(state.range(1));
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  std::vector<dd::Span> spans;
+  spans.reserve(span_count);
+  std::uint64_t bytes = 0;
+  for (auto _ : state) {
+    const auto before = benchmark_allocations::this_thread_totals();
+    spans.push_back(tracer.create_span());
+    set_tags(spans.back(), names);
+    while (spans.size() < span_count) {
+      spans.push_back(spans.front().create_child());
+      set_tags(spans.back(), names);
+    }
+    bytes += benchmark_allocations::this_thread_totals().bytes - before.bytes;
+    state.PauseTiming();
+    while (!spans.empty()) {
+      spans.pop_back();
+    }
+    state.ResumeTiming();
+  }
+  if (benchmark_allocations::enabled()) {
+    state.counters["bytes_per_span"] =
+        double(bytes) / double(state.iterations() * span_count);
+  }
+  state.SetItemsProcessed(state.iterations() * span_count);
+}
+BENCHMARK(BM_InFlightSpanMemory)->ArgsProduct({{16, 256}, {0, 4}});
+
+// Set the specified number of tags on one span, replacing their values every
+// iteration.
+void BM_SetTag(benchmark::State& state) {
+  const auto names = tag_names(state.range(0));
+  const std::vector<std::string> values{"first value", "second value"};
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  auto span = tracer.create_span();
+  std::size_t iteration = 0;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    const auto& value = values[iteration++ % values.size()];
+    for (const auto& name : names) {
+      span.set_tag(name, value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_SetTag)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+// Set the specified number of metrics on one span, replacing their values
+// every iteration.
+void BM_SetMetric(benchmark::State& state) {
+  const auto names = tag_names(state.range(0));
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  auto span = tracer.create_span();
+  double value = 0;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    value += 1;
+    for (const auto& name : names) {
+      span.set_metric(name, value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_SetMetric)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+// Create a child span and set the tags that an HTTP client integration
+// typically sets, one at a time with `set_tag` (argument 0), all at once
+// with `set_tags` (argument 1), or with a `SchemaTags<HttpClientSchema>` for
+// the tags that the schema has and `set_tags` for the others (argument 2).
+// The trace is finished, outside of the measurement, every
+// `children_per_trace` children.
+void BM_SetIntegrationTags(benchmark::State& state) {
+  const auto method = state.range(0);
+  const auto config = dd::finalize_config(tracer_config());
+  dd::Tracer tracer{*config};
+  std::vector<dd::Span> roots;
+  int children = 0;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    if (children++ % children_per_trace == 0) {
+      state.PauseTiming();
+      allocations.pause();
+      roots.clear();
+      roots.push_back(tracer.create_span());
+      allocations.resume();
+      state.ResumeTiming();
+    }
+    auto span = roots.front().create_child();
+    if (method == 2) {
+      dd::SchemaTags<dd::HttpClientSchema> tags;
+      tags.set<dd::HttpClientSchema::COMPONENT>("curl");
+      tags.set<dd::HttpClientSchema::SPAN_KIND>("client");
+      tags.set<dd::HttpClientSchema::METHOD>("GET");
+      tags.set<dd::HttpClientSchema::URL>(
+          "https://example.com/api/v1/users/42");
+      tags.set<dd::HttpClientSchema::STATUS_CODE>(200);
+      tags.set<dd::HttpClientSchema::HOST>("example.com");
+      tags.set<dd::HttpClientSchema::PORT>(443);
+      span.set_tags(tags);
+      span.set_tags({{"peer.hostname", "example.com"},
+                     {"peer.service", "users-api"},
+                     {"http.useragent", "curl/8.5.0"},
+                     {"http.request.content_length", "0"},
+                     {"language", "cpp"}});
+    } else if (method == 1) {
+      span.set_tags({{"component", "curl"},
+                     {"span.kind", "client"},
+                     {"http.method", "GET"},
+                     {"http.url", "https://example.com/api/v1/users/42"},
+                     {"http.status_code", "200"},
+                     {"peer.hostname", "example.com"},
+                     {"peer.service", "users-api"},
+                     {"network.destination.port", "443"},
+                     {"http.useragent", "curl/8.5.0"},
+                     {"http.request.content_length", "0"},
+                     {"out.host", "example.com"},
+                     {"language", "cpp"}});
+    } else {
+      span.set_tag("component", "curl");
+      span.set_tag("span.kind", "client");
+      span.set_tag("http.method", "GET");
+      span.set_tag("http.url", "https://example.com/api/v1/users/42");
+      span.set_tag("http.status_code", "200");
+      span.set_tag("peer.hostname", "example.com");
+      span.set_tag("peer.service", "users-api");
+      span.set_tag("network.destination.port", "443");
+      span.set_tag("http.useragent", "curl/8.5.0");
+      span.set_tag("http.request.content_length", "0");
+      span.set_tag("out.host", "example.com");
+      span.set_tag("language", "cpp");
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetIntegrationTags)->Arg(0)->Arg(1)->Arg(2);
+
+// Finish a trace that is a root span with a chain of the specified number of
+// descendants, each having the specified number of tags.  The trace sampler
+// has a sampling rule, so that finishing the trace makes a rule-based
+// sampling decision.  The trace is created outside of the measurement.
+void BM_FinishTrace(benchmark::State& state) {
+  const auto depth = state.range(0);
+  const auto names = tag_names(state.range(1));
+  auto tracer_config = benchmark_fixture::tracer_config();
+  tracer_config.trace_sampler.sample_rate = 0.5;
+  const auto config = dd::finalize_config(tracer_config);
+  dd::Tracer tracer{*config};
+  std::vector<dd::Span> spans;
+  AllocationCounter allocations{state};
+  for (auto _ : state) {
+    state.PauseTiming();
+    allocations.pause();
+    spans.push_back(tracer.create_span());
+    set_tags(spans.back(), names);
+    for (int i = 0; i < depth; ++i) {
+      spans.push_back(spans.back().create_child());
+      set_tags(spans.back(), names);
+    }
+    allocations.resume();
+    state.ResumeTiming();
+    // Finish the spans from the deepest to the root.
+    while (!spans.empty()) {
+      spans.pop_back();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * (depth + 1));
+}
+BENCHMARK(BM_FinishTrace)->ArgsProduct({{0, 4, 16, 64}, {0, 4, 16}});
+
+}  // namespace
@@ -0,0 +1,163 @@
+// These benchmarks measure how long it takes to start tracing, as a server
+// does whenever it creates a tracer, e.g. each nginx worker after every
+// configuration reload.  `BM_TimeToFirstSpan` measures all of it, and the
+// others measure its parts: finalizing the configuration, with and without
+// configuration from the environment, looking up the container ID,
+// constructing the event scheduler and HTTP client that a `DatadogAgent`
+// uses, and constructing a `Tracer`.
+//
+// Destroying what is constructed is excluded from the measurements.  Some
+// work is done once per process, and so is measured only by the first
+// iteration: initializing telemetry, and discovering the facts of
+// `process_info.h`.
+
+#include <benchmark/benchmark.h>
+#include <datadog/clock.h>
+#include <datadog/curl.h>
+#include <datadog/platform_util.h>
+#include <datadog/threaded_event_scheduler.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fixture.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+using namespace benchmark_fixture;
+
+// `Environment` sets environment variables such as those of a typical
+// deployment, and restores them when it is destroyed.
+class Environment {
+  std::vector<std::pair<std::string, std::string>> saved_;
+  std::vector<std::string> unset_;
+
+ public:
+  Environment() {
+    set("DD_ENV", "prod");
+    set("DD_VERSION", "1.2.3");
+    set("DD_TAGS", "team:apm,region:us-east-1,cluster:main");
+    set("DD_TRACE_PROPAGATION_STYLE", "datadog,tracecontext,baggage");
+    set("DD_TRACE_SAMPLING_RULES",
+        R"([{"service": "web", "name": "http.request", "sample_rate": 0.5},)"
+        R"( {"service": "db", "sample_rate": 0.1},)"
+        R"( {"resource": "GET /health*", "sample_rate": 0}])");
+    set("DD_SPAN_SAMPLING_RULES",
+        R"([{"service": "web", "name": "cache.*", "max_per_second": 100}])");
+  }
+
+  ~Environment() {
+    for (const auto& [name, value] : saved_) {
+      ::setenv(name.c_str(), value.c_str(), 1);
+    }
+    for (const auto& name : unset_) {
+      ::unsetenv(name.c_str());
+    }
+  }
+
+  void set(const char* name, const char* value) {
+    if (const char* previous = std::getenv(name)) {
+      saved_.emplace_back(name, previous);
+    } else {
+      unset_.emplace_back(name);
+    }
+    ::setenv(name, value, 1);
+  }
+};
+
+// Finalize a tracer configuration.  If the argument is 1, the configuration
+// includes environment variables, including sampling rules, which are JSON.
+void BM_FinalizeConfig(benchmark::State& state) {
+  std::unique_ptr<Environment> environment;
+  if (state.range(0)) {
+    environment = std::make_unique<Environment>();
+  }
+  const auto config = tracer_config();
+  for (auto _ : state) {
+    auto finalized = dd::finalize_config(config);
+    benchmark::DoNotOptimize(finalized);
+  }
+}
+BENCHMARK(BM_FinalizeConfig)->Arg(0)->Arg(1);
+
+// Look up the ID of the container, if any, that the process runs in.
+void BM_ContainerIDLookup(benchmark::State& state) {
+  for (auto _ : state) {
+    auto id = dd::container::get_id();
+    benchmark::DoNotOptimize(id);
+  }
+}
+BENCHMARK(BM_ContainerIDLookup);
+
+void BM_ConstructEventScheduler(benchmark::State& state) {
+  for (auto _ : state) {
+    auto scheduler = std::make_unique<dd::ThreadedEventScheduler>();
+    state.PauseTiming();
+    scheduler.reset();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_ConstructEventScheduler);
+
+void BM_ConstructCurl(benchmark::State& state) {
+  const auto logger = std::make_shared<NullLogger>();
+  for (auto _ : state) {
+    auto curl = std::make_unique<dd::Curl>(logger, dd::default_clock);
+    state.PauseTiming();
+    curl.reset();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_ConstructCurl);
+
+// Construct a tracer from a finalized configuration.  If the argument is 0,
+// the tracer sends traces to a `NullCollector`.  If it is 1, the tracer sends
+// them with a `DatadogAgent`, which creates a `Curl` and a
+// `ThreadedEventScheduler`, to an address where nothing listens.
+void BM_ConstructTracer(benchmark::State& state) {
+  auto config = tracer_config();
+  if (state.range(0)) {
+    config.collector = nullptr;
+    config.agent.http_client = nullptr;
+    config.agent.event_scheduler = nullptr;
+    config.agent.url = "http://127.0.0.1:9";
+    config.agent.remote_configuration_enabled = false;
+  }
+  const auto finalized = dd::finalize_config(config);
+  for (auto _ : state) {
+    auto tracer = std::make_unique<dd::Tracer>(*finalized);
+    state.PauseTiming();
+    tracer.reset();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_ConstructTracer)->Arg(0)->Arg(1);
+
+// Finalize a configuration that includes environment variables, construct a
+// tracer that sends traces with a `DatadogAgent`, and create a span.
+void BM_TimeToFirstSpan(benchmark::State& state) {
+  const Environment environment;
+  auto config = tracer_config();
+  config.collector = nullptr;
+  config.agent.http_client = nullptr;
+  config.agent.event_scheduler = nullptr;
+  config.agent.url = "http://127.0.0.1:9";
+  config.agent.remote_configuration_enabled = false;
+  for (auto _ : state) {
+    auto tracer = std::make_unique<dd::Tracer>(*dd::finalize_config(config));
+    auto span = std::make_unique<dd::Span>(tracer->create_span());
+    state.PauseTiming();
+    span.reset();
+    tracer.reset();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_TimeToFirstSpan);
+
+}  // namespace
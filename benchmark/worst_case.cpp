@@ -0,0 +1,191 @@
+// These benchmarks measure the parsers and matchers that consume input that
+// a client of the traced service controls: the "tracestate", "x-datadog-tags",
+// and "baggage" request headers, the URL paths from which `http.endpoint` is
+// inferred, and the span names matched against sampling rules' glob patterns.
+//
+// Each is given a pathological input, of a shape chosen to make it do the
+// most work per byte, whose size is the benchmark's argument.  Google
+// Benchmark fits the measurements to a complexity (the "BigO" rows of the
+// output), so that a parser that is not linear in the size of its input is
+// noticed, and so that the time per call for the largest input that a
+// service accepts can be read from the table.
+
+#include <benchmark/benchmark.h>
+#include <datadog/baggage.h>
+#include <datadog/dict_reader.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "endpoint_inferral.h"
+#include "extracted_data.h"
+#include "glob.h"
+#include "tag_propagation.h"
+#include "w3c_propagation.h"
+
+namespace {
+
+namespace dd = datadog::tracing;
+
+// `OneHeader` is a `DictReader` that has only the specified header.
+class OneHeader : public dd::DictReader {
+  std::string name_;
+  std::string value_;
+
+ public:
+  OneHeader(std::string name, std::string value)
+      : name_(std::move(name)), value_(std::move(value)) {}
+
+  dd::Optional<dd::StringView> lookup(dd::StringView key) const override {
+    if (key == name_) {
+      return dd::StringView(value_);
+    }
+    return dd::nullopt;
+  }
+
+  void visit(const std::function<void(dd::StringView, dd::StringView)>&
+                 visitor) const override {
+    visitor(name_, value_);
+  }
+};
+
+// Return the concatenation of `make(0)`, `make(1)`, ..., separated by the
+// specified `separator`, stopping before it would exceed the specified
+// `size`.
+template <typename Make>
+std::string repeat_to_size(std::size_t size, char separator, Make&& make) {
+  std::string result;
+  for (int i = 0;; ++i) {
+    const std::string part = make(i);
+    if (result.size() + 1 + part.size() > size) {
+      return result;
+    }
+    if (!result.empty()) {
+      result += separator;
+    }
+    result += part;
+  }
+}
+
+// A "tracestate" whose "dd" entry has many propagated tags, and that has many
+// other vendors' entries, which are kept for injection.
+void BM_WorstCaseTracestate(benchmark::State& state) {
+  const std::size_t size = state.range(0);
+  std::string tracestate = "dd=s:2;o:rum;p:00f067aa0ba902b7";
+  tracestate += repeat_to_size(size / 2, ';', [](int i) {
+    return "t.k" + std::to_string(i) + ":~v";
+  });
+  tracestate += ',';
+  tracestate += repeat_to_size(size - tracestate.size(), ',', [](int i) {
+    return "v" + std::to_string(i) + "@x=y";
+  });
+  for (auto _ : state) {
+    dd::ExtractedData data;
+    dd::parse_tracestate(data, tracestate);
+    benchmark::DoNotOptimize(data);
+  }
+  state.SetBytesProcessed(state.iterations() * tracestate.size());
+  state.SetComplexityN(tracestate.size());
+}
+BENCHMARK(BM_WorstCaseTracestate)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+// An "x-datadog-tags" of the shortest tags, half of which are propagated.
+void BM_WorstCaseTraceTags(benchmark::State& state) {
+  const std::string header =
+      repeat_to_size(state.range(0), ',', [](int i) {
+        return i % 2 ? "_dd.p." + std::to_string(i) + "=v"
+                     : std::to_string(i) + "=v";
+      });
+  std::vector<std::pair<dd::StringView, dd::StringView>> decoded;
+  for (auto _ : state) {
+    decoded.clear();
+    auto result = dd::decode_tags(header, "_dd.p.", decoded);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * header.size());
+  state.SetComplexityN(header.size());
+}
+BENCHMARK(BM_WorstCaseTraceTags)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+// A "baggage" of the shortest items, each of which has a distinct key, so
+// that every item is kept.
+void BM_WorstCaseBaggage(benchmark::State& state) {
+  const OneHeader headers{"baggage",
+                          repeat_to_size(state.range(0), ',', [](int i) {
+                            return std::to_string(i) + "=%20";
+                          })};
+  const std::size_t size = headers.lookup("baggage")->size();
+  for (auto _ : state) {
+    auto baggage = dd::Baggage::extract(headers);
+    benchmark::DoNotOptimize(baggage);
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+  state.SetComplexityN(size);
+}
+BENCHMARK(BM_WorstCaseBaggage)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+// A URL path of many short segments, each of which looks like a parameter
+// until its last character.
+void BM_WorstCaseInferEndpoint(benchmark::State& state) {
+  const std::string path =
+      "/" + repeat_to_size(state.range(0) - 1, '/', [](int i) {
+        return std::to_string(i) + "0a1b2c3d4e5f6-";
+      });
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dd::infer_endpoint(path));
+  }
+  state.SetBytesProcessed(state.iterations() * path.size());
+  state.SetComplexityN(path.size());
+}
+BENCHMARK(BM_WorstCaseInferEndpoint)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+// A pattern that is a run of one character between wildcards, and a subject
+// that is a longer run of that character, so that the matcher compares the
+// whole run at every position of the subject before it gives up.  The
+// pattern grows with the subject, as a sampling rule from Remote
+// Configuration can.
+std::pair<std::string, std::string> glob_input(std::size_t size) {
+  return {"*" + std::string(size / 8, 'a') + "b*", std::string(size, 'a')};
+}
+
+void BM_WorstCaseGlobMatch(benchmark::State& state) {
+  const auto [pattern, subject] = glob_input(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dd::glob_match(pattern, subject));
+  }
+  state.SetComplexityN(subject.size());
+}
+BENCHMARK(BM_WorstCaseGlobMatch)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+void BM_WorstCaseGlobPattern(benchmark::State& state) {
+  const auto [pattern, subject] = glob_input(state.range(0));
+  const dd::GlobPattern compiled{pattern};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(compiled.match(subject));
+  }
+  state.SetComplexityN(subject.size());
+}
+BENCHMARK(BM_WorstCaseGlobPattern)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->Complexity();
+
+}  // namespace
@@ -2,10 +2,23 @@
 #include <datadog/string_view.h>
 
 #include <cstdint>
+#include <cstdlib>
+#include <string>
 
 namespace dd = datadog::tracing;
 
+// Decode the input with both the vector and the portable implementations, and
+// abort if they disagree.
 extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size) {
-  dd::base64_decode(dd::StringView{(const char*)data, size});
+  const dd::StringView input{(const char*)data, size};
+  std::string decoded;
+  std::string decoded_portable;
+  const bool valid = dd::base64_decode(decoded, input);
+  const bool valid_portable =
+      dd::detail::base64_decode_portable(decoded_portable, input);
+  if (valid != valid_portable || decoded != decoded_portable ||
+      decoded != dd::base64_decode(input)) {
+    std::abort();
+  }
   return 0;
 }
@@ -0,0 +1,179 @@
+// This fuzzer checks that `parse_tracestate` produces the same `ExtractedData`
+// as the implementation that it replaced, which copied each piece of the
+// tracestate into a `std::string` as it went.  The replaced implementation is
+// kept below as `reference::parse_tracestate`.
+
+#include <datadog/extracted_data.h>
+#include <datadog/optional.h>
+#include <datadog/parse_util.h>
+#include <datadog/string_util.h>
+#include <datadog/string_view.h>
+#include <datadog/tags.h>
+#include <datadog/trace_source.h>
+#include <datadog/w3c_propagation.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace dd = datadog::tracing;
+
+namespace reference {
+
+using dd::append;
+using dd::ExtractedData;
+using dd::nullopt;
+using dd::Optional;
+using dd::StringView;
+
+struct PartiallyParsedTracestate {
+  StringView datadog_value;
+  std::string other_entries;
+};
+
+Optional<PartiallyParsedTracestate> parse_tracestate(StringView tracestate) {
+  const std::size_t begin = 0;
+  const std::size_t end = tracestate.size();
+  std::size_t pair_begin = begin;
+  while (pair_begin < end) {
+    const std::size_t pair_end = tracestate.find(',', pair_begin);
+    const auto pair =
+        dd::trim(tracestate.substr(pair_begin, pair_end - pair_begin));
+    if (pair.empty()) {
+      pair_begin = (pair_end == StringView::npos) ? end : pair_end + 1;
+      continue;
+    }
+
+    const auto kv_separator = pair.find('=');
+    if (kv_separator == StringView::npos) {
+      pair_begin = (pair_end == StringView::npos) ? end : pair_end + 1;
+      continue;
+    }
+
+    const auto key = pair.substr(0, kv_separator);
+    if (key != "dd") {
+      pair_begin = (pair_end == StringView::npos) ? end : pair_end + 1;
+      continue;
+    }
+
+    PartiallyParsedTracestate result;
+    result.datadog_value = pair.substr(kv_separator + 1);
+    if (pair_begin != 0) {
+      append(result.other_entries, tracestate.substr(0, pair_begin - 1));
+      if (pair_end != StringView::npos && pair_end + 1 < end) {
+        append(result.other_entries, tracestate.substr(pair_end));
+      }
+    } else if (pair_end != StringView::npos && pair_end + 1 < end) {
+      append(result.other_entries, tracestate.substr(pair_end + 1));
+    }
+
+    return result;
+  }
+
+  return nullopt;
+}
+
+void parse_datadog_tracestate(ExtractedData& result, StringView datadog_value) {
+  const std::size_t end = datadog_value.size();
+  std::size_t pair_begin = 0;
+  while (pair_begin < end) {
+    const std::size_t pair_end = datadog_value.find(';', pair_begin);
+    const auto pair = datadog_value.substr(pair_begin, pair_end - pair_begin);
+    pair_begin = (pair_end == StringView::npos) ? end : pair_end + 1;
+    if (pair.empty()) {
+      continue;
+    }
+
+    const auto kv_separator = pair.find(':');
+    if (kv_separator == StringView::npos) {
+      continue;
+    }
+
+    const auto key = pair.substr(0, kv_separator);
+    const auto value = pair.substr(kv_separator + 1);
+    if (key == "o") {
+      result.origin = std::string{value};
+      std::replace(result.origin->begin(), result.origin->end(), '~', '=');
+    } else if (key == "s") {
+      const auto maybe_priority = dd::parse_int(value, 10);
+      if (!maybe_priority) {
+        continue;
+      }
+      const int priority = *maybe_priority;
+      if (!result.sampling_priority ||
+          (*result.sampling_priority > 0) == (priority > 0)) {
+        result.sampling_priority = priority;
+      }
+    } else if (key == "p") {
+      result.datadog_w3c_parent_id = std::string(value);
+    } else if (key == "ts") {
+      if (dd::validate_trace_source(value)) {
+        result.trace_tags.emplace_back(dd::tags::internal::trace_source,
+                                       value);
+      }
+    } else if (dd::starts_with(key, "t.")) {
+      const auto tag_suffix = key.substr(2);
+      std::string tag_name = "_dd.p.";
+      append(tag_name, tag_suffix);
+      std::string decoded_value{value};
+      std::replace(decoded_value.begin(), decoded_value.end(), '~', '=');
+      result.trace_tags.emplace_back(std::move(tag_name),
+                                     std::move(decoded_value));
+    } else {
+      auto& entries = result.additional_datadog_w3c_tracestate;
+      if (!entries) {
+        entries.emplace();
+      } else {
+        *entries += ';';
+      }
+      append(*entries, pair);
+    }
+  }
+}
+
+void extract_tracestate(ExtractedData& result, StringView tracestate) {
+  if (tracestate.empty()) {
+    return;
+  }
+
+  tracestate = dd::trim(tracestate);
+  auto maybe_parsed = parse_tracestate(tracestate);
+  if (!maybe_parsed) {
+    if (!tracestate.empty()) {
+      result.additional_w3c_tracestate = std::string{tracestate};
+    }
+    return;
+  }
+
+  auto& [datadog_value, other_entries] = *maybe_parsed;
+  if (!other_entries.empty()) {
+    result.additional_w3c_tracestate = std::move(other_entries);
+  }
+
+  parse_datadog_tracestate(result, datadog_value);
+}
+
+}  // namespace reference
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size) {
+  const dd::StringView tracestate{reinterpret_cast<const char*>(data), size};
+
+  dd::ExtractedData expected;
+  reference::extract_tracestate(expected, tracestate);
+  dd::ExtractedData actual;
+  dd::parse_tracestate(actual, tracestate);
+
+  if (actual.origin != expected.origin ||
+      actual.trace_tags != expected.trace_tags ||
+      actual.sampling_priority != expected.sampling_priority ||
+      actual.datadog_w3c_parent_id != expected.datadog_w3c_parent_id ||
+      actual.additional_datadog_w3c_tracestate !=
+          expected.additional_datadog_w3c_tracestate ||
+      actual.additional_w3c_tracestate != expected.additional_w3c_tracestate) {
+    std::abort();
+  }
+
+  return 0;
+}
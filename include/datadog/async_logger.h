@@ -0,0 +1,129 @@
+#pragma once
+
+// This component provides a class, `AsyncLogger`, that implements the `Logger`
+// interface from `logger.h`.  `AsyncLogger` formats each message on the thread
+// that logs it, and writes it later, on a background thread, either to
+// `std::cerr` or to another `Logger`.  Threads that log, such as a server's
+// request threads, thus never wait for the standard error file, which can be
+// slow to write when a misbehaving environment produces many errors.
+//
+// The messages are held in a bounded queue.  A message logged while the queue
+// is full is dropped, and the number of dropped messages is logged once there
+// is room again.  A message identical to the last message in the queue is not
+// queued again, but counted, and written once with its count.
+//
+// Messages are also rate limited by their site: the lambda passed to
+// `log_error` (as identified by its type), the code of an `Error`, or the
+// text of a `StringView`.  At most `AsyncLoggerOptions::max_messages_per_site`
+// messages from a site are logged per `AsyncLoggerOptions::rate_limit_period`.
+// After that, messages from the site are counted, rather than formatted, until
+// the period ends, and the next message from the site notes how many were
+// suppressed.  Startup messages are not rate limited.
+//
+// `AsyncLogger` is the recommended `Logger` for servers:
+//
+//     TracerConfig config;
+//     config.logger = std::make_shared<AsyncLogger>();
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "clock.h"
+#include "logger.h"
+
+namespace datadog {
+namespace tracing {
+
+struct AsyncLoggerOptions {
+  // The most messages that can wait to be written.
+  std::size_t max_queued_messages = 1000;
+  // The most messages logged from one site per `rate_limit_period`.
+  std::size_t max_messages_per_site = 10;
+  std::chrono::steady_clock::duration rate_limit_period =
+      std::chrono::seconds(60);
+  // Used to measure `rate_limit_period`.
+  Clock clock = default_clock;
+};
+
+class AsyncLogger : public Logger {
+  struct Message {
+    std::string text;
+    bool startup;
+    // The number of identical messages coalesced into this one.
+    std::size_t repeats;
+  };
+
+  // A site is identified by the `type_info` of a callback, `Error`, or
+  // `StringView`, together with an error code or the hash of a text.
+  using SiteKey = std::pair<const void*, std::size_t>;
+  struct Site {
+    std::chrono::steady_clock::time_point period_start;
+    std::size_t logged;
+    std::size_t suppressed;
+  };
+
+  const AsyncLoggerOptions options_;
+  const std::shared_ptr<Logger> destination_;
+
+  std::mutex mutex_;
+  // Notifies the background thread of new messages and of destruction.
+  std::condition_variable wake_;
+  // Notifies `flush` of written messages.
+  std::condition_variable written_;
+  // The following members are guarded by `mutex_`.
+  std::deque<Message> queue_;
+  std::map<SiteKey, Site> sites_;
+  std::size_t dropped_ = 0;
+  std::uint64_t queued_count_ = 0;
+  std::uint64_t written_count_ = 0;
+  bool shutting_down_ = false;
+
+  std::thread thread_;
+
+ public:
+  // Create a logger that writes to the specified `destination`, or to
+  // `std::cerr` if `destination` is null, on a background thread, as
+  // configured by the optionally specified `options`.
+  explicit AsyncLogger(std::shared_ptr<Logger> destination = nullptr,
+                       AsyncLoggerOptions options = AsyncLoggerOptions());
+  // Write the messages that are still queued, and then stop the background
+  // thread.
+  ~AsyncLogger() override;
+
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  void log_error(const LogFunc&) override;
+  void log_startup(const LogFunc&) override;
+  void log_error(const Error&) override;
+  void log_error(StringView) override;
+
+  // Wait until every message logged before this call has been written.
+  void flush();
+
+ private:
+  // Return whether a message from the specified `site` may be logged now.  If
+  // so, load into the specified `suppressed` the number of messages from
+  // `site` that were suppressed before it.  `mutex_` must be locked.
+  bool admit(const SiteKey& site, std::size_t& suppressed);
+  // Format a message from the specified `site` using the specified `write`,
+  // and queue it, unless the site is rate limited or the queue is full.
+  void log(const SiteKey& site, const LogFunc& write);
+  // Queue the specified `text` as a message, startup or otherwise as
+  // specified by `startup`, unless the queue is full.
+  void enqueue(std::string&& text, bool startup);
+  // Write queued messages until the logger is destroyed.
+  void run();
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,84 @@
+#pragma once
+
+// This component provides a class template, `AtomicSnapshot`, that publishes
+// an immutable value to concurrent readers, so that reading the current value
+// is wait-free.
+//
+// `AtomicSnapshot` serves the same purpose as the atomic access functions for
+// `shared_ptr` (`std::atomic_load` and `std::atomic_store`), or as C++20's
+// `std::atomic<std::shared_ptr<T>>`.  Common implementations of those take a
+// lock from a small, process-wide pool of locks, so that readers of unrelated
+// values can contend with each other.  `AtomicSnapshot::load` instead reads an
+// atomic pointer and copies the `shared_ptr` to which it points, which
+// increments a reference count without locking.
+//
+// This is possible because a replaced value is destroyed only once no reader
+// can still be copying it.  Readers announce themselves in one of two
+// counters, chosen by the parity of an epoch.  `store` publishes the new
+// value, and then, for each counter in turn, advances the epoch so that new
+// readers use the other counter, and waits until the counter drains.  A
+// reader that saw the replaced value was counted in one of the two, and has
+// since finished.  Readers are only ever delayed by the atomic increments, so
+// `load` remains wait-free, but `store` can wait for the readers in progress.
+// `AtomicSnapshot` is thus suited to values that are replaced rarely, such as
+// configuration that changes when a remote configuration update is received.
+// `store` locks a mutex, and so writers are serialized.
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace datadog {
+namespace tracing {
+
+template <typename T>
+class AtomicSnapshot {
+  std::mutex mutex_;
+  // The most recently stored value.  Owned by the snapshot.
+  std::atomic<const std::shared_ptr<T>*> current_;
+  // The number of readers in progress that chose each counter, by the parity
+  // of `epoch_`.
+  mutable std::atomic<unsigned> readers_[2] = {{0}, {0}};
+  // Advanced twice by each `store`.  Modified while `mutex_` is locked.
+  std::atomic<unsigned> epoch_{0};
+
+ public:
+  explicit AtomicSnapshot(std::shared_ptr<T> initial)
+      : current_(new const std::shared_ptr<T>(std::move(initial))) {}
+
+  ~AtomicSnapshot() { delete current_.load(); }
+
+  AtomicSnapshot(const AtomicSnapshot&) = delete;
+  AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+  // Return the most recently stored value.
+  std::shared_ptr<T> load() const {
+    std::atomic<unsigned>& readers = readers_[epoch_.load() % 2];
+    readers.fetch_add(1);
+    std::shared_ptr<T> result = *current_.load();
+    readers.fetch_sub(1, std::memory_order_release);
+    return result;
+  }
+
+  // Replace the current value with the specified `value`, and destroy the
+  // snapshot's copy of the replaced value once no reader is copying it.
+  void store(std::shared_ptr<T> value) {
+    auto next = std::make_unique<const std::shared_ptr<T>>(std::move(value));
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<const std::shared_ptr<T>> previous{
+        current_.exchange(next.release())};
+    for (int i = 0; i < 2; ++i) {
+      std::atomic<unsigned>& readers = readers_[epoch_.fetch_add(1) % 2];
+      // Sequentially consistent, as are the readers' increments, so that a
+      // reader that this load does not count sees the new value.
+      while (readers.load() != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -6,8 +6,11 @@
 #include <datadog/optional.h>
 #include <datadog/string_view.h>
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace datadog {
 namespace tracing {
@@ -21,6 +24,11 @@ namespace tracing {
 ///
 /// Baggages are injected to any tracing context implementing the `DictWriter`
 /// interface using the `inject` method.
+///
+/// The keys and values of all items are stored in one buffer. An extracted
+/// Baggage keeps the "baggage" header value as that buffer, so extraction
+/// copies no individual item, and if the Baggage is not modified, then
+/// `inject` writes the header value as it was extracted.
 class Baggage {
  public:
   struct Error final {
@@ -125,7 +133,8 @@ class Baggage {
 
   /// Injects the Baggage data into a `DictWriter` with the constraint that
   /// the amount of bytes written does not exceed the specified maximum byte
-  /// limit.
+  /// limit. Items are written in order until one does not fit. Characters
+  /// that are not allowed in a baggage key or value are percent-encoded.
   ///
   /// @param `writer` The DictWriter to inject the data into.
   /// @param `opts` Injection options.
@@ -134,14 +143,40 @@ class Baggage {
   Expected<void> inject(DictWriter& writer,
                         const Options& opts = default_options) const;
 
-  /// Equality operator for comparing two Baggage instances.
-  inline bool operator==(const Baggage& rhs) const {
-    return baggage_ == rhs.baggage_;
-  }
+  /// Returns the number of bytes that `inject` would write if there were no
+  /// limits.
+  size_t encoded_size() const;
+
+  /// Equality operator for comparing two Baggage instances. Two Baggage
+  /// instances are equal if they have the same key-value pairs.
+  bool operator==(const Baggage& rhs) const;
 
  private:
+  /// The positions of an item's key and value within `buffer_`.
+  struct Item final {
+    size_t key_begin;
+    size_t key_size;
+    size_t value_begin;
+    size_t value_size;
+  };
+
+  StringView key(const Item&) const;
+  StringView value(const Item&) const;
+  const Item* find(StringView key) const;
+  /// Appends the specified `text` to `buffer_` and returns its position.
+  size_t store(StringView text);
+  /// Records that the specified number of `bytes` of `buffer_` are no longer
+  /// referred to by any item, and rebuilds `buffer_` if most of it is not.
+  void discard(size_t bytes);
+
   const size_t max_capacity_ = Baggage::default_max_capacity;
-  std::unordered_map<std::string, std::string> baggage_;
+  std::string buffer_;
+  std::vector<Item> items_;
+  /// The number of bytes of `buffer_` not referred to by any item.
+  size_t unused_bytes_ = 0;
+  /// Whether `buffer_` is a "baggage" header value describing exactly
+  /// `items_`, so that it can be injected as is.
+  bool is_header_ = false;
 };
 
 }  // namespace tracing
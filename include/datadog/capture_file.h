@@ -0,0 +1,96 @@
+#pragma once
+
+// This component provides a class, `CaptureFile`, that is an append-only log
+// of trace payloads in a memory-mapped file.
+//
+// A `RecordingCollector` (see `recording_collector_config.h`) appends each
+// payload that it would have sent to a Datadog Agent to a `CaptureFile`,
+// together with the number of traces in the payload and when, relative to the
+// beginning of the capture, the payload was flushed.  The replay tool in
+// `test/replay/` then reads the file and sends the payloads to a real agent
+// at the pace at which they were recorded, or faster, so that production load
+// can be reproduced in the lab.
+//
+// The file's size is fixed when it is created.  Records that do not fit in
+// the room that remains are dropped, and counted, rather than replacing
+// earlier records, so that a capture is always a contiguous prefix of what was
+// recorded.  A record becomes visible to readers only once it is completely
+// written, so a capture can be read while it is still being recorded.
+//
+// `CaptureFile` is not available on Windows.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "expected.h"
+#include "string_view.h"
+
+namespace datadog {
+namespace tracing {
+
+class CaptureFile {
+  struct Header;
+  Header* header_;
+  std::size_t mapped_size_;
+  // Serializes the appends of this process.
+  std::mutex mutex_;
+
+  CaptureFile(Header* header, std::size_t mapped_size);
+
+ public:
+  struct Record {
+    // When the payload was recorded, relative to the beginning of the capture.
+    std::chrono::nanoseconds offset;
+    // The number of traces in the payload, as sent in the
+    // "X-Datadog-Trace-Count" request header.
+    std::size_t trace_count;
+    // The payload, which refers to the file's memory and is valid for as long
+    // as the `CaptureFile` is.
+    StringView payload;
+  };
+
+  // Return an empty capture in the file at the specified `path`, which can
+  // hold the specified `capacity` bytes of records, or return an error if the
+  // file cannot be mapped.  The file is created if it does not exist, and its
+  // previous contents are discarded if it does.
+  static Expected<std::shared_ptr<CaptureFile>> create(const std::string& path,
+                                                       std::size_t capacity);
+
+  // Return the capture in the existing file at the specified `path`, or return
+  // an error if the file cannot be mapped or was not created by `create`.
+  static Expected<std::shared_ptr<CaptureFile>> open(const std::string& path);
+
+  ~CaptureFile();
+
+  CaptureFile(const CaptureFile&) = delete;
+  CaptureFile& operator=(const CaptureFile&) = delete;
+
+  // Append a record of the payload that is the concatenation of the specified
+  // `payload` parts, which contains the specified `trace_count` traces and was
+  // recorded at the specified `offset`.  Return false if the record does not
+  // fit in the room that remains, in which case it is dropped.
+  bool append(std::chrono::nanoseconds offset, std::size_t trace_count,
+              std::initializer_list<StringView> payload);
+
+  // Assign to the specified `record` the record at the specified `position`,
+  // and advance `position` to the record after it.  Return false if there is
+  // no record at `position`.  The first record is at position zero.
+  bool next(std::uint64_t& position, Record& record) const;
+
+  // Return the number of records in the file.
+  std::uint64_t size() const;
+
+  // Return the number of bytes of records that the file can hold.
+  std::size_t capacity() const;
+
+  // Return the number of records that were dropped because they did not fit.
+  std::uint64_t dropped() const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
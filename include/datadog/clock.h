@@ -18,6 +18,14 @@
 // `Clock` is an alias for `std::function<TimePoint()>`, and the default
 // `Clock`, `default_clock`, gives a `TimePoint` using the
 // `std::chrono::system_clock` and `std::chrono::steady_clock`.
+//
+// `calibrated_clock` is a `Clock` that reads only the steady clock, and that
+// derives the wall time from the steady time plus a per-process offset.  The
+// offset is measured again once every `calibrated_clock_period` of steady
+// time, so that the wall time follows adjustments made to the system clock
+// within that period.  It suits platforms where reading a clock is expensive,
+// e.g. virtual machines where `clock_gettime` is not served by the vDSO, at
+// the expense of span start times lagging behind system clock adjustments.
 
 #include <chrono>
 #include <functional>
@@ -56,5 +64,9 @@ using Clock = std::function<TimePoint()>;
 
 extern const Clock default_clock;
 
+constexpr std::chrono::seconds calibrated_clock_period{1};
+
+extern const Clock calibrated_clock;
+
 }  // namespace tracing
 }  // namespace datadog
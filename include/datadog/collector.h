@@ -9,11 +9,22 @@
 // As a result of `send`ing spans to a `Collector`, the `TraceSampler` might be
 // adjusted to increase or decrease the rate at which traces are kept.  See the
 // `response_handler` parameter to `Collector::send`.
+//
+// The spans are sent as a `TraceChunk`, which also holds what the spans have
+// in common, such as the trace's sampling priority, so that a collector need
+// not look it up in the tags of the spans.  `TraceSegment` calls
+// `send_chunk`, which by default calls `send` with only the spans, so that
+// collectors that need only the spans can implement just `send`.
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "expected.h"
+#include "optional.h"
+#include "runtime_stats.h"
 
 namespace datadog {
 namespace tracing {
@@ -21,6 +32,28 @@ namespace tracing {
 struct SpanData;
 class TraceSampler;
 
+struct TraceChunk {
+  // The spans of the chunk, the first of which is the local root of the trace
+  // segment if the whole segment is sent at once.  The chunk's properties
+  // below are also among the tags of the first span, where the Datadog Agent
+  // expects them.
+  std::vector<std::unique_ptr<SpanData>> spans;
+  // The sampling priority of the trace (see `sampling_priority.h`), if known.
+  Optional<int> sampling_priority;
+  // The origin of the trace, such as "synthetics", if any.
+  Optional<std::string> origin;
+  // The name of the host on which the tracer runs, if it is reported.
+  Optional<std::string> hostname;
+  // The MessagePack encoding of `spans` as an array, as accepted by the
+  // Datadog Agent's "/v0.4/traces" endpoint, if the chunk's producer already
+  // encoded it, or otherwise empty.  `spans` is present either way.
+  std::string encoded;
+  // When the last of `spans` finished, by the tracer's clock, or the default
+  // value if unknown.  Collectors measure from it how long the chunk takes to
+  // be delivered.
+  std::chrono::steady_clock::time_point finished;
+};
+
 class Collector {
  public:
   // Submit ownership of the specified `spans` to the collector.  If the
@@ -31,6 +64,12 @@ class Collector {
       std::vector<std::unique_ptr<SpanData>>&& spans,
       const std::shared_ptr<TraceSampler>& response_handler) = 0;
 
+  // Submit ownership of the specified `chunk` to the collector, as `send` does
+  // for its spans.  The default implementation sends only `chunk.spans`.
+  virtual Expected<void> send_chunk(
+      TraceChunk&& chunk,
+      const std::shared_ptr<TraceSampler>& response_handler);
+
   // Return a JSON representation of this object's configuration. The JSON
   // representation is an object with the following properties:
   //
@@ -40,6 +79,35 @@ class Collector {
   //   may be omitted if the derived class has no configuration.
   virtual std::string config() const = 0;
 
+  // Return whether the spans sent to this collector may omit the tags that
+  // every span of a trace segment has in common, such as "language" and
+  // "runtime-id", and instead refer to them through `SpanData::shared_tags`.
+  // If not, then those tags are copied into each span's `tags` and
+  // `numeric_tags`, and `SpanData::shared_tags` is null.  The default
+  // implementation returns `false`.
+  virtual bool accepts_shared_tags() const { return false; }
+
+  // Add this collector's buffered trace chunks, in-flight requests, and
+  // dropped trace chunks to the specified `stats`.  The default implementation
+  // does nothing.
+  virtual void add_runtime_stats(RuntimeStats&) const {}
+
+  // Allocate ahead of time what this collector would otherwise allocate while
+  // sending the first trace chunks, for traces having about the specified
+  // `expected_spans_per_trace` sent from as many as the specified
+  // `expected_concurrency` threads at once (see `Tracer::warm_up`).  The
+  // default implementation does nothing.
+  virtual void warm_up(std::size_t /*expected_spans_per_trace*/,
+                       std::size_t /*expected_concurrency*/) {}
+
+  // Send what this collector has buffered, and wait for its requests in
+  // flight to finish, but no longer than the specified `deadline`.  After
+  // this, the collector's destructor does not wait, and trace chunks sent to
+  // the collector are not delivered.  This function may be called from any
+  // thread, and more than once; only the first call has an effect.  The
+  // default implementation does nothing (see `Tracer::shutdown_async`).
+  virtual void shut_down(std::chrono::steady_clock::time_point /*deadline*/) {}
+
   virtual ~Collector() {}
 };
 
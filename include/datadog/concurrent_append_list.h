@@ -0,0 +1,181 @@
+#pragma once
+
+// This component provides a class template, `ConcurrentAppendList`, that is a
+// sequence container to which elements can be appended concurrently without
+// locking.
+//
+// `ConcurrentAppendList` is an implementation detail of `TraceSegment`, which
+// uses it to hold the data of the spans in a trace segment.  Spans of a trace
+// can be created on many threads at once, and `ConcurrentAppendList` allows
+// them to be registered with their segment without contending for a mutex.
+//
+// The elements are stored in a sequence of segments, where each segment is
+// twice the size of the previous one.  The first segment is stored inline, so
+// that a small list does not allocate.  Later segments are allocated as
+// needed, and are never moved, so appending never invalidates references to
+// existing elements.
+//
+// Appending is thread-safe.  Accessing an element is thread-safe only if the
+// access happens after the element was appended (e.g. because the same thread
+// appended it, or because some other synchronization orders the two), except
+// by `find_appended`, which skips the elements whose appending is still in
+// progress.  `take` is not thread-safe.
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+template <typename T, std::size_t first_segment_size = 8>
+class ConcurrentAppendList {
+  static_assert(first_segment_size > 0 &&
+                    (first_segment_size & (first_segment_size - 1)) == 0,
+                "first_segment_size must be a power of two");
+
+  // Segment `k` has `first_segment_size << k` elements, so this many segments
+  // are enough for any index representable as `std::size_t`.
+  static constexpr std::size_t max_segments = sizeof(std::size_t) * 8;
+
+  // Each element is stored together with whether its appending completed.
+  struct Slot {
+    T value;
+    std::atomic<bool> appended{false};
+  };
+
+  std::atomic<std::size_t> size_;
+  Slot first_segment_[first_segment_size];
+  std::atomic<Slot*> segments_[max_segments];
+
+ public:
+  ConcurrentAppendList() : size_(0) {
+    segments_[0].store(first_segment_, std::memory_order_relaxed);
+    for (std::size_t i = 1; i < max_segments; ++i) {
+      segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentAppendList(const ConcurrentAppendList&) = delete;
+  ConcurrentAppendList& operator=(const ConcurrentAppendList&) = delete;
+
+  ~ConcurrentAppendList() {
+    for (std::size_t i = 1; i < max_segments; ++i) {
+      delete[] segments_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  // Append the specified `value` to this list and return its index.
+  std::size_t push_back(T value) {
+    const std::size_t index = size_.fetch_add(1, std::memory_order_relaxed);
+    Slot& destination = slot(index, true);
+    destination.value = std::move(value);
+    destination.appended.store(true, std::memory_order_release);
+    return index;
+  }
+
+  // Append the specified `count` elements beginning at the specified `values`,
+  // moving them, and return the index of the first.  The elements have
+  // consecutive indices, which are reserved at once.
+  std::size_t push_back(T* values, std::size_t count) {
+    const std::size_t first = size_.fetch_add(count, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < count; ++i) {
+      Slot& destination = slot(first + i, true);
+      destination.value = std::move(values[i]);
+      destination.appended.store(true, std::memory_order_release);
+    }
+    return first;
+  }
+
+  // Return the number of elements that have been appended to this list,
+  // including any whose appending is still in progress.
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  bool empty() const { return size() == 0; }
+
+  // Return a reference to the element at the specified `index`.  The behavior
+  // is undefined unless the element's appending happened before this call.
+  T& operator[](std::size_t index) { return slot(index, false).value; }
+  const T& operator[](std::size_t index) const {
+    return const_cast<ConcurrentAppendList&>(*this).slot(index, false).value;
+  }
+
+  // Return a pointer to the element at the specified `index`, or null if the
+  // element's appending has not completed.  Unlike `operator[]`, this can be
+  // called concurrently with appending, for any `index` less than `size()`.
+  T* find_appended(std::size_t index) {
+    Slot* const found = find_slot(index);
+    if (!found || !found->appended.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &found->value;
+  }
+
+  // Move every element of this list into the returned vector, in the order in
+  // which they were appended, and leave this list empty.  The behavior is
+  // undefined if elements are appended concurrently.
+  std::vector<T> take() {
+    const std::size_t count = size_.exchange(0, std::memory_order_acquire);
+    std::vector<T> result;
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      Slot& source = slot(i, false);
+      result.push_back(std::move(source.value));
+      source.appended.store(false, std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+ private:
+  // Assign to the specified `segment` and `offset` the location of the slot
+  // at the specified `index`.
+  static void locate(std::size_t index, std::size_t& segment,
+                     std::size_t& offset) {
+    // Segment `k` begins at index `first_segment_size * (2^k - 1)`.
+    const std::size_t scaled = index / first_segment_size + 1;
+    segment = 0;
+    while (scaled >> (segment + 1)) {
+      ++segment;
+    }
+    offset = index - first_segment_size * ((std::size_t(1) << segment) - 1);
+  }
+
+  // Return the slot at the specified `index`, or null if its segment was not
+  // allocated yet.
+  Slot* find_slot(std::size_t index) {
+    std::size_t segment;
+    std::size_t offset;
+    locate(index, segment, offset);
+    Slot* const storage = segments_[segment].load(std::memory_order_acquire);
+    return storage ? storage + offset : nullptr;
+  }
+
+  // Return the slot at the specified `index`.  If `allocate` is true, then
+  // allocate the slot's segment if necessary.
+  Slot& slot(std::size_t index, bool allocate) {
+    std::size_t segment;
+    std::size_t offset;
+    locate(index, segment, offset);
+
+    Slot* storage = segments_[segment].load(std::memory_order_acquire);
+    if (!storage) {
+      assert(allocate);
+      (void)allocate;
+      Slot* const fresh = new Slot[first_segment_size << segment];
+      if (segments_[segment].compare_exchange_strong(
+              storage, fresh, std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        storage = fresh;
+      } else {
+        // Another thread allocated the segment first.
+        delete[] fresh;
+      }
+    }
+    return storage[offset];
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
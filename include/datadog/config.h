@@ -30,6 +30,9 @@ enum class ConfigName : char {
   APM_TRACING_ENABLED,
   TRACE_RESOURCE_RENAMING_ENABLED,
   TRACE_RESOURCE_RENAMING_ALWAYS_SIMPLIFIED_ENDPOINT,
+  TRACE_PARTIAL_FLUSH_ENABLED,
+  TRACE_PARTIAL_FLUSH_MIN_SPANS,
+  TRACE_API_VERSION,
 };
 
 // Represents metadata for configuration parameters
@@ -0,0 +1,175 @@
+#pragma once
+
+// This component provides a class, `ScopePromise`, that C++20 coroutine
+// promise types can derive from so that the scopes (see `scope.h`) of a
+// coroutine are carried across its suspension points, even when it is
+// resumed on a different thread.
+//
+// `Scope` keeps a stack of active spans per thread.  A coroutine that has an
+// active `Scope` and that is suspended, and then resumed by an executor on
+// another thread, would otherwise find the executor's scopes active instead
+// of its own, and would leave its own scopes active on the thread where it
+// was suspended.  `ScopePromise` swaps the coroutine's innermost scope with
+// the thread's at every suspension and resumption, which costs a pointer
+// swap each.
+//
+// To use it, derive the promise type of a task from `ScopePromise`, and pass
+// the awaiters of the promise's `initial_suspend` and `final_suspend` through
+// `transform_initial_suspend` and `transform_final_suspend`:
+//
+//     struct promise_type : datadog::tracing::ScopePromise {
+//       auto initial_suspend() {
+//         return transform_initial_suspend(std::suspend_always{});
+//       }
+//       auto final_suspend() noexcept {
+//         return transform_final_suspend(FinalAwaiter{continuation});
+//       }
+//       ...
+//     };
+//
+// `ScopePromise` wraps each `co_await` of the coroutine via `await_transform`.
+// A promise type that has its own `await_transform` can pass its result
+// through `ScopePromise::await_transform`.
+//
+// A coroutine begins with the scopes of the thread that created it, so that
+// `Scope::active_span` within it is the span that was active where it was
+// called.  The spans of those scopes must outlive the coroutine, as they do
+// when the caller awaits the coroutine's result.
+//
+// This component is available only when compiling as C++20 or later with
+// coroutine support, and is otherwise empty.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+#include "scope.h"
+
+namespace datadog {
+namespace tracing {
+
+class ScopePromise {
+  // While the coroutine runs, the innermost scope of the thread that resumed
+  // it, which is restored when the coroutine is suspended.
+  Scope* thread_scope_;
+  // While the coroutine is suspended, the coroutine's innermost scope, which
+  // is restored when the coroutine is resumed.
+  Scope* task_scope_;
+
+  // Return the awaiter of the specified `awaitable`, as `co_await` would,
+  // except that `operator co_await` of the promise is not considered.
+  template <typename Awaitable>
+  static decltype(auto) get_awaiter(Awaitable&& awaitable) {
+    if constexpr (requires {
+                    std::forward<Awaitable>(awaitable).operator co_await();
+                  }) {
+      return std::forward<Awaitable>(awaitable).operator co_await();
+    } else if constexpr (requires {
+                           operator co_await(
+                               std::forward<Awaitable>(awaitable));
+                         }) {
+      return operator co_await(std::forward<Awaitable>(awaitable));
+    } else {
+      return std::forward<Awaitable>(awaitable);
+    }
+  }
+
+  // The type of awaiter that the wrappers below hold for `Awaitable`: a
+  // reference if `get_awaiter` returns an lvalue, or a value otherwise.
+  template <typename Awaitable,
+            typename Result = decltype(get_awaiter(std::declval<Awaitable>()))>
+  using awaiter_t = std::conditional_t<std::is_lvalue_reference_v<Result>,
+                                       Result, std::remove_cvref_t<Result>>;
+
+  // `Awaiter` swaps the coroutine's scopes with the thread's when the
+  // coroutine is suspended and resumed by the wrapped awaiter, `Inner`.
+  template <typename Inner>
+  class Awaiter {
+    ScopePromise* promise_;
+    Inner inner_;
+    // Whether the coroutine was suspended, so that the scopes were swapped.
+    bool suspended_ = false;
+
+   public:
+    Awaiter(ScopePromise& promise, Inner&& inner)
+        : promise_(&promise), inner_(std::forward<Inner>(inner)) {}
+
+    bool await_ready() { return inner_.await_ready(); }
+
+    template <typename Promise>
+    decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+      // Swap before the coroutine can be resumed elsewhere, which might
+      // happen before `inner_.await_suspend` returns.
+      suspended_ = true;
+      promise_->task_scope_ =
+          Scope::exchange_current(promise_->thread_scope_);
+      return inner_.await_suspend(handle);
+    }
+
+    decltype(auto) await_resume() {
+      if (suspended_) {
+        promise_->thread_scope_ =
+            Scope::exchange_current(promise_->task_scope_);
+      }
+      return inner_.await_resume();
+    }
+  };
+
+  // `FinalAwaiter` restores the scope of the thread that last resumed the
+  // coroutine, now that the coroutine's own scopes are destroyed.
+  template <typename Inner>
+  class FinalAwaiter {
+    ScopePromise* promise_;
+    Inner inner_;
+
+   public:
+    FinalAwaiter(ScopePromise& promise, Inner&& inner)
+        : promise_(&promise), inner_(std::forward<Inner>(inner)) {}
+
+    bool await_ready() noexcept {
+      Scope::exchange_current(promise_->thread_scope_);
+      return inner_.await_ready();
+    }
+
+    template <typename Promise>
+    decltype(auto) await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      return inner_.await_suspend(handle);
+    }
+
+    void await_resume() noexcept { inner_.await_resume(); }
+  };
+
+ public:
+  // The coroutine begins with the scopes of the thread that creates it.
+  ScopePromise() noexcept
+      : thread_scope_(Scope::current()), task_scope_(thread_scope_) {}
+
+  template <typename Awaitable>
+  Awaiter<awaiter_t<Awaitable>> await_transform(Awaitable&& awaitable) {
+    return {*this, get_awaiter(std::forward<Awaitable>(awaitable))};
+  }
+
+  // Return the specified awaiter of `initial_suspend`, wrapped so that the
+  // coroutine's scopes are restored when it starts.
+  template <typename Awaitable>
+  Awaiter<awaiter_t<Awaitable>> transform_initial_suspend(
+      Awaitable&& awaitable) {
+    return await_transform(std::forward<Awaitable>(awaitable));
+  }
+
+  // Return the specified awaiter of `final_suspend`, wrapped so that the
+  // thread's scopes are restored when the coroutine finishes.
+  template <typename Awaitable>
+  FinalAwaiter<awaiter_t<Awaitable>> transform_final_suspend(
+      Awaitable&& awaitable) noexcept {
+    return {*this, get_awaiter(std::forward<Awaitable>(awaitable))};
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
+
+#endif
@@ -12,6 +12,7 @@
 // See `tracer_config.h`.
 
 #include <chrono>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -22,23 +23,33 @@
 #include "expected.h"
 #include "http_client.h"
 #include "remote_config/listener.h"
+#include "thread_options.h"
 
 namespace datadog {
 namespace tracing {
 
 class EventScheduler;
 class Logger;
+class SharedTraceBuffer;
+class SpillFile;
+
+// The version of the Datadog Agent's traces API, and thus the encoding of the
+// trace payloads, that `DatadogAgent` uses.  `V0_5` payloads encode each
+// distinct string only once, and so are smaller and cheaper to produce.
+enum class TracesAPIVersion : char { V0_4, V0_5 };
 
 struct DatadogAgentConfig {
   // The `HTTPClient` used to submit traces to the Datadog Agent.  If this
   // library was built with libcurl (the default), then `http_client` is
   // optional: a `Curl` instance will be used if `http_client` is left null.
   // If this library was built without libcurl, then `http_client` is required
-  // not to be null.
+  // not to be null.  The default `HTTPClient` is shared by the tracers in the
+  // process that use it, and so are its thread and connections.
   std::shared_ptr<HTTPClient> http_client = nullptr;
   // The `EventScheduler` used to periodically submit batches of traces to the
   // Datadog Agent.  If `event_scheduler` is null, then a
-  // `ThreadedEventScheduler` instance will be used instead.
+  // `ThreadedEventScheduler` instance shared by the tracers in the process
+  // will be used instead.
   std::shared_ptr<EventScheduler> event_scheduler = nullptr;
   // A list of Remote Configuration listeners.
   std::vector<std::shared_ptr<remote_config::Listener>>
@@ -55,6 +66,22 @@ struct DatadogAgentConfig {
   Optional<std::string> url;
   // How often, in milliseconds, to send batches of traces to the Datadog Agent.
   Optional<int> flush_interval_milliseconds;
+  // The flush interval adapts to how quickly trace chunks are buffered,
+  // between these bounds, in milliseconds.  While the flush timer finds at
+  // least a quarter of `flush_threshold_bytes` buffered, the interval halves,
+  // down to `flush_interval_min_milliseconds`.  While it finds nothing
+  // buffered, the interval doubles, up to `flush_interval_max_milliseconds`.
+  // Otherwise, the interval is `flush_interval_milliseconds`.  The timer
+  // fires every `flush_interval_min_milliseconds`, and the intervals are
+  // multiples of it.  Both default to `flush_interval_milliseconds`, which
+  // means that the interval does not change.
+  Optional<int> flush_interval_min_milliseconds;
+  Optional<int> flush_interval_max_milliseconds;
+  // Whether the first flush is after a random part of the flush interval, so
+  // that processes started at the same time do not flush at the same time.
+  // An `event_scheduler` that is specified might not support this (see
+  // `EventScheduler::schedule_recurring_event_after`).  The default is true.
+  Optional<bool> flush_jitter_enabled;
   // Maximum amount of time an HTTP request is allowed to run.
   Optional<int> request_timeout_milliseconds;
   // Maximum amount of time the process is allowed to wait before shutting down.
@@ -65,6 +92,150 @@ struct DatadogAgentConfig {
   // How often, in seconds, to query the Datadog Agent for remote configuration
   // updates.
   Optional<double> remote_configuration_poll_interval_seconds;
+  // While the Datadog Agent's responses to Remote Configuration queries report
+  // no changes, the interval between queries doubles, up to this many seconds.
+  // The first response that does report a change restores
+  // `remote_configuration_poll_interval_seconds`.  A value not greater than
+  // the poll interval means that the interval does not change.  The default
+  // is the poll interval.
+  Optional<double> remote_configuration_max_poll_interval_seconds;
+  // How often, in seconds, to ask the Datadog Agent which endpoints it
+  // supports, using its "/info" endpoint.  The first query is at startup.
+  // Until the Datadog Agent answers, every endpoint is assumed to be
+  // supported.  Afterward, v0.5 traces fall back to v0.4 if
+  // the agent has no v0.5 traces endpoint (see `traces_api_version`).
+  // Remote Configuration is not queried if the agent has no endpoint for it.
+  // Trace stats are neither computed nor sent if it has no stats endpoint
+  // (see `stats_computation_enabled`).  Zero means that the Datadog Agent is
+  // not asked.  The default is zero.
+  Optional<double> agent_info_refresh_interval_seconds;
+  // Whether each trace chunk is encoded to MessagePack as soon as it is
+  // complete, rather than when the batch containing it is flushed.  Encoding
+  // early releases the chunk's spans right away and spreads the cost of
+  // serialization across the threads that finish traces, at the expense of
+  // doing that work on those threads.  The default is `false`.
+  Optional<bool> encode_on_send;
+  // The version of the Datadog Agent's traces API to which traces are sent.
+  // If the Datadog Agent does not support `TracesAPIVersion::V0_5`, then
+  // `DatadogAgent` falls back to `TracesAPIVersion::V0_4` for subsequent
+  // payloads.  Trace chunks are encoded on send (see `encode_on_send`) only
+  // while `TracesAPIVersion::V0_4` is in use.  Overridden by the
+  // `DD_TRACE_API_VERSION` environment variable, whose value is either "v0.4"
+  // or "v0.5".  The default is `TracesAPIVersion::V0_4`.
+  Optional<TracesAPIVersion> traces_api_version;
+  // The number of threads, besides the one flushing, that encode a payload of
+  // trace chunks in parallel when the payload has at least
+  // `parallel_encoding_min_spans` spans.  Each thread encodes a share of the
+  // chunks into its own buffer.  Only `TracesAPIVersion::V0_4` payloads are
+  // encoded in parallel, because their chunks are encoded independently of
+  // each other.  The threads have the options `background_threads`.  Must be
+  // at most 64.  The default is zero, which means that payloads are encoded
+  // by the flushing thread alone.
+  Optional<std::size_t> encoding_threads;
+  // The minimum number of spans in a payload for it to be encoded in parallel
+  // (see `encoding_threads`).  Smaller payloads are encoded faster than the
+  // threads can be woken.  The default is 10000.
+  Optional<std::size_t> parallel_encoding_min_spans;
+  // When the estimated encoded size of the buffered trace chunks reaches this
+  // many bytes, they are sent immediately, on the thread that sent the last
+  // chunk, rather than at the next flush interval.  Must be positive.  The
+  // default is 8 MiB.
+  Optional<std::size_t> flush_threshold_bytes;
+  // The maximum estimated encoded size, in bytes, of the buffered trace
+  // chunks.  Trace chunks sent while the buffer is full are dropped.  Must be
+  // at least `flush_threshold_bytes`.  The default is 64 MiB.
+  Optional<std::size_t> max_buffered_bytes;
+  // The maximum estimated encoded size, in bytes, of one trace payload.  A
+  // flush whose trace chunks exceed it is split, at chunk boundaries, into
+  // several payloads, which are sent concurrently so long as fewer than
+  // `max_in_flight_requests` are in flight.  The chunks that remain are sent
+  // by a later flush.  A chunk larger than the maximum is sent in a payload of
+  // its own.  Must be positive.  The default is 25 MiB, the largest payload
+  // that the Datadog Agent accepts by default.
+  Optional<std::size_t> max_payload_bytes;
+  // Whether to gzip compress trace payloads, and say so in the
+  // "Content-Encoding" request header.  If the Datadog Agent rejects a
+  // compressed payload as an unsupported media type, then subsequent payloads
+  // are sent uncompressed.  Compression requires that this library was built
+  // with zlib (see the `DD_TRACE_COMPRESSION` build option).  The default is
+  // `false`.
+  Optional<bool> compression_enabled;
+  // The gzip compression level, between 1 (fastest) and 9 (smallest).  The
+  // default is 6.
+  Optional<int> compression_level;
+  // Payloads smaller than this many bytes are sent uncompressed, because
+  // compressing them saves little.  The default is 1024.
+  Optional<std::size_t> compression_min_bytes;
+  // Whether the default HTTP client sends requests to the Datadog Agent using
+  // HTTP/2, so that concurrent requests (traces, Remote Configuration, and
+  // telemetry) are multiplexed over one connection.  For "http" and Unix
+  // domain socket URLs, the Datadog Agent must accept HTTP/2 without
+  // negotiation ("prior knowledge").  Has no effect if `http_client` is
+  // specified.  The default is `false`.
+  Optional<bool> http2_enabled;
+  // Whether the default HTTP client, if this library was built with
+  // `DD_TRACE_TRANSPORT` set to "native", uses io_uring rather than `poll`
+  // for its event loop, so that the sends and receives of all of its
+  // connections are submitted in one system call.  If io_uring is unavailable
+  // (on other than Linux, on Linux older than 5.11, or where it is disabled),
+  // then `poll` is used instead.  Has no effect if `http_client` is specified.
+  // The default is `false`.
+  Optional<bool> io_uring_enabled;
+  // The maximum number of trace requests to the Datadog Agent that may be in
+  // flight at once.  While that many are in flight, sending the buffered trace
+  // chunks is deferred, and they are merged into the payload of a later flush.
+  // The buffered chunks remain bounded by `max_buffered_bytes`.  Zero means
+  // no limit.  The default is 2.
+  Optional<std::size_t> max_in_flight_requests;
+  // When a trace chunk that was kept by the user, or that has an error, is
+  // buffered, the buffered chunks of that kind are sent at once, in a payload
+  // of their own, at most this many times per second.  The other chunks wait
+  // for the next flush, as do those that would exceed the rate or the
+  // `max_in_flight_requests`.  This lets errors be seen, e.g. by monitors,
+  // sooner than the flush interval, while most chunks are still batched.
+  // Zero, the default, disables such flushes.
+  Optional<double> priority_flushes_per_second;
+  // The maximum number of times that a trace payload is sent again after the
+  // Datadog Agent could not be reached or responded with status 429 or 5xx.
+  // Payloads are sent again after an exponential backoff with random jitter,
+  // the first of which is about one second, and at the earliest at the next
+  // flush interval.  Zero disables retries.  The default is 3.
+  Optional<std::size_t> max_retries;
+  // The maximum total size, in bytes, of the payloads kept to be sent again.
+  // A payload that would exceed it is dropped instead.  The default is
+  // 16 MiB.
+  Optional<std::size_t> retry_budget_bytes;
+  // A file into which the payloads that cannot be retried in memory, because
+  // they were retried `max_retries` times or would exceed
+  // `retry_budget_bytes`, are written while the Datadog Agent cannot be
+  // reached, to be sent again once it responds.  See `spill_file.h`.  The
+  // default is null, which means that those payloads are dropped.
+  std::shared_ptr<SpillFile> spill_file = nullptr;
+  // A buffer shared with other processes, into which trace chunks are written
+  // instead of being sent to the Datadog Agent by this process.  One of the
+  // processes sharing the buffer sends the chunks of all of them.  See
+  // `shared_trace_buffer.h`.  Requires the v0.4 traces API.  The default is
+  // null, which means that this process sends its own trace chunks.
+  std::shared_ptr<SharedTraceBuffer> shared_trace_buffer = nullptr;
+  // Whether the trace chunks of the tracers in this process that send traces
+  // identically (with the same `HTTPClient`, URL, and options) are buffered
+  // together and sent in one payload per flush, rather than one payload per
+  // tracer.  Has no effect if `shared_trace_buffer` is specified.  The
+  // default is `true`.
+  Optional<bool> batch_across_tracers;
+  // Whether the tracer computes trace stats (see `stats_concentrator.h`) and
+  // sends them to the Datadog Agent, rather than the Datadog Agent computing
+  // them from the traces that it receives.  The tracer then does not send
+  // traces that it drops, except for spans kept by span sampling rules.
+  // Overridden by the `DD_TRACE_STATS_COMPUTATION_ENABLED` environment
+  // variable.  The default is `false`.
+  Optional<bool> stats_computation_enabled;
+  // The CPUs, scheduling policy, nice value, and names of the threads of the
+  // default `http_client` and `event_scheduler`.  See `thread_options.h`.  If
+  // any of the options is specified, then those defaults are not shared with
+  // other tracers.  Has no effect on a specified `http_client` or
+  // `event_scheduler`.
+  ThreadOptions background_threads;
 };
 
 class FinalizedDatadogAgentConfig {
@@ -76,24 +247,67 @@ class FinalizedDatadogAgentConfig {
  public:
   Clock clock;
   bool remote_configuration_enabled;
+  bool encode_on_send;
+  TracesAPIVersion traces_api_version;
+  std::size_t encoding_threads;
+  std::size_t parallel_encoding_min_spans;
+  ThreadOptions background_threads;
+  std::size_t flush_threshold_bytes;
+  std::size_t max_buffered_bytes;
+  std::size_t max_payload_bytes;
+  bool compression_enabled;
+  int compression_level;
+  std::size_t compression_min_bytes;
+  bool http2_enabled;
+  bool io_uring_enabled;
+  std::size_t max_in_flight_requests;
+  // Zero if chunks are not sent ahead of the flush interval for their class.
+  double priority_flushes_per_second;
+  std::size_t max_retries;
+  std::size_t retry_budget_bytes;
+  std::shared_ptr<SpillFile> spill_file;
   std::shared_ptr<HTTPClient> http_client;
   std::shared_ptr<EventScheduler> event_scheduler;
+  // Whether `http_client` and `event_scheduler` were made by this library,
+  // rather than specified by the user.  A process forked from the one that
+  // made them must make its own (see `Tracer::reinitialize_after_fork`).
+  bool default_http_client;
+  bool default_event_scheduler;
+  std::shared_ptr<SharedTraceBuffer> shared_trace_buffer;
+  bool batch_across_tracers;
   std::vector<std::shared_ptr<remote_config::Listener>>
       remote_configuration_listeners;
   HTTPClient::URL url;
   std::chrono::steady_clock::duration flush_interval;
+  // At most `flush_interval`.
+  std::chrono::steady_clock::duration flush_interval_min;
+  // At least `flush_interval`.
+  std::chrono::steady_clock::duration flush_interval_max;
+  bool flush_jitter_enabled;
   std::chrono::steady_clock::duration request_timeout;
   std::chrono::steady_clock::duration shutdown_timeout;
   std::chrono::steady_clock::duration remote_configuration_poll_interval;
+  // At least `remote_configuration_poll_interval`.
+  std::chrono::steady_clock::duration remote_configuration_max_poll_interval;
+  // Zero if the Datadog Agent's "/info" endpoint is not queried.
+  std::chrono::steady_clock::duration agent_info_refresh_interval;
   std::unordered_map<ConfigName, ConfigMetadata> metadata;
 
   // Origin detection
   Optional<std::string> admission_controller_uid;
 
-  // Indicate if stats computation should be delegated to the Agent.
-  // This feature is not supported yet, however, we need to inform the Agent to
-  // not compute stats when APM Tracing `DD_APM_TRACING_ENABLED` is disabled.
+  // Whether the tracer computes trace stats and drops the traces that it does
+  // not keep.
   bool stats_computation_enabled;
+  // Whether to tell the Datadog Agent not to compute trace stats, using the
+  // "Datadog-Client-Computed-Stats" header.  This is the case if the tracer
+  // computes them, and also when APM tracing (`DD_APM_TRACING_ENABLED`) is
+  // disabled.
+  bool client_computed_stats;
+  // Whether to tell the Datadog Agent not to obfuscate trace chunks, using the
+  // "Datadog-Obfuscation-Version" header, because the tracer obfuscates them
+  // (see `TracerConfig::obfuscation_enabled`).
+  bool client_obfuscation;
 };
 
 Expected<FinalizedDatadogAgentConfig> finalize_config(
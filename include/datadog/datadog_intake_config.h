@@ -0,0 +1,136 @@
+#pragma once
+
+// This component provides facilities for configuring a `DatadogIntake`, a
+// collector that sends traces directly to Datadog rather than to a Datadog
+// Agent.
+//
+// `struct DatadogIntakeConfig` contains fields that are used to configure
+// `DatadogIntake`.  The configuration must first be finalized before it can be
+// used by `DatadogIntake`.  The function `finalize_config` produces either an
+// error or a `FinalizedDatadogIntakeConfig`.
+//
+// `DatadogIntake` is meant for short-lived processes, such as batch jobs,
+// that run where no Datadog Agent is available.  It buffers encoded trace
+// chunks until a large batch is accumulated, sends again the batches that
+// failed to be sent, and sends the buffered chunks when it is destroyed, so
+// that a process makes few requests and loses no traces at exit.
+//
+// Typical usage of `DatadogIntakeConfig` is implicit as part of
+// `TracerConfig`.  See `tracer_config.h`.
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "clock.h"
+#include "expected.h"
+#include "http_client.h"
+#include "optional.h"
+#include "thread_options.h"
+
+namespace datadog {
+namespace tracing {
+
+class EventScheduler;
+class Logger;
+
+struct DatadogIntakeConfig {
+  // Whether traces are sent directly to the Datadog intake, in which case the
+  // `TracerConfig::agent` configuration is ignored.  The default is `false`.
+  Optional<bool> enabled;
+  // The Datadog API key sent with each request.  Required if `enabled`.
+  // Overridden by the `DD_API_KEY` environment variable.
+  Optional<std::string> api_key;
+  // The Datadog site to which traces are sent, e.g. "datadoghq.eu".
+  // Overridden by the `DD_SITE` environment variable.  The default is
+  // "datadoghq.com".
+  Optional<std::string> site;
+  // The URL to which trace payloads are posted, in the protobuf format of the
+  // agentless traces API (`AgentPayload`), which is what a Datadog Agent
+  // itself sends to Datadog.  Specify `url` to send traces through a proxy or
+  // relay.  The default is "https://trace.agent.<site>/api/v0.2/traces".
+  Optional<std::string> url;
+  // The `HTTPClient` used to submit traces.  See
+  // `DatadogAgentConfig::http_client`.
+  std::shared_ptr<HTTPClient> http_client = nullptr;
+  // The `EventScheduler` used to periodically submit batches of traces.  If
+  // `event_scheduler` is null, then a `ThreadedEventScheduler` instance shared
+  // by the tracers in the process will be used instead.
+  std::shared_ptr<EventScheduler> event_scheduler = nullptr;
+  // The options of the threads of the default `http_client` and
+  // `event_scheduler`.  See `DatadogAgentConfig::background_threads`.
+  ThreadOptions background_threads;
+  // How often, in milliseconds, to send the buffered traces.  The default is
+  // 10000.
+  Optional<int> flush_interval_milliseconds;
+  // Maximum amount of time an HTTP request is allowed to run.  The default is
+  // 10000.
+  Optional<int> request_timeout_milliseconds;
+  // Maximum amount of time the process is allowed to wait before shutting
+  // down.  The default is 10000.
+  Optional<int> shutdown_timeout_milliseconds;
+  // When the encoded size of the buffered trace chunks reaches this many
+  // bytes, they are sent immediately, rather than at the next flush interval.
+  // Must be positive.  The default is 2 MiB.
+  Optional<std::size_t> flush_threshold_bytes;
+  // The maximum encoded size, in bytes, of the buffered trace chunks.  Trace
+  // chunks sent while the buffer is full are dropped.  Must be at least
+  // `flush_threshold_bytes`.  The default is 32 MiB.
+  Optional<std::size_t> max_buffered_bytes;
+  // Whether to gzip compress payloads.  Payloads are compressed only if this
+  // library was built with zlib (see the `DD_TRACE_COMPRESSION` build option).
+  // The default is `true`.
+  Optional<bool> compression_enabled;
+  // The gzip compression level, between 1 (fastest) and 9 (smallest).  The
+  // default is 6.
+  Optional<int> compression_level;
+  // The maximum number of times that a trace payload is sent again after the
+  // Datadog intake could not be reached or responded with status 429 or 5xx.
+  // See `DatadogAgentConfig::max_retries`.  The default is 3.
+  Optional<std::size_t> max_retries;
+  // The maximum total size, in bytes, of the payloads kept to be sent again.
+  // A payload that would exceed it is dropped instead.  The default is
+  // 16 MiB.
+  Optional<std::size_t> retry_budget_bytes;
+};
+
+class FinalizedDatadogIntakeConfig {
+  friend Expected<FinalizedDatadogIntakeConfig> finalize_config(
+      const DatadogIntakeConfig&, const std::shared_ptr<Logger>&,
+      const Clock&);
+
+  FinalizedDatadogIntakeConfig() = default;
+
+ public:
+  Clock clock;
+  std::string api_key;
+  HTTPClient::URL url;
+  std::shared_ptr<HTTPClient> http_client;
+  std::shared_ptr<EventScheduler> event_scheduler;
+  // Whether `http_client` and `event_scheduler` were made by this library,
+  // rather than specified by the user.  A process forked from the one that
+  // made them must make its own (see `Tracer::reinitialize_after_fork`).
+  bool default_http_client;
+  bool default_event_scheduler;
+  ThreadOptions background_threads;
+  std::chrono::steady_clock::duration flush_interval;
+  std::chrono::steady_clock::duration request_timeout;
+  std::chrono::steady_clock::duration shutdown_timeout;
+  std::size_t flush_threshold_bytes;
+  std::size_t max_buffered_bytes;
+  bool compression_enabled;
+  int compression_level;
+  std::size_t max_retries;
+  std::size_t retry_budget_bytes;
+};
+
+// Return a `FinalizedDatadogIntakeConfig` from the specified `config` and from
+// any relevant environment variables, or return an `Error` if the
+// configuration is invalid.
+Expected<FinalizedDatadogIntakeConfig> finalize_config(
+    const DatadogIntakeConfig& config, const std::shared_ptr<Logger>& logger,
+    const Clock& clock);
+
+}  // namespace tracing
+}  // namespace datadog
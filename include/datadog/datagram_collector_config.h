@@ -0,0 +1,71 @@
+#pragma once
+
+// This component provides facilities for configuring a `DatagramCollector`, a
+// collector that sends each trace chunk as one datagram over a Unix domain
+// socket, rather than in HTTP requests to a Datadog Agent.
+//
+// `struct DatagramCollectorConfig` contains fields that are used to configure
+// `DatagramCollector`.  The configuration must first be finalized before it
+// can be used by `DatagramCollector`.  The function `finalize_config` produces
+// either an error or a `FinalizedDatagramCollectorConfig`.
+//
+// Typical usage of `DatagramCollectorConfig` is implicit as part of
+// `TracerConfig`.  See `tracer_config.h`.
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "clock.h"
+#include "expected.h"
+#include "optional.h"
+
+namespace datadog {
+namespace tracing {
+
+// The type of Unix domain socket over which `DatagramCollector` sends trace
+// chunks.  `SEQPACKET` sockets are connection oriented, so that the
+// receiver's going away is noticed, and they preserve message boundaries as
+// `DATAGRAM` sockets do.
+enum class DatagramSocketType : char { DATAGRAM, SEQPACKET };
+
+struct DatagramCollectorConfig {
+  // Whether trace chunks are sent as datagrams, in which case the
+  // `TracerConfig::agent` configuration is ignored.  The default is `false`.
+  Optional<bool> enabled;
+  // The path of the Unix domain socket to which trace chunks are sent.
+  // Required if `enabled` is true.
+  Optional<std::string> socket_path;
+  // The type of the socket at `socket_path`.  The default is
+  // `DatagramSocketType::DATAGRAM`.
+  Optional<DatagramSocketType> socket_type;
+  // The maximum size, in bytes, of one datagram.  Trace chunks whose encoding
+  // is larger are dropped.  Must be positive.  The default is 65536.
+  Optional<std::size_t> max_datagram_bytes;
+  // While the socket cannot be connected, or after sending on it fails, trace
+  // chunks are dropped, and connecting is attempted again at most once per
+  // this many milliseconds.  Must be positive.  The default is 1000.
+  Optional<int> reconnect_interval_milliseconds;
+};
+
+class FinalizedDatagramCollectorConfig {
+  friend Expected<FinalizedDatagramCollectorConfig> finalize_config(
+      const DatagramCollectorConfig&, const Clock&);
+
+  FinalizedDatagramCollectorConfig() = default;
+
+ public:
+  Clock clock;
+  std::string socket_path;
+  DatagramSocketType socket_type;
+  std::size_t max_datagram_bytes;
+  std::chrono::steady_clock::duration reconnect_interval;
+};
+
+// Return a `FinalizedDatagramCollectorConfig` from the specified `config`, or
+// return an `Error` if the configuration is invalid.
+Expected<FinalizedDatagramCollectorConfig> finalize_config(
+    const DatagramCollectorConfig& config, const Clock& clock);
+
+}  // namespace tracing
+}  // namespace datadog
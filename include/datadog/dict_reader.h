@@ -24,6 +24,13 @@ class DictReader {
   virtual void visit(
       const std::function<void(StringView key, StringView value)>& visitor)
       const = 0;
+
+  // Return whether reading several keys of this object is faster with one
+  // call to `visit` than with a call to `lookup` per key, as when `lookup`
+  // scans every key/value pair.  `Tracer::extract_span` reads the propagation
+  // headers of a reader that returns `false` by looking up each header only
+  // when an extractor needs it.  The default implementation returns `true`.
+  virtual bool prefers_visit() const { return true; }
 };
 
 }  // namespace tracing
@@ -40,13 +40,17 @@ namespace environment {
   MACRO(DD_TAGS)                                               \
   MACRO(DD_TRACE_AGENT_PORT)                                   \
   MACRO(DD_TRACE_AGENT_URL)                                    \
+  MACRO(DD_TRACE_API_VERSION)                                  \
   MACRO(DD_TRACE_DEBUG)                                        \
   MACRO(DD_TRACE_ENABLED)                                      \
+  MACRO(DD_TRACE_PARTIAL_FLUSH_ENABLED)                        \
+  MACRO(DD_TRACE_PARTIAL_FLUSH_MIN_SPANS)                      \
   MACRO(DD_TRACE_RATE_LIMIT)                                   \
   MACRO(DD_TRACE_REPORT_HOSTNAME)                              \
   MACRO(DD_TRACE_SAMPLE_RATE)                                  \
   MACRO(DD_TRACE_SAMPLING_RULES)                               \
   MACRO(DD_TRACE_STARTUP_LOGS)                                 \
+  MACRO(DD_TRACE_STATS_COMPUTATION_ENABLED)                    \
   MACRO(DD_TRACE_TAGS_PROPAGATION_MAX_LENGTH)                  \
   MACRO(DD_VERSION)                                            \
   MACRO(DD_TRACE_128_BIT_TRACEID_GENERATION_ENABLED)           \
@@ -63,7 +67,10 @@ namespace environment {
   MACRO(DD_APM_TRACING_ENABLED)                                \
   MACRO(DD_TRACE_RESOURCE_RENAMING_ENABLED)                    \
   MACRO(DD_TRACE_RESOURCE_RENAMING_ALWAYS_SIMPLIFIED_ENDPOINT) \
-  MACRO(DD_EXTERNAL_ENV)
+  MACRO(DD_EXTERNAL_ENV)                                       \
+  MACRO(DD_API_KEY)                                            \
+  MACRO(DD_SITE)                                               \
+  MACRO(OTEL_EXPORTER_OTLP_TRACES_ENDPOINT)
 
 #define WITH_COMMA(ARG) ARG,
 
@@ -79,6 +79,68 @@ struct Error {
     BAGGAGE_MAXIMUM_BYTES_REACHED = 54,
     BAGGAGE_MAXIMUM_ITEMS_REACHED = 55,
     REMOTE_CONFIGURATION_INVALID_JSON = 56,
+    INVALID_PARTIAL_FLUSH_MIN_SPANS = 57,
+    DATADOG_AGENT_INVALID_TRACES_API_VERSION = 58,
+    DATADOG_AGENT_INVALID_BUFFER_LIMITS = 59,
+    DATADOG_AGENT_COMPRESSION_UNAVAILABLE = 60,
+    DATADOG_AGENT_COMPRESSION_FAILURE = 61,
+    DATADOG_AGENT_INVALID_COMPRESSION_LEVEL = 62,
+    CURL_HTTP2_UNAVAILABLE = 63,
+    SOCKET_HTTP_CLIENT_SETUP_FAILED = 64,
+    SOCKET_HTTP_CLIENT_UNSUPPORTED_URL = 65,
+    SOCKET_HTTP_CLIENT_REQUEST_FAILURE = 66,
+    SOCKET_HTTP_CLIENT_DEADLINE_EXCEEDED = 67,
+    SHARED_TRACE_BUFFER_INVALID_CAPACITY = 68,
+    SHARED_TRACE_BUFFER_UNAVAILABLE = 69,
+    DATADOG_AGENT_INVALID_SHARED_TRACE_BUFFER = 70,
+    DATADOG_INTAKE_NULL_HTTP_CLIENT = 71,
+    DATADOG_INTAKE_MISSING_API_KEY = 72,
+    DATADOG_INTAKE_INVALID_INTERVAL = 73,
+    DATADOG_INTAKE_INVALID_BUFFER_LIMITS = 74,
+    DATADOG_INTAKE_INVALID_COMPRESSION_LEVEL = 75,
+    INVALID_THREAD_OPTIONS = 76,
+    THREAD_OPTIONS_UNAVAILABLE = 77,
+    ADAPTIVE_SAMPLING_TARGET_OUT_OF_RANGE = 78,
+    TELEMETRY_COMPRESSION_UNAVAILABLE = 79,
+    DATADOG_AGENT_INVALID_ENCODING_THREADS = 80,
+    SPILL_FILE_INVALID_CAPACITY = 81,
+    SPILL_FILE_UNAVAILABLE = 82,
+    TAIL_SAMPLING_INVALID_WINDOW = 83,
+    TAIL_SAMPLING_INVALID_BUFFER_LIMIT = 84,
+    TAIL_SAMPLING_INVALID_PERCENTILE = 85,
+    TAIL_SAMPLING_INVALID_RATE = 86,
+    ORPHANED_SEGMENT_INVALID_MAX_AGE = 87,
+    DATADOG_AGENT_INVALID_INFO_REFRESH_INTERVAL = 88,
+    PROPAGATION_STYLE_UNAVAILABLE = 89,
+    OTLP_EXPORTER_NULL_HTTP_CLIENT = 90,
+    OTLP_EXPORTER_INVALID_INTERVAL = 91,
+    OTLP_EXPORTER_INVALID_BUFFER_LIMITS = 92,
+    DATAGRAM_COLLECTOR_MISSING_SOCKET_PATH = 93,
+    DATAGRAM_COLLECTOR_INVALID_MAX_DATAGRAM_BYTES = 94,
+    DATAGRAM_COLLECTOR_INVALID_INTERVAL = 95,
+    DATAGRAM_SOCKET_UNAVAILABLE = 96,
+    IO_URING_UNAVAILABLE = 97,
+    WINHTTP_CLIENT_SETUP_FAILED = 98,
+    WINHTTP_CLIENT_UNSUPPORTED_URL = 99,
+    WINHTTP_CLIENT_REQUEST_FAILURE = 100,
+    WINHTTP_CLIENT_DEADLINE_EXCEEDED = 101,
+    CAPTURE_FILE_INVALID_CAPACITY = 102,
+    CAPTURE_FILE_UNAVAILABLE = 103,
+    CAPTURE_FILE_INVALID_FORMAT = 104,
+    RECORDING_COLLECTOR_MISSING_CAPTURE_PATH = 105,
+    RECORDING_COLLECTOR_INVALID_INTERVAL = 106,
+    RECORDING_COLLECTOR_INVALID_FLUSH_THRESHOLD = 107,
+    TRACER_UPDATE_EMPTY_SERVICE = 108,
+    DATADOG_AGENT_INVALID_PRIORITY_FLUSH_RATE = 109,
+    TRACER_INVALID_MAX_CPU_OVERHEAD = 110,
+    TRACER_INVALID_HEADER_TAGS = 111,
+    TRACER_INVALID_IMPORTED_SPANS = 112,
+    TRACER_INVALID_BAGGAGE_TAG_KEYS = 113,
+    SHARED_SAMPLER_STATE_UNAVAILABLE = 114,
+    TRACER_INVALID_SPAN_ROLLUPS = 115,
+    STRATIFIED_SAMPLING_TARGET_OUT_OF_RANGE = 116,
+    ADAPTIVE_AND_STRATIFIED_SAMPLING = 117,
+    DATADOG_AGENT_INVALID_V05_PAYLOAD = 118,
   };
 
   Code code;
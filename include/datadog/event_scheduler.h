@@ -4,7 +4,10 @@
 // specified function-like object to be invoked at regular intervals.
 //
 // `DatadogAgent` uses an `EventScheduler` to periodically send batches of
-// traces to the Datadog Agent.
+// traces to the Datadog Agent.  It also hands the CPU work of sending them,
+// such as encoding and compression, to `EventScheduler::post`, so that a
+// server can run that work on its own event loop or low-priority workers
+// rather than on the threads that finish traces.
 //
 // The default implementation is `ThreadedEventScheduler`.  See
 // `threaded_event_scheduler.h`.
@@ -12,6 +15,7 @@
 #include <chrono>
 #include <functional>
 #include <string>
+#include <utility>
 
 namespace datadog {
 namespace tracing {
@@ -28,6 +32,25 @@ class EventScheduler {
       std::chrono::steady_clock::duration interval,
       std::function<void()> callback) = 0;
 
+  // Invoke the specified `callback` as `schedule_recurring_event` does, except
+  // that the first invocation is after the specified `first_delay` rather than
+  // after an initial `interval`.  `DatadogAgent` uses this to give each
+  // process's flushes a random phase.  The default implementation ignores
+  // `first_delay`.
+  virtual Cancel schedule_recurring_event_after(
+      std::chrono::steady_clock::duration first_delay,
+      std::chrono::steady_clock::duration interval,
+      std::function<void()> callback) {
+    static_cast<void>(first_delay);
+    return schedule_recurring_event(interval, std::move(callback));
+  }
+
+  // Invoke the specified `task` once, soon, on a thread of this object's
+  // choosing.  The task might be invoked before `post` returns.  Tasks that
+  // are pending when this object is destroyed might never be invoked.  The
+  // default implementation invokes `task` immediately on the calling thread.
+  virtual void post(std::function<void()> task) { task(); }
+
   // Return a JSON representation of this object's configuration. The JSON
   // representation is an object with the following properties:
   //
@@ -10,9 +10,14 @@
 
 #include <chrono>
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "error.h"
 #include "expected.h"
+#include "optional.h"
+#include "string_view.h"
 
 namespace datadog {
 namespace tracing {
@@ -31,12 +36,31 @@ class HTTPClient {
     static Expected<HTTPClient::URL> parse(StringView input);
   };
 
+  // `URLView` is the parts of a URL as it is parsed by `URL::parse`, but
+  // referring to the parsed text rather than copying it.  It's meant for
+  // parsing URLs on hot paths, such as span tags, where the allocations and
+  // error messages of `URL::parse` are not wanted.
+  struct URLView {
+    StringView scheme;
+    StringView authority;
+    StringView path;
+    StringView query;
+
+    // Return the parts of the specified `input`, or return `nullopt` if
+    // `URL::parse(input)` would return an error.
+    static Optional<URLView> split(StringView input);
+  };
+
   using HeadersSetter = std::function<void(DictWriter& headers)>;
   using ResponseHandler = std::function<void(
       int status, const DictReader& headers, std::string body)>;
   // `ErrorHandler` is for errors encountered by `HTTPClient`, not for
   // error-indicating HTTP responses.
   using ErrorHandler = std::function<void(Error)>;
+  // `BodySegments` is a request body divided into immutable segments, which
+  // are sent one after another.  The segments are shared so that a caller can
+  // send data that it already holds without first concatenating it.
+  using BodySegments = std::vector<std::shared_ptr<const std::string>>;
 
   // Send a POST request to the specified `url`.  Set request headers by calling
   // the specified `set_headers` callback.  Include the specified `body` at the
@@ -51,6 +75,15 @@ class HTTPClient {
       ResponseHandler on_response, ErrorHandler on_error,
       std::chrono::steady_clock::time_point deadline) = 0;
 
+  // Send a POST request as `post` does, except that the request body is the
+  // concatenation of the specified `body` segments.  Each segment must be
+  // non-null.  The default implementation concatenates the segments and
+  // calls `post`.
+  virtual Expected<void> post_segments(
+      const URL& url, HeadersSetter set_headers, BodySegments body,
+      ResponseHandler on_response, ErrorHandler on_error,
+      std::chrono::steady_clock::time_point deadline);
+
   // Wait until there are no more outstanding requests, or until the specified
   // `deadline`.
   virtual void drain(std::chrono::steady_clock::time_point deadline) = 0;
@@ -0,0 +1,37 @@
+#pragma once
+
+// This component provides a `struct`, `ImportedSpan`, that describes an
+// operation that finished before it was traced, such as a query timed by a
+// database driver, a kernel timed by a GPU, or an operation found in a log.
+//
+// `Tracer::import_spans` makes a trace of a sequence of `ImportedSpan`s and
+// sends it as though each span had been created and then finished.  The
+// spans are built together, in one arena, and registered with their trace
+// segment at once, which costs much less than creating each span with
+// `Span::create_child` and then setting its end time.
+
+#include <cstddef>
+
+#include "clock.h"
+#include "span_config.h"
+
+namespace datadog {
+namespace tracing {
+
+struct ImportedSpan {
+  // The `parent_index` of the root of an imported trace.
+  static constexpr std::size_t no_parent = std::size_t(-1);
+
+  // The index of this span's parent among the imported spans.  A parent
+  // precedes its children.
+  std::size_t parent_index = no_parent;
+  // The span's name, resource, start time, tags, and so on, as for a span
+  // created by `Span::create_child`.  The referred-to strings must remain
+  // valid until `Tracer::import_spans` returns.
+  SpanConfigView config;
+  Duration duration = Duration::zero();
+  bool error = false;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -15,6 +15,8 @@ class NullCollector : public Collector {
     return {};
   }
 
+  bool accepts_shared_tags() const override { return true; }
+
   std::string config() const override {
     // clang-format off
     return R"({
@@ -0,0 +1,105 @@
+#pragma once
+
+// This component provides facilities for configuring an `OtlpExporter`, a
+// collector that sends traces to an OpenTelemetry collector in the OTLP/HTTP
+// protobuf format, rather than to a Datadog Agent.
+//
+// `struct OtlpExporterConfig` contains fields that are used to configure
+// `OtlpExporter`.  The configuration must first be finalized before it can be
+// used by `OtlpExporter`.  The function `finalize_config` produces either an
+// error or a `FinalizedOtlpExporterConfig`.
+//
+// Typical usage of `OtlpExporterConfig` is implicit as part of
+// `TracerConfig`.  See `tracer_config.h`.
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "clock.h"
+#include "expected.h"
+#include "http_client.h"
+#include "optional.h"
+#include "thread_options.h"
+
+namespace datadog {
+namespace tracing {
+
+class EventScheduler;
+class Logger;
+
+struct OtlpExporterConfig {
+  // Whether traces are sent to an OpenTelemetry collector, in which case the
+  // `TracerConfig::agent` configuration is ignored.  The default is `false`.
+  Optional<bool> enabled;
+  // The URL to which ExportTraceServiceRequest messages are posted.
+  // Overridden by the `OTEL_EXPORTER_OTLP_TRACES_ENDPOINT` environment
+  // variable.  The default is "http://localhost:4318/v1/traces".
+  Optional<std::string> url;
+  // Additional HTTP headers sent with each request, e.g. for authentication.
+  std::unordered_map<std::string, std::string> headers;
+  // The `HTTPClient` used to submit traces.  See
+  // `DatadogAgentConfig::http_client`.
+  std::shared_ptr<HTTPClient> http_client = nullptr;
+  // The `EventScheduler` used to periodically submit batches of traces.  If
+  // `event_scheduler` is null, then a `ThreadedEventScheduler` instance shared
+  // by the tracers in the process will be used instead.
+  std::shared_ptr<EventScheduler> event_scheduler = nullptr;
+  // The options of the threads of the default `http_client` and
+  // `event_scheduler`.  See `DatadogAgentConfig::background_threads`.
+  ThreadOptions background_threads;
+  // How often, in milliseconds, to send the buffered traces.  The default is
+  // 5000.
+  Optional<int> flush_interval_milliseconds;
+  // Maximum amount of time an HTTP request is allowed to run.  The default is
+  // 10000.
+  Optional<int> request_timeout_milliseconds;
+  // Maximum amount of time the process is allowed to wait before shutting
+  // down.  The default is 10000.
+  Optional<int> shutdown_timeout_milliseconds;
+  // When the encoded size of the buffered spans reaches this many bytes, they
+  // are sent immediately, rather than at the next flush interval.  Must be
+  // positive.  The default is 2 MiB.
+  Optional<std::size_t> flush_threshold_bytes;
+  // The maximum encoded size, in bytes, of the buffered spans.  Trace chunks
+  // sent while the buffer is full are dropped.  Must be at least
+  // `flush_threshold_bytes`.  The default is 32 MiB.
+  Optional<std::size_t> max_buffered_bytes;
+};
+
+class FinalizedOtlpExporterConfig {
+  friend Expected<FinalizedOtlpExporterConfig> finalize_config(
+      const OtlpExporterConfig&, const std::shared_ptr<Logger>&, const Clock&);
+
+  FinalizedOtlpExporterConfig() = default;
+
+ public:
+  Clock clock;
+  HTTPClient::URL url;
+  std::unordered_map<std::string, std::string> headers;
+  std::shared_ptr<HTTPClient> http_client;
+  std::shared_ptr<EventScheduler> event_scheduler;
+  // Whether `http_client` and `event_scheduler` were made by this library,
+  // rather than specified by the user.  A process forked from the one that
+  // made them must make its own (see `Tracer::reinitialize_after_fork`).
+  bool default_http_client;
+  bool default_event_scheduler;
+  ThreadOptions background_threads;
+  std::chrono::steady_clock::duration flush_interval;
+  std::chrono::steady_clock::duration request_timeout;
+  std::chrono::steady_clock::duration shutdown_timeout;
+  std::size_t flush_threshold_bytes;
+  std::size_t max_buffered_bytes;
+};
+
+// Return a `FinalizedOtlpExporterConfig` from the specified `config` and from
+// any relevant environment variables, or return an `Error` if the
+// configuration is invalid.
+Expected<FinalizedOtlpExporterConfig> finalize_config(
+    const OtlpExporterConfig& config, const std::shared_ptr<Logger>& logger,
+    const Clock& clock);
+
+}  // namespace tracing
+}  // namespace datadog
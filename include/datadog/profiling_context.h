@@ -0,0 +1,44 @@
+#pragma once
+
+// This component provides a `struct`, `ProfilingContext`, through which a
+// continuous profiler running in the same process learns which span is active
+// on a thread when it samples the thread, so that it can attribute the sample
+// to the span, its trace, and the endpoint of its local root span.
+//
+// Each thread has one `ProfilingContext`, the thread-local variable
+// `datadog_tracing_profiling_context`, whose unmangled name lets a profiler
+// find it without linking to this library's C++ interface.  `Scope` updates
+// the variable whenever the current thread's active span changes (see
+// `scope.h`), using only a few stores: it neither locks nor allocates.
+//
+// The variable is meant to be read by a signal handler on the thread that it
+// belongs to, such as the handler of a profiler's sampling signal, and is
+// updated as a sequence lock: `sequence` is odd while an update is in
+// progress.  A reader loads `sequence`, then the other fields, then
+// `sequence` again, and discards what it read if the two values of
+// `sequence` differ or are odd.  All fields are zero when no span is active.
+//
+// `local_root_resource_hash` is the 64-bit FNV-1a hash of the resource name
+// of the local root span when the span was activated, so that a profiler can
+// group samples by endpoint without copying strings in a signal handler.
+
+#include <atomic>
+#include <cstdint>
+
+namespace datadog {
+namespace tracing {
+
+struct ProfilingContext {
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> trace_id_low;
+  std::atomic<std::uint64_t> trace_id_high;
+  std::atomic<std::uint64_t> span_id;
+  std::atomic<std::uint64_t> local_root_span_id;
+  std::atomic<std::uint64_t> local_root_resource_hash;
+};
+
+}  // namespace tracing
+}  // namespace datadog
+
+extern "C" thread_local datadog::tracing::ProfilingContext
+    datadog_tracing_profiling_context;
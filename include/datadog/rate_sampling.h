@@ -0,0 +1,37 @@
+#pragma once
+
+// This component provides a function, `keep_at_rate`, that decides for many
+// trace IDs at once whether each trace is kept when sampled at a specified
+// rate.  The decision for a trace ID is the one that `TraceSampler` makes for
+// a trace sampled at that rate by a sampling rule or by the Datadog Agent,
+// before any limiter is applied.
+//
+// `keep_at_rate` is intended for tools that sample many stored traces, such as
+// a tool that replays traces through a candidate sampling configuration.  Its
+// loop has no branches, so that the compiler can vectorize it.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rate.h"
+#include "trace_id.h"
+
+namespace datadog {
+namespace tracing {
+
+// For each `i` less than the specified `count`, set `keep[i]` to whether the
+// trace whose ID has the lower 64 bits `trace_ids_low[i]` is kept at the
+// specified `rate`.  Return the number of traces kept.  `keep` and
+// `trace_ids_low` must each have at least `count` elements.
+std::size_t keep_at_rate(const std::uint64_t* trace_ids_low, std::size_t count,
+                         Rate rate, bool* keep);
+
+// For each `i` less than the specified `count`, set `keep[i]` to whether the
+// trace whose ID is `trace_ids[i]` is kept at the specified `rate`.  Return
+// the number of traces kept.  `keep` and `trace_ids` must each have at least
+// `count` elements.
+std::size_t keep_at_rate(const TraceID* trace_ids, std::size_t count,
+                         Rate rate, bool* keep);
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,84 @@
+#pragma once
+
+// This component provides facilities for configuring a `RecordingCollector`,
+// a collector that appends the trace payloads that it would have sent to a
+// Datadog Agent to a capture file (see `capture_file.h`), rather than sending
+// them, so that they can be replayed later against a real agent.
+//
+// `struct RecordingCollectorConfig` contains fields that are used to configure
+// `RecordingCollector`.  The configuration must first be finalized before it
+// can be used by `RecordingCollector`.  The function `finalize_config`
+// produces either an error or a `FinalizedRecordingCollectorConfig`.
+//
+// Typical usage of `RecordingCollectorConfig` is implicit as part of
+// `TracerConfig`.  See `tracer_config.h`.
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "clock.h"
+#include "event_scheduler.h"
+#include "expected.h"
+#include "optional.h"
+
+namespace datadog {
+namespace tracing {
+
+class CaptureFile;
+
+struct RecordingCollectorConfig {
+  // Whether trace payloads are recorded, in which case the
+  // `TracerConfig::agent` configuration is ignored.  The default is `false`.
+  Optional<bool> enabled;
+  // The path of the capture file, which is created, or emptied if it exists.
+  // Required if `enabled` is true.  A process forked from the recording one
+  // records to its own file, whose path is this path followed by a period and
+  // the process ID.
+  Optional<std::string> capture_path;
+  // The size, in bytes, of the capture file's records.  Payloads recorded once
+  // the file is full are dropped.  The default is 256 MiB.
+  Optional<std::size_t> capture_bytes;
+  // The `EventScheduler` used to periodically record the buffered traces.  If
+  // `event_scheduler` is null, then a `ThreadedEventScheduler` instance shared
+  // by the tracers in the process will be used instead.
+  std::shared_ptr<EventScheduler> event_scheduler = nullptr;
+  // How often, in milliseconds, to record the buffered traces as a payload.
+  // The default is 2000, as for `DatadogAgentConfig`, so that the recorded
+  // payloads are like those that a `DatadogAgent` would send.
+  Optional<int> flush_interval_milliseconds;
+  // When the encoded size of the buffered traces reaches this many bytes,
+  // they are recorded immediately, rather than at the next flush interval.
+  // Must be positive.  The default is 8 MiB, as for `DatadogAgentConfig`.
+  Optional<std::size_t> flush_threshold_bytes;
+};
+
+class FinalizedRecordingCollectorConfig {
+  friend Expected<FinalizedRecordingCollectorConfig> finalize_config(
+      const RecordingCollectorConfig&, const Clock&);
+
+  FinalizedRecordingCollectorConfig() = default;
+
+ public:
+  Clock clock;
+  std::string capture_path;
+  std::size_t capture_bytes;
+  std::shared_ptr<CaptureFile> capture_file;
+  std::shared_ptr<EventScheduler> event_scheduler;
+  // Whether `event_scheduler` was made by this library, rather than specified
+  // by the user.  A process forked from the one that made it must make its
+  // own (see `Tracer::reinitialize_after_fork`).
+  bool default_event_scheduler;
+  std::chrono::steady_clock::duration flush_interval;
+  std::size_t flush_threshold_bytes;
+};
+
+// Return a `FinalizedRecordingCollectorConfig` from the specified `config`, or
+// return an `Error` if the configuration is invalid or if the capture file
+// cannot be created.
+Expected<FinalizedRecordingCollectorConfig> finalize_config(
+    const RecordingCollectorConfig& config, const Clock& clock);
+
+}  // namespace tracing
+}  // namespace datadog
@@ -33,6 +33,8 @@ class Listener {
   virtual Capabilities get_capabilities() = 0;
 
   // Pure virtual function called when a configuration needs to be reverted.
+  // The `content` of the configuration is empty, since it is not retained
+  // once the configuration is applied.
   virtual void on_revert(const Configuration&) = 0;
 
   // Pure virtual function called when a configuration is updated.
@@ -41,7 +43,8 @@ class Listener {
   virtual tracing::Optional<std::string> on_update(const Configuration&) = 0;
 
   // TODO: Find a better name and a better solution! Mainly here for ASM
-  // Called once the last remote configuration response is completed.
+  // Called once the last remote configuration response is completed.  Not
+  // called for a response that is identical to the previously processed one.
   virtual void on_post_process() = 0;
 };
 
@@ -0,0 +1,107 @@
+#pragma once
+
+// This component provides a `struct`, `RuntimeStats`, that is a snapshot of
+// the work that a `Tracer` has in progress, such as the number of trace
+// segments that are not yet finished and the number of trace chunks waiting
+// to be sent.
+//
+// `RuntimeStats` is returned by `Tracer::runtime_stats`, which reads counters
+// that the tracer maintains anyway, so that it is cheap enough to call
+// frequently, e.g. once per second by an application's own metrics pipeline.
+// The members are read independently of each other, so a snapshot taken
+// while the tracer is busy need not be consistent across members.
+//
+// `RuntimeStats` also includes quantiles of the recent durations of local root
+// spans for each service and resource (see `ResourceLatency`), of which there
+// are at most a few hundred, and quantiles of how long recent trace chunks took
+// to be delivered (see `DeliveryLatency`).
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+// `ResourceLatency` describes the recent durations of the local root spans
+// that have a particular service and resource.  Each quantile is the lower
+// bound of a range of durations within 5% of each other.
+struct ResourceLatency {
+  std::string service;
+  std::string resource;
+  // The number of durations that the quantiles are computed from.  Older
+  // durations count for less than recent ones, so this is not the number of
+  // spans that finished.
+  std::uint32_t count = 0;
+  std::uint64_t p50_nanoseconds = 0;
+  std::uint64_t p90_nanoseconds = 0;
+  std::uint64_t p99_nanoseconds = 0;
+};
+
+// `DeliveryLatency` describes how long the trace chunks that the collector sent
+// recently took, by the tracer's clock, between two stages of their delivery.
+// Each quantile is the lower bound of a range of durations within 5% of each
+// other.
+struct DeliveryLatency {
+  // The number of durations that the quantiles are computed from.  Older
+  // durations count for less than recent ones, so this is not the number of
+  // chunks sent.
+  std::uint32_t count = 0;
+  std::uint64_t p50_nanoseconds = 0;
+  std::uint64_t p90_nanoseconds = 0;
+  std::uint64_t p99_nanoseconds = 0;
+};
+
+struct RuntimeStats {
+  // The number of trace segments created by the tracer that have not yet been
+  // destroyed, i.e. that have spans that are not yet finished or that are
+  // still referred to.
+  std::size_t live_trace_segments = 0;
+  // The number of trace chunks that the collector has buffered and not yet
+  // sent.
+  std::size_t buffered_trace_chunks = 0;
+  // The estimated encoded size, in bytes, of `buffered_trace_chunks`.
+  std::size_t buffered_bytes = 0;
+  // The number of requests that the collector has sent and for which it has
+  // not yet received a response or an error.
+  std::size_t in_flight_requests = 0;
+  // The number of trace chunks that the collector dropped, since it was
+  // created, because its buffer was full.
+  std::uint64_t dropped_trace_chunks = 0;
+  // Of `dropped_trace_chunks`, the number whose trace was dropped by
+  // sampling, whose trace was kept but neither by the user nor for an error,
+  // and whose trace was kept by the user or that contain an error.  When the
+  // buffer is full, the collector drops chunks in that order.
+  std::uint64_t dropped_sampled_out_trace_chunks = 0;
+  std::uint64_t dropped_kept_trace_chunks = 0;
+  std::uint64_t dropped_protected_trace_chunks = 0;
+  // The number of trace segments whose spans were sent before they all
+  // finished, since the tracer was created, because the segments outlived
+  // `TracerConfig::orphaned_segment_max_age_seconds`, and the estimated
+  // encoded size, in bytes, of their spans.
+  std::uint64_t orphaned_trace_segments = 0;
+  std::uint64_t orphaned_bytes = 0;
+  // The estimated encoded size, in bytes, of the trace data held by the
+  // tracer, as counted against `TracerConfig::max_memory_bytes`, or zero if
+  // that is not limited.
+  std::size_t memory_bytes = 0;
+  // The share of the traces kept by the trace sampler that are not dropped
+  // to keep the tracer within `TracerConfig::max_cpu_overhead`, or one if
+  // that is not limited.
+  double overhead_keep_rate = 1;
+  // The latencies of the resources whose local root spans finished most
+  // recently, the most recent first.
+  std::vector<ResourceLatency> resource_latencies;
+  // How long trace chunks took from when their last span finished to when the
+  // collector buffered them, from then to when they were encoded in a request,
+  // and from then to when the Datadog Agent acknowledged the request, and how
+  // long they took in all.  Measured only by the Datadog Agent collector.
+  DeliveryLatency finish_to_enqueue;
+  DeliveryLatency enqueue_to_encode;
+  DeliveryLatency encode_to_ack;
+  DeliveryLatency finish_to_ack;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -4,6 +4,8 @@
 // keep/drop sampling decision (for either trace sampling or span sampling) and
 // contains supporting information about the reason for the decision.
 
+#include <cstdint>
+
 #include "optional.h"
 #include "rate.h"
 
@@ -41,6 +43,14 @@ struct SamplingDecision {
   Optional<double> limiter_max_per_second;
   // The provenance of this decision.
   Origin origin;
+  // Whether the trace would have been kept, but was dropped by this tracer to
+  // keep its CPU overhead within its budget (see
+  // `TracerConfig::max_cpu_overhead`).
+  bool overhead_regulated = false;
+  // The stratum, i.e. the hash of the service and resource, of the root span
+  // whose sample rate was computed by stratified sampling (see
+  // `TraceSamplerConfig::stratified_target_per_second`), if any.
+  Optional<std::uint64_t> stratum;
 };
 
 }  // namespace tracing
@@ -0,0 +1,76 @@
+#pragma once
+
+// This component provides a class, `Scope`, that makes a `Span` the _active_
+// span of the current thread for the lifetime of the `Scope`.
+//
+// Integrations that would otherwise pass a `Span&` through every layer of a
+// call stack can instead activate the span once, near the top:
+//
+//     auto span = tracer.create_span(config);
+//     Scope scope{span};
+//     ...
+//     // somewhere further down the stack
+//     if (Span* parent = Scope::active_span()) {
+//       auto child = parent->create_child(child_config);
+//     }
+//
+// The scopes of a thread form a stack.  Each `Scope` is a node of the stack,
+// so activating a span allocates nothing, and deactivating it is done by the
+// `Scope`'s destructor.  Scopes must be destroyed in the reverse order of
+// their construction on a thread, which is the usual order of automatic
+// variables.
+//
+// Runtimes that run fibers or coroutines on a thread, and that suspend them
+// while their scopes are alive, switch stacks using `Scope::exchange_current`:
+// when a task is suspended, the runtime saves the task's innermost scope and
+// restores the scope that was current before the task was resumed; when the
+// task is resumed, the runtime restores the task's saved scope.  Each switch
+// is a pointer swap.
+//
+// Whenever the innermost scope of a thread changes, the IDs of its span are
+// published to the thread's `ProfilingContext` for a continuous profiler (see
+// `profiling_context.h`).
+
+#include "span.h"
+
+namespace datadog {
+namespace tracing {
+
+class Scope {
+  Span* span_;
+  Scope* parent_;
+
+ public:
+  // Make the specified `span` the active span of the current thread until
+  // this object is destroyed.  The behavior is undefined unless `span`
+  // outlives this object.
+  explicit Scope(Span& span) noexcept;
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+  // Make the span that was active when this object was created active again.
+  // The behavior is undefined unless this object is the current thread's
+  // innermost scope.
+  ~Scope();
+
+  // Return the span that this scope activates.
+  Span& span() const noexcept;
+  // Return the scope that was innermost when this object was created, or
+  // return null if there was none.
+  Scope* parent() const noexcept;
+
+  // Return the current thread's innermost scope, or return null if the
+  // thread has no scopes.
+  static Scope* current() noexcept;
+  // Return the span of the current thread's innermost scope, or return null
+  // if the thread has no scopes.
+  static Span* active_span() noexcept;
+  // Make the specified `scope`, which may be null, the current thread's
+  // innermost scope, and return the scope that was innermost previously.
+  // This is for runtimes that suspend and resume tasks on a thread while the
+  // tasks have scopes (see above).
+  static Scope* exchange_current(Scope* scope) noexcept;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,80 @@
+#pragma once
+
+// This component provides a class, `SharedSamplerState`, that is the state of
+// trace sampling in memory shared among processes.
+//
+// Servers such as nginx and Apache httpd fork worker processes, each of which
+// has its own `Tracer`, and so its own trace sampler.  Ordinarily, each
+// worker then keeps up to `TraceSamplerConfig::max_per_second` traces per
+// second, so that together the workers keep that many times the number of
+// workers, and each worker learns the Datadog Agent's sample rates only from
+// the responses to its own requests.  Instead, a `SharedSamplerState` can be
+// created in the parent process before it forks the workers, and then
+// specified as `TraceSamplerConfig::shared_state` in each worker.  The
+// workers' trace samplers then share one token bucket, so that together they
+// keep up to `max_per_second` traces per second, and the sample rates that
+// any worker receives from the Datadog Agent are published to the others.
+//
+// The workers must be configured with the same `max_per_second`.  The trace
+// sampler of a worker configured otherwise keeps its own token bucket.
+//
+// `SharedSamplerState` is not available on Windows, which does not have
+// `fork`.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "expected.h"
+#include "rate.h"
+
+namespace datadog {
+namespace tracing {
+
+struct SharedLimiterBucket;
+
+class SharedSamplerState {
+  struct Header;
+  Header* header_;
+
+  explicit SharedSamplerState(Header* header);
+
+ public:
+  // The most bytes of sample rates that can be published.  Each rate takes
+  // twelve bytes more than its key.
+  static constexpr std::size_t rates_capacity = 64 * 1024;
+
+  // Return a state shared with the processes that are forked afterward, or
+  // return an error if the memory cannot be shared.
+  static Expected<std::shared_ptr<SharedSamplerState>> create();
+
+  ~SharedSamplerState();
+
+  SharedSamplerState(const SharedSamplerState&) = delete;
+  SharedSamplerState& operator=(const SharedSamplerState&) = delete;
+
+  // Return the token bucket shared by the trace samplers.
+  SharedLimiterBucket& limiter_bucket();
+
+  // Replace the published sample rates with the specified `rates`, keyed as
+  // in `CollectorResponse`.  Return false, and publish nothing, if the rates
+  // are larger than `rates_capacity`.
+  bool publish_rates(const std::unordered_map<std::string, Rate>& rates);
+
+  // Return a number that changes each time rates are published, or zero if
+  // none have been.  This function does not lock, and is cheap enough to
+  // call for every sampling decision.
+  std::uint64_t rates_version() const;
+
+  // Assign the published sample rates to the specified `rates`, and their
+  // version (see `rates_version`) to the specified `version`.  Return false,
+  // and assign nothing, if no rates have been published, or if they could
+  // not be read because they are being replaced.
+  bool read_rates(std::unordered_map<std::string, Rate>& rates,
+                  std::uint64_t& version) const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,84 @@
+#pragma once
+
+// This component provides a class, `SharedTraceBuffer`, that is a buffer of
+// encoded trace chunks in memory shared among processes.
+//
+// Servers such as nginx and Apache httpd fork worker processes, each of which
+// has its own `Tracer`.  Ordinarily, each worker then sends its own traces to
+// the Datadog Agent.  Instead, a `SharedTraceBuffer` can be created in the
+// parent process before it forks the workers, and then specified as
+// `DatadogAgentConfig::shared_trace_buffer` in each worker.  Each worker
+// writes its trace chunks to the buffer, and only one of the workers, elected
+// among those that are using the buffer, sends them to the Datadog Agent.
+// When the elected worker exits, another is elected in its place.
+//
+// The buffer is a ring of records, each of which is a trace chunk encoded in
+// the MessagePack format of the v0.4 traces API.  If the buffer is full, then
+// a chunk written to it is dropped.
+//
+// `SharedTraceBuffer` is not available on Windows, which does not have
+// `fork`.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "expected.h"
+#include "string_view.h"
+
+namespace datadog {
+namespace tracing {
+
+class SharedTraceBuffer {
+  struct Header;
+  Header* header_;
+  std::size_t mapped_size_;
+
+  SharedTraceBuffer(Header* header, std::size_t mapped_size);
+
+  // Lock the buffer on behalf of this process.  If the process that held the
+  // lock exited without releasing it, then discard the buffer's records,
+  // which might be incomplete.
+  void lock();
+  void unlock();
+
+ public:
+  // Return a buffer that can hold the specified `capacity` bytes of records,
+  // shared with the processes that are forked afterward, or return an error
+  // if the memory cannot be shared.
+  static Expected<std::shared_ptr<SharedTraceBuffer>> create(
+      std::size_t capacity);
+
+  ~SharedTraceBuffer();
+
+  SharedTraceBuffer(const SharedTraceBuffer&) = delete;
+  SharedTraceBuffer& operator=(const SharedTraceBuffer&) = delete;
+
+  // Append a copy of the specified `record` to the buffer.  Return whether
+  // there was room for it.
+  bool push(StringView record);
+
+  // Remove the oldest record from the buffer and assign it to the specified
+  // `record`.  Return whether there was a record to remove.
+  bool pop(std::string& record);
+
+  // Try to become the process that sends the buffer's records to the Datadog
+  // Agent.  Return true if this process is, or has now become, that process.
+  // Return false if another running process is.
+  bool try_become_drainer();
+
+  // If this process is the one that sends the buffer's records, then stop
+  // being that process, so that another can be elected.
+  void resign_drainer();
+
+  // Return the number of bytes of records that the buffer can hold.
+  std::size_t capacity() const;
+
+  // Return the number of records that were dropped because the buffer was
+  // full, by any of the processes sharing it.
+  std::uint64_t dropped() const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
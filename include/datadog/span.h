@@ -37,16 +37,31 @@
 // If an error occurs during the operation that a span represents, the error can
 // be noted in the span via the `set_error` family of member functions.
 //
+// A `Span` cannot be copied.  Children of a `Span` can nonetheless be created
+// elsewhere, such as on another thread, from the copyable `SpanContext` that
+// `Span::context` returns.
+//
 // A `Span` is finished when it is destroyed.  The end time can be overridden
 // via the `set_end_time` member function prior to the span's destruction.
+//
+// A child `Span` created in a trace segment that will be dropped is not
+// recorded if the segment says so (see `TraceSegment::skips_new_spans`), as
+// while traces are not reported.  Such a span has IDs for trace context
+// propagation, but no other properties: setting its tags, names, links, and
+// events has no effect.  It is discarded when it is finished.
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <initializer_list>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "clock.h"
 #include "optional.h"
+#include "span_schema.h"
 #include "string_view.h"
 #include "trace_id.h"
 #include "trace_source.h"
@@ -54,30 +69,44 @@
 namespace datadog {
 namespace tracing {
 
+class Arena;
 struct InjectionOptions;
 class DictReader;
 class DictWriter;
 struct SpanConfig;
+struct SpanConfigView;
+class SpanContext;
 struct SpanData;
+struct SpanEvent;
+struct SpanLink;
 class TraceSegment;
 
 class Span {
+  friend class SpanContext;
+
+  // A `Span` is a handle that is cheap to move: the clock and the ID
+  // generator are reached through `trace_segment_`, and an end time set by
+  // `set_end_time` is kept as the duration in `data_`.
   std::shared_ptr<TraceSegment> trace_segment_;
   SpanData* data_;
-  std::function<std::uint64_t()> generate_span_id_;
-  Clock clock_;
-  Optional<std::chrono::steady_clock::time_point> end_time_;
+  std::size_t segment_index_;
+  // Whether this span is not recorded, in which case it owns `data_`, which
+  // is not registered with `trace_segment_`.
+  bool unrecorded_ = false;
+  // Whether `set_end_time` was called.
+  bool has_end_time_ = false;
 
  public:
-  // Create a span whose properties are stored in the specified `data`, that is
-  // associated with the specified `trace_segment`, that uses the specified
-  // `generate_span_id` to generate IDs of child spans, and that uses the
-  // specified `clock` to determine start and end times.
-  Span(SpanData* data, const std::shared_ptr<TraceSegment>& trace_segment,
-       const std::function<std::uint64_t()>& generate_span_id,
-       const Clock& clock);
+  // Create a span whose properties are stored in the specified `data`, and
+  // that is associated with the specified `trace_segment`.  The start and end
+  // times are determined by the clock of `trace_segment`, and the IDs of
+  // child spans are generated by `trace_segment`.  Optionally specify the
+  // `segment_index` returned by `TraceSegment::register_span` for `data`.  The
+  // local root span of a segment has index zero.
+  Span(SpanData* data, std::shared_ptr<TraceSegment> trace_segment,
+       std::size_t segment_index = 0);
   Span(const Span&) = delete;
-  Span(Span&&) = default;
+  Span(Span&&);
   Span& operator=(Span&&) = delete;
   Span& operator=(const Span&) = delete;
 
@@ -95,8 +124,25 @@ class Span {
   // is related.  The child span's start time is the current time unless
   // overridden in `config`.
   Span create_child(const SpanConfig& config) const;
+  Span create_child(const SpanConfigView& config) const;
   Span create_child() const;
 
+  // Return the specified `count` children of this span, as `create_child`
+  // would, but created together, e.g. for the queries of a request that
+  // fans out to many shards.  The children's IDs are generated in one call,
+  // the children are registered with the trace segment at once, and they
+  // have the same start time unless `config` overrides it.
+  std::vector<Span> create_children(std::size_t count,
+                                    const SpanConfig& config) const;
+  std::vector<Span> create_children(std::size_t count,
+                                    const SpanConfigView& config) const;
+  std::vector<Span> create_children(std::size_t count) const;
+
+  // Return a copyable handle to this span, from which children of this span
+  // can be created, such as on another thread.  The trace segment is not
+  // complete while the handle exists (see `SpanContext`).
+  SpanContext context() const;
+
   // Return this span's ID (span ID).
   std::uint64_t id() const;
   // Return the ID of the trace of which this span is a part.
@@ -130,9 +176,57 @@ class Span {
   // Overwrite the tag having the specified `name` so that it has the specified
   // `value`, or create a new tag.
   void set_tag(StringView name, StringView value);
+  // Overwrite the tag having the specified `name` so that it has the decimal
+  // representation of the specified integer `value`, or "true" or "false" if
+  // `value` is a `bool`, or create a new tag.  The value is formatted directly
+  // into the tag's storage, which for most integers, such as HTTP status
+  // codes and ports, does not allocate.
+  template <typename Integer,
+            typename = std::enable_if_t<std::is_integral<Integer>::value &&
+                                        !std::is_same<Integer, char>::value>>
+  void set_tag(StringView name, Integer value) {
+    if constexpr (std::is_same<Integer, bool>::value) {
+      set_tag(name, value ? StringView("true") : StringView("false"));
+    } else if constexpr (std::is_signed<Integer>::value) {
+      set_integer_tag(name, std::int64_t(value));
+    } else {
+      set_integer_tag(name, std::uint64_t(value));
+    }
+  }
   // Overwrite the metric having the specified `name` so that it has the
   // specified `value`, or create a new metric.
   void set_metric(StringView name, double value);
+  // Set each of the specified `tags`, in order, as `set_tag` would.  Room for
+  // the new tags is made once, rather than as each is set.
+  void set_tags(std::initializer_list<std::pair<StringView, StringView>> tags);
+  // Set each of the set slots of the specified `tags` as `set_tag` would (see
+  // `span_schema.h`).  If this span has no tags yet, then the tags are
+  // appended without looking for existing tags of the same names.
+  template <typename Schema>
+  void set_tags(const SchemaTags<Schema>& tags) {
+    set_schema_tags(Schema::keys, tags.values(), tags.present());
+  }
+  // Set each of the specified `metrics`, in order, as `set_metric` would.
+  // Room for the new metrics is made once, rather than as each is set.
+  void set_metrics(
+      std::initializer_list<std::pair<StringView, double>> metrics);
+  // Add to this span a link to the span described by the specified `link`,
+  // such as a message producer's span that was extracted by a consumer.
+  void add_link(SpanLink link);
+  // Add to this span a link to the specified `other` span, having the
+  // optionally specified `attributes`.  The link's flags indicate whether
+  // `other`'s trace is sampled, if that has been decided.
+  void add_link(
+      const Span& other,
+      std::initializer_list<std::pair<StringView, StringView>> attributes = {});
+  // Add to this span the specified `event`, such as an exception that was
+  // handled or a retried attempt.
+  void add_event(SpanEvent event);
+  // Add to this span an event having the specified `name` and the optionally
+  // specified `attributes` that happens now.
+  void add_event(
+      StringView name,
+      std::initializer_list<std::pair<StringView, StringView>> attributes = {});
   // Delete the tag having the specified `name` if it exists.
   void remove_tag(StringView name);
   // Delete the metric having the specified `name` if it exists.
@@ -160,6 +254,17 @@ class Span {
   // Associate a call stack with the error that occurred during the extent of
   // this span.  This also has the effect of calling `set_error(true)`.
   void set_error_stack(StringView);
+  // Associate the calling thread's current call stack with the error that
+  // occurred during the extent of this span.  This also has the effect of
+  // calling `set_error(true)`.  Only the stack's return addresses are
+  // recorded now.  They are symbolized when the span is sent, on the thread
+  // that sends it.  A call stack set by `set_error_stack` takes precedence.
+  void capture_error_stack();
+  // Set a tag for each of the specified response `headers` named by
+  // `TracerConfig::header_tags`.  The headers are visited once, if `headers`
+  // prefers that (see `DictReader::prefers_visit`), or otherwise each
+  // configured header is looked up in them.
+  void set_response_header_tags(const DictReader& headers);
   // Set end time of this span.  Doing so will override the default behavior of
   // using the current time in the destructor.
   void set_end_time(std::chrono::steady_clock::time_point);
@@ -171,11 +276,53 @@ class Span {
   void inject(DictWriter& writer) const;
   void inject(DictWriter& writer, const InjectionOptions& options) const;
 
+  // `Injection` is a span and the writer into which its trace context is
+  // injected.
+  struct Injection {
+    const Span* span;
+    DictWriter* writer;
+  };
+
+  // Write information about each span in the specified `injections` and its
+  // trace into the span's writer, as `inject` does.  This is useful when a
+  // span has many children that call other services, such as when a request
+  // fans out.  Consecutive spans of the same trace segment are injected
+  // together, so that the segment is locked once and the trace context that
+  // they share is encoded once.
+  static void inject_all(const std::vector<Injection>& injections);
+
   // Return a reference to this span's trace segment.  The trace segment has
   // member functions that affect the trace as a whole, such as
   // `TraceSegment::override_sampling_priority`.
   TraceSegment& trace_segment();
   const TraceSegment& trace_segment() const;
+
+ private:
+  void set_integer_tag(StringView name, std::int64_t value);
+  void set_integer_tag(StringView name, std::uint64_t value);
+  // Set the tag named by each of the specified `keys` whose bit is set in the
+  // specified `present` to the corresponding element of `values`.  The keys
+  // are distinct.
+  void set_schema_tags(const StringView* keys, const StringView* values,
+                       std::uint32_t present);
+
+  // Return a child, within the specified `trace_segment`, of the span having
+  // the specified `trace_id` and `parent_id`, whose data is allocated from the
+  // specified `arena`, or from the global heap if `arena` is null.  `Config`
+  // is either `SpanConfig` or `SpanConfigView`.
+  template <typename Config>
+  static Span create_child_with_config(
+      const std::shared_ptr<TraceSegment>& trace_segment, TraceID trace_id,
+      std::uint64_t parent_id, Arena* arena, const Config& config);
+  // `Config` is either `SpanConfig` or `SpanConfigView`.
+  template <typename Config>
+  std::vector<Span> create_children_with_config(std::size_t count,
+                                                const Config& config) const;
+  // These are the implementation of `SpanContext::create_child`.
+  static Span create_child_of(const SpanContext& parent,
+                              const SpanConfig& config);
+  static Span create_child_of(const SpanContext& parent,
+                              const SpanConfigView& config);
 };
 
 }  // namespace tracing
@@ -6,18 +6,32 @@
 //
 // - `Tracer::create_span`
 // - `Tracer::extract_span`
+// - `Tracer::extract_or_create_span`
 // - `Span::create_child`
 //
 // `SpanConfig` contains much of the same information as `SpanDefaults`, but the
 // two types have different purposes. `SpanDefaults` are the properties used
 // when no corresponding property is specified in a `SpanConfig` argument.
 // See `SpanData::apply_config`.
+//
+// This component also provides a `struct`, `SpanConfigView`, that specifies
+// the same properties as `SpanConfig` without owning them.  Each of the member
+// functions above also accepts a `SpanConfigView`.  Building a `SpanConfig`
+// from string literals or other strings allocates copies of them, which the
+// new span then copies again.  The strings referred to by a `SpanConfigView`
+// are instead copied only once, into the new span.  The strings, and the tags,
+// referred to by a `SpanConfigView` must remain valid until the span is
+// created, but not afterward.
 
+#include <cstddef>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "clock.h"
 #include "optional.h"
+#include "string_view.h"
 
 namespace datadog {
 namespace tracing {
@@ -33,5 +47,38 @@ struct SpanConfig {
   std::unordered_map<std::string, std::string> tags;
 };
 
+struct SpanConfigView {
+  using Tag = std::pair<StringView, StringView>;
+
+  // `Tags` is a sequence of tags stored elsewhere, such as in an array or a
+  // `std::vector`.  If a tag name appears more than once, then the last
+  // occurrence wins.
+  class Tags {
+    const Tag* begin_ = nullptr;
+    const Tag* end_ = nullptr;
+
+   public:
+    Tags() = default;
+    Tags(const Tag* tags, std::size_t size) : begin_(tags), end_(tags + size) {}
+    template <std::size_t size>
+    Tags(const Tag (&tags)[size]) : Tags(tags, size) {}
+    Tags(const std::vector<Tag>& tags) : Tags(tags.data(), tags.size()) {}
+
+    const Tag* begin() const { return begin_; }
+    const Tag* end() const { return end_; }
+    std::size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+  };
+
+  Optional<StringView> service;
+  Optional<StringView> service_type;
+  Optional<StringView> version;
+  Optional<StringView> environment;
+  Optional<StringView> name;
+  Optional<StringView> resource;
+  Optional<TimePoint> start;
+  Tags tags;
+};
+
 }  // namespace tracing
 }  // namespace datadog
@@ -0,0 +1,72 @@
+#pragma once
+
+// This component provides a class, `SpanContext`, that identifies a `Span`
+// within its trace segment, so that children of the span can be created
+// elsewhere in the process, such as on another thread.
+//
+// `SpanContext` is obtained from `Span::context`.  Unlike `Span`, it is
+// copyable, and copying it copies a `std::shared_ptr` and two words.  It is
+// meant to be handed to a thread pool or to a callback along with the work
+// that the span represents.  Children created from a `SpanContext` belong to
+// the same `TraceSegment` as the span, as if they were created by
+// `Span::create_child`.  Nothing is serialized, unlike with `Span::inject`
+// and `Tracer::extract_span`.
+//
+// A `SpanContext` does not keep its span from finishing, but it does keep the
+// span's trace segment from completing, as an unfinished span would, until
+// the last copy of it is destroyed.  Children may thus be created from a
+// `SpanContext` even after its span has finished.  A `SpanContext` ought not
+// to be kept longer than the work that was handed off, since the segment is
+// not sent until then.
+
+#include <cstdint>
+#include <memory>
+
+#include "trace_id.h"
+
+namespace datadog {
+namespace tracing {
+
+class Arena;
+class Span;
+struct SpanConfig;
+struct SpanConfigView;
+class TraceSegment;
+
+class SpanContext {
+  friend class Span;
+
+  // Counts as an unfinished span of the trace segment, and holds a reference
+  // to the arena from which the span's data was allocated, if any, for as
+  // long as it lives.  Shared by the copies of this object.
+  struct Hold;
+  std::shared_ptr<const Hold> hold_;
+  TraceID trace_id_;
+  std::uint64_t span_id_;
+
+  SpanContext(std::shared_ptr<TraceSegment> trace_segment, TraceID trace_id,
+              std::uint64_t span_id, Arena* arena);
+
+  // Return the span's trace segment.
+  const std::shared_ptr<TraceSegment>& segment() const;
+  // Return the arena from which the span's data was allocated, or null.
+  Arena* arena() const;
+
+ public:
+  // Return a span that is a child of the span that this object identifies,
+  // as `Span::create_child` would, whether or not that span has finished.
+  Span create_child(const SpanConfig& config) const;
+  Span create_child(const SpanConfigView& config) const;
+  Span create_child() const;
+
+  // Return the ID of the span that this object identifies.
+  std::uint64_t id() const;
+  // Return the ID of the trace of which the span is a part.
+  TraceID trace_id() const;
+
+  // Return a reference to the span's trace segment.
+  TraceSegment& trace_segment() const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
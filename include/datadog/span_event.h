@@ -0,0 +1,27 @@
+#pragma once
+
+// This component provides a `struct`, `SpanEvent`, that is something that
+// happened at a point in time during a span, such as an exception that was
+// handled or an attempt that was retried.
+//
+// Events are added to a span using `Span::add_event`, and are sent to the
+// Datadog Agent with the span.
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+struct SpanEvent {
+  std::string name;
+  // When the event happened.
+  std::chrono::system_clock::time_point time;
+  // Attributes of the event, such as an exception's message.
+  std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,36 @@
+#pragma once
+
+// This component provides a `struct`, `SpanLink`, that refers from one span to
+// another span, which may be in a different trace.
+//
+// A span has a parent, which is in the same trace, and any number of links.
+// For example, a span that processes a batch of messages can link to the span
+// that produced each message.  Links are added to a span using
+// `Span::add_link`, and are sent to the Datadog Agent with the span.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "optional.h"
+#include "trace_id.h"
+
+namespace datadog {
+namespace tracing {
+
+struct SpanLink {
+  // The trace ID and span ID of the linked span.
+  TraceID trace_id;
+  std::uint64_t span_id = 0;
+  // The W3C trace flags of the linked span, e.g. 1 if it was sampled, if
+  // known.
+  Optional<std::uint32_t> flags;
+  // The W3C "tracestate" of the linked span, or empty if unknown.
+  std::string tracestate;
+  // Attributes of the link itself, such as the reason for it.
+  std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+}  // namespace tracing
+}  // namespace datadog
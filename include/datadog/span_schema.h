@@ -0,0 +1,202 @@
+#pragma once
+
+// This component provides a class template, `SchemaTags`, with which an
+// integration sets the tags that it sets on every span, e.g. the method, URL,
+// and status code of an HTTP request, without looking up or formatting tag
+// names.
+//
+// A span schema is a type that declares, at compile time, the names of the
+// tags in `keys` and an enumeration of their slots:
+//
+//     struct QueueSchema {
+//       static constexpr StringView keys[] = {"component", "queue.name"};
+//       enum Slot : std::size_t { COMPONENT, QUEUE_NAME };
+//     };
+//
+// `SchemaTags<QueueSchema>` then has one typed slot per key, which the
+// integration fills by slot, and `Span::set_tags` sets the filled slots on a
+// span at once:
+//
+//     SchemaTags<QueueSchema> tags;
+//     tags.set<QueueSchema::COMPONENT>("my-queue-client");
+//     tags.set<QueueSchema::QUEUE_NAME>(queue_name);
+//     span.set_tags(tags);
+//
+// The keys of a schema are checked when `SchemaTags` is instantiated: there
+// must be at least one and at most `max_schema_keys`, none empty, and no two
+// equal.  Because the keys are known to be distinct, `Span::set_tags` appends
+// them to a span that has no tags yet without looking for existing tags of
+// the same names, and makes room for them once.
+//
+// Other tags are set with `Span::set_tag`, as usual, and a schema's tags can
+// be overwritten or removed that way too.  Schemas for HTTP servers and
+// clients, gRPC, and databases are provided below.
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+#include "string_view.h"
+
+namespace datadog {
+namespace tracing {
+
+// The most keys that a span schema can have.
+constexpr std::size_t max_schema_keys = 32;
+
+namespace schema_detail {
+
+constexpr bool equal(StringView left, StringView right) {
+  if (left.size() != right.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    if (left[i] != right[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Return whether each of the specified `keys` is not empty and differs from
+// the others.
+template <std::size_t size>
+constexpr bool valid_keys(const StringView (&keys)[size]) {
+  for (std::size_t i = 0; i < size; ++i) {
+    if (keys[i].empty()) {
+      return false;
+    }
+    for (std::size_t j = 0; j < i; ++j) {
+      if (equal(keys[i], keys[j])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace schema_detail
+
+template <typename Schema>
+class SchemaTags {
+ public:
+  static constexpr std::size_t size = std::size(Schema::keys);
+  static_assert(size >= 1 && size <= max_schema_keys,
+                "A span schema has between 1 and 32 keys.");
+  static_assert(schema_detail::valid_keys(Schema::keys),
+                "The keys of a span schema are not empty, and are distinct.");
+
+  // Set the tag of the specified `slot` to the specified `value`.  `value`
+  // is referred to, not copied, so it must outlive the call to
+  // `Span::set_tags` that sets it.
+  template <std::size_t slot>
+  void set(StringView value) {
+    static_assert(slot < size, "The slot is not one of the schema's.");
+    values_[slot] = value;
+    present_ |= std::uint32_t(1) << slot;
+  }
+
+  // Set the tag of the specified `slot` to the decimal representation of the
+  // specified integer `value`, which is formatted into this object.
+  template <std::size_t slot, typename Integer,
+            typename = std::enable_if_t<std::is_integral<Integer>::value &&
+                                        !std::is_same<Integer, bool>::value &&
+                                        !std::is_same<Integer, char>::value>>
+  void set(Integer value) {
+    static_assert(slot < size, "The slot is not one of the schema's.");
+    char* const begin = digits_[slot];
+    const auto result = std::to_chars(begin, begin + sizeof digits_[slot],
+                                      value);
+    set<slot>(StringView(begin, std::size_t(result.ptr - begin)));
+  }
+
+  // Unset the tag of the specified `slot`.
+  template <std::size_t slot>
+  void clear() {
+    static_assert(slot < size, "The slot is not one of the schema's.");
+    present_ &= ~(std::uint32_t(1) << slot);
+  }
+
+  // Return whether the tag of the specified `slot` is set.
+  template <std::size_t slot>
+  bool has() const {
+    static_assert(slot < size, "The slot is not one of the schema's.");
+    return present_ & (std::uint32_t(1) << slot);
+  }
+
+  const StringView* values() const { return values_; }
+  // Return the set slots, where bit `i` stands for slot `i`.
+  std::uint32_t present() const { return present_; }
+
+ private:
+  StringView values_[size] = {};
+  std::uint32_t present_ = 0;
+  // Enough for any 64-bit integer, including its sign.
+  char digits_[size][20];
+};
+
+struct HttpServerSchema {
+  static constexpr StringView keys[] = {
+      "component",   "span.kind",        "http.method",   "http.url",
+      "http.route",  "http.status_code", "http.useragent"};
+  enum Slot : std::size_t {
+    COMPONENT,
+    SPAN_KIND,
+    METHOD,
+    URL,
+    ROUTE,
+    STATUS_CODE,
+    USER_AGENT
+  };
+};
+
+struct HttpClientSchema {
+  static constexpr StringView keys[] = {
+      "component",        "span.kind", "http.method",
+      "http.url",         "http.status_code", "out.host",
+      "network.destination.port"};
+  enum Slot : std::size_t {
+    COMPONENT,
+    SPAN_KIND,
+    METHOD,
+    URL,
+    STATUS_CODE,
+    HOST,
+    PORT
+  };
+};
+
+struct GrpcSchema {
+  static constexpr StringView keys[] = {
+      "component",   "span.kind",  "rpc.system",
+      "rpc.service", "rpc.method", "rpc.grpc.status_code"};
+  enum Slot : std::size_t {
+    COMPONENT,
+    SPAN_KIND,
+    SYSTEM,
+    SERVICE,
+    METHOD,
+    STATUS_CODE
+  };
+};
+
+struct DatabaseSchema {
+  static constexpr StringView keys[] = {
+      "component", "span.kind", "db.system",
+      "db.name",   "db.user",   "out.host",
+      "network.destination.port"};
+  enum Slot : std::size_t {
+    COMPONENT,
+    SPAN_KIND,
+    SYSTEM,
+    NAME,
+    USER,
+    HOST,
+    PORT
+  };
+};
+
+}  // namespace tracing
+}  // namespace datadog
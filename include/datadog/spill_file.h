@@ -0,0 +1,83 @@
+#pragma once
+
+// This component provides a class, `SpillFile`, that is a bounded buffer of
+// trace payloads in a memory-mapped file.
+//
+// When the Datadog Agent cannot be reached, a `DatadogAgent` keeps the
+// payloads that it failed to send in memory, up to
+// `DatadogAgentConfig::retry_budget_bytes`, and retries them a few times
+// (see `DatadogAgentConfig::max_retries`).  If a `SpillFile` is specified as
+// `DatadogAgentConfig::spill_file`, then the payloads that would otherwise be
+// dropped are appended to the file instead, and are sent again, oldest first,
+// once the Datadog Agent responds again.  The payloads that are still waiting
+// to be sent again when the tracer shuts down are appended to the file too,
+// and are sent by the next process that opens it.
+//
+// The file is a ring of records, as in `shared_trace_buffer.h`.  The file's
+// size is fixed when it is opened, and so it does not grow during a long
+// outage: if a record does not fit, then the oldest records are removed to
+// make room for it.  Processes that open the same file, or that are forked
+// after it is opened, share its records.
+//
+// `SpillFile` is not available on Windows.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "expected.h"
+#include "string_view.h"
+
+namespace datadog {
+namespace tracing {
+
+class SpillFile {
+  struct Header;
+  Header* header_;
+  std::size_t mapped_size_;
+
+  SpillFile(Header* header, std::size_t mapped_size);
+
+  // Lock the file on behalf of this process.  If the process that held the
+  // lock exited without releasing it, then discard the file's records, which
+  // might be incomplete.
+  void lock();
+  void unlock();
+
+ public:
+  // Return the buffer in the file at the specified `path`, which can hold the
+  // specified `capacity` bytes of records, or return an error if the file
+  // cannot be mapped.  The file is created if it does not exist.  The records
+  // already in the file are kept if it was last opened with the same
+  // `capacity`, and are discarded otherwise.
+  static Expected<std::shared_ptr<SpillFile>> open(const std::string& path,
+                                                   std::size_t capacity);
+
+  ~SpillFile();
+
+  SpillFile(const SpillFile&) = delete;
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  // Append a copy of the specified `record` to the file, first removing the
+  // oldest records if there is not room for it.  Return false if `record` is
+  // larger than the file's capacity, in which case it is dropped.
+  bool push(StringView record);
+
+  // Remove the oldest record from the file and assign it to the specified
+  // `record`.  Return whether there was a record to remove.
+  bool pop(std::string& record);
+
+  // Return whether the file holds no records.
+  bool empty();
+
+  // Return the number of bytes of records that the file can hold.
+  std::size_t capacity() const;
+
+  // Return the number of records that were dropped, because they did not fit,
+  // or to make room for others, since the file was created.
+  std::uint64_t dropped() const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
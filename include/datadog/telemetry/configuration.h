@@ -41,6 +41,13 @@ struct Configuration {
   // Can be overriden by the `DD_TELEMETRY_LOG_COLLECTION_ENABLED` environment
   // variable.
   tracing::Optional<bool> report_logs;
+  // Whether to gzip compress telemetry payloads of at least 1 KiB, and say so
+  // in the "Content-Encoding" request header. If the Datadog Agent rejects a
+  // compressed payload as an unsupported media type, then subsequent payloads
+  // are sent uncompressed. Compression requires that this library was built
+  // with zlib (see the `DD_TRACE_COMPRESSION` build option).
+  // Default: disabled.
+  tracing::Optional<bool> compression_enabled;
   // List of products reported in the `app-started` message.
   std::vector<Product> products;
 };
@@ -50,6 +57,7 @@ struct FinalizedConfiguration {
   bool enabled;
   bool report_metrics;
   bool report_logs;
+  bool compression_enabled;
   std::chrono::steady_clock::duration metrics_interval;
   std::chrono::steady_clock::duration heartbeat_interval;
   std::string integration_name;
@@ -1,15 +1,38 @@
 #pragma once
 
-#include <string>
+#include <datadog/string_view.h>
+
+#include <cstdint>
 
 namespace datadog {
 namespace telemetry {
 
 namespace details {
 enum class MetricType : char { counter, rate, distribution };
+
+/// Return the 64-bit FNV-1a hash of the specified metric identity. The hash
+/// is computed at compile time for metrics defined with `constexpr`.
+constexpr std::uint64_t metric_hash(MetricType type, tracing::StringView name,
+                                    tracing::StringView scope, bool common) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto mix = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+  mix(static_cast<unsigned char>(type));
+  for (const char c : name) mix(static_cast<unsigned char>(c));
+  // The separator distinguishes ("ab", "c") from ("a", "bc").
+  mix(0);
+  for (const char c : scope) mix(static_cast<unsigned char>(c));
+  mix(common);
+  return hash;
 }
+}  // namespace details
 
-/// TODO: pre-compute hash?
+/// A metric definition. Metrics are meant to be defined once, with string
+/// literals, as `constexpr` or `const` objects at namespace scope. The
+/// definition does not copy `name` and `scope`, which must outlive every use
+/// of the metric.
 template <details::MetricType T>
 struct Metric final {
   /// The type of the metric.
@@ -17,13 +40,23 @@ struct Metric final {
   /// The name of the metric that will be published. A transformation occurs
   /// based on the name and whether it is "common" or "language-specific" when
   /// it is recorded.
-  std::string name;
+  tracing::StringView name;
   /// Namespace of the metric.
-  std::string scope;
+  tracing::StringView scope;
   /// This affects the transformation of the metric name, where it can be a
   /// common telemetry metric, or a language-specific metric that is prefixed
   /// with the language name.
   bool common;
+  /// Hash of the type, name, scope and common flag, so that recording the
+  /// metric does not hash its strings.
+  std::uint64_t hash;
+
+  constexpr Metric(tracing::StringView name, tracing::StringView scope,
+                   bool common)
+      : name(name),
+        scope(scope),
+        common(common),
+        hash(details::metric_hash(T, name, scope, common)) {}
 };
 
 using Counter = Metric<details::MetricType::counter>;
@@ -9,6 +9,9 @@
 #include <datadog/telemetry/metrics.h>
 #include <datadog/tracer_signature.h>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -91,6 +94,83 @@ void error(std::string message, std::string stacktrace);
 /// processed every 10 seconds.
 namespace counter {
 
+/// A `ShardedValue` is the value of a counter that is incremented through
+/// handles. The value is split into shards, each on its own cache line, so
+/// that threads incrementing the counter concurrently do not contend for one
+/// cache line. Each thread increments the shard selected by
+/// `ShardedValue::this_thread_shard`, and the value is the sum of the shards.
+/// Since shards belong to the counter rather than to threads, nothing needs
+/// to be cleaned up when a thread exits.
+class ShardedValue final {
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+  std::size_t mask_;
+
+  // Returns the shard index of a thread that has not yet been assigned one.
+  static std::size_t next_thread_shard();
+
+ public:
+  /// Creates a value of zero having one shard per hardware thread, rounded up
+  /// to a power of two, and at most 64 shards.
+  ShardedValue();
+
+  /// Returns the index, modulo the number of shards, of the shard incremented
+  /// by the calling thread. Threads are assigned indices in turn.
+  static std::size_t this_thread_shard() {
+    thread_local const std::size_t shard = next_thread_shard();
+    return shard;
+  }
+
+  /// Increments the value by 1.
+  void increment() { add(1); }
+
+  /// Increments the value by the specified `amount`.
+  void add(uint64_t amount) {
+    shards_[this_thread_shard() & mask_].value.fetch_add(
+        amount, std::memory_order_relaxed);
+  }
+
+  /// Returns the value, and sets it to zero.
+  uint64_t exchange_zero();
+};
+
+/// A `Handle` refers to a counter having a fixed set of tags. Incrementing a
+/// counter through its handle is a relaxed atomic addition to a shard of the
+/// counter's value (see `ShardedValue`): it does not allocate, hash the tags
+/// or lock. Counters that are incremented for every span should be
+/// incremented through handles.
+///
+/// A default constructed handle, and a handle obtained while telemetry is
+/// disabled, does nothing.
+class Handle final {
+  ShardedValue* value_ = nullptr;
+
+ public:
+  Handle() = default;
+  explicit Handle(ShardedValue* value) : value_(value) {}
+
+  /// Increments the counter by 1.
+  void increment() const {
+    if (value_) value_->increment();
+  }
+
+  /// Increments the counter by the specified `amount`, e.g. once for a batch
+  /// of spans.
+  void add(uint64_t amount) const {
+    if (value_) value_->add(amount);
+  }
+};
+
+/// Returns a handle to the specified counter having the specified tags. The
+/// handle remains valid for the lifetime of the process.
+///
+/// @param `counter` the counter to increment through the handle.
+/// @param `tags` the counter tags.
+Handle handle(const Counter& counter, const std::vector<std::string>& tags);
+
 /// Increments the specified counter by 1.
 ///
 /// @param `counter` the counter to increment.
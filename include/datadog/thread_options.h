@@ -0,0 +1,59 @@
+#pragma once
+
+// This component provides a `struct`, `ThreadOptions`, that configures the
+// threads that the tracer runs in the background: the dispatching thread of
+// the default `EventScheduler` and the event loop thread of the default
+// `HTTPClient`.  For example, a server that pins its request threads to some
+// cores can confine the tracer's threads to other cores, at a lower priority.
+//
+// This component also provides `ThreadGenerator`, the type of a function that
+// creates a thread that runs a specified function.
+//
+// The options are applied by each thread when it starts.  An option that
+// cannot be applied, e.g. because the platform does not support it or the
+// process lacks the privilege, is logged as an error, and the thread runs
+// anyway.  All of the options are supported on Linux.  Only `name_prefix` is
+// supported on macOS, and none are supported on Windows.
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "optional.h"
+
+namespace datadog {
+namespace tracing {
+
+using ThreadGenerator = std::function<std::thread(std::function<void()>&&)>;
+
+// The scheduling policy of a thread, other than the default of the platform.
+// See `sched(7)`.
+enum class ThreadSchedulingPolicy : char {
+  // `SCHED_BATCH`: the thread is assumed to be CPU-bound, and is
+  // slightly disfavored when it wakes up.
+  BATCH,
+  // `SCHED_IDLE`: the thread runs only when the CPU would otherwise be idle.
+  IDLE,
+};
+
+struct ThreadOptions {
+  // The threads are named "<name_prefix>-<role>", e.g. "dd-trace-sched" and
+  // "dd-trace-http".  Linux truncates thread names to 15 characters.  If
+  // `name_prefix` is null, then the threads are not named.
+  Optional<std::string> name_prefix;
+  // The CPUs on which the threads may run, numbered from zero.  If `cpus` is
+  // empty, then the threads may run on any CPU that the process may.
+  std::vector<int> cpus;
+  // The scheduling policy of the threads.  If `scheduling_policy` is null,
+  // then the threads have the process's policy.
+  Optional<ThreadSchedulingPolicy> scheduling_policy;
+  // The nice value of the threads, between -20 (highest priority) and 19
+  // (lowest priority).  Values below the process's usually require
+  // privilege.  If `nice` is null, then the threads have the process's nice
+  // value.
+  Optional<int> nice;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,55 @@
+#pragma once
+
+// This component provides functions that record a timeline of what the
+// tracer's own threads and the application's threads do inside the tracer,
+// and that dump it in the [Chrome trace event format][1], which
+// chrome://tracing and the [Perfetto UI][2] display, e.g. to find where the
+// tracer spends its time, or why a flush stalls.
+//
+// The timeline includes the event scheduler's wakeups, the encoding of trace
+// chunks when they are flushed, the iterations of the HTTP client's event
+// loop, waits for the locks of trace segments and of `DatadogAgent`, and the
+// processing of Remote Configuration responses.  Each thread records its
+// events in its own ring of the most recent `timeline::events_per_thread`
+// events, without locking.
+//
+// The timeline is compiled in only if the `DD_TRACE_TIMELINE` preprocessor
+// macro is defined when this library is built (see the `DD_TRACE_TIMELINE`
+// CMake option), and then records only while it is enabled.  Otherwise,
+// `timeline::available` returns false and nothing is recorded.
+//
+// For example:
+//
+//     datadog::tracing::timeline::enable(true);
+//     // ... reproduce the stall ...
+//     std::ofstream("/tmp/tracer.json") << datadog::tracing::timeline::dump();
+//
+// [1]: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+// [2]: https://ui.perfetto.dev
+
+#include <cstddef>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+namespace timeline {
+
+// The number of most recent events kept for each thread.
+constexpr std::size_t events_per_thread = 4096;
+
+// Return whether the timeline is compiled into this library.
+bool available();
+
+// Start recording events if the specified `enabled` is true, or stop if it
+// is false.  The events recorded so far are kept either way.  Recording is
+// initially stopped.  Has no effect unless `available()`.
+void enable(bool enabled);
+
+// Return the recorded events, oldest first on each thread, as a JSON object
+// in the Chrome trace event format.  Recording continues meanwhile.  If
+// nothing was recorded, then the object's "traceEvents" array is empty.
+std::string dump();
+
+}  // namespace timeline
+}  // namespace tracing
+}  // namespace datadog
@@ -7,6 +7,7 @@
 // `TraceSamplerConfig` is specified as the `trace_sampler` property of
 // `TracerConfig`.
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -20,6 +21,8 @@
 namespace datadog {
 namespace tracing {
 
+class SharedSamplerState;
+
 struct TraceSamplerRule final {
   Rate rate;
   SpanMatcher matcher;
@@ -38,6 +41,21 @@ struct TraceSamplerConfig {
   Optional<double> sample_rate;
   std::vector<Rule> rules;
   Optional<double> max_per_second;
+  // If set, root spans that match no rule are sampled at rates computed from
+  // local throughput, so that about this many traces per second are kept,
+  // rather than at rates from the Datadog Agent.  See `adaptive_sampler.h`.
+  Optional<double> adaptive_target_per_second;
+  // If set, root spans that match no rule are sampled so that about this many
+  // traces per second are kept, and every service and resource is among them
+  // however rare it is, rather than at rates from the Datadog Agent.  See
+  // `stratified_sampler.h`.  It cannot be set with
+  // `adaptive_target_per_second`.
+  Optional<double> stratified_target_per_second;
+  // State shared with the trace samplers of other processes, so that they
+  // share `max_per_second` and the sample rates of the Datadog Agent.  See
+  // `shared_sampler_state.h`.  The default is null, which means that this
+  // process samples traces on its own.
+  std::shared_ptr<SharedSamplerState> shared_state = nullptr;
 };
 
 class FinalizedTraceSamplerConfig {
@@ -50,6 +68,9 @@ class FinalizedTraceSamplerConfig {
  public:
   double max_per_second;
   std::vector<TraceSamplerRule> rules;
+  Optional<double> adaptive_target_per_second;
+  Optional<double> stratified_target_per_second;
+  std::shared_ptr<SharedSamplerState> shared_state;
   std::unordered_map<ConfigName, ConfigMetadata> metadata;
 
  public:
@@ -24,20 +24,60 @@
 // same `TraceSegment`.
 //
 // When all of the `Span`s associated with `TraceSegment` have been destroyed,
-// the `TraceSegment` submits them in a payload to a `Collector`.
+// the `TraceSegment` submits them in a payload to a `Collector`.  If partial
+// flushing is enabled (see `TracerConfig::partial_flush_enabled`), then the
+// `TraceSegment` also submits finished spans other than the local root in
+// intermediate payloads, as soon as enough of them have accumulated.
+//
+// If early sampling decisions are enabled (see
+// `TracerConfig::early_sampling_decision`), then the `TraceSegment` makes its
+// sampling decision when it is created.  While the decision is to drop the
+// trace and no span sampling rule could keep a span, children created in the
+// segment are not registered with it (see `skips_new_spans`).  The same is
+// true once the segment reaches its limit on the number or the size of its
+// spans (see `TracerConfig::max_spans_per_trace_segment`), and while traces
+// are not reported (see `TracerConfig::report_traces`), in which case the
+// segment's spans are discarded when it finishes, without being sampled or
+// finalized.
+//
+// If tail sampling is enabled (see `TracerConfig::tail_sampling_enabled`),
+// then a segment that began its trace, and whose sampling decision was not
+// needed before all of its spans finished, is not decided by the trace
+// sampler.  Its spans are instead given to a `TailSampler`, which decides the
+// trace later, knowing whether it had an error and how long it took.
+//
+// If orphaned segments are flushed (see
+// `TracerConfig::orphaned_segment_max_age_seconds`), then a segment that is
+// still not complete when it reaches the maximum age is flushed as though it
+// were complete (see `flush_orphaned`), so that a leaked span does not keep
+// the other spans of its segment in memory.
+//
+// If span rollups are configured (see `TracerConfig::span_rollups`), then
+// finished child spans that match a rollup are counted into a summary span,
+// the first of them having the same parent, name, and resource, and are then
+// discarded, so that a loop creating many such spans holds the data of only
+// one.  A span that might be the parent of another, local or remote, is never
+// discarded, so that no span is sent referring to a missing parent.
+//
+// If the tracer's memory is limited (see `TracerConfig::max_memory_bytes`),
+// then a segment counts its finished spans against the limit until it sends
+// them, and it sheds chunks or truncates itself as the limit is approached.
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "clock.h"
+#include "concurrent_append_list.h"
 #include "optional.h"
-#include "propagation_style.h"
-#include "runtime_id.h"
 #include "sampling_decision.h"
 #include "sampling_priority.h"
-#include "tracer_config.h"
 
 namespace datadog {
 namespace telemetry {
@@ -45,71 +85,138 @@ class Telemetry;
 }
 namespace tracing {
 
-class Collector;
 class DictReader;
 class DictWriter;
+class HeaderTags;
 struct InjectionOptions;
 class Logger;
+class SegmentRegistry;
+class SharedTags;
 struct SpanData;
 struct SpanDefaults;
-class SpanSampler;
-class TraceSampler;
-class ConfigManager;
+struct SpanLimits;
+struct TracerContext;
 
-class TraceSegment {
-  mutable std::mutex mutex_;
+class TraceSegment : public std::enable_shared_from_this<TraceSegment> {
+  friend class SegmentRegistry;
 
-  std::shared_ptr<Logger> logger_;
-  std::shared_ptr<Collector> collector_;
-  std::shared_ptr<TraceSampler> trace_sampler_;
-  std::shared_ptr<SpanSampler> span_sampler_;
+  // `mutex_` protects the sampling decision and the trace tags.  Registering
+  // and finishing spans does not lock `mutex_`.
+  mutable std::mutex mutex_;
 
-  std::shared_ptr<const SpanDefaults> defaults_;
-  RuntimeID runtime_id_;
-  const std::vector<PropagationStyle> injection_styles_;
-  const Optional<std::string> hostname_;
+  // The tracer's collaborators and configuration, shared with the other
+  // segments that it created at about the same time.
+  const std::shared_ptr<const TracerContext> context_;
   const Optional<std::string> origin_;
-  const std::size_t tags_header_max_size_;
   std::vector<std::pair<std::string, std::string>> trace_tags_;
 
-  std::vector<std::unique_ptr<SpanData>> spans_;
-  std::size_t num_finished_spans_;
+  ConcurrentAppendList<std::unique_ptr<SpanData>> spans_;
+  // The number of registered and unrecorded spans that have not yet
+  // finished.  When it reaches zero, the segment is complete.
+  std::atomic<std::size_t> num_unfinished_spans_;
+  // Indices into `spans_` of the finished spans that are waiting for the next
+  // partial flush.  Guarded by `mutex_`.
+  std::vector<std::size_t> partially_flushable_;
+  // The statistics of the finished spans rolled up into each summary span so
+  // far (see `TracerConfig::span_rollups`).  They are applied to the summary
+  // span when the segment is sent.  Guarded by `mutex_`.
+  struct Rollup {
+    // Index into `spans_` of the summary span.
+    std::size_t index;
+    std::uint64_t count;
+    std::uint64_t errors;
+    Duration total;
+    Duration min;
+    Duration max;
+    TimePoint start;
+    std::chrono::steady_clock::time_point end;
+  };
+  std::vector<Rollup> rollups_;
   Optional<SamplingDecision> sampling_decision_;
   Optional<std::string> additional_w3c_tracestate_;
   Optional<std::string> additional_datadog_w3c_tracestate_;
 
-  std::shared_ptr<ConfigManager> config_manager_;
+  // Whether new spans need not be registered.  Guarded by `mutex_` for
+  // writing.
+  std::atomic<bool> skips_new_spans_;
+  // Why new spans are no longer recorded, if the segment reached one of its
+  // limits, or `NOT_TRUNCATED`.  Set at most once.
+  enum Truncation : std::uint8_t {
+    NOT_TRUNCATED,
+    TOO_MANY_SPANS,
+    TOO_MANY_BYTES,
+    TOO_MUCH_MEMORY
+  };
+  std::atomic<Truncation> truncation_;
+  // The estimated encoded size of the finished spans, if the size of the
+  // segment's spans is limited.
+  std::atomic<std::size_t> finished_bytes_;
+  // The estimated encoded size of the finished spans not yet sent, as counted
+  // against `TracerContext::memory_budget`, if there is one.
+  std::atomic<std::size_t> charged_bytes_;
+  // Whether the segment was flushed before it completed (see
+  // `flush_orphaned`), after which its spans finishing has no effect.
+  std::atomic<bool> orphaned_;
 
-  HttpEndpointCalculationMode resource_renaming_mode_;
+  // The neighbors of this segment in the list of its tracer's
+  // `SegmentRegistry`, if any, and when it was added to the list.  These are
+  // guarded by the registry.
+  TraceSegment* registry_older_ = nullptr;
+  TraceSegment* registry_newer_ = nullptr;
+  bool registered_ = false;
+  std::chrono::steady_clock::time_point registered_at_;
 
-  bool tracing_enabled_;
+  // Parts of the injected header values that depend only on the sampling
+  // decision and the trace tags, so that `inject` need not encode them again
+  // for every call.  `trace_context_version_` is incremented whenever the
+  // sampling decision or the trace tags change.  Both are guarded by `mutex_`.
+  struct EncodedTraceContext {
+    // The value of `trace_context_version_` when this was encoded.
+    std::uint64_t version;
+    // The value of the local root's `_dd.p.ts` tag when this was encoded.
+    Optional<std::string> trace_source;
+    // The "x-datadog-tags" value, or empty if it is too large to inject.
+    std::string datadog_tags;
+    // The encoded size of "x-datadog-tags" if it is too large to inject.
+    Optional<std::size_t> oversized_tags_size;
+    // The "tracestate" value with a parent ID of zero, and the offset of the
+    // parent ID within it.
+    std::string tracestate;
+    std::size_t tracestate_parent_id_offset;
+  };
+  std::uint64_t trace_context_version_;
+  Optional<EncodedTraceContext> encoded_trace_context_;
 
  public:
-  TraceSegment(const std::shared_ptr<Logger>& logger,
-               const std::shared_ptr<Collector>& collector,
-               const std::shared_ptr<TraceSampler>& trace_sampler,
-               const std::shared_ptr<SpanSampler>& span_sampler,
-               const std::shared_ptr<const SpanDefaults>& defaults,
-               const std::shared_ptr<ConfigManager>& config_manager,
-               const RuntimeID& runtime_id,
-               const std::vector<PropagationStyle>& injection_styles,
-               const Optional<std::string>& hostname,
-               Optional<std::string> origin, std::size_t tags_header_max_size,
+  TraceSegment(std::shared_ptr<const TracerContext> context,
+               Optional<std::string> origin,
                std::vector<std::pair<std::string, std::string>> trace_tags,
                Optional<SamplingDecision> sampling_decision,
                Optional<std::string> additional_w3c_tracestate,
                Optional<std::string> additional_datadog_w3c_tracestate,
-               std::unique_ptr<SpanData> local_root,
-               HttpEndpointCalculationMode resource_renaming_mode,
-               bool tracing_enabled = true);
+               std::unique_ptr<SpanData> local_root);
+  ~TraceSegment();
 
   const SpanDefaults& defaults() const;
+  const SpanLimits& span_limits() const;
+  // Return the headers whose values become tags of the segment's spans, or
+  // return null if there are none.
+  const HeaderTags* header_tags() const;
+  // Return the clock that gives the start and end times of the segment's
+  // spans.
+  const Clock& clock() const;
   const Optional<std::string>& hostname() const;
   const Optional<std::string>& origin() const;
   Optional<SamplingDecision> sampling_decision() const;
 
   Logger& logger() const;
 
+  // Return a new span ID from the segment's ID generator.
+  std::uint64_t generate_span_id() const;
+  // Store in each of the specified `count` `ids` a new span ID from the
+  // segment's ID generator.
+  void generate_span_ids(std::uint64_t* ids, std::size_t count) const;
+
   // Inject trace context for the specified `span` into the specified `writer`.
   // Return whether the trace sampling decision was delegated.
   // This function is the implementation of `Span::inject`.
@@ -117,11 +224,50 @@ class TraceSegment {
   bool inject(DictWriter& writer, const SpanData& span,
               const InjectionOptions& options);
 
-  // Take ownership of the specified `span`.
-  void register_span(std::unique_ptr<SpanData> span);
-  // Increment the number of finished spans.  If that number is equal to the
-  // number of registered spans, send all of the spans to the `Collector`.
-  void span_finished();
+  // `Injection` is a span of this segment and the writer into which its trace
+  // context is injected.
+  struct Injection {
+    const SpanData* span;
+    DictWriter* writer;
+  };
+
+  // Inject trace context for each of the specified `count` `injections`, as
+  // `inject` does for one span.  The segment is locked once for all of them,
+  // and only the span IDs are formatted for each.  Return whether the trace
+  // sampling decision was delegated.  This function is the implementation of
+  // `Span::inject_all`.
+  bool inject(const Injection* injections, std::size_t count);
+
+  // Take ownership of the specified `span` and return its index within this
+  // segment.  This function does not lock.
+  std::size_t register_span(std::unique_ptr<SpanData> span);
+  // Take ownership of the specified `count` `spans`, as `register_span` would
+  // of each, and return the index of the first.  The others follow it.  The
+  // spans are counted together, rather than one at a time.
+  std::size_t register_spans(std::unique_ptr<SpanData>* spans,
+                             std::size_t count);
+  // Increment the number of finished spans, where the specified `index` is
+  // that of the finished span.  If that number is equal to the number of
+  // registered spans, send all of the remaining spans to the `Collector`.  If
+  // partial flushing is enabled and enough spans have finished, send the
+  // finished spans other than the local root to the `Collector`.  Unless
+  // partial flushing is enabled, this function locks only when the segment is
+  // complete.
+  void span_finished(std::size_t index);
+  // Count, and then uncount, a span that is not registered because it is not
+  // recorded (see `skips_new_spans`).  The segment is not complete while such
+  // a span is unfinished, since the span can still propagate trace context.
+  // A `SpanContext` is counted in the same way, since children can still be
+  // created from it.
+  // Optionally specify the `count` of such spans to count at once.
+  void register_unrecorded_span(std::size_t count = 1);
+  void unrecorded_span_finished();
+  // Take ownership of the specified `spans`, which are finished, and then
+  // finish the local root, which must be the only unfinished span.  The spans
+  // are registered and counted together, rather than one at a time.  Spans
+  // beyond `TracerConfig::max_spans_per_trace_segment` are discarded.  This
+  // function is the implementation of `Tracer::import_spans`.
+  void finish_imported(std::vector<std::unique_ptr<SpanData>>&& spans);
 
   // Set the sampling decision to be a local, manual decision with the specified
   // sampling `priority`. Overwrite any previous sampling decision.
@@ -131,7 +277,40 @@ class TraceSegment {
   // Retrieves the local root span.
   SpanData& local_root() const;
 
+  // Return whether spans created in this segment from now on would be
+  // discarded when the segment finishes, so that they need not be
+  // registered.  This is the case for early sampling decisions to drop the
+  // trace, when there are no span sampling rules, for segments that reached
+  // one of their limits, and while traces are not reported.  This function
+  // does not lock.
+  bool skips_new_spans() const;
+
+  // Return whether this segment might be flushed while its spans are in use
+  // (see `flush_orphaned`), in which case `Span` writes to a span only under
+  // its `SpanData::write_guard`.
+  bool flushes_orphans() const;
+
+  // Send this segment's spans to the `Collector` as though all of them had
+  // finished, unless the segment is already complete.  Tag the unfinished
+  // spans with `_dd.span.orphaned`, and send copies of them, since their
+  // `Span`s may still be destroyed later.  Spans created from this segment
+  // afterward are not recorded.  Return the estimated encoded size of the
+  // spans sent, or return null if the segment was already complete or
+  // flushed.  The spans may be in use concurrently: each is detached from its
+  // `Span` (see `SpanWriteGuard`) before it is read, so that the `Span` no
+  // longer writes to it.
+  Optional<std::size_t> flush_orphaned();
+
  private:
+  // Send all of the remaining spans to the `Collector`, now that every span
+  // has finished.
+  void finish();
+  // Run the span sampler on the specified `spans`, whose local root is first,
+  // tag the local root with the sampling decision and the trace tags, and send
+  // the spans to the `Collector`, or to the `TailSampler` if the specified
+  // `tail_sampled` is true.
+  void finalize_and_send(std::vector<std::unique_ptr<SpanData>>&& spans,
+                         bool tail_sampled);
   // If `sampling_decision_` is null, use `trace_sampler_` to make a
   // sampling decision and assign it to `sampling_decision_`.
   void make_sampling_decision_if_null();
@@ -139,6 +318,61 @@ class TraceSegment {
   // `trace_tags_` according to either information extracted from trace context
   // or from a local sampling decision.
   void update_decision_maker_trace_tag();
+  // Set `skips_new_spans_` according to `sampling_decision_`.  `mutex_` must
+  // be locked, except in the constructor.
+  void update_skips_new_spans();
+  // Stop recording new spans for the specified `reason`, unless the segment
+  // was already truncated.  This function does not lock.
+  void truncate(Truncation reason);
+  // Return whether the estimated encoded size of finished spans is counted,
+  // as it is if the size of the segment or the memory of the tracer is
+  // limited.
+  bool counts_finished_bytes() const;
+  // Count the specified `bytes` of finished spans toward the limits of the
+  // segment and of the tracer, and truncate the segment if either is
+  // reached.  This function does not lock.
+  void count_finished_bytes(std::size_t bytes);
+  // Release the specified `bytes`, but no more than `charged_bytes_`, from
+  // `TracerContext::memory_budget`.  This function does not lock.
+  void release_charged(std::size_t bytes);
+  // Return `encoded_trace_context_`, first encoding it again if the sampling
+  // decision, the trace tags, or the specified `trace_source` tag of the local
+  // root (which may be null) changed since it was last encoded.  `mutex_`
+  // must be locked.
+  const EncodedTraceContext& encoded_trace_context(
+      const std::pair<std::string, std::string>* trace_source);
+  // The result of `roll_up`.
+  enum RollupResult { NOT_ROLLED_UP, SUMMARY, FOLDED };
+  // Return whether the specified `span` matches one of
+  // `TracerContext::span_rollups`.
+  bool matches_rollup(const SpanData& span) const;
+  // Given that the finished span at the specified `index` matches a rollup,
+  // return `SUMMARY` if it is the first of its parent's children to match
+  // with its name and resource, or otherwise count it into the summary,
+  // discard it, and return `FOLDED`.  Return `NOT_ROLLED_UP` instead if it
+  // has children (see `SpanData::has_children`), and return `FOLDED` if
+  // `flush_orphaned` took it meanwhile.  This function locks.
+  RollupResult roll_up(std::size_t index);
+  // Tag each summary span with the statistics of the spans rolled up into
+  // it.  `mutex_` must be locked.
+  void apply_rollups();
+  // Add `index` to the spans awaiting a partial flush and, if there are enough
+  // of them, send them to the `Collector`.
+  void partial_flush(std::size_t index);
+  // Return the tags that every span in this segment has in common.  Unless
+  // the segment has an origin, these are `TracerContext::shared_tags`, so
+  // that nothing is allocated.
+  std::shared_ptr<const SharedTags> shared_tags() const;
+  // Set `SpanData::shared_tags` on each of the specified `spans`, or copy the
+  // shared tags into the spans' tags if the `Collector` does not accept
+  // shared tags (see `Collector::accepts_shared_tags`).
+  void apply_shared_tags(
+      const std::vector<std::unique_ptr<SpanData>>& spans,
+      const std::shared_ptr<const SharedTags>& shared_tags);
+  // Send the specified `spans`, of a trace having the specified sampling
+  // `priority`, to the `Collector` as one chunk, if traces are reported and
+  // the chunk is not shed to stay within `TracerContext::memory_budget`.
+  void send(std::vector<std::unique_ptr<SpanData>>&& spans, int priority);
 };
 
 }  // namespace tracing
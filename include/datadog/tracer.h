@@ -10,16 +10,24 @@
 // obtained from a `TracerConfig` via the `finalize_config` function.  See
 // `tracer_config.h`.
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <future>
 #include <memory>
+#include <memory_resource>
 
+#include "atomic_snapshot.h"
 #include "baggage.h"
 #include "clock.h"
 #include "expected.h"
 #include "id_generator.h"
+#include "imported_span.h"
 #include "optional.h"
+#include "runtime_stats.h"
 #include "span.h"
 #include "span_config.h"
+#include "trace_id.h"
 #include "tracer_config.h"
 #include "tracer_signature.h"
 
@@ -28,13 +36,23 @@ namespace tracing {
 
 class ConfigManager;
 class DictReader;
+class DictWriter;
 struct SpanConfig;
 class TraceSampler;
 class SpanSampler;
 class IDGenerator;
 class InMemoryFile;
+class MemoryBudget;
+class OverheadGovernor;
+class PropagationHeaders;
+class ResourceLatencies;
+class SegmentRegistry;
+struct TracerContext;
 
 class Tracer {
+  // The configuration that this tracer was created with, kept for
+  // `reinitialize_after_fork`.
+  std::shared_ptr<const FinalizedTracerConfig> finalized_config_;
   std::shared_ptr<Logger> logger_;
   RuntimeID runtime_id_;
   TracerSignature signature_;
@@ -43,10 +61,10 @@ class Tracer {
   std::shared_ptr<SpanSampler> span_sampler_;
   std::shared_ptr<const IDGenerator> generator_;
   Clock clock_;
-  std::vector<PropagationStyle> injection_styles_;
+  // What each trace segment shares with this tracer.  Replaced when the span
+  // defaults change (see `context()`).
+  std::shared_ptr<AtomicSnapshot<const TracerContext>> context_;
   std::vector<PropagationStyle> extraction_styles_;
-  Optional<std::string> hostname_;
-  std::size_t tags_header_max_size_;
   // Store the tracer configuration in an in-memory file, allowing it to be
   // read to determine if the process is instrumented with a tracer and to
   // retrieve relevant tracing information.
@@ -54,13 +72,35 @@ class Tracer {
   Baggage::Options baggage_opts_;
   bool baggage_injection_enabled_;
   bool baggage_extraction_enabled_;
-  bool tracing_enabled_;
-  HttpEndpointCalculationMode resource_renaming_mode_;
+  bool trace_arena_enabled_;
+  // Null unless spans are allocated from the application's memory resource
+  // (see `TracerConfig::memory_resource`).
+  std::pmr::memory_resource* memory_resource_;
+  // The number of trace segments created by this tracer that have not been
+  // destroyed.  Shared with each trace segment.
+  std::shared_ptr<std::atomic<std::size_t>> live_segments_;
+  // The recent durations of local root spans, by service and resource.  Null
+  // if tracing is disabled.  Shared with each trace segment.
+  std::shared_ptr<ResourceLatencies> resource_latencies_;
+  // Null unless orphaned trace segments are flushed.  Shared with each trace
+  // segment.
+  std::shared_ptr<SegmentRegistry> segment_registry_;
+  // Null unless the memory held in trace data is limited (see
+  // `TracerConfig::max_memory_bytes`).  Shared with each trace segment and
+  // with the collector.
+  std::shared_ptr<MemoryBudget> memory_budget_;
+  // Null unless the CPU overhead of the tracer is limited (see
+  // `TracerConfig::max_cpu_overhead`).
+  std::shared_ptr<OverheadGovernor> overhead_governor_;
 
  public:
   // Create a tracer configured using the specified `config`, and optionally:
   // - using the specified `generator` to create trace IDs and span IDs
   // - using the specified `clock` to get the current time.
+  // If `config` was finalized in another process, e.g. before this process
+  // was forked, then the tracer uses its own HTTP client and event scheduler
+  // in place of any that this library made for `config`, as does
+  // `reinitialize_after_fork`.
   explicit Tracer(const FinalizedTracerConfig& config);
   Tracer(const FinalizedTracerConfig& config,
          const std::shared_ptr<const IDGenerator>& generator);
@@ -69,23 +109,59 @@ class Tracer {
   // specify a `config` indicating the attributes of the root span.
   Span create_span();
   Span create_span(const SpanConfig& config);
+  Span create_span(const SpanConfigView& config);
 
   // Return a span whose parent and other context is parsed from the specified
   // `reader`, and whose attributes are determined by the optionally specified
   // `config`.  If there is no tracing information in `reader`, then return an
   // error with code `Error::NO_SPAN_TO_EXTRACT`.  If a failure occurs, then
-  // return an error with some other code.
+  // return an error with some other code.  The span is tagged with the
+  // request headers named by `TracerConfig::header_tags` and with the baggage
+  // items named by `TracerConfig::baggage_tag_keys`.
   Expected<Span> extract_span(const DictReader& reader);
   Expected<Span> extract_span(const DictReader& reader,
                               const SpanConfig& config);
+  Expected<Span> extract_span(const DictReader& reader,
+                              const SpanConfigView& config);
 
   // Return a span extracted from the specified `reader` (see `extract_span`).
   // If there is no span to extract, or if an error occurs during extraction,
   // then return a span that is the root of a new trace (see `create_span`).
   // Optionally specify a `config` indicating the attributes of the span.
+  // Either way, the span is tagged with the request headers named by
+  // `TracerConfig::header_tags` and with the baggage items named by
+  // `TracerConfig::baggage_tag_keys`.
   Span extract_or_create_span(const DictReader& reader);
   Span extract_or_create_span(const DictReader& reader,
                               const SpanConfig& config);
+  Span extract_or_create_span(const DictReader& reader,
+                              const SpanConfigView& config);
+
+  // Write to the specified `writer` the trace context parsed from the
+  // specified `reader`, in the configured injection styles, without creating
+  // a span.  This is for proxies that forward requests without tracing them.
+  // If the specified `new_parent_id` is true, then the context is written
+  // with a new parent span ID, as though the proxy had created a span;
+  // otherwise, it is written with the extracted parent ID.  Return the parent
+  // ID written, or return an error as `extract_span` does.  The context is
+  // neither sampled nor sent to the collector: the extracted sampling
+  // decision, if any, is forwarded, and if there is none, then the decision
+  // is left to the receiver, and the "traceparent" and "tracestate" headers
+  // are not written.
+  Expected<std::uint64_t> propagate(const DictReader& reader,
+                                    DictWriter& writer,
+                                    bool new_parent_id = false);
+
+  // Make a trace of the specified `spans`, which describe operations that
+  // have already finished (see `imported_span.h`), and send it as though
+  // each span had been created and then finished.  The first of `spans` is
+  // the root of the trace, and each of the others names its parent by the
+  // parent's index in `spans`, which is less than its own.  The spans are
+  // sampled, tagged, and limited as any trace is.  Return the ID of the
+  // trace, or return an error if `spans` is empty or a parent index is
+  // invalid.
+  Expected<TraceID> import_spans(const ImportedSpan* spans, std::size_t count);
+  Expected<TraceID> import_spans(const std::vector<ImportedSpan>& spans);
 
   // Create a baggage.
   Baggage create_baggage();
@@ -106,8 +182,96 @@ class Tracer {
   // same JSON object that was logged when this Tracer was created.
   std::string config() const;
 
+  // Change the span defaults, trace sampling rules, or trace reporting of this
+  // tracer as specified by `update`, without replacing its collector or
+  // stopping its threads.  Spans created after this function returns have the
+  // new defaults, and traces whose sampling decision is made after it returns
+  // are sampled by the new rules.  The update is applied atomically, and may
+  // be called concurrently with any other member function.  Return an error,
+  // and change nothing, if `update` is invalid.
+  //
+  // The service name that identifies this tracer to the Datadog Agent, to
+  // telemetry, and to Remote Configuration is the one it was created with.
+  // `reinitialize_after_fork` restores the configuration that the tracer was
+  // created with, so an update made before a fork must be made again in the
+  // child.
+  Expected<void> reconfigure(const TracerUpdate& update);
+
+  // Prepare this tracer for use in a process created by `fork` from the
+  // process in which the tracer was created.  Call this in the child process
+  // before the tracer is otherwise used there, and before the child creates
+  // another thread.  Servers that fork worker processes, such as nginx, can
+  // thus create one tracer before forking, rather than one in each worker.
+  //
+  // The threads of the tracer's background components do not exist in the
+  // child.  This function replaces the tracer's collector with a new one, and
+  // the HTTP client and event scheduler that this library made by default
+  // with new ones, each having its own threads.  Trace chunks that the parent
+  // had buffered are not inherited; the parent sends them.  The tracer gets a
+  // new runtime ID.  The configuration that the tracer was created with is
+  // reused rather than finalized again.  An HTTP client, event scheduler, or
+  // collector that was specified in the configuration is kept, and must
+  // itself be usable in the child.  Telemetry, which is shared by the
+  // tracers in a process, is not restarted.
+  //
+  // The replaced components are never destroyed in the child, since
+  // destroying them would wait for threads that do not exist.  Spans created
+  // in the parent should not be finished in the child.
+  void reinitialize_after_fork();
+
+  // Allocate ahead of time what the first traces would otherwise allocate, so
+  // that the latency of the first requests after startup, or after
+  // `reinitialize_after_fork`, matches that of later ones.  Size the pools of
+  // spans, of arena chunks, and of the collector's encoding buffers for
+  // traces having about the specified `expected_spans_per_trace` spans,
+  // created on as many as the specified `expected_concurrency` threads at
+  // once.  Also discover the process information reported with traces, such
+  // as the container ID.  The pools are bounded, so large arguments are not
+  // harmful, only capped.
+  void warm_up(std::size_t expected_spans_per_trace,
+               std::size_t expected_concurrency);
+
+  // Begin the final flush of this tracer on another thread, and return a
+  // future that is ready once it completes.  The flush sends the trace chunks
+  // that the collector has buffered, including those awaiting a tail
+  // sampling decision, and waits for the collector's requests in flight to
+  // finish, but no longer than the specified `deadline`.  Destroying the
+  // tracer afterwards does not wait, so that the final flushes of many
+  // tracers can overlap, rather than each tracer's destructor waiting in
+  // turn.  Traces that finish after the flush begins are not sent.  Telemetry,
+  // which is shared by the tracers in a process, is not flushed.  Calling
+  // this function again has no further effect.
+  std::future<void> shutdown_async(
+      std::chrono::steady_clock::time_point deadline);
+
+  // Return a snapshot of the work in progress in this tracer and its
+  // collector.  This function does not lock, and is cheap enough to call
+  // frequently.  See `runtime_stats.h`.
+  RuntimeStats runtime_stats() const;
+
  private:
   void store_config(const std::unordered_map<std::string, std::string>&);
+  // Return the current `context_`, first replacing it if the span defaults
+  // have changed since it was made.
+  std::shared_ptr<const TracerContext> context();
+  // `Config` is either `SpanConfig` or `SpanConfigView`.
+  template <typename Config>
+  Span create_span_with_config(const Config& config);
+  // Return a span extracted from the specified `headers`, tagged with the
+  // configured request headers.  If the specified `describe_errors` is false,
+  // then a returned `Error` is not described as fully, because the caller
+  // discards it.
+  template <typename Config>
+  Expected<Span> extract_span_with_config(PropagationHeaders& headers,
+                                          const Config& config,
+                                          bool describe_errors);
+  // `Config` is either `SpanConfig` or `SpanConfigView`.
+  template <typename Config>
+  Span extract_or_create_span_with_config(const DictReader& reader,
+                                          const Config& config);
+  // Tag the specified `span` with the configured items of the "baggage"
+  // header of the specified `reader` (see `baggage_tags.h`).
+  void set_baggage_tags(const DictReader& reader, Span& span) const;
 };
 
 }  // namespace tracing
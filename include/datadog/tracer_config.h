@@ -6,17 +6,23 @@
 
 #include <datadog/telemetry/configuration.h>
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
+#include <memory_resource>
 #include <variant>
 #include <vector>
 
 #include "baggage.h"
 #include "clock.h"
 #include "datadog_agent_config.h"
+#include "datagram_collector_config.h"
+#include "datadog_intake_config.h"
 #include "expected.h"
 #include "http_endpoint_calculation_mode.h"
+#include "otlp_exporter_config.h"
 #include "propagation_style.h"
+#include "recording_collector_config.h"
 #include "runtime_id.h"
 #include "span_defaults.h"
 #include "span_sampler_config.h"
@@ -25,11 +31,21 @@
 namespace datadog {
 namespace tracing {
 
+class BaggageTags;
 class Collector;
+class HeaderTags;
 class Logger;
 class SpanSampler;
 class TraceSampler;
 
+// `SpanRollup` selects child spans that are rolled up into a summary span
+// (see `TracerConfig::span_rollups`): those having the operation name `name`
+// and, unless `resource` is empty, the resource name `resource`.
+struct SpanRollup {
+  std::string name;
+  std::string resource;
+};
+
 struct TracerConfig {
   // Set the service name.
   //
@@ -64,15 +80,51 @@ struct TracerConfig {
   // set or if `report_traces` is `false`.
   DatadogAgentConfig agent;
 
+  // `intake` configures a `DatadogIntake` collector instance, which sends
+  // traces directly to Datadog, without a Datadog Agent.  See
+  // `datadog_intake_config.h`.  If `intake.enabled` is true, then `agent` is
+  // ignored.  Note that `intake` is ignored if `collector` is set or if
+  // `report_traces` is `false`.
+  DatadogIntakeConfig intake;
+
+  // `otlp` configures an `OtlpExporter` collector instance, which sends traces
+  // to an OpenTelemetry collector in the OTLP/HTTP protobuf format.  See
+  // `otlp_exporter_config.h`.  If `otlp.enabled` is true, and `intake.enabled`
+  // is not, then `agent` is ignored.  Note that `otlp` is ignored if
+  // `collector` is set or if `report_traces` is `false`.
+  OtlpExporterConfig otlp;
+
+  // `datagram` configures a `DatagramCollector` instance, which sends each
+  // trace chunk as one datagram over a Unix domain socket.  See
+  // `datagram_collector_config.h`.  If `datagram.enabled` is true, and neither
+  // `intake.enabled` nor `otlp.enabled` is, then `agent` is ignored.  Note
+  // that `datagram` is ignored if `collector` is set or if `report_traces` is
+  // `false`.
+  DatagramCollectorConfig datagram;
+
+  // `recording` configures a `RecordingCollector` instance, which appends the
+  // trace payloads that a `DatadogAgent` would send to a capture file, for
+  // replay against a real agent.  See `recording_collector_config.h`.  If
+  // `recording.enabled` is true, and none of `intake.enabled`,
+  // `otlp.enabled`, or `datagram.enabled` is, then `agent` is ignored.  Note
+  // that `recording` is ignored if `collector` is set or if `report_traces` is
+  // `false`.
+  RecordingCollectorConfig recording;
+
   // `collector` is a `Collector` instance that the tracer will use to report
-  // traces to Datadog.  If `collector` is null, then a `DatadogAgent` instance
-  // will be created using the `agent` configuration.  Note that `collector` is
-  // ignored if `report_traces` is `false`.
+  // traces to Datadog.  If `collector` is null, then a `DatadogIntake`,
+  // `OtlpExporter`, `DatagramCollector`, `RecordingCollector`, or
+  // `DatadogAgent` instance will be created using the `intake`, `otlp`,
+  // `datagram`, `recording`, or `agent` configuration.
+  // Note that `collector` is ignored if `report_traces` is `false`.
   std::shared_ptr<Collector> collector;
 
   // `report_traces` indicates whether traces generated by the tracer will be
   // sent to a collector (`true`) or discarded on completion (`false`).  If
   // `report_traces` is `false`, then both `agent` and `collector` are ignored.
+  // While traces are not reported, only the local root span of each trace
+  // segment is recorded: child spans carry only the IDs needed to propagate
+  // trace context, and setting their tags has no effect (see `span.h`).
   // `report_traces` is overridden by the `DD_TRACE_ENABLED` environment
   // variable.
   Optional<bool> report_traces;
@@ -94,7 +146,11 @@ struct TracerConfig {
   // will be compatible when injecting (sending) trace context.
   // All styles indicated by `injection_styles` are used for injection.
   // `injection_styles` is overridden by the `DD_TRACE_PROPAGATION_STYLE_INJECT`
-  // and `DD_TRACE_PROPAGATION_STYLE` environment variables.
+  // and `DD_TRACE_PROPAGATION_STYLE` environment variables.  The B3 and
+  // baggage styles are unavailable if this library was built without them
+  // (see the `DD_TRACE_B3_PROPAGATION` and `DD_TRACE_BAGGAGE` build options),
+  // in which case the default styles exclude baggage.  The same is true of
+  // `extraction_styles`.
   Optional<std::vector<PropagationStyle>> injection_styles;
 
   // `extraction_styles` indicates with which tracing systems trace propagation
@@ -119,7 +175,8 @@ struct TracerConfig {
 
   // `logger` specifies how the tracer will issue diagnostic messages.  If
   // `logger` is null, then it defaults to no logging (`NullLogger`).  See
-  // `CerrLogger` for an alternative.
+  // `AsyncLogger`, which is recommended for servers, and `CerrLogger` for
+  // alternatives.
   std::shared_ptr<Logger> logger;
 
   // `log_on_startup` indicates whether the tracer will log a banner of
@@ -166,8 +223,8 @@ struct TracerConfig {
   Optional<std::size_t> baggage_max_bytes;
 
   /// The event scheduler used for scheduling recurring tasks.
-  /// By default, it uses `ThreadedEventScheduler`, which runs tasks on a
-  /// separate thread.
+  /// By default, it uses a `ThreadedEventScheduler` shared by the tracers in
+  /// the process, which runs tasks on a separate thread.
   std::shared_ptr<EventScheduler> event_scheduler;
 
   /// `tracing_enabled` indicates whether APM traces and APM trace metrics
@@ -195,6 +252,214 @@ struct TracerConfig {
   /// values with a process. These tags are consumed as fact for identifying
   /// processes.
   std::unordered_map<std::string, std::string> process_tags;
+
+  // `trace_arena_enabled` indicates whether the spans of each trace segment,
+  // and their tags, are allocated from a per-segment arena instead of
+  // individually from the global heap.  The arena's memory is released all at
+  // once when the segment's spans are destroyed, after they have been sent to
+  // the collector.  This reduces allocator overhead for traces having many
+  // spans, at the cost of memory that cannot be reused until the trace is
+  // done.  Defaults to `false`.
+  Optional<bool> trace_arena_enabled;
+
+  // `memory_resource`, if not null, is where the tracer allocates the storage
+  // of spans: each trace segment's arena, as for `trace_arena_enabled`, takes
+  // all of its memory from `memory_resource` instead of from the global heap,
+  // and so do the spans of the segment and their tag tables.  Tag names and
+  // values longer than a `std::string`'s inline capacity are still allocated
+  // from the global heap.  `memory_resource` must be thread-safe, e.g. a
+  // `std::pmr::synchronized_pool_resource`, and must outlive the tracer and
+  // any spans that it created.  Implies `trace_arena_enabled`.
+  std::pmr::memory_resource* memory_resource = nullptr;
+
+  // `obfuscation_enabled` indicates whether the tracer obfuscates its spans
+  // before sending them, rather than leaving that to the Datadog Agent: the
+  // literals of SQL statements in the resources of database spans, the
+  // arguments of Redis commands, and the credentials in URLs (see
+  // `obfuscation.h`).  The Datadog Agent is then told not to obfuscate the
+  // spans again, which saves its CPU time.  Spans are obfuscated when their
+  // trace segment is finalized, and the obfuscation of each distinct SQL
+  // statement is cached.  Defaults to `false`.
+  Optional<bool> obfuscation_enabled;
+
+  // `header_tags` maps the names of request and response headers to the
+  // names of the tags given their values.  A header mapped to an empty tag
+  // name has the tag "http.request.headers.<header>" or
+  // "http.response.headers.<header>", where "<header>" is the header's name in
+  // lower case with characters other than letters, digits, and hyphens
+  // replaced by underscores.  Header names are case-insensitive.  A span
+  // extracted by `Tracer::extract_span` or `Tracer::extract_or_create_span` is
+  // tagged with the request headers as they are read for trace context, and
+  // `Span::set_response_header_tags` tags a span with the response headers.
+  // The headers, at most 64 of them, are compiled by `finalize_config` into a
+  // table that costs one lookup per header read, however many are
+  // configured.
+  std::unordered_map<std::string, std::string> header_tags;
+
+  // `baggage_tag_keys` names the baggage items whose values become tags of
+  // the local root span of a trace extracted by `Tracer::extract_span` or
+  // `Tracer::extract_or_create_span`.  The tag of the item with key "<key>"
+  // is "baggage.<key>".  The keys, at most 16 of them, are compiled by
+  // `finalize_config`, and the "baggage" header is parsed once per
+  // extraction without making a `Baggage`.  Items are tagged only if baggage
+  // is an extraction style.
+  std::vector<std::string> baggage_tag_keys;
+
+  // `partial_flush_enabled` indicates whether a trace segment sends its
+  // finished spans to the collector before the whole segment is finished.
+  // This bounds the memory used by long-lived traces having many spans.  The
+  // local root span is always sent last, with the final chunk.
+  // `partial_flush_enabled` is overridden by the
+  // `DD_TRACE_PARTIAL_FLUSH_ENABLED` environment variable.  Defaults to
+  // `false`.
+  Optional<bool> partial_flush_enabled;
+
+  // `partial_flush_min_spans` is the number of finished spans, not including
+  // the local root, that a trace segment accumulates before sending them as a
+  // partial chunk.  It is ignored unless `partial_flush_enabled` is `true`.
+  // `partial_flush_min_spans` is overridden by the
+  // `DD_TRACE_PARTIAL_FLUSH_MIN_SPANS` environment variable.  Must be
+  // positive.  Defaults to 1000.
+  Optional<std::size_t> partial_flush_min_spans;
+
+  // `early_sampling_decision` indicates whether the trace sampling decision
+  // for a trace that begins in this process is made when its root span is
+  // created, rather than when the trace segment finishes or is first
+  // propagated.  If the trace is then dropped, and no span sampling rules are
+  // configured, then subsequently created child spans are not recorded: they
+  // only carry IDs for trace context propagation, are not sent to the
+  // collector, and do not contribute to the Datadog Agent's trace metrics.
+  // Sampling rules see the root span only as it was when created.  If the
+  // sampling priority is later overridden to keep the trace, only spans
+  // created afterward are recorded.  Ignored when APM tracing is disabled.
+  // Defaults to `false`.
+  Optional<bool> early_sampling_decision;
+
+  // `max_spans_per_trace_segment` and `max_bytes_per_trace_segment` limit the
+  // spans recorded in a trace segment, by their number and by their estimated
+  // encoded size, respectively.  Once a segment reaches either limit, it is
+  // truncated: child spans created in it from then on are not recorded, as
+  // for `early_sampling_decision`, but still propagate trace context.  The
+  // local root span of a truncated segment has the "_dd.trace.truncated" tag,
+  // whose value is the limit that was reached, "spans" or "bytes".  This
+  // protects the tracer from integrations that create a span for every
+  // iteration of an unbounded loop.  Zero, the default, means no limit.
+  Optional<std::size_t> max_spans_per_trace_segment;
+  Optional<std::size_t> max_bytes_per_trace_segment;
+
+  // `span_rollups` selects child spans, such as those of cache lookups or
+  // serialization calls in a loop, that are aggregated rather than recorded
+  // one by one.  Of the finished children of a span that match the same
+  // rollup and that have the same name and resource, only the first is kept,
+  // as a summary: the others are counted into it and discarded as they
+  // finish.  The summary spans the time from the earliest start to the latest
+  // end of the spans it summarizes, is an error if any of them is, and has
+  // the metrics "_dd.rollup.count", "_dd.rollup.errors", and
+  // "_dd.rollup.duration.total", ".min", and ".max", in nanoseconds.  The
+  // other tags of the summary are those of the first span.  The children of a
+  // discarded span are left without their parent, so only spans that have no
+  // children should be rolled up.  Each rollup must have a name.  Empty, the
+  // default, means no rollups.
+  std::vector<SpanRollup> span_rollups;
+
+  // `max_resource_length` and `max_tag_value_length` limit the size, in
+  // bytes, of span resource names and of string tag values, respectively.
+  // Longer values set by `Span::set_resource_name`, `Span::set_tag`, and the
+  // like, or by `SpanConfig`, are truncated, without splitting a UTF-8
+  // encoded character, so that values such as SQL statements or payload
+  // dumps do not bloat the tracer's memory and its payloads.  The Datadog
+  // Agent itself truncates resource names at 5000 bytes and tag values at
+  // 25000 bytes.  Zero, the default, means no limit.
+  Optional<std::size_t> max_resource_length;
+  Optional<std::size_t> max_tag_value_length;
+
+  // `max_memory_bytes` limits the memory that the tracer holds in trace data,
+  // as the estimated encoded size of the spans that trace segments hold after
+  // they finish, of the trace chunks that the Datadog Agent collector
+  // buffers, and of the payloads that it has in flight or keeps to send
+  // again.  As the memory approaches the limit, the tracer degrades in
+  // steps: from half of the limit, trace chunks dropped by sampling are not
+  // sent, even to compute trace metrics; from three quarters, trace segments
+  // are truncated, as for `max_spans_per_trace_segment`, with the
+  // "_dd.trace.truncated" tag value "memory"; and at the limit, no trace
+  // chunks are sent.  Chunks not sent are counted by the
+  // `trace_chunks_dropped` telemetry metric with the tag
+  // `reason:memory_budget`.  The memory is reported by
+  // `Tracer::runtime_stats`.  Zero, the default, means no limit.
+  Optional<std::size_t> max_memory_bytes;
+
+  // `max_cpu_overhead` limits the CPU time that the tracer spends serializing
+  // and otherwise processing traces, as a share of the CPU time of the
+  // process, e.g. 0.02 for two percent.  Once a second, the tracer compares
+  // its cost with the CPU time of the process and, while over the limit,
+  // keeps a smaller share of the traces that the trace sampler would
+  // otherwise keep, dropping the others and tagging their local root with
+  // "_dd.overhead.dropped".  The share kept is reported by
+  // `Tracer::runtime_stats`.  The value must be between zero and one.  Zero,
+  // the default, means no limit.
+  Optional<double> max_cpu_overhead;
+
+  // `tail_sampling_enabled` indicates whether the sampling decision for a
+  // trace that is wholly within this process is made after the trace
+  // finishes, rather than by the trace sampler.  Such a trace began here,
+  // was not propagated to other services, and did not otherwise have its
+  // sampling decision made before its local root finished.  Its chunk is
+  // held for up to `tail_sampling_window_milliseconds`, in a buffer of at
+  // most `tail_sampling_max_buffered_bytes` (estimated) before the buffered
+  // chunks are decided early.  Traces having an error are kept, as are
+  // traces whose local root lasted at least as long as the
+  // `tail_sampling_latency_percentile`th percentile of the recent local
+  // roots having the same service and resource.
+  // Of the other traces, up to `tail_sampling_max_per_second` are kept.  Kept
+  // traces have the sampling mechanism `SamplingMechanism::RULE`, and their
+  // local root has the tag "_dd.tail_sampling.reason", which is "error",
+  // "latency", or "limit".
+  // Traces that are propagated, extracted, or partially flushed, and traces
+  // whose decision was otherwise made early, are sampled as usual.
+  // `tail_sampling_enabled` defaults to `false`, and the others to 1000,
+  // 4 MiB, 99, and 10, respectively.
+  Optional<bool> tail_sampling_enabled;
+  Optional<int> tail_sampling_window_milliseconds;
+  Optional<std::size_t> tail_sampling_max_buffered_bytes;
+  Optional<double> tail_sampling_latency_percentile;
+  Optional<double> tail_sampling_max_per_second;
+
+  // `orphaned_segment_max_age_seconds` is the age beyond which a trace
+  // segment whose spans have not all finished is presumed to have leaked a
+  // span, e.g. into an object that is never destroyed.  Such a segment's spans
+  // are then sent, with the unfinished ones tagged as such, and their memory
+  // is reclaimed, rather than kept until the leaked span is destroyed.  Trace
+  // segments are checked every `orphaned_segment_max_age_seconds`, so a
+  // segment is flushed when it is up to twice as old.  The maximum age must
+  // exceed the lifetime of any trace segment that is not leaked: spans of a
+  // flushed segment may still be destroyed, but their changes are not sent,
+  // and they must not be used concurrently with the flush.  The number of
+  // segments flushed is reported by `Tracer::runtime_stats`.  If zero, which
+  // is the default, trace segments are not checked.
+  Optional<int> orphaned_segment_max_age_seconds;
+};
+
+// `TracerUpdate` contains the properties of a `TracerConfig` that can be
+// changed in a live `Tracer` (see `Tracer::reconfigure`).  A property that is
+// null is left unchanged.  The new values take the place of those from the
+// `TracerConfig` and the environment.  As with those, values received through
+// Remote Configuration take precedence over them while they are in effect.
+struct TracerUpdate {
+  // The defaults of spans created after the update.  `service` must not be
+  // empty.
+  Optional<std::string> service;
+  Optional<std::string> service_type;
+  Optional<std::string> environment;
+  Optional<std::string> version;
+  Optional<std::string> name;
+  Optional<std::unordered_map<std::string, std::string>> tags;
+
+  // Replace the trace sampling rules and the overall sample rate, as in
+  // `TraceSamplerConfig`.  A null `trace_sample_rate` keeps the current one.
+  Optional<std::vector<TraceSamplerConfig::Rule>> trace_sampling_rules;
+  Optional<double> trace_sample_rate;
+
+  Optional<bool> report_traces;
 };
 
 // `FinalizedTracerConfig` contains `Tracer` implementation details derived from
@@ -209,7 +474,9 @@ class FinalizedTracerConfig final {
   SpanDefaults defaults;
 
   std::variant<std::monostate, FinalizedDatadogAgentConfig,
-               std::shared_ptr<Collector>>
+               FinalizedDatadogIntakeConfig, FinalizedOtlpExporterConfig,
+               FinalizedDatagramCollectorConfig,
+               FinalizedRecordingCollectorConfig, std::shared_ptr<Collector>>
       collector;
 
   FinalizedTraceSamplerConfig trace_sampler;
@@ -234,9 +501,44 @@ class FinalizedTracerConfig final {
   HTTPClient::URL agent_url;
   std::shared_ptr<EventScheduler> event_scheduler;
   std::shared_ptr<HTTPClient> http_client;
+  // Whether `event_scheduler` and `http_client` were made by this library,
+  // rather than specified in the `TracerConfig`.
+  bool default_event_scheduler;
+  bool default_http_client;
+  // The process in which the default HTTP clients and event schedulers of
+  // this configuration were made.  A `Tracer` created in another process,
+  // e.g. in a worker forked after the configuration was finalized, makes its
+  // own (see `Tracer::Tracer`).
+  int process_id;
   bool tracing_enabled;
   HttpEndpointCalculationMode resource_renaming_mode;
   std::unordered_map<std::string, std::string> process_tags;
+  bool trace_arena_enabled;
+  std::pmr::memory_resource* memory_resource;
+  bool obfuscation_enabled;
+  // Null if no headers are tagged.
+  std::shared_ptr<const HeaderTags> header_tags;
+  // Null if no baggage items are tagged.
+  std::shared_ptr<const BaggageTags> baggage_tags;
+  // Zero if partial flushing is disabled.
+  std::size_t partial_flush_min_spans;
+  bool early_sampling_decision;
+  // Zero if not limited.
+  std::size_t max_spans_per_trace_segment;
+  std::size_t max_bytes_per_trace_segment;
+  std::vector<SpanRollup> span_rollups;
+  std::size_t max_resource_length;
+  std::size_t max_tag_value_length;
+  std::size_t max_memory_bytes;
+  // Zero if not limited.
+  double max_cpu_overhead;
+  bool tail_sampling_enabled;
+  std::chrono::steady_clock::duration tail_sampling_window;
+  std::size_t tail_sampling_max_buffered_bytes;
+  double tail_sampling_latency_percentile;
+  double tail_sampling_max_per_second;
+  // Zero if orphaned trace segments are not flushed.
+  std::chrono::steady_clock::duration orphaned_segment_max_age;
 };
 
 // Return a `FinalizedTracerConfig` from the specified `config` and from any
@@ -245,6 +547,9 @@ class FinalizedTracerConfig final {
 // Optionally specify a `clock` used to calculate span start times, span
 // durations, and timeouts.  If `clock` is not specified, then `default_clock`
 // is used.
+// The result can be finalized once, e.g. in the master process of a prefork
+// server, and then used to create a `Tracer` in each forked worker, which
+// neither reads the environment nor parses sampling rules again.
 Expected<FinalizedTracerConfig> finalize_config(const TracerConfig& config);
 Expected<FinalizedTracerConfig> finalize_config(const TracerConfig& config,
                                                 const Clock& clock);
@@ -0,0 +1,130 @@
+#include "adaptive_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+constexpr std::chrono::steady_clock::duration window =
+    std::chrono::seconds(1);
+
+// Each window, the average throughput of a key keeps this fraction of its
+// previous value, and takes the rest from the window's count.
+constexpr double decay = 0.5;
+
+// Keys that are not seen for this many windows are forgotten.
+constexpr unsigned max_idle_windows = 60;
+
+// Root spans of new keys share this key once `max_keys` keys are tracked.
+// Other keys are never empty, since they contain a null character.
+const std::string overflow_key;
+
+}  // namespace
+
+AdaptiveSampler::AdaptiveSampler(const Clock& clock, double target_per_second)
+    : clock_(clock),
+      target_per_second_(target_per_second),
+      window_end_((clock_().tick + window).time_since_epoch().count()) {}
+
+Rate AdaptiveSampler::sample_rate(StringView service, StringView resource) {
+  const auto now = clock_().tick;
+  if (now.time_since_epoch().count() >=
+      window_end_.load(std::memory_order_relaxed)) {
+    roll(now);
+  }
+
+  // The key is built in storage that is reused by later calls on this thread,
+  // so that the common case does not allocate.
+  thread_local std::string key;
+  assign(key, service);
+  key += '\0';
+  append(key, resource);
+
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto found = entries_.find(key);
+    if (found != entries_.end()) {
+      found->second.count.fetch_add(1, std::memory_order_relaxed);
+      return *Rate::from(found->second.rate.load(std::memory_order_relaxed));
+    }
+  }
+
+  std::lock_guard<std::shared_mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found == entries_.end()) {
+    found = entries_
+                .try_emplace(entries_.size() < max_keys ? key : overflow_key)
+                .first;
+  }
+  found->second.count.fetch_add(1, std::memory_order_relaxed);
+  return *Rate::from(found->second.rate.load(std::memory_order_relaxed));
+}
+
+void AdaptiveSampler::roll(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::shared_mutex> lock(mutex_);
+  const std::chrono::steady_clock::time_point end{
+      std::chrono::steady_clock::duration{
+          window_end_.load(std::memory_order_relaxed)}};
+  if (now < end) {
+    // Another thread ended the window first.
+    return;
+  }
+  // The windows after the first that elapsed without a call had no root
+  // spans.
+  const auto empty_windows = (now - end) / window;
+
+  std::vector<std::pair<double, Entry*>> by_average;
+  by_average.reserve(entries_.size());
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    Entry& entry = iter->second;
+    const auto count = entry.count.exchange(0, std::memory_order_relaxed);
+    if (!entry.measured) {
+      entry.average = double(count);
+      entry.measured = true;
+    } else {
+      entry.average = decay * entry.average + (1 - decay) * double(count);
+    }
+    entry.average *= std::pow(decay, double(empty_windows));
+    entry.idle_windows =
+        count ? 0 : entry.idle_windows + 1 + unsigned(empty_windows);
+
+    if (entry.idle_windows > max_idle_windows) {
+      iter = entries_.erase(iter);
+    } else {
+      by_average.emplace_back(entry.average, &entry);
+      ++iter;
+    }
+  }
+
+  // Keys whose average is below an even share of what remains of the target
+  // keep all of their traces.  The others split the remainder evenly.
+  std::sort(by_average.begin(), by_average.end(),
+            [](const auto& left, const auto& right) {
+              return left.first < right.first;
+            });
+  double remaining = target_per_second_;
+  for (std::size_t i = 0; i < by_average.size(); ++i) {
+    const auto [average, entry] = by_average[i];
+    const double share = remaining / double(by_average.size() - i);
+    double rate = 1.0;
+    if (average > share) {
+      rate = share / average;
+      remaining -= share;
+    } else {
+      remaining -= average;
+    }
+    entry->rate.store(rate, std::memory_order_relaxed);
+  }
+
+  const auto next_end = end + (empty_windows + 1) * window;
+  window_end_.store(next_end.time_since_epoch().count(),
+                    std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+}  // namespace datadog
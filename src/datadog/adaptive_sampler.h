@@ -0,0 +1,81 @@
+#pragma once
+
+// This component provides a `class`, `AdaptiveSampler`, that computes sample
+// rates for root spans from the local throughput of each (service, resource)
+// pair, so that the process keeps approximately a target number of traces per
+// second without waiting for rates from the Datadog Agent.
+//
+// `TraceSampler` consults an `AdaptiveSampler` when
+// `TraceSamplerConfig::adaptive_target_per_second` is set and no sampling rule
+// matches the root span.
+//
+// Throughput is measured in one-second windows.  At the end of each window,
+// the number of root spans seen for each pair is folded into an exponentially
+// decaying average.  The target is then divided among the pairs so that
+// low-volume pairs keep all of their traces, and the rest of the target is
+// split evenly among the high-volume pairs.  A pair seen for the first time
+// has sample rate one until the end of its first window.
+//
+// Pairs that are not seen for a minute are forgotten.  At most
+// `AdaptiveSampler::max_keys` pairs are tracked; beyond that, root spans of
+// new pairs share a single rate.
+//
+// `AdaptiveSampler` is safe to use from multiple threads.  `sample_rate` takes
+// a shared lock, except when it sees a pair for the first time or the end of a
+// window, when it takes an exclusive lock.
+
+#include <datadog/clock.h>
+#include <datadog/rate.h>
+#include <datadog/string_view.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace datadog {
+namespace tracing {
+
+class AdaptiveSampler {
+ public:
+  static constexpr std::size_t max_keys = 1000;
+
+  AdaptiveSampler(const Clock& clock, double target_per_second);
+
+  AdaptiveSampler(const AdaptiveSampler&) = delete;
+  AdaptiveSampler& operator=(const AdaptiveSampler&) = delete;
+
+  // Count a root span having the specified `service` and `resource`, and
+  // return the sample rate for it.
+  Rate sample_rate(StringView service, StringView resource);
+
+  double target_per_second() const { return target_per_second_; }
+
+ private:
+  struct Entry {
+    // The number of root spans seen in the current window.
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<double> rate{1.0};
+    // The following are guarded by an exclusive lock on `mutex_`.
+    double average = 0.0;
+    bool measured = false;
+    unsigned idle_windows = 0;
+  };
+
+  Clock clock_;
+  double target_per_second_;
+  std::shared_mutex mutex_;
+  // Keys are the service, a null character, and the resource.
+  std::unordered_map<std::string, Entry> entries_;
+  // The end of the current window, as a count of steady clock ticks.
+  std::atomic<std::chrono::steady_clock::rep> window_end_;
+
+  // End the current window (and any that elapsed without calls) if the
+  // specified `now` is past its end, and recompute the sample rates.
+  void roll(std::chrono::steady_clock::time_point now);
+};
+
+}  // namespace tracing
+}  // namespace datadog
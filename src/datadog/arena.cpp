@@ -0,0 +1,187 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Freed chunks are kept here for reuse by other arenas, up to a limit.  The
+// limit bounds how much memory the free list can pin after a burst of large
+// traces.
+constexpr std::size_t max_free_chunks = 256;
+
+struct ChunkPool {
+  std::mutex mutex;
+  std::vector<void*> free_chunks;
+
+  void* acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!free_chunks.empty()) {
+        void* chunk = free_chunks.back();
+        free_chunks.pop_back();
+        return chunk;
+      }
+    }
+    return ::operator new(Arena::chunk_size);
+  }
+
+  void reserve(std::size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    count = std::min(count, max_free_chunks);
+    while (free_chunks.size() < count) {
+      free_chunks.push_back(::operator new(Arena::chunk_size));
+    }
+  }
+
+  void release(const std::pmr::vector<void*>& chunks) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (void* chunk : chunks) {
+      if (free_chunks.size() < max_free_chunks) {
+        free_chunks.push_back(chunk);
+      } else {
+        ::operator delete(chunk);
+      }
+    }
+  }
+};
+
+ChunkPool& chunk_pool() {
+  // Intentionally leaked, so that arenas released during static destruction
+  // (e.g. by a global `Tracer`) still have a pool to return chunks to.
+  static ChunkPool* pool = new ChunkPool;
+  return *pool;
+}
+
+// Allocations in a chunk begin after its header (see `Arena::ChunkHeader`),
+// at an offset that keeps them aligned.
+constexpr std::size_t chunk_header_size =
+    (sizeof(std::atomic<std::size_t>) + alignof(std::max_align_t) - 1) &
+    ~(alignof(std::max_align_t) - 1);
+
+}  // namespace
+
+struct Arena::ChunkHeader {
+  // The offset from the beginning of the chunk of its first unused byte.
+  std::atomic<std::size_t> used;
+};
+
+Arena::Arena(std::pmr::memory_resource* upstream)
+    : upstream_(upstream),
+      ref_count_(1),
+      current_(nullptr),
+      chunks_(upstream ? upstream : std::pmr::new_delete_resource()),
+      oversized_(upstream ? upstream : std::pmr::new_delete_resource()) {}
+
+Arena::~Arena() {
+  if (upstream_) {
+    for (void* chunk : chunks_) {
+      upstream_->deallocate(chunk, chunk_size, alignof(std::max_align_t));
+    }
+    for (const auto& [block, size] : oversized_) {
+      upstream_->deallocate(block, size, alignof(std::max_align_t));
+    }
+    return;
+  }
+
+  chunk_pool().release(chunks_);
+  for (const auto& entry : oversized_) {
+    ::operator delete(entry.first);
+  }
+}
+
+void Arena::reserve_chunks(std::size_t count) { chunk_pool().reserve(count); }
+
+Arena* Arena::create(std::pmr::memory_resource* upstream) {
+  if (!upstream) {
+    return new Arena(nullptr);
+  }
+  void* storage = upstream->allocate(sizeof(Arena), alignof(Arena));
+  return new (storage) Arena(upstream);
+}
+
+void Arena::retain() noexcept {
+  ref_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Arena::release() noexcept {
+  if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  if (std::pmr::memory_resource* const upstream = upstream_) {
+    this->~Arena();
+    upstream->deallocate(this, sizeof(Arena), alignof(Arena));
+  } else {
+    delete this;
+  }
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+  assert(alignment <= alignof(std::max_align_t));
+  assert((alignment & (alignment - 1)) == 0);
+
+  if (size > chunk_size / 4) {
+    return allocate_oversized(size);
+  }
+
+  for (;;) {
+    ChunkHeader* const chunk = current_.load(std::memory_order_acquire);
+    if (chunk) {
+      if (void* result = allocate_from(*chunk, size, alignment)) {
+        return result;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    grow(chunk);
+  }
+}
+
+void* Arena::allocate_from(ChunkHeader& chunk, std::size_t size,
+                           std::size_t alignment) {
+  // Chunks are aligned to `alignof(std::max_align_t)`, so aligning the offset
+  // aligns the address.
+  std::size_t used = chunk.used.load(std::memory_order_relaxed);
+  std::size_t begin;
+  do {
+    begin = (used + alignment - 1) & ~(alignment - 1);
+    if (begin + size > chunk_size) {
+      return nullptr;
+    }
+  } while (!chunk.used.compare_exchange_weak(used, begin + size,
+                                             std::memory_order_relaxed));
+  return reinterpret_cast<char*>(&chunk) + begin;
+}
+
+void* Arena::allocate_oversized(std::size_t size) {
+  void* block = upstream_
+                    ? upstream_->allocate(size, alignof(std::max_align_t))
+                    : ::operator new(size);
+  std::lock_guard<std::mutex> lock(mutex_);
+  oversized_.emplace_back(block, size);
+  return block;
+}
+
+void Arena::grow(ChunkHeader* full) {
+  // `mutex_` must already be locked.
+  if (current_.load(std::memory_order_relaxed) != full) {
+    // Another thread replaced the chunk meanwhile.
+    return;
+  }
+  void* chunk =
+      upstream_ ? upstream_->allocate(chunk_size, alignof(std::max_align_t))
+                : chunk_pool().acquire();
+  chunks_.push_back(chunk);
+  current_.store(new (chunk) ChunkHeader{{chunk_header_size}},
+                 std::memory_order_release);
+}
+
+std::size_t Arena::capacity() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.size() * chunk_size;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,161 @@
+#pragma once
+
+// This component provides a `class`, `Arena`, that is a thread-safe bump
+// allocator, and a class template, `ArenaAllocator`, that adapts `Arena` to the
+// standard library's allocator requirements.
+//
+// An `Arena` hands out memory from large chunks.  Allocating from the current
+// chunk advances an atomic offset within it, without locking; only replacing
+// a full chunk, and allocations too large for a chunk, lock the arena.
+// Individual deallocations are no-ops; instead, all of the arena's memory is
+// released at once when the last reference to the arena is released.
+// Released chunks are kept in a bounded, process-wide free list, so that a
+// subsequent arena can reuse them without going back to the global heap.
+//
+// `Arena` is used by `TraceSegment` (optionally, see
+// `TracerConfig::trace_arena_enabled`) to back the `SpanData` objects of a
+// trace, and their tags.  Since all spans of a trace segment are destroyed
+// together after the segment is sent to a `Collector`, the arena's lifetime
+// matches that of the trace's data.
+//
+// `Arena` is reference counted.  `Arena::create` returns a new arena with a
+// reference count of one.  Each `SpanData` allocated from the arena holds a
+// reference (see `SpanData::make`).
+//
+// An arena can instead obtain all of its memory, including the storage of the
+// `Arena` object itself, from a `std::pmr::memory_resource` supplied by the
+// application (see `TracerConfig::memory_resource`).  Such an arena neither
+// uses the global heap nor shares chunks with other arenas.
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class Arena {
+ public:
+  // The size, in bytes, of the chunks from which allocations are carved.
+  // Allocations larger than a quarter of this size get a chunk of their own.
+  static constexpr std::size_t chunk_size = 8 * 1024;
+
+ private:
+  // Null if memory comes from the process-wide free list of chunks and from
+  // the global heap.
+  std::pmr::memory_resource* const upstream_;
+  std::atomic<std::size_t> ref_count_;
+  // Locked to replace `current_`, and to modify `chunks_` and `oversized_`.
+  mutable std::mutex mutex_;
+  // The chunk from which allocations are carved, or null.  A chunk begins
+  // with a `ChunkHeader`.
+  struct ChunkHeader;
+  std::atomic<ChunkHeader*> current_;
+  std::pmr::vector<void*> chunks_;
+  // The oversized allocations and their sizes.
+  std::pmr::vector<std::pair<void*, std::size_t>> oversized_;
+
+  explicit Arena(std::pmr::memory_resource* upstream);
+  ~Arena();
+
+  void* allocate_oversized(std::size_t size);
+  // Carve the specified `size` bytes aligned to the specified `alignment`
+  // from the specified `chunk`, or return null if they do not fit.
+  static void* allocate_from(ChunkHeader& chunk, std::size_t size,
+                             std::size_t alignment);
+  // Make a new chunk current, unless `current_` is no longer the specified
+  // `full` chunk.  `mutex_` must be locked.
+  void grow(ChunkHeader* full);
+
+ public:
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Add chunks to the process-wide free list until it holds the specified
+  // `count` chunks, or as many as it can hold, so that the arenas of the
+  // first traces do not allocate them.
+  static void reserve_chunks(std::size_t count);
+
+  // Return a new arena whose reference count is one.  Optionally specify an
+  // `upstream` memory resource from which the arena obtains all of its
+  // memory.  `upstream` must outlive the arena.
+  static Arena* create(std::pmr::memory_resource* upstream = nullptr);
+
+  // Increment this arena's reference count.
+  void retain() noexcept;
+  // Decrement this arena's reference count.  If the count reaches zero, then
+  // release all of this arena's memory and destroy this arena.
+  void release() noexcept;
+
+  // Return a pointer to at least the specified `size` bytes of storage aligned
+  // to the specified `alignment`.  The storage remains valid until this arena
+  // is destroyed.  `alignment` must be a power of two not greater than
+  // `alignof(std::max_align_t)`.  This function is thread-safe.
+  void* allocate(std::size_t size, std::size_t alignment);
+
+  // Return the total number of bytes of chunk storage currently owned by this
+  // arena.
+  std::size_t capacity() const;
+};
+
+// `ArenaAllocator` allocates from an `Arena` if it was constructed with one, or
+// from the global heap otherwise.  Copies of a container that uses
+// `ArenaAllocator` allocate from the global heap, so that they may safely
+// outlive the arena.
+template <typename T>
+class ArenaAllocator {
+  template <typename U>
+  friend class ArenaAllocator;
+
+  Arena* arena_;
+
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::false_type;
+  using is_always_equal = std::false_type;
+
+  ArenaAllocator() noexcept : arena_(nullptr) {}
+  explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+      : arena_(other.arena_) {}
+
+  T* allocate(std::size_t n) {
+    if (!arena_) {
+      return std::allocator<T>{}.allocate(n);
+    }
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, std::size_t n) noexcept {
+    if (!arena_) {
+      std::allocator<T>{}.deallocate(pointer, n);
+    }
+    // Arena memory is released all at once by the arena.
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const noexcept {
+    return ArenaAllocator{};
+  }
+
+  Arena* arena() const noexcept { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept {
+    return arena_ == other.arena_;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+    return arena_ != other.arena_;
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,189 @@
+#include <datadog/async_logger.h>
+#include <datadog/error.h>
+
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <typeinfo>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Sites are normally few.  Sites identified by text can be many, and so the
+// rate limiting state is forgotten when there are more than this many.
+constexpr std::size_t max_sites = 1024;
+
+// Return the text written by the specified `write`, formatted in a stream that
+// is reused by each thread.
+std::string format(const Logger::LogFunc& write) {
+  thread_local std::ostringstream stream;
+  stream.clear();
+  // Copy an empty string in, don't move it, so that `stream` keeps its
+  // storage.
+  const std::string empty;
+  stream.str(empty);
+  write(stream);
+  return stream.str();
+}
+
+}  // namespace
+
+AsyncLogger::AsyncLogger(std::shared_ptr<Logger> destination,
+                         AsyncLoggerOptions options)
+    : options_(std::move(options)), destination_(std::move(destination)) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void AsyncLogger::log_error(const LogFunc& write) {
+  log(SiteKey(&write.target_type(), 0), write);
+}
+
+void AsyncLogger::log_startup(const LogFunc& write) {
+  enqueue(format(write), true);
+}
+
+void AsyncLogger::log_error(const Error& error) {
+  log(SiteKey(&typeid(Error), std::size_t(error.code)),
+      [&](std::ostream& stream) { stream << error; });
+}
+
+void AsyncLogger::log_error(StringView message) {
+  const std::string_view text(message.data(), message.size());
+  log(SiteKey(&typeid(StringView), std::hash<std::string_view>()(text)),
+      [&](std::ostream& stream) { stream << message; });
+}
+
+void AsyncLogger::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const std::uint64_t target = queued_count_;
+  written_.wait(lock, [&]() { return written_count_ >= target; });
+}
+
+bool AsyncLogger::admit(const SiteKey& site, std::size_t& suppressed) {
+  const auto now = options_.clock().tick;
+  if (sites_.size() >= max_sites && !sites_.count(site)) {
+    sites_.clear();
+  }
+  Site& state = sites_.try_emplace(site, Site{now, 0, 0}).first->second;
+  if (now - state.period_start >= options_.rate_limit_period) {
+    state.period_start = now;
+    state.logged = 0;
+  }
+  if (state.logged >= options_.max_messages_per_site) {
+    ++state.suppressed;
+    return false;
+  }
+  ++state.logged;
+  suppressed = state.suppressed;
+  state.suppressed = 0;
+  return true;
+}
+
+void AsyncLogger::log(const SiteKey& site, const LogFunc& write) {
+  std::size_t suppressed = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!admit(site, suppressed)) {
+      return;
+    }
+  }
+
+  // Format the message without holding the lock.
+  std::string text = format(write);
+  if (suppressed) {
+    text += " [";
+    text += std::to_string(suppressed);
+    text += " similar messages were suppressed]";
+  }
+  enqueue(std::move(text), false);
+}
+
+void AsyncLogger::enqueue(std::string&& text, bool startup) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!queue_.empty() && queue_.back().startup == startup &&
+        queue_.back().text == text) {
+      ++queue_.back().repeats;
+      return;
+    }
+    if (queue_.size() >= options_.max_queued_messages) {
+      ++dropped_;
+      return;
+    }
+    queue_.push_back(Message{std::move(text), startup, 0});
+    ++queued_count_;
+  }
+  wake_.notify_one();
+}
+
+void AsyncLogger::run() {
+  std::deque<Message> batch;
+  std::string buffer;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [&]() { return shutting_down_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      // `shutting_down_` is true and every message has been written.
+      return;
+    }
+    batch.swap(queue_);
+    const std::size_t dropped = dropped_;
+    dropped_ = 0;
+    lock.unlock();
+
+    for (auto& message : batch) {
+      if (message.repeats) {
+        message.text += " [repeated ";
+        message.text += std::to_string(message.repeats);
+        message.text += " more times]";
+      }
+    }
+    if (dropped) {
+      batch.push_back(Message{std::to_string(dropped) +
+                                  " log messages were dropped because too "
+                                  "many were waiting to be written.",
+                              false, 0});
+    }
+
+    if (destination_) {
+      for (const auto& message : batch) {
+        const auto write = [&](std::ostream& stream) {
+          stream << message.text;
+        };
+        if (message.startup) {
+          destination_->log_startup(write);
+        } else {
+          destination_->log_error(write);
+        }
+      }
+    } else {
+      // Write the whole batch at once, rather than once per message.
+      buffer.clear();
+      for (const auto& message : batch) {
+        buffer += message.text;
+        buffer += '\n';
+      }
+      std::cerr.write(buffer.data(), buffer.size());
+    }
+
+    const std::size_t written = batch.size() - (dropped ? 1 : 0);
+    batch.clear();
+    lock.lock();
+    written_count_ += written;
+    written_.notify_all();
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -1,173 +1,63 @@
 #include <datadog/baggage.h>
 
+#include <string>
+#include <utility>
+
+#include "baggage_parser.h"
+
 namespace datadog {
 namespace tracing {
 
 namespace {
 
-/// Whitespace in RFC 7230 section 3.2.3 definition
-/// BDNF:
-///  - OWS  = *(SP / HTAB)
-///  - SP   = SPACE (0x20)
-///  - HTAB = Horizontal tab (0x09)
-constexpr bool is_whitespace(char c) { return c == 0x20 || c == 0x09; }
-
-constexpr bool is_allowed_key_char(char c) {
-  // clang-format off
-  return (c >= 0x30 && c <= 0x39)   ///< [0-9]
-      || (c >= 0x41 && c <= 0x5A)   ///< [a-z]
-      || (c >= 0x61 && c <= 0x7A)   ///< [A-Z]
-      || (c == 0x21)                ///< "!"
-      || (c >= 0x23 && c <= 0x27)   ///< "#" / "$" / "%" / "&" / "'"
-      || (c == 0x2A)                ///< "*"
-      || (c == 0x2B)                ///< "+"
-      || (c == 0x2D)                ///< "-"
-      || (c == 0x2E)                ///< "."
-      || (c == 0x5E)                ///< "^"
-      || (c == 0x5F)                ///< "_"
-      || (c == 0x60)                ///< "`"
-      || (c == 0x7C)                ///< "|"
-      || (c == 0x7E);               ///< "~"
-  // clang-format on
-}
-
-constexpr bool is_allowed_value_char(char c) {
-  // clang-format off
-  return (c == 0x21)                ///< "!"
-      || (c >= 0x23 && c <= 0x2B)   ///< "#" / "$" / "%" / "&" / "'" / "(" / /< ")" / "*" / "+" / "," / "-"
-      || (c >= 0x2D && c <= 0x5B)   ///< "-" / "." / "/" / [0-9] / ";' / "<" / "=" / ">" / "?" / "@" / [A-Z]
-      || (c >= 0x5D && c <= 0x7E);  ///< "]" / "^" / "_" / "`" / [a-z]
-  // clang-format on
-}
-
-Expected<std::unordered_map<std::string, std::string>, Baggage::Error>
-parse_baggage(StringView input) {
-  std::unordered_map<std::string, std::string> result;
-  if (input.empty()) return result;
-
-  enum class state : char {
-    leading_spaces_key,
-    key,
-    trailing_spaces_key,
-    leading_spaces_value,
-    value,
-    trailing_spaces_value,
-    properties,
-  } internal_state = state::leading_spaces_key;
-
-  size_t beg = 0;
-  size_t tmp_end = 0;
-
-  StringView key;
-  StringView value;
-
-  const size_t end = input.size();
-
-  for (size_t i = 0; i < end; ++i) {
-    auto c = input[i];
-
-    switch (internal_state) {
-      case state::leading_spaces_key: {
-        if (!is_whitespace(c)) {
-          beg = i;
-          tmp_end = i;
-          internal_state = state::key;
-          goto key;
-        }
-      } break;
-
-      case state::key: {
-      key:
-        if (c == '=') {
-          tmp_end = i;
-          goto consume_key;
-        } else if (is_whitespace(c)) {
-          tmp_end = i;
-          internal_state = state::trailing_spaces_key;
-        } else if (!is_allowed_key_char(c)) {
-          return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, i};
-        }
-      } break;
-
-      case state::trailing_spaces_key: {
-        if (c == '=') {
-        consume_key:
-          size_t count = tmp_end - beg;
-          if (count < 1)
-            return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, i};
-
-          key = StringView{input.data() + beg, count};
-          internal_state = state::leading_spaces_value;
-        } else if (!is_whitespace(c)) {
-          return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, i};
-        }
-      } break;
-
-      case state::leading_spaces_value: {
-        if (!is_whitespace(c)) {
-          beg = i;
-          tmp_end = i;
-          internal_state = state::value;
-          goto value;
-        }
-      } break;
-
-      case state::value: {
-      value:
-        if (c == ',') {
-          tmp_end = i;
-          goto consume_value;
-        } else if (c == ';') {
-          tmp_end = i;
-          internal_state = state::properties;
-        } else if (is_whitespace(c)) {
-          tmp_end = i;
-          internal_state = state::trailing_spaces_value;
-        } else if (!is_allowed_value_char(c)) {
-          return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, i};
-        }
-      } break;
-
-      case state::properties: {
-        if (c == ',') {
-          goto consume_value;
-        }
-      } break;
-
-      case state::trailing_spaces_value: {
-        if (c == ',') {
-        consume_value:
-          size_t count = tmp_end - beg;
-          if (count < 1)
-            return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER,
-                                  tmp_end};
-
-          value = StringView{input.data() + beg, count};
-          result.emplace(std::string(key), std::string(value));
-          beg = i;
-          tmp_end = i;
-          internal_state = state::leading_spaces_key;
-        } else if (c == ';') {
-          internal_state = state::properties;
-        } else if (!is_whitespace(c)) {
-          return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, i};
-        }
-      } break;
+using baggage_parser::is_allowed_key_char;
+using baggage_parser::is_allowed_value_char;
+using baggage_parser::parse_baggage;
+
+/// How `Baggage::inject` writes a character of a key or value: as is, or
+/// percent-encoded if the baggage grammar does not allow it there. A ";" in a
+/// value would begin a property, so it is percent-encoded too.
+struct EscapedChar final {
+  char bytes[3];
+  unsigned char size;
+};
+
+struct EscapeTable final {
+  EscapedChar key[256] = {};
+  EscapedChar value[256] = {};
+
+  constexpr EscapeTable() {
+    const char digits[] = "0123456789ABCDEF";
+    for (int i = 0; i < 256; ++i) {
+      const char c = static_cast<char>(i);
+      const EscapedChar as_is{{c, 0, 0}, 1};
+      const EscapedChar escaped{{'%', digits[i >> 4], digits[i & 0xf]}, 3};
+      key[i] = is_allowed_key_char(c) ? as_is : escaped;
+      value[i] = is_allowed_value_char(c) && c != ';' ? as_is : escaped;
     }
   }
+};
+
+constexpr EscapeTable escape_table;
 
-  if (internal_state == state::value) {
-    value = StringView{input.data() + beg, end - beg};
-    result.emplace(std::string(key), std::string(value));
-  } else if (internal_state == state::trailing_spaces_value ||
-             internal_state == state::properties) {
-    value = StringView{input.data() + beg, tmp_end - beg};
-    result.emplace(std::string(key), std::string(value));
-  } else {
-    return Baggage::Error{Baggage::Error::MALFORMED_BAGGAGE_HEADER, end};
+/// Returns the size of the specified `text` once escaped using the specified
+/// `table`.
+size_t escaped_size(StringView text, const EscapedChar (&table)[256]) {
+  size_t size = 0;
+  for (const char c : text) {
+    size += table[static_cast<unsigned char>(c)].size;
   }
+  return size;
+}
 
-  return result;
+/// Appends the specified `text`, escaped using the specified `table`, to the
+/// specified `destination`.
+void append_escaped(std::string& destination, StringView text,
+                    const EscapedChar (&table)[256]) {
+  for (const char c : text) {
+    const EscapedChar& escaped = table[static_cast<unsigned char>(c)];
+    destination.append(escaped.bytes, escaped.size);
+  }
 }
 
 }  // namespace
@@ -178,105 +68,209 @@ Baggage::Baggage(size_t max_capacity) : max_capacity_(max_capacity) {
 
 Baggage::Baggage(std::unordered_map<std::string, std::string> baggage,
                  size_t max_capacity)
-    : max_capacity_(max_capacity), baggage_(std::move(baggage)) {}
+    : max_capacity_(max_capacity) {
+  items_.reserve(baggage.size());
+  for (const auto& [key, value] : baggage) {
+    const size_t key_begin = store(key);
+    const size_t value_begin = store(value);
+    items_.push_back(Item{key_begin, key.size(), value_begin, value.size()});
+  }
+}
+
+StringView Baggage::key(const Item& item) const {
+  return StringView{buffer_.data() + item.key_begin, item.key_size};
+}
+
+StringView Baggage::value(const Item& item) const {
+  return StringView{buffer_.data() + item.value_begin, item.value_size};
+}
+
+const Baggage::Item* Baggage::find(StringView key) const {
+  for (const auto& item : items_) {
+    if (this->key(item) == key) return &item;
+  }
+  return nullptr;
+}
+
+size_t Baggage::store(StringView text) {
+  const size_t begin = buffer_.size();
+  buffer_.append(text.data(), text.size());
+  return begin;
+}
+
+void Baggage::discard(size_t bytes) {
+  unused_bytes_ += bytes;
+  if (unused_bytes_ <= buffer_.size() / 2) return;
+
+  std::string compacted;
+  compacted.reserve(buffer_.size() - unused_bytes_);
+  for (auto& item : items_) {
+    const size_t key_begin = compacted.size();
+    compacted.append(buffer_, item.key_begin, item.key_size);
+    const size_t value_begin = compacted.size();
+    compacted.append(buffer_, item.value_begin, item.value_size);
+    item.key_begin = key_begin;
+    item.value_begin = value_begin;
+  }
+  buffer_ = std::move(compacted);
+  unused_bytes_ = 0;
+}
 
 Optional<StringView> Baggage::get(StringView key) const {
-  auto it = baggage_.find(std::string(key));
-  if (it == baggage_.cend()) return nullopt;
+  const Item* found = find(key);
+  if (found == nullptr) return nullopt;
 
-  return it->second;
+  return value(*found);
 }
 
 bool Baggage::set(std::string key, std::string value) {
-  baggage_[key] = value;
+  is_header_ = false;
+  const size_t value_begin = store(value);
+  if (const Item* found = find(key)) {
+    auto& item = items_[found - items_.data()];
+    const size_t old_value_size = item.value_size;
+    item.value_begin = value_begin;
+    item.value_size = value.size();
+    discard(old_value_size);
+    return true;
+  }
+
+  const size_t key_begin = store(key);
+  items_.push_back(Item{key_begin, key.size(), value_begin, value.size()});
   return true;
 }
 
-void Baggage::remove(StringView key) { baggage_.erase(std::string(key)); }
+void Baggage::remove(StringView key) {
+  const Item* found = find(key);
+  if (found == nullptr) return;
+
+  is_header_ = false;
+  const size_t bytes = found->key_size + found->value_size;
+  items_.erase(items_.begin() + (found - items_.data()));
+  discard(bytes);
+}
 
-void Baggage::clear() { baggage_.clear(); }
+void Baggage::clear() {
+  is_header_ = false;
+  buffer_.clear();
+  items_.clear();
+  unused_bytes_ = 0;
+}
 
-size_t Baggage::size() const { return baggage_.size(); }
+size_t Baggage::size() const { return items_.size(); }
 
-bool Baggage::empty() const { return baggage_.empty(); }
+bool Baggage::empty() const { return items_.empty(); }
 
-bool Baggage::contains(StringView key) const {
-  auto found = baggage_.find(std::string(key));
-  return found != baggage_.cend();
-}
+bool Baggage::contains(StringView key) const { return find(key) != nullptr; }
 
 void Baggage::visit(std::function<void(StringView, StringView)>&& visitor) {
-  for (const auto& [key, value] : baggage_) {
-    visitor(key, value);
+  for (const auto& item : items_) {
+    visitor(key(item), value(item));
+  }
+}
+
+bool Baggage::operator==(const Baggage& rhs) const {
+  if (items_.size() != rhs.items_.size()) return false;
+  for (const auto& item : items_) {
+    if (rhs.get(key(item)) != value(item)) return false;
   }
+  return true;
 }
 
 Expected<void> Baggage::inject(DictWriter& writer, const Options& opts) const {
-  auto n = baggage_.size();
+  auto n = items_.size();
   if (n == 0) return {};
 
+  if (is_header_ && n <= opts.max_items && buffer_.size() <= opts.max_bytes) {
+    // The items are exactly those extracted, so forward the extracted header.
+    writer.set("baggage", buffer_);
+    return {};
+  }
+
   Expected<void> res;
   if (n > opts.max_items) {
     std::string err_msg = "injected ";
     err_msg += std::to_string(opts.max_items);
     err_msg += " out of ";
-    err_msg += std::to_string(baggage_.size());
+    err_msg += std::to_string(n);
     err_msg += " baggage items";
     res = datadog::tracing::Error{
         datadog::tracing::Error::Code::BAGGAGE_MAXIMUM_ITEMS_REACHED, err_msg};
   }
 
-  // TODO(@dmehala): Memory alloc optimization, (re)use fixed size buffer.
-  std::string seralized_baggage;
-  seralized_baggage.reserve(opts.max_bytes);
-
-  auto it = baggage_.cbegin();
-  seralized_baggage += it->first;
-  seralized_baggage += "=";
-  seralized_baggage += it->second;
-  if (seralized_baggage.size() > opts.max_bytes) {
-    return datadog::tracing::Error{
-        datadog::tracing::Error::Code::BAGGAGE_MAXIMUM_BYTES_REACHED,
-        "reached maximum bytes size limit"};
-  }
-
-  size_t items = 1;
-  for (it++; it != baggage_.cend() && ++items < opts.max_items; ++it) {
-    std::string buffer;
-    buffer += ",";
-    buffer += it->first;
-    buffer += "=";
-    buffer += it->second;
-
-    if (buffer.size() + seralized_baggage.size() > opts.max_bytes) {
+  // The header is written into storage that is reused by later calls on this
+  // thread. Each item's size is computed before it is written, so that the
+  // header stops at the last item that fits in `opts.max_bytes`.
+  thread_local std::string header;
+  header.clear();
+  size_t items = 0;
+  for (const auto& item : items_) {
+    if (items == opts.max_items) break;
+
+    const size_t size = (items == 0 ? 0 : 1) +
+                        escaped_size(key(item), escape_table.key) + 1 +
+                        escaped_size(value(item), escape_table.value);
+    if (header.size() + size > opts.max_bytes) {
       res = datadog::tracing::Error{
           datadog::tracing::Error::Code::BAGGAGE_MAXIMUM_BYTES_REACHED,
           "reached maximum bytes size limit"};
+      if (items == 0) return res;
       break;
     }
 
-    seralized_baggage += buffer;
+    if (items != 0) header += ',';
+    append_escaped(header, key(item), escape_table.key);
+    header += '=';
+    append_escaped(header, value(item), escape_table.value);
+    ++items;
   }
 
   /// NOTE(@dmehala): It is the writer's responsibility to write the header,
-  /// including percent-encoding.
-  writer.set("baggage", seralized_baggage);
+  /// including percent-encoding.  Only the characters that would otherwise
+  /// make the header malformed are percent-encoded here.
+  writer.set("baggage", header);
   return res;
 }
 
+size_t Baggage::encoded_size() const {
+  if (is_header_) return buffer_.size();
+
+  size_t size = 0;
+  for (const auto& item : items_) {
+    size += (size == 0 ? 0 : 1) + escaped_size(key(item), escape_table.key) +
+            1 + escaped_size(value(item), escape_table.value);
+  }
+  return size;
+}
+
 Expected<Baggage, Baggage::Error> Baggage::extract(const DictReader& headers) {
   auto found = headers.lookup("baggage");
   if (!found) {
     return Baggage::Error{Error::MISSING_HEADER};
   }
 
-  // TODO(@dmehala): Avoid allocation
-  auto bv = parse_baggage(*found);
-  if (auto error = bv.if_error()) {
+  // The header value is the buffer, and the items refer to it.
+  Baggage result;
+  result.buffer_.assign(found->data(), found->size());
+  result.is_header_ = true;
+  const char* const begin = result.buffer_.data();
+  auto error = parse_baggage(
+      result.buffer_, [&](StringView key, StringView value) {
+        if (result.find(key) != nullptr) {
+          // The first value of a key is used. The header cannot be injected
+          // as is, because it has the other values too.
+          result.is_header_ = false;
+          result.unused_bytes_ += key.size() + value.size();
+          return;
+        }
+        result.items_.push_back(Item{size_t(key.data() - begin), key.size(),
+                                     size_t(value.data() - begin),
+                                     value.size()});
+      });
+  if (error) {
     return *error;
   }
 
-  Baggage result(*bv);
   return result;
 }
 
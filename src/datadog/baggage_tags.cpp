@@ -0,0 +1,83 @@
+#include "baggage_tags.h"
+
+#include <datadog/span.h>
+
+#include <array>
+#include <string>
+#include <utility>
+
+#include "baggage_parser.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<BaggageTags> BaggageTags::compile(
+    const std::vector<std::string>& keys) {
+  if (keys.size() > max_keys) {
+    std::string message;
+    message += "At most ";
+    message += std::to_string(max_keys);
+    message += " baggage keys can be tagged, but ";
+    message += std::to_string(keys.size());
+    message += " are configured.";
+    return Error{Error::TRACER_INVALID_BAGGAGE_TAG_KEYS, std::move(message)};
+  }
+
+  BaggageTags result;
+  for (const auto& key : keys) {
+    if (key.empty()) {
+      return Error{Error::TRACER_INVALID_BAGGAGE_TAG_KEYS,
+                   "A tagged baggage key must not be empty."};
+    }
+    for (const char c : key) {
+      if (!baggage_parser::is_allowed_key_char(c)) {
+        std::string message;
+        message += "The baggage key \"";
+        message += key;
+        message += "\" has a character that baggage keys cannot have.";
+        return Error{Error::TRACER_INVALID_BAGGAGE_TAG_KEYS,
+                     std::move(message)};
+      }
+    }
+    for (const Entry& other : result.entries_) {
+      if (other.key == key) {
+        std::string message;
+        message += "The baggage key \"";
+        message += key;
+        message += "\" is tagged more than once.";
+        return Error{Error::TRACER_INVALID_BAGGAGE_TAG_KEYS,
+                     std::move(message)};
+      }
+    }
+    result.entries_.push_back(Entry{key, "baggage." + key});
+  }
+  return result;
+}
+
+Optional<Baggage::Error> BaggageTags::set_tags(StringView header,
+                                               Span& span) const {
+  // The values refer to `header`, and are set as tags only once the whole
+  // header is known to be well-formed.
+  std::array<Optional<StringView>, max_keys> values;
+  auto error = baggage_parser::parse_baggage(
+      header, [&](StringView key, StringView value) {
+        for (std::size_t i = 0; i < entries_.size(); ++i) {
+          if (!values[i] && entries_[i].key == key) {
+            values[i] = value;
+            return;
+          }
+        }
+      });
+  if (error) {
+    return error;
+  }
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    if (values[i]) {
+      span.set_tag(entries_[i].tag, *values[i]);
+    }
+  }
+  return nullopt;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,59 @@
+#pragma once
+
+// This component provides a class, `BaggageTags`, that is the compiled form of
+// `TracerConfig::baggage_tag_keys`: the baggage items whose values become tags
+// of spans.
+//
+// `finalize_config` makes the tag name, "baggage.<key>", of each configured
+// key, so that tagging a span formats nothing.  `Tracer::extract_span` then
+// parses the request's "baggage" header once, and tags the local root span
+// with the configured items as the parser finds them.  No `Baggage` is made,
+// and the other items are not copied.
+//
+// Baggage keys are case-sensitive.  If a key appears more than once in a
+// header, then only its first occurrence is used, as in `Baggage::extract`.
+
+#include <datadog/baggage.h>
+#include <datadog/expected.h>
+#include <datadog/optional.h>
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class Span;
+
+class BaggageTags {
+ public:
+  struct Entry {
+    // The baggage key.
+    std::string key;
+    // The name of the tag given the item's value, "baggage.<key>".
+    std::string tag;
+  };
+
+  // The most baggage keys that can be tagged.
+  static constexpr std::size_t max_keys = 16;
+
+  // Return the compiled form of the specified `keys`.  Return an error if a
+  // key is empty, repeated, or not allowed by the baggage grammar, or if
+  // there are more than `max_keys`.
+  static Expected<BaggageTags> compile(const std::vector<std::string>& keys);
+
+  // Set on the specified `span` the tag of each configured item of the
+  // specified "baggage" `header`.  Return an error, and set no tags, if
+  // `header` is malformed.
+  Optional<Baggage::Error> set_tags(StringView header, Span& span) const;
+
+  const std::vector<Entry>& entries() const { return entries_; }
+
+ private:
+  std::vector<Entry> entries_;
+};
+
+}  // namespace tracing
+}  // namespace datadog
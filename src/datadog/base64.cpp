@@ -3,19 +3,25 @@
 #include <cstddef>
 #include <cstdint>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DD_TRACE_BASE64_SSSE3
+#include <tmmintrin.h>
+#endif
+
 namespace datadog {
 namespace tracing {
+namespace {
 
 constexpr uint8_t k_sentinel = 255;
 constexpr uint8_t _ = k_sentinel;  // for brevity
-constexpr uint8_t k_eol = 0;
 
-// Invalid inputs are mapped to the value 255. '=' maps to 0.
+// Invalid inputs, including the padding character '=', are mapped to the
+// value 255.
 constexpr uint8_t k_base64_table[] = {
     _,  _,  _,  _,  _,  _,  _,  _,     _,  _,  _,  _,  _,  _,  _,  _,  _,  _,
     _,  _,  _,  _,  _,  _,  _,  _,     _,  _,  _,  _,  _,  _,  _,  _,  _,  _,
     _,  _,  _,  _,  _,  _,  _,  62,    _,  _,  _,  63, 52, 53, 54, 55, 56, 57,
-    58, 59, 60, 61, _,  _,  _,  k_eol, _,  _,  _,  0,  1,  2,  3,  4,  5,  6,
+    58, 59, 60, 61, _,  _,  _,  _,     _,  _,  _,  0,  1,  2,  3,  4,  5,  6,
     7,  8,  9,  10, 11, 12, 13, 14,    15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
     25, _,  _,  _,  _,  _,  _,  26,    27, 28, 29, 30, 31, 32, 33, 34, 35, 36,
     37, 38, 39, 40, 41, 42, 43, 44,    45, 46, 47, 48, 49, 50, 51, _,  _,  _,
@@ -28,61 +34,167 @@ constexpr uint8_t k_base64_table[] = {
     _,  _,  _,  _,  _,  _,  _,  _,     _,  _,  _,  _,  _,  _,  _,  _,  _,  _,
     _,  _,  _,  _};
 
-std::string base64_decode(StringView input) {
-  const size_t in_size = input.size();
-
-  std::string output;
-  output.reserve(in_size);
-
-  size_t i = 0;
+// Decode the specified `groups` groups of four base64 characters beginning at
+// `input`, writing three bytes for each to `output`.  Return false if any of
+// the characters is not in the base64 alphabet.
+bool decode_groups(const char* input, std::size_t groups, char* output) {
+  for (; groups != 0; --groups, input += 4, output += 3) {
+    const uint32_t c0 = k_base64_table[static_cast<uint8_t>(input[0])];
+    const uint32_t c1 = k_base64_table[static_cast<uint8_t>(input[1])];
+    const uint32_t c2 = k_base64_table[static_cast<uint8_t>(input[2])];
+    const uint32_t c3 = k_base64_table[static_cast<uint8_t>(input[3])];
+    if ((c0 | c1 | c2 | c3) > 63) {
+      return false;
+    }
 
-  for (; i + 4 < in_size;) {
-    uint32_t c0 = k_base64_table[static_cast<size_t>(input[i++])];
-    uint32_t c1 = k_base64_table[static_cast<size_t>(input[i++])];
-    uint32_t c2 = k_base64_table[static_cast<size_t>(input[i++])];
-    uint32_t c3 = k_base64_table[static_cast<size_t>(input[i++])];
+    const uint32_t bits = c0 << 18 | c1 << 12 | c2 << 6 | c3;
+    output[0] = static_cast<char>(bits >> 16);
+    output[1] = static_cast<char>(bits >> 8);
+    output[2] = static_cast<char>(bits);
+  }
+  return true;
+}
 
-    if (c0 == k_sentinel || c1 == k_sentinel || c2 == k_sentinel ||
-        c3 == k_sentinel) {
-      return "";
+#ifdef DD_TRACE_BASE64_SSSE3
+// Decode blocks of four of the specified `groups` groups of four base64
+// characters beginning at `input`, writing twelve bytes for each block to
+// `output`, until fewer than four groups remain or a block contains a
+// character that is not in the base64 alphabet.  Return the number of groups
+// decoded.  Sixteen bytes are written for each block, so `output` must have
+// room for four bytes more than are decoded.
+//
+// This is the algorithm described by Wojciech Muła in "Base64 decoding with
+// SIMD instructions" [1]: each character's high and low nibbles index tables
+// whose entries have a common bit only if the character is invalid, and the
+// high nibble selects the offset that translates the character to its value.
+//
+// [1]: http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+__attribute__((target("ssse3"))) std::size_t decode_blocks_ssse3(
+    const char* input, std::size_t groups, char* output) {
+  const __m128i lut_lo =
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi =
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  // The offset from a character to its value, by its high nibble, except
+  // that '/' is moved to the otherwise unused index 1.
+  const __m128i lut_roll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+  const __m128i slash = _mm_set1_epi8('/');
+  // Each 32-bit lane holds the values of four characters, one per byte, and
+  // these combine them into the lane's low 24 bits, whose bytes are then
+  // written most significant first.
+  const __m128i merge_pairs = _mm_set1_epi32(0x01400140);
+  const __m128i merge_quads = _mm_set1_epi32(0x00011000);
+  const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                      -1, -1, -1, -1);
+
+  std::size_t done = 0;
+  for (; groups - done >= 4; done += 4, input += 16, output += 12) {
+    const __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+    const __m128i hi_nibbles =
+        _mm_and_si128(_mm_srli_epi32(chars, 4), nibble_mask);
+    const __m128i lo_nibbles = _mm_and_si128(chars, nibble_mask);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                         _mm_setzero_si128())) != 0) {
+      break;
     }
 
-    output.push_back(static_cast<char>(c0 << 2 | (c1 & 0xF0) >> 4));
-    output.push_back(static_cast<char>((c1 & 0x0F) << 4 | ((c2 & 0x3C) >> 2)));
-    output.push_back(static_cast<char>(((c2 & 0x03) << 6) | (c3 & 0x3F)));
+    const __m128i is_slash = _mm_cmpeq_epi8(chars, slash);
+    const __m128i roll =
+        _mm_shuffle_epi8(lut_roll, _mm_add_epi8(is_slash, hi_nibbles));
+    const __m128i values = _mm_add_epi8(chars, roll);
+    const __m128i pairs = _mm_maddubs_epi16(values, merge_pairs);
+    const __m128i quads = _mm_madd_epi16(pairs, merge_quads);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm_shuffle_epi8(quads, order));
   }
+  return done;
+}
 
-  // If padding is missing, return the empty string in lieu of an Error.
-  if ((in_size - i) < 4) return "";
-
-  uint32_t c0 = k_base64_table[static_cast<size_t>(input[i++])];
-  uint32_t c1 = k_base64_table[static_cast<size_t>(input[i++])];
-  uint32_t c2 = k_base64_table[static_cast<size_t>(input[i++])];
-  uint32_t c3 = k_base64_table[static_cast<size_t>(input[i++])];
+bool ssse3_available() {
+  static const bool available = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+  }();
+  return available;
+}
+#endif
+
+bool decode(std::string& destination, StringView input, bool use_vector) {
+  destination.clear();
+  const std::size_t size = input.size();
+  // If padding is missing, then the input is invalid.
+  if (size == 0 || size % 4 != 0) {
+    return false;
+  }
 
-  if (c0 == k_sentinel || c1 == k_sentinel || c2 == k_sentinel ||
-      c3 == k_sentinel) {
-    return "";
+  // The last group might be padded, so it is decoded separately.  Room is
+  // made for its three bytes, and for the four extra bytes that vector
+  // decoding writes.
+  const std::size_t groups = size / 4 - 1;
+  destination.resize(groups * 3 + 3 + 4);
+  char* const output = &destination[0];
+
+  std::size_t done = 0;
+#ifdef DD_TRACE_BASE64_SSSE3
+  if (use_vector && groups >= 4) {
+    done = decode_blocks_ssse3(input.data(), groups, output);
+  }
+#else
+  (void)use_vector;
+#endif
+  if (!decode_groups(input.data() + done * 4, groups - done,
+                     output + done * 3)) {
+    destination.clear();
+    return false;
   }
 
-  if (c2 == k_eol) {
-    // The last quadruplet is of the form "xx==", where only one character needs
-    // to be decoded.
-    output.push_back(static_cast<char>(c0 << 2 | (c1 & 0xF0) >> 4));
-  } else if (c3 == k_eol) {
-    // The last quadruplet is of the form "xxx=", where only two character needs
-    // to be decoded.
-    output.push_back(static_cast<char>(c0 << 2 | (c1 & 0xF0) >> 4));
-    output.push_back(static_cast<char>((c1 & 0x0F) << 4 | ((c2 & 0x3C) >> 2)));
-  } else {
-    // The last quadruplet is not padded -> common use case
-    output.push_back(static_cast<char>(c0 << 2 | (c1 & 0xF0) >> 4));
-    output.push_back(static_cast<char>((c1 & 0x0F) << 4 | ((c2 & 0x3C) >> 2)));
-    output.push_back(static_cast<char>(((c2 & 0x03) << 6) | (c3 & 0x3F)));
+  // The last group is of the form "xxxx", "xxx=", or "xx==".  Its padding is
+  // decoded as zero bits, which are then discarded.
+  const char* const last = input.data() + groups * 4;
+  std::size_t last_size = 3;
+  if (last[3] == '=') {
+    last_size = last[2] == '=' ? 1 : 2;
+  }
+  const char padded[] = {last[0], last[1], last_size > 1 ? last[2] : 'A',
+                         last_size > 2 ? last[3] : 'A'};
+  if (!decode_groups(padded, 1, output + groups * 3)) {
+    destination.clear();
+    return false;
   }
 
+  destination.resize(groups * 3 + last_size);
+  return true;
+}
+
+}  // namespace
+
+std::string base64_decode(StringView input) {
+  std::string output;
+  base64_decode(output, input);
   return output;
 }
 
+bool base64_decode(std::string& destination, StringView input) {
+#ifdef DD_TRACE_BASE64_SSSE3
+  return decode(destination, input, ssse3_available());
+#else
+  return decode(destination, input, false);
+#endif
+}
+
+namespace detail {
+
+bool base64_decode_portable(std::string& destination, StringView input) {
+  return decode(destination, input, false);
+}
+
+}  // namespace detail
 }  // namespace tracing
 }  // namespace datadog
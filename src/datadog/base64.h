@@ -1,5 +1,14 @@
 #pragma once
 
+// This component provides functions that decode padded base64, as used by
+// Remote Configuration for the documents that the Datadog Agent sends.
+//
+// On x86-64 processors that support SSSE3, sixteen characters at a time are
+// decoded using vector instructions.  Otherwise, and for the last four
+// characters of the input, a portable implementation decodes one group of
+// four characters at a time.  Both produce the same result for every input,
+// which the fuzzer in `fuzz/base64/` checks.
+
 #include <datadog/string_view.h>
 
 #include <string>
@@ -8,8 +17,23 @@ namespace datadog {
 namespace tracing {
 
 // Return the result of decoding the specified padded base64-encoded `input`. If
-// `input` is not padded, then return the empty string instead.
+// `input` is not padded, or is otherwise not valid base64, then return the
+// empty string instead.
 std::string base64_decode(StringView input);
 
+// Replace the contents of the specified `destination` with the result of
+// decoding the specified padded base64-encoded `input`, reusing the storage of
+// `destination`.  Return true if `input` is valid.  If `input` is not padded,
+// or is otherwise not valid base64, then return false and leave `destination`
+// empty.  The padding character "=" is valid only as one of the last two
+// characters of `input`.
+bool base64_decode(std::string& destination, StringView input);
+
+namespace detail {
+
+// Behave as `base64_decode`, but without using vector instructions.
+bool base64_decode_portable(std::string& destination, StringView input);
+
+}  // namespace detail
 }  // namespace tracing
 }  // namespace datadog
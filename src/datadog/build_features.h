@@ -0,0 +1,43 @@
+#pragma once
+
+// This component provides constants that indicate which optional features
+// this library was built with.  A feature is compiled out by defining the
+// corresponding preprocessor macro (see the `DD_TRACE_B3_PROPAGATION` and
+// `DD_TRACE_BAGGAGE` CMake options).
+//
+// Code that dispatches to an optional feature tests its constant with
+// `if constexpr`, so that a library built without the feature contains
+// neither the feature's code on that path nor the branch that selects it.
+
+#include <datadog/propagation_style.h>
+
+namespace datadog {
+namespace tracing {
+
+#ifdef DD_TRACE_NO_B3_PROPAGATION
+inline constexpr bool b3_propagation_built = false;
+#else
+inline constexpr bool b3_propagation_built = true;
+#endif
+
+#ifdef DD_TRACE_NO_BAGGAGE
+inline constexpr bool baggage_built = false;
+#else
+inline constexpr bool baggage_built = true;
+#endif
+
+// Return whether this library was built with support for the specified
+// propagation `style`.
+constexpr bool propagation_style_built(PropagationStyle style) {
+  switch (style) {
+    case PropagationStyle::B3:
+      return b3_propagation_built;
+    case PropagationStyle::BAGGAGE:
+      return baggage_built;
+    default:
+      return true;
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
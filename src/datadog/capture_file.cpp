@@ -0,0 +1,189 @@
+#include <datadog/capture_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <new>
+#include <system_error>
+
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Identifies a file that was initialized by `CaptureFile`, in this format.
+constexpr std::uint64_t capture_file_magic = 0x3154504143444444;  // "DDDCAPT1"
+
+// Each record is this header followed by the payload, padded so that the next
+// record begins at an aligned address.
+struct RecordHeader {
+  std::int64_t offset_nanoseconds;
+  std::uint32_t trace_count;
+  std::uint32_t size;
+};
+
+constexpr std::uint64_t record_alignment = alignof(RecordHeader);
+
+std::uint64_t padded(std::uint64_t size) {
+  return (size + record_alignment - 1) / record_alignment * record_alignment;
+}
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Counters in a shared file must not depend on the process.");
+
+}  // namespace
+
+// `Header` is at the beginning of the file, and the records follow it.
+struct CaptureFile::Header {
+  // `capture_file_magic` once the header is initialized.
+  std::uint64_t magic = 0;
+  std::uint64_t capacity = 0;
+  // The number of bytes, and of records, that are completely written.
+  // Readers load them with acquire ordering, so that they see the records.
+  std::atomic<std::uint64_t> used{0};
+  std::atomic<std::uint64_t> records{0};
+  std::atomic<std::uint64_t> dropped{0};
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+CaptureFile::CaptureFile(Header* header, std::size_t mapped_size)
+    : header_(header), mapped_size_(mapped_size) {}
+
+Expected<std::shared_ptr<CaptureFile>> CaptureFile::create(
+    const std::string& path, std::size_t capacity) {
+  static_assert(sizeof(Header) % record_alignment == 0,
+                "Records must begin at an aligned address.");
+  if (capacity <= sizeof(RecordHeader) ||
+      capacity > std::numeric_limits<std::size_t>::max() - sizeof(Header)) {
+    return Error{Error::CAPTURE_FILE_INVALID_CAPACITY,
+                 "CaptureFile: capacity must be large enough to hold a "
+                 "record."};
+  }
+
+  // Truncate the file first, so that the records of a previous capture do
+  // not survive in the new file's pages.
+  std::error_code ignored;
+  std::filesystem::resize_file(path, 0, ignored);
+
+  const std::size_t mapped_size = sizeof(Header) + capacity;
+  void* memory = map_file(path, mapped_size);
+  if (memory == nullptr) {
+    return Error{Error::CAPTURE_FILE_UNAVAILABLE,
+                 "CaptureFile: unable to map the file \"" + path + "\"."};
+  }
+
+  auto* header = new (memory) Header;
+  header->capacity = capacity;
+  header->magic = capture_file_magic;
+  return std::shared_ptr<CaptureFile>(new CaptureFile(header, mapped_size));
+}
+
+Expected<std::shared_ptr<CaptureFile>> CaptureFile::open(
+    const std::string& path) {
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(path, error);
+  if (error) {
+    return Error{Error::CAPTURE_FILE_UNAVAILABLE,
+                 "CaptureFile: unable to read the file \"" + path +
+                     "\": " + error.message()};
+  }
+  if (file_size <= sizeof(Header) ||
+      file_size > std::numeric_limits<std::size_t>::max()) {
+    return Error{Error::CAPTURE_FILE_INVALID_FORMAT,
+                 "CaptureFile: \"" + path + "\" is not a capture file."};
+  }
+
+  // The file is mapped at its own size, so it is not resized.
+  const std::size_t mapped_size = static_cast<std::size_t>(file_size);
+  void* memory = map_file(path, mapped_size);
+  if (memory == nullptr) {
+    return Error{Error::CAPTURE_FILE_UNAVAILABLE,
+                 "CaptureFile: unable to map the file \"" + path + "\"."};
+  }
+
+  auto* header = static_cast<Header*>(memory);
+  if (header->magic != capture_file_magic ||
+      header->capacity != mapped_size - sizeof(Header) ||
+      header->used.load(std::memory_order_acquire) > header->capacity) {
+    unmap_shared_memory(memory, mapped_size);
+    return Error{Error::CAPTURE_FILE_INVALID_FORMAT,
+                 "CaptureFile: \"" + path + "\" is not a capture file."};
+  }
+  return std::shared_ptr<CaptureFile>(new CaptureFile(header, mapped_size));
+}
+
+CaptureFile::~CaptureFile() { unmap_shared_memory(header_, mapped_size_); }
+
+bool CaptureFile::append(std::chrono::nanoseconds offset,
+                         std::size_t trace_count,
+                         std::initializer_list<StringView> payload) {
+  std::uint64_t size = 0;
+  for (const StringView part : payload) {
+    size += part.size();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::uint64_t used = header_->used.load(std::memory_order_relaxed);
+  const std::uint64_t needed = sizeof(RecordHeader) + padded(size);
+  if (size > std::numeric_limits<std::uint32_t>::max() ||
+      needed > header_->capacity - used) {
+    header_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  RecordHeader record;
+  record.offset_nanoseconds = offset.count();
+  record.trace_count = static_cast<std::uint32_t>(
+      std::min<std::size_t>(trace_count,
+                            std::numeric_limits<std::uint32_t>::max()));
+  record.size = static_cast<std::uint32_t>(size);
+  char* destination = header_->data() + used;
+  std::memcpy(destination, &record, sizeof record);
+  destination += sizeof record;
+  for (const StringView part : payload) {
+    std::memcpy(destination, part.data(), part.size());
+    destination += part.size();
+  }
+
+  header_->used.store(used + needed, std::memory_order_release);
+  header_->records.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+bool CaptureFile::next(std::uint64_t& position, Record& record) const {
+  const std::uint64_t used = header_->used.load(std::memory_order_acquire);
+  if (position + sizeof(RecordHeader) > used) {
+    return false;
+  }
+
+  RecordHeader header;
+  const char* source = header_->data() + position;
+  std::memcpy(&header, source, sizeof header);
+  if (sizeof header + padded(header.size) > used - position) {
+    return false;
+  }
+  record.offset = std::chrono::nanoseconds(header.offset_nanoseconds);
+  record.trace_count = header.trace_count;
+  record.payload = StringView(source + sizeof header, header.size);
+  position += sizeof header + padded(header.size);
+  return true;
+}
+
+std::uint64_t CaptureFile::size() const {
+  return header_->records.load(std::memory_order_acquire);
+}
+
+std::size_t CaptureFile::capacity() const {
+  return static_cast<std::size_t>(header_->capacity);
+}
+
+std::uint64_t CaptureFile::dropped() const {
+  return header_->dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -1,12 +1,68 @@
 #include <datadog/clock.h>
 
+#include <atomic>
+#include <cstdint>
+
 namespace datadog {
 namespace tracing {
+namespace {
+
+// `Calibration` is the offset from the steady clock to the system clock that
+// `calibrated_clock` uses, and the steady time at which to measure it again.
+// Both are stored as a count of `std::chrono::steady_clock::duration`, so that
+// they can be read without a lock.
+class Calibration {
+  std::atomic<std::int64_t> offset_;
+  std::atomic<std::int64_t> next_;
+
+  void measure(std::chrono::steady_clock::time_point tick) {
+    const auto wall = std::chrono::system_clock::now();
+    offset_.store(
+        (std::chrono::duration_cast<Duration>(wall.time_since_epoch()) -
+         tick.time_since_epoch())
+            .count(),
+        std::memory_order_relaxed);
+  }
+
+ public:
+  Calibration() {
+    const auto tick = std::chrono::steady_clock::now();
+    measure(tick);
+    next_.store((tick + calibrated_clock_period).time_since_epoch().count(),
+                std::memory_order_relaxed);
+  }
+
+  TimePoint now() {
+    const auto tick = std::chrono::steady_clock::now();
+    auto next = next_.load(std::memory_order_relaxed);
+    // Only the thread that advances `next_` measures the offset.  Meanwhile,
+    // other threads use the previous offset, which is at most a period old.
+    if (tick.time_since_epoch().count() >= next &&
+        next_.compare_exchange_strong(
+            next, (tick + calibrated_clock_period).time_since_epoch().count(),
+            std::memory_order_relaxed)) {
+      measure(tick);
+    }
+    const Duration offset{offset_.load(std::memory_order_relaxed)};
+    return TimePoint{
+        std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                tick.time_since_epoch() + offset)),
+        tick};
+  }
+};
+
+}  // namespace
 
 const Clock default_clock = []() {
   return TimePoint{std::chrono::system_clock::now(),
                    std::chrono::steady_clock::now()};
 };
 
+const Clock calibrated_clock = []() {
+  static Calibration calibration;
+  return calibration.now();
+};
+
 }  // namespace tracing
 }  // namespace datadog
@@ -0,0 +1,14 @@
+#include <datadog/collector.h>
+
+#include "span_data.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<void> Collector::send_chunk(
+    TraceChunk&& chunk, const std::shared_ptr<TraceSampler>& response_handler) {
+  return send(std::move(chunk.spans), response_handler);
+}
+
+}  // namespace tracing
+}  // namespace datadog
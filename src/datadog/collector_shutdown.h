@@ -0,0 +1,46 @@
+#pragma once
+
+// This component provides a function, `shut_down_collector`, that performs the
+// steps shared by the collectors that send traces using an `HTTPClient`
+// (`DatadogAgent`, `DatadogIntake`, and `OtlpExporter`) when they are shut
+// down (see `Collector::shut_down`) or destroyed, so that the traces buffered
+// at exit are not lost.
+
+#include <datadog/event_scheduler.h>
+#include <datadog/http_client.h>
+
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+// Unless the specified `once` was already used, cancel the specified recurring
+// `tasks`, so that they do not run concurrently with shutdown.  Then invoke
+// the specified `flush` with the specified `deadline`.  `flush` is expected to
+// send everything that is buffered, or as much as it can before the deadline.
+// Then wait for the specified `http_client` to finish the requests in flight,
+// but no longer than the deadline.  A collector shuts down at most once, so a
+// collector that was shut down before it is destroyed is destroyed without
+// waiting.
+template <typename Flush>
+void shut_down_collector(std::once_flag& once,
+                         std::vector<EventScheduler::Cancel>& tasks,
+                         Flush&& flush, HTTPClient& http_client,
+                         std::chrono::steady_clock::time_point deadline) {
+  std::call_once(once, [&]() {
+    for (auto&& cancel_task : tasks) {
+      cancel_task();
+    }
+    tasks.clear();
+
+    std::forward<Flush>(flush)(deadline);
+
+    http_client.drain(deadline);
+  });
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,180 @@
+#include "compiled_span_matchers.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <mutex>
+
+#include "span_data.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+std::size_t hash_names(const SpanData& span) {
+  const std::hash<std::string> hash;
+  std::size_t result = hash(span.service);
+  result = result * 31 + hash(span.name);
+  result = result * 31 + hash(span.resource);
+  return result;
+}
+
+}  // namespace
+
+CompiledSpanMatchers::CompiledSpanMatchers(
+    const std::vector<const SpanMatcher*>& matchers)
+    : names_are_literal_(true), has_tag_patterns_(false), cache_full_(false) {
+  matchers_.reserve(matchers.size());
+  for (const SpanMatcher* matcher : matchers) {
+    Matcher compiled{GlobPattern(matcher->service), GlobPattern(matcher->name),
+                     GlobPattern(matcher->resource), {}};
+    for (const auto& [key, pattern] : matcher->tags) {
+      compiled.tags.emplace_back(key, GlobPattern(pattern));
+    }
+    has_tag_patterns_ = has_tag_patterns_ || !compiled.tags.empty();
+    matchers_.push_back(std::move(compiled));
+  }
+
+  // Index the matchers once `matchers_` is complete, since the indices refer
+  // to the patterns in it.
+  for (std::uint32_t index = 0; index < matchers_.size(); ++index) {
+    const Matcher& matcher = matchers_[index];
+    if (matcher.service.is_literal()) {
+      by_service_[matcher.service.literal()].push_back(index);
+    } else {
+      any_service_.push_back(index);
+    }
+    if (matcher.name.is_literal()) {
+      literal_names_.insert(matcher.name.literal());
+    } else {
+      names_are_literal_ = false;
+    }
+  }
+}
+
+std::size_t CompiledSpanMatchers::find(const SpanData& span) const {
+  if (matchers_.empty() || rejects(span)) {
+    return npos;
+  }
+
+  const auto first_match =
+      [&](const std::vector<std::uint32_t>& indices) -> std::size_t {
+    for (const std::uint32_t index : indices) {
+      if (match_tags(matchers_[index], span)) {
+        return index;
+      }
+    }
+    return npos;
+  };
+
+  const std::size_t hash = hash_names(span);
+  {
+    std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+    const auto [begin, end] = cache_.equal_range(hash);
+    for (auto entry = begin; entry != end; ++entry) {
+      const CacheEntry& cached = entry->second;
+      if (cached.service == span.service && cached.name == span.name &&
+          cached.resource == span.resource) {
+        return first_match(cached.candidates);
+      }
+    }
+  }
+
+  auto found = candidates(span);
+  const std::size_t result = first_match(found);
+  if (cache_full_.load(std::memory_order_relaxed)) {
+    return result;
+  }
+  if (!has_tag_patterns_ && !found.empty()) {
+    // Only the first candidate is ever needed.
+    found.resize(1);
+  }
+
+  std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+  if (cache_.size() < max_cache_entries) {
+    // Another thread might have cached the same names meanwhile, in which
+    // case there are now two identical entries, which is harmless.
+    cache_.emplace(hash, CacheEntry{span.service, span.name, span.resource,
+                                    std::move(found)});
+  }
+  if (cache_.size() >= max_cache_entries) {
+    cache_full_.store(true, std::memory_order_relaxed);
+  }
+  return result;
+}
+
+bool CompiledSpanMatchers::rejects(const SpanData& span) const {
+  if (any_service_.empty() && !by_service_.count(span.service)) {
+    return true;
+  }
+  return names_are_literal_ && !literal_names_.count(span.name);
+}
+
+std::vector<std::uint32_t> CompiledSpanMatchers::candidates(
+    const SpanData& span) const {
+  const std::vector<std::uint32_t>* same_service = nullptr;
+  if (!by_service_.empty()) {
+    const auto found = by_service_.find(span.service);
+    if (found != by_service_.end()) {
+      same_service = &found->second;
+    }
+  }
+
+  // Merge the matchers for `span.service` with those for any service, in
+  // order.
+  std::vector<std::uint32_t> merged;
+  if (same_service) {
+    merged.reserve(same_service->size() + any_service_.size());
+    std::merge(same_service->begin(), same_service->end(),
+               any_service_.begin(), any_service_.end(),
+               std::back_inserter(merged));
+  } else {
+    merged = any_service_;
+  }
+
+  std::vector<std::uint32_t> result;
+  for (const std::uint32_t index : merged) {
+    const Matcher& matcher = matchers_[index];
+    // Literal service patterns already matched, via `by_service_`.
+    if ((matcher.service.is_literal() ||
+         matcher.service.match(span.service)) &&
+        matcher.name.match(span.name) &&
+        matcher.resource.match(span.resource)) {
+      result.push_back(index);
+    }
+  }
+  return result;
+}
+
+std::size_t CompiledSpanMatchers::CaseInsensitiveHash::operator()(
+    StringView text) const {
+  // The FNV-1a hash of the lowercased `text`.
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (const char c : text) {
+    hash ^= static_cast<unsigned char>(ascii_to_lower(c));
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+bool CompiledSpanMatchers::CaseInsensitiveEqual::operator()(
+    StringView left, StringView right) const {
+  return left.size() == right.size() &&
+         std::equal(left.begin(), left.end(), right.begin(),
+                    [](char l, char r) {
+                      return ascii_to_lower(l) == ascii_to_lower(r);
+                    });
+}
+
+bool CompiledSpanMatchers::match_tags(const Matcher& matcher,
+                                      const SpanData& span) {
+  return std::all_of(
+      matcher.tags.begin(), matcher.tags.end(), [&](const auto& entry) {
+        const auto& [key, pattern] = entry;
+        const auto found = span.tags.find(key);
+        return found != span.tags.end() && pattern.match(found->second);
+      });
+}
+
+}  // namespace tracing
+}  // namespace datadog
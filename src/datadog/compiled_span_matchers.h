@@ -0,0 +1,129 @@
+#pragma once
+
+// This component provides a `class`, `CompiledSpanMatchers`, that finds the
+// first of a sequence of `SpanMatcher`s that a span matches.  It is used by
+// `TraceSampler` and `SpanSampler` to find the sampling rule that applies to a
+// span.
+//
+// The matchers are compiled once, when the rules are configured, rather than
+// interpreted for each span:
+//
+// - Each glob pattern is a `GlobPattern`, lowercased in advance, and matched
+//   without backtracking when it is a literal, a prefix, or a suffix.
+// - Matchers whose service pattern is a literal are indexed by that service,
+//   so that a span is compared only against those for its service, and those
+//   whose service pattern is not a literal.
+// - If every service pattern, or every operation name pattern, is a literal,
+//   then a span whose service, or name, is not among those literals is
+//   rejected at once, without consulting or filling the cache below.  Most
+//   span sampling rules name a service and an operation, and most spans of a
+//   dropped trace match none of them.
+// - The matchers whose service, operation name, and resource name patterns
+//   match a span are cached for the span's (service, name, resource), so that
+//   subsequent spans having the same names need compare only tag patterns.
+//   The cache is bounded; once full, uncached names are matched without
+//   being cached.
+//
+// `CompiledSpanMatchers` is safe to use from multiple threads.
+
+#include <datadog/span_matcher.h>
+#include <datadog/string_view.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "glob.h"
+
+namespace datadog {
+namespace tracing {
+
+struct SpanData;
+
+class CompiledSpanMatchers {
+ public:
+  // The result of `find` when no matcher matches.
+  static constexpr std::size_t npos = std::size_t(-1);
+
+  // Compile the specified `matchers`.
+  explicit CompiledSpanMatchers(
+      const std::vector<const SpanMatcher*>& matchers);
+
+  // Return the index of the first of the matchers that the specified `span`
+  // matches, or return `npos` if there is none.  The result is the same as
+  // that of `SpanMatcher::match` applied to each of the matchers in order.
+  std::size_t find(const SpanData& span) const;
+
+ private:
+  struct Matcher {
+    GlobPattern service;
+    GlobPattern name;
+    GlobPattern resource;
+    std::vector<std::pair<std::string, GlobPattern>> tags;
+  };
+
+  // The matchers whose service, name, and resource patterns match the
+  // service, name, and resource of a span.
+  struct CacheEntry {
+    std::string service;
+    std::string name;
+    std::string resource;
+    std::vector<std::uint32_t> candidates;
+  };
+
+  // Hash and compare text ignoring the case of ASCII letters, so that a
+  // span's service or name is looked up among the lowercased literal patterns
+  // without first being lowercased.
+  struct CaseInsensitiveHash {
+    std::size_t operator()(StringView text) const;
+  };
+  struct CaseInsensitiveEqual {
+    bool operator()(StringView left, StringView right) const;
+  };
+
+  static constexpr std::size_t max_cache_entries = 1024;
+
+  std::vector<Matcher> matchers_;
+  // The indices of the matchers whose service pattern is a literal, by that
+  // literal.  The keys refer to the patterns in `matchers_`.
+  std::unordered_map<StringView, std::vector<std::uint32_t>,
+                     CaseInsensitiveHash, CaseInsensitiveEqual>
+      by_service_;
+  // The indices of the matchers whose service pattern is not a literal.
+  std::vector<std::uint32_t> any_service_;
+  // The name patterns of the matchers, if every one is a literal.  They refer
+  // to the patterns in `matchers_`.
+  std::unordered_set<StringView, CaseInsensitiveHash, CaseInsensitiveEqual>
+      literal_names_;
+  bool names_are_literal_;
+  // Whether any matcher has tag patterns.  If none does, then the first
+  // candidate is the result.
+  bool has_tag_patterns_;
+
+  mutable std::shared_mutex cache_mutex_;
+  // Keyed by the hash of the (service, name, resource) of `CacheEntry`.
+  mutable std::unordered_multimap<std::size_t, CacheEntry> cache_;
+  // Whether `cache_` has `max_cache_entries` entries, after which a span whose
+  // names are not cached is matched without locking `cache_mutex_`
+  // exclusively.
+  mutable std::atomic<bool> cache_full_;
+
+  // Return whether the specified `span` matches none of the matchers because
+  // its service or name is not among their literal patterns.
+  bool rejects(const SpanData& span) const;
+  // Return the indices, in order, of the matchers whose service, name, and
+  // resource patterns the specified `span` matches.
+  std::vector<std::uint32_t> candidates(const SpanData& span) const;
+  // Return whether the specified `span` has tags matching the tag patterns of
+  // the specified `matcher`.
+  static bool match_tags(const Matcher& matcher, const SpanData& span);
+};
+
+}  // namespace tracing
+}  // namespace datadog
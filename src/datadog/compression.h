@@ -0,0 +1,36 @@
+#pragma once
+
+// This component defines functions, `gzip_available`, `gzip_compress`, and
+// `gzip_decompress`, that `DatadogAgent` uses to compress the trace payloads
+// that it sends, and to restore a payload that the Datadog Agent would not
+// accept compressed.
+//
+// Compression requires zlib, which is included in the build only if the
+// `DD_TRACE_COMPRESSION` build option is "zlib".  The functions are implemented
+// in either `compression_zlib.cpp` or `compression_null.cpp`.
+
+#include <datadog/expected.h>
+#include <datadog/string_view.h>
+
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+// Return whether this library was built with support for gzip compression.
+bool gzip_available();
+
+// Append to the specified `destination` the gzip compressed form of the
+// specified `input`, using the specified compression `level`, which is between
+// 1 (fastest) and 9 (smallest).  Return an error if compression is not
+// available or if it fails.
+Expected<void> gzip_compress(std::string& destination, StringView input,
+                             int level);
+
+// Append to the specified `destination` the decompressed form of the
+// specified gzip compressed `input`.  Return an error if compression is not
+// available, or if `input` is not gzip compressed data.
+Expected<void> gzip_decompress(std::string& destination, StringView input);
+
+}  // namespace tracing
+}  // namespace datadog
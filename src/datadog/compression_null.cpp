@@ -0,0 +1,25 @@
+#include <datadog/error.h>
+
+#include "compression.h"
+
+// This file is included in the build when zlib is not included in the build.
+// It provides implementations of `gzip_available`, `gzip_compress`, and
+// `gzip_decompress` that indicate that compression is not supported.
+
+namespace datadog {
+namespace tracing {
+
+bool gzip_available() { return false; }
+
+Expected<void> gzip_compress(std::string&, StringView, int) {
+  return Error{Error::DATADOG_AGENT_COMPRESSION_UNAVAILABLE,
+               "This library was built without support for compression."};
+}
+
+Expected<void> gzip_decompress(std::string&, StringView) {
+  return Error{Error::DATADOG_AGENT_COMPRESSION_UNAVAILABLE,
+               "This library was built without support for compression."};
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,125 @@
+#include <datadog/error.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "compression.h"
+
+// This file is included in the build when zlib is included in the build.  It
+// provides implementations of `gzip_available`, `gzip_compress`, and
+// `gzip_decompress` in terms of zlib.
+//
+// If zlib is not included in the build, then `compression_null.cpp` will be
+// built instead.
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Passed to `deflateInit2` to select the gzip format, rather than the zlib
+// format, with the largest window.
+constexpr int gzip_window_bits = 15 + 16;
+constexpr int default_memory_level = 8;
+
+// Output is inflated into `destination` this many bytes at a time, beyond a
+// first guess of a few times the size of the input.
+constexpr std::size_t inflate_step = 64 * 1024;
+
+Error make_error(StringView what, int code) {
+  std::string message;
+  message += "gzip compression failed in ";
+  append(message, what);
+  message += " with code ";
+  message += std::to_string(code);
+  message += '.';
+  return Error{Error::DATADOG_AGENT_COMPRESSION_FAILURE, std::move(message)};
+}
+
+}  // namespace
+
+bool gzip_available() { return true; }
+
+Expected<void> gzip_compress(std::string& destination, StringView input,
+                             int level) {
+  if (input.size() > std::numeric_limits<uInt>::max()) {
+    return Error{Error::DATADOG_AGENT_COMPRESSION_FAILURE,
+                 "Input is too large to compress in one pass."};
+  }
+
+  z_stream stream{};
+  int rc = deflateInit2(&stream, level, Z_DEFLATED, gzip_window_bits,
+                        default_memory_level, Z_DEFAULT_STRATEGY);
+  if (rc != Z_OK) {
+    return make_error("deflateInit2", rc);
+  }
+
+  // `deflateBound` is large enough for the whole output, so that one call to
+  // `deflate` compresses all of `input` directly into `destination`.
+  const std::size_t offset = destination.size();
+  const uLong bound = deflateBound(&stream, static_cast<uLong>(input.size()));
+  if (bound > std::numeric_limits<uInt>::max()) {
+    deflateEnd(&stream);
+    return Error{Error::DATADOG_AGENT_COMPRESSION_FAILURE,
+                 "Input is too large to compress in one pass."};
+  }
+  destination.resize(offset + bound);
+
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&destination[offset]);
+  stream.avail_out = static_cast<uInt>(bound);
+
+  rc = deflate(&stream, Z_FINISH);
+  const std::size_t written = stream.total_out;
+  deflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    destination.resize(offset);
+    return make_error("deflate", rc);
+  }
+
+  destination.resize(offset + written);
+  return nullopt;
+}
+
+Expected<void> gzip_decompress(std::string& destination, StringView input) {
+  if (input.size() > std::numeric_limits<uInt>::max()) {
+    return Error{Error::DATADOG_AGENT_COMPRESSION_FAILURE,
+                 "Input is too large to decompress in one pass."};
+  }
+
+  z_stream stream{};
+  int rc = inflateInit2(&stream, gzip_window_bits);
+  if (rc != Z_OK) {
+    return make_error("inflateInit2", rc);
+  }
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+
+  const std::size_t offset = destination.size();
+  std::size_t written = 0;
+  destination.resize(offset + 4 * input.size() + inflate_step);
+  do {
+    if (destination.size() == offset + written) {
+      destination.resize(destination.size() + inflate_step);
+    }
+    const std::size_t room = destination.size() - (offset + written);
+    stream.next_out = reinterpret_cast<Bytef*>(&destination[offset + written]);
+    stream.avail_out = static_cast<uInt>(
+        std::min<std::size_t>(room, std::numeric_limits<uInt>::max()));
+    const uInt before = stream.avail_out;
+    rc = inflate(&stream, Z_NO_FLUSH);
+    written += before - stream.avail_out;
+  } while (rc == Z_OK);
+  inflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    destination.resize(offset);
+    return make_error("inflate", rc);
+  }
+
+  destination.resize(offset + written);
+  return nullopt;
+}
+
+}  // namespace tracing
+}  // namespace datadog
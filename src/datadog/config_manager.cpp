@@ -2,6 +2,7 @@
 
 #include <datadog/telemetry/telemetry.h>
 
+#include "json_serializer.h"
 #include "parse_util.h"
 #include "string_util.h"
 #include "trace_sampler.h"
@@ -281,6 +282,68 @@ Expected<ConfigManager::Update> parse_dynamic_config(const nlohmann::json& j) {
   return config_update;
 }
 
+// `DecodedUpdates` holds the remote updates of the tracers in this process, by
+// the content that they were decoded from.  An entry is removed once no tracer
+// has its update.
+struct DecodedUpdates {
+  std::mutex mutex;
+  std::unordered_map<std::string, std::weak_ptr<const ConfigManager::Update>>
+      by_content;
+};
+
+DecodedUpdates& decoded_updates() {
+  // Never destroyed, since updates can outlive static objects.
+  static auto* const instance = new DecodedUpdates;
+  return *instance;
+}
+
+// Return the update decoded from the specified APM remote configuration
+// `content`, or an error message.  The tracers in a process usually receive
+// the same configurations, so an update is decoded by the first tracer that
+// applies its content, and is shared with the others until none of them has
+// it.
+Expected<std::shared_ptr<const ConfigManager::Update>, std::string>
+decode_update(const std::string& content) {
+  auto& updates = decoded_updates();
+  {
+    std::lock_guard<std::mutex> lock(updates.mutex);
+    const auto found = updates.by_content.find(content);
+    if (found != updates.by_content.end()) {
+      if (auto update = found->second.lock()) {
+        return update;
+      }
+    }
+  }
+
+  const auto config_json = nlohmann::json::parse(content);
+  auto maybe_config_update = parse_dynamic_config(config_json.at("lib_config"));
+  if (auto err = maybe_config_update.if_error()) {
+    return err
+        ->with_prefix("Failed to parse APM remote configuration payload: ")
+        .message;
+  }
+
+  std::shared_ptr<const ConfigManager::Update> update(
+      new ConfigManager::Update(std::move(*maybe_config_update)),
+      [content](const ConfigManager::Update* expired) {
+        delete expired;
+        auto& updates = decoded_updates();
+        std::lock_guard<std::mutex> lock(updates.mutex);
+        const auto found = updates.by_content.find(content);
+        if (found != updates.by_content.end() && found->second.expired()) {
+          updates.by_content.erase(found);
+        }
+      });
+  std::lock_guard<std::mutex> lock(updates.mutex);
+  auto& entry = updates.by_content[content];
+  if (auto existing = entry.lock()) {
+    // Another tracer decoded the same content meanwhile.
+    return existing;
+  }
+  entry = update;
+  return update;
+}
+
 }  // namespace
 
 namespace rc = datadog::remote_config;
@@ -291,8 +354,12 @@ ConfigManager::ConfigManager(const FinalizedTracerConfig& config)
       trace_sampler_(
           std::make_shared<TraceSampler>(config.trace_sampler, clock_)),
       rules_(config.trace_sampler.rules),
+      remote_update_(std::make_shared<const Update>()),
       span_defaults_(std::make_shared<SpanDefaults>(config.defaults)),
-      report_traces_(config.report_traces) {}
+      report_traces_(config.report_traces),
+      current_span_defaults_(span_defaults_.value()),
+      current_report_traces_(report_traces_.value()),
+      span_defaults_version_(0) {}
 
 rc::Products ConfigManager::get_products() { return rc::product::APM_TRACING; }
 
@@ -307,137 +374,288 @@ Optional<std::string> ConfigManager::on_update(const Configuration& config) {
     return nullopt;
   }
 
-  const auto config_json = nlohmann::json::parse(config.content);
-
-  auto maybe_config_update = parse_dynamic_config(config_json.at("lib_config"));
-  if (auto err = maybe_config_update.if_error()) {
-    return err
-        ->with_prefix("Failed to parse APM remote configuration payload: ")
-        .message;
+  auto maybe_update = decode_update(config.content);
+  if (auto* error_message = maybe_update.if_error()) {
+    return std::move(*error_message);
   }
 
-  apply_update(*maybe_config_update);
+  apply_update(std::move(*maybe_update));
   return nullopt;
 }
 
-void ConfigManager::on_revert(const Configuration&) { apply_update({}); }
+void ConfigManager::on_revert(const Configuration&) {
+  apply_update(std::make_shared<const Update>());
+}
 
 std::shared_ptr<TraceSampler> ConfigManager::trace_sampler() {
-  std::lock_guard<std::mutex> lock(mutex_);
   return trace_sampler_;
 }
 
 std::shared_ptr<const SpanDefaults> ConfigManager::span_defaults() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return span_defaults_.value();
+  return current_span_defaults_.load();
+}
+
+std::uint64_t ConfigManager::span_defaults_version() const {
+  return span_defaults_version_.load(std::memory_order_acquire);
 }
 
 bool ConfigManager::report_traces() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return report_traces_.value();
+  return current_report_traces_.load(std::memory_order_acquire);
 }
 
-void ConfigManager::apply_update(const ConfigManager::Update& conf) {
+void ConfigManager::apply_update(std::shared_ptr<const Update> conf) {
   std::vector<ConfigMetadata> metadata;
 
-  // TODO: We're doing too much while holding the lock. Refactor to reduce lock
-  // contention.
+  // Readers do not take the lock, so holding it while the update is built
+  // only serializes updates.
   {
     std::lock_guard<std::mutex> lock(mutex_);
+    remote_update_ = std::move(conf);
+    apply_update_locked(*remote_update_, metadata);
+  }
 
-    // NOTE(@dmehala): Sampling rules are generally not well specified.
-    //
-    // Rules are evaluated in the order they are inserted, which means the most
-    // specific matching rule might not be evaluated, even though it should be.
-    // For now, we must follow this legacy behavior.
-    //
-    // Additionally, I exploit this behavior to avoid a merge operation.
-    // The resulting array can contain duplicate `SpanMatcher`, but only the
-    // first encountered one will be evaluated, acting as an override.
-    //
-    // Remote Configuration rules will/should always be placed at the begining
-    // of the array, ensuring they are evaluated first.
-    auto rules = rules_;
-
-    if (!conf.trace_sampling_rate) {
-      auto found = default_metadata_.find(ConfigName::TRACE_SAMPLING_RATE);
-      if (found != default_metadata_.cend()) {
-        metadata.push_back(found->second);
-      }
-    } else {
-      ConfigMetadata trace_sampling_metadata(
-          ConfigName::TRACE_SAMPLING_RATE,
-          to_string(*conf.trace_sampling_rate, 1),
-          ConfigMetadata::Origin::REMOTE_CONFIG);
-
-      TraceSamplerRule rule;
-      rule.rate = *conf.trace_sampling_rate;
-      rule.matcher = catch_all;
-      rule.mechanism = SamplingMechanism::RULE;
-
-      // Convention: Catch-all rules should ALWAYS be the last in the list.
-      // If a catch-all rule already exists, replace it.
-      // If NOT, add the new one at the end of the rules list.
-      if (rules.empty()) {
-        rules.emplace_back(std::move(rule));
-      } else {
-        if (auto& last_rule = rules.back(); last_rule.matcher == catch_all) {
-          last_rule = rule;
-        } else {
-          rules.emplace_back(std::move(rule));
-        }
-      }
+  telemetry::capture_configuration_change(metadata);
+}
 
-      metadata.emplace_back(std::move(trace_sampling_metadata));
-    }
+Expected<void> ConfigManager::apply_local_update(const TracerUpdate& update) {
+  if (update.service && update.service->empty()) {
+    return Error{Error::TRACER_UPDATE_EMPTY_SERVICE,
+                 "The service name of a tracer cannot be empty."};
+  }
 
-    if (!conf.trace_sampling_rules) {
-      auto found = default_metadata_.find(ConfigName::TRACE_SAMPLING_RULES);
-      if (found != default_metadata_.cend()) {
-        metadata.emplace_back(found->second);
+  // Validate the sampling configuration before anything is changed.
+  Optional<Rules> rules;
+  if (update.trace_sampling_rules) {
+    rules.emplace();
+    for (const auto& rule : *update.trace_sampling_rules) {
+      auto maybe_rate = Rate::from(rule.sample_rate);
+      if (auto* error = maybe_rate.if_error()) {
+        std::string prefix;
+        prefix +=
+            "Unable to parse sample_rate in trace sampling rule with root "
+            "span pattern ";
+        prefix += nlohmann::json(static_cast<SpanMatcher>(rule)).dump();
+        prefix += ": ";
+        return error->with_prefix(prefix);
       }
-    } else {
-      rules.insert(rules.cbegin(), conf.trace_sampling_rules->begin(),
-                   conf.trace_sampling_rules->end());
-
-      ConfigMetadata trace_sampling_rules_metadata(
-          ConfigName::TRACE_SAMPLING_RULES,
-          to_json(*conf.trace_sampling_rules).dump(),
-          ConfigMetadata::Origin::REMOTE_CONFIG);
-      metadata.emplace_back(std::move(trace_sampling_rules_metadata));
+      TraceSamplerRule finalized_rule;
+      finalized_rule.matcher = rule;
+      finalized_rule.rate = *maybe_rate;
+      finalized_rule.mechanism = SamplingMechanism::RULE;
+      rules->emplace_back(std::move(finalized_rule));
     }
+  }
 
-    trace_sampler_->set_rules(std::move(rules));
+  Optional<TraceSamplerRule> rate_rule;
+  if (update.trace_sample_rate) {
+    auto maybe_rate = Rate::from(*update.trace_sample_rate);
+    if (auto* error = maybe_rate.if_error()) {
+      return error->with_prefix(
+          "Unable to parse overall sample_rate for trace sampling: ");
+    }
+    rate_rule.emplace();
+    rate_rule->rate = *maybe_rate;
+    rate_rule->matcher = catch_all;
+    rate_rule->mechanism = SamplingMechanism::RULE;
+  }
 
-    if (!conf.tags) {
-      reset_config(ConfigName::TAGS, span_defaults_, metadata);
-    } else {
-      ConfigMetadata tags_metadata(ConfigName::TAGS, join_tags(*conf.tags),
-                                   ConfigMetadata::Origin::REMOTE_CONFIG);
+  std::vector<ConfigMetadata> metadata;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
 
-      if (*conf.tags != span_defaults_.value()->tags) {
-        auto new_span_defaults =
-            std::make_shared<SpanDefaults>(*span_defaults_.value());
-        new_span_defaults->tags = std::move(*conf.tags);
+    // Record the new value of the specified configuration `name`, and report
+    // it unless a remote value takes precedence over it.
+    const auto set_metadata = [&](ConfigName name, std::string value,
+                                  bool overridden) {
+      auto& entry = default_metadata_[name];
+      entry = ConfigMetadata(name, std::move(value),
+                             ConfigMetadata::Origin::CODE);
+      if (!overridden) {
+        metadata.push_back(entry);
+      }
+    };
+
+    if (update.service || update.service_type || update.environment ||
+        update.version || update.name || update.tags) {
+      auto defaults =
+          std::make_shared<SpanDefaults>(*span_defaults_.original_value());
+      if (update.service) {
+        defaults->service = *update.service;
+        set_metadata(ConfigName::SERVICE_NAME, defaults->service, false);
+      }
+      if (update.service_type) {
+        defaults->service_type = *update.service_type;
+      }
+      if (update.environment) {
+        defaults->environment = *update.environment;
+        set_metadata(ConfigName::SERVICE_ENV, defaults->environment, false);
+      }
+      if (update.version) {
+        defaults->version = *update.version;
+        set_metadata(ConfigName::SERVICE_VERSION, defaults->version, false);
+      }
+      if (update.name) {
+        defaults->name = *update.name;
+      }
+      if (update.tags) {
+        defaults->tags = *update.tags;
+        set_metadata(ConfigName::TAGS, join_tags(defaults->tags),
+                     !span_defaults_.is_original_value());
+      }
+      if (!span_defaults_.is_original_value()) {
+        // Remote tags are in effect.  Keep them, with the new defaults.
+        auto current = std::make_shared<SpanDefaults>(*defaults);
+        current->tags = span_defaults_.value()->tags;
+        span_defaults_ = current;
+      }
+      span_defaults_.set_original_value(std::move(defaults));
+    }
 
-        span_defaults_ = new_span_defaults;
-        metadata.emplace_back(std::move(tags_metadata));
+    if (rules || rate_rule) {
+      // By convention, a catch-all rule at the end of the rules is the
+      // overall sample rate.
+      auto rate_begin = rules_.end();
+      if (!rules_.empty() && rules_.back().matcher == catch_all) {
+        --rate_begin;
+      }
+      if (!rate_rule && rate_begin != rules_.end()) {
+        rate_rule = *rate_begin;
+      }
+      if (!rules) {
+        rules.emplace(rules_.begin(), rate_begin);
+      }
+      if (update.trace_sampling_rules) {
+        set_metadata(ConfigName::TRACE_SAMPLING_RULES,
+                     to_json(*rules).dump(),
+                     bool(remote_update_->trace_sampling_rules));
+      }
+      if (update.trace_sample_rate) {
+        set_metadata(ConfigName::TRACE_SAMPLING_RATE,
+                     to_string(*update.trace_sample_rate, 1),
+                     bool(remote_update_->trace_sampling_rate));
+      }
+      if (rate_rule) {
+        rules->push_back(std::move(*rate_rule));
       }
+      rules_ = std::move(*rules);
     }
 
-    if (!conf.report_traces) {
-      reset_config(ConfigName::REPORT_TRACES, report_traces_, metadata);
+    if (update.report_traces) {
+      report_traces_.set_original_value(*update.report_traces);
+      set_metadata(ConfigName::REPORT_TRACES, to_string(*update.report_traces),
+                   !report_traces_.is_original_value());
+    }
+
+    // Apply the remote configuration again, on top of the new local
+    // configuration, which publishes the result.  What it reports is
+    // unchanged.
+    std::vector<ConfigMetadata> unchanged;
+    apply_update_locked(*remote_update_, unchanged);
+  }
+
+  telemetry::capture_configuration_change(metadata);
+  return {};
+}
+
+void ConfigManager::apply_update_locked(const ConfigManager::Update& conf,
+                                        std::vector<ConfigMetadata>& metadata) {
+  // NOTE(@dmehala): Sampling rules are generally not well specified.
+  //
+  // Rules are evaluated in the order they are inserted, which means the most
+  // specific matching rule might not be evaluated, even though it should be.
+  // For now, we must follow this legacy behavior.
+  //
+  // Additionally, I exploit this behavior to avoid a merge operation.
+  // The resulting array can contain duplicate `SpanMatcher`, but only the
+  // first encountered one will be evaluated, acting as an override.
+  //
+  // Remote Configuration rules will/should always be placed at the begining
+  // of the array, ensuring they are evaluated first.
+  auto rules = rules_;
+
+  if (!conf.trace_sampling_rate) {
+    auto found = default_metadata_.find(ConfigName::TRACE_SAMPLING_RATE);
+    if (found != default_metadata_.cend()) {
+      metadata.push_back(found->second);
+    }
+  } else {
+    ConfigMetadata trace_sampling_metadata(
+        ConfigName::TRACE_SAMPLING_RATE,
+        to_string(*conf.trace_sampling_rate, 1),
+        ConfigMetadata::Origin::REMOTE_CONFIG);
+
+    TraceSamplerRule rule;
+    rule.rate = *conf.trace_sampling_rate;
+    rule.matcher = catch_all;
+    rule.mechanism = SamplingMechanism::RULE;
+
+    // Convention: Catch-all rules should ALWAYS be the last in the list.
+    // If a catch-all rule already exists, replace it.
+    // If NOT, add the new one at the end of the rules list.
+    if (rules.empty()) {
+      rules.emplace_back(std::move(rule));
     } else {
-      if (conf.report_traces != report_traces_.value()) {
-        report_traces_ = *conf.report_traces;
-        metadata.emplace_back(ConfigName::REPORT_TRACES,
-                              to_string(*conf.report_traces),
-                              ConfigMetadata::Origin::REMOTE_CONFIG);
+      if (auto& last_rule = rules.back(); last_rule.matcher == catch_all) {
+        last_rule = rule;
+      } else {
+        rules.emplace_back(std::move(rule));
       }
     }
+
+    metadata.emplace_back(std::move(trace_sampling_metadata));
+  }
+
+  if (!conf.trace_sampling_rules) {
+    auto found = default_metadata_.find(ConfigName::TRACE_SAMPLING_RULES);
+    if (found != default_metadata_.cend()) {
+      metadata.emplace_back(found->second);
+    }
+  } else {
+    rules.insert(rules.cbegin(), conf.trace_sampling_rules->begin(),
+                 conf.trace_sampling_rules->end());
+
+    ConfigMetadata trace_sampling_rules_metadata(
+        ConfigName::TRACE_SAMPLING_RULES,
+        to_json(*conf.trace_sampling_rules).dump(),
+        ConfigMetadata::Origin::REMOTE_CONFIG);
+    metadata.emplace_back(std::move(trace_sampling_rules_metadata));
   }
 
-  telemetry::capture_configuration_change(metadata);
+  trace_sampler_->set_rules(std::move(rules));
+
+  if (!conf.tags) {
+    reset_config(ConfigName::TAGS, span_defaults_, metadata);
+  } else {
+    ConfigMetadata tags_metadata(ConfigName::TAGS, join_tags(*conf.tags),
+                                 ConfigMetadata::Origin::REMOTE_CONFIG);
+
+    if (*conf.tags != span_defaults_.value()->tags) {
+      auto new_span_defaults =
+          std::make_shared<SpanDefaults>(*span_defaults_.value());
+      new_span_defaults->tags = std::move(*conf.tags);
+
+      span_defaults_ = new_span_defaults;
+      metadata.emplace_back(std::move(tags_metadata));
+    }
+  }
+
+  if (!conf.report_traces) {
+    reset_config(ConfigName::REPORT_TRACES, report_traces_, metadata);
+  } else {
+    if (conf.report_traces != report_traces_.value()) {
+      report_traces_ = *conf.report_traces;
+      metadata.emplace_back(ConfigName::REPORT_TRACES,
+                            to_string(*conf.report_traces),
+                            ConfigMetadata::Origin::REMOTE_CONFIG);
+    }
+  }
+
+  if (span_defaults_.value() != current_span_defaults_.load()) {
+    current_span_defaults_.store(span_defaults_.value());
+    span_defaults_version_.fetch_add(1, std::memory_order_release);
+  }
+  current_report_traces_.store(report_traces_.value(),
+                               std::memory_order_release);
 }
 
 template <typename T>
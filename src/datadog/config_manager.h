@@ -2,15 +2,20 @@
 
 // The `ConfigManager` class is designed to handle configuration update
 // and provide access to the current configuration.
-// It utilizes a mutex to ensure thread safety when updating or accessing
-// the configuration.
+// Updates are serialized by a mutex, and publish the resulting configuration
+// in a form that can be read without locking, since the configuration is read
+// for every trace but updated rarely.
 
+#include <datadog/atomic_snapshot.h>
 #include <datadog/clock.h>
 #include <datadog/optional.h>
 #include <datadog/remote_config/listener.h>
 #include <datadog/span_defaults.h>
 #include <datadog/tracer_config.h>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 
 #include "json.hpp"
@@ -61,6 +66,13 @@ class ConfigManager : public remote_config::Listener {
       return current_value_.has_value() ? *current_value_ : original_value_;
     }
 
+    const Value& original_value() const { return original_value_; }
+
+    // Replaces the original value, leaving any current value in effect
+    void set_original_value(Value value) {
+      original_value_ = std::move(value);
+    }
+
     // Updates the current value of the configuration
     void operator=(const Value& rhs) { current_value_ = rhs; }
   };
@@ -69,17 +81,35 @@ class ConfigManager : public remote_config::Listener {
   Clock clock_;
   std::unordered_map<ConfigName, ConfigMetadata> default_metadata_;
 
-  std::shared_ptr<TraceSampler> trace_sampler_;
+  const std::shared_ptr<TraceSampler> trace_sampler_;
+  // The trace sampling rules from the tracer's configuration or from the most
+  // recent `apply_local_update`, to which `remote_update_` is applied.
+  // `remote_update_` is shared by the tracers in this process that applied
+  // the same remote configuration.
   std::vector<TraceSamplerRule> rules_;
+  std::shared_ptr<const Update> remote_update_;
 
+  // `span_defaults_` and `report_traces_` are guarded by `mutex_`.  Their
+  // current values are published to readers, who do not lock, in
+  // `current_span_defaults_` and `current_report_traces_`.
+  // `span_defaults_version_` is incremented after each publication of
+  // `current_span_defaults_`.
   DynamicConfig<std::shared_ptr<const SpanDefaults>> span_defaults_;
   DynamicConfig<bool> report_traces_;
+  AtomicSnapshot<const SpanDefaults> current_span_defaults_;
+  std::atomic<bool> current_report_traces_;
+  std::atomic<std::uint64_t> span_defaults_version_;
 
  private:
   template <typename T>
   void reset_config(ConfigName name, T& conf,
                     std::vector<ConfigMetadata>& metadata);
 
+  // Apply the specified remote `conf` to the local configuration, appending
+  // the resulting changes to `metadata`.  The caller must hold `mutex_`.
+  void apply_update_locked(const Update& conf,
+                           std::vector<ConfigMetadata>& metadata);
+
  public:
   ConfigManager(const FinalizedTracerConfig& config);
   ~ConfigManager() override{};
@@ -98,6 +128,11 @@ class ConfigManager : public remote_config::Listener {
   // Return the `SpanDefaults` consistent with the most recent configuration.
   std::shared_ptr<const SpanDefaults> span_defaults();
 
+  // Return a number that changes whenever the value returned by
+  // `span_defaults` might have changed, so that callers can tell whether a
+  // copy of the `SpanDefaults` is out of date without loading them.
+  std::uint64_t span_defaults_version() const;
+
   // Return whether traces should be sent to the collector.
   bool report_traces();
 
@@ -105,7 +140,12 @@ class ConfigManager : public remote_config::Listener {
   // object.
   nlohmann::json config_json() const;
 
-  void apply_update(const ConfigManager::Update& conf);
+  void apply_update(std::shared_ptr<const Update> conf);
+
+  // Replace the configuration that remote updates are applied to with the
+  // specified local `update` (see `Tracer::reconfigure`).  Return an error,
+  // and change nothing, if `update` is invalid.
+  Expected<void> apply_local_update(const TracerUpdate& update);
 };
 
 }  // namespace tracing
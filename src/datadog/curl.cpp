@@ -7,19 +7,38 @@
 #include <datadog/string_view.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cctype>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <system_error>
 #include <unordered_map>
 #include <unordered_set>
-
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "header_block_reader.h"
 #include "json.hpp"
 #include "string_util.h"
+#include "timeline_events.h"
+#include "usdt.h"
 
 namespace datadog {
 namespace tracing {
@@ -29,12 +48,35 @@ namespace {
 // the hood.
 CurlLibrary libcurl;
 
+// The maximum number of idle easy handles kept for reuse per endpoint.
+constexpr std::size_t max_idle_handles_per_endpoint = 4;
+
+// The maximum number of URLs for which header lists are kept (see
+// `CurlImpl::shared_headers_`), and the maximum number of header lines in a
+// kept list.
+constexpr std::size_t max_shared_header_urls = 32;
+constexpr std::size_t max_shared_header_lines = 64;
+
+// The longest that the event loop waits for activity.  Posting a request,
+// draining, and shutting down all wake the loop, and libcurl shortens the wait
+// when one of its transfers has a timer due, so this bound seldom matters.
+constexpr std::chrono::milliseconds max_poll_wait = std::chrono::minutes(10);
+
+// The maximum number of host names whose addresses are kept (see
+// `CurlImpl::resolved_hosts_`).
+constexpr std::size_t max_resolved_hosts = 16;
+
+// How soon to try again to resolve a host name that could not be resolved.
+constexpr std::chrono::seconds resolve_retry_interval{5};
+
 }  // namespace
 
 CURL *CurlLibrary::easy_init() { return curl_easy_init(); }
 
 void CurlLibrary::easy_cleanup(CURL *handle) { curl_easy_cleanup(handle); }
 
+void CurlLibrary::easy_reset(CURL *handle) { curl_easy_reset(handle); }
+
 CURLcode CurlLibrary::easy_getinfo_private(CURL *curl, char **user_data) {
   return curl_easy_getinfo(curl, CURLINFO_PRIVATE, user_data);
 }
@@ -61,6 +103,14 @@ CURLcode CurlLibrary::easy_setopt_httpheader(CURL *handle,
   return curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
 }
 
+CURLcode CurlLibrary::easy_setopt_http_version(CURL *handle, long version) {
+  return curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, version);
+}
+
+CURLcode CurlLibrary::easy_setopt_pipewait(CURL *handle, long wait) {
+  return curl_easy_setopt(handle, CURLOPT_PIPEWAIT, wait);
+}
+
 CURLcode CurlLibrary::easy_setopt_post(CURL *handle, long post) {
   return curl_easy_setopt(handle, CURLOPT_POST, post);
 }
@@ -77,6 +127,23 @@ CURLcode CurlLibrary::easy_setopt_private(CURL *handle, void *pointer) {
   return curl_easy_setopt(handle, CURLOPT_PRIVATE, pointer);
 }
 
+CURLcode CurlLibrary::easy_setopt_readdata(CURL *handle, void *data) {
+  return curl_easy_setopt(handle, CURLOPT_READDATA, data);
+}
+
+CURLcode CurlLibrary::easy_setopt_readfunction(CURL *handle,
+                                               ReadCallback on_read) {
+  return curl_easy_setopt(handle, CURLOPT_READFUNCTION, on_read);
+}
+
+CURLcode CurlLibrary::easy_setopt_resolve(CURL *handle, curl_slist *hosts) {
+  return curl_easy_setopt(handle, CURLOPT_RESOLVE, hosts);
+}
+
+CURLcode CurlLibrary::easy_setopt_tcp_keepalive(CURL *handle, long enabled) {
+  return curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, enabled);
+}
+
 CURLcode CurlLibrary::easy_setopt_unix_socket_path(CURL *handle,
                                                    const char *path) {
   return curl_easy_setopt(handle, CURLOPT_UNIX_SOCKET_PATH, path);
@@ -141,6 +208,11 @@ CURLMcode CurlLibrary::multi_remove_handle(CURLM *multi_handle,
   return curl_multi_remove_handle(multi_handle, easy_handle);
 }
 
+CURLMcode CurlLibrary::multi_setopt_pipelining(CURLM *multi_handle,
+                                               long bitmask) {
+  return curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, bitmask);
+}
+
 const char *CurlLibrary::multi_strerror(CURLMcode error) {
   return curl_multi_strerror(error);
 }
@@ -157,6 +229,50 @@ void CurlLibrary::slist_free_all(curl_slist *list) {
   curl_slist_free_all(list);
 }
 
+curl_version_info_data *CurlLibrary::version_info(CURLversion version) {
+  return curl_version_info(version);
+}
+
+std::string CurlLibrary::resolve_host(const std::string &host,
+                                      const std::string &port) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *results = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+    return "";
+  }
+
+  std::string addresses;
+  for (const addrinfo *info = results; info; info = info->ai_next) {
+    char buffer[INET6_ADDRSTRLEN];
+    const char *address = nullptr;
+    if (info->ai_family == AF_INET) {
+      const auto *ip = reinterpret_cast<const sockaddr_in *>(info->ai_addr);
+      address = inet_ntop(AF_INET, &ip->sin_addr, buffer, sizeof buffer);
+    } else if (info->ai_family == AF_INET6) {
+      const auto *ip = reinterpret_cast<const sockaddr_in6 *>(info->ai_addr);
+      address = inet_ntop(AF_INET6, &ip->sin6_addr, buffer, sizeof buffer);
+    }
+    if (!address) {
+      continue;
+    }
+    if (!addresses.empty()) {
+      addresses += ',';
+    }
+    if (info->ai_family == AF_INET6) {
+      addresses += '[';
+      addresses += address;
+      addresses += ']';
+    } else {
+      addresses += address;
+    }
+  }
+  freeaddrinfo(results);
+  return addresses;
+}
+
+using BodySegments = HTTPClient::BodySegments;
 using ErrorHandler = HTTPClient::ErrorHandler;
 using HeadersSetter = HTTPClient::HeadersSetter;
 using ResponseHandler = HTTPClient::ResponseHandler;
@@ -170,51 +286,135 @@ class CurlImpl {
   CURLM *multi_handle_;
   std::unordered_set<CURL *> request_handles_;
   std::list<CURL *> new_handles_;
+  // Easy handles of completed requests, kept for reuse by later requests to
+  // the same endpoint.  The key is the endpoint's scheme and authority.
+  std::unordered_map<std::string, std::vector<CURL *>> idle_handles_;
+  std::atomic<std::uint64_t> handles_created_;
+  std::atomic<std::uint64_t> handles_reused_;
+
+  // `SharedHeaders` is the header lines that were the same in the recent
+  // requests to a URL, as a list that requests to the URL share.  Most
+  // headers, e.g. those identifying the tracer, are the same in every request
+  // to a URL, so a request allocates list nodes only for the few that differ,
+  // such as a count of traces.
+  struct SharedHeaders {
+    std::vector<std::string> lines;
+    std::shared_ptr<curl_slist> list;
+  };
+  // The key is the URL without its query.  Guarded by `mutex_`.
+  std::unordered_map<std::string, SharedHeaders> shared_headers_;
+  // Whether requests use HTTP/2 (see `CurlOptions::http2`).
+  bool http2_;
   bool shutting_down_;
   int num_active_handles_;
+  // Whether `multi_wakeup` was called since the event loop last took
+  // `new_handles_`.  Until the loop takes them, later requests need not wake
+  // it again.  Guarded by `mutex_`.
+  bool wakeup_pending_;
   std::condition_variable no_requests_;
   std::thread event_loop_;
 
+  // `ResolvedHost` is the addresses of a host name that requests were sent
+  // to, which `resolver_` resolves every `dns_cache_ttl_`.
+  struct ResolvedHost {
+    std::string host;
+    std::string port;
+    // Comma-separated, or empty if `host` has not been resolved yet.
+    std::string addresses;
+    std::chrono::steady_clock::time_point refresh_at;
+    // Whether a request was sent to `host` since it was last resolved.
+    bool used = true;
+  };
+  const std::chrono::steady_clock::duration dns_cache_ttl_;
+  // `resolver_mutex_` guards the members below it.
+  std::mutex resolver_mutex_;
+  std::condition_variable resolver_wakeup_;
+  // The key is "host:port".
+  std::unordered_map<std::string, ResolvedHost> resolved_hosts_;
+  bool resolver_stopping_;
+  std::thread resolver_;
+  // Whether `resolver_` is running.  Set before any request is sent.
+  bool resolving_;
+
   struct Request {
     CurlLibrary *curl = nullptr;
+    // The request's header lines that are not in `shared_headers`, the last
+    // of which links to `shared_headers`.  `request_headers` is null if all
+    // of the request's header lines are shared.
     curl_slist *request_headers = nullptr;
+    curl_slist *last_request_header = nullptr;
+    std::shared_ptr<curl_slist> shared_headers;
+    // The `CURLOPT_RESOLVE` entry for the request's host, if any.
+    curl_slist *resolve = nullptr;
     std::string request_body;
+    // If not empty, the request body is these segments instead of
+    // `request_body`.  `segment` and `segment_offset` are the position of the
+    // next byte to send.
+    BodySegments request_segments;
+    std::size_t segment = 0;
+    std::size_t segment_offset = 0;
     ResponseHandler on_response;
     ErrorHandler on_error;
     char error_buffer[CURL_ERROR_SIZE] = "";
-    std::unordered_map<std::string, std::string> response_headers_lower;
+    // The response's header lines, which are parsed only if the response
+    // handler looks them up (see `HeaderBlockReader`).
+    std::string response_headers;
     std::string response_body;
     std::chrono::steady_clock::time_point deadline;
+    // The key of the request's handle in `idle_handles_`.
+    std::string endpoint;
+
+    // Return the list of all of the request's header lines.
+    curl_slist *headers() const;
 
     ~Request();
   };
 
+  // `HeaderWriter` formats each header as a null-terminated "key: value"
+  // line, all in one buffer.
   class HeaderWriter : public DictWriter {
-    curl_slist *list_ = nullptr;
     std::string buffer_;
-    CurlLibrary &curl_;
+    // The offset of each line in `buffer_`.
+    std::vector<std::size_t> offsets_;
 
    public:
-    explicit HeaderWriter(CurlLibrary &curl);
-    ~HeaderWriter();
-    curl_slist *release();
     void set(StringView key, StringView value) override;
-  };
-
-  class HeaderReader : public DictReader {
-    std::unordered_map<std::string, std::string> *response_headers_lower_;
-    mutable std::string buffer_;
 
-   public:
-    explicit HeaderReader(
-        std::unordered_map<std::string, std::string> *response_headers_lower);
-    Optional<StringView> lookup(StringView key) const override;
-    void visit(const std::function<void(StringView key, StringView value)>
-                   &visitor) const override;
+    std::size_t size() const { return offsets_.size(); }
+    const char *line(std::size_t index) const {
+      return buffer_.c_str() + offsets_[index];
+    }
   };
 
   void run();
   void handle_message(const CURLMsg &);
+  // Return the earliest deadline after the specified `after` of the requests
+  // in libcurl, or `time_point::max()` if there is none.
+  std::chrono::steady_clock::time_point next_deadline(
+      std::chrono::steady_clock::time_point after);
+  // Resolve host names until `resolver_stopping_`.  This is the body of
+  // `resolver_`.
+  void resolve_hosts();
+  // Return the `CURLOPT_RESOLVE` entry for the host of the specified `url`,
+  // or return an empty string if its host has not been resolved yet.  Start
+  // resolving the host in the background if it is not already.
+  std::string resolved_host(const URL &url);
+  // Set the headers of the specified `request` to the specified `url` to the
+  // lines of the specified `writer`, sharing those that the previous request
+  // to `url` had as well.
+  void set_request_headers(Request &request, const URL &url,
+                           const HeaderWriter &writer);
+  // Prepare a handle for the specified `request` to the specified `url` and
+  // add it to the requests that the event loop will send.
+  Expected<void> post(const URL &url, HeadersSetter set_headers,
+                      std::unique_ptr<Request> request);
+  // Return an idle handle for the specified `endpoint`, reset to its default
+  // options, or a new handle if there is none.  Return null if a new handle
+  // cannot be allocated.
+  CURL *acquire_handle(const std::string &endpoint);
+  // Keep the specified `handle` for reuse by requests to the specified
+  // `endpoint`, or clean it up if enough handles are already kept.
+  void release_handle(CURL *handle, const std::string &endpoint);
   CURLcode log_on_error(CURLcode result);
   CURLMcode log_on_error(CURLMcode result);
 
@@ -222,20 +422,29 @@ class CurlImpl {
                                     void *user_data);
   static std::size_t on_read_body(char *data, std::size_t, std::size_t length,
                                   void *user_data);
+  static std::size_t on_send_body(char *buffer, std::size_t size,
+                                  std::size_t count, void *user_data);
 
  public:
   explicit CurlImpl(const std::shared_ptr<Logger> &, const Clock &,
-                    CurlLibrary &, const Curl::ThreadGenerator &);
+                    CurlLibrary &, const Curl::ThreadGenerator &,
+                    const CurlOptions &);
   ~CurlImpl();
 
   Expected<void> post(const URL &url, HeadersSetter set_headers,
                       std::string body, ResponseHandler on_response,
                       ErrorHandler on_error,
                       std::chrono::steady_clock::time_point deadline);
+  Expected<void> post(const URL &url, HeadersSetter set_headers,
+                      BodySegments body, ResponseHandler on_response,
+                      ErrorHandler on_error,
+                      std::chrono::steady_clock::time_point deadline);
 
   void drain(std::chrono::steady_clock::time_point deadline);
 
   void clear_requests();
+
+  nlohmann::json config() const;
 };
 
 namespace {
@@ -251,6 +460,16 @@ void throw_on_error(CURLcode result) {
 Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock)
     : Curl(logger, clock, libcurl) {}
 
+Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
+           const CurlOptions &options)
+    : Curl(logger, clock, libcurl,
+           [](auto &&func) { return std::thread(std::move(func)); }, options) {}
+
+Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
+           const Curl::ThreadGenerator &make_thread,
+           const CurlOptions &options)
+    : Curl(logger, clock, libcurl, make_thread, options) {}
+
 Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
            CurlLibrary &curl)
     : Curl(logger, clock, curl,
@@ -258,7 +477,12 @@ Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
 
 Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
            CurlLibrary &curl, const Curl::ThreadGenerator &make_thread)
-    : impl_(new CurlImpl{logger, clock, curl, make_thread}) {}
+    : Curl(logger, clock, curl, make_thread, CurlOptions{}) {}
+
+Curl::Curl(const std::shared_ptr<Logger> &logger, const Clock &clock,
+           CurlLibrary &curl, const Curl::ThreadGenerator &make_thread,
+           const CurlOptions &options)
+    : impl_(new CurlImpl{logger, clock, curl, make_thread, options}) {}
 
 Curl::~Curl() { delete impl_; }
 
@@ -266,7 +490,16 @@ Expected<void> Curl::post(const URL &url, HeadersSetter set_headers,
                           std::string body, ResponseHandler on_response,
                           ErrorHandler on_error,
                           std::chrono::steady_clock::time_point deadline) {
-  return impl_->post(url, set_headers, body, on_response, on_error, deadline);
+  return impl_->post(url, std::move(set_headers), std::move(body),
+                     std::move(on_response), std::move(on_error), deadline);
+}
+
+Expected<void> Curl::post_segments(
+    const URL &url, HeadersSetter set_headers, BodySegments body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  return impl_->post(url, std::move(set_headers), std::move(body),
+                     std::move(on_response), std::move(on_error), deadline);
 }
 
 void Curl::drain(std::chrono::steady_clock::time_point deadline) {
@@ -274,16 +507,26 @@ void Curl::drain(std::chrono::steady_clock::time_point deadline) {
 }
 
 std::string Curl::config() const {
-  return nlohmann::json::object({{"type", "datadog::tracing::Curl"}}).dump();
+  return nlohmann::json::object(
+             {{"type", "datadog::tracing::Curl"}, {"config", impl_->config()}})
+      .dump();
 }
 
 CurlImpl::CurlImpl(const std::shared_ptr<Logger> &logger, const Clock &clock,
-                   CurlLibrary &curl, const Curl::ThreadGenerator &make_thread)
+                   CurlLibrary &curl, const Curl::ThreadGenerator &make_thread,
+                   const CurlOptions &options)
     : curl_(curl),
       logger_(logger),
       clock_(clock),
+      handles_created_(0),
+      handles_reused_(0),
+      http2_(options.http2),
       shutting_down_(false),
-      num_active_handles_(0) {
+      num_active_handles_(0),
+      wakeup_pending_(false),
+      dns_cache_ttl_(options.dns_cache_ttl),
+      resolver_stopping_(false),
+      resolving_(false) {
   curl_.global_init(CURL_GLOBAL_ALL);
   multi_handle_ = curl_.multi_init();
   if (multi_handle_ == nullptr) {
@@ -293,6 +536,21 @@ CurlImpl::CurlImpl(const std::shared_ptr<Logger> &logger, const Clock &clock,
     return;
   }
 
+  if (http2_) {
+    const curl_version_info_data *info = curl_.version_info(CURLVERSION_NOW);
+    if (!info || !(info->features & CURL_VERSION_HTTP2)) {
+      logger_->log_error(
+          Error{Error::CURL_HTTP2_UNAVAILABLE,
+                "HTTP/2 is enabled, but libcurl was built without support for "
+                "it.  Using HTTP/1.1 instead."});
+      http2_ = false;
+    } else {
+      // Concurrent requests to the same endpoint share one connection.
+      log_on_error(
+          curl_.multi_setopt_pipelining(multi_handle_, CURLPIPE_MULTIPLEX));
+    }
+  }
+
   try {
     event_loop_ = make_thread([this]() { run(); });
   } catch (const std::system_error &error) {
@@ -306,6 +564,18 @@ CurlImpl::CurlImpl(const std::shared_ptr<Logger> &logger, const Clock &clock,
 
     // Mark this object as not working.
     multi_handle_ = nullptr;
+    return;
+  }
+
+  if (dns_cache_ttl_ > std::chrono::steady_clock::duration::zero()) {
+    try {
+      resolver_ = make_thread([this]() { resolve_hosts(); });
+      resolving_ = true;
+    } catch (const std::system_error &error) {
+      // libcurl resolves host names when it connects instead.
+      logger_->log_error(
+          Error{Error::CURL_HTTP_CLIENT_SETUP_FAILED, error.what()});
+    }
   }
 }
 
@@ -322,6 +592,15 @@ CurlImpl::~CurlImpl() {
   log_on_error(curl_.multi_wakeup(multi_handle_));
   event_loop_.join();
 
+  if (resolving_) {
+    {
+      std::lock_guard<std::mutex> lock(resolver_mutex_);
+      resolver_stopping_ = true;
+    }
+    resolver_wakeup_.notify_one();
+    resolver_.join();
+  }
+
   log_on_error(curl_.multi_cleanup(multi_handle_));
   curl_.global_cleanup();
 }
@@ -329,47 +608,83 @@ CurlImpl::~CurlImpl() {
 Expected<void> CurlImpl::post(
     const HTTPClient::URL &url, HeadersSetter set_headers, std::string body,
     ResponseHandler on_response, ErrorHandler on_error,
-    std::chrono::steady_clock::time_point deadline) try {
+    std::chrono::steady_clock::time_point deadline) {
+  auto request = std::make_unique<Request>();
+  request->curl = &curl_;
+  request->request_body = std::move(body);
+  request->on_response = std::move(on_response);
+  request->on_error = std::move(on_error);
+  request->deadline = std::move(deadline);
+  return post(url, std::move(set_headers), std::move(request));
+}
+
+Expected<void> CurlImpl::post(
+    const HTTPClient::URL &url, HeadersSetter set_headers, BodySegments body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  auto request = std::make_unique<Request>();
+  request->curl = &curl_;
+  request->request_segments = std::move(body);
+  request->on_response = std::move(on_response);
+  request->on_error = std::move(on_error);
+  request->deadline = std::move(deadline);
+  return post(url, std::move(set_headers), std::move(request));
+}
+
+Expected<void> CurlImpl::post(const HTTPClient::URL &url,
+                              HeadersSetter set_headers,
+                              std::unique_ptr<Request> request) try {
   if (multi_handle_ == nullptr) {
     return Error{Error::CURL_HTTP_CLIENT_NOT_RUNNING,
                  "Unable to send request via libcurl because the HTTP client "
                  "failed to start."};
   }
 
-  HeaderWriter writer{curl_};
+  const bool segmented = !request->request_segments.empty();
+
+  HeaderWriter writer;
   set_headers(writer);
-  auto cleanup_list = [&](auto list) { curl_.slist_free_all(list); };
-  std::unique_ptr<curl_slist, decltype(cleanup_list)> headers{
-      writer.release(), std::move(cleanup_list)};
+  if (segmented) {
+    // libcurl would otherwise ask for "100 Continue" before sending a large
+    // body that it reads via callback, costing a round trip.
+    writer.set("Expect", "");
+  }
+  set_request_headers(*request, url, writer);
 
-  auto request = std::make_unique<Request>();
-
-  request->curl = &curl_;
-  request->request_headers = headers.get();
-  request->request_body = std::move(body);
-  request->on_response = std::move(on_response);
-  request->on_error = std::move(on_error);
-  request->deadline = std::move(deadline);
+  request->endpoint = url.scheme;
+  request->endpoint += "://";
+  request->endpoint += url.authority;
 
   auto cleanup_handle = [&](auto handle) { curl_.easy_cleanup(handle); };
   std::unique_ptr<CURL, decltype(cleanup_handle)> handle{
-      curl_.easy_init(), std::move(cleanup_handle)};
+      acquire_handle(request->endpoint), std::move(cleanup_handle)};
 
   if (!handle) {
     return Error{Error::CURL_REQUEST_SETUP_FAILED,
                  "unable to initialize a curl handle for request sending"};
   }
 
-  throw_on_error(
-      curl_.easy_setopt_httpheader(handle.get(), request->request_headers));
+  throw_on_error(curl_.easy_setopt_httpheader(handle.get(), request->headers()));
   throw_on_error(curl_.easy_setopt_private(handle.get(), request.get()));
   throw_on_error(
       curl_.easy_setopt_errorbuffer(handle.get(), request->error_buffer));
   throw_on_error(curl_.easy_setopt_post(handle.get(), 1));
-  throw_on_error(curl_.easy_setopt_postfieldsize(
-      handle.get(), static_cast<long>(request->request_body.size())));
-  throw_on_error(
-      curl_.easy_setopt_postfields(handle.get(), request->request_body.data()));
+  if (segmented) {
+    std::size_t size = 0;
+    for (const auto &segment : request->request_segments) {
+      assert(segment);
+      size += segment->size();
+    }
+    throw_on_error(
+        curl_.easy_setopt_postfieldsize(handle.get(), static_cast<long>(size)));
+    throw_on_error(curl_.easy_setopt_readfunction(handle.get(), &on_send_body));
+    throw_on_error(curl_.easy_setopt_readdata(handle.get(), request.get()));
+  } else {
+    throw_on_error(curl_.easy_setopt_postfieldsize(
+        handle.get(), static_cast<long>(request->request_body.size())));
+    throw_on_error(curl_.easy_setopt_postfields(handle.get(),
+                                                request->request_body.data()));
+  }
   throw_on_error(
       curl_.easy_setopt_headerfunction(handle.get(), &on_read_header));
   throw_on_error(curl_.easy_setopt_headerdata(handle.get(), request.get()));
@@ -384,25 +699,141 @@ Expected<void> CurlImpl::post(
     throw_on_error(curl_.easy_setopt_url(
         handle.get(), ("http://localhost" + url.path).c_str()));
   } else {
+    // Keep idle connections to the endpoint alive between requests.
+    throw_on_error(curl_.easy_setopt_tcp_keepalive(handle.get(), 1));
+    if (resolving_) {
+      const std::string entry = resolved_host(url);
+      if (!entry.empty()) {
+        request->resolve = curl_.slist_append(nullptr, entry.c_str());
+        throw_on_error(
+            curl_.easy_setopt_resolve(handle.get(), request->resolve));
+      }
+    }
     throw_on_error(curl_.easy_setopt_url(
         handle.get(), (url.scheme + "://" + url.authority + url.path).c_str()));
   }
+  if (http2_) {
+    // Requests over a Unix domain socket are sent in plain text (see above),
+    // so only "https" negotiates HTTP/2.
+    throw_on_error(curl_.easy_setopt_http_version(
+        handle.get(), url.scheme == "https"
+                          ? CURL_HTTP_VERSION_2TLS
+                          : CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE));
+    // Wait for a connection that can be multiplexed, rather than open another
+    // one while the first is being established.
+    throw_on_error(curl_.easy_setopt_pipewait(handle.get(), 1));
+  }
 
+  bool wake;
   {
     std::lock_guard<std::mutex> lock(mutex_);
     new_handles_.emplace_back(handle.get());
+    wake = !wakeup_pending_;
+    wakeup_pending_ = true;
   }
-  std::ignore = headers.release();
   std::ignore = handle.release();
   std::ignore = request.release();
 
-  log_on_error(curl_.multi_wakeup(multi_handle_));
+  if (wake) {
+    log_on_error(curl_.multi_wakeup(multi_handle_));
+  }
 
   return nullopt;
 } catch (CURLcode error) {
   return Error{Error::CURL_REQUEST_SETUP_FAILED, curl_.easy_strerror(error)};
 }
 
+void CurlImpl::set_request_headers(Request &request,
+                                   const HTTPClient::URL &url,
+                                   const HeaderWriter &writer) {
+  // Bit `i` is set if line `i` of `writer` is in `request.shared_headers`.
+  std::uint64_t shared_lines = 0;
+  static_assert(max_shared_header_lines <= 64,
+                "shared_lines has a bit for each line");
+  {
+    std::string key = url.scheme;
+    key += "://";
+    key += url.authority;
+    key += url.path;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = shared_headers_.find(key);
+    if (found == shared_headers_.end() &&
+        shared_headers_.size() < max_shared_header_urls &&
+        writer.size() <= max_shared_header_lines) {
+      // Until another request to `url`, every line might be the same in each.
+      found = shared_headers_.emplace(std::move(key), SharedHeaders{}).first;
+      SharedHeaders &entry = found->second;
+      for (std::size_t i = 0; i < writer.size(); ++i) {
+        entry.lines.emplace_back(writer.line(i));
+      }
+      shared_lines = writer.size() == 64
+                         ? ~std::uint64_t(0)
+                         : (std::uint64_t(1) << writer.size()) - 1;
+    } else if (found != shared_headers_.end()) {
+      SharedHeaders &entry = found->second;
+      std::size_t num_shared = 0;
+      for (const std::string &shared : entry.lines) {
+        for (std::size_t i = 0; i < writer.size() && i < 64; ++i) {
+          if (!(shared_lines & (std::uint64_t(1) << i)) &&
+              shared == writer.line(i)) {
+            shared_lines |= std::uint64_t(1) << i;
+            ++num_shared;
+            break;
+          }
+        }
+      }
+      if (num_shared == entry.lines.size() && entry.list) {
+        request.shared_headers = entry.list;
+      } else {
+        // Some line changed since the previous request to `url`, so the list
+        // now has the lines that did not.  Requests still using the previous
+        // list keep it alive.
+        entry.lines.clear();
+        for (std::size_t i = 0; i < writer.size(); ++i) {
+          if (shared_lines & (std::uint64_t(1) << i)) {
+            entry.lines.emplace_back(writer.line(i));
+          }
+        }
+        entry.list = nullptr;
+      }
+    }
+
+    if (found != shared_headers_.end() && !request.shared_headers) {
+      SharedHeaders &entry = found->second;
+      curl_slist *list = nullptr;
+      for (const std::string &line : entry.lines) {
+        list = curl_.slist_append(list, line.c_str());
+      }
+      CurlLibrary *curl = &curl_;
+      entry.list = std::shared_ptr<curl_slist>(
+          list, [curl](curl_slist *list) { curl->slist_free_all(list); });
+      request.shared_headers = entry.list;
+    }
+  }
+
+  for (std::size_t i = 0; i < writer.size(); ++i) {
+    if (i < 64 && (shared_lines & (std::uint64_t(1) << i))) {
+      continue;
+    }
+    // Appending after the last line avoids walking the list.
+    curl_slist *const list =
+        curl_.slist_append(request.last_request_header, writer.line(i));
+    if (!list) {
+      continue;
+    }
+    if (!request.request_headers) {
+      request.request_headers = list;
+      request.last_request_header = list;
+    } else {
+      request.last_request_header = request.last_request_header->next;
+    }
+  }
+  if (request.last_request_header) {
+    request.last_request_header->next = request.shared_headers.get();
+  }
+}
+
 void CurlImpl::clear_requests() {
   for (const auto &handle : request_handles_) {
     char *user_data;
@@ -416,6 +847,62 @@ void CurlImpl::clear_requests() {
   }
 
   request_handles_.clear();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &[endpoint, handles] : idle_handles_) {
+    for (CURL *handle : handles) {
+      curl_.easy_cleanup(handle);
+    }
+  }
+  idle_handles_.clear();
+  shared_headers_.clear();
+}
+
+CURL *CurlImpl::acquire_handle(const std::string &endpoint) {
+  CURL *handle = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = idle_handles_.find(endpoint);
+    if (found != idle_handles_.end() && !found->second.empty()) {
+      handle = found->second.back();
+      found->second.pop_back();
+    }
+  }
+
+  if (handle) {
+    // Resetting the handle's options keeps its connections and caches.
+    curl_.easy_reset(handle);
+    ++handles_reused_;
+    return handle;
+  }
+
+  handle = curl_.easy_init();
+  if (handle) {
+    ++handles_created_;
+  }
+  return handle;
+}
+
+void CurlImpl::release_handle(CURL *handle, const std::string &endpoint) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &handles = idle_handles_[endpoint];
+    if (handles.size() < max_idle_handles_per_endpoint) {
+      handles.push_back(handle);
+      return;
+    }
+  }
+  curl_.easy_cleanup(handle);
+}
+
+nlohmann::json CurlImpl::config() const {
+  return nlohmann::json::object({
+      {"handles_created", handles_created_.load()},
+      {"handles_reused", handles_reused_.load()},
+      {"http2", http2_},
+      {"dns_cache_ttl_seconds",
+       std::chrono::duration<double>(dns_cache_ttl_).count()},
+  });
 }
 
 void CurlImpl::drain(std::chrono::steady_clock::time_point deadline) {
@@ -433,10 +920,11 @@ void CurlImpl::drain(std::chrono::steady_clock::time_point deadline) {
 std::size_t CurlImpl::on_read_header(char *data, std::size_t,
                                      std::size_t length, void *user_data) {
   const auto request = static_cast<Request *>(user_data);
-  // The idea is:
+  // Header lines are kept as they are, e.g.
   //
   //         "    Foo-Bar  :   thingy, thingy, thing   \r\n"
-  //    -> {"foo-bar", "thingy, thingy, thing"}
+  //
+  // and then parsed by `HeaderBlockReader` only if they are looked up.
   //
   // There isn't always a colon.  Inputs without a colon can be ignored:
   //
@@ -448,15 +936,15 @@ std::size_t CurlImpl::on_read_header(char *data, std::size_t,
   //
 
   StringView sv(data, length);
-  auto colon_idx = sv.find(":");
-  if (colon_idx == StringView::npos) {
+  if (sv.find(':') == StringView::npos) {
     return length;
   }
 
-  const auto key = trim(sv.substr(0, colon_idx));
-  const auto value = trim(sv.substr(colon_idx + 1));
-
-  request->response_headers_lower.emplace(to_lower(key), value);
+  auto &headers = request->response_headers;
+  append(headers, sv);
+  if (sv.back() != '\n') {
+    headers += '\n';
+  }
   return length;
 }
 
@@ -467,6 +955,28 @@ std::size_t CurlImpl::on_read_body(char *data, std::size_t, std::size_t length,
   return length;
 }
 
+std::size_t CurlImpl::on_send_body(char *buffer, std::size_t size,
+                                   std::size_t count, void *user_data) {
+  const auto request = static_cast<Request *>(user_data);
+  const auto &segments = request->request_segments;
+  const std::size_t capacity = size * count;
+  std::size_t written = 0;
+  while (written < capacity && request->segment < segments.size()) {
+    const std::string &segment = *segments[request->segment];
+    const std::size_t length = std::min(
+        capacity - written, segment.size() - request->segment_offset);
+    std::memcpy(buffer + written, segment.data() + request->segment_offset,
+                length);
+    written += length;
+    request->segment_offset += length;
+    if (request->segment_offset == segment.size()) {
+      ++request->segment;
+      request->segment_offset = 0;
+    }
+  }
+  return written;
+}
+
 CURLcode CurlImpl::log_on_error(CURLcode result) {
   if (result != CURLE_OK) {
     logger_->log_error(
@@ -489,7 +999,11 @@ void CurlImpl::run() {
 
   bool shutting_down = false;
   CURLMsg *message = nullptr;
-  constexpr int max_wait_milliseconds = 10'000;
+  // The earliest deadline of the requests in libcurl that is not yet reached,
+  // or `time_point::max()` if there is none.  A request that has since
+  // completed might have had this deadline, which causes at most one early
+  // wakeup.
+  auto next_deadline = std::chrono::steady_clock::time_point::max();
 
   std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
   std::list<CURL *> handles_to_process;
@@ -500,6 +1014,7 @@ void CurlImpl::run() {
 
     handles_to_process.splice(handles_to_process.begin(), new_handles_);
     assert(new_handles_.empty());
+    wakeup_pending_ = false;
 
     num_active_handles_ =
         num_active_handles + static_cast<int>(handles_to_process.size());
@@ -507,7 +1022,10 @@ void CurlImpl::run() {
 
     no_requests_.notify_all();
 
-    // New requests might have been added while we were sleeping.
+    // New requests might have been added while we were sleeping.  They are
+    // added to libcurl together, each with the time remaining before its
+    // deadline.
+    const auto now = clock_().tick;
     for (; !handles_to_process.empty(); handles_to_process.pop_front()) {
       CURL *handle = handles_to_process.front();
       char *user_data;
@@ -518,7 +1036,7 @@ void CurlImpl::run() {
       }
 
       auto *request = reinterpret_cast<Request *>(user_data);
-      const auto timeout = request->deadline - clock_().tick;
+      const auto timeout = request->deadline - now;
       if (timeout <= std::chrono::steady_clock::time_point::duration::zero()) {
         std::string error_message;
         error_message +=
@@ -546,26 +1064,166 @@ void CurlImpl::run() {
                   .count())));
       log_on_error(curl_.multi_add_handle(multi_handle_, handle));
       request_handles_.insert(handle);
+      next_deadline = std::min(next_deadline, request->deadline);
     }
 
     if (shutting_down) break;
 
-    log_on_error(curl_.multi_perform(multi_handle_, &num_active_handles));
+    {
+      DD_TIMELINE_SCOPE("Curl event loop iteration");
+      log_on_error(curl_.multi_perform(multi_handle_, &num_active_handles));
+
+      // If a request is done or errored out, curl will enqueue a "message"
+      // for us to handle. Handle any pending messages.
+      while ((message = curl_.multi_info_read(multi_handle_,
+                                              &num_messages_remaining))) {
+        handle_message(*message);
+      }
+    }
 
-    // If a request is done or errored out, curl will enqueue a "message" for
-    // us to handle. Handle any pending messages.
-    while ((message = curl_.multi_info_read(multi_handle_,
-                                            &num_messages_remaining))) {
-      handle_message(*message);
+    // Wait until the next deadline, but no longer than `max_poll_wait`.
+    const auto before_poll = clock_().tick;
+    if (request_handles_.empty()) {
+      next_deadline = std::chrono::steady_clock::time_point::max();
+    } else if (next_deadline <= before_poll) {
+      next_deadline = this->next_deadline(before_poll);
+    }
+    auto wait = max_poll_wait;
+    if (next_deadline < before_poll + max_poll_wait) {
+      wait = std::chrono::ceil<std::chrono::milliseconds>(next_deadline -
+                                                          before_poll);
     }
     log_on_error(curl_.multi_poll(multi_handle_, nullptr, 0,
-                                  max_wait_milliseconds, nullptr));
+                                  static_cast<int>(wait.count()), nullptr));
   }
 
   // We're shutting down. Clean up any remaining request handles.
   clear_requests();
 }
 
+std::chrono::steady_clock::time_point CurlImpl::next_deadline(
+    std::chrono::steady_clock::time_point after) {
+  // libcurl times out the requests whose deadlines have been reached, so
+  // those need not wake the event loop.
+  auto result = std::chrono::steady_clock::time_point::max();
+  for (CURL *handle : request_handles_) {
+    char *user_data;
+    if (curl_.easy_getinfo_private(handle, &user_data) != CURLE_OK) {
+      continue;
+    }
+    const auto deadline = reinterpret_cast<Request *>(user_data)->deadline;
+    if (deadline > after) {
+      result = std::min(result, deadline);
+    }
+  }
+  return result;
+}
+
+void CurlImpl::resolve_hosts() {
+  std::unique_lock<std::mutex> lock(resolver_mutex_);
+  while (!resolver_stopping_) {
+    const auto now = std::chrono::steady_clock::now();
+    auto next_refresh = std::chrono::steady_clock::time_point::max();
+    auto due = resolved_hosts_.end();
+    for (auto entry = resolved_hosts_.begin(); entry != resolved_hosts_.end();
+         ++entry) {
+      if (entry->second.refresh_at <= now) {
+        due = entry;
+        break;
+      }
+      next_refresh = std::min(next_refresh, entry->second.refresh_at);
+    }
+
+    if (due == resolved_hosts_.end()) {
+      if (next_refresh == std::chrono::steady_clock::time_point::max()) {
+        resolver_wakeup_.wait(lock);
+      } else {
+        resolver_wakeup_.wait_until(lock, next_refresh);
+      }
+      continue;
+    }
+    if (!due->second.used) {
+      resolved_hosts_.erase(due);
+      continue;
+    }
+
+    // Only this thread removes entries, so `key` is still there after
+    // resolving, though `resolved_hosts_` might have been rehashed.
+    due->second.used = false;
+    const std::string key = due->first;
+    const std::string host = due->second.host;
+    const std::string port = due->second.port;
+    lock.unlock();
+    std::string addresses = curl_.resolve_host(host, port);
+    lock.lock();
+
+    ResolvedHost &resolved = resolved_hosts_.at(key);
+    const auto resolved_at = std::chrono::steady_clock::now();
+    if (addresses.empty()) {
+      // Keep using the previous addresses, if any, until `host` resolves.
+      resolved.refresh_at =
+          resolved_at + std::min<std::chrono::steady_clock::duration>(
+                            dns_cache_ttl_, resolve_retry_interval);
+    } else {
+      resolved.addresses = std::move(addresses);
+      resolved.refresh_at = resolved_at + dns_cache_ttl_;
+    }
+  }
+}
+
+std::string CurlImpl::resolved_host(const URL &url) {
+  // `url.authority` is "host", "host:port", or "[address]:port".  Addresses
+  // need not be resolved, and neither does "localhost", which libcurl
+  // resolves itself.
+  const std::string &authority = url.authority;
+  if (authority.empty() || authority.front() == '[') {
+    return "";
+  }
+  const auto colon = authority.rfind(':');
+  std::string host = authority.substr(0, colon);
+  std::string port = colon == std::string::npos
+                         ? (url.scheme == "https" ? "443" : "80")
+                         : authority.substr(colon + 1);
+  if (host.empty() || host == "localhost" ||
+      host.find_first_not_of("0123456789.") == std::string::npos) {
+    return "";
+  }
+
+  std::string key = host;
+  key += ':';
+  key += port;
+
+  std::string entry;
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lock(resolver_mutex_);
+    auto found = resolved_hosts_.find(key);
+    if (found == resolved_hosts_.end()) {
+      if (resolved_hosts_.size() >= max_resolved_hosts) {
+        return "";
+      }
+      found = resolved_hosts_.emplace(key, ResolvedHost{}).first;
+      ResolvedHost &resolved = found->second;
+      resolved.host = std::move(host);
+      resolved.port = std::move(port);
+      resolved.refresh_at = std::chrono::steady_clock::now();
+      added = true;
+    }
+    ResolvedHost &resolved = found->second;
+    resolved.used = true;
+    if (!resolved.addresses.empty()) {
+      entry = std::move(key);
+      entry += ':';
+      entry += resolved.addresses;
+    }
+  }
+
+  if (added) {
+    resolver_wakeup_.notify_one();
+  }
+  return entry;
+}
+
 void CurlImpl::handle_message(const CURLMsg &message) {
   if (message.msg != CURLMSG_DONE) {
     return;
@@ -588,6 +1246,7 @@ void CurlImpl::handle_message(const CURLMsg &message) {
     error_message += curl_.easy_strerror(result);
     error_message += "): ";
     error_message += request.error_buffer;
+    DD_USDT_PROBE(http__done, -1);
     request.on_error(
         Error{Error::CURL_REQUEST_FAILURE, std::move(error_message)});
   } else {
@@ -596,58 +1255,37 @@ void CurlImpl::handle_message(const CURLMsg &message) {
                                                       &status)) != CURLE_OK) {
       status = -1;
     }
-    HeaderReader reader(&request.response_headers_lower);
+    DD_USDT_PROBE(http__done, status);
+    HeaderBlockReader reader(request.response_headers);
     request.on_response(static_cast<int>(status), reader,
                         std::move(request.response_body));
   }
 
   log_on_error(curl_.multi_remove_handle(multi_handle_, request_handle));
-  curl_.easy_cleanup(request_handle);
   request_handles_.erase(request_handle);
+  release_handle(request_handle, request.endpoint);
   delete &request;
 }
 
-CurlImpl::Request::~Request() { curl->slist_free_all(request_headers); }
-
-CurlImpl::HeaderWriter::HeaderWriter(CurlLibrary &curl) : curl_(curl) {}
-
-CurlImpl::HeaderWriter::~HeaderWriter() { curl_.slist_free_all(list_); }
+curl_slist *CurlImpl::Request::headers() const {
+  return request_headers ? request_headers : shared_headers.get();
+}
 
-curl_slist *CurlImpl::HeaderWriter::release() {
-  auto list = list_;
-  list_ = nullptr;
-  return list;
+CurlImpl::Request::~Request() {
+  if (last_request_header) {
+    // The shared lines belong to `shared_headers`.
+    last_request_header->next = nullptr;
+  }
+  curl->slist_free_all(request_headers);
+  curl->slist_free_all(resolve);
 }
 
 void CurlImpl::HeaderWriter::set(StringView key, StringView value) {
-  buffer_.clear();
+  offsets_.push_back(buffer_.size());
   buffer_ += key;
   buffer_ += ": ";
   buffer_ += value;
-
-  list_ = curl_.slist_append(list_, buffer_.c_str());
-}
-
-CurlImpl::HeaderReader::HeaderReader(
-    std::unordered_map<std::string, std::string> *response_headers_lower)
-    : response_headers_lower_(response_headers_lower) {}
-
-Optional<StringView> CurlImpl::HeaderReader::lookup(StringView key) const {
-  buffer_ = to_lower(key);
-
-  const auto found = response_headers_lower_->find(buffer_);
-  if (found == response_headers_lower_->end()) {
-    return nullopt;
-  }
-  return found->second;
-}
-
-void CurlImpl::HeaderReader::visit(
-    const std::function<void(StringView key, StringView value)> &visitor)
-    const {
-  for (const auto &[key, value] : *response_headers_lower_) {
-    visitor(key, value);
-  }
+  buffer_ += '\0';
 }
 
 }  // namespace tracing
@@ -4,6 +4,15 @@
 // interface in terms of [libcurl][1].  `class Curl` manages a thread that is
 // used as the event loop for libcurl.
 //
+// Each request uses a libcurl "easy handle."  When a request completes, its
+// handle is kept for reuse by a later request to the same endpoint, so that
+// the handle's connections and caches are kept too.
+//
+// Optionally, `Curl` speaks HTTP/2, so that concurrent requests to the same
+// endpoint are multiplexed over one connection, and resolves the host names of
+// endpoints in the background, so that requests do not wait for DNS (see
+// `CurlOptions`).
+//
 // If this library was built in a mode that does not include libcurl, then this
 // file and its implementation, `curl.cpp`, will not be included.
 //
@@ -12,6 +21,7 @@
 #include <curl/curl.h>
 #include <datadog/clock.h>
 #include <datadog/http_client.h>
+#include <datadog/thread_options.h>
 
 #include <chrono>
 #include <functional>
@@ -31,6 +41,9 @@ namespace tracing {
 // corresponding member functions -- one for each `CURLINFO` value or
 // `CURLoption` value, respectively.
 //
+// The exception is `resolve_host`, which uses `getaddrinfo` rather than
+// libcurl.
+//
 // The default implementations forward to their libcurl counterparts.  Unit
 // tests override some of the member functions.
 class CurlLibrary {
@@ -39,21 +52,30 @@ class CurlLibrary {
                                   void *userdata);
   typedef size_t (*HeaderCallback)(char *buffer, size_t size, size_t nitems,
                                    void *userdata);
+  typedef size_t (*ReadCallback)(char *buffer, size_t size, size_t nitems,
+                                 void *userdata);
 
   virtual ~CurlLibrary() = default;
 
   virtual void easy_cleanup(CURL *handle);
   virtual CURL *easy_init();
+  virtual void easy_reset(CURL *handle);
   virtual CURLcode easy_getinfo_private(CURL *curl, char **user_data);
   virtual CURLcode easy_getinfo_response_code(CURL *curl, long *code);
   virtual CURLcode easy_setopt_errorbuffer(CURL *handle, char *buffer);
   virtual CURLcode easy_setopt_headerdata(CURL *handle, void *data);
   virtual CURLcode easy_setopt_headerfunction(CURL *handle, HeaderCallback);
   virtual CURLcode easy_setopt_httpheader(CURL *handle, curl_slist *headers);
+  virtual CURLcode easy_setopt_http_version(CURL *handle, long version);
+  virtual CURLcode easy_setopt_pipewait(CURL *handle, long wait);
   virtual CURLcode easy_setopt_post(CURL *handle, long post);
   virtual CURLcode easy_setopt_postfields(CURL *handle, const char *data);
   virtual CURLcode easy_setopt_postfieldsize(CURL *handle, long size);
   virtual CURLcode easy_setopt_private(CURL *handle, void *pointer);
+  virtual CURLcode easy_setopt_readdata(CURL *handle, void *data);
+  virtual CURLcode easy_setopt_readfunction(CURL *handle, ReadCallback);
+  virtual CURLcode easy_setopt_resolve(CURL *handle, curl_slist *hosts);
+  virtual CURLcode easy_setopt_tcp_keepalive(CURL *handle, long enabled);
   virtual CURLcode easy_setopt_unix_socket_path(CURL *handle, const char *path);
   virtual CURLcode easy_setopt_url(CURL *handle, const char *url);
   virtual CURLcode easy_setopt_writedata(CURL *handle, void *data);
@@ -71,10 +93,36 @@ class CurlLibrary {
                                unsigned extra_nfds, int timeout_ms,
                                int *numfds);
   virtual CURLMcode multi_remove_handle(CURLM *multi_handle, CURL *easy_handle);
+  virtual CURLMcode multi_setopt_pipelining(CURLM *multi_handle, long bitmask);
   virtual const char *multi_strerror(CURLMcode error);
   virtual CURLMcode multi_wakeup(CURLM *multi_handle);
   virtual curl_slist *slist_append(curl_slist *list, const char *string);
   virtual void slist_free_all(curl_slist *list);
+  virtual curl_version_info_data *version_info(CURLversion version);
+
+  // Return the addresses of the specified `host` for TCP connections to the
+  // specified `port`, comma-separated as in an entry of `CURLOPT_RESOLVE`, or
+  // return an empty string if `host` cannot be resolved.
+  virtual std::string resolve_host(const std::string &host,
+                                   const std::string &port);
+};
+
+struct CurlOptions {
+  // Whether to send requests using HTTP/2, multiplexing concurrent requests to
+  // the same endpoint over one connection.  For "http" and Unix domain socket
+  // URLs, HTTP/2 is used without first negotiating it ("prior knowledge"), so
+  // the server must support it.  For "https" URLs, HTTP/2 is negotiated
+  // during the TLS handshake.  If libcurl was built without HTTP/2 support,
+  // then an error is logged and HTTP/1.1 is used instead.
+  bool http2 = false;
+  // If not zero, how often to resolve the host names of endpoints.  A
+  // background thread resolves each host name that requests were sent to,
+  // and requests connect to the addresses most recently resolved (see
+  // `CURLOPT_RESOLVE`), so that a slow DNS server does not delay them.  Host
+  // names that no request used since they were last resolved are forgotten.
+  // If zero, libcurl resolves host names when it connects.
+  std::chrono::steady_clock::duration dns_cache_ttl =
+      std::chrono::steady_clock::duration::zero();
 };
 
 class CurlImpl;
@@ -84,12 +132,17 @@ class Curl : public HTTPClient {
   CurlImpl *impl_;
 
  public:
-  using ThreadGenerator = std::function<std::thread(std::function<void()> &&)>;
+  using ThreadGenerator = tracing::ThreadGenerator;
 
   explicit Curl(const std::shared_ptr<Logger> &, const Clock &);
+  Curl(const std::shared_ptr<Logger> &, const Clock &, const CurlOptions &);
+  Curl(const std::shared_ptr<Logger> &, const Clock &, const ThreadGenerator &,
+       const CurlOptions &);
   Curl(const std::shared_ptr<Logger> &, const Clock &, CurlLibrary &);
   Curl(const std::shared_ptr<Logger> &, const Clock &, CurlLibrary &,
        const ThreadGenerator &);
+  Curl(const std::shared_ptr<Logger> &, const Clock &, CurlLibrary &,
+       const ThreadGenerator &, const CurlOptions &);
   ~Curl();
 
   Curl(const Curl &) = delete;
@@ -99,6 +152,13 @@ class Curl : public HTTPClient {
                       ErrorHandler on_error,
                       std::chrono::steady_clock::time_point deadline) override;
 
+  // Send the `body` segments in order as they are read by libcurl, without
+  // concatenating them.
+  Expected<void> post_segments(
+      const URL &url, HeadersSetter set_headers, BodySegments body,
+      ResponseHandler on_response, ErrorHandler on_error,
+      std::chrono::steady_clock::time_point deadline) override;
+
   void drain(std::chrono::steady_clock::time_point deadline) override;
 
   std::string config() const override;
@@ -4,38 +4,207 @@
 #include <datadog/dict_writer.h>
 #include <datadog/http_client.h>
 #include <datadog/logger.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/shared_trace_buffer.h>
+#include <datadog/spill_file.h>
 #include <datadog/string_view.h>
 #include <datadog/telemetry/telemetry.h>
 #include <datadog/tracer.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include "collector_response.h"
+#include "collector_shutdown.h"
+#include "common/hash.h"
+#include "compression.h"
 #include "json.hpp"
+#include "limiter.h"
 #include "msgpack.h"
+#include "overhead_governor.h"
 #include "platform_util.h"
+#include "process_info.h"
+#include "resource_latencies.h"
+#include "stats_concentrator.h"
+#include "tags.h"
+#include "random.h"
+#include "retry_backoff.h"
 #include "span_data.h"
+#include "span_recycler.h"
 #include "telemetry_metrics.h"
+#include "thread_generator.h"
+#include "timeline_events.h"
+#include "trace_encoder_v05.h"
 #include "trace_sampler.h"
+#include "usdt.h"
+#include "worker_pool.h"
 
 namespace datadog {
 namespace tracing {
 namespace {
 
 constexpr StringView traces_api_path = "/v0.4/traces";
+constexpr StringView traces_v05_api_path = "/v0.5/traces";
 constexpr StringView remote_configuration_path = "/v0.7/config";
+constexpr StringView stats_api_path = "/v0.6/stats";
+constexpr StringView info_api_path = "/info";
+
+// Limits on the buffers that `DatadogAgent` keeps for encoding trace chunks.
+// Buffers that grew larger than `max_pooled_buffer_capacity` are released
+// rather than pooled, so that one huge trace does not pin its memory.
+constexpr std::size_t max_pooled_buffers = 128;
+constexpr std::size_t max_pooled_buffer_capacity = 64 * 1024;
+
+// The estimated size of an encoded span before the first payload is sent.
+constexpr std::size_t initial_encoded_bytes_per_span = 512;
+
+// The number of shards in which `DatadogAgent::Batch` buffers trace chunks is
+// the number of hardware threads, rounded up to a power of two, and at most
+// this.  Each flush locks every shard.
+constexpr std::size_t max_batch_shards = 16;
+
+std::size_t batch_shard_count() {
+  const std::size_t threads =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  std::size_t count = 1;
+  while (count < threads && count < max_batch_shards) {
+    count *= 2;
+  }
+  return count;
+}
+
+// `InFlightRequest` counts a trace request as in flight for as long as it
+// exists.  The request's callbacks share ownership of it, so that the request
+// stops being in flight once the HTTP client releases them.
+class InFlightRequest {
+  std::shared_ptr<std::atomic<std::size_t>> count_;
+
+ public:
+  explicit InFlightRequest(std::shared_ptr<std::atomic<std::size_t>> count)
+      : count_(std::move(count)) {
+    ++*count_;
+  }
+  InFlightRequest(const InFlightRequest&) = delete;
+  InFlightRequest& operator=(const InFlightRequest&) = delete;
+  ~InFlightRequest() { --*count_; }
+};
+
+// Return whether the trace of the specified `chunk` is kept by its sampling
+// decision, which the first span carries.
+bool is_trace_kept(const TraceChunk& chunk) {
+  const auto& spans = chunk.spans;
+  if (spans.empty()) {
+    return true;
+  }
+  if (chunk.sampling_priority) {
+    return *chunk.sampling_priority > 0;
+  }
+  // The chunk did not come from a `TraceSegment`, so look up the priority
+  // where the Datadog Agent would.
+  const auto& priority_tags = spans.front()->numeric_tags;
+  const auto priority = priority_tags.find(tags::internal::sampling_priority);
+  return priority == priority_tags.end() || priority->second > 0;
+}
+
+// Remove from the specified `spans`, the spans of a dropped trace, those that
+// were not kept by span sampling.  Keep the trace's sampling priority on the
+// first remaining span, where the Datadog Agent reads it.
+void keep_span_sampled_spans(std::vector<std::unique_ptr<SpanData>>& spans) {
+  if (spans.empty()) {
+    return;
+  }
+  const auto& priority_tags = spans.front()->numeric_tags;
+  const auto priority = priority_tags.find(tags::internal::sampling_priority);
+  // A plain `double` and flag, rather than an `Optional`, which GCC warns
+  // might be read uninitialized once the spans are erased.
+  const bool has_priority = priority != priority_tags.end();
+  const double sampling_priority = has_priority ? priority->second : 0;
+
+  const auto is_dropped = [](const std::unique_ptr<SpanData>& span) {
+    return span->numeric_tags.find(tags::internal::span_sampling_mechanism) ==
+           span->numeric_tags.end();
+  };
+  spans.erase(std::remove_if(spans.begin(), spans.end(), is_dropped),
+              spans.end());
+  if (!spans.empty() && has_priority) {
+    spans.front()->numeric_tags[tags::internal::sampling_priority] =
+        sampling_priority;
+  }
+}
+
+// Return whether any of the specified `spans` has a call stack that is yet to
+// be symbolized (see `Span::capture_error_stack`).
+bool has_captured_stack(const std::vector<std::unique_ptr<SpanData>>& spans) {
+  return std::any_of(spans.begin(), spans.end(), [](const auto& span) {
+    return span->error_stack && span->error_stack->size != 0;
+  });
+}
+
+// Return the class of the specified `chunk`, given its sampling priority or,
+// if the chunk did not come from a `TraceSegment`, the priority carried by
+// its first span.  A chunk of unknown priority is kept, as it would be by the
+// Datadog Agent.
+DatadogAgent::ChunkClass class_of(const TraceChunk& chunk) {
+  const auto& spans = chunk.spans;
+  if (std::any_of(spans.begin(), spans.end(),
+                  [](const auto& span) { return span->error; })) {
+    return DatadogAgent::ChunkClass::PROTECTED;
+  }
+  double priority = 1;
+  if (chunk.sampling_priority) {
+    priority = *chunk.sampling_priority;
+  } else if (!spans.empty()) {
+    const auto& priority_tags = spans.front()->numeric_tags;
+    const auto found = priority_tags.find(tags::internal::sampling_priority);
+    if (found != priority_tags.end()) {
+      priority = found->second;
+    }
+  }
+  if (priority <= 0) {
+    return DatadogAgent::ChunkClass::SAMPLED_OUT;
+  }
+  if (priority >= int(SamplingPriority::USER_KEEP)) {
+    return DatadogAgent::ChunkClass::PROTECTED;
+  }
+  return DatadogAgent::ChunkClass::KEPT;
+}
+
+// Return the tag naming the specified `chunk_class` in telemetry.
+const char* class_tag(DatadogAgent::ChunkClass chunk_class) {
+  switch (chunk_class) {
+    case DatadogAgent::ChunkClass::SAMPLED_OUT:
+      return "class:sampled_out";
+    case DatadogAgent::ChunkClass::KEPT:
+      return "class:kept";
+    case DatadogAgent::ChunkClass::PROTECTED:
+      break;
+  }
+  return "class:protected";
+}
 
 void set_content_type_json(DictWriter& headers) {
   headers.set("Content-Type", "application/json");
 }
 
-HTTPClient::URL traces_endpoint(const HTTPClient::URL& agent_url) {
+HTTPClient::URL traces_endpoint(const HTTPClient::URL& agent_url,
+                                StringView api_path) {
   auto traces_url = agent_url;
-  append(traces_url.path, traces_api_path);
+  append(traces_url.path, api_path);
   return traces_url;
 }
 
@@ -46,118 +215,979 @@ HTTPClient::URL remote_configuration_endpoint(
   return remote_configuration;
 }
 
+// Return the number of consecutive Remote Configuration polls, at the
+// specified `poll_interval`, that are skipped so that queries are at most the
+// specified `max_poll_interval` apart.  This is also the number of periods of
+// the flush timer skipped between flushes at most a flush interval apart.
+std::uint32_t max_skipped_polls(
+    std::chrono::steady_clock::duration poll_interval,
+    std::chrono::steady_clock::duration max_poll_interval) {
+  if (poll_interval <= std::chrono::steady_clock::duration::zero()) {
+    return 0;
+  }
+  const auto polls = max_poll_interval / poll_interval;
+  return static_cast<std::uint32_t>(
+      std::min<decltype(polls)>(std::max<decltype(polls)>(polls - 1, 0),
+                                std::numeric_limits<std::uint32_t>::max()));
+}
+
 Expected<void> msgpack_encode(
     std::string& destination,
-    const std::vector<DatadogAgent::TraceChunk>& trace_chunks) {
-  return msgpack::pack_array(destination, trace_chunks,
-                             [](auto& destination, const auto& chunk) {
-                               return msgpack_encode(destination, chunk.spans);
-                             });
-}
-
-std::variant<CollectorResponse, std::string> parse_agent_traces_response(
-    StringView body) try {
-  nlohmann::json response = nlohmann::json::parse(body);
-
-  StringView type = response.type_name();
-  if (type != "object") {
-    std::string message;
-    message +=
-        "Parsing the Datadog Agent's response to traces we sent it failed.  "
-        "The response is expected to be a JSON object, but instead it's a JSON "
-        "value with type \"";
-    append(message, type);
-    message += '\"';
-    message += "\nError occurred for response body (begins on next line):\n";
-    append(message, body);
-    return message;
+    const std::vector<DatadogAgent::BufferedChunk>& trace_chunks) {
+  return msgpack::pack_array(
+      destination, trace_chunks, [](auto& destination, const auto& chunk) {
+        if (chunk.spans.empty()) {
+          // The chunk was encoded when it was sent.
+          destination += chunk.encoded;
+          return Expected<void>{};
+        }
+        return msgpack_encode(destination, chunk.spans);
+      });
+}
+
+// Encode the specified `trace_chunks`, which have the specified `span_count`
+// spans among them, as a v0.4 payload divided into consecutive `parts`, using
+// the threads of the specified `pool` and the calling thread.  The parts are
+// divided at chunk boundaries so that each has about the same number of spans
+// to encode.  Reserve room in each part for the specified `bytes_per_span`
+// for each of its spans.
+Expected<void> msgpack_encode_parallel(
+    std::vector<std::string>& parts,
+    const std::vector<DatadogAgent::BufferedChunk>& trace_chunks,
+    std::size_t span_count, std::size_t bytes_per_span, WorkerPool& pool) {
+  // `bounds[i]` is the index of the first chunk of part `i`.
+  const std::size_t max_parts = pool.size() + 1;
+  std::vector<std::size_t> bounds{0};
+  std::vector<std::size_t> part_spans{0};
+  for (std::size_t i = 0; i < trace_chunks.size(); ++i) {
+    part_spans.back() += trace_chunks[i].spans.size();
+    if (part_spans.back() * max_parts >= span_count &&
+        bounds.size() < max_parts && i + 1 < trace_chunks.size()) {
+      bounds.push_back(i + 1);
+      part_spans.push_back(0);
+    }
   }
+  bounds.push_back(trace_chunks.size());
+
+  parts.resize(bounds.size() - 1);
+  std::vector<Expected<void>> results(parts.size());
+  pool.run(parts.size(), [&](std::size_t part) {
+    auto& destination = parts[part];
+    const std::size_t estimated_size = part_spans[part] * bytes_per_span;
+    destination.reserve(estimated_size + estimated_size / 8);
+    auto& result = results[part];
+    if (part == 0) {
+      result = msgpack::pack_array(destination, trace_chunks.size());
+    }
+    for (std::size_t i = bounds[part]; result && i < bounds[part + 1]; ++i) {
+      const auto& chunk = trace_chunks[i];
+      if (chunk.spans.empty()) {
+        // The chunk was encoded when it was sent.
+        destination += chunk.encoded;
+      } else {
+        result = msgpack_encode(destination, chunk.spans);
+      }
+    }
+  });
 
-  const StringView sample_rates_property = "rate_by_service";
-  const auto found = response.find(sample_rates_property);
-  if (found == response.end()) {
-    return CollectorResponse{};
-  }
-  const auto& rates_json = found.value();
-  type = rates_json.type_name();
-  if (type != "object") {
-    std::string message;
-    message +=
-        "Parsing the Datadog Agent's response to traces we sent it failed.  "
-        "The \"";
-    append(message, sample_rates_property);
-    message +=
-        "\" property of the response is expected to be a JSON object, but "
-        "instead it's a JSON value with type \"";
-    append(message, type);
-    message += '\"';
+  for (auto& result : results) {
+    if (!result) {
+      return result;
+    }
+  }
+  return {};
+}
+
+// The size at which `msgpack_encode_paged` ends a page of a payload.
+constexpr std::size_t encoding_page_size = 256 * 1024;
+
+// Encode the specified `trace_chunks` as a v0.4 payload divided into
+// consecutive `pages`, so that a large payload is neither one contiguous
+// allocation nor copied as it grows.  A page ends after the span or
+// pre-encoded chunk that brings it to `encoding_page_size` bytes.  Reserve
+// room in the pages for no more than the specified `estimated_size` of the
+// payload, with some headroom.
+Expected<void> msgpack_encode_paged(
+    std::vector<std::string>& pages,
+    const std::vector<DatadogAgent::BufferedChunk>& trace_chunks,
+    std::size_t estimated_size) {
+  std::size_t reserved = 0;
+  const auto start_page = [&]() {
+    // If the estimate was too small, then the rest of the payload is at
+    // least one more page.
+    const std::size_t remaining = estimated_size > reserved
+                                      ? estimated_size - reserved
+                                      : encoding_page_size;
+    const std::size_t room = std::min(remaining, encoding_page_size);
+    pages.emplace_back();
+    pages.back().reserve(room + room / 8);
+    reserved += room;
+  };
+  const auto page_is_full = [&]() {
+    return pages.back().size() >= encoding_page_size;
+  };
+
+  start_page();
+  auto result = msgpack::pack_array(pages.back(), trace_chunks.size());
+  for (const auto& chunk : trace_chunks) {
+    if (!result) {
+      return result;
+    }
+    if (page_is_full()) {
+      start_page();
+    }
+    if (chunk.spans.empty()) {
+      // The chunk was encoded when it was sent.
+      pages.back() += chunk.encoded;
+      continue;
+    }
+    result = msgpack::pack_array(pages.back(), chunk.spans.size());
+    for (const auto& span : chunk.spans) {
+      if (!result) {
+        return result;
+      }
+      if (page_is_full()) {
+        start_page();
+      }
+      result = msgpack_encode(pages.back(), *span);
+    }
+  }
+  return result;
+}
+
+Expected<void> msgpack_encode_v05(
+    std::string& destination,
+    const std::vector<DatadogAgent::BufferedChunk>& trace_chunks) {
+  // The spans are encoded into the encoder's own buffer, and then appended to
+  // `destination` after the dictionary, so reserve the same amount for both.
+  TraceEncoderV05 encoder(destination.capacity() - destination.size());
+  for (const auto& chunk : trace_chunks) {
+    // Chunks are encoded on send only while v0.4 is in use, and v0.4 is never
+    // replaced by v0.5, so every chunk here still has its spans.
+    assert(!chunk.spans.empty());
+    auto result = encoder.add_chunk(chunk.spans);
+    if (!result) {
+      return result;
+    }
+  }
+  return encoder.finish(destination);
+}
+
+std::string to_url_string(const HTTPClient::URL& url) {
+  return url.scheme + "://" + url.authority + url.path;
+}
+
+// `RateByServiceParser` handles the events of a SAX parse of the Datadog
+// Agent's response to traces.  It collects the "rate_by_service" property and
+// skips everything else, so that no JSON DOM is built for the response.
+class RateByServiceParser : public nlohmann::json::json_sax_t {
+ public:
+  using number_integer_t = nlohmann::json::number_integer_t;
+  using number_unsigned_t = nlohmann::json::number_unsigned_t;
+  using number_float_t = nlohmann::json::number_float_t;
+  using string_t = nlohmann::json::string_t;
+  using binary_t = nlohmann::json::binary_t;
+
+  std::unordered_map<std::string, Rate> sample_rates;
+  // If the parse failed, why.  The body is not included.
+  std::string error;
+
+  bool null() override { return value("null"); }
+  bool boolean(bool) override { return value("boolean"); }
+  bool number_integer(number_integer_t number) override {
+    return rate(static_cast<double>(number));
+  }
+  bool number_unsigned(number_unsigned_t number) override {
+    return rate(static_cast<double>(number));
+  }
+  bool number_float(number_float_t number, const string_t&) override {
+    return rate(number);
+  }
+  bool string(string_t&) override { return value("string"); }
+  bool binary(binary_t&) override { return value("binary"); }
+
+  bool start_object(std::size_t) override {
+    if (depth_ == 1 && at_rates_) {
+      in_rates_ = true;
+      at_rates_ = false;
+      sample_rates.clear();
+    } else if (!value("object")) {
+      return false;
+    }
+    ++depth_;
+    return true;
+  }
+
+  bool key(string_t& key) override {
+    if (depth_ == 1) {
+      at_rates_ = key == sample_rates_property;
+    } else if (in_rates_ && depth_ == 2) {
+      key_ = std::move(key);
+    }
+    return true;
+  }
+
+  bool end_object() override {
+    --depth_;
+    if (depth_ == 1) {
+      in_rates_ = false;
+    }
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    if (!value("array")) {
+      return false;
+    }
+    ++depth_;
+    return true;
+  }
+
+  bool end_array() override {
+    --depth_;
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&,
+                   const nlohmann::json::exception& exception) override {
+    error =
+        "Parsing the Datadog Agent's response to traces we sent it failed with "
+        "a JSON error: ";
+    error += exception.what();
+    return false;
+  }
+
+ private:
+  static constexpr StringView sample_rates_property = "rate_by_service";
+
+  // The number of objects and arrays that contain the current event.
+  int depth_ = 0;
+  // Whether the next value is that of the "rate_by_service" property.
+  bool at_rates_ = false;
+  // Whether the current event is within the "rate_by_service" object.
+  bool in_rates_ = false;
+  // The key of the current sample rate.
+  std::string key_;
+
+  // Check the specified `type` of a value that is not a number.  Return
+  // whether parsing should continue.
+  bool value(StringView type) {
+    if (in_rates_ && depth_ == 2) {
+      return invalid_rate_type(type);
+    }
+    return check_placement(type);
+  }
+
+  // Check the specified `type` of a value that is not within
+  // "rate_by_service".  Return whether parsing should continue.
+  bool check_placement(StringView type) {
+    if (depth_ == 0 && type != "object") {
+      error =
+          "Parsing the Datadog Agent's response to traces we sent it failed.  "
+          "The response is expected to be a JSON object, but instead it's a "
+          "JSON value with type \"";
+      append(error, type);
+      error += '\"';
+      return false;
+    }
+    if (depth_ == 1 && at_rates_) {
+      error =
+          "Parsing the Datadog Agent's response to traces we sent it failed.  "
+          "The \"";
+      append(error, sample_rates_property);
+      error +=
+          "\" property of the response is expected to be a JSON object, but "
+          "instead it's a JSON value with type \"";
+      append(error, type);
+      error += '\"';
+      return false;
+    }
+    return true;
+  }
+
+  bool invalid_rate_type(StringView type) {
+    error =
+        "Datadog Agent response to traces included an invalid sample rate for "
+        "the key \"";
+    error += key_;
+    error += "\". Rate should be a number, but it's a \"";
+    append(error, type);
+    error += "\" instead.";
+    return false;
+  }
+
+  bool rate(double number) {
+    if (!(in_rates_ && depth_ == 2)) {
+      return check_placement("number");
+    }
+    auto maybe_rate = Rate::from(number);
+    if (auto* rate_error = maybe_rate.if_error()) {
+      error =
+          "Datadog Agent response trace traces included an invalid sample "
+          "rate for the key \"";
+      error += key_;
+      error += "\": ";
+      error += rate_error->message;
+      return false;
+    }
+    // As with a JSON object, the last occurrence of a key wins.
+    sample_rates.insert_or_assign(std::move(key_), *maybe_rate);
+    return true;
+  }
+};
+
+std::variant<std::shared_ptr<const CollectorResponse>, std::string>
+parse_agent_traces_response(StringView body) {
+  RateByServiceParser parser;
+  if (!nlohmann::json::sax_parse(body.data(), body.data() + body.size(),
+                                 &parser)) {
+    std::string message = std::move(parser.error);
     message += "\nError occurred for response body (begins on next line):\n";
     append(message, body);
     return message;
   }
-
-  std::unordered_map<std::string, Rate> sample_rates;
-  for (const auto& [key, value] : rates_json.items()) {
-    type = value.type_name();
-    if (type != "number") {
-      std::string message;
-      message +=
-          "Datadog Agent response to traces included an invalid sample rate "
-          "for the key \"";
-      message += key;
-      message += "\". Rate should be a number, but it's a \"";
-      append(message, type);
-      message += "\" instead.";
-      message += "\nError occurred for response body (begins on next line):\n";
-      append(message, body);
-      return message;
-    }
-    auto maybe_rate = Rate::from(value);
-    if (auto* error = maybe_rate.if_error()) {
-      std::string message;
-      message +=
-          "Datadog Agent response trace traces included an invalid sample rate "
-          "for the key \"";
-      message += key;
-      message += "\": ";
-      message += error->message;
-      message += "\nError occurred for response body (begins on next line):\n";
-      append(message, body);
-      return message;
-    }
-    sample_rates.emplace(key, *maybe_rate);
-  }
-  return CollectorResponse{std::move(sample_rates)};
-} catch (const nlohmann::json::exception& error) {
-  std::string message;
-  message +=
-      "Parsing the Datadog Agent's response to traces we sent it failed with a "
-      "JSON error: ";
-  message += error.what();
-  message += "\nError occurred for response body (begins on next line):\n";
-  append(message, body);
-  return message;
+  return std::make_shared<const CollectorResponse>(
+      CollectorResponse{std::move(parser.sample_rates)});
 }
 
 }  // namespace
 
 namespace rc = datadog::remote_config;
 
+// `Retries` holds the payloads that failed to be sent, until they are sent
+// again.  It is shared with the callbacks of requests, which can outlive the
+// `DatadogAgent`.
+struct DatadogAgent::Retries {
+  std::mutex mutex;
+  // Guarded by `mutex`.
+  std::vector<std::shared_ptr<Payload>> payloads;
+  // The total size of `payloads`.  Guarded by `mutex`.
+  std::size_t bytes = 0;
+  const std::size_t max_retries;
+  const std::size_t budget_bytes;
+  // If not null, where the payloads that cannot be kept in `payloads` are
+  // written instead of being dropped.
+  const std::shared_ptr<SpillFile> spill_file;
+  // Whether the most recent outcome of sending a payload was a successful
+  // response.
+  std::atomic<bool> agent_responding{true};
+  const Clock clock;
+
+  Retries(std::size_t max_retries, std::size_t budget_bytes,
+          std::shared_ptr<SpillFile> spill_file, const Clock& clock)
+      : max_retries(max_retries),
+        budget_bytes(budget_bytes),
+        spill_file(std::move(spill_file)),
+        clock(clock) {}
+
+  // Keep the specified `payload` to be sent again after a backoff, unless it
+  // was already retried `max_retries` times or keeping it would exceed
+  // `budget_bytes`, in which case write it to `spill_file`, if there is one.
+  // Return whether the payload was kept or written.
+  bool retry_later(const std::shared_ptr<Payload>& payload) {
+    agent_responding.store(false, std::memory_order_relaxed);
+    if (payload->attempts > max_retries) {
+      return spill(*payload);
+    }
+    const auto delay = retry_backoff(payload->attempts);
+    return keep(payload, delay);
+  }
+
+  // Keep the specified `payload`, which was re-encoded in a form that the
+  // Datadog Agent accepts after it rejected the payload's original form, to
+  // be sent again by the next flush.  Unlike `retry_later`, this does not
+  // count against `max_retries`, since the Datadog Agent is responding.
+  // Return whether the payload was kept or written to `spill_file`.
+  bool resend(const std::shared_ptr<Payload>& payload) {
+    return keep(payload, std::chrono::steady_clock::duration::zero());
+  }
+
+  // Keep the specified `payload` to be sent again after the specified
+  // `delay`, unless keeping it would exceed `budget_bytes`, in which case
+  // write it to `spill_file`, if there is one.  Return whether the payload
+  // was kept or written.
+  bool keep(const std::shared_ptr<Payload>& payload,
+            std::chrono::steady_clock::duration delay) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (bytes + payload->size <= budget_bytes) {
+        payload->retry_after = clock().tick + delay;
+        bytes += payload->size;
+        payloads.push_back(payload);
+        return true;
+      }
+    }
+    return spill(*payload);
+  }
+
+  // Remove and return the payloads whose backoff has elapsed, or all of them
+  // if the specified `all` is true.
+  std::vector<std::shared_ptr<Payload>> take_due(bool all) {
+    const auto now = clock().tick;
+    std::vector<std::shared_ptr<Payload>> due;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto waiting = std::partition(
+        payloads.begin(), payloads.end(), [&](const auto& payload) {
+          return !all && payload->retry_after > now;
+        });
+    for (auto iter = waiting; iter != payloads.end(); ++iter) {
+      bytes -= (*iter)->size;
+      due.push_back(std::move(*iter));
+    }
+    payloads.erase(waiting, payloads.end());
+    return due;
+  }
+
+  // Return whether no payloads are waiting to be sent again in memory.
+  bool empty() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return payloads.empty();
+  }
+
+  // Write the specified `payload` to `spill_file`.  Return whether there is a
+  // `spill_file` and the payload fit in it.
+  //
+  // A spilled payload is the payload's trace count and dropped P0 counts as
+  // 64-bit integers, then a byte of flags, and then the body.
+  bool spill(const Payload& payload) {
+    if (!spill_file) {
+      return false;
+    }
+    std::string record;
+    record.reserve(spilled_header_size + payload.size);
+    const std::uint64_t counts[] = {payload.trace_count,
+                                    payload.dropped_p0_traces,
+                                    payload.dropped_p0_spans};
+    record.append(reinterpret_cast<const char*>(counts), sizeof counts);
+    record += char((payload.v05 ? spilled_v05 : 0) |
+                   (payload.compressed ? spilled_compressed : 0) |
+                   (payload.computed_stats ? spilled_computed_stats : 0));
+    for (const auto& segment : payload.body) {
+      record += *segment;
+    }
+    return spill_file->push(record);
+  }
+
+  // Write all of the payloads that are waiting to be sent again to
+  // `spill_file`, oldest first, so that they are not lost when the tracer
+  // shuts down.
+  void spill_all() {
+    if (!spill_file) {
+      return;
+    }
+    for (const auto& payload : take_due(true)) {
+      spill(*payload);
+    }
+  }
+
+  // Return the payload in the specified spilled `record`, or return null if
+  // `record` is not a spilled payload.
+  static std::shared_ptr<Payload> unspill(const std::string& record) {
+    if (record.size() < spilled_header_size) {
+      return nullptr;
+    }
+    std::uint64_t counts[3];
+    std::memcpy(counts, record.data(), sizeof counts);
+    const char flags = record[sizeof counts];
+    auto payload = std::make_shared<Payload>();
+    payload->trace_count = static_cast<std::size_t>(counts[0]);
+    payload->dropped_p0_traces = counts[1];
+    payload->dropped_p0_spans = counts[2];
+    payload->v05 = flags & spilled_v05;
+    payload->compressed = flags & spilled_compressed;
+    payload->computed_stats = flags & spilled_computed_stats;
+    payload->body.push_back(std::make_shared<const std::string>(
+        record.substr(spilled_header_size)));
+    payload->size = record.size() - spilled_header_size;
+    return payload;
+  }
+
+  static constexpr std::size_t spilled_header_size =
+      3 * sizeof(std::uint64_t) + 1;
+  static constexpr char spilled_v05 = 1;
+  static constexpr char spilled_compressed = 2;
+  static constexpr char spilled_computed_stats = 4;
+};
+
+// `ResponseCache` holds the response to traces that was parsed most recently.
+// The Datadog Agent usually responds with the same sample rates many times in
+// a row, so a response whose body is the same as the cached one is not parsed
+// again.  It is shared with the callbacks of requests.
+struct DatadogAgent::ResponseCache {
+  std::mutex mutex;
+  // The hash and size of the body of `response`.  Guarded by `mutex`.
+  std::uint64_t body_hash = 0;
+  std::size_t body_size = 0;
+  // Guarded by `mutex`.
+  std::shared_ptr<const CollectorResponse> response;
+
+  // Return the parsed response for the specified `body`, or an error message.
+  std::variant<std::shared_ptr<const CollectorResponse>, std::string> parse(
+      StringView body) {
+    common::FastHash hasher(0);
+    hasher.append(body.data(), body.size());
+    const std::uint64_t hash = hasher.final();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (response && hash == body_hash && body.size() == body_size) {
+        return response;
+      }
+    }
+
+    auto result = parse_agent_traces_response(body);
+    if (const auto* parsed =
+            std::get_if<std::shared_ptr<const CollectorResponse>>(&result)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      body_hash = hash;
+      body_size = body.size();
+      response = *parsed;
+    }
+    return result;
+  }
+};
+
+// `DeliveryLatencies` holds the distributions of how long trace chunks took,
+// by the tracer's clock, to reach each stage of their delivery: from when their
+// last span finished to when they were buffered, from then to when they were
+// encoded in a payload, and from then to when the Datadog Agent acknowledged
+// the payload.  The stages are timed without reading the clock more than once
+// per chunk and once per payload, and the distributions are added to when a
+// payload is encoded and when it is acknowledged, rather than for every chunk
+// as it is buffered.  It is shared with the callbacks of requests.
+struct DatadogAgent::DeliveryLatencies {
+  std::mutex mutex;
+  // Guarded by `mutex`.
+  ResourceLatencies::Sketch finish_to_enqueue;
+  ResourceLatencies::Sketch enqueue_to_encode;
+  ResourceLatencies::Sketch encode_to_ack;
+  ResourceLatencies::Sketch finish_to_ack;
+
+  // Add the specified `latency` to the specified `sketch` and to the
+  // specified telemetry `distribution`.  `mutex` must be locked.
+  static void add(ResourceLatencies::Sketch& sketch,
+                  const telemetry::Distribution& distribution,
+                  Duration latency) {
+    if (latency < Duration::zero()) {
+      latency = Duration::zero();
+    }
+    sketch.add(std::uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+            .count()));
+    telemetry::distribution::add(
+        distribution,
+        std::uint64_t(
+            std::chrono::duration_cast<std::chrono::milliseconds>(latency)
+                .count()));
+  }
+
+  // Add the latencies of the specified `trace_chunks`, which were encoded in
+  // the specified `payload` at `payload.encoded`, up to their encoding, and
+  // record in `payload` when each of the chunks finished.
+  void add_encoded(const std::vector<BufferedChunk>& trace_chunks,
+                   Payload& payload) {
+    const std::chrono::steady_clock::time_point unknown{};
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& chunk : trace_chunks) {
+      if (chunk.enqueued == unknown) {
+        continue;
+      }
+      add(enqueue_to_encode, metrics::tracer::trace_chunk_encode_latency,
+          payload.encoded - chunk.enqueued);
+      if (chunk.finished == unknown) {
+        continue;
+      }
+      add(finish_to_enqueue, metrics::tracer::trace_chunk_enqueue_latency,
+          chunk.enqueued - chunk.finished);
+      payload.chunks_finished.push_back(chunk.finished);
+    }
+  }
+
+  // Add the latencies of the chunks of the specified `payload`, which the
+  // Datadog Agent acknowledged at the specified `acknowledged`.
+  void add_acknowledged(const Payload& payload,
+                        std::chrono::steady_clock::time_point acknowledged) {
+    if (payload.encoded == std::chrono::steady_clock::time_point{}) {
+      // The payload was read from a spill file.
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i = 0; i < payload.trace_count; ++i) {
+      add(encode_to_ack, metrics::tracer::trace_chunk_ack_latency,
+          acknowledged - payload.encoded);
+    }
+    for (const auto finished : payload.chunks_finished) {
+      add(finish_to_ack, metrics::tracer::trace_chunk_delivery_latency,
+          acknowledged - finished);
+    }
+  }
+
+  void add_runtime_stats(RuntimeStats& stats) {
+    const auto describe = [](const ResourceLatencies::Sketch& sketch,
+                             DeliveryLatency& latency) {
+      latency.count = sketch.count();
+      latency.p50_nanoseconds = sketch.quantile(0.5);
+      latency.p90_nanoseconds = sketch.quantile(0.9);
+      latency.p99_nanoseconds = sketch.quantile(0.99);
+    };
+    std::lock_guard<std::mutex> lock(mutex);
+    describe(finish_to_enqueue, stats.finish_to_enqueue);
+    describe(enqueue_to_encode, stats.enqueue_to_encode);
+    describe(encode_to_ack, stats.encode_to_ack);
+    describe(finish_to_ack, stats.finish_to_ack);
+  }
+};
+
+// `Batch` holds the trace chunks to be sent in the next payload, along with
+// the state that must agree among the instances sending them.
+//
+// The chunks are buffered in shards, each having its own lock, so that the
+// threads that buffer chunks concurrently contend neither with each other nor
+// with a flush.  Each thread buffers its chunks in the shard selected by
+// `this_thread_shard`.  Only making room in a full buffer locks every shard.
+struct DatadogAgent::Batch {
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    // Guarded by `mutex`.
+    std::vector<BufferedChunk> chunks;
+    // The estimated encoded size of the chunks in `chunks` of each
+    // `ChunkClass`.  Guarded by `mutex`.
+    std::size_t class_bytes[num_chunk_classes] = {};
+    // A copy of `chunks.size()`, which can be read without locking `mutex`
+    // (see `add_runtime_stats`).
+    std::atomic<std::size_t> chunk_count{0};
+    // Empty, and exchanged with `chunks` when they are taken, so that the
+    // capacity of both is reused by later chunks.  Guarded by the `Batch`'s
+    // `mutex`.
+    std::vector<BufferedChunk> spare;
+
+    // Append the specified `chunk` to `chunks`.  `mutex` must be locked.
+    void add(BufferedChunk&& chunk) {
+      class_bytes[std::size_t(chunk.chunk_class)] += chunk.bytes;
+      chunks.push_back(std::move(chunk));
+      chunk_count.store(chunks.size(), std::memory_order_relaxed);
+    }
+  };
+
+  // Serializes taking the chunks and making room for them.  Not locked to
+  // buffer a chunk unless the buffer is full.
+  std::mutex mutex;
+  std::unique_ptr<Shard[]> shards;
+  std::size_t shard_mask;
+  // The estimated encoded size of the chunks, including those being added to
+  // a shard.
+  std::atomic<std::size_t> bytes{0};
+  // Whether the chunks include chunks whose sending was deferred.
+  std::atomic<bool> deferred{false};
+  // Whether a flush was posted for the chunks and has not yet run.
+  std::atomic<bool> flush_posted{false};
+  // Whether a flush of only the `ChunkClass::PROTECTED` chunks was posted and
+  // has not yet run.
+  std::atomic<bool> priority_flush_posted{false};
+  std::atomic<std::size_t> in_flight_requests{0};
+  // Whether the chunks are sent in `TracesAPIVersion::V0_5` payloads, which
+  // determines whether they can be encoded on send.
+  std::atomic<bool> use_v05;
+  std::atomic<bool> compression_enabled;
+  // The number of chunks of each `ChunkClass` dropped because the buffer was
+  // full.
+  std::atomic<std::uint64_t> dropped_chunks[num_chunk_classes] = {};
+
+  Batch(bool use_v05, bool compression_enabled)
+      : use_v05(use_v05), compression_enabled(compression_enabled) {
+    static const std::size_t count = batch_shard_count();
+    shards = std::make_unique<Shard[]>(count);
+    shard_mask = count - 1;
+  }
+
+  // Return the index, modulo the number of shards, of the shard to which the
+  // calling thread adds chunks.  Threads are assigned indices in turn.
+  static std::size_t this_thread_shard() {
+    static std::atomic<std::size_t> next{0};
+    thread_local const std::size_t shard =
+        next.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+  }
+
+  // Return the number of chunks in the shards.
+  std::size_t chunk_count() const {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i <= shard_mask; ++i) {
+      count += shards[i].chunk_count.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  // Append the specified `chunk` to the shard of the calling thread, unless
+  // doing so would exceed the specified `max_bytes` and not enough room can
+  // be made for it (see `shed_below`).  Move the chunks removed to make room,
+  // or `chunk` itself if it was not added, into the specified `shed`.  Return
+  // whether `chunk` was added.
+  bool add(BufferedChunk&& chunk, std::size_t max_bytes,
+           std::vector<BufferedChunk>& shed) {
+    const std::size_t size = chunk.bytes;
+    Shard& shard = shards[this_thread_shard() & shard_mask];
+    if (bytes.fetch_add(size, std::memory_order_relaxed) + size <=
+        max_bytes) {
+      DD_TIMELINE_LOCK(shard.mutex, "DatadogAgent shard lock wait");
+      std::lock_guard<std::mutex> lock(shard.mutex, std::adopt_lock);
+      shard.add(std::move(chunk));
+      return true;
+    }
+    bytes.fetch_sub(size, std::memory_order_relaxed);
+
+    // The buffer is full.  Lock every shard, in order, to make room.
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(shard_mask + 1);
+    for (std::size_t i = 0; i <= shard_mask; ++i) {
+      locks.emplace_back(shards[i].mutex);
+    }
+    const std::size_t total = bytes.load(std::memory_order_relaxed) + size;
+    if (total > max_bytes &&
+        !shed_below(chunk.chunk_class, total - max_bytes, shed)) {
+      // The buffer is full of chunks that are not of a lower class.
+      shed.push_back(std::move(chunk));
+      return false;
+    }
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    shard.add(std::move(chunk));
+    return true;
+  }
+
+  // Remove every chunk and append them to the specified `taken`, shard by
+  // shard.  `mutex` must be locked.
+  void take(std::vector<BufferedChunk>& taken) {
+    std::size_t taken_bytes = 0;
+    for (std::size_t i = 0; i <= shard_mask; ++i) {
+      Shard& shard = shards[i];
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.chunks.empty()) {
+          continue;
+        }
+        using std::swap;
+        swap(shard.chunks, shard.spare);
+        std::fill(std::begin(shard.class_bytes), std::end(shard.class_bytes),
+                  0);
+        shard.chunk_count.store(0, std::memory_order_relaxed);
+      }
+      for (auto& chunk : shard.spare) {
+        taken_bytes += chunk.bytes;
+        taken.push_back(std::move(chunk));
+      }
+      shard.spare.clear();
+    }
+    bytes.fetch_sub(taken_bytes, std::memory_order_relaxed);
+  }
+
+  // Remove the chunks of the specified `chunk_class` and append them to the
+  // specified `taken`, shard by shard, keeping the other chunks in order.
+  // `mutex` must be locked.
+  void take_class(ChunkClass chunk_class, std::vector<BufferedChunk>& taken) {
+    const std::size_t index = std::size_t(chunk_class);
+    std::size_t taken_bytes = 0;
+    for (std::size_t s = 0; s <= shard_mask; ++s) {
+      Shard& shard = shards[s];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.class_bytes[index] == 0) {
+        continue;
+      }
+      auto& chunks = shard.chunks;
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < chunks.size(); ++i) {
+        auto& chunk = chunks[i];
+        if (chunk.chunk_class == chunk_class) {
+          taken_bytes += chunk.bytes;
+          taken.push_back(std::move(chunk));
+        } else {
+          if (kept != i) {
+            chunks[kept] = std::move(chunk);
+          }
+          ++kept;
+        }
+      }
+      chunks.erase(chunks.begin() + kept, chunks.end());
+      shard.class_bytes[index] = 0;
+      shard.chunk_count.store(chunks.size(), std::memory_order_relaxed);
+    }
+    bytes.fetch_sub(taken_bytes, std::memory_order_relaxed);
+  }
+
+  // Move the elements of the specified `chunks`, from the specified index
+  // `from` onward, back into the shards, as though they had not been taken,
+  // even if that exceeds the maximum size of the buffer.  `mutex` must be
+  // locked.
+  void restore(std::vector<BufferedChunk>& chunks, std::size_t from) {
+    Shard& shard = shards[0];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (; from < chunks.size(); ++from) {
+      bytes.fetch_add(chunks[from].bytes, std::memory_order_relaxed);
+      shard.add(std::move(chunks[from]));
+    }
+  }
+
+  // Make room for the specified `needed` bytes by moving chunks of a class
+  // lower than the specified `chunk_class` out of the shards and into the
+  // specified `shed`: the lowest class first and, within a class, the oldest
+  // of each shard first.  Return whether there was enough room to be made.
+  // If not, then do not remove any chunks.  `mutex` and every shard's mutex
+  // must be locked.
+  bool shed_below(ChunkClass chunk_class, std::size_t needed,
+                  std::vector<BufferedChunk>& shed) {
+    const std::size_t limit = std::size_t(chunk_class);
+    std::size_t available = 0;
+    for (std::size_t i = 0; i <= shard_mask; ++i) {
+      for (std::size_t lower = 0; lower < limit; ++lower) {
+        available += shards[i].class_bytes[lower];
+      }
+    }
+    if (available < needed) {
+      return false;
+    }
+
+    std::size_t freed = 0;
+    for (std::size_t lower = 0; freed < needed; ++lower) {
+      for (std::size_t s = 0; s <= shard_mask && freed < needed; ++s) {
+        Shard& shard = shards[s];
+        auto& chunks = shard.chunks;
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+          auto& chunk = chunks[i];
+          if (freed < needed && std::size_t(chunk.chunk_class) == lower) {
+            freed += chunk.bytes;
+            shard.class_bytes[lower] -= chunk.bytes;
+            shed.push_back(std::move(chunk));
+          } else {
+            if (kept != i) {
+              chunks[kept] = std::move(chunk);
+            }
+            ++kept;
+          }
+        }
+        chunks.erase(chunks.begin() + kept, chunks.end());
+        shard.chunk_count.store(chunks.size(), std::memory_order_relaxed);
+      }
+    }
+    bytes.fetch_sub(freed, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+// `Handoff` lets a task passed to `EventScheduler::post` flush the agent that
+// posted it, unless the agent was destroyed before the task was invoked.
+struct DatadogAgent::Handoff {
+  std::shared_mutex mutex;
+  // Guarded by `mutex`, which tasks lock in shared mode while they flush, so
+  // that the agent is not destroyed during a flush.
+  DatadogAgent* agent;
+
+  explicit Handoff(DatadogAgent* agent) : agent(agent) {}
+};
+
+struct DatadogAgent::AgentInfo {
+  std::atomic<bool> remote_configuration{true};
+  std::atomic<bool> stats{true};
+};
+
+std::shared_ptr<DatadogAgent::Batch> DatadogAgent::shared_batch(
+    const std::string& key, bool use_v05, bool compression_enabled) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<Batch>> batches;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto iter = batches.begin(); iter != batches.end();) {
+    if (iter->second.expired()) {
+      iter = batches.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  auto& batch = batches[key];
+  if (auto existing = batch.lock()) {
+    return existing;
+  }
+  auto created = std::make_shared<Batch>(use_v05, compression_enabled);
+  batch = created;
+  return created;
+}
+
 DatadogAgent::DatadogAgent(
     const FinalizedDatadogAgentConfig& config,
     const std::shared_ptr<Logger>& logger,
     const TracerSignature& tracer_signature,
-    const std::vector<std::shared_ptr<rc::Listener>>& rc_listeners)
+    const std::vector<std::shared_ptr<rc::Listener>>& rc_listeners,
+    std::shared_ptr<MemoryBudget> memory_budget)
     : clock_(config.clock),
       logger_(logger),
-      traces_endpoint_(traces_endpoint(config.url)),
+      // Chunks are written to a shared trace buffer already encoded.
+      encode_on_send_(config.encode_on_send ||
+                      config.shared_trace_buffer != nullptr),
+      encoded_bytes_per_span_(initial_encoded_bytes_per_span),
+      flush_threshold_bytes_(config.flush_threshold_bytes),
+      max_buffered_bytes_(config.max_buffered_bytes),
+      max_payload_bytes_(config.max_payload_bytes),
+      compression_enabled_(
+          std::make_shared<std::atomic<bool>>(config.compression_enabled)),
+      compression_level_(config.compression_level),
+      compression_min_bytes_(config.compression_min_bytes),
+      max_in_flight_requests_(config.max_in_flight_requests),
+      priority_flushes_per_second_(config.priority_flushes_per_second),
+      priority_flush_limiter_(
+          config.priority_flushes_per_second > 0
+              ? std::make_unique<Limiter>(config.clock,
+                                          config.priority_flushes_per_second)
+              : nullptr),
+      memory_budget_(std::move(memory_budget)),
+      encoding_pool_(config.encoding_threads
+                         ? std::make_unique<WorkerPool>(
+                               config.encoding_threads,
+                               make_thread_generator(config.background_threads,
+                                                     "encode", logger))
+                         : nullptr),
+      parallel_encoding_min_spans_(config.parallel_encoding_min_spans),
+      retries_(std::make_shared<Retries>(
+          config.max_retries, config.retry_budget_bytes, config.spill_file,
+          config.clock)),
+      response_cache_(std::make_shared<ResponseCache>()),
+      delivery_latencies_(std::make_shared<DeliveryLatencies>()),
+      shared_trace_buffer_(config.shared_trace_buffer),
+      traces_endpoint_(traces_endpoint(config.url, traces_api_path)),
+      traces_v05_endpoint_(traces_endpoint(config.url, traces_v05_api_path)),
+      use_v05_(std::make_shared<std::atomic<bool>>(
+          config.traces_api_version == TracesAPIVersion::V0_5)),
       remote_configuration_endpoint_(remote_configuration_endpoint(config.url)),
+      stats_concentrator_(config.stats_computation_enabled
+                              ? std::make_unique<StatsConcentrator>(
+                                    tracer_signature)
+                              : nullptr),
+      stats_endpoint_(traces_endpoint(config.url, stats_api_path)),
+      client_computed_stats_(config.client_computed_stats),
+      dropped_p0_traces_(0),
+      dropped_p0_spans_(0),
       http_client_(config.http_client),
       event_scheduler_(config.event_scheduler),
+      handoff_(std::make_shared<Handoff>(this)),
       flush_interval_(config.flush_interval),
+      flush_interval_min_(config.flush_interval_min),
+      flush_interval_max_(config.flush_interval_max),
+      nominal_flush_periods_(
+          max_skipped_polls(config.flush_interval_min, config.flush_interval) +
+          1),
+      max_flush_periods_(max_skipped_polls(config.flush_interval_min,
+                                           config.flush_interval_max) +
+                         1),
+      flush_periods_(nominal_flush_periods_),
+      flush_periods_to_skip_(0),
       request_timeout_(config.request_timeout),
       shutdown_timeout_(config.shutdown_timeout),
-      remote_config_(tracer_signature, rc_listeners, logger) {
+      remote_config_(tracer_signature, rc_listeners, logger),
+      remote_configuration_polls_to_skip_(0),
+      remote_configuration_max_skipped_polls_(max_skipped_polls(
+          config.remote_configuration_poll_interval,
+          config.remote_configuration_max_poll_interval)),
+      remote_configuration_idle_responses_(0),
+      agent_info_(std::make_shared<AgentInfo>()),
+      info_endpoint_(traces_endpoint(config.url, info_api_path)) {
   assert(logger_);
 
   // Set HTTP headers
@@ -167,14 +1197,14 @@ DatadogAgent::DatadogAgent(
                    tracer_signature.library_language_version);
   headers_.emplace("Datadog-Meta-Tracer-Version",
                    tracer_signature.library_version);
-  if (config.stats_computation_enabled) {
-    headers_.emplace("Datadog-Client-Computed-Stats", "yes");
+  if (config.client_obfuscation) {
+    headers_.emplace("Datadog-Obfuscation-Version", "1");
   }
 
   // Origin Detection headers are not necessary when Unix Domain Socket (UDS)
   // is used to communicate with the Datadog Agent.
   if (!contains(config.url.scheme, "unix")) {
-    if (auto container_id = container::get_id()) {
+    if (const auto& container_id = process_info().container_id) {
       if (container_id->type == container::ContainerID::Type::container_id) {
         headers_.emplace("Datadog-Container-ID", container_id->value);
         headers_.emplace("Datadog-Entity-Id", "ci-" + container_id->value);
@@ -190,46 +1220,440 @@ DatadogAgent::DatadogAgent(
     }
   }
 
-  tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
-      config.flush_interval, [this]() { flush(); }));
+  if (config.batch_across_tracers && !shared_trace_buffer_) {
+    // Instances that would send identical requests share their batch.  A
+    // forked process must not share its parent's, whose mutex might be
+    // locked forever.
+    std::string key = std::to_string(get_process_id());
+    key += ' ';
+    key += std::to_string(reinterpret_cast<std::uintptr_t>(http_client_.get()));
+    key += ' ';
+    key += this->config();
+    key += client_computed_stats_ ? " computed stats" : "";
+    for (const auto& [name, value] :
+         std::map<std::string, std::string>(headers_.begin(), headers_.end())) {
+      key += '\n';
+      key += name;
+      key += ": ";
+      key += value;
+    }
+    batch_ = shared_batch(key, use_v05_->load(), compression_enabled_->load());
+  } else {
+    batch_ = std::make_shared<Batch>(use_v05_->load(),
+                                     compression_enabled_->load());
+  }
+  in_flight_requests_ = std::shared_ptr<std::atomic<std::size_t>>(
+      batch_, &batch_->in_flight_requests);
+  use_v05_ = std::shared_ptr<std::atomic<bool>>(batch_, &batch_->use_v05);
+  compression_enabled_ = std::shared_ptr<std::atomic<bool>>(
+      batch_, &batch_->compression_enabled);
+
+  // Without jitter, the first flush is one flush interval after startup.
+  auto first_delay = flush_interval_min_;
+  flush_periods_to_skip_ = nominal_flush_periods_ - 1;
+  if (config.flush_jitter_enabled) {
+    // A phase chosen uniformly within the flush interval, as a part of a
+    // timer period and a number of whole periods.
+    const auto period = std::uint64_t(flush_interval_min_.count());
+    const auto phase = random_uint64() % (period * nominal_flush_periods_);
+    first_delay = std::chrono::steady_clock::duration(phase % period);
+    flush_periods_to_skip_ = std::uint32_t(phase / period);
+  }
+  tasks_.emplace_back(event_scheduler_->schedule_recurring_event_after(
+      first_delay, flush_interval_min_, [this]() { on_flush_timer(); }));
 
   if (config.remote_configuration_enabled) {
     tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
         config.remote_configuration_poll_interval,
-        [this] { get_and_apply_remote_configuration_updates(); }));
+        [this] { poll_remote_configuration(); }));
   }
-}
-
-DatadogAgent::~DatadogAgent() {
-  const auto deadline = clock_().tick + shutdown_timeout_;
 
-  for (auto&& cancel_task : tasks_) {
-    cancel_task();
+  if (config.agent_info_refresh_interval >
+      std::chrono::steady_clock::duration::zero()) {
+    tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
+        config.agent_info_refresh_interval, [this] { query_agent_info(); }));
+    // The first query is at startup, rather than after an interval.
+    event_scheduler_->post([handoff = handoff_]() {
+      std::shared_lock<std::shared_mutex> lock(handoff->mutex);
+      if (handoff->agent) {
+        handoff->agent->query_agent_info();
+      }
+    });
   }
+}
 
-  flush();
+DatadogAgent::~DatadogAgent() {
+  shut_down(clock_().tick + shutdown_timeout_);
+  // The payloads that are still waiting to be sent again are sent by the next
+  // process that opens the spill file, if there is one.
+  retries_->spill_all();
+}
 
-  http_client_->drain(deadline);
+void DatadogAgent::shut_down(std::chrono::steady_clock::time_point deadline) {
+  shut_down_collector(
+      shut_down_once_, tasks_,
+      [this](std::chrono::steady_clock::time_point deadline) {
+        {
+          // Wait for a posted flush that is in progress, and prevent those
+          // not yet invoked from flushing.  The final flush happens here
+          // instead, since the event scheduler might not invoke them.
+          std::lock_guard<std::shared_mutex> lock(handoff_->mutex);
+          handoff_->agent = nullptr;
+        }
+        flush(true, deadline);
+        if (shared_trace_buffer_) {
+          // Let another process send the chunks written from now on.
+          shared_trace_buffer_->resign_drainer();
+        }
+      },
+      *http_client_, deadline);
 }
 
 Expected<void> DatadogAgent::send(
     std::vector<std::unique_ptr<SpanData>>&& spans,
     const std::shared_ptr<TraceSampler>& response_handler) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  trace_chunks_.push_back(TraceChunk{std::move(spans), response_handler});
+  TraceChunk chunk;
+  chunk.spans = std::move(spans);
+  return send_chunk(std::move(chunk), response_handler);
+}
+
+Expected<void> DatadogAgent::send_chunk(
+    TraceChunk&& chunk, const std::shared_ptr<TraceSampler>& response_handler) {
+  auto& spans = chunk.spans;
+  if (stats_concentrator_ &&
+      agent_info_->stats.load(std::memory_order_relaxed)) {
+    stats_concentrator_->add(spans);
+    // The Datadog Agent needs the traces that were dropped only to compute
+    // their stats, so send only their spans that were kept by span sampling.
+    // Spans encoded by the chunk's producer are sent as they are.
+    if (!is_trace_kept(chunk) && chunk.encoded.empty()) {
+      const std::size_t span_count = spans.size();
+      keep_span_sampled_spans(spans);
+      dropped_p0_spans_.fetch_add(span_count - spans.size(),
+                                  std::memory_order_relaxed);
+      if (spans.empty()) {
+        dropped_p0_traces_.fetch_add(1, std::memory_order_relaxed);
+        return nullopt;
+      }
+    }
+  }
+  const ChunkClass chunk_class = class_of(chunk);
+
+  // Spans whose call stacks are yet to be symbolized are encoded when they
+  // are flushed, since symbolizing is too expensive for the sending thread.
+  if (!shared_trace_buffer_ &&
+      (!encode_on_send_ || using_v05() || has_captured_stack(spans))) {
+    BufferedChunk buffered{std::move(spans), response_handler, {}, chunk_class};
+    buffered.finished = chunk.finished;
+    enqueue(std::move(buffered));
+    return nullopt;
+  }
+
+  std::string encoded;
+  if (!chunk.encoded.empty()) {
+    // The chunk's producer already encoded it.
+    encoded = std::move(chunk.encoded);
+  } else {
+    encoded = acquire_buffer();
+
+    auto beg = std::chrono::steady_clock::now();
+    auto encode_result = msgpack_encode(encoded, spans);
+    auto end = std::chrono::steady_clock::now();
+
+    telemetry::distribution::add(
+        metrics::tracer::trace_chunk_serialization_duration,
+        std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+            .count());
+    OverheadGovernor::add_cost(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+
+    if (auto* error = encode_result.if_error()) {
+      return std::move(*error);
+    }
+  }
+
+  // The spans are no longer needed, so recycle them now rather than release
+  // them at the next flush.
+  recycle_spans(spans);
+
+  if (shared_trace_buffer_) {
+    const bool pushed = shared_trace_buffer_->push(encoded);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shared_response_handler_ = response_handler;
+      release_buffer(std::move(encoded));
+    }
+    if (!pushed) {
+      count_dropped(chunk_class, 1, "reason:overfull_buffer");
+    }
+    return nullopt;
+  }
+
+  BufferedChunk buffered{{}, response_handler, std::move(encoded), chunk_class};
+  buffered.finished = chunk.finished;
+  enqueue(std::move(buffered));
   return nullopt;
 }
 
+void DatadogAgent::count_dropped(ChunkClass chunk_class, std::size_t dropped,
+                                 const char* reason) {
+  batch_->dropped_chunks[std::size_t(chunk_class)].fetch_add(
+      dropped, std::memory_order_relaxed);
+  telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                {reason, class_tag(chunk_class)});
+}
+
+void DatadogAgent::enqueue(BufferedChunk&& chunk) {
+  chunk.bytes = chunk.encoded.size();
+  for (const auto& span : chunk.spans) {
+    chunk.bytes += estimated_encoded_size(*span);
+  }
+  chunk.charge = MemoryBudget::Charge(memory_budget_, chunk.bytes);
+  chunk.enqueued = clock_().tick;
+  DD_USDT_PROBE(chunk__enqueued, chunk.bytes, int(chunk.chunk_class));
+
+  const ChunkClass chunk_class = chunk.chunk_class;
+  // The chunks dropped, which are destroyed only after releasing the locks.
+  std::vector<BufferedChunk> trace_chunks;
+  const bool dropped =
+      !batch_->add(std::move(chunk), max_buffered_bytes_, trace_chunks);
+  bool deferred = false;
+  bool posting = false;
+  if (!dropped) {
+    if (chunk_class == ChunkClass::PROTECTED && priority_flush_limiter_ &&
+        !batch_->priority_flush_posted.load(std::memory_order_relaxed) &&
+        !at_max_in_flight_requests() &&
+        priority_flush_limiter_->allow().allowed &&
+        !batch_->priority_flush_posted.exchange(true)) {
+      // Send the chunk, and any others like it, without waiting for the
+      // flush interval.
+      post_priority_flush();
+    }
+    if (batch_->bytes.load(std::memory_order_relaxed) <
+        flush_threshold_bytes_) {
+      return;
+    }
+    if (at_max_in_flight_requests()) {
+      // Keep buffering.  Count the deferral only once, rather than once for
+      // every chunk buffered after the threshold was reached.
+      deferred = !batch_->deferred.exchange(true);
+    } else {
+      posting = !batch_->flush_posted.exchange(true);
+    }
+  }
+
+  for (const auto& shed : trace_chunks) {
+    count_dropped(shed.chunk_class, 1, "reason:overfull_buffer");
+  }
+  if (dropped) {
+    return;
+  }
+  if (deferred) {
+    telemetry::counter::increment(metrics::tracer::api::deferred);
+  }
+  if (!posting) {
+    return;
+  }
+
+  // Enough chunks are buffered to send them now, rather than wait for the
+  // next flush interval.  The chunks stay in the buffer until the posted
+  // flush takes them, so that they are not lost if this agent is destroyed
+  // first.
+  post_flush();
+}
+
+void DatadogAgent::post_flush() {
+  event_scheduler_->post([handoff = handoff_]() {
+    std::shared_lock<std::shared_mutex> lock(handoff->mutex);
+    if (handoff->agent) {
+      handoff->agent->flush(false);
+    }
+  });
+}
+
+void DatadogAgent::post_priority_flush() {
+  event_scheduler_->post([handoff = handoff_]() {
+    std::shared_lock<std::shared_mutex> lock(handoff->mutex);
+    if (handoff->agent) {
+      handoff->agent->flush_priority();
+    }
+  });
+}
+
+void DatadogAgent::flush_priority() {
+  std::vector<BufferedChunk> trace_chunks;
+  {
+    std::lock_guard<std::mutex> lock(batch_->mutex);
+    batch_->priority_flush_posted = false;
+    if (at_max_in_flight_requests()) {
+      // The chunks will be sent by the next flush.
+      return;
+    }
+    batch_->take_class(ChunkClass::PROTECTED, trace_chunks);
+  }
+  if (!trace_chunks.empty()) {
+    send_trace_chunks_split(std::move(trace_chunks), false);
+  }
+}
+
+void DatadogAgent::on_flush_timer() {
+  if (flush_periods_to_skip_ != 0) {
+    --flush_periods_to_skip_;
+    return;
+  }
+
+  const std::size_t bytes = batch_->bytes.load(std::memory_order_relaxed);
+  if (bytes == 0) {
+    flush_periods_ = flush_periods_ > max_flush_periods_ / 2
+                         ? max_flush_periods_
+                         : flush_periods_ * 2;
+  } else if (bytes >= flush_threshold_bytes_ / 4) {
+    // Chunks are buffered quickly, so send smaller batches more often.
+    flush_periods_ = std::max<std::uint32_t>(
+        1, std::min(flush_periods_, nominal_flush_periods_) / 2);
+  } else {
+    flush_periods_ = nominal_flush_periods_;
+  }
+  flush_periods_to_skip_ = flush_periods_ - 1;
+
+  post_flush();
+}
+
+bool DatadogAgent::at_max_in_flight_requests() const {
+  return max_in_flight_requests_ != 0 &&
+         in_flight_requests_->load() >= max_in_flight_requests_;
+}
+
+bool DatadogAgent::using_v05() const { return use_v05_->load(); }
+
+std::string DatadogAgent::acquire_buffer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (buffer_pool_.empty()) {
+    return std::string();
+  }
+  std::string buffer = std::move(buffer_pool_.back());
+  buffer_pool_.pop_back();
+  return buffer;
+}
+
+void DatadogAgent::release_buffer(std::string&& buffer) {
+  if (buffer_pool_.size() < max_pooled_buffers &&
+      buffer.capacity() <= max_pooled_buffer_capacity) {
+    buffer.clear();
+    buffer_pool_.push_back(std::move(buffer));
+  }
+}
+
+void DatadogAgent::take_shared_trace_chunks() {
+  if (!shared_trace_buffer_->try_become_drainer()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string record;
+  if (!buffer_pool_.empty()) {
+    record = std::move(buffer_pool_.back());
+    buffer_pool_.pop_back();
+  }
+  // The batch is not shared when there is a shared trace buffer, and so only
+  // this thread adds chunks to the shard.
+  auto& shard =
+      batch_->shards[Batch::this_thread_shard() & batch_->shard_mask];
+  std::lock_guard<std::mutex> shard_lock(shard.mutex);
+  while (batch_->bytes.load(std::memory_order_relaxed) <
+             max_buffered_bytes_ &&
+         shared_trace_buffer_->pop(record)) {
+    const std::size_t bytes = record.size();
+    batch_->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    shard.add(BufferedChunk{{},
+                            shared_response_handler_,
+                            std::move(record),
+                            ChunkClass::KEPT,
+                            bytes});
+    record.clear();
+  }
+}
+
+void DatadogAgent::reclaim_sent_buffers() {
+  auto reclaimed = std::remove_if(
+      sent_buffers_.begin(), sent_buffers_.end(), [&](auto& buffer) {
+        if (buffer.use_count() != 1) {
+          // The HTTP client is still sending it.
+          return false;
+        }
+        // Order the HTTP client's last use of the buffer before its reuse.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (buffer_pool_.size() < max_pooled_buffers) {
+          buffer->clear();
+          buffer_pool_.push_back(std::move(*buffer));
+        }
+        return true;
+      });
+  sent_buffers_.erase(reclaimed, sent_buffers_.end());
+}
+
+void DatadogAgent::warm_up(std::size_t expected_spans_per_trace,
+                           std::size_t expected_concurrency) {
+  const std::size_t capacity = std::min(
+      max_pooled_buffer_capacity,
+      expected_spans_per_trace *
+          encoded_bytes_per_span_.load(std::memory_order_relaxed));
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (buffer_pool_.size() < std::min(expected_concurrency,
+                                        max_pooled_buffers)) {
+    std::string buffer;
+    buffer.reserve(capacity);
+    buffer_pool_.push_back(std::move(buffer));
+  }
+}
+
+void DatadogAgent::add_runtime_stats(RuntimeStats& stats) const {
+  stats.buffered_trace_chunks += batch_->chunk_count();
+  stats.buffered_bytes += batch_->bytes.load(std::memory_order_relaxed);
+  stats.in_flight_requests += in_flight_requests_->load();
+  const auto dropped = [&](ChunkClass chunk_class) {
+    return batch_->dropped_chunks[std::size_t(chunk_class)].load(
+        std::memory_order_relaxed);
+  };
+  stats.dropped_sampled_out_trace_chunks += dropped(ChunkClass::SAMPLED_OUT);
+  stats.dropped_kept_trace_chunks += dropped(ChunkClass::KEPT);
+  stats.dropped_protected_trace_chunks += dropped(ChunkClass::PROTECTED);
+  stats.dropped_trace_chunks += dropped(ChunkClass::SAMPLED_OUT) +
+                                dropped(ChunkClass::KEPT) +
+                                dropped(ChunkClass::PROTECTED);
+  delivery_latencies_->add_runtime_stats(stats);
+}
+
 std::string DatadogAgent::config() const {
   // clang-format off
   return nlohmann::json::object({
     {"type", "datadog::tracing::DatadogAgent"},
     {"config", nlohmann::json::object({
-      {"traces_url", (traces_endpoint_.scheme + "://" + traces_endpoint_.authority + traces_endpoint_.path)},
-      {"remote_configuration_url", (remote_configuration_endpoint_.scheme + "://" + remote_configuration_endpoint_.authority + remote_configuration_endpoint_.path)},
+      {"traces_url", to_url_string(using_v05() ? traces_v05_endpoint_ : traces_endpoint_)},
+      {"traces_api_version", using_v05() ? "v0.5" : "v0.4"},
+      {"remote_configuration_url", to_url_string(remote_configuration_endpoint_)},
       {"flush_interval_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_).count() },
+      {"flush_interval_min_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_min_).count() },
+      {"flush_interval_max_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_max_).count() },
       {"request_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(request_timeout_).count() },
       {"shutdown_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(shutdown_timeout_).count() },
+      {"encode_on_send", encode_on_send_},
+      {"flush_threshold_bytes", flush_threshold_bytes_},
+      {"max_buffered_bytes", max_buffered_bytes_},
+      {"max_payload_bytes", max_payload_bytes_},
+      {"compression_enabled", compression_enabled_->load()},
+      {"compression_level", compression_level_},
+      {"compression_min_bytes", compression_min_bytes_},
+      {"max_in_flight_requests", max_in_flight_requests_},
+      {"priority_flushes_per_second", priority_flushes_per_second_},
+      {"encoding_threads", encoding_pool_ ? encoding_pool_->size() : 0},
+      {"parallel_encoding_min_spans", parallel_encoding_min_spans_},
+      {"max_retries", retries_->max_retries},
+      {"retry_budget_bytes", retries_->budget_bytes},
+      {"spill_file_capacity", retries_->spill_file ? retries_->spill_file->capacity() : 0},
+      {"shared_trace_buffer_capacity", shared_trace_buffer_ ? shared_trace_buffer_->capacity() : 0},
+      {"stats_computation_enabled", stats_concentrator_ != nullptr},
+      {"client_obfuscation", headers_.count("Datadog-Obfuscation-Version") != 0},
       {"http_client", nlohmann::json::parse(http_client_->config())},
       {"event_scheduler", nlohmann::json::parse(event_scheduler_->config())},
     })},
@@ -237,14 +1661,176 @@ std::string DatadogAgent::config() const {
   // clang-format on
 }
 
-void DatadogAgent::flush() {
-  std::vector<TraceChunk> trace_chunks;
+void DatadogAgent::flush(
+    bool force, Optional<std::chrono::steady_clock::time_point> deadline) {
+  DD_TIMELINE_SCOPE("DatadogAgent flush");
+  if (stats_concentrator_ &&
+      agent_info_->stats.load(std::memory_order_relaxed)) {
+    send_stats(force);
+  }
+  if (shared_trace_buffer_) {
+    take_shared_trace_chunks();
+  }
+
+  // Payloads that failed to be sent count against the limit on in-flight
+  // requests too.  When shutting down, send them regardless of their backoff.
+  if (force || !at_max_in_flight_requests()) {
+    for (auto& payload : retries_->take_due(force)) {
+      send_payload(std::move(payload));
+    }
+    // Spilled payloads are left in the spill file for the next process when
+    // shutting down, rather than delaying shutdown.
+    if (!force && retries_->spill_file) {
+      send_spilled_payloads();
+    }
+  }
+
+  std::vector<BufferedChunk> trace_chunks;
+  bool merged = false;
   {
-    std::lock_guard<std::mutex> lock(mutex_);
-    using std::swap;
-    swap(trace_chunks, trace_chunks_);
+    DD_TIMELINE_LOCK(batch_->mutex, "DatadogAgent batch lock wait");
+    std::lock_guard<std::mutex> lock(batch_->mutex, std::adopt_lock);
+    // Any flush, even one that defers the chunks, lets reaching the flush
+    // threshold post another.
+    batch_->flush_posted = false;
+    if (batch_->bytes.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    if (!force && at_max_in_flight_requests()) {
+      batch_->deferred = true;
+    } else {
+      batch_->take(trace_chunks);
+      if (trace_chunks.empty()) {
+        // The chunks counted in `bytes` are still being added to shards, and
+        // will be sent by a later flush.
+        return;
+      }
+      merged = batch_->deferred.exchange(false);
+    }
   }
 
+  if (trace_chunks.empty()) {
+    // The chunks will be sent along with those of a later flush.
+    telemetry::counter::increment(metrics::tracer::api::deferred);
+    return;
+  }
+  if (merged) {
+    telemetry::counter::increment(metrics::tracer::api::merged);
+  }
+
+  if (deadline) {
+    send_trace_chunks_by(std::move(trace_chunks), *deadline);
+  } else {
+    send_trace_chunks_split(std::move(trace_chunks), force);
+  }
+}
+
+void DatadogAgent::send_trace_chunks_by(
+    std::vector<BufferedChunk>&& trace_chunks,
+    std::chrono::steady_clock::time_point deadline) {
+  // Choose the chunks to send first by their class and then by how recent
+  // they are, but keep the chunks within a payload in the order in which they
+  // were buffered.
+  std::vector<std::size_t> order(trace_chunks.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = order.size() - 1 - i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t left, std::size_t right) {
+                     return trace_chunks[left].chunk_class >
+                            trace_chunks[right].chunk_class;
+                   });
+
+  const auto size_of = [&](std::size_t index) {
+    return trace_chunks[index].bytes;
+  };
+
+  const std::size_t max_bytes =
+      std::min(flush_threshold_bytes_, max_payload_bytes_);
+  std::size_t next = 0;
+  std::vector<std::size_t> selected;
+  while (next < order.size() && clock_().tick < deadline) {
+    selected.clear();
+    std::size_t bytes = 0;
+    do {
+      bytes += size_of(order[next]);
+      selected.push_back(order[next++]);
+    } while (next < order.size() &&
+             bytes + size_of(order[next]) <= max_bytes);
+    std::sort(selected.begin(), selected.end());
+
+    std::vector<BufferedChunk> payload;
+    payload.reserve(selected.size());
+    for (const std::size_t index : selected) {
+      payload.push_back(std::move(trace_chunks[index]));
+    }
+    send_trace_chunks(std::move(payload));
+  }
+
+  if (next == order.size()) {
+    return;
+  }
+  const std::size_t dropped_chunks = order.size() - next;
+  std::size_t dropped_spans = 0;
+  for (; next < order.size(); ++next) {
+    const auto& chunk = trace_chunks[order[next]];
+    dropped_spans += chunk.spans.size();
+    count_dropped(chunk.chunk_class, 1, "reason:shutdown_deadline");
+  }
+  logger_->log_error([&](std::ostream& log) {
+    log << "DatadogAgent: " << dropped_chunks
+        << " trace chunks were dropped, because the shutdown timeout was "
+           "reached before they could be sent.";
+    if (dropped_spans) {
+      log << "  " << dropped_spans << " of their spans were not yet encoded.";
+    }
+  });
+}
+
+void DatadogAgent::send_trace_chunks_split(
+    std::vector<BufferedChunk>&& trace_chunks, bool force) {
+  std::size_t total_bytes = 0;
+  for (const auto& chunk : trace_chunks) {
+    total_bytes += chunk.bytes;
+  }
+  if (total_bytes <= max_payload_bytes_) {
+    send_trace_chunks(std::move(trace_chunks));
+    return;
+  }
+
+  // Each payload is posted before the next is encoded, so the payloads are in
+  // flight concurrently.  The first is sent regardless of the limit on
+  // in-flight requests, as the whole flush would have been.
+  std::size_t next = 0;
+  std::size_t payload_count = 0;
+  while (next < trace_chunks.size()) {
+    if (payload_count != 0 && !force && at_max_in_flight_requests()) {
+      break;
+    }
+    std::vector<BufferedChunk> payload;
+    std::size_t bytes = 0;
+    do {
+      bytes += trace_chunks[next].bytes;
+      payload.push_back(std::move(trace_chunks[next++]));
+    } while (next < trace_chunks.size() &&
+             bytes + trace_chunks[next].bytes <= max_payload_bytes_);
+    send_trace_chunks(std::move(payload));
+    ++payload_count;
+  }
+
+  if (next == trace_chunks.size()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(batch_->mutex);
+    batch_->restore(trace_chunks, next);
+    batch_->deferred = true;
+  }
+  telemetry::counter::increment(metrics::tracer::api::deferred);
+}
+
+void DatadogAgent::send_trace_chunks(
+    std::vector<BufferedChunk>&& trace_chunks) {
   if (trace_chunks.empty()) {
     return;
   }
@@ -255,46 +1841,227 @@ void DatadogAgent::flush() {
   /*  msgpack_encode(body, trace_chunks);*/
   /*});*/
 
+  // Read the flag after taking the chunks, so that any chunk that was encoded
+  // on send is known to be part of a v0.4 payload.
+  const bool v05 = using_v05();
+
+  std::size_t pre_encoded_size = 0;
+  std::size_t span_count = 0;
+  for (const auto& chunk : trace_chunks) {
+    pre_encoded_size += chunk.encoded.size();
+    span_count += chunk.spans.size();
+  }
+  DD_USDT_PROBE(flush__begin, trace_chunks.size(), span_count);
+  DD_TIMELINE_SCOPE("DatadogAgent encode and send payload");
+
   std::string body;
+  // The parts of the body, if it was encoded in parallel or in pages.
+  std::vector<std::string> parts;
+  HTTPClient::BodySegments segments;
+  std::size_t body_size = 0;
+  bool compress = false;
+  const bool compression_enabled = compression_enabled_->load();
+  if (!v05 && span_count == 0 && encode_on_send_ &&
+      !(compression_enabled && pre_encoded_size >= compression_min_bytes_)) {
+    // Every chunk was encoded on send and the payload is not compressed, so
+    // send the chunks' buffers as they are, after the array header that
+    // precedes them, rather than copy them into one body.
+    auto header = std::make_shared<std::string>();
+    auto header_result = msgpack::pack_array(*header, trace_chunks.size());
+    if (auto* error = header_result.if_error()) {
+      logger_->log_error(*error);
+      return;
+    }
+    body_size = header->size() + pre_encoded_size;
+    segments.reserve(trace_chunks.size() + 1);
+    segments.push_back(std::move(header));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    reclaim_sent_buffers();
+    for (auto& chunk : trace_chunks) {
+      auto buffer = std::make_shared<std::string>(std::move(chunk.encoded));
+      if (sent_buffers_.size() < max_pooled_buffers &&
+          buffer->capacity() <= max_pooled_buffer_capacity) {
+        sent_buffers_.push_back(buffer);
+      }
+      segments.push_back(std::move(buffer));
+    }
+  } else {
+    // Reserve enough room for the body up front, so that encoding it does not
+    // repeatedly reallocate and copy it.  The size of chunks that were
+    // encoded on send is known.  The size of the others is estimated from the
+    // previous payload, with some headroom.
+    const std::size_t bytes_per_span =
+        encoded_bytes_per_span_.load(std::memory_order_relaxed);
+    const std::size_t estimated_span_size = span_count * bytes_per_span;
+
+    auto beg = std::chrono::steady_clock::now();
+    Expected<void> encode_result;
+    if (!v05 && encoding_pool_ && span_count >= parallel_encoding_min_spans_) {
+      encode_result = msgpack_encode_parallel(
+          parts, trace_chunks, span_count, bytes_per_span, *encoding_pool_);
+      for (const auto& part : parts) {
+        body_size += part.size();
+      }
+    } else if (!v05 && !compression_enabled) {
+      // The body is sent as it is encoded, so it need not be contiguous.
+      // The extra bytes are for the array header that precedes the chunks.
+      encode_result = msgpack_encode_paged(
+          parts, trace_chunks, 5 + pre_encoded_size + estimated_span_size);
+      for (const auto& part : parts) {
+        body_size += part.size();
+      }
+    } else {
+      // The extra bytes are for the array header that precedes the chunks.
+      body.reserve(5 + pre_encoded_size + estimated_span_size +
+                   estimated_span_size / 8);
+      encode_result = v05 ? msgpack_encode_v05(body, trace_chunks)
+                          : msgpack_encode(body, trace_chunks);
+      body_size = body.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (span_count != 0 && body_size > pre_encoded_size) {
+      encoded_bytes_per_span_.store((body_size - pre_encoded_size) / span_count,
+                                    std::memory_order_relaxed);
+    }
 
-  auto beg = std::chrono::steady_clock::now();
-  auto encode_result = msgpack_encode(body, trace_chunks);
-  auto end = std::chrono::steady_clock::now();
+    // When chunks are encoded on send, their serialization duration is
+    // recorded there, and here they are only concatenated.
+    if (!encode_on_send_) {
+      telemetry::distribution::add(
+          metrics::tracer::trace_chunk_serialization_duration,
+          std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+              .count());
+      OverheadGovernor::add_cost(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+    }
 
-  telemetry::distribution::add(
-      metrics::tracer::trace_chunk_serialization_duration,
-      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+    if (encode_on_send_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& chunk : trace_chunks) {
+        if (buffer_pool_.size() == max_pooled_buffers) {
+          break;
+        }
+        if (chunk.encoded.capacity() <= max_pooled_buffer_capacity) {
+          chunk.encoded.clear();
+          buffer_pool_.push_back(std::move(chunk.encoded));
+        }
+      }
+    }
+
+    // The spans are encoded, so they can be reused by later traces.
+    for (auto& chunk : trace_chunks) {
+      recycle_spans(chunk.spans);
+    }
+
+    if (auto* error = encode_result.if_error()) {
+      logger_->log_error(*error);
+      return;
+    }
+
+    compress = compression_enabled && body_size >= compression_min_bytes_;
+    if (compress && !parts.empty()) {
+      // Compression needs the whole body at once.
+      body.reserve(body_size);
+      for (const auto& part : parts) {
+        body += part;
+      }
+      parts.clear();
+    }
+    for (auto& part : parts) {
+      segments.push_back(std::make_shared<const std::string>(std::move(part)));
+    }
+  }
   telemetry::distribution::add(metrics::tracer::trace_chunk_serialized_bytes,
-                               static_cast<uint64_t>(body.size()));
+                               static_cast<uint64_t>(body_size));
 
-  if (auto* error = encode_result.if_error()) {
-    logger_->log_error(*error);
-    return;
+  if (compress) {
+    std::string compressed;
+    auto compress_result = gzip_compress(compressed, body, compression_level_);
+    if (auto* error = compress_result.if_error()) {
+      logger_->log_error(*error);
+      return;
+    }
+    telemetry::distribution::add(metrics::tracer::trace_chunk_compressed_bytes,
+                                 static_cast<uint64_t>(compressed.size()));
+    body = std::move(compressed);
+    body_size = body.size();
   }
 
+  if (segments.empty()) {
+    segments.push_back(std::make_shared<const std::string>(std::move(body)));
+  }
+
+  auto payload = std::make_shared<Payload>();
+  payload->encoded = clock_().tick;
+  delivery_latencies_->add_encoded(trace_chunks, *payload);
+  payload->body = std::move(segments);
+  payload->size = body_size;
+  payload->charge = MemoryBudget::Charge(memory_budget_, body_size);
+  payload->trace_count = trace_chunks.size();
+  payload->v05 = v05;
+  payload->compressed = compress;
+  payload->computed_stats =
+      client_computed_stats_ &&
+      (!stats_concentrator_ ||
+       agent_info_->stats.load(std::memory_order_relaxed));
+  if (stats_concentrator_) {
+    payload->dropped_p0_traces = dropped_p0_traces_.exchange(0);
+    payload->dropped_p0_spans = dropped_p0_spans_.exchange(0);
+  }
   // One HTTP request to the Agent could possibly involve trace chunks from
   // multiple tracers, and thus multiple trace samplers might need to have
   // their rates updated. Unlikely, but possible.
-  std::unordered_set<std::shared_ptr<TraceSampler>> response_handlers;
   for (auto& chunk : trace_chunks) {
-    response_handlers.insert(std::move(chunk.response_handler));
+    payload->samplers.insert(std::move(chunk.response_handler));
   }
+  DD_USDT_PROBE(flush__end, trace_chunks.size(), body_size);
+
+  send_payload(std::move(payload));
+}
+
+void DatadogAgent::send_payload(std::shared_ptr<Payload> payload) {
+  ++payload->attempts;
 
   // This is the callback for setting request headers.
   // It's invoked synchronously (before `post` returns).
   auto set_request_headers = [&](DictWriter& writer) {
-    writer.set("X-Datadog-Trace-Count", std::to_string(trace_chunks.size()));
+    writer.set("X-Datadog-Trace-Count", std::to_string(payload->trace_count));
+    if (payload->compressed) {
+      writer.set("Content-Encoding", "gzip");
+    }
+    if (payload->computed_stats) {
+      writer.set("Datadog-Client-Computed-Stats", "yes");
+    }
+    if (payload->computed_stats && stats_concentrator_) {
+      writer.set("Datadog-Client-Dropped-P0-Traces",
+                 std::to_string(payload->dropped_p0_traces));
+      writer.set("Datadog-Client-Dropped-P0-Spans",
+                 std::to_string(payload->dropped_p0_spans));
+    }
     for (const auto& [key, value] : headers_) {
       writer.set(key, value);
     }
   };
 
+  // Both callbacks share `in_flight`, so that the request counts as in flight
+  // until the HTTP client is done with it.
+  auto in_flight = std::make_shared<InFlightRequest>(in_flight_requests_);
+
   // This is the callback for the HTTP response.  It's invoked
   // asynchronously.
-  auto on_response = [samplers = std::move(response_handlers),
-                      logger = logger_](int response_status,
-                                        const DictReader& /*response_headers*/,
-                                        std::string response_body) {
+  auto on_response = [in_flight, payload, retries = retries_,
+                      response_cache = response_cache_,
+                      delivery_latencies = delivery_latencies_,
+                      clock = clock_, logger = logger_,
+                      use_v05 = use_v05_,
+                      compression_enabled = compression_enabled_,
+                      memory_budget = memory_budget_,
+                      event_scheduler = event_scheduler_](
+                         int response_status,
+                         const DictReader& /*response_headers*/,
+                         std::string response_body) {
     if (response_status >= 500) {
       telemetry::counter::increment(metrics::tracer::api::responses,
                                     {"status_code:5xx"});
@@ -311,15 +2078,90 @@ void DatadogAgent::flush() {
       telemetry::counter::increment(metrics::tracer::api::responses,
                                     {"status_code:1xx"});
     }
+    // Replace the body of `payload` with the specified `body`, and send it
+    // again.
+    const auto resend = [&](std::string body) {
+      payload->size = body.size();
+      payload->body.assign(
+          1, std::make_shared<const std::string>(std::move(body)));
+      payload->charge = MemoryBudget::Charge(memory_budget, payload->size);
+      if (!retries->resend(payload)) {
+        logger->log_error(
+            "Unable to keep a payload to send it again. Its traces are lost.");
+      }
+    };
+    if (payload->compressed && response_status == 415) {
+      // This Datadog Agent does not accept compressed payloads.  Send
+      // subsequent payloads uncompressed, and this one again, decompressed.
+      if (compression_enabled->exchange(false)) {
+        logger->log_error(
+            "Datadog Agent does not accept gzip compressed traces. Sending "
+            "them uncompressed instead.");
+      }
+      std::string body;
+      for (const auto& segment : payload->body) {
+        auto result = gzip_decompress(body, *segment);
+        if (auto* error = result.if_error()) {
+          logger->log_error(*error);
+          return;
+        }
+      }
+      payload->compressed = false;
+      resend(std::move(body));
+      return;
+    }
+    if (payload->v05 && response_status == 404) {
+      // This Datadog Agent does not support v0.5.  Send subsequent payloads
+      // using v0.4, and this one again, converted to v0.4.
+      if (use_v05->exchange(false)) {
+        logger->log_error(
+            "Datadog Agent does not support the v0.5 traces API. Falling back "
+            "to v0.4.");
+      }
+      std::string v05;
+      for (const auto& segment : payload->body) {
+        if (!payload->compressed) {
+          v05 += *segment;
+          continue;
+        }
+        auto result = gzip_decompress(v05, *segment);
+        if (auto* error = result.if_error()) {
+          logger->log_error(*error);
+          return;
+        }
+      }
+      std::string body;
+      auto result = transcode_v05_to_v04(body, v05);
+      if (auto* error = result.if_error()) {
+        logger->log_error(*error);
+        return;
+      }
+      // The converted payload is sent uncompressed, as after a 415 response,
+      // rather than compressed again on the HTTP client's thread.
+      payload->v05 = false;
+      payload->compressed = false;
+      resend(std::move(body));
+      return;
+    }
     if (response_status != 200) {
+      // The Datadog Agent might be overloaded or restarting, in which case
+      // sending the payload again later might succeed.
+      const bool retrying =
+          (response_status >= 500 || response_status == 429) &&
+          retries->retry_later(payload);
       logger->log_error([&](auto& stream) {
         stream << "Unexpected response status " << response_status
                << " in Datadog Agent response with body of length "
                << response_body.size() << " (starts on next line):\n"
                << response_body;
+        if (retrying) {
+          stream << "\nThe payload will be sent again later.";
+        }
       });
       return;
     }
+    retries->agent_responding.store(true, std::memory_order_relaxed);
+    delivery_latencies->add_acknowledged(*payload, clock().tick);
 
     if (response_body.empty()) {
       logger->log_error([](auto& stream) {
@@ -330,37 +2172,50 @@ void DatadogAgent::flush() {
       return;
     }
 
-    auto result = parse_agent_traces_response(response_body);
-    if (const auto* error_message = std::get_if<std::string>(&result)) {
-      logger->log_error(*error_message);
-      return;
-    }
-    const auto& response = std::get<CollectorResponse>(result);
-    for (const auto& sampler : samplers) {
-      if (sampler) {
-        sampler->handle_collector_response(response);
+    // Parse the response off of the HTTP client's thread.
+    event_scheduler->post([samplers = payload->samplers, response_cache,
+                           logger, body = std::move(response_body)]() {
+      auto result = response_cache->parse(body);
+      if (const auto* error_message = std::get_if<std::string>(&result)) {
+        logger->log_error(*error_message);
+        return;
       }
-    }
+      const auto& response =
+          std::get<std::shared_ptr<const CollectorResponse>>(result);
+      for (const auto& sampler : samplers) {
+        if (sampler) {
+          sampler->handle_collector_response(response);
+        }
+      }
+    });
   };
 
   // This is the callback for if something goes wrong sending the
   // request or retrieving the response.  It's invoked
   // asynchronously.
-  auto on_error = [logger = logger_](Error error) {
+  auto on_error = [in_flight = std::move(in_flight), payload,
+                   retries = retries_, logger = logger_](Error error) {
     telemetry::counter::increment(metrics::tracer::api::errors,
                                   {"type:network"});
+    const bool retrying = retries->retry_later(payload);
     logger->log_error(error.with_prefix(
-        "Error occurred during HTTP request for submitting traces: "));
+        retrying ? "Error occurred during HTTP request for submitting traces "
+                   "(they will be sent again later): "
+                 : "Error occurred during HTTP request for submitting "
+                   "traces: "));
   };
 
   telemetry::counter::increment(metrics::tracer::api::requests);
+  if (payload->attempts > 1) {
+    telemetry::counter::increment(metrics::tracer::api::retries);
+  }
   telemetry::distribution::add(metrics::tracer::api::bytes_sent,
-                               static_cast<uint64_t>(body.size()));
+                               static_cast<uint64_t>(payload->size));
 
-  auto post_result =
-      http_client_->post(traces_endpoint_, std::move(set_request_headers),
-                         std::move(body), std::move(on_response),
-                         std::move(on_error), clock_().tick + request_timeout_);
+  auto post_result = http_client_->post_segments(
+      payload->v05 ? traces_v05_endpoint_ : traces_endpoint_,
+      std::move(set_request_headers), payload->body, std::move(on_response),
+      std::move(on_error), clock_().tick + request_timeout_);
   if (auto* error = post_result.if_error()) {
     // NOTE(@dmehala): `technical` is a better kind of errors.
     telemetry::counter::increment(metrics::tracer::api::errors,
@@ -370,7 +2225,172 @@ void DatadogAgent::flush() {
   }
 }
 
+void DatadogAgent::send_spilled_payloads() {
+  // While the Datadog Agent is not responding, send only one payload, and only
+  // if no other payload is waiting to be sent again, to find out when the
+  // Datadog Agent responds again.
+  const bool responding =
+      retries_->agent_responding.load(std::memory_order_relaxed);
+  if (!responding && !retries_->empty()) {
+    return;
+  }
+  const std::size_t max_bytes = responding ? flush_threshold_bytes_ : 1;
+  std::size_t bytes = 0;
+  std::string record;
+  while (bytes < max_bytes && retries_->spill_file->pop(record)) {
+    auto payload = Retries::unspill(record);
+    if (!payload) {
+      continue;
+    }
+    bytes += payload->size;
+    payload->charge = MemoryBudget::Charge(memory_budget_, payload->size);
+    send_payload(std::move(payload));
+  }
+}
+
+void DatadogAgent::send_stats(bool force) {
+  auto payloads = stats_concentrator_->flush(clock_(), force);
+  if (auto* error = payloads.if_error()) {
+    logger_->log_error(error->with_prefix("Unable to encode trace stats: "));
+    return;
+  }
+
+  const auto set_request_headers = [this](DictWriter& writer) {
+    writer.set("Datadog-Client-Computed-Stats", "yes");
+    for (const auto& [key, value] : headers_) {
+      writer.set(key, value);
+    }
+  };
+  const auto on_response = [logger = logger_](
+                               int response_status,
+                               const DictReader& /*response_headers*/,
+                               std::string response_body) {
+    if (response_status < 200 || response_status >= 300) {
+      logger->log_error([&](auto& stream) {
+        stream << "Unexpected response status " << response_status
+               << " in Datadog Agent response to trace stats with body (if "
+                  "any, starts on next line):\n"
+               << response_body;
+      });
+    }
+  };
+  const auto on_error = [logger = logger_](Error error) {
+    logger->log_error(error.with_prefix(
+        "Error occurred during HTTP request for submitting trace stats: "));
+  };
+
+  for (auto& payload : *payloads) {
+    auto post_result = http_client_->post(
+        stats_endpoint_, set_request_headers, std::move(payload), on_response,
+        on_error, clock_().tick + request_timeout_);
+    if (auto* error = post_result.if_error()) {
+      logger_->log_error(
+          error->with_prefix("Unexpected error submitting trace stats: "));
+    }
+  }
+}
+
+void DatadogAgent::query_agent_info() {
+  const auto on_response = [logger = logger_, agent_info = agent_info_,
+                            use_v05 = use_v05_](
+                               int response_status,
+                               const DictReader& /*response_headers*/,
+                               std::string response_body) {
+    if (response_status < 200 || response_status >= 300) {
+      // A Datadog Agent without an "/info" endpoint is assumed to support
+      // everything, as before it was asked.
+      if (response_status != 404) {
+        logger->log_error([&](auto& stream) {
+          stream << "Unexpected response status " << response_status
+                 << " in Datadog Agent response to info query with body (if "
+                    "any, starts on next line):\n"
+                 << response_body;
+        });
+      }
+      return;
+    }
+
+    const auto info =
+        nlohmann::json::parse(/* input = */ response_body,
+                              /* parser_callback = */ nullptr,
+                              /* allow_exceptions = */ false);
+    if (info.is_discarded() || !info.is_object() ||
+        !info.contains("endpoints") || !info["endpoints"].is_array()) {
+      logger->log_error(
+          "Could not parse the endpoints in the Datadog Agent's response to "
+          "info query.");
+      return;
+    }
+    const auto& endpoints = info["endpoints"];
+    const auto supports = [&](StringView path) {
+      return std::any_of(endpoints.begin(), endpoints.end(),
+                         [&](const nlohmann::json& endpoint) {
+                           return endpoint.is_string() &&
+                                  endpoint.get_ref<const std::string&>() ==
+                                      path;
+                         });
+    };
+
+    agent_info->remote_configuration.store(
+        supports(remote_configuration_path), std::memory_order_relaxed);
+    agent_info->stats.store(supports(stats_api_path),
+                            std::memory_order_relaxed);
+    // v0.5 is never chosen here, since trace chunks encoded on send are v0.4.
+    if (!supports(traces_v05_api_path) && use_v05->exchange(false)) {
+      logger->log_error(
+          "Datadog Agent does not support the v0.5 traces API. Falling back "
+          "to v0.4.");
+    }
+  };
+
+  const auto on_error = [logger = logger_](Error error) {
+    logger->log_error(error.with_prefix(
+        "Error occurred during HTTP request for Datadog Agent info: "));
+  };
+
+  // `HTTPClient` sends only POST requests, which the Datadog Agent's "/info"
+  // endpoint answers as it does GET requests.
+  auto post_result = http_client_->post(
+      info_endpoint_, [](DictWriter&) {}, std::string{}, on_response, on_error,
+      clock_().tick + request_timeout_);
+  if (auto* error = post_result.if_error()) {
+    logger_->log_error(
+        error->with_prefix("Unexpected error querying Datadog Agent info: "));
+  }
+}
+
+void DatadogAgent::poll_remote_configuration() {
+  auto skip = remote_configuration_polls_to_skip_.load();
+  while (skip != 0 &&
+         !remote_configuration_polls_to_skip_.compare_exchange_weak(
+             skip, skip - 1)) {
+  }
+  if (skip == 0) {
+    get_and_apply_remote_configuration_updates();
+  }
+}
+
+void DatadogAgent::back_off_remote_configuration(bool changed) {
+  if (changed) {
+    remote_configuration_idle_responses_ = 0;
+    remote_configuration_polls_to_skip_ = 0;
+    return;
+  }
+
+  // After `n` consecutive unchanged responses, skip `2^n - 1` polls.
+  const auto idle_responses = ++remote_configuration_idle_responses_;
+  std::uint32_t skip = remote_configuration_max_skipped_polls_;
+  if (idle_responses < 32) {
+    skip = std::min(skip, (std::uint32_t(1) << idle_responses) - 1);
+  }
+  remote_configuration_polls_to_skip_ = skip;
+}
+
 void DatadogAgent::get_and_apply_remote_configuration_updates() {
+  if (!agent_info_->remote_configuration.load(std::memory_order_relaxed)) {
+    return;
+  }
+
   auto remote_configuration_on_response =
       [this](int response_status, const DictReader& /*response_headers*/,
              std::string response_body) {
@@ -382,6 +2402,7 @@ void DatadogAgent::get_and_apply_remote_configuration_updates() {
              * feature could be enabled, so the tracer must continuously check
              * for new remote configuration.
              */
+            back_off_remote_configuration(false);
             return;
           }
 
@@ -406,8 +2427,10 @@ void DatadogAgent::get_and_apply_remote_configuration_updates() {
           return;
         }
 
-        if (!response_json.empty()) {
-          remote_config_.process_response(response_json);
+        const bool changed = !response_json.empty() &&
+                             remote_config_.process_response(response_json);
+        back_off_remote_configuration(changed);
+        if (changed) {
           // NOTE(@dmehala): Not ideal but it mimics the old behavior.
           // In the future, I would prefer telemetry pushing to the agent
           // and not the agent pulling from telemetry. That way telemetry will
@@ -422,9 +2445,9 @@ void DatadogAgent::get_and_apply_remote_configuration_updates() {
         "Error occurred during HTTP request for Remote Configuration: "));
   };
 
-  auto post_result = http_client_->post(
+  auto post_result = http_client_->post_segments(
       remote_configuration_endpoint_, set_content_type_json,
-      remote_config_.make_request_payload().dump(),
+      HTTPClient::BodySegments{remote_config_.serialized_request_payload()},
       remote_configuration_on_response, remote_configuration_on_error,
       clock_().tick + request_timeout_);
   if (auto error = post_result.if_error()) {
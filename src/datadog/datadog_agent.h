@@ -8,66 +8,364 @@
 
 #include <datadog/clock.h>
 #include <datadog/collector.h>
+#include <datadog/datadog_agent_config.h>
 #include <datadog/event_scheduler.h>
 #include <datadog/http_client.h>
 #include <datadog/tracer_signature.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
+#include "memory_budget.h"
 #include "remote_config/remote_config.h"
 
 namespace datadog {
 namespace tracing {
 
-class FinalizedDatadogAgentConfig;
+class Limiter;
 class Logger;
+class SharedTraceBuffer;
 struct SpanData;
+class StatsConcentrator;
 class TraceSampler;
 struct TracerSignature;
+class WorkerPool;
 
 class DatadogAgent : public Collector {
  public:
-  struct TraceChunk {
+  // The classes of trace chunks, ordered from those dropped first when the
+  // buffer is full to those dropped last.
+  enum class ChunkClass : std::uint8_t {
+    // The trace was dropped by sampling, so the chunk is sent only for the
+    // spans kept by span sampling, or for the Datadog Agent's stats.
+    SAMPLED_OUT,
+    // The trace was kept, but neither by the user nor for an error.
+    KEPT,
+    // The trace was kept by the user, or a span of the chunk is an error.
+    PROTECTED,
+  };
+  static constexpr std::size_t num_chunk_classes = 3;
+
+  struct BufferedChunk {
     std::vector<std::unique_ptr<SpanData>> spans;
     std::shared_ptr<TraceSampler> response_handler;
+    // The MessagePack encoding of the chunk, if it was encoded when it was
+    // sent (see `DatadogAgentConfig::encode_on_send`).  In that case, `spans`
+    // is empty.
+    std::string encoded;
+    // When the buffer is full, buffered chunks of a lower class are dropped
+    // to make room for a chunk of a higher class.  When the chunks cannot
+    // all be sent before the shutdown deadline, those of a higher class are
+    // sent first.
+    ChunkClass chunk_class;
+    // The estimated encoded size of the chunk, as counted against
+    // `DatadogAgentConfig::max_buffered_bytes`.
+    std::size_t bytes = 0;
+    // `bytes`, as counted against `memory_budget_`, if there is one.
+    MemoryBudget::Charge charge{};
+    // When the last span of the chunk finished, and when the chunk was
+    // buffered, by `clock_`, or the default value if unknown (see
+    // `DeliveryLatencies`).
+    std::chrono::steady_clock::time_point finished{};
+    std::chrono::steady_clock::time_point enqueued{};
   };
 
  private:
   std::mutex mutex_;
   Clock clock_;
   std::shared_ptr<Logger> logger_;
-  std::vector<TraceChunk> trace_chunks_;
+  // The trace chunks buffered to be sent in the next payload.  Possibly
+  // shared with the other `DatadogAgent` instances in this process that send
+  // traces identically (see `DatadogAgentConfig::batch_across_tracers`), in
+  // which case whichever of them flushes first sends the chunks of all.
+  struct Batch;
+  std::shared_ptr<Batch> batch_;
+  // Buffers previously used to hold encoded trace chunks, kept for reuse.
+  // Guarded by `mutex_`.
+  std::vector<std::string> buffer_pool_;
+  // Buffers of encoded trace chunks that were sent as segments of a request
+  // body (see `HTTPClient::BodySegments`).  Each is moved to `buffer_pool_`
+  // once the HTTP client no longer refers to it.  Guarded by `mutex_`.
+  std::vector<std::shared_ptr<std::string>> sent_buffers_;
+  bool encode_on_send_;
+  // The average size of an encoded span in the previous payload, used to
+  // estimate the size of the next one.
+  std::atomic<std::size_t> encoded_bytes_per_span_;
+  const std::size_t flush_threshold_bytes_;
+  const std::size_t max_buffered_bytes_;
+  const std::size_t max_payload_bytes_;
+  // Whether to compress payloads.  Set to false, possibly asynchronously, if
+  // the Datadog Agent does not accept compressed payloads.  Shared by the
+  // instances that share `batch_`.
+  std::shared_ptr<std::atomic<bool>> compression_enabled_;
+  const int compression_level_;
+  const std::size_t compression_min_bytes_;
+  // The number of trace requests in flight.  A request is in flight for as
+  // long as the HTTP client holds its callbacks.  Shared by the instances that
+  // share `batch_`.
+  std::shared_ptr<std::atomic<std::size_t>> in_flight_requests_;
+  // Zero if there is no limit.
+  const std::size_t max_in_flight_requests_;
+  // If `priority_flushes_per_second_` is not zero, buffering a chunk of
+  // `ChunkClass::PROTECTED` posts a flush of the chunks of that class when
+  // `priority_flush_limiter_` allows it (see
+  // `DatadogAgentConfig::priority_flushes_per_second`).
+  const double priority_flushes_per_second_;
+  std::unique_ptr<Limiter> priority_flush_limiter_;
+  // Null unless the memory held in trace data is limited (see
+  // `TracerConfig::max_memory_bytes`).
+  std::shared_ptr<MemoryBudget> memory_budget_;
+  // If not null, the threads that help to encode payloads of at least
+  // `parallel_encoding_min_spans_` spans (see
+  // `DatadogAgentConfig::encoding_threads`).
+  std::unique_ptr<WorkerPool> encoding_pool_;
+  const std::size_t parallel_encoding_min_spans_;
+  // An encoded batch of trace chunks, kept until it is sent successfully or
+  // no longer retried.
+  struct Payload {
+    HTTPClient::BodySegments body;
+    // The total size of `body`.
+    std::size_t size = 0;
+    std::size_t trace_count = 0;
+    bool v05 = false;
+    bool compressed = false;
+    std::unordered_set<std::shared_ptr<TraceSampler>> samplers;
+    // The number of times that the payload has been sent.
+    std::size_t attempts = 0;
+    // If the payload is waiting to be sent again, when it may be.
+    std::chrono::steady_clock::time_point retry_after;
+    // The number of traces, and of their spans, that were dropped instead of
+    // sent since the previous payload, because their stats were computed by
+    // `stats_concentrator_`.
+    std::uint64_t dropped_p0_traces = 0;
+    std::uint64_t dropped_p0_spans = 0;
+    // Whether the Datadog Agent is told not to compute the stats of the
+    // payload's traces, because the tracer computed and sent them when the
+    // payload was encoded (see `client_computed_stats_`).
+    bool computed_stats = false;
+    // `size`, as counted against `memory_budget_`, for as long as the
+    // payload is in flight or kept to be sent again.
+    MemoryBudget::Charge charge;
+    // When the payload was encoded, and when the last span of each of its
+    // chunks finished, where known, by `clock_` (see `DeliveryLatencies`).
+    std::chrono::steady_clock::time_point encoded{};
+    std::vector<std::chrono::steady_clock::time_point> chunks_finished;
+  };
+  struct Retries;
+  std::shared_ptr<Retries> retries_;
+  // The most recently parsed response to traces, which is reused when the
+  // next response has the same body.
+  struct ResponseCache;
+  std::shared_ptr<ResponseCache> response_cache_;
+  // The distributions of how long trace chunks take to be delivered, which
+  // are reported by `add_runtime_stats`.
+  struct DeliveryLatencies;
+  std::shared_ptr<DeliveryLatencies> delivery_latencies_;
+  // If not null, trace chunks are written to `shared_trace_buffer_` rather
+  // than buffered here, and the chunks in it are sent by this process only
+  // while it is elected to (see `SharedTraceBuffer::try_become_drainer`).
+  std::shared_ptr<SharedTraceBuffer> shared_trace_buffer_;
+  // The trace sampler that handles the responses to chunks taken from
+  // `shared_trace_buffer_`, which is that of the chunk most recently written
+  // to it by this process.  Guarded by `mutex_`.
+  std::shared_ptr<TraceSampler> shared_response_handler_;
   HTTPClient::URL traces_endpoint_;
+  // The endpoint used instead of `traces_endpoint_` when
+  // `TracesAPIVersion::V0_5` is in use.
+  HTTPClient::URL traces_v05_endpoint_;
+  // Whether to send `TracesAPIVersion::V0_5` payloads.  Set to false,
+  // possibly asynchronously, if the Datadog Agent does not support them.
+  // Shared by the instances that share `batch_`.
+  std::shared_ptr<std::atomic<bool>> use_v05_;
   HTTPClient::URL remote_configuration_endpoint_;
+  // If not null, trace stats are computed from the trace chunks sent to this
+  // agent (see `DatadogAgentConfig::stats_computation_enabled`), and are sent
+  // to `stats_endpoint_` by each flush.
+  std::unique_ptr<StatsConcentrator> stats_concentrator_;
+  HTTPClient::URL stats_endpoint_;
+  // Whether requests tell the Datadog Agent not to compute trace stats (see
+  // `FinalizedDatadogAgentConfig::client_computed_stats`).  If there is a
+  // `stats_concentrator_`, then trace requests do so only while the agent
+  // accepts the stats that it computes.
+  const bool client_computed_stats_;
+  // The number of traces, and of their spans, not sent since the previous
+  // payload (see `Payload::dropped_p0_traces`).
+  std::atomic<std::uint64_t> dropped_p0_traces_;
+  std::atomic<std::uint64_t> dropped_p0_spans_;
   std::shared_ptr<HTTPClient> http_client_;
   std::shared_ptr<EventScheduler> event_scheduler_;
+  // Flushes passed to `EventScheduler::post` refer to this agent through
+  // `handoff_`, which is detached from the agent when it is destroyed.
+  struct Handoff;
+  std::shared_ptr<Handoff> handoff_;
   std::vector<EventScheduler::Cancel> tasks_;
   std::chrono::steady_clock::duration flush_interval_;
+  // The flush timer fires every `flush_interval_min_`.  The flush interval is
+  // `flush_periods_` of those, which is `nominal_flush_periods_` unless it has
+  // adapted to how quickly chunks are buffered, and at most
+  // `max_flush_periods_` (see
+  // `DatadogAgentConfig::flush_interval_min_milliseconds`).  The timer skips
+  // `flush_periods_to_skip_` more periods before the next flush.  Used only
+  // by the flush timer, whose invocations do not overlap.
+  std::chrono::steady_clock::duration flush_interval_min_;
+  std::chrono::steady_clock::duration flush_interval_max_;
+  const std::uint32_t nominal_flush_periods_;
+  const std::uint32_t max_flush_periods_;
+  std::uint32_t flush_periods_;
+  std::uint32_t flush_periods_to_skip_;
   std::chrono::steady_clock::duration request_timeout_;
   std::chrono::steady_clock::duration shutdown_timeout_;
+  // Used by `shut_down_collector`, so that this collector shuts down once.
+  std::once_flag shut_down_once_;
 
   remote_config::Manager remote_config_;
+  // The number of Remote Configuration polls still to be skipped, and the
+  // most that are skipped in a row (see
+  // `DatadogAgentConfig::remote_configuration_max_poll_interval_seconds`).
+  std::atomic<std::uint32_t> remote_configuration_polls_to_skip_;
+  const std::uint32_t remote_configuration_max_skipped_polls_;
+  // The number of consecutive Remote Configuration responses that reported no
+  // changes.
+  std::atomic<std::uint32_t> remote_configuration_idle_responses_;
 
   std::unordered_map<std::string, std::string> headers_;
 
-  void flush();
+  // What the Datadog Agent's "/info" endpoint reported that the agent
+  // supports, or everything if it has not reported (see
+  // `DatadogAgentConfig::agent_info_refresh_interval_seconds`).  Shared with
+  // the callbacks of requests in flight.
+  struct AgentInfo;
+  std::shared_ptr<AgentInfo> agent_info_;
+  HTTPClient::URL info_endpoint_;
+
+  // Send the buffered trace chunks to the Datadog Agent.  If the maximum
+  // number of trace requests are in flight and the specified `force` is
+  // false, then keep them buffered instead.  If the specified `deadline` is
+  // not null, then send the chunks as with `send_trace_chunks_by`.
+  void flush(bool force,
+             Optional<std::chrono::steady_clock::time_point> deadline = {});
+  // Flush, as with `flush(false)`, in a task passed to the event scheduler's
+  // `post`.
+  void post_flush();
+  // Send the buffered trace chunks of `ChunkClass::PROTECTED`, and only
+  // those, unless the maximum number of trace requests are in flight.
+  void flush_priority();
+  // Call `flush_priority` in a task passed to the event scheduler's `post`.
+  void post_priority_flush();
+  // Post a flush, as with `post_flush`, unless the flush timer skips this
+  // period, and adapt the flush interval to the bytes buffered.
+  void on_flush_timer();
+  // Query the Datadog Agent for Remote Configuration updates, unless this poll
+  // is skipped because recent responses reported no changes.
+  void poll_remote_configuration();
+  // Update the number of Remote Configuration polls to skip after a response
+  // that reported a change if the specified `changed` is true, or no change
+  // otherwise.  The polls that follow consecutive unchanged responses are 1,
+  // 2, 4, and so on, poll intervals apart.
+  void back_off_remote_configuration(bool changed);
+  // Ask the Datadog Agent which endpoints it supports, and update
+  // `agent_info_` accordingly once it responds.
+  void query_agent_info();
+  // Send the trace stats of the buckets of `stats_concentrator_` that have
+  // ended, or of all buckets if the specified `force` is true.
+  void send_stats(bool force);
+  // Count the specified number of `dropped` trace chunks of the specified
+  // `chunk_class`, dropped for the specified `reason` tag.
+  void count_dropped(ChunkClass chunk_class, std::size_t dropped,
+                     const char* reason);
+  // Encode the specified `trace_chunks` and send them to the Datadog Agent.
+  void send_trace_chunks(std::vector<BufferedChunk>&& trace_chunks);
+  // Encode the specified `trace_chunks` and send them to the Datadog Agent in
+  // payloads no larger than the flush threshold, those of the highest class
+  // first and, among those, the most recent first.  Drop
+  // the chunks that remain when the specified `deadline` is reached, and log
+  // how many were dropped.
+  void send_trace_chunks_by(std::vector<BufferedChunk>&& trace_chunks,
+                            std::chrono::steady_clock::time_point deadline);
+  // Send the specified `trace_chunks` in consecutive payloads of at most
+  // `max_payload_bytes_` each.  Unless `force` is true, stop once the maximum
+  // number of trace requests are in flight, and return the chunks not yet
+  // sent to `batch_` to be sent by a later flush.
+  void send_trace_chunks_split(std::vector<BufferedChunk>&& trace_chunks,
+                               bool force);
+  // Send the specified `payload` to the Datadog Agent.  If sending it fails in
+  // a way that might be transient, keep it in `retries_` to be sent again by
+  // a later flush.
+  void send_payload(std::shared_ptr<Payload> payload);
+  // Send the oldest payloads in the spill file, up to the flush threshold, or
+  // only one while the Datadog Agent is not responding.
+  void send_spilled_payloads();
+  // Buffer the specified `chunk`, unless the buffer is full, in which case
+  // drop it.  If the buffer then reaches the flush threshold, post a flush,
+  // unless the maximum number of trace requests are in flight.
+  void enqueue(BufferedChunk&& chunk);
+  // Return whether the maximum number of trace requests are in flight.
+  bool at_max_in_flight_requests() const;
+  // Return whether `TracesAPIVersion::V0_5` payloads are currently sent.
+  bool using_v05() const;
+  // If this process is elected to send the chunks in `shared_trace_buffer_`,
+  // then move them to `batch_`, until `max_buffered_bytes_` is reached.
+  void take_shared_trace_chunks();
+  // Return the `Batch` identified by the specified `key`, which is shared by
+  // the instances in this process that use the same `key`.  If there is no
+  // such `Batch`, create one having the specified `use_v05` and
+  // `compression_enabled`.
+  static std::shared_ptr<Batch> shared_batch(const std::string& key,
+                                             bool use_v05,
+                                             bool compression_enabled);
+  // Return a buffer from `buffer_pool_`, or a new buffer if the pool is empty.
+  std::string acquire_buffer();
+  // Return the specified `buffer` to `buffer_pool_`, unless the pool is full
+  // or the buffer is too large to keep.  The behavior is undefined unless
+  // `mutex_` is locked.
+  void release_buffer(std::string&& buffer);
+  // Move to `buffer_pool_` the buffers in `sent_buffers_` that the HTTP client
+  // no longer refers to.  The behavior is undefined unless `mutex_` is locked.
+  void reclaim_sent_buffers();
 
  public:
-  DatadogAgent(const FinalizedDatadogAgentConfig&,
+  // Create an agent configured by the specified `config`.  If the specified
+  // `memory_budget` is not null, then count the buffered trace chunks and
+  // the payloads against it.
+  DatadogAgent(const FinalizedDatadogAgentConfig& config,
                const std::shared_ptr<Logger>&, const TracerSignature& id,
                const std::vector<std::shared_ptr<remote_config::Listener>>&
-                   rc_listeners);
+                   rc_listeners,
+               std::shared_ptr<MemoryBudget> memory_budget = nullptr);
   ~DatadogAgent();
 
+  void shut_down(std::chrono::steady_clock::time_point deadline) override;
+
   Expected<void> send(
       std::vector<std::unique_ptr<SpanData>>&& spans,
       const std::shared_ptr<TraceSampler>& response_handler) override;
+  Expected<void> send_chunk(
+      TraceChunk&& chunk,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
 
   void get_and_apply_remote_configuration_updates();
 
   std::string config() const override;
+
+  bool accepts_shared_tags() const override { return true; }
+
+  // Add the trace chunks buffered by this agent, its trace requests in flight,
+  // and the trace chunks that it dropped to the specified `stats`.  If this
+  // agent shares its buffer with other instances (see
+  // `DatadogAgentConfig::batch_across_tracers`), then these include theirs.
+  void add_runtime_stats(RuntimeStats& stats) const override;
+
+  // Fill the pool of buffers for encoded trace chunks with buffers large
+  // enough for traces having about the specified `expected_spans_per_trace`
+  // spans, one for each of the specified `expected_concurrency` threads.
+  void warm_up(std::size_t expected_spans_per_trace,
+               std::size_t expected_concurrency) override;
 };
 
 }  // namespace tracing
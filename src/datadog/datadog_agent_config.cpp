@@ -3,15 +3,46 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
 
+#include "compression.h"
 #include "default_http_client.h"
 #include "parse_util.h"
 #include "platform_util.h"
+#include "thread_generator.h"
 #include "threaded_event_scheduler.h"
 
 namespace datadog {
 namespace tracing {
+namespace {
+
+Expected<TracesAPIVersion> parse_traces_api_version(StringView text) {
+  if (text == "v0.4") {
+    return TracesAPIVersion::V0_4;
+  }
+  if (text == "v0.5") {
+    return TracesAPIVersion::V0_5;
+  }
+  std::string message;
+  message += "DatadogAgent: Unsupported traces API version \"";
+  append(message, text);
+  message += "\".  Supported versions are \"v0.4\" and \"v0.5\".";
+  return Error{Error::DATADOG_AGENT_INVALID_TRACES_API_VERSION,
+               std::move(message)};
+}
+
+StringView to_string(TracesAPIVersion version) {
+  switch (version) {
+    case TracesAPIVersion::V0_5:
+      return "v0.5";
+    case TracesAPIVersion::V0_4:
+    default:
+      return "v0.4";
+  }
+}
+
+}  // namespace
 
 Expected<DatadogAgentConfig> load_datadog_agent_env_config() {
   DatadogAgentConfig env_config;
@@ -20,6 +51,11 @@ Expected<DatadogAgentConfig> load_datadog_agent_env_config() {
     env_config.remote_configuration_enabled = !falsy(*rc_enabled);
   }
 
+  if (auto stats_enabled =
+          lookup(environment::DD_TRACE_STATS_COMPUTATION_ENABLED)) {
+    env_config.stats_computation_enabled = !falsy(*stats_enabled);
+  }
+
   if (auto raw_rc_poll_interval_value =
           lookup(environment::DD_REMOTE_CONFIG_POLL_INTERVAL_SECONDS)) {
     auto res = parse_double(*raw_rc_poll_interval_value);
@@ -31,6 +67,14 @@ Expected<DatadogAgentConfig> load_datadog_agent_env_config() {
     env_config.remote_configuration_poll_interval_seconds = *res;
   }
 
+  if (auto api_version = lookup(environment::DD_TRACE_API_VERSION)) {
+    auto parsed = parse_traces_api_version(*api_version);
+    if (auto* error = parsed.if_error()) {
+      return std::move(*error);
+    }
+    env_config.traces_api_version = *parsed;
+  }
+
   auto env_host = lookup(environment::DD_AGENT_HOST);
   auto env_port = lookup(environment::DD_TRACE_AGENT_PORT);
 
@@ -60,8 +104,19 @@ Expected<FinalizedDatadogAgentConfig> finalize_config(
 
   result.clock = clock;
 
+  result.http2_enabled = user_config.http2_enabled.value_or(false);
+  result.io_uring_enabled = user_config.io_uring_enabled.value_or(false);
+
+  auto validated = validate(user_config.background_threads);
+  if (auto* error = validated.if_error()) {
+    return error->with_prefix("DatadogAgent: ");
+  }
+
+  result.default_http_client = !user_config.http_client;
   if (!user_config.http_client) {
-    result.http_client = default_http_client(logger, clock);
+    result.http_client =
+        shared_default_http_client(logger, clock, http_client_options(result),
+                                   user_config.background_threads);
     // `default_http_client` might return a `Curl` instance depending on how
     // this library was built.  If it returns `nullptr`, then there's no
     // built-in default, and so the user must provide a value.
@@ -73,8 +128,10 @@ Expected<FinalizedDatadogAgentConfig> finalize_config(
     result.http_client = user_config.http_client;
   }
 
+  result.default_event_scheduler = !user_config.event_scheduler;
   if (!user_config.event_scheduler) {
-    result.event_scheduler = std::make_shared<ThreadedEventScheduler>();
+    result.event_scheduler = ThreadedEventScheduler::shared_instance(
+        user_config.background_threads, logger);
   } else {
     result.event_scheduler = user_config.event_scheduler;
   }
@@ -94,6 +151,27 @@ Expected<FinalizedDatadogAgentConfig> finalize_config(
                  "milliseconds."};
   }
 
+  result.flush_interval_min = result.flush_interval;
+  if (auto min_milliseconds = user_config.flush_interval_min_milliseconds) {
+    if (*min_milliseconds <= 0) {
+      return Error{Error::DATADOG_AGENT_INVALID_FLUSH_INTERVAL,
+                   "DatadogAgent: Minimum flush interval must be a positive "
+                   "number of milliseconds."};
+    }
+    result.flush_interval_min =
+        std::min(result.flush_interval_min,
+                 std::chrono::steady_clock::duration(
+                     std::chrono::milliseconds(*min_milliseconds)));
+  }
+  result.flush_interval_max = result.flush_interval;
+  if (auto max_milliseconds = user_config.flush_interval_max_milliseconds) {
+    result.flush_interval_max =
+        std::max(result.flush_interval_max,
+                 std::chrono::steady_clock::duration(
+                     std::chrono::milliseconds(*max_milliseconds)));
+  }
+  result.flush_jitter_enabled = user_config.flush_jitter_enabled.value_or(true);
+
   if (auto request_timeout_milliseconds =
           value_or(env_config->request_timeout_milliseconds,
                    user_config.request_timeout_milliseconds, 2000);
@@ -131,10 +209,122 @@ Expected<FinalizedDatadogAgentConfig> finalize_config(
                  "positive number of seconds."};
   }
 
+  result.remote_configuration_max_poll_interval =
+      result.remote_configuration_poll_interval;
+  if (auto max_seconds =
+          user_config.remote_configuration_max_poll_interval_seconds) {
+    if (*max_seconds < 0.0) {
+      return Error{Error::DATADOG_AGENT_INVALID_REMOTE_CONFIG_POLL_INTERVAL,
+                   "DatadogAgent: Remote Configuration maximum poll interval "
+                   "must be a positive number of seconds."};
+    }
+    result.remote_configuration_max_poll_interval =
+        std::max(result.remote_configuration_max_poll_interval,
+                 std::chrono::steady_clock::duration(
+                     std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::duration<double>(*max_seconds))));
+  }
+
+  result.agent_info_refresh_interval =
+      std::chrono::steady_clock::duration::zero();
+  if (auto info_seconds = user_config.agent_info_refresh_interval_seconds) {
+    if (*info_seconds < 0.0) {
+      return Error{Error::DATADOG_AGENT_INVALID_INFO_REFRESH_INTERVAL,
+                   "DatadogAgent: The Datadog Agent info refresh interval "
+                   "must be a positive number of seconds."};
+    }
+    result.agent_info_refresh_interval =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::duration<double>(*info_seconds));
+  }
+
   result.remote_configuration_enabled =
       value_or(env_config->remote_configuration_enabled,
                user_config.remote_configuration_enabled, true);
 
+  result.encode_on_send = user_config.encode_on_send.value_or(false);
+
+  result.encoding_threads = user_config.encoding_threads.value_or(0);
+  if (result.encoding_threads > 64) {
+    return Error{Error::DATADOG_AGENT_INVALID_ENCODING_THREADS,
+                 "DatadogAgent: The number of encoding threads must be at "
+                 "most 64, but " +
+                     std::to_string(result.encoding_threads) +
+                     " were configured."};
+  }
+  result.parallel_encoding_min_spans =
+      user_config.parallel_encoding_min_spans.value_or(10000);
+  result.background_threads = user_config.background_threads;
+
+  result.flush_threshold_bytes =
+      user_config.flush_threshold_bytes.value_or(8 * 1024 * 1024);
+  result.max_buffered_bytes =
+      user_config.max_buffered_bytes.value_or(64 * 1024 * 1024);
+  if (result.flush_threshold_bytes == 0) {
+    return Error{Error::DATADOG_AGENT_INVALID_BUFFER_LIMITS,
+                 "DatadogAgent: Flush threshold must be a positive number of "
+                 "bytes."};
+  }
+  if (result.max_buffered_bytes < result.flush_threshold_bytes) {
+    return Error{Error::DATADOG_AGENT_INVALID_BUFFER_LIMITS,
+                 "DatadogAgent: Maximum buffered bytes must be at least the "
+                 "flush threshold."};
+  }
+  result.max_payload_bytes =
+      user_config.max_payload_bytes.value_or(25 * 1024 * 1024);
+  if (result.max_payload_bytes == 0) {
+    return Error{Error::DATADOG_AGENT_INVALID_BUFFER_LIMITS,
+                 "DatadogAgent: Maximum payload size must be a positive number "
+                 "of bytes."};
+  }
+
+  result.max_in_flight_requests =
+      user_config.max_in_flight_requests.value_or(2);
+  result.priority_flushes_per_second =
+      user_config.priority_flushes_per_second.value_or(0);
+  if (!(result.priority_flushes_per_second >= 0) ||
+      !std::isfinite(result.priority_flushes_per_second)) {
+    return Error{Error::DATADOG_AGENT_INVALID_PRIORITY_FLUSH_RATE,
+                 "DatadogAgent: Priority flushes per second must be a "
+                 "nonnegative number."};
+  }
+  result.max_retries = user_config.max_retries.value_or(3);
+  result.retry_budget_bytes =
+      user_config.retry_budget_bytes.value_or(16 * 1024 * 1024);
+  result.spill_file = user_config.spill_file;
+
+  result.compression_enabled = user_config.compression_enabled.value_or(false);
+  result.compression_level = user_config.compression_level.value_or(6);
+  result.compression_min_bytes =
+      user_config.compression_min_bytes.value_or(1024);
+  if (result.compression_enabled) {
+    if (!gzip_available()) {
+      return Error{Error::DATADOG_AGENT_COMPRESSION_UNAVAILABLE,
+                   "DatadogAgent: Compression is enabled, but this library was "
+                   "built without support for it."};
+    }
+    if (result.compression_level < 1 || result.compression_level > 9) {
+      return Error{Error::DATADOG_AGENT_INVALID_COMPRESSION_LEVEL,
+                   "DatadogAgent: Compression level must be between 1 and 9."};
+    }
+  }
+
+  const auto [api_version_origin, api_version] =
+      pick(env_config->traces_api_version, user_config.traces_api_version,
+           TracesAPIVersion::V0_4);
+  result.traces_api_version = api_version;
+  result.shared_trace_buffer = user_config.shared_trace_buffer;
+  if (result.shared_trace_buffer && api_version == TracesAPIVersion::V0_5) {
+    return Error{Error::DATADOG_AGENT_INVALID_SHARED_TRACE_BUFFER,
+                 "DatadogAgent: A shared trace buffer requires the v0.4 traces "
+                 "API."};
+  }
+  result.batch_across_tracers =
+      user_config.batch_across_tracers.value_or(true);
+  result.metadata[ConfigName::TRACE_API_VERSION] =
+      ConfigMetadata(ConfigName::TRACE_API_VERSION,
+                     std::string(to_string(api_version)), api_version_origin);
+
   const auto [origin, url] =
       pick(env_config->url, user_config.url, "http://localhost:8126");
   auto parsed_url = HTTPClient::URL::parse(url);
@@ -152,8 +342,11 @@ Expected<FinalizedDatadogAgentConfig> finalize_config(
     result.admission_controller_uid = std::string(*external_env);
   }
 
-  // Not supported yet but required for APM tracing disablement.
-  result.stats_computation_enabled = false;
+  result.stats_computation_enabled =
+      value_or(env_config->stats_computation_enabled,
+               user_config.stats_computation_enabled, false);
+  result.client_computed_stats = result.stats_computation_enabled;
+  result.client_obfuscation = false;
 
   return result;
 }
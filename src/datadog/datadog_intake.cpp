@@ -0,0 +1,686 @@
+#include "datadog_intake.h"
+
+#include <datadog/dict_reader.h>
+#include <datadog/dict_writer.h>
+#include <datadog/logger.h>
+#include <datadog/telemetry/telemetry.h>
+#include <datadog/tracer_signature.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <shared_mutex>
+#include <utility>
+
+#include "collector_shutdown.h"
+#include "compression.h"
+#include "json.hpp"
+#include "overhead_governor.h"
+#include "protobuf.h"
+#include "retry_backoff.h"
+#include "span_data.h"
+#include "tags.h"
+#include "telemetry_metrics.h"
+#include "utf8.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Payloads smaller than this are sent uncompressed, because compressing them
+// saves little.
+constexpr std::size_t compression_min_bytes = 1024;
+
+// These are the field numbers of the messages of the agentless traces API, as
+// defined in "agent_payload.proto", "tracer_payload.proto", and "span.proto"
+// of the Datadog Agent.  Only the fields that `DatadogIntake` sends are
+// listed.
+namespace agent_payload {
+constexpr std::uint32_t tracer_payloads = 5;
+}  // namespace agent_payload
+namespace tracer_payload {
+constexpr std::uint32_t language_name = 2;
+constexpr std::uint32_t language_version = 3;
+constexpr std::uint32_t tracer_version = 4;
+constexpr std::uint32_t runtime_id = 5;
+constexpr std::uint32_t chunks = 6;
+constexpr std::uint32_t env = 8;
+constexpr std::uint32_t app_version = 10;
+}  // namespace tracer_payload
+namespace trace_chunk {
+constexpr std::uint32_t priority = 1;
+constexpr std::uint32_t origin = 2;
+constexpr std::uint32_t spans = 3;
+// The priority of a chunk whose sampling priority is not known.
+constexpr std::int32_t priority_none = -128;
+}  // namespace trace_chunk
+namespace span {
+constexpr std::uint32_t service = 1;
+constexpr std::uint32_t name = 2;
+constexpr std::uint32_t resource = 3;
+constexpr std::uint32_t trace_id = 4;
+constexpr std::uint32_t span_id = 5;
+constexpr std::uint32_t parent_id = 6;
+constexpr std::uint32_t start = 7;
+constexpr std::uint32_t duration = 8;
+constexpr std::uint32_t error = 9;
+constexpr std::uint32_t meta = 10;
+constexpr std::uint32_t metrics = 11;
+constexpr std::uint32_t type = 12;
+constexpr std::uint32_t span_links = 14;
+constexpr std::uint32_t span_events = 15;
+}  // namespace span
+namespace span_link {
+constexpr std::uint32_t trace_id = 1;
+constexpr std::uint32_t trace_id_high = 2;
+constexpr std::uint32_t span_id = 3;
+constexpr std::uint32_t attributes = 4;
+constexpr std::uint32_t tracestate = 5;
+constexpr std::uint32_t flags = 6;
+}  // namespace span_link
+namespace span_event {
+constexpr std::uint32_t time_unix_nano = 1;
+constexpr std::uint32_t name = 2;
+constexpr std::uint32_t attributes = 3;
+}  // namespace span_event
+// Each element of a map field is a message having these fields.
+namespace map_entry {
+constexpr std::uint32_t key = 1;
+constexpr std::uint32_t value = 2;
+}  // namespace map_entry
+namespace attribute_any_value {
+constexpr std::uint32_t string_value = 2;
+}  // namespace attribute_any_value
+
+std::string to_url_string(const HTTPClient::URL& url) {
+  return url.scheme + "://" + url.authority + url.path;
+}
+
+// Return the specified `text` if it is valid UTF-8, as protobuf strings must
+// be.  Otherwise, return a copy of `text` repaired by `repair_utf8`, which is
+// kept in the specified `storage`.
+StringView valid_utf8(StringView text, std::string& storage) {
+  if (valid_utf8_prefix(text) == text.size()) {
+    return text;
+  }
+  storage.resize(repaired_utf8_size(text));
+  char* const end = repair_utf8(&storage[0], text);
+  storage.resize(end - storage.data());
+  return storage;
+}
+
+void pack_text(std::string& destination, std::uint32_t field,
+               StringView text) {
+  std::string storage;
+  protobuf::pack_string(destination, field, valid_utf8(text, storage));
+}
+
+// Append an element of a `map<string, string>` having the specified `key` and
+// `value`, as the specified `field`.
+void pack_entry(std::string& destination, std::uint32_t field, StringView key,
+                StringView value) {
+  std::string key_storage;
+  std::string value_storage;
+  key = valid_utf8(key, key_storage);
+  value = valid_utf8(value, value_storage);
+  protobuf::pack_message_header(
+      destination, field,
+      protobuf::length_delimited_size(map_entry::key, key.size()) +
+          protobuf::length_delimited_size(map_entry::value, value.size()));
+  protobuf::pack_string(destination, map_entry::key, key);
+  protobuf::pack_string(destination, map_entry::value, value);
+}
+
+// Append an element of a `map<string, double>` having the specified `key` and
+// `value`, as the specified `field`.
+void pack_entry(std::string& destination, std::uint32_t field, StringView key,
+                double value) {
+  std::string key_storage;
+  key = valid_utf8(key, key_storage);
+  // One byte of key and eight of value.
+  const std::size_t value_size = 9;
+  protobuf::pack_message_header(
+      destination, field,
+      protobuf::length_delimited_size(map_entry::key, key.size()) +
+          value_size);
+  protobuf::pack_string(destination, map_entry::key, key);
+  protobuf::pack_double(destination, map_entry::value, value);
+}
+
+// Append an element of a `map<string, AttributeAnyValue>` having the
+// specified `key` and string `value`, as the specified `field`.
+void pack_attribute(std::string& destination, std::uint32_t field,
+                    StringView key, StringView value) {
+  std::string key_storage;
+  std::string value_storage;
+  key = valid_utf8(key, key_storage);
+  value = valid_utf8(value, value_storage);
+  // The type of an `AttributeAnyValue` is zero, for a string, and so it is
+  // omitted.
+  const std::size_t value_size = protobuf::length_delimited_size(
+      attribute_any_value::string_value, value.size());
+  protobuf::pack_message_header(
+      destination, field,
+      protobuf::length_delimited_size(map_entry::key, key.size()) +
+          protobuf::length_delimited_size(map_entry::value, value_size));
+  protobuf::pack_string(destination, map_entry::key, key);
+  protobuf::pack_message_header(destination, map_entry::value, value_size);
+  protobuf::pack_string(destination, attribute_any_value::string_value, value);
+}
+
+std::uint64_t unix_nanoseconds(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Return the value of the tag of the specified `data` having the specified
+// `key`, whether it is among the span's own tags or its shared tags, or null
+// if there is none.
+const std::string* find_tag(const SpanData& data, const std::string& key) {
+  const auto found = data.tags.find(key);
+  if (found != data.tags.end()) {
+    return &found->second;
+  }
+  if (const auto* shared = data.shared_tags.get()) {
+    for (const auto& [shared_key, value] : shared->tags()) {
+      if (shared_key == key) {
+        return &value;
+      }
+    }
+  }
+  return nullptr;
+}
+
+// Append to the specified `destination` the specified `data` as a `spans`
+// field of a `TraceChunk`.  As in the MessagePack encoding of spans (see
+// `msgpack_encode`), the span's shared tags follow its own tags, so that they
+// take precedence.
+void encode_span(std::string& destination, const SpanData& data) {
+  const std::size_t length_position =
+      protobuf::begin_message(destination, trace_chunk::spans);
+
+  pack_text(destination, span::service, data.service);
+  pack_text(destination, span::name, data.name);
+  pack_text(destination, span::resource, data.resource);
+  protobuf::pack_uint64(destination, span::trace_id, data.trace_id.low);
+  protobuf::pack_uint64(destination, span::span_id, data.span_id);
+  if (data.parent_id != 0) {
+    protobuf::pack_uint64(destination, span::parent_id, data.parent_id);
+  }
+  protobuf::pack_uint64(destination, span::start,
+                        unix_nanoseconds(data.start.wall));
+  protobuf::pack_uint64(
+      destination, span::duration,
+      std::uint64_t(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(data.duration)
+              .count()));
+  if (data.error) {
+    protobuf::pack_uint64(destination, span::error, 1);
+  }
+
+  const auto* shared = data.shared_tags.get();
+  for (const auto& [key, value] : data.tags) {
+    pack_entry(destination, span::meta, key, value);
+  }
+  if (shared) {
+    for (const auto& [key, value] : shared->tags()) {
+      pack_entry(destination, span::meta, key, value);
+    }
+  }
+  if (const std::string* error_stack = symbolized_error_stack(data)) {
+    pack_entry(destination, span::meta, tags::error_stack, *error_stack);
+  }
+  for (const auto& [key, value] : data.numeric_tags) {
+    pack_entry(destination, span::metrics, key, value);
+  }
+  if (shared) {
+    for (const auto& [key, value] : shared->numeric_tags()) {
+      pack_entry(destination, span::metrics, key, value);
+    }
+  }
+  if (!data.service_type.empty()) {
+    pack_text(destination, span::type, data.service_type);
+  }
+
+  for (const SpanLink& item : data.links) {
+    const std::size_t link_position =
+        protobuf::begin_message(destination, span::span_links);
+    protobuf::pack_uint64(destination, span_link::trace_id,
+                          item.trace_id.low);
+    if (item.trace_id.high != 0) {
+      protobuf::pack_uint64(destination, span_link::trace_id_high,
+                            item.trace_id.high);
+    }
+    protobuf::pack_uint64(destination, span_link::span_id, item.span_id);
+    for (const auto& [key, value] : item.attributes) {
+      pack_entry(destination, span_link::attributes, key, value);
+    }
+    if (!item.tracestate.empty()) {
+      pack_text(destination, span_link::tracestate, item.tracestate);
+    }
+    if (item.flags) {
+      // The high bit indicates that the flags are set, so that zero flags can
+      // be distinguished from no flags.
+      protobuf::pack_uint64(destination, span_link::flags,
+                            std::uint32_t(*item.flags | 0x80000000u));
+    }
+    protobuf::end_message(destination, link_position);
+  }
+
+  for (const SpanEvent& item : data.events) {
+    const std::size_t event_position =
+        protobuf::begin_message(destination, span::span_events);
+    protobuf::pack_fixed64(destination, span_event::time_unix_nano,
+                           unix_nanoseconds(item.time));
+    pack_text(destination, span_event::name, item.name);
+    for (const auto& [key, value] : item.attributes) {
+      pack_attribute(destination, span_event::attributes, key, value);
+    }
+    protobuf::end_message(destination, event_position);
+  }
+
+  protobuf::end_message(destination, length_position);
+}
+
+// Append to the specified `destination` the specified `spans` as a `chunks`
+// field of a `TracerPayload`.  The chunk's priority is that of the first span
+// that has one, which is the local root span.  `spans` must not be empty.
+void encode_chunk(std::string& destination,
+                  const std::vector<std::unique_ptr<SpanData>>& spans) {
+  const std::size_t length_position =
+      protobuf::begin_message(destination, tracer_payload::chunks);
+
+  std::int32_t priority = trace_chunk::priority_none;
+  for (const auto& span_ptr : spans) {
+    const auto found =
+        span_ptr->numeric_tags.find(tags::internal::sampling_priority);
+    if (found != span_ptr->numeric_tags.end()) {
+      priority = std::int32_t(found->second);
+      break;
+    }
+  }
+  // Negative integers are encoded as ten byte varints.
+  protobuf::pack_uint64(destination, trace_chunk::priority,
+                        std::uint64_t(std::int64_t(priority)));
+  if (const std::string* origin =
+          find_tag(*spans.front(), tags::internal::origin)) {
+    pack_text(destination, trace_chunk::origin, *origin);
+  }
+  for (const auto& span_ptr : spans) {
+    assert(span_ptr);
+    encode_span(destination, *span_ptr);
+  }
+
+  protobuf::end_message(destination, length_position);
+}
+
+// Return the element of the specified `groups` having the specified
+// `environment` and `version`, adding one if there is none.
+DatadogIntake::TracerPayload& tracer_payload_for(
+    std::vector<DatadogIntake::TracerPayload>& groups, StringView environment,
+    StringView version) {
+  for (auto& group : groups) {
+    if (group.environment == environment && group.version == version) {
+      return group;
+    }
+  }
+  auto& group = groups.emplace_back();
+  group.environment = std::string(environment);
+  group.version = std::string(version);
+  return group;
+}
+
+}  // namespace
+
+// `Retries` holds the payloads that failed to be sent, until they are sent
+// again.  It is shared with the callbacks of requests, which can outlive the
+// `DatadogIntake`.
+struct DatadogIntake::Retries {
+  std::mutex mutex;
+  // Guarded by `mutex`.
+  std::vector<std::shared_ptr<Payload>> payloads;
+  // The total size of `payloads`.  Guarded by `mutex`.
+  std::size_t bytes = 0;
+  const std::size_t max_retries;
+  const std::size_t budget_bytes;
+  const Clock clock;
+
+  Retries(std::size_t max_retries, std::size_t budget_bytes,
+          const Clock& clock)
+      : max_retries(max_retries), budget_bytes(budget_bytes), clock(clock) {}
+
+  // Keep the specified `payload` to be sent again after a backoff, unless it
+  // was already retried `max_retries` times or keeping it would exceed
+  // `budget_bytes`.  Return whether the payload was kept.
+  bool retry_later(const std::shared_ptr<Payload>& payload) {
+    if (payload->attempts > max_retries) {
+      return false;
+    }
+    const auto delay = retry_backoff(payload->attempts);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes + payload->body.size() > budget_bytes) {
+      return false;
+    }
+    payload->retry_after = clock().tick + delay;
+    bytes += payload->body.size();
+    payloads.push_back(payload);
+    return true;
+  }
+
+  // Remove and return the payloads whose backoff has elapsed, or all of them
+  // if the specified `all` is true.
+  std::vector<std::shared_ptr<Payload>> take_due(bool all) {
+    const auto now = clock().tick;
+    std::vector<std::shared_ptr<Payload>> due;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto waiting = std::partition(
+        payloads.begin(), payloads.end(), [&](const auto& payload) {
+          return !all && payload->retry_after > now;
+        });
+    for (auto iter = waiting; iter != payloads.end(); ++iter) {
+      bytes -= (*iter)->body.size();
+      due.push_back(std::move(*iter));
+    }
+    payloads.erase(waiting, payloads.end());
+    return due;
+  }
+};
+
+struct DatadogIntake::Handoff {
+  std::shared_mutex mutex;
+  // Guarded by `mutex`, which tasks lock in shared mode while they flush, so
+  // that the intake is not destroyed during a flush.
+  DatadogIntake* intake;
+
+  explicit Handoff(DatadogIntake* intake) : intake(intake) {}
+};
+
+DatadogIntake::DatadogIntake(const FinalizedDatadogIntakeConfig& config,
+                             const std::shared_ptr<Logger>& logger,
+                             const TracerSignature& tracer_signature)
+    : clock_(config.clock),
+      logger_(logger),
+      buffered_bytes_(0),
+      flush_posted_(false),
+      flush_threshold_bytes_(config.flush_threshold_bytes),
+      max_buffered_bytes_(config.max_buffered_bytes),
+      compression_enabled_(config.compression_enabled),
+      compression_level_(config.compression_level),
+      traces_endpoint_(config.url),
+      http_client_(config.http_client),
+      event_scheduler_(config.event_scheduler),
+      flush_interval_(config.flush_interval),
+      request_timeout_(config.request_timeout),
+      shutdown_timeout_(config.shutdown_timeout),
+      retries_(std::make_shared<Retries>(
+          config.max_retries, config.retry_budget_bytes, config.clock)),
+      handoff_(std::make_shared<Handoff>(this)) {
+  assert(logger_);
+
+  pack_text(tracer_fields_, tracer_payload::language_name, "cpp");
+  pack_text(tracer_fields_, tracer_payload::language_version,
+            tracer_signature.library_language_version);
+  pack_text(tracer_fields_, tracer_payload::tracer_version,
+            tracer_signature.library_version);
+  pack_text(tracer_fields_, tracer_payload::runtime_id,
+            tracer_signature.runtime_id.string());
+
+  headers_.emplace("Content-Type", "application/x-protobuf");
+  headers_.emplace("DD-API-KEY", config.api_key);
+  headers_.emplace("Datadog-Meta-Lang", "cpp");
+  headers_.emplace("Datadog-Meta-Lang-Version",
+                   tracer_signature.library_language_version);
+  headers_.emplace("Datadog-Meta-Tracer-Version",
+                   tracer_signature.library_version);
+
+  tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
+      config.flush_interval, [this]() { flush(false); }));
+}
+
+DatadogIntake::~DatadogIntake() {
+  shut_down(clock_().tick + shutdown_timeout_);
+}
+
+void DatadogIntake::shut_down(std::chrono::steady_clock::time_point deadline) {
+  shut_down_collector(
+      shut_down_once_, tasks_,
+      [this](std::chrono::steady_clock::time_point) {
+        {
+          // Wait for a posted flush that is in progress, and prevent those
+          // not yet invoked from flushing.  The final flush happens here
+          // instead, since the event scheduler might not invoke them.
+          std::lock_guard<std::shared_mutex> lock(handoff_->mutex);
+          handoff_->intake = nullptr;
+        }
+        flush(true);
+      },
+      *http_client_, deadline);
+}
+
+Expected<void> DatadogIntake::send(
+    std::vector<std::unique_ptr<SpanData>>&& spans,
+    const std::shared_ptr<TraceSampler>& /*response_handler*/) {
+  if (spans.empty()) {
+    return nullopt;
+  }
+
+  std::string encoded;
+  auto beg = std::chrono::steady_clock::now();
+  encode_chunk(encoded, spans);
+  auto end = std::chrono::steady_clock::now();
+
+  telemetry::distribution::add(
+      metrics::tracer::trace_chunk_serialization_duration,
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+  OverheadGovernor::add_cost(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+
+  const SpanData& root = *spans.front();
+  const StringView environment = root.environment().value_or("");
+  const StringView version = root.version().value_or("");
+
+  bool post = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffered_bytes_ + encoded.size() > max_buffered_bytes_) {
+      telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                    {"reason:overfull_buffer"});
+      spans.clear();
+      return nullopt;
+    }
+    buffered_bytes_ += encoded.size();
+    auto& group = tracer_payload_for(tracer_payloads_, environment, version);
+    group.chunks += encoded;
+    ++group.trace_count;
+    // The batch is large enough to send now, rather than wait for the next
+    // flush interval.
+    if (buffered_bytes_ >= flush_threshold_bytes_ && !flush_posted_) {
+      flush_posted_ = post = true;
+    }
+  }
+  spans.clear();
+
+  if (post) {
+    post_flush();
+  }
+  return nullopt;
+}
+
+void DatadogIntake::post_flush() {
+  event_scheduler_->post([handoff = handoff_]() {
+    std::shared_lock<std::shared_mutex> lock(handoff->mutex);
+    if (handoff->intake) {
+      handoff->intake->flush(false);
+    }
+  });
+}
+
+void DatadogIntake::flush(bool force) {
+  // When shutting down, send the payloads that failed to be sent regardless
+  // of their backoff.
+  for (auto& payload : retries_->take_due(force)) {
+    send_payload(std::move(payload));
+  }
+
+  std::vector<TracerPayload> tracer_payloads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_posted_ = false;
+    using std::swap;
+    swap(tracer_payloads, tracer_payloads_);
+    buffered_bytes_ = 0;
+  }
+  if (tracer_payloads.empty()) {
+    return;
+  }
+
+  if (auto payload = make_payload(std::move(tracer_payloads))) {
+    send_payload(std::move(payload));
+  }
+}
+
+std::shared_ptr<DatadogIntake::Payload> DatadogIntake::make_payload(
+    std::vector<TracerPayload>&& tracer_payloads) {
+  auto payload = std::make_shared<Payload>();
+  std::string& body = payload->body;
+
+  // Each `TracerPayload` consists of `tracer_fields_`, its environment and
+  // version, and its chunks, and so its size is known before its chunks are
+  // copied.
+  for (TracerPayload& group : tracer_payloads) {
+    std::string fields = tracer_fields_;
+    if (!group.environment.empty()) {
+      pack_text(fields, tracer_payload::env, group.environment);
+    }
+    if (!group.version.empty()) {
+      pack_text(fields, tracer_payload::app_version, group.version);
+    }
+    protobuf::pack_message_header(body, agent_payload::tracer_payloads,
+                                  fields.size() + group.chunks.size());
+    body += fields;
+    body += group.chunks;
+    // Release each group once it is copied, so that the batch is not held in
+    // memory twice.
+    std::string().swap(group.chunks);
+    payload->trace_count += group.trace_count;
+  }
+  telemetry::distribution::add(metrics::tracer::trace_chunk_serialized_bytes,
+                               static_cast<uint64_t>(body.size()));
+
+  if (compression_enabled_ && body.size() >= compression_min_bytes) {
+    std::string compressed;
+    auto compress_result = gzip_compress(compressed, body, compression_level_);
+    if (auto* error = compress_result.if_error()) {
+      logger_->log_error(*error);
+      return nullptr;
+    }
+    telemetry::distribution::add(metrics::tracer::trace_chunk_compressed_bytes,
+                                 static_cast<uint64_t>(compressed.size()));
+    body = std::move(compressed);
+    payload->compressed = true;
+  }
+
+  return payload;
+}
+
+void DatadogIntake::send_payload(std::shared_ptr<Payload>&& payload) {
+  ++payload->attempts;
+
+  auto set_request_headers = [this, payload](DictWriter& writer) {
+    writer.set("X-Datadog-Trace-Count", std::to_string(payload->trace_count));
+    if (payload->compressed) {
+      writer.set("Content-Encoding", "gzip");
+    }
+    for (const auto& [key, value] : headers_) {
+      writer.set(key, value);
+    }
+  };
+
+  auto on_response = [payload, retries = retries_, logger = logger_](
+                         int response_status,
+                         const DictReader& /*response_headers*/,
+                         std::string response_body) {
+    if (response_status >= 200 && response_status < 300) {
+      telemetry::counter::increment(metrics::tracer::api::responses,
+                                    {"status_code:2xx"});
+      return;
+    }
+    telemetry::counter::increment(
+        metrics::tracer::api::responses,
+        {response_status >= 500   ? "status_code:5xx"
+         : response_status >= 400 ? "status_code:4xx"
+                                  : "status_code:3xx"});
+    // The Datadog intake might be overloaded, in which case sending the
+    // payload again later might succeed.
+    const bool retrying =
+        (response_status >= 500 || response_status == 429) &&
+        retries->retry_later(payload);
+    logger->log_error([&](auto& stream) {
+      stream << "Unexpected response status " << response_status
+             << " in Datadog intake response with body of length "
+             << response_body.size() << " (starts on next line):\n"
+             << response_body;
+      if (retrying) {
+        stream << "\nThe payload will be sent again later.";
+      }
+    });
+  };
+
+  auto on_error = [payload, retries = retries_,
+                   logger = logger_](Error error) {
+    telemetry::counter::increment(metrics::tracer::api::errors,
+                                  {"type:network"});
+    const bool retrying = retries->retry_later(payload);
+    logger->log_error(error.with_prefix(
+        retrying ? "Error occurred during HTTP request for submitting traces "
+                   "to the Datadog intake (they will be sent again later): "
+                 : "Error occurred during HTTP request for submitting traces "
+                   "to the Datadog intake: "));
+  };
+
+  telemetry::counter::increment(metrics::tracer::api::requests);
+  if (payload->attempts > 1) {
+    telemetry::counter::increment(metrics::tracer::api::retries);
+  }
+  telemetry::distribution::add(metrics::tracer::api::bytes_sent,
+                               static_cast<uint64_t>(payload->body.size()));
+
+  // The body is copied, rather than moved, in case it is sent again.
+  auto post_result =
+      http_client_->post(traces_endpoint_, std::move(set_request_headers),
+                         payload->body, std::move(on_response),
+                         std::move(on_error), clock_().tick + request_timeout_);
+  if (auto* error = post_result.if_error()) {
+    telemetry::counter::increment(metrics::tracer::api::errors,
+                                  {"type:network"});
+    logger_->log_error(
+        error->with_prefix("Unexpected error submitting traces: "));
+  }
+}
+
+std::string DatadogIntake::config() const {
+  // clang-format off
+  return nlohmann::json::object({
+    {"type", "datadog::tracing::DatadogIntake"},
+    {"config", nlohmann::json::object({
+      {"traces_url", to_url_string(traces_endpoint_)},
+      {"flush_interval_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_).count() },
+      {"request_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(request_timeout_).count() },
+      {"shutdown_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(shutdown_timeout_).count() },
+      {"flush_threshold_bytes", flush_threshold_bytes_},
+      {"max_buffered_bytes", max_buffered_bytes_},
+      {"compression_enabled", compression_enabled_},
+      {"compression_level", compression_level_},
+      {"max_retries", retries_->max_retries},
+      {"retry_budget_bytes", retries_->budget_bytes},
+      {"http_client", nlohmann::json::parse(http_client_->config())},
+      {"event_scheduler", nlohmann::json::parse(event_scheduler_->config())},
+    })},
+  }).dump();
+  // clang-format on
+}
+
+}  // namespace tracing
+}  // namespace datadog
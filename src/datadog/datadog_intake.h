@@ -0,0 +1,136 @@
+#pragma once
+
+// This component provides a `class`, `DatadogIntake`, that implements the
+// `Collector` interface in terms of HTTP requests sent directly to the Datadog
+// intake, without a Datadog Agent.
+//
+// `DatadogIntake` encodes each trace chunk when it is sent, in the protobuf
+// format of the agentless traces API, and buffers the encoded chunks until
+// they reach a size threshold or until the next flush interval.  Reaching the
+// threshold posts a flush to the event scheduler, so that requests are made
+// off of the thread that finished the trace.  A payload that fails to be sent
+// because the intake could not be reached, or responded with status 429 or
+// 5xx, is sent again by a later flush after a backoff, as by `DatadogAgent`
+// (see `retry_backoff.h`).  The buffered chunks are sent when the
+// `DatadogIntake` is destroyed.  Unlike `DatadogAgent`, `DatadogIntake`
+// receives no sample rates in response, and it does not poll for Remote
+// Configuration.
+//
+// `DatadogIntake` is configured by `DatadogIntakeConfig`.  See
+// `datadog_intake_config.h`.
+
+#include <datadog/clock.h>
+#include <datadog/collector.h>
+#include <datadog/datadog_intake_config.h>
+#include <datadog/event_scheduler.h>
+#include <datadog/http_client.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+struct SpanData;
+class TraceSampler;
+struct TracerSignature;
+
+class DatadogIntake : public Collector {
+ public:
+  // `TracerPayload` is the encoding of the trace chunks that have the same
+  // environment and version, each of which is a `chunks` field of an
+  // agentless `TracerPayload` message.
+  struct TracerPayload {
+    std::string environment;
+    std::string version;
+    std::string chunks;
+    std::size_t trace_count = 0;
+  };
+
+ private:
+  // `Payload` is a request body, kept until it is sent successfully or
+  // dropped.
+  struct Payload {
+    std::string body;
+    std::size_t trace_count = 0;
+    bool compressed = false;
+    // The number of times that the payload has been sent.
+    std::size_t attempts = 0;
+    // If the payload is waiting to be sent again, when it may be.
+    std::chrono::steady_clock::time_point retry_after;
+  };
+  struct Retries;
+  // `Handoff` lets a flush posted to the event scheduler find this object,
+  // unless it was shut down before the flush was invoked.
+  struct Handoff;
+
+  std::mutex mutex_;
+  Clock clock_;
+  std::shared_ptr<Logger> logger_;
+  // The encodings of the trace chunks not yet sent.  Guarded by `mutex_`.
+  std::vector<TracerPayload> tracer_payloads_;
+  // The total size of the `chunks` of `tracer_payloads_`.  Guarded by
+  // `mutex_`.
+  std::size_t buffered_bytes_;
+  // Whether a flush was posted and has not yet begun, so that reaching the
+  // flush threshold again does not post another.  Guarded by `mutex_`.
+  bool flush_posted_;
+  const std::size_t flush_threshold_bytes_;
+  const std::size_t max_buffered_bytes_;
+  const bool compression_enabled_;
+  const int compression_level_;
+  HTTPClient::URL traces_endpoint_;
+  std::shared_ptr<HTTPClient> http_client_;
+  std::shared_ptr<EventScheduler> event_scheduler_;
+  std::vector<EventScheduler::Cancel> tasks_;
+  std::chrono::steady_clock::duration flush_interval_;
+  std::chrono::steady_clock::duration request_timeout_;
+  std::chrono::steady_clock::duration shutdown_timeout_;
+  // Shared with the callbacks of requests, which can outlive this object.
+  std::shared_ptr<Retries> retries_;
+  std::shared_ptr<Handoff> handoff_;
+  // Used by `shut_down_collector`, so that this collector shuts down once.
+  std::once_flag shut_down_once_;
+
+  // The fields of each `TracerPayload` message that are the same for every
+  // payload, already encoded.
+  std::string tracer_fields_;
+  std::unordered_map<std::string, std::string> headers_;
+
+  // Post a call to `flush` to the event scheduler.
+  void post_flush();
+  // Send the buffered trace chunks to the Datadog intake, and send again the
+  // payloads whose backoff has elapsed, or all of them if the specified
+  // `force` is true.
+  void flush(bool force);
+  // Return a payload of the specified `tracer_payloads`, or null if it could
+  // not be made.
+  std::shared_ptr<Payload> make_payload(
+      std::vector<TracerPayload>&& tracer_payloads);
+  // Send the specified `payload` to the Datadog intake.
+  void send_payload(std::shared_ptr<Payload>&& payload);
+
+ public:
+  DatadogIntake(const FinalizedDatadogIntakeConfig&,
+                const std::shared_ptr<Logger>&, const TracerSignature&);
+  ~DatadogIntake();
+
+  void shut_down(std::chrono::steady_clock::time_point deadline) override;
+
+  Expected<void> send(
+      std::vector<std::unique_ptr<SpanData>>&& spans,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+
+  std::string config() const override;
+
+  bool accepts_shared_tags() const override { return true; }
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,123 @@
+#include <datadog/datadog_intake_config.h>
+#include <datadog/environment.h>
+
+#include <chrono>
+#include <cstddef>
+
+#include "compression.h"
+#include "default_http_client.h"
+#include "thread_generator.h"
+#include "threaded_event_scheduler.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<FinalizedDatadogIntakeConfig> finalize_config(
+    const DatadogIntakeConfig& user_config,
+    const std::shared_ptr<Logger>& logger, const Clock& clock) {
+  FinalizedDatadogIntakeConfig result;
+
+  result.clock = clock;
+
+  auto validated = validate(user_config.background_threads);
+  if (auto* error = validated.if_error()) {
+    return error->with_prefix("DatadogIntake: ");
+  }
+
+  result.background_threads = user_config.background_threads;
+  result.default_http_client = !user_config.http_client;
+  if (!user_config.http_client) {
+    result.http_client = shared_default_http_client(
+        logger, clock, {}, user_config.background_threads);
+    if (!result.http_client) {
+      return Error{Error::DATADOG_INTAKE_NULL_HTTP_CLIENT,
+                   "DatadogIntake: HTTP client cannot be null."};
+    }
+  } else {
+    result.http_client = user_config.http_client;
+  }
+
+  result.default_event_scheduler = !user_config.event_scheduler;
+  if (!user_config.event_scheduler) {
+    result.event_scheduler = ThreadedEventScheduler::shared_instance(
+        user_config.background_threads, logger);
+  } else {
+    result.event_scheduler = user_config.event_scheduler;
+  }
+
+  if (auto api_key = lookup(environment::DD_API_KEY)) {
+    result.api_key = std::string(*api_key);
+  } else if (user_config.api_key) {
+    result.api_key = *user_config.api_key;
+  }
+  if (result.api_key.empty()) {
+    return Error{Error::DATADOG_INTAKE_MISSING_API_KEY,
+                 "DatadogIntake: An API key is required to send traces "
+                 "directly to Datadog.  Set DD_API_KEY."};
+  }
+
+  std::string url;
+  if (user_config.url) {
+    url = *user_config.url;
+  } else {
+    url = "https://trace.agent.";
+    if (auto site = lookup(environment::DD_SITE)) {
+      append(url, *site);
+    } else {
+      url += user_config.site.value_or("datadoghq.com");
+    }
+    url += "/api/v0.2/traces";
+  }
+  auto parsed_url = HTTPClient::URL::parse(url);
+  if (auto* error = parsed_url.if_error()) {
+    return error->with_prefix("DatadogIntake: ");
+  }
+  result.url = std::move(*parsed_url);
+
+  const int flush_interval_milliseconds =
+      user_config.flush_interval_milliseconds.value_or(10000);
+  const int request_timeout_milliseconds =
+      user_config.request_timeout_milliseconds.value_or(10000);
+  const int shutdown_timeout_milliseconds =
+      user_config.shutdown_timeout_milliseconds.value_or(10000);
+  if (flush_interval_milliseconds <= 0 || request_timeout_milliseconds <= 0 ||
+      shutdown_timeout_milliseconds <= 0) {
+    return Error{Error::DATADOG_INTAKE_INVALID_INTERVAL,
+                 "DatadogIntake: Flush interval, request timeout, and shutdown "
+                 "timeout must be positive numbers of milliseconds."};
+  }
+  result.flush_interval =
+      std::chrono::milliseconds(flush_interval_milliseconds);
+  result.request_timeout =
+      std::chrono::milliseconds(request_timeout_milliseconds);
+  result.shutdown_timeout =
+      std::chrono::milliseconds(shutdown_timeout_milliseconds);
+
+  result.flush_threshold_bytes =
+      user_config.flush_threshold_bytes.value_or(2 * 1024 * 1024);
+  result.max_buffered_bytes =
+      user_config.max_buffered_bytes.value_or(32 * 1024 * 1024);
+  if (result.flush_threshold_bytes == 0 ||
+      result.max_buffered_bytes < result.flush_threshold_bytes) {
+    return Error{Error::DATADOG_INTAKE_INVALID_BUFFER_LIMITS,
+                 "DatadogIntake: Flush threshold must be a positive number of "
+                 "bytes, and at most the maximum buffered bytes."};
+  }
+
+  result.compression_enabled =
+      user_config.compression_enabled.value_or(true) && gzip_available();
+  result.compression_level = user_config.compression_level.value_or(6);
+  if (result.compression_level < 1 || result.compression_level > 9) {
+    return Error{Error::DATADOG_INTAKE_INVALID_COMPRESSION_LEVEL,
+                 "DatadogIntake: Compression level must be between 1 and 9."};
+  }
+
+  result.max_retries = user_config.max_retries.value_or(3);
+  result.retry_budget_bytes =
+      user_config.retry_budget_bytes.value_or(16 * 1024 * 1024);
+
+  return result;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,230 @@
+#include "datagram_collector.h"
+
+#include <datadog/logger.h>
+#include <datadog/telemetry/telemetry.h>
+
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <utility>
+
+#include "json.hpp"
+#include "msgpack.h"
+#include "overhead_governor.h"
+#include "platform_util.h"
+#include "span_data.h"
+#include "telemetry_metrics.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+const char* to_string(DatagramSocketType type) {
+  switch (type) {
+    case DatagramSocketType::SEQPACKET:
+      return "seqpacket";
+    case DatagramSocketType::DATAGRAM:
+    default:
+      return "datagram";
+  }
+}
+
+}  // namespace
+
+DatagramCollector::DatagramCollector(
+    const FinalizedDatagramCollectorConfig& config,
+    const std::shared_ptr<Logger>& logger)
+    : clock_(config.clock),
+      logger_(logger),
+      socket_path_(config.socket_path),
+      socket_type_(config.socket_type),
+      max_datagram_bytes_(config.max_datagram_bytes),
+      reconnect_interval_(config.reconnect_interval),
+      socket_(-1),
+      next_connect_(clock_().tick),
+      unreachable_(false),
+      dropped_would_block_(0),
+      dropped_too_large_(0),
+      dropped_unreachable_(0) {
+  assert(logger_);
+
+  std::lock_guard<std::shared_mutex> lock(mutex_);
+  connect();
+}
+
+DatagramCollector::~DatagramCollector() {
+  if (socket_ != -1) {
+    close_datagram_socket(socket_);
+  }
+}
+
+Expected<void> DatagramCollector::send(
+    std::vector<std::unique_ptr<SpanData>>&& spans,
+    const std::shared_ptr<TraceSampler>& response_handler) {
+  TraceChunk chunk;
+  chunk.spans = std::move(spans);
+  return send_chunk(std::move(chunk), response_handler);
+}
+
+Expected<void> DatagramCollector::send_chunk(
+    TraceChunk&& chunk, const std::shared_ptr<TraceSampler>&) {
+  // Each datagram is a payload of one trace chunk, encoded into a buffer that
+  // the sending thread reuses.
+  thread_local std::string datagram;
+  datagram.clear();
+  auto result = msgpack::pack_array(datagram, 1);
+  if (!chunk.encoded.empty()) {
+    // The chunk's producer already encoded it.
+    datagram += chunk.encoded;
+  } else if (result) {
+    auto beg = std::chrono::steady_clock::now();
+    result = msgpack_encode(datagram, chunk.spans);
+    auto end = std::chrono::steady_clock::now();
+
+    telemetry::distribution::add(
+        metrics::tracer::trace_chunk_serialization_duration,
+        std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+            .count());
+    OverheadGovernor::add_cost(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+  }
+  if (auto* error = result.if_error()) {
+    return std::move(*error);
+  }
+
+  // The spans are no longer needed, so release them before sending.
+  chunk.spans.clear();
+
+  if (datagram.size() > max_datagram_bytes_) {
+    count_dropped(dropped_too_large_, "reason:oversized_chunk");
+    return nullopt;
+  }
+  telemetry::distribution::add(metrics::tracer::trace_chunk_serialized_bytes,
+                               static_cast<uint64_t>(datagram.size()));
+
+  send_datagram(datagram);
+  return nullopt;
+}
+
+void DatagramCollector::send_datagram(const std::string& datagram) {
+  int failed_socket;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    failed_socket = socket_;
+    if (socket_ != -1 &&
+        !failed(tracing::send_datagram(socket_, datagram.data(),
+                                       datagram.size()))) {
+      return;
+    }
+  }
+
+  // The socket is not connected, or sending on it failed.  If another thread
+  // is already reconnecting it, then drop the chunk rather than wait.
+  std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    count_dropped(dropped_unreachable_, "reason:unreachable");
+    return;
+  }
+  if (failed_socket != -1 && socket_ == failed_socket) {
+    disconnect();
+    // Reconnect right away, in case the receiver was restarted.
+    next_connect_ = clock_().tick;
+  }
+  connect();
+  if (socket_ == -1) {
+    count_dropped(dropped_unreachable_, "reason:unreachable");
+    return;
+  }
+  if (!failed(tracing::send_datagram(socket_, datagram.data(),
+                                     datagram.size()))) {
+    unreachable_ = false;
+    return;
+  }
+  // The socket was just connected, but the receiver is already gone.  It is
+  // connected again no sooner than the reconnect interval.
+  disconnect();
+  count_dropped(dropped_unreachable_, "reason:unreachable");
+}
+
+bool DatagramCollector::failed(DatagramStatus status) {
+  switch (status) {
+    case DatagramStatus::SENT:
+      return false;
+    case DatagramStatus::WOULD_BLOCK:
+      count_dropped(dropped_would_block_, "reason:overfull_buffer");
+      return false;
+    case DatagramStatus::TOO_LARGE:
+      count_dropped(dropped_too_large_, "reason:oversized_chunk");
+      return false;
+    case DatagramStatus::FAILED:
+    default:
+      return true;
+  }
+}
+
+void DatagramCollector::connect() {
+  if (socket_ != -1) {
+    return;
+  }
+  const auto now = clock_().tick;
+  if (now < next_connect_) {
+    return;
+  }
+  next_connect_ = now + reconnect_interval_;
+
+  auto connected = connect_unix_datagram_socket(
+      socket_path_, socket_type_ == DatagramSocketType::SEQPACKET);
+  if (auto* error = connected.if_error()) {
+    if (!unreachable_) {
+      unreachable_ = true;
+      logger_->log_error(error->with_prefix(
+          "DatagramCollector: Trace chunks will be dropped until the socket "
+          "can be connected: "));
+    }
+    return;
+  }
+  socket_ = *connected;
+}
+
+void DatagramCollector::disconnect() {
+  close_datagram_socket(socket_);
+  socket_ = -1;
+  if (!unreachable_) {
+    unreachable_ = true;
+    logger_->log_error([&](auto& stream) {
+      stream << "DatagramCollector: Unable to send a trace chunk to "
+             << socket_path_ << ".  Reconnecting.";
+    });
+  }
+}
+
+void DatagramCollector::count_dropped(std::atomic<std::uint64_t>& counter,
+                                      const char* reason) {
+  counter.fetch_add(1, std::memory_order_relaxed);
+  telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                {reason});
+}
+
+void DatagramCollector::add_runtime_stats(RuntimeStats& stats) const {
+  stats.dropped_trace_chunks +=
+      dropped_would_block_.load(std::memory_order_relaxed) +
+      dropped_too_large_.load(std::memory_order_relaxed) +
+      dropped_unreachable_.load(std::memory_order_relaxed);
+}
+
+std::string DatagramCollector::config() const {
+  // clang-format off
+  return nlohmann::json::object({
+    {"type", "datadog::tracing::DatagramCollector"},
+    {"config", nlohmann::json::object({
+      {"socket_path", socket_path_},
+      {"socket_type", to_string(socket_type_)},
+      {"max_datagram_bytes", max_datagram_bytes_},
+      {"reconnect_interval_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(reconnect_interval_).count() },
+    })},
+  }).dump();
+  // clang-format on
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,106 @@
+#pragma once
+
+// This component provides a `class`, `DatagramCollector`, that implements the
+// `Collector` interface by sending each trace chunk as one datagram over a
+// Unix domain socket, in the manner of DogStatsD, rather than in HTTP
+// requests to a Datadog Agent.
+//
+// `DatagramCollector` has no thread, no buffer, and no HTTP client.  Each
+// chunk is encoded to MessagePack on the thread that sends it, as a v0.4
+// traces payload containing just that chunk, and is written to the socket
+// without blocking.  A chunk is dropped, and counted as such, if the socket's
+// buffer is full, if the chunk is larger than a datagram, or if the receiver
+// cannot be reached.  Nothing is received in response, so the trace sampler
+// is not adjusted, and Remote Configuration is not polled.
+//
+// `DatagramCollector` is configured by `DatagramCollectorConfig`.  See
+// `datagram_collector_config.h`.
+
+#include <datadog/clock.h>
+#include <datadog/collector.h>
+#include <datadog/datagram_collector_config.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+enum class DatagramStatus : char;
+class Logger;
+struct SpanData;
+class TraceSampler;
+
+class DatagramCollector : public Collector {
+  Clock clock_;
+  std::shared_ptr<Logger> logger_;
+  const std::string socket_path_;
+  const DatagramSocketType socket_type_;
+  const std::size_t max_datagram_bytes_;
+  const std::chrono::steady_clock::duration reconnect_interval_;
+  // Datagrams are sent on `socket_` concurrently, while `mutex_` is shared.
+  // It is reconnected, or closed, while `mutex_` is held exclusively.  -1 if
+  // the socket is not connected.
+  mutable std::shared_mutex mutex_;
+  int socket_;
+  // When connecting may next be attempted.  Guarded by `mutex_`.
+  std::chrono::steady_clock::time_point next_connect_;
+  // Whether connecting or sending failed, and the socket has not been used
+  // successfully since, so that a failure is logged only once until the
+  // socket is usable again.  Guarded by `mutex_`.
+  bool unreachable_;
+  // The number of trace chunks dropped because the socket's buffer was full,
+  // because they were larger than a datagram, and because the receiver could
+  // not be reached.
+  std::atomic<std::uint64_t> dropped_would_block_;
+  std::atomic<std::uint64_t> dropped_too_large_;
+  std::atomic<std::uint64_t> dropped_unreachable_;
+
+  // Send the specified `datagram`, connecting the socket first if it is not
+  // connected and may be.
+  void send_datagram(const std::string& datagram);
+  // Return whether the specified `status` of sending a trace chunk means that
+  // the socket is unusable.  If the chunk was dropped for another reason,
+  // count it.
+  bool failed(DatagramStatus status);
+  // Connect the socket if it is not connected and the reconnect interval has
+  // passed since the previous attempt.  The behavior is undefined unless
+  // `mutex_` is held exclusively.
+  void connect();
+  // Close the socket after sending on it failed.  The behavior is undefined
+  // unless `mutex_` is held exclusively.
+  void disconnect();
+  // Count a trace chunk dropped for the specified `reason` tag, incrementing
+  // the specified `counter`.
+  void count_dropped(std::atomic<std::uint64_t>& counter, const char* reason);
+
+ public:
+  DatagramCollector(const FinalizedDatagramCollectorConfig&,
+                    const std::shared_ptr<Logger>&);
+  ~DatagramCollector();
+
+  DatagramCollector(const DatagramCollector&) = delete;
+
+  Expected<void> send(
+      std::vector<std::unique_ptr<SpanData>>&& spans,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+  Expected<void> send_chunk(
+      TraceChunk&& chunk,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+
+  std::string config() const override;
+
+  bool accepts_shared_tags() const override { return true; }
+
+  // Add the trace chunks that this collector dropped to the specified `stats`.
+  void add_runtime_stats(RuntimeStats& stats) const override;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,44 @@
+#include <datadog/datagram_collector_config.h>
+
+#include <chrono>
+
+namespace datadog {
+namespace tracing {
+
+Expected<FinalizedDatagramCollectorConfig> finalize_config(
+    const DatagramCollectorConfig& user_config, const Clock& clock) {
+  FinalizedDatagramCollectorConfig result;
+
+  result.clock = clock;
+
+  if (!user_config.socket_path || user_config.socket_path->empty()) {
+    return Error{Error::DATAGRAM_COLLECTOR_MISSING_SOCKET_PATH,
+                 "DatagramCollector: A socket path is required."};
+  }
+  result.socket_path = *user_config.socket_path;
+  result.socket_type =
+      user_config.socket_type.value_or(DatagramSocketType::DATAGRAM);
+
+  result.max_datagram_bytes =
+      user_config.max_datagram_bytes.value_or(64 * 1024);
+  if (result.max_datagram_bytes == 0) {
+    return Error{Error::DATAGRAM_COLLECTOR_INVALID_MAX_DATAGRAM_BYTES,
+                 "DatagramCollector: The maximum datagram size must be a "
+                 "positive number of bytes."};
+  }
+
+  const int reconnect_interval_milliseconds =
+      user_config.reconnect_interval_milliseconds.value_or(1000);
+  if (reconnect_interval_milliseconds <= 0) {
+    return Error{Error::DATAGRAM_COLLECTOR_INVALID_INTERVAL,
+                 "DatagramCollector: The reconnect interval must be a "
+                 "positive number of milliseconds."};
+  }
+  result.reconnect_interval =
+      std::chrono::milliseconds(reconnect_interval_milliseconds);
+
+  return result;
+}
+
+}  // namespace tracing
+}  // namespace datadog
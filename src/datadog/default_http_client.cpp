@@ -0,0 +1,59 @@
+#include "default_http_client.h"
+
+#include <datadog/datadog_agent_config.h>
+
+#include <mutex>
+
+#include "platform_util.h"
+#include "thread_generator.h"
+
+// This file provides `shared_default_http_client`, which is the same for
+// every `DD_TRACE_TRANSPORT`.
+
+namespace datadog {
+namespace tracing {
+
+std::shared_ptr<HTTPClient> shared_default_http_client(
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions& options, const ThreadOptions& threads) {
+  if (!is_default(threads)) {
+    return default_http_client(logger, clock, options,
+                               make_thread_generator(threads, "http", logger));
+  }
+  if (clock.target_type() != default_clock.target_type()) {
+    // The client measures its deadlines with `clock`, so it cannot be shared
+    // with components that use another clock.
+    return default_http_client(logger, clock, options, nullptr);
+  }
+
+  static std::mutex mutex;
+  // One instance for each combination of `options`.
+  static std::weak_ptr<HTTPClient> instances[4];
+  // The processes that created `instances`.  A forked process does not have
+  // an instance's thread.
+  static int owners[4] = {0, 0, 0, 0};
+
+  std::lock_guard<std::mutex> lock(mutex);
+  const int self = get_process_id();
+  const int index = int(options.http2) + 2 * int(options.io_uring);
+  auto& instance = instances[index];
+  int& owner = owners[index];
+  if (auto existing = instance.lock(); existing && owner == self) {
+    return existing;
+  }
+  auto created = default_http_client(logger, clock, options, nullptr);
+  instance = created;
+  owner = self;
+  return created;
+}
+
+DefaultHTTPClientOptions http_client_options(
+    const FinalizedDatadogAgentConfig& config) {
+  DefaultHTTPClientOptions options;
+  options.http2 = config.http2_enabled;
+  options.io_uring = config.io_uring_enabled;
+  return options;
+}
+
+}  // namespace tracing
+}  // namespace datadog
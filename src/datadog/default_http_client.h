@@ -1,24 +1,62 @@
 #pragma once
 
-// This component defines a function, `default_http_client`, that returns either
-// a `Curl` instance or `nullptr` depending on whether libcurl was included in
-// the build.
+// This component defines a function, `default_http_client`, that returns a
+// `Curl` instance, a `SocketHTTPClient` instance, a `WinHTTPClient` instance,
+// or `nullptr`, depending on the `DD_TRACE_TRANSPORT` with which this library
+// was built, and on the platform.
 //
-// `default_http_client` is implemented in either `default_http_client_curl.cpp`
-// or `default_http_client_null.cpp`.
+// `default_http_client` is implemented in `default_http_client_curl.cpp`,
+// `default_http_client_native.cpp`, `default_http_client_winhttp.cpp`, or
+// `default_http_client_null.cpp`.
+//
+// If `options.http2` is true and the returned client is a `Curl` instance, then
+// the client sends requests using HTTP/2 (see `CurlOptions::http2`).  If
+// `options.io_uring` is true and the returned client is a `SocketHTTPClient`
+// instance, then the client uses io_uring where it is available (see
+// `SocketHTTPClientOptions::io_uring`).  If `make_thread` is not empty, then
+// the client creates its thread using it.
+//
+// `shared_default_http_client`, implemented in `default_http_client.cpp`,
+// returns one such client for the whole process, so that the tracers in the
+// process share its thread and connections.  If `threads` configures the
+// client's thread, then the client is not shared.
 
 #include <datadog/clock.h>
+#include <datadog/thread_options.h>
 
 #include <memory>
 
 namespace datadog {
 namespace tracing {
 
+struct FinalizedDatadogAgentConfig;
 class HTTPClient;
 class Logger;
 
+struct DefaultHTTPClientOptions {
+  bool http2 = false;
+  bool io_uring = false;
+};
+
 std::shared_ptr<HTTPClient> default_http_client(
-    const std::shared_ptr<Logger>& logger, const Clock& clock);
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions& options,
+    const ThreadGenerator& make_thread);
+
+// Return the result of `default_http_client` that is shared by the components
+// of this process that use the default HTTP client, creating it if it does not
+// exist.  The shared client logs using the specified `logger` of whichever
+// component created it.  If the specified `clock` is not `default_clock`, or
+// the specified `threads` are not the default, then return a client that is
+// not shared, whose thread has the options `threads`.
+std::shared_ptr<HTTPClient> shared_default_http_client(
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions& options, const ThreadOptions& threads);
+
+// Return the options of the default HTTP client of a `DatadogAgent` that has
+// the specified `config`.
+DefaultHTTPClientOptions http_client_options(
+    const FinalizedDatadogAgentConfig& config);
 
 }  // namespace tracing
 }  // namespace datadog
@@ -12,8 +12,16 @@ namespace datadog {
 namespace tracing {
 
 std::shared_ptr<HTTPClient> default_http_client(
-    const std::shared_ptr<Logger>& logger, const Clock& clock) {
-  return std::make_shared<Curl>(logger, clock);
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions& options,
+    const ThreadGenerator& make_thread) {
+  CurlOptions curl_options;
+  curl_options.http2 = options.http2;
+  curl_options.dns_cache_ttl = std::chrono::minutes(1);
+  if (make_thread) {
+    return std::make_shared<Curl>(logger, clock, make_thread, curl_options);
+  }
+  return std::make_shared<Curl>(logger, clock, curl_options);
 }
 
 }  // namespace tracing
@@ -0,0 +1,27 @@
+#include "default_http_client.h"
+#include "socket_http_client.h"
+
+// This file is included in the build when `DD_TRACE_TRANSPORT` is "native".
+// It provides an implementation of `default_http_client` that returns a
+// `SocketHTTPClient` instance, which does not depend on libcurl.
+//
+// `SocketHTTPClient` speaks only HTTP/1.1, so `options.http2` is ignored.
+
+namespace datadog {
+namespace tracing {
+
+std::shared_ptr<HTTPClient> default_http_client(
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions& options,
+    const ThreadGenerator& make_thread) {
+  SocketHTTPClientOptions socket_options;
+  socket_options.io_uring = options.io_uring;
+  if (make_thread) {
+    return std::make_shared<SocketHTTPClient>(logger, clock, make_thread,
+                                              socket_options);
+  }
+  return std::make_shared<SocketHTTPClient>(logger, clock, socket_options);
+}
+
+}  // namespace tracing
+}  // namespace datadog
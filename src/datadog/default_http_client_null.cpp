@@ -9,8 +9,9 @@
 namespace datadog {
 namespace tracing {
 
-std::shared_ptr<HTTPClient> default_http_client(const std::shared_ptr<Logger> &,
-                                                const Clock &) {
+std::shared_ptr<HTTPClient> default_http_client(
+    const std::shared_ptr<Logger> &, const Clock &,
+    const DefaultHTTPClientOptions &, const ThreadGenerator &) {
   return nullptr;
 }
 
@@ -0,0 +1,21 @@
+#include "default_http_client.h"
+#include "winhttp_client.h"
+
+// This file is included in the build on Windows when `DD_TRACE_TRANSPORT` is
+// "native".  It provides an implementation of `default_http_client` that
+// returns a `WinHTTPClient` instance, which does not depend on libcurl.
+//
+// `WinHTTPClient` has no thread of its own, so `make_thread` is ignored, and
+// WinHTTP chooses the protocol version, so `options` are ignored too.
+
+namespace datadog {
+namespace tracing {
+
+std::shared_ptr<HTTPClient> default_http_client(
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const DefaultHTTPClientOptions&, const ThreadGenerator&) {
+  return std::make_shared<WinHTTPClient>(logger, clock);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,55 @@
+#pragma once
+
+// This component provides a `class`, `DefaultIDGenerator`, that is the
+// `IDGenerator` returned by `default_id_generator`.
+//
+// `DefaultIDGenerator` is `final`, and its member functions are defined here,
+// so that code that knows it is using the default generator (see
+// `TraceSegment::generate_span_id`) can generate IDs without a virtual call.
+
+#include <datadog/id_generator.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "random.h"
+
+namespace datadog {
+namespace tracing {
+
+class DefaultIDGenerator final : public IDGenerator {
+  const bool trace_id_128_bit_;
+
+ public:
+  explicit DefaultIDGenerator(bool trace_id_128_bit)
+      : trace_id_128_bit_(trace_id_128_bit) {}
+
+  TraceID trace_id(const TimePoint& start) const override {
+    TraceID result;
+    result.low = random_uint64();
+    if (trace_id_128_bit_) {
+      // Highest 32 bits contain a unix timestamp (the trace start time).
+      const auto since_epoch = start.wall.time_since_epoch();
+      const auto seconds =
+          std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+      // The farthest we'll go back is the unix epoch.
+      const std::uint64_t unsigned_seconds = seconds < 0 ? 0 : seconds;
+      result.high = unsigned_seconds << 32;
+    } else {
+      // In 64-bit mode, zero the most significant bit for compatibility with
+      // older tracers that can't accept values above
+      // `numeric_limits<int64_t>::max()`.
+      result.low &= ~(std::uint64_t(1) << 63);
+    }
+    return result;
+  }
+
+  std::uint64_t span_id() const override {
+    // Zero the most significant bit for compatibility with older tracers that
+    // can't accept values above `numeric_limits<int64_t>::max()`.
+    return random_uint64() & ~(std::uint64_t(1) << 63);
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
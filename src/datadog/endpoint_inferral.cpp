@@ -1,6 +1,13 @@
 #include "endpoint_inferral.h"
 
+#include <datadog/telemetry/telemetry.h>
+
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <functional>
+
+#include "telemetry_metrics.h"
 
 namespace datadog::tracing {
 
@@ -41,6 +48,32 @@ static constexpr auto all_components =
     is_int | is_int_id | is_hex | is_hex_id | is_str;
 static_assert(all_components == (is_str << 1) - 1);
 
+// The class of a character is a bitset of the component types that allow the
+// character, and of the following flags.
+constexpr std::uint8_t digit_flag = is_str << 1;
+constexpr std::uint8_t special_char_flag = is_str << 2;
+
+constexpr std::array<std::uint8_t, 256> make_char_classes() {
+  std::array<std::uint8_t, 256> classes{};
+  for (std::size_t i = 0; i < classes.size(); ++i) {
+    const char c = static_cast<char>(i);
+    if (is_str_special(c)) {
+      classes[i] = is_str | special_char_flag;
+    } else if (is_hex_alpha(c)) {
+      classes[i] = is_hex | is_hex_id | is_str;
+    } else if (is_delim(c)) {
+      classes[i] = is_int_id | is_hex_id | is_str;
+    } else if (is_digit(c)) {
+      classes[i] = all_components | digit_flag;
+    } else {
+      classes[i] = is_str;
+    }
+  }
+  return classes;
+}
+
+constexpr auto char_classes = make_char_classes();
+
 StringView to_string(component_type type) {
   switch (type) {
     case component_type::is_int:
@@ -64,8 +97,6 @@ StringView to_string(component_type type) {
 component_type component_replacement(StringView path) noexcept {
   // viable_components is a bitset of the component types not yet excluded
   std::uint8_t viable_components = all_components;
-  bool found_special_char = false;
-  bool found_digit = false;
 
   if (path.size() < 2) {
     viable_components &= ~(component_type::is_int | component_type::is_int_id |
@@ -82,28 +113,16 @@ component_type component_replacement(StringView path) noexcept {
     viable_components &= ~component_type::is_int;
   }
 
-  for (std::size_t i = 0; i < path.size(); ++i) {
-    char c = path[i];
-
-    if (is_str_special(c)) {
-      found_special_char = true;
-      viable_components &=
-          ~(component_type::is_int | component_type::is_int_id |
-            component_type::is_hex | component_type::is_hex_id);
-    } else if (is_hex_alpha(c)) {
-      viable_components &=
-          ~(component_type::is_int | component_type::is_int_id);
-    } else if (is_delim(c)) {
-      viable_components &= ~(component_type::is_int | component_type::is_hex);
-    } else if (is_digit(c)) {
-      found_digit = true;
-    } else {
-      // other character
-      viable_components &=
-          ~(component_type::is_int | component_type::is_int_id |
-            component_type::is_hex | component_type::is_hex_id);
-    }
+  // Each character's class keeps the component types that allow it, and
+  // flags whether it is a digit or a special character.
+  std::uint8_t seen = 0;
+  for (const char c : path) {
+    const std::uint8_t char_class = char_classes[static_cast<unsigned char>(c)];
+    viable_components &= char_class;
+    seen |= char_class;
   }
+  const bool found_special_char = seen & special_char_flag;
+  const bool found_digit = seen & digit_flag;
 
   // is_str requires a special char or a size >= 20
   if (!found_special_char && path.size() < 20) {
@@ -182,4 +201,51 @@ std::string infer_endpoint(StringView path) {
   return result;
 }
 
+EndpointCache::EndpointCache(std::size_t shards, std::size_t entries_per_shard)
+    : shard_count_(std::clamp<std::size_t>(shards, 1, max_shards)),
+      entries_per_shard_(entries_per_shard) {}
+
+EndpointCache::Shard& EndpointCache::shard(StringView path) {
+  return shards_[std::hash<StringView>{}(path) % shard_count_];
+}
+
+std::string EndpointCache::infer(StringView path) {
+  static const auto hits = telemetry::counter::handle(
+      metrics::tracer::endpoint_inferral::cache_hits, {});
+  static const auto misses = telemetry::counter::handle(
+      metrics::tracer::endpoint_inferral::cache_misses, {});
+
+  auto& shard = this->shard(path);
+  std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    misses.increment();
+    return infer_endpoint(path);
+  }
+
+  if (const auto found = shard.index.find(path); found != shard.index.end()) {
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    hits.increment();
+    return found->second->second;
+  }
+
+  misses.increment();
+  std::string endpoint = infer_endpoint(path);
+  if (entries_per_shard_ == 0) {
+    return endpoint;
+  }
+  if (shard.entries.size() == entries_per_shard_) {
+    shard.index.erase(shard.entries.back().first);
+    shard.entries.pop_back();
+  }
+  shard.entries.emplace_front(std::string(path), endpoint);
+  shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+  return endpoint;
+}
+
+bool EndpointCache::contains(StringView path) {
+  auto& shard = this->shard(path);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.index.count(path) != 0;
+}
+
 }  // namespace datadog::tracing
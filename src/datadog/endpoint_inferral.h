@@ -2,7 +2,13 @@
 
 #include <datadog/string_view.h>
 
+#include <array>
+#include <cstddef>
+#include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace datadog::tracing {
 
@@ -14,4 +20,43 @@ namespace datadog::tracing {
 // HTTPClient::URL::parse().
 std::string infer_endpoint(StringView path);
 
+// `EndpointCache` memoizes `infer_endpoint`, for applications whose requests
+// have relatively few distinct paths.  The cache is divided into shards, each
+// holding at most a fixed number of paths and evicting the least recently
+// used path when a new one is added.  Hits and misses are counted in
+// telemetry.
+//
+// `EndpointCache` is safe to use from multiple threads.  If a path's shard is
+// in use by another thread, then the endpoint is inferred without the cache,
+// rather than waiting.
+class EndpointCache {
+ public:
+  static constexpr std::size_t max_shards = 16;
+
+  // Create a cache having the specified number of `shards`, at most
+  // `max_shards`, each holding at most the specified `entries_per_shard`.
+  EndpointCache(std::size_t shards, std::size_t entries_per_shard);
+
+  // Return `infer_endpoint(path)`.
+  std::string infer(StringView path);
+
+  // Return whether the endpoint of the specified `path` is cached.
+  bool contains(StringView path);
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    // (path, endpoint) in order of most recent use, the most recent first.
+    std::list<std::pair<std::string, std::string>> entries;
+    // Keys refer to the paths in `entries`.
+    std::unordered_map<StringView, decltype(entries)::iterator> index;
+  };
+
+  Shard& shard(StringView path);
+
+  std::array<Shard, max_shards> shards_;
+  const std::size_t shard_count_;
+  const std::size_t entries_per_shard_;
+};
+
 }  // namespace datadog::tracing
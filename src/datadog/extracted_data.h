@@ -12,6 +12,8 @@
 #include <utility>
 #include <vector>
 
+#include "propagation_headers.h"
+
 namespace datadog {
 namespace tracing {
 
@@ -41,10 +43,10 @@ struct ExtractedData {
   // `style` is the extraction style used to obtain this `ExtractedData`. It's
   // for diagnostics.
   Optional<PropagationStyle> style;
-  // `headers_examined` are the name/value pairs of HTTP headers (or equivalent
-  // request meta-data) that were looked up and had values during the
-  // preparation of this `ExtractedData`. It's for diagnostics.
-  std::vector<std::pair<std::string, std::string>> headers_examined;
+  // `headers_examined` are the HTTP headers (or equivalent request meta-data)
+  // that were looked up and had values during the preparation of this
+  // `ExtractedData`. It's for diagnostics (see `PropagationHeaders::entries`).
+  PropagationHeaders::Set headers_examined = 0;
 };
 
 }  // namespace tracing
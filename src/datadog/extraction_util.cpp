@@ -4,9 +4,9 @@
 #include <datadog/trace_source.h>
 
 #include <cstdint>
-#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "extracted_data.h"
 #include "hex.h"
@@ -24,25 +24,27 @@ namespace {
 // to the specified `span_tags` and log a diagnostic using the specified
 // `logger`.
 void handle_trace_tags(StringView trace_tags, ExtractedData& result,
-                       std::unordered_map<std::string, std::string>& span_tags,
-                       Logger& logger) {
-  auto maybe_trace_tags = decode_tags(trace_tags);
-  if (auto* error = maybe_trace_tags.if_error()) {
+                       SpanTags& span_tags, Logger& logger) {
+  // Only the "_dd.p." tags are kept, so only they are copied out of
+  // `trace_tags`.  The views are kept in storage that is reused by later calls
+  // on this thread.
+  thread_local std::vector<std::pair<StringView, StringView>> decoded;
+  decoded.clear();
+  auto decode_result = decode_tags(trace_tags, "_dd.p.", decoded);
+  if (auto* error = decode_result.if_error()) {
     logger.log_error(*error);
     span_tags[tags::internal::propagation_error] = "decoding_error";
     return;
   }
 
-  for (auto& [key, value] : *maybe_trace_tags) {
-    if (!starts_with(key, "_dd.p.")) {
-      continue;
-    }
-
+  for (const auto& [key, value] : decoded) {
     if (key == tags::internal::trace_id_high) {
       // _dd.p.tid contains the high 64 bits of the trace ID.
       const Optional<std::uint64_t> high = parse_trace_id_high(value);
       if (!high) {
-        span_tags[tags::internal::propagation_error] = "malformed_tid " + value;
+        std::string& error = span_tags[tags::internal::propagation_error];
+        error = "malformed_tid ";
+        append(error, value);
         continue;
       }
 
@@ -55,7 +57,7 @@ void handle_trace_tags(StringView trace_tags, ExtractedData& result,
       if (!validate_trace_source(value)) continue;
     }
 
-    result.trace_tags.emplace_back(std::move(key), std::move(value));
+    result.trace_tags.emplace_back(std::string(key), std::string(value));
   }
 }
 
@@ -95,7 +97,7 @@ Expected<Optional<std::uint64_t>> extract_id_header(const DictReader& headers,
 
 }  // namespace
 
-Optional<std::uint64_t> parse_trace_id_high(const std::string& value) {
+Optional<std::uint64_t> parse_trace_id_high(StringView value) {
   if (value.size() != 16) {
     return nullopt;
   }
@@ -108,9 +110,9 @@ Optional<std::uint64_t> parse_trace_id_high(const std::string& value) {
   return nullopt;
 }
 
-Expected<ExtractedData> extract_datadog(
-    const DictReader& headers,
-    std::unordered_map<std::string, std::string>& span_tags, Logger& logger) {
+Expected<ExtractedData> extract_datadog(const DictReader& headers,
+                                        SpanTags& span_tags,
+                                        Logger& logger) {
   ExtractedData result;
   result.style = PropagationStyle::DATADOG;
 
@@ -158,9 +160,8 @@ Expected<ExtractedData> extract_datadog(
   return result;
 }
 
-Expected<ExtractedData> extract_b3(
-    const DictReader& headers, std::unordered_map<std::string, std::string>&,
-    Logger&) {
+Expected<ExtractedData> extract_b3(const DictReader& headers, SpanTags&,
+                                   Logger&) {
   ExtractedData result;
   result.style = PropagationStyle::B3;
 
@@ -200,62 +201,41 @@ Expected<ExtractedData> extract_b3(
   return result;
 }
 
-Expected<ExtractedData> extract_none(
-    const DictReader&, std::unordered_map<std::string, std::string>&, Logger&) {
+Expected<ExtractedData> extract_none(const DictReader&, SpanTags&, Logger&) {
   ExtractedData result;
   result.style = PropagationStyle::NONE;
   return result;
 }
 
-std::string extraction_error_prefix(
-    const Optional<PropagationStyle>& style,
-    const std::vector<std::pair<std::string, std::string>>& headers_examined) {
-  std::ostringstream stream;
-  stream << "While extracting trace context";
+Error with_extraction_context(Error&& error,
+                              const Optional<PropagationStyle>& style,
+                              const PropagationHeaders& headers,
+                              PropagationHeaders::Set headers_examined) {
+  // The description is built in one string, followed by the original message,
+  // rather than in a stream whose result is then copied by
+  // `Error::with_prefix`.
+  std::string message = "While extracting trace context";
   if (style) {
-    stream << " in the " << to_string_view(*style) << " propagation style";
+    message += " in the ";
+    append(message, to_string_view(*style));
+    message += " propagation style";
   }
-
-  if (!headers_examined.empty()) {
-    auto it = headers_examined.begin();
-    stream << " from the following headers: [" << it->first << ": "
-           << it->second;
-    for (++it; it != headers_examined.end(); ++it) {
-      stream << ", " << it->first << ": " << it->second;
-    }
-    stream << "]";
-  }
-  stream << ", an error occurred: ";
-  return stream.str();
-}
-
-AuditedReader::AuditedReader(const DictReader& underlying)
-    : underlying(underlying) {}
-
-Optional<StringView> AuditedReader::lookup(StringView key) const {
-  auto value = underlying.lookup(key);
-  if (value) {
-    entries_found.emplace_back(key, *value);
+  if (headers_examined) {
+    message += " from the following headers: [";
+    headers.append_entries(message, headers_examined);
+    message += ']';
   }
-  return value;
-}
-
-void AuditedReader::visit(
-    const std::function<void(StringView key, StringView value)>& visitor)
-    const {
-  underlying.visit([&, this](StringView key, StringView value) {
-    entries_found.emplace_back(key, value);
-    visitor(key, value);
-  });
+  message += ", an error occurred: ";
+  message += error.message;
+  error.message = std::move(message);
+  return std::move(error);
 }
 
-ExtractedData merge(
-    const PropagationStyle first_style,
-    const std::unordered_map<PropagationStyle, ExtractedData>& contexts) {
-  ExtractedData result;
-  const auto found = contexts.find(first_style);
-  if (found == contexts.end()) {
-    return result;
+ExtractedData merge(const PropagationStyle first_style,
+                    ExtractedContexts& contexts) {
+  ExtractedData* const found = contexts.find(first_style);
+  if (found == nullptr) {
+    return ExtractedData{};
   }
 
   // `found` refers to the first extracted context that yielded a trace ID.
@@ -264,31 +244,35 @@ ExtractedData merge(
   // If the W3C style is present and its trace-id matches, we'll update the main
   // context with tracestate information that we want to include in `result`. We
   // may also need to use Datadog header information (only when the trace-id
-  // matches).
-  result = found->second;
-
-  const auto w3c = contexts.find(PropagationStyle::W3C);
-  const auto dd = contexts.find(PropagationStyle::DATADOG);
-
-  if (w3c != contexts.end() && w3c->second.trace_id == result.trace_id) {
-    result.additional_w3c_tracestate = w3c->second.additional_w3c_tracestate;
+  // matches).  If the main context is the W3C context, then it already
+  // includes that information.
+  ExtractedData result = std::move(*found);
+
+  ExtractedData* const w3c = first_style == PropagationStyle::W3C
+                                 ? nullptr
+                                 : contexts.find(PropagationStyle::W3C);
+  const ExtractedData* const dd =
+      first_style == PropagationStyle::DATADOG
+          ? &result
+          : contexts.find(PropagationStyle::DATADOG);
+
+  if (w3c != nullptr && w3c->trace_id == result.trace_id) {
+    result.additional_w3c_tracestate =
+        std::move(w3c->additional_w3c_tracestate);
     result.additional_datadog_w3c_tracestate =
-        w3c->second.additional_datadog_w3c_tracestate;
-    result.headers_examined.insert(result.headers_examined.end(),
-                                   w3c->second.headers_examined.begin(),
-                                   w3c->second.headers_examined.end());
-
-    if (result.parent_id != w3c->second.parent_id) {
-      if (w3c->second.datadog_w3c_parent_id &&
-          w3c->second.datadog_w3c_parent_id != "0000000000000000") {
-        result.datadog_w3c_parent_id = w3c->second.datadog_w3c_parent_id;
-      } else if (dd != contexts.end() &&
-                 dd->second.trace_id == result.trace_id &&
-                 dd->second.parent_id.has_value()) {
-        result.datadog_w3c_parent_id = hex_padded(dd->second.parent_id.value());
+        std::move(w3c->additional_datadog_w3c_tracestate);
+    result.headers_examined |= w3c->headers_examined;
+
+    if (result.parent_id != w3c->parent_id) {
+      if (w3c->datadog_w3c_parent_id &&
+          w3c->datadog_w3c_parent_id != "0000000000000000") {
+        result.datadog_w3c_parent_id = std::move(w3c->datadog_w3c_parent_id);
+      } else if (dd != nullptr && dd->trace_id == result.trace_id &&
+                 dd->parent_id.has_value()) {
+        result.datadog_w3c_parent_id = hex_padded(dd->parent_id.value());
       }
 
-      result.parent_id = w3c->second.parent_id;
+      result.parent_id = w3c->parent_id;
     }
   }
 
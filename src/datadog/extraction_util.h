@@ -8,62 +8,77 @@
 #include <datadog/optional.h>
 #include <datadog/propagation_style.h>
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "extracted_data.h"
+#include "propagation_headers.h"
+#include "span_data.h"
+
 namespace datadog {
 namespace tracing {
 
-struct ExtractedData;
 class Logger;
 
 // Parse the high 64 bits of a trace ID from the specified `value`. If `value`
 // is correctly formatted, then return the resulting bits. If `value` is
 // incorrectly formatted, then return `nullopt`.
-Optional<std::uint64_t> parse_trace_id_high(const std::string& value);
+Optional<std::uint64_t> parse_trace_id_high(StringView value);
 
 // Return trace information parsed from the specified `headers` in the Datadog
 // propagation style. Use the specified `span_tags` and `logger` to report
 // warnings. If an error occurs, return an `Error`.
-Expected<ExtractedData> extract_datadog(
-    const DictReader& headers,
-    std::unordered_map<std::string, std::string>& span_tags, Logger& logger);
+Expected<ExtractedData> extract_datadog(const DictReader& headers,
+                                        SpanTags& span_tags,
+                                        Logger& logger);
 
 // Return trace information parsed from the specified `headers` in the B3
 // multi-header propagation style. If an error occurs, return an `Error`.
-Expected<ExtractedData> extract_b3(
-    const DictReader& headers, std::unordered_map<std::string, std::string>&,
-    Logger&);
+Expected<ExtractedData> extract_b3(const DictReader& headers, SpanTags&,
+                                   Logger&);
 
 // Return an `ExtractedData` whose only non-default field is
 // `style = PropagationStyle::NONE`.
-Expected<ExtractedData> extract_none(
-    const DictReader&, std::unordered_map<std::string, std::string>&, Logger&);
-
-// Return a string that can be used as the argument to `Error::with_prefix` for
-// errors occurring while extracting trace information in the specified `style`
-// from the specified `headers_examined`.
-std::string extraction_error_prefix(
-    const Optional<PropagationStyle>& style,
-    const std::vector<std::pair<std::string, std::string>>& headers_examined);
-
-// `AuditedReader` is a `DictReader` that remembers all key/value pairs looked
-// up or visited through it. It remembers a lookup only if it yielded a non-null
-// value. This is used for error diagnostic messages in trace extraction (i.e.
-// an error occurred, but which HTTP request headers were we looking at?).
-struct AuditedReader : public DictReader {
-  const DictReader& underlying;
-  mutable std::vector<std::pair<std::string, std::string>> entries_found;
-
-  explicit AuditedReader(const DictReader& underlying);
-
-  Optional<StringView> lookup(StringView key) const override;
-
-  void visit(const std::function<void(StringView key, StringView value)>&
-                 visitor) const override;
+Expected<ExtractedData> extract_none(const DictReader&, SpanTags&, Logger&);
+
+// Return the specified `error` with its message prefixed by a description of
+// extracting trace information in the specified `style` from the specified
+// `headers_examined` of the specified `headers`.
+Error with_extraction_context(Error&& error,
+                              const Optional<PropagationStyle>& style,
+                              const PropagationHeaders& headers,
+                              PropagationHeaders::Set headers_examined);
+
+// `ExtractedContexts` holds the trace context extracted in each propagation
+// style, when more than one style is extracted.  There is a slot for each
+// style, so the contexts are kept on the stack of the extracting thread
+// rather than in a container that allocates.
+class ExtractedContexts {
+  static constexpr std::size_t slot_count =
+      static_cast<std::size_t>(PropagationStyle::BAGGAGE) + 1;
+
+  std::array<ExtractedData, slot_count> slots_;
+  std::array<bool, slot_count> present_{};
+
+ public:
+  // Store the specified `data` as the context extracted in the specified
+  // `style`, replacing any context previously stored for `style`.
+  void set(PropagationStyle style, ExtractedData&& data) {
+    const auto slot = static_cast<std::size_t>(style);
+    slots_[slot] = std::move(data);
+    present_[slot] = true;
+  }
+
+  // Return the context extracted in the specified `style`, or return null if
+  // there is none.
+  ExtractedData* find(PropagationStyle style) {
+    const auto slot = static_cast<std::size_t>(style);
+    return present_[slot] ? &slots_[slot] : nullptr;
+  }
 };
 
 // Combine the specified trace `contexts`, each of which was extracted in a
@@ -71,10 +86,10 @@ struct AuditedReader : public DictReader {
 // from compatible elements of `contexts`, and return the resulting
 // `ExtractedData`. The `first_style` specifies the first configured extraction
 // propagation style that has been extracted and the other contexts will be
-// merged with it, so long as the trace-ids match.
-ExtractedData merge(
-    const PropagationStyle first_style,
-    const std::unordered_map<PropagationStyle, ExtractedData>& contexts);
+// merged with it, so long as the trace-ids match.  The fields of `contexts`
+// that are included in the result are moved from, rather than copied.
+ExtractedData merge(const PropagationStyle first_style,
+                    ExtractedContexts& contexts);
 
 }  // namespace tracing
 }  // namespace datadog
@@ -0,0 +1,198 @@
+#pragma once
+
+// This component provides a class template, `FlatMap`, that is an associative
+// container optimized for a small number of elements.
+//
+// `FlatMap` stores its elements contiguously, in insertion order, and looks
+// them up by linear search.  For the handful of elements typical of span tags,
+// this is faster than a node-based hash table: inserting an element does not
+// allocate a node, and lookup does not chase pointers.  Storage for
+// `initial_capacity` elements is reserved the first time an element is
+// inserted, so that a typical map performs exactly one allocation.
+//
+// `FlatMap` supports the subset of the `std::unordered_map` interface used by
+// this library, with the same semantics, except that:
+//
+// - any insertion or erasure may invalidate iterators and references,
+// - lookup accepts any key type that is equality comparable with `Key`, so
+//   that, for example, a `StringView` can be looked up without first copying
+//   it into a `std::string`,
+// - lookup is linear in the size of the map, so `FlatMap` is not suitable for
+//   large maps.
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+template <typename Key, typename Value, std::size_t initial_capacity = 8,
+          typename Allocator = std::allocator<std::pair<Key, Value>>>
+class FlatMap {
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<Key, Value>;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+
+ private:
+  using Storage = std::vector<value_type, Allocator>;
+  Storage elements_;
+
+ public:
+  using iterator = typename Storage::iterator;
+  using const_iterator = typename Storage::const_iterator;
+
+  FlatMap() = default;
+  explicit FlatMap(const Allocator& allocator) : elements_(allocator) {}
+
+  allocator_type get_allocator() const { return elements_.get_allocator(); }
+
+  iterator begin() noexcept { return elements_.begin(); }
+  iterator end() noexcept { return elements_.end(); }
+  const_iterator begin() const noexcept { return elements_.begin(); }
+  const_iterator end() const noexcept { return elements_.end(); }
+  const_iterator cbegin() const noexcept { return elements_.cbegin(); }
+  const_iterator cend() const noexcept { return elements_.cend(); }
+
+  bool empty() const noexcept { return elements_.empty(); }
+  size_type size() const noexcept { return elements_.size(); }
+  void clear() noexcept { elements_.clear(); }
+  // Make room for at least the specified `count` elements, and in any case
+  // for at least `initial_capacity`, as the first insertion would.
+  void reserve(size_type count) {
+    elements_.reserve(std::max(count, size_type(initial_capacity)));
+  }
+
+  template <typename K>
+  iterator find(const K& key) {
+    return std::find_if(begin(), end(), [&](const value_type& element) {
+      return element.first == key;
+    });
+  }
+
+  template <typename K>
+  const_iterator find(const K& key) const {
+    return std::find_if(begin(), end(), [&](const value_type& element) {
+      return element.first == key;
+    });
+  }
+
+  template <typename K>
+  size_type count(const K& key) const {
+    return find(key) != end();
+  }
+
+  template <typename K>
+  Value& at(const K& key) {
+    const auto found = find(key);
+    if (found == end()) {
+      throw std::out_of_range("FlatMap::at: key not found");
+    }
+    return found->second;
+  }
+
+  template <typename K>
+  const Value& at(const K& key) const {
+    const auto found = find(key);
+    if (found == end()) {
+      throw std::out_of_range("FlatMap::at: key not found");
+    }
+    return found->second;
+  }
+
+  template <typename K>
+  Value& operator[](K&& key) {
+    const auto found = find(key);
+    if (found != end()) {
+      return found->second;
+    }
+    return append(Key(std::forward<K>(key)), Value())->second;
+  }
+
+  // Insert an element having the specified `key` and a value constructed from
+  // the specified `args`, unless an element having `key` already exists.
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+    const auto found = find(key);
+    if (found != end()) {
+      return {found, false};
+    }
+    return {append(Key(std::forward<K>(key)),
+                   Value(std::forward<Args>(args)...)),
+            true};
+  }
+
+  template <typename K, typename V>
+  std::pair<iterator, bool> insert_or_assign(K&& key, V&& value) {
+    const auto found = find(key);
+    if (found != end()) {
+      found->second = std::forward<V>(value);
+      return {found, false};
+    }
+    return {append(Key(std::forward<K>(key)), Value(std::forward<V>(value))),
+            true};
+  }
+
+  // Insert an element having the specified `key` and `value` without looking
+  // for an existing element having `key`.  The behavior is undefined if there
+  // is one.
+  template <typename K, typename V>
+  iterator append_unique(K&& key, V&& value) {
+    return append(Key(std::forward<K>(key)), Value(std::forward<V>(value)));
+  }
+
+  template <typename Pair>
+  std::pair<iterator, bool> insert(const Pair& element) {
+    return emplace(element.first, element.second);
+  }
+
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <typename K>
+  size_type erase(const K& key) {
+    const auto found = find(key);
+    if (found == end()) {
+      return 0;
+    }
+    elements_.erase(found);
+    return 1;
+  }
+
+  // Return whether the specified maps contain the same elements, regardless
+  // of order.
+  friend bool operator==(const FlatMap& left, const FlatMap& right) {
+    return left.size() == right.size() &&
+           std::all_of(left.begin(), left.end(), [&](const value_type& entry) {
+             const auto found = right.find(entry.first);
+             return found != right.end() && found->second == entry.second;
+           });
+  }
+
+  friend bool operator!=(const FlatMap& left, const FlatMap& right) {
+    return !(left == right);
+  }
+
+ private:
+  iterator append(Key&& key, Value&& value) {
+    if (elements_.capacity() == 0) {
+      elements_.reserve(initial_capacity);
+    }
+    elements_.emplace_back(std::move(key), std::move(value));
+    return std::prev(elements_.end());
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
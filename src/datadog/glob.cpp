@@ -1,9 +1,29 @@
 #include "glob.h"
 
-#include <cctype>
+#include <algorithm>
 
 namespace datadog {
 namespace tracing {
+namespace {
+
+// Return whether the specified `subject` equals the specified `lowered`,
+// ignoring the case of `subject`.
+bool equals_lowered(StringView lowered, StringView subject) {
+  return lowered.size() == subject.size() &&
+         std::equal(lowered.begin(), lowered.end(), subject.begin(),
+                    [](char l, char s) { return l == ascii_to_lower(s); });
+}
+
+// Return whether the specified `subject` matches the specified `segment`, a
+// lowercased pattern without "*" that has the same size as `subject`.
+bool matches_segment(StringView segment, StringView subject) {
+  return std::equal(segment.begin(), segment.end(), subject.begin(),
+                    [](char p, char s) {
+                      return p == '?' || p == ascii_to_lower(s);
+                    });
+}
+
+}  // namespace
 
 bool glob_match(StringView pattern, StringView subject) {
   // This is a backtracking implementation of the glob matching algorithm.
@@ -40,7 +60,8 @@ bool glob_match(StringView pattern, StringView subject) {
           }
           break;
         default:
-          if (s < s_size && tolower(subject[s]) == tolower(pattern_char)) {
+          if (s < s_size &&
+              ascii_to_lower(subject[s]) == ascii_to_lower(pattern_char)) {
             ++p;
             ++s;
             continue;
@@ -58,5 +79,114 @@ bool glob_match(StringView pattern, StringView subject) {
   return true;
 }
 
+GlobPattern::GlobPattern(StringView pattern) {
+  lowered_.reserve(pattern.size());
+  for (const char c : pattern) {
+    lowered_ += ascii_to_lower(c);
+  }
+
+  const auto first_star = lowered_.find('*');
+  const bool has_question = lowered_.find('?') != std::string::npos;
+  if (lowered_.find_first_not_of('*') == std::string::npos &&
+      !lowered_.empty()) {
+    kind_ = Kind::EVERYTHING;
+    lowered_.clear();
+  } else if (first_star == std::string::npos && !has_question) {
+    kind_ = Kind::LITERAL;
+  } else if (has_question || lowered_.find('*', first_star + 1) !=
+                                 std::string::npos) {
+    kind_ = Kind::GLOB;
+  } else if (first_star == lowered_.size() - 1) {
+    kind_ = Kind::PREFIX;
+    lowered_.pop_back();
+  } else if (first_star == 0) {
+    kind_ = Kind::SUFFIX;
+    lowered_.erase(0, 1);
+  } else {
+    kind_ = Kind::GLOB;
+  }
+
+  if (kind_ != Kind::GLOB) {
+    return;
+  }
+  anchored_start_ = lowered_.front() != '*';
+  anchored_end_ = lowered_.back() != '*';
+  std::size_t begin = 0;
+  while (begin <= lowered_.size()) {
+    auto end = lowered_.find('*', begin);
+    if (end == std::string::npos) {
+      end = lowered_.size();
+    }
+    if (end != begin) {
+      segments_.push_back(lowered_.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+}
+
+bool GlobPattern::match_segments(StringView subject) const {
+  if (segments_.size() == 1 && anchored_start_ && anchored_end_) {
+    // There is no "*", only "?".
+    return subject.size() == segments_.front().size() &&
+           matches_segment(segments_.front(), subject);
+  }
+
+  auto first = segments_.begin();
+  auto last = segments_.end();
+  std::size_t begin = 0;
+  std::size_t end = subject.size();
+  if (anchored_start_) {
+    const std::string& segment = *first++;
+    if (segment.size() > end ||
+        !matches_segment(segment, subject.substr(0, segment.size()))) {
+      return false;
+    }
+    begin = segment.size();
+  }
+  if (anchored_end_) {
+    const std::string& segment = *--last;
+    if (segment.size() > end - begin ||
+        !matches_segment(segment, subject.substr(end - segment.size()))) {
+      return false;
+    }
+    end -= segment.size();
+  }
+
+  // Find each of the remaining segments at its leftmost position.
+  for (; first != last; ++first) {
+    const std::string& segment = *first;
+    for (;;) {
+      if (segment.size() > end - begin) {
+        return false;
+      }
+      if (matches_segment(segment, subject.substr(begin, segment.size()))) {
+        break;
+      }
+      ++begin;
+    }
+    begin += segment.size();
+  }
+  return true;
+}
+
+bool GlobPattern::match(StringView subject) const {
+  switch (kind_) {
+    case Kind::EVERYTHING:
+      return true;
+    case Kind::LITERAL:
+      return equals_lowered(lowered_, subject);
+    case Kind::PREFIX:
+      return subject.size() >= lowered_.size() &&
+             equals_lowered(lowered_, subject.substr(0, lowered_.size()));
+    case Kind::SUFFIX:
+      return subject.size() >= lowered_.size() &&
+             equals_lowered(lowered_,
+                            subject.substr(subject.size() - lowered_.size()));
+    case Kind::GLOB:
+      break;
+  }
+  return match_segments(subject);
+}
+
 }  // namespace tracing
 }  // namespace datadog
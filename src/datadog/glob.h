@@ -8,11 +8,25 @@
 // - "?" matches exactly one instance of any character.
 // - Other characters match exactly one instance of themselves.
 //
+// Matching ignores the case of ASCII letters.
+//
 // The patterns are here called "glob patterns," though they are different from
 // the patterns used in Unix shells.
+//
+// This component also provides a `class`, `GlobPattern`, that is a glob
+// pattern prepared for matching many subjects.  Patterns that are a literal,
+// a literal prefix, or a literal suffix are matched without backtracking, and
+// the pattern is lowercased once rather than once per match.  Other patterns
+// are divided into the segments between their "*"s, which are matched in
+// order, each at its leftmost position after the previous one.  This, too,
+// needs no backtracking, since a "*" can absorb whatever precedes a segment's
+// leftmost occurrence.
 
 #include <datadog/string_view.h>
 
+#include <string>
+#include <vector>
+
 namespace datadog {
 namespace tracing {
 
@@ -21,5 +35,42 @@ namespace tracing {
 // glob `pattern`.
 bool glob_match(StringView pattern, StringView subject);
 
+// Return the specified `c` converted to lowercase, if it is an ASCII letter.
+inline char ascii_to_lower(char c) {
+  return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+class GlobPattern {
+ public:
+  explicit GlobPattern(StringView pattern);
+
+  // Return whether the specified `subject` matches this pattern.  The result
+  // is the same as that of `glob_match`.
+  bool match(StringView subject) const;
+
+  // Return whether this pattern matches every string.
+  bool matches_everything() const { return kind_ == Kind::EVERYTHING; }
+  // Return whether this pattern matches only the strings equal to `literal()`,
+  // ignoring case.
+  bool is_literal() const { return kind_ == Kind::LITERAL; }
+  // Return the lowercased text of this pattern, excluding the "*" of a prefix
+  // or suffix pattern.
+  const std::string& literal() const { return lowered_; }
+
+ private:
+  enum class Kind : char { EVERYTHING, LITERAL, PREFIX, SUFFIX, GLOB };
+  Kind kind_;
+  std::string lowered_;
+  // The following are used only by `Kind::GLOB`.  The segments of the pattern
+  // between "*"s, excluding empty segments, and whether the pattern begins and
+  // ends with a segment rather than with "*".
+  std::vector<std::string> segments_;
+  bool anchored_start_ = false;
+  bool anchored_end_ = false;
+
+  // Return whether the segments of this pattern match `subject`.
+  bool match_segments(StringView subject) const;
+};
+
 }  // namespace tracing
 }  // namespace datadog
@@ -0,0 +1,83 @@
+#include "header_block_reader.h"
+
+#include <cctype>
+#include <cstddef>
+
+#include "string_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+bool equals_ignoring_case(StringView left, StringView right) {
+  if (left.size() != right.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < left.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(left[i])) !=
+        std::tolower(static_cast<unsigned char>(right[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Invoke the specified `callback` with the trimmed name and value of each
+// header line in the specified `block`, in order, until `callback` returns
+// `false`.
+template <typename Callback>
+void for_each_header(StringView block, Callback&& callback) {
+  while (!block.empty()) {
+    const auto end = block.find('\n');
+    const StringView line = block.substr(0, end);
+    block = end == StringView::npos ? StringView() : block.substr(end + 1);
+
+    const auto colon = line.find(':');
+    if (colon == StringView::npos) {
+      continue;
+    }
+    if (!callback(trim(line.substr(0, colon)), trim(line.substr(colon + 1)))) {
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+HeaderBlockReader::HeaderBlockReader(StringView block) : block_(block) {}
+
+Optional<StringView> HeaderBlockReader::lookup(StringView key) const {
+  Optional<StringView> result;
+  for_each_header(block_, [&](StringView name, StringView value) {
+    if (!equals_ignoring_case(name, key)) {
+      return true;
+    }
+    result = value;
+    return false;
+  });
+  return result;
+}
+
+void HeaderBlockReader::visit(
+    const std::function<void(StringView key, StringView value)>& visitor)
+    const {
+  for_each_header(block_, [&](StringView name, StringView value) {
+    // Skip the header if it already appeared earlier in the block.
+    bool seen = false;
+    for_each_header(block_, [&](StringView earlier, StringView) {
+      if (earlier.data() == name.data()) {
+        return false;
+      }
+      seen = equals_ignoring_case(earlier, name);
+      return !seen;
+    });
+    if (!seen) {
+      buffer_ = to_lower(name);
+      visitor(buffer_, value);
+    }
+    return true;
+  });
+}
+
+}  // namespace tracing
+}  // namespace datadog
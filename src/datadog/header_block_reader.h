@@ -0,0 +1,43 @@
+#pragma once
+
+// This component provides a class, `HeaderBlockReader`, that implements the
+// `DictReader` interface in terms of a block of HTTP header lines, e.g.
+//
+//     "Content-Type: application/json\r\nContent-Length: 42\r\n"
+//
+// The lines are not parsed until they are looked up, so an HTTP client can
+// keep a response's headers in one buffer as they arrive instead of copying
+// each into a map that most callers never read.
+//
+// Header names are compared case-insensitively.  If a header appears more
+// than once, then only its first occurrence is used.  Lines without a colon,
+// such as status lines, are ignored.
+
+#include <datadog/dict_reader.h>
+#include <datadog/string_view.h>
+
+#include <functional>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+class HeaderBlockReader : public DictReader {
+  StringView block_;
+  mutable std::string buffer_;
+
+ public:
+  // Create a reader over the specified `block` of lines, each terminated by
+  // "\n" or "\r\n".  The behavior is undefined if `block` is modified or
+  // destroyed while the reader is in use.
+  explicit HeaderBlockReader(StringView block);
+
+  Optional<StringView> lookup(StringView key) const override;
+  // Invoke the specified `visitor` once per header name, with the name in
+  // lower case.
+  void visit(const std::function<void(StringView key, StringView value)>&
+                 visitor) const override;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,134 @@
+#include "header_tags.h"
+
+#include <string>
+#include <utility>
+
+#include "string_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The number of seeds tried for each table size before the table is made
+// larger.
+constexpr int seeds_per_size = 64;
+
+char lower(char c) { return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c; }
+
+// Return the specified lower-case `header` with characters other than
+// letters, digits, and hyphens replaced by underscores.
+std::string normalized(std::string header) {
+  for (char& c : header) {
+    if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-')) {
+      c = '_';
+    }
+  }
+  return header;
+}
+
+}  // namespace
+
+Expected<HeaderTags> HeaderTags::compile(
+    const std::unordered_map<std::string, std::string>& config) {
+  if (config.size() > max_headers) {
+    std::string message;
+    message += "At most ";
+    message += std::to_string(max_headers);
+    message += " headers can be tagged, but ";
+    message += std::to_string(config.size());
+    message += " are configured.";
+    return Error{Error::TRACER_INVALID_HEADER_TAGS, std::move(message)};
+  }
+
+  HeaderTags result;
+  for (const auto& [header, tag] : config) {
+    if (header.empty()) {
+      return Error{Error::TRACER_INVALID_HEADER_TAGS,
+                   "A tagged header must have a name."};
+    }
+    Entry entry;
+    entry.header = to_lower(header);
+    for (const Entry& other : result.entries_) {
+      if (other.header == entry.header) {
+        std::string message;
+        message += "The header \"";
+        message += entry.header;
+        message += "\" is tagged more than once.";
+        return Error{Error::TRACER_INVALID_HEADER_TAGS, std::move(message)};
+      }
+    }
+    if (tag.empty()) {
+      const std::string suffix = normalized(entry.header);
+      entry.request_tag = "http.request.headers." + suffix;
+      entry.response_tag = "http.response.headers." + suffix;
+    } else {
+      entry.request_tag = tag;
+      entry.response_tag = tag;
+    }
+    result.entries_.push_back(std::move(entry));
+  }
+
+  if (result.entries_.empty()) {
+    return result;
+  }
+
+  // Look for a seed for which no two headers share a slot.  A table at least
+  // twice the number of headers usually has one among the first few seeds.
+  std::size_t size = 2;
+  while (size < 2 * result.entries_.size()) {
+    size *= 2;
+  }
+  for (;; size *= 2) {
+    result.mask_ = size - 1;
+    for (int attempt = 0; attempt < seeds_per_size; ++attempt) {
+      result.seed_ = 0x9e3779b97f4a7c15ULL * std::uint64_t(attempt + 1);
+      result.slots_.assign(size, 0);
+      bool collided = false;
+      for (std::size_t i = 0; i < result.entries_.size(); ++i) {
+        const std::uint64_t hash = result.hash(result.entries_[i].header);
+        auto& slot = result.slots_[hash & result.mask_];
+        if (slot != 0) {
+          collided = true;
+          break;
+        }
+        slot = std::uint32_t(i + 1);
+      }
+      if (!collided) {
+        return result;
+      }
+    }
+  }
+}
+
+std::uint64_t HeaderTags::hash(StringView name) const {
+  // FNV-1a of the lower-case name, starting from the seed.
+  std::uint64_t result = 0xcbf29ce484222325ULL ^ seed_;
+  for (const char c : name) {
+    result ^= static_cast<unsigned char>(lower(c));
+    result *= 0x100000001b3ULL;
+  }
+  return result ^ (result >> 32);
+}
+
+std::size_t HeaderTags::find(StringView name) const {
+  if (slots_.empty()) {
+    return npos;
+  }
+  const std::uint32_t slot = slots_[hash(name) & mask_];
+  if (slot == 0) {
+    return npos;
+  }
+  const std::string& header = entries_[slot - 1].header;
+  if (header.size() != name.size()) {
+    return npos;
+  }
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (lower(name[i]) != header[i]) {
+      return npos;
+    }
+  }
+  return slot - 1;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,76 @@
+#pragma once
+
+// This component provides a class, `HeaderTags`, that is the compiled form of
+// `TracerConfig::header_tags`: the request and response headers whose values
+// become tags of spans.
+//
+// `finalize_config` compiles the configured header names into a perfect hash
+// table, so that deciding whether a header is tagged costs one hash of its
+// name and at most one comparison, however many headers are configured.  The
+// tag names are made then too, so that tagging a span formats nothing.
+//
+// `Tracer::extract_span` tags the local root span with the request headers as
+// it visits them for trace context (see `PropagationHeaders`), and
+// `Span::set_response_header_tags` tags a span with the response headers.
+//
+// Header names are compared case-insensitively.  If a header appears more
+// than once, then only its first occurrence is used.
+
+#include <datadog/expected.h>
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class HeaderTags {
+ public:
+  struct Entry {
+    // The name of the header, in lower case.
+    std::string header;
+    // The names of the tags given the header's value in requests and in
+    // responses.
+    std::string request_tag;
+    std::string response_tag;
+  };
+
+  // The most headers that can be tagged.
+  static constexpr std::size_t max_headers = 64;
+
+  // The value returned by `find` for headers that are not tagged.
+  static constexpr std::size_t npos = std::size_t(-1);
+
+  // Return the compiled form of the specified `config`, which maps header
+  // names to tag names.  A header mapped to an empty tag name has the tag
+  // "http.request.headers.<header>" in requests and
+  // "http.response.headers.<header>" in responses, where "<header>" is the
+  // header's name in lower case with characters other than letters, digits,
+  // and hyphens replaced by underscores.  Return an error if a header name is
+  // empty or repeated, or if there are more than `max_headers`.
+  static Expected<HeaderTags> compile(
+      const std::unordered_map<std::string, std::string>& config);
+
+  // Return the index in `entries()` of the specified header `name`, or return
+  // `npos` if `name` is not tagged.
+  std::size_t find(StringView name) const;
+
+  const std::vector<Entry>& entries() const { return entries_; }
+
+ private:
+  std::uint64_t hash(StringView name) const;
+
+  std::vector<Entry> entries_;
+  // One more than the index in `entries_` of the header whose hash, masked by
+  // `mask_`, is the slot's index, or zero if there is no such header.
+  std::vector<std::uint32_t> slots_;
+  std::size_t mask_ = 0;
+  std::uint64_t seed_ = 0;
+};
+
+}  // namespace tracing
+}  // namespace datadog
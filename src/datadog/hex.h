@@ -1,16 +1,55 @@
 #pragma once
 
 // This component provides functions for formatting an unsigned integral value
-// in hexadecimal.
+// in hexadecimal, and for parsing one from hexadecimal.
+//
+// Trace IDs and span IDs are formatted and parsed for every injection and
+// extraction, so the padded formatting and the parsing use lookup tables
+// rather than `std::to_chars` and `std::from_chars`.
+
+#include <datadog/optional.h>
+#include <datadog/string_view.h>
 
 #include <cassert>
 #include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <string>
 #include <system_error>
 #include <utility>
 
 namespace datadog {
 namespace tracing {
+namespace detail {
+
+// `HexTables` contains the two lower-case hexadecimal digits of each byte
+// value, and the value of each character as a hexadecimal digit (0xff if it
+// is not one).
+struct HexTables {
+  char digit_pairs[2 * 256] = {};
+  std::uint8_t digit_values[256] = {};
+
+  constexpr HexTables() {
+    const char digits[] = "0123456789abcdef";
+    for (int byte = 0; byte < 256; ++byte) {
+      digit_pairs[2 * byte] = digits[byte >> 4];
+      digit_pairs[2 * byte + 1] = digits[byte & 0xf];
+      digit_values[byte] = 0xff;
+    }
+    for (int value = 0; value < 16; ++value) {
+      digit_values[static_cast<unsigned char>(digits[value])] =
+          static_cast<std::uint8_t>(value);
+    }
+    for (int value = 10; value < 16; ++value) {
+      digit_values['A' + value - 10] = static_cast<std::uint8_t>(value);
+    }
+  }
+};
+
+inline constexpr HexTables hex_tables;
+
+}  // namespace detail
 
 // Return the specified unsigned `value` formatted as a lower-case hexadecimal
 // string without any leading zeroes.
@@ -29,25 +68,62 @@ std::string hex(UnsignedInteger value) {
   return std::string{std::begin(buffer), result.ptr};
 }
 
-// Return the specified unsigned `value` formatted as a lower-case hexadecimal
-// string with leading zeroes.
+// Write to the specified `destination` the specified unsigned `value`
+// formatted as a lower-case hexadecimal string with leading zeroes.  Exactly
+// two characters are written for each byte of `UnsignedInteger`.
 template <typename UnsignedInteger>
-std::string hex_padded(UnsignedInteger value) {
+void write_hex_padded(char* destination, UnsignedInteger value) {
   static_assert(!std::numeric_limits<UnsignedInteger>::is_signed);
 
-  // 4 bits per hex digit char.
-  char buffer[std::numeric_limits<UnsignedInteger>::digits / 4];
+  const char* const pairs = detail::hex_tables.digit_pairs;
+  for (std::size_t i = sizeof(value); i != 0; --i) {
+    const std::size_t byte = value & 0xff;
+    destination[2 * i - 2] = pairs[2 * byte];
+    destination[2 * i - 1] = pairs[2 * byte + 1];
+    value = static_cast<UnsignedInteger>(value >> 8);
+  }
+}
 
-  const int base = 16;
-  auto result =
-      std::to_chars(std::begin(buffer), std::end(buffer), value, base);
-  assert(result.ec == std::errc());
+// Append to the specified `destination` the specified unsigned `value`
+// formatted as a lower-case hexadecimal string with leading zeroes.
+template <typename UnsignedInteger>
+void append_hex_padded(std::string& destination, UnsignedInteger value) {
+  const std::size_t begin = destination.size();
+  destination.resize(begin + 2 * sizeof(value));
+  write_hex_padded(&destination[begin], value);
+}
 
-  const auto num_zeroes = sizeof(buffer) - (result.ptr - std::begin(buffer));
-  std::string padded(num_zeroes, '0');
-  padded.append(std::begin(buffer), result.ptr);
+// Return the specified unsigned `value` formatted as a lower-case hexadecimal
+// string with leading zeroes.
+template <typename UnsignedInteger>
+std::string hex_padded(UnsignedInteger value) {
+  std::string padded;
+  append_hex_padded(padded, value);
   return padded;
 }
 
+// Return the value of the specified `digits`, which are hexadecimal digits of
+// either case, or return `nullopt` if `digits` is empty, has more than 16
+// characters, or contains a character that is not a hexadecimal digit.
+inline Optional<std::uint64_t> parse_hex(StringView digits) {
+  if (digits.empty() || digits.size() > 16) {
+    return nullopt;
+  }
+
+  const std::uint8_t* const values = detail::hex_tables.digit_values;
+  std::uint64_t value = 0;
+  // The high bits of `invalid` are set if any character is not a digit.
+  std::uint8_t invalid = 0;
+  for (const char digit : digits) {
+    const std::uint8_t digit_value = values[static_cast<unsigned char>(digit)];
+    invalid |= digit_value;
+    value = (value << 4) | (digit_value & 0xf);
+  }
+  if (invalid & 0xf0) {
+    return nullopt;
+  }
+  return value;
+}
+
 }  // namespace tracing
 }  // namespace datadog
\ No newline at end of file
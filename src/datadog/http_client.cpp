@@ -1,6 +1,8 @@
 #include <datadog/http_client.h>
 
 #include <algorithm>
+#include <cassert>
+#include <utility>
 
 namespace datadog {
 namespace tracing {
@@ -9,31 +11,25 @@ constexpr StringView k_scheme_separator = "://";
 constexpr StringView k_supported[] = {"http", "https", "unix", "http+unix",
                                       "https+unix"};
 
-Expected<HTTPClient::URL> HTTPClient::URL::parse(StringView input) {
+namespace {
+
+bool is_unix_scheme(StringView scheme) {
+  return scheme == "unix" || scheme == "http+unix" || scheme == "https+unix";
+}
+
+}  // namespace
+
+Optional<HTTPClient::URLView> HTTPClient::URLView::split(StringView input) {
   const auto after_scheme = input.find(k_scheme_separator);
   if (after_scheme == StringView::npos) {
-    std::string message;
-    message += "Datadog Agent URL is missing the \"://\" separator: \"";
-    append(message, input);
-    message += '\"';
-    return Error{Error::URL_MISSING_SEPARATOR, std::move(message)};
+    return nullopt;
   }
 
-  const StringView scheme = input.substr(0, after_scheme);
-  const auto found =
-      std::find(std::begin(k_supported), std::end(k_supported), scheme);
-  if (found == std::end(k_supported)) {
-    std::string message;
-    message += "Unsupported URI scheme \"";
-    append(message, scheme);
-    message += "\" in Datadog Agent URL \"";
-    append(message, input);
-    message += "\". The following are supported:";
-    for (const auto& supported_scheme : k_supported) {
-      message += ' ';
-      append(message, supported_scheme);
-    }
-    return Error{Error::URL_UNSUPPORTED_SCHEME, std::move(message)};
+  URLView result;
+  result.scheme = input.substr(0, after_scheme);
+  if (std::find(std::begin(k_supported), std::end(k_supported),
+                result.scheme) == std::end(k_supported)) {
+    return nullopt;
   }
 
   const StringView authority_and_path =
@@ -46,22 +42,12 @@ Expected<HTTPClient::URL> HTTPClient::URL::parse(StringView input) {
   // location.  Thus, if the scheme is for a unix domain socket, assume that
   // the entire part after the "://" is the path to the socket, and that
   // there is no resource path.
-  if (scheme == "unix" || scheme == "http+unix" || scheme == "https+unix") {
+  if (is_unix_scheme(result.scheme)) {
     if (authority_and_path.empty() || authority_and_path[0] != '/') {
-      std::string message;
-      message +=
-          "Unix domain socket paths for Datadog Agent must be absolute, i.e. "
-          "must begin with a "
-          "\"/\". The path \"";
-      append(message, authority_and_path);
-      message += "\" is not absolute. Error occurred for URL: \"";
-      append(message, input);
-      message += '\"';
-      return Error{Error::URL_UNIX_DOMAIN_SOCKET_PATH_NOT_ABSOLUTE,
-                   std::move(message)};
+      return nullopt;
     }
-    return HTTPClient::URL{std::string(scheme), std::string(authority_and_path),
-                           "", ""};
+    result.authority = authority_and_path;
+    return result;
   }
 
   // The scheme is either "http" or "https".  This means that the part after
@@ -70,11 +56,10 @@ Expected<HTTPClient::URL> HTTPClient::URL::parse(StringView input) {
   // the Datadog Agent service, and so they will not have a resource
   // location.  Still, let's parse it properly.
   const auto after_authority = authority_and_path.find('/');
-
-  std::string path;
-  std::string query;
+  result.authority = authority_and_path.substr(0, after_authority);
   if (after_authority != StringView::npos) {
-    StringView path_and_query = authority_and_path.substr(after_authority);
+    const StringView path_and_query =
+        authority_and_path.substr(after_authority);
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstringop-overread"
@@ -83,18 +68,79 @@ Expected<HTTPClient::URL> HTTPClient::URL::parse(StringView input) {
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC diagnostic pop
 #endif
+    result.path = path_and_query.substr(0, query_pos);
     if (query_pos != StringView::npos) {
-      path = std::string(path_and_query.substr(0, query_pos));
-      query = std::string(path_and_query.substr(query_pos + 1));
-    } else {
-      path = std::string(path_and_query);
+      result.query = path_and_query.substr(query_pos + 1);
     }
   }
 
-  return HTTPClient::URL{
-      std::string(scheme),
-      std::string(authority_and_path.substr(0, after_authority)),
-      std::move(path), std::move(query)};
+  return result;
+}
+
+Expected<HTTPClient::URL> HTTPClient::URL::parse(StringView input) {
+  if (const auto view = URLView::split(input)) {
+    return HTTPClient::URL{std::string(view->scheme),
+                           std::string(view->authority),
+                           std::string(view->path), std::string(view->query)};
+  }
+
+  // `input` is not a valid URL.  Say why.
+  const auto after_scheme = input.find(k_scheme_separator);
+  if (after_scheme == StringView::npos) {
+    std::string message;
+    message += "Datadog Agent URL is missing the \"://\" separator: \"";
+    append(message, input);
+    message += '\"';
+    return Error{Error::URL_MISSING_SEPARATOR, std::move(message)};
+  }
+
+  const StringView scheme = input.substr(0, after_scheme);
+  if (std::find(std::begin(k_supported), std::end(k_supported), scheme) ==
+      std::end(k_supported)) {
+    std::string message;
+    message += "Unsupported URI scheme \"";
+    append(message, scheme);
+    message += "\" in Datadog Agent URL \"";
+    append(message, input);
+    message += "\". The following are supported:";
+    for (const auto& supported_scheme : k_supported) {
+      message += ' ';
+      append(message, supported_scheme);
+    }
+    return Error{Error::URL_UNSUPPORTED_SCHEME, std::move(message)};
+  }
+
+  const StringView authority_and_path =
+      input.substr(after_scheme + k_scheme_separator.size());
+  std::string message;
+  message +=
+      "Unix domain socket paths for Datadog Agent must be absolute, i.e. "
+      "must begin with a "
+      "\"/\". The path \"";
+  append(message, authority_and_path);
+  message += "\" is not absolute. Error occurred for URL: \"";
+  append(message, input);
+  message += '\"';
+  return Error{Error::URL_UNIX_DOMAIN_SOCKET_PATH_NOT_ABSOLUTE,
+               std::move(message)};
+}
+
+Expected<void> HTTPClient::post_segments(
+    const URL& url, HeadersSetter set_headers, BodySegments body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  std::size_t size = 0;
+  for (const auto& segment : body) {
+    assert(segment);
+    size += segment->size();
+  }
+  std::string concatenated;
+  concatenated.reserve(size);
+  for (const auto& segment : body) {
+    concatenated += *segment;
+  }
+  return post(url, std::move(set_headers), std::move(concatenated),
+              std::move(on_response), std::move(on_error), deadline);
 }
 
 }  // namespace tracing
@@ -0,0 +1,174 @@
+#include "interned_string.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The pool of interned strings is divided into this many shards, each of
+// which holds at most `max_strings_per_shard` strings totaling at most
+// `max_bytes_per_shard` bytes.
+constexpr std::size_t num_shards = 16;
+constexpr std::size_t max_strings_per_shard = 512;
+constexpr std::size_t max_bytes_per_shard = 64 * 1024;
+// Longer strings, such as SQL queries used as resources, are not interned.
+constexpr std::size_t max_interned_size = 256;
+// The number of recently interned strings that each thread remembers.  A
+// power of two.
+constexpr std::size_t thread_cache_size = 64;
+
+// Return the 64-bit FNV-1a hash of the specified `value`.
+std::uint64_t hash(StringView value) {
+  std::uint64_t result = 14695981039346656037ULL;
+  for (const char c : value) {
+    result = (result ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+  }
+  return result;
+}
+
+struct StringViewHash {
+  std::size_t operator()(StringView value) const {
+    return static_cast<std::size_t>(hash(value));
+  }
+};
+
+struct alignas(64) Shard {
+  std::shared_mutex mutex;
+  // The keys refer to the values.  Guarded by `mutex`.
+  std::unordered_map<StringView, std::unique_ptr<const std::string>,
+                     StringViewHash>
+      strings;
+  // The total size of `strings`.  Guarded by `mutex`.
+  std::size_t bytes = 0;
+};
+
+// The shards are never destroyed, so that interned strings remain valid until
+// the process exits, including while static objects are destroyed.
+Shard* shards() {
+  static Shard* const result = new Shard[num_shards];
+  return result;
+}
+
+}  // namespace
+
+const std::string* intern(StringView value) {
+  if (value.size() > max_interned_size) {
+    return nullptr;
+  }
+
+  // Each thread remembers recently interned strings both by the address of
+  // the value interned and by its hash.  Values are usually interned again
+  // from the same source, such as the tracer's `SpanDefaults`, and looking up
+  // a value by its address is cheaper than hashing it.
+  struct BySource {
+    const char* source = nullptr;
+    const std::string* interned = nullptr;
+  };
+  thread_local BySource by_source[thread_cache_size];
+  thread_local const std::string* by_hash[thread_cache_size] = {};
+
+  BySource& source_entry =
+      by_source[(reinterpret_cast<std::uintptr_t>(value.data()) >> 3) &
+                (thread_cache_size - 1)];
+  if (source_entry.source == value.data() && source_entry.interned &&
+      StringView(*source_entry.interned) == value) {
+    return source_entry.interned;
+  }
+  const std::uint64_t value_hash = hash(value);
+  const std::string*& hash_entry =
+      by_hash[value_hash & (thread_cache_size - 1)];
+  const auto remember = [&](const std::string* interned) {
+    source_entry = BySource{value.data(), interned};
+    hash_entry = interned;
+    return interned;
+  };
+  if (hash_entry && StringView(*hash_entry) == value) {
+    return remember(hash_entry);
+  }
+
+  // The low bits of the hash select the cache entry, and the high bits the
+  // shard.
+  Shard& shard = shards()[(value_hash >> 32) % num_shards];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const auto found = shard.strings.find(value);
+    if (found != shard.strings.end()) {
+      return remember(found->second.get());
+    }
+  }
+
+  std::lock_guard<std::shared_mutex> lock(shard.mutex);
+  const auto found = shard.strings.find(value);
+  if (found != shard.strings.end()) {
+    return remember(found->second.get());
+  }
+  if (shard.strings.size() >= max_strings_per_shard ||
+      shard.bytes + value.size() > max_bytes_per_shard) {
+    return nullptr;
+  }
+  auto copy = std::make_unique<const std::string>(value);
+  const std::string* result = copy.get();
+  shard.strings.emplace(StringView(*result), std::move(copy));
+  shard.bytes += value.size();
+  return remember(result);
+}
+
+const std::string& InternedString::empty_string() {
+  static const std::string* const empty = [] {
+    const std::string* interned = intern(StringView());
+    return interned ? interned : new std::string();
+  }();
+  return *empty;
+}
+
+void InternedString::assign(StringView value) {
+  if (const std::string* interned = intern(value)) {
+    release();
+    value_ = address_of(*interned);
+  } else if (std::string* owned_value = owned()) {
+    owned_value->assign(value.data(), value.size());
+  } else {
+    value_ = address_of(*new std::string(value)) | owned_bit;
+  }
+}
+
+InternedString::InternedString(const InternedString& other)
+    : value_(other.value_) {
+  if (const std::string* other_value = other.owned()) {
+    value_ = address_of(*new std::string(*other_value)) | owned_bit;
+  }
+}
+
+InternedString::InternedString(InternedString&& other) noexcept
+    : value_(other.value_) {
+  other.value_ = address_of(empty_string());
+}
+
+InternedString& InternedString::operator=(const InternedString& other) {
+  if (this != &other) {
+    if (const std::string* other_value = other.owned()) {
+      assign(*other_value);
+    } else {
+      release();
+      value_ = other.value_;
+    }
+  }
+  return *this;
+}
+
+InternedString& InternedString::operator=(InternedString&& other) noexcept {
+  if (this != &other) {
+    release();
+    value_ = other.value_;
+    other.value_ = address_of(empty_string());
+  }
+  return *this;
+}
+
+}  // namespace tracing
+}  // namespace datadog
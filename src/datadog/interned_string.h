@@ -0,0 +1,138 @@
+#pragma once
+
+// This component provides a class, `InternedString`, that is the type of the
+// string fields of `SpanData`: its service, service type, name, and resource.
+//
+// The spans of a process usually have few distinct services, service types,
+// and names, and a bounded set of resources.  Rather than own a copy of its
+// value, an `InternedString` refers to the one copy of the value kept in a
+// process-wide pool of strings.  Copying an `InternedString` then copies a
+// pointer, and a span's strings neither allocate nor take the space of a
+// `std::string` each.
+//
+// Interned strings are never freed, so that an `InternedString` remains valid
+// regardless of which tracer created it.  The pool is therefore bounded, and
+// long strings are not interned: once the pool is full, an `InternedString`
+// whose value is not already in the pool owns a copy of it instead, as it
+// does for a long value.  Looking up a value in the pool usually hits a
+// per-thread cache of recently interned strings, and otherwise takes a shared
+// lock on one of several shards of the pool.
+
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+class InternedString {
+  // The address of the value, whose lowest bit is set if the value is owned,
+  // i.e. is not interned.  An owned value is a `std::string` allocated by
+  // `assign`.  Otherwise, the value is interned or is `empty_string()`.  An
+  // `InternedString` is thus the size of a pointer.
+  std::uintptr_t value_;
+
+  static constexpr std::uintptr_t owned_bit = 1;
+
+  static const std::string& empty_string();
+
+  static std::uintptr_t address_of(const std::string& value) noexcept {
+    return reinterpret_cast<std::uintptr_t>(&value);
+  }
+  const std::string* get() const noexcept {
+    return reinterpret_cast<const std::string*>(value_ & ~owned_bit);
+  }
+  std::string* owned() const noexcept {
+    return value_ & owned_bit
+               ? reinterpret_cast<std::string*>(value_ & ~owned_bit)
+               : nullptr;
+  }
+  void release() noexcept { delete owned(); }
+
+  void assign(StringView value);
+
+ public:
+  InternedString() noexcept : value_(address_of(empty_string())) {}
+  InternedString(StringView value) : InternedString() { assign(value); }
+  InternedString(const std::string& value)
+      : InternedString(StringView(value)) {}
+  InternedString(const char* value) : InternedString(StringView(value)) {}
+
+  InternedString(const InternedString& other);
+  InternedString(InternedString&& other) noexcept;
+  InternedString& operator=(const InternedString& other);
+  InternedString& operator=(InternedString&& other) noexcept;
+  ~InternedString() { release(); }
+  InternedString& operator=(StringView value) {
+    assign(value);
+    return *this;
+  }
+  InternedString& operator=(const std::string& value) {
+    assign(value);
+    return *this;
+  }
+  InternedString& operator=(const char* value) {
+    assign(value);
+    return *this;
+  }
+
+  const std::string& str() const noexcept { return *get(); }
+  operator const std::string&() const noexcept { return *get(); }
+  operator StringView() const noexcept { return *get(); }
+
+  std::size_t size() const noexcept { return get()->size(); }
+  bool empty() const noexcept { return get()->empty(); }
+  const char* data() const noexcept { return get()->data(); }
+  const char* c_str() const noexcept { return get()->c_str(); }
+
+  // Return whether the value is interned, rather than owned.
+  bool interned() const noexcept { return !(value_ & owned_bit); }
+
+  friend bool operator==(const InternedString& left,
+                         const InternedString& right) {
+    // Equal interned values are the same string.
+    return left.value_ == right.value_ ||
+           ((!left.interned() || !right.interned()) &&
+            *left.get() == *right.get());
+  }
+  friend bool operator==(const InternedString& left, StringView right) {
+    return StringView(*left.get()) == right;
+  }
+  friend bool operator==(const InternedString& left, const std::string& right) {
+    return *left.get() == right;
+  }
+  friend bool operator==(const InternedString& left, const char* right) {
+    return *left.get() == right;
+  }
+  template <typename Other>
+  friend bool operator==(const Other& left, const InternedString& right) {
+    return right == left;
+  }
+  template <typename Other>
+  friend bool operator!=(const InternedString& left, const Other& right) {
+    return !(left == right);
+  }
+  template <typename Other>
+  friend bool operator!=(const Other& left, const InternedString& right) {
+    return !(right == left);
+  }
+  friend bool operator!=(const InternedString& left,
+                         const InternedString& right) {
+    return !(left == right);
+  }
+  friend std::ostream& operator<<(std::ostream& stream,
+                                  const InternedString& value) {
+    return stream << *value.get();
+  }
+};
+
+// Return the copy of the specified `value` in the process-wide pool of
+// strings, adding it to the pool if necessary, or return null if `value` is
+// not in the pool and cannot be added to it.
+const std::string* intern(StringView value);
+
+}  // namespace tracing
+}  // namespace datadog
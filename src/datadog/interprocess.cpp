@@ -0,0 +1,133 @@
+#include "interprocess.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "platform_util.h"
+#include "random.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// While waiting for the lock, check this often whether its holder exited.
+constexpr unsigned spins_per_liveness_check = 1024;
+
+// Return a nonzero identity for the current process: its process ID in the
+// low half, and a random number in the high half.
+std::uint64_t new_process_identity() {
+  std::uint64_t nonce;
+  do {
+    nonce = random_uint64() >> 32;
+  } while (nonce == 0);
+  return (nonce << 32) | std::uint32_t(get_process_id());
+}
+
+struct Cache {
+  static std::uint64_t process_identity;
+
+  static void recalculate_values() {
+    process_identity = new_process_identity();
+  }
+
+  Cache() {
+    recalculate_values();
+    at_fork_in_child(&recalculate_values);
+  }
+};
+
+std::uint64_t Cache::process_identity;
+
+// Return the identity of the current process.  The function-local static
+// makes it safe to call during static initialization.
+std::uint64_t process_identity() {
+  static Cache cache;
+  (void)cache;
+  return Cache::process_identity;
+}
+
+// Return whether the process having the specified `identity` is not the
+// current process and has exited.
+bool abandoned(std::uint64_t identity) {
+  const int pid = int(std::uint32_t(identity));
+  // The current process holds locks only under its own identity, so an
+  // identity having its process ID belonged to an earlier process.
+  return pid == get_process_id() || !process_exists(pid);
+}
+
+// Copy the specified `size` bytes from `source` into the ring having the
+// specified `capacity`, whose bytes begin at `data`, at the specified
+// `position`, wrapping around the end of the ring.
+void write(char* data, std::uint64_t capacity, std::uint64_t position,
+           const char* source, std::size_t size) {
+  const std::size_t offset = position % capacity;
+  const std::size_t first = std::min<std::size_t>(size, capacity - offset);
+  std::memcpy(data + offset, source, first);
+  std::memcpy(data, source + first, size - first);
+}
+
+// Copy the specified `size` bytes from the ring having the specified
+// `capacity`, whose bytes begin at `data`, at the specified `position`, into
+// `destination`, wrapping around the end of the ring.
+void read(const char* data, std::uint64_t capacity, std::uint64_t position,
+          char* destination, std::size_t size) {
+  const std::size_t offset = position % capacity;
+  const std::size_t first = std::min<std::size_t>(size, capacity - offset);
+  std::memcpy(destination, data + offset, first);
+  std::memcpy(destination + first, data, size - first);
+}
+
+}  // namespace
+
+bool ProcessLock::lock() {
+  const std::uint64_t self = process_identity();
+  for (unsigned spins = 1;; ++spins) {
+    std::uint64_t owner = 0;
+    if (owner_.compare_exchange_weak(owner, self, std::memory_order_acquire)) {
+      return false;
+    }
+    if (spins % spins_per_liveness_check == 0 && owner != 0 &&
+        owner != self && abandoned(owner) &&
+        owner_.compare_exchange_strong(owner, self,
+                                       std::memory_order_acquire)) {
+      return true;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void ProcessLock::unlock() { owner_.store(0, std::memory_order_release); }
+
+std::uint64_t SharedRing::space_for(StringView record) {
+  return sizeof(RecordSize) + std::uint64_t(record.size());
+}
+
+void SharedRing::push(char* data, StringView record) {
+  const RecordSize size = static_cast<RecordSize>(record.size());
+  write(data, capacity, tail, reinterpret_cast<const char*>(&size),
+        sizeof size);
+  write(data, capacity, tail + sizeof size, record.data(), size);
+  tail += sizeof size + std::uint64_t(size);
+}
+
+bool SharedRing::pop(const char* data, std::string& record) {
+  if (empty()) {
+    return false;
+  }
+  RecordSize size;
+  read(data, capacity, head, reinterpret_cast<char*>(&size), sizeof size);
+  record.resize(size);
+  read(data, capacity, head + sizeof size, &record[0], size);
+  head += sizeof size + std::uint64_t(size);
+  return true;
+}
+
+void SharedRing::drop(const char* data) {
+  RecordSize size;
+  read(data, capacity, head, reinterpret_cast<char*>(&size), sizeof size);
+  head += sizeof size + std::uint64_t(size);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,84 @@
+#pragma once
+
+// This component provides the parts that `SharedTraceBuffer`, `SpillFile`,
+// and `SharedSamplerState` have in common, each of which keeps its data in
+// memory shared among processes.
+//
+// `ProcessLock` is a spin lock in shared memory.  It records which process
+// holds it, so that a process waiting for it can take it over if the holder
+// exited without releasing it.  A process is identified by its process ID
+// together with a random number chosen when the process starts, and again
+// when it forks.  That way, a lock that was left held by an earlier process
+// having the same process ID, e.g. in a file that outlived the process, is
+// not mistaken for one held by another thread of the current process.
+//
+// `SharedRing` is a ring of records, each of which is preceded by its size,
+// in shared memory.  It is guarded by a `ProcessLock`.
+//
+// Both are standard layout types, so that they can be placed at a fixed
+// offset in shared memory, and both are valid when zeroed.
+
+#include <datadog/string_view.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+class ProcessLock {
+  // The identity of the process holding the lock, as returned by
+  // `process_identity`, or zero.
+  std::atomic<std::uint64_t> owner_{0};
+
+ public:
+  // Take the lock on behalf of this process, waiting while another process,
+  // or another thread of this process, holds it.  Return true if the lock
+  // was taken over from a process that exited while holding it, in which case
+  // the data that it guards might have been left half written.  Return false
+  // otherwise.
+  bool lock();
+  void unlock();
+};
+
+struct SharedRing {
+  // Each record is preceded by its size, in this type.
+  using RecordSize = std::uint32_t;
+
+  // The number of bytes ever removed from and appended to the ring.  Their
+  // difference is the number of bytes in the ring.
+  std::uint64_t head = 0;
+  std::uint64_t tail = 0;
+  // The number of bytes that the ring can hold.
+  std::uint64_t capacity = 0;
+
+  // Return whether the ring holds no records.
+  bool empty() const { return head == tail; }
+
+  // Return the number of bytes that the specified `record` takes in a ring.
+  static std::uint64_t space_for(StringView record);
+
+  // Append the specified `record` to the ring, whose bytes begin at the
+  // specified `data`.  The behavior is undefined unless there is
+  // `space_for(record)` in the ring.
+  void push(char* data, StringView record);
+
+  // Remove the oldest record from the ring, whose bytes begin at the
+  // specified `data`, and assign it to the specified `record`.  Return
+  // whether there was a record to remove.
+  bool pop(const char* data, std::string& record);
+
+  // Remove the oldest record from the ring, whose bytes begin at the
+  // specified `data`, without reading it.  The ring must not be empty.
+  void drop(const char* data);
+};
+
+static_assert(sizeof(ProcessLock) == sizeof(std::uint64_t),
+              "A lock in shared memory has a fixed size.");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "A lock in shared memory must not depend on the process.");
+
+}  // namespace tracing
+}  // namespace datadog
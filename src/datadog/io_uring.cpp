@@ -0,0 +1,294 @@
+#include "io_uring.h"
+
+#include <datadog/error.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define DD_TRACE_IO_URING_AVAILABLE 1
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#endif
+
+namespace datadog {
+namespace tracing {
+
+#ifdef DD_TRACE_IO_URING_AVAILABLE
+namespace {
+
+template <typename T>
+T* at(void* base, unsigned offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+Error unavailable(const char* what) {
+  std::string message = "io_uring is unavailable: ";
+  message += what;
+  message += ": ";
+  message += std::strerror(errno);
+  return Error{Error::IO_URING_UNAVAILABLE, std::move(message)};
+}
+
+}  // namespace
+
+IoUring::IoUring()
+    : fd_(-1),
+      rings_(MAP_FAILED),
+      rings_size_(0),
+      entries_(MAP_FAILED),
+      entries_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_array_(nullptr),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(0),
+      cqes_(nullptr),
+      prepared_tail_(0) {}
+
+Expected<std::unique_ptr<IoUring>> IoUring::create(unsigned entries) {
+  std::unique_ptr<IoUring> ring{new IoUring};
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof params);
+  ring->fd_ =
+      static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+  if (ring->fd_ == -1) {
+    return unavailable("io_uring_setup");
+  }
+  // Waiting with a timeout requires `IORING_FEAT_EXT_ARG` (Linux 5.11), which
+  // implies the other features used here.
+  const unsigned required =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ((params.features & required) != required) {
+    errno = ENOSYS;
+    return unavailable("io_uring_setup");
+  }
+
+  // The submission and completion rings share one mapping.
+  ring->rings_size_ = std::max<std::size_t>(
+      params.sq_off.array + params.sq_entries * sizeof(unsigned),
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  ring->rings_ = ::mmap(nullptr, ring->rings_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd_,
+                        IORING_OFF_SQ_RING);
+  if (ring->rings_ == MAP_FAILED) {
+    return unavailable("mmap");
+  }
+  ring->entries_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  ring->entries_ = ::mmap(nullptr, ring->entries_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd_,
+                          IORING_OFF_SQES);
+  if (ring->entries_ == MAP_FAILED) {
+    return unavailable("mmap");
+  }
+
+  void* const rings = ring->rings_;
+  ring->sq_head_ = at<unsigned>(rings, params.sq_off.head);
+  ring->sq_tail_ = at<unsigned>(rings, params.sq_off.tail);
+  ring->sq_mask_ = *at<unsigned>(rings, params.sq_off.ring_mask);
+  ring->sq_entries_ = *at<unsigned>(rings, params.sq_off.ring_entries);
+  ring->sq_array_ = at<unsigned>(rings, params.sq_off.array);
+  ring->cq_head_ = at<unsigned>(rings, params.cq_off.head);
+  ring->cq_tail_ = at<unsigned>(rings, params.cq_off.tail);
+  ring->cq_mask_ = *at<unsigned>(rings, params.cq_off.ring_mask);
+  ring->cqes_ = at<io_uring_cqe>(rings, params.cq_off.cqes);
+  ring->prepared_tail_ = *ring->sq_tail_;
+
+  return ring;
+}
+
+IoUring::~IoUring() {
+  if (entries_ != MAP_FAILED) {
+    ::munmap(entries_, entries_size_);
+  }
+  if (rings_ != MAP_FAILED) {
+    ::munmap(rings_, rings_size_);
+  }
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void* IoUring::prepare(std::uint8_t opcode, int fd, std::uint64_t user_data) {
+  if (prepared_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >=
+      sq_entries_) {
+    // The submission queue is full.  Submit what is in it to make room.
+    if (!enter(false, std::chrono::milliseconds(0)) ||
+        prepared_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >=
+            sq_entries_) {
+      return nullptr;
+    }
+  }
+
+  const unsigned index = prepared_tail_ & sq_mask_;
+  auto* entry = static_cast<io_uring_sqe*>(entries_) + index;
+  std::memset(entry, 0, sizeof *entry);
+  entry->opcode = opcode;
+  entry->fd = fd;
+  entry->user_data = user_data;
+  sq_array_[index] = index;
+  ++prepared_tail_;
+  return entry;
+}
+
+bool IoUring::prepare_poll(int fd, short events, std::uint64_t user_data) {
+  auto* entry =
+      static_cast<io_uring_sqe*>(prepare(IORING_OP_POLL_ADD, fd, user_data));
+  if (!entry) {
+    return false;
+  }
+  std::uint32_t mask = static_cast<std::uint16_t>(events);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // The kernel reads the mask as two little-endian halves.
+  mask = (mask << 16) | (mask >> 16);
+#endif
+  entry->poll32_events = mask;
+  return true;
+}
+
+bool IoUring::prepare_sendmsg(int fd, const msghdr* message, int flags,
+                              std::uint64_t user_data) {
+  auto* entry =
+      static_cast<io_uring_sqe*>(prepare(IORING_OP_SENDMSG, fd, user_data));
+  if (!entry) {
+    return false;
+  }
+  entry->addr = reinterpret_cast<std::uintptr_t>(message);
+  entry->len = 1;
+  entry->msg_flags = static_cast<std::uint32_t>(flags);
+  return true;
+}
+
+bool IoUring::prepare_recv(int fd, void* buffer, std::size_t size,
+                           std::uint64_t user_data) {
+  auto* entry =
+      static_cast<io_uring_sqe*>(prepare(IORING_OP_RECV, fd, user_data));
+  if (!entry) {
+    return false;
+  }
+  entry->addr = reinterpret_cast<std::uintptr_t>(buffer);
+  entry->len = static_cast<std::uint32_t>(size);
+  return true;
+}
+
+bool IoUring::prepare_cancel(std::uint64_t target, std::uint64_t user_data) {
+  auto* entry = static_cast<io_uring_sqe*>(
+      prepare(IORING_OP_ASYNC_CANCEL, -1, user_data));
+  if (!entry) {
+    return false;
+  }
+  entry->addr = target;
+  return true;
+}
+
+Expected<void> IoUring::submit_and_wait(std::chrono::milliseconds timeout) {
+  return enter(true, timeout);
+}
+
+Expected<void> IoUring::enter(bool wait, std::chrono::milliseconds timeout) {
+  __atomic_store_n(sq_tail_, prepared_tail_, __ATOMIC_RELEASE);
+  const unsigned to_submit =
+      prepared_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (!wait && to_submit == 0) {
+    return nullopt;
+  }
+
+  __kernel_timespec time;
+  time.tv_sec = timeout.count() / 1000;
+  time.tv_nsec = (timeout.count() % 1000) * 1'000'000;
+  io_uring_getevents_arg arg;
+  std::memset(&arg, 0, sizeof arg);
+  arg.sigmask_sz = _NSIG / 8;
+  arg.ts = reinterpret_cast<std::uintptr_t>(&time);
+
+  const unsigned flags =
+      wait ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+  if (::syscall(__NR_io_uring_enter, fd_, to_submit, wait ? 1 : 0, flags,
+                wait ? &arg : nullptr, wait ? sizeof arg : 0) < 0 &&
+      errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+    std::string message = "io_uring_enter: ";
+    message += std::strerror(errno);
+    return Error{Error::IO_URING_UNAVAILABLE, std::move(message)};
+  }
+  return nullopt;
+}
+
+void IoUring::for_each_completion(
+    const std::function<void(std::uint64_t user_data, int result)>& handle) {
+  unsigned head = *cq_head_;
+  const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    const auto& completion =
+        static_cast<const io_uring_cqe*>(cqes_)[head & cq_mask_];
+    handle(completion.user_data, completion.res);
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+#else  // io_uring is not available on this platform
+
+IoUring::IoUring()
+    : fd_(-1),
+      rings_(nullptr),
+      rings_size_(0),
+      entries_(nullptr),
+      entries_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_array_(nullptr),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(0),
+      cqes_(nullptr),
+      prepared_tail_(0) {}
+
+Expected<std::unique_ptr<IoUring>> IoUring::create(unsigned) {
+  return Error{Error::IO_URING_UNAVAILABLE,
+               "io_uring is unavailable on this platform."};
+}
+
+IoUring::~IoUring() {}
+
+void* IoUring::prepare(std::uint8_t, int, std::uint64_t) { return nullptr; }
+
+bool IoUring::prepare_poll(int, short, std::uint64_t) { return false; }
+
+bool IoUring::prepare_sendmsg(int, const msghdr*, int, std::uint64_t) {
+  return false;
+}
+
+bool IoUring::prepare_recv(int, void*, std::size_t, std::uint64_t) {
+  return false;
+}
+
+bool IoUring::prepare_cancel(std::uint64_t, std::uint64_t) { return false; }
+
+Expected<void> IoUring::submit_and_wait(std::chrono::milliseconds) {
+  return Error{Error::IO_URING_UNAVAILABLE,
+               "io_uring is unavailable on this platform."};
+}
+
+Expected<void> IoUring::enter(bool, std::chrono::milliseconds) {
+  return submit_and_wait(std::chrono::milliseconds(0));
+}
+
+void IoUring::for_each_completion(
+    const std::function<void(std::uint64_t, int)>&) {}
+
+#endif
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,106 @@
+#pragma once
+
+// This component provides a `class`, `IoUring`, that is a minimal interface to
+// Linux's [io_uring][1], as used by `SocketHTTPClient` (see
+// `socket_http_client.h`) in place of `poll`.
+//
+// `IoUring` is written directly in terms of the io_uring system calls, rather
+// than liburing, and supports only the operations that `SocketHTTPClient`
+// needs.  Each `prepare_*` member function adds an operation to the
+// submission queue, identified by a caller-chosen `user_data`, and
+// `submit_and_wait` submits all of the prepared operations in one system call,
+// which also waits for completions.  The ring has no kernel polling thread
+// (`IORING_SETUP_SQPOLL`), so nothing runs while the caller waits.
+//
+// The memory referred to by an operation must remain valid until the
+// operation's completion is delivered by `for_each_completion`.
+//
+// `IoUring::create` returns an error other than on Linux, and on kernels
+// older than 5.11 or where io_uring is disabled.
+//
+// [1]: https://kernel.dk/io_uring.pdf
+
+#include <datadog/expected.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+struct msghdr;
+
+namespace datadog {
+namespace tracing {
+
+class IoUring {
+  int fd_;
+  // The mapped submission and completion rings, and submission entries.
+  void* rings_;
+  std::size_t rings_size_;
+  void* entries_;
+  std::size_t entries_size_;
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  void* cqes_;
+  // The tail of the submission queue including the operations prepared since
+  // the previous submission.
+  unsigned prepared_tail_;
+
+  IoUring();
+
+  // Return a zeroed submission entry for the specified operation `opcode`,
+  // submitting the prepared operations first if the queue is full, or return
+  // null if that is not possible.
+  void* prepare(std::uint8_t opcode, int fd, std::uint64_t user_data);
+  // Submit the prepared operations, and if the specified `wait` is true, wait
+  // until at least one operation completes or until the specified `timeout`.
+  Expected<void> enter(bool wait, std::chrono::milliseconds timeout);
+
+ public:
+  // Return a ring whose submission queue has room for at least the specified
+  // number of `entries`, or return an error if io_uring is unavailable.
+  static Expected<std::unique_ptr<IoUring>> create(unsigned entries);
+  ~IoUring();
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Each of these prepares an operation identified by the specified
+  // `user_data`, and returns false if the submission queue is full and cannot
+  // be submitted.
+  //
+  // Wait until the specified `fd` has any of the specified poll `events`.
+  // The result is the events that occurred.
+  bool prepare_poll(int fd, short events, std::uint64_t user_data);
+  // Send the specified `message` on the specified `fd`, as `sendmsg` does
+  // with the specified `flags`.
+  bool prepare_sendmsg(int fd, const msghdr* message, int flags,
+                       std::uint64_t user_data);
+  // Receive at most the specified `size` bytes from the specified `fd` into
+  // the specified `buffer`.
+  bool prepare_recv(int fd, void* buffer, std::size_t size,
+                    std::uint64_t user_data);
+  // Cancel the operation identified by the specified `target`.  The canceled
+  // operation completes with `-ECANCELED`, unless it completed already.
+  bool prepare_cancel(std::uint64_t target, std::uint64_t user_data);
+
+  // Submit the prepared operations, and wait until at least one operation
+  // completes or until the specified `timeout`.
+  Expected<void> submit_and_wait(std::chrono::milliseconds timeout);
+
+  // Invoke the specified `handle` with the `user_data` and result of each
+  // operation that completed and has not yet been handled.  A negative result
+  // is the negation of an `errno` value.
+  void for_each_completion(
+      const std::function<void(std::uint64_t user_data, int result)>& handle);
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,149 @@
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+const char hex_digits[] = "0123456789abcdef";
+
+void append_escaped(std::string& destination, StringView string) {
+  destination += '"';
+  const char* const end = string.data() + string.size();
+  const char* run = string.data();
+  for (const char* cursor = run; cursor != end; ++cursor) {
+    const auto byte = static_cast<unsigned char>(*cursor);
+    if (byte >= 0x20 && byte != '"' && byte != '\\') {
+      continue;
+    }
+
+    destination.append(run, cursor);
+    run = cursor + 1;
+    switch (byte) {
+      case '"':
+        destination += "\\\"";
+        break;
+      case '\\':
+        destination += "\\\\";
+        break;
+      case '\b':
+        destination += "\\b";
+        break;
+      case '\f':
+        destination += "\\f";
+        break;
+      case '\n':
+        destination += "\\n";
+        break;
+      case '\r':
+        destination += "\\r";
+        break;
+      case '\t':
+        destination += "\\t";
+        break;
+      default:
+        destination += "\\u00";
+        destination += hex_digits[byte >> 4];
+        destination += hex_digits[byte & 0xF];
+    }
+  }
+  destination.append(run, end);
+  destination += '"';
+}
+
+void append_number(std::string& destination, double number) {
+  // Use the shorter of the two precisions that reads back as the same value.
+  char buffer[32];
+  int size = std::snprintf(buffer, sizeof buffer, "%.15g", number);
+  if (std::strtod(buffer, nullptr) != number) {
+    size = std::snprintf(buffer, sizeof buffer, "%.17g", number);
+  }
+  destination.append(buffer, size);
+
+  // Keep the number a floating point number when it is read back, as
+  // `nlohmann::json` does.
+  for (int i = 0; i < size; ++i) {
+    if (buffer[i] == '.' || buffer[i] == 'e') {
+      return;
+    }
+  }
+  destination += ".0";
+}
+
+}  // namespace
+
+JsonWriter::JsonWriter(std::string& destination) : destination_(destination) {}
+
+void JsonWriter::begin_object() {
+  separate();
+  destination_ += '{';
+  first_ = true;
+}
+
+void JsonWriter::end_object() {
+  destination_ += '}';
+  first_ = false;
+}
+
+void JsonWriter::begin_array() {
+  separate();
+  destination_ += '[';
+  first_ = true;
+}
+
+void JsonWriter::end_array() {
+  destination_ += ']';
+  first_ = false;
+}
+
+void JsonWriter::key(StringView name) {
+  separate();
+  append_escaped(destination_, name);
+  destination_ += ':';
+  first_ = true;
+}
+
+void JsonWriter::value(StringView string) {
+  separate();
+  append_escaped(destination_, string);
+}
+
+void JsonWriter::value(const char* string) { value(StringView{string}); }
+
+void JsonWriter::value(bool boolean) {
+  separate();
+  destination_ += boolean ? "true" : "false";
+}
+
+void JsonWriter::value(double number) {
+  if (!std::isfinite(number)) {
+    null();
+    return;
+  }
+  separate();
+  append_number(destination_, number);
+}
+
+void JsonWriter::null() {
+  separate();
+  destination_ += "null";
+}
+
+void JsonWriter::raw(StringView json) {
+  separate();
+  append(destination_, json);
+}
+
+void JsonWriter::separate() {
+  if (first_) {
+    first_ = false;
+  } else {
+    destination_ += ',';
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,101 @@
+#pragma once
+
+// This component provides a `class`, `JsonWriter`, that appends JSON to a
+// `std::string` as it is written, without first building a document in
+// memory.
+//
+// `JsonWriter` is used to produce payloads that are built often, such as
+// telemetry messages, where an `nlohmann::json` document would allocate once
+// for every value in the payload.  The caller is responsible for producing a
+// well-formed document: `JsonWriter` inserts the commas and colons between
+// elements, but does not check that objects alternate keys and values, nor
+// that every object or array is closed.
+//
+// For example,
+//
+//     std::string buffer;
+//     JsonWriter json{buffer};
+//     json.begin_object();
+//     json.member("name", "stella");
+//     json.key("points");
+//     json.begin_array();
+//     json.value(1);
+//     json.value(2.5);
+//     json.end_array();
+//     json.end_object();
+//
+// appends `{"name":"stella","points":[1,2.5]}` to `buffer`.
+
+#include <datadog/string_view.h>
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace datadog {
+namespace tracing {
+
+class JsonWriter {
+  std::string& destination_;
+  // Whether the next element is the first of the current object or array, or
+  // the value of a member whose key was just written.  If not, it is preceded
+  // by a comma.
+  bool first_ = true;
+
+ public:
+  // Append JSON to the specified `destination`, which must outlive this
+  // object.
+  explicit JsonWriter(std::string& destination);
+
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+
+  // Write the specified `name` of the next member of the current object.  The
+  // member's value is written next.
+  void key(StringView name);
+
+  void value(StringView string);
+  void value(const char* string);
+  void value(bool boolean);
+  // Non-finite numbers are written as `null`, since JSON cannot represent
+  // them.
+  void value(double number);
+  template <typename Integer>
+  std::enable_if_t<std::is_integral_v<Integer> &&
+                   !std::is_same_v<Integer, bool>>
+  value(Integer number);
+  void null();
+
+  // Write the specified `json`, which must be a complete JSON value, as the
+  // next element.
+  void raw(StringView json);
+
+  // Write a member of the current object having the specified `name` and
+  // `value`.
+  template <typename Value>
+  void member(StringView name, const Value& value);
+
+ private:
+  void separate();
+};
+
+template <typename Integer>
+std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>>
+JsonWriter::value(Integer number) {
+  separate();
+  char buffer[24];
+  const auto result = std::to_chars(buffer, buffer + sizeof buffer, number);
+  destination_.append(buffer, result.ptr);
+}
+
+template <typename Value>
+void JsonWriter::member(StringView name, const Value& value) {
+  key(name);
+  this->value(value);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -2,97 +2,225 @@
 
 #include <algorithm>
 #include <cmath>
-#include <numeric>
+#include <cstring>
+#include <thread>
 
 namespace datadog {
 namespace tracing {
+namespace {
+
+// Layout of an element of `Limiter::periods_`: the second plus one, truncated
+// to `tag_bits`, followed by the allowed count and then the requested count,
+// each `count_bits` wide.  The counts saturate rather than overflow.
+constexpr unsigned count_bits = 20;
+constexpr unsigned tag_bits = 64 - 2 * count_bits;
+constexpr std::uint64_t count_mask = (std::uint64_t(1) << count_bits) - 1;
+constexpr std::uint64_t tag_mask = (std::uint64_t(1) << tag_bits) - 1;
+
+std::uint64_t period_tag(std::uint64_t second) {
+  return (second + 1) & tag_mask;
+}
+
+// Return the number of bits needed to represent the specified `value`, or one
+// if `value` is zero.
+unsigned bit_width(std::uint64_t value) {
+  unsigned bits = 1;
+  while (bits < 64 && (value >> bits) != 0) {
+    ++bits;
+  }
+  return bits;
+}
+
+}  // namespace
 
 Limiter::Limiter(const Clock& clock, int max_tokens, double refresh_rate,
                  int tokens_per_refresh)
     : clock_(clock),
-      num_tokens_(max_tokens),
-      max_tokens_(max_tokens),
+      origin_(clock_().tick),
+      max_tokens_(std::max(max_tokens, 0)),
       tokens_per_refresh_(tokens_per_refresh),
-      previous_rates_(9, 1.0) {
+      token_bits_(bit_width(std::uint64_t(max_tokens_))),
+      own_bucket_(std::uint64_t(max_tokens_)),
+      bucket_(&own_bucket_),
+      periods_{},
+      previous_rates_sum_(0) {
   // calculate refresh interval: (1/rate) * tokens per refresh as nanoseconds
   refresh_interval_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
                           std::chrono::duration_cast<std::chrono::nanoseconds>(
                               std::chrono::seconds(1)) /
                           refresh_rate) *
                       tokens_per_refresh_;
-
-  auto now = clock_().tick;
-  next_refresh_ = now + refresh_interval_;
-  current_period_ = std::chrono::time_point_cast<std::chrono::seconds>(now);
-  previous_rates_sum_ =
-      std::accumulate(previous_rates_.begin(), previous_rates_.end(), 0.0);
+  refresh_interval_ =
+      std::max(refresh_interval_, std::chrono::steady_clock::duration(1));
 }
 
 Limiter::Limiter(const Clock& clock, double allowed_per_second)
     : Limiter(clock, int(std::ceil(allowed_per_second)), allowed_per_second,
               1) {}
 
+Limiter::Limiter(const Clock& clock, double allowed_per_second,
+                 SharedLimiterBucket& shared)
+    : Limiter(clock, allowed_per_second) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &allowed_per_second, sizeof bits);
+  if (bits == 0) {
+    return;
+  }
+
+  std::uint64_t expected = 0;
+  std::int64_t origin;
+  if (shared.limit_bits.compare_exchange_strong(expected, bits,
+                                                std::memory_order_acq_rel)) {
+    // This is the first limiter to use the bucket.  Zero means that the
+    // origin is not yet stored.
+    origin = std::max<std::int64_t>(origin_.time_since_epoch().count(), 1);
+    shared.bucket.store(std::uint64_t(max_tokens_), std::memory_order_relaxed);
+    shared.origin.store(origin, std::memory_order_release);
+  } else if (expected != bits) {
+    // The bucket allows a different number per second.
+    return;
+  } else {
+    while ((origin = shared.origin.load(std::memory_order_acquire)) == 0) {
+      std::this_thread::yield();
+    }
+  }
+  origin_ = std::chrono::steady_clock::time_point(
+      std::chrono::steady_clock::duration(origin));
+  bucket_ = &shared.bucket;
+}
+
 Limiter::Result Limiter::allow() { return allow(1); }
 
 Limiter::Result Limiter::allow(int tokens_requested) {
-  auto now = clock_().tick;
-
-  // update effective rate calculations
-  auto intervals = std::chrono::duration_cast<std::chrono::seconds>(
-                       std::chrono::time_point_cast<std::chrono::seconds>(now) -
-                       current_period_)
-                       .count();
-  if (intervals > 0) {
-    if (std::size_t(intervals) >= previous_rates_.size()) {
-      std::fill(previous_rates_.begin() + 1, previous_rates_.end(), 1.0);
-    } else {
-      std::move_backward(previous_rates_.begin(),
-                         previous_rates_.end() - intervals,
-                         previous_rates_.end());
-      if (num_requested_ > 0) {
-        previous_rates_[intervals - 1] =
-            double(num_allowed_) / double(num_requested_);
-      } else {
-        previous_rates_[intervals - 1] = 1.0;
-      }
-      if (intervals - 2 > 0) {
-        std::fill(previous_rates_.begin(),
-                  previous_rates_.begin() + intervals - 2, 1.0);
-      }
+  const auto now = clock_().tick;
+  const auto elapsed = std::max(now - origin_,
+                                std::chrono::steady_clock::duration::zero());
+
+  const bool allowed =
+      take(elapsed, std::uint64_t(std::max(tokens_requested, 0)));
+
+  const auto second = std::uint64_t(
+      std::chrono::duration_cast<std::chrono::seconds>(elapsed).count());
+  const double current_rate = record(second, allowed);
+
+  // `effective_rate` is guaranteed to be between 0.0 and 1.0.
+  const double effective_rate =
+      std::min(1.0, (previous_rates_sum(second) + current_rate) / num_periods);
+
+  return {allowed, *Rate::from(effective_rate)};
+}
+
+bool Limiter::take(std::chrono::steady_clock::duration elapsed,
+                   std::uint64_t tokens) {
+  const std::uint64_t token_mask = (std::uint64_t(1) << token_bits_) - 1;
+  const std::uint64_t refresh_mask = ~std::uint64_t(0) >> token_bits_;
+  const std::uint64_t due = std::uint64_t(elapsed / refresh_interval_);
+  // After this many refreshes, the bucket is full regardless of its tokens.
+  const std::uint64_t refreshes_to_fill =
+      tokens_per_refresh_ > 0
+          ? (std::uint64_t(max_tokens_) + tokens_per_refresh_ - 1) /
+                std::uint64_t(tokens_per_refresh_)
+          : refresh_mask;
+
+  std::uint64_t state = bucket_->load(std::memory_order_relaxed);
+  for (;;) {
+    std::uint64_t refreshed = state >> token_bits_;
+    std::uint64_t available = state & token_mask;
+    // The number of refreshes due that are not yet applied.  If another thread
+    // applied refreshes up to a later time than `elapsed`, then this "wraps
+    // around" to more than half of `refresh_mask`, and nothing is applied.
+    const std::uint64_t pending = (due - refreshed) & refresh_mask;
+    if (pending != 0 && pending <= refresh_mask / 2) {
+      refreshed = due & refresh_mask;
+      available =
+          pending >= refreshes_to_fill
+              ? std::uint64_t(max_tokens_)
+              : std::min(std::uint64_t(max_tokens_),
+                         available + pending * std::uint64_t(
+                                                   tokens_per_refresh_));
+    }
+
+    const bool allowed = available >= tokens;
+    if (allowed) {
+      available -= tokens;
+    }
+
+    const std::uint64_t next = (refreshed << token_bits_) | available;
+    if (next == state ||
+        bucket_->compare_exchange_weak(state, next,
+                                      std::memory_order_relaxed)) {
+      return allowed;
     }
-    previous_rates_sum_ =
-        std::accumulate(previous_rates_.begin(), previous_rates_.end(), 0.0);
-    num_allowed_ = 0;
-    num_requested_ = 0;
-    current_period_ = now;
   }
+}
+
+double Limiter::record(std::uint64_t second, bool allowed) {
+  const std::uint64_t tag = period_tag(second);
+  auto& period = periods_[second % num_periods];
+
+  std::uint64_t state = period.load(std::memory_order_relaxed);
+  for (;;) {
+    std::uint64_t num_allowed = 0;
+    std::uint64_t num_requested = 0;
+    if ((state >> (2 * count_bits)) == tag) {
+      num_allowed = (state >> count_bits) & count_mask;
+      num_requested = state & count_mask;
+    }
+    if (num_requested < count_mask) {
+      ++num_requested;
+      num_allowed += allowed;
+    }
 
-  num_requested_++;
-  // refill "tokens"
-  if (now >= next_refresh_) {
-    intervals = (now - next_refresh_).count() / refresh_interval_.count() + 1;
-    if (intervals > 0) {
-      next_refresh_ += refresh_interval_ * intervals;
-      num_tokens_ += static_cast<int>(intervals * tokens_per_refresh_);
-      if (num_tokens_ > max_tokens_) {
-        num_tokens_ = max_tokens_;
-      }
+    const std::uint64_t next = (tag << (2 * count_bits)) |
+                               (num_allowed << count_bits) | num_requested;
+    if (next == state ||
+        period.compare_exchange_weak(state, next,
+                                     std::memory_order_relaxed)) {
+      return double(num_allowed) / double(num_requested);
     }
   }
-  // determine if allowed or not
-  bool allowed = false;
-  if (num_tokens_ >= tokens_requested) {
-    allowed = true;
-    num_allowed_++;
-    num_tokens_ -= tokens_requested;
+}
+
+double Limiter::previous_rates_sum(std::uint64_t second) {
+  // The sum is cached as a `float` in the low half, tagged with the second
+  // plus one in the high half.
+  const std::uint64_t tag = (second + 1) & 0xFFFFFFFF;
+  const std::uint64_t cached =
+      previous_rates_sum_.load(std::memory_order_relaxed);
+  if ((cached >> 32) == tag) {
+    const auto bits = std::uint32_t(cached);
+    float sum;
+    std::memcpy(&sum, &bits, sizeof sum);
+    return sum;
   }
 
-  // `effective_rate` is guaranteed to be between 0.0 and 1.0.
-  double effective_rate =
-      (previous_rates_sum_ + double(num_allowed_) / double(num_requested_)) /
-      (previous_rates_.size() + 1);
+  double sum = 0.0;
+  for (std::uint64_t back = 1; back < num_periods; ++back) {
+    if (back > second) {
+      // Before the limiter was created.
+      sum += 1.0;
+      continue;
+    }
+    const std::uint64_t previous = second - back;
+    const std::uint64_t state =
+        periods_[previous % num_periods].load(std::memory_order_relaxed);
+    const std::uint64_t num_requested = state & count_mask;
+    if ((state >> (2 * count_bits)) != period_tag(previous) ||
+        num_requested == 0) {
+      sum += 1.0;
+    } else {
+      sum += double((state >> count_bits) & count_mask) /
+             double(num_requested);
+    }
+  }
 
-  return {allowed, *Rate::from(effective_rate)};
+  // Concurrent callers might each compute and store the sum.  They store the
+  // same value, give or take requests counted while they computed it.
+  const float rounded = float(sum);
+  std::uint32_t bits;
+  std::memcpy(&bits, &rounded, sizeof bits);
+  previous_rates_sum_.store((tag << 32) | bits, std::memory_order_relaxed);
+  return rounded;
 }
 
 }  // namespace tracing
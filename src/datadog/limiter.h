@@ -6,16 +6,44 @@
 // `Limiter` is used by the `TraceSampler` and the `SpanSampler` to enforce
 // their respective `max_per_second` configuration parameters.
 //
+// `Limiter` is safe to use from multiple threads without synchronization.  It
+// does not lock: the token bucket is a single atomic word that `allow` updates
+// with compare-and-swap, and the effective rate is computed from atomic
+// per-second counters.
+//
+// Limiters can also share one token bucket, a `SharedLimiterBucket`, which
+// might be in memory shared among processes (see `shared_sampler_state.h`),
+// so that together they allow `allowed_per_second`, rather than each of
+// them.  Each limiter still computes its own effective rate.
+//
 // [1]: https://en.wikipedia.org/wiki/Token_bucket
 
 #include <datadog/clock.h>
 #include <datadog/rate.h>
 
-#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 namespace datadog {
 namespace tracing {
 
+// The state of a token bucket shared by limiters.  It is usable when
+// zero-initialized, and is initialized by the first limiter that uses it.
+struct SharedLimiterBucket {
+  // The bits of the `double` allowed per second by the first limiter that
+  // used the bucket, or zero if none has.  Limiters that allow a different
+  // number do not use the bucket.
+  std::atomic<std::uint64_t> limit_bits;
+  // When the first limiter that used the bucket was created, as a count of
+  // `std::chrono::steady_clock` ticks, or zero until it is stored.
+  std::atomic<std::int64_t> origin;
+  // The tokens and the refreshes applied, encoded as in `Limiter`.
+  std::atomic<std::uint64_t> bucket;
+};
+
 class Limiter {
  public:
   struct Result {
@@ -26,23 +54,55 @@ class Limiter {
   Limiter(const Clock& clock, int max_tokens, double refresh_rate,
           int tokens_per_refresh);
   Limiter(const Clock& clock, double allowed_per_second);
+  // Create a limiter that allows the specified `allowed_per_second` using the
+  // specified `shared` bucket, unless the limiters that already use `shared`
+  // allow a different number, in which case this limiter uses its own
+  // bucket.  `shared` must outlive the limiter.
+  Limiter(const Clock& clock, double allowed_per_second,
+          SharedLimiterBucket& shared);
+
+  Limiter(const Limiter&) = delete;
+  Limiter& operator=(const Limiter&) = delete;
 
   Result allow();
   Result allow(int tokens);
 
  private:
+  // The effective rate is averaged over the current second and the seconds
+  // preceding it, for this many seconds in total.
+  static constexpr std::size_t num_periods = 10;
+
   Clock clock_;
-  int num_tokens_;
+  // When the limiter was created.  Refreshes and seconds are counted from
+  // here.
+  std::chrono::steady_clock::time_point origin_;
   int max_tokens_;
   std::chrono::steady_clock::duration refresh_interval_;
   int tokens_per_refresh_;
-  std::chrono::steady_clock::time_point next_refresh_;
-  // effective rate fields
-  std::vector<double> previous_rates_;
-  double previous_rates_sum_;
-  std::chrono::steady_clock::time_point current_period_;
-  int num_allowed_ = 0;
-  int num_requested_ = 0;
+  // The low `token_bits_` bits of `*bucket_` are the number of tokens.  The
+  // high bits are the number of refreshes applied to the bucket, truncated.
+  unsigned token_bits_;
+  std::atomic<std::uint64_t> own_bucket_;
+  // Either `&own_bucket_` or the `bucket` of a `SharedLimiterBucket`.
+  std::atomic<std::uint64_t>* bucket_;
+  // The numbers of allowed and requested tokens in a second, in the slot of
+  // that second modulo `num_periods`, tagged with the second.
+  std::array<std::atomic<std::uint64_t>, num_periods> periods_;
+  // The sum of the effective rates of the `num_periods - 1` seconds before
+  // the current one, tagged with the current second, so that it is computed
+  // once per second rather than once per call.
+  std::atomic<std::uint64_t> previous_rates_sum_;
+
+  // Refresh the bucket to the specified `elapsed` time since `origin_`, and
+  // then take the specified `tokens` from it if there are enough.  Return
+  // whether the tokens were taken.
+  bool take(std::chrono::steady_clock::duration elapsed, std::uint64_t tokens);
+  // Count a request in the specified `second` since `origin_`, and whether it
+  // was `allowed`.  Return the ratio of allowed to requested in `second`.
+  double record(std::uint64_t second, bool allowed);
+  // Return the sum of the effective rates of the seconds before the
+  // specified `second`.  A second without requests has rate one.
+  double previous_rates_sum(std::uint64_t second);
 };
 
 }  // namespace tracing
@@ -0,0 +1,73 @@
+#include "memory_budget.h"
+
+#include <cassert>
+#include <utility>
+
+namespace datadog {
+namespace tracing {
+
+MemoryBudget::Charge::Charge(std::shared_ptr<MemoryBudget> budget,
+                             std::size_t bytes)
+    : budget_(std::move(budget)), bytes_(bytes) {
+  if (budget_) {
+    budget_->charge(bytes_);
+  }
+}
+
+MemoryBudget::Charge::Charge(Charge&& other) noexcept
+    : budget_(std::move(other.budget_)), bytes_(other.bytes_) {
+  other.bytes_ = 0;
+}
+
+MemoryBudget::Charge& MemoryBudget::Charge::operator=(Charge&& other) noexcept {
+  if (this != &other) {
+    if (budget_) {
+      budget_->release(bytes_);
+    }
+    budget_ = std::move(other.budget_);
+    bytes_ = other.bytes_;
+    other.bytes_ = 0;
+  }
+  return *this;
+}
+
+MemoryBudget::Charge::~Charge() {
+  if (budget_) {
+    budget_->release(bytes_);
+  }
+}
+
+MemoryBudget::MemoryBudget(std::size_t limit) : limit_(limit), used_(0) {
+  assert(limit_ > 0);
+}
+
+std::size_t MemoryBudget::limit() const { return limit_; }
+
+std::size_t MemoryBudget::used() const {
+  return used_.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::charge(std::size_t bytes) {
+  used_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::release(std::size_t bytes) {
+  used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryBudget::Pressure MemoryBudget::pressure() const {
+  const std::size_t used = used_.load(std::memory_order_relaxed);
+  if (used >= limit_) {
+    return Pressure::DROP;
+  }
+  if (used >= limit_ - limit_ / 4) {
+    return Pressure::TRUNCATE;
+  }
+  if (used >= limit_ - limit_ / 2) {
+    return Pressure::SHED_SAMPLED_OUT;
+  }
+  return Pressure::NONE;
+}
+
+}  // namespace tracing
+}  // namespace datadog
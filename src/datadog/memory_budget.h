@@ -0,0 +1,78 @@
+#pragma once
+
+// This component provides a `class`, `MemoryBudget`, that accounts for the
+// memory that a `Tracer` holds in trace data, and that says how close that
+// memory is to the limit configured by `TracerConfig::max_memory_bytes`.
+//
+// The memory is accounted for as the estimated encoded size of the data (see
+// `estimated_encoded_size`), at the granularity of the spans that trace
+// segments hold after they finish, of the trace chunks that a `DatadogAgent`
+// buffers, and of the payloads that it has in flight or keeps to send again.
+// `MemoryBudget` only counts.  The tracer degrades as the `pressure`
+// increases: trace segments stop sending chunks that were dropped by
+// sampling, then stop recording new spans, and then stop sending chunks.
+//
+// `MemoryBudget` is safe to use from multiple threads without
+// synchronization.  It does not lock.
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace datadog {
+namespace tracing {
+
+class MemoryBudget {
+  const std::size_t limit_;
+  std::atomic<std::size_t> used_;
+
+ public:
+  // The degradations of the tracer, in the order that they begin as the
+  // memory accounted for approaches the limit.
+  enum class Pressure {
+    // Below half of the limit.
+    NONE,
+    // At least half of the limit: trace chunks dropped by sampling are not
+    // sent.
+    SHED_SAMPLED_OUT,
+    // At least three quarters of the limit: trace segments do not record new
+    // spans.
+    TRUNCATE,
+    // At the limit: no trace chunks are sent.
+    DROP,
+  };
+
+  // `Charge` is an amount of memory accounted for in a `MemoryBudget` until
+  // the `Charge` is destroyed, so that the memory is released with the data
+  // that holds it, however that data is disposed of.
+  class Charge {
+    std::shared_ptr<MemoryBudget> budget_;
+    std::size_t bytes_ = 0;
+
+   public:
+    Charge() = default;
+    // Charge the specified `bytes` to the specified `budget`, unless `budget`
+    // is null.
+    Charge(std::shared_ptr<MemoryBudget> budget, std::size_t bytes);
+    Charge(Charge&&) noexcept;
+    Charge& operator=(Charge&&) noexcept;
+    ~Charge();
+  };
+
+  // Create a budget of the specified `limit` bytes, which must be positive.
+  explicit MemoryBudget(std::size_t limit);
+
+  std::size_t limit() const;
+  // Return the number of bytes currently accounted for.
+  std::size_t used() const;
+
+  void charge(std::size_t bytes);
+  void release(std::size_t bytes);
+
+  // Return the degradation that applies to the memory currently accounted
+  // for.
+  Pressure pressure() const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
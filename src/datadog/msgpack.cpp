@@ -2,24 +2,12 @@
 
 #include <datadog/error.h>
 
-#include <cassert>
-#include <climits>
 #include <limits>
-#include <type_traits>
 
 namespace datadog {
 namespace tracing {
 namespace msgpack {
 namespace {
-// MessagePack values are prefixed by a byte naming their type.
-namespace types {
-constexpr auto ARRAY32 = std::byte(0xDD);
-constexpr auto DOUBLE = std::byte(0xCB);
-constexpr auto INT64 = std::byte(0xD3);
-constexpr auto MAP32 = std::byte(0xDF);
-constexpr auto STR32 = std::byte(0xDB);
-constexpr auto UINT64 = std::byte(0xCF);
-}  // namespace types
 
 std::string make_overflow_message(StringView type, std::size_t actual,
                                   std::size_t max) {
@@ -34,99 +22,124 @@ std::string make_overflow_message(StringView type, std::size_t actual,
   return message;
 }
 
-template <typename Integer>
-void push_number_big_endian(std::string& buffer, Integer integer) {
-  // Assume two's complement.
-  const std::make_unsigned_t<Integer> value = integer;
-
-  // The loop below is more likely to unroll if we don't call any functions
-  // within it.
-  char buf[sizeof value];
-
-  // The most significant byte of `value` goes to the front of `buf`, and the
-  // least significant byte of `value` goes
-  // to the back of `buf`, and so on in between.
-  // On a big endian architecture, this is just a complicated way to copy
-  // `value`. On a little endian architecture, which is much more common, this
-  // effectively copies the bytes of `value` backwards.
-  const int size = sizeof value;
-  for (int i = 0; i < size; ++i) {
-    const char byte = (value >> (CHAR_BIT * ((size - 1) - i))) & 0xFF;
-    buf[i] = byte;
-  }
+// Append to the specified `buffer` what the specified `write` writes using a
+// `Writer`, which is at most the specified `MaxSize` bytes.
+template <std::size_t MaxSize, typename Write>
+void append_with(std::string& buffer, Write&& write) {
+  char bytes[MaxSize];
+  Writer writer{bytes};
+  write(writer);
+  buffer.append(bytes, writer.cursor() - bytes);
+}
 
-  buffer.append(buf, sizeof buf);
+// Return an error if the specified `size` of the specified `type` of value is
+// too large to be encoded.
+Expected<void> check_size(StringView type, std::size_t size) {
+  const auto max = std::numeric_limits<std::uint32_t>::max();
+  if (size > max) {
+    return Error{Error::MESSAGEPACK_ENCODE_FAILURE,
+                 make_overflow_message(type, size, max)};
+  }
+  return {};
 }
 
 }  // namespace
 
 void pack_integer(std::string& buffer, std::int64_t value) {
-  buffer.push_back(static_cast<char>(types::INT64));
-  push_number_big_endian(buffer, static_cast<std::int64_t>(value));
+  append_with<Writer::max_integer_size>(
+      buffer, [&](Writer& writer) { writer.pack_integer(value); });
 }
 
 void pack_integer(std::string& buffer, std::uint64_t value) {
-  buffer.push_back(static_cast<char>(types::UINT64));
-  push_number_big_endian(buffer, static_cast<std::uint64_t>(value));
+  append_with<Writer::max_integer_size>(
+      buffer, [&](Writer& writer) { writer.pack_integer(value); });
+}
+
+void pack_integer(std::string& buffer, std::int32_t value) {
+  pack_integer(buffer, std::int64_t(value));
+}
+
+void pack_integer(std::string& buffer, std::uint32_t value) {
+  pack_integer(buffer, std::uint64_t(value));
 }
 
 void pack_double(std::string& buffer, double value) {
-  buffer.push_back(static_cast<char>(types::DOUBLE));
-
-  // The following is lifted from the "msgpack-c" project.
-  // See "pack_double" in
-  // <https://github.com/msgpack/msgpack-c/blob/cpp_master/include/msgpack/v1/pack.hpp>
-
-  union {
-    double as_double;
-    uint64_t as_integer;
-  } memory;
-  memory.as_double = value;
-
-#if defined(TARGET_OS_IPHONE)
-  // ok
-#elif defined(__arm__) && !(__ARM_EABI__)  // arm-oabi
-  // https://github.com/msgpack/msgpack-perl/pull/1
-  memory.as_integer =
-      (memory.as_integer & 0xFFFFFFFFUL) << 32UL | (memory.as_integer >> 32UL);
-#endif
-
-  push_number_big_endian(buffer, memory.as_integer);
+  append_with<Writer::max_double_size>(
+      buffer, [&](Writer& writer) { writer.pack_double(value); });
+}
+
+void pack_number(std::string& buffer, double value) {
+  static_assert(Writer::max_integer_size <= Writer::max_double_size,
+                "a number fits in max_double_size");
+  append_with<Writer::max_double_size>(
+      buffer, [&](Writer& writer) { writer.pack_number(value); });
+}
+
+void pack_bool(std::string& buffer, bool value) {
+  append_with<Writer::max_bool_size>(
+      buffer, [&](Writer& writer) { writer.pack_bool(value); });
 }
 
 Expected<void> pack_string(std::string& buffer, const char* begin,
                            std::size_t size) {
-  const auto max = std::numeric_limits<std::uint32_t>::max();
-  if (size > max) {
-    return Error{Error::MESSAGEPACK_ENCODE_FAILURE,
-                 make_overflow_message("string", size, max)};
+  auto result = check_size("string", size);
+  if (!result) {
+    return result;
   }
-  buffer.push_back(static_cast<char>(types::STR32));
-  push_number_big_endian(buffer, static_cast<std::uint32_t>(size));
-  buffer.append(begin, size);
-  return {};
+  const StringView value{begin, size};
+  const std::size_t valid = valid_utf8_prefix(value);
+  const StringView invalid = value.substr(valid);
+  std::size_t repaired_size = size;
+  if (!invalid.empty()) {
+    // The repaired string is longer, and might then be too long.
+    repaired_size = valid + repaired_utf8_size(invalid);
+    result = check_size("string", repaired_size);
+    if (!result) {
+      return result;
+    }
+  }
+  append_with<Writer::max_header_size>(buffer, [&](Writer& writer) {
+    writer.pack_string_header(repaired_size);
+  });
+  buffer.append(begin, valid);
+  if (!invalid.empty()) {
+    const std::size_t offset = buffer.size();
+    buffer.resize(offset + (repaired_size - valid));
+    repair_utf8(&buffer[offset], invalid);
+  }
+  return result;
+}
+
+Expected<void> pack_binary(std::string& buffer, StringView value) {
+  auto result = check_size("binary", value.size());
+  if (!result) {
+    return result;
+  }
+  append_with<Writer::max_header_size>(buffer, [&](Writer& writer) {
+    writer.pack_binary_header(value.size());
+  });
+  append(buffer, value);
+  return result;
 }
 
 Expected<void> pack_array(std::string& buffer, std::size_t size) {
-  const auto max = std::numeric_limits<std::uint32_t>::max();
-  if (size > max) {
-    return Error{Error::MESSAGEPACK_ENCODE_FAILURE,
-                 make_overflow_message("array", size, max)};
+  auto result = check_size("array", size);
+  if (!result) {
+    return result;
   }
-  buffer.push_back(static_cast<char>(types::ARRAY32));
-  push_number_big_endian(buffer, static_cast<std::uint32_t>(size));
-  return {};
+  append_with<Writer::max_header_size>(
+      buffer, [&](Writer& writer) { writer.pack_array(size); });
+  return result;
 }
 
 Expected<void> pack_map(std::string& buffer, std::size_t size) {
-  const auto max = std::numeric_limits<std::uint32_t>::max();
-  if (size > max) {
-    return Error{Error::MESSAGEPACK_ENCODE_FAILURE,
-                 make_overflow_message("map", size, max)};
+  auto result = check_size("map", size);
+  if (!result) {
+    return result;
   }
-  buffer.push_back(static_cast<char>(types::MAP32));
-  push_number_big_endian(buffer, static_cast<std::uint32_t>(size));
-  return {};
+  append_with<Writer::max_header_size>(
+      buffer, [&](Writer& writer) { writer.pack_map(size); });
+  return result;
 }
 
 }  // namespace msgpack
@@ -9,30 +9,282 @@
 // Only encoding is provided, and only for the types required by `SpanData` and
 // `DatadogAgent`.
 //
+// Each value is encoded in its narrowest MessagePack form, e.g. the integer
+// `1` is one byte (a "positive fixint"), and a string of a dozen characters
+// has a one byte header (a "fixstr").  Spans consist mostly of small integers,
+// short strings, and small maps, so this is much more compact than always
+// using the widest forms.
+//
+// `msgpack::Writer` produces the same encodings as the functions, but writes
+// through a `char*` cursor into memory that the caller has already reserved.
+// An encoder that can bound the size of what it encodes, such as the encoder
+// of `SpanData`, checks the capacity of its destination once rather than for
+// every value.  The `std::string` functions are implemented using `Writer`.
+//
+// The Datadog Agent expects strings to be valid UTF-8.  The `std::string`
+// function `pack_string` replaces the parts of a string that are not (see
+// `utf8.h`).  `Writer::pack_string` does so only if told to by
+// `Writer::set_repair_utf8`, since its caller must first make room for the
+// repaired strings, which can be longer.
+//
 // [1]: https://msgpack.org/index.html
 
 #include <datadog/expected.h>
 #include <datadog/string_view.h>
 
+#include <climits>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <utility>
 
+#include "utf8.h"
+
 namespace datadog {
 namespace tracing {
 namespace msgpack {
 
+// MessagePack values are prefixed by a byte naming their type.
+namespace types {
+constexpr auto ARRAY16 = std::byte(0xDC);
+constexpr auto ARRAY32 = std::byte(0xDD);
+constexpr auto BIN8 = std::byte(0xC4);
+constexpr auto BIN16 = std::byte(0xC5);
+constexpr auto BIN32 = std::byte(0xC6);
+constexpr auto BOOL_FALSE = std::byte(0xC2);
+constexpr auto BOOL_TRUE = std::byte(0xC3);
+constexpr auto DOUBLE = std::byte(0xCB);
+constexpr auto FIXARRAY = std::byte(0x90);
+constexpr auto FIXMAP = std::byte(0x80);
+constexpr auto FIXSTR = std::byte(0xA0);
+constexpr auto INT8 = std::byte(0xD0);
+constexpr auto INT16 = std::byte(0xD1);
+constexpr auto INT32 = std::byte(0xD2);
+constexpr auto INT64 = std::byte(0xD3);
+constexpr auto MAP16 = std::byte(0xDE);
+constexpr auto MAP32 = std::byte(0xDF);
+constexpr auto STR8 = std::byte(0xD9);
+constexpr auto STR16 = std::byte(0xDA);
+constexpr auto STR32 = std::byte(0xDB);
+constexpr auto UINT8 = std::byte(0xCC);
+constexpr auto UINT16 = std::byte(0xCD);
+constexpr auto UINT32 = std::byte(0xCE);
+constexpr auto UINT64 = std::byte(0xCF);
+}  // namespace types
+
+// `Writer` encodes values at a cursor, which it advances past each value.  It
+// does not check for room: the caller must reserve, before each value, at
+// least the value's `max_..._size` in bytes.  The sizes of strings, binary
+// data, arrays, and maps must fit in 32 bits, which the caller must check.
+class Writer {
+  char* cursor_;
+  bool repair_utf8_ = false;
+
+  template <typename Integer>
+  void write_big_endian(Integer integer) {
+    // Assume two's complement.
+    const std::make_unsigned_t<Integer> value = integer;
+    // The most significant byte of `value` is written first.  On a little
+    // endian architecture, which is much more common, this effectively copies
+    // the bytes of `value` backwards.
+    constexpr int size = sizeof value;
+    for (int i = 0; i < size; ++i) {
+      cursor_[i] = char((value >> (CHAR_BIT * ((size - 1) - i))) & 0xFF);
+    }
+    cursor_ += size;
+  }
+
+  void write_type(std::byte type) { *cursor_++ = static_cast<char>(type); }
+
+  // Write the specified `size` prefixed by the specified `type16` if `size`
+  // fits in two bytes, or by the specified `type32` otherwise.
+  void write_size(std::size_t size, std::byte type16, std::byte type32) {
+    if (size <= 0xFFFF) {
+      write_type(type16);
+      write_big_endian(static_cast<std::uint16_t>(size));
+    } else {
+      write_type(type32);
+      write_big_endian(static_cast<std::uint32_t>(size));
+    }
+  }
+
+ public:
+  static constexpr std::size_t max_integer_size = 9;
+  static constexpr std::size_t max_double_size = 9;
+  static constexpr std::size_t max_bool_size = 1;
+  // The largest header of a string, binary data, array, or map.
+  static constexpr std::size_t max_header_size = 5;
+
+  explicit Writer(char* cursor) : cursor_(cursor) {}
+
+  // Return the position after the last value written.
+  char* cursor() const { return cursor_; }
+
+  // Integers are encoded in the fewest bytes that represent them, which is
+  // one byte for most of the integers in a span, such as its error flag.
+  void pack_integer(std::uint64_t value) {
+    if (value < 0x80) {
+      // positive fixint
+      *cursor_++ = static_cast<char>(value);
+    } else if (value <= 0xFF) {
+      write_type(types::UINT8);
+      *cursor_++ = static_cast<char>(value);
+    } else if (value <= 0xFFFF) {
+      write_type(types::UINT16);
+      write_big_endian(static_cast<std::uint16_t>(value));
+    } else if (value <= 0xFFFFFFFF) {
+      write_type(types::UINT32);
+      write_big_endian(static_cast<std::uint32_t>(value));
+    } else {
+      write_type(types::UINT64);
+      write_big_endian(value);
+    }
+  }
+
+  void pack_integer(std::int64_t value) {
+    if (value >= 0) {
+      pack_integer(static_cast<std::uint64_t>(value));
+    } else if (value >= -32) {
+      // negative fixint
+      *cursor_++ = static_cast<char>(value);
+    } else if (value >= INT8_MIN) {
+      write_type(types::INT8);
+      *cursor_++ = static_cast<char>(value);
+    } else if (value >= INT16_MIN) {
+      write_type(types::INT16);
+      write_big_endian(static_cast<std::int16_t>(value));
+    } else if (value >= INT32_MIN) {
+      write_type(types::INT32);
+      write_big_endian(static_cast<std::int32_t>(value));
+    } else {
+      write_type(types::INT64);
+      write_big_endian(value);
+    }
+  }
+
+  void pack_integer(std::uint32_t value) { pack_integer(std::uint64_t(value)); }
+  void pack_integer(std::int32_t value) { pack_integer(std::int64_t(value)); }
+
+  void pack_double(double value) {
+    write_type(types::DOUBLE);
+
+    // The following is lifted from the "msgpack-c" project.
+    // See "pack_double" in
+    // <https://github.com/msgpack/msgpack-c/blob/cpp_master/include/msgpack/v1/pack.hpp>
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+#if defined(TARGET_OS_IPHONE)
+    // ok
+#elif defined(__arm__) && !(__ARM_EABI__)  // arm-oabi
+    // https://github.com/msgpack/msgpack-perl/pull/1
+    bits = (bits & 0xFFFFFFFFUL) << 32UL | (bits >> 32UL);
+#endif
+    write_big_endian(bits);
+  }
+
+  // Encode the specified `value` as an integer if it is an integer that
+  // `std::int64_t` can represent, and as a double otherwise.  Most metrics of
+  // a span, such as its sampling priority, are small integers, which are then
+  // encoded in one byte rather than nine.  The Datadog Agent accepts either
+  // encoding wherever it expects a double.
+  void pack_number(double value) {
+    // The bounds are -2^63 and 2^63, and both are exactly representable.
+    if (value >= -9223372036854775808.0 && value < 9223372036854775808.0 &&
+        value == std::trunc(value)) {
+      pack_integer(static_cast<std::int64_t>(value));
+    } else {
+      pack_double(value);
+    }
+  }
+
+  void pack_bool(bool value) {
+    write_type(value ? types::BOOL_TRUE : types::BOOL_FALSE);
+  }
+
+  void pack_string_header(std::size_t size) {
+    if (size < 32) {
+      write_type(types::FIXSTR | std::byte(size));
+    } else if (size <= 0xFF) {
+      write_type(types::STR8);
+      *cursor_++ = static_cast<char>(size);
+    } else {
+      write_size(size, types::STR16, types::STR32);
+    }
+  }
+
+  // Set whether `pack_string` replaces the parts of strings that are not
+  // valid UTF-8.  If so, then the room reserved for each string must be at
+  // least its `repaired_utf8_size`.  By default, strings are copied as is.
+  void set_repair_utf8(bool repair) { repair_utf8_ = repair; }
+
+  void pack_string(StringView value) {
+    if (repair_utf8_) {
+      pack_string_header(repaired_utf8_size(value));
+      cursor_ = repair_utf8(cursor_, value);
+      return;
+    }
+    pack_string_header(value.size());
+    append(value.data(), value.size());
+  }
+
+  void pack_binary_header(std::size_t size) {
+    if (size <= 0xFF) {
+      write_type(types::BIN8);
+      *cursor_++ = static_cast<char>(size);
+    } else {
+      write_size(size, types::BIN16, types::BIN32);
+    }
+  }
+
+  void pack_array(std::size_t size) {
+    if (size < 16) {
+      write_type(types::FIXARRAY | std::byte(size));
+    } else {
+      write_size(size, types::ARRAY16, types::ARRAY32);
+    }
+  }
+
+  void pack_map(std::size_t size) {
+    if (size < 16) {
+      write_type(types::FIXMAP | std::byte(size));
+    } else {
+      write_size(size, types::MAP16, types::MAP32);
+    }
+  }
+
+  // Copy the specified `size` bytes at the specified `data`, which are already
+  // encoded.
+  void append(const char* data, std::size_t size) {
+    if (size) {
+      std::memcpy(cursor_, data, size);
+      cursor_ += size;
+    }
+  }
+};
+
 void pack_integer(std::string& buffer, std::int64_t value);
 void pack_integer(std::string& buffer, std::uint64_t value);
 void pack_integer(std::string& buffer, std::int32_t value);
+void pack_integer(std::string& buffer, std::uint32_t value);
 
 void pack_double(std::string& buffer, double value);
+void pack_number(std::string& buffer, double value);
+
+void pack_bool(std::string& buffer, bool value);
 
+// Append the specified string `value` to the specified `buffer`, with each
+// part of `value` that is not valid UTF-8 replaced by U+FFFD.
 Expected<void> pack_string(std::string& buffer, StringView value);
 Expected<void> pack_string(std::string& buffer, const char* begin,
                            std::size_t size);
 
+// Append the specified `value` as MessagePack binary data, rather than as a
+// string, which must be valid UTF-8.
+Expected<void> pack_binary(std::string& buffer, StringView value);
+
 Expected<void> pack_array(std::string& buffer, std::size_t size);
 
 // Append to the specified `buffer` a MessagePack encoded array having the
@@ -154,10 +406,6 @@ inline Expected<void> pack_map_suffix(std::string&) {
   return {};
 }
 
-inline void pack_integer(std::string& buffer, std::int32_t value) {
-  pack_integer(buffer, std::int64_t(value));
-}
-
 inline Expected<void> pack_string(std::string& buffer, StringView value) {
   return pack_string(buffer, value.data(), value.size());
 }
@@ -0,0 +1,384 @@
+#include "obfuscation.h"
+
+#include <datadog/string_view.h>
+
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "interned_string.h"
+#include "span_data.h"
+#include "tags.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Beyond this many distinct statements, resources are obfuscated but not
+// cached, so that an application that does not use bind parameters does not
+// grow the cache without bound.
+constexpr std::size_t max_cached_statements = 4096;
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_alpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_identifier_start(char c) {
+  // Bytes of multibyte UTF-8 sequences are taken as letters.
+  return is_alpha(c) || c == '_' || c == '@' || c == '#' ||
+         static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool is_identifier_part(char c) {
+  return is_identifier_start(c) || is_digit(c) || c == '$';
+}
+
+// Return whether the specified `word` is the specified lower-case `keyword`,
+// ignoring case.
+bool is_keyword(StringView word, StringView keyword) {
+  if (word.size() != keyword.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < word.size(); ++i) {
+    const char c = word[i];
+    if ((c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c) != keyword[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Return the index just past the end of the string literal that begins at
+// the specified `begin` index of the specified `data` of the specified
+// `size`.  Quotes within the literal are escaped by doubling them or by a
+// backslash.
+std::size_t skip_string(const char* data, std::size_t size,
+                        std::size_t begin) {
+  std::size_t i = begin + 1;
+  while (i < size) {
+    if (data[i] == '\\' && i + 1 < size) {
+      i += 2;
+    } else if (data[i] == '\'') {
+      if (i + 1 < size && data[i + 1] == '\'') {
+        i += 2;
+      } else {
+        return i + 1;
+      }
+    } else {
+      ++i;
+    }
+  }
+  return size;
+}
+
+// Return the index just past the end of the number that begins at the
+// specified `begin` index of the specified `data` of the specified `size`.
+std::size_t skip_number(const char* data, std::size_t size,
+                        std::size_t begin) {
+  const bool hex = data[begin] == '0' && begin + 1 < size &&
+                   (data[begin + 1] == 'x' || data[begin + 1] == 'X');
+  std::size_t i = begin;
+  char previous = '\0';
+  while (i < size) {
+    const char c = data[i];
+    const bool exponent_sign =
+        !hex && (c == '+' || c == '-') && (previous == 'e' || previous == 'E');
+    if (!is_alpha(c) && !is_digit(c) && c != '.' && !exponent_sign) {
+      break;
+    }
+    previous = c;
+    ++i;
+  }
+  return i;
+}
+
+// `SqlWriter` writes the tokens of an obfuscated statement over the statement
+// itself.  Every token written replaces at least as many characters read, so
+// the writer never overtakes the reader.
+class SqlWriter {
+  char* const data_;
+  std::size_t size_ = 0;
+  // Whether whitespace or a comment precedes the next token.
+  bool separated_ = false;
+
+  void separate() {
+    if (separated_ && size_ != 0) {
+      data_[size_++] = ' ';
+    }
+    separated_ = false;
+  }
+
+ public:
+  explicit SqlWriter(char* data) : data_(data) {}
+
+  std::size_t size() const { return size_; }
+
+  void skip() { separated_ = true; }
+
+  // Write the characters in [`begin`, `end`) of the statement.
+  void copy(std::size_t begin, std::size_t end) {
+    separate();
+    std::memmove(data_ + size_, data_ + begin, end - begin);
+    size_ += end - begin;
+  }
+
+  void literal() {
+    // A list of literals becomes one.
+    if (size_ >= 2 && data_[size_ - 1] == ',' && data_[size_ - 2] == '?') {
+      --size_;
+      separated_ = false;
+      return;
+    }
+    if (size_ >= 3 && data_[size_ - 1] == ',' && data_[size_ - 2] == ' ' &&
+        data_[size_ - 3] == '?') {
+      size_ -= 2;
+      separated_ = false;
+      return;
+    }
+    separate();
+    data_[size_++] = '?';
+  }
+};
+
+// Write the obfuscation of the specified Redis `command`, which is one line,
+// at the specified `destination`, which is not after `command`.  Return the
+// number of characters written.
+std::size_t obfuscate_redis_command(char* destination, const char* command,
+                                    std::size_t size) {
+  // Find up to the first two tokens, and whether any follow.
+  StringView tokens[2];
+  std::size_t count = 0;
+  bool more = false;
+  std::size_t i = 0;
+  while (i < size) {
+    while (i < size && is_space(command[i])) {
+      ++i;
+    }
+    if (i == size) {
+      break;
+    }
+    if (count == 2) {
+      more = true;
+      break;
+    }
+    const std::size_t begin = i;
+    while (i < size && !is_space(command[i])) {
+      ++i;
+    }
+    tokens[count++] = StringView(command + begin, i - begin);
+  }
+  if (count == 0) {
+    return 0;
+  }
+  // Decide before writing, since writing can overwrite the tokens.
+  const bool auth = is_keyword(tokens[0], "auth");
+
+  std::size_t written = 0;
+  const auto write = [&](StringView text) {
+    std::memmove(destination + written, text.data(), text.size());
+    written += text.size();
+  };
+  write(tokens[0]);
+  if (count == 2) {
+    write(" ");
+    if (auth) {
+      write("?");
+      return written;
+    }
+    write(tokens[1]);
+  }
+  if (more) {
+    write(" ?");
+  }
+  return written;
+}
+
+struct SqlCache {
+  std::shared_mutex mutex;
+  // Keys are the interned values of resources, which are never freed.
+  std::unordered_map<const std::string*, InternedString> obfuscated;
+};
+
+SqlCache& sql_cache() {
+  // The cache is never destroyed, so that spans can be sent during static
+  // destruction.
+  static SqlCache* const cache = new SqlCache;
+  return *cache;
+}
+
+InternedString obfuscate(const std::string& statement) {
+  thread_local std::string buffer;
+  buffer.assign(statement);
+  buffer.resize(obfuscate_sql(buffer.data(), buffer.size()));
+  return InternedString(buffer);
+}
+
+InternedString obfuscated_resource(const InternedString& resource) {
+  if (!resource.interned()) {
+    return obfuscate(resource);
+  }
+  const std::string* const key = &resource.str();
+  auto& cache = sql_cache();
+  {
+    std::shared_lock<std::shared_mutex> lock(cache.mutex);
+    const auto found = cache.obfuscated.find(key);
+    if (found != cache.obfuscated.end()) {
+      return found->second;
+    }
+  }
+  InternedString result = obfuscate(resource);
+  std::lock_guard<std::shared_mutex> lock(cache.mutex);
+  if (cache.obfuscated.size() < max_cached_statements) {
+    cache.obfuscated.emplace(key, result);
+  }
+  return result;
+}
+
+void obfuscate_tag(SpanTags& tags, StringView name,
+                   std::size_t (*obfuscate)(char*, std::size_t)) {
+  const auto found = tags.find(name);
+  if (found != tags.end()) {
+    std::string& value = found->second;
+    value.resize(obfuscate(value.data(), value.size()));
+  }
+}
+
+}  // namespace
+
+std::size_t obfuscate_sql(char* data, std::size_t size) {
+  SqlWriter writer{data};
+  std::size_t i = 0;
+  while (i < size) {
+    const char c = data[i];
+    const char next = i + 1 < size ? data[i + 1] : '\0';
+    if (is_space(c)) {
+      writer.skip();
+      ++i;
+    } else if (c == '-' && next == '-') {
+      while (i < size && data[i] != '\n') {
+        ++i;
+      }
+      writer.skip();
+    } else if (c == '/' && next == '*') {
+      i += 2;
+      while (i < size && !(data[i] == '*' && i + 1 < size &&
+                           data[i + 1] == '/')) {
+        ++i;
+      }
+      i = i < size ? i + 2 : size;
+      writer.skip();
+    } else if (c == '\'') {
+      i = skip_string(data, size, i);
+      writer.literal();
+    } else if (c == '"' || c == '`' || c == '[') {
+      // A quoted identifier is kept.
+      const char close = c == '[' ? ']' : c;
+      std::size_t end = i + 1;
+      while (end < size && data[end] != close) {
+        ++end;
+      }
+      end = end < size ? end + 1 : size;
+      writer.copy(i, end);
+      i = end;
+    } else if (is_digit(c) || (c == '.' && is_digit(next))) {
+      i = skip_number(data, size, i);
+      writer.literal();
+    } else if (c == '$' && is_digit(next)) {
+      // A bind parameter is kept.
+      std::size_t end = i + 1;
+      while (end < size && is_digit(data[end])) {
+        ++end;
+      }
+      writer.copy(i, end);
+      i = end;
+    } else if (is_identifier_start(c)) {
+      std::size_t end = i + 1;
+      while (end < size && is_identifier_part(data[end])) {
+        ++end;
+      }
+      const StringView word{data + i, end - i};
+      if (is_keyword(word, "true") || is_keyword(word, "false")) {
+        writer.literal();
+      } else {
+        writer.copy(i, end);
+      }
+      i = end;
+    } else {
+      writer.copy(i, i + 1);
+      ++i;
+    }
+  }
+  return writer.size();
+}
+
+std::size_t obfuscate_redis(char* data, std::size_t size) {
+  std::size_t written = 0;
+  std::size_t begin = 0;
+  while (begin < size) {
+    const char* const newline =
+        static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+    const std::size_t end = newline ? newline - data : size;
+    const std::size_t line_written =
+        obfuscate_redis_command(data + written + (written != 0),
+                                data + begin, end - begin);
+    if (line_written != 0) {
+      if (written != 0) {
+        data[written++] = '\n';
+      }
+      written += line_written;
+    }
+    begin = end + 1;
+  }
+  return written;
+}
+
+std::size_t obfuscate_url(char* data, std::size_t size) {
+  const StringView url{data, size};
+  const auto scheme_end = url.find("://");
+  if (scheme_end == StringView::npos) {
+    return size;
+  }
+  const std::size_t authority = scheme_end + 3;
+  const auto authority_end = url.find_first_of("/?#", authority);
+  const auto at = url.substr(authority, authority_end == StringView::npos
+                                            ? StringView::npos
+                                            : authority_end - authority)
+                      .rfind('@');
+  if (at == StringView::npos) {
+    return size;
+  }
+  const std::size_t removed = at + 1;
+  std::memmove(data + authority, data + authority + removed,
+               size - authority - removed);
+  return size - removed;
+}
+
+void obfuscate_spans(std::vector<std::unique_ptr<SpanData>>& spans) {
+  for (const auto& span : spans) {
+    const std::string& type = span->service_type;
+    if (type == "sql" || type == "cassandra") {
+      span->resource = obfuscated_resource(span->resource);
+    } else if (type == "redis") {
+      obfuscate_tag(span->tags, "redis.raw_command", &obfuscate_redis);
+    }
+    obfuscate_tag(span->tags, tags::http_url, &obfuscate_url);
+  }
+}
+
+std::size_t obfuscation_cache_size() {
+  auto& cache = sql_cache();
+  std::shared_lock<std::shared_mutex> lock(cache.mutex);
+  return cache.obfuscated.size();
+}
+
+}  // namespace tracing
+}  // namespace datadog
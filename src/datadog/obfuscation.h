@@ -0,0 +1,57 @@
+#pragma once
+
+// This component provides functions that obfuscate the parts of spans that the
+// Datadog Agent would otherwise obfuscate: the literals of SQL statements in
+// the resources of database spans, the arguments of Redis commands in the
+// "redis.raw_command" tag, and the credentials in the "http.url" tag.  A
+// tracer configured with `TracerConfig::obfuscation_enabled` obfuscates its
+// spans before sending them, and tells the Datadog Agent that it did, so that
+// the Agent does not spend its own CPU time doing it again.
+//
+// Each obfuscation is done in one pass over its input, in place.  The output
+// is never longer than the input, so obfuscating does not allocate.  The
+// resources of spans are interned (see `interned_string.h`), so the
+// obfuscation of each distinct statement is cached.
+//
+// The obfuscations are simpler than the Datadog Agent's:
+//
+// - In SQL, each number, quoted string, and `TRUE` or `FALSE` becomes `?`, a
+//   list of literals such as `(1, 2, 3)` becomes `(?)`, comments are removed,
+//   and runs of whitespace become one space.  Identifiers, including quoted
+//   ones, and bind parameters such as `$1` are kept.
+// - In Redis commands, the command and its first argument (usually the key)
+//   are kept, and the remaining arguments become `?`.  All arguments of `AUTH`
+//   become `?`.
+// - In URLs, the user information (e.g. "user:password@") is removed.
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+struct SpanData;
+
+// Obfuscate the SQL statement of the specified `size` at the specified `data`
+// in place.  Return the size of the result.
+std::size_t obfuscate_sql(char* data, std::size_t size);
+
+// Obfuscate the Redis commands, one per line, of the specified `size` at the
+// specified `data` in place.  Return the size of the result.
+std::size_t obfuscate_redis(char* data, std::size_t size);
+
+// Remove the user information from the URL of the specified `size` at the
+// specified `data` in place.  Return the size of the result.
+std::size_t obfuscate_url(char* data, std::size_t size);
+
+// Obfuscate the resource of each of the specified `spans` whose type is "sql"
+// or "cassandra", the "redis.raw_command" tag of each whose type is "redis",
+// and the "http.url" tag of each.
+void obfuscate_spans(std::vector<std::unique_ptr<SpanData>>& spans);
+
+// Return the number of distinct SQL resources whose obfuscation is cached.
+std::size_t obfuscation_cache_size();
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,533 @@
+#include "otlp_exporter.h"
+
+#include <datadog/dict_reader.h>
+#include <datadog/dict_writer.h>
+#include <datadog/logger.h>
+#include <datadog/telemetry/telemetry.h>
+#include <datadog/tracer_signature.h>
+
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <utility>
+
+#include "collector_shutdown.h"
+#include "json.hpp"
+#include "overhead_governor.h"
+#include "protobuf.h"
+#include "shared_tags.h"
+#include "span_data.h"
+#include "tags.h"
+#include "telemetry_metrics.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The field numbers of the OTLP messages used below.  See
+// <https://github.com/open-telemetry/opentelemetry-proto>.
+namespace export_request {
+constexpr std::uint32_t resource_spans = 1;
+}  // namespace export_request
+namespace resource_spans {
+constexpr std::uint32_t resource = 1;
+constexpr std::uint32_t scope_spans = 2;
+}  // namespace resource_spans
+namespace resource {
+constexpr std::uint32_t attributes = 1;
+}  // namespace resource
+namespace scope_spans {
+constexpr std::uint32_t scope = 1;
+constexpr std::uint32_t spans = 2;
+}  // namespace scope_spans
+namespace scope {
+constexpr std::uint32_t name = 1;
+constexpr std::uint32_t version = 2;
+}  // namespace scope
+namespace span {
+constexpr std::uint32_t trace_id = 1;
+constexpr std::uint32_t span_id = 2;
+constexpr std::uint32_t parent_span_id = 4;
+constexpr std::uint32_t name = 5;
+constexpr std::uint32_t kind = 6;
+constexpr std::uint32_t start_time_unix_nano = 7;
+constexpr std::uint32_t end_time_unix_nano = 8;
+constexpr std::uint32_t attributes = 9;
+constexpr std::uint32_t events = 11;
+constexpr std::uint32_t links = 13;
+constexpr std::uint32_t status = 15;
+}  // namespace span
+namespace event {
+constexpr std::uint32_t time_unix_nano = 1;
+constexpr std::uint32_t name = 2;
+constexpr std::uint32_t attributes = 3;
+}  // namespace event
+namespace link {
+constexpr std::uint32_t trace_id = 1;
+constexpr std::uint32_t span_id = 2;
+constexpr std::uint32_t trace_state = 3;
+constexpr std::uint32_t attributes = 4;
+constexpr std::uint32_t flags = 6;
+}  // namespace link
+namespace status {
+constexpr std::uint32_t message = 2;
+constexpr std::uint32_t code = 3;
+constexpr std::uint64_t code_error = 2;
+}  // namespace status
+namespace key_value {
+constexpr std::uint32_t key = 1;
+constexpr std::uint32_t value = 2;
+}  // namespace key_value
+namespace any_value {
+constexpr std::uint32_t string_value = 1;
+constexpr std::uint32_t double_value = 4;
+}  // namespace any_value
+
+std::string to_url_string(const HTTPClient::URL& url) {
+  return url.scheme + "://" + url.authority + url.path;
+}
+
+// Append a `KeyValue` having the specified `key` and string `value`, as the
+// specified `field`.  The sizes of a `KeyValue` and of its `AnyValue` follow
+// from the sizes of its strings, so that this needs no `begin_message`.
+void pack_attribute(std::string& destination, std::uint32_t field,
+                    StringView key, StringView value) {
+  const std::size_t value_size =
+      protobuf::length_delimited_size(any_value::string_value, value.size());
+  protobuf::pack_message_header(
+      destination, field,
+      protobuf::length_delimited_size(key_value::key, key.size()) +
+          protobuf::length_delimited_size(key_value::value, value_size));
+  protobuf::pack_string(destination, key_value::key, key);
+  protobuf::pack_message_header(destination, key_value::value, value_size);
+  protobuf::pack_string(destination, any_value::string_value, value);
+}
+
+void pack_attribute(std::string& destination, std::uint32_t field,
+                    StringView key, double value) {
+  // One byte of key and eight of value.
+  const std::size_t value_size = 9;
+  protobuf::pack_message_header(
+      destination, field,
+      protobuf::length_delimited_size(key_value::key, key.size()) +
+          protobuf::length_delimited_size(key_value::value, value_size));
+  protobuf::pack_string(destination, key_value::key, key);
+  protobuf::pack_message_header(destination, key_value::value, value_size);
+  protobuf::pack_double(destination, any_value::double_value, value);
+}
+
+template <typename Attributes>
+void pack_attributes(std::string& destination, std::uint32_t field,
+                     const Attributes& attributes) {
+  for (const auto& [key, value] : attributes) {
+    pack_attribute(destination, field, key, value);
+  }
+}
+
+// OTLP identifiers are big endian byte strings.
+void pack_id(std::string& destination, std::uint32_t field,
+             std::uint64_t high, std::uint64_t low, std::size_t size) {
+  char bytes[16];
+  for (std::size_t i = 0; i < 8; ++i) {
+    bytes[i] = char((high >> (CHAR_BIT * (7 - i))) & 0xFF);
+    bytes[8 + i] = char((low >> (CHAR_BIT * (7 - i))) & 0xFF);
+  }
+  protobuf::pack_string(destination, field,
+                        StringView(bytes + (16 - size), size));
+}
+
+void pack_trace_id(std::string& destination, std::uint32_t field,
+                   const TraceID& trace_id) {
+  pack_id(destination, field, trace_id.high, trace_id.low, 16);
+}
+
+void pack_span_id(std::string& destination, std::uint32_t field,
+                  std::uint64_t span_id) {
+  pack_id(destination, field, 0, span_id, 8);
+}
+
+std::uint64_t unix_nanoseconds(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Return the OTLP `SpanKind` named by the specified "span.kind" tag `value`,
+// or zero (unspecified) if `value` names none.
+std::uint64_t span_kind(StringView value) {
+  if (value == "internal") return 1;
+  if (value == "server") return 2;
+  if (value == "client") return 3;
+  if (value == "producer") return 4;
+  if (value == "consumer") return 5;
+  return 0;
+}
+
+// Append to the specified `destination` the specified `span` as a `spans`
+// field of a `ScopeSpans`.  The span's service, environment, version, and
+// shared tags are the attributes of its `Resource`, so they are not encoded
+// here.
+void encode_span(std::string& destination, const SpanData& data) {
+  const std::size_t length_position =
+      protobuf::begin_message(destination, scope_spans::spans);
+
+  pack_trace_id(destination, span::trace_id, data.trace_id);
+  pack_span_id(destination, span::span_id, data.span_id);
+  if (data.parent_id != 0) {
+    pack_span_id(destination, span::parent_span_id, data.parent_id);
+  }
+  protobuf::pack_string(destination, span::name, data.name);
+  const auto kind = data.tags.find("span.kind");
+  if (kind != data.tags.end()) {
+    if (const auto value = span_kind(kind->second)) {
+      protobuf::pack_uint64(destination, span::kind, value);
+    }
+  }
+  const auto start = unix_nanoseconds(data.start.wall);
+  protobuf::pack_fixed64(destination, span::start_time_unix_nano, start);
+  protobuf::pack_fixed64(
+      destination, span::end_time_unix_nano,
+      start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  data.duration)
+                  .count());
+
+  if (!data.resource.empty()) {
+    pack_attribute(destination, span::attributes, tags::resource_name,
+                   data.resource);
+  }
+  if (!data.service_type.empty()) {
+    pack_attribute(destination, span::attributes, tags::span_type,
+                   data.service_type);
+  }
+  for (const auto& [key, value] : data.tags) {
+    if (key == tags::environment || key == tags::version) {
+      continue;
+    }
+    pack_attribute(destination, span::attributes, key, value);
+  }
+  if (const std::string* error_stack = symbolized_error_stack(data)) {
+    pack_attribute(destination, span::attributes, tags::error_stack,
+                   *error_stack);
+  }
+  pack_attributes(destination, span::attributes, data.numeric_tags);
+
+  for (const SpanEvent& item : data.events) {
+    const std::size_t event_position =
+        protobuf::begin_message(destination, span::events);
+    protobuf::pack_fixed64(destination, event::time_unix_nano,
+                           unix_nanoseconds(item.time));
+    protobuf::pack_string(destination, event::name, item.name);
+    pack_attributes(destination, event::attributes, item.attributes);
+    protobuf::end_message(destination, event_position);
+  }
+
+  for (const SpanLink& item : data.links) {
+    const std::size_t link_position =
+        protobuf::begin_message(destination, span::links);
+    pack_trace_id(destination, link::trace_id, item.trace_id);
+    pack_span_id(destination, link::span_id, item.span_id);
+    if (!item.tracestate.empty()) {
+      protobuf::pack_string(destination, link::trace_state, item.tracestate);
+    }
+    pack_attributes(destination, link::attributes, item.attributes);
+    if (item.flags) {
+      protobuf::pack_fixed32(destination, link::flags, *item.flags);
+    }
+    protobuf::end_message(destination, link_position);
+  }
+
+  if (data.error) {
+    const std::size_t status_position =
+        protobuf::begin_message(destination, span::status);
+    const auto message = data.tags.find("error.message");
+    if (message != data.tags.end()) {
+      protobuf::pack_string(destination, status::message, message->second);
+    }
+    protobuf::pack_uint64(destination, status::code, status::code_error);
+    protobuf::end_message(destination, status_position);
+  }
+
+  protobuf::end_message(destination, length_position);
+}
+
+// Return the element of the specified `groups` having the specified
+// `service`, `environment`, `version`, and `shared_tags`, or `groups.end()`
+// if there is none.
+std::vector<OtlpExporter::Resource>::iterator find_resource(
+    std::vector<OtlpExporter::Resource>& groups, StringView service,
+    StringView environment, StringView version,
+    const std::shared_ptr<const SharedTags>& shared_tags) {
+  auto found = groups.begin();
+  while (found != groups.end() &&
+         !(found->shared_tags == shared_tags && found->service == service &&
+           found->environment == environment && found->version == version)) {
+    ++found;
+  }
+  return found;
+}
+
+// Return the element of the specified `groups` to which the specified `data`
+// belongs, adding one if there is none.
+OtlpExporter::Resource& resource_for(
+    std::vector<OtlpExporter::Resource>& groups, const SpanData& data) {
+  const StringView environment = data.environment().value_or("");
+  const StringView version = data.version().value_or("");
+  auto found = find_resource(groups, data.service, environment, version,
+                             data.shared_tags);
+  if (found != groups.end()) {
+    return *found;
+  }
+  auto& group = groups.emplace_back();
+  group.service = data.service;
+  group.environment = std::string(environment);
+  group.version = std::string(version);
+  group.shared_tags = data.shared_tags;
+  return group;
+}
+
+}  // namespace
+
+OtlpExporter::OtlpExporter(const FinalizedOtlpExporterConfig& config,
+                           const std::shared_ptr<Logger>& logger,
+                           const TracerSignature& tracer_signature)
+    : clock_(config.clock),
+      logger_(logger),
+      buffered_bytes_(0),
+      flush_threshold_bytes_(config.flush_threshold_bytes),
+      max_buffered_bytes_(config.max_buffered_bytes),
+      traces_endpoint_(config.url),
+      http_client_(config.http_client),
+      event_scheduler_(config.event_scheduler),
+      flush_interval_(config.flush_interval),
+      request_timeout_(config.request_timeout),
+      shutdown_timeout_(config.shutdown_timeout),
+      library_version_(tracer_signature.library_version),
+      headers_(config.headers) {
+  assert(logger_);
+
+  headers_.insert_or_assign("Content-Type", "application/x-protobuf");
+
+  tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
+      config.flush_interval, [this]() { flush(); }));
+}
+
+OtlpExporter::~OtlpExporter() { shut_down(clock_().tick + shutdown_timeout_); }
+
+void OtlpExporter::shut_down(std::chrono::steady_clock::time_point deadline) {
+  shut_down_collector(
+      shut_down_once_, tasks_,
+      [this](std::chrono::steady_clock::time_point) { flush(); }, *http_client_,
+      deadline);
+}
+
+Expected<void> OtlpExporter::send(
+    std::vector<std::unique_ptr<SpanData>>&& spans,
+    const std::shared_ptr<TraceSampler>& /*response_handler*/) {
+  // The spans of a chunk usually all belong to one resource.
+  std::vector<Resource> encoded;
+  std::size_t encoded_size = 0;
+  auto beg = std::chrono::steady_clock::now();
+  for (const auto& span_ptr : spans) {
+    assert(span_ptr);
+    std::string& destination = resource_for(encoded, *span_ptr).spans;
+    const std::size_t before = destination.size();
+    encode_span(destination, *span_ptr);
+    encoded_size += destination.size() - before;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  telemetry::distribution::add(
+      metrics::tracer::trace_chunk_serialization_duration,
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+  OverheadGovernor::add_cost(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+  spans.clear();
+
+  std::vector<Resource> resources;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffered_bytes_ + encoded_size > max_buffered_bytes_) {
+      telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                    {"reason:overfull_buffer"});
+      return nullopt;
+    }
+    buffered_bytes_ += encoded_size;
+    for (auto& group : encoded) {
+      const auto buffered =
+          find_resource(resources_, group.service, group.environment,
+                        group.version, group.shared_tags);
+      if (buffered == resources_.end()) {
+        resources_.push_back(std::move(group));
+      } else {
+        buffered->spans += group.spans;
+      }
+    }
+    if (buffered_bytes_ < flush_threshold_bytes_) {
+      return nullopt;
+    }
+    using std::swap;
+    swap(resources, resources_);
+    buffered_bytes_ = 0;
+  }
+
+  // The batch is large enough to send now, rather than wait for the next
+  // flush interval.
+  send_resources(std::move(resources));
+  return nullopt;
+}
+
+void OtlpExporter::flush() {
+  std::vector<Resource> resources;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    using std::swap;
+    swap(resources, resources_);
+    buffered_bytes_ = 0;
+  }
+
+  send_resources(std::move(resources));
+}
+
+void OtlpExporter::send_resources(std::vector<Resource>&& resources) {
+  if (resources.empty()) {
+    return;
+  }
+
+  // The `Resource` and `InstrumentationScope` of each group are small, and
+  // are encoded first so that the sizes of the enclosing messages are known
+  // before the spans are copied.
+  std::string scope;
+  protobuf::pack_string(scope, scope::name, "dd-trace-cpp");
+  protobuf::pack_string(scope, scope::version, library_version_);
+
+  std::vector<std::string> attributes;
+  attributes.reserve(resources.size());
+  std::size_t body_size = 0;
+  for (const Resource& group : resources) {
+    std::string& encoded = attributes.emplace_back();
+    pack_attribute(encoded, resource::attributes, "service.name",
+                   group.service);
+    if (!group.environment.empty()) {
+      pack_attribute(encoded, resource::attributes, "deployment.environment",
+                     group.environment);
+    }
+    if (!group.version.empty()) {
+      pack_attribute(encoded, resource::attributes, "service.version",
+                     group.version);
+    }
+    pack_attribute(encoded, resource::attributes, "telemetry.sdk.name",
+                   "datadog");
+    pack_attribute(encoded, resource::attributes, "telemetry.sdk.language",
+                   "cpp");
+    pack_attribute(encoded, resource::attributes, "telemetry.sdk.version",
+                   library_version_);
+    if (group.shared_tags) {
+      pack_attributes(encoded, resource::attributes,
+                      group.shared_tags->tags());
+      pack_attributes(encoded, resource::attributes,
+                      group.shared_tags->numeric_tags());
+    }
+    // Each group has four message headers: `ResourceSpans`, `Resource`,
+    // `ScopeSpans`, and `InstrumentationScope`.
+    body_size += 4 * (1 + protobuf::max_length_size) + encoded.size() +
+                 scope.size() + group.spans.size();
+  }
+
+  std::string body;
+  body.reserve(body_size);
+  for (std::size_t i = 0; i < resources.size(); ++i) {
+    Resource& group = resources[i];
+    const std::size_t scope_spans_size =
+        protobuf::length_delimited_size(scope_spans::scope, scope.size()) +
+        group.spans.size();
+    protobuf::pack_message_header(
+        body, export_request::resource_spans,
+        protobuf::length_delimited_size(resource_spans::resource,
+                                        attributes[i].size()) +
+            protobuf::length_delimited_size(resource_spans::scope_spans,
+                                            scope_spans_size));
+    protobuf::pack_message_header(body, resource_spans::resource,
+                                  attributes[i].size());
+    body += attributes[i];
+    protobuf::pack_message_header(body, resource_spans::scope_spans,
+                                  scope_spans_size);
+    protobuf::pack_string(body, scope_spans::scope, scope);
+    body += group.spans;
+    // Release each group once it is copied, so that the batch is not held in
+    // memory twice.
+    std::string().swap(group.spans);
+  }
+  telemetry::distribution::add(metrics::tracer::trace_chunk_serialized_bytes,
+                               static_cast<uint64_t>(body.size()));
+
+  auto set_request_headers = [&](DictWriter& writer) {
+    for (const auto& [key, value] : headers_) {
+      writer.set(key, value);
+    }
+  };
+
+  auto on_response = [logger = logger_](int response_status,
+                                        const DictReader& /*response_headers*/,
+                                        std::string response_body) {
+    if (response_status >= 200 && response_status < 300) {
+      telemetry::counter::increment(metrics::tracer::api::responses,
+                                    {"status_code:2xx"});
+      return;
+    }
+    telemetry::counter::increment(
+        metrics::tracer::api::responses,
+        {response_status >= 500   ? "status_code:5xx"
+         : response_status >= 400 ? "status_code:4xx"
+                                  : "status_code:3xx"});
+    logger->log_error([&](auto& stream) {
+      stream << "Unexpected response status " << response_status
+             << " in OTLP collector response with body of length "
+             << response_body.size() << '.';
+    });
+  };
+
+  auto on_error = [logger = logger_](Error error) {
+    telemetry::counter::increment(metrics::tracer::api::errors,
+                                  {"type:network"});
+    logger->log_error(error.with_prefix(
+        "Error occurred during HTTP request for submitting traces to the "
+        "OTLP collector: "));
+  };
+
+  telemetry::counter::increment(metrics::tracer::api::requests);
+  telemetry::distribution::add(metrics::tracer::api::bytes_sent,
+                               static_cast<uint64_t>(body.size()));
+
+  auto post_result =
+      http_client_->post(traces_endpoint_, std::move(set_request_headers),
+                         std::move(body), std::move(on_response),
+                         std::move(on_error), clock_().tick + request_timeout_);
+  if (auto* error = post_result.if_error()) {
+    telemetry::counter::increment(metrics::tracer::api::errors,
+                                  {"type:network"});
+    logger_->log_error(
+        error->with_prefix("Unexpected error submitting traces: "));
+  }
+}
+
+std::string OtlpExporter::config() const {
+  // clang-format off
+  return nlohmann::json::object({
+    {"type", "datadog::tracing::OtlpExporter"},
+    {"config", nlohmann::json::object({
+      {"traces_url", to_url_string(traces_endpoint_)},
+      {"flush_interval_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_).count() },
+      {"request_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(request_timeout_).count() },
+      {"shutdown_timeout_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(shutdown_timeout_).count() },
+      {"flush_threshold_bytes", flush_threshold_bytes_},
+      {"max_buffered_bytes", max_buffered_bytes_},
+      {"http_client", nlohmann::json::parse(http_client_->config())},
+      {"event_scheduler", nlohmann::json::parse(event_scheduler_->config())},
+    })},
+  }).dump();
+  // clang-format on
+}
+
+}  // namespace tracing
+}  // namespace datadog
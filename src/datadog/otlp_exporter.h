@@ -0,0 +1,108 @@
+#pragma once
+
+// This component provides a `class`, `OtlpExporter`, that implements the
+// `Collector` interface in terms of HTTP requests sent to an OpenTelemetry
+// collector, using the OTLP/HTTP protobuf format.
+//
+// `OtlpExporter` encodes each span of a trace chunk when the chunk is sent,
+// directly as an OTLP `Span` message (see `protobuf.h`), and buffers the
+// encoded spans until they reach a size threshold or until the next flush
+// interval.  The buffered spans are sent as one ExportTraceServiceRequest, and
+// they are sent when the `OtlpExporter` is destroyed.
+//
+// Spans are grouped by their service, environment, version, and shared tags
+// (see `shared_tags.h`), which are encoded once per group, as the attributes
+// of its OTLP `Resource`, rather than as attributes of each span.  The spans
+// of a tracer usually have one or a few such groups.
+//
+// `OtlpExporter` receives no sample rates in response, and it does not poll
+// for Remote Configuration.
+//
+// `OtlpExporter` is configured by `OtlpExporterConfig`.  See
+// `otlp_exporter_config.h`.
+
+#include <datadog/clock.h>
+#include <datadog/collector.h>
+#include <datadog/event_scheduler.h>
+#include <datadog/http_client.h>
+#include <datadog/otlp_exporter_config.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+class SharedTags;
+struct SpanData;
+class TraceSampler;
+struct TracerSignature;
+
+class OtlpExporter : public Collector {
+ public:
+  // `Resource` is the encoding of the spans that have the same resource
+  // attributes.
+  struct Resource {
+    std::string service;
+    std::string environment;
+    std::string version;
+    // Shared tags are compared by address, which is stable while `Resource`
+    // refers to them.
+    std::shared_ptr<const SharedTags> shared_tags;
+    // The concatenated `spans` fields of an OTLP `ScopeSpans`.
+    std::string spans;
+  };
+
+ private:
+  std::mutex mutex_;
+  Clock clock_;
+  std::shared_ptr<Logger> logger_;
+  // The encodings of the spans not yet sent.  Guarded by `mutex_`.
+  std::vector<Resource> resources_;
+  // The total size of the `spans` of `resources_`.  Guarded by `mutex_`.
+  std::size_t buffered_bytes_;
+  const std::size_t flush_threshold_bytes_;
+  const std::size_t max_buffered_bytes_;
+  HTTPClient::URL traces_endpoint_;
+  std::shared_ptr<HTTPClient> http_client_;
+  std::shared_ptr<EventScheduler> event_scheduler_;
+  std::vector<EventScheduler::Cancel> tasks_;
+  std::chrono::steady_clock::duration flush_interval_;
+  std::chrono::steady_clock::duration request_timeout_;
+  std::chrono::steady_clock::duration shutdown_timeout_;
+  // Used by `shut_down_collector`, so that this collector shuts down once.
+  std::once_flag shut_down_once_;
+  std::string library_version_;
+
+  std::unordered_map<std::string, std::string> headers_;
+
+  // Send the buffered spans to the OpenTelemetry collector.
+  void flush();
+  // Send the specified encoded `resources` to the OpenTelemetry collector in
+  // one request.
+  void send_resources(std::vector<Resource>&& resources);
+
+ public:
+  OtlpExporter(const FinalizedOtlpExporterConfig&,
+               const std::shared_ptr<Logger>&, const TracerSignature&);
+  ~OtlpExporter();
+
+  void shut_down(std::chrono::steady_clock::time_point deadline) override;
+
+  Expected<void> send(
+      std::vector<std::unique_ptr<SpanData>>&& spans,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+
+  std::string config() const override;
+
+  bool accepts_shared_tags() const override { return true; }
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,95 @@
+#include <datadog/environment.h>
+#include <datadog/otlp_exporter_config.h>
+
+#include <chrono>
+#include <cstddef>
+
+#include "default_http_client.h"
+#include "thread_generator.h"
+#include "threaded_event_scheduler.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<FinalizedOtlpExporterConfig> finalize_config(
+    const OtlpExporterConfig& user_config,
+    const std::shared_ptr<Logger>& logger, const Clock& clock) {
+  FinalizedOtlpExporterConfig result;
+
+  result.clock = clock;
+
+  auto validated = validate(user_config.background_threads);
+  if (auto* error = validated.if_error()) {
+    return error->with_prefix("OtlpExporter: ");
+  }
+
+  result.background_threads = user_config.background_threads;
+  result.default_http_client = !user_config.http_client;
+  if (!user_config.http_client) {
+    result.http_client = shared_default_http_client(
+        logger, clock, {}, user_config.background_threads);
+    if (!result.http_client) {
+      return Error{Error::OTLP_EXPORTER_NULL_HTTP_CLIENT,
+                   "OtlpExporter: HTTP client cannot be null."};
+    }
+  } else {
+    result.http_client = user_config.http_client;
+  }
+
+  result.default_event_scheduler = !user_config.event_scheduler;
+  if (!user_config.event_scheduler) {
+    result.event_scheduler = ThreadedEventScheduler::shared_instance(
+        user_config.background_threads, logger);
+  } else {
+    result.event_scheduler = user_config.event_scheduler;
+  }
+
+  std::string url;
+  if (auto endpoint =
+          lookup(environment::OTEL_EXPORTER_OTLP_TRACES_ENDPOINT)) {
+    url = std::string(*endpoint);
+  } else {
+    url = user_config.url.value_or("http://localhost:4318/v1/traces");
+  }
+  auto parsed_url = HTTPClient::URL::parse(url);
+  if (auto* error = parsed_url.if_error()) {
+    return error->with_prefix("OtlpExporter: ");
+  }
+  result.url = std::move(*parsed_url);
+  result.headers = user_config.headers;
+
+  const int flush_interval_milliseconds =
+      user_config.flush_interval_milliseconds.value_or(5000);
+  const int request_timeout_milliseconds =
+      user_config.request_timeout_milliseconds.value_or(10000);
+  const int shutdown_timeout_milliseconds =
+      user_config.shutdown_timeout_milliseconds.value_or(10000);
+  if (flush_interval_milliseconds <= 0 || request_timeout_milliseconds <= 0 ||
+      shutdown_timeout_milliseconds <= 0) {
+    return Error{Error::OTLP_EXPORTER_INVALID_INTERVAL,
+                 "OtlpExporter: Flush interval, request timeout, and shutdown "
+                 "timeout must be positive numbers of milliseconds."};
+  }
+  result.flush_interval =
+      std::chrono::milliseconds(flush_interval_milliseconds);
+  result.request_timeout =
+      std::chrono::milliseconds(request_timeout_milliseconds);
+  result.shutdown_timeout =
+      std::chrono::milliseconds(shutdown_timeout_milliseconds);
+
+  result.flush_threshold_bytes =
+      user_config.flush_threshold_bytes.value_or(2 * 1024 * 1024);
+  result.max_buffered_bytes =
+      user_config.max_buffered_bytes.value_or(32 * 1024 * 1024);
+  if (result.flush_threshold_bytes == 0 ||
+      result.max_buffered_bytes < result.flush_threshold_bytes) {
+    return Error{Error::OTLP_EXPORTER_INVALID_BUFFER_LIMITS,
+                 "OtlpExporter: Flush threshold must be a positive number of "
+                 "bytes, and at most the maximum buffered bytes."};
+  }
+
+  return result;
+}
+
+}  // namespace tracing
+}  // namespace datadog
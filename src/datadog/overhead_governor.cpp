@@ -0,0 +1,77 @@
+#include "overhead_governor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+#include "platform_util.h"
+#include "trace_sampler.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+std::atomic<std::int64_t> cost_nanoseconds{0};
+
+}  // namespace
+
+OverheadGovernor::OverheadGovernor(double max_share,
+                                   std::shared_ptr<TraceSampler> trace_sampler,
+                                   EventScheduler& event_scheduler)
+    : OverheadGovernor(max_share, std::move(trace_sampler), event_scheduler,
+                       get_process_cpu_time) {}
+
+OverheadGovernor::OverheadGovernor(double max_share,
+                                   std::shared_ptr<TraceSampler> trace_sampler,
+                                   EventScheduler& event_scheduler,
+                                   ProcessCPUTime process_cpu_time)
+    : max_share_(max_share),
+      trace_sampler_(std::move(trace_sampler)),
+      process_cpu_time_(std::move(process_cpu_time)),
+      last_cost_(total_cost()),
+      last_process_cpu_time_(process_cpu_time_()) {
+  assert(max_share_ > 0 && max_share_ <= 1);
+  cancel_evaluation_ = event_scheduler.schedule_recurring_event(
+      std::chrono::seconds(1), [this]() { evaluate(); });
+}
+
+OverheadGovernor::~OverheadGovernor() { cancel_evaluation_(); }
+
+void OverheadGovernor::add_cost(std::chrono::nanoseconds cost) {
+  cost_nanoseconds.fetch_add(cost.count(), std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds OverheadGovernor::total_cost() {
+  return std::chrono::nanoseconds(
+      cost_nanoseconds.load(std::memory_order_relaxed));
+}
+
+void OverheadGovernor::evaluate() {
+  const auto cost = total_cost();
+  const auto process_cpu_time = process_cpu_time_();
+  const auto cost_delta = cost - last_cost_;
+  const auto process_delta = process_cpu_time - last_process_cpu_time_;
+  last_cost_ = cost;
+  last_process_cpu_time_ = process_cpu_time;
+  if (process_delta.count() <= 0) {
+    // The process was idle, or its CPU time is not available.
+    return;
+  }
+
+  const double share = double(cost_delta.count()) / process_delta.count();
+  const double keep_rate = trace_sampler_->overhead_keep_rate().value();
+  double new_keep_rate = keep_rate;
+  if (share > max_share_) {
+    new_keep_rate = std::max(min_keep_rate, keep_rate * max_share_ / share);
+  } else if (share < max_share_ / 2) {
+    new_keep_rate = std::min(1.0, keep_rate * 2);
+  }
+  if (new_keep_rate != keep_rate) {
+    trace_sampler_->set_overhead_keep_rate(*Rate::from(new_keep_rate));
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
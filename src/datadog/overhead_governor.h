@@ -0,0 +1,83 @@
+#pragma once
+
+// This component provides a class, `OverheadGovernor`, that keeps the CPU
+// time that a `Tracer` spends on its own work within a share of the CPU time
+// of the process, by lowering the share of traces that the trace sampler
+// keeps when the tracer exceeds its budget, and raising it again when the
+// tracer is well within it.
+//
+// The cost of the tracer is measured where it is concentrated: in the
+// serialization of trace chunks by the collectors and, when built with
+// `DD_TRACE_SELF_PROFILING`, in the operations measured by
+// `SelfProfilingTimer`.  Each measurement is added to a process-wide counter
+// by `add_cost`.  Once a second, the governor compares the cost added since
+// its last evaluation with the CPU time used by the process since then (see
+// `get_process_cpu_time`), and adjusts the keep rate of the trace sampler
+// (see `TraceSampler::set_overhead_keep_rate`):
+//
+// - If the share of the tracer exceeds `max_share`, then the keep rate is
+//   scaled down in proportion, but not below one percent.
+// - If the share of the tracer is less than half of `max_share`, then the
+//   keep rate is doubled, up to one.
+//
+// Traces dropped this way keep the sampling mechanism of the rate that would
+// have kept them, and their local root has the tag "_dd.overhead.dropped".
+
+#include <datadog/event_scheduler.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace datadog {
+namespace tracing {
+
+class TraceSampler;
+
+class OverheadGovernor {
+ public:
+  using ProcessCPUTime = std::function<std::chrono::nanoseconds()>;
+
+ private:
+  const double max_share_;
+  const std::shared_ptr<TraceSampler> trace_sampler_;
+  const ProcessCPUTime process_cpu_time_;
+  std::chrono::nanoseconds last_cost_;
+  std::chrono::nanoseconds last_process_cpu_time_;
+  EventScheduler::Cancel cancel_evaluation_;
+
+ public:
+  // The keep rate below which the governor does not go.
+  static constexpr double min_keep_rate = 0.01;
+
+  // Create a governor that keeps the cost of the tracer within the specified
+  // `max_share` of the CPU time of the process, which must be in (0, 1], by
+  // adjusting the specified `trace_sampler`, evaluating once a second using
+  // the specified `event_scheduler`.  Optionally specify the
+  // `process_cpu_time` function, which by default is
+  // `get_process_cpu_time`.
+  OverheadGovernor(double max_share,
+                   std::shared_ptr<TraceSampler> trace_sampler,
+                   EventScheduler& event_scheduler);
+  OverheadGovernor(double max_share,
+                   std::shared_ptr<TraceSampler> trace_sampler,
+                   EventScheduler& event_scheduler,
+                   ProcessCPUTime process_cpu_time);
+  OverheadGovernor(const OverheadGovernor&) = delete;
+  OverheadGovernor& operator=(const OverheadGovernor&) = delete;
+  ~OverheadGovernor();
+
+  // Add the specified `cost` to the CPU time spent by tracers in this
+  // process.
+  static void add_cost(std::chrono::nanoseconds cost);
+  // Return the CPU time spent by tracers in this process, as added by
+  // `add_cost`.
+  static std::chrono::nanoseconds total_cost();
+
+  // Compare the cost of the tracer with the CPU time of the process since the
+  // previous evaluation, and adjust the keep rate of the trace sampler.
+  void evaluate();
+};
+
+}  // namespace tracing
+}  // namespace datadog
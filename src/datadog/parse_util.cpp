@@ -10,6 +10,7 @@
 #include <sstream>
 #include <string>
 
+#include "hex.h"
 #include "string_util.h"
 
 namespace datadog {
@@ -53,6 +54,13 @@ bool falsy(StringView input) {
 }
 
 Expected<std::uint64_t> parse_uint64(StringView input, int base) {
+  if (base == 16) {
+    // This is the common case of a trace ID or span ID.  If it fails, then
+    // `parse_integer` produces the error.
+    if (const auto value = parse_hex(input)) {
+      return *value;
+    }
+  }
   return parse_integer<std::uint64_t>(input, base, "64-bit unsigned");
 }
 
@@ -5,7 +5,10 @@
 #include <datadog/expected.h>
 #include <datadog/optional.h>
 #include <datadog/string_view.h>
+#include <datadog/thread_options.h>
 
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <string>
 
@@ -82,12 +85,81 @@ std::string get_hostname();
 
 int get_process_id();
 
+// Return the CPU time that the current process has used, in all of its
+// threads, or zero if it cannot be determined.
+std::chrono::nanoseconds get_process_cpu_time();
+
 std::string get_process_name();
 
+// Store in the specified `frames` the return addresses of at most the
+// specified `max_frames` frames of the calling thread's stack, innermost
+// first, skipping the specified `skip` innermost frames of the caller.  Return
+// the number of addresses stored, which is zero if the stack cannot be
+// walked on this platform.  The addresses are not symbolized (see
+// `describe_code_address`).
+std::size_t capture_return_addresses(void** frames, std::size_t max_frames,
+                                     std::size_t skip);
+
+// Return a human-readable description of the code at the specified
+// `address`: its function and the offset within it, or else its module and
+// the offset within that, or else the address itself.
+std::string describe_code_address(const void* address);
+
 Optional<std::filesystem::path> get_process_path();
 
 int at_fork_in_child(void (*on_fork)());
 
+// Return `size` bytes of zero-initialized memory that is shared with the
+// processes that are forked afterward, or return null if that is not possible.
+void* map_shared_memory(std::size_t size);
+
+// Return `size` bytes of memory mapped from the file at the specified `path`,
+// which is created if it does not exist and is resized to `size` bytes, or
+// return null if that is not possible.  Changes to the memory are written to
+// the file, and are shared with the other processes that map it.
+void* map_file(const std::string& path, std::size_t size);
+
+// Release the specified `memory` of the specified `size`, which was returned
+// by `map_shared_memory` or `map_file`.
+void unmap_shared_memory(void* memory, std::size_t size);
+
+// Return whether a process having the specified `pid` is running.
+bool process_exists(int pid);
+
+// Return a non-blocking Unix domain socket connected to the specified `path`,
+// of type `SOCK_SEQPACKET` if the specified `seqpacket` is true, or of type
+// `SOCK_DGRAM` otherwise.  Return an error if that is not possible.
+Expected<int> connect_unix_datagram_socket(const std::string& path,
+                                           bool seqpacket);
+
+// The outcome of `send_datagram`.
+enum class DatagramStatus : char {
+  SENT,
+  // The socket's buffer is full.
+  WOULD_BLOCK,
+  // The datagram is larger than the socket accepts.
+  TOO_LARGE,
+  // The receiver is gone, or the socket is otherwise unusable.
+  FAILED,
+};
+
+// Send the specified `size` bytes at the specified `data` as one datagram on
+// the specified `socket`, which was returned by
+// `connect_unix_datagram_socket`, without blocking.  Sending never raises
+// `SIGPIPE`.
+DatagramStatus send_datagram(int socket, const char* data, std::size_t size);
+
+// Close the specified `socket`, which was returned by
+// `connect_unix_datagram_socket`.
+void close_datagram_socket(int socket);
+
+// Apply the specified `options` to the calling thread, and name it the
+// specified `name` unless `name` is empty.  Return an error describing the
+// options that could not be applied, if any.  The other options are applied
+// regardless.
+Expected<void> configure_current_thread(const ThreadOptions& options,
+                                        const std::string& name);
+
 namespace container {
 
 struct ContainerID final {
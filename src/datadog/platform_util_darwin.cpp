@@ -1,15 +1,30 @@
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
 #include <libproc.h>
 #include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/sysctl.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/utsname.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <regex>
 
+#include "hex.h"
 #include "platform_util.h"
 
 #define DD_SDK_OS "Darwin"
@@ -59,6 +74,59 @@ std::string get_hostname() { return get_host_info().hostname; }
 
 int get_process_id() { return ::getpid(); }
 
+std::chrono::nanoseconds get_process_cpu_time() {
+  struct timespec time;
+  if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::seconds(time.tv_sec) +
+         std::chrono::nanoseconds(time.tv_nsec);
+}
+
+std::size_t capture_return_addresses(void** frames, std::size_t max_frames,
+                                     std::size_t skip) {
+  // Skip this function's own frame, too.
+  ++skip;
+  void* buffer[128];
+  const std::size_t wanted =
+      std::min(sizeof buffer / sizeof *buffer, max_frames + skip);
+  const int count = ::backtrace(buffer, int(wanted));
+  if (count <= int(skip)) {
+    return 0;
+  }
+  const std::size_t size = std::size_t(count) - skip;
+  std::memcpy(frames, buffer + skip, size * sizeof *frames);
+  return size;
+}
+
+std::string describe_code_address(const void* address) {
+  std::string result;
+  Dl_info info;
+  if (::dladdr(address, &info) == 0) {
+    result += "0x";
+    result += hex(std::uintptr_t(address));
+    return result;
+  }
+  if (info.dli_sname) {
+    int status;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    result += demangled ? demangled : info.dli_sname;
+    std::free(demangled);
+    result += "+0x";
+    result += hex(std::uintptr_t(address) - std::uintptr_t(info.dli_saddr));
+  } else {
+    result += "0x";
+    result += hex(std::uintptr_t(address) - std::uintptr_t(info.dli_fbase));
+  }
+  if (info.dli_fname) {
+    result += " (";
+    result += info.dli_fname;
+    result += ')';
+  }
+  return result;
+}
+
 Optional<std::filesystem::path> get_process_path() {
   char pathbuf[PROC_PIDPATHINFO_MAXSIZE];
   if (!proc_pidpath(::getpid(), pathbuf, sizeof(pathbuf))) {
@@ -79,6 +147,108 @@ int at_fork_in_child(void (*on_fork)()) {
                         /*in child*/ on_fork);
 }
 
+void* map_shared_memory(std::size_t size) {
+  void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void* map_file(const std::string& path, std::size_t size) {
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return nullptr;
+  }
+  void* memory = nullptr;
+  struct stat status;
+  if (::fstat(fd, &status) == 0 &&
+      (std::uint64_t(status.st_size) == size ||
+       ::ftruncate(fd, off_t(size)) == 0)) {
+    memory =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  // The mapping remains valid after the file is closed.
+  ::close(fd);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void unmap_shared_memory(void* memory, std::size_t size) {
+  ::munmap(memory, size);
+}
+
+bool process_exists(int pid) {
+  // Signal 0 checks for the process without signaling it.  EPERM means that
+  // the process exists but belongs to another user.
+  return ::kill(pid, 0) == 0 || errno == EPERM;
+}
+
+Expected<int> connect_unix_datagram_socket(const std::string& path,
+                                           bool seqpacket) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) {
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 "Unix domain socket path is too long: " + path};
+  }
+  std::memcpy(address.sun_path, path.data(), path.size());
+
+  // macOS has neither `SOCK_NONBLOCK` nor `MSG_NOSIGNAL`, so the socket is
+  // configured after it is created.
+  const int fd = ::socket(AF_UNIX, seqpacket ? SOCK_SEQPACKET : SOCK_DGRAM, 0);
+  if (fd == -1) {
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 std::string("Unable to create Unix domain socket: ") +
+                     std::strerror(errno)};
+  }
+  const int on = 1;
+  if (::fcntl(fd, F_SETFD, FD_CLOEXEC) == -1 ||
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+      ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on) == -1 ||
+      ::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                sizeof address) == -1) {
+    const int error = errno;
+    ::close(fd);
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 "Unable to connect to Unix domain socket " + path + ": " +
+                     std::strerror(error)};
+  }
+  return fd;
+}
+
+DatagramStatus send_datagram(int socket, const char* data, std::size_t size) {
+  while (::send(socket, data, size, 0) == -1) {
+    switch (errno) {
+      case EINTR:
+        continue;
+      case EAGAIN:
+      case ENOBUFS:
+        return DatagramStatus::WOULD_BLOCK;
+      case EMSGSIZE:
+        return DatagramStatus::TOO_LARGE;
+      default:
+        return DatagramStatus::FAILED;
+    }
+  }
+  return DatagramStatus::SENT;
+}
+
+void close_datagram_socket(int socket) { ::close(socket); }
+
+Expected<void> configure_current_thread(const ThreadOptions& options,
+                                        const std::string& name) {
+  if (!name.empty()) {
+    // macOS can name only the calling thread, and limits names to 64 bytes,
+    // including the terminating null.
+    ::pthread_setname_np(name.substr(0, 63).c_str());
+  }
+  if (!options.cpus.empty() || options.scheduling_policy || options.nice) {
+    return Error{Error::THREAD_OPTIONS_UNAVAILABLE,
+                 "CPU affinity, scheduling policy, and nice value of threads "
+                 "are not supported on macOS."};
+  }
+  return nullopt;
+}
+
 InMemoryFile::InMemoryFile(void* handle) : handle_(handle) {}
 
 InMemoryFile::~InMemoryFile() {}
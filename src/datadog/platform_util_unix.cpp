@@ -1,19 +1,35 @@
+#include <cxxabi.h>
+#include <dlfcn.h>
 #include <errno.h>
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#endif
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/statfs.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/utsname.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <cstdint>
 #include <fstream>
 #include <regex>
 #include <string>
 
+#include "hex.h"
 #include "platform_util.h"
 #include "string_util.h"
 
@@ -81,6 +97,66 @@ std::string get_hostname() { return get_host_info().hostname; }
 
 int get_process_id() { return ::getpid(); }
 
+std::chrono::nanoseconds get_process_cpu_time() {
+  struct timespec time;
+  if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+    return std::chrono::nanoseconds::zero();
+  }
+  return std::chrono::seconds(time.tv_sec) +
+         std::chrono::nanoseconds(time.tv_nsec);
+}
+
+std::size_t capture_return_addresses(void** frames, std::size_t max_frames,
+                                     std::size_t skip) {
+#if __has_include(<execinfo.h>)
+  // Skip this function's own frame, too.
+  ++skip;
+  void* buffer[128];
+  const std::size_t wanted =
+      std::min(sizeof buffer / sizeof *buffer, max_frames + skip);
+  const int count = ::backtrace(buffer, int(wanted));
+  if (count <= int(skip)) {
+    return 0;
+  }
+  const std::size_t size = std::size_t(count) - skip;
+  std::memcpy(frames, buffer + skip, size * sizeof *frames);
+  return size;
+#else
+  (void)frames;
+  (void)max_frames;
+  (void)skip;
+  return 0;
+#endif
+}
+
+std::string describe_code_address(const void* address) {
+  std::string result;
+  Dl_info info;
+  if (::dladdr(address, &info) == 0) {
+    result += "0x";
+    result += hex(std::uintptr_t(address));
+    return result;
+  }
+  if (info.dli_sname) {
+    int status;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    result += demangled ? demangled : info.dli_sname;
+    std::free(demangled);
+    result += "+0x";
+    result += hex(std::uintptr_t(address) - std::uintptr_t(info.dli_saddr));
+  } else {
+    result += "0x";
+    result += hex(std::uintptr_t(address) - std::uintptr_t(info.dli_fbase));
+  }
+  if (info.dli_fname) {
+    result += " (";
+    result += info.dli_fname;
+    result += ')';
+  }
+  return result;
+}
+
 Optional<std::filesystem::path> get_process_path() {
   return fs::path(program_invocation_name);
 }
@@ -93,6 +169,155 @@ int at_fork_in_child(void (*on_fork)()) {
                         /*in child*/ on_fork);
 }
 
+void* map_shared_memory(std::size_t size) {
+  void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void* map_file(const std::string& path, std::size_t size) {
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return nullptr;
+  }
+  void* memory = nullptr;
+  struct stat status;
+  if (::fstat(fd, &status) == 0 &&
+      (std::uint64_t(status.st_size) == size ||
+       ::ftruncate(fd, off_t(size)) == 0)) {
+    memory =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  // The mapping remains valid after the file is closed.
+  ::close(fd);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void unmap_shared_memory(void* memory, std::size_t size) {
+  ::munmap(memory, size);
+}
+
+bool process_exists(int pid) {
+  // Signal 0 checks for the process without signaling it.  EPERM means that
+  // the process exists but belongs to another user.
+  return ::kill(pid, 0) == 0 || errno == EPERM;
+}
+
+Expected<int> connect_unix_datagram_socket(const std::string& path,
+                                           bool seqpacket) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) {
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 "Unix domain socket path is too long: " + path};
+  }
+  std::memcpy(address.sun_path, path.data(), path.size());
+
+  const int fd =
+      ::socket(AF_UNIX,
+               (seqpacket ? SOCK_SEQPACKET : SOCK_DGRAM) | SOCK_NONBLOCK |
+                   SOCK_CLOEXEC,
+               0);
+  if (fd == -1) {
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 std::string("Unable to create Unix domain socket: ") +
+                     std::strerror(errno)};
+  }
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                sizeof address) == -1) {
+    const int error = errno;
+    ::close(fd);
+    return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+                 "Unable to connect to Unix domain socket " + path + ": " +
+                     std::strerror(error)};
+  }
+  return fd;
+}
+
+DatagramStatus send_datagram(int socket, const char* data, std::size_t size) {
+  while (::send(socket, data, size, MSG_NOSIGNAL) == -1) {
+    switch (errno) {
+      case EINTR:
+        continue;
+      case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+      case EWOULDBLOCK:
+#endif
+      case ENOBUFS:
+        return DatagramStatus::WOULD_BLOCK;
+      case EMSGSIZE:
+        return DatagramStatus::TOO_LARGE;
+      default:
+        return DatagramStatus::FAILED;
+    }
+  }
+  return DatagramStatus::SENT;
+}
+
+void close_datagram_socket(int socket) { ::close(socket); }
+
+Expected<void> configure_current_thread(const ThreadOptions& options,
+                                        const std::string& name) {
+  std::string failures;
+  const auto fail = [&](const char* what, int error) {
+    if (!failures.empty()) {
+      failures += "; ";
+    }
+    failures += what;
+    failures += ": ";
+    failures += std::strerror(error);
+  };
+
+  if (!name.empty()) {
+    // Thread names are limited to 16 bytes, including the terminating null.
+    const std::string truncated = name.substr(0, 15);
+    const int rc = ::pthread_setname_np(::pthread_self(), truncated.c_str());
+    if (rc != 0) {
+      fail("Unable to set the thread name", rc);
+    }
+  }
+
+  if (!options.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const int cpu : options.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpus);
+      }
+    }
+    // Zero means the calling thread, rather than the whole process.
+    if (::sched_setaffinity(0, sizeof cpus, &cpus) != 0) {
+      fail("Unable to set the thread's CPU affinity", errno);
+    }
+  }
+
+  if (options.scheduling_policy) {
+    const int policy =
+        *options.scheduling_policy == ThreadSchedulingPolicy::IDLE
+            ? SCHED_IDLE
+            : SCHED_BATCH;
+    sched_param param{};
+    if (::sched_setscheduler(0, policy, &param) != 0) {
+      fail("Unable to set the thread's scheduling policy", errno);
+    }
+  }
+
+  if (options.nice) {
+    // On Linux, the nice value belongs to the thread, identified by its
+    // thread ID.
+    const auto thread_id = static_cast<id_t>(::syscall(SYS_gettid));
+    if (::setpriority(PRIO_PROCESS, thread_id, *options.nice) != 0) {
+      fail("Unable to set the thread's nice value", errno);
+    }
+  }
+
+  if (!failures.empty()) {
+    return Error{Error::THREAD_OPTIONS_UNAVAILABLE, failures};
+  }
+  return nullopt;
+}
+
 InMemoryFile::InMemoryFile(void* handle) : handle_(handle) {}
 
 InMemoryFile::InMemoryFile(InMemoryFile&& rhs) {
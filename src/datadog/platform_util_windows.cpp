@@ -9,6 +9,7 @@
 #include <fstream>
 #include <regex>
 
+#include "hex.h"
 #include "platform_util.h"
 
 using namespace std::literals;
@@ -102,6 +103,46 @@ std::string get_hostname() { return get_host_info().hostname; }
 
 int get_process_id() { return GetCurrentProcessId(); }
 
+std::chrono::nanoseconds get_process_cpu_time() {
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel,
+                       &user)) {
+    return std::chrono::nanoseconds::zero();
+  }
+  const auto ticks = [](const FILETIME& time) {
+    return (std::uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+  };
+  // `FILETIME` counts intervals of 100 nanoseconds.
+  return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+}
+
+std::size_t capture_return_addresses(void** frames, std::size_t max_frames,
+                                     std::size_t skip) {
+  // Skip this function's own frame, too.
+  return CaptureStackBackTrace(DWORD(skip + 1), DWORD(max_frames), frames,
+                               nullptr);
+}
+
+std::string describe_code_address(const void* address) {
+  // Symbol names would require DbgHelp, so describe the address by its
+  // module instead.
+  std::string result = "0x";
+  HMODULE module;
+  char path[MAX_PATH];
+  if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                              GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                          static_cast<LPCSTR>(address), &module) ||
+      GetModuleFileNameA(module, path, sizeof path) == 0) {
+    result += hex(std::uintptr_t(address));
+    return result;
+  }
+  result += hex(std::uintptr_t(address) - std::uintptr_t(module));
+  result += " (";
+  result += path;
+  result += ')';
+  return result;
+}
+
 Optional<std::filesystem::path> get_process_path() {
   const char* cmdline = GetCommandLineA();
   if (cmdline == NULL) return nullopt;
@@ -141,6 +182,63 @@ int at_fork_in_child(void (*on_fork)()) {
   return 0;
 }
 
+void* map_shared_memory(std::size_t size) {
+  // Memory can be shared only with forked processes, and Windows does not
+  // have `fork`.
+  (void)size;
+  return nullptr;
+}
+
+void* map_file(const std::string& path, std::size_t size) {
+  // `SpillFile`, which maps files, is not available on Windows.
+  (void)path;
+  (void)size;
+  return nullptr;
+}
+
+void unmap_shared_memory(void* memory, std::size_t size) {
+  (void)memory;
+  (void)size;
+}
+
+bool process_exists(int pid) {
+  const HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+  if (process == NULL) {
+    return false;
+  }
+  const bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return running;
+}
+
+Expected<int> connect_unix_datagram_socket(const std::string& path,
+                                           bool seqpacket) {
+  // Windows has Unix domain sockets of type `SOCK_STREAM` only.
+  (void)path;
+  (void)seqpacket;
+  return Error{Error::DATAGRAM_SOCKET_UNAVAILABLE,
+               "Unix domain datagram sockets are not supported on Windows."};
+}
+
+DatagramStatus send_datagram(int socket, const char* data, std::size_t size) {
+  (void)socket;
+  (void)data;
+  (void)size;
+  return DatagramStatus::FAILED;
+}
+
+void close_datagram_socket(int socket) { (void)socket; }
+
+Expected<void> configure_current_thread(const ThreadOptions& options,
+                                        const std::string& name) {
+  if (!name.empty() || !options.cpus.empty() || options.scheduling_policy ||
+      options.nice) {
+    return Error{Error::THREAD_OPTIONS_UNAVAILABLE,
+                 "Thread options are not supported on Windows."};
+  }
+  return nullopt;
+}
+
 InMemoryFile::InMemoryFile(void* handle) : handle_(handle) {}
 
 InMemoryFile::InMemoryFile(InMemoryFile&& rhs) {
@@ -0,0 +1,108 @@
+#pragma once
+
+// This component provides a class template, `PoolAllocator`, that is a
+// stateless allocator that recycles the storage of single objects through a
+// bounded, per-thread free list.
+//
+// `PoolAllocator` is used with `std::allocate_shared` to allocate the
+// `TraceSegment` of each trace, together with its `shared_ptr` control block,
+// so that a process creating many traces per second reuses the same few
+// blocks of storage rather than going to the global heap for each trace.
+//
+// Storage freed by a thread goes to that thread's free list, regardless of
+// which thread allocated it.  A thread's free list holds at most
+// `pool_allocator_capacity` blocks of each type, and the rest are returned to
+// the global heap.  Allocations of more than one object are not pooled.
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace datadog {
+namespace tracing {
+
+// The maximum number of freed blocks of one type that a thread keeps.
+constexpr std::size_t pool_allocator_capacity = 64;
+
+template <typename T>
+class PoolAllocator {
+  // A free block holds the address of the next free block.
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  static_assert(sizeof(T) >= sizeof(FreeBlock) &&
+                    alignof(T) >= alignof(FreeBlock),
+                "A free block must fit in the storage of a T.");
+
+  struct FreeList {
+    FreeBlock* head = nullptr;
+    std::size_t size = 0;
+
+    ~FreeList() {
+      destroyed() = true;
+      while (head) {
+        FreeBlock* const block = head;
+        head = block->next;
+        std::allocator<T>{}.deallocate(reinterpret_cast<T*>(block), 1);
+      }
+    }
+  };
+
+  static FreeList& free_list() {
+    thread_local FreeList list;
+    return list;
+  }
+
+  // Whether the calling thread's free list has been destroyed, as it is when
+  // the thread exits.  Objects freed afterward, e.g. by the destructors of
+  // other thread-local objects, go to the global heap.  Being trivially
+  // destructible, this flag remains valid throughout the thread's exit.
+  static bool& destroyed() {
+    thread_local bool flag = false;
+    return flag;
+  }
+
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  PoolAllocator() noexcept = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    if (n == 1 && !destroyed()) {
+      FreeList& list = free_list();
+      if (FreeBlock* const block = list.head) {
+        list.head = block->next;
+        --list.size;
+        return reinterpret_cast<T*>(block);
+      }
+    }
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* pointer, std::size_t n) noexcept {
+    if (n == 1 && !destroyed()) {
+      FreeList& list = free_list();
+      if (list.size < pool_allocator_capacity) {
+        list.head = ::new (static_cast<void*>(pointer)) FreeBlock{list.head};
+        ++list.size;
+        return;
+      }
+    }
+    std::allocator<T>{}.deallocate(pointer, n);
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+}  // namespace tracing
+}  // namespace datadog
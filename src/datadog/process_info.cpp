@@ -0,0 +1,58 @@
+#include "process_info.h"
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+struct CachedProcessInfo {
+  // The process that discovered `info`.
+  int process_id;
+  ProcessInfo info;
+};
+
+std::unique_ptr<CachedProcessInfo> discover() {
+  auto cached = std::make_unique<CachedProcessInfo>();
+  cached->process_id = get_process_id();
+  ProcessInfo& info = cached->info;
+  info.container_id = container::get_id();
+  info.entrypoint_name = get_process_name();
+  std::error_code error;
+  info.entrypoint_workdir =
+      std::filesystem::current_path(error).filename().string();
+  if (auto process_path = get_process_path()) {
+    info.entrypoint_basedir = process_path->parent_path().filename().string();
+  }
+  return cached;
+}
+
+// The info discovered by this process or, after a `fork`, by its parent.
+// Info that is replaced is never deleted, because another thread might still
+// be reading it.  It's replaced at most once per `fork`.
+std::atomic<const CachedProcessInfo*> cache{nullptr};
+
+}  // namespace
+
+const ProcessInfo& process_info() {
+  const int self = get_process_id();
+  const CachedProcessInfo* cached = cache.load(std::memory_order_acquire);
+  if (cached && cached->process_id == self) {
+    return cached->info;
+  }
+
+  auto discovered = discover();
+  if (cache.compare_exchange_strong(cached, discovered.get(),
+                                    std::memory_order_acq_rel,
+                                    std::memory_order_acquire)) {
+    return discovered.release()->info;
+  }
+  // Another thread of this process discovered the info first.  Use its info
+  // instead.
+  return cached->info;
+}
+
+}  // namespace tracing
+}  // namespace datadog
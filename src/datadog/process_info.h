@@ -0,0 +1,39 @@
+#pragma once
+
+// This component provides a function, `process_info`, that returns facts about
+// the current process that the tracer reports, such as its container ID and
+// the "entrypoint.*" process tags.
+//
+// Discovering these facts reads files like "/proc/self/cgroup", which takes
+// long enough to matter to short-lived programs and to servers that create
+// many tracers, e.g. when nginx reloads its configuration.  So, the facts are
+// discovered once per process, the first time they are requested, and are
+// then shared by every `Tracer` and `DatadogAgent` in the process.  A process
+// created by `fork` discovers them again, since it might have a different
+// working directory or control group.
+
+#include <datadog/optional.h>
+
+#include <string>
+
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+
+struct ProcessInfo {
+  Optional<container::ContainerID> container_id;
+  // The values of the "entrypoint.name", "entrypoint.workdir", and
+  // "entrypoint.basedir" process tags.  `entrypoint_basedir` is null if the
+  // path of the executable is not known.
+  std::string entrypoint_name;
+  std::string entrypoint_workdir;
+  Optional<std::string> entrypoint_basedir;
+};
+
+// Return the facts about the current process, discovering them if this is the
+// first call in this process.
+const ProcessInfo& process_info();
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,202 @@
+#include "propagation_headers.h"
+
+#include <datadog/span.h>
+
+#include <cctype>
+
+#include "header_tags.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+enum Header : std::size_t {
+  DATADOG_TRACE_ID,
+  DATADOG_PARENT_ID,
+  DATADOG_SAMPLING_PRIORITY,
+  DATADOG_ORIGIN,
+  DATADOG_TAGS,
+  B3_TRACE_ID,
+  B3_SPAN_ID,
+  B3_SAMPLED,
+  TRACEPARENT,
+  TRACESTATE
+};
+
+char to_lower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+// Return whether the specified `name` is equal to the specified `lower_name`,
+// ignoring the case of `name`.
+bool equals_lower(StringView name, StringView lower_name) {
+  if (name.size() != lower_name.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (to_lower(name[i]) != lower_name[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+const std::array<StringView, PropagationHeaders::count>
+    PropagationHeaders::names = {
+        "x-datadog-trace-id", "x-datadog-parent-id",
+        "x-datadog-sampling-priority", "x-datadog-origin", "x-datadog-tags",
+        "x-b3-traceid", "x-b3-spanid", "x-b3-sampled", "traceparent",
+        "tracestate"};
+
+PropagationHeaders::PropagationHeaders(const DictReader& underlying,
+                                       const HeaderTags* header_tags)
+    : underlying_(underlying),
+      known_(0),
+      examined_(0),
+      header_tags_(header_tags) {
+  if (!underlying_.prefers_visit()) {
+    return;
+  }
+  known_ = Set((1u << count) - 1);
+  underlying_.visit([this](StringView key, StringView value) {
+    const std::size_t index = find(key);
+    if (index != count && !values_[index]) {
+      values_[index] = value;
+    }
+    if (!header_tags_) {
+      return;
+    }
+    const std::size_t tagged = header_tags_->find(key);
+    if (tagged == HeaderTags::npos) {
+      return;
+    }
+    for (const auto& [other, ignored] : tagged_) {
+      if (other == tagged) {
+        return;
+      }
+    }
+    tagged_.emplace_back(tagged, value);
+  });
+}
+
+std::size_t PropagationHeaders::find(StringView name) {
+  // The length of a name, and sometimes one of its characters, determines
+  // the only header that it could be.
+  std::size_t candidate;
+  switch (name.size()) {
+    case 10:
+      candidate = TRACESTATE;
+      break;
+    case 11:
+      candidate = to_lower(name[0]) == 't' ? TRACEPARENT : B3_SPAN_ID;
+      break;
+    case 12:
+      candidate = to_lower(name[5]) == 't' ? B3_TRACE_ID : B3_SAMPLED;
+      break;
+    case 14:
+      candidate = DATADOG_TAGS;
+      break;
+    case 16:
+      candidate = DATADOG_ORIGIN;
+      break;
+    case 18:
+      candidate = DATADOG_TRACE_ID;
+      break;
+    case 19:
+      candidate = DATADOG_PARENT_ID;
+      break;
+    case 27:
+      candidate = DATADOG_SAMPLING_PRIORITY;
+      break;
+    default:
+      return count;
+  }
+  return equals_lower(name, names[candidate]) ? candidate : count;
+}
+
+const Optional<StringView>& PropagationHeaders::value(
+    std::size_t index) const {
+  const Set bit = Set(1u << index);
+  if (!(known_ & bit)) {
+    values_[index] = underlying_.lookup(names[index]);
+    known_ |= bit;
+  }
+  return values_[index];
+}
+
+Optional<StringView> PropagationHeaders::lookup(StringView key) const {
+  const std::size_t index = find(key);
+  if (index == count) {
+    return underlying_.lookup(key);
+  }
+  const auto& found = value(index);
+  if (found) {
+    examined_ |= Set(1u << index);
+  }
+  return found;
+}
+
+void PropagationHeaders::visit(
+    const std::function<void(StringView key, StringView value)>& visitor)
+    const {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (const auto& found = value(i)) {
+      examined_ |= Set(1u << i);
+      visitor(names[i], *found);
+    }
+  }
+}
+
+PropagationHeaders::Set PropagationHeaders::examined() const {
+  return examined_;
+}
+
+void PropagationHeaders::clear_examined() { examined_ = 0; }
+
+std::vector<std::pair<std::string, std::string>> PropagationHeaders::entries(
+    Set headers) const {
+  std::vector<std::pair<std::string, std::string>> result;
+  for (std::size_t i = 0; i < count; ++i) {
+    if ((headers & (1u << i)) && values_[i]) {
+      result.emplace_back(names[i], *values_[i]);
+    }
+  }
+  return result;
+}
+
+void PropagationHeaders::append_entries(std::string& destination,
+                                        Set headers) const {
+  const char* separator = "";
+  for (std::size_t i = 0; i < count; ++i) {
+    if ((headers & (1u << i)) && values_[i]) {
+      destination += separator;
+      destination.append(names[i].data(), names[i].size());
+      destination += ": ";
+      destination.append(values_[i]->data(), values_[i]->size());
+      separator = ", ";
+    }
+  }
+}
+
+void PropagationHeaders::set_header_tags(Span& span) const {
+  if (!header_tags_) {
+    return;
+  }
+  const auto& entries = header_tags_->entries();
+  if (!underlying_.prefers_visit()) {
+    for (const auto& entry : entries) {
+      if (const auto value = underlying_.lookup(entry.header)) {
+        span.set_tag(entry.request_tag, *value);
+      }
+    }
+    return;
+  }
+  for (const auto& [index, value] : tagged_) {
+    span.set_tag(entries[index].request_tag, value);
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
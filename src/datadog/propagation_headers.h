@@ -0,0 +1,110 @@
+#pragma once
+
+// This component provides a class, `PropagationHeaders`, that implements the
+// `DictReader` interface in terms of the trace context headers of another
+// `DictReader`.
+//
+// `PropagationHeaders` visits the other reader once, when it is constructed,
+// and keeps the values of the headers that any extraction propagation style
+// might look up.  `Tracer::extract_span` then runs the extractor of each
+// configured style against it, so that the request's headers are examined
+// once rather than looked up once per header per style.  If the other reader
+// has a fast `lookup` instead (see `DictReader::prefers_visit`), then each
+// header is looked up in it at most once, when first needed.
+//
+// `PropagationHeaders` also remembers which of its headers had values when
+// they were looked up, for use in diagnostic messages.  The names and values
+// are copied only when a message is made (see `entries` and `append_entries`).
+//
+// `PropagationHeaders` can also be given the compiled `HeaderTags` of the
+// tracer, so that the same visit keeps the values of the headers whose values
+// become tags of the extracted span (see `set_header_tags`).
+//
+// Header names are compared case-insensitively.  If a header appears more
+// than once, then only its first occurrence is used.
+
+#include <datadog/dict_reader.h>
+#include <datadog/optional.h>
+#include <datadog/string_view.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class HeaderTags;
+class Span;
+
+class PropagationHeaders : public DictReader {
+ public:
+  // A set of headers, where bit `i` stands for `names[i]`.
+  using Set = std::uint16_t;
+
+  // The names of the headers, in lower case, in the order that the extractors
+  // look them up.
+  static constexpr std::size_t count = 10;
+  static const std::array<StringView, count> names;
+
+  // Create a reader over the propagation headers of the specified
+  // `underlying` reader.  Optionally specify `header_tags`, the headers whose
+  // values `set_header_tags` sets as tags.  The behavior is undefined if the
+  // values of `underlying` are modified or destroyed while this reader is in
+  // use, or if `header_tags` is destroyed.
+  explicit PropagationHeaders(const DictReader& underlying,
+                              const HeaderTags* header_tags = nullptr);
+
+  // Return the index in `names` of the specified header `name`, or return
+  // `count` if `name` is not a propagation header.
+  static std::size_t find(StringView name);
+
+  // Return the value of the specified propagation header `key`, and remember
+  // it if it has a value.  If the underlying reader was not visited, then
+  // look up the header in it the first time.  Other keys are looked up in the underlying reader.
+  Optional<StringView> lookup(StringView key) const override;
+  // Invoke the specified `visitor` once for each propagation header that has a
+  // value, and remember each.
+  void visit(const std::function<void(StringView key, StringView value)>&
+                 visitor) const override;
+
+  // Return the headers that had values when looked up or visited since this
+  // reader was created or since the last call to `clear_examined`.
+  Set examined() const;
+  void clear_examined();
+
+  // Return the names and values of the specified `headers`, in the order of
+  // `names`.
+  std::vector<std::pair<std::string, std::string>> entries(Set headers) const;
+  // Append to the specified `destination` the names and values of the
+  // specified `headers`, in the order of `names`, as "name: value" separated
+  // by ", ".
+  void append_entries(std::string& destination, Set headers) const;
+
+  // Set on the specified `span` the request tag of each header, among the
+  // `HeaderTags` specified at construction, that has a value.  If the
+  // underlying reader was not visited, then look up each header in it.
+  void set_header_tags(Span& span) const;
+
+ private:
+  // Return the value of the header at the specified `index` in `names`.
+  const Optional<StringView>& value(std::size_t index) const;
+
+  const DictReader& underlying_;
+  mutable std::array<Optional<StringView>, count> values_;
+  // The headers whose values are known.  All of them, if the underlying
+  // reader was visited.
+  mutable Set known_;
+  mutable Set examined_;
+  const HeaderTags* header_tags_;
+  // The index in `header_tags_->entries()` and the value of each tagged
+  // header found when the underlying reader was visited.
+  std::vector<std::pair<std::size_t, StringView>> tagged_;
+};
+
+}  // namespace tracing
+}  // namespace datadog
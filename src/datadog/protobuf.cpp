@@ -0,0 +1,119 @@
+#include "protobuf.h"
+
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+namespace datadog {
+namespace tracing {
+namespace protobuf {
+namespace {
+
+// Fixed-width values are little endian, whatever the architecture.
+template <typename Integer>
+void write_little_endian(std::string& destination, Integer value) {
+  char bytes[sizeof value];
+  for (std::size_t i = 0; i < sizeof value; ++i) {
+    bytes[i] = char((value >> (CHAR_BIT * i)) & 0xFF);
+  }
+  destination.append(bytes, sizeof bytes);
+}
+
+// Write the variable-length encoding of the specified `value` at the
+// specified `cursor`, and return the position after it.
+char* write_varint(char* cursor, std::uint64_t value) {
+  // Seven bits per byte, least significant first, with the high bit set on
+  // each byte but the last.
+  while (value >= 0x80) {
+    *cursor++ = char((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  *cursor++ = char(value);
+  return cursor;
+}
+
+}  // namespace
+
+std::size_t varint_size(std::uint64_t value) {
+  std::size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+std::size_t length_delimited_size(std::uint32_t field, std::size_t size) {
+  return varint_size(std::uint64_t(field) << 3) + varint_size(size) + size;
+}
+
+void pack_varint(std::string& destination, std::uint64_t value) {
+  char buffer[10];
+  destination.append(buffer, write_varint(buffer, value) - buffer);
+}
+
+void pack_key(std::string& destination, std::uint32_t field, WireType type) {
+  pack_varint(destination,
+              (std::uint64_t(field) << 3) | static_cast<std::uint32_t>(type));
+}
+
+void pack_uint64(std::string& destination, std::uint32_t field,
+                 std::uint64_t value) {
+  pack_key(destination, field, WireType::VARINT);
+  pack_varint(destination, value);
+}
+
+void pack_fixed32(std::string& destination, std::uint32_t field,
+                  std::uint32_t value) {
+  pack_key(destination, field, WireType::FIXED32);
+  write_little_endian(destination, value);
+}
+
+void pack_fixed64(std::string& destination, std::uint32_t field,
+                  std::uint64_t value) {
+  pack_key(destination, field, WireType::FIXED64);
+  write_little_endian(destination, value);
+}
+
+void pack_double(std::string& destination, std::uint32_t field, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  pack_fixed64(destination, field, bits);
+}
+
+void pack_string(std::string& destination, std::uint32_t field,
+                 StringView value) {
+  pack_message_header(destination, field, value.size());
+  destination.append(value.data(), value.size());
+}
+
+void pack_message_header(std::string& destination, std::uint32_t field,
+                         std::size_t size) {
+  pack_key(destination, field, WireType::LENGTH_DELIMITED);
+  pack_varint(destination, size);
+}
+
+std::size_t begin_message(std::string& destination, std::uint32_t field) {
+  pack_key(destination, field, WireType::LENGTH_DELIMITED);
+  const std::size_t length_position = destination.size();
+  destination.append(max_length_size, '\0');
+  return length_position;
+}
+
+void end_message(std::string& destination, std::size_t length_position) {
+  const std::size_t contents = length_position + max_length_size;
+  assert(contents <= destination.size());
+  const std::size_t size = destination.size() - contents;
+  assert(size <= 0xFFFFFFFF);
+  char* const begin = &destination[length_position];
+  const std::size_t width = write_varint(begin, size) - begin;
+  // Most messages are small, so that their length is one byte and the gap is
+  // four.
+  if (width < max_length_size) {
+    destination.erase(length_position + width, max_length_size - width);
+  }
+}
+
+}  // namespace protobuf
+}  // namespace tracing
+}  // namespace datadog
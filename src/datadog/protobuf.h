@@ -0,0 +1,96 @@
+#pragma once
+
+// This component provides encoding routines for the [Protocol Buffers][1] wire
+// format, as needed by `OtlpExporter` to produce OTLP trace requests, and by
+// `DatadogIntake` to produce agentless trace payloads, without depending on a
+// Protocol Buffers library.
+//
+// Each function is in `namespace protobuf` and appends an encoded field to a
+// `std::string`.  For example, `protobuf::pack_string(destination, 5, "GET")`
+// encodes the string "GET" as field number 5 of a message and appends the
+// result to `destination`.  A message is the concatenation of its encoded
+// fields.
+//
+// A nested message is encoded as a length-delimited field, whose length
+// precedes its contents.  When the size of the contents is known in advance,
+// as for an encoded buffer or a small message of strings, use
+// `pack_message_header` followed by the contents.  Otherwise, use
+// `begin_message` and `end_message` around the contents: `begin_message`
+// reserves room for the widest length, and `end_message` writes the length
+// and then closes the gap left by a narrower one, which moves the contents
+// once.
+//
+// Only encoding is provided, and only for the types required by
+// `OtlpExporter` and `DatadogIntake`.
+//
+// [1]: https://protobuf.dev/programming-guides/encoding/
+
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+namespace protobuf {
+
+// Each field is prefixed by its number and by one of these, which determines
+// how the rest of the field is encoded.
+enum class WireType : std::uint32_t {
+  VARINT = 0,
+  FIXED64 = 1,
+  LENGTH_DELIMITED = 2,
+  FIXED32 = 5,
+};
+
+// The largest encoding of a message's length, which must fit in 32 bits.
+constexpr std::size_t max_length_size = 5;
+
+// Return the number of bytes in the variable-length encoding of the specified
+// `value`.
+std::size_t varint_size(std::uint64_t value);
+
+// Return the number of bytes in the encoding of a length-delimited field
+// having the specified `field` number and the specified `size` of contents.
+std::size_t length_delimited_size(std::uint32_t field, std::size_t size);
+
+void pack_varint(std::string& destination, std::uint64_t value);
+
+void pack_key(std::string& destination, std::uint32_t field, WireType type);
+
+void pack_uint64(std::string& destination, std::uint32_t field,
+                 std::uint64_t value);
+
+void pack_fixed32(std::string& destination, std::uint32_t field,
+                  std::uint32_t value);
+
+void pack_fixed64(std::string& destination, std::uint32_t field,
+                  std::uint64_t value);
+
+void pack_double(std::string& destination, std::uint32_t field, double value);
+
+// Strings and binary data have the same encoding.
+void pack_string(std::string& destination, std::uint32_t field,
+                 StringView value);
+
+// Append the key and length of a nested message having the specified `field`
+// number and the specified `size`.  The caller then appends exactly `size`
+// bytes of contents.
+void pack_message_header(std::string& destination, std::uint32_t field,
+                         std::size_t size);
+
+// Append the key of a nested message having the specified `field` number,
+// followed by room for its length, and return the position of that room.  The
+// caller then appends the contents of the message, and passes the returned
+// position to `end_message`.
+std::size_t begin_message(std::string& destination, std::uint32_t field);
+
+// Write the length of the message begun by `begin_message` at the specified
+// `length_position` of the specified `destination`, which ends with the
+// message's contents.
+void end_message(std::string& destination, std::size_t length_position);
+
+}  // namespace protobuf
+}  // namespace tracing
+}  // namespace datadog
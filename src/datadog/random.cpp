@@ -12,26 +12,59 @@ namespace {
 
 extern "C" void on_fork();
 
+// `Uint64Generator` is the xoshiro256** generator of Blackman and Vigna
+// (https://prng.di.unimi.it/).  It's much faster than `std::mt19937_64`, and
+// its state is 32 bytes rather than 2.5 KB, which matters for applications
+// that have a thread for each connection.  It's not cryptographically secure,
+// but neither were the IDs generated before.
 class Uint64Generator {
-  std::mt19937_64 generator_;
-  std::uniform_int_distribution<std::uint64_t> distribution_;
+  std::uint64_t state_[4];
+
+  static std::uint64_t rotate_left(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
 
  public:
   Uint64Generator() {
     seed_with_random();
     // If a process links to this library and then calls `fork`, the
-    // `generator_` in the parent and child processes will produce the exact
+    // generator in the parent and child processes will produce the exact
     // same sequence of values, which is bad.
     // A subsequent call to `exec` would remedy this, but nginx in particular
     // does not call `exec` after forking its worker processes.
-    // So, we use `at_fork_in_child` to re-seed `generator_` in the child
-    // process after `fork`.
-    (void)at_fork_in_child(&on_fork);
+    // So, we use `at_fork_in_child` to re-seed the generator in the child
+    // process after `fork`.  The only thread in the child is the one that
+    // called `fork`, so only its generator needs to be re-seeded.
+    static const bool registered = (at_fork_in_child(&on_fork), true);
+    (void)registered;
   }
 
-  std::uint64_t operator()() { return distribution_(generator_); }
+  std::uint64_t operator()() {
+    const std::uint64_t result = rotate_left(state_[1] * 5, 7) * 9;
+    const std::uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = rotate_left(state_[3], 45);
+    return result;
+  }
 
-  void seed_with_random() { generator_.seed(std::random_device{}()); }
+  void seed_with_random() {
+    std::random_device device;
+    // Expand 64 random bits into the 256 bits of state using SplitMix64, as
+    // recommended by the authors of xoshiro256**.  SplitMix64 never produces
+    // an all-zero state.
+    std::uint64_t seed = (std::uint64_t(device()) << 32) | device();
+    for (auto& word : state_) {
+      seed += 0x9e3779b97f4a7c15;
+      std::uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      word = z ^ (z >> 31);
+    }
+  }
 };
 
 thread_local Uint64Generator thread_local_generator;
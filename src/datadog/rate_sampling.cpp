@@ -0,0 +1,34 @@
+#include <datadog/rate_sampling.h>
+
+#include "sampling_util.h"
+
+namespace datadog {
+namespace tracing {
+
+std::size_t keep_at_rate(const std::uint64_t* trace_ids_low, std::size_t count,
+                         Rate rate, bool* keep) {
+  const std::uint64_t threshold = max_id_from_rate(rate);
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const bool keep_trace = knuth_hash(trace_ids_low[i]) <= threshold;
+    keep[i] = keep_trace;
+    kept += keep_trace;
+  }
+  return kept;
+}
+
+std::size_t keep_at_rate(const TraceID* trace_ids, std::size_t count,
+                         Rate rate, bool* keep) {
+  // Only the lower 64 bits of a trace ID are sampled.
+  const std::uint64_t threshold = max_id_from_rate(rate);
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const bool keep_trace = knuth_hash(trace_ids[i].low) <= threshold;
+    keep[i] = keep_trace;
+    kept += keep_trace;
+  }
+  return kept;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,171 @@
+#include "recording_collector.h"
+
+#include <datadog/capture_file.h>
+#include <datadog/logger.h>
+#include <datadog/telemetry/telemetry.h>
+
+#include <cassert>
+#include <chrono>
+#include <utility>
+
+#include "json.hpp"
+#include "msgpack.h"
+#include "overhead_governor.h"
+#include "span_data.h"
+#include "telemetry_metrics.h"
+
+namespace datadog {
+namespace tracing {
+
+RecordingCollector::RecordingCollector(
+    const FinalizedRecordingCollectorConfig& config,
+    const std::shared_ptr<Logger>& logger)
+    : clock_(config.clock),
+      logger_(logger),
+      capture_path_(config.capture_path),
+      capture_file_(config.capture_file),
+      start_(clock_().tick),
+      buffered_traces_(0),
+      flush_threshold_bytes_(config.flush_threshold_bytes),
+      event_scheduler_(config.event_scheduler),
+      flush_interval_(config.flush_interval),
+      dropped_trace_chunks_(0),
+      capture_full_(false) {
+  assert(logger_);
+  assert(capture_file_);
+
+  tasks_.emplace_back(event_scheduler_->schedule_recurring_event(
+      flush_interval_, [this]() { flush(); }));
+}
+
+RecordingCollector::~RecordingCollector() {
+  for (auto&& cancel_task : tasks_) {
+    cancel_task();
+  }
+  tasks_.clear();
+  // Nothing is sent, so the buffered chunks are recorded without a deadline.
+  flush();
+}
+
+Expected<void> RecordingCollector::send(
+    std::vector<std::unique_ptr<SpanData>>&& spans,
+    const std::shared_ptr<TraceSampler>& response_handler) {
+  TraceChunk chunk;
+  chunk.spans = std::move(spans);
+  return send_chunk(std::move(chunk), response_handler);
+}
+
+Expected<void> RecordingCollector::send_chunk(
+    TraceChunk&& chunk, const std::shared_ptr<TraceSampler>&) {
+  // The chunk is encoded outside of the lock, into a buffer that the sending
+  // thread reuses, as `DatadogAgent` does when it encodes chunks on send.
+  thread_local std::string encoded;
+  encoded.clear();
+  if (!chunk.encoded.empty()) {
+    // The chunk's producer already encoded it.
+    encoded.swap(chunk.encoded);
+  } else {
+    auto beg = std::chrono::steady_clock::now();
+    auto result = msgpack_encode(encoded, chunk.spans);
+    auto end = std::chrono::steady_clock::now();
+    if (auto* error = result.if_error()) {
+      return std::move(*error);
+    }
+
+    telemetry::distribution::add(
+        metrics::tracer::trace_chunk_serialization_duration,
+        std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+            .count());
+    OverheadGovernor::add_cost(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg));
+  }
+  chunk.spans.clear();
+
+  std::string body;
+  std::size_t traces;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_ += encoded;
+    ++buffered_traces_;
+    if (buffer_.size() < flush_threshold_bytes_) {
+      return nullopt;
+    }
+    body.swap(buffer_);
+    traces = buffered_traces_;
+    buffered_traces_ = 0;
+  }
+
+  // The batch is large enough to record now, rather than wait for the next
+  // flush interval.
+  record(body, traces);
+  return nullopt;
+}
+
+void RecordingCollector::flush() {
+  std::string body;
+  std::size_t traces;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body.swap(buffer_);
+    traces = buffered_traces_;
+    buffered_traces_ = 0;
+  }
+
+  if (traces != 0) {
+    record(body, traces);
+  }
+}
+
+void RecordingCollector::record(const std::string& body, std::size_t traces) {
+  // The payload is an array of the encoded chunks.  Its header is written
+  // separately, so that the chunks are copied only into the capture file.
+  std::string header;
+  msgpack::pack_array(header, traces);
+  telemetry::distribution::add(
+      metrics::tracer::trace_chunk_serialized_bytes,
+      static_cast<uint64_t>(header.size() + body.size()));
+
+  const auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock_().tick - start_);
+  if (capture_file_->append(offset, traces, {header, body})) {
+    return;
+  }
+
+  dropped_trace_chunks_.fetch_add(traces, std::memory_order_relaxed);
+  telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                {"reason:overfull_buffer"});
+  if (!capture_full_.exchange(true)) {
+    logger_->log_error([&](auto& stream) {
+      stream << "RecordingCollector: The capture file " << capture_path_
+             << " is full.  Later payloads will be dropped.";
+    });
+  }
+}
+
+void RecordingCollector::add_runtime_stats(RuntimeStats& stats) const {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.buffered_trace_chunks += buffered_traces_;
+    stats.buffered_bytes += buffer_.size();
+  }
+  stats.dropped_trace_chunks +=
+      dropped_trace_chunks_.load(std::memory_order_relaxed);
+}
+
+std::string RecordingCollector::config() const {
+  // clang-format off
+  return nlohmann::json::object({
+    {"type", "datadog::tracing::RecordingCollector"},
+    {"config", nlohmann::json::object({
+      {"capture_path", capture_path_},
+      {"capture_bytes", capture_file_->capacity()},
+      {"flush_interval_milliseconds", std::chrono::duration_cast<std::chrono::milliseconds>(flush_interval_).count() },
+      {"flush_threshold_bytes", flush_threshold_bytes_},
+      {"event_scheduler", nlohmann::json::parse(event_scheduler_->config())},
+    })},
+  }).dump();
+  // clang-format on
+}
+
+}  // namespace tracing
+}  // namespace datadog
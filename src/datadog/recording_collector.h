@@ -0,0 +1,96 @@
+#pragma once
+
+// This component provides a `class`, `RecordingCollector`, that implements the
+// `Collector` interface by appending trace payloads to a capture file (see
+// `capture_file.h`), rather than sending them to a Datadog Agent.
+//
+// `RecordingCollector` buffers trace chunks as a `DatadogAgent` does, encoding
+// each chunk to MessagePack when it is sent, and flushes them at the same
+// interval and size threshold.  Each flush appends one v0.4 traces payload to
+// the capture file, along with the number of traces in it and when it was
+// flushed, so that the recorded payloads are those that a `DatadogAgent` would
+// have sent, at the times it would have sent them.  The replay tool in
+// `test/replay/` sends them to a real agent.
+//
+// Nothing is received in response, so the trace sampler is not adjusted, and
+// Remote Configuration is not polled.  Payloads that do not fit in the capture
+// file are dropped, and counted as such.
+//
+// `RecordingCollector` is configured by `RecordingCollectorConfig`.  See
+// `recording_collector_config.h`.
+
+#include <datadog/clock.h>
+#include <datadog/collector.h>
+#include <datadog/event_scheduler.h>
+#include <datadog/recording_collector_config.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class CaptureFile;
+class Logger;
+struct SpanData;
+class TraceSampler;
+
+class RecordingCollector : public Collector {
+  mutable std::mutex mutex_;
+  Clock clock_;
+  std::shared_ptr<Logger> logger_;
+  const std::string capture_path_;
+  std::shared_ptr<CaptureFile> capture_file_;
+  // Recorded payloads are timed relative to when the collector was created.
+  const std::chrono::steady_clock::time_point start_;
+  // The encoded trace chunks not yet recorded, and how many there are.
+  // Guarded by `mutex_`.
+  std::string buffer_;
+  std::size_t buffered_traces_;
+  const std::size_t flush_threshold_bytes_;
+  std::shared_ptr<EventScheduler> event_scheduler_;
+  std::vector<EventScheduler::Cancel> tasks_;
+  const std::chrono::steady_clock::duration flush_interval_;
+  // The number of trace chunks dropped because their payload did not fit in
+  // the capture file.
+  std::atomic<std::uint64_t> dropped_trace_chunks_;
+  // Whether the capture file was found full, so that it is logged only once.
+  std::atomic<bool> capture_full_;
+
+  // Record the buffered trace chunks as one payload.
+  void flush();
+  // Append to the capture file the payload of the specified `traces` encoded
+  // trace chunks in the specified `body`, timed by the current time.
+  void record(const std::string& body, std::size_t traces);
+
+ public:
+  RecordingCollector(const FinalizedRecordingCollectorConfig&,
+                     const std::shared_ptr<Logger>&);
+  ~RecordingCollector();
+
+  RecordingCollector(const RecordingCollector&) = delete;
+
+  Expected<void> send(
+      std::vector<std::unique_ptr<SpanData>>&& spans,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+  Expected<void> send_chunk(
+      TraceChunk&& chunk,
+      const std::shared_ptr<TraceSampler>& response_handler) override;
+
+  std::string config() const override;
+
+  bool accepts_shared_tags() const override { return true; }
+
+  // Add the buffered trace chunks, and those dropped because the capture file
+  // was full, to the specified `stats`.
+  void add_runtime_stats(RuntimeStats& stats) const override;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,61 @@
+#include <datadog/capture_file.h>
+#include <datadog/recording_collector_config.h>
+
+#include <chrono>
+
+#include "threaded_event_scheduler.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<FinalizedRecordingCollectorConfig> finalize_config(
+    const RecordingCollectorConfig& user_config, const Clock& clock) {
+  FinalizedRecordingCollectorConfig result;
+
+  result.clock = clock;
+
+  if (!user_config.capture_path || user_config.capture_path->empty()) {
+    return Error{Error::RECORDING_COLLECTOR_MISSING_CAPTURE_PATH,
+                 "RecordingCollector: A capture path is required."};
+  }
+  result.capture_path = *user_config.capture_path;
+
+  const int flush_interval_milliseconds =
+      user_config.flush_interval_milliseconds.value_or(2000);
+  if (flush_interval_milliseconds <= 0) {
+    return Error{Error::RECORDING_COLLECTOR_INVALID_INTERVAL,
+                 "RecordingCollector: The flush interval must be a positive "
+                 "number of milliseconds."};
+  }
+  result.flush_interval = std::chrono::milliseconds(flush_interval_milliseconds);
+
+  result.flush_threshold_bytes =
+      user_config.flush_threshold_bytes.value_or(8 * 1024 * 1024);
+  if (result.flush_threshold_bytes == 0) {
+    return Error{Error::RECORDING_COLLECTOR_INVALID_FLUSH_THRESHOLD,
+                 "RecordingCollector: The flush threshold must be a positive "
+                 "number of bytes."};
+  }
+
+  result.default_event_scheduler = !user_config.event_scheduler;
+  if (!user_config.event_scheduler) {
+    result.event_scheduler = ThreadedEventScheduler::shared_instance();
+  } else {
+    result.event_scheduler = user_config.event_scheduler;
+  }
+
+  // The capture file is created last, so that an invalid configuration does
+  // not empty an existing capture.
+  result.capture_bytes = user_config.capture_bytes.value_or(256 * 1024 * 1024);
+  auto capture_file =
+      CaptureFile::create(result.capture_path, result.capture_bytes);
+  if (auto* error = capture_file.if_error()) {
+    return error->with_prefix("RecordingCollector: ");
+  }
+  result.capture_file = std::move(*capture_file);
+
+  return result;
+}
+
+}  // namespace tracing
+}  // namespace datadog
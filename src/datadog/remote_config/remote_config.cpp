@@ -6,11 +6,14 @@
 
 #include <cassert>
 #include <regex>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include "base64.h"
 #include "json.hpp"
 #include "random.h"
+#include "timeline_events.h"
 
 using namespace datadog::tracing;
 using namespace nlohmann::literals;
@@ -57,6 +60,33 @@ Optional<ConfigKeyMetadata> parse_config_path(StringView config_path) {
   return {{parse_product(product_sv), config_id_sv}};
 }
 
+// Return the FNV-1a hash of the parts of the specified remote configuration
+// `response` that determine how it is processed: the encoded targets document,
+// which includes the hash of every configuration file, and the paths of the
+// configurations that apply to this client.
+std::uint64_t response_digest(StringView targets,
+                              const nlohmann::json* client_configs) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto mix = [&](StringView text) {
+    for (const char ch : text) {
+      hash ^= static_cast<unsigned char>(ch);
+      hash *= 1099511628211ULL;
+    }
+    // Separate consecutive texts, so that ("ab", "c") and ("a", "bc") usually
+    // have different hashes.
+    hash ^= 0xff;
+    hash *= 1099511628211ULL;
+  };
+
+  mix(targets);
+  if (client_configs) {
+    for (const auto& config_path : *client_configs) {
+      mix(config_path.get<StringView>());
+    }
+  }
+  return hash;
+}
+
 }  // namespace
 
 Manager::Manager(const TracerSignature& tracer_signature,
@@ -102,6 +132,15 @@ bool Manager::is_new_config(StringView config_path,
 void Manager::error(std::string message) {
   logger_->log_error(Error{Error::REMOTE_CONFIGURATION_INVALID_INPUT, message});
   state_.error_message = std::move(message);
+  serialized_request_payload_ = nullptr;
+}
+
+std::shared_ptr<const std::string> Manager::serialized_request_payload() {
+  if (!serialized_request_payload_) {
+    serialized_request_payload_ =
+        std::make_shared<const std::string>(make_request_payload().dump());
+  }
+  return serialized_request_payload_;
 }
 
 nlohmann::json Manager::make_request_payload() {
@@ -153,7 +192,7 @@ nlohmann::json Manager::make_request_payload() {
 
       nlohmann::json cached_file = {
           {"path", config.path},
-          {"length", config.content.size()},
+          {"length", config.length},
           {"hashes", {{{"algorithm", "sha256"}, {"hash", config.hash}}}}};
 
       cached_target_files.emplace_back(std::move(cached_file));
@@ -166,15 +205,29 @@ nlohmann::json Manager::make_request_payload() {
   return j;
 }
 
-void Manager::process_response(const nlohmann::json& json) {
-  state_.error_message = nullopt;
-
+bool Manager::process_response(const nlohmann::json& json) {
+  DD_TIMELINE_SCOPE("Remote Configuration response");
   try {
-    const auto targets = nlohmann::json::parse(
-        base64_decode(json.at("targets").get<StringView>()));
-
+    const auto encoded_targets = json.at("targets").get<StringView>();
     const auto client_configs_it = json.find("client_configs");
 
+    // The Datadog Agent responds with the same targets every poll until a
+    // configuration changes.  If this response is the same as the last one
+    // that was processed without error, then there is nothing to do.
+    const auto digest = response_digest(
+        encoded_targets,
+        client_configs_it == json.cend() ? nullptr : &*client_configs_it);
+    if (processed_response_digest_ == digest) {
+      return false;
+    }
+
+    state_.error_message = nullopt;
+    processed_response_digest_ = nullopt;
+    serialized_request_payload_ = nullptr;
+
+    base64_decode(decoded_targets_, encoded_targets);
+    const auto targets = nlohmann::json::parse(decoded_targets_);
+
     // `client_configs` is absent => remove previously applied configuration if
     // any applied.
     if (client_configs_it == json.cend()) {
@@ -197,12 +250,18 @@ void Manager::process_response(const nlohmann::json& json) {
           targets.at("/signed/version"_json_pointer).get<std::uint64_t>();
       state_.opaque_backend_state =
           targets.at("/signed/custom/opaque_backend_state"_json_pointer);
-      return;
+      processed_response_digest_ = digest;
+      return true;
     }
 
     // Keep track of config path received to know which ones to revert.
     std::unordered_set<std::string> visited_config;
 
+    const auto& targets_metadata = targets.at("/signed/targets"_json_pointer);
+    // `target_files` contains only the files that are not already cached by
+    // this client, so it's indexed by path only once a configuration is new.
+    std::unordered_map<StringView, const nlohmann::json*> target_files;
+
     for (const auto& client_config : *client_configs_it) {
       auto config_path = client_config.get<StringView>();
       visited_config.emplace(config_path);
@@ -213,42 +272,42 @@ void Manager::process_response(const nlohmann::json& json) {
         reason += " is an invalid configuration path";
 
         error(reason);
-        return;
+        return true;
       }
 
       const auto product = config_key_metadata->product;
 
-      const auto& config_metadata =
-          targets.at("/signed/targets"_json_pointer).at(config_path);
+      const auto& config_metadata = targets_metadata.at(config_path);
 
       if (!is_new_config(config_path, config_metadata)) {
         continue;
       }
 
-      const auto& target_files = json.at("/target_files"_json_pointer);
-      auto target_it = std::find_if(
-          target_files.cbegin(), target_files.cend(),
-          [&config_path](const nlohmann::json& j) {
-            return j.at("/path"_json_pointer).get<StringView>() == config_path;
-          });
+      if (target_files.empty()) {
+        for (const auto& target_file : json.at("/target_files"_json_pointer)) {
+          target_files.emplace(
+              target_file.at("/path"_json_pointer).get<StringView>(),
+              &target_file);
+        }
+      }
 
+      const auto target_it = target_files.find(config_path);
       if (target_it == target_files.cend()) {
         std::string reason{"Target \""};
         append(reason, config_path);
         reason += "\" missing from the list of targets";
 
         error(reason);
-        return;
+        return true;
       }
 
-      auto raw_data = target_it->at("raw").get<StringView>();
-      auto decoded_config = base64_decode(raw_data);
+      auto raw_data = target_it->second->at("raw").get<StringView>();
 
       Configuration new_config;
       new_config.id = std::string{config_key_metadata->config_id};
       new_config.path = std::string{config_path};
       new_config.hash = config_metadata.at("/hashes/sha256"_json_pointer);
-      new_config.content = std::move(decoded_config);
+      base64_decode(new_config.content, raw_data);
       new_config.version = config_metadata.at("/custom/v"_json_pointer);
       new_config.product = product;
 
@@ -265,7 +324,11 @@ void Manager::process_response(const nlohmann::json& json) {
         }
       }
 
-      applied_config_[std::string{config_path}] = new_config;
+      // Keep only what is reported in later requests.  Reverting a
+      // configuration does not need its content.
+      new_config.length = new_config.content.size();
+      std::string().swap(new_config.content);
+      applied_config_[std::string{config_path}] = std::move(new_config);
     }
 
     // Revert applied configurations not present
@@ -288,6 +351,7 @@ void Manager::process_response(const nlohmann::json& json) {
         targets.at("/signed/version"_json_pointer).get<std::uint64_t>();
     state_.opaque_backend_state =
         targets.at("/signed/custom/opaque_backend_state"_json_pointer);
+    processed_response_digest_ = digest;
   } catch (const nlohmann::json::exception& json_exception) {
     std::string reason = "Failed to parse the response: ";
     reason += json_exception.what();
@@ -296,6 +360,8 @@ void Manager::process_response(const nlohmann::json& json) {
   } catch (const std::exception& e) {
     error(e.what());
   }
+
+  return true;
 }
 
 }  // namespace remote_config
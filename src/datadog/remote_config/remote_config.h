@@ -40,8 +40,10 @@ class Manager {
     tracing::Optional<std::string> error_message;
   };
 
-  // Holds information about a specific configuration update,
-  // including its identifier, hash value, version number and the content.
+  // Holds information about a specific configuration update, including its
+  // identifier, hash value, version number and length.  The content is given
+  // to the listeners and then released, since only its length is reported
+  // afterward.
   struct Configuration final : public Listener::Configuration {
     enum State : char {
       unacknowledged = 1,
@@ -50,6 +52,7 @@ class Manager {
     } state = State::unacknowledged;
 
     std::string hash;
+    std::size_t length = 0;
     tracing::Optional<std::string> error_message;
   };
 
@@ -64,6 +67,15 @@ class Manager {
 
   State state_;
   std::unordered_map<std::string, Configuration> applied_config_;
+  // A hash of the last response that was processed without error, so that an
+  // unchanged response need not be decoded again.
+  tracing::Optional<std::uint64_t> processed_response_digest_;
+  // The serialized request payload, or null if `state_` or `applied_config_`
+  // changed since it was last serialized.
+  std::shared_ptr<const std::string> serialized_request_payload_;
+  // The decoded targets document of the last response processed, whose
+  // storage is reused by the next.
+  std::string decoded_targets_;
 
  public:
   Manager(const tracing::TracerSignature& tracer_signature,
@@ -74,9 +86,16 @@ class Manager {
   // configuration request.
   nlohmann::json make_request_payload();
 
+  // Return the serialization of `make_request_payload()`.  The serialization
+  // is reused until a response changes the state of this object, so that
+  // polling while nothing changes does not rebuild the payload.
+  std::shared_ptr<const std::string> serialized_request_payload();
+
   // Handles the response received from a remote source and udates the internal
-  // state accordingly.
-  void process_response(const nlohmann::json& json);
+  // state accordingly.  A response that is identical to the previous one is
+  // ignored, unless processing the previous one failed.  Return false if the
+  // response was ignored, or true otherwise.
+  bool process_response(const nlohmann::json& json);
 
  private:
   // Tell if a `config_path` is a new configuration update.
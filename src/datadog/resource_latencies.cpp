@@ -0,0 +1,133 @@
+#include "resource_latencies.h"
+
+#include <datadog/runtime_stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string_view>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The ratio of the bounds of each bucket of a `Sketch`.
+const double sketch_gamma =
+    (1 + ResourceLatencies::Sketch::relative_accuracy) /
+    (1 - ResourceLatencies::Sketch::relative_accuracy);
+const double log_gamma = std::log(sketch_gamma);
+
+std::size_t hash(StringView text) {
+  return std::hash<std::string_view>{}(
+      std::string_view(text.data(), text.size()));
+}
+
+}  // namespace
+
+constexpr std::size_t ResourceLatencies::max_resources;
+constexpr std::size_t ResourceLatencies::Sketch::num_buckets;
+constexpr std::uint32_t ResourceLatencies::Sketch::max_count;
+
+void ResourceLatencies::Sketch::add(std::uint64_t nanoseconds) {
+  // Bucket `i`, other than the first and the last, contains the durations in
+  // [min * gamma^(i-1), min * gamma^i).
+  std::size_t index = 0;
+  if (nanoseconds >= min_nanoseconds) {
+    const double exponent =
+        std::log(double(nanoseconds) / min_nanoseconds) / log_gamma;
+    index = std::min(num_buckets - 1, std::size_t(exponent) + 1);
+  }
+  ++buckets_[index];
+
+  if (++count_ < max_count) {
+    return;
+  }
+  // Rounding up keeps rare durations, such as the slowest, in the sketch.
+  count_ = 0;
+  for (auto& bucket : buckets_) {
+    bucket = (bucket + 1) / 2;
+    count_ += bucket;
+  }
+}
+
+std::uint64_t ResourceLatencies::Sketch::quantile(double quantile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // The rank, from one, of the duration at `quantile`.
+  const double rank = std::ceil(quantile * count_);
+  const std::uint32_t target =
+      rank < 1 ? 1 : std::min(count_, std::uint32_t(rank));
+  std::uint32_t seen = 0;
+  std::size_t index = 0;
+  for (; index < num_buckets - 1; ++index) {
+    seen += buckets_[index];
+    if (seen >= target) {
+      break;
+    }
+  }
+  if (index == 0) {
+    return 0;
+  }
+  return std::uint64_t(min_nanoseconds * std::pow(sketch_gamma, index - 1));
+}
+
+std::size_t ResourceLatencies::KeyHash::operator()(const Key& key) const {
+  return hash(key.service) * 31 + hash(key.resource);
+}
+
+void ResourceLatencies::add(StringView service, StringView resource,
+                            Duration duration) {
+  const auto nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(Key{service, resource});
+  if (found != index_.end()) {
+    resources_.splice(resources_.begin(), resources_, found->second);
+  } else if (resources_.size() < max_resources) {
+    resources_.push_front(
+        Resource{std::string(service), std::string(resource), Sketch{}});
+    const Resource& added = resources_.front();
+    index_.emplace(Key{added.service, added.resource}, resources_.begin());
+  } else {
+    // Reuse the least recently added to resource for this one.
+    auto oldest = std::prev(resources_.end());
+    index_.erase(Key{oldest->service, oldest->resource});
+    oldest->service.assign(service.data(), service.size());
+    oldest->resource.assign(resource.data(), resource.size());
+    oldest->sketch = Sketch{};
+    resources_.splice(resources_.begin(), resources_, oldest);
+    index_.emplace(Key{oldest->service, oldest->resource}, oldest);
+  }
+  resources_.front().sketch.add(nanoseconds < 0 ? 0 : nanoseconds);
+}
+
+Optional<std::uint64_t> ResourceLatencies::quantile(StringView service,
+                                                    StringView resource,
+                                                    double quantile) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto found = index_.find(Key{service, resource});
+  if (found == index_.end()) {
+    return nullopt;
+  }
+  return found->second->sketch.quantile(quantile);
+}
+
+void ResourceLatencies::add_runtime_stats(RuntimeStats& stats) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.resource_latencies.reserve(stats.resource_latencies.size() +
+                                   resources_.size());
+  for (const Resource& entry : resources_) {
+    auto& latency = stats.resource_latencies.emplace_back();
+    latency.service = entry.service;
+    latency.resource = entry.resource;
+    latency.count = entry.sketch.count();
+    latency.p50_nanoseconds = entry.sketch.quantile(0.50);
+    latency.p90_nanoseconds = entry.sketch.quantile(0.90);
+    latency.p99_nanoseconds = entry.sketch.quantile(0.99);
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,115 @@
+#pragma once
+
+// This component provides a class, `ResourceLatencies`, that maintains the
+// distribution of the durations of local root spans for each combination of
+// service and resource, so that quantiles of the recent durations of a
+// resource, such as its 99th percentile, are available at any time.
+//
+// `TraceSegment` adds the duration of its local root when the local root
+// finishes.  The tail sampler (see `tail_sampler.h`) keeps the traces whose
+// local root lasted at least as long as a percentile of its resource's recent
+// durations, and `Tracer::runtime_stats` reports quantiles for each resource.
+//
+// Adding a duration takes constant time, and the memory used is bounded: the
+// distribution of each resource is a `Sketch` of fixed size, and at most
+// `max_resources` resources are tracked.  When another resource is added, the
+// resource least recently added to is forgotten.  A sketch's counts are halved
+// whenever its count reaches `Sketch::max_count`, so that its quantiles follow
+// recent durations more than older ones.
+
+#include <datadog/clock.h>
+#include <datadog/optional.h>
+#include <datadog/string_view.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace datadog {
+namespace tracing {
+
+struct RuntimeStats;
+
+class ResourceLatencies {
+ public:
+  // The number of combinations of service and resource tracked.
+  static constexpr std::size_t max_resources = 256;
+
+  // `Sketch` counts durations in a fixed number of buckets whose bounds grow
+  // geometrically from `min_nanoseconds`, so that every duration in a bucket
+  // is within `relative_accuracy` of the bucket's midpoint.  The first bucket
+  // counts all shorter durations, and the last bucket all longer ones, which
+  // for the buckets below is upwards of a day.
+  class Sketch {
+   public:
+    static constexpr std::size_t num_buckets = 256;
+    static constexpr double relative_accuracy = 0.05;
+    static constexpr std::uint64_t min_nanoseconds = 1000;
+    static constexpr std::uint32_t max_count = 10000;
+
+    void add(std::uint64_t nanoseconds);
+    // Return the number of durations that the sketch accounts for, which is
+    // fewer than were added once the counts have been halved.
+    std::uint32_t count() const { return count_; }
+    // Return the lower bound, in nanoseconds, of the bucket containing the
+    // specified `quantile`, between 0 and 1, of the durations, or zero if
+    // there are none.
+    std::uint64_t quantile(double quantile) const;
+
+   private:
+    std::array<std::uint32_t, num_buckets> buckets_{};
+    std::uint32_t count_ = 0;
+  };
+
+ private:
+  struct Resource {
+    std::string service;
+    std::string resource;
+    Sketch sketch;
+  };
+
+  // A `Key` refers to the names of a `Resource` in `resources_`, or to the
+  // names looked up.
+  struct Key {
+    StringView service;
+    StringView resource;
+
+    bool operator==(const Key& other) const {
+      return service == other.service && resource == other.resource;
+    }
+  };
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  mutable std::mutex mutex_;
+  // The tracked resources, the most recently added to first.
+  std::list<Resource> resources_;
+  std::unordered_map<Key, std::list<Resource>::iterator, KeyHash> index_;
+
+ public:
+  ResourceLatencies() = default;
+  ResourceLatencies(const ResourceLatencies&) = delete;
+  ResourceLatencies& operator=(const ResourceLatencies&) = delete;
+
+  // Add the specified `duration` of a local root span having the specified
+  // `service` and `resource`.
+  void add(StringView service, StringView resource, Duration duration);
+
+  // Return the lower bound, in nanoseconds, of the bucket containing the
+  // specified `quantile`, between 0 and 1, of the recent durations of the
+  // specified `service` and `resource`, or return null if the resource is not
+  // tracked.
+  Optional<std::uint64_t> quantile(StringView service, StringView resource,
+                                   double quantile) const;
+
+  // Append the quantiles of each tracked resource to the specified `stats`.
+  void add_runtime_stats(RuntimeStats& stats) const;
+};
+
+}  // namespace tracing
+}  // namespace datadog
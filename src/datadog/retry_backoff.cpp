@@ -0,0 +1,28 @@
+#include "retry_backoff.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "random.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The backoff, before randomization, after a payload first fails to be sent.
+constexpr std::chrono::milliseconds initial_retry_backoff{1000};
+
+}  // namespace
+
+std::chrono::steady_clock::duration retry_backoff(std::size_t attempts) {
+  const auto backoff =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          initial_retry_backoff) *
+      (std::size_t(1) << std::min<std::size_t>(attempts - 1, 16));
+  const auto half = static_cast<std::uint64_t>(backoff.count() / 2);
+  return std::chrono::steady_clock::duration(half +
+                                             random_uint64() % (half + 1));
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,25 @@
+#pragma once
+
+// This component provides a function, `retry_backoff`, that determines how
+// long the collectors that send traces over HTTP (`DatadogAgent` and
+// `DatadogIntake`) wait before sending a payload again after it failed to be
+// sent.
+//
+// The backoff doubles with each attempt, starting at about one second.  It is
+// randomized, so that many processes that fail at the same time do not retry
+// at the same time.  Payloads are sent again only when trace chunks are
+// flushed, so the actual delay is rounded up to a multiple of the flush
+// interval.
+
+#include <chrono>
+#include <cstddef>
+
+namespace datadog {
+namespace tracing {
+
+// Return the delay before sending again a payload that failed to be sent the
+// specified `attempts` times.  `attempts` must be positive.
+std::chrono::steady_clock::duration retry_backoff(std::size_t attempts);
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,111 @@
+#include <datadog/profiling_context.h>
+#include <datadog/scope.h>
+#include <datadog/trace_segment.h>
+
+#include <cassert>
+
+#include "span_data.h"
+
+thread_local datadog::tracing::ProfilingContext
+    datadog_tracing_profiling_context;
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The innermost scope of this thread, or of the task that this thread is
+// running (see `Scope::exchange_current`).
+thread_local Scope* current_scope = nullptr;
+
+// Return the 64-bit FNV-1a hash of the specified `value`.
+std::uint64_t fnv1a(const std::string& value) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : value) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Return the hash of the specified `resource`.  The last interned resource
+// hashed on this thread is remembered, since interned strings are never
+// freed, and the scopes of a thread usually have the same few endpoints.
+std::uint64_t resource_hash(const InternedString& resource) {
+  thread_local const std::string* last_resource = nullptr;
+  thread_local std::uint64_t last_hash = 0;
+  if (!resource.interned()) {
+    return fnv1a(resource);
+  }
+  if (&resource.str() != last_resource) {
+    last_resource = &resource.str();
+    last_hash = fnv1a(resource);
+  }
+  return last_hash;
+}
+
+// Publish the IDs of the specified `scope`'s span, or zeros if `scope` is
+// null, to the current thread's `ProfilingContext`.
+void publish(const Scope* scope) noexcept {
+  ProfilingContext& context = datadog_tracing_profiling_context;
+  std::uint64_t trace_id_low = 0;
+  std::uint64_t trace_id_high = 0;
+  std::uint64_t span_id = 0;
+  std::uint64_t local_root_span_id = 0;
+  std::uint64_t local_root_resource_hash = 0;
+  if (scope) {
+    Span& span = scope->span();
+    const TraceID trace_id = span.trace_id();
+    trace_id_low = trace_id.low;
+    trace_id_high = trace_id.high;
+    span_id = span.id();
+    const SpanData& local_root = span.trace_segment().local_root();
+    local_root_span_id = local_root.span_id;
+    local_root_resource_hash = resource_hash(local_root.resource);
+  }
+
+  const auto relaxed = std::memory_order_relaxed;
+  const std::uint64_t sequence = context.sequence.load(relaxed);
+  context.sequence.store(sequence + 1, relaxed);
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  context.trace_id_low.store(trace_id_low, relaxed);
+  context.trace_id_high.store(trace_id_high, relaxed);
+  context.span_id.store(span_id, relaxed);
+  context.local_root_span_id.store(local_root_span_id, relaxed);
+  context.local_root_resource_hash.store(local_root_resource_hash, relaxed);
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  context.sequence.store(sequence + 2, relaxed);
+}
+
+}  // namespace
+
+Scope::Scope(Span& span) noexcept : span_(&span), parent_(current_scope) {
+  current_scope = this;
+  publish(this);
+}
+
+Scope::~Scope() {
+  assert(current_scope == this);
+  current_scope = parent_;
+  publish(parent_);
+}
+
+Span& Scope::span() const noexcept { return *span_; }
+
+Scope* Scope::parent() const noexcept { return parent_; }
+
+Scope* Scope::current() noexcept { return current_scope; }
+
+Span* Scope::active_span() noexcept {
+  Scope* const scope = current_scope;
+  return scope ? scope->span_ : nullptr;
+}
+
+Scope* Scope::exchange_current(Scope* scope) noexcept {
+  Scope* const previous = current_scope;
+  current_scope = scope;
+  publish(scope);
+  return previous;
+}
+
+}  // namespace tracing
+}  // namespace datadog
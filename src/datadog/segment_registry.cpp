@@ -0,0 +1,120 @@
+#include "segment_registry.h"
+
+#include <datadog/logger.h>
+#include <datadog/runtime_stats.h>
+#include <datadog/trace_segment.h>
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+SegmentRegistry::SegmentRegistry(const Clock& clock,
+                                 std::chrono::steady_clock::duration max_age,
+                                 std::shared_ptr<Logger> logger,
+                                 EventScheduler& event_scheduler)
+    : clock_(clock),
+      max_age_(max_age),
+      logger_(std::move(logger)),
+      oldest_(nullptr),
+      newest_(nullptr),
+      orphaned_segments_(0),
+      orphaned_bytes_(0) {
+  assert(max_age_ > std::chrono::steady_clock::duration::zero());
+  cancel_sweep_ = event_scheduler.schedule_recurring_event(
+      max_age_, [this]() { sweep(); });
+}
+
+SegmentRegistry::~SegmentRegistry() {
+  cancel_sweep_();
+  // Each segment refers to the registry through its `TracerContext`.
+  assert(!oldest_);
+}
+
+void SegmentRegistry::add(TraceSegment& segment) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  segment.registered_at_ = clock_().tick;
+  segment.registered_ = true;
+  segment.registry_older_ = newest_;
+  segment.registry_newer_ = nullptr;
+  if (newest_) {
+    newest_->registry_newer_ = &segment;
+  } else {
+    oldest_ = &segment;
+  }
+  newest_ = &segment;
+}
+
+void SegmentRegistry::remove(TraceSegment& segment) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (segment.registered_) {
+    unlink(segment);
+  }
+}
+
+void SegmentRegistry::unlink(TraceSegment& segment) {
+  if (segment.registry_older_) {
+    segment.registry_older_->registry_newer_ = segment.registry_newer_;
+  } else {
+    oldest_ = segment.registry_newer_;
+  }
+  if (segment.registry_newer_) {
+    segment.registry_newer_->registry_older_ = segment.registry_older_;
+  } else {
+    newest_ = segment.registry_older_;
+  }
+  segment.registry_older_ = segment.registry_newer_ = nullptr;
+  segment.registered_ = false;
+}
+
+void SegmentRegistry::sweep() {
+  std::vector<std::shared_ptr<TraceSegment>> expired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto cutoff = clock_().tick - max_age_;
+    while (oldest_ && oldest_->registered_at_ <= cutoff) {
+      TraceSegment& segment = *oldest_;
+      unlink(segment);
+      // A segment that is being destroyed is complete, and has no owners.
+      if (auto owner = segment.weak_from_this().lock()) {
+        expired.push_back(std::move(owner));
+      }
+    }
+  }
+
+  // The segments are flushed without `mutex_` locked, since flushing sends to
+  // the collector, and since the segments might be destroyed meanwhile.
+  std::uint64_t segments = 0;
+  std::uint64_t bytes = 0;
+  for (const auto& segment : expired) {
+    if (const auto flushed = segment->flush_orphaned()) {
+      ++segments;
+      bytes += *flushed;
+    }
+  }
+  expired.clear();
+  if (segments == 0) {
+    return;
+  }
+
+  orphaned_segments_.fetch_add(segments, std::memory_order_relaxed);
+  orphaned_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  logger_->log_error([&](std::ostream& log) {
+    log << segments
+        << " trace segment(s) still had unfinished spans after "
+        << std::chrono::duration_cast<std::chrono::seconds>(max_age_).count()
+        << " seconds, so their spans were sent and about " << bytes
+        << " bytes reclaimed.  A span might have been leaked.";
+  });
+}
+
+void SegmentRegistry::add_runtime_stats(RuntimeStats& stats) const {
+  stats.orphaned_trace_segments =
+      orphaned_segments_.load(std::memory_order_relaxed);
+  stats.orphaned_bytes = orphaned_bytes_.load(std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,90 @@
+#pragma once
+
+// This component provides a class, `SegmentRegistry`, that keeps track of the
+// live trace segments of a `Tracer`, so that the spans of segments that never
+// complete can be sent and their memory reclaimed.
+//
+// A trace segment completes when all of its spans are finished.  If
+// application code leaks a `Span`, e.g. by moving it into an object that is
+// never destroyed, then its segment never completes, and all of the spans of
+// the segment remain in memory indefinitely.
+//
+// When `TracerConfig::orphaned_segment_max_age_seconds` is set, each trace
+// segment adds itself to the tracer's `SegmentRegistry` when it is created,
+// and removes itself when it is destroyed.  The registry periodically sweeps
+// its segments, using the tracer's `EventScheduler`, and force-flushes those
+// older than the maximum age that are not yet complete (see
+// `TraceSegment::flush_orphaned`).  The number of segments flushed and the
+// estimated size of their spans are reported by `Tracer::runtime_stats`.
+//
+// The segments are linked into a list through `TraceSegment` itself, in order
+// of creation, so that adding and removing a segment does not allocate, and a
+// sweep visits only the segments that are old enough.
+
+#include <datadog/clock.h>
+#include <datadog/event_scheduler.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+struct RuntimeStats;
+class TraceSegment;
+
+class SegmentRegistry {
+  const Clock clock_;
+  const std::chrono::steady_clock::duration max_age_;
+  const std::shared_ptr<Logger> logger_;
+
+  // `mutex_` guards the list of segments, including the links within each
+  // segment.
+  std::mutex mutex_;
+  TraceSegment* oldest_;
+  TraceSegment* newest_;
+
+  std::atomic<std::uint64_t> orphaned_segments_;
+  std::atomic<std::uint64_t> orphaned_bytes_;
+
+  EventScheduler::Cancel cancel_sweep_;
+
+ public:
+  // Create a registry that force-flushes segments older than the specified
+  // `max_age`, sweeping as often using the specified `event_scheduler`, and
+  // that measures age using the specified `clock`.
+  SegmentRegistry(const Clock& clock,
+                  std::chrono::steady_clock::duration max_age,
+                  std::shared_ptr<Logger> logger,
+                  EventScheduler& event_scheduler);
+  SegmentRegistry(const SegmentRegistry&) = delete;
+  SegmentRegistry& operator=(const SegmentRegistry&) = delete;
+  ~SegmentRegistry();
+
+  // Add the specified `segment` to the registry.  `segment` is not yet
+  // referred to by a `std::shared_ptr`.
+  void add(TraceSegment& segment);
+  // Remove the specified `segment` from the registry, if it has not already
+  // been removed by a sweep.
+  void remove(TraceSegment& segment);
+
+  // Force-flush the segments older than the maximum age, and stop tracking
+  // them.
+  void sweep();
+
+  // Set the members of the specified `stats` that describe the force-flushed
+  // segments.
+  void add_runtime_stats(RuntimeStats& stats) const;
+
+ private:
+  // Unlink the specified `segment`, which is in the list.  `mutex_` must be
+  // locked.
+  void unlink(TraceSegment& segment);
+};
+
+}  // namespace tracing
+}  // namespace datadog
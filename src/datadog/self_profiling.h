@@ -0,0 +1,76 @@
+#pragma once
+
+// This component provides a macro, `DD_SELF_PROFILE`, that measures how long
+// the tracer itself spends in its hot paths.
+//
+// `DD_SELF_PROFILE(distribution)` is a statement that measures the time from
+// where it appears until the end of the enclosing scope, and adds the duration
+// in nanoseconds to the specified telemetry `distribution` (see the
+// `metrics::tracer::self_profiling` distributions in `telemetry_metrics.h`).
+// To keep the overhead low, each use of the macro measures only one in
+// `SelfProfilingTimer::sample_period` of its executions on each thread.
+//
+// Self-profiling is compiled in only if the `DD_TRACE_SELF_PROFILING`
+// preprocessor macro is defined (see the `DD_TRACE_SELF_PROFILING` CMake
+// option).  Otherwise, `DD_SELF_PROFILE` expands to a statement that does
+// nothing, and the timers do not exist.
+
+#ifdef DD_TRACE_SELF_PROFILING
+
+#include <datadog/telemetry/metrics.h>
+#include <datadog/telemetry/telemetry.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "overhead_governor.h"
+
+namespace datadog {
+namespace tracing {
+
+class SelfProfilingTimer {
+  const telemetry::Distribution* distribution_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  static constexpr std::uint32_t sample_period = 64;
+
+  // Measure the lifetime of this object if it is the first of every
+  // `sample_period` timers that share the specified `calls` count.
+  SelfProfilingTimer(const telemetry::Distribution& distribution,
+                     std::uint32_t& calls) {
+    if (calls++ % sample_period == 0) {
+      distribution_ = &distribution;
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~SelfProfilingTimer() {
+    if (!distribution_) return;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_);
+    telemetry::distribution::add(*distribution_, elapsed.count());
+    // The calls that were not measured are assumed to have cost as much.
+    OverheadGovernor::add_cost(elapsed * sample_period);
+  }
+
+  SelfProfilingTimer(const SelfProfilingTimer&) = delete;
+  SelfProfilingTimer& operator=(const SelfProfilingTimer&) = delete;
+
+  // Return whether this timer is measuring.
+  bool active() const { return distribution_ != nullptr; }
+};
+
+}  // namespace tracing
+}  // namespace datadog
+
+#define DD_SELF_PROFILE(distribution)                                 \
+  static thread_local std::uint32_t dd_self_profile_calls;            \
+  const ::datadog::tracing::SelfProfilingTimer dd_self_profile_timer( \
+      distribution, dd_self_profile_calls)
+
+#else
+
+#define DD_SELF_PROFILE(distribution) static_cast<void>(0)
+
+#endif  // defined DD_TRACE_SELF_PROFILING
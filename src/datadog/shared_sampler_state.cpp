@@ -0,0 +1,177 @@
+#include <datadog/shared_sampler_state.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "interprocess.h"
+#include "limiter.h"
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Give up reading the rates after this many attempts that overlap a write.
+constexpr unsigned max_read_attempts = 64;
+
+constexpr std::size_t rates_words = SharedSamplerState::rates_capacity / 8;
+
+static_assert(std::atomic<std::int64_t>::is_always_lock_free &&
+                  std::atomic<std::uint64_t>::is_always_lock_free,
+              "Words in shared memory must not depend on the process.");
+
+// Each rate is encoded as the size of its key, the key, and then the rate.
+using KeySize = std::uint32_t;
+
+}  // namespace
+
+// `Header` is the whole of the shared memory.  The rates are protected by a
+// sequence lock: `sequence` is odd while they are written, so that readers
+// do not lock, but retry if a write overlapped their read.
+struct SharedSamplerState::Header {
+  SharedLimiterBucket limiter{};
+  // Held by the process publishing rates.
+  ProcessLock writer;
+  std::atomic<std::uint64_t> sequence{0};
+  // The number of bytes of encoded rates in `rates`.
+  std::atomic<std::uint64_t> rates_size{0};
+  std::atomic<std::uint64_t> rates[rates_words];
+};
+
+SharedSamplerState::SharedSamplerState(Header* header) : header_(header) {}
+
+Expected<std::shared_ptr<SharedSamplerState>> SharedSamplerState::create() {
+  void* memory = map_shared_memory(sizeof(Header));
+  if (memory == nullptr) {
+    return Error{Error::SHARED_SAMPLER_STATE_UNAVAILABLE,
+                 "SharedSamplerState: unable to map shared memory."};
+  }
+
+  // The mapped memory is zeroed, as are the rates.
+  Header* header = new (memory) Header;
+  return std::shared_ptr<SharedSamplerState>(new SharedSamplerState(header));
+}
+
+SharedSamplerState::~SharedSamplerState() {
+  // The shared memory is unmapped in this process only.  It remains mapped in
+  // the other processes that share it.
+  unmap_shared_memory(header_, sizeof(Header));
+}
+
+SharedLimiterBucket& SharedSamplerState::limiter_bucket() {
+  return header_->limiter;
+}
+
+bool SharedSamplerState::publish_rates(
+    const std::unordered_map<std::string, Rate>& rates) {
+  std::string encoded;
+  for (const auto& [key, rate] : rates) {
+    if (key.size() > rates_capacity) {
+      return false;
+    }
+    const KeySize key_size = static_cast<KeySize>(key.size());
+    const double value = rate;
+    encoded.append(reinterpret_cast<const char*>(&key_size), sizeof key_size);
+    encoded += key;
+    encoded.append(reinterpret_cast<const char*>(&value), sizeof value);
+  }
+  if (encoded.size() > rates_capacity) {
+    return false;
+  }
+  const std::size_t size = encoded.size();
+  encoded.resize((size + 7) / 8 * 8, '\0');
+
+  // If the holder of the lock exited while holding it, then `sequence` is
+  // still odd, and the rates are written again below.
+  header_->writer.lock();
+
+  std::uint64_t sequence = header_->sequence.load(std::memory_order_relaxed);
+  if (sequence % 2 == 0) {
+    ++sequence;
+    header_->sequence.store(sequence, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i = 0; i < encoded.size() / 8; ++i) {
+    std::uint64_t word;
+    std::memcpy(&word, encoded.data() + i * 8, sizeof word);
+    header_->rates[i].store(word, std::memory_order_relaxed);
+  }
+  header_->rates_size.store(size, std::memory_order_relaxed);
+  header_->sequence.store(sequence + 1, std::memory_order_release);
+
+  header_->writer.unlock();
+  return true;
+}
+
+std::uint64_t SharedSamplerState::rates_version() const {
+  // Each publication adds two to `sequence`.
+  return header_->sequence.load(std::memory_order_acquire) / 2;
+}
+
+bool SharedSamplerState::read_rates(
+    std::unordered_map<std::string, Rate>& rates,
+    std::uint64_t& version) const {
+  std::string encoded;
+  std::uint64_t sequence = 0;
+  bool consistent = false;
+  for (unsigned attempt = 0; attempt < max_read_attempts && !consistent;
+       ++attempt) {
+    sequence = header_->sequence.load(std::memory_order_acquire);
+    if (sequence == 0) {
+      return false;
+    }
+    if (sequence % 2 == 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    const std::size_t size = std::min<std::size_t>(
+        header_->rates_size.load(std::memory_order_relaxed), rates_capacity);
+    encoded.resize((size + 7) / 8 * 8);
+    for (std::size_t i = 0; i < encoded.size() / 8; ++i) {
+      const std::uint64_t word =
+          header_->rates[i].load(std::memory_order_relaxed);
+      std::memcpy(&encoded[i * 8], &word, sizeof word);
+    }
+    encoded.resize(size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    consistent =
+        header_->sequence.load(std::memory_order_relaxed) == sequence;
+  }
+  if (!consistent) {
+    return false;
+  }
+
+  std::unordered_map<std::string, Rate> decoded;
+  std::size_t offset = 0;
+  while (offset < encoded.size()) {
+    KeySize key_size;
+    if (encoded.size() - offset < sizeof key_size) {
+      return false;
+    }
+    std::memcpy(&key_size, encoded.data() + offset, sizeof key_size);
+    offset += sizeof key_size;
+    double value;
+    if (encoded.size() - offset < key_size + sizeof value) {
+      return false;
+    }
+    std::string key = encoded.substr(offset, key_size);
+    offset += key_size;
+    std::memcpy(&value, encoded.data() + offset, sizeof value);
+    offset += sizeof value;
+    auto rate = Rate::from(value);
+    if (rate.if_error()) {
+      return false;
+    }
+    decoded.insert_or_assign(std::move(key), *rate);
+  }
+
+  rates = std::move(decoded);
+  version = sequence / 2;
+  return true;
+}
+
+}  // namespace tracing
+}  // namespace datadog
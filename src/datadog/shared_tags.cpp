@@ -0,0 +1,83 @@
+#include "shared_tags.h"
+
+#include "msgpack.h"
+#include "tags.h"
+
+namespace datadog {
+namespace tracing {
+
+SharedTags::SharedTags(Tags tags, NumericTags numeric_tags)
+    : tags_(std::move(tags)), numeric_tags_(std::move(numeric_tags)) {
+  // Keys are well-known tag names and values are short, so the string length
+  // limits of `msgpack::pack_string` cannot be exceeded.
+  for (const auto& [key, value] : tags_) {
+    msgpack::pack_string(packed_tags_, key);
+    msgpack::pack_string(packed_tags_, value);
+  }
+  for (const auto& [key, value] : numeric_tags_) {
+    msgpack::pack_string(packed_numeric_tags_, key);
+    msgpack::pack_number(packed_numeric_tags_, value);
+  }
+}
+
+const SharedTags::Tags& SharedTags::tags() const { return tags_; }
+
+const SharedTags::NumericTags& SharedTags::numeric_tags() const {
+  return numeric_tags_;
+}
+
+const std::string& SharedTags::packed_tags() const { return packed_tags_; }
+
+const std::string& SharedTags::packed_numeric_tags() const {
+  return packed_numeric_tags_;
+}
+
+std::shared_ptr<const SharedTags> make_segment_tags(
+    const Optional<std::string>& origin, StringView runtime_id,
+    int process_id) {
+  SharedTags::Tags tags;
+  tags.reserve(3);
+  if (origin) {
+    tags.emplace_back(tags::internal::origin, *origin);
+  }
+  tags.emplace_back(tags::internal::language, "cpp");
+  tags.emplace_back(tags::internal::runtime_id, std::string(runtime_id));
+  return std::make_shared<const SharedTags>(
+      std::move(tags),
+      SharedTags::NumericTags{{tags::internal::process_id, process_id}});
+}
+
+constexpr std::size_t SegmentTagsCache::max_origins;
+
+SegmentTagsCache::SegmentTagsCache(std::string runtime_id)
+    : runtime_id_(std::move(runtime_id)) {}
+
+std::shared_ptr<const SharedTags> SegmentTagsCache::get(StringView origin,
+                                                        int process_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (process_id != process_id_) {
+    // This is a child process forked since the tags were made.
+    entries_.clear();
+    next_replaced_ = 0;
+    process_id_ = process_id;
+  }
+  for (const Entry& entry : entries_) {
+    if (entry.origin == origin) {
+      return entry.tags;
+    }
+  }
+
+  auto tags = make_segment_tags(std::string(origin), runtime_id_, process_id);
+  if (entries_.size() < max_origins) {
+    entries_.push_back(Entry{std::string(origin), tags});
+  } else {
+    Entry& replaced = entries_[next_replaced_];
+    replaced.origin.assign(origin.data(), origin.size());
+    replaced.tags = tags;
+    next_replaced_ = (next_replaced_ + 1) % max_origins;
+  }
+  return tags;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,103 @@
+#pragma once
+
+// This component provides a `class`, `SharedTags`, that holds span tags whose
+// values are the same for every span in a trace segment, such as
+// `tags::internal::language`, `tags::internal::runtime_id`, and
+// `tags::internal::process_id`.
+//
+// Rather than copying these tags into the `SpanData::tags` and
+// `SpanData::numeric_tags` of each span, `TraceSegment` creates one immutable
+// `SharedTags` per segment and gives each finished span a reference to it (see
+// `SpanData::shared_tags`).  The MessagePack encoding of the tags is computed
+// once, when the `SharedTags` is constructed, and `msgpack_encode` appends it
+// verbatim to each span's "meta" and "metrics" maps.
+//
+// Most segments have no origin, and so their shared tags are the same for all
+// of a tracer's segments.  The tracer builds them once (see
+// `TracerContext::shared_tags`), so that finishing a segment neither
+// allocates nor encodes them.  The segments that have an origin usually have
+// one of a few, such as "synthetics" or "rum", and so the tracer also keeps
+// the shared tags of the origins most recently seen (see `SegmentTagsCache`).
+
+#include <datadog/optional.h>
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class SharedTags {
+ public:
+  using Tags = std::vector<std::pair<std::string, std::string>>;
+  using NumericTags = std::vector<std::pair<std::string, double>>;
+
+ private:
+  Tags tags_;
+  NumericTags numeric_tags_;
+  std::string packed_tags_;
+  std::string packed_numeric_tags_;
+
+ public:
+  // Create an object holding the specified `tags` and `numeric_tags`.  The
+  // keys of `tags` must be distinct, as must the keys of `numeric_tags`.
+  SharedTags(Tags tags, NumericTags numeric_tags);
+
+  const Tags& tags() const;
+  const NumericTags& numeric_tags() const;
+
+  // Return the concatenated MessagePack encodings of the key and value of
+  // each element of `tags()` or `numeric_tags()`, respectively.  The returned
+  // values do not include a map header, so that they can be appended to the
+  // elements of a larger map.
+  const std::string& packed_tags() const;
+  const std::string& packed_numeric_tags() const;
+};
+
+// Return the tags that every span has in common in a trace segment having the
+// specified `origin`, created by a tracer having the specified `runtime_id` in
+// the process having the specified `process_id`.
+std::shared_ptr<const SharedTags> make_segment_tags(
+    const Optional<std::string>& origin, StringView runtime_id,
+    int process_id);
+
+// `SegmentTagsCache` keeps the tags returned by `make_segment_tags` for the
+// origins most recently seen, so that the segments having one of them share
+// the same `SharedTags`.  It is safe to use concurrently.
+class SegmentTagsCache {
+ public:
+  // The number of origins whose tags are kept.  The least recently added is
+  // replaced by another.
+  static constexpr std::size_t max_origins = 8;
+
+ private:
+  struct Entry {
+    std::string origin;
+    std::shared_ptr<const SharedTags> tags;
+  };
+
+  const std::string runtime_id_;
+  std::mutex mutex_;
+  // Guarded by `mutex_`.
+  int process_id_ = 0;
+  std::vector<Entry> entries_;
+  std::size_t next_replaced_ = 0;
+
+ public:
+  // Create a cache of the tags of segments created by a tracer having the
+  // specified `runtime_id`.
+  explicit SegmentTagsCache(std::string runtime_id);
+
+  // Return the tags that every span has in common in a trace segment having
+  // the specified `origin`, in the process having the specified
+  // `process_id`.  The tags kept for another process are discarded.
+  std::shared_ptr<const SharedTags> get(StringView origin, int process_id);
+};
+
+}  // namespace tracing
+}  // namespace datadog
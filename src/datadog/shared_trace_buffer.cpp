@@ -0,0 +1,128 @@
+#include <datadog/shared_trace_buffer.h>
+
+#include <atomic>
+#include <limits>
+#include <new>
+
+#include "interprocess.h"
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+static_assert(std::atomic<std::int32_t>::is_always_lock_free,
+              "The drainer in shared memory must not depend on the process.");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Counters in shared memory must not depend on the process.");
+
+}  // namespace
+
+// `Header` is at the beginning of the shared memory, and the records follow
+// it.
+struct SharedTraceBuffer::Header {
+  ProcessLock lock;
+  // The process ID of the process that sends the records, or zero.
+  std::atomic<std::int32_t> drainer{0};
+  std::atomic<std::uint64_t> dropped{0};
+  // Guarded by `lock`.
+  SharedRing ring;
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+SharedTraceBuffer::SharedTraceBuffer(Header* header, std::size_t mapped_size)
+    : header_(header), mapped_size_(mapped_size) {}
+
+Expected<std::shared_ptr<SharedTraceBuffer>> SharedTraceBuffer::create(
+    std::size_t capacity) {
+  static_assert(sizeof(Header) % alignof(std::uint64_t) == 0,
+                "Records must begin at an aligned address.");
+  if (capacity <= sizeof(SharedRing::RecordSize) ||
+      capacity > std::numeric_limits<std::size_t>::max() - sizeof(Header)) {
+    return Error{Error::SHARED_TRACE_BUFFER_INVALID_CAPACITY,
+                 "SharedTraceBuffer: capacity must be large enough to hold a "
+                 "record."};
+  }
+
+  const std::size_t mapped_size = sizeof(Header) + capacity;
+  void* memory = map_shared_memory(mapped_size);
+  if (memory == nullptr) {
+    return Error{Error::SHARED_TRACE_BUFFER_UNAVAILABLE,
+                 "SharedTraceBuffer: unable to map shared memory."};
+  }
+
+  Header* header = new (memory) Header;
+  header->ring.capacity = capacity;
+  return std::shared_ptr<SharedTraceBuffer>(
+      new SharedTraceBuffer(header, mapped_size));
+}
+
+SharedTraceBuffer::~SharedTraceBuffer() {
+  // The shared memory is unmapped in this process only.  It remains mapped in
+  // the other processes that share it.
+  unmap_shared_memory(header_, mapped_size_);
+}
+
+void SharedTraceBuffer::lock() {
+  if (header_->lock.lock()) {
+    // The holder of the lock exited while holding it, possibly in the middle
+    // of writing a record.  Discard the records.
+    header_->ring.head = header_->ring.tail;
+  }
+}
+
+void SharedTraceBuffer::unlock() { header_->lock.unlock(); }
+
+bool SharedTraceBuffer::push(StringView record) {
+  if (record.size() > std::numeric_limits<SharedRing::RecordSize>::max()) {
+    header_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  SharedRing& ring = header_->ring;
+  lock();
+  if (ring.tail - ring.head + SharedRing::space_for(record) > ring.capacity) {
+    unlock();
+    header_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  ring.push(header_->data(), record);
+  unlock();
+  return true;
+}
+
+bool SharedTraceBuffer::pop(std::string& record) {
+  lock();
+  const bool popped = header_->ring.pop(header_->data(), record);
+  unlock();
+  return popped;
+}
+
+bool SharedTraceBuffer::try_become_drainer() {
+  const std::int32_t self = get_process_id();
+  std::int32_t drainer = header_->drainer.load();
+  if (drainer == self) {
+    return true;
+  }
+  if (drainer != 0 && process_exists(drainer)) {
+    return false;
+  }
+  return header_->drainer.compare_exchange_strong(drainer, self);
+}
+
+void SharedTraceBuffer::resign_drainer() {
+  std::int32_t self = get_process_id();
+  header_->drainer.compare_exchange_strong(self, 0);
+}
+
+std::size_t SharedTraceBuffer::capacity() const {
+  return static_cast<std::size_t>(header_->ring.capacity);
+}
+
+std::uint64_t SharedTraceBuffer::dropped() const {
+  return header_->dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+}  // namespace datadog
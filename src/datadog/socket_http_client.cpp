@@ -0,0 +1,1377 @@
+#include "socket_http_client.h"
+
+#include <datadog/dict_reader.h>
+#include <datadog/dict_writer.h>
+#include <datadog/logger.h>
+#include <datadog/string_view.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "header_block_reader.h"
+#include "io_uring.h"
+#include "json.hpp"
+#include "parse_util.h"
+#include "string_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Connections that are kept alive beyond this many per endpoint are closed.
+constexpr std::size_t max_idle_connections_per_endpoint = 4;
+// The event loop wakes up at least this often, even if nothing happens.
+constexpr int max_wait_milliseconds = 10'000;
+// Response bytes are read from a socket in pieces of this size.
+constexpr std::size_t read_size = 4096;
+// A response whose status line and headers are larger than this is rejected.
+constexpr std::size_t max_response_head_size = 64 * 1024;
+// At most this many buffers are passed to one call to `sendmsg`.
+constexpr std::size_t max_send_buffers = 64;
+// The submission queue of an io_uring event loop has this many entries.
+constexpr unsigned ring_entries = 256;
+// The `user_data` of io_uring operations that are not for a connection.  The
+// `user_data` of an operation for a connection is the connection's address.
+constexpr std::uint64_t wake_user_data = 1;
+constexpr std::uint64_t cancel_user_data = 2;
+
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+bool is_unix_socket(const HTTPClient::URL& url) {
+  return url.scheme == "unix" || url.scheme == "http+unix";
+}
+
+// Return a message describing the current value of `errno`, prefixed by the
+// specified `what`.
+std::string errno_message(StringView what) {
+  std::string message;
+  append(message, what);
+  message += ": ";
+  message += std::strerror(errno);
+  return message;
+}
+
+bool set_nonblocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags != -1 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// `ResponseParser` parses an HTTP/1.1 response as its bytes arrive.
+class ResponseParser {
+ public:
+  enum class Result { incomplete, complete, invalid };
+
+  // Bytes received but not yet parsed.
+  std::string buffer;
+  int status = -1;
+  // The response's header lines, which are parsed only if they are looked up
+  // (see `HeaderBlockReader`).
+  std::string headers;
+  std::string body;
+  // Whether the connection may be used for another request afterward.
+  bool keep_alive = true;
+  // If `parse` or `finish` returned `Result::invalid`, why.
+  std::string error;
+
+  void reset() {
+    buffer.clear();
+    status = -1;
+    headers.clear();
+    body.clear();
+    keep_alive = true;
+    error.clear();
+    state_ = State::head;
+    remaining_ = 0;
+  }
+
+  // Parse as much of `buffer` as possible.
+  Result parse() {
+    std::size_t position = 0;
+    Result result = Result::incomplete;
+    while (result == Result::incomplete) {
+      const std::size_t before = position;
+      result = step(position);
+      if (result == Result::incomplete && position == before) {
+        break;  // more bytes are needed
+      }
+    }
+    buffer.erase(0, position);
+    return result;
+  }
+
+  // Return the result of the connection having been closed by the server.
+  Result finish() {
+    if (state_ == State::until_close) {
+      state_ = State::done;
+      return Result::complete;
+    }
+    error = "The connection was closed before the response was complete.";
+    return Result::invalid;
+  }
+
+ private:
+  enum class State {
+    head,
+    length,
+    chunk_size,
+    chunk_data,
+    chunk_data_end,
+    trailers,
+    until_close,
+    done
+  };
+  State state_ = State::head;
+  std::size_t remaining_ = 0;
+
+  Result invalid(std::string message) {
+    error = std::move(message);
+    return Result::invalid;
+  }
+
+  // Consume the line that begins at the specified `position`, if it is
+  // complete, and assign it, without its terminator, to `line`.  Return
+  // whether the line was complete.
+  bool take_line(std::size_t& position, StringView& line) const {
+    const auto end = buffer.find("\r\n", position);
+    if (end == std::string::npos) {
+      return false;
+    }
+    line = StringView(buffer).substr(position, end - position);
+    position = end + 2;
+    return true;
+  }
+
+  Result step(std::size_t& position) {
+    switch (state_) {
+      case State::head:
+        return parse_head(position);
+      case State::length: {
+        const std::size_t length =
+            std::min(remaining_, buffer.size() - position);
+        body.append(buffer, position, length);
+        position += length;
+        remaining_ -= length;
+        if (remaining_ == 0) {
+          state_ = State::done;
+          return Result::complete;
+        }
+        return Result::incomplete;
+      }
+      case State::chunk_size: {
+        StringView line;
+        if (!take_line(position, line)) {
+          return Result::incomplete;
+        }
+        const auto size =
+            parse_uint64(trim(line.substr(0, line.find(';'))), 16);
+        if (!size) {
+          return invalid("Invalid chunk size in response.");
+        }
+        remaining_ = static_cast<std::size_t>(*size);
+        state_ = remaining_ == 0 ? State::trailers : State::chunk_data;
+        return Result::incomplete;
+      }
+      case State::chunk_data: {
+        const std::size_t length =
+            std::min(remaining_, buffer.size() - position);
+        body.append(buffer, position, length);
+        position += length;
+        remaining_ -= length;
+        if (remaining_ == 0) {
+          state_ = State::chunk_data_end;
+        }
+        return Result::incomplete;
+      }
+      case State::chunk_data_end: {
+        if (buffer.size() - position < 2) {
+          return Result::incomplete;
+        }
+        if (buffer.compare(position, 2, "\r\n") != 0) {
+          return invalid("Invalid chunk terminator in response.");
+        }
+        position += 2;
+        state_ = State::chunk_size;
+        return Result::incomplete;
+      }
+      case State::trailers: {
+        StringView line;
+        if (!take_line(position, line)) {
+          return Result::incomplete;
+        }
+        if (line.empty()) {
+          state_ = State::done;
+          return Result::complete;
+        }
+        return Result::incomplete;
+      }
+      case State::until_close:
+        body.append(buffer, position, std::string::npos);
+        position = buffer.size();
+        return Result::incomplete;
+      case State::done:
+      default:
+        return invalid("Unexpected data after the response.");
+    }
+  }
+
+  Result parse_head(std::size_t& position) {
+    const auto end = buffer.find("\r\n\r\n", position);
+    if (end == std::string::npos) {
+      if (buffer.size() - position > max_response_head_size) {
+        return invalid("Response headers are too large.");
+      }
+      return Result::incomplete;
+    }
+
+    StringView line;
+    take_line(position, line);
+    // The status line looks like "HTTP/1.1 200 OK".
+    if (!starts_with(line, "HTTP/1.")) {
+      return invalid("Invalid status line in response.");
+    }
+    keep_alive = !starts_with(line, "HTTP/1.0");
+    const auto after_version = line.find(' ');
+    const auto code = after_version == StringView::npos
+                          ? StringView()
+                          : line.substr(after_version + 1, 3);
+    const auto parsed_status = parse_int(code, 10);
+    if (!parsed_status) {
+      return invalid("Invalid status code in response.");
+    }
+    status = *parsed_status;
+
+    // The header lines are everything before the empty line.  The status line
+    // ends at `end` when there are none.
+    const std::size_t headers_end = std::max(position, end + 2);
+    headers.assign(buffer, position, headers_end - position);
+    position = std::max(position, end + 4);
+
+    if (status >= 100 && status < 200) {
+      // An interim response, such as "100 Continue".  The final response
+      // follows.
+      return Result::incomplete;
+    }
+
+    const HeaderBlockReader reader{headers};
+    if (auto found = reader.lookup("connection")) {
+      const auto value = to_lower(*found);
+      if (value == "close") {
+        keep_alive = false;
+      } else if (value == "keep-alive") {
+        keep_alive = true;
+      }
+    }
+
+    if (auto found = reader.lookup("transfer-encoding");
+        found && to_lower(*found).find("chunked") != std::string::npos) {
+      state_ = State::chunk_size;
+      return Result::incomplete;
+    }
+    if (auto found = reader.lookup("content-length")) {
+      const auto length = parse_uint64(*found, 10);
+      if (!length) {
+        return invalid("Invalid Content-Length in response.");
+      }
+      remaining_ = static_cast<std::size_t>(*length);
+      state_ = State::length;
+      if (remaining_ == 0) {
+        state_ = State::done;
+        return Result::complete;
+      }
+      return Result::incomplete;
+    }
+    if (status == 204 || status == 304) {
+      state_ = State::done;
+      return Result::complete;
+    }
+    // The body extends until the server closes the connection.
+    keep_alive = false;
+    state_ = State::until_close;
+    return Result::incomplete;
+  }
+};
+
+// `HeaderWriter` appends request headers to the request's buffer.
+class HeaderWriter : public DictWriter {
+  std::string& head_;
+
+ public:
+  explicit HeaderWriter(std::string& head) : head_(head) {}
+
+  void set(StringView key, StringView value) override {
+    append(head_, key);
+    head_ += ": ";
+    append(head_, value);
+    head_ += "\r\n";
+  }
+};
+
+}  // namespace
+
+class SocketHTTPClientImpl {
+  struct Request {
+    HTTPClient::URL url;
+    // The key of the request's connection in `idle_`.  The endpoint's scheme
+    // and authority.
+    std::string endpoint;
+    // The request line and headers.
+    std::string head;
+    HTTPClient::BodySegments body;
+    HTTPClient::ResponseHandler on_response;
+    HTTPClient::ErrorHandler on_error;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  struct Address {
+    sockaddr_storage storage;
+    socklen_t length;
+  };
+
+  struct Connection {
+    int fd = -1;
+    std::string endpoint;
+    // Addresses not yet tried, if connecting fails.
+    std::vector<Address> addresses;
+    bool connecting = false;
+    // Whether the connection was used by an earlier request.
+    bool reused = false;
+    std::unique_ptr<Request> request;
+    // The position of the next request byte to send.  Segment 0 is the
+    // request's `head`, and the others are its `body`.
+    std::size_t segment = 0;
+    std::size_t offset = 0;
+    bool sending = false;
+    // Whether any of the response has been received.
+    bool received = false;
+    ResponseParser response;
+    // The following are used only by the io_uring event loop.
+    //
+    // Whether an operation for the connection is in flight.  The connection
+    // must not be destroyed until the operation completes.
+    bool submitted = false;
+    // Whether the operation completed, and its result, not yet handled.
+    bool completed = false;
+    int result = 0;
+    // Whether to wait until the socket is ready before sending or receiving
+    // again, because the previous attempt would have blocked.
+    bool await_ready = false;
+    // The size of `response.buffer` before the receive in flight.
+    std::size_t receive_offset = 0;
+    // The buffers of the send in flight.
+    iovec buffers[max_send_buffers];
+    msghdr message{};
+
+    ~Connection() {
+      if (fd != -1) {
+        ::close(fd);
+      }
+    }
+  };
+
+  std::mutex mutex_;
+  const std::shared_ptr<Logger> logger_;
+  Clock clock_;
+  // The ends of a pipe used to wake up the event loop.
+  int wake_read_;
+  int wake_write_;
+  // Guarded by `mutex_`.
+  std::list<std::unique_ptr<Request>> new_requests_;
+  // Guarded by `mutex_`.
+  bool shutting_down_;
+  // The number of requests in the event loop.  Guarded by `mutex_`.
+  std::size_t num_active_requests_;
+  std::condition_variable no_requests_;
+  // Accessed only by the event loop.
+  std::vector<std::unique_ptr<Connection>> active_;
+  std::unordered_map<std::string, std::vector<std::unique_ptr<Connection>>>
+      idle_;
+  std::atomic<std::uint64_t> connections_created_;
+  std::atomic<std::uint64_t> connections_reused_;
+  // Null if the event loop uses `poll`.
+  std::unique_ptr<IoUring> ring_;
+  std::thread event_loop_;
+
+  void run();
+  // Run the event loop using `ring_` rather than `poll`.
+  void run_ring();
+  void wake();
+  // Assign a connection to the specified `request` and begin sending it, or
+  // deliver an error if that is not possible.
+  void start(std::unique_ptr<Request> request);
+  // Return a new connection to the endpoint of the specified `url`.
+  Expected<std::unique_ptr<Connection>> open(const HTTPClient::URL& url);
+  // Begin connecting `connection` to its next address.
+  Expected<void> connect_next(Connection& connection);
+  // Begin sending the specified `request` on the specified `connection`.
+  static void begin(Connection& connection, std::unique_ptr<Request> request);
+  // Make progress on `connection` given the specified poll `events`.  Return
+  // false if the connection is finished with its request.
+  bool handle_events(Connection& connection, short events);
+  // Check whether `connection` connected, and if it did not, begin connecting
+  // to its next address.  Return false if the connection is finished with its
+  // request.
+  bool finish_connecting(Connection& connection);
+  bool send_request(Connection& connection);
+  bool receive_response(Connection& connection);
+  // Fill the specified `buffers` with the parts of the request of
+  // `connection` not yet sent, and return how many were filled.  Return zero
+  // if the whole request was sent.
+  static std::size_t gather(const Connection& connection, iovec* buffers);
+  // Advance `connection` past the specified number of request bytes `sent`.
+  static void advance(Connection& connection, std::size_t sent);
+  // Parse the specified number of bytes `received` at the end of the response
+  // buffer of `connection`, where zero means that the server closed the
+  // connection.  Return false if the connection is finished with its request.
+  bool receive(Connection& connection, std::size_t received);
+  // Submit to `ring_` the next operation for `connection`.
+  void submit(Connection& connection);
+  // Make progress on `connection` given the specified `result` of its
+  // completed io_uring operation.  Return false if the connection is finished
+  // with its request.
+  bool handle_completion(Connection& connection, int result);
+  // Cancel the io_uring operation in flight for `connection`.
+  void cancel(Connection& connection);
+  static std::uint64_t user_data(const Connection& connection);
+  // Deliver the response received on `connection`, and then keep or close
+  // the connection.  Return false.
+  bool complete(Connection& connection);
+  // Deliver an error for the request of `connection`, or, if the connection
+  // was reused and the server closed it before responding, send the request
+  // again on a new connection.  Return false.
+  bool fail(Connection& connection, std::string message);
+  // Deliver the specified error for the request of `connection`.
+  static void deliver_error(Connection& connection, Error error);
+  void release(std::unique_ptr<Connection> connection);
+
+ public:
+  SocketHTTPClientImpl(const std::shared_ptr<Logger>&, const Clock&,
+                       const ThreadGenerator&, const SocketHTTPClientOptions&);
+  ~SocketHTTPClientImpl();
+
+  Expected<void> post(const HTTPClient::URL& url,
+                      HTTPClient::HeadersSetter set_headers,
+                      HTTPClient::BodySegments body,
+                      HTTPClient::ResponseHandler on_response,
+                      HTTPClient::ErrorHandler on_error,
+                      std::chrono::steady_clock::time_point deadline);
+
+  void drain(std::chrono::steady_clock::time_point deadline);
+
+  nlohmann::json config() const;
+};
+
+SocketHTTPClient::SocketHTTPClient(const std::shared_ptr<Logger>& logger,
+                                   const Clock& clock)
+    : SocketHTTPClient(logger, clock, SocketHTTPClientOptions{}) {}
+
+SocketHTTPClient::SocketHTTPClient(const std::shared_ptr<Logger>& logger,
+                                   const Clock& clock,
+                                   const ThreadGenerator& make_thread)
+    : SocketHTTPClient(logger, clock, make_thread, SocketHTTPClientOptions{}) {
+}
+
+SocketHTTPClient::SocketHTTPClient(const std::shared_ptr<Logger>& logger,
+                                   const Clock& clock,
+                                   const SocketHTTPClientOptions& options)
+    : SocketHTTPClient(
+          logger, clock,
+          [](std::function<void()>&& run) {
+            return std::thread(std::move(run));
+          },
+          options) {}
+
+SocketHTTPClient::SocketHTTPClient(const std::shared_ptr<Logger>& logger,
+                                   const Clock& clock,
+                                   const ThreadGenerator& make_thread,
+                                   const SocketHTTPClientOptions& options)
+    : impl_(new SocketHTTPClientImpl{logger, clock, make_thread, options}) {}
+
+SocketHTTPClient::~SocketHTTPClient() { delete impl_; }
+
+Expected<void> SocketHTTPClient::post(
+    const URL& url, HeadersSetter set_headers, std::string body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  BodySegments segments;
+  segments.push_back(std::make_shared<const std::string>(std::move(body)));
+  return impl_->post(url, std::move(set_headers), std::move(segments),
+                     std::move(on_response), std::move(on_error), deadline);
+}
+
+Expected<void> SocketHTTPClient::post_segments(
+    const URL& url, HeadersSetter set_headers, BodySegments body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  return impl_->post(url, std::move(set_headers), std::move(body),
+                     std::move(on_response), std::move(on_error), deadline);
+}
+
+void SocketHTTPClient::drain(std::chrono::steady_clock::time_point deadline) {
+  impl_->drain(deadline);
+}
+
+std::string SocketHTTPClient::config() const {
+  return nlohmann::json::object({{"type", "datadog::tracing::SocketHTTPClient"},
+                                 {"config", impl_->config()}})
+      .dump();
+}
+
+SocketHTTPClientImpl::SocketHTTPClientImpl(
+    const std::shared_ptr<Logger>& logger, const Clock& clock,
+    const ThreadGenerator& make_thread, const SocketHTTPClientOptions& options)
+    : logger_(logger),
+      clock_(clock),
+      wake_read_(-1),
+      wake_write_(-1),
+      shutting_down_(false),
+      num_active_requests_(0),
+      connections_created_(0),
+      connections_reused_(0) {
+  int fds[2];
+  if (::pipe(fds) != 0) {
+    logger_->log_error(Error{Error::SOCKET_HTTP_CLIENT_SETUP_FAILED,
+                             errno_message("Unable to create a pipe")});
+    return;
+  }
+  if (!set_nonblocking(fds[0]) || !set_nonblocking(fds[1])) {
+    logger_->log_error(Error{Error::SOCKET_HTTP_CLIENT_SETUP_FAILED,
+                             errno_message("Unable to configure a pipe")});
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return;
+  }
+
+  wake_read_ = fds[0];
+  wake_write_ = fds[1];
+
+  if (options.io_uring) {
+    // If io_uring is unavailable, then `poll` is used instead.
+    auto ring = IoUring::create(ring_entries);
+    if (ring) {
+      ring_ = std::move(*ring);
+    }
+  }
+
+  try {
+    event_loop_ = make_thread([this]() {
+      if (ring_) {
+        run_ring();
+      } else {
+        run();
+      }
+    });
+  } catch (const std::system_error& error) {
+    logger_->log_error(
+        Error{Error::SOCKET_HTTP_CLIENT_SETUP_FAILED, error.what()});
+    ::close(wake_read_);
+    ::close(wake_write_);
+  }
+}
+
+SocketHTTPClientImpl::~SocketHTTPClientImpl() {
+  if (!event_loop_.joinable()) {
+    // We're not running; nothing to shut down.
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  wake();
+  event_loop_.join();
+
+  ::close(wake_read_);
+  ::close(wake_write_);
+}
+
+void SocketHTTPClientImpl::wake() {
+  const char byte = 0;
+  // If the pipe is full, then the event loop is going to wake up anyway.
+  (void)!::write(wake_write_, &byte, 1);
+}
+
+Expected<void> SocketHTTPClientImpl::post(
+    const HTTPClient::URL& url, HTTPClient::HeadersSetter set_headers,
+    HTTPClient::BodySegments body, HTTPClient::ResponseHandler on_response,
+    HTTPClient::ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  if (!event_loop_.joinable()) {
+    return Error{Error::SOCKET_HTTP_CLIENT_SETUP_FAILED,
+                 "Unable to send request because the HTTP client failed to "
+                 "start."};
+  }
+  if (url.scheme != "http" && !is_unix_socket(url)) {
+    std::string message;
+    message += "The built-in HTTP client does not support the URL scheme \"";
+    message += url.scheme;
+    message += "\".  Supported schemes are \"http\", \"unix\", and ";
+    message += "\"http+unix\".";
+    return Error{Error::SOCKET_HTTP_CLIENT_UNSUPPORTED_URL,
+                 std::move(message)};
+  }
+
+  auto request = std::make_unique<Request>();
+  request->url = url;
+  request->endpoint = url.scheme;
+  request->endpoint += "://";
+  request->endpoint += url.authority;
+
+  std::size_t body_size = 0;
+  for (const auto& segment : body) {
+    assert(segment);
+    body_size += segment->size();
+  }
+
+  std::string& head = request->head;
+  head.reserve(256);
+  head += "POST ";
+  head += url.path.empty() ? "/" : url.path;
+  if (!url.query.empty()) {
+    head += '?';
+    head += url.query;
+  }
+  head += " HTTP/1.1\r\nHost: ";
+  // The authority of a Unix domain socket URL is the path to the socket.
+  head += is_unix_socket(url) ? "localhost" : url.authority;
+  head += "\r\nContent-Length: ";
+  head += std::to_string(body_size);
+  head += "\r\n";
+  HeaderWriter writer{head};
+  set_headers(writer);
+  head += "\r\n";
+
+  request->body = std::move(body);
+  request->on_response = std::move(on_response);
+  request->on_error = std::move(on_error);
+  request->deadline = deadline;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    new_requests_.push_back(std::move(request));
+  }
+  wake();
+  return nullopt;
+}
+
+void SocketHTTPClientImpl::drain(
+    std::chrono::steady_clock::time_point deadline) {
+  if (!event_loop_.joinable()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  no_requests_.wait_until(lock, deadline, [this]() {
+    return num_active_requests_ == 0 && new_requests_.empty();
+  });
+}
+
+nlohmann::json SocketHTTPClientImpl::config() const {
+  return nlohmann::json::object({
+      {"connections_created", connections_created_.load()},
+      {"connections_reused", connections_reused_.load()},
+      {"io_uring", ring_ != nullptr},
+  });
+}
+
+void SocketHTTPClientImpl::run() {
+  std::list<std::unique_ptr<Request>> requests;
+  std::vector<pollfd> fds;
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (shutting_down_) {
+        break;
+      }
+      requests.splice(requests.end(), new_requests_);
+      num_active_requests_ = active_.size() + requests.size();
+    }
+
+    for (; !requests.empty(); requests.pop_front()) {
+      start(std::move(requests.front()));
+    }
+
+    // Poll the wake-up pipe, the connections with requests, and the idle
+    // connections, in that order.  An idle connection is readable only if
+    // the server closed it.
+    fds.clear();
+    fds.push_back(pollfd{wake_read_, POLLIN, 0});
+    auto timeout = std::chrono::milliseconds(max_wait_milliseconds);
+    const auto now = clock_().tick;
+    for (const auto& connection : active_) {
+      const bool want_output = connection->connecting || connection->sending;
+      fds.push_back(pollfd{connection->fd,
+                           static_cast<short>(want_output ? POLLOUT : POLLIN),
+                           0});
+      const auto remaining =
+          std::chrono::ceil<std::chrono::milliseconds>(
+              connection->request->deadline - now);
+      timeout =
+          std::max(std::chrono::milliseconds(0), std::min(timeout, remaining));
+    }
+    for (const auto& [endpoint, connections] : idle_) {
+      for (const auto& connection : connections) {
+        fds.push_back(pollfd{connection->fd, POLLIN, 0});
+      }
+    }
+
+    if (::poll(fds.data(), static_cast<nfds_t>(fds.size()),
+               static_cast<int>(timeout.count())) < 0 &&
+        errno != EINTR) {
+      logger_->log_error(Error{Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE,
+                               errno_message("poll")});
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char discard[64];
+      while (::read(wake_read_, discard, sizeof discard) > 0) {
+      }
+    }
+
+    // Close idle connections that the server closed.  Do this before handling
+    // active connections, which can make connections idle.
+    std::size_t index = 1 + active_.size();
+    for (auto& [endpoint, connections] : idle_) {
+      auto closed = std::remove_if(
+          connections.begin(), connections.end(),
+          [&](const auto&) { return fds[index++].revents != 0; });
+      connections.erase(closed, connections.end());
+    }
+
+    // `handle_events` can make `active_` grow, by sending a request again on a
+    // new connection, so iterate over the connections that were polled only.
+    std::vector<std::unique_ptr<Connection>> polled;
+    polled.swap(active_);
+    const auto after_poll = clock_().tick;
+    for (std::size_t i = 0; i < polled.size(); ++i) {
+      auto& connection = polled[i];
+      bool keep = true;
+      if (fds[i + 1].revents != 0) {
+        keep = handle_events(*connection, fds[i + 1].revents);
+      }
+      if (keep && connection->request &&
+          after_poll >= connection->request->deadline) {
+        deliver_error(*connection,
+                      Error{Error::SOCKET_HTTP_CLIENT_DEADLINE_EXCEEDED,
+                            "Request deadline exceeded."});
+        keep = false;
+      }
+      if (!keep) {
+        if (connection->request) {
+          // `fail` moved the request to a new connection.
+          connection->request.reset();
+        }
+        release(std::move(connection));
+        continue;
+      }
+      active_.push_back(std::move(connection));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_active_requests_ = active_.size();
+    }
+    no_requests_.notify_all();
+  }
+
+  // Requests that are still outstanding are abandoned.
+  active_.clear();
+  idle_.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  new_requests_.clear();
+  num_active_requests_ = 0;
+  no_requests_.notify_all();
+}
+
+void SocketHTTPClientImpl::run_ring() {
+  std::list<std::unique_ptr<Request>> requests;
+  // Connections that are finished, but whose canceled operation has not yet
+  // completed.
+  std::vector<std::unique_ptr<Connection>> canceled;
+  bool wake_submitted = false;
+
+  // Submit the prepared operations, wait for any to complete, and note the
+  // completions.  Return false if waiting failed.
+  const auto wait = [&](std::chrono::milliseconds timeout) {
+    auto entered = ring_->submit_and_wait(timeout);
+    if (auto* error = entered.if_error()) {
+      logger_->log_error(error->with_prefix("SocketHTTPClient: "));
+      return false;
+    }
+    ring_->for_each_completion([&](std::uint64_t data, int result) {
+      if (data == wake_user_data) {
+        char discard[64];
+        while (::read(wake_read_, discard, sizeof discard) > 0) {
+        }
+        wake_submitted = false;
+        return;
+      }
+      if (data == cancel_user_data) {
+        return;
+      }
+      auto* connection =
+          reinterpret_cast<Connection*>(static_cast<std::uintptr_t>(data));
+      connection->submitted = false;
+      connection->completed = true;
+      connection->result = result;
+    });
+    canceled.erase(std::remove_if(canceled.begin(), canceled.end(),
+                                  [](const auto& connection) {
+                                    return !connection->submitted;
+                                  }),
+                   canceled.end());
+    return true;
+  };
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (shutting_down_) {
+        break;
+      }
+      requests.splice(requests.end(), new_requests_);
+      num_active_requests_ = active_.size() + requests.size();
+    }
+
+    for (; !requests.empty(); requests.pop_front()) {
+      start(std::move(requests.front()));
+    }
+
+    // Submit the next operation of each connection with a request, and wait
+    // on the wake-up pipe.  Idle connections are not watched.  If the server
+    // closed one, then reusing it fails, and the request is sent again on a
+    // new connection (see `fail`).
+    if (!wake_submitted) {
+      wake_submitted = ring_->prepare_poll(wake_read_, POLLIN, wake_user_data);
+    }
+    auto timeout = std::chrono::milliseconds(max_wait_milliseconds);
+    const auto now = clock_().tick;
+    for (const auto& connection : active_) {
+      if (!connection->submitted) {
+        submit(*connection);
+      }
+      const auto remaining =
+          std::chrono::ceil<std::chrono::milliseconds>(
+              connection->request->deadline - now);
+      timeout =
+          std::max(std::chrono::milliseconds(0), std::min(timeout, remaining));
+    }
+
+    wait(timeout);
+
+    // `handle_completion` can make `active_` grow, by sending a request again
+    // on a new connection, so iterate over the connections that were submitted
+    // only.
+    std::vector<std::unique_ptr<Connection>> submitted;
+    submitted.swap(active_);
+    const auto after_wait = clock_().tick;
+    for (auto& connection : submitted) {
+      bool keep = true;
+      if (connection->completed) {
+        connection->completed = false;
+        keep = handle_completion(*connection, connection->result);
+      }
+      if (keep && connection->request &&
+          after_wait >= connection->request->deadline) {
+        deliver_error(*connection,
+                      Error{Error::SOCKET_HTTP_CLIENT_DEADLINE_EXCEEDED,
+                            "Request deadline exceeded."});
+        keep = false;
+      }
+      if (!keep) {
+        if (connection->request) {
+          // `fail` moved the request to a new connection.
+          connection->request.reset();
+        }
+        if (connection->submitted) {
+          cancel(*connection);
+          canceled.push_back(std::move(connection));
+          continue;
+        }
+        release(std::move(connection));
+        continue;
+      }
+      active_.push_back(std::move(connection));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_active_requests_ = active_.size();
+    }
+    no_requests_.notify_all();
+  }
+
+  // Requests that are still outstanding are abandoned.  Their operations
+  // refer to their connections, so cancel the operations and wait for them to
+  // complete before destroying the connections.
+  for (auto& connection : active_) {
+    if (connection->submitted) {
+      cancel(*connection);
+      canceled.push_back(std::move(connection));
+    }
+  }
+  active_.clear();
+  if (wake_submitted) {
+    ring_->prepare_cancel(wake_user_data, cancel_user_data);
+  }
+  while ((wake_submitted || !canceled.empty()) &&
+         wait(std::chrono::milliseconds(max_wait_milliseconds))) {
+  }
+  idle_.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  new_requests_.clear();
+  num_active_requests_ = 0;
+  no_requests_.notify_all();
+}
+
+void SocketHTTPClientImpl::start(std::unique_ptr<Request> request) {
+  if (clock_().tick >= request->deadline) {
+    request->on_error(
+        Error{Error::SOCKET_HTTP_CLIENT_DEADLINE_EXCEEDED,
+              "Request deadline exceeded before the request was started."});
+    return;
+  }
+
+  std::unique_ptr<Connection> connection;
+  auto& idle = idle_[request->endpoint];
+  if (!idle.empty()) {
+    connection = std::move(idle.back());
+    idle.pop_back();
+    connection->reused = true;
+    ++connections_reused_;
+  } else {
+    auto opened = open(request->url);
+    if (auto* error = opened.if_error()) {
+      request->on_error(std::move(*error));
+      return;
+    }
+    connection = std::move(*opened);
+  }
+
+  connection->endpoint = request->endpoint;
+  begin(*connection, std::move(request));
+  active_.push_back(std::move(connection));
+}
+
+Expected<std::unique_ptr<SocketHTTPClientImpl::Connection>>
+SocketHTTPClientImpl::open(const HTTPClient::URL& url) {
+  auto connection = std::make_unique<Connection>();
+
+  if (is_unix_socket(url)) {
+    Address address{};
+    auto& unix_address = reinterpret_cast<sockaddr_un&>(address.storage);
+    if (url.authority.size() >= sizeof unix_address.sun_path) {
+      return Error{Error::SOCKET_HTTP_CLIENT_UNSUPPORTED_URL,
+                   "Unix domain socket path is too long: " + url.authority};
+    }
+    unix_address.sun_family = AF_UNIX;
+    std::memcpy(unix_address.sun_path, url.authority.c_str(),
+                url.authority.size() + 1);
+    address.length = sizeof unix_address;
+    connection->addresses.push_back(address);
+  } else {
+    // The authority is "host", "host:port", or "[IPv6 address]:port".
+    std::string host = url.authority;
+    std::string port = "80";
+    const auto bracket = host.rfind(']');
+    const auto colon = host.rfind(':');
+    if (colon != std::string::npos &&
+        (bracket == std::string::npos || colon > bracket)) {
+      port = host.substr(colon + 1);
+      host.erase(colon);
+    }
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    if (const int rc =
+            ::getaddrinfo(host.c_str(), port.c_str(), &hints, &results)) {
+      std::string message;
+      message += "Unable to resolve \"";
+      message += url.authority;
+      message += "\": ";
+      message += ::gai_strerror(rc);
+      return Error{Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE,
+                   std::move(message)};
+    }
+    for (const addrinfo* result = results; result; result = result->ai_next) {
+      Address address{};
+      std::memcpy(&address.storage, result->ai_addr, result->ai_addrlen);
+      address.length = static_cast<socklen_t>(result->ai_addrlen);
+      connection->addresses.push_back(address);
+    }
+    ::freeaddrinfo(results);
+    // Addresses are tried in order, so try them from the back.
+    std::reverse(connection->addresses.begin(), connection->addresses.end());
+  }
+
+  auto result = connect_next(*connection);
+  if (auto* error = result.if_error()) {
+    return std::move(*error);
+  }
+  ++connections_created_;
+  return connection;
+}
+
+Expected<void> SocketHTTPClientImpl::connect_next(Connection& connection) {
+  std::string message = "Unable to connect";
+  while (!connection.addresses.empty()) {
+    const Address address = connection.addresses.back();
+    connection.addresses.pop_back();
+    if (connection.fd != -1) {
+      ::close(connection.fd);
+    }
+
+    const int family = address.storage.ss_family;
+    connection.fd = ::socket(family, SOCK_STREAM, 0);
+    if (connection.fd == -1) {
+      message = errno_message("Unable to create a socket");
+      continue;
+    }
+    if (!set_nonblocking(connection.fd)) {
+      message = errno_message("Unable to configure a socket");
+      continue;
+    }
+#ifdef SO_NOSIGPIPE
+    const int enabled = 1;
+    ::setsockopt(connection.fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled,
+                 sizeof enabled);
+#endif
+    if (family != AF_UNIX) {
+      // Requests are written all at once, so do not delay sending them.
+      const int no_delay = 1;
+      ::setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &no_delay,
+                   sizeof no_delay);
+    }
+
+    if (::connect(connection.fd,
+                  reinterpret_cast<const sockaddr*>(&address.storage),
+                  address.length) == 0) {
+      connection.connecting = false;
+      return nullopt;
+    }
+    if (errno == EINPROGRESS || errno == EAGAIN) {
+      connection.connecting = true;
+      return nullopt;
+    }
+    message = errno_message("Unable to connect");
+  }
+  return Error{Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE, std::move(message)};
+}
+
+void SocketHTTPClientImpl::begin(Connection& connection,
+                                 std::unique_ptr<Request> request) {
+  connection.request = std::move(request);
+  connection.segment = 0;
+  connection.offset = 0;
+  connection.sending = true;
+  connection.received = false;
+  connection.response.reset();
+}
+
+bool SocketHTTPClientImpl::handle_events(Connection& connection,
+                                         short events) {
+  if (connection.connecting) {
+    if (!finish_connecting(connection)) {
+      return false;
+    }
+    if (connection.connecting) {
+      return true;
+    }
+  }
+
+  if (connection.sending) {
+    return send_request(connection);
+  }
+  if (events & (POLLIN | POLLHUP | POLLERR)) {
+    return receive_response(connection);
+  }
+  return true;
+}
+
+bool SocketHTTPClientImpl::finish_connecting(Connection& connection) {
+  int error = 0;
+  socklen_t length = sizeof error;
+  if (::getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length) !=
+      0) {
+    error = errno;
+  }
+  if (error != 0) {
+    errno = error;
+    std::string message = errno_message("Unable to connect");
+    if (connection.addresses.empty() || !connect_next(connection)) {
+      return fail(connection, std::move(message));
+    }
+    return true;
+  }
+  connection.connecting = false;
+  return true;
+}
+
+bool SocketHTTPClientImpl::send_request(Connection& connection) {
+  while (true) {
+    iovec buffers[max_send_buffers];
+    const std::size_t count = gather(connection, buffers);
+    if (count == 0) {
+      break;
+    }
+
+    msghdr message{};
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+    const ssize_t sent = ::sendmsg(connection.fd, &message, send_flags);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return true;
+      }
+      return fail(connection, errno_message("Unable to send request"));
+    }
+    advance(connection, static_cast<std::size_t>(sent));
+  }
+
+  connection.sending = false;
+  return true;
+}
+
+std::size_t SocketHTTPClientImpl::gather(const Connection& connection,
+                                         iovec* buffers) {
+  const Request& request = *connection.request;
+  const std::size_t num_segments = 1 + request.body.size();
+  std::size_t count = 0;
+  for (std::size_t i = connection.segment;
+       i < num_segments && count < max_send_buffers; ++i) {
+    const std::string& segment = i == 0 ? request.head : *request.body[i - 1];
+    const std::size_t offset = i == connection.segment ? connection.offset : 0;
+    if (segment.size() == offset) {
+      continue;
+    }
+    buffers[count].iov_base = const_cast<char*>(segment.data() + offset);
+    buffers[count].iov_len = segment.size() - offset;
+    ++count;
+  }
+  return count;
+}
+
+void SocketHTTPClientImpl::advance(Connection& connection, std::size_t sent) {
+  const Request& request = *connection.request;
+  const std::size_t num_segments = 1 + request.body.size();
+  while (connection.segment < num_segments) {
+    const std::string& segment = connection.segment == 0
+                                     ? request.head
+                                     : *request.body[connection.segment - 1];
+    const std::size_t available = segment.size() - connection.offset;
+    if (sent < available) {
+      connection.offset += sent;
+      break;
+    }
+    sent -= available;
+    ++connection.segment;
+    connection.offset = 0;
+  }
+}
+
+bool SocketHTTPClientImpl::receive_response(Connection& connection) {
+  std::string& buffer = connection.response.buffer;
+  while (true) {
+    const std::size_t size = buffer.size();
+    buffer.resize(size + read_size);
+    const ssize_t received =
+        ::recv(connection.fd, &buffer[size], read_size, 0);
+    buffer.resize(size + std::max<ssize_t>(received, 0));
+
+    if (received < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return true;
+      }
+      return fail(connection, errno_message("Unable to receive response"));
+    }
+    if (!receive(connection, static_cast<std::size_t>(received))) {
+      return false;
+    }
+  }
+}
+
+bool SocketHTTPClientImpl::receive(Connection& connection,
+                                   std::size_t received) {
+  if (received == 0) {
+    // The server closed the connection.
+    connection.response.keep_alive = false;
+    const auto result = connection.response.parse();
+    if (result == ResponseParser::Result::complete ||
+        (result == ResponseParser::Result::incomplete &&
+         connection.response.finish() == ResponseParser::Result::complete)) {
+      return complete(connection);
+    }
+    return fail(connection, connection.response.error);
+  }
+
+  connection.received = true;
+  switch (connection.response.parse()) {
+    case ResponseParser::Result::complete:
+      return complete(connection);
+    case ResponseParser::Result::invalid:
+      return fail(connection, connection.response.error);
+    case ResponseParser::Result::incomplete:
+      break;
+  }
+  return true;
+}
+
+void SocketHTTPClientImpl::submit(Connection& connection) {
+  if (connection.connecting || connection.await_ready) {
+    const bool want_output = connection.connecting || connection.sending;
+    connection.submitted = ring_->prepare_poll(
+        connection.fd, want_output ? POLLOUT : POLLIN, user_data(connection));
+    return;
+  }
+
+  if (connection.sending) {
+    const std::size_t count = gather(connection, connection.buffers);
+    if (count != 0) {
+      connection.message = msghdr{};
+      connection.message.msg_iov = connection.buffers;
+      connection.message.msg_iovlen = count;
+      connection.submitted =
+          ring_->prepare_sendmsg(connection.fd, &connection.message,
+                                 send_flags, user_data(connection));
+      return;
+    }
+    connection.sending = false;
+  }
+
+  std::string& buffer = connection.response.buffer;
+  connection.receive_offset = buffer.size();
+  buffer.resize(connection.receive_offset + read_size);
+  connection.submitted =
+      ring_->prepare_recv(connection.fd, &buffer[connection.receive_offset],
+                          read_size, user_data(connection));
+  if (!connection.submitted) {
+    buffer.resize(connection.receive_offset);
+  }
+}
+
+bool SocketHTTPClientImpl::handle_completion(Connection& connection,
+                                             int result) {
+  if (connection.connecting) {
+    return finish_connecting(connection);
+  }
+  if (connection.await_ready) {
+    connection.await_ready = false;
+    return true;
+  }
+
+  if (!connection.sending) {
+    connection.response.buffer.resize(connection.receive_offset +
+                                      std::max(result, 0));
+  }
+  if (result == -EAGAIN || result == -EINTR) {
+    connection.await_ready = result == -EAGAIN;
+    return true;
+  }
+  if (result < 0) {
+    errno = -result;
+    return fail(connection, errno_message(connection.sending
+                                              ? "Unable to send request"
+                                              : "Unable to receive response"));
+  }
+  if (connection.sending) {
+    advance(connection, static_cast<std::size_t>(result));
+    return true;
+  }
+  return receive(connection, static_cast<std::size_t>(result));
+}
+
+void SocketHTTPClientImpl::cancel(Connection& connection) {
+  // Shutting down the socket completes an operation that is already being
+  // performed, and so could not otherwise be canceled.
+  ::shutdown(connection.fd, SHUT_RDWR);
+  ring_->prepare_cancel(user_data(connection), cancel_user_data);
+}
+
+std::uint64_t SocketHTTPClientImpl::user_data(const Connection& connection) {
+  return static_cast<std::uint64_t>(
+      reinterpret_cast<std::uintptr_t>(&connection));
+}
+
+bool SocketHTTPClientImpl::complete(Connection& connection) {
+  auto request = std::move(connection.request);
+  auto& response = connection.response;
+  HeaderBlockReader reader{response.headers};
+  request->on_response(response.status, reader, std::move(response.body));
+  return false;
+}
+
+bool SocketHTTPClientImpl::fail(Connection& connection, std::string message) {
+  if (connection.reused && !connection.received) {
+    // The server probably closed the idle connection before the request
+    // reached it.  Send the request again on a new connection.
+    auto request = std::move(connection.request);
+    auto opened = open(request->url);
+    if (!opened) {
+      request->on_error(std::move(opened.error()));
+      return false;
+    }
+    auto& fresh = *opened;
+    fresh->endpoint = request->endpoint;
+    begin(*fresh, std::move(request));
+    active_.push_back(std::move(fresh));
+    return false;
+  }
+
+  deliver_error(connection,
+                Error{Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE,
+                      std::move(message)});
+  return false;
+}
+
+void SocketHTTPClientImpl::deliver_error(Connection& connection, Error error) {
+  auto request = std::move(connection.request);
+  // The connection is in an unknown state, so it must not be reused.
+  connection.response.keep_alive = false;
+  request->on_error(std::move(error));
+}
+
+void SocketHTTPClientImpl::release(std::unique_ptr<Connection> connection) {
+  if (!connection->response.keep_alive || connection->sending) {
+    return;
+  }
+  auto& idle = idle_[connection->endpoint];
+  if (idle.size() < max_idle_connections_per_endpoint) {
+    connection->reused = false;
+    idle.push_back(std::move(connection));
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
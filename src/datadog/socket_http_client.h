@@ -0,0 +1,74 @@
+#pragma once
+
+// This component provides a `class`, `SocketHTTPClient`, that implements the
+// `HTTPClient` interface directly in terms of POSIX sockets, without libcurl.
+// `class SocketHTTPClient` manages a thread that is used as its event loop.
+//
+// `SocketHTTPClient` speaks plain text HTTP/1.1, over either TCP ("http" URLs)
+// or a Unix domain socket ("unix" and "http+unix" URLs).  It does not support
+// TLS.  Connections are kept alive between requests, and reused by later
+// requests to the same endpoint.  Request headers are written directly into
+// the request's buffer, and request bodies are sent from the caller's buffers
+// without being copied.
+//
+// On Linux, `SocketHTTPClient` can instead use io_uring (see `io_uring.h`) for
+// its event loop, if `SocketHTTPClientOptions::io_uring` is true.  Then each
+// iteration of the event loop submits the sends, receives, and waits of all of
+// the connections in one system call.  If io_uring is unavailable, then
+// `poll` is used as usual.
+//
+// If this library was built with `DD_TRACE_TRANSPORT` set to "native", then
+// `default_http_client` returns a `SocketHTTPClient`.
+
+#include <datadog/clock.h>
+#include <datadog/http_client.h>
+#include <datadog/thread_options.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+class SocketHTTPClientImpl;
+
+struct SocketHTTPClientOptions {
+  // Whether to use io_uring rather than `poll`, where it is available.
+  bool io_uring = false;
+};
+
+class SocketHTTPClient : public HTTPClient {
+  SocketHTTPClientImpl* impl_;
+
+ public:
+  SocketHTTPClient(const std::shared_ptr<Logger>&, const Clock&);
+  // Create the event loop thread using the specified `ThreadGenerator`.
+  SocketHTTPClient(const std::shared_ptr<Logger>&, const Clock&,
+                   const ThreadGenerator&);
+  SocketHTTPClient(const std::shared_ptr<Logger>&, const Clock&,
+                   const SocketHTTPClientOptions&);
+  SocketHTTPClient(const std::shared_ptr<Logger>&, const Clock&,
+                   const ThreadGenerator&, const SocketHTTPClientOptions&);
+  ~SocketHTTPClient();
+
+  SocketHTTPClient(const SocketHTTPClient&) = delete;
+
+  Expected<void> post(const URL& url, HeadersSetter set_headers,
+                      std::string body, ResponseHandler on_response,
+                      ErrorHandler on_error,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+  Expected<void> post_segments(
+      const URL& url, HeadersSetter set_headers, BodySegments body,
+      ResponseHandler on_response, ErrorHandler on_error,
+      std::chrono::steady_clock::time_point deadline) override;
+
+  void drain(std::chrono::steady_clock::time_point deadline) override;
+
+  std::string config() const override;
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -1,70 +1,280 @@
+#include <datadog/dict_reader.h>
 #include <datadog/dict_writer.h>
 #include <datadog/optional.h>
 #include <datadog/span.h>
 #include <datadog/span_config.h>
+#include <datadog/span_context.h>
+#include <datadog/span_event.h>
+#include <datadog/span_link.h>
 #include <datadog/string_view.h>
 #include <datadog/trace_segment.h>
 
 #include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "header_tags.h"
 #include "span_data.h"
+#include "stack_trace.h"
+#include "string_util.h"
 #include "tags.h"
+#include "usdt.h"
 
 namespace datadog {
 namespace tracing {
 
-Span::Span(SpanData* data, const std::shared_ptr<TraceSegment>& trace_segment,
-           const std::function<std::uint64_t()>& generate_span_id,
-           const Clock& clock)
-    : trace_segment_(trace_segment),
+// Spans are moved often, e.g. through the frames of coroutines, so a `Span`
+// ought to remain a handle of a few pointers.
+static_assert(sizeof(Span) <= 5 * sizeof(void*),
+              "Span has grown beyond a few pointers.");
+
+namespace {
+
+// `Writing` holds the write guard of a span (see `SpanWriteGuard`) while it
+// lives, if the span's segment might be flushed while the span is in use.  It
+// converts to false if the segment was flushed, after which the span is not
+// written.
+class Writing {
+  SpanWriteGuard* guard_ = nullptr;
+  bool allowed_ = true;
+
+ public:
+  Writing(const TraceSegment& segment, SpanData& span) {
+    if (segment.flushes_orphans()) {
+      allowed_ = span.write_guard.begin_write();
+      if (allowed_) {
+        guard_ = &span.write_guard;
+      }
+    }
+  }
+  Writing(const Writing&) = delete;
+  Writing& operator=(const Writing&) = delete;
+  ~Writing() {
+    if (guard_) {
+      guard_->end_write();
+    }
+  }
+
+  explicit operator bool() const { return allowed_; }
+};
+
+// Record that the specified `span`, of the specified `segment`, might be the
+// parent of another span (see `SpanData::has_children`).
+void mark_as_parent(const TraceSegment& segment, SpanData& span) {
+  if (span.has_children) {
+    return;
+  }
+  const Writing writing{segment, span};
+  if (writing) {
+    span.has_children = true;
+  }
+}
+
+}  // namespace
+
+Span::Span(SpanData* data, std::shared_ptr<TraceSegment> trace_segment,
+           std::size_t segment_index)
+    : trace_segment_(std::move(trace_segment)),
       data_(data),
-      generate_span_id_(generate_span_id),
-      clock_(clock) {
+      segment_index_(segment_index) {
   assert(trace_segment_);
   assert(data_);
-  assert(generate_span_id_);
-  assert(clock_);
+  DD_USDT_PROBE(span__start, data_->trace_id.low, data_->span_id,
+                data_->parent_id);
 }
 
+Span::Span(Span&&) = default;
+
 Span::~Span() {
   if (!trace_segment_) {
     // We were moved from.
     return;
   }
+  if (unrecorded_) {
+    trace_segment_->unrecorded_span_finished();
+    delete data_;
+    return;
+  }
 
-  if (end_time_) {
-    data_->duration = *end_time_ - data_->start.tick;
-  } else {
-    const auto now = clock_();
-    data_->duration = now - data_->start;
+  if (!has_end_time_) {
+    const Writing writing{*trace_segment_, *data_};
+    if (writing) {
+      data_->duration = trace_segment_->clock()() - data_->start;
+    }
   }
 
-  trace_segment_->span_finished();
+  DD_USDT_PROBE(span__finish, data_->trace_id.low, data_->span_id,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    data_->duration)
+                    .count());
+  trace_segment_->span_finished(segment_index_);
 }
 
-Span Span::create_child(const SpanConfig& config) const {
-  auto span_data = std::make_unique<SpanData>();
-  span_data->apply_config(trace_segment_->defaults(), config, clock_);
-  span_data->trace_id = data_->trace_id;
-  span_data->parent_id = data_->span_id;
-  span_data->span_id = generate_span_id_();
+template <typename Config>
+Span Span::create_child_with_config(
+    const std::shared_ptr<TraceSegment>& trace_segment, TraceID trace_id,
+    std::uint64_t parent_id, Arena* arena, const Config& config) {
+  if (trace_segment->skips_new_spans()) {
+    // The child would be discarded anyway, so it keeps only what is needed
+    // to propagate trace context.
+    auto span_data = SpanData::make(nullptr);
+    span_data->trace_id = trace_id;
+    span_data->parent_id = parent_id;
+    span_data->span_id = trace_segment->generate_span_id();
+    trace_segment->register_unrecorded_span();
+    Span child(span_data.release(), trace_segment);
+    child.unrecorded_ = true;
+    return child;
+  }
+
+  // The child shares its parent's arena, if any.
+  auto span_data = SpanData::make(arena);
+  span_data->apply_config(trace_segment->defaults(),
+                          trace_segment->span_limits(), config,
+                          trace_segment->clock());
+  span_data->trace_id = trace_id;
+  span_data->parent_id = parent_id;
+  span_data->span_id = trace_segment->generate_span_id();
 
   const auto span_data_ptr = span_data.get();
-  trace_segment_->register_span(std::move(span_data));
-  return Span(span_data_ptr, trace_segment_, generate_span_id_, clock_);
+  const std::size_t index = trace_segment->register_span(std::move(span_data));
+  return Span(span_data_ptr, trace_segment, index);
+}
+
+Span Span::create_child(const SpanConfig& config) const {
+  mark_as_parent(*trace_segment_, *data_);
+  return create_child_with_config(trace_segment_, data_->trace_id,
+                                  data_->span_id, data_->arena(), config);
+}
+
+Span Span::create_child(const SpanConfigView& config) const {
+  mark_as_parent(*trace_segment_, *data_);
+  return create_child_with_config(trace_segment_, data_->trace_id,
+                                  data_->span_id, data_->arena(), config);
 }
 
-Span Span::create_child() const { return create_child(SpanConfig{}); }
+Span Span::create_child() const { return create_child(SpanConfigView{}); }
+
+template <typename Config>
+std::vector<Span> Span::create_children_with_config(
+    std::size_t count, const Config& config) const {
+  std::vector<Span> children;
+  children.reserve(count);
+  mark_as_parent(*trace_segment_, *data_);
+  // The IDs and data of the children are kept in storage that is reused by
+  // later calls on this thread.
+  thread_local std::vector<std::uint64_t> ids;
+  thread_local std::vector<std::unique_ptr<SpanData>> batch;
+  ids.resize(count);
+  trace_segment_->generate_span_ids(ids.data(), count);
+
+  if (trace_segment_->skips_new_spans()) {
+    // See `create_child_with_config`.
+    trace_segment_->register_unrecorded_span(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      auto span_data = SpanData::make(nullptr);
+      span_data->trace_id = data_->trace_id;
+      span_data->parent_id = data_->span_id;
+      span_data->span_id = ids[i];
+      children.push_back(Span(span_data.release(), trace_segment_));
+      children.back().unrecorded_ = true;
+    }
+    return children;
+  }
+
+  // The children share their parent's arena, if any, and the clock is read
+  // once for all of them.
+  const TimePoint start = trace_segment_->clock()();
+  const Clock clock = [start]() { return start; };
+  batch.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    auto span_data = SpanData::make(data_->arena());
+    span_data->apply_config(trace_segment_->defaults(),
+                            trace_segment_->span_limits(), config, clock);
+    span_data->trace_id = data_->trace_id;
+    span_data->parent_id = data_->span_id;
+    span_data->span_id = ids[i];
+    children.push_back(Span(span_data.get(), trace_segment_));
+    batch.push_back(std::move(span_data));
+  }
+
+  // The children learn their indices once they are registered.
+  const std::size_t first = trace_segment_->register_spans(batch.data(), count);
+  for (std::size_t i = 0; i < count; ++i) {
+    children[i].segment_index_ = first + i;
+  }
+  batch.clear();
+  return children;
+}
+
+std::vector<Span> Span::create_children(std::size_t count,
+                                        const SpanConfig& config) const {
+  return create_children_with_config(count, config);
+}
+
+std::vector<Span> Span::create_children(std::size_t count,
+                                        const SpanConfigView& config) const {
+  return create_children_with_config(count, config);
+}
+
+std::vector<Span> Span::create_children(std::size_t count) const {
+  return create_children(count, SpanConfigView{});
+}
+
+Span Span::create_child_of(const SpanContext& parent,
+                           const SpanConfig& config) {
+  return create_child_with_config(parent.segment(), parent.trace_id_,
+                                  parent.span_id_, parent.arena(), config);
+}
+
+Span Span::create_child_of(const SpanContext& parent,
+                           const SpanConfigView& config) {
+  return create_child_with_config(parent.segment(), parent.trace_id_,
+                                  parent.span_id_, parent.arena(), config);
+}
+
+SpanContext Span::context() const {
+  mark_as_parent(*trace_segment_, *data_);
+  return SpanContext(trace_segment_, data_->trace_id, data_->span_id,
+                     data_->arena());
+}
 
 void Span::inject(DictWriter& writer) const {
+  mark_as_parent(*trace_segment_, *data_);
   trace_segment_->inject(writer, *data_);
 }
 
 void Span::inject(DictWriter& writer, const InjectionOptions& options) const {
+  mark_as_parent(*trace_segment_, *data_);
   trace_segment_->inject(writer, *data_, options);
 }
 
+void Span::inject_all(const std::vector<Injection>& injections) {
+  // The batch passed to each segment is kept in storage that is reused by
+  // later calls on this thread.
+  thread_local std::vector<TraceSegment::Injection> batch;
+  for (std::size_t begin = 0; begin != injections.size();) {
+    TraceSegment* const segment = injections[begin].span->trace_segment_.get();
+    batch.clear();
+    std::size_t end = begin;
+    for (; end != injections.size() &&
+           injections[end].span->trace_segment_.get() == segment;
+         ++end) {
+      const Injection& injection = injections[end];
+      mark_as_parent(*segment, *injection.span->data_);
+      batch.push_back(
+          TraceSegment::Injection{injection.span->data_, injection.writer});
+    }
+    segment->inject(batch.data(), batch.size());
+    begin = end;
+  }
+}
+
 std::uint64_t Span::id() const { return data_->span_id; }
 
 TraceID Span::trace_id() const { return data_->trace_id; }
@@ -89,7 +299,7 @@ const std::string& Span::name() const { return data_->name; }
 const std::string& Span::resource_name() const { return data_->resource; }
 
 Optional<StringView> Span::lookup_tag(StringView name) const {
-  const auto found = data_->tags.find(std::string(name));
+  const auto found = data_->tags.find(name);
   if (found == data_->tags.end()) {
     return nullopt;
   }
@@ -97,71 +307,422 @@ Optional<StringView> Span::lookup_tag(StringView name) const {
 }
 
 Optional<double> Span::lookup_metric(StringView name) const {
-  const auto found = data_->numeric_tags.find(std::string(name));
+  const auto found = data_->numeric_tags.find(name);
   if (found == data_->numeric_tags.end()) {
     return nullopt;
   }
   return found->second;
 }
 
+namespace {
+
+// The size counted in `SpanData::byte_size` for the value of a numeric tag.
+constexpr std::size_t numeric_tag_size = 8;
+
+// Set the tag having the specified `name` in the specified `span` to the
+// specified `value`, reusing the storage of the previous value, if any.  Keep
+// `SpanData::byte_size` up to date.
+void put_tag(SpanData& span, StringView name, StringView value) {
+  const auto found = span.tags.find(name);
+  if (found != span.tags.end()) {
+    span.byte_size = span.byte_size - found->second.size() + value.size();
+    assign(found->second, value);
+  } else {
+    span.byte_size += name.size() + value.size();
+    span.tags.emplace(name, value);
+  }
+}
+
+// Remove the tag having the specified `name`, if any, from the specified
+// `span`.  Keep `SpanData::byte_size` up to date.
+void erase_tag(SpanData& span, StringView name) {
+  const auto found = span.tags.find(name);
+  if (found != span.tags.end()) {
+    span.byte_size -= found->first.size() + found->second.size();
+    span.tags.erase(name);
+  }
+}
+
+// Set the numeric tag having the specified `name` in the specified `span` to
+// the specified `value`.  Keep `SpanData::byte_size` up to date.
+void put_metric(SpanData& span, StringView name, double value) {
+  if (span.numeric_tags.insert_or_assign(name, value).second) {
+    span.byte_size += name.size() + numeric_tag_size;
+  }
+}
+
+// Set the specified `field` of the specified `span` to the specified `value`.
+// Keep `SpanData::byte_size` up to date.
+void put_field(SpanData& span, InternedString& field, StringView value) {
+  span.byte_size = span.byte_size - field.size() + value.size();
+  field = value;
+}
+
+// Set the tag having the specified `name` in the specified `span` to the
+// decimal representation of the specified `value`.
+template <typename Integer>
+void set_integer(SpanData& span, StringView name, Integer value) {
+  // Enough for any 64-bit integer, including its sign.
+  char buffer[20];
+  const auto result =
+      std::to_chars(std::begin(buffer), std::end(buffer), value);
+  put_tag(span, name, StringView(buffer, result.ptr - buffer));
+}
+
+}  // namespace
+
 void Span::set_tag(StringView name, StringView value) {
-  data_->tags.insert_or_assign(std::string(name), std::string(value));
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  put_tag(*data_, name,
+          truncate_utf8(value,
+                        trace_segment_->span_limits().max_tag_value_length));
+}
+
+void Span::set_integer_tag(StringView name, std::int64_t value) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  set_integer(*data_, name, value);
+}
+
+void Span::set_integer_tag(StringView name, std::uint64_t value) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  set_integer(*data_, name, value);
 }
 
 void Span::set_metric(StringView name, double value) {
-  data_->numeric_tags.insert_or_assign(std::string(name), value);
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  put_metric(*data_, name, value);
 }
 
-void Span::remove_tag(StringView name) { data_->tags.erase(std::string(name)); }
+void Span::set_tags(
+    std::initializer_list<std::pair<StringView, StringView>> tags) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  const std::size_t max_length =
+      trace_segment_->span_limits().max_tag_value_length;
+  data_->tags.reserve(data_->tags.size() + tags.size());
+  for (const auto& [name, value] : tags) {
+    put_tag(*data_, name, truncate_utf8(value, max_length));
+  }
+}
+
+void Span::set_schema_tags(const StringView* keys, const StringView* values,
+                           std::uint32_t present) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  const std::size_t max_length =
+      trace_segment_->span_limits().max_tag_value_length;
+  auto& tags = data_->tags;
+  // An integration usually sets its schema's tags first.  The keys of a
+  // schema are distinct, so then none of them needs to be looked up.
+  const bool fresh = tags.empty();
+  std::size_t count = 0;
+  for (std::uint32_t bits = present; bits != 0; bits &= bits - 1) {
+    ++count;
+  }
+  tags.reserve(tags.size() + count);
+  for (std::size_t i = 0; present >> i != 0; ++i) {
+    if (!(present & (std::uint32_t(1) << i))) {
+      continue;
+    }
+    const StringView value = truncate_utf8(values[i], max_length);
+    if (fresh) {
+      data_->byte_size += keys[i].size() + value.size();
+      tags.append_unique(keys[i], value);
+    } else {
+      put_tag(*data_, keys[i], value);
+    }
+  }
+}
+
+void Span::set_metrics(
+    std::initializer_list<std::pair<StringView, double>> metrics) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  data_->numeric_tags.reserve(data_->numeric_tags.size() + metrics.size());
+  for (const auto& [name, value] : metrics) {
+    put_metric(*data_, name, value);
+  }
+}
+
+void Span::add_link(SpanLink link) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  data_->links.push_back(std::move(link));
+}
+
+void Span::add_link(
+    const Span& other,
+    std::initializer_list<std::pair<StringView, StringView>> attributes) {
+  if (unrecorded_) {
+    return;
+  }
+  // The decision is looked up first, since it locks the other span's
+  // segment, which might be this span's.
+  const auto decision = other.trace_segment_->sampling_decision();
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  auto& link = data_->links.emplace_back();
+  link.trace_id = other.trace_id();
+  link.span_id = other.id();
+  if (decision) {
+    link.flags = decision->priority > 0 ? 1 : 0;
+  }
+  link.attributes.reserve(attributes.size());
+  for (const auto& [name, value] : attributes) {
+    link.attributes.emplace_back(std::string(name), std::string(value));
+  }
+}
+
+void Span::add_event(SpanEvent event) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  data_->events.push_back(std::move(event));
+}
+
+void Span::add_event(
+    StringView name,
+    std::initializer_list<std::pair<StringView, StringView>> attributes) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  auto& event = data_->events.emplace_back();
+  assign(event.name, name);
+  event.time = trace_segment_->clock()().wall;
+  event.attributes.reserve(attributes.size());
+  for (const auto& [key, value] : attributes) {
+    event.attributes.emplace_back(std::string(key), std::string(value));
+  }
+}
+
+void Span::remove_tag(StringView name) {
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  erase_tag(*data_, name);
+}
 
 void Span::remove_metric(StringView name) {
-  data_->numeric_tags.erase(std::string(name));
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  const auto found = data_->numeric_tags.find(name);
+  if (found != data_->numeric_tags.end()) {
+    data_->byte_size -= found->first.size() + numeric_tag_size;
+    data_->numeric_tags.erase(name);
+  }
 }
 
 void Span::set_service_name(StringView service) {
-  assign(data_->service, service);
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  put_field(*data_, data_->service, service);
 }
 
 void Span::set_service_type(StringView type) {
-  assign(data_->service_type, type);
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  put_field(*data_, data_->service_type, type);
 }
 
 void Span::set_resource_name(StringView resource) {
-  assign(data_->resource, resource);
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  const std::size_t max_length =
+      trace_segment_->span_limits().max_resource_length;
+  put_field(*data_, data_->resource, truncate_utf8(resource, max_length));
 }
 
 void Span::set_error(bool is_error) {
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
   data_->error = is_error;
   if (!is_error) {
-    data_->tags.erase("error.message");
-    data_->tags.erase("error.type");
+    erase_tag(*data_, "error.message");
+    erase_tag(*data_, "error.type");
+    if (data_->error_stack) {
+      data_->error_stack->size = 0;
+    }
   }
 }
 
 void Span::set_error_message(StringView message) {
-  data_->error = true;
-  data_->tags.insert_or_assign("error.message", std::string(message));
+  {
+    const Writing writing{*trace_segment_, *data_};
+    if (!writing) {
+      return;
+    }
+    data_->error = true;
+  }
+  set_tag("error.message", message);
 }
 
 void Span::set_error_type(StringView type) {
-  data_->error = true;
-  data_->tags.insert_or_assign("error.type", std::string(type));
+  {
+    const Writing writing{*trace_segment_, *data_};
+    if (!writing) {
+      return;
+    }
+    data_->error = true;
+  }
+  set_tag("error.type", type);
 }
 
 void Span::set_error_stack(StringView type) {
+  {
+    const Writing writing{*trace_segment_, *data_};
+    if (!writing) {
+      return;
+    }
+    data_->error = true;
+  }
+  set_tag(tags::error_stack, type);
+}
+
+void Span::capture_error_stack() {
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
   data_->error = true;
-  data_->tags.insert_or_assign("error.stack", std::string(type));
+  if (unrecorded_) {
+    return;
+  }
+  // Skip this function's own frame.
+  capture_stack(data_->error_stack.get_or_create(), 1);
 }
 
-void Span::set_name(StringView value) { assign(data_->name, value); }
+void Span::set_response_header_tags(const DictReader& headers) {
+  const HeaderTags* const header_tags = trace_segment_->header_tags();
+  if (unrecorded_ || !header_tags) {
+    return;
+  }
+  const auto& entries = header_tags->entries();
+  if (!headers.prefers_visit()) {
+    for (const auto& entry : entries) {
+      if (const auto value = headers.lookup(entry.header)) {
+        set_tag(entry.response_tag, *value);
+      }
+    }
+    return;
+  }
+  // Only the first occurrence of each header is used.  There are at most
+  // `HeaderTags::max_headers`.
+  std::uint64_t seen = 0;
+  headers.visit([&](StringView key, StringView value) {
+    const std::size_t index = header_tags->find(key);
+    if (index == HeaderTags::npos) {
+      return;
+    }
+    const std::uint64_t bit = std::uint64_t(1) << index;
+    if (seen & bit) {
+      return;
+    }
+    seen |= bit;
+    set_tag(entries[index].response_tag, value);
+  });
+}
+
+void Span::set_name(StringView value) {
+  if (unrecorded_) {
+    return;
+  }
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  put_field(*data_, data_->name, value);
+}
 
 void Span::set_end_time(std::chrono::steady_clock::time_point end_time) {
-  end_time_ = end_time;
+  has_end_time_ = true;
+  const Writing writing{*trace_segment_, *data_};
+  if (!writing) {
+    return;
+  }
+  data_->duration = end_time - data_->start.tick;
 }
 
 void Span::set_source(Source source) {
-  trace_segment_->local_root().tags.emplace(tags::internal::trace_source,
-                                            to_tag(source));
+  SpanData& local_root = trace_segment_->local_root();
+  const Writing writing{*trace_segment_, local_root};
+  if (!writing) {
+    return;
+  }
+  local_root.tags.emplace(tags::internal::trace_source, to_tag(source));
 }
 
 TraceSegment& Span::trace_segment() { return *trace_segment_; }
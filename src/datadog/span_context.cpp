@@ -0,0 +1,73 @@
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/span_context.h>
+#include <datadog/trace_segment.h>
+
+#include <cassert>
+#include <utility>
+
+#include "arena.h"
+
+namespace datadog {
+namespace tracing {
+
+struct SpanContext::Hold {
+  std::shared_ptr<TraceSegment> trace_segment;
+  Arena* arena;
+
+  Hold(std::shared_ptr<TraceSegment> trace_segment, Arena* arena)
+      : trace_segment(std::move(trace_segment)), arena(arena) {
+    this->trace_segment->register_unrecorded_span();
+    if (arena) {
+      arena->retain();
+    }
+  }
+
+  Hold(const Hold&) = delete;
+  Hold& operator=(const Hold&) = delete;
+
+  ~Hold() {
+    // The segment might complete here, in which case its spans, and perhaps
+    // the arena's other references, are released first.
+    trace_segment->unrecorded_span_finished();
+    if (arena) {
+      arena->release();
+    }
+  }
+};
+
+SpanContext::SpanContext(std::shared_ptr<TraceSegment> trace_segment,
+                         TraceID trace_id, std::uint64_t span_id, Arena* arena)
+    : trace_id_(trace_id), span_id_(span_id) {
+  assert(trace_segment);
+  hold_ = std::make_shared<const Hold>(std::move(trace_segment), arena);
+}
+
+const std::shared_ptr<TraceSegment>& SpanContext::segment() const {
+  return hold_->trace_segment;
+}
+
+Arena* SpanContext::arena() const { return hold_->arena; }
+
+Span SpanContext::create_child(const SpanConfig& config) const {
+  return Span::create_child_of(*this, config);
+}
+
+Span SpanContext::create_child(const SpanConfigView& config) const {
+  return Span::create_child_of(*this, config);
+}
+
+Span SpanContext::create_child() const {
+  return create_child(SpanConfigView{});
+}
+
+std::uint64_t SpanContext::id() const { return span_id_; }
+
+TraceID SpanContext::trace_id() const { return trace_id_; }
+
+TraceSegment& SpanContext::trace_segment() const {
+  return *hold_->trace_segment;
+}
+
+}  // namespace tracing
+}  // namespace datadog
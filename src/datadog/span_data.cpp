@@ -5,19 +5,27 @@
 #include <datadog/span_defaults.h>
 #include <datadog/string_view.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <string>
 
+#include "hex.h"
+#include "json_writer.h"
 #include "msgpack.h"
+#include "span_recycler.h"
+#include "string_util.h"
 #include "tags.h"
+#include "utf8.h"
 
 namespace datadog {
 namespace tracing {
 namespace {
 
-Optional<StringView> lookup(
-    const std::string& key,
-    const std::unordered_map<std::string, std::string>& map) {
+Optional<StringView> lookup(const std::string& key, const SpanTags& map) {
   const auto found = map.find(key);
   if (found != map.end()) {
     return found->second;
@@ -25,8 +33,362 @@ Optional<StringView> lookup(
   return nullopt;
 }
 
+// `AllocationHeader` precedes every `SpanData` in memory.  Its size preserves
+// the alignment of the object that follows it.
+struct alignas(std::max_align_t) AllocationHeader {
+  Arena* arena;
+};
+
+AllocationHeader& header_of(const void* object) {
+  return *(static_cast<AllocationHeader*>(const_cast<void*>(object)) - 1);
+}
+
+const std::string no_shared_tags;
+
+// `PackedKey` is the MessagePack encoding of a key of the map that encodes a
+// span.  The keys are shorter than 32 bytes, so each is a "fixstr": a byte
+// holding the length of the key, followed by the key.  `msgpack_encode` copies
+// the encodings, which are computed at compile time, rather than encoding the
+// keys for every span.
+template <std::size_t Size>
+struct PackedKey {
+  char bytes[Size] = {};
+
+  // Encode the specified `key`, preceded by the MessagePack header of a map
+  // having the specified `map_size` entries, unless `map_size` is zero.
+  template <std::size_t KeySize>
+  constexpr explicit PackedKey(const char (&key)[KeySize],
+                               std::size_t map_size = 0) {
+    static_assert(KeySize - 1 < 32, "a fixstr is shorter than 32 bytes");
+    std::size_t i = 0;
+    if (map_size) {
+      bytes[i++] = char(0x80 | map_size);  // fixmap
+    }
+    bytes[i++] = char(0xA0 | (KeySize - 1));  // fixstr
+    for (std::size_t j = 0; j < KeySize - 1; ++j) {
+      bytes[i++] = key[j];
+    }
+  }
+};
+
+namespace keys {
+// A span is encoded as a map having this many entries, plus one for each of
+// "span_links" and "span_events" if the span has links or events.
+constexpr std::size_t count = 12;
+static_assert(count + 2 < 16, "the span map is a fixmap");
+
+// The map header is encoded together with the first key.
+constexpr PackedKey<sizeof "service" + 1> map_and_service{"service", count};
+constexpr PackedKey<sizeof "name"> name{"name"};
+constexpr PackedKey<sizeof "resource"> resource{"resource"};
+constexpr PackedKey<sizeof "trace_id"> trace_id{"trace_id"};
+constexpr PackedKey<sizeof "span_id"> span_id{"span_id"};
+constexpr PackedKey<sizeof "parent_id"> parent_id{"parent_id"};
+constexpr PackedKey<sizeof "start"> start{"start"};
+constexpr PackedKey<sizeof "duration"> duration{"duration"};
+constexpr PackedKey<sizeof "error"> error{"error"};
+constexpr PackedKey<sizeof "meta"> meta{"meta"};
+constexpr PackedKey<sizeof "metrics"> metrics{"metrics"};
+constexpr PackedKey<sizeof "type"> type{"type"};
+
+constexpr std::size_t total_size =
+    sizeof map_and_service + sizeof name + sizeof resource + sizeof trace_id +
+    sizeof span_id + sizeof parent_id + sizeof start + sizeof duration +
+    sizeof error + sizeof meta + sizeof metrics + sizeof type;
+
+constexpr PackedKey<sizeof "span_links"> span_links{"span_links"};
+constexpr PackedKey<sizeof "span_events"> span_events{"span_events"};
+
+// The keys of the map that encodes a span link.
+namespace link {
+constexpr PackedKey<sizeof "trace_id"> trace_id{"trace_id"};
+constexpr PackedKey<sizeof "trace_id_high"> trace_id_high{"trace_id_high"};
+constexpr PackedKey<sizeof "span_id"> span_id{"span_id"};
+constexpr PackedKey<sizeof "attributes"> attributes{"attributes"};
+constexpr PackedKey<sizeof "tracestate"> tracestate{"tracestate"};
+constexpr PackedKey<sizeof "flags"> flags{"flags"};
+
+constexpr std::size_t total_size = sizeof trace_id + sizeof trace_id_high +
+                                   sizeof span_id + sizeof attributes +
+                                   sizeof tracestate + sizeof flags;
+}  // namespace link
+
+// The keys of the map that encodes a span event, and of the map that encodes
+// each of its attribute values.
+namespace event {
+constexpr PackedKey<sizeof "name"> name{"name"};
+constexpr PackedKey<sizeof "time_unix_nano"> time_unix_nano{"time_unix_nano"};
+constexpr PackedKey<sizeof "attributes"> attributes{"attributes"};
+constexpr PackedKey<sizeof "type"> type{"type"};
+constexpr PackedKey<sizeof "string_value"> string_value{"string_value"};
+
+constexpr std::size_t total_size =
+    sizeof name + sizeof time_unix_nano + sizeof attributes;
+constexpr std::size_t attribute_size = sizeof type + sizeof string_value;
+}  // namespace event
+}  // namespace keys
+
+// Return an upper bound of the size of the encoding of the specified `span`,
+// whose shared tags are encoded in the specified `packed_shared_size` bytes,
+// assuming the widest encoding of each header and number.  Each string is
+// counted as repaired, if it is not valid UTF-8, and the specified `repair`
+// is set to true if any is not.  Return an error if a string in `span` is too
+// large to be encoded.
+Expected<std::size_t> max_encoded_size(const SpanData& span,
+                                       std::size_t packed_shared_size,
+                                       bool& repair) {
+  using msgpack::Writer;
+  static_assert(Writer::max_integer_size >= Writer::max_header_size &&
+                    Writer::max_double_size == Writer::max_integer_size,
+                "every header and number fits in max_integer_size");
+  constexpr std::size_t max_item = Writer::max_integer_size;
+  constexpr std::size_t max_string = std::numeric_limits<std::uint32_t>::max();
+
+  std::size_t size = keys::total_size + packed_shared_size + 12 * max_item;
+  std::size_t longest = 0;
+  const auto add_string = [&](const std::string& value) {
+    // Most strings are ASCII, which is checked 32 bytes at a time.
+    const std::size_t repaired = repaired_utf8_size(value);
+    repair |= repaired != value.size();
+    size += repaired;
+    longest = std::max(longest, repaired);
+  };
+  add_string(span.service);
+  add_string(span.name);
+  add_string(span.resource);
+  add_string(span.service_type);
+  for (const auto& [key, value] : span.tags) {
+    add_string(key);
+    add_string(value);
+    size += 2 * max_item;
+  }
+  for (const auto& entry : span.numeric_tags) {
+    add_string(entry.first);
+    size += 2 * max_item;
+  }
+  const auto add_attributes = [&](const auto& attributes,
+                                  std::size_t value_overhead) {
+    for (const auto& [key, value] : attributes) {
+      add_string(key);
+      add_string(value);
+      size += 2 * max_item + value_overhead;
+    }
+  };
+  if (!span.links.empty()) {
+    size += sizeof keys::span_links + max_item;
+    for (const auto& link : span.links) {
+      size += keys::link::total_size + 7 * max_item;
+      add_string(link.tracestate);
+      add_attributes(link.attributes, 0);
+    }
+  }
+  if (!span.events.empty()) {
+    size += sizeof keys::span_events + max_item;
+    for (const auto& event : span.events) {
+      size += keys::event::total_size + 4 * max_item;
+      add_string(event.name);
+      // Each value is a map of its type and the string.
+      add_attributes(event.attributes,
+                     keys::event::attribute_size + 2 * max_item);
+    }
+  }
+
+  if (longest > max_string) {
+    return Error{Error::MESSAGEPACK_ENCODE_FAILURE,
+                 "Cannot msgpack encode a span having a string of size " +
+                     std::to_string(longest) +
+                     ", which exceeds the protocol maximum of " +
+                     std::to_string(max_string) + '.'};
+  }
+  return size;
+}
+
+// Write to the specified `writer` a map consisting of the elements of the
+// specified `tags` followed by the `count` elements already encoded in the
+// specified `packed_shared_tags`.  Write each value of `tags` using the
+// specified `pack_value`.
+template <typename Map, typename PackValue>
+void pack_tags(msgpack::Writer& writer, const Map& tags, std::size_t count,
+               const std::string& packed_shared_tags, PackValue&& pack_value) {
+  writer.pack_map(tags.size() + count);
+  for (const auto& [key, value] : tags) {
+    writer.pack_string(key);
+    pack_value(writer, value);
+  }
+  writer.append(packed_shared_tags.data(), packed_shared_tags.size());
+}
+
+template <typename Key>
+void append_key(msgpack::Writer& writer, const Key& key) {
+  writer.append(key.bytes, sizeof key.bytes);
+}
+
+std::uint64_t unix_nanoseconds(std::chrono::system_clock::time_point time) {
+  return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           time.time_since_epoch())
+                           .count());
+}
+
+// Write to the specified `writer` an array of the specified `links`.  Each
+// link is a map whose optional entries are omitted when they are empty.
+void pack_links(msgpack::Writer& writer, const SpanLinks& links) {
+  namespace key = keys::link;
+  writer.pack_array(links.size());
+  for (const auto& link : links) {
+    const bool has_high = link.trace_id.high != 0;
+    const bool has_attributes = !link.attributes.empty();
+    const bool has_tracestate = !link.tracestate.empty();
+    const bool has_flags = bool(link.flags);
+    writer.pack_map(2 + has_high + has_attributes + has_tracestate +
+                    has_flags);
+    append_key(writer, key::trace_id);
+    writer.pack_integer(link.trace_id.low);
+    if (has_high) {
+      append_key(writer, key::trace_id_high);
+      writer.pack_integer(link.trace_id.high);
+    }
+    append_key(writer, key::span_id);
+    writer.pack_integer(link.span_id);
+    if (has_attributes) {
+      append_key(writer, key::attributes);
+      writer.pack_map(link.attributes.size());
+      for (const auto& [name, value] : link.attributes) {
+        writer.pack_string(name);
+        writer.pack_string(value);
+      }
+    }
+    if (has_tracestate) {
+      append_key(writer, key::tracestate);
+      writer.pack_string(link.tracestate);
+    }
+    if (has_flags) {
+      append_key(writer, key::flags);
+      // The high bit indicates that the flags are set, so that zero flags can
+      // be distinguished from no flags.
+      writer.pack_integer(std::uint32_t(*link.flags | 0x80000000u));
+    }
+  }
+}
+
+// Write to the specified `writer` an array of the specified `events`.  Each
+// attribute value is encoded as the string variant of an OpenTelemetry
+// `AnyValue`, as the Datadog Agent expects.
+void pack_events(msgpack::Writer& writer, const SpanEvents& events) {
+  namespace key = keys::event;
+  writer.pack_array(events.size());
+  for (const auto& event : events) {
+    writer.pack_map(2 + !event.attributes.empty());
+    append_key(writer, key::name);
+    writer.pack_string(event.name);
+    append_key(writer, key::time_unix_nano);
+    writer.pack_integer(unix_nanoseconds(event.time));
+    if (event.attributes.empty()) {
+      continue;
+    }
+    append_key(writer, key::attributes);
+    writer.pack_map(event.attributes.size());
+    for (const auto& [name, value] : event.attributes) {
+      writer.pack_string(name);
+      writer.pack_map(2);
+      append_key(writer, key::type);
+      writer.pack_integer(std::uint64_t(0));  // string
+      append_key(writer, key::string_value);
+      writer.pack_string(value);
+    }
+  }
+}
+
+// Each buffered span costs at least `sizeof(SpanData)`, so a change to the
+// fields of `SpanData` that makes it larger than this budget ought to be a
+// deliberate one.  The budget applies to 64-bit builds using libstdc++ or
+// libc++, whose containers have the expected sizes.
+#if (defined(__GLIBCXX__) || defined(_LIBCPP_VERSION)) && \
+    UINTPTR_MAX == UINT64_MAX
+constexpr std::size_t span_data_size_budget = 256;
+static_assert(sizeof(SpanData) <= span_data_size_budget,
+              "SpanData has grown beyond its size budget.");
+#endif
+
 }  // namespace
 
+SpanData::SpanData(Arena* arena)
+    : tags(SpanTags::allocator_type(arena)),
+      numeric_tags(SpanNumericTags::allocator_type(arena)),
+      links(SpanLinks::allocator_type(arena)),
+      events(SpanEvents::allocator_type(arena)) {}
+
+std::unique_ptr<SpanData> SpanData::make(Arena* arena) {
+  if (!arena) {
+    if (auto recycled = take_recycled_span()) {
+      return recycled;
+    }
+  }
+  return std::unique_ptr<SpanData>(new (arena) SpanData(arena));
+}
+
+void SpanData::reset() {
+  // A field added to `SpanData` must be reset here, too.
+  trace_id = TraceID();
+  span_id = 0;
+  parent_id = 0;
+  start = TimePoint();
+  duration = Duration::zero();
+  byte_size = 0;
+  service = InternedString();
+  service_type = InternedString();
+  name = InternedString();
+  resource = InternedString();
+  tags.clear();
+  numeric_tags.clear();
+  links.clear();
+  events.clear();
+  shared_tags.reset();
+  if (error_stack) {
+    error_stack->size = 0;
+  }
+  error = false;
+  finished = false;
+  has_children = false;
+  write_guard.reset();
+}
+
+Arena* SpanData::arena() const { return header_of(this).arena; }
+
+void* SpanData::operator new(std::size_t size) {
+  auto* header = static_cast<AllocationHeader*>(
+      ::operator new(sizeof(AllocationHeader) + size));
+  header->arena = nullptr;
+  return header + 1;
+}
+
+void* SpanData::operator new(std::size_t size, Arena* arena) {
+  if (!arena) {
+    return operator new(size);
+  }
+  auto* header = static_cast<AllocationHeader*>(arena->allocate(
+      sizeof(AllocationHeader) + size, alignof(AllocationHeader)));
+  header->arena = arena;
+  arena->retain();
+  return header + 1;
+}
+
+void SpanData::operator delete(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  AllocationHeader& header = header_of(pointer);
+  if (header.arena) {
+    header.arena->release();
+  } else {
+    ::operator delete(&header);
+  }
+}
+
+void SpanData::operator delete(void* pointer, Arena*) noexcept {
+  // Called only if a constructor invoked via placement `new (arena)` throws.
+  operator delete(pointer);
+}
+
 Optional<StringView> SpanData::environment() const {
   return lookup(tags::environment, tags);
 }
@@ -35,105 +397,207 @@ Optional<StringView> SpanData::version() const {
   return lookup(tags::version, tags);
 }
 
-void SpanData::apply_config(const SpanDefaults& defaults,
-                            const SpanConfig& config, const Clock& clock) {
-  std::string version;
+namespace {
+
+// Modify the specified `span` to honor the specified `config` and `defaults`,
+// as described by `SpanData::apply_config`.  `Config` is either `SpanConfig`
+// or `SpanConfigView`.  Each string in `config` is copied once, into `span`.
+template <typename Config>
+void apply_span_config(SpanData& span, const SpanDefaults& defaults,
+                       const SpanLimits& limits, const Config& config,
+                       const Clock& clock) {
+  StringView version;
   if (config.service) {
-    service = *config.service;
-    version = config.version.value_or("");
+    span.service = *config.service;
+    if (config.version) {
+      version = *config.version;
+    }
   } else {
-    service = defaults.service;
+    span.service = defaults.service;
     version = defaults.version;
   }
 
   if (!version.empty()) {
-    tags.insert_or_assign(tags::version, version);
+    span.tags.insert_or_assign(tags::version, std::string(version));
   }
 
-  name = config.name.value_or(defaults.name);
+  if (config.name) {
+    span.name = *config.name;
+  } else {
+    span.name = defaults.name;
+  }
 
   for (const auto& item : defaults.tags) {
-    tags.insert(item);
+    span.tags.insert(item);
   }
-  std::string environment = config.environment.value_or(defaults.environment);
+  const StringView environment =
+      config.environment ? StringView(*config.environment)
+                         : StringView(defaults.environment);
   if (!environment.empty()) {
-    tags.insert_or_assign(tags::environment, environment);
+    span.tags.insert_or_assign(tags::environment, std::string(environment));
   }
 
   for (const auto& [key, value] : config.tags) {
-    tags.insert_or_assign(key, value);
+    span.tags.insert_or_assign(
+        key, std::string(truncate_utf8(value, limits.max_tag_value_length)));
   }
 
-  resource = config.resource.value_or(name);
-  service_type = config.service_type.value_or(defaults.service_type);
+  if (config.resource) {
+    span.resource =
+        truncate_utf8(*config.resource, limits.max_resource_length);
+  } else {
+    span.resource = span.name;
+  }
+  if (config.service_type) {
+    span.service_type = *config.service_type;
+  } else {
+    span.service_type = defaults.service_type;
+  }
   if (config.start) {
-    start = *config.start;
+    span.start = *config.start;
   } else {
-    start = clock();
+    span.start = clock();
+  }
+
+  std::size_t byte_size = span.service.size() + span.service_type.size() +
+                          span.name.size() + span.resource.size();
+  for (const auto& [key, value] : span.tags) {
+    byte_size += key.size() + value.size();
+  }
+  span.byte_size = byte_size;
+}
+
+// The estimated size of the parts of an encoded span that are not counted by
+// `SpanData::byte_size`: the names of its fields, its IDs and times, and the
+// MessagePack headers of its strings.
+constexpr std::size_t encoded_span_overhead = 160;
+
+}  // namespace
+
+void SpanData::apply_config(const SpanDefaults& defaults,
+                            const SpanLimits& limits, const SpanConfig& config,
+                            const Clock& clock) {
+  apply_span_config(*this, defaults, limits, config, clock);
+}
+
+void SpanData::apply_config(const SpanDefaults& defaults,
+                            const SpanLimits& limits,
+                            const SpanConfigView& config, const Clock& clock) {
+  apply_span_config(*this, defaults, limits, config, clock);
+}
+
+std::size_t estimated_encoded_size(const SpanData& span) {
+  std::size_t size = encoded_span_overhead + span.byte_size;
+  if (const auto* shared = span.shared_tags.get()) {
+    size += shared->packed_tags().size() + shared->packed_numeric_tags().size();
   }
+  return size;
+}
+
+const std::string* symbolized_error_stack(const SpanData& span) {
+  if (!span.error_stack || span.error_stack->size == 0 ||
+      span.tags.count(tags::error_stack)) {
+    return nullptr;
+  }
+  thread_local std::string description;
+  description.clear();
+  symbolize(description, *span.error_stack);
+  return &description;
 }
 
 Expected<void> msgpack_encode(std::string& destination, const SpanData& span) {
-  // clang-format off
-  msgpack::pack_map(
-      destination,
-      "service", [&](auto& destination) {
-         return msgpack::pack_string(destination, span.service);
-       },
-      "name", [&](auto& destination) {
-         return msgpack::pack_string(destination, span.name);
-       },
-      "resource", [&](auto& destination) {
-         return msgpack::pack_string(destination, span.resource);
-       },
-      "trace_id", [&](auto& destination) {
-         msgpack::pack_integer(destination, span.trace_id.low);
-         return Expected<void>{};
-       },
-      "span_id", [&](auto& destination) {
-         msgpack::pack_integer(destination, span.span_id);
-         return Expected<void>{};
-       },
-      "parent_id", [&](auto& destination) {
-         msgpack::pack_integer(destination, span.parent_id);
-         return Expected<void>{};
-       },
-      "start", [&](auto& destination) {
-         msgpack::pack_integer(
-             destination, std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
-                              span.start.wall.time_since_epoch())
-                              .count()));
-         return Expected<void>{};
-       },
-      "duration", [&](auto& destination) {
-         msgpack::pack_integer(
-             destination,
-             std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(span.duration)
-                 .count()));
-        return Expected<void>{};
-       },
-      "error", [&](auto& destination) {
-         msgpack::pack_integer(destination, std::int32_t(span.error));
-         return Expected<void>{};
-       },
-      "meta", [&](auto& destination) {
-         return msgpack::pack_map(destination, span.tags,
-                           [](std::string& destination, const auto& value) {
-                             return msgpack::pack_string(destination, value);
-                           });
-       }, "metrics",
-       [&](auto& destination) {
-         return msgpack::pack_map(destination, span.numeric_tags,
-                           [](std::string& destination, const auto& value) {
-                             msgpack::pack_double(destination, value);
-                             return Expected<void>{};
-                           });
-       }, "type", [&](auto& destination) {
-         return msgpack::pack_string(destination, span.service_type);
-       });
-  // clang-format on
+  const auto* shared = span.shared_tags.get();
+  const std::string& packed_shared_tags =
+      shared ? shared->packed_tags() : no_shared_tags;
+  const std::string& packed_shared_numeric_tags =
+      shared ? shared->packed_numeric_tags() : no_shared_tags;
+  const std::string* const error_stack = symbolized_error_stack(span);
 
-  return nullopt;
+  // The "error.stack" tag, if any, is encoded after the shared tags, so
+  // count it together with them.
+  std::size_t extra_size =
+      packed_shared_tags.size() + packed_shared_numeric_tags.size();
+  bool repair = false;
+  if (error_stack) {
+    const std::size_t stack_size = repaired_utf8_size(*error_stack);
+    repair = stack_size != error_stack->size();
+    extra_size += tags::error_stack.size() + stack_size +
+                  2 * msgpack::Writer::max_integer_size;
+  }
+  const auto max_size = max_encoded_size(span, extra_size, repair);
+  if (auto* error = max_size.if_error()) {
+    return *error;
+  }
+
+  // Make room for the span once, and then write it without checking for room.
+  const std::size_t offset = destination.size();
+  const std::size_t needed = offset + *max_size;
+  if (needed > destination.capacity()) {
+    // Grow geometrically, as `append` would, so that encoding many spans
+    // into one buffer does not reallocate it for every span.
+    destination.reserve(std::max(needed, 2 * destination.capacity()));
+  }
+  destination.resize(needed);
+  msgpack::Writer writer{&destination[offset]};
+  // Strings are copied as is, unless one of them is not valid UTF-8.
+  writer.set_repair_utf8(repair);
+
+  append_key(writer, keys::map_and_service);
+  if (!span.links.empty() || !span.events.empty()) {
+    // Correct the size of the map, which is the first byte of the span.
+    destination[offset] =
+        char(0x80 | (keys::count + !span.links.empty() + !span.events.empty()));
+  }
+  writer.pack_string(span.service);
+  append_key(writer, keys::name);
+  writer.pack_string(span.name);
+  append_key(writer, keys::resource);
+  writer.pack_string(span.resource);
+  append_key(writer, keys::trace_id);
+  writer.pack_integer(span.trace_id.low);
+  append_key(writer, keys::span_id);
+  writer.pack_integer(span.span_id);
+  append_key(writer, keys::parent_id);
+  writer.pack_integer(span.parent_id);
+  append_key(writer, keys::start);
+  writer.pack_integer(unix_nanoseconds(span.start.wall));
+  append_key(writer, keys::duration);
+  writer.pack_integer(std::uint64_t(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(span.duration)
+          .count()));
+  append_key(writer, keys::error);
+  writer.pack_integer(std::int32_t(span.error));
+  append_key(writer, keys::meta);
+  pack_tags(writer, span.tags,
+            (shared ? shared->tags().size() : 0) + (error_stack != nullptr),
+            packed_shared_tags,
+            [](msgpack::Writer& writer, const auto& value) {
+              writer.pack_string(value);
+            });
+  if (error_stack) {
+    writer.pack_string(tags::error_stack);
+    writer.pack_string(*error_stack);
+  }
+  append_key(writer, keys::metrics);
+  pack_tags(writer, span.numeric_tags,
+            shared ? shared->numeric_tags().size() : 0,
+            packed_shared_numeric_tags,
+            [](msgpack::Writer& writer, double value) {
+              writer.pack_number(value);
+            });
+  append_key(writer, keys::type);
+  writer.pack_string(span.service_type);
+  if (!span.links.empty()) {
+    append_key(writer, keys::span_links);
+    pack_links(writer, span.links);
+  }
+  if (!span.events.empty()) {
+    append_key(writer, keys::span_events);
+    pack_events(writer, span.events);
+  }
+
+  destination.resize(writer.cursor() - destination.data());
+  return {};
 }
 
 Expected<void> msgpack_encode(
@@ -146,5 +610,51 @@ Expected<void> msgpack_encode(
                              });
 }
 
+void json_encode(std::string& destination, const SpanLinks& links) {
+  JsonWriter json{destination};
+  json.begin_array();
+  for (const auto& link : links) {
+    json.begin_object();
+    json.member("trace_id", link.trace_id.hex_padded());
+    json.member("span_id", hex_padded(link.span_id));
+    if (!link.attributes.empty()) {
+      json.key("attributes");
+      json.begin_object();
+      for (const auto& [name, value] : link.attributes) {
+        json.member(name, StringView(value));
+      }
+      json.end_object();
+    }
+    if (!link.tracestate.empty()) {
+      json.member("tracestate", StringView(link.tracestate));
+    }
+    if (link.flags) {
+      json.member("flags", *link.flags);
+    }
+    json.end_object();
+  }
+  json.end_array();
+}
+
+void json_encode(std::string& destination, const SpanEvents& events) {
+  JsonWriter json{destination};
+  json.begin_array();
+  for (const auto& event : events) {
+    json.begin_object();
+    json.member("name", StringView(event.name));
+    json.member("time_unix_nano", unix_nanoseconds(event.time));
+    if (!event.attributes.empty()) {
+      json.key("attributes");
+      json.begin_object();
+      for (const auto& [name, value] : event.attributes) {
+        json.member(name, StringView(value));
+      }
+      json.end_object();
+    }
+    json.end_object();
+  }
+  json.end_array();
+}
+
 }  // namespace tracing
 }  // namespace datadog
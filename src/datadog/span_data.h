@@ -6,33 +6,168 @@
 #include <datadog/clock.h>
 #include <datadog/expected.h>
 #include <datadog/optional.h>
+#include <datadog/span_event.h>
+#include <datadog/span_link.h>
 #include <datadog/string_view.h>
 #include <datadog/trace_id.h>
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
+#include "arena.h"
+#include "flat_map.h"
+#include "interned_string.h"
+#include "shared_tags.h"
+#include "stack_trace.h"
+
 namespace datadog {
 namespace tracing {
 
 struct SpanConfig;
+struct SpanConfigView;
 struct SpanDefaults;
 
+// `SpanLimits` bounds the size, in bytes, of strings set on a span (see
+// `TracerConfig::max_tag_value_length`).  Zero means no limit.
+struct SpanLimits {
+  std::size_t max_resource_length = 0;
+  std::size_t max_tag_value_length = 0;
+};
+
+// `SpanTags`, `SpanNumericTags`, `SpanLinks`, and `SpanEvents` are the types
+// of `SpanData::tags`, `SpanData::numeric_tags`, `SpanData::links`, and
+// `SpanData::events`, respectively.  They allocate from the `Arena`, if any,
+// from which their `SpanData` was allocated.
+using SpanTags =
+    FlatMap<std::string, std::string, 8,
+            ArenaAllocator<std::pair<std::string, std::string>>>;
+using SpanNumericTags =
+    FlatMap<std::string, double, 8,
+            ArenaAllocator<std::pair<std::string, double>>>;
+using SpanLinks = std::vector<SpanLink, ArenaAllocator<SpanLink>>;
+using SpanEvents = std::vector<SpanEvent, ArenaAllocator<SpanEvent>>;
+
+// `SpanWriteGuard` lets the thread that writes to a span through its `Span`
+// do so while `TraceSegment::flush_orphaned`, on another thread, might copy
+// the span.  A writer calls `begin_write` and, if it returns true, writes and
+// then calls `end_write`.  `detach` waits for the writer, if any, and makes
+// `begin_write` return false from then on, so that afterward the span is only
+// read.  A writer must not wait for the segment's mutex, which is locked
+// while `detach` waits.
+class SpanWriteGuard {
+  enum : unsigned char { WRITING = 1, DETACHED = 2 };
+  std::atomic<unsigned char> state_{0};
+
+  // Change the state from zero to the specified `state`, waiting while
+  // another thread writes.  Return false instead if the guard is detached.
+  bool acquire(unsigned char state) {
+    unsigned char expected = 0;
+    while (!state_.compare_exchange_weak(expected, state,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+      if (expected & DETACHED) {
+        return false;
+      }
+      if (expected != 0) {
+        std::this_thread::yield();
+      }
+      expected = 0;
+    }
+    return true;
+  }
+
+ public:
+  SpanWriteGuard() = default;
+  // A copy of a span is not written through the span's `Span`, so the copy's
+  // guard starts out neither written nor detached.
+  SpanWriteGuard(const SpanWriteGuard&) {}
+  SpanWriteGuard& operator=(const SpanWriteGuard&) { return *this; }
+
+  bool begin_write() { return acquire(WRITING); }
+  void end_write() { state_.store(0, std::memory_order_release); }
+  void detach() { acquire(DETACHED); }
+  void reset() { state_.store(0, std::memory_order_relaxed); }
+};
+
 struct SpanData {
-  std::string service;
-  std::string service_type;
-  std::string name;
-  std::string resource;
+  // The fields are ordered so that those read when a span is created,
+  // finished, and sampled come first, and so that no padding separates them.
+  // `span_data.cpp` checks the size of `SpanData` against a budget.
   TraceID trace_id;
   std::uint64_t span_id = 0;
   std::uint64_t parent_id = 0;
   TimePoint start;
   Duration duration = Duration::zero();
+  // The approximate size, in bytes, of the span's service, type, name, and
+  // resource, and of the names and values of its tags, as maintained by
+  // `apply_config` and by `Span`'s setters.  Tags that this library adds to
+  // `tags` and `numeric_tags` directly are not counted.
+  std::size_t byte_size = 0;
+  // Spans share their values of these (see `interned_string.h`), each of
+  // which is the size of a pointer.
+  InternedString service;
+  InternedString service_type;
+  InternedString name;
+  InternedString resource;
+  SpanTags tags;
+  SpanNumericTags numeric_tags;
+  // Most spans have neither links nor events, and an empty vector does not
+  // allocate.
+  SpanLinks links;
+  SpanEvents events;
+  // Tags that this span has in common with the other spans of its trace
+  // segment, set when the segment is finalized.  They are serialized together
+  // with `tags` and `numeric_tags`, and take precedence over them.
+  std::shared_ptr<const SharedTags> shared_tags;
+  // The call stack captured by `Span::capture_error_stack`, if any.  It is
+  // symbolized only when the span is encoded (see `symbolized_error_stack`).
+  // Its storage is kept for reuse when it is cleared.
+  CapturedStackPtr error_stack;
   bool error = false;
-  std::unordered_map<std::string, std::string> tags;
-  std::unordered_map<std::string, double> numeric_tags;
+  // Whether the span's `Span` has finished.  A segment that is flushed before
+  // all of its spans finish tells them apart by this (see
+  // `TraceSegment::flush_orphaned`).  It is set under `write_guard`.
+  bool finished = false;
+  // Whether another span might have this one as its parent, because a child
+  // was created from it or its context was taken or injected.  Span rollups
+  // discard only spans that are nobody's parent (see `TraceSegment`).
+  bool has_children = false;
+  // Guards the span against `TraceSegment::flush_orphaned` while its `Span`
+  // writes to it, if the segment's orphaned spans are flushed (see
+  // `TraceSegment::flushes_orphans`).
+  SpanWriteGuard write_guard;
+
+  // Create a `SpanData` whose tags allocate from the specified `arena`, or
+  // from the global heap if `arena` is null.  Prefer `make`, which also
+  // allocates the `SpanData` itself from `arena`.
+  explicit SpanData(Arena* arena = nullptr);
+
+  // Return a new `SpanData` that, together with its tags, is allocated from
+  // the specified `arena`.  The returned object holds a reference to `arena`
+  // until it is destroyed.  If `arena` is null, then reuse a recycled object
+  // (see `span_recycler.h`) if there is one, or else allocate from the global
+  // heap.
+  static std::unique_ptr<SpanData> make(Arena* arena);
+
+  // Restore this object to the state of a newly constructed one, but keep the
+  // storage of its tags, links, and events for reuse.
+  void reset();
+
+  // Return the `Arena` from which this object was allocated, or null if it was
+  // allocated from the global heap.
+  Arena* arena() const;
+
+  // `SpanData` records, in front of each object, where the object's storage
+  // came from, so that `delete` (e.g. via `std::unique_ptr<SpanData>`) returns
+  // it to the right place.
+  static void* operator new(std::size_t size);
+  static void* operator new(std::size_t size, Arena* arena);
+  static void operator delete(void* pointer) noexcept;
+  static void operator delete(void* pointer, Arena* arena) noexcept;
 
   Optional<StringView> environment() const;
   Optional<StringView> version() const;
@@ -40,11 +175,26 @@ struct SpanData {
   // Modify the properties of this object to honor the specified `config` and
   // `defaults`.  The properties of `config`, if set, override the properties of
   // `defaults`. Use the specified `clock` to provide a start none of none is
-  // specified in `config`.
-  void apply_config(const SpanDefaults& defaults, const SpanConfig& config,
-                    const Clock& clock);
+  // specified in `config`.  Truncate the resource and tag values of `config`
+  // to the specified `limits`.  Set `byte_size`.
+  void apply_config(const SpanDefaults& defaults, const SpanLimits& limits,
+                    const SpanConfig& config, const Clock& clock);
+  void apply_config(const SpanDefaults& defaults, const SpanLimits& limits,
+                    const SpanConfigView& config, const Clock& clock);
 };
 
+// Return an estimate of the size of the MessagePack encoding of the specified
+// `span`, computed from `SpanData::byte_size` and the span's shared tags,
+// without examining the span's other tags.
+std::size_t estimated_encoded_size(const SpanData& span);
+
+// Return a description of the call stack captured for the specified `span`,
+// or return null if none was captured or if the span has an "error.stack"
+// tag, which takes precedence.  The description is computed by this call
+// (see `stack_trace.h`), and it is valid until the next call on the same
+// thread.  Encoders call this when they write the span's "error.stack" tag.
+const std::string* symbolized_error_stack(const SpanData& span);
+
 // Append to the specified `destination` the MessagePack representation of the
 // specified `span`.
 Expected<void> msgpack_encode(std::string& destination, const SpanData& span);
@@ -56,5 +206,15 @@ Expected<void> msgpack_encode(
     std::string& destination,
     const std::vector<std::unique_ptr<SpanData>>& spans);
 
+// Append to the specified `destination` the JSON representation of the
+// specified `links`, as expected in the "_dd.span_links" tag by formats that
+// cannot encode links natively.
+void json_encode(std::string& destination, const SpanLinks& links);
+
+// Append to the specified `destination` the JSON representation of the
+// specified `events`, as expected in the "events" tag by formats that cannot
+// encode events natively.
+void json_encode(std::string& destination, const SpanEvents& events);
+
 }  // namespace tracing
 }  // namespace datadog
@@ -0,0 +1,132 @@
+#include "span_recycler.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include "span_data.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Spans having more tags than this are not recycled, so that a few unusual
+// spans do not pin their large tables indefinitely.
+constexpr std::size_t max_recycled_tags = 32;
+
+using Batch = std::vector<std::unique_ptr<SpanData>>;
+
+struct Pool {
+  std::mutex mutex;
+  std::vector<Batch> batches;
+  std::size_t size = 0;
+};
+
+Pool& pool() {
+  // Intentionally leaked, so that spans recycled during static destruction
+  // still have a pool to go to.
+  static Pool* instance = new Pool;
+  return *instance;
+}
+
+// Whether the calling thread's spans have been destroyed, as they are when
+// the thread exits.  Being trivially destructible, this flag remains valid
+// throughout the thread's exit (see `PoolAllocator`).
+bool& destroyed() {
+  thread_local bool flag = false;
+  return flag;
+}
+
+struct ThreadSpans {
+  Batch spans;
+
+  ~ThreadSpans() { destroyed() = true; }
+};
+
+Batch& thread_spans() {
+  thread_local ThreadSpans instance;
+  return instance.spans;
+}
+
+bool recyclable(const SpanData& span) {
+  return span.arena() == nullptr && span.tags.size() <= max_recycled_tags &&
+         span.numeric_tags.size() <= max_recycled_tags;
+}
+
+}  // namespace
+
+void recycle_spans(std::vector<std::unique_ptr<SpanData>>& spans) {
+  if (destroyed()) {
+    spans.clear();
+    return;
+  }
+
+  Batch& local = thread_spans();
+  Batch overflow;
+  for (auto& span : spans) {
+    if (!span || !recyclable(*span)) {
+      continue;
+    }
+    span->reset();
+    if (local.size() < span_recycler_thread_capacity) {
+      local.push_back(std::move(span));
+    } else {
+      overflow.push_back(std::move(span));
+    }
+  }
+  spans.clear();
+
+  if (overflow.empty()) {
+    return;
+  }
+  Pool& shared = pool();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  if (shared.size + overflow.size() <= span_recycler_capacity) {
+    shared.size += overflow.size();
+    shared.batches.push_back(std::move(overflow));
+  }
+}
+
+void reserve_recycled_spans(std::size_t count) {
+  count = std::min(count, span_recycler_capacity);
+  Pool& shared = pool();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  while (shared.size < count) {
+    const std::size_t batch_size =
+        std::min(count - shared.size, span_recycler_thread_capacity);
+    Batch batch;
+    batch.reserve(batch_size);
+    for (std::size_t i = 0; i < batch_size; ++i) {
+      batch.push_back(std::unique_ptr<SpanData>(new SpanData));
+    }
+    shared.size += batch_size;
+    shared.batches.push_back(std::move(batch));
+  }
+}
+
+std::unique_ptr<SpanData> take_recycled_span() {
+  if (destroyed()) {
+    return nullptr;
+  }
+  Batch& local = thread_spans();
+  if (local.empty()) {
+    Pool& shared = pool();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (shared.batches.empty()) {
+      return nullptr;
+    }
+    local.swap(shared.batches.back());
+    shared.batches.pop_back();
+    shared.size -= local.size();
+  }
+  auto span = std::move(local.back());
+  local.pop_back();
+  return span;
+}
+
+std::size_t recycled_span_count() {
+  return destroyed() ? 0 : thread_spans().size();
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,48 @@
+#pragma once
+
+// This component provides functions that recycle `SpanData` objects once a
+// collector is done with them, so that the spans of later traces reuse their
+// storage rather than allocating it again.
+//
+// `recycle_spans` resets each span that was allocated from the global heap
+// (see `SpanData::reset`), keeping the storage of its tag tables, links, and
+// events, and keeps the span for reuse.  `SpanData::make` takes a recycled
+// span, if there is one, before allocating a new one.  Spans allocated from an
+// `Arena` are not recycled, since their storage is released with the arena.
+//
+// Each thread keeps up to `span_recycler_thread_capacity` recycled spans for
+// its own use, without locking.  Spans recycled beyond that, e.g. by a
+// collector that encodes spans on its own thread, go to a process-wide pool
+// of at most `span_recycler_capacity` spans, from which a thread whose own
+// spans are exhausted takes a whole batch at a time.
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+struct SpanData;
+
+// The maximum number of recycled spans that one thread keeps.
+constexpr std::size_t span_recycler_thread_capacity = 256;
+// The maximum number of recycled spans in the process-wide pool.
+constexpr std::size_t span_recycler_capacity = 4096;
+
+// Reset and keep for reuse the spans in the specified `spans`, up to the
+// capacities above, and destroy the rest.  Leave `spans` empty.
+void recycle_spans(std::vector<std::unique_ptr<SpanData>>& spans);
+
+// Add new spans to the process-wide pool until it holds the specified `count`
+// spans, or as many as it can hold, so that the first traces reuse them.
+void reserve_recycled_spans(std::size_t count);
+
+// Return a recycled span, or null if there is none.
+std::unique_ptr<SpanData> take_recycled_span();
+
+// Return the number of recycled spans that the calling thread keeps.
+std::size_t recycled_span_count();
+
+}  // namespace tracing
+}  // namespace datadog
@@ -2,23 +2,23 @@
 
 #include <datadog/sampling_mechanism.h>
 #include <datadog/sampling_priority.h>
+#include <datadog/telemetry/metrics.h>
+#include <datadog/telemetry/telemetry.h>
 
 #include "sampling_util.h"
 #include "span_data.h"
+#include "tags.h"
+#include "telemetry_metrics.h"
 
 namespace datadog {
 namespace tracing {
 
-SpanSampler::SynchronizedLimiter::SynchronizedLimiter(const Clock& clock,
-                                                      double max_per_second)
-    : limiter(clock, max_per_second) {}
-
 SpanSampler::Rule::Rule(const FinalizedSpanSamplerConfig::Rule& rule,
                         const Clock& clock)
     : FinalizedSpanSamplerConfig::Rule(rule),
-      limiter_(max_per_second ? std::make_unique<SynchronizedLimiter>(
-                                    clock, *max_per_second)
-                              : nullptr) {}
+      limiter_(max_per_second
+                   ? std::make_unique<Limiter>(clock, *max_per_second)
+                   : nullptr) {}
 
 SamplingDecision SpanSampler::Rule::decide(const SpanData& span) {
   SamplingDecision decision;
@@ -38,8 +38,7 @@ SamplingDecision SpanSampler::Rule::decide(const SpanData& span) {
     return decision;
   }
 
-  std::lock_guard<std::mutex> lock(limiter_->mutex);
-  const auto result = limiter_->limiter.allow();
+  const auto result = limiter_->allow();
   if (result.allowed) {
     decision.priority = int(SamplingPriority::USER_KEEP);
   } else {
@@ -50,22 +49,66 @@ SamplingDecision SpanSampler::Rule::decide(const SpanData& span) {
   return decision;
 }
 
+namespace {
+
+std::vector<const SpanMatcher*> matchers_of(
+    const std::vector<FinalizedSpanSamplerConfig::Rule>& rules) {
+  std::vector<const SpanMatcher*> matchers;
+  matchers.reserve(rules.size());
+  for (const auto& rule : rules) {
+    matchers.push_back(&rule);
+  }
+  return matchers;
+}
+
+}  // namespace
+
 SpanSampler::SpanSampler(const FinalizedSpanSamplerConfig& config,
-                         const Clock& clock) {
+                         const Clock& clock)
+    : matchers_(matchers_of(config.rules)) {
   for (const auto& rule : config.rules) {
     rules_.push_back(Rule{rule, clock});
   }
 }
 
 SpanSampler::Rule* SpanSampler::match(const SpanData& span) {
-  const auto found = std::find_if(rules_.begin(), rules_.end(),
-                                  [&](Rule& rule) { return rule.match(span); });
-  if (found != rules_.end()) {
-    return &*found;
+  const std::size_t found = matchers_.find(span);
+  if (found != CompiledSpanMatchers::npos) {
+    return &rules_[found];
   }
   return nullptr;
 }
 
+void SpanSampler::sample_spans_of_dropped_trace(
+    const std::vector<std::unique_ptr<SpanData>>& spans) {
+  // Span sampling happens when the trace is dropped.
+  if (empty()) {
+    return;
+  }
+  for (const auto& span_ptr : spans) {
+    SpanData& span = *span_ptr;
+    auto* rule = match(span);
+    if (!rule) {
+      continue;
+    }
+    const SamplingDecision decision = rule->decide(span);
+    if (decision.priority <= 0) {
+      telemetry::counter::increment(metrics::tracer::spans_dropped,
+                                    {"reason:p0_drop"});
+      continue;
+    }
+
+    span.numeric_tags[tags::internal::span_sampling_mechanism] =
+        *decision.mechanism;
+    span.numeric_tags[tags::internal::span_sampling_rule_rate] =
+        *decision.configured_rate;
+    if (decision.limiter_max_per_second) {
+      span.numeric_tags[tags::internal::span_sampling_limit] =
+          *decision.limiter_max_per_second;
+    }
+  }
+}
+
 nlohmann::json SpanSampler::config_json() const {
   std::vector<nlohmann::json> rules;
   for (const auto& rule : rules_) {
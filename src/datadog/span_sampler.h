@@ -23,8 +23,9 @@
 #include <datadog/span_sampler_config.h>
 
 #include <memory>
-#include <mutex>
+#include <vector>
 
+#include "compiled_span_matchers.h"
 #include "json.hpp"
 #include "limiter.h"
 
@@ -33,15 +34,8 @@ namespace tracing {
 
 class SpanSampler {
  public:
-  struct SynchronizedLimiter {
-    std::mutex mutex;
-    Limiter limiter;
-
-    SynchronizedLimiter(const Clock&, double max_per_second);
-  };
-
   class Rule : public FinalizedSpanSamplerConfig::Rule {
-    std::unique_ptr<SynchronizedLimiter> limiter_;
+    std::unique_ptr<Limiter> limiter_;
 
    public:
     explicit Rule(const FinalizedSpanSamplerConfig::Rule&, const Clock&);
@@ -52,6 +46,7 @@ class SpanSampler {
 
  private:
   std::vector<Rule> rules_;
+  CompiledSpanMatchers matchers_;
 
  public:
   explicit SpanSampler(const FinalizedSpanSamplerConfig& config,
@@ -61,6 +56,15 @@ class SpanSampler {
   // return null if there is no match.
   Rule* match(const SpanData&);
 
+  // Return whether there are no rules, so that no span is ever kept by this
+  // sampler.
+  bool empty() const { return rules_.empty(); }
+
+  // Apply the rules to the specified `spans`, which belong to a trace that is
+  // being dropped, and tag the spans that are kept as such.
+  void sample_spans_of_dropped_trace(
+      const std::vector<std::unique_ptr<SpanData>>& spans);
+
   nlohmann::json config_json() const;
 };
 
@@ -0,0 +1,125 @@
+#include <datadog/spill_file.h>
+
+#include <atomic>
+#include <limits>
+#include <new>
+
+#include "interprocess.h"
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Identifies a file that was initialized by `SpillFile`, in this format.
+constexpr std::uint64_t spill_file_magic = 0x314c4c4950534444;  // "DDSPILL1"
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Counters in a shared file must not depend on the process.");
+
+}  // namespace
+
+// `Header` is at the beginning of the file, and the records follow it.
+struct SpillFile::Header {
+  // `spill_file_magic` once the header is initialized.
+  std::uint64_t magic = 0;
+  ProcessLock lock;
+  std::atomic<std::uint64_t> dropped{0};
+  // Guarded by `lock`.
+  SharedRing ring;
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+SpillFile::SpillFile(Header* header, std::size_t mapped_size)
+    : header_(header), mapped_size_(mapped_size) {}
+
+Expected<std::shared_ptr<SpillFile>> SpillFile::open(const std::string& path,
+                                                     std::size_t capacity) {
+  static_assert(sizeof(Header) % alignof(std::uint64_t) == 0,
+                "Records must begin at an aligned address.");
+  if (capacity <= sizeof(SharedRing::RecordSize) ||
+      capacity > std::numeric_limits<std::size_t>::max() - sizeof(Header)) {
+    return Error{Error::SPILL_FILE_INVALID_CAPACITY,
+                 "SpillFile: capacity must be large enough to hold a record."};
+  }
+
+  const std::size_t mapped_size = sizeof(Header) + capacity;
+  void* memory = map_file(path, mapped_size);
+  if (memory == nullptr) {
+    return Error{Error::SPILL_FILE_UNAVAILABLE,
+                 "SpillFile: unable to map the file \"" + path + "\"."};
+  }
+
+  // Keep the records of a file that was opened before with the same
+  // capacity.  Otherwise, the file is new, was resized, or is not a spill
+  // file, and is initialized.
+  auto* header = static_cast<Header*>(memory);
+  if (header->magic != spill_file_magic || header->ring.capacity != capacity ||
+      header->ring.tail - header->ring.head > capacity) {
+    header = new (memory) Header;
+    header->ring.capacity = capacity;
+    header->magic = spill_file_magic;
+  }
+  return std::shared_ptr<SpillFile>(new SpillFile(header, mapped_size));
+}
+
+SpillFile::~SpillFile() {
+  // The file is unmapped in this process only.  Its records remain in the
+  // file.
+  unmap_shared_memory(header_, mapped_size_);
+}
+
+void SpillFile::lock() {
+  if (header_->lock.lock()) {
+    // The holder of the lock exited while holding it, possibly in the middle
+    // of writing a record.  Discard the records.
+    header_->ring.head = header_->ring.tail;
+  }
+}
+
+void SpillFile::unlock() { header_->lock.unlock(); }
+
+bool SpillFile::push(StringView record) {
+  SharedRing& ring = header_->ring;
+  if (SharedRing::space_for(record) > ring.capacity ||
+      record.size() > std::numeric_limits<SharedRing::RecordSize>::max()) {
+    header_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  lock();
+  while (ring.tail - ring.head + SharedRing::space_for(record) >
+         ring.capacity) {
+    ring.drop(header_->data());
+    header_->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  ring.push(header_->data(), record);
+  unlock();
+  return true;
+}
+
+bool SpillFile::pop(std::string& record) {
+  lock();
+  const bool popped = header_->ring.pop(header_->data(), record);
+  unlock();
+  return popped;
+}
+
+bool SpillFile::empty() {
+  lock();
+  const bool result = header_->ring.empty();
+  unlock();
+  return result;
+}
+
+std::size_t SpillFile::capacity() const {
+  return static_cast<std::size_t>(header_->ring.capacity);
+}
+
+std::uint64_t SpillFile::dropped() const {
+  return header_->dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,68 @@
+#include "stack_trace.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Beyond this many addresses, descriptions are computed but not cached, so
+// that a process that captures many distinct stacks does not grow the cache
+// without bound.
+constexpr std::size_t max_cached_symbols = 16384;
+
+struct SymbolCache {
+  std::mutex mutex;
+  std::unordered_map<const void*, std::string> descriptions;
+};
+
+SymbolCache& symbol_cache() {
+  // The cache is never destroyed, so that spans can be sent during static
+  // destruction.
+  static SymbolCache* const cache = new SymbolCache;
+  return *cache;
+}
+
+}  // namespace
+
+void capture_stack(CapturedStack& stack, std::size_t skip) {
+  // Skip this function's own frame, too.
+  stack.size = capture_return_addresses(stack.frames, CapturedStack::max_frames,
+                                        skip + 1);
+}
+
+void symbolize(std::string& destination, const CapturedStack& stack) {
+  auto& cache = symbol_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  for (std::size_t i = 0; i < stack.size; ++i) {
+    // A return address is the instruction after the call, which might belong
+    // to the next function, so describe the call instead.
+    const void* const address = static_cast<const char*>(stack.frames[i]) - 1;
+    destination += '#';
+    destination += std::to_string(i);
+    destination += ' ';
+    const auto found = cache.descriptions.find(address);
+    if (found != cache.descriptions.end()) {
+      destination += found->second;
+    } else if (cache.descriptions.size() < max_cached_symbols) {
+      destination += cache.descriptions
+                         .emplace(address, describe_code_address(address))
+                         .first->second;
+    } else {
+      destination += describe_code_address(address);
+    }
+    destination += '\n';
+  }
+}
+
+std::size_t symbol_cache_size() {
+  auto& cache = symbol_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return cache.descriptions.size();
+}
+
+}  // namespace tracing
+}  // namespace datadog
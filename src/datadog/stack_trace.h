@@ -0,0 +1,75 @@
+#pragma once
+
+// This component provides a `struct`, `CapturedStack`, that holds the return
+// addresses of a thread's call stack, and functions that capture a stack and
+// that describe a captured stack.
+//
+// Capturing a stack only records addresses, which is cheap enough to do on a
+// thread that is serving a request.  Describing the addresses in terms of
+// functions and modules is much more expensive, so it is meant to be done
+// later, on a thread that is not, such as the thread that sends spans.  The
+// description of each address is cached for the life of the process, since
+// the same stacks tend to recur.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+struct CapturedStack {
+  static constexpr std::size_t max_frames = 32;
+
+  // The number of elements of `frames` that are return addresses, innermost
+  // first.
+  std::size_t size = 0;
+  void* frames[max_frames];
+};
+
+// `CapturedStackPtr` owns a `CapturedStack`, if any, as `std::unique_ptr`
+// would, except that copying it copies the stack.
+class CapturedStackPtr {
+  std::unique_ptr<CapturedStack> stack_;
+
+ public:
+  CapturedStackPtr() = default;
+  CapturedStackPtr(const CapturedStackPtr& other)
+      : stack_(other.stack_ ? std::make_unique<CapturedStack>(*other.stack_)
+                            : nullptr) {}
+  CapturedStackPtr(CapturedStackPtr&&) noexcept = default;
+  CapturedStackPtr& operator=(const CapturedStackPtr& other) {
+    if (this != &other) {
+      *this = CapturedStackPtr(other);
+    }
+    return *this;
+  }
+  CapturedStackPtr& operator=(CapturedStackPtr&&) noexcept = default;
+
+  explicit operator bool() const { return stack_ != nullptr; }
+  CapturedStack& operator*() const { return *stack_; }
+  CapturedStack* operator->() const { return stack_.get(); }
+
+  // Return the owned stack, first allocating an empty one if there is none.
+  CapturedStack& get_or_create() {
+    if (!stack_) {
+      stack_ = std::make_unique<CapturedStack>();
+    }
+    return *stack_;
+  }
+};
+
+// Store in the specified `stack` the return addresses of the calling thread's
+// call stack, skipping the specified `skip` innermost frames of the caller.
+// Keep the innermost `CapturedStack::max_frames` frames if there are more.
+void capture_stack(CapturedStack& stack, std::size_t skip = 0);
+
+// Append to the specified `destination` a description of each frame of the
+// specified `stack`, one per line.
+void symbolize(std::string& destination, const CapturedStack& stack);
+
+// Return the number of addresses whose descriptions are cached.
+std::size_t symbol_cache_size();
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,417 @@
+#include "stats_concentrator.h"
+
+#include <datadog/string_view.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include "msgpack.h"
+#include "span_data.h"
+#include "string_util.h"
+#include "tags.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The ratio of the bounds of each bucket of a `LatencySketch`.
+const double sketch_gamma =
+    (1 + StatsConcentrator::LatencySketch::relative_accuracy) /
+    (1 - StatsConcentrator::LatencySketch::relative_accuracy);
+const double log_gamma = std::log(sketch_gamma);
+
+// Protocol Buffers wire types.
+enum WireType { VARINT = 0, FIXED64 = 1, LENGTH_DELIMITED = 2 };
+
+void append_varint(std::string& destination, std::uint64_t value) {
+  while (value >= 0x80) {
+    destination += static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  destination += static_cast<char>(value);
+}
+
+void append_field(std::string& destination, int field, WireType type) {
+  append_varint(destination, (std::uint64_t(field) << 3) | type);
+}
+
+void append_fixed64(std::string& destination, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  for (int i = 0; i < 8; ++i) {
+    destination += static_cast<char>((bits >> (8 * i)) & 0xFF);
+  }
+}
+
+void append_message(std::string& destination, int field,
+                    const std::string& message) {
+  append_field(destination, field, LENGTH_DELIMITED);
+  append_varint(destination, message.size());
+  destination += message;
+}
+
+Optional<StringView> find_tag(const SpanData& span, const std::string& name) {
+  // Tags shared by the spans of the trace segment take precedence.
+  if (span.shared_tags) {
+    for (const auto& [key, value] : span.shared_tags->tags()) {
+      if (key == name) {
+        return StringView{value};
+      }
+    }
+  }
+  const auto found = span.tags.find(name);
+  if (found != span.tags.end()) {
+    return StringView{found->second};
+  }
+  return nullopt;
+}
+
+std::uint32_t http_status_code(const SpanData& span) {
+  static const std::string tag = "http.status_code";
+  if (const auto text = find_tag(span, tag)) {
+    std::uint32_t code = 0;
+    std::from_chars(text->data(), text->data() + text->size(), code);
+    return code;
+  }
+  const auto found = span.numeric_tags.find(tag);
+  if (found != span.numeric_tags.end() && found->second >= 0 &&
+      found->second < 1000) {
+    return static_cast<std::uint32_t>(found->second);
+  }
+  return 0;
+}
+
+bool is_measured(const SpanData& span) {
+  const auto found = span.numeric_tags.find("_dd.measured");
+  return found != span.numeric_tags.end() && found->second == 1;
+}
+
+bool has_stats_span_kind(StringView span_kind) {
+  return span_kind == "server" || span_kind == "client" ||
+         span_kind == "producer" || span_kind == "consumer";
+}
+
+std::int64_t nanoseconds_since_epoch(
+    std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+constexpr std::chrono::seconds StatsConcentrator::bucket_duration;
+
+void StatsConcentrator::LatencySketch::add(std::uint64_t nanoseconds) {
+  if (nanoseconds == 0) {
+    ++zeros_;
+    return;
+  }
+
+  // Bucket `i` contains the durations in [gamma^i, gamma^(i+1)).
+  const int index =
+      static_cast<int>(std::floor(std::log(double(nanoseconds)) / log_gamma));
+  if (buckets_.empty()) {
+    first_bucket_ = index;
+    buckets_.push_back(0);
+  } else if (index < first_bucket_) {
+    buckets_.insert(buckets_.begin(), first_bucket_ - index, 0);
+    first_bucket_ = index;
+  } else if (std::size_t(index - first_bucket_) >= buckets_.size()) {
+    buckets_.resize(index - first_bucket_ + 1);
+  }
+  ++buckets_[index - first_bucket_];
+}
+
+std::uint64_t StatsConcentrator::LatencySketch::count() const {
+  std::uint64_t total = zeros_;
+  for (const std::uint64_t bucket : buckets_) {
+    total += bucket;
+  }
+  return total;
+}
+
+void StatsConcentrator::LatencySketch::encode(std::string& destination) const {
+  // message IndexMapping { double gamma = 1; ... }
+  std::string mapping;
+  append_field(mapping, 1, FIXED64);
+  append_fixed64(mapping, sketch_gamma);
+
+  // message Store { ...
+  //   repeated double contiguousBinCounts = 2 [packed = true];
+  //   sint32 contiguousBinIndexOffset = 3; }
+  std::string store;
+  if (!buckets_.empty()) {
+    append_field(store, 2, LENGTH_DELIMITED);
+    append_varint(store, 8 * buckets_.size());
+    for (const std::uint64_t bucket : buckets_) {
+      append_fixed64(store, double(bucket));
+    }
+    append_field(store, 3, VARINT);
+    // `sint32` is zigzag encoded.
+    append_varint(store, std::uint32_t(first_bucket_ << 1) ^
+                             std::uint32_t(first_bucket_ >> 31));
+  }
+
+  // message DDSketch { IndexMapping mapping = 1; Store positiveValues = 2;
+  //   Store negativeValues = 3; double zeroCount = 4; }
+  append_message(destination, 1, mapping);
+  if (!store.empty()) {
+    append_message(destination, 2, store);
+  }
+  if (zeros_) {
+    append_field(destination, 4, FIXED64);
+    append_fixed64(destination, double(zeros_));
+  }
+}
+
+StatsConcentrator::StatsConcentrator(const TracerSignature& signature)
+    : signature_(signature) {}
+
+void StatsConcentrator::add(
+    const std::vector<std::unique_ptr<SpanData>>& spans) {
+  // The service of each span in the chunk, for finding top-level spans.
+  std::unordered_map<std::uint64_t, const InternedString*> services;
+  if (spans.size() > 1) {
+    services.reserve(spans.size());
+    for (const auto& span : spans) {
+      services.emplace(span->span_id, &span->service);
+    }
+  }
+
+  const std::int64_t bucket_nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(bucket_duration)
+          .count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& span_ptr : spans) {
+    const SpanData& span = *span_ptr;
+
+    const auto parent = services.find(span.parent_id);
+    const bool top_level =
+        parent == services.end() || *parent->second != span.service;
+    static const std::string span_kind_tag = "span.kind";
+    const StringView span_kind =
+        find_tag(span, span_kind_tag).value_or(StringView{});
+    if (!top_level && !is_measured(span) && !has_stats_span_kind(span_kind)) {
+      continue;
+    }
+
+    const auto duration = std::max<std::int64_t>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(span.duration)
+               .count());
+    const std::int64_t end =
+        nanoseconds_since_epoch(span.start.wall) + duration;
+    const std::int64_t bucket_start =
+        end - (end % bucket_nanoseconds + bucket_nanoseconds) %
+                  bucket_nanoseconds;
+
+    Key key;
+    key.environment = std::string(span.environment().value_or(""));
+    key.version = std::string(span.version().value_or(""));
+    key.service = span.service;
+    key.name = span.name;
+    key.resource = span.resource;
+    key.type = span.service_type;
+    key.span_kind = std::string(span_kind);
+    key.http_status_code = http_status_code(span);
+    key.synthetics = starts_with(
+        find_tag(span, tags::internal::origin).value_or(""), "synthetics");
+    key.trace_root = span.parent_id == 0;
+
+    GroupStats& group = buckets_[bucket_start][std::move(key)];
+    ++group.hits;
+    if (top_level) {
+      ++group.top_level_hits;
+    }
+    group.duration += duration;
+    if (span.error) {
+      ++group.errors;
+      group.error_latencies.add(duration);
+    } else {
+      group.ok_latencies.add(duration);
+    }
+  }
+}
+
+Expected<std::vector<std::string>> StatsConcentrator::flush(TimePoint now,
+                                                            bool force) {
+  const std::int64_t bucket_nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(bucket_duration)
+          .count();
+  const std::int64_t now_nanoseconds = nanoseconds_since_epoch(now.wall);
+
+  std::map<std::int64_t, Bucket> flushed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto end = buckets_.begin();
+    while (end != buckets_.end() &&
+           (force || end->first + bucket_nanoseconds <= now_nanoseconds)) {
+      ++end;
+    }
+    flushed.insert(std::make_move_iterator(buckets_.begin()),
+                   std::make_move_iterator(end));
+    buckets_.erase(buckets_.begin(), end);
+  }
+
+  // Sort the groups into payloads by environment and version, and within
+  // each payload by bucket.
+  using Group = std::pair<const Key, GroupStats>;
+  std::map<std::pair<StringView, StringView>,
+           std::map<std::int64_t, std::vector<const Group*>>>
+      payloads;
+  for (const auto& [start, bucket] : flushed) {
+    for (const auto& group : bucket) {
+      payloads[{group.first.environment, group.first.version}][start]
+          .push_back(&group);
+    }
+  }
+
+  std::vector<std::string> encoded;
+  std::string summary;
+  for (const auto& [env_version, payload_buckets] : payloads) {
+    std::string& destination = encoded.emplace_back();
+    Expected<void> result;
+    // clang-format off
+    result = msgpack::pack_map(
+        destination,
+        "Hostname", [&](auto& destination) {
+          return msgpack::pack_string(destination, "");
+        },
+        "Env", [&](auto& destination) {
+          return msgpack::pack_string(destination, env_version.first);
+        },
+        "Version", [&](auto& destination) {
+          return msgpack::pack_string(destination, env_version.second);
+        },
+        "Lang", [&](auto& destination) {
+          return msgpack::pack_string(destination,
+                                      signature_.library_language);
+        },
+        "TracerVersion", [&](auto& destination) {
+          return msgpack::pack_string(destination,
+                                      signature_.library_version);
+        },
+        "RuntimeID", [&](auto& destination) {
+          return msgpack::pack_string(destination,
+                                      signature_.runtime_id.string());
+        },
+        "Sequence", [&](auto& destination) {
+          msgpack::pack_integer(destination, ++sequence_);
+          return Expected<void>{};
+        },
+        "Service", [&](auto& destination) {
+          return msgpack::pack_string(destination,
+                                      signature_.default_service);
+        },
+        "Stats", [&](auto& destination) {
+          return msgpack::pack_array(
+              destination, payload_buckets,
+              [&](auto& destination, const auto& entry) {
+                return msgpack::pack_map(
+                    destination,
+                    "Start", [&](auto& destination) {
+                      msgpack::pack_integer(destination,
+                                            std::uint64_t(entry.first));
+                      return Expected<void>{};
+                    },
+                    "Duration", [&](auto& destination) {
+                      msgpack::pack_integer(
+                          destination, std::uint64_t(bucket_nanoseconds));
+                      return Expected<void>{};
+                    },
+                    "Stats", [&](auto& destination) {
+                      return msgpack::pack_array(
+                          destination, entry.second,
+                          [&](auto& destination, const Group* group) {
+                            const Key& key = group->first;
+                            const GroupStats& stats = group->second;
+                            return msgpack::pack_map(
+                                destination,
+                                "Service", [&](auto& destination) {
+                                  return msgpack::pack_string(destination,
+                                                              key.service);
+                                },
+                                "Name", [&](auto& destination) {
+                                  return msgpack::pack_string(destination,
+                                                              key.name);
+                                },
+                                "Resource", [&](auto& destination) {
+                                  return msgpack::pack_string(destination,
+                                                              key.resource);
+                                },
+                                "Type", [&](auto& destination) {
+                                  return msgpack::pack_string(destination,
+                                                              key.type);
+                                },
+                                "HTTPStatusCode", [&](auto& destination) {
+                                  msgpack::pack_integer(destination,
+                                                        key.http_status_code);
+                                  return Expected<void>{};
+                                },
+                                "SpanKind", [&](auto& destination) {
+                                  return msgpack::pack_string(destination,
+                                                              key.span_kind);
+                                },
+                                "Synthetics", [&](auto& destination) {
+                                  msgpack::pack_bool(destination,
+                                                     key.synthetics);
+                                  return Expected<void>{};
+                                },
+                                // A `Trilean`: 1 is true, and 2 is false.
+                                "IsTraceRoot", [&](auto& destination) {
+                                  msgpack::pack_integer(
+                                      destination,
+                                      std::uint32_t(key.trace_root ? 1 : 2));
+                                  return Expected<void>{};
+                                },
+                                "Hits", [&](auto& destination) {
+                                  msgpack::pack_integer(destination,
+                                                        stats.hits);
+                                  return Expected<void>{};
+                                },
+                                "TopLevelHits", [&](auto& destination) {
+                                  msgpack::pack_integer(destination,
+                                                        stats.top_level_hits);
+                                  return Expected<void>{};
+                                },
+                                "Errors", [&](auto& destination) {
+                                  msgpack::pack_integer(destination,
+                                                        stats.errors);
+                                  return Expected<void>{};
+                                },
+                                "Duration", [&](auto& destination) {
+                                  msgpack::pack_integer(destination,
+                                                        stats.duration);
+                                  return Expected<void>{};
+                                },
+                                "OkSummary", [&](auto& destination) {
+                                  summary.clear();
+                                  stats.ok_latencies.encode(summary);
+                                  return msgpack::pack_binary(destination,
+                                                              summary);
+                                },
+                                "ErrorSummary", [&](auto& destination) {
+                                  summary.clear();
+                                  stats.error_latencies.encode(summary);
+                                  return msgpack::pack_binary(destination,
+                                                              summary);
+                                });
+                          });
+                    });
+              });
+        });
+    // clang-format on
+    if (auto* error = result.if_error()) {
+      return std::move(*error);
+    }
+  }
+
+  return encoded;
+}
+
+}  // namespace tracing
+}  // namespace datadog
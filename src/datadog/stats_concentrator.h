@@ -0,0 +1,125 @@
+#pragma once
+
+// This component provides a `class`, `StatsConcentrator`, that computes trace
+// stats from finished spans, as the Datadog Agent otherwise does from the
+// traces that it receives.
+//
+// Trace stats are counts of hits and errors, total durations, and latency
+// distributions of spans, grouped by service, operation name, resource, span
+// type, HTTP status code, span kind, whether the trace is synthetic, and
+// whether the span is the root of its trace.  The groups are aggregated in
+// buckets of `StatsConcentrator::bucket_duration`, according to when each span
+// ended.  As in the Datadog Agent, only top-level spans (those whose parent is
+// in another service, or not in the chunk), measured spans, and spans having a
+// client, server, producer, or consumer "span.kind" are counted.
+//
+// When the tracer computes trace stats, the Datadog Agent does not, so that
+// traces that the tracer would drop need not be sent to the Datadog Agent at
+// all.  `DatadogAgent` uses a `StatsConcentrator` for its trace chunks if
+// `DatadogAgentConfig::stats_computation_enabled` is true, and sends the
+// payloads produced by `flush` to the Datadog Agent's "/v0.6/stats" endpoint.
+
+#include <datadog/clock.h>
+#include <datadog/expected.h>
+#include <datadog/tracer_signature.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+struct SpanData;
+
+class StatsConcentrator {
+ public:
+  static constexpr std::chrono::seconds bucket_duration{10};
+
+  // `LatencySketch` counts durations, in nanoseconds, in buckets whose bounds
+  // grow geometrically, so that every duration in a bucket is within
+  // `relative_accuracy` of the bucket's representative value.  It is encoded
+  // as the Protocol Buffers `DDSketch` message that the Datadog Agent expects.
+  class LatencySketch {
+    // The number of durations in each bucket, starting at `first_bucket_`.
+    std::vector<std::uint64_t> buckets_;
+    int first_bucket_ = 0;
+    std::uint64_t zeros_ = 0;
+
+   public:
+    static constexpr double relative_accuracy = 0.01;
+
+    void add(std::uint64_t nanoseconds);
+    // Return the number of durations added.
+    std::uint64_t count() const;
+    // Append the `DDSketch` encoding of this sketch to the specified
+    // `destination`.
+    void encode(std::string& destination) const;
+  };
+
+ private:
+  struct Key {
+    // The "Env" and "Version" of the payload that includes the group.
+    std::string environment;
+    std::string version;
+    std::string service;
+    std::string name;
+    std::string resource;
+    std::string type;
+    std::string span_kind;
+    std::uint32_t http_status_code;
+    bool synthetics;
+    bool trace_root;
+
+    bool operator<(const Key& other) const {
+      const auto tie = [](const Key& key) {
+        return std::tie(key.environment, key.version, key.service, key.name,
+                        key.resource, key.type, key.span_kind,
+                        key.http_status_code, key.synthetics, key.trace_root);
+      };
+      return tie(*this) < tie(other);
+    }
+  };
+
+  struct GroupStats {
+    std::uint64_t hits = 0;
+    std::uint64_t top_level_hits = 0;
+    std::uint64_t errors = 0;
+    // The sum of the durations, in nanoseconds.
+    std::uint64_t duration = 0;
+    LatencySketch ok_latencies;
+    LatencySketch error_latencies;
+  };
+
+  using Bucket = std::map<Key, GroupStats>;
+
+  std::mutex mutex_;
+  // The buckets that have stats, by their start time in nanoseconds since the
+  // Unix epoch.  Guarded by `mutex_`.
+  std::map<std::int64_t, Bucket> buckets_;
+  // The number of payloads produced so far.
+  std::atomic<std::uint64_t> sequence_{0};
+  const TracerSignature signature_;
+
+ public:
+  explicit StatsConcentrator(const TracerSignature& signature);
+
+  // Add to the stats the spans, among the specified `spans` of a trace chunk,
+  // that the Datadog Agent would count.
+  void add(const std::vector<std::unique_ptr<SpanData>>& spans);
+
+  // Remove the buckets that ended before the specified `now`, or all buckets
+  // if `force` is true, and return them as MessagePack encoded payloads for
+  // the "/v0.6/stats" endpoint.  There is one payload for each combination of
+  // the environment and version of the spans.
+  Expected<std::vector<std::string>> flush(TimePoint now, bool force);
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,141 @@
+#include "stratified_sampler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+constexpr std::chrono::steady_clock::duration window =
+    std::chrono::seconds(1);
+
+// Return the index of the counter in the specified `row` of a sketch for the
+// pair having the specified `hash`.  The rows' hash functions are derived
+// from the two halves of `hash` by double hashing.
+std::size_t column(std::uint64_t hash, std::size_t row) {
+  const std::uint32_t first = static_cast<std::uint32_t>(hash);
+  const std::uint32_t second = static_cast<std::uint32_t>(hash >> 32) | 1;
+  return (first + row * second) % StratifiedSampler::sketch_width;
+}
+
+}  // namespace
+
+std::uint64_t StratifiedSampler::stratum(StringView service,
+                                         StringView resource) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto mix = [&](StringView text) {
+    for (const char ch : text) {
+      hash ^= static_cast<unsigned char>(ch);
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(service);
+  // Separate the service from the resource, so that ("ab", "c") and
+  // ("a", "bc") usually have different hashes.
+  hash ^= 0xff;
+  hash *= 1099511628211ULL;
+  mix(resource);
+  return hash;
+}
+
+StratifiedSampler::StratifiedSampler(const Clock& clock,
+                                     double target_per_second)
+    : clock_(clock),
+      target_per_second_(target_per_second),
+      current_(0),
+      pairs_(0),
+      share_(target_per_second),
+      window_end_((clock_().tick + window).time_since_epoch().count()) {
+  for (auto& sketch : sketches_) {
+    for (auto& row : sketch) {
+      for (auto& counter : row) {
+        counter.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+Rate StratifiedSampler::sample_rate(StringView service, StringView resource) {
+  return sample_rate(stratum(service, resource));
+}
+
+Rate StratifiedSampler::sample_rate(std::uint64_t hash) {
+  const auto now = clock_().tick;
+  if (now.time_since_epoch().count() >=
+      window_end_.load(std::memory_order_relaxed)) {
+    roll(now);
+  }
+
+  const unsigned current = current_.load(std::memory_order_acquire);
+  Sketch& counts = sketches_[current];
+  const Sketch& previous_counts = sketches_[1 - current];
+  // The estimates are the least of the pair's counters in each sketch.  The
+  // estimate for the current window excludes this root span.
+  std::uint32_t seen = std::numeric_limits<std::uint32_t>::max();
+  std::uint32_t previous = std::numeric_limits<std::uint32_t>::max();
+  for (std::size_t row = 0; row < sketch_depth; ++row) {
+    const std::size_t col = column(hash, row);
+    seen = std::min(seen,
+                    counts[row][col].fetch_add(1, std::memory_order_relaxed));
+    previous = std::min(
+        previous, previous_counts[row][col].load(std::memory_order_relaxed));
+  }
+
+  if (seen == 0 &&
+      double(pairs_.fetch_add(1, std::memory_order_relaxed)) <
+          target_per_second_) {
+    return Rate::one();
+  }
+
+  const double estimate = std::max(double(previous), double(seen) + 1);
+  const double share = share_.load(std::memory_order_relaxed);
+  return *Rate::from(std::min(1.0, share / estimate));
+}
+
+void StratifiedSampler::roll(std::chrono::steady_clock::time_point now) {
+  auto end_ticks = window_end_.load(std::memory_order_relaxed);
+  const std::chrono::steady_clock::time_point end{
+      std::chrono::steady_clock::duration{end_ticks}};
+  if (now < end) {
+    return;
+  }
+  // The windows after the first that elapsed without a call had no root
+  // spans.
+  const auto empty_windows = (now - end) / window;
+  const auto next_end = end + (empty_windows + 1) * window;
+  if (!window_end_.compare_exchange_strong(
+          end_ticks, next_end.time_since_epoch().count(),
+          std::memory_order_relaxed)) {
+    // Another thread ended the window first.
+    return;
+  }
+
+  const auto reset = [](Sketch& sketch) {
+    for (auto& row : sketch) {
+      for (auto& counter : row) {
+        counter.store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  const unsigned current = current_.load(std::memory_order_relaxed);
+  std::uint64_t pairs = pairs_.exchange(0, std::memory_order_relaxed);
+  reset(sketches_[1 - current]);
+  if (empty_windows > 0) {
+    // The window that becomes the previous one saw nothing.
+    reset(sketches_[current]);
+    pairs = 0;
+  }
+
+  // Each pair's first root span in a window is kept, so the pairs seen in
+  // the window that ended split what remains of the target.
+  const double remaining =
+      target_per_second_ - std::min(target_per_second_, double(pairs));
+  share_.store(remaining / double(std::max<std::uint64_t>(pairs, 1)),
+               std::memory_order_relaxed);
+  current_.store(1 - current, std::memory_order_release);
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,93 @@
+#pragma once
+
+// This component provides a `class`, `StratifiedSampler`, that computes sample
+// rates for root spans so that every (service, resource) pair, however rare,
+// is represented among the kept traces, while the heavy hitters share what
+// remains of a target number of traces per second.
+//
+// `TraceSampler` consults a `StratifiedSampler` when
+// `TraceSamplerConfig::stratified_target_per_second` is set and no sampling
+// rule matches the root span.
+//
+// Unlike `AdaptiveSampler`, which tracks at most `AdaptiveSampler::max_keys`
+// pairs in a map, `StratifiedSampler` estimates the throughput of each pair
+// with a count-min sketch of fixed size, and so handles any number of pairs,
+// e.g. resources that contain IDs, in constant memory and without locking.
+//
+// Throughput is measured in one-second windows.  The first root span of each
+// pair in a window has sample rate one, as long as fewer than the target
+// number of pairs were seen in the window.  At the end of each window, the
+// rest of the target is divided evenly among the pairs that the window saw.
+// Each later root span of a pair then has the sample rate that would keep
+// that share of the pair's estimated throughput, which is the greater of its
+// counts in the current and the previous window.
+//
+// The sketch overestimates the throughput of a pair when it collides with
+// busier pairs, so rare pairs are sometimes sampled as if they were busier,
+// and the first root span of a pair in a window is occasionally mistaken for
+// a later one.  With `StratifiedSampler::sketch_width` counters per row, this
+// is unlikely while a window sees fewer than about a thousand pairs.
+//
+// `StratifiedSampler` is safe to use from multiple threads.  `sample_rate`
+// does not lock.  The thread that sees the end of a window resets the oldest
+// sketch, which other threads might read while it does so; the rates that
+// they compute meanwhile are only approximate.
+
+#include <datadog/clock.h>
+#include <datadog/rate.h>
+#include <datadog/string_view.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace datadog {
+namespace tracing {
+
+class StratifiedSampler {
+ public:
+  // The number of rows, i.e. of hash functions, of each count-min sketch.
+  static constexpr std::size_t sketch_depth = 4;
+  // The number of counters in each row of each count-min sketch.
+  static constexpr std::size_t sketch_width = 1024;
+
+  StratifiedSampler(const Clock& clock, double target_per_second);
+
+  StratifiedSampler(const StratifiedSampler&) = delete;
+  StratifiedSampler& operator=(const StratifiedSampler&) = delete;
+
+  // Return the stratum of root spans having the specified `service` and
+  // `resource`, which is the FNV-1a hash of the pair.
+  static std::uint64_t stratum(StringView service, StringView resource);
+
+  // Count a root span having the specified `service` and `resource`, or
+  // having the specified `stratum`, and return the sample rate for it.
+  Rate sample_rate(StringView service, StringView resource);
+  Rate sample_rate(std::uint64_t stratum);
+
+  double target_per_second() const { return target_per_second_; }
+
+ private:
+  using Sketch = std::atomic<std::uint32_t>[sketch_depth][sketch_width];
+
+  Clock clock_;
+  double target_per_second_;
+  // The sketches of the current and the previous window.  The current one is
+  // `sketches_[current_]`.
+  Sketch sketches_[2];
+  std::atomic<unsigned> current_;
+  // The number of pairs seen in the current window.
+  std::atomic<std::uint64_t> pairs_;
+  // The number of traces per second allotted to each pair beyond its first
+  // root span in a window, as computed at the end of the previous window.
+  std::atomic<double> share_;
+  // The end of the current window, as a count of steady clock ticks.
+  std::atomic<std::chrono::steady_clock::rep> window_end_;
+
+  // End the current window (and any that elapsed without calls) if the
+  // specified `now` is past its end and no other thread ends it first.
+  void roll(std::chrono::steady_clock::time_point now);
+};
+
+}  // namespace tracing
+}  // namespace datadog
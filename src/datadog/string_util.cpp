@@ -103,5 +103,18 @@ StringView trim(StringView str) {
   return str;
 }
 
+StringView truncate_utf8(StringView text, std::size_t max_size) {
+  if (max_size == 0 || text.size() <= max_size) {
+    return text;
+  }
+  std::size_t size = max_size;
+  // Back up over continuation bytes (10xxxxxx) to the start of the character
+  // that would be cut.
+  while (size > 0 && (static_cast<unsigned char>(text[size]) & 0xC0) == 0x80) {
+    --size;
+  }
+  return text.substr(0, size);
+}
+
 }  // namespace tracing
 }  // namespace datadog
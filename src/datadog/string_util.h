@@ -3,7 +3,12 @@
 #include <datadog/propagation_style.h>
 #include <datadog/string_view.h>
 
+#include <cassert>
+#include <charconv>
+#include <iterator>
+#include <limits>
 #include <string>
+#include <system_error>
 #include <unordered_map>
 #include <vector>
 
@@ -23,6 +28,18 @@ std::string to_string(bool b);
 // Converts a double value to a string
 std::string to_string(double d, size_t precision);
 
+// Append to the specified `destination` the specified integral `value` in
+// decimal, as `std::to_string` would format it.
+template <typename Integer>
+void append_decimal(std::string& destination, Integer value) {
+  // Room for every digit and a sign.
+  char buffer[std::numeric_limits<Integer>::digits10 + 2];
+  const auto result =
+      std::to_chars(std::begin(buffer), std::end(buffer), value);
+  assert(result.ec == std::errc());
+  destination.append(std::begin(buffer), result.ptr);
+}
+
 // Joins elements of a vector into a single string with a specified separator
 std::string join(const std::vector<StringView>& values, StringView separator);
 
@@ -40,5 +57,10 @@ bool starts_with(StringView subject, StringView prefix);
 // the specified `input`.
 StringView trim(StringView);
 
+// Return the longest prefix of the specified `text` that is at most the
+// specified `max_size` bytes long and that does not end within a UTF-8
+// encoded character.  If `max_size` is zero, return `text`.
+StringView truncate_utf8(StringView text, std::size_t max_size);
+
 }  // namespace tracing
 }  // namespace datadog
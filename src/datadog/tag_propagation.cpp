@@ -4,7 +4,6 @@
 
 #include <algorithm>
 #include <cstddef>
-#include <sstream>
 
 #include "string_util.h"
 
@@ -30,26 +29,29 @@ namespace tracing {
 
 namespace {
 
-// Insert into the specified `destination` a tag decoded from the specified
-// `entry`.  Return an `Error` if an error occurs.
-Expected<void> decode_tag(
-    std::vector<std::pair<std::string, std::string>>& destination,
-    StringView entry) {
-  const auto separator = std::find(entry.begin(), entry.end(), '=');
-  if (separator == entry.end()) {
-    std::string message;
-    message += "invalid key=value pair for encoded tag: missing \"=\" in: ";
-    append(message, entry);
-    return Error{Error::MALFORMED_TRACE_TAGS, std::move(message)};
+// The role of a byte in an encoded tag set.  Bytes outside of the grammar's
+// allowed characters are accepted, as they have always been, and are replaced
+// where the tags are propagated in formats that do not allow them.
+enum class TagByte : unsigned char { ORDINARY, TAG_SEPARATOR, KEY_SEPARATOR };
+
+struct TagByteTable final {
+  TagByte roles[256] = {};
+
+  constexpr TagByteTable() {
+    roles[static_cast<unsigned char>(',')] = TagByte::TAG_SEPARATOR;
+    roles[static_cast<unsigned char>('=')] = TagByte::KEY_SEPARATOR;
   }
+};
 
-  const StringView key = entry.substr(0, separator - entry.cbegin());
-  const StringView value =
-      entry.substr(separator - entry.cbegin() + 1,
-                   separator - entry.cbegin() + entry.size());
-  destination.emplace_back(std::string(key), std::string(value));
+constexpr TagByteTable tag_byte_table;
 
-  return nullopt;
+Error decoding_error(StringView header_value, StringView entry) {
+  std::string message;
+  message += "Error decoding trace tags \"";
+  append(message, header_value);
+  message += "\": invalid key=value pair for encoded tag: missing \"=\" in: ";
+  append(message, entry);
+  return Error{Error::MALFORMED_TRACE_TAGS, std::move(message)};
 }
 
 void append_tag(std::string& serialized_tags, StringView tag_key,
@@ -61,59 +63,101 @@ void append_tag(std::string& serialized_tags, StringView tag_key,
 
 }  // namespace
 
-Expected<std::vector<std::pair<std::string, std::string>>> decode_tags(
-    StringView header_value) {
-  std::vector<std::pair<std::string, std::string>> tags;
-  tags.reserve(header_value.size());
-
-  if (header_value.empty()) return tags;
-
-  std::size_t beg = 0;
-  for (std::size_t i = 0; i < header_value.size(); ++i) {
-    if (header_value[i] == ',') {
-      auto result = decode_tag(tags, header_value.substr(beg, i - beg));
-      if (auto* error = result.if_error()) {
-        std::string prefix;
-        prefix += "Error decoding trace tags \"";
-        append(prefix, header_value);
-        prefix += "\": ";
-        return error->with_prefix(prefix);
+Expected<void> decode_tags(
+    StringView header_value, StringView key_prefix,
+    std::vector<std::pair<StringView, StringView>>& destination) {
+  const char* const data = header_value.data();
+  const std::size_t size = header_value.size();
+
+  // Each tag is found in one pass over its bytes: the first '=' ends its key,
+  // and the next ',' ends its value.
+  std::size_t begin = 0;
+  while (begin != size) {
+    std::size_t equal = std::string::npos;
+    std::size_t end = begin;
+    for (; end != size; ++end) {
+      const TagByte role =
+          tag_byte_table.roles[static_cast<unsigned char>(data[end])];
+      if (role == TagByte::TAG_SEPARATOR) {
+        break;
       }
+      if (role == TagByte::KEY_SEPARATOR && equal == std::string::npos) {
+        equal = end;
+      }
+    }
 
-      beg = i + 1;
+    if (equal == std::string::npos) {
+      return decoding_error(header_value,
+                            header_value.substr(begin, end - begin));
+    }
+
+    const StringView key = header_value.substr(begin, equal - begin);
+    if (starts_with(key, key_prefix)) {
+      destination.emplace_back(
+          key, header_value.substr(equal + 1, end - (equal + 1)));
     }
-  }
 
-  if (beg != header_value.size()) {
-    auto result =
-        decode_tag(tags, header_value.substr(beg, header_value.size() - beg));
-    if (auto* error = result.if_error()) {
-      std::string prefix;
-      prefix += "Error decoding trace tags \"";
-      append(prefix, header_value);
-      prefix += "\": ";
-      return error->with_prefix(prefix);
+    if (end == size) {
+      break;
     }
+    begin = end + 1;
   }
 
+  return nullopt;
+}
+
+Expected<std::vector<std::pair<std::string, std::string>>> decode_tags(
+    StringView header_value) {
+  std::vector<std::pair<StringView, StringView>> views;
+  auto result = decode_tags(header_value, "", views);
+  if (auto* error = result.if_error()) {
+    return std::move(*error);
+  }
+
+  std::vector<std::pair<std::string, std::string>> tags;
+  tags.reserve(views.size());
+  for (const auto& [key, value] : views) {
+    tags.emplace_back(std::string(key), std::string(value));
+  }
   return tags;
 }
 
 std::string encode_tags(
     const std::vector<std::pair<std::string, std::string>>& trace_tags) {
   std::string result;
-  auto iter = trace_tags.begin();
-  if (iter == trace_tags.end()) {
-    return result;
-  }
+  append_tags(result, TraceTagsView{&trace_tags});
+  return result;
+}
 
-  append_tag(result, iter->first, iter->second);
-  for (++iter; iter != trace_tags.end(); ++iter) {
-    result += ',';
-    append_tag(result, iter->first, iter->second);
-  }
+void append_tags(std::string& destination, TraceTagsView trace_tags) {
+  bool first = true;
+  trace_tags.for_each([&](StringView key, StringView value) {
+    if (!first) {
+      destination += ',';
+    }
+    first = false;
+    append_tag(destination, key, value);
+  });
+}
 
-  return result;
+std::size_t append_tags(std::string& destination, TraceTagsView trace_tags,
+                        std::size_t max_size) {
+  const std::size_t original_size = destination.size();
+  std::size_t size = 0;
+  trace_tags.for_each([&](StringView key, StringView value) {
+    size += (size != 0) + key.size() + 1 + value.size();
+    if (size > max_size) {
+      // Keep counting, so that the caller can report the size, but do not
+      // copy anything more.
+      destination.resize(original_size);
+      return;
+    }
+    if (destination.size() != original_size) {
+      destination += ',';
+    }
+    append_tag(destination, key, value);
+  });
+  return size;
 }
 
 }  // namespace tracing
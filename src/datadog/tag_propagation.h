@@ -14,6 +14,7 @@
 #include <datadog/expected.h>
 #include <datadog/string_view.h>
 
+#include <cstddef>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,10 +27,52 @@ namespace tracing {
 Expected<std::vector<std::pair<std::string, std::string>>> decode_tags(
     StringView header_value);
 
+// Append to the specified `destination` the key and value of each tag in the
+// specified `header_value` whose key begins with the specified `key_prefix`.
+// The appended keys and values refer to `header_value`.  Return an `Error` if
+// an error occurs, in which case `destination` might contain some of the
+// tags.
+Expected<void> decode_tags(
+    StringView header_value, StringView key_prefix,
+    std::vector<std::pair<StringView, StringView>>& destination);
+
+// `TraceTagsView` refers to a sequence of trace tags: those in a vector,
+// optionally followed by one more tag, so that a tag can be added to the
+// sequence without copying the vector.
+struct TraceTagsView {
+  const std::vector<std::pair<std::string, std::string>>* tags;
+  // A tag that follows `tags`, or null.
+  const std::pair<std::string, std::string>* extra = nullptr;
+
+  // Invoke the specified `visit` with the key and value of each tag, in
+  // order.
+  template <typename Visitor>
+  void for_each(Visitor&& visit) const {
+    for (const auto& [key, value] : *tags) {
+      visit(key, value);
+    }
+    if (extra) {
+      visit(extra->first, extra->second);
+    }
+  }
+};
+
 // Serialize the specified `trace_tags` into the propagation format and return
 // the resulting string.
 std::string encode_tags(
     const std::vector<std::pair<std::string, std::string>>& trace_tags);
 
+// Serialize the specified `trace_tags` into the propagation format, appending
+// the result to the specified `destination`.
+void append_tags(std::string& destination, TraceTagsView trace_tags);
+
+// Serialize the specified `trace_tags` into the propagation format, appending
+// the result to the specified `destination` if it is no longer than the
+// specified `max_size`.  Return the size of the serialized tags.  If the size
+// exceeds `max_size`, then `destination` is left unmodified, and the tags
+// following the first that does not fit are measured but not copied.
+std::size_t append_tags(std::string& destination, TraceTagsView trace_tags,
+                        std::size_t max_size);
+
 }  // namespace tracing
 }  // namespace datadog
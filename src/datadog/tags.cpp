@@ -13,6 +13,7 @@ const std::string version = "version";
 const std::string http_endpoint = "http.endpoint";
 const std::string http_route = "http.route";
 const std::string http_url = "http.url";
+const std::string error_stack = "error.stack";
 
 namespace internal {
 
@@ -36,6 +37,16 @@ const std::string w3c_parent_id = "_dd.parent_id";
 const std::string trace_source = "_dd.p.ts";
 const std::string apm_enabled = "_dd.apm.enabled";
 const std::string ksr = "_dd.p.ksr";
+const std::string trace_truncated = "_dd.trace.truncated";
+const std::string span_orphaned = "_dd.span.orphaned";
+const std::string rollup_count = "_dd.rollup.count";
+const std::string rollup_errors = "_dd.rollup.errors";
+const std::string rollup_duration_total = "_dd.rollup.duration.total";
+const std::string rollup_duration_min = "_dd.rollup.duration.min";
+const std::string rollup_duration_max = "_dd.rollup.duration.max";
+const std::string tail_sampling_reason = "_dd.tail_sampling.reason";
+const std::string overhead_dropped = "_dd.overhead.dropped";
+const std::string sampling_stratum = "_dd.sampling.stratum";
 
 }  // namespace internal
 
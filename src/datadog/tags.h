@@ -22,6 +22,7 @@ extern const std::string version;
 extern const std::string http_endpoint;
 extern const std::string http_route;
 extern const std::string http_url;
+extern const std::string error_stack;
 
 namespace internal {
 extern const std::string propagation_error;
@@ -44,6 +45,16 @@ extern const std::string w3c_parent_id;
 extern const std::string trace_source;  // _dd.p.ts
 extern const std::string apm_enabled;   // _dd.apm.enabled
 extern const std::string ksr;           // _dd.p.ksr
+extern const std::string trace_truncated;  // _dd.trace.truncated
+extern const std::string span_orphaned;   // _dd.span.orphaned
+extern const std::string rollup_count;    // _dd.rollup.count
+extern const std::string rollup_errors;   // _dd.rollup.errors
+extern const std::string rollup_duration_total;
+extern const std::string rollup_duration_min;
+extern const std::string rollup_duration_max;
+extern const std::string tail_sampling_reason;  // _dd.tail_sampling.reason
+extern const std::string overhead_dropped;      // _dd.overhead.dropped
+extern const std::string sampling_stratum;      // _dd.sampling.stratum
 
 }  // namespace internal
 
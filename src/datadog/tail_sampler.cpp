@@ -0,0 +1,157 @@
+#include "tail_sampler.h"
+
+#include <datadog/collector.h>
+#include <datadog/logger.h>
+#include <datadog/sampling_mechanism.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/telemetry/metrics.h>
+#include <datadog/telemetry/telemetry.h>
+#include <datadog/tracer_config.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "resource_latencies.h"
+#include "span_data.h"
+#include "span_sampler.h"
+#include "tags.h"
+#include "telemetry_metrics.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+std::int64_t nanoseconds(Duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+}
+
+}  // namespace
+
+TailSampler::TailSampler(const FinalizedTracerConfig& config,
+                         std::shared_ptr<Collector> collector,
+                         std::shared_ptr<SpanSampler> span_sampler,
+                         std::shared_ptr<const ResourceLatencies> latencies)
+    : collector_(std::move(collector)),
+      span_sampler_(std::move(span_sampler)),
+      logger_(config.logger),
+      latencies_(std::move(latencies)),
+      max_buffered_bytes_(config.tail_sampling_max_buffered_bytes),
+      latency_quantile_(config.tail_sampling_latency_percentile / 100),
+      limiter_(config.tail_sampling_max_per_second > 0
+                   ? std::make_unique<Limiter>(
+                         config.clock, config.tail_sampling_max_per_second)
+                   : nullptr),
+      pending_bytes_(0) {
+  assert(collector_);
+  assert(span_sampler_);
+  assert(latencies_);
+  cancel_flush_ = config.event_scheduler->schedule_recurring_event(
+      config.tail_sampling_window, [this]() { flush(); });
+}
+
+TailSampler::~TailSampler() {
+  cancel_flush_();
+  flush();
+}
+
+void TailSampler::add(std::vector<std::unique_ptr<SpanData>>&& spans,
+                      const Optional<std::string>& hostname,
+                      std::shared_ptr<TraceSampler> response_handler) {
+  assert(!spans.empty());
+  std::size_t bytes = 0;
+  for (const auto& span : spans) {
+    bytes += estimated_encoded_size(*span);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(
+        Pending{std::move(spans), hostname, std::move(response_handler)});
+    pending_bytes_ += bytes;
+    if (pending_bytes_ < max_buffered_bytes_) {
+      return;
+    }
+  }
+
+  // The buffer is full, so its chunks are decided now, rather than when the
+  // window elapses.
+  flush();
+}
+
+void TailSampler::flush() {
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    using std::swap;
+    swap(batch, pending_);
+    pending_bytes_ = 0;
+  }
+
+  for (auto& chunk : batch) {
+    decide_and_send(std::move(chunk));
+  }
+}
+
+bool TailSampler::is_slow(const Pending& chunk) const {
+  const SpanData& local_root = *chunk.spans.front();
+  // The local root's duration was added to `latencies_` when it finished, so
+  // its resource is tracked unless many other resources have since finished.
+  const auto threshold = latencies_->quantile(
+      local_root.service, local_root.resource, latency_quantile_);
+  return threshold &&
+         nanoseconds(local_root.duration) >= std::int64_t(*threshold);
+}
+
+void TailSampler::decide_and_send(Pending&& chunk) {
+  SpanData& local_root = *chunk.spans.front();
+  const bool has_error =
+      std::any_of(chunk.spans.begin(), chunk.spans.end(),
+                  [](const auto& span) { return span->error; });
+  // The limiter is consulted only for traces that are not otherwise kept, so
+  // that they do not use up its allowance.
+  const char* reason = nullptr;
+  if (has_error) {
+    reason = "error";
+  } else if (is_slow(chunk)) {
+    reason = "latency";
+  } else if (limiter_ && limiter_->allow().allowed) {
+    reason = "limit";
+  }
+  const bool keep = reason != nullptr;
+
+  const int priority = keep ? int(SamplingPriority::AUTO_KEEP)
+                            : int(SamplingPriority::AUTO_DROP);
+  local_root.numeric_tags[tags::internal::sampling_priority] = priority;
+  if (keep) {
+    // The tail sampler's criteria act as sampling rules local to this
+    // tracer.  Which of them kept the trace is not propagated.
+    local_root.tags[tags::internal::decision_maker] =
+        "-" + std::to_string(int(SamplingMechanism::RULE));
+    local_root.tags[tags::internal::tail_sampling_reason] = reason;
+  } else {
+    telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                  {"reason:p0_drop"});
+    span_sampler_->sample_spans_of_dropped_trace(chunk.spans);
+  }
+
+  telemetry::distribution::add(metrics::tracer::trace_chunk_size,
+                               chunk.spans.size());
+  static const auto chunks_sent =
+      telemetry::counter::handle(metrics::tracer::trace_chunks_sent, {});
+  chunks_sent.increment();
+  TraceChunk trace_chunk;
+  trace_chunk.spans = std::move(chunk.spans);
+  trace_chunk.sampling_priority = priority;
+  trace_chunk.hostname = std::move(chunk.hostname);
+  const auto result =
+      collector_->send_chunk(std::move(trace_chunk), chunk.response_handler);
+  if (auto* error = result.if_error()) {
+    logger_->log_error(
+        error->with_prefix("Error sending spans to collector: "));
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
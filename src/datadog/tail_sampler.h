@@ -0,0 +1,111 @@
+#pragma once
+
+// This component provides a class, `TailSampler`, that makes the sampling
+// decisions of traces after they finish, when it is known whether they had
+// an error and how long they took.
+//
+// The trace sampler (see `trace_sampler.h`) decides whether to keep a trace
+// when the decision is first needed, which is often when the trace's root span
+// is created or when the trace is first propagated.  A trace that begins in
+// this process and is never propagated elsewhere, however, can be decided by
+// a `TailSampler` once its trace segment finishes (see
+// `TracerConfig::tail_sampling_enabled`).
+//
+// `TailSampler` buffers the chunks of such traces for a window of time, and
+// then decides all of them at once.  If the buffer reaches its limit on the
+// estimated encoded size of its spans, then the buffered chunks are decided
+// before the window elapses.  A trace is kept if any of its spans is an error,
+// or if its local root lasted at least as long as a percentile of the recent
+// durations of the local roots having the same service and resource (see
+// `resource_latencies.h`).  Otherwise, it is kept if a rate limiter allows
+// it.
+// Kept and dropped chunks alike are then sent to the `Collector`, as other
+// chunks are, so that the Datadog Agent's trace metrics count them.
+
+#include <datadog/clock.h>
+#include <datadog/event_scheduler.h>
+#include <datadog/optional.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "limiter.h"
+
+namespace datadog {
+namespace tracing {
+
+class Collector;
+class FinalizedTracerConfig;
+class Logger;
+class ResourceLatencies;
+struct SpanData;
+class SpanSampler;
+class TraceSampler;
+
+class TailSampler {
+  // `Pending` is a chunk waiting for its decision.
+  struct Pending {
+    std::vector<std::unique_ptr<SpanData>> spans;
+    Optional<std::string> hostname;
+    std::shared_ptr<TraceSampler> response_handler;
+  };
+
+  const std::shared_ptr<Collector> collector_;
+  const std::shared_ptr<SpanSampler> span_sampler_;
+  const std::shared_ptr<Logger> logger_;
+  const std::shared_ptr<const ResourceLatencies> latencies_;
+  const std::size_t max_buffered_bytes_;
+  // Between 0 and 1.
+  const double latency_quantile_;
+  // Null if no trace is kept on account of the limiter.
+  const std::unique_ptr<Limiter> limiter_;
+
+  std::mutex mutex_;
+  std::vector<Pending> pending_;
+  std::size_t pending_bytes_;
+
+  EventScheduler::Cancel cancel_flush_;
+
+ public:
+  // Create a sampler configured by the `tail_sampling_*` members of the
+  // specified `config`, that sends chunks to the specified `collector`, and
+  // that applies the specified `span_sampler` to dropped traces, and that
+  // compares the durations of local roots with the specified `latencies`.
+  // Decide the buffered chunks periodically using `config.event_scheduler`.
+  TailSampler(const FinalizedTracerConfig& config,
+              std::shared_ptr<Collector> collector,
+              std::shared_ptr<SpanSampler> span_sampler,
+              std::shared_ptr<const ResourceLatencies> latencies);
+  TailSampler(const TailSampler&) = delete;
+  TailSampler& operator=(const TailSampler&) = delete;
+
+  // Decide and send any buffered chunks.
+  ~TailSampler();
+
+  // Buffer the specified `spans`, which are the whole of a finished trace
+  // whose local root is first, until their sampling decision is made.  The
+  // chunk is sent with the specified `hostname` and `response_handler`, as
+  // `TraceSegment` otherwise sends it.  If the buffer is then full, decide and
+  // send the buffered chunks before returning.
+  void add(std::vector<std::unique_ptr<SpanData>>&& spans,
+           const Optional<std::string>& hostname,
+           std::shared_ptr<TraceSampler> response_handler);
+
+  // Decide and send the buffered chunks.
+  void flush();
+
+ private:
+  // Return whether the local root of the specified `chunk` lasted at least as
+  // long as the latency percentile of its service and resource.
+  bool is_slow(const Pending& chunk) const;
+  // Decide and then send the specified `chunk`.
+  void decide_and_send(Pending&& chunk);
+};
+
+}  // namespace tracing
+}  // namespace datadog
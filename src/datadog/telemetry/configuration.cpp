@@ -3,6 +3,7 @@
 #include <datadog/telemetry/configuration.h>
 #include <datadog/version.h>
 
+#include "compression.h"
 #include "parse_util.h"
 
 using namespace datadog::tracing;
@@ -122,6 +123,14 @@ tracing::Expected<FinalizedConfiguration> finalize_config(
       pick(env_config->integration_version, user_config.integration_version,
            tracing::tracer_version);
 
+  // compression_enabled
+  result.compression_enabled = user_config.compression_enabled.value_or(false);
+  if (result.compression_enabled && !gzip_available()) {
+    return Error{Error::TELEMETRY_COMPRESSION_UNAVAILABLE,
+                 "Telemetry compression is enabled, but this library was built "
+                 "without support for it."};
+  }
+
   // products
   result.products = user_config.products;
 
@@ -0,0 +1,122 @@
+#include "distribution_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace datadog::telemetry {
+namespace {
+
+/// The ratio of the bounds of each bucket.
+const double growth = (1 + DistributionSketch::relative_accuracy) /
+                      (1 - DistributionSketch::relative_accuracy);
+const double log_growth = std::log(growth);
+
+/// Returns the index of the bucket of the specified nonzero `value`. Bucket
+/// `i` contains the values in (growth^(i-1), growth^i].
+int bucket_index(uint64_t value) {
+  return static_cast<int>(std::ceil(std::log(double(value)) / log_growth));
+}
+
+/// Returns the representative value of the bucket having the specified
+/// `index`, which is within the relative accuracy of every value in the
+/// bucket.
+uint64_t bucket_value(int index) {
+  const double value = 2 * std::pow(growth, index) / (growth + 1);
+  if (value >= 18446744073709551615.0) {
+    return UINT64_MAX;
+  }
+  return std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(value)));
+}
+
+}  // namespace
+
+void DistributionSketch::add(uint64_t value) {
+  if (count_ < max_points) {
+    exact_.push_back(value);
+    ++count_;
+    return;
+  }
+
+  if (count_ == max_points) {
+    move_exact_to_buckets();
+  }
+  add_to_buckets(value, 1);
+  ++count_;
+}
+
+void DistributionSketch::merge(const DistributionSketch& other) {
+  if (other.is_exact()) {
+    for (const uint64_t point : other.exact_) {
+      add(point);
+    }
+    return;
+  }
+
+  if (is_exact()) {
+    move_exact_to_buckets();
+  }
+  zeros_ += other.zeros_;
+  for (std::size_t i = 0; i < other.buckets_.size(); ++i) {
+    if (other.buckets_[i]) {
+      add_to_bucket(other.first_bucket_ + int(i), other.buckets_[i]);
+    }
+  }
+  count_ += other.count_;
+}
+
+void DistributionSketch::move_exact_to_buckets() {
+  for (const uint64_t point : exact_) {
+    add_to_buckets(point, 1);
+  }
+  exact_.clear();
+  exact_.shrink_to_fit();
+}
+
+void DistributionSketch::add_to_buckets(uint64_t value, uint64_t count) {
+  if (value == 0) {
+    zeros_ += count;
+  } else {
+    add_to_bucket(bucket_index(value), count);
+  }
+}
+
+void DistributionSketch::add_to_bucket(int index, uint64_t count) {
+  if (buckets_.empty()) {
+    first_bucket_ = index;
+    buckets_.push_back(0);
+  } else if (index < first_bucket_) {
+    buckets_.insert(buckets_.begin(), std::size_t(first_bucket_ - index), 0);
+    first_bucket_ = index;
+  } else if (index >= first_bucket_ + int(buckets_.size())) {
+    buckets_.resize(std::size_t(index - first_bucket_ + 1), 0);
+  }
+  buckets_[std::size_t(index - first_bucket_)] += count;
+}
+
+std::vector<uint64_t> DistributionSketch::points() const {
+  if (is_exact()) {
+    return exact_;
+  }
+
+  // Each bucket gets as many of the `max_points` points as its cumulative
+  // share of the count, rounded, so that the total is exactly `max_points`.
+  std::vector<uint64_t> result;
+  result.reserve(max_points);
+  uint64_t cumulative = 0;
+  const auto emit = [&](uint64_t value, uint64_t bucket_count) {
+    cumulative += bucket_count;
+    const auto end = std::size_t(
+        (double(cumulative) * max_points + double(count_) / 2) / count_);
+    result.resize(std::min(end, max_points), value);
+  };
+
+  emit(0, zeros_);
+  for (std::size_t i = 0; i < buckets_.size(); ++i) {
+    if (buckets_[i]) {
+      emit(bucket_value(first_bucket_ + int(i)), buckets_[i]);
+    }
+  }
+  return result;
+}
+
+}  // namespace datadog::telemetry
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace datadog::telemetry {
+
+/// `DistributionSketch` stores the data points of a telemetry distribution in
+/// bounded memory, regardless of how many points are added.
+///
+/// The first `max_points` points are kept as they are. Beyond that, the
+/// points are counted in buckets whose bounds grow geometrically, in the
+/// manner of DDSketch: every value in a bucket is within `relative_accuracy`
+/// of the bucket's representative value. There are at most a few thousand
+/// buckets for the whole range of `uint64_t`, and only the buckets between the
+/// smallest and the largest point are stored.
+///
+/// Sketches can be merged, and `points` returns at most `max_points` points
+/// whose quantiles approximate those of the added points.
+class DistributionSketch final {
+ public:
+  /// The number of points kept exactly, and the maximum number of points
+  /// returned by `points`.
+  static constexpr std::size_t max_points = 1024;
+  static constexpr double relative_accuracy = 0.01;
+
+  /// Adds the specified `value`.
+  void add(uint64_t value);
+
+  /// Adds the points of the specified `other` sketch.
+  void merge(const DistributionSketch& other);
+
+  /// Returns the number of points added.
+  uint64_t count() const { return count_; }
+
+  /// Returns the points added, if there are at most `max_points`, in the
+  /// order they were added. Otherwise, returns `max_points` representative
+  /// values in increasing order, each appearing in proportion to the number of
+  /// points in its bucket.
+  std::vector<uint64_t> points() const;
+
+ private:
+  uint64_t count_ = 0;
+  /// The points, while there are at most `max_points`.
+  std::vector<uint64_t> exact_;
+  /// The number of zero points, once `exact_` is no longer used.
+  uint64_t zeros_ = 0;
+  /// The number of points in each bucket, starting at `first_bucket_`, once
+  /// `exact_` is no longer used.
+  std::vector<uint64_t> buckets_;
+  int first_bucket_ = 0;
+
+  bool is_exact() const { return count_ <= max_points; }
+  void move_exact_to_buckets();
+  void add_to_buckets(uint64_t value, uint64_t count);
+  void add_to_bucket(int index, uint64_t count);
+};
+
+}  // namespace datadog::telemetry
@@ -1,6 +1,10 @@
+#pragma once
+
 #include <datadog/optional.h>
 #include <datadog/string_view.h>
 
+#include <chrono>
+#include <cstddef>
 #include <string>
 
 namespace datadog::telemetry {
@@ -12,6 +16,8 @@ struct LogMessage final {
   LogLevel level;
   tracing::Optional<std::string> stacktrace;
   std::chrono::seconds::rep timestamp;
+  /// The number of times that the message was logged.
+  std::size_t count = 1;
 };
 
 inline tracing::StringView to_string(LogLevel level) {
@@ -0,0 +1,87 @@
+#include "log_queue.h"
+
+#include <string>
+#include <utility>
+
+namespace datadog::telemetry {
+namespace {
+
+constexpr std::size_t mask = LogQueue::capacity - 1;
+static_assert((LogQueue::capacity & mask) == 0,
+              "LogQueue::capacity must be a power of two");
+
+bool same_log(const LogMessage& left, const LogMessage& right) {
+  return left.level == right.level && left.message == right.message &&
+         left.stacktrace == right.stacktrace;
+}
+
+}  // namespace
+
+LogQueue::LogQueue() : slots_(std::make_unique<Slot[]>(capacity)) {
+  for (std::size_t i = 0; i < capacity; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool LogQueue::push(LogMessage&& message) {
+  std::size_t position = tail_.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot& slot = slots_[position & mask];
+    const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      // The slot is free.  Claim it, unless another producer did first.
+      if (tail_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        slot.message = std::move(message);
+        slot.sequence.store(position + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (static_cast<std::ptrdiff_t>(sequence - position) < 0) {
+      // The slot still holds the message pushed `capacity` positions ago, so
+      // the queue is full.
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      // Another producer claimed the slot.
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void LogQueue::drain(std::vector<LogMessage>& destination,
+                     std::chrono::seconds::rep now) {
+  for (;;) {
+    Slot& slot = slots_[head_ & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+      // The queue is empty, or the next message is still being written.
+      break;
+    }
+
+    LogMessage message = std::move(slot.message);
+    slot.sequence.store(head_ + capacity, std::memory_order_release);
+    ++head_;
+
+    bool merged = false;
+    for (auto& existing : destination) {
+      if (same_log(existing, message)) {
+        existing.count += message.count;
+        merged = true;
+        break;
+      }
+    }
+    if (!merged) {
+      destination.push_back(std::move(message));
+    }
+  }
+
+  if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed)) {
+    std::string message = std::to_string(dropped);
+    message +=
+        " telemetry log messages were dropped because too many were logged "
+        "between heartbeats.";
+    destination.push_back(LogMessage{std::move(message), LogLevel::WARNING,
+                                     tracing::nullopt, now});
+  }
+}
+
+}  // namespace datadog::telemetry
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "log.h"
+
+namespace datadog::telemetry {
+
+/// `LogQueue` is a bounded queue of `LogMessage`s, into which any number of
+/// threads can push without locking, and from which one thread at a time
+/// drains.
+///
+/// The queue is a ring of `capacity` slots, each having a sequence number
+/// that tells producers and the consumer whose turn it is to use the slot, in
+/// the manner of Dmitry Vyukov's bounded MPMC queue. A message pushed when
+/// the ring is full is dropped and counted, so that logging never blocks and
+/// the memory used is bounded.
+class LogQueue final {
+ public:
+  static constexpr std::size_t capacity = 256;
+
+  LogQueue();
+
+  /// Pushes the specified `message`, or drops it if the queue is full. Returns
+  /// whether `message` was pushed.
+  bool push(LogMessage&& message);
+
+  /// Moves the queued messages into the specified `destination`. Identical
+  /// messages, including those already in `destination`, are merged into one
+  /// whose `count` is their total. If messages were dropped since the last
+  /// drain, a warning saying how many, timestamped with the specified `now`,
+  /// is appended. Only one thread at a time may drain the queue.
+  void drain(std::vector<LogMessage>& destination,
+             std::chrono::seconds::rep now);
+
+ private:
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    LogMessage message;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::size_t head_ = 0;
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace datadog::telemetry
@@ -19,10 +19,10 @@ struct MetricContext final {
   std::vector<std::string> tags;
 
   std::size_t hash() const {
-    common::FastHash h(3028);
-    h.append(id.name.data(), id.name.size());
-    h.append(id.scope.data(), id.scope.size());
-    h.append(&id.common, sizeof(id.common));
+    if (tags.empty()) {
+      return static_cast<std::size_t>(id.hash);
+    }
+    common::FastHash h(id.hash);
     for (const auto& t : tags) {
       h.append(t.data(), t.size());
     }
@@ -30,8 +30,9 @@ struct MetricContext final {
   }
 
   bool operator==(const MetricContext<Metric>& rhs) const {
-    return id.name == rhs.id.name && id.scope == rhs.id.scope &&
-           id.common == rhs.id.common && tags == rhs.tags;
+    return id.hash == rhs.id.hash && id.name == rhs.id.name &&
+           id.scope == rhs.id.scope && id.common == rhs.id.common &&
+           tags == rhs.tags;
   }
 };
 
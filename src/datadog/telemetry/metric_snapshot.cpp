@@ -0,0 +1,30 @@
+#include "metric_snapshot.h"
+
+namespace datadog::telemetry {
+
+void MetricSnapshot::add(std::time_t timestamp, uint64_t value) {
+  if (size_ == capacity) {
+    // Combine the oldest point into the next oldest, which keeps its
+    // timestamp.
+    const Slot& oldest = slots_[first_];
+    Slot& next = slots_[(first_ + 1) % capacity];
+    next.total += oldest.total;
+    next.weight += oldest.weight;
+    first_ = (first_ + 1) % capacity;
+    --size_;
+  }
+
+  slots_[(first_ + size_) % capacity] = Slot{timestamp, value, 1};
+  ++size_;
+}
+
+MetricSnapshot::Point MetricSnapshot::operator[](std::size_t index) const {
+  const Slot& slot = slots_[(first_ + index) % capacity];
+  if (combine_ == Combine::sum) {
+    return {slot.timestamp, slot.total};
+  }
+  // The mean, rounded to the nearest integer.
+  return {slot.timestamp, (slot.total + slot.weight / 2) / slot.weight};
+}
+
+}  // namespace datadog::telemetry
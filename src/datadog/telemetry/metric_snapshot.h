@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <utility>
+
+namespace datadog::telemetry {
+
+/// `MetricSnapshot` stores the points of a counter or rate captured between
+/// telemetry payloads, in fixed memory, regardless of how many are captured.
+///
+/// The points are kept in a ring of `capacity` points. When the ring is full,
+/// the oldest point is combined with the next oldest before another point is
+/// added, so that the snapshot of a metric stays the same size however long
+/// the points are not sent. Counters are combined by adding their values, so
+/// that the total count is kept. Rates are combined by averaging their values,
+/// weighted by the number of points that each already combines.
+class MetricSnapshot final {
+ public:
+  /// The number of points kept.
+  static constexpr std::size_t capacity = 16;
+
+  using Point = std::pair<std::time_t, uint64_t>;
+
+  /// How the values of points are combined.
+  enum class Combine : char { sum, mean };
+
+  explicit MetricSnapshot(Combine combine = Combine::sum)
+      : combine_(combine) {}
+
+  /// Adds the specified `value` captured at the specified `timestamp`.
+  void add(std::time_t timestamp, uint64_t value);
+
+  /// Returns the number of points, which is at most `capacity`.
+  std::size_t size() const { return size_; }
+
+  /// Returns the point at the specified `index`, from oldest to newest.
+  Point operator[](std::size_t index) const;
+
+ private:
+  struct Slot {
+    std::time_t timestamp = 0;
+    /// The sum of the values of the captured points that the slot combines,
+    /// and their number.
+    uint64_t total = 0;
+    uint64_t weight = 0;
+  };
+
+  std::array<Slot, capacity> slots_;
+  std::size_t first_ = 0;
+  std::size_t size_ = 0;
+  Combine combine_;
+};
+
+}  // namespace datadog::telemetry
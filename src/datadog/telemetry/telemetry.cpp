@@ -1,6 +1,8 @@
 #include <datadog/optional.h>
 #include <datadog/telemetry/telemetry.h>
 
+#include <thread>
+
 #include "telemetry_impl.h"
 
 namespace datadog::telemetry {
@@ -118,6 +120,49 @@ void error(std::string message, std::string stacktrace) {
 }  // namespace log
 
 namespace counter {
+namespace {
+
+std::size_t shard_count() {
+  std::size_t count = 1;
+  const std::size_t threads = std::thread::hardware_concurrency();
+  while (count < threads && count < 64) {
+    count *= 2;
+  }
+  return count;
+}
+
+}  // namespace
+
+ShardedValue::ShardedValue() {
+  static const std::size_t count = shard_count();
+  shards_ = std::make_unique<Shard[]>(count);
+  mask_ = count - 1;
+}
+
+std::size_t ShardedValue::next_thread_shard() {
+  static std::atomic<std::size_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ShardedValue::exchange_zero() {
+  uint64_t sum = 0;
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    sum += shards_[i].value.exchange(0, std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+Handle handle(const Counter& counter, const std::vector<std::string>& tags) {
+  return std::visit(
+      details::Overload{
+          [&](Telemetry& telemetry) {
+            return telemetry.counter_handle(counter, tags);
+          },
+          [](auto&&) { return Handle{}; },
+      },
+      instance());
+}
+
 void increment(const Counter& counter) {
   std::visit(
       details::Overload{
@@ -8,9 +8,14 @@
 #include <datadog/telemetry/telemetry.h>
 #include <datadog/tracer_signature.h>
 
+#include <algorithm>
 #include <chrono>
+#include <utility>
 
+#include "common/hash.h"
+#include "compression.h"
 #include "datadog_agent.h"
+#include "json_writer.h"
 #include "platform_util.h"
 
 using namespace datadog::tracing;
@@ -22,27 +27,28 @@ namespace internal_metrics {
 /// The number of logs created with a given log level. Useful for calculating
 /// impact for other features (automatic sending of logs). Levels should be one
 /// of `debug`, `info`, `warn`, `error`, `critical`.
-const telemetry::Counter logs_created{"logs_created", "general", true};
+constexpr telemetry::Counter logs_created{"logs_created", "general", true};
 
 /// The number of requests sent to the api endpoint in the agent that errored,
 /// tagged by the error type (e.g. `type:timeout`, `type:network`,
 /// `type:status_code`) and Endpoint (`endpoint:agent`, `endpoint:agentless`).
-const telemetry::Counter errors{"telemetry_api.errors", "telemetry", true};
+constexpr telemetry::Counter errors{"telemetry_api.errors", "telemetry", true};
 
 /// The number of requests sent to a telemetry endpoint, regardless of success,
 /// tagged by the endpoint (`endpoint:agent`, `endpoint:agentless`).
-const telemetry::Counter requests{"telemetry_api.requests", "telemetry", true};
+constexpr telemetry::Counter requests{"telemetry_api.requests", "telemetry",
+                                      true};
 
 /// The number of responses received from the endpoint, tagged with status code
 /// (`status_code:200`, `status_code:404`) and endpoint (`endpoint:agent`,
 /// `endpoint:agentless`).
-const telemetry::Counter responses{"telemetry_api.responses", "telemetry",
-                                   true};
+constexpr telemetry::Counter responses{"telemetry_api.responses", "telemetry",
+                                       true};
 
 /// The size of the payload sent to the stats endpoint in bytes, tagged by the
 /// endpoint (`endpoint:agent`, `endpoint:agentless`).
-const telemetry::Distribution bytes_sent{"telemetry_api.bytes", "telemetry",
-                                         true};
+constexpr telemetry::Distribution bytes_sent{"telemetry_api.bytes", "telemetry",
+                                             true};
 
 /// The time it takes to send the payload sent to the endpoint in ms, tagged by
 /// the endpoint (`endpoint:agent`, `endpoint:agentless`).
@@ -53,8 +59,29 @@ const telemetry::Distribution bytes_sent{"telemetry_api.bytes", "telemetry",
 
 namespace {
 
+// Return a hash of what is reported of the specified configuration field:
+// its value, its origin and its error.
+std::uint64_t config_hash(const ConfigMetadata& metadata) {
+  common::FastHash hasher(0);
+  hasher.append(metadata.value.data(), metadata.value.size());
+  const char origin = char(metadata.origin);
+  hasher.append(&origin, 1);
+  if (metadata.error) {
+    const int code = int(metadata.error->code);
+    hasher.append(&code, sizeof code);
+    hasher.append(metadata.error->message.data(),
+                  metadata.error->message.size());
+  }
+  return hasher.final();
+}
+
 constexpr std::chrono::steady_clock::duration request_timeout = 2s;
 
+// When compression is enabled, payloads smaller than this are sent
+// uncompressed, because compressing them saves little.
+constexpr std::size_t compression_min_bytes = 1024;
+constexpr int compression_level = 6;
+
 HTTPClient::URL make_telemetry_endpoint(HTTPClient::URL url) {
   append(url.path, "/telemetry/proxy/api/v2/apmtelemetry");
   return url;
@@ -113,29 +140,24 @@ std::string to_string(datadog::tracing::ConfigName name) {
       return "trace_resource_renaming_enabled";
     case ConfigName::TRACE_RESOURCE_RENAMING_ALWAYS_SIMPLIFIED_ENDPOINT:
       return "trace_resource_renaming_always_simplified_endpoint";
+    case ConfigName::TRACE_PARTIAL_FLUSH_ENABLED:
+      return "trace_partial_flush_enabled";
+    case ConfigName::TRACE_PARTIAL_FLUSH_MIN_SPANS:
+      return "trace_partial_flush_min_spans";
+    case ConfigName::TRACE_API_VERSION:
+      return "trace_api_version";
   }
 
   std::abort();
 }
 
-nlohmann::json encode_logs(const std::vector<telemetry::LogMessage>& logs) {
-  auto encoded_logs = nlohmann::json::array();
-  for (auto& log : logs) {
-    auto encoded = nlohmann::json{
-        {"message", log.message},
-        {"level", to_string(log.level)},
-        {"tracer_time", log.timestamp},
-    };
-    if (log.stacktrace) {
-      encoded.emplace("stack_trace", *log.stacktrace);
-    }
-
-    encoded_logs.emplace_back(std::move(encoded));
-  }
-  return encoded_logs;
+std::chrono::seconds::rep now_seconds(const Clock& clock) {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             clock().wall.time_since_epoch())
+      .count();
 }
 
-std::string_view to_string(details::MetricType type) {
+StringView to_string(details::MetricType type) {
   using namespace datadog::telemetry::details;
   switch (type) {
     case MetricType::counter:
@@ -149,53 +171,128 @@ std::string_view to_string(details::MetricType type) {
   return "";
 }
 
+void write_strings(JsonWriter& json,
+                   const std::vector<std::string>& strings) {
+  json.begin_array();
+  for (const auto& string : strings) {
+    json.value(string);
+  }
+  json.end_array();
+}
+
+// Begin a message of a `message-batch` having the specified `request_type`,
+// and write the key of its payload. The caller writes the payload and then
+// ends the message.
+void begin_message(JsonWriter& json, StringView request_type) {
+  json.begin_object();
+  json.member("request_type", request_type);
+  json.key("payload");
+}
+
+// Write each metric of the specified `snapshots` as an element of a
+// `generate-metrics` series.
 // TODO: do `enable_if`
 template <typename T>
-void encode_metrics(
-    nlohmann::json::array_t& metrics,
+void write_series(
+    JsonWriter& json,
     const std::unordered_map<MetricContext<T>, telemetry::MetricSnapshot>&
-        counters_snapshots) {
-  for (const auto& [metric_ctx, snapshots] : counters_snapshots) {
-    auto encoded = nlohmann::json{
-        {"metric", metric_ctx.id.name},
-        {"type", to_string(metric_ctx.id.type)},
-        {"common", metric_ctx.id.common},
-        {"namespace", metric_ctx.id.scope},
-    };
-
+        snapshots) {
+  for (const auto& [metric_ctx, points] : snapshots) {
+    json.begin_object();
+    json.member("metric", metric_ctx.id.name);
+    json.member("type", to_string(metric_ctx.id.type));
+    json.member("common", metric_ctx.id.common);
+    json.member("namespace", metric_ctx.id.scope);
     if (!metric_ctx.tags.empty()) {
-      encoded.emplace("tags", metric_ctx.tags);
+      json.key("tags");
+      write_strings(json, metric_ctx.tags);
     }
 
-    auto points = nlohmann::json::array();
-    for (const auto& [timestamp, value] : snapshots) {
-      points.emplace_back(nlohmann::json::array({timestamp, value}));
+    json.key("points");
+    json.begin_array();
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      const auto [timestamp, value] = points[i];
+      json.begin_array();
+      json.value(timestamp);
+      json.value(value);
+      json.end_array();
     }
-
-    encoded.emplace("points", points);
-    metrics.emplace_back(std::move(encoded));
+    json.end_array();
+    json.end_object();
   }
 }
 
-nlohmann::json encode_distributions(
-    const std::unordered_map<MetricContext<Distribution>,
-                             std::vector<uint64_t>>& distributions) {
-  auto j = nlohmann::json::array();
+// Write the `generate-metrics`, `distributions` and `logs` messages of a
+// `message-batch` for the specified metrics and `logs`, omitting those that
+// would be empty.
+void write_telemetry_messages(
+    JsonWriter& json,
+    const std::unordered_map<MetricContext<Counter>, MetricSnapshot>& counters,
+    const std::unordered_map<MetricContext<Rate>, MetricSnapshot>& rates,
+    const std::unordered_map<MetricContext<Distribution>, DistributionSketch>&
+        distributions,
+    const std::vector<telemetry::LogMessage>& logs) {
+  if (!counters.empty() || !rates.empty()) {
+    begin_message(json, "generate-metrics");
+    json.begin_object();
+    json.key("series");
+    json.begin_array();
+    write_series(json, counters);
+    write_series(json, rates);
+    json.end_array();
+    json.end_object();
+    json.end_object();
+  }
 
-  for (const auto& [metric_ctx, values] : distributions) {
-    auto series = nlohmann::json{
-        {"metric", metric_ctx.id.name},
-        {"common", metric_ctx.id.common},
-        {"namespace", metric_ctx.id.scope},
-        {"points", values},
-    };
-    if (!metric_ctx.tags.empty()) {
-      series.emplace("tags", metric_ctx.tags);
+  if (!distributions.empty()) {
+    begin_message(json, "distributions");
+    json.begin_object();
+    json.key("series");
+    json.begin_array();
+    for (const auto& [metric_ctx, sketch] : distributions) {
+      json.begin_object();
+      json.member("metric", metric_ctx.id.name);
+      json.member("common", metric_ctx.id.common);
+      json.member("namespace", metric_ctx.id.scope);
+      json.key("points");
+      json.begin_array();
+      for (const auto point : sketch.points()) {
+        json.value(point);
+      }
+      json.end_array();
+      if (!metric_ctx.tags.empty()) {
+        json.key("tags");
+        write_strings(json, metric_ctx.tags);
+      }
+      json.end_object();
     }
-    j.emplace_back(series);
+    json.end_array();
+    json.end_object();
+    json.end_object();
   }
 
-  return j;
+  if (!logs.empty()) {
+    begin_message(json, "logs");
+    json.begin_object();
+    json.key("logs");
+    json.begin_array();
+    for (const auto& log : logs) {
+      json.begin_object();
+      json.member("message", log.message);
+      json.member("level", to_string(log.level));
+      json.member("tracer_time", log.timestamp);
+      if (log.count > 1) {
+        json.member("count", log.count);
+      }
+      if (log.stacktrace) {
+        json.member("stack_trace", *log.stacktrace);
+      }
+      json.end_object();
+    }
+    json.end_array();
+    json.end_object();
+    json.end_object();
+  }
 }
 
 }  // namespace
@@ -213,7 +310,10 @@ Telemetry::Telemetry(FinalizedConfiguration config,
       http_client_(client),
       clock_(std::move(clock)),
       scheduler_(event_scheduler),
-      host_info_(get_host_info()) {
+      logs_(std::make_unique<LogQueue>()),
+      host_info_(get_host_info()),
+      compression_enabled_(std::make_shared<std::atomic<bool>>(
+          config_.compression_enabled)) {
   app_started();
   schedule_tasks();
 }
@@ -221,7 +321,7 @@ Telemetry::Telemetry(FinalizedConfiguration config,
 void Telemetry::schedule_tasks() {
   tasks_.emplace_back(scheduler_->schedule_recurring_event(
       config_.heartbeat_interval,
-      [this]() { send_payload("app-heartbeat", heartbeat_and_telemetry()); }));
+      [this]() { send_payload("message-batch", heartbeat_and_telemetry()); }));
 
   if (config_.report_metrics) {
     tasks_.emplace_back(scheduler_->schedule_recurring_event(
@@ -246,12 +346,16 @@ Telemetry::Telemetry(Telemetry&& rhs)
       scheduler_(std::move(rhs.scheduler_)),
       counters_(std::move(rhs.counters_)),
       counters_snapshot_(std::move(rhs.counters_snapshot_)),
+      counter_handles_(std::move(rhs.counter_handles_)),
       rates_(std::move(rhs.rates_)),
       rates_snapshot_(std::move(rhs.rates_snapshot_)),
       distributions_(std::move(rhs.distributions_)),
+      logs_(std::exchange(rhs.logs_, std::make_unique<LogQueue>())),
       seq_id_(rhs.seq_id_),
       config_seq_ids_(rhs.config_seq_ids_),
-      host_info_(rhs.host_info_) {
+      config_hashes_(rhs.config_hashes_),
+      host_info_(rhs.host_info_),
+      compression_enabled_(rhs.compression_enabled_) {
   cancel_tasks(rhs.tasks_);
   schedule_tasks();
 }
@@ -269,12 +373,16 @@ Telemetry& Telemetry::operator=(Telemetry&& rhs) {
     std::swap(scheduler_, rhs.scheduler_);
     std::swap(counters_, rhs.counters_);
     std::swap(counters_snapshot_, rhs.counters_snapshot_);
+    std::swap(counter_handles_, rhs.counter_handles_);
     std::swap(rates_, rhs.rates_);
     std::swap(rates_snapshot_, rhs.rates_snapshot_);
     std::swap(distributions_, rhs.distributions_);
+    std::swap(logs_, rhs.logs_);
     std::swap(seq_id_, rhs.seq_id_);
     std::swap(config_seq_ids_, rhs.config_seq_ids_);
+    std::swap(config_hashes_, rhs.config_hashes_);
     std::swap(host_info_, rhs.host_info_);
+    std::swap(compression_enabled_, rhs.compression_enabled_);
     schedule_tasks();
   }
   return *this;
@@ -299,67 +407,42 @@ void Telemetry::log_warning(std::string message) {
 }
 
 void Telemetry::app_started() {
-  auto payload = app_started_payload();
-
-  auto on_headers = [payload_size = payload.size(),
-                     debug_enabled = config_.debug](DictWriter& headers) {
-    headers.set("Content-Type", "application/json");
-    headers.set("Content-Length", std::to_string(payload_size));
-    headers.set("DD-Telemetry-API-Version", "v2");
-    headers.set("DD-Client-Library-Language", "cpp");
-    headers.set("DD-Client-Library-Version", tracer_version);
-    headers.set("DD-Telemetry-Request-Type", "app-started");
-    if (debug_enabled) {
-      headers.set("DD-Telemetry-Debug-Enabled", "true");
-    }
-  };
-
-  auto on_response = [logger = logger_](int response_status, const DictReader&,
-                                        std::string response_body) {
-    if (response_status < 200 || response_status >= 300) {
-      logger->log_error([&](auto& stream) {
-        stream << "Unexpected telemetry response status " << response_status
-               << " with body (if any, starts on next line):\n"
-               << response_body;
-      });
-    }
-  };
-
-  auto on_error = [logger = logger_](Error error) {
-    logger->log_error(error.with_prefix(
-        "Error occurred during HTTP request for telemetry: "));
-  };
-
-  increment_counter(internal_metrics::requests, {"endpoint:agent"});
-  add_datapoint(internal_metrics::bytes_sent, {"endpoint:agent"},
-                payload.size());
-
-  auto post_result =
-      http_client_->post(telemetry_endpoint_, on_headers, std::move(payload),
-                         std::move(on_response), std::move(on_error),
-                         clock_().tick + request_timeout);
-  if (auto* error = post_result.if_error()) {
-    increment_counter(internal_metrics::errors,
-                      {"type:network", "endpoint:agent"});
-    logger_->log_error(
-        error->with_prefix("Unexpected error submitting telemetry event: "));
-  }
+  send_payload("message-batch", app_started_payload(),
+               /*count_responses=*/false);
 }
 
 void Telemetry::app_closing() {
   // Capture metrics in-between two ticks to be sent with the last payload.
   capture_metrics();
 
-  send_payload("app-closing", app_closing_payload());
+  send_payload("message-batch", app_closing_payload());
   http_client_->drain(clock_().tick + request_timeout);
 }
 
-void Telemetry::send_payload(StringView request_type, std::string payload) {
-  auto set_telemetry_headers = [request_type, payload_size = payload.size(),
-                                debug_enabled =
-                                    config_.debug](DictWriter& headers) {
+void Telemetry::send_payload(StringView request_type, std::string payload,
+                             bool count_responses) {
+  bool compressed = false;
+  if (compression_enabled_->load(std::memory_order_relaxed) &&
+      payload.size() >= compression_min_bytes) {
+    std::string body;
+    auto result = gzip_compress(body, payload, compression_level);
+    if (auto* error = result.if_error()) {
+      logger_->log_error(
+          error->with_prefix("Unable to compress telemetry payload: "));
+    } else {
+      payload = std::move(body);
+      compressed = true;
+    }
+  }
+
+  auto set_telemetry_headers = [request_type, body_size = payload.size(),
+                                compressed, debug_enabled = config_.debug](
+                                   DictWriter& headers) {
     headers.set("Content-Type", "application/json");
-    headers.set("Content-Length", std::to_string(payload_size));
+    headers.set("Content-Length", std::to_string(body_size));
+    if (compressed) {
+      headers.set("Content-Encoding", "gzip");
+    }
     headers.set("DD-Telemetry-API-Version", "v2");
     headers.set("DD-Client-Library-Language", "cpp");
     headers.set("DD-Client-Library-Version", tracer_version);
@@ -369,24 +452,40 @@ void Telemetry::send_payload(StringView request_type, std::string payload) {
     }
   };
 
-  auto on_response = [this, logger = logger_](int response_status,
-                                              const DictReader&,
-                                              std::string response_body) {
+  // Responses are counted by this object, unless it is still being
+  // constructed, since it might be moved before the response arrives.
+  Telemetry* const counter_owner = count_responses ? this : nullptr;
+
+  auto on_response = [counter_owner, logger = logger_, compressed,
+                      compression_enabled = compression_enabled_](
+                         int response_status, const DictReader&,
+                         std::string response_body) {
+    const char* status_code = nullptr;
     if (response_status >= 500) {
-      increment_counter(internal_metrics::responses,
-                        {"status_code:5xx", "endpoint:agent"});
+      status_code = "status_code:5xx";
     } else if (response_status >= 400) {
-      increment_counter(internal_metrics::responses,
-                        {"status_code:4xx", "endpoint:agent"});
+      status_code = "status_code:4xx";
     } else if (response_status >= 300) {
-      increment_counter(internal_metrics::responses,
-                        {"status_code:3xx", "endpoint:agent"});
+      status_code = "status_code:3xx";
     } else if (response_status >= 200) {
-      increment_counter(internal_metrics::responses,
-                        {"status_code:2xx", "endpoint:agent"});
+      status_code = "status_code:2xx";
     } else if (response_status >= 100) {
-      increment_counter(internal_metrics::responses,
-                        {"status_code:1xx", "endpoint:agent"});
+      status_code = "status_code:1xx";
+    }
+    if (counter_owner && status_code) {
+      counter_owner->increment_counter(internal_metrics::responses,
+                                       {status_code, "endpoint:agent"});
+    }
+
+    if (compressed && response_status == 415) {
+      // This Datadog Agent does not accept compressed payloads. Send
+      // subsequent payloads uncompressed. This payload is lost.
+      if (compression_enabled->exchange(false)) {
+        logger->log_error(
+            "Datadog Agent does not accept gzip compressed telemetry. Sending "
+            "it uncompressed instead.");
+      }
+      return;
     }
 
     if (response_status < 200 || response_status >= 300) {
@@ -399,9 +498,11 @@ void Telemetry::send_payload(StringView request_type, std::string payload) {
   };
 
   // Callback for unsuccessful telemetry HTTP requests.
-  auto on_error = [this, logger = logger_](Error error) {
-    increment_counter(internal_metrics::errors,
-                      {"type:network", "endpoint:agent"});
+  auto on_error = [counter_owner, logger = logger_](Error error) {
+    if (counter_owner) {
+      counter_owner->increment_counter(internal_metrics::errors,
+                                       {"type:network", "endpoint:agent"});
+    }
     logger->log_error(error.with_prefix(
         "Error occurred during HTTP request for telemetry: "));
   };
@@ -423,34 +524,38 @@ void Telemetry::send_payload(StringView request_type, std::string payload) {
 }
 
 void Telemetry::send_configuration_change() {
-  if (configuration_snapshot_.empty()) return;
-
+  // Only the fields that changed since they were last reported are sent.
   std::vector<ConfigMetadata> current_configuration;
-  std::swap(current_configuration, configuration_snapshot_);
-
-  auto configuration_json = nlohmann::json::array();
+  for (auto& config_metadata : configuration_snapshot_) {
+    const auto found = config_hashes_.find(config_metadata.name);
+    if (found == config_hashes_.end() ||
+        found->second != config_hash(config_metadata)) {
+      current_configuration.push_back(std::move(config_metadata));
+    }
+  }
+  configuration_snapshot_.clear();
+  if (current_configuration.empty()) return;
+
+  std::string payload;
+  payload.reserve(payload_capacity_);
+  JsonWriter json{payload};
+  begin_telemetry_body(json, "app-client-configuration-change");
+  json.begin_object();
+  json.key("configuration");
+  json.begin_array();
   for (const auto& config_metadata : current_configuration) {
-    configuration_json.emplace_back(
-        generate_configuration_field(config_metadata));
+    write_configuration_field(json, config_metadata);
   }
+  json.end_array();
+  json.end_object();
+  json.end_object();
 
-  auto telemetry_body =
-      generate_telemetry_body("app-client-configuration-change");
-  telemetry_body["payload"] =
-      nlohmann::json{{"configuration", configuration_json}};
-
-  send_payload("app-client-configuration-change", telemetry_body.dump());
+  payload_capacity_ = std::max(payload_capacity_, payload.size());
+  send_payload("app-client-configuration-change", std::move(payload));
 }
 
 std::string Telemetry::heartbeat_and_telemetry() {
-  auto batch_payloads = nlohmann::json::array();
-
-  auto heartbeat = nlohmann::json::object({
-      {"request_type", "app-heartbeat"},
-  });
-  batch_payloads.emplace_back(std::move(heartbeat));
-
-  std::unordered_map<MetricContext<Distribution>, std::vector<uint64_t>>
+  std::unordered_map<MetricContext<Distribution>, DistributionSketch>
       distributions;
   {
     std::lock_guard l{distributions_mutex_};
@@ -469,290 +574,228 @@ std::string Telemetry::heartbeat_and_telemetry() {
     std::swap(rates_snapshot_, rates_snapshot);
   }
 
-  nlohmann::json::array_t metrics = nlohmann::json::array();
-  encode_metrics(metrics, counters_snapshot);
-  encode_metrics(metrics, rates_snapshot);
-  if (!metrics.empty()) {
-    auto generate_metrics = nlohmann::json::object({
-        {"request_type", "generate-metrics"},
-        {"payload", nlohmann::json::object({
-                        {"series", metrics},
-                    })},
-    });
-    batch_payloads.emplace_back(std::move(generate_metrics));
-  }
-
-  if (auto distributions_series = encode_distributions(distributions);
-      !distributions.empty()) {
-    auto distributions_json = nlohmann::json{
-        {"request_type", "distributions"},
-        {
-            "payload",
-            nlohmann::json{
-                {"series", distributions_series},
-            },
-        },
-    };
-    batch_payloads.emplace_back(std::move(distributions_json));
-  }
-
   std::vector<telemetry::LogMessage> old_logs;
   {
     std::lock_guard l{log_mutex_};
-    std::swap(old_logs, logs_);
+    logs_->drain(old_logs, now_seconds(clock_));
   }
 
-  if (!old_logs.empty()) {
-    auto encoded_logs = encode_logs(old_logs);
-    assert(!encoded_logs.empty());
+  std::string payload;
+  payload.reserve(payload_capacity_);
+  JsonWriter json{payload};
+  begin_telemetry_body(json, "message-batch");
+  json.begin_array();
+  json.begin_object();
+  json.member("request_type", "app-heartbeat");
+  json.end_object();
+  write_telemetry_messages(json, counters_snapshot, rates_snapshot,
+                           distributions, old_logs);
+  json.end_array();
+  json.end_object();
 
-    auto logs_payload = nlohmann::json::object({
-        {"request_type", "logs"},
-        {"payload",
-         nlohmann::json{
-             {"logs", encoded_logs},
-         }},
-    });
+  payload_capacity_ = std::max(payload_capacity_, payload.size());
+  return payload;
+}
 
-    batch_payloads.emplace_back(std::move(logs_payload));
+std::string Telemetry::app_closing_payload() {
+  std::vector<telemetry::LogMessage> logs;
+  {
+    std::lock_guard l{log_mutex_};
+    logs_->drain(logs, now_seconds(clock_));
   }
 
-  auto telemetry_body = generate_telemetry_body("message-batch");
-  telemetry_body["payload"] = batch_payloads;
-  auto message_batch_payload = telemetry_body.dump();
+  std::string payload;
+  payload.reserve(payload_capacity_);
+  JsonWriter json{payload};
+  begin_telemetry_body(json, "message-batch");
+  json.begin_array();
+  json.begin_object();
+  json.member("request_type", "app-closing");
+  json.end_object();
+  write_telemetry_messages(json, counters_snapshot_, rates_snapshot_,
+                           distributions_, logs);
+  json.end_array();
+  json.end_object();
 
-  return message_batch_payload;
-}
-
-std::string Telemetry::app_closing_payload() {
-  auto batch_payloads = nlohmann::json::array();
-
-  auto app_closing = nlohmann::json::object({
-      {"request_type", "app-closing"},
-  });
-  batch_payloads.emplace_back(std::move(app_closing));
-
-  nlohmann::json::array_t metrics = nlohmann::json::array();
-  encode_metrics(metrics, counters_snapshot_);
-  encode_metrics(metrics, rates_snapshot_);
-  if (!metrics.empty()) {
-    auto generate_metrics = nlohmann::json::object({
-        {"request_type", "generate-metrics"},
-        {"payload", nlohmann::json::object({
-                        {"series", metrics},
-                    })},
-    });
-    batch_payloads.emplace_back(std::move(generate_metrics));
-  }
-
-  if (auto distributions_series = encode_distributions(distributions_);
-      !distributions_.empty()) {
-    auto distributions_json = nlohmann::json{
-        {"request_type", "distributions"},
-        {
-            "payload",
-            nlohmann::json{
-                {"series", distributions_series},
-            },
-        },
-    };
-    batch_payloads.emplace_back(std::move(distributions_json));
-  }
-
-  if (!logs_.empty()) {
-    auto encoded_logs = encode_logs(logs_);
-    assert(!encoded_logs.empty());
-
-    auto logs_payload = nlohmann::json::object({
-        {"request_type", "logs"},
-        {"payload",
-         nlohmann::json{
-             {"logs", encoded_logs},
-         }},
-    });
-
-    batch_payloads.emplace_back(std::move(logs_payload));
-  }
-
-  auto telemetry_body = generate_telemetry_body("message-batch");
-  telemetry_body["payload"] = batch_payloads;
-
-  auto message_batch_payload = telemetry_body.dump();
-  return message_batch_payload;
+  payload_capacity_ = std::max(payload_capacity_, payload.size());
+  return payload;
 }
 
 std::string Telemetry::app_started_payload() {
-  auto configuration_json = nlohmann::json::array();
-  auto product_json = nlohmann::json::object();
-
+  std::string payload;
+  payload.reserve(payload_capacity_);
+  JsonWriter json{payload};
+  begin_telemetry_body(json, "message-batch");
+  json.begin_array();
+
+  begin_message(json, "app-started");
+  json.begin_object();
+  json.key("configuration");
+  json.begin_array();
   for (const auto& product : config_.products) {
-    auto& configurations = product.configurations;
-    for (const auto& [_, config_metadata] : configurations) {
-      // if (config_metadata.value.empty()) continue;
-
-      configuration_json.emplace_back(
-          generate_configuration_field(config_metadata));
+    for (const auto& [_, config_metadata] : product.configurations) {
+      write_configuration_field(json, config_metadata);
     }
+  }
+  json.end_array();
 
+  json.key("products");
+  json.begin_object();
+  for (const auto& product : config_.products) {
     /// NOTE(@dmehala): Telemetry API is tightly related to APM tracing and
     /// assumes telemetry event can only be generated from a tracer. The
     /// assumption is that the tracing product is always enabled and there
     /// is no need to declare it.
     if (product.name == Product::Name::tracing) continue;
 
-    auto p = nlohmann::json{
-        {to_string(product.name),
-         nlohmann::json{
-             {"version", product.version},
-             {"enabled", product.enabled},
-         }},
-    };
-
+    const auto name = to_string(product.name);
+    json.key(StringView{name.data(), name.size()});
+    json.begin_object();
+    json.member("version", product.version);
+    json.member("enabled", product.enabled);
     if (product.error_code || product.error_message) {
-      auto p_error = nlohmann::json{};
+      json.key("error");
+      json.begin_object();
       if (product.error_code) {
-        p_error.emplace("code", *product.error_code);
+        json.member("code", *product.error_code);
       }
       if (product.error_message) {
-        p_error.emplace("message", *product.error_message);
+        json.member("message", *product.error_message);
       }
-
-      p.emplace("error", std::move(p_error));
+      json.end_object();
     }
-
-    product_json.emplace(std::move(p));
+    json.end_object();
   }
-
-  auto app_started_msg = nlohmann::json{
-      {"request_type", "app-started"},
-      {
-          "payload",
-          nlohmann::json{
-              {"configuration", configuration_json},
-              {"products", product_json},
-          },
-      },
-  };
+  json.end_object();
 
   if (config_.install_id || config_.install_time || config_.install_type) {
-    auto install_signature = nlohmann::json{};
+    json.key("install_signature");
+    json.begin_object();
     if (config_.install_id) {
-      install_signature.emplace("install_id", *config_.install_id);
+      json.member("install_id", *config_.install_id);
     }
     if (config_.install_type) {
-      install_signature.emplace("install_type", *config_.install_type);
+      json.member("install_type", *config_.install_type);
     }
     if (config_.install_time) {
-      install_signature.emplace("install_time", *config_.install_time);
+      json.member("install_time", *config_.install_time);
     }
+    json.end_object();
+  }
+  json.end_object();
+  json.end_object();
 
-    app_started_msg["payload"].emplace("install_signature",
-                                       std::move(install_signature));
+  if (!config_.integration_name.empty()) {
+    begin_message(json, "app-integrations-change");
+    json.begin_object();
+    json.key("integrations");
+    json.begin_array();
+    json.begin_object();
+    json.member("name", config_.integration_name);
+    json.member("version", config_.integration_version);
+    json.member("enabled", true);
+    json.end_object();
+    json.end_array();
+    json.end_object();
+    json.end_object();
   }
 
-  auto batch = generate_telemetry_body("message-batch");
-  batch["payload"] = nlohmann::json::array({std::move(app_started_msg)});
+  json.end_array();
+  json.end_object();
 
-  if (!config_.integration_name.empty()) {
-    auto integration_msg = nlohmann::json{
-        {"request_type", "app-integrations-change"},
-        {
-            "payload",
-            nlohmann::json{
-                {
-                    "integrations",
-                    nlohmann::json::array({
-                        nlohmann::json{{"name", config_.integration_name},
-                                       {"version", config_.integration_version},
-                                       {"enabled", true}},
-                    }),
-                },
-            },
-        },
-    };
-
-    batch["payload"].emplace_back(std::move(integration_msg));
-  }
-
-  return batch.dump();
-}
-
-nlohmann::json Telemetry::generate_telemetry_body(std::string request_type) {
-  std::time_t tracer_time = std::chrono::duration_cast<std::chrono::seconds>(
-                                clock_().wall.time_since_epoch())
-                                .count();
+  payload_capacity_ = std::max(payload_capacity_, payload.size());
+  return payload;
+}
+
+void Telemetry::begin_telemetry_body(JsonWriter& json,
+                                     StringView request_type) {
   seq_id_++;
-  return nlohmann::json::object({
-      {"api_version", "v2"},
-      {"seq_id", seq_id_},
-      {"request_type", request_type},
-      {"tracer_time", tracer_time},
-      {"runtime_id", tracer_signature_.runtime_id.string()},
-      {"debug", config_.debug},
-      {"application",
-       nlohmann::json::object({
-           {"service_name", tracer_signature_.default_service},
-           {"env", tracer_signature_.default_environment},
-           {"tracer_version", tracer_signature_.library_version},
-           {"language_name", tracer_signature_.library_language},
-           {"language_version", tracer_signature_.library_language_version},
-       })},
-      {"host",
-       {
-           {"hostname", host_info_.hostname},
-           {"os", host_info_.os},
-           {"os_version", host_info_.os_version},
-           {"architecture", host_info_.cpu_architecture},
-           {"kernel_name", host_info_.kernel_name},
-           {"kernel_version", host_info_.kernel_version},
-           {"kernel_release", host_info_.kernel_release},
-       }},
-  });
-}
-
-nlohmann::json Telemetry::generate_configuration_field(
-    const ConfigMetadata& config_metadata) {
+  json.begin_object();
+  json.member("api_version", "v2");
+  json.member("seq_id", seq_id_);
+  json.member("request_type", request_type);
+  json.member("tracer_time", now_seconds(clock_));
+  json.member("runtime_id", tracer_signature_.runtime_id.string());
+  json.member("debug", config_.debug);
+
+  json.key("application");
+  json.begin_object();
+  json.member("service_name", tracer_signature_.default_service);
+  json.member("env", tracer_signature_.default_environment);
+  json.member("tracer_version", tracer_signature_.library_version);
+  json.member("language_name", tracer_signature_.library_language);
+  json.member("language_version", tracer_signature_.library_language_version);
+  json.end_object();
+
+  json.key("host");
+  json.begin_object();
+  json.member("hostname", host_info_.hostname);
+  json.member("os", host_info_.os);
+  json.member("os_version", host_info_.os_version);
+  json.member("architecture", host_info_.cpu_architecture);
+  json.member("kernel_name", host_info_.kernel_name);
+  json.member("kernel_version", host_info_.kernel_version);
+  json.member("kernel_release", host_info_.kernel_release);
+  json.end_object();
+
+  json.key("payload");
+}
+
+void Telemetry::write_configuration_field(JsonWriter& json,
+                                          const ConfigMetadata& metadata) {
   // NOTE(@dmehala): `seq_id` should start at 1 so that the go backend can
   // detect between non set fields.
-  config_seq_ids_[config_metadata.name] += 1;
-  auto seq_id = config_seq_ids_[config_metadata.name];
+  config_seq_ids_[metadata.name] += 1;
+  auto seq_id = config_seq_ids_[metadata.name];
+  config_hashes_[metadata.name] = config_hash(metadata);
 
-  auto j = nlohmann::json{{"name", to_string(config_metadata.name)},
-                          {"value", config_metadata.value},
-                          {"seq_id", seq_id}};
+  json.begin_object();
+  json.member("name", to_string(metadata.name));
+  json.member("value", metadata.value);
+  json.member("seq_id", seq_id);
 
-  switch (config_metadata.origin) {
+  switch (metadata.origin) {
     case ConfigMetadata::Origin::ENVIRONMENT_VARIABLE:
-      j["origin"] = "env_var";
+      json.member("origin", "env_var");
       break;
     case ConfigMetadata::Origin::CODE:
-      j["origin"] = "code";
+      json.member("origin", "code");
       break;
     case ConfigMetadata::Origin::REMOTE_CONFIG:
-      j["origin"] = "remote_config";
+      json.member("origin", "remote_config");
       break;
     case ConfigMetadata::Origin::DEFAULT:
-      j["origin"] = "default";
+      json.member("origin", "default");
       break;
   }
 
-  if (config_metadata.error) {
-    // clang-format off
-      j["error"] = {
-        {"code", config_metadata.error->code},
-        {"message", config_metadata.error->message}
-      };
-    // clang-format on
+  if (metadata.error) {
+    json.key("error");
+    json.begin_object();
+    json.member("code", int(metadata.error->code));
+    json.member("message", metadata.error->message);
+    json.end_object();
   }
 
-  return j;
+  json.end_object();
 }
 
 void Telemetry::capture_configuration_change(
     const std::vector<tracing::ConfigMetadata>& new_configuration) {
-  configuration_snapshot_.insert(configuration_snapshot_.begin(),
-                                 new_configuration.begin(),
-                                 new_configuration.end());
+  // A field that changes again before it is sent is sent only as it was
+  // last changed.
+  for (const auto& config_metadata : new_configuration) {
+    const auto found = std::find_if(
+        configuration_snapshot_.begin(), configuration_snapshot_.end(),
+        [&](const ConfigMetadata& captured) {
+          return captured.name == config_metadata.name;
+        });
+    if (found == configuration_snapshot_.end()) {
+      configuration_snapshot_.push_back(config_metadata);
+    } else {
+      *found = config_metadata;
+    }
+  }
 }
 
 void Telemetry::capture_metrics() {
@@ -764,11 +807,16 @@ void Telemetry::capture_metrics() {
   {
     std::lock_guard l{counter_mutex_};
     std::swap(counter_snapshot, counters_);
+    for (auto& [counter, value] : counter_handles_) {
+      if (const auto count = value.exchange_zero()) {
+        counter_snapshot[counter] += count;
+      }
+    }
   }
 
   for (auto& [counter, value] : counter_snapshot) {
-    auto& counter_snapshots = counters_snapshot_[counter];
-    counter_snapshots.emplace_back(std::make_pair(timepoint, value));
+    counters_snapshot_.try_emplace(counter, MetricSnapshot::Combine::sum)
+        .first->second.add(timepoint, value);
   }
 
   std::unordered_map<MetricContext<Rate>, uint64_t> rate_snapshot;
@@ -778,19 +826,16 @@ void Telemetry::capture_metrics() {
   }
 
   for (auto& [rate, value] : rate_snapshot) {
-    auto& rates_snapshots = rates_snapshot_[rate];
-    rates_snapshots.emplace_back(std::make_pair(timepoint, value));
+    rates_snapshot_.try_emplace(rate, MetricSnapshot::Combine::mean)
+        .first->second.add(timepoint, value);
   }
 }
 
 void Telemetry::log(std::string message, telemetry::LogLevel level,
                     Optional<std::string> stacktrace) {
-  auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-                       clock_().wall.time_since_epoch())
-                       .count();
-  std::lock_guard l{log_mutex_};
-  logs_.emplace_back(
-      telemetry::LogMessage{std::move(message), level, stacktrace, timestamp});
+  logs_->push(telemetry::LogMessage{std::move(message), level,
+                                    std::move(stacktrace),
+                                    now_seconds(clock_)});
 }
 
 void Telemetry::increment_counter(const Counter& id) {
@@ -803,6 +848,13 @@ void Telemetry::increment_counter(const Counter& id,
   counters_[{id, tags}] += 1;
 }
 
+counter::Handle Telemetry::counter_handle(
+    const Counter& id, const std::vector<std::string>& tags) {
+  std::lock_guard l{counter_mutex_};
+  auto& value = counter_handles_.try_emplace({id, tags}).first->second;
+  return counter::Handle{&value};
+}
+
 void Telemetry::decrement_counter(const Counter& id) {
   decrement_counter(id, {});
 }
@@ -843,7 +895,7 @@ void Telemetry::add_datapoint(const Distribution& id,
                               const std::vector<std::string>& tags,
                               uint64_t value) {
   std::lock_guard l{distributions_mutex_};
-  distributions_[{id, tags}].emplace_back(value);
+  distributions_[{id, tags}].add(value);
 }
 
 }  // namespace datadog::telemetry
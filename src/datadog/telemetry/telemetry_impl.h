@@ -7,19 +7,22 @@
 #include <datadog/logger.h>
 #include <datadog/telemetry/configuration.h>
 #include <datadog/telemetry/metrics.h>
+#include <datadog/telemetry/telemetry.h>
 #include <datadog/tracer_signature.h>
 
+#include <atomic>
 #include <mutex>
 
-#include "json.hpp"
+#include "distribution_sketch.h"
+#include "json_writer.h"
 #include "log.h"
+#include "log_queue.h"
 #include "metric_context.h"
+#include "metric_snapshot.h"
 #include "platform_util.h"
 
 namespace datadog::telemetry {
 
-using MetricSnapshot = std::vector<std::pair<std::time_t, uint64_t>>;
-
 /// The telemetry class is responsible for handling internal telemetry data to
 /// track Datadog product usage. It _can_ collect and report logs and metrics.
 ///
@@ -28,6 +31,9 @@ using MetricSnapshot = std::vector<std::pair<std::time_t, uint64_t>>;
 /// indeed a bottleneck, I'll embrace KISS principle. However, in a future
 /// iteration we could use multiple producer single consumer queue or
 /// lock-free queue.
+///
+/// Logs are pushed into a lock-free queue (see `LogQueue`), since errors can
+/// be logged from every thread at once while an incident lasts.
 class Telemetry final {
   /// Configuration object containing the validated settings for telemetry
   FinalizedConfiguration config_;
@@ -43,7 +49,14 @@ class Telemetry final {
   /// Counter
   std::mutex counter_mutex_;
   std::unordered_map<MetricContext<Counter>, uint64_t> counters_;
+  /// The points captured since the last payload (see `MetricSnapshot`).
   std::unordered_map<MetricContext<Counter>, MetricSnapshot> counters_snapshot_;
+  /// The values of the counters that are incremented through handles (see
+  /// `counter::Handle`). The map is guarded by `counter_mutex_`, but the
+  /// values are not. Elements of the map are never erased, so that handles
+  /// remain valid.
+  std::unordered_map<MetricContext<Counter>, counter::ShardedValue>
+      counter_handles_;
 
   /// Rate
   std::mutex rate_mutex_;
@@ -51,23 +64,38 @@ class Telemetry final {
   std::unordered_map<MetricContext<Rate>, MetricSnapshot> rates_snapshot_;
 
   /// Distribution
-  /// TODO: split distribution in array of N element?
+  /// The points of each distribution are stored in a `DistributionSketch`, so
+  /// that memory use does not grow with throughput between heartbeats.
   std::mutex distributions_mutex_;
-  std::unordered_map<MetricContext<Distribution>, std::vector<uint64_t>>
+  std::unordered_map<MetricContext<Distribution>, DistributionSketch>
       distributions_;
 
   /// Configuration
+  /// The configuration changes captured since they were last sent, at most
+  /// one for each configuration field.
   std::vector<tracing::ConfigMetadata> configuration_snapshot_;
 
+  /// `log_mutex_` is locked while `logs_` is drained, so that there is one
+  /// consumer at a time. Pushing does not lock.
   std::mutex log_mutex_;
-  std::vector<telemetry::LogMessage> logs_;
+  std::unique_ptr<LogQueue> logs_;
 
   // Track sequence id per payload generated
   uint64_t seq_id_ = 0;
   // Track sequence id per configuration field
   std::unordered_map<tracing::ConfigName, std::size_t> config_seq_ids_;
+  // A hash of each configuration field as it was last reported, so that a
+  // change that leaves a field as it was reported is not reported again.
+  std::unordered_map<tracing::ConfigName, std::uint64_t> config_hashes_;
 
   tracing::HostInfo host_info_;
+  // Size of the largest payload built so far, so that the next payload is
+  // built without growing its buffer.
+  std::size_t payload_capacity_ = 0;
+  // Whether payloads are gzip compressed. It is shared with the callbacks of
+  // requests in flight, which disable compression if the Datadog Agent
+  // rejects a compressed payload.
+  std::shared_ptr<std::atomic<bool>> compression_enabled_;
 
  public:
   /// Constructor for the Telemetry class
@@ -118,6 +146,8 @@ class Telemetry final {
   void set_counter(const Counter& counter, uint64_t value);
   void set_counter(const Counter& counter, const std::vector<std::string>& tags,
                    uint64_t value);
+  counter::Handle counter_handle(const Counter& counter,
+                                 const std::vector<std::string>& tags);
 
   /// Rate
   void set_rate(const Rate& rate, uint64_t value);
@@ -133,7 +163,11 @@ class Telemetry final {
   void app_started();
   void app_closing();
 
-  void send_payload(tracing::StringView request_type, std::string payload);
+  // Send the specified `payload` having the specified `request_type`. If
+  // `count_responses` is false, then the request's callbacks do not refer to
+  // this object.
+  void send_payload(tracing::StringView request_type, std::string payload,
+                    bool count_responses = true);
 
   void schedule_tasks();
 
@@ -142,9 +176,13 @@ class Telemetry final {
   void log(std::string message, telemetry::LogLevel level,
            tracing::Optional<std::string> stacktrace = tracing::nullopt);
 
-  nlohmann::json generate_telemetry_body(std::string request_type);
-  nlohmann::json generate_configuration_field(
-      const tracing::ConfigMetadata& config_metadata);
+  // Begin the body of a telemetry request having the specified
+  // `request_type`, and write the key of its payload. The caller writes the
+  // payload and then ends the body.
+  void begin_telemetry_body(tracing::JsonWriter& json,
+                            tracing::StringView request_type);
+  void write_configuration_field(tracing::JsonWriter& json,
+                                 const tracing::ConfigMetadata& metadata);
 
   // Constructs an `app-started` message using information provided when
   // constructed and the tracer_config value passed in.
@@ -3,63 +3,112 @@
 namespace datadog::tracing::metrics {
 
 namespace tracer {
-const telemetry::Counter spans_created = {"spans_created", "tracers", true};
-const telemetry::Counter spans_dropped = {"spans_dropped", "tracers", true};
-const telemetry::Counter spans_finished = {"spans_finished", "tracers", true};
+constexpr telemetry::Counter spans_created = {"spans_created", "tracers", true};
+constexpr telemetry::Counter spans_dropped = {"spans_dropped", "tracers", true};
+constexpr telemetry::Counter spans_finished = {"spans_finished", "tracers",
+                                               true};
 
-const telemetry::Counter trace_segments_created = {"trace_segments_created",
-                                                   "tracers", true};
+constexpr telemetry::Counter trace_segments_created = {"trace_segments_created",
+                                                       "tracers", true};
 
-const telemetry::Counter trace_segments_closed = {"trace_segments_closed",
-                                                  "tracers", true};
+constexpr telemetry::Counter trace_segments_closed = {"trace_segments_closed",
+                                                      "tracers", true};
+
+constexpr telemetry::Counter trace_segments_truncated = {
+    "trace_segments_truncated", "tracers", true};
+
+constexpr telemetry::Counter trace_segments_orphaned = {
+    "trace_segments_orphaned", "tracers", true};
 
-const telemetry::Distribution trace_chunk_size = {"trace_chunk_size", "tracers",
-                                                  true};
+constexpr telemetry::Distribution trace_chunk_size = {"trace_chunk_size",
+                                                      "tracers", true};
 
-const telemetry::Distribution trace_chunk_serialized_bytes = {
+constexpr telemetry::Distribution trace_chunk_serialized_bytes = {
     "trace_chunk_serialization.bytes", "tracers", true};
 
-const telemetry::Distribution trace_chunk_serialization_duration = {
+constexpr telemetry::Distribution trace_chunk_compressed_bytes = {
+    "trace_chunk_serialization.compressed_bytes", "tracers", true};
+
+constexpr telemetry::Distribution trace_chunk_serialization_duration = {
     "trace_chunk_serialization.ms", "tracers", true};
 
-const telemetry::Counter trace_chunks_enqueued = {"trace_chunks_enqueued",
-                                                  "tracers", true};
+constexpr telemetry::Distribution trace_chunk_enqueue_latency = {
+    "trace_chunk_delivery.enqueue.ms", "tracers", true};
+
+constexpr telemetry::Distribution trace_chunk_encode_latency = {
+    "trace_chunk_delivery.encode.ms", "tracers", true};
 
-const telemetry::Counter trace_chunks_enqueued_for_serialization = {
+constexpr telemetry::Distribution trace_chunk_ack_latency = {
+    "trace_chunk_delivery.ack.ms", "tracers", true};
+
+constexpr telemetry::Distribution trace_chunk_delivery_latency = {
+    "trace_chunk_delivery.ms", "tracers", true};
+
+constexpr telemetry::Counter trace_chunks_enqueued = {"trace_chunks_enqueued",
+                                                      "tracers", true};
+
+constexpr telemetry::Counter trace_chunks_enqueued_for_serialization = {
     "trace_chunks_enqueued_for_serialization", "tracers", true};
 
-const telemetry::Counter trace_chunks_dropped = {"trace_chunks_dropped",
-                                                 "tracers", true};
+constexpr telemetry::Counter trace_chunks_dropped = {"trace_chunks_dropped",
+                                                     "tracers", true};
 
-const telemetry::Counter trace_chunks_sent = {"trace_chunks_sent", "tracers",
-                                              true};
+constexpr telemetry::Counter trace_chunks_sent = {"trace_chunks_sent",
+                                                  "tracers", true};
 
-const telemetry::Counter context_header_truncated = {
+constexpr telemetry::Counter context_header_truncated = {
     "context_header.truncated",
     "tracers",
     true,
 };
 
 namespace api {
-const telemetry::Counter requests = {"trace_api.requests", "tracers", true};
-const telemetry::Counter responses = {"trace_api.responses", "tracers", true};
-const telemetry::Distribution bytes_sent = {"trace_api.bytes", "tracers", true};
-const telemetry::Distribution request_duration = {"trace_api.ms", "tracers",
-                                                  true};
-const telemetry::Counter errors = {"trace_api.errors", "tracers", true};
+constexpr telemetry::Counter requests = {"trace_api.requests", "tracers", true};
+constexpr telemetry::Counter responses = {"trace_api.responses", "tracers",
+                                          true};
+constexpr telemetry::Distribution bytes_sent = {"trace_api.bytes", "tracers",
+                                                true};
+constexpr telemetry::Distribution request_duration = {"trace_api.ms", "tracers",
+                                                      true};
+constexpr telemetry::Counter errors = {"trace_api.errors", "tracers", true};
+constexpr telemetry::Counter deferred = {"trace_api.deferred", "tracers", true};
+constexpr telemetry::Counter merged = {"trace_api.merged", "tracers", true};
+constexpr telemetry::Counter retries = {"trace_api.retries", "tracers", true};
 }  // namespace api
 
 namespace trace_context {
-const telemetry::Counter injected = {"context_header_style.injected", "tracers",
-                                     true};
-const telemetry::Counter extracted = {"context_header_style.extracted",
-                                      "tracers", true};
-const telemetry::Counter truncated = {"context_header.truncated", "tracers",
-                                      true};
-const telemetry::Counter malformed = {"context_header_style.malformed",
-                                      "tracers", true};
+constexpr telemetry::Counter injected = {"context_header_style.injected",
+                                         "tracers", true};
+constexpr telemetry::Counter extracted = {"context_header_style.extracted",
+                                          "tracers", true};
+constexpr telemetry::Counter truncated = {"context_header.truncated", "tracers",
+                                          true};
+constexpr telemetry::Distribution truncated_header_bytes = {
+    "context_header.truncated_bytes", "tracers", true};
+constexpr telemetry::Counter malformed = {"context_header_style.malformed",
+                                          "tracers", true};
 }  // namespace trace_context
 
+namespace endpoint_inferral {
+constexpr telemetry::Counter cache_hits = {"endpoint_inferral.cache_hits",
+                                           "tracers", false};
+constexpr telemetry::Counter cache_misses = {"endpoint_inferral.cache_misses",
+                                             "tracers", false};
+}  // namespace endpoint_inferral
+
+namespace self_profiling {
+constexpr telemetry::Distribution create_span = {
+    "self_profiling.create_span.ns", "tracers", false};
+constexpr telemetry::Distribution extract_span = {
+    "self_profiling.extract_span.ns", "tracers", false};
+constexpr telemetry::Distribution inject = {"self_profiling.inject.ns",
+                                            "tracers", false};
+constexpr telemetry::Distribution span_finished = {
+    "self_profiling.span_finished.ns", "tracers", false};
+constexpr telemetry::Distribution sampling = {"self_profiling.sampling.ns",
+                                              "tracers", false};
+}  // namespace self_profiling
+
 }  // namespace tracer
 
 }  // namespace datadog::tracing::metrics
@@ -29,9 +29,22 @@ extern const telemetry::Distribution trace_chunk_size;
 /// The size in bytes of the serialized trace chunk.
 extern const telemetry::Distribution trace_chunk_serialized_bytes;
 
+/// The size in bytes of the serialized trace chunks after compression, for
+/// payloads that were compressed.  Compare with `trace_chunk_serialized_bytes`.
+extern const telemetry::Distribution trace_chunk_compressed_bytes;
+
 /// The time it takes to serialize a trace chunk.
 extern const telemetry::Distribution trace_chunk_serialization_duration;
 
+/// The time, in milliseconds, from when the last span of a trace chunk finished
+/// to when the Datadog Agent collector buffered it, from then to when it was
+/// encoded in a request, from then to when the Datadog Agent acknowledged the
+/// request, and in all.
+extern const telemetry::Distribution trace_chunk_enqueue_latency;
+extern const telemetry::Distribution trace_chunk_encode_latency;
+extern const telemetry::Distribution trace_chunk_ack_latency;
+extern const telemetry::Distribution trace_chunk_delivery_latency;
+
 /// The number of times a trace chunk is enqueued for sampling/serialization. In
 /// partial-flush scenarios, multiple trace chunks may be enqueued per trace
 /// segment/local trace.
@@ -50,7 +63,10 @@ extern const telemetry::Counter trace_chunks_enqueued_for_serialization;
 /// trace that was droped by the tracer), `reason:overfull_buffer` (the local
 /// buffer was full, and the trace chunk had to be dropped),
 /// `reason:serialization_error` (there was an error serializing the trace and
-/// it had to be dropped).
+/// it had to be dropped), `reason:memory_budget` (the tracer held too much
+/// memory, see `TracerConfig::max_memory_bytes`). Chunks dropped by the
+/// Datadog Agent collector are also tagged by their class:
+/// `class:sampled_out`, `class:kept`, or `class:protected`.
 extern const telemetry::Counter trace_chunks_dropped;
 
 /// The number of trace chunks attempted to be sent to the backend, regardless
@@ -66,6 +82,17 @@ extern const telemetry::Counter trace_segments_created;
 /// scenarios, trace_segments_closed == trace_chunks_enqueued.
 extern const telemetry::Counter trace_segments_closed;
 
+/// The number of trace segments that stopped recording new spans because they
+/// reached a limit, tagged by `reason:spans` or `reason:bytes` (see
+/// `TracerConfig::max_spans_per_trace_segment`), or `reason:memory` (see
+/// `TracerConfig::max_memory_bytes`).
+extern const telemetry::Counter trace_segments_truncated;
+
+/// The number of trace segments whose spans were sent before they all
+/// finished, because the segment outlived its maximum age (see
+/// `TracerConfig::orphaned_segment_max_age_seconds`).
+extern const telemetry::Counter trace_segments_orphaned;
+
 namespace api {
 
 /// The number of requests sent to the trace endpoint in the agent, regardless
@@ -90,6 +117,18 @@ extern const telemetry::Distribution request_duration;
 /// `type:status_code`).
 extern const telemetry::Counter errors;
 
+/// The number of times sending buffered trace chunks was deferred because the
+/// maximum number of trace requests were already in flight.
+extern const telemetry::Counter deferred;
+
+/// The number of requests whose payload includes trace chunks whose sending
+/// was previously deferred.
+extern const telemetry::Counter merged;
+
+/// The number of requests that send again a payload that previously failed
+/// to be sent.
+extern const telemetry::Counter retries;
+
 }  // namespace api
 
 namespace trace_context {
@@ -110,11 +149,51 @@ extern const telemetry::Counter extracted;
 /// `truncation_reason:baggage_byte_count_exceeded`)
 extern const telemetry::Counter truncated;
 
+/// The size in bytes that a context propagation header would have had if it
+/// had not been truncated, tagged like `truncated`.
+extern const telemetry::Distribution truncated_header_bytes;
+
 /// The number of times baggage headers are dropped because they're malformed
 /// (missing key/value/'='), tagged by header style (`header_style:baggage`)
 extern const telemetry::Counter malformed;
 }  // namespace trace_context
 
+namespace endpoint_inferral {
+
+/// The number of local root spans whose `http.endpoint` was found in the
+/// cache of endpoints inferred from URL paths.
+extern const telemetry::Counter cache_hits;
+
+/// The number of local root spans whose `http.endpoint` was inferred from the
+/// URL path because it was not in the cache.
+extern const telemetry::Counter cache_misses;
+
+}  // namespace endpoint_inferral
+
+/// The time in nanoseconds that the tracer spends in its hot paths. These are
+/// reported only if the library is built with `DD_TRACE_SELF_PROFILING` (see
+/// `self_profiling.h`), and then only for a sample of the calls.
+namespace self_profiling {
+
+/// The time it takes `Tracer::create_span` to create a root span.
+extern const telemetry::Distribution create_span;
+
+/// The time it takes `Tracer::extract_span` to extract trace context and
+/// create a span.
+extern const telemetry::Distribution extract_span;
+
+/// The time it takes to inject the trace context of one or more spans.
+extern const telemetry::Distribution inject;
+
+/// The time it takes a trace segment to account for a finished span,
+/// including finalizing the trace chunk when it is the last span.
+extern const telemetry::Distribution span_finished;
+
+/// The time it takes the trace sampler to make a sampling decision.
+extern const telemetry::Distribution sampling;
+
+}  // namespace self_profiling
+
 }  // namespace tracer
 
 }  // namespace datadog::tracing::metrics
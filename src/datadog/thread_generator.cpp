@@ -0,0 +1,57 @@
+#include "thread_generator.h"
+
+#include <datadog/error.h>
+#include <datadog/logger.h>
+
+#include <string>
+#include <utility>
+
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+
+Expected<void> validate(const ThreadOptions& options) {
+  for (const int cpu : options.cpus) {
+    if (cpu < 0) {
+      return Error{Error::INVALID_THREAD_OPTIONS,
+                   "Thread options: CPU " + std::to_string(cpu) +
+                       " is negative."};
+    }
+  }
+  if (options.nice && (*options.nice < -20 || *options.nice > 19)) {
+    return Error{Error::INVALID_THREAD_OPTIONS,
+                 "Thread options: nice value " + std::to_string(*options.nice) +
+                     " is not between -20 and 19."};
+  }
+  return nullopt;
+}
+
+bool is_default(const ThreadOptions& options) {
+  return !options.name_prefix && options.cpus.empty() &&
+         !options.scheduling_policy && !options.nice;
+}
+
+ThreadGenerator make_thread_generator(const ThreadOptions& options,
+                                      StringView role,
+                                      const std::shared_ptr<Logger>& logger) {
+  std::string name;
+  if (options.name_prefix) {
+    name = *options.name_prefix;
+    name += '-';
+    append(name, role);
+  }
+  return [options, name = std::move(name),
+          logger](std::function<void()>&& run) {
+    return std::thread([options, name, logger, run = std::move(run)]() {
+      auto configured = configure_current_thread(options, name);
+      if (auto* error = configured.if_error()) {
+        logger->log_error(*error);
+      }
+      run();
+    });
+  };
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,34 @@
+#pragma once
+
+// This component provides functions for creating the threads that the tracer
+// runs in the background, as configured by `ThreadOptions`.  See
+// `thread_options.h`.
+
+#include <datadog/expected.h>
+#include <datadog/string_view.h>
+#include <datadog/thread_options.h>
+
+#include <memory>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+
+// Return an error if the specified `options` are invalid.
+Expected<void> validate(const ThreadOptions& options);
+
+// Return whether the specified `options` leave threads as they would be
+// created by `std::thread`.
+bool is_default(const ThreadOptions& options);
+
+// Return a function that creates threads that apply the specified `options`
+// before running, having the name "<name_prefix>-<role>" for the specified
+// `role`.  Options that cannot be applied are logged using the specified
+// `logger`.
+ThreadGenerator make_thread_generator(const ThreadOptions& options,
+                                      StringView role,
+                                      const std::shared_ptr<Logger>& logger);
+
+}  // namespace tracing
+}  // namespace datadog
@@ -1,26 +1,49 @@
 #include "threaded_event_scheduler.h"
 
+#include <algorithm>
 #include <thread>
 
 #include "json.hpp"
+#include "platform_util.h"
+#include "thread_generator.h"
+#include "timeline_events.h"
 
 namespace datadog {
 namespace tracing {
+namespace {
 
-ThreadedEventScheduler::EventConfig::EventConfig(
-    std::function<void()> callback,
-    std::chrono::steady_clock::duration interval)
-    : callback(callback), interval(interval), cancelled(false) {}
-
-bool ThreadedEventScheduler::GreaterThan::operator()(
-    const ScheduledRun& left, const ScheduledRun& right) const {
-  return left.when > right.when;
+// Return the index of the first set bit of the specified `bits` at or after
+// the specified `start`, wrapping around, as an offset from `start`.  The
+// behavior is undefined unless `bits` is not zero.
+std::size_t next_set_bit(std::uint64_t bits, std::size_t start) {
+  if (start != 0) {
+    bits = (bits >> start) | (bits << (64 - start));
+  }
+  std::size_t offset = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    ++offset;
+  }
+  return offset;
 }
 
-ThreadedEventScheduler::ThreadedEventScheduler()
-    : running_current_(false),
+}  // namespace
+
+ThreadedEventScheduler::ThreadedEventScheduler(
+    std::chrono::steady_clock::duration slack)
+    : ThreadedEventScheduler(slack, [](std::function<void()>&& run) {
+        return std::thread(std::move(run));
+      }) {}
+
+ThreadedEventScheduler::ThreadedEventScheduler(
+    std::chrono::steady_clock::duration slack,
+    const ThreadGenerator& make_thread)
+    : slack_(std::max(slack, std::chrono::steady_clock::duration(1))),
+      origin_(std::chrono::steady_clock::now()),
+      current_tick_(0),
+      generation_(0),
       shutting_down_(false),
-      dispatcher_([this]() { run(); }) {}
+      dispatcher_(make_thread([this]() { run(); })) {}
 
 ThreadedEventScheduler::~ThreadedEventScheduler() {
   {
@@ -31,83 +54,286 @@ ThreadedEventScheduler::~ThreadedEventScheduler() {
   dispatcher_.join();
 }
 
+std::shared_ptr<ThreadedEventScheduler>
+ThreadedEventScheduler::shared_instance() {
+  static std::mutex mutex;
+  static std::weak_ptr<ThreadedEventScheduler> instance;
+  // The process that created `instance`.  A forked process does not have the
+  // instance's thread.
+  static int owner = 0;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  const int self = get_process_id();
+  if (auto existing = instance.lock(); existing && owner == self) {
+    return existing;
+  }
+  auto created = std::make_shared<ThreadedEventScheduler>();
+  instance = created;
+  owner = self;
+  return created;
+}
+
+std::shared_ptr<ThreadedEventScheduler> ThreadedEventScheduler::shared_instance(
+    const ThreadOptions& threads, const std::shared_ptr<Logger>& logger) {
+  if (is_default(threads)) {
+    return shared_instance();
+  }
+  return std::make_shared<ThreadedEventScheduler>(
+      std::chrono::milliseconds(10),
+      make_thread_generator(threads, "sched", logger));
+}
+
 EventScheduler::Cancel ThreadedEventScheduler::schedule_recurring_event(
     std::chrono::steady_clock::duration interval,
     std::function<void()> callback) {
-  const auto now = std::chrono::steady_clock::now();
-  auto config = std::make_shared<EventConfig>(std::move(callback), interval);
+  return schedule_recurring_event_after(interval, interval,
+                                        std::move(callback));
+}
+
+EventScheduler::Cancel ThreadedEventScheduler::schedule_recurring_event_after(
+    std::chrono::steady_clock::duration first_delay,
+    std::chrono::steady_clock::duration interval,
+    std::function<void()> callback) {
+  auto timer = std::make_shared<Timer>();
+  timer->callback = std::move(callback);
+  timer->interval = interval;
+  timer->when = std::chrono::steady_clock::now() + first_delay;
 
   {
     std::lock_guard<std::mutex> guard(mutex_);
-    upcoming_.push(ScheduledRun{now + interval, config});
+    TimerList scheduled{timer};
+    timer->list = &scheduled;
+    timer->position = scheduled.begin();
+    file(*timer);
+    ++generation_;
     schedule_or_shutdown_.notify_one();
   }
 
   // Return a cancellation function.
-  return [this, config = std::move(config)]() mutable {
-    if (!config) {
+  return [this, timer = std::move(timer)]() mutable {
+    if (!timer) {
       return;
     }
 
     std::unique_lock<std::mutex> lock(mutex_);
-    config->cancelled = true;
-    current_done_.wait(lock, [this, &config]() {
-      return !running_current_ || current_.config != config;
-    });
-    config.reset();
+    timer->cancelled = true;
+    if (timer->list) {
+      erase(*timer);
+    }
+    current_done_.wait(lock, [this, &timer]() { return running_ != timer; });
+    timer.reset();
   };
 }
 
+void ThreadedEventScheduler::post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    posted_.push_back(std::move(task));
+    ++generation_;
+  }
+  schedule_or_shutdown_.notify_one();
+}
+
 std::string ThreadedEventScheduler::config() const {
   return nlohmann::json::object(
-             {{"type", "datadog::tracing::ThreadedEventScheduler"}})
+             {{"type", "datadog::tracing::ThreadedEventScheduler"},
+              {"config",
+               nlohmann::json::object(
+                   {{"slack_milliseconds",
+                     std::chrono::duration_cast<std::chrono::milliseconds>(
+                         slack_)
+                         .count()}})}})
       .dump();
 }
 
-void ThreadedEventScheduler::run() {
-  std::unique_lock<std::mutex> lock(mutex_);
+std::uint64_t ThreadedEventScheduler::tick_of(
+    std::chrono::steady_clock::time_point when) const {
+  if (when <= origin_) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>((when - origin_ + slack_ -
+                                     std::chrono::steady_clock::duration(1)) /
+                                    slack_);
+}
 
-  for (;;) {
-    schedule_or_shutdown_.wait(
-        lock, [this]() { return shutting_down_ || !upcoming_.empty(); });
-    if (shutting_down_) {
-      return;
+void ThreadedEventScheduler::file(Timer& timer) {
+  TimerList* list = &due_;
+  Level* level = nullptr;
+  std::size_t slot = 0;
+
+  const std::uint64_t due = tick_of(timer.when);
+  if (due > current_tick_) {
+    constexpr std::uint64_t max_delta =
+        (std::uint64_t(1) << (slot_bits * levels)) - 1;
+    std::uint64_t delta = due - current_tick_;
+    std::uint64_t target = due;
+    if (delta > max_delta) {
+      // The timer is beyond the reach of the wheel.  Keep it in the top level
+      // until the wheel is closer to it.
+      delta = max_delta;
+      target = current_tick_ + max_delta;
+    }
+    std::size_t index = 0;
+    while (delta >> (slot_bits * (index + 1))) {
+      ++index;
+    }
+    level = &levels_[index];
+    slot = (target >> (slot_bits * index)) & (slots_per_level - 1);
+    list = &level->slots[slot];
+    level->occupied |= std::uint64_t(1) << slot;
+  }
+
+  TimerList* const old_list = timer.list;
+  Level* const old_level = timer.level;
+  const std::size_t old_slot = timer.slot;
+  list->splice(list->end(), *old_list, timer.position);
+  if (old_level && old_list->empty()) {
+    old_level->occupied &= ~(std::uint64_t(1) << old_slot);
+  }
+  timer.list = list;
+  timer.level = level;
+  timer.slot = slot;
+}
+
+void ThreadedEventScheduler::erase(Timer& timer) {
+  TimerList* const list = timer.list;
+  Level* const level = timer.level;
+  const std::size_t slot = timer.slot;
+  timer.list = nullptr;
+  timer.level = nullptr;
+  // This might destroy `timer`, if no cancellation function refers to it.
+  list->erase(timer.position);
+  if (level && list->empty()) {
+    level->occupied &= ~(std::uint64_t(1) << slot);
+  }
+}
+
+Optional<std::uint64_t> ThreadedEventScheduler::next_tick() const {
+  Optional<std::uint64_t> result;
+  for (std::size_t index = 0; index < levels; ++index) {
+    const std::uint64_t occupied = levels_[index].occupied;
+    if (!occupied) {
+      continue;
+    }
+    // A slot of this level is processed when the wheel reaches the first tick
+    // of the slot's span.  The slot of the current span was already
+    // processed, so look from the following slot onward.
+    const std::size_t shift = slot_bits * index;
+    const std::uint64_t span = current_tick_ >> shift;
+    const std::size_t following = (span + 1) & (slots_per_level - 1);
+    const std::uint64_t tick = (span + 1 + next_set_bit(occupied, following))
+                               << shift;
+    if (!result || tick < *result) {
+      result = tick;
     }
+  }
+  return result;
+}
 
-    current_ = upcoming_.top();
+void ThreadedEventScheduler::advance(std::uint64_t tick) {
+  current_tick_ = tick;
 
-    if (current_.config->cancelled) {
-      upcoming_.pop();
+  for (std::size_t index = levels; index-- > 1;) {
+    const std::size_t shift = slot_bits * index;
+    if (tick & ((std::uint64_t(1) << shift) - 1)) {
+      // `tick` is not the beginning of a slot's span in this level.
       continue;
     }
+    Level& level = levels_[index];
+    const std::size_t slot = (tick >> shift) & (slots_per_level - 1);
+    TimerList cascading;
+    cascading.splice(cascading.end(), level.slots[slot]);
+    level.occupied &= ~(std::uint64_t(1) << slot);
+    for (const auto& timer : cascading) {
+      timer->list = &cascading;
+      timer->level = nullptr;
+    }
+    while (!cascading.empty()) {
+      file(*cascading.front());
+    }
+  }
+
+  Level& level = levels_[0];
+  const std::size_t slot = tick & (slots_per_level - 1);
+  for (const auto& timer : level.slots[slot]) {
+    timer->list = &due_;
+    timer->level = nullptr;
+  }
+  due_.splice(due_.end(), level.slots[slot]);
+  level.occupied &= ~(std::uint64_t(1) << slot);
+}
 
-    const bool changed =
-        schedule_or_shutdown_.wait_until(lock, current_.when, [this]() {
-          return shutting_down_ || upcoming_.top().config != current_.config;
-        });
+void ThreadedEventScheduler::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
 
+  for (;;) {
     if (shutting_down_) {
       return;
     }
 
-    if (changed) {
-      // A more recent event has been scheduled.
+    if (!posted_.empty()) {
+      std::vector<std::function<void()>> tasks;
+      tasks.swap(posted_);
+      lock.unlock();
+      {
+        DD_TIMELINE_SCOPE("EventScheduler posted tasks");
+        for (auto& task : tasks) {
+          task();
+        }
+      }
+      // Destroy the tasks before locking again, in case that releases objects
+      // that post more tasks.
+      tasks.clear();
+      lock.lock();
       continue;
     }
 
-    // We waited for `current_` and now it's its turn.
-    upcoming_.pop();
-    if (current_.config->cancelled) {
+    if (due_.empty()) {
+      const std::uint64_t generation = generation_;
+      const auto woken = [this, generation]() {
+        return shutting_down_ || generation_ != generation;
+      };
+      const Optional<std::uint64_t> next = next_tick();
+      if (!next) {
+        schedule_or_shutdown_.wait(lock, woken);
+        continue;
+      }
+      if (schedule_or_shutdown_.wait_until(lock, origin_ + *next * slack_,
+                                           woken)) {
+        // Either shutting down, or a timer was scheduled that might be due
+        // before `next`.
+        continue;
+      }
+
+      // Process every slot that was reached while waiting.
+      const auto now_tick = static_cast<std::uint64_t>(
+          (std::chrono::steady_clock::now() - origin_) / slack_);
+      for (auto tick = next_tick(); tick && *tick <= now_tick;
+           tick = next_tick()) {
+        advance(*tick);
+      }
       continue;
     }
 
-    upcoming_.push(ScheduledRun{current_.when + current_.config->interval,
-                                current_.config});
-    running_current_ = true;
+    // Invoke the callback of the first due timer, and then reschedule it.
+    running_ = due_.front();
+    Timer& timer = *running_;
+    timer.list = nullptr;
+    TimerList running;
+    running.splice(running.end(), due_, due_.begin());
     lock.unlock();
-    current_.config->callback();
+    {
+      DD_TIMELINE_SCOPE("EventScheduler timer");
+      timer.callback();
+    }
     lock.lock();
-    running_current_ = false;
+    if (!timer.cancelled) {
+      timer.when += timer.interval;
+      timer.list = &running;
+      timer.position = running.begin();
+      file(timer);
+    }
+    running_.reset();
     current_done_.notify_all();
   }
 }
@@ -4,59 +4,143 @@
 // the `EventScheduler` interface in terms of a dedicated event dispatching
 // thread. It is the default implementation used if
 // `DatadogAgent::event_scheduler` is not specified.
+//
+// Scheduled events are kept in a hierarchical timer wheel, so that scheduling
+// and cancelling an event take constant time.  Time is divided into ticks of
+// a "slack" duration, and an event is due at the end of the tick in which its
+// time falls.  Events that are due in the same tick are invoked after one
+// wakeup of the dispatching thread, rather than one wakeup each.  An event is
+// thus invoked up to one slack duration late, but never early.
+//
+// Tasks passed to `post` are invoked on the dispatching thread, in the order
+// in which they were posted.
 
 #include <datadog/event_scheduler.h>
+#include <datadog/optional.h>
+#include <datadog/thread_options.h>
 
+#include <array>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <list>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
 
 namespace datadog {
 namespace tracing {
 
+class Logger;
+
 class ThreadedEventScheduler : public EventScheduler {
-  struct EventConfig {
-    std::function<void()> callback;
-    std::chrono::steady_clock::duration interval;
-    bool cancelled;
+  struct Timer;
+  using TimerList = std::list<std::shared_ptr<Timer>>;
 
-    EventConfig(std::function<void()> callback,
-                std::chrono::steady_clock::duration interval);
-  };
+  // Each level of the wheel has `slots_per_level` slots.  A slot in level `L`
+  // holds the timers that are due in one span of `slots_per_level` to the
+  // power `L` ticks.  Timers further in the future than the top level spans
+  // are kept in the top level, and moved down when they are reached.
+  static constexpr std::size_t slot_bits = 6;
+  static constexpr std::size_t slots_per_level = std::size_t(1) << slot_bits;
+  static constexpr std::size_t levels = 4;
 
-  struct ScheduledRun {
-    std::chrono::steady_clock::time_point when;
-    std::shared_ptr<const EventConfig> config;
+  struct Level {
+    std::array<TimerList, slots_per_level> slots;
+    // Bit `i` is set if `slots[i]` is not empty.
+    std::uint64_t occupied = 0;
   };
 
-  struct GreaterThan {
-    bool operator()(const ScheduledRun&, const ScheduledRun&) const;
+  struct Timer {
+    std::function<void()> callback;
+    std::chrono::steady_clock::duration interval;
+    // When the callback is next to be invoked.
+    std::chrono::steady_clock::time_point when;
+    bool cancelled = false;
+    // The list that holds this timer and the timer's position in it, or null
+    // if the timer is not in a list.
+    TimerList* list = nullptr;
+    TimerList::iterator position;
+    // The level and slot of `list`, if `list` is in the wheel.
+    Level* level = nullptr;
+    std::size_t slot = 0;
   };
 
+  const std::chrono::steady_clock::duration slack_;
+  const std::chrono::steady_clock::time_point origin_;
   std::mutex mutex_;
-  ScheduledRun current_;
   std::condition_variable schedule_or_shutdown_;
-  bool running_current_;
   std::condition_variable current_done_;
-  std::priority_queue<ScheduledRun, std::vector<ScheduledRun>, GreaterThan>
-      upcoming_;
+  std::array<Level, levels> levels_;
+  // Timers that are due, in the order in which to invoke them.
+  TimerList due_;
+  // The last tick that the wheel advanced to.  Timers due at or before it are
+  // in `due_`.
+  std::uint64_t current_tick_;
+  // Incremented whenever a timer is scheduled, so that the dispatching thread
+  // knows to reconsider when next to wake up.
+  std::uint64_t generation_;
+  // Tasks passed to `post`, in the order in which to invoke them.
+  std::vector<std::function<void()>> posted_;
+  // The timer whose callback is being invoked, if any.
+  std::shared_ptr<Timer> running_;
   bool shutting_down_;
   std::thread dispatcher_;
 
   void run();
 
+  // Return the first tick at or after the specified `when`.
+  std::uint64_t tick_of(std::chrono::steady_clock::time_point when) const;
+  // Move the specified `timer` from its current list to the wheel slot, or to
+  // `due_`, according to `timer.when`.
+  void file(Timer& timer);
+  // Remove the specified `timer` from its list.
+  void erase(Timer& timer);
+  // Return the next tick at which a slot of the wheel is to be processed, or
+  // return null if the wheel is empty.
+  Optional<std::uint64_t> next_tick() const;
+  // Advance the wheel to the specified `tick`, which must be the result of
+  // `next_tick()`.  Move the timers of the higher levels that `tick` reaches
+  // to the lower levels, and move the timers that are due to `due_`.
+  void advance(std::uint64_t tick);
+
  public:
-  ThreadedEventScheduler();
+  // Events that are due within the same `slack` duration are invoked
+  // together.
+  explicit ThreadedEventScheduler(
+      std::chrono::steady_clock::duration slack =
+          std::chrono::milliseconds(10));
+  // Create the dispatching thread using the specified `make_thread`.
+  ThreadedEventScheduler(std::chrono::steady_clock::duration slack,
+                         const ThreadGenerator& make_thread);
   ~ThreadedEventScheduler();
 
+  // Return the `ThreadedEventScheduler` shared by the components of this
+  // process that use the default event scheduler, creating it if it does not
+  // exist.  It is destroyed, and its thread joined, once no component refers
+  // to it.  A process forked from one that refers to it gets its own.
+  static std::shared_ptr<ThreadedEventScheduler> shared_instance();
+  // Return `shared_instance()` if the specified `threads` are the default.
+  // Otherwise, return a new `ThreadedEventScheduler` whose dispatching thread
+  // has the options `threads`, and logs using the specified `logger`.
+  static std::shared_ptr<ThreadedEventScheduler> shared_instance(
+      const ThreadOptions& threads, const std::shared_ptr<Logger>& logger);
+
   Cancel schedule_recurring_event(std::chrono::steady_clock::duration interval,
                                   std::function<void()> callback) override;
 
+  Cancel schedule_recurring_event_after(
+      std::chrono::steady_clock::duration first_delay,
+      std::chrono::steady_clock::duration interval,
+      std::function<void()> callback) override;
+
+  // Invoke the specified `task` on the dispatching thread, before any timers
+  // that are due.
+  void post(std::function<void()> task) override;
+
   std::string config() const override;
 };
 
@@ -0,0 +1,181 @@
+#include <datadog/timeline.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json_writer.h"
+#include "platform_util.h"
+#include "timeline_events.h"
+
+namespace datadog {
+namespace tracing {
+namespace timeline {
+namespace {
+
+// The fields of an event are atomic because `dump` reads them while the
+// recording thread might overwrite them.  An event torn that way is
+// discarded (see `dump`).
+struct Event {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<std::int64_t> start{0};
+  std::atomic<std::int64_t> end{0};
+};
+
+// `Ring` holds the most recent events of one thread, which is the only writer.
+struct Ring {
+  // Guarded by `Registry::mutex`.
+  std::uint64_t thread_id = 0;
+  bool in_use = false;
+  // The number of events ever recorded in the ring.  Event `i` is in
+  // `events[i % events_per_thread]`.
+  std::atomic<std::uint64_t> written{0};
+  Event events[events_per_thread];
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::uint64_t next_thread_id = 1;
+};
+
+// The registry is never destroyed, so that threads exiting after `main`
+// returns can still release their rings.
+Registry& registry() {
+  static Registry* const instance = new Registry;
+  return *instance;
+}
+
+// Claim a ring for the calling thread, reusing one released by a thread that
+// exited, if any.
+Ring& claim_ring() {
+  Registry& registry = timeline::registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  Ring* ring = nullptr;
+  for (const auto& candidate : registry.rings) {
+    if (!candidate->in_use) {
+      ring = candidate.get();
+      break;
+    }
+  }
+  if (ring == nullptr) {
+    registry.rings.push_back(std::make_unique<Ring>());
+    ring = registry.rings.back().get();
+  }
+  ring->thread_id = registry.next_thread_id++;
+  ring->in_use = true;
+  ring->written.store(0, std::memory_order_relaxed);
+  return *ring;
+}
+
+struct ThreadRing {
+  Ring* ring = nullptr;
+
+  ~ThreadRing() {
+    if (ring == nullptr) return;
+    // The ring's events are kept until another thread claims it.
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->in_use = false;
+  }
+};
+
+thread_local ThreadRing this_thread_ring;
+
+}  // namespace
+
+std::atomic<bool> recording{false};
+
+std::int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void record(const char* name, std::int64_t start, std::int64_t end) {
+  Ring* ring = this_thread_ring.ring;
+  if (ring == nullptr) {
+    ring = this_thread_ring.ring = &claim_ring();
+  }
+  const std::uint64_t index = ring->written.load(std::memory_order_relaxed);
+  Event& event = ring->events[index % events_per_thread];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start.store(start, std::memory_order_relaxed);
+  event.end.store(end, std::memory_order_relaxed);
+  ring->written.store(index + 1, std::memory_order_release);
+}
+
+bool available() {
+#ifdef DD_TRACE_TIMELINE
+  return true;
+#else
+  return false;
+#endif
+}
+
+void enable(bool enabled) {
+  recording.store(enabled, std::memory_order_relaxed);
+}
+
+std::string dump() {
+  struct Copy {
+    const char* name;
+    std::int64_t start;
+    std::int64_t end;
+  };
+
+  std::string result;
+  JsonWriter json{result};
+  json.begin_object();
+  json.member("displayTimeUnit", "ns");
+  json.key("traceEvents");
+  json.begin_array();
+
+  const int process_id = get_process_id();
+  std::vector<Copy> copies;
+  Registry& registry = timeline::registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto& ring : registry.rings) {
+    const std::uint64_t end = ring->written.load(std::memory_order_acquire);
+    const std::uint64_t begin =
+        end > events_per_thread ? end - events_per_thread : 0;
+    copies.clear();
+    for (std::uint64_t i = begin; i < end; ++i) {
+      const Event& event = ring->events[i % events_per_thread];
+      copies.push_back(Copy{event.name.load(std::memory_order_relaxed),
+                            event.start.load(std::memory_order_relaxed),
+                            event.end.load(std::memory_order_relaxed)});
+    }
+    // Discard the events that the recording thread might have overwritten
+    // while they were copied, including the one it might be writing now, if
+    // the thread has not exited.
+    const std::uint64_t after = ring->written.load(std::memory_order_acquire) +
+                                (ring->in_use ? 1 : 0);
+    const std::uint64_t first_intact =
+        after > events_per_thread ? after - events_per_thread : 0;
+
+    for (std::uint64_t i = std::max(begin, first_intact); i < end; ++i) {
+      const Copy& event = copies[i - begin];
+      json.begin_object();
+      json.member("name", event.name);
+      json.member("cat", "dd-trace-cpp");
+      json.member("ph", "X");
+      json.member("ts", double(event.start) / 1000);
+      json.member("dur", double(event.end - event.start) / 1000);
+      json.member("pid", process_id);
+      json.member("tid", ring->thread_id);
+      json.end_object();
+    }
+  }
+
+  json.end_array();
+  json.end_object();
+  return result;
+}
+
+}  // namespace timeline
+}  // namespace tracing
+}  // namespace datadog
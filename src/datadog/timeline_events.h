@@ -0,0 +1,89 @@
+#pragma once
+
+// This component provides the macros with which the tracer records events in
+// its timeline (see `timeline.h`).
+//
+// `DD_TIMELINE_SCOPE(name)` is a statement that records an event having the
+// specified `name`, a string literal, from where it appears until the end of
+// the enclosing scope.
+//
+// `DD_TIMELINE_LOCK(mutex, name)` locks the specified `mutex`, and records
+// an event having the specified `name` for the time spent waiting if the
+// mutex was not immediately available.  The caller then adopts the lock,
+// e.g. with `std::lock_guard<std::mutex> lock(mutex, std::adopt_lock)`.
+//
+// The events are recorded only if the `DD_TRACE_TIMELINE` preprocessor macro
+// is defined, and then only while the timeline is enabled.  Otherwise,
+// `DD_TIMELINE_SCOPE` expands to a statement that does nothing, and
+// `DD_TIMELINE_LOCK` only locks.  The recording itself, `TimelineScope`, is
+// always compiled, so that it can be tested.
+
+#include <atomic>
+#include <cstdint>
+
+namespace datadog {
+namespace tracing {
+namespace timeline {
+
+// Whether events are recorded (see `timeline::enable`).
+extern std::atomic<bool> recording;
+
+// Return the current time, in nanoseconds, as recorded in events.
+std::int64_t now();
+
+// Record, on the calling thread, an event having the specified `name`, which
+// began at the specified `start` and ended at the specified `end`.
+void record(const char* name, std::int64_t start, std::int64_t end);
+
+}  // namespace timeline
+
+class TimelineScope {
+  const char* name_;
+  std::int64_t start_ = 0;
+
+ public:
+  explicit TimelineScope(const char* name)
+      : name_(timeline::recording.load(std::memory_order_relaxed) ? name
+                                                                  : nullptr) {
+    if (name_) start_ = timeline::now();
+  }
+
+  ~TimelineScope() {
+    if (name_) timeline::record(name_, start_, timeline::now());
+  }
+
+  TimelineScope(const TimelineScope&) = delete;
+  TimelineScope& operator=(const TimelineScope&) = delete;
+};
+
+// Lock the specified `mutex`, recording the wait, if any, as an event having
+// the specified `name`.
+template <typename Mutex>
+void lock_recording_wait(Mutex& mutex, const char* name) {
+  if (mutex.try_lock()) return;
+  const TimelineScope wait(name);
+  mutex.lock();
+}
+
+}  // namespace tracing
+}  // namespace datadog
+
+#ifdef DD_TRACE_TIMELINE
+
+#define DD_TIMELINE_CONCAT_IMPL(left, right) left##right
+#define DD_TIMELINE_CONCAT(left, right) DD_TIMELINE_CONCAT_IMPL(left, right)
+
+#define DD_TIMELINE_SCOPE(name)                               \
+  const ::datadog::tracing::TimelineScope DD_TIMELINE_CONCAT( \
+      dd_timeline_scope_, __LINE__)(name)
+
+#define DD_TIMELINE_LOCK(mutex, name) \
+  ::datadog::tracing::lock_recording_wait(mutex, name)
+
+#else
+
+#define DD_TIMELINE_SCOPE(name) static_cast<void>(0)
+
+#define DD_TIMELINE_LOCK(mutex, name) (mutex).lock()
+
+#endif  // defined DD_TRACE_TIMELINE
@@ -0,0 +1,373 @@
+#include "trace_encoder_v05.h"
+
+#include <cassert>
+#include <chrono>
+
+#include "msgpack.h"
+#include "span_data.h"
+#include "tags.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// `Reader` decodes the MessagePack values that `TraceEncoderV05` produces.
+// Each function returns false, and leaves the cursor unspecified, if the next
+// value is not of the expected type or is truncated.
+class Reader {
+  const unsigned char* next_;
+  const unsigned char* const end_;
+
+  bool read_big_endian(std::size_t size, std::uint64_t& value) {
+    if (std::size_t(end_ - next_) < size) {
+      return false;
+    }
+    value = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      value = (value << 8) | *next_++;
+    }
+    return true;
+  }
+
+  // Read the size of an array or a map whose type bytes are the specified
+  // `fix` (with the size in its low bits, under the specified `fix_mask`),
+  // `type16`, and `type32`.
+  bool read_size(std::byte fix, unsigned fix_mask, std::byte type16,
+                 std::byte type32, std::size_t& size) {
+    if (next_ == end_) {
+      return false;
+    }
+    const auto type = std::byte(*next_++);
+    std::uint64_t value;
+    if ((type & ~std::byte(fix_mask)) == fix) {
+      value = std::to_integer<unsigned>(type) & fix_mask;
+    } else if (type == type16) {
+      if (!read_big_endian(2, value)) return false;
+    } else if (type == type32) {
+      if (!read_big_endian(4, value)) return false;
+    } else {
+      return false;
+    }
+    size = static_cast<std::size_t>(value);
+    return true;
+  }
+
+ public:
+  explicit Reader(StringView input)
+      : next_(reinterpret_cast<const unsigned char*>(input.data())),
+        end_(next_ + input.size()) {}
+
+  bool done() const { return next_ == end_; }
+
+  bool read_array(std::size_t& size) {
+    using namespace msgpack::types;
+    return read_size(FIXARRAY, 0x0F, ARRAY16, ARRAY32, size);
+  }
+
+  bool read_map(std::size_t& size) {
+    using namespace msgpack::types;
+    return read_size(FIXMAP, 0x0F, MAP16, MAP32, size);
+  }
+
+  bool read_string(StringView& value) {
+    using namespace msgpack::types;
+    if (next_ == end_) {
+      return false;
+    }
+    const auto type = std::byte(*next_);
+    std::uint64_t size;
+    if ((type & std::byte(0xE0)) == FIXSTR) {
+      ++next_;
+      size = std::to_integer<unsigned>(type) & 0x1F;
+    } else if (type == STR8 || type == STR16 || type == STR32) {
+      ++next_;
+      if (!read_big_endian(type == STR8 ? 1 : type == STR16 ? 2 : 4, size)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+    if (std::uint64_t(end_ - next_) < size) {
+      return false;
+    }
+    value = StringView(reinterpret_cast<const char*>(next_),
+                       static_cast<std::size_t>(size));
+    next_ += size;
+    return true;
+  }
+
+  // Read a nonnegative integer.
+  bool read_unsigned(std::uint64_t& value) {
+    using namespace msgpack::types;
+    if (next_ == end_) {
+      return false;
+    }
+    const auto type = std::byte(*next_++);
+    if ((type & std::byte(0x80)) == std::byte(0)) {
+      value = std::to_integer<unsigned>(type);
+      return true;
+    }
+    if (type == UINT8) return read_big_endian(1, value);
+    if (type == UINT16) return read_big_endian(2, value);
+    if (type == UINT32) return read_big_endian(4, value);
+    if (type == UINT64) return read_big_endian(8, value);
+    return false;
+  }
+
+  // Append the encoding of the next value, which must be a number, to the
+  // specified `destination`, as it is.
+  bool copy_number(std::string& destination) {
+    using namespace msgpack::types;
+    if (next_ == end_) {
+      return false;
+    }
+    const unsigned char* const begin = next_;
+    const auto type = std::byte(*next_++);
+    std::size_t size = 0;
+    if (type == UINT8 || type == INT8) {
+      size = 1;
+    } else if (type == UINT16 || type == INT16) {
+      size = 2;
+    } else if (type == UINT32 || type == INT32) {
+      size = 4;
+    } else if (type == UINT64 || type == INT64 || type == DOUBLE) {
+      size = 8;
+    } else if ((type & std::byte(0x80)) != std::byte(0) &&
+               (type & std::byte(0xE0)) != std::byte(0xE0)) {
+      // It is neither a positive nor a negative fixint.
+      return false;
+    }
+    if (std::size_t(end_ - next_) < size) {
+      return false;
+    }
+    next_ += size;
+    destination.append(reinterpret_cast<const char*>(begin), next_ - begin);
+    return true;
+  }
+};
+
+}  // namespace
+
+TraceEncoderV05::TraceEncoderV05(std::size_t expected_size) : chunk_count_(0) {
+  chunks_.reserve(expected_size);
+  // By convention, the empty string is the first entry of the dictionary.
+  index_of("");
+}
+
+Expected<void> TraceEncoderV05::add_chunk(
+    const std::vector<std::unique_ptr<SpanData>>& spans) {
+  Expected<void> result = msgpack::pack_array(chunks_, spans.size());
+  if (!result) {
+    return result;
+  }
+  for (const auto& span : spans) {
+    assert(span);
+    encode_span(*span);
+  }
+  ++chunk_count_;
+  return result;
+}
+
+Expected<void> TraceEncoderV05::finish(std::string& destination) const {
+  if (destination.capacity() < destination.size() + chunks_.size()) {
+    destination.reserve(destination.size() + chunks_.size());
+  }
+  Expected<void> result = msgpack::pack_array(destination, 2);
+  if (!result) {
+    return result;
+  }
+  result = msgpack::pack_array(destination, strings_,
+                               [](std::string& destination, StringView value) {
+                                 return msgpack::pack_string(destination,
+                                                             value);
+                               });
+  if (!result) {
+    return result;
+  }
+  result = msgpack::pack_array(destination, chunk_count_);
+  if (!result) {
+    return result;
+  }
+  destination += chunks_;
+  return result;
+}
+
+std::uint32_t TraceEncoderV05::index_of(StringView value) {
+  const auto [iter, inserted] =
+      indices_.emplace(value, static_cast<std::uint32_t>(strings_.size()));
+  if (inserted) {
+    strings_.push_back(value);
+  }
+  return iter->second;
+}
+
+void TraceEncoderV05::encode_span(const SpanData& span) {
+  // The dictionary's indices are 32-bit, and the number of elements of each
+  // array and map below is far below the protocol maximum, so none of the
+  // `msgpack` functions can fail.
+  std::string& out = chunks_;
+  msgpack::pack_array(out, 12);
+  msgpack::pack_integer(out, index_of(span.service));
+  msgpack::pack_integer(out, index_of(span.name));
+  msgpack::pack_integer(out, index_of(span.resource));
+  msgpack::pack_integer(out, span.trace_id.low);
+  msgpack::pack_integer(out, span.span_id);
+  msgpack::pack_integer(out, span.parent_id);
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  msgpack::pack_integer(
+      out, std::int64_t(duration_cast<nanoseconds>(
+                            span.start.wall.time_since_epoch())
+                            .count()));
+  msgpack::pack_integer(
+      out, std::int64_t(duration_cast<nanoseconds>(span.duration).count()));
+  msgpack::pack_integer(out, std::int32_t(span.error));
+
+  const auto* shared = span.shared_tags.get();
+  const std::string* const error_stack = symbolized_error_stack(span);
+
+  msgpack::pack_map(out, span.tags.size() +
+                             (shared ? shared->tags().size() : 0) +
+                             (error_stack != nullptr) + !span.links.empty() +
+                             !span.events.empty());
+  for (const auto& [key, value] : span.tags) {
+    msgpack::pack_integer(out, index_of(key));
+    msgpack::pack_integer(out, index_of(value));
+  }
+  if (shared) {
+    for (const auto& [key, value] : shared->tags()) {
+      msgpack::pack_integer(out, index_of(key));
+      msgpack::pack_integer(out, index_of(value));
+    }
+  }
+  if (error_stack) {
+    // The dictionary refers to its strings, so keep a copy of the stack.
+    generated_.push_back(*error_stack);
+    msgpack::pack_integer(out, index_of(tags::error_stack));
+    msgpack::pack_integer(out, index_of(generated_.back()));
+  }
+  if (!span.links.empty()) {
+    json_encode(generated_.emplace_back(), span.links);
+    msgpack::pack_integer(out, index_of("_dd.span_links"));
+    msgpack::pack_integer(out, index_of(generated_.back()));
+  }
+  if (!span.events.empty()) {
+    json_encode(generated_.emplace_back(), span.events);
+    msgpack::pack_integer(out, index_of("events"));
+    msgpack::pack_integer(out, index_of(generated_.back()));
+  }
+
+  msgpack::pack_map(out, span.numeric_tags.size() +
+                             (shared ? shared->numeric_tags().size() : 0));
+  for (const auto& [key, value] : span.numeric_tags) {
+    msgpack::pack_integer(out, index_of(key));
+    msgpack::pack_number(out, value);
+  }
+  if (shared) {
+    for (const auto& [key, value] : shared->numeric_tags()) {
+      msgpack::pack_integer(out, index_of(key));
+      msgpack::pack_number(out, value);
+    }
+  }
+
+  msgpack::pack_integer(out, index_of(span.service_type));
+}
+
+Expected<void> transcode_v05_to_v04(std::string& destination,
+                                    StringView payload) {
+  const Error invalid{Error::DATADOG_AGENT_INVALID_V05_PAYLOAD,
+                      "Unable to convert a v0.5 traces payload to v0.4, "
+                      "because it is not valid."};
+  Reader reader{payload};
+  std::vector<StringView> strings;
+  std::size_t size;
+  if (!reader.read_array(size) || size != 2 || !reader.read_array(size)) {
+    return invalid;
+  }
+  strings.resize(size);
+  for (auto& value : strings) {
+    if (!reader.read_string(value)) {
+      return invalid;
+    }
+  }
+
+  // The strings of the dictionary are valid UTF-8, since they were packed
+  // by `pack_string`, so that packing them again does not change them.
+  std::string& out = destination;
+  const auto pack_string_at = [&](const char* key) {
+    std::uint64_t index;
+    if (key != nullptr) {
+      msgpack::pack_string(out, key);
+    }
+    if (!reader.read_unsigned(index) || index >= strings.size()) {
+      return false;
+    }
+    msgpack::pack_string(out, strings[index]);
+    return true;
+  };
+  const auto copy_number = [&](const char* key) {
+    msgpack::pack_string(out, key);
+    return reader.copy_number(out);
+  };
+
+  std::size_t chunk_count;
+  if (!reader.read_array(chunk_count)) {
+    return invalid;
+  }
+  msgpack::pack_array(out, chunk_count);
+  for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    std::size_t span_count;
+    if (!reader.read_array(span_count)) {
+      return invalid;
+    }
+    msgpack::pack_array(out, span_count);
+    for (std::size_t span = 0; span < span_count; ++span) {
+      std::size_t field_count;
+      if (!reader.read_array(field_count) || field_count != 12) {
+        return invalid;
+      }
+      msgpack::pack_map(out, 12);
+      if (!pack_string_at("service") || !pack_string_at("name") ||
+          !pack_string_at("resource") || !copy_number("trace_id") ||
+          !copy_number("span_id") || !copy_number("parent_id") ||
+          !copy_number("start") || !copy_number("duration") ||
+          !copy_number("error")) {
+        return invalid;
+      }
+
+      std::size_t tag_count;
+      if (!reader.read_map(tag_count)) {
+        return invalid;
+      }
+      msgpack::pack_string(out, "meta");
+      msgpack::pack_map(out, tag_count);
+      for (std::size_t tag = 0; tag < tag_count; ++tag) {
+        if (!pack_string_at(nullptr) || !pack_string_at(nullptr)) {
+          return invalid;
+        }
+      }
+
+      if (!reader.read_map(tag_count)) {
+        return invalid;
+      }
+      msgpack::pack_string(out, "metrics");
+      msgpack::pack_map(out, tag_count);
+      for (std::size_t tag = 0; tag < tag_count; ++tag) {
+        if (!pack_string_at(nullptr) || !reader.copy_number(out)) {
+          return invalid;
+        }
+      }
+
+      if (!pack_string_at("type")) {
+        return invalid;
+      }
+    }
+  }
+  if (!reader.done()) {
+    return invalid;
+  }
+  return nullopt;
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,80 @@
+#pragma once
+
+// This component provides a `class`, `TraceEncoderV05`, that MessagePack
+// encodes trace chunks in the format accepted by the Datadog Agent's
+// "/v0.5/traces" endpoint.
+//
+// In the v0.4 format (see `msgpack_encode` in `span_data.h`), each span is a
+// map whose keys and string values are repeated in full for every span.  In
+// the v0.5 format, a payload is an array of two elements:
+//
+// 1. a "dictionary," which is an array of every distinct string in the
+//    payload, and
+// 2. an array of trace chunks, each of which is an array of spans.
+//
+// Each span is an array of twelve elements in a fixed order, and every string
+// within a span (its service, name, resource, type, and tag keys and values)
+// is encoded as an index into the dictionary.  Payloads in which the same
+// strings appear in many spans are thereby much smaller, and cheaper to
+// produce.
+
+#include <datadog/expected.h>
+#include <datadog/string_view.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+struct SpanData;
+
+class TraceEncoderV05 {
+  // The dictionary, in index order.  The strings are owned by the encoded
+  // spans, except for those in `generated_`.
+  std::vector<StringView> strings_;
+  // The JSON encodings of span links and span events.  A `deque` does not
+  // move its elements, so that `strings_` can refer to them.
+  std::deque<std::string> generated_;
+  std::unordered_map<StringView, std::uint32_t> indices_;
+  // The encoded trace chunks, without their enclosing array header.
+  std::string chunks_;
+  std::size_t chunk_count_;
+
+ public:
+  // Create an encoder that reserves room for the specified `expected_size`
+  // bytes of encoded spans.
+  explicit TraceEncoderV05(std::size_t expected_size = 0);
+
+  // Encode the specified `spans` as one trace chunk of the payload.  The
+  // spans must remain alive and unmodified until `finish` returns.  The
+  // behavior is undefined if any span is `nullptr`.
+  Expected<void> add_chunk(const std::vector<std::unique_ptr<SpanData>>& spans);
+
+  // Append to the specified `destination` the MessagePack encoding of the
+  // payload consisting of the chunks added so far.
+  Expected<void> finish(std::string& destination) const;
+
+ private:
+  // Return the dictionary index of the specified `value`, adding it to the
+  // dictionary if necessary.
+  std::uint32_t index_of(StringView value);
+  void encode_span(const SpanData& span);
+};
+
+// Append to the specified `destination` the v0.4 encoding (see
+// `msgpack_encode` in `span_data.h`) of the trace chunks in the specified
+// v0.5 `payload`, which was produced by `TraceEncoderV05::finish`.  Return an
+// error if `payload` is not such a payload.  Span links and span events remain
+// in the tags in which the v0.5 encoding places them.  This is how a payload
+// is sent again when the Datadog Agent turns out not to support v0.5.
+Expected<void> transcode_v05_to_v04(std::string& destination,
+                                    StringView payload);
+
+}  // namespace tracing
+}  // namespace datadog
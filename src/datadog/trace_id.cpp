@@ -15,13 +15,9 @@ TraceID::TraceID(std::uint64_t low, std::uint64_t high)
     : low(low), high(high) {}
 
 std::string TraceID::hex_padded() const {
-  std::string result;
-  if (high) {
-    result += ::datadog::tracing::hex_padded(high);
-  } else {
-    result.append(16, '0');
-  }
-  result += ::datadog::tracing::hex_padded(low);
+  std::string result(32, '0');
+  write_hex_padded(&result[0], high);
+  write_hex_padded(&result[16], low);
   return result;
 }
 
@@ -2,19 +2,96 @@
 
 #include <datadog/sampling_decision.h>
 #include <datadog/sampling_priority.h>
+#include <datadog/shared_sampler_state.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "collector_response.h"
 #include "json_serializer.h"
 #include "sampling_util.h"
+#include "self_profiling.h"
 #include "span_data.h"
+#include "telemetry_metrics.h"
 
 namespace datadog {
 namespace tracing {
 
+namespace {
+
+std::vector<const SpanMatcher*> matchers_of(
+    const std::vector<TraceSamplerRule>& rules) {
+  std::vector<const SpanMatcher*> matchers;
+  matchers.reserve(rules.size());
+  for (const auto& rule : rules) {
+    matchers.push_back(&rule.matcher);
+  }
+  return matchers;
+}
+
+// `TraceSampler::generation_` values are drawn from this counter, so that no
+// two samplers ever have the same generation.  Zero is never drawn, and so it
+// marks an empty cache entry.
+std::atomic<std::uint64_t> next_generation{1};
+
+// `CollectorRate` is the collector-controlled sample rate that
+// `TraceSampler::decide` resolved for a service and environment during a
+// particular sampler generation.
+struct CollectorRate {
+  std::uint64_t generation = 0;
+  std::string service;
+  std::string environment;
+  Rate rate;
+  SamplingMechanism mechanism = SamplingMechanism::DEFAULT;
+};
+
+// Each thread caches recently resolved collector rates in a small
+// direct-mapped table.  Once an entry's strings have been allocated, replacing
+// the entry reuses their capacity, so steady-state lookups do not allocate.
+constexpr std::size_t collector_rate_cache_size = 16;
+thread_local std::array<CollectorRate, collector_rate_cache_size>
+    collector_rate_cache;
+
+// Return the index in `collector_rate_cache` of the entry for the specified
+// `service` and `environment`.  The hash is FNV-1a.
+std::size_t collector_rate_slot(StringView service, StringView environment) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto mix = [&](StringView text) {
+    for (const char ch : text) {
+      hash ^= static_cast<unsigned char>(ch);
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(service);
+  // Separate the service from the environment, so that ("ab", "c") and
+  // ("a", "bc") usually have different hashes.
+  hash ^= 0xff;
+  hash *= 1099511628211ULL;
+  mix(environment);
+  return static_cast<std::size_t>(hash % collector_rate_cache_size);
+}
+
+// Return a limiter for the specified `config`, which shares the token bucket
+// of `config.shared_state` if there is one.
+Limiter make_limiter(const FinalizedTraceSamplerConfig& config,
+                     const Clock& clock) {
+  if (config.shared_state) {
+    return Limiter(clock, config.max_per_second,
+                   config.shared_state->limiter_bucket());
+  }
+  return Limiter(clock, config.max_per_second);
+}
+
+}  // namespace
+
+TraceSampler::Rules::Rules(std::vector<TraceSamplerRule>&& rules)
+    : rules(std::move(rules)), matchers(matchers_of(this->rules)) {}
+
 nlohmann::json to_json(const TraceSamplerRule& rule) {
   nlohmann::json j = rule.matcher;
   j["sample_rate"] = rule.rate.value();
@@ -23,75 +100,113 @@ nlohmann::json to_json(const TraceSamplerRule& rule) {
 
 TraceSampler::TraceSampler(const FinalizedTraceSamplerConfig& config,
                            const Clock& clock)
-    : rules_(config.rules),
-      limiter_(clock, config.max_per_second),
-      limiter_max_per_second_(config.max_per_second) {}
+    : collector_rates_(std::make_shared<const CollectorRates>()),
+      rules_(std::make_shared<const Rules>(
+          std::vector<TraceSamplerRule>(config.rules))),
+      limiter_(make_limiter(config, clock)),
+      limiter_max_per_second_(config.max_per_second),
+      adaptive_(config.adaptive_target_per_second
+                    ? std::make_unique<AdaptiveSampler>(
+                          clock, *config.adaptive_target_per_second)
+                    : nullptr),
+      stratified_(config.stratified_target_per_second
+                      ? std::make_unique<StratifiedSampler>(
+                            clock, *config.stratified_target_per_second)
+                      : nullptr),
+      generation_(next_generation.fetch_add(1)),
+      overhead_keep_rate_(1.0),
+      shared_state_(config.shared_state),
+      shared_rates_version_(0) {}
+
+void TraceSampler::bump_generation() {
+  generation_.store(next_generation.fetch_add(1), std::memory_order_release);
+}
 
 void TraceSampler::set_rules(std::vector<TraceSamplerRule> rules) {
-  std::lock_guard lock(mutex_);
-  rules_ = std::move(rules);
+  auto snapshot = std::make_shared<const Rules>(std::move(rules));
+  std::lock_guard<std::mutex> lock(mutex_);
+  rules_.store(std::move(snapshot));
+  bump_generation();
 }
 
 SamplingDecision TraceSampler::decide(const SpanData& span) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::sampling);
   SamplingDecision decision;
   decision.origin = SamplingDecision::Origin::LOCAL;
 
   // First check sampling rules.
-  const auto found_rule =
-      std::find_if(rules_.cbegin(), rules_.cend(),
-                   [&](const auto& it) { return it.matcher.match(span); });
+  const auto rules = rules_.load();
+  const std::size_t found_rule = rules->matchers.find(span);
 
-  // `mutex_` protects `limiter_`, `collector_sample_rates_`, and
-  // `collector_default_sample_rate_`, so let's lock it here.
-  std::lock_guard lock(mutex_);
-
-  if (found_rule != rules_.end()) {
-    const auto& rule = *found_rule;
+  if (found_rule != CompiledSpanMatchers::npos) {
+    const auto& rule = rules->rules[found_rule];
     decision.mechanism = int(rule.mechanism);
-    decision.limiter_max_per_second = limiter_max_per_second_;
-    decision.configured_rate = rule.rate;
-    const std::uint64_t threshold = max_id_from_rate(rule.rate);
-    if (knuth_hash(span.trace_id.low) <= threshold) {
-      if (rule.bypass_limiter) {
-        decision.priority = int(SamplingPriority::USER_KEEP);
-        return decision;
-      }
+    apply_rule_rate(decision, rule.rate, rule.bypass_limiter,
+                    span.trace_id.low);
+    return decision;
+  }
 
-      const auto result = limiter_.allow();
-      if (result.allowed) {
-        decision.priority = int(SamplingPriority::USER_KEEP);
-      } else {
-        decision.priority = int(SamplingPriority::USER_DROP);
-      }
-      decision.limiter_effective_rate = result.effective_rate;
-    } else {
-      decision.priority = int(SamplingPriority::USER_DROP);
-    }
+  if (adaptive_) {
+    decision.mechanism = int(SamplingMechanism::RULE);
+    apply_rule_rate(decision,
+                    adaptive_->sample_rate(span.service, span.resource),
+                    false, span.trace_id.low);
+    return decision;
+  }
 
+  if (stratified_) {
+    decision.mechanism = int(SamplingMechanism::RULE);
+    decision.stratum = StratifiedSampler::stratum(span.service, span.resource);
+    apply_rule_rate(decision, stratified_->sample_rate(*decision.stratum),
+                    true, span.trace_id.low);
     return decision;
   }
 
   // No sampling rule matched.  Find the appropriate collector-controlled
-  // sample rate.
-  auto found_rate = collector_sample_rates_.find(
-      CollectorResponse::key(span.service, span.environment().value_or("")));
-  if (found_rate != collector_sample_rates_.end()) {
-    decision.configured_rate = found_rate->second;
-    decision.mechanism = int(SamplingMechanism::AGENT_RATE);
-  } else {
-    if (collector_default_sample_rate_) {
-      decision.configured_rate = *collector_default_sample_rate_;
-      decision.mechanism = int(SamplingMechanism::AGENT_RATE);
+  // sample rate, preferably in this thread's cache.
+  if (shared_state_) {
+    refresh_shared_rates();
+  }
+  const StringView environment = span.environment().value_or("");
+  CollectorRate& cached =
+      collector_rate_cache[collector_rate_slot(span.service, environment)];
+  const std::uint64_t generation = generation_.load(std::memory_order_acquire);
+  if (cached.generation != generation || cached.service != span.service ||
+      cached.environment != environment) {
+    // `generation_` is replaced after `collector_rates_`, so the rates loaded
+    // here are at least as recent as `generation`.  If they are more recent,
+    // then the entry is merely refreshed again by a later call.
+    const auto collector_rates = collector_rates_.load();
+    cached.generation = generation;
+    cached.service = span.service;
+    assign(cached.environment, environment);
+
+    Optional<Rate> collector_rate;
+    if (collector_rates->response) {
+      const auto& rates = collector_rates->response->sample_rate_by_key;
+      const auto found_rate =
+          rates.find(CollectorResponse::key(span.service, environment));
+      if (found_rate != rates.end()) {
+        collector_rate = found_rate->second;
+      }
+    }
+    if (collector_rate) {
+      cached.rate = *collector_rate;
+      cached.mechanism = SamplingMechanism::AGENT_RATE;
+    } else if (collector_rates->default_rate) {
+      cached.rate = *collector_rates->default_rate;
+      cached.mechanism = SamplingMechanism::AGENT_RATE;
     } else {
       // We have yet to receive a default rate from the collector.  This
       // corresponds to the `DEFAULT` sampling mechanism.
-      decision.configured_rate = Rate::one();
-      decision.mechanism = int(SamplingMechanism::DEFAULT);
+      cached.rate = Rate::one();
+      cached.mechanism = SamplingMechanism::DEFAULT;
     }
   }
+  decision.configured_rate = cached.rate;
+  decision.mechanism = int(cached.mechanism);
 
-  const std::uint64_t threshold = max_id_from_rate(*decision.configured_rate);
-  if (knuth_hash(span.trace_id.low) <= threshold) {
+  if (keep_at_configured_rate(decision, span.trace_id.low)) {
     decision.priority = int(SamplingPriority::AUTO_KEEP);
   } else {
     decision.priority = int(SamplingPriority::AUTO_DROP);
@@ -100,29 +215,132 @@ SamplingDecision TraceSampler::decide(const SpanData& span) {
   return decision;
 }
 
+bool TraceSampler::keep_at_configured_rate(SamplingDecision& decision,
+                                           std::uint64_t trace_id_low) {
+  const std::uint64_t hash = knuth_hash(trace_id_low);
+  const Rate rate = *decision.configured_rate;
+  const double keep_rate = overhead_keep_rate_.load(std::memory_order_relaxed);
+  if (keep_rate >= 1) {
+    return hash <= max_id_from_rate(rate);
+  }
+
+  decision.configured_rate = *Rate::from(rate * keep_rate);
+  if (hash <= max_id_from_rate(*decision.configured_rate)) {
+    return true;
+  }
+  decision.overhead_regulated = hash <= max_id_from_rate(rate);
+  return false;
+}
+
+void TraceSampler::set_overhead_keep_rate(Rate rate) {
+  overhead_keep_rate_.store(rate, std::memory_order_relaxed);
+}
+
+Rate TraceSampler::overhead_keep_rate() const {
+  return *Rate::from(overhead_keep_rate_.load(std::memory_order_relaxed));
+}
+
+void TraceSampler::apply_rule_rate(SamplingDecision& decision, Rate rate,
+                                   bool bypass_limiter,
+                                   std::uint64_t trace_id_low) {
+  decision.limiter_max_per_second = limiter_max_per_second_;
+  decision.configured_rate = rate;
+  if (!keep_at_configured_rate(decision, trace_id_low)) {
+    decision.priority = int(SamplingPriority::USER_DROP);
+    return;
+  }
+  if (bypass_limiter) {
+    decision.priority = int(SamplingPriority::USER_KEEP);
+    return;
+  }
+
+  const auto result = limiter_.allow();
+  if (result.allowed) {
+    decision.priority = int(SamplingPriority::USER_KEEP);
+  } else {
+    decision.priority = int(SamplingPriority::USER_DROP);
+  }
+  decision.limiter_effective_rate = result.effective_rate;
+}
+
 void TraceSampler::handle_collector_response(
     const CollectorResponse& response) {
-  const auto found =
-      response.sample_rate_by_key.find(response.key_of_default_rate);
+  handle_collector_response(
+      std::make_shared<const CollectorResponse>(response));
+}
+
+void TraceSampler::handle_collector_response(
+    std::shared_ptr<const CollectorResponse> response) {
+  assert(response);
+  if (shared_state_) {
+    // The other samplers apply the rates at their next decision, as does
+    // this one, for which they are then the same as those set below.
+    shared_state_->publish_rates(response->sample_rate_by_key);
+  }
   std::lock_guard<std::mutex> lock(mutex_);
+  set_collector_rates(std::move(response));
+}
 
-  if (found != response.sample_rate_by_key.end()) {
-    collector_default_sample_rate_ = found->second;
+void TraceSampler::refresh_shared_rates() {
+  if (shared_state_->rates_version() ==
+      shared_rates_version_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  auto response = std::make_shared<CollectorResponse>();
+  std::uint64_t version;
+  if (!shared_state_->read_rates(response->sample_rate_by_key, version)) {
+    return;
   }
+  shared_rates_version_.store(version, std::memory_order_relaxed);
+  set_collector_rates(std::move(response));
+}
+
+void TraceSampler::set_collector_rates(
+    std::shared_ptr<const CollectorResponse> response) {
+  const auto& rates = response->sample_rate_by_key;
+  const auto found = rates.find(CollectorResponse::key_of_default_rate);
+  auto snapshot = std::make_shared<CollectorRates>();
+  if (found != rates.end()) {
+    snapshot->default_rate = found->second;
+  }
+  snapshot->response = std::move(response);
 
-  collector_sample_rates_ = response.sample_rate_by_key;
+  if (!snapshot->default_rate) {
+    // Keep the default rate of an earlier response.
+    snapshot->default_rate = collector_rates_.load()->default_rate;
+  }
+  // Publish the new rates by swapping a pointer.  The old rates are freed by
+  // the last `decide` call that loaded them.
+  collector_rates_.store(std::move(snapshot));
+  bump_generation();
 }
 
 nlohmann::json TraceSampler::config_json() const {
+  const auto current_rules = rules_.load();
   std::vector<nlohmann::json> rules;
-  for (const auto& rule : rules_) {
+  for (const auto& rule : current_rules->rules) {
     rules.push_back(to_json(rule));
   }
 
-  return nlohmann::json::object({
+  auto result = nlohmann::json::object({
       {"rules", rules},
       {"max_per_second", limiter_max_per_second_},
   });
+  if (adaptive_) {
+    result["adaptive_target_per_second"] = adaptive_->target_per_second();
+  }
+  if (stratified_) {
+    result["stratified_target_per_second"] =
+        stratified_->target_per_second();
+  }
+  if (shared_state_) {
+    result["shared_state"] = true;
+  }
+  return result;
 }
 
 }  // namespace tracing
@@ -82,47 +82,150 @@
 // rate) is limited by a configurable number of traces-per-second.  The limit is
 // configured via `TraceSamplerConfig::max_per_second` or the
 // `DD_TRACE_RATE_LIMIT` environment variable.
+//
+// 4. Adaptive Sampling
+// --------------------
+// If `TraceSamplerConfig::adaptive_target_per_second` is set, then root spans
+// that match no sampling rule are sampled at rates computed locally from the
+// throughput of each service and resource, instead of at the rates provided by
+// the Datadog Agent.  The computed rates are applied as if by a sampling rule,
+// and so are also subject to `max_per_second`.  See `adaptive_sampler.h`.
+//
+// 5. Stratified Sampling
+// ----------------------
+// If `TraceSamplerConfig::stratified_target_per_second` is set, then root
+// spans that match no sampling rule are sampled at rates computed locally so
+// that every service and resource is represented among the kept traces,
+// however many there are, and the busiest share the rest of the target.  The
+// decisions are made as by a sampling rule that is not subject to
+// `max_per_second`, and record the stratum of the root span, which is added
+// to it as the tag "_dd.sampling.stratum".  See `stratified_sampler.h`.
+//
+// 6. Overhead Regulation
+// ----------------------
+// If `TracerConfig::max_cpu_overhead` is set, then an `OverheadGovernor` may
+// lower the share of traces that `decide` keeps, whatever their rate, by
+// setting `overhead_keep_rate`.  The configured rate of each decision is then
+// the product of the two, and a trace kept by the former but not by the
+// latter is dropped, with the decision's `overhead_regulated` set.
+//
+// 7. Shared State
+// ---------------
+// If `TraceSamplerConfig::shared_state` is set, then the limiter's token
+// bucket is shared with the trace samplers of other processes, as are the
+// sample rates received from the Datadog Agent: each response's rates are
+// published to the other samplers, which apply them at their next decision.
+// See `shared_sampler_state.h`.
 
+#include <datadog/atomic_snapshot.h>
 #include <datadog/clock.h>
 #include <datadog/optional.h>
 #include <datadog/rate.h>
 #include <datadog/trace_sampler_config.h>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 
+#include "adaptive_sampler.h"
+#include "compiled_span_matchers.h"
 #include "json.hpp"
 #include "limiter.h"
+#include "stratified_sampler.h"
 
 namespace datadog {
 namespace tracing {
 
 struct CollectorResponse;
+class SharedSamplerState;
 struct SamplingDecision;
 struct SpanData;
 
 class TraceSampler {
  private:
+  // The state that `decide` reads is published as immutable snapshots, which
+  // are replaced as a whole through `AtomicSnapshot`, so that `decide` never
+  // locks.  `mutex_` serializes the writers, which build each new snapshot
+  // from the previous one.
   std::mutex mutex_;
 
-  Optional<Rate> collector_default_sample_rate_;
-  std::unordered_map<std::string, Rate> collector_sample_rates_;
-  std::vector<TraceSamplerRule> rules_;
+  // The most recent collector response, and the most recent default sample
+  // rate that any collector response contained.
+  struct CollectorRates {
+    std::shared_ptr<const CollectorResponse> response;
+    Optional<Rate> default_rate;
+  };
+  AtomicSnapshot<const CollectorRates> collector_rates_;
+  // The sampling rules, along with their compiled matchers.
+  struct Rules {
+    std::vector<TraceSamplerRule> rules;
+    CompiledSpanMatchers matchers;
+
+    explicit Rules(std::vector<TraceSamplerRule>&& rules);
+  };
+  AtomicSnapshot<const Rules> rules_;
   Limiter limiter_;
   double limiter_max_per_second_;
+  // Null unless adaptive sampling is configured.
+  std::unique_ptr<AdaptiveSampler> adaptive_;
+  // Null unless stratified sampling is configured.
+  std::unique_ptr<StratifiedSampler> stratified_;
+  // Identifies the current rules and collector rates.  It is drawn from a
+  // counter shared by all `TraceSampler` objects, and is replaced after either
+  // changes, so that `decide` can cache the collector rate resolved for a
+  // service and environment in thread-local storage, and know when the cached
+  // rate is stale.
+  std::atomic<std::uint64_t> generation_;
+  // The share of the traces kept at their configured rate that are kept (see
+  // `set_overhead_keep_rate`).
+  std::atomic<double> overhead_keep_rate_;
+  // Null unless the sampler shares state with other processes.
+  std::shared_ptr<SharedSamplerState> shared_state_;
+  // The version of the shared collector rates last applied (see
+  // `SharedSamplerState::rates_version`).
+  std::atomic<std::uint64_t> shared_rates_version_;
+
+  void bump_generation();
+  // Replace the collector rates with those of the specified `response`.
+  // `mutex_` must be locked.
+  void set_collector_rates(std::shared_ptr<const CollectorResponse> response);
+  // Apply the collector rates published to `shared_state_` if they changed
+  // since they were last applied, unless another thread is doing so.
+  void refresh_shared_rates();
+  // Set the priority of the specified `decision` for the root span of the
+  // trace having the specified `trace_id_low`, using the specified `rate` of a
+  // sampling rule, and the limiter unless `bypass_limiter`.
+  void apply_rule_rate(SamplingDecision& decision, Rate rate,
+                       bool bypass_limiter, std::uint64_t trace_id_low);
+  // Scale the configured rate of the specified `decision` by
+  // `overhead_keep_rate_`, and return whether the trace having the specified
+  // `trace_id_low` is kept at the scaled rate.  If the trace is kept only at
+  // the unscaled rate, then set the decision's `overhead_regulated`.
+  bool keep_at_configured_rate(SamplingDecision& decision,
+                               std::uint64_t trace_id_low);
 
  public:
   TraceSampler(const FinalizedTraceSamplerConfig& config, const Clock& clock);
 
   void set_rules(std::vector<TraceSamplerRule> rules);
 
+  // Keep only the specified `rate` share of the traces that `decide` would
+  // otherwise keep, e.g. to reduce the tracer's overhead.  The rate is one
+  // initially.
+  void set_overhead_keep_rate(Rate rate);
+  Rate overhead_keep_rate() const;
+
   // Return a sampling decision for the specified root span.
   SamplingDecision decide(const SpanData&);
 
   // Update this sampler's Agent-provided sample rates using the specified
-  // collector response.
+  // collector response.  The overload that takes a `shared_ptr` does not copy
+  // the response's sample rates.
   void handle_collector_response(const CollectorResponse&);
+  void handle_collector_response(std::shared_ptr<const CollectorResponse>);
 
   nlohmann::json config_json() const;
 };
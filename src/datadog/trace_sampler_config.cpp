@@ -243,6 +243,37 @@ Expected<FinalizedTraceSamplerConfig> finalize_config(
   }
   result.max_per_second = max_per_second;
 
+  if (const auto target = config.adaptive_target_per_second) {
+    if (!(*target > 0) || !std::isfinite(*target)) {
+      std::string message;
+      message +=
+          "Trace sampling adaptive_target_per_second must be greater than "
+          "zero, but the following value was given: ";
+      message += std::to_string(*target);
+      return Error{Error::ADAPTIVE_SAMPLING_TARGET_OUT_OF_RANGE,
+                   std::move(message)};
+    }
+    result.adaptive_target_per_second = target;
+  }
+  if (const auto target = config.stratified_target_per_second) {
+    if (!(*target > 0) || !std::isfinite(*target)) {
+      std::string message;
+      message +=
+          "Trace sampling stratified_target_per_second must be greater than "
+          "zero, but the following value was given: ";
+      message += std::to_string(*target);
+      return Error{Error::STRATIFIED_SAMPLING_TARGET_OUT_OF_RANGE,
+                   std::move(message)};
+    }
+    if (result.adaptive_target_per_second) {
+      return Error{Error::ADAPTIVE_AND_STRATIFIED_SAMPLING,
+                   "Trace sampling adaptive_target_per_second and "
+                   "stratified_target_per_second cannot both be set."};
+    }
+    result.stratified_target_per_second = target;
+  }
+  result.shared_state = config.shared_state;
+
   return result;
 }
 
@@ -11,23 +11,39 @@
 #include <datadog/telemetry/telemetry.h>
 #include <datadog/trace_segment.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <charconv>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "build_features.h"
 #include "config_manager.h"
+#include "default_id_generator.h"
 #include "endpoint_inferral.h"
 #include "hex.h"
+#include "memory_budget.h"
+#include "obfuscation.h"
 #include "platform_util.h"
+#include "resource_latencies.h"
+#include "segment_registry.h"
+#include "self_profiling.h"
+#include "shared_tags.h"
 #include "span_data.h"
 #include "span_sampler.h"
+#include "string_util.h"
 #include "tag_propagation.h"
 #include "tags.h"
+#include "tail_sampler.h"
 #include "telemetry_metrics.h"
+#include "timeline_events.h"
 #include "trace_sampler.h"
+#include "tracer_context.h"
+#include "usdt.h"
 #include "w3c_propagation.h"
 
 namespace datadog {
@@ -52,35 +68,6 @@ int Cache::process_id;
 // `cache_singleton.process_id`.
 Cache cache_singleton;
 
-// Encode the specified `trace_tags`. If the encoded value is not longer than
-// the specified `tags_header_max_size`, then set it as the "x-datadog-tags"
-// header using the specified `writer`. If the encoded value is oversized, then
-// write a diagnostic to the specified `logger` and set a propagation error tag
-// on the specified `local_root_tags`.
-void inject_trace_tags(
-    DictWriter& writer,
-    const std::vector<std::pair<std::string, std::string>>& trace_tags,
-    std::size_t tags_header_max_size,
-    std::unordered_map<std::string, std::string>& local_root_tags,
-    Logger& logger) {
-  const std::string encoded_trace_tags = encode_tags(trace_tags);
-
-  if (encoded_trace_tags.size() > tags_header_max_size) {
-    std::string message;
-    message +=
-        "Serialized x-datadog-tags header value is too large.  The configured "
-        "maximum size is ";
-    message += std::to_string(tags_header_max_size);
-    message += " bytes, but the encoded value is ";
-    message += std::to_string(encoded_trace_tags.size());
-    message += " bytes.";
-    logger.log_error(message);
-    local_root_tags[tags::internal::propagation_error] = "inject_max_size";
-  } else if (!encoded_trace_tags.empty()) {
-    writer.set("x-datadog-tags", encoded_trace_tags);
-  }
-}
-
 void maybe_calculate_http_endpoint(HttpEndpointCalculationMode renaming_mode,
                                    SpanData& local_root) {
   // calculate http.endpoint if:
@@ -99,162 +86,541 @@ void maybe_calculate_http_endpoint(HttpEndpointCalculationMode renaming_mode,
        local_root.tags.find(tags::http_route) == local_root.tags.end());
 
   if (should_calculate_endpoint) {
-    Expected<HTTPClient::URL> url_result =
-        HTTPClient::URL::parse(http_url_tag->second);
-    if (url_result.has_value()) {
-      const std::string& path = url_result->path;
+    if (const auto url = HTTPClient::URLView::split(http_url_tag->second)) {
+      // Distinct paths are typically few compared with requests, so the
+      // inferred endpoints are cached.
+      static EndpointCache endpoints{EndpointCache::max_shards, 256};
       local_root.tags[tags::http_endpoint] =
-          infer_endpoint(path.empty() ? "/" : path);
+          endpoints.infer(url->path.empty() ? "/" : url->path);
+    }
+  }
+}
+
+// Return the telemetry counter that is incremented when the specified `style`
+// is injected, or return null if the style injects nothing.
+const telemetry::counter::Handle* injected_counter(PropagationStyle style) {
+  const auto& injected = metrics::tracer::trace_context::injected;
+  static const auto datadog =
+      telemetry::counter::handle(injected, {"header_style:datadog"});
+  static const auto b3 =
+      telemetry::counter::handle(injected, {"header_style:b3multi"});
+  static const auto w3c =
+      telemetry::counter::handle(injected, {"header_style:tracecontext"});
+  switch (style) {
+    case PropagationStyle::DATADOG:
+      return &datadog;
+    case PropagationStyle::B3:
+      return &b3;
+    case PropagationStyle::W3C:
+      return &w3c;
+    default:
+      return nullptr;
+  }
+}
+
+// Return the value of the `_dd.p.dm` trace tag for the specified sampling
+// `mechanism`, e.g. "-3".  The values of the mechanisms that this library
+// defines are formatted once, rather than for every trace.
+std::string decision_maker_value(int mechanism) {
+  static const auto values = []() {
+    std::array<std::string,
+               int(SamplingMechanism::REMOTE_ADAPTIVE_RULE) + 1>
+        result;
+    for (std::size_t i = 0; i < result.size(); ++i) {
+      result[i] = "-" + std::to_string(i);
     }
+    return result;
+  }();
+  if (mechanism >= 0 && std::size_t(mechanism) < values.size()) {
+    return values[mechanism];
+  }
+  return "-" + std::to_string(mechanism);
+}
+
+// Return the value of the `_dd.p.ksr` trace tag for the specified sample
+// `rate`, formatted as by `std::to_string`.  A tracer samples by only a few
+// configured rates, so each thread remembers the rate that it formatted last
+// rather than formatting it for every trace.
+const std::string& sample_rate_value(double rate) {
+  thread_local double last_rate = -1;
+  thread_local std::string last_value;
+  if (rate != last_rate) {
+    last_rate = rate;
+    last_value = std::to_string(rate);
   }
+  return last_value;
 }
+
 }  // namespace
 
 TraceSegment::TraceSegment(
-    const std::shared_ptr<Logger>& logger,
-    const std::shared_ptr<Collector>& collector,
-    const std::shared_ptr<TraceSampler>& trace_sampler,
-    const std::shared_ptr<SpanSampler>& span_sampler,
-    const std::shared_ptr<const SpanDefaults>& defaults,
-    const std::shared_ptr<ConfigManager>& config_manager,
-    const RuntimeID& runtime_id,
-    const std::vector<PropagationStyle>& injection_styles,
-    const Optional<std::string>& hostname, Optional<std::string> origin,
-    std::size_t tags_header_max_size,
+    std::shared_ptr<const TracerContext> context, Optional<std::string> origin,
     std::vector<std::pair<std::string, std::string>> trace_tags,
     Optional<SamplingDecision> sampling_decision,
     Optional<std::string> additional_w3c_tracestate,
     Optional<std::string> additional_datadog_w3c_tracestate,
-    std::unique_ptr<SpanData> local_root,
-    HttpEndpointCalculationMode resource_renaming_mode,
-    bool apm_tracing_enabled)
-    : logger_(logger),
-      collector_(collector),
-      trace_sampler_(trace_sampler),
-      span_sampler_(span_sampler),
-      defaults_(defaults),
-      runtime_id_(runtime_id),
-      injection_styles_(injection_styles),
-      hostname_(hostname),
+    std::unique_ptr<SpanData> local_root)
+    : context_(std::move(context)),
       origin_(std::move(origin)),
-      tags_header_max_size_(tags_header_max_size),
       trace_tags_(std::move(trace_tags)),
-      num_finished_spans_(0),
+      num_unfinished_spans_(0),
       sampling_decision_(std::move(sampling_decision)),
       additional_w3c_tracestate_(std::move(additional_w3c_tracestate)),
       additional_datadog_w3c_tracestate_(
           std::move(additional_datadog_w3c_tracestate)),
-      config_manager_(config_manager),
-      resource_renaming_mode_(resource_renaming_mode),
-      tracing_enabled_(apm_tracing_enabled) {
-  assert(logger_);
-  assert(collector_);
-  assert(trace_sampler_);
-  assert(span_sampler_);
-  assert(defaults_);
-  assert(config_manager_);
+      skips_new_spans_(false),
+      truncation_(NOT_TRUNCATED),
+      finished_bytes_(0),
+      charged_bytes_(0),
+      orphaned_(false),
+      trace_context_version_(0) {
+  assert(context_);
+  assert(context_->logger);
+  assert(context_->collector);
+  assert(context_->trace_sampler);
+  assert(context_->span_sampler);
+  assert(context_->defaults);
+  assert(context_->config_manager);
+  assert(context_->id_generator);
 
+  if (context_->live_segments) {
+    context_->live_segments->fetch_add(1, std::memory_order_relaxed);
+  }
+  if (context_->segment_registry) {
+    context_->segment_registry->add(*this);
+  }
   register_span(std::move(local_root));
+  if (context_->memory_budget && context_->memory_budget->pressure() >=
+                                     MemoryBudget::Pressure::TRUNCATE) {
+    truncate(TOO_MUCH_MEMORY);
+  }
+  if (context_->early_sampling_decision) {
+    // Nobody else can refer to this segment yet, so there is no need to lock.
+    make_sampling_decision_if_null();
+    update_skips_new_spans();
+  }
+}
+
+TraceSegment::~TraceSegment() {
+  if (context_->memory_budget) {
+    context_->memory_budget->release(charged_bytes_.load());
+  }
+  if (context_->segment_registry) {
+    context_->segment_registry->remove(*this);
+  }
+  if (context_->live_segments) {
+    context_->live_segments->fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+const SpanDefaults& TraceSegment::defaults() const {
+  return *context_->defaults;
+}
+
+const SpanLimits& TraceSegment::span_limits() const {
+  return context_->span_limits;
+}
+
+const HeaderTags* TraceSegment::header_tags() const {
+  return context_->header_tags.get();
 }
 
-const SpanDefaults& TraceSegment::defaults() const { return *defaults_; }
+const Clock& TraceSegment::clock() const { return context_->clock; }
 
 const Optional<std::string>& TraceSegment::hostname() const {
-  return hostname_;
+  return context_->hostname;
 }
 
 const Optional<std::string>& TraceSegment::origin() const { return origin_; }
 
 Optional<SamplingDecision> TraceSegment::sampling_decision() const {
   // `sampling_decision_` can change, so we need a lock.
-  std::lock_guard<std::mutex> lock(mutex_);
+  DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
   return sampling_decision_;
 }
 
-Logger& TraceSegment::logger() const { return *logger_; }
+Logger& TraceSegment::logger() const { return *context_->logger; }
+
+std::uint64_t TraceSegment::generate_span_id() const {
+  if (context_->default_id_generator) {
+    return context_->default_id_generator->span_id();
+  }
+  return context_->id_generator->span_id();
+}
+
+void TraceSegment::generate_span_ids(std::uint64_t* ids,
+                                     std::size_t count) const {
+  if (const DefaultIDGenerator* generator = context_->default_id_generator) {
+    for (std::size_t i = 0; i < count; ++i) {
+      ids[i] = generator->span_id();
+    }
+    return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    ids[i] = context_->id_generator->span_id();
+  }
+}
+
+std::size_t TraceSegment::register_span(std::unique_ptr<SpanData> span) {
+  static const auto spans_created = telemetry::counter::handle(
+      metrics::tracer::spans_created, {"integration_name:datadog"});
+  spans_created.increment();
+
+  // A span is registered either by the constructor or by an unfinished span
+  // creating a child, so the segment cannot complete concurrently.
+  assert(spans_.empty() ||
+         num_unfinished_spans_.load(std::memory_order_relaxed) > 0);
+  num_unfinished_spans_.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t index = spans_.push_back(std::move(span));
+  if (context_->max_spans_per_segment &&
+      index + 1 >= context_->max_spans_per_segment) {
+    truncate(TOO_MANY_SPANS);
+  }
+  return index;
+}
+
+std::size_t TraceSegment::register_spans(std::unique_ptr<SpanData>* spans,
+                                         std::size_t count) {
+  static const auto spans_created = telemetry::counter::handle(
+      metrics::tracer::spans_created, {"integration_name:datadog"});
+  spans_created.add(count);
+
+  // See `register_span`.
+  assert(num_unfinished_spans_.load(std::memory_order_relaxed) > 0);
+  num_unfinished_spans_.fetch_add(count, std::memory_order_relaxed);
+  const std::size_t first = spans_.push_back(spans, count);
+  if (context_->max_spans_per_segment &&
+      first + count >= context_->max_spans_per_segment) {
+    truncate(TOO_MANY_SPANS);
+  }
+  return first;
+}
+
+void TraceSegment::truncate(Truncation reason) {
+  Truncation expected = NOT_TRUNCATED;
+  if (!truncation_.compare_exchange_strong(expected, reason,
+                                           std::memory_order_relaxed)) {
+    return;
+  }
+  const char* tag = "reason:bytes";
+  if (reason == TOO_MANY_SPANS) {
+    tag = "reason:spans";
+  } else if (reason == TOO_MUCH_MEMORY) {
+    tag = "reason:memory";
+  }
+  telemetry::counter::increment(metrics::tracer::trace_segments_truncated,
+                                {tag});
+}
 
-void TraceSegment::register_span(std::unique_ptr<SpanData> span) {
-  telemetry::counter::increment(metrics::tracer::spans_created,
-                                {"integration_name:datadog"});
+void TraceSegment::release_charged(std::size_t bytes) {
+  std::size_t charged = charged_bytes_.load(std::memory_order_relaxed);
+  std::size_t released;
+  do {
+    released = std::min(bytes, charged);
+  } while (!charged_bytes_.compare_exchange_weak(
+      charged, charged - released, std::memory_order_relaxed));
+  context_->memory_budget->release(released);
+}
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  assert(spans_.empty() || num_finished_spans_ < spans_.size());
-  spans_.emplace_back(std::move(span));
+bool TraceSegment::counts_finished_bytes() const {
+  return context_->max_bytes_per_segment || context_->memory_budget;
 }
 
-void TraceSegment::span_finished() {
+void TraceSegment::count_finished_bytes(std::size_t bytes) {
+  if (context_->max_bytes_per_segment &&
+      finished_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes >=
+          context_->max_bytes_per_segment) {
+    truncate(TOO_MANY_BYTES);
+  }
+  if (const auto& budget = context_->memory_budget) {
+    charged_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    budget->charge(bytes);
+    if (budget->pressure() >= MemoryBudget::Pressure::TRUNCATE) {
+      truncate(TOO_MUCH_MEMORY);
+    }
+  }
+}
+
+void TraceSegment::finish_imported(
+    std::vector<std::unique_ptr<SpanData>>&& spans) {
+  static const auto spans_created = telemetry::counter::handle(
+      metrics::tracer::spans_created, {"integration_name:datadog"});
+  static const auto spans_finished = telemetry::counter::handle(
+      metrics::tracer::spans_finished, {"integration_name:datadog"});
+
+  // As for `register_span`, the span that reaches the limit is kept, and
+  // those after it are not.
+  const std::size_t max_spans = context_->max_spans_per_segment;
+  if (max_spans && spans.size() + 1 >= max_spans) {
+    spans.resize(max_spans - 1);
+    truncate(TOO_MANY_SPANS);
+  }
+  spans_created.add(spans.size());
+  spans_finished.add(spans.size());
+
+  std::size_t bytes = 0;
+  const bool count_bytes = counts_finished_bytes();
+  for (auto& span : spans) {
+    span->finished = true;
+    if (count_bytes) {
+      bytes += estimated_encoded_size(*span);
+    }
+    spans_.push_back(std::move(span));
+  }
+  if (count_bytes) {
+    count_finished_bytes(bytes);
+  }
+  // The spans are finished already, so the segment is complete once the
+  // local root is.
+  span_finished(0);
+}
+
+void TraceSegment::span_finished(std::size_t index) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::span_finished);
+  static const auto spans_finished = telemetry::counter::handle(
+      metrics::tracer::spans_finished, {"integration_name:datadog"});
+  spans_finished.increment();
+  if (orphaned_.load(std::memory_order_acquire)) {
+    // The segment was already sent (see `flush_orphaned`).
+    num_unfinished_spans_.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  SpanData& span = *spans_[index];
+  // Once the span is marked finished and its write guard is released,
+  // `flush_orphaned` might take the span, so it is read before then.
+  const bool guarded = flushes_orphans();
+  if (guarded && !span.write_guard.begin_write()) {
+    // The segment was flushed meanwhile.
+    num_unfinished_spans_.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  span.finished = true;
+  if (index == 0 && context_->resource_latencies) {
+    context_->resource_latencies->add(span.service, span.resource,
+                                      span.duration);
+  }
+  const bool rolls_up =
+      index != 0 && !context_->span_rollups.empty() && matches_rollup(span);
+  const std::size_t bytes =
+      counts_finished_bytes() ? estimated_encoded_size(span) : 0;
+  if (guarded) {
+    span.write_guard.end_write();
+  }
+
+  RollupResult rollup = NOT_ROLLED_UP;
+  if (rolls_up) {
+    rollup = roll_up(index);
+  }
+  if (rollup != FOLDED && counts_finished_bytes()) {
+    count_finished_bytes(bytes);
+  }
+  // The release half makes this thread's writes to its spans visible to the
+  // thread that completes the segment, and the acquire half makes every other
+  // thread's writes visible to this one, if it is that thread.
+  const std::size_t previously_unfinished =
+      num_unfinished_spans_.fetch_sub(1, std::memory_order_acq_rel);
+  assert(previously_unfinished > 0);
+  if (previously_unfinished > 1) {
+    // The local root is always sent with the final chunk, as are summary
+    // spans, which might yet be counted into.
+    if (context_->partial_flush_min_spans && index != 0 &&
+        rollup == NOT_ROLLED_UP) {
+      partial_flush(index);
+    }
+    return;
+  }
+
+  finish();
+}
+
+bool TraceSegment::matches_rollup(const SpanData& span) const {
+  const auto& rollups = context_->span_rollups;
+  return std::any_of(rollups.begin(), rollups.end(), [&](const SpanRollup& r) {
+    return span.name == r.name &&
+           (r.resource.empty() || span.resource == r.resource);
+  });
+}
+
+TraceSegment::RollupResult TraceSegment::roll_up(std::size_t index) {
+  // The discarded span is destroyed after `mutex_` is unlocked.
+  std::unique_ptr<SpanData> folded;
+  DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+  if (!spans_[index]) {
+    // `flush_orphaned` sent the span.
+    return FOLDED;
+  }
+  const SpanData& span = *spans_[index];
+  const auto end = span.start.tick + span.duration;
+  for (Rollup& rollup : rollups_) {
+    // The summary is null if it was sent by `flush_orphaned`.
+    const SpanData* summary = spans_[rollup.index].get();
+    if (summary == nullptr || summary->parent_id != span.parent_id ||
+        summary->name != span.name || summary->resource != span.resource) {
+      continue;
+    }
+    if (span.has_children) {
+      // Discarding the span would leave its children without a parent, so
+      // it is sent as is.
+      return NOT_ROLLED_UP;
+    }
+    ++rollup.count;
+    rollup.errors += span.error;
+    rollup.total += span.duration;
+    rollup.min = std::min(rollup.min, span.duration);
+    rollup.max = std::max(rollup.max, span.duration);
+    if (span.start.tick < rollup.start.tick) {
+      rollup.start = span.start;
+    }
+    rollup.end = std::max(rollup.end, end);
+    folded = std::move(spans_[index]);
+    return FOLDED;
+  }
+
+  rollups_.push_back(Rollup{index, 1, span.error, span.duration,
+                            span.duration, span.duration, span.start, end});
+  return SUMMARY;
+}
+
+void TraceSegment::apply_rollups() {
+  for (const Rollup& rollup : rollups_) {
+    SpanData* summary = spans_[rollup.index].get();
+    if (summary == nullptr) {
+      continue;
+    }
+    summary->start = rollup.start;
+    summary->duration = rollup.end - rollup.start.tick;
+    summary->error = rollup.errors != 0;
+    const auto nanoseconds = [](Duration duration) {
+      return double(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+              .count());
+    };
+    auto& numeric_tags = summary->numeric_tags;
+    numeric_tags[tags::internal::rollup_count] = double(rollup.count);
+    numeric_tags[tags::internal::rollup_errors] = double(rollup.errors);
+    numeric_tags[tags::internal::rollup_duration_total] =
+        nanoseconds(rollup.total);
+    numeric_tags[tags::internal::rollup_duration_min] =
+        nanoseconds(rollup.min);
+    numeric_tags[tags::internal::rollup_duration_max] =
+        nanoseconds(rollup.max);
+  }
+  rollups_.clear();
+}
+
+void TraceSegment::register_unrecorded_span(std::size_t count) {
+  // See `register_span`.
+  assert(num_unfinished_spans_.load(std::memory_order_relaxed) > 0);
+  num_unfinished_spans_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void TraceSegment::unrecorded_span_finished() {
+  // See `span_finished`.
+  const std::size_t previously_unfinished =
+      num_unfinished_spans_.fetch_sub(1, std::memory_order_acq_rel);
+  assert(previously_unfinished > 0);
+  if (previously_unfinished == 1 &&
+      !orphaned_.load(std::memory_order_acquire)) {
+    finish();
+  }
+}
+
+void TraceSegment::finish() {
+  static const auto chunks_enqueued =
+      telemetry::counter::handle(metrics::tracer::trace_chunks_enqueued, {});
+  chunks_enqueued.increment();
+
+  std::vector<std::unique_ptr<SpanData>> spans;
+  // Whether the tail sampler decides the trace, which it does if the trace
+  // began in this segment and its sampling decision was not needed until
+  // now, so that the trace was neither propagated nor partially flushed.
+  bool tail_sampled;
   {
-    telemetry::counter::increment(metrics::tracer::spans_finished,
-                                  {"integration_name:datadog"});
-    std::lock_guard<std::mutex> lock(mutex_);
-    ++num_finished_spans_;
-    assert(num_finished_spans_ <= spans_.size());
-    if (num_finished_spans_ < spans_.size()) {
+    // There's nobody left to call our methods, except for a concurrent
+    // `partial_flush` that might still be moving spans out of `spans_`.
+    DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+    if (orphaned_.load(std::memory_order_relaxed)) {
+      // `flush_orphaned` sent the spans while the last of them finished.
       return;
     }
+    if (!context_->config_manager->report_traces()) {
+      // The spans would not be sent, so they need not be sampled or
+      // finalized.
+      spans = spans_.take();
+      partially_flushable_.clear();
+      return;
+    }
+    tail_sampled = context_->tail_sampler && !sampling_decision_ &&
+                   !origin_ && spans_[0]->parent_id == 0;
+    if (!tail_sampled) {
+      make_sampling_decision_if_null();
+      assert(sampling_decision_);
+    }
+    apply_rollups();
+    spans = spans_.take();
+    partially_flushable_.clear();
+  }
+  if (context_->partial_flush_min_spans || !context_->span_rollups.empty()) {
+    // Spans that were already sent in a partial chunk, or that were rolled
+    // up, left null behind.
+    spans.erase(std::remove(spans.begin(), spans.end(), nullptr), spans.end());
   }
 
-  telemetry::counter::increment(metrics::tracer::trace_chunks_enqueued);
+  DD_USDT_PROBE(segment__finish,
+                spans.empty() ? 0 : spans.front()->trace_id.low,
+                spans.size());
+  finalize_and_send(std::move(spans), tail_sampled);
+}
 
-  // We don't need the lock anymore.  There's nobody left to call our methods.
-  // On the other hand, there's nobody left to contend for the mutex, so it
-  // doesn't make any difference.
-  make_sampling_decision_if_null();
-  assert(sampling_decision_);
+void TraceSegment::finalize_and_send(
+    std::vector<std::unique_ptr<SpanData>>&& spans, bool tail_sampled) {
+  if (context_->memory_budget) {
+    // The spans are counted by whatever receives them instead.
+    context_->memory_budget->release(charged_bytes_.exchange(0));
+  }
 
   // All of our spans are finished. Run the span sampler, finalize the spans,
   // and then send the spans to the collector.
-  if (sampling_decision_->priority <= 0) {
+  if (!tail_sampled && sampling_decision_->priority <= 0) {
     telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
                                   {"reason:p0_drop"});
-    // Span sampling happens when the trace is dropped.
-    for (const auto& span_ptr : spans_) {
-      SpanData& span = *span_ptr;
-      auto* rule = span_sampler_->match(span);
-      if (!rule) {
-        continue;
-      }
-      const SamplingDecision decision = rule->decide(span);
-      if (decision.priority <= 0) {
-        telemetry::counter::increment(metrics::tracer::spans_dropped,
-                                      {"reason:p0_drop"});
-        continue;
-      }
-
-      span.numeric_tags[tags::internal::span_sampling_mechanism] =
-          *decision.mechanism;
-      span.numeric_tags[tags::internal::span_sampling_rule_rate] =
-          *decision.configured_rate;
-      if (decision.limiter_max_per_second) {
-        span.numeric_tags[tags::internal::span_sampling_limit] =
-            *decision.limiter_max_per_second;
-      }
-    }
+    context_->span_sampler->sample_spans_of_dropped_trace(spans);
   }
 
-  const SamplingDecision& decision = *sampling_decision_;
-
-  auto& local_root = *spans_.front();
+  auto& local_root = *spans.front();
   local_root.tags.insert(trace_tags_.begin(), trace_tags_.end());
-  local_root.numeric_tags[tags::internal::sampling_priority] =
-      decision.priority;
-  if (hostname_) {
-    local_root.tags[tags::internal::hostname] = *hostname_;
-  }
-  if (decision.origin == SamplingDecision::Origin::LOCAL) {
-    if (decision.mechanism == int(SamplingMechanism::AGENT_RATE) ||
-        decision.mechanism == int(SamplingMechanism::DEFAULT)) {
-      local_root.numeric_tags[tags::internal::agent_sample_rate] =
-          *decision.configured_rate;
-    } else if (decision.mechanism == int(SamplingMechanism::RULE) ||
-               decision.mechanism == int(SamplingMechanism::REMOTE_RULE) ||
-               decision.mechanism ==
-                   int(SamplingMechanism::REMOTE_ADAPTIVE_RULE)) {
-      local_root.numeric_tags[tags::internal::rule_sample_rate] =
-          *decision.configured_rate;
-      if (decision.limiter_effective_rate) {
-        local_root.numeric_tags[tags::internal::rule_limiter_sample_rate] =
-            *decision.limiter_effective_rate;
+  if (context_->hostname) {
+    local_root.tags[tags::internal::hostname] = *context_->hostname;
+  }
+  if (!tail_sampled) {
+    const SamplingDecision& decision = *sampling_decision_;
+    local_root.numeric_tags[tags::internal::sampling_priority] =
+        decision.priority;
+    if (decision.overhead_regulated) {
+      local_root.tags[tags::internal::overhead_dropped] = "1";
+    }
+    if (decision.stratum) {
+      local_root.tags[tags::internal::sampling_stratum] =
+          hex_padded(*decision.stratum);
+    }
+    if (decision.origin == SamplingDecision::Origin::LOCAL) {
+      if (decision.mechanism == int(SamplingMechanism::AGENT_RATE) ||
+          decision.mechanism == int(SamplingMechanism::DEFAULT)) {
+        local_root.numeric_tags[tags::internal::agent_sample_rate] =
+            *decision.configured_rate;
+      } else if (decision.mechanism == int(SamplingMechanism::RULE) ||
+                 decision.mechanism == int(SamplingMechanism::REMOTE_RULE) ||
+                 decision.mechanism ==
+                     int(SamplingMechanism::REMOTE_ADAPTIVE_RULE)) {
+        local_root.numeric_tags[tags::internal::rule_sample_rate] =
+            *decision.configured_rate;
+        if (decision.limiter_effective_rate) {
+          local_root.numeric_tags[tags::internal::rule_limiter_sample_rate] =
+              *decision.limiter_effective_rate;
+        }
       }
     }
   }
@@ -262,36 +628,251 @@ void TraceSegment::span_finished() {
   // RFC seems to only mandate that this be set if the trace is kept.
   // However, system-tests expect this to always be set.
   // Add it all the time; can't hurt
-  if (!tracing_enabled_) {
+  if (!context_->tracing_enabled) {
     local_root.numeric_tags[tags::internal::apm_enabled] = 0;
   }
+  switch (truncation_.load(std::memory_order_relaxed)) {
+    case TOO_MANY_SPANS:
+      local_root.tags[tags::internal::trace_truncated] = "spans";
+      break;
+    case TOO_MANY_BYTES:
+      local_root.tags[tags::internal::trace_truncated] = "bytes";
+      break;
+    case TOO_MUCH_MEMORY:
+      local_root.tags[tags::internal::trace_truncated] = "memory";
+      break;
+    case NOT_TRUNCATED:
+      break;
+  }
 
-  // Some tags are repeated on all spans.
-  for (const auto& span_ptr : spans_) {
-    SpanData& span = *span_ptr;
-    if (origin_) {
-      span.tags[tags::internal::origin] = *origin_;
+  apply_shared_tags(spans, shared_tags());
+
+  maybe_calculate_http_endpoint(context_->resource_renaming_mode, local_root);
+  if (context_->obfuscation_enabled) {
+    obfuscate_spans(spans);
+  }
+
+  if (!tail_sampled) {
+    send(std::move(spans), sampling_decision_->priority);
+  } else if (context_->config_manager->report_traces()) {
+    context_->tail_sampler->add(std::move(spans), context_->hostname,
+                                context_->trace_sampler);
+  }
+
+  static const auto segments_closed =
+      telemetry::counter::handle(metrics::tracer::trace_segments_closed, {});
+  segments_closed.increment();
+}
+
+void TraceSegment::partial_flush(std::size_t index) {
+  std::vector<std::unique_ptr<SpanData>> chunk;
+  int priority;
+  {
+    DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+    // If the segment completed concurrently, then the span was already sent.
+    if (!spans_[index]) {
+      return;
+    }
+    partially_flushable_.push_back(index);
+    if (partially_flushable_.size() < context_->partial_flush_min_spans) {
+      return;
+    }
+
+    // The decision applies to the rest of the trace, too, so it can't change
+    // afterward.
+    make_sampling_decision_if_null();
+    assert(sampling_decision_);
+    priority = sampling_decision_->priority;
+
+    chunk.reserve(partially_flushable_.size());
+    for (const std::size_t finished : partially_flushable_) {
+      chunk.push_back(std::move(spans_[finished]));
     }
-    span.numeric_tags[tags::internal::process_id] = Cache::process_id;
-    span.tags[tags::internal::language] = "cpp";
-    span.tags[tags::internal::runtime_id] = runtime_id_.string();
+    partially_flushable_.clear();
+  }
+
+  if (context_->memory_budget) {
+    std::size_t bytes = 0;
+    for (const auto& span : chunk) {
+      bytes += estimated_encoded_size(*span);
+    }
+    release_charged(bytes);
+  }
+
+  static const auto chunks_enqueued =
+      telemetry::counter::handle(metrics::tracer::trace_chunks_enqueued, {});
+  chunks_enqueued.increment();
+  if (priority <= 0) {
+    telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                  {"reason:p0_drop"});
+    context_->span_sampler->sample_spans_of_dropped_trace(chunk);
+  }
+
+  // The Datadog Agent reads the sampling priority of a chunk from its first
+  // span.  The origin is among the shared tags.
+  chunk.front()->numeric_tags[tags::internal::sampling_priority] = priority;
+  apply_shared_tags(chunk, shared_tags());
+  if (context_->obfuscation_enabled) {
+    obfuscate_spans(chunk);
   }
 
-  maybe_calculate_http_endpoint(resource_renaming_mode_, local_root);
+  send(std::move(chunk), priority);
+}
 
-  if (config_manager_->report_traces()) {
-    telemetry::distribution::add(metrics::tracer::trace_chunk_size,
-                                 spans_.size());
+Optional<std::size_t> TraceSegment::flush_orphaned() {
+  std::vector<std::unique_ptr<SpanData>> spans;
+  std::size_t bytes = 0;
+  {
+    DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+    if (num_unfinished_spans_.load(std::memory_order_acquire) == 0 ||
+        orphaned_.load(std::memory_order_relaxed)) {
+      return nullopt;
+    }
+    orphaned_.store(true, std::memory_order_release);
+    skips_new_spans_.store(true, std::memory_order_relaxed);
+    // A `Span` that is still in use writes to its span no more, so that the
+    // span can be read below.  Writers never lock `mutex_`, so they don't
+    // keep this from returning.  Spans are registered without `mutex_`, too,
+    // and those whose registration is still in progress are treated as
+    // registered from now on, which are not sent.
+    std::vector<std::pair<std::size_t, std::unique_ptr<SpanData>*>> slots;
+    const std::size_t size = spans_.size();
+    slots.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      if (auto* const slot = spans_.find_appended(i)) {
+        slots.emplace_back(i, slot);
+        if (const auto& span = *slot) {
+          span->write_guard.detach();
+        }
+      }
+    }
+    make_sampling_decision_if_null();
+    assert(sampling_decision_);
+    apply_rollups();
+
+    const auto now = context_->clock().tick;
+    spans.reserve(slots.size());
+    for (const auto& [i, slot] : slots) {
+      auto& span = *slot;
+      if (!span) {
+        // The span was already sent in a partial chunk, or was rolled up.
+        continue;
+      }
+      if (span->finished && i != 0) {
+        spans.push_back(std::move(span));
+      } else {
+        // The span's data stays where its `Span`, or `local_root`, can still
+        // refer to it, and a copy is sent instead.  The `Span` might still
+        // read the original.
+        const bool finished = span->finished;
+        auto sent = SpanData::make(nullptr);
+        *sent = *span;
+        if (!finished) {
+          sent->tags[tags::internal::span_orphaned] = "1";
+          if (sent->duration == Duration::zero()) {
+            sent->duration = now - sent->start.tick;
+          }
+        }
+        spans.push_back(std::move(sent));
+      }
+      bytes += estimated_encoded_size(*spans.back());
+    }
+    partially_flushable_.clear();
+  }
+
+  static const auto chunks_enqueued =
+      telemetry::counter::handle(metrics::tracer::trace_chunks_enqueued, {});
+  chunks_enqueued.increment();
+  static const auto segments_orphaned =
+      telemetry::counter::handle(metrics::tracer::trace_segments_orphaned, {});
+  segments_orphaned.increment();
+  finalize_and_send(std::move(spans), false);
+  return bytes;
+}
+
+std::shared_ptr<const SharedTags> TraceSegment::shared_tags() const {
+  // Some tags are repeated on all spans.  They are stored and encoded once,
+  // and shared by all of the spans.
+  if (!origin_ && context_->shared_tags &&
+      context_->shared_tags_process_id == Cache::process_id) {
+    return context_->shared_tags;
+  }
+  if (origin_ && context_->origin_tags) {
+    return context_->origin_tags->get(*origin_, Cache::process_id);
+  }
+  return make_segment_tags(origin_, context_->runtime_id, Cache::process_id);
+}
+
+void TraceSegment::apply_shared_tags(
+    const std::vector<std::unique_ptr<SpanData>>& spans,
+    const std::shared_ptr<const SharedTags>& shared_tags) {
+  if (!context_->collector->accepts_shared_tags()) {
+    for (const auto& span_ptr : spans) {
+      SpanData& span = *span_ptr;
+      for (const auto& entry : shared_tags->tags()) {
+        span.tags[entry.first] = entry.second;
+      }
+      for (const auto& entry : shared_tags->numeric_tags()) {
+        span.numeric_tags[entry.first] = entry.second;
+      }
+    }
+    return;
+  }
+
+  for (const auto& span_ptr : spans) {
+    SpanData& span = *span_ptr;
+    // The shared tags replace any span-specific tags having the same names.
+    for (const auto& entry : shared_tags->tags()) {
+      span.tags.erase(entry.first);
+    }
+    for (const auto& entry : shared_tags->numeric_tags()) {
+      span.numeric_tags.erase(entry.first);
+    }
+    span.shared_tags = shared_tags;
+  }
+}
 
-    telemetry::counter::increment(metrics::tracer::trace_chunks_sent);
-    const auto result = collector_->send(std::move(spans_), trace_sampler_);
-    if (auto* error = result.if_error()) {
-      logger_->log_error(
-          error->with_prefix("Error sending spans to collector: "));
+void TraceSegment::send(std::vector<std::unique_ptr<SpanData>>&& spans,
+                        int priority) {
+  if (!context_->config_manager->report_traces()) {
+    return;
+  }
+  if (const auto& budget = context_->memory_budget) {
+    const auto pressure = budget->pressure();
+    if (pressure == MemoryBudget::Pressure::DROP ||
+        (pressure >= MemoryBudget::Pressure::SHED_SAMPLED_OUT &&
+         priority <= 0)) {
+      telemetry::counter::increment(metrics::tracer::trace_chunks_dropped,
+                                    {"reason:memory_budget"});
+      return;
     }
   }
 
-  telemetry::counter::increment(metrics::tracer::trace_segments_closed);
+  telemetry::distribution::add(metrics::tracer::trace_chunk_size,
+                               spans.size());
+
+  static const auto chunks_sent =
+      telemetry::counter::handle(metrics::tracer::trace_chunks_sent, {});
+  chunks_sent.increment();
+  TraceChunk chunk;
+  // The chunk finished when the last of its spans did, which is known without
+  // reading the clock again.
+  for (const auto& span : spans) {
+    chunk.finished =
+        std::max(chunk.finished, span->start.tick + span->duration);
+  }
+  chunk.spans = std::move(spans);
+  chunk.sampling_priority = priority;
+  chunk.origin = origin_;
+  chunk.hostname = context_->hostname;
+  const auto result = context_->collector->send_chunk(std::move(chunk),
+                                                      context_->trace_sampler);
+  if (auto* error = result.if_error()) {
+    context_->logger->log_error(
+        error->with_prefix("Error sending spans to collector: "));
+  }
 }
 
 void TraceSegment::override_sampling_priority(SamplingPriority priority) {
@@ -304,9 +885,12 @@ void TraceSegment::override_sampling_priority(int priority) {
   decision.mechanism = int(SamplingMechanism::MANUAL);
   decision.origin = SamplingDecision::Origin::LOCAL;
 
-  std::lock_guard<std::mutex> lock(mutex_);
+  DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
   sampling_decision_ = decision;
+  ++trace_context_version_;
   update_decision_maker_trace_tag();
+  update_skips_new_spans();
 }
 
 void TraceSegment::make_sampling_decision_if_null() {
@@ -316,14 +900,17 @@ void TraceSegment::make_sampling_decision_if_null() {
     return;
   }
 
-  const SpanData& local_root = *spans_.front();
-  sampling_decision_ = trace_sampler_->decide(local_root);
+  const SpanData& local_root = *spans_[0];
+  sampling_decision_ = context_->trace_sampler->decide(local_root);
+  DD_USDT_PROBE(sampling__decided, local_root.trace_id.low,
+                sampling_decision_->priority,
+                sampling_decision_->mechanism.value_or(-1));
 
   update_decision_maker_trace_tag();
 
   trace_tags_.emplace_back(
       tags::internal::ksr,
-      std::to_string(*sampling_decision_->configured_rate));
+      sample_rate_value(*sampling_decision_->configured_rate));
 }
 
 void TraceSegment::update_decision_maker_trace_tag() {
@@ -331,6 +918,10 @@ void TraceSegment::update_decision_maker_trace_tag() {
 
   assert(sampling_decision_);
 
+  // This is called whenever the sampling decision changes, including right
+  // before `make_sampling_decision_if_null` adds `tags::internal::ksr`.
+  ++trace_context_version_;
+
   // Note that `found` might be erased below (in case you refactor this code).
   const auto found = std::find_if(
       trace_tags_.begin(), trace_tags_.end(), [](const auto& entry) {
@@ -345,7 +936,7 @@ void TraceSegment::update_decision_maker_trace_tag() {
   }
 
   // Note that `value` is moved-from below (in case you refactor this code).
-  auto value = "-" + std::to_string(*sampling_decision_->mechanism);
+  auto value = decision_maker_value(*sampling_decision_->mechanism);
   if (found == trace_tags_.end()) {
     trace_tags_.emplace_back(tags::internal::decision_maker, std::move(value));
   } else {
@@ -353,118 +944,258 @@ void TraceSegment::update_decision_maker_trace_tag() {
   }
 }
 
+void TraceSegment::update_skips_new_spans() {
+  // Depending on the context, `mutex_` might need already to be locked.
+
+  assert(sampling_decision_);
+  skips_new_spans_.store(context_->early_sampling_decision &&
+                             sampling_decision_->priority <= 0 &&
+                             context_->span_sampler->empty(),
+                         std::memory_order_relaxed);
+}
+
+bool TraceSegment::skips_new_spans() const {
+  return skips_new_spans_.load(std::memory_order_relaxed) ||
+         truncation_.load(std::memory_order_relaxed) != NOT_TRUNCATED ||
+         !context_->config_manager->report_traces();
+}
+
+bool TraceSegment::flushes_orphans() const {
+  return context_->segment_registry != nullptr;
+}
+
+const TraceSegment::EncodedTraceContext& TraceSegment::encoded_trace_context(
+    const std::pair<std::string, std::string>* trace_source) {
+  // Depending on the context, `mutex_` might need already to be locked.
+
+  if (encoded_trace_context_ &&
+      encoded_trace_context_->version == trace_context_version_ &&
+      bool(encoded_trace_context_->trace_source) == bool(trace_source) &&
+      (!trace_source ||
+       *encoded_trace_context_->trace_source == trace_source->second)) {
+    return *encoded_trace_context_;
+  }
+
+  auto& encoded = encoded_trace_context_.emplace();
+  encoded.version = trace_context_version_;
+  if (trace_source) {
+    encoded.trace_source = trace_source->second;
+  }
+  // `_dd.p.ts` is propagated with the trace tags.
+  const TraceTagsView trace_tags{&trace_tags_, trace_source};
+
+  const std::size_t tags_size =
+      append_tags(encoded.datadog_tags, trace_tags,
+                  context_->tags_header_max_size);
+  if (tags_size > context_->tags_header_max_size) {
+    encoded.oversized_tags_size = tags_size;
+  }
+
+  const int sampling_priority = sampling_decision_->priority;
+  append_tracestate(encoded.tracestate, 0, sampling_priority, origin_,
+                    trace_tags, additional_datadog_w3c_tracestate_,
+                    additional_w3c_tracestate_);
+  // The tracestate begins with "dd=s:<priority>;p:<parent ID>".
+  const StringView parent_id_key = ";p:";
+  const auto found = encoded.tracestate.find(parent_id_key.data(), 0,
+                                             parent_id_key.size());
+  assert(found != std::string::npos);
+  encoded.tracestate_parent_id_offset = found + parent_id_key.size();
+
+  return encoded;
+}
+
 bool TraceSegment::inject(DictWriter& writer, const SpanData& span) {
   return inject(writer, span, InjectionOptions{});
 }
 
 bool TraceSegment::inject(DictWriter& writer, const SpanData& span,
                           const InjectionOptions&) {
+  const Injection injection{&span, &writer};
+  return inject(&injection, 1);
+}
+
+bool TraceSegment::inject(const Injection* injections, std::size_t count) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::inject);
   // If the only injection style is `NONE`, then don't do anything.
-  if (injection_styles_.size() == 1 &&
-      injection_styles_[0] == PropagationStyle::NONE) {
+  const std::vector<PropagationStyle>& injection_styles =
+      context_->injection_styles;
+  if (injection_styles.size() == 1 &&
+      injection_styles[0] == PropagationStyle::NONE) {
     return true;
   }
 
+  auto& local_root_tags = spans_[0]->tags;
+
+  auto ts_tag_found = std::find_if(
+      local_root_tags.cbegin(), local_root_tags.cend(),
+      [](const auto& p) { return p.first == tags::internal::trace_source; });
+  const std::pair<std::string, std::string>* const trace_source =
+      ts_tag_found == local_root_tags.cend() ? nullptr : &*ts_tag_found;
+
+  // The header values are formatted into `buffer`, which is reused by later
+  // calls on this thread, so that injection does not allocate once `buffer`
+  // and `headers` are large enough.  `headers` refers to ranges of `buffer`.
+  thread_local std::string buffer;
+  buffer.clear();
+  struct Header {
+    // Index into `injections` of the injection that writes this header.
+    std::size_t injection;
+    StringView name;
+    std::size_t begin;
+    std::size_t end;
+  };
+  thread_local std::vector<Header> headers;
+  headers.clear();
+  std::size_t injection_index = 0;
+  const auto add_header = [&](StringView name, std::size_t begin) {
+    headers.push_back(Header{injection_index, name, begin, buffer.size()});
+  };
+
   // The sampling priority can change (it can be overridden on another thread),
-  // and trace tags might change when that happens ("_dd.p.dm").
-  // So, we lock here, make a sampling decision if necessary, and then copy the
-  // decision and trace tags before unlocking.
+  // and trace tags might change when that happens ("_dd.p.dm").  So, we lock
+  // here, make a sampling decision if necessary, and then format the header
+  // values for all of `injections` before unlocking.
   int sampling_priority;
-  std::vector<std::pair<std::string, std::string>> trace_tags;
+  bool suppressed = false;
+  // The size of the "x-datadog-tags" value if it is too large to inject.
+  Optional<std::size_t> oversized_tags_size;
   {
-    std::lock_guard<std::mutex> lock(mutex_);
+    DD_TIMELINE_LOCK(mutex_, "TraceSegment lock wait");
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
     make_sampling_decision_if_null();
     assert(sampling_decision_);
     sampling_priority = sampling_decision_->priority;
-    trace_tags = trace_tags_;
-  }
 
-  auto& local_root_tags = spans_.front()->tags;
+    // When tracing (the product) is disabled, skip tracing context
+    // propagation when:
+    //  - the local root span is NOT created by another product (no `_dd.p.ts`)
+    //  - sampling priority is DROP
+    if (!context_->tracing_enabled && !trace_source && sampling_priority <= 0) {
+      suppressed = true;
+    } else {
+      // Only the parent IDs and the sampling priority are formatted for each
+      // span.  The rest is copied from `encoded`.
+      const EncodedTraceContext& encoded = encoded_trace_context(trace_source);
+      oversized_tags_size = encoded.oversized_tags_size;
+      const auto add_datadog_tags = [&]() {
+        if (!encoded.datadog_tags.empty()) {
+          const std::size_t begin = buffer.size();
+          buffer += encoded.datadog_tags;
+          add_header("x-datadog-tags", begin);
+        }
+      };
+      const auto add_origin = [&]() {
+        if (origin_) {
+          const std::size_t begin = buffer.size();
+          buffer += *origin_;
+          add_header("x-datadog-origin", begin);
+        }
+      };
 
-  auto ts_tag_found = std::find_if(
-      local_root_tags.cbegin(), local_root_tags.cend(),
-      [](const auto& p) { return p.first == tags::internal::trace_source; });
+      for (; injection_index != count; ++injection_index) {
+        const SpanData& span = *injections[injection_index].span;
+        for (const auto style : injection_styles) {
+          std::size_t begin = buffer.size();
+          switch (style) {
+            case PropagationStyle::DATADOG:
+              append_decimal(buffer, span.trace_id.low);
+              add_header("x-datadog-trace-id", begin);
+              begin = buffer.size();
+              append_decimal(buffer, span.span_id);
+              add_header("x-datadog-parent-id", begin);
+              begin = buffer.size();
+              append_decimal(buffer, sampling_priority);
+              add_header("x-datadog-sampling-priority", begin);
+              add_origin();
+              add_datadog_tags();
+              break;
+            case PropagationStyle::B3:
+              if constexpr (b3_propagation_built) {
+                if (span.trace_id.high) {
+                  append_hex_padded(buffer, span.trace_id.high);
+                }
+                append_hex_padded(buffer, span.trace_id.low);
+                add_header("x-b3-traceid", begin);
+                begin = buffer.size();
+                append_hex_padded(buffer, span.span_id);
+                add_header("x-b3-spanid", begin);
+                begin = buffer.size();
+                buffer += sampling_priority > 0 ? '1' : '0';
+                add_header("x-b3-sampled", begin);
+                add_origin();
+                add_datadog_tags();
+              }
+              break;
+            case PropagationStyle::W3C:
+              append_traceparent(buffer, span.trace_id, span.span_id,
+                                 sampling_priority);
+              add_header("traceparent", begin);
+              begin = buffer.size();
+              buffer.append(encoded.tracestate, 0,
+                            encoded.tracestate_parent_id_offset);
+              append_hex_padded(buffer, span.span_id);
+              buffer.append(encoded.tracestate,
+                            encoded.tracestate_parent_id_offset +
+                                2 * sizeof(span.span_id));
+              add_header("tracestate", begin);
+              break;
+            default:
+              break;
+          }
+        }
+      }
+    }
+  }
 
-  // When tracing (the product) is disabled, skip tracing context propagation
-  // when:
-  //  - the local root span is NOT created by another product (no `_dd.p.ts`)
-  //  - sampling priority is DROP
-  if (!tracing_enabled_) {
-    if (ts_tag_found == local_root_tags.cend() && sampling_priority <= 0) {
+  if (suppressed) {
+    for (std::size_t i = 0; i < count; ++i) {
+      DictWriter& writer = *injections[i].writer;
       writer.erase("x-datadog-trace-id");
       writer.erase("x-datadog-parent-id");
       writer.erase("x-datadog-sampling-priority");
       writer.erase("x-datadog-origin");
-      writer.erase("x-datadog-trace-id");
       writer.erase("x-datadog-tags");
       writer.erase("x-b3-traceid");
       writer.erase("x-b3-spanid");
       writer.erase("x-b3-sampled");
-      writer.erase("x-datadog-origin");
       writer.erase("traceparent");
       writer.erase("tracestate");
-      return false;
     }
+    return false;
   }
 
-  // Add `_dd.p.ts` to `trace_tags` for context propagation.
-  if (ts_tag_found != local_root_tags.cend()) {
-    trace_tags.emplace_back(tags::internal::trace_source, ts_tag_found->second);
+  if (oversized_tags_size) {
+    std::string message;
+    message +=
+        "Serialized x-datadog-tags header value is too large.  The configured "
+        "maximum size is ";
+    message += std::to_string(context_->tags_header_max_size);
+    message += " bytes, but the encoded value is ";
+    message += std::to_string(*oversized_tags_size);
+    message += " bytes.";
+    context_->logger->log_error(message);
+    local_root_tags[tags::internal::propagation_error] = "inject_max_size";
   }
 
-  for (const auto style : injection_styles_) {
-    switch (style) {
-      case PropagationStyle::DATADOG:
-        writer.set("x-datadog-trace-id", std::to_string(span.trace_id.low));
-        writer.set("x-datadog-parent-id", std::to_string(span.span_id));
-        writer.set("x-datadog-sampling-priority",
-                   std::to_string(sampling_priority));
-        if (origin_) {
-          writer.set("x-datadog-origin", *origin_);
-        }
-        inject_trace_tags(writer, trace_tags, tags_header_max_size_,
-                          local_root_tags, *logger_);
-
-        telemetry::counter::increment(metrics::tracer::trace_context::injected,
-                                      {"header_style:datadog"});
-        break;
-      case PropagationStyle::B3:
-        if (span.trace_id.high) {
-          writer.set("x-b3-traceid", span.trace_id.hex_padded());
-        } else {
-          writer.set("x-b3-traceid", hex_padded(span.trace_id.low));
-        }
-        writer.set("x-b3-spanid", hex_padded(span.span_id));
-        writer.set("x-b3-sampled", std::to_string(int(sampling_priority > 0)));
-        if (origin_) {
-          writer.set("x-datadog-origin", *origin_);
-        }
-        inject_trace_tags(writer, trace_tags, tags_header_max_size_,
-                          local_root_tags, *logger_);
-        telemetry::counter::increment(metrics::tracer::trace_context::injected,
-                                      {"header_style:b3multi"});
-        break;
-      case PropagationStyle::W3C:
-        writer.set(
-            "traceparent",
-            encode_traceparent(span.trace_id, span.span_id, sampling_priority));
-        writer.set(
-            "tracestate",
-            encode_tracestate(span.span_id, sampling_priority, origin_,
-                              trace_tags, additional_datadog_w3c_tracestate_,
-                              additional_w3c_tracestate_));
-        telemetry::counter::increment(metrics::tracer::trace_context::injected,
-                                      {"header_style:tracecontext"});
-        break;
-      default:
-        break;
+  for (const Header& header : headers) {
+    injections[header.injection].writer->set(
+        header.name,
+        StringView(buffer.data() + header.begin, header.end - header.begin));
+  }
+
+  for (const auto style : injection_styles) {
+    if (const auto* counter = injected_counter(style)) {
+      for (std::size_t i = 0; i < count; ++i) {
+        counter->increment();
+      }
     }
   }
 
   return true;
 }
 
-SpanData& TraceSegment::local_root() const { return *spans_.front(); }
+SpanData& TraceSegment::local_root() const { return *spans_[0]; }
 
 }  // namespace tracing
 }  // namespace datadog
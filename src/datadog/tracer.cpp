@@ -1,7 +1,9 @@
+#include <datadog/capture_file.h>
 #include <datadog/dict_reader.h>
 #include <datadog/environment.h>
 #include <datadog/id_generator.h>
 #include <datadog/logger.h>
+#include <datadog/null_collector.h>
 #include <datadog/runtime_id.h>
 #include <datadog/span.h>
 #include <datadog/span_config.h>
@@ -13,28 +15,399 @@
 
 #include <algorithm>
 #include <cassert>
-#include <filesystem>
 
+#include "baggage_tags.h"
+#include "build_features.h"
 #include "config_manager.h"
 #include "datadog_agent.h"
+#include "datadog_intake.h"
+#include "datagram_collector.h"
+#include "default_http_client.h"
+#include "default_id_generator.h"
 #include "extracted_data.h"
 #include "extraction_util.h"
+#include "header_tags.h"
 #include "hex.h"
 #include "json.hpp"
+#include "json_writer.h"
+#include "memory_budget.h"
 #include "msgpack.h"
+#include "otlp_exporter.h"
+#include "overhead_governor.h"
 #include "platform_util.h"
+#include "pool_allocator.h"
+#include "process_info.h"
+#include "propagation_headers.h"
 #include "random.h"
+#include "recording_collector.h"
+#include "resource_latencies.h"
+#include "segment_registry.h"
+#include "self_profiling.h"
+#include "shared_tags.h"
 #include "span_data.h"
+#include "span_recycler.h"
 #include "span_sampler.h"
+#include "string_util.h"
+#include "tag_propagation.h"
 #include "tags.h"
+#include "tail_sampler.h"
 #include "telemetry_metrics.h"
+#include "threaded_event_scheduler.h"
 #include "trace_sampler.h"
+#include "tracer_context.h"
 #include "w3c_propagation.h"
 
-namespace fs = std::filesystem;
-
 namespace datadog {
 namespace tracing {
+namespace {
+
+// Return a new `SpanData` for the local root span of a new trace segment.  If
+// the specified `use_arena` is true, then the span is allocated from a new
+// `Arena` that is shared by the segment's other spans, and that takes its
+// memory from the specified `upstream` memory resource, if not null.
+std::unique_ptr<SpanData> make_local_root(bool use_arena,
+                                          std::pmr::memory_resource* upstream) {
+  if (!use_arena) {
+    return SpanData::make(nullptr);
+  }
+  Arena* arena = Arena::create(upstream);
+  auto span_data = SpanData::make(arena);
+  arena->release();
+  return span_data;
+}
+
+// Return the value of the `_dd.p.tid` trace tag for the specified high 64 bits
+// of a trace ID.  Generated trace IDs have the time in seconds as their high
+// bits, so each thread remembers the value that it formatted last rather than
+// formatting it for every trace.
+const std::string& trace_id_high_value(std::uint64_t high) {
+  thread_local std::uint64_t last_high = 0;
+  thread_local std::string last_value = hex_padded(std::uint64_t(0));
+  if (high != last_high) {
+    last_high = high;
+    last_value.clear();
+    append_hex_padded(last_value, high);
+  }
+  return last_value;
+}
+
+// The extractor of a propagation style, and the telemetry counter that is
+// incremented when the style is extracted.
+struct StyleExtractor {
+  decltype(&extract_datadog) extract;
+  telemetry::counter::Handle extracted;
+};
+
+const StyleExtractor& extractor_for(PropagationStyle style) {
+  const auto& extracted = metrics::tracer::trace_context::extracted;
+  static const StyleExtractor datadog{
+      &extract_datadog,
+      telemetry::counter::handle(extracted, {"header_style:datadog"})};
+  static const StyleExtractor w3c{
+      &extract_w3c,
+      telemetry::counter::handle(extracted, {"header_style:tracecontext"})};
+  static const StyleExtractor none{
+      &extract_none,
+      telemetry::counter::handle(extracted, {"header_style:none"})};
+
+  switch (style) {
+    case PropagationStyle::DATADOG:
+      return datadog;
+    case PropagationStyle::B3:
+      if constexpr (b3_propagation_built) {
+        static const StyleExtractor b3{
+            &extract_b3,
+            telemetry::counter::handle(extracted, {"header_style:b3multi"})};
+        return b3;
+      }
+      return none;
+    case PropagationStyle::W3C:
+      return w3c;
+    default:
+      return none;
+  }
+}
+
+// Return trace context extracted in the specified `style` from the specified
+// `headers`, or return an `Error` if an error occurs.  The returned context's
+// `headers_examined` are those examined by the extraction.  If the specified
+// `describe_errors` is false, then a returned `Error` is not prefixed with a
+// description of the extraction, since the caller discards it.
+Expected<ExtractedData> extract_style(PropagationStyle style,
+                                      PropagationHeaders& headers,
+                                      SpanTags& span_tags, Logger& logger,
+                                      bool describe_errors) {
+  const StyleExtractor& extractor = extractor_for(style);
+  headers.clear_examined();
+  auto data = extractor.extract(headers, span_tags, logger);
+  if (auto* error = data.if_error()) {
+    if (!describe_errors) {
+      return std::move(*error);
+    }
+    return with_extraction_context(std::move(*error), style, headers,
+                                   headers.examined());
+  }
+
+  extractor.extracted.increment();
+  data->headers_examined = headers.examined();
+  return data;
+}
+
+// Return the trace context extracted in the specified `extraction_styles`
+// from the specified `headers`, or return an `Error` if there is no valid
+// context to extract.  Extraction errors are logged to the specified `logger`
+// or tagged in the specified `span_tags`.  If the specified `describe_errors`
+// is false, then a returned `Error` is not described as fully, because the
+// caller discards it.
+Expected<ExtractedData> extract_context(
+    const std::vector<PropagationStyle>& extraction_styles,
+    PropagationHeaders& headers, SpanTags& span_tags, Logger& logger,
+    bool describe_errors) {
+  assert(!extraction_styles.empty());
+
+  ExtractedData merged_context;
+  if (extraction_styles.size() == 1) {
+    // Most configurations extract a single style, whose context needs no
+    // merging.  This is what the general case below yields for one style.
+    auto data = extract_style(extraction_styles.front(), headers, span_tags,
+                              logger, describe_errors);
+    if (auto* error = data.if_error()) {
+      return std::move(*error);
+    }
+    if (data->trace_id || data->parent_id) {
+      merged_context = std::move(*data);
+    }
+  } else {
+    Optional<PropagationStyle> first_style_with_trace_id;
+    Optional<PropagationStyle> first_style_with_parent_id;
+    ExtractedContexts extracted_contexts;
+
+    for (const auto style : extraction_styles) {
+      auto data = extract_style(style, headers, span_tags, logger,
+                                describe_errors);
+      if (auto* error = data.if_error()) {
+        return std::move(*error);
+      }
+
+      if (!first_style_with_trace_id && data->trace_id.has_value()) {
+        first_style_with_trace_id = style;
+      }
+
+      if (!first_style_with_parent_id && data->parent_id.has_value()) {
+        first_style_with_parent_id = style;
+      }
+
+      extracted_contexts.set(style, std::move(*data));
+    }
+
+    if (!first_style_with_trace_id) {
+      // Nothing extracted a trace ID. Return the first context that includes a
+      // parent ID, if any, or otherwise just return an empty `ExtractedData`.
+      // The purpose of looking for a parent ID is to allow for the error
+      // "extracted a parent ID without a trace ID," if that's what happened.
+      if (first_style_with_parent_id) {
+        auto* other = extracted_contexts.find(*first_style_with_parent_id);
+        assert(other);
+        merged_context = std::move(*other);
+      }
+    } else {
+      merged_context = merge(*first_style_with_trace_id, extracted_contexts);
+    }
+  }
+
+  // Return an `Error` having the specified `code` and, if `describe_errors`,
+  // a message made by the specified `describe` and prefixed with a
+  // description of the extraction.  Otherwise, the message is left empty,
+  // since the caller discards the error.
+  const auto extraction_error = [&](Error::Code code, const auto& describe) {
+    Error error{code, std::string()};
+    if (describe_errors) {
+      error.message = describe();
+      error = with_extraction_context(std::move(error), merged_context.style,
+                                      headers, merged_context.headers_examined);
+    }
+    return error;
+  };
+
+  // Some information might be missing.
+  // Here are the combinations considered:
+  //
+  // - no trace ID and no parent ID
+  //     - this means there's no span to extract
+  // - parent ID and no trace ID
+  //     - error
+  // - trace ID and no parent ID
+  //     - if origin is set, then we're extracting a root span
+  //         - the idea is that "synthetics" might have started a trace without
+  //           producing a root span
+  //     - if origin is _not_ set, then it's an error
+  // - trace ID and parent ID means we're extracting a child span
+  // - if trace ID is zero, then that's an error.
+
+  if (!merged_context.trace_id && !merged_context.parent_id) {
+    return extraction_error(Error::NO_SPAN_TO_EXTRACT, []() {
+      return std::string(
+          "There's neither a trace ID nor a parent span ID to extract.");
+    });
+  }
+  if (!merged_context.trace_id) {
+    return extraction_error(Error::MISSING_TRACE_ID, [&]() {
+      std::string message;
+      message +=
+          "There's no trace ID to extract, but there is a parent span ID: ";
+      message += std::to_string(*merged_context.parent_id);
+      return message;
+    });
+  }
+  if (!merged_context.parent_id && !merged_context.origin) {
+    return extraction_error(Error::MISSING_PARENT_SPAN_ID, [&]() {
+      std::string message;
+      message +=
+          "There's no parent span ID to extract, but there is a trace ID: ";
+      message += "[hexadecimal = ";
+      message += merged_context.trace_id->hex_padded();
+      if (merged_context.trace_id->high == 0) {
+        message += ", decimal = ";
+        message += std::to_string(merged_context.trace_id->low);
+      }
+      message += ']';
+      return message;
+    });
+  }
+
+  if (!merged_context.parent_id) {
+    // We have a trace ID, but not parent ID.  We're meant to be the root, and
+    // whoever called us already created a trace ID for us (to correlate with
+    // whatever they're doing).
+    merged_context.parent_id = 0;
+  }
+
+  assert(merged_context.parent_id);
+  assert(merged_context.trace_id);
+
+  if (*merged_context.trace_id == 0) {
+    return extraction_error(Error::ZERO_TRACE_ID, []() {
+      return std::string("extracted zero value for trace ID, which is invalid");
+    });
+  }
+
+  if (merged_context.trace_id->high) {
+    // The trace ID has some bits set in the higher 64 bits. Set the
+    // corresponding `trace_id_high` tag, so that the Datadog backend is aware
+    // of those bits.
+    //
+    // First, though, if the `trace_id_high` tag is already set and has a
+    // bogus value or a value inconsistent with the trace ID, tag an error.
+    const std::string& hex_high =
+        trace_id_high_value(merged_context.trace_id->high);
+    const auto extant =
+        std::find_if(merged_context.trace_tags.begin(),
+                     merged_context.trace_tags.end(), [&](const auto& pair) {
+                       return pair.first == tags::internal::trace_id_high;
+                     });
+    if (extant == merged_context.trace_tags.end()) {
+      merged_context.trace_tags.emplace_back(tags::internal::trace_id_high,
+                                             hex_high);
+    } else {
+      // There is already a `trace_id_high` tag. `hex_high` is its proper
+      // value. Check if the extant value is malformed or different from
+      // `hex_high`. In either case, tag an error and overwrite the tag with
+      // `hex_high`.
+      const Optional<std::uint64_t> high = parse_trace_id_high(extant->second);
+      if (!high) {
+        span_tags[tags::internal::propagation_error] =
+            "malformed_tid " + extant->second;
+        extant->second = hex_high;
+      } else if (*high != merged_context.trace_id->high) {
+        span_tags[tags::internal::propagation_error] =
+            "inconsistent_tid " + extant->second;
+        extant->second = hex_high;
+      }
+    }
+  }
+
+  return merged_context;
+}
+
+// Replace the HTTP client and event scheduler of the specified collector
+// `config`, if this library made them, with ones whose threads belong to the
+// calling process.  `Config` is `FinalizedDatadogAgentConfig`,
+// `FinalizedDatadogIntakeConfig`, or `FinalizedOtlpExporterConfig`.
+template <typename Config>
+void renew_default_components(Config& config,
+                              const DefaultHTTPClientOptions& options,
+                              const std::shared_ptr<Logger>& logger) {
+  if (config.default_http_client) {
+    config.http_client = shared_default_http_client(
+        logger, config.clock, options, config.background_threads);
+  }
+  if (config.default_event_scheduler) {
+    config.event_scheduler =
+        ThreadedEventScheduler::shared_instance(config.background_threads,
+                                                logger);
+  }
+}
+
+// Replace the HTTP clients and event schedulers of the specified `config`
+// that this library made, and the capture file of its recording collector,
+// with ones that belong to the calling process.
+void renew_for_current_process(FinalizedTracerConfig& config) {
+  config.process_id = get_process_id();
+  if (config.default_event_scheduler) {
+    config.event_scheduler = ThreadedEventScheduler::shared_instance();
+  }
+  if (auto* agent =
+          std::get_if<FinalizedDatadogAgentConfig>(&config.collector)) {
+    renew_default_components(*agent, http_client_options(*agent),
+                             config.logger);
+    if (config.default_http_client) {
+      config.http_client = agent->http_client;
+    }
+    return;
+  }
+  if (config.default_http_client) {
+    config.http_client = shared_default_http_client(
+        config.logger, config.clock, {}, ThreadOptions{});
+  }
+  if (auto* intake =
+          std::get_if<FinalizedDatadogIntakeConfig>(&config.collector)) {
+    renew_default_components(*intake, {}, config.logger);
+  } else if (auto* otlp =
+                 std::get_if<FinalizedOtlpExporterConfig>(&config.collector)) {
+    renew_default_components(*otlp, {}, config.logger);
+  } else if (auto* recording = std::get_if<FinalizedRecordingCollectorConfig>(
+                 &config.collector)) {
+    // Appends to the capture file are serialized only within a process, so
+    // each process records to a file of its own.
+    if (recording->default_event_scheduler) {
+      recording->event_scheduler = ThreadedEventScheduler::shared_instance();
+    }
+    recording->capture_path += '.';
+    recording->capture_path += std::to_string(config.process_id);
+    auto capture_file = CaptureFile::create(recording->capture_path,
+                                            recording->capture_bytes);
+    if (auto* error = capture_file.if_error()) {
+      config.logger->log_error(*error);
+      // Without a capture file of its own, the process discards its traces.
+      config.collector = std::make_shared<NullCollector>();
+    } else {
+      recording->capture_file = std::move(*capture_file);
+    }
+  }
+}
+
+// Return a copy of the specified `config`, renewed for the calling process if
+// it was finalized (or last renewed) in another process.
+std::shared_ptr<const FinalizedTracerConfig> for_current_process(
+    const FinalizedTracerConfig& config) {
+  auto result = std::make_shared<FinalizedTracerConfig>(config);
+  if (result->process_id != get_process_id()) {
+    renew_for_current_process(*result);
+  }
+  return result;
+}
+
+}  // namespace
 
 void to_json(nlohmann::json& j, const PropagationStyle& style) {
   j = to_string_view(style);
@@ -43,46 +416,128 @@ void to_json(nlohmann::json& j, const PropagationStyle& style) {
 Tracer::Tracer(const FinalizedTracerConfig& config)
     : Tracer(config, default_id_generator(config.generate_128bit_trace_ids)) {}
 
-Tracer::Tracer(const FinalizedTracerConfig& config,
+Tracer::Tracer(const FinalizedTracerConfig& original_config,
                const std::shared_ptr<const IDGenerator>& generator)
-    : logger_(config.logger),
-      runtime_id_(config.runtime_id ? *config.runtime_id
-                                    : RuntimeID::generate()),
-      signature_{runtime_id_, config.defaults.service,
-                 config.defaults.environment},
-      config_manager_(std::make_shared<ConfigManager>(config)),
+    : finalized_config_(for_current_process(original_config)),
+      logger_(finalized_config_->logger),
+      runtime_id_(finalized_config_->runtime_id
+                      ? *finalized_config_->runtime_id
+                      : RuntimeID::generate()),
+      signature_{runtime_id_, finalized_config_->defaults.service,
+                 finalized_config_->defaults.environment},
+      config_manager_(std::make_shared<ConfigManager>(*finalized_config_)),
       collector_(/* see constructor body */),
-      span_sampler_(
-          std::make_shared<SpanSampler>(config.span_sampler, config.clock)),
+      span_sampler_(std::make_shared<SpanSampler>(
+          finalized_config_->span_sampler, finalized_config_->clock)),
       generator_(generator),
-      clock_(config.clock),
-      injection_styles_(config.injection_styles),
-      extraction_styles_(config.extraction_styles),
-      tags_header_max_size_(config.tags_header_size),
-      baggage_opts_(config.baggage_opts),
+      clock_(finalized_config_->clock),
+      extraction_styles_(finalized_config_->extraction_styles),
+      baggage_opts_(finalized_config_->baggage_opts),
       baggage_injection_enabled_(false),
       baggage_extraction_enabled_(false),
-      tracing_enabled_(config.tracing_enabled),
-      resource_renaming_mode_(config.resource_renaming_mode) {
+      trace_arena_enabled_(finalized_config_->trace_arena_enabled),
+      memory_resource_(finalized_config_->memory_resource),
+      live_segments_(std::make_shared<std::atomic<std::size_t>>(0)),
+      memory_budget_(finalized_config_->max_memory_bytes
+                         ? std::make_shared<MemoryBudget>(
+                               finalized_config_->max_memory_bytes)
+                         : nullptr) {
+  const FinalizedTracerConfig& config = *finalized_config_;
   telemetry::init(config.telemetry, signature_, logger_, config.http_client,
                   config.event_scheduler, config.agent_url);
-  if (config.report_hostname) {
-    hostname_ = get_hostname();
-  }
   if (auto* collector =
           std::get_if<std::shared_ptr<Collector>>(&config.collector)) {
     collector_ = *collector;
+  } else if (auto* intake_config =
+                 std::get_if<FinalizedDatadogIntakeConfig>(&config.collector)) {
+    collector_ = std::make_shared<DatadogIntake>(*intake_config, config.logger,
+                                                 signature_);
+  } else if (auto* otlp_config =
+                 std::get_if<FinalizedOtlpExporterConfig>(&config.collector)) {
+    collector_ =
+        std::make_shared<OtlpExporter>(*otlp_config, config.logger, signature_);
+  } else if (auto* datagram_config =
+                 std::get_if<FinalizedDatagramCollectorConfig>(
+                     &config.collector)) {
+    collector_ =
+        std::make_shared<DatagramCollector>(*datagram_config, config.logger);
+  } else if (auto* recording_config =
+                 std::get_if<FinalizedRecordingCollectorConfig>(
+                     &config.collector)) {
+    collector_ =
+        std::make_shared<RecordingCollector>(*recording_config, config.logger);
   } else {
     auto& agent_config =
         std::get<FinalizedDatadogAgentConfig>(config.collector);
 
     auto rc_listeners = agent_config.remote_configuration_listeners;
     rc_listeners.emplace_back(config_manager_);
-    auto agent = std::make_shared<DatadogAgent>(agent_config, config.logger,
-                                                signature_, rc_listeners);
+    auto agent = std::make_shared<DatadogAgent>(
+        agent_config, config.logger, signature_, rc_listeners, memory_budget_);
     collector_ = agent;
   }
 
+  auto context = std::make_shared<TracerContext>();
+  context->logger = logger_;
+  context->collector = collector_;
+  context->trace_sampler = config_manager_->trace_sampler();
+  context->span_sampler = span_sampler_;
+  context->config_manager = config_manager_;
+  if (config.tracing_enabled) {
+    resource_latencies_ = std::make_shared<ResourceLatencies>();
+    context->resource_latencies = resource_latencies_;
+  }
+  if (config.tail_sampling_enabled && config.tracing_enabled) {
+    context->tail_sampler = std::make_shared<TailSampler>(
+        config, collector_, span_sampler_, resource_latencies_);
+  }
+  context->clock = clock_;
+  context->defaults = config_manager_->span_defaults();
+  context->defaults_version = config_manager_->span_defaults_version();
+  context->id_generator = generator_;
+  context->default_id_generator =
+      dynamic_cast<const DefaultIDGenerator*>(generator_.get());
+  context->runtime_id = runtime_id_.string();
+  context->shared_tags_process_id = get_process_id();
+  context->shared_tags = make_segment_tags(nullopt, context->runtime_id,
+                                           context->shared_tags_process_id);
+  context->origin_tags =
+      std::make_shared<SegmentTagsCache>(context->runtime_id);
+  context->injection_styles = config.injection_styles;
+  if (config.report_hostname) {
+    context->hostname = get_hostname();
+  }
+  context->tags_header_max_size = config.tags_header_size;
+  context->resource_renaming_mode = config.resource_renaming_mode;
+  context->obfuscation_enabled = config.obfuscation_enabled;
+  context->header_tags = config.header_tags;
+  context->tracing_enabled = config.tracing_enabled;
+  context->partial_flush_min_spans = config.partial_flush_min_spans;
+  // A trace created when APM tracing is disabled might yet be kept on account
+  // of another product, once its spans are tagged as such.
+  context->early_sampling_decision =
+      config.early_sampling_decision && config.tracing_enabled;
+  context->span_limits.max_resource_length = config.max_resource_length;
+  context->span_limits.max_tag_value_length = config.max_tag_value_length;
+  context->max_spans_per_segment = config.max_spans_per_trace_segment;
+  context->max_bytes_per_segment = config.max_bytes_per_trace_segment;
+  context->span_rollups = config.span_rollups;
+  context->live_segments = live_segments_;
+  context->memory_budget = memory_budget_;
+  if (config.orphaned_segment_max_age.count() > 0) {
+    segment_registry_ = std::make_shared<SegmentRegistry>(
+        clock_, config.orphaned_segment_max_age, logger_,
+        *config.event_scheduler);
+    context->segment_registry = segment_registry_;
+  }
+  if (config.max_cpu_overhead > 0) {
+    overhead_governor_ = std::make_shared<OverheadGovernor>(
+        config.max_cpu_overhead, config_manager_->trace_sampler(),
+        *config.event_scheduler);
+  }
+  context_ = std::make_shared<AtomicSnapshot<const TracerContext>>(
+      std::move(context));
+
   for (const auto style : extraction_styles_) {
     if (style == PropagationStyle::BAGGAGE) {
       baggage_extraction_enabled_ = true;
@@ -90,7 +545,7 @@ Tracer::Tracer(const FinalizedTracerConfig& config,
     }
   }
 
-  for (const auto style : injection_styles_) {
+  for (const auto style : config.injection_styles) {
     if (style == PropagationStyle::BAGGAGE) {
       baggage_injection_enabled_ = true;
       break;
@@ -103,45 +558,182 @@ Tracer::Tracer(const FinalizedTracerConfig& config,
     });
   }
 
+  const ProcessInfo& process = process_info();
   std::unordered_map<std::string, std::string> process_tags(
       config.process_tags);
-  process_tags.emplace("entrypoint.name", get_process_name());
+  process_tags.emplace("entrypoint.name", process.entrypoint_name);
   process_tags.emplace("entrypoint.type", "executable");
-  process_tags.emplace("entrypoint.workdir",
-                       fs::current_path().filename().string());
-  if (auto maybe_process_path = get_process_path();
-      maybe_process_path.has_value()) {
-    process_tags.emplace("entrypoint.basedir",
-                         maybe_process_path->parent_path().filename().string());
+  process_tags.emplace("entrypoint.workdir", process.entrypoint_workdir);
+  if (process.entrypoint_basedir) {
+    process_tags.emplace("entrypoint.basedir", *process.entrypoint_basedir);
   }
   store_config(process_tags);
 }
 
+void Tracer::reinitialize_after_fork() {
+  FinalizedTracerConfig config = *finalized_config_;
+  // The child is another instance of the service.
+  config.runtime_id = nullopt;
+  // The constructor renews the components that belong to the parent, since
+  // `config` was last renewed in the parent.
+  const auto generator = generator_;
+
+  // The current components of this tracer wait for threads of the parent
+  // process when they are destroyed, and those threads do not exist in this
+  // process.  So, the components are moved into a tracer that is never
+  // destroyed.
+  static_cast<void>(new Tracer(std::move(*this)));
+  *this = Tracer(config, generator);
+}
+
+void Tracer::warm_up(std::size_t expected_spans_per_trace,
+                     std::size_t expected_concurrency) {
+  const std::size_t spans = expected_spans_per_trace * expected_concurrency;
+  if (trace_arena_enabled_) {
+    if (!memory_resource_) {
+      // Assume that a span and its tags take about twice the size of
+      // `SpanData`.
+      const std::size_t bytes_per_trace =
+          expected_spans_per_trace * 2 * sizeof(SpanData);
+      const std::size_t chunks_per_trace =
+          (bytes_per_trace + Arena::chunk_size - 1) / Arena::chunk_size;
+      Arena::reserve_chunks(chunks_per_trace * expected_concurrency);
+    }
+  } else {
+    reserve_recycled_spans(spans);
+  }
+  collector_->warm_up(expected_spans_per_trace, expected_concurrency);
+  process_info();
+}
+
+std::future<void> Tracer::shutdown_async(
+    std::chrono::steady_clock::time_point deadline) {
+  // The task shares ownership of what it flushes, so the tracer can be
+  // destroyed before the task completes.
+  return std::async(std::launch::async,
+                    [tail_sampler = context_->load()->tail_sampler,
+                     collector = collector_, deadline]() {
+                      if (tail_sampler) {
+                        tail_sampler->flush();
+                      }
+                      collector->shut_down(deadline);
+                    });
+}
+
+RuntimeStats Tracer::runtime_stats() const {
+  RuntimeStats stats;
+  stats.live_trace_segments = live_segments_->load(std::memory_order_relaxed);
+  collector_->add_runtime_stats(stats);
+  if (resource_latencies_) {
+    resource_latencies_->add_runtime_stats(stats);
+  }
+  if (segment_registry_) {
+    segment_registry_->add_runtime_stats(stats);
+  }
+  if (memory_budget_) {
+    stats.memory_bytes = memory_budget_->used();
+  }
+  stats.overhead_keep_rate =
+      config_manager_->trace_sampler()->overhead_keep_rate();
+  return stats;
+}
+
+Expected<void> Tracer::reconfigure(const TracerUpdate& update) {
+  // Trace segments notice the new span defaults by their version (see
+  // `context()`), and share the trace sampler, whose rules are replaced.
+  return config_manager_->apply_local_update(update);
+}
+
 std::string Tracer::config() const {
-  // clang-format off
-  auto config = nlohmann::json::object({
-    {"version", tracer_version_string},
-    {"runtime_id", runtime_id_.string()},
-    {"collector", nlohmann::json::parse(collector_->config())},
-    {"span_sampler", span_sampler_->config_json()},
-    {"injection_styles", injection_styles_},
-    {"extraction_styles", extraction_styles_},
-    {"tags_header_size", tags_header_max_size_},
-    {"environment_variables", nlohmann::json::parse(environment::to_json())},
-    {"baggage", nlohmann::json{
-      {"max_bytes", baggage_opts_.max_bytes},
-      {"max_items", baggage_opts_.max_items},
-    }},
-  });
-  // clang-format on
+  const auto write_styles = [](JsonWriter& json,
+                               const std::vector<PropagationStyle>& styles) {
+    json.begin_array();
+    for (const auto style : styles) {
+      json.value(to_string_view(style));
+    }
+    json.end_array();
+  };
+
+  const auto context = context_->load();
+
+  std::string config;
+  JsonWriter json{config};
+  json.begin_object();
+  json.member("version", tracer_version_string);
+  json.member("runtime_id", runtime_id_.string());
+  json.key("collector");
+  json.raw(collector_->config());
+  json.key("span_sampler");
+  json.raw(span_sampler_->config_json().dump());
+  json.key("injection_styles");
+  write_styles(json, context->injection_styles);
+  json.key("extraction_styles");
+  write_styles(json, extraction_styles_);
+  json.member("tags_header_size", context->tags_header_max_size);
+  json.member("trace_arena_enabled", trace_arena_enabled_);
+  json.member("memory_resource", memory_resource_ != nullptr);
+  json.member("obfuscation_enabled", context->obfuscation_enabled);
+  json.key("header_tags");
+  json.begin_object();
+  if (context->header_tags) {
+    for (const auto& entry : context->header_tags->entries()) {
+      json.member(entry.header, entry.request_tag);
+    }
+  }
+  json.end_object();
+  json.key("baggage_tag_keys");
+  json.begin_array();
+  if (finalized_config_->baggage_tags) {
+    for (const auto& entry : finalized_config_->baggage_tags->entries()) {
+      json.value(entry.key);
+    }
+  }
+  json.end_array();
+  json.member("partial_flush_min_spans", context->partial_flush_min_spans);
+  json.member("early_sampling_decision", context->early_sampling_decision);
+  json.member("max_spans_per_trace_segment", context->max_spans_per_segment);
+  json.member("max_bytes_per_trace_segment", context->max_bytes_per_segment);
+  json.key("span_rollups");
+  json.begin_array();
+  for (const SpanRollup& rollup : context->span_rollups) {
+    json.begin_object();
+    json.member("name", rollup.name);
+    json.member("resource", rollup.resource);
+    json.end_object();
+  }
+  json.end_array();
+  json.member("max_resource_length", context->span_limits.max_resource_length);
+  json.member("max_tag_value_length",
+              context->span_limits.max_tag_value_length);
+  json.member("max_memory_bytes", finalized_config_->max_memory_bytes);
+  json.member("max_cpu_overhead", finalized_config_->max_cpu_overhead);
+  json.member("tail_sampling_enabled", context->tail_sampler != nullptr);
+  json.member("orphaned_segment_max_age_seconds",
+              std::chrono::duration_cast<std::chrono::seconds>(
+                  finalized_config_->orphaned_segment_max_age)
+                  .count());
+  json.key("environment_variables");
+  json.raw(environment::to_json());
+  json.key("baggage");
+  json.begin_object();
+  json.member("max_bytes", baggage_opts_.max_bytes);
+  json.member("max_items", baggage_opts_.max_items);
+  json.end_object();
 
-  config.merge_patch(config_manager_->config_json());
+  // The members of the configuration manager's configuration are distinct
+  // from the members above, so they are appended rather than merged.
+  const auto manager_config = config_manager_->config_json();
+  for (const auto& item : manager_config.items()) {
+    json.key(item.key());
+    json.raw(item.value().dump());
+  }
 
-  if (hostname_) {
-    config["hostname"] = *hostname_;
+  if (context->hostname) {
+    json.member("hostname", *context->hostname);
   }
+  json.end_object();
 
-  return config.dump();
+  return config;
 }
 
 void Tracer::store_config(
@@ -160,7 +752,7 @@ void Tracer::store_config(
   auto defaults = config_manager_->span_defaults();
 
   std::string container_id = "";
-  if (auto maybe_container_id = container::get_id()) {
+  if (const auto& maybe_container_id = process_info().container_id) {
     container_id = maybe_container_id->value;
   }
 
@@ -174,7 +766,7 @@ void Tracer::store_config(
     "runtime_id", [&](auto& buffer) { return msgpack::pack_string(buffer, runtime_id_.string()); },
     "tracer_version", [&](auto& buffer) { return msgpack::pack_string(buffer, signature_.library_version); },
     "tracer_language", [&](auto& buffer) { return msgpack::pack_string(buffer, signature_.library_language); },
-    "hostname", [&](auto& buffer) { return msgpack::pack_string(buffer, hostname_.value_or("")); },
+    "hostname", [&](auto& buffer) { return msgpack::pack_string(buffer, context_->load()->hostname.value_or("")); },
     "service_name", [&](auto& buffer) { return msgpack::pack_string(buffer, defaults->service); },
     "service_env", [&](auto& buffer) { return msgpack::pack_string(buffer, defaults->environment); },
     "service_version", [&](auto& buffer) { return msgpack::pack_string(buffer, defaults->version); },
@@ -188,12 +780,41 @@ void Tracer::store_config(
   }
 }
 
-Span Tracer::create_span() { return create_span(SpanConfig{}); }
+std::shared_ptr<const TracerContext> Tracer::context() {
+  auto context = context_->load();
+  const auto version = config_manager_->span_defaults_version();
+  if (context->defaults_version == version) {
+    return context;
+  }
+
+  // Remote configuration changed the span defaults.  Publish a copy of the
+  // context that has the new defaults.  If another thread does the same
+  // concurrently, either copy will do.
+  auto updated = std::make_shared<TracerContext>(*context);
+  updated->defaults = config_manager_->span_defaults();
+  updated->defaults_version = version;
+  context = std::move(updated);
+  context_->store(context);
+  return context;
+}
+
+Span Tracer::create_span() { return create_span(SpanConfigView{}); }
 
 Span Tracer::create_span(const SpanConfig& config) {
-  auto defaults = config_manager_->span_defaults();
-  auto span_data = std::make_unique<SpanData>();
-  span_data->apply_config(*defaults, config, clock_);
+  return create_span_with_config(config);
+}
+
+Span Tracer::create_span(const SpanConfigView& config) {
+  return create_span_with_config(config);
+}
+
+template <typename Config>
+Span Tracer::create_span_with_config(const Config& config) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::create_span);
+  auto context = this->context();
+  auto span_data = make_local_root(trace_arena_enabled_, memory_resource_);
+  span_data->apply_config(*context->defaults, context->span_limits, config,
+                          clock_);
   span_data->trace_id = generator_->trace_id(span_data->start);
   span_data->span_id = span_data->trace_id.low;
   span_data->parent_id = 0;
@@ -201,202 +822,61 @@ Span Tracer::create_span(const SpanConfig& config) {
   std::vector<std::pair<std::string, std::string>> trace_tags;
   if (span_data->trace_id.high) {
     trace_tags.emplace_back(tags::internal::trace_id_high,
-                            hex_padded(span_data->trace_id.high));
+                            trace_id_high_value(span_data->trace_id.high));
   }
 
   const auto span_data_ptr = span_data.get();
-  telemetry::counter::increment(metrics::tracer::trace_segments_created,
-                                {"new_continued:new"});
-  const auto segment = std::make_shared<TraceSegment>(
-      logger_, collector_, config_manager_->trace_sampler(), span_sampler_,
-      defaults, config_manager_, runtime_id_, injection_styles_, hostname_,
-      nullopt /* origin */, tags_header_max_size_, std::move(trace_tags),
-      nullopt /* sampling_decision */, nullopt /* additional_w3c_tracestate */,
-      nullopt /* additional_datadog_w3c_tracestate*/, std::move(span_data),
-      resource_renaming_mode_, tracing_enabled_);
-  Span span{span_data_ptr, segment,
-            [generator = generator_]() { return generator->span_id(); },
-            clock_};
+  static const auto segments_created = telemetry::counter::handle(
+      metrics::tracer::trace_segments_created, {"new_continued:new"});
+  segments_created.increment();
+  auto segment = std::allocate_shared<TraceSegment>(
+      PoolAllocator<TraceSegment>{}, std::move(context), nullopt /* origin */,
+      std::move(trace_tags), nullopt /* sampling_decision */,
+      nullopt /* additional_w3c_tracestate */,
+      nullopt /* additional_datadog_w3c_tracestate*/, std::move(span_data));
+  Span span{span_data_ptr, std::move(segment)};
   return span;
 }
 
 Expected<Span> Tracer::extract_span(const DictReader& reader) {
-  return extract_span(reader, SpanConfig{});
+  return extract_span(reader, SpanConfigView{});
 }
 
 Expected<Span> Tracer::extract_span(const DictReader& reader,
                                     const SpanConfig& config) {
-  assert(!extraction_styles_.empty());
-
-  AuditedReader audited_reader{reader};
-
-  auto span_data = std::make_unique<SpanData>();
-  Optional<PropagationStyle> first_style_with_trace_id;
-  Optional<PropagationStyle> first_style_with_parent_id;
-  std::unordered_map<PropagationStyle, ExtractedData> extracted_contexts;
-
-  for (const auto style : extraction_styles_) {
-    using Extractor = decltype(&extract_datadog);  // function pointer
-    Extractor extract;
-    std::string extracted_tag;  ///< for telemetry
-    switch (style) {
-      case PropagationStyle::DATADOG:
-        extract = &extract_datadog;
-        extracted_tag = "header_style:datadog";
-        break;
-      case PropagationStyle::B3:
-        extract = &extract_b3;
-        extracted_tag = "header_style:b3multi";
-        break;
-      case PropagationStyle::W3C:
-        extract = &extract_w3c;
-        extracted_tag = "header_style:tracecontext";
-        break;
-      default:
-        extract = &extract_none;
-        extracted_tag = "header_style:none";
-    }
-    audited_reader.entries_found.clear();
-    auto data = extract(audited_reader, span_data->tags, *logger_);
-    if (auto* error = data.if_error()) {
-      return error->with_prefix(
-          extraction_error_prefix(style, audited_reader.entries_found));
-    }
-
-    telemetry::counter::increment(metrics::tracer::trace_context::extracted,
-                                  {extracted_tag});
-
-    if (!first_style_with_trace_id && data->trace_id.has_value()) {
-      first_style_with_trace_id = style;
-    }
-
-    if (!first_style_with_parent_id && data->parent_id.has_value()) {
-      first_style_with_parent_id = style;
-    }
-
-    data->headers_examined = audited_reader.entries_found;
-    extracted_contexts.emplace(style, std::move(*data));
-  }
-
-  ExtractedData merged_context;
-  if (!first_style_with_trace_id) {
-    // Nothing extracted a trace ID. Return the first context that includes a
-    // parent ID, if any, or otherwise just return an empty `ExtractedData`.
-    // The purpose of looking for a parent ID is to allow for the error
-    // "extracted a parent ID without a trace ID," if that's what happened.
-    if (first_style_with_parent_id) {
-      auto other = extracted_contexts.find(*first_style_with_parent_id);
-      assert(other != extracted_contexts.end());
-      merged_context = other->second;
-    }
-  } else {
-    merged_context = merge(*first_style_with_trace_id, extracted_contexts);
-  }
-
-  // Some information might be missing.
-  // Here are the combinations considered:
-  //
-  // - no trace ID and no parent ID
-  //     - this means there's no span to extract
-  // - parent ID and no trace ID
-  //     - error
-  // - trace ID and no parent ID
-  //     - if origin is set, then we're extracting a root span
-  //         - the idea is that "synthetics" might have started a trace without
-  //           producing a root span
-  //     - if origin is _not_ set, then it's an error
-  // - trace ID and parent ID means we're extracting a child span
-  // - if trace ID is zero, then that's an error.
-
-  if (!merged_context.trace_id && !merged_context.parent_id) {
-    return Error{Error::NO_SPAN_TO_EXTRACT,
-                 "There's neither a trace ID nor a parent span ID to extract."}
-        .with_prefix(extraction_error_prefix(merged_context.style,
-                                             merged_context.headers_examined));
-  }
-  if (!merged_context.trace_id) {
-    std::string message;
-    message +=
-        "There's no trace ID to extract, but there is a parent span ID: ";
-    message += std::to_string(*merged_context.parent_id);
-    return Error{Error::MISSING_TRACE_ID, std::move(message)}.with_prefix(
-        extraction_error_prefix(merged_context.style,
-                                merged_context.headers_examined));
-  }
-  if (!merged_context.parent_id && !merged_context.origin) {
-    std::string message;
-    message +=
-        "There's no parent span ID to extract, but there is a trace ID: ";
-    message += "[hexadecimal = ";
-    message += merged_context.trace_id->hex_padded();
-    if (merged_context.trace_id->high == 0) {
-      message += ", decimal = ";
-      message += std::to_string(merged_context.trace_id->low);
-    }
-    message += ']';
-    return Error{Error::MISSING_PARENT_SPAN_ID, std::move(message)}.with_prefix(
-        extraction_error_prefix(merged_context.style,
-                                merged_context.headers_examined));
-  }
+  PropagationHeaders headers{reader, finalized_config_->header_tags.get()};
+  return extract_span_with_config(headers, config, true);
+}
 
-  if (!merged_context.parent_id) {
-    // We have a trace ID, but not parent ID.  We're meant to be the root, and
-    // whoever called us already created a trace ID for us (to correlate with
-    // whatever they're doing).
-    merged_context.parent_id = 0;
-  }
+Expected<Span> Tracer::extract_span(const DictReader& reader,
+                                    const SpanConfigView& config) {
+  PropagationHeaders headers{reader, finalized_config_->header_tags.get()};
+  return extract_span_with_config(headers, config, true);
+}
 
-  assert(merged_context.parent_id);
-  assert(merged_context.trace_id);
+template <typename Config>
+Expected<Span> Tracer::extract_span_with_config(PropagationHeaders& headers,
+                                                const Config& config,
+                                                bool describe_errors) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::extract_span);
 
-  if (*merged_context.trace_id == 0) {
-    return Error{Error::ZERO_TRACE_ID,
-                 "extracted zero value for trace ID, which is invalid"}
-        .with_prefix(extraction_error_prefix(merged_context.style,
-                                             merged_context.headers_examined));
+  auto span_data = make_local_root(trace_arena_enabled_, memory_resource_);
+  auto extracted = extract_context(extraction_styles_, headers,
+                                   span_data->tags, *logger_, describe_errors);
+  if (auto* error = extracted.if_error()) {
+    return std::move(*error);
   }
+  ExtractedData& merged_context = *extracted;
 
   // We're done extracting fields.  Now create the span.
   // This is similar to what we do in `create_span`.
-  span_data->apply_config(*config_manager_->span_defaults(), config, clock_);
+  auto context = this->context();
+  span_data->apply_config(*context->defaults, context->span_limits, config,
+                          clock_);
   span_data->span_id = generator_->span_id();
   span_data->trace_id = *merged_context.trace_id;
   span_data->parent_id = *merged_context.parent_id;
 
-  if (span_data->trace_id.high) {
-    // The trace ID has some bits set in the higher 64 bits. Set the
-    // corresponding `trace_id_high` tag, so that the Datadog backend is aware
-    // of those bits.
-    //
-    // First, though, if the `trace_id_high` tag is already set and has a
-    // bogus value or a value inconsistent with the trace ID, tag an error.
-    const auto hex_high = hex_padded(span_data->trace_id.high);
-    const auto extant =
-        std::find_if(merged_context.trace_tags.begin(),
-                     merged_context.trace_tags.end(), [&](const auto& pair) {
-                       return pair.first == tags::internal::trace_id_high;
-                     });
-    if (extant == merged_context.trace_tags.end()) {
-      merged_context.trace_tags.emplace_back(tags::internal::trace_id_high,
-                                             hex_high);
-    } else {
-      // There is already a `trace_id_high` tag. `hex_high` is its proper
-      // value. Check if the extant value is malformed or different from
-      // `hex_high`. In either case, tag an error and overwrite the tag with
-      // `hex_high`.
-      const Optional<std::uint64_t> high = parse_trace_id_high(extant->second);
-      if (!high) {
-        span_data->tags[tags::internal::propagation_error] =
-            "malformed_tid " + extant->second;
-        extant->second = hex_high;
-      } else if (*high != span_data->trace_id.high) {
-        span_data->tags[tags::internal::propagation_error] =
-            "inconsistent_tid " + extant->second;
-        extant->second = hex_high;
-      }
-    }
-  }
-
   if (merged_context.datadog_w3c_parent_id) {
     span_data->tags[tags::internal::w3c_parent_id] =
         *merged_context.datadog_w3c_parent_id;
@@ -419,7 +899,7 @@ Expected<Span> Tracer::extract_span(const DictReader& reader,
   // decision is intentionally ignored, and the tracer is expected to make its
   // own decision in accordance with the locally enabled product configuration.
   Optional<SamplingDecision> sampling_decision;
-  if (tracing_enabled_ && merged_context.sampling_priority) {
+  if (context->tracing_enabled && merged_context.sampling_priority) {
     SamplingDecision decision;
     decision.priority = *merged_context.sampling_priority;
     // `decision.mechanism` is null.  We might be able to infer it once we
@@ -430,41 +910,260 @@ Expected<Span> Tracer::extract_span(const DictReader& reader,
   }
 
   const auto span_data_ptr = span_data.get();
-  telemetry::counter::increment(metrics::tracer::trace_segments_created,
-                                {"new_continued:continued"});
-  const auto segment = std::make_shared<TraceSegment>(
-      logger_, collector_, config_manager_->trace_sampler(), span_sampler_,
-      config_manager_->span_defaults(), config_manager_, runtime_id_,
-      injection_styles_, hostname_, std::move(merged_context.origin),
-      tags_header_max_size_, std::move(merged_context.trace_tags),
-      std::move(sampling_decision),
+  static const auto segments_created = telemetry::counter::handle(
+      metrics::tracer::trace_segments_created, {"new_continued:continued"});
+  segments_created.increment();
+  auto segment = std::allocate_shared<TraceSegment>(
+      PoolAllocator<TraceSegment>{}, std::move(context),
+      std::move(merged_context.origin),
+      std::move(merged_context.trace_tags), std::move(sampling_decision),
       std::move(merged_context.additional_w3c_tracestate),
       std::move(merged_context.additional_datadog_w3c_tracestate),
-      std::move(span_data), resource_renaming_mode_, tracing_enabled_);
-  Span span{span_data_ptr, segment,
-            [generator = generator_]() { return generator->span_id(); },
-            clock_};
+      std::move(span_data));
+  Span span{span_data_ptr, std::move(segment)};
+  headers.set_header_tags(span);
+  set_baggage_tags(headers, span);
   return span;
 }
 
 Span Tracer::extract_or_create_span(const DictReader& reader) {
-  return extract_or_create_span(reader, SpanConfig{});
+  return extract_or_create_span(reader, SpanConfigView{});
 }
 
 Span Tracer::extract_or_create_span(const DictReader& reader,
                                     const SpanConfig& config) {
-  auto maybe_span = extract_span(reader, config);
+  return extract_or_create_span_with_config(reader, config);
+}
+
+Span Tracer::extract_or_create_span(const DictReader& reader,
+                                    const SpanConfigView& config) {
+  return extract_or_create_span_with_config(reader, config);
+}
+
+template <typename Config>
+Span Tracer::extract_or_create_span_with_config(const DictReader& reader,
+                                                const Config& config) {
+  // The headers read for extraction also tag a new trace's root span.
+  PropagationHeaders headers{reader, finalized_config_->header_tags.get()};
+  auto maybe_span = extract_span_with_config(headers, config, false);
   if (maybe_span) {
     return std::move(*maybe_span);
   }
-  return create_span(config);
+  Span span = create_span_with_config(config);
+  headers.set_header_tags(span);
+  set_baggage_tags(headers, span);
+  return span;
+}
+
+Expected<std::uint64_t> Tracer::propagate(const DictReader& reader,
+                                          DictWriter& writer,
+                                          bool new_parent_id) {
+  DD_SELF_PROFILE(metrics::tracer::self_profiling::extract_span);
+  PropagationHeaders headers{reader};
+  // Extraction might tag the span with an error.  There is no span, so the
+  // tags are discarded.
+  SpanTags span_tags;
+  auto extracted = extract_context(extraction_styles_, headers, span_tags,
+                                   *logger_, true);
+  if (auto* error = extracted.if_error()) {
+    return std::move(*error);
+  }
+  const ExtractedData& data = *extracted;
+  const TraceID trace_id = *data.trace_id;
+  // A context having an origin but no parent ID, e.g. from Synthetics, is
+  // given a parent ID, since zero is not a valid one.
+  const std::uint64_t parent_id = new_parent_id || *data.parent_id == 0
+                                      ? generator_->span_id()
+                                      : *data.parent_id;
+
+  const auto context = this->context();
+  const std::vector<PropagationStyle>& injection_styles =
+      context->injection_styles;
+  if (injection_styles.size() == 1 &&
+      injection_styles[0] == PropagationStyle::NONE) {
+    return parent_id;
+  }
+
+  // As in `TraceSegment::inject`, the values are formatted into buffers that
+  // are reused by later calls on this thread.
+  thread_local std::string datadog_tags;
+  datadog_tags.clear();
+  const TraceTagsView trace_tags{&data.trace_tags};
+  const std::size_t tags_size =
+      append_tags(datadog_tags, trace_tags, context->tags_header_max_size);
+  if (tags_size > context->tags_header_max_size) {
+    std::string message;
+    message +=
+        "Serialized x-datadog-tags header value is too large.  The configured "
+        "maximum size is ";
+    message += std::to_string(context->tags_header_max_size);
+    message += " bytes, but the encoded value is ";
+    message += std::to_string(tags_size);
+    message += " bytes.";
+    logger_->log_error(message);
+  }
+
+  thread_local std::string buffer;
+  buffer.clear();
+  // Write the formatted value to the header having the specified `name`.
+  const auto write = [&](StringView name) {
+    writer.set(name, buffer);
+    buffer.clear();
+  };
+  const auto write_origin_and_tags = [&]() {
+    if (data.origin) {
+      writer.set("x-datadog-origin", *data.origin);
+    }
+    if (!datadog_tags.empty()) {
+      writer.set("x-datadog-tags", datadog_tags);
+    }
+  };
+
+  for (const auto style : injection_styles) {
+    switch (style) {
+      case PropagationStyle::DATADOG:
+        append_decimal(buffer, trace_id.low);
+        write("x-datadog-trace-id");
+        append_decimal(buffer, parent_id);
+        write("x-datadog-parent-id");
+        if (data.sampling_priority) {
+          append_decimal(buffer, *data.sampling_priority);
+          write("x-datadog-sampling-priority");
+        }
+        write_origin_and_tags();
+        break;
+      case PropagationStyle::B3:
+        if constexpr (b3_propagation_built) {
+          if (trace_id.high) {
+            append_hex_padded(buffer, trace_id.high);
+          }
+          append_hex_padded(buffer, trace_id.low);
+          write("x-b3-traceid");
+          append_hex_padded(buffer, parent_id);
+          write("x-b3-spanid");
+          if (data.sampling_priority) {
+            buffer += *data.sampling_priority > 0 ? '1' : '0';
+            write("x-b3-sampled");
+          }
+          write_origin_and_tags();
+        }
+        break;
+      case PropagationStyle::W3C:
+        // The "traceparent" header cannot defer the sampling decision.
+        if (data.sampling_priority) {
+          append_traceparent(buffer, trace_id, parent_id,
+                             *data.sampling_priority);
+          write("traceparent");
+          append_tracestate(buffer, parent_id, *data.sampling_priority,
+                            data.origin, trace_tags,
+                            data.additional_datadog_w3c_tracestate,
+                            data.additional_w3c_tracestate);
+          write("tracestate");
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return parent_id;
+}
+
+void Tracer::set_baggage_tags(const DictReader& reader, Span& span) const {
+  const BaggageTags* const baggage_tags = finalized_config_->baggage_tags.get();
+  if (!baggage_built || !baggage_extraction_enabled_ || !baggage_tags) {
+    return;
+  }
+  if (const auto header = reader.lookup("baggage")) {
+    // A malformed header is counted when the baggage is extracted.
+    (void)baggage_tags->set_tags(*header, span);
+  }
+}
+
+Expected<TraceID> Tracer::import_spans(const std::vector<ImportedSpan>& spans) {
+  return import_spans(spans.data(), spans.size());
+}
+
+Expected<TraceID> Tracer::import_spans(const ImportedSpan* spans,
+                                       std::size_t count) {
+  if (count == 0) {
+    return Error{Error::TRACER_INVALID_IMPORTED_SPANS,
+                 "There are no spans to import."};
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::size_t parent = spans[i].parent_index;
+    if ((i == 0) != (parent == ImportedSpan::no_parent) ||
+        (i != 0 && parent >= i)) {
+      std::string message;
+      message += "The imported span at index ";
+      message += std::to_string(i);
+      message += i == 0 ? " is the root, and so must not have a parent."
+                        : " must have a parent that precedes it.";
+      return Error{Error::TRACER_INVALID_IMPORTED_SPANS, std::move(message)};
+    }
+  }
+
+  auto context = this->context();
+  // The spans share one arena, whether or not trace segments otherwise have
+  // arenas, so that they are allocated together.
+  Arena* arena = Arena::create(memory_resource_);
+  const auto make_span = [&](const ImportedSpan& imported) {
+    auto span_data = SpanData::make(arena);
+    span_data->apply_config(*context->defaults, context->span_limits,
+                            imported.config, clock_);
+    span_data->duration = imported.duration;
+    span_data->error = imported.error;
+    return span_data;
+  };
+
+  auto root = make_span(spans[0]);
+  root->trace_id = generator_->trace_id(root->start);
+  root->span_id = root->trace_id.low;
+  root->parent_id = 0;
+  const TraceID trace_id = root->trace_id;
+
+  std::vector<std::pair<std::string, std::string>> trace_tags;
+  if (trace_id.high) {
+    trace_tags.emplace_back(tags::internal::trace_id_high,
+                            trace_id_high_value(trace_id.high));
+  }
+
+  std::vector<std::unique_ptr<SpanData>> children;
+  children.reserve(count - 1);
+  const auto span_id = [&](std::size_t index) {
+    return index == 0 ? trace_id.low : children[index - 1]->span_id;
+  };
+  static const auto segments_created = telemetry::counter::handle(
+      metrics::tracer::trace_segments_created, {"new_continued:new"});
+  segments_created.increment();
+  // The segment shares `context` with `make_span`, which makes the children.
+  auto segment = std::allocate_shared<TraceSegment>(
+      PoolAllocator<TraceSegment>{}, context, nullopt /* origin */,
+      std::move(trace_tags), nullopt /* sampling_decision */,
+      nullopt /* additional_w3c_tracestate */,
+      nullopt /* additional_datadog_w3c_tracestate*/, std::move(root));
+
+  // Spans that the segment would discard are not made at all.
+  if (!segment->skips_new_spans()) {
+    for (std::size_t i = 1; i < count; ++i) {
+      auto child = make_span(spans[i]);
+      child->trace_id = trace_id;
+      child->parent_id = span_id(spans[i].parent_index);
+      child->span_id = segment->generate_span_id();
+      children.push_back(std::move(child));
+    }
+  }
+  arena->release();
+  segment->finish_imported(std::move(children));
+  return trace_id;
 }
 
 Baggage Tracer::create_baggage() { return Baggage(baggage_opts_.max_items); }
 
 Expected<Baggage, Baggage::Error> Tracer::extract_baggage(
     const DictReader& reader) {
-  if (!baggage_extraction_enabled_) {
+  // A library built without baggage support compiles out the rest.
+  if (!baggage_built || !baggage_extraction_enabled_) {
     return Baggage::Error{Baggage::Error::DISABLED};
   }
 
@@ -491,7 +1190,7 @@ Baggage Tracer::extract_or_create_baggage(const DictReader& reader) {
 }
 
 Expected<void> Tracer::inject(const Baggage& baggage, DictWriter& writer) {
-  if (!baggage_injection_enabled_) {
+  if (!baggage_built || !baggage_injection_enabled_) {
     // TODO(@dmehala): update `Expected` to support `<void, Error>`
     return Error{Error::Code::OTHER, "Baggage propagation is disabled"};
   }
@@ -502,13 +1201,21 @@ Expected<void> Tracer::inject(const Baggage& baggage, DictWriter& writer) {
         err->with_prefix("failed to serialize all baggage items: "));
 
     if (err->code == Error::Code::BAGGAGE_MAXIMUM_BYTES_REACHED) {
-      telemetry::counter::increment(
-          metrics::tracer::trace_context::truncated,
-          {"truncation_reason:baggage_byte_count_exceeded"});
+      const std::vector<std::string> tags{
+          "truncation_reason:baggage_byte_count_exceeded"};
+      telemetry::counter::increment(metrics::tracer::trace_context::truncated,
+                                    tags);
+      telemetry::distribution::add(
+          metrics::tracer::trace_context::truncated_header_bytes, tags,
+          baggage.encoded_size());
     } else if (err->code == Error::Code::BAGGAGE_MAXIMUM_ITEMS_REACHED) {
-      telemetry::counter::increment(
-          metrics::tracer::trace_context::truncated,
-          {"truncation_reason:baggage_item_count_exceeded"});
+      const std::vector<std::string> tags{
+          "truncation_reason:baggage_item_count_exceeded"};
+      telemetry::counter::increment(metrics::tracer::trace_context::truncated,
+                                    tags);
+      telemetry::distribution::add(
+          metrics::tracer::trace_context::truncated_header_bytes, tags,
+          baggage.encoded_size());
     } else {
       telemetry::counter::increment(metrics::tracer::trace_context::injected,
                                     {"header_style:baggage"});
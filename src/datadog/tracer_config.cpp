@@ -4,11 +4,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "baggage_tags.h"
+#include "build_features.h"
 #include "datadog_agent.h"
+#include "header_tags.h"
 #include "json.hpp"
 #include "null_logger.h"
 #include "parse_util.h"
@@ -143,6 +148,23 @@ Expected<TracerConfig> load_tracer_env_config(Logger &logger) {
         !falsy(*resource_renaming_always_simplified_endpoint_env);
   }
 
+  if (auto partial_flush_env =
+          lookup(environment::DD_TRACE_PARTIAL_FLUSH_ENABLED)) {
+    env_cfg.partial_flush_enabled = !falsy(*partial_flush_env);
+  }
+  if (auto min_spans_env =
+          lookup(environment::DD_TRACE_PARTIAL_FLUSH_MIN_SPANS)) {
+    auto maybe_value = parse_uint64(*min_spans_env, 10);
+    if (auto *error = maybe_value.if_error()) {
+      std::string prefix;
+      prefix += "Unable to parse ";
+      append(prefix, name(environment::DD_TRACE_PARTIAL_FLUSH_MIN_SPANS));
+      prefix += " environment variable: ";
+      return error->with_prefix(prefix);
+    }
+    env_cfg.partial_flush_min_spans = *maybe_value;
+  }
+
   // Baggage
   if (auto baggage_items_env =
           lookup(environment::DD_TRACE_BAGGAGE_MAX_ITEMS)) {
@@ -321,9 +343,11 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
       ConfigName::TAGS, join_tags(final_config.defaults.tags), origin);
 
   // Extraction Styles
-  const std::vector<PropagationStyle> default_propagation_styles{
-      PropagationStyle::DATADOG, PropagationStyle::W3C,
-      PropagationStyle::BAGGAGE};
+  std::vector<PropagationStyle> default_propagation_styles{
+      PropagationStyle::DATADOG, PropagationStyle::W3C};
+  if constexpr (baggage_built) {
+    default_propagation_styles.push_back(PropagationStyle::BAGGAGE);
+  }
 
   std::tie(origin, final_config.extraction_styles) =
       pick(env_config->extraction_styles, user_config.extraction_styles,
@@ -348,6 +372,20 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
       ConfigName::INJECTION_STYLES,
       join_propagation_styles(final_config.injection_styles), origin);
 
+  for (const auto *styles :
+       {&final_config.extraction_styles, &final_config.injection_styles}) {
+    for (const PropagationStyle style : *styles) {
+      if (!propagation_style_built(style)) {
+        std::string message = "The ";
+        append(message, to_string_view(style));
+        message +=
+            " propagation style is configured, but this library was built "
+            "without support for it.";
+        return Error{Error::PROPAGATION_STYLE_UNAVAILABLE, std::move(message)};
+      }
+    }
+  }
+
   // Startup Logs
   std::tie(origin, final_config.log_on_startup) =
       pick(env_config->log_on_startup, user_config.log_on_startup, true);
@@ -415,6 +453,122 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
 
   final_config.process_tags = user_config.process_tags;
 
+  final_config.memory_resource = user_config.memory_resource;
+  final_config.trace_arena_enabled =
+      user_config.trace_arena_enabled.value_or(false) ||
+      final_config.memory_resource != nullptr;
+  final_config.obfuscation_enabled =
+      user_config.obfuscation_enabled.value_or(false);
+
+  if (!user_config.header_tags.empty()) {
+    auto header_tags = HeaderTags::compile(user_config.header_tags);
+    if (auto *error = header_tags.if_error()) {
+      return std::move(*error);
+    }
+    final_config.header_tags =
+        std::make_shared<const HeaderTags>(std::move(*header_tags));
+  }
+
+  if (!user_config.baggage_tag_keys.empty()) {
+    auto baggage_tags = BaggageTags::compile(user_config.baggage_tag_keys);
+    if (auto *error = baggage_tags.if_error()) {
+      return std::move(*error);
+    }
+    final_config.baggage_tags =
+        std::make_shared<const BaggageTags>(std::move(*baggage_tags));
+  }
+
+  // Partial flush
+  bool partial_flush_enabled;
+  std::tie(origin, partial_flush_enabled) =
+      pick(env_config->partial_flush_enabled, user_config.partial_flush_enabled,
+           false);
+  final_config.metadata[ConfigName::TRACE_PARTIAL_FLUSH_ENABLED] =
+      ConfigMetadata(ConfigName::TRACE_PARTIAL_FLUSH_ENABLED,
+                     to_string(partial_flush_enabled), origin);
+
+  std::size_t partial_flush_min_spans;
+  std::tie(origin, partial_flush_min_spans) =
+      pick(env_config->partial_flush_min_spans,
+           user_config.partial_flush_min_spans, 1000);
+  if (partial_flush_min_spans == 0) {
+    return Error{Error::INVALID_PARTIAL_FLUSH_MIN_SPANS,
+                 "The minimum number of spans for a partial flush must be "
+                 "positive."};
+  }
+  final_config.metadata[ConfigName::TRACE_PARTIAL_FLUSH_MIN_SPANS] =
+      ConfigMetadata(ConfigName::TRACE_PARTIAL_FLUSH_MIN_SPANS,
+                     std::to_string(partial_flush_min_spans), origin);
+  final_config.partial_flush_min_spans =
+      partial_flush_enabled ? partial_flush_min_spans : 0;
+
+  final_config.early_sampling_decision =
+      user_config.early_sampling_decision.value_or(false);
+  final_config.max_spans_per_trace_segment =
+      user_config.max_spans_per_trace_segment.value_or(0);
+  final_config.max_bytes_per_trace_segment =
+      user_config.max_bytes_per_trace_segment.value_or(0);
+  for (const SpanRollup& rollup : user_config.span_rollups) {
+    if (rollup.name.empty()) {
+      return Error{Error::TRACER_INVALID_SPAN_ROLLUPS,
+                   "Each span rollup must have an operation name."};
+    }
+  }
+  final_config.span_rollups = user_config.span_rollups;
+  final_config.max_resource_length =
+      user_config.max_resource_length.value_or(0);
+  final_config.max_tag_value_length =
+      user_config.max_tag_value_length.value_or(0);
+  final_config.max_memory_bytes = user_config.max_memory_bytes.value_or(0);
+  final_config.max_cpu_overhead = user_config.max_cpu_overhead.value_or(0);
+  if (!(final_config.max_cpu_overhead >= 0 &&
+        final_config.max_cpu_overhead <= 1)) {
+    return Error{Error::TRACER_INVALID_MAX_CPU_OVERHEAD,
+                 "The maximum CPU overhead must be between 0 and 1."};
+  }
+
+  final_config.tail_sampling_enabled =
+      user_config.tail_sampling_enabled.value_or(false);
+  const int tail_sampling_window_milliseconds =
+      user_config.tail_sampling_window_milliseconds.value_or(1000);
+  if (tail_sampling_window_milliseconds <= 0) {
+    return Error{Error::TAIL_SAMPLING_INVALID_WINDOW,
+                 "The tail sampling window must be a positive number of "
+                 "milliseconds."};
+  }
+  final_config.tail_sampling_window =
+      std::chrono::milliseconds(tail_sampling_window_milliseconds);
+  final_config.tail_sampling_max_buffered_bytes =
+      user_config.tail_sampling_max_buffered_bytes.value_or(4 * 1024 * 1024);
+  if (final_config.tail_sampling_max_buffered_bytes == 0) {
+    return Error{Error::TAIL_SAMPLING_INVALID_BUFFER_LIMIT,
+                 "The tail sampling buffer limit must be positive."};
+  }
+  final_config.tail_sampling_latency_percentile =
+      user_config.tail_sampling_latency_percentile.value_or(99);
+  if (!(final_config.tail_sampling_latency_percentile >= 0 &&
+        final_config.tail_sampling_latency_percentile <= 100)) {
+    return Error{Error::TAIL_SAMPLING_INVALID_PERCENTILE,
+                 "The tail sampling latency percentile must be between 0 and "
+                 "100."};
+  }
+  final_config.tail_sampling_max_per_second =
+      user_config.tail_sampling_max_per_second.value_or(10);
+  if (!(final_config.tail_sampling_max_per_second >= 0)) {
+    return Error{Error::TAIL_SAMPLING_INVALID_RATE,
+                 "The tail sampling limit per second must not be negative."};
+  }
+
+  const int orphaned_segment_max_age_seconds =
+      user_config.orphaned_segment_max_age_seconds.value_or(0);
+  if (orphaned_segment_max_age_seconds < 0) {
+    return Error{Error::ORPHANED_SEGMENT_INVALID_MAX_AGE,
+                 "The maximum age of orphaned trace segments must not be "
+                 "negative."};
+  }
+  final_config.orphaned_segment_max_age =
+      std::chrono::seconds(orphaned_segment_max_age_seconds);
+
   auto agent_finalized =
       finalize_config(user_config.agent, final_config.logger, clock);
   if (auto *error = agent_finalized.if_error()) {
@@ -439,13 +593,16 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
   // agent url
   final_config.agent_url = agent_finalized->url;
 
+  final_config.default_event_scheduler = user_config.event_scheduler == nullptr;
   if (user_config.event_scheduler == nullptr) {
-    final_config.event_scheduler = std::make_shared<ThreadedEventScheduler>();
+    final_config.event_scheduler = ThreadedEventScheduler::shared_instance();
   } else {
     final_config.event_scheduler = user_config.event_scheduler;
   }
 
   final_config.http_client = agent_finalized->http_client;
+  final_config.default_http_client = agent_finalized->default_http_client;
+  final_config.process_id = get_process_id();
 
   // telemetry
   if (auto telemetry_final_config =
@@ -501,8 +658,12 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
 
   // Whether APM tracing is enabled. This affects whether the
   // "Datadog-Client-Computed-Stats: yes" header is sent with trace requests.
+  agent_finalized->client_obfuscation = final_config.obfuscation_enabled;
+
   if (!final_config.tracing_enabled) {
-    agent_finalized->stats_computation_enabled = !final_config.tracing_enabled;
+    agent_finalized->client_computed_stats = true;
+    // There are no APM stats to compute.
+    agent_finalized->stats_computation_enabled = false;
 
     // Overwrite the trace sampler configuration with a specific trace sampler
     // configuration which:
@@ -512,7 +673,36 @@ Expected<FinalizedTracerConfig> finalize_config(const TracerConfig &user_config,
         FinalizedTraceSamplerConfig::apm_tracing_disabled_config();
   }
 
-  if (!user_config.collector) {
+  if (!user_config.collector && user_config.intake.enabled.value_or(false)) {
+    auto intake_finalized =
+        finalize_config(user_config.intake, final_config.logger, clock);
+    if (auto *error = intake_finalized.if_error()) {
+      return std::move(*error);
+    }
+    final_config.collector = std::move(*intake_finalized);
+  } else if (!user_config.collector &&
+             user_config.otlp.enabled.value_or(false)) {
+    auto otlp_finalized =
+        finalize_config(user_config.otlp, final_config.logger, clock);
+    if (auto *error = otlp_finalized.if_error()) {
+      return std::move(*error);
+    }
+    final_config.collector = std::move(*otlp_finalized);
+  } else if (!user_config.collector &&
+             user_config.datagram.enabled.value_or(false)) {
+    auto datagram_finalized = finalize_config(user_config.datagram, clock);
+    if (auto *error = datagram_finalized.if_error()) {
+      return std::move(*error);
+    }
+    final_config.collector = std::move(*datagram_finalized);
+  } else if (!user_config.collector &&
+             user_config.recording.enabled.value_or(false)) {
+    auto recording_finalized = finalize_config(user_config.recording, clock);
+    if (auto *error = recording_finalized.if_error()) {
+      return std::move(*error);
+    }
+    final_config.collector = std::move(*recording_finalized);
+  } else if (!user_config.collector) {
     final_config.collector = *agent_finalized;
     final_config.metadata.merge(agent_finalized->metadata);
   } else {
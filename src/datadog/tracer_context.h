@@ -0,0 +1,111 @@
+#pragma once
+
+// This component provides a `struct`, `TracerContext`, that holds what a
+// `Tracer` shares with every `TraceSegment` that it creates: its collaborators,
+// such as the collector and the samplers, and the parts of its configuration
+// that trace segments use.
+//
+// A `Tracer` publishes its `TracerContext` as one immutable snapshot, so that
+// creating a trace segment copies one `shared_ptr` rather than each of the
+// collaborators and configuration values.  Remote configuration can change
+// the span defaults.  When it does, the tracer publishes a new snapshot the
+// next time that it creates a trace segment (see
+// `ConfigManager::span_defaults_version`).
+
+#include <datadog/clock.h>
+#include <datadog/http_endpoint_calculation_mode.h>
+#include <datadog/optional.h>
+#include <datadog/propagation_style.h>
+#include <datadog/tracer_config.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "span_data.h"
+
+namespace datadog {
+namespace tracing {
+
+class Collector;
+class ConfigManager;
+class DefaultIDGenerator;
+class HeaderTags;
+class IDGenerator;
+class Logger;
+class MemoryBudget;
+class ResourceLatencies;
+class SegmentRegistry;
+class SegmentTagsCache;
+class SharedTags;
+struct SpanDefaults;
+class SpanSampler;
+class TailSampler;
+class TraceSampler;
+
+struct TracerContext {
+  std::shared_ptr<Logger> logger;
+  std::shared_ptr<Collector> collector;
+  std::shared_ptr<TraceSampler> trace_sampler;
+  std::shared_ptr<SpanSampler> span_sampler;
+  std::shared_ptr<ConfigManager> config_manager;
+  // Null unless tail sampling is enabled.
+  std::shared_ptr<TailSampler> tail_sampler;
+  // The recent durations of local root spans, by service and resource.  Null
+  // if tracing is disabled.
+  std::shared_ptr<ResourceLatencies> resource_latencies;
+  // Gives the start and end times of spans.
+  Clock clock;
+  std::shared_ptr<const SpanDefaults> defaults;
+  // The `ConfigManager::span_defaults_version` of `defaults`.
+  std::uint64_t defaults_version = 0;
+  // Generates the IDs of the spans created in a segment after its local root.
+  std::shared_ptr<const IDGenerator> id_generator;
+  // `id_generator` if it is the default generator, so that span IDs are
+  // generated without a virtual call, or null otherwise.
+  const DefaultIDGenerator* default_id_generator = nullptr;
+  // The textual representation of the tracer's runtime ID.
+  std::string runtime_id;
+  // The tags that the spans of a segment having no origin have in common
+  // (see `make_segment_tags`), and the process ID among them.  A forked child
+  // process has another ID, and so builds its own.
+  std::shared_ptr<const SharedTags> shared_tags;
+  int shared_tags_process_id = 0;
+  // The tags that the spans of a segment having an origin have in common, for
+  // the most common origins.
+  std::shared_ptr<SegmentTagsCache> origin_tags;
+  std::vector<PropagationStyle> injection_styles;
+  Optional<std::string> hostname;
+  std::size_t tags_header_max_size = 0;
+  HttpEndpointCalculationMode resource_renaming_mode =
+      HttpEndpointCalculationMode::DISABLED;
+  // Whether spans are obfuscated before they are sent (see `obfuscation.h`).
+  bool obfuscation_enabled = false;
+  // The headers whose values become tags of spans, or null if there are none
+  // (see `header_tags.h`).
+  std::shared_ptr<const HeaderTags> header_tags;
+  bool tracing_enabled = true;
+  // Zero if partial flushing is disabled.
+  std::size_t partial_flush_min_spans = 0;
+  bool early_sampling_decision = false;
+  SpanLimits span_limits;
+  // Zero if not limited.
+  std::size_t max_spans_per_segment = 0;
+  std::size_t max_bytes_per_segment = 0;
+  // The child spans that are rolled up into summary spans, if any (see
+  // `TracerConfig::span_rollups`).
+  std::vector<SpanRollup> span_rollups;
+  // The number of trace segments created by the tracer that have not been
+  // destroyed (see `Tracer::runtime_stats`).
+  std::shared_ptr<std::atomic<std::size_t>> live_segments;
+  // Null unless orphaned trace segments are flushed.
+  std::shared_ptr<SegmentRegistry> segment_registry;
+  // Null unless the memory held in trace data is limited.
+  std::shared_ptr<MemoryBudget> memory_budget;
+};
+
+}  // namespace tracing
+}  // namespace datadog
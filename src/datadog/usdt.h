@@ -0,0 +1,49 @@
+#pragma once
+
+// This component provides a macro, `DD_USDT_PROBE`, that marks a point in the
+// life of spans, trace chunks, and requests as a USDT (user statically
+// defined tracing) probe, so that tools such as `bpftrace`, `perf`, and
+// SystemTap can observe the tracer in production without enabling its
+// logging or telemetry.
+//
+// `DD_USDT_PROBE(name, args...)` defines the probe `name` of the provider
+// `dd_trace_cpp`, whose arguments are the specified integer `args`.  A probe
+// that no tool is attached to costs a no-op instruction.  For example:
+//
+//     bpftrace -e 'usdt:/path/to/libdd_trace_cpp.so:dd_trace_cpp:flush__end
+//                  { @bytes = hist(arg0); }'
+//
+// The probes are:
+//
+// - `span__start(trace_id_low, span_id, parent_id)`
+// - `span__finish(trace_id_low, span_id, duration_ns)`
+// - `segment__finish(trace_id_low, span_count)`
+// - `sampling__decided(trace_id_low, priority, mechanism)`
+// - `chunk__enqueued(bytes, chunk_class)`
+// - `flush__begin(chunk_count, span_count)`
+// - `flush__end(chunk_count, body_bytes)`
+// - `http__done(status)`, where `status` is -1 if the request failed
+//
+// Probes are compiled in only if the `DD_TRACE_USDT` preprocessor macro is
+// defined (see the `DD_TRACE_USDT` CMake option) and `<sys/sdt.h>` is
+// available, as it is on Linux with the SystemTap SDT headers installed.
+// Otherwise, `DD_USDT_PROBE` expands to a statement that does nothing, and
+// its arguments are not evaluated.
+
+#if defined(DD_TRACE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define DD_TRACE_USDT_AVAILABLE
+#endif
+#endif
+
+#ifdef DD_TRACE_USDT_AVAILABLE
+
+#include <sys/sdt.h>
+
+#define DD_USDT_PROBE(...) STAP_PROBEV(dd_trace_cpp, __VA_ARGS__)
+
+#else
+
+#define DD_USDT_PROBE(...) static_cast<void>(0)
+
+#endif  // defined DD_TRACE_USDT_AVAILABLE
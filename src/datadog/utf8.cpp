@@ -0,0 +1,172 @@
+#include "utf8.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DD_UTF8_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DD_UTF8_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define DD_UTF8_NEON
+#endif
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// The UTF-8 encoding of U+FFFD, the replacement character.
+constexpr StringView replacement = "\xEF\xBF\xBD";
+
+// The number of bytes checked at once for ones that are not ASCII.
+constexpr std::size_t block_size = 32;
+
+// Return whether each of the `block_size` bytes at the specified `data` is
+// ASCII, i.e. has its high bit clear.
+bool is_ascii_block(const char* data) {
+#if defined(DD_UTF8_AVX2)
+  const __m256i bytes =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  return _mm256_movemask_epi8(bytes) == 0;
+#elif defined(DD_UTF8_SSE2)
+  const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  const __m128i high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+  return _mm_movemask_epi8(_mm_or_si128(low, high)) == 0;
+#elif defined(DD_UTF8_NEON)
+  const auto* bytes = reinterpret_cast<const std::uint8_t*>(data);
+  const uint8x16_t either = vorrq_u8(vld1q_u8(bytes), vld1q_u8(bytes + 16));
+  return vmaxvq_u8(either) < 0x80;
+#else
+  std::uint64_t words[block_size / sizeof(std::uint64_t)];
+  std::memcpy(words, data, sizeof words);
+  return ((words[0] | words[1] | words[2] | words[3]) &
+          0x8080808080808080ULL) == 0;
+#endif
+}
+
+// Return the length of the sequence that begins the specified `size` bytes
+// at the specified `data`, where `size` is not zero, and set the specified
+// `valid` to whether the sequence is well-formed.  The length of an
+// ill-formed sequence is that of its maximal subpart, which is at least one.
+std::size_t sequence_length(const unsigned char* data, std::size_t size,
+                            bool& valid) {
+  const unsigned char lead = data[0];
+  valid = true;
+  if (lead < 0x80) {
+    return 1;
+  }
+
+  // The range of the second byte depends on the first, so that overlong
+  // encodings, surrogates, and code points beyond U+10FFFF are ill-formed.
+  // See table 3-7 of the Unicode Standard.
+  std::size_t length;
+  unsigned char low = 0x80;
+  unsigned char high = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    if (lead == 0xE0) {
+      low = 0xA0;
+    } else if (lead == 0xED) {
+      high = 0x9F;
+    }
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    if (lead == 0xF0) {
+      low = 0x90;
+    } else if (lead == 0xF4) {
+      high = 0x8F;
+    }
+  } else {
+    valid = false;
+    return 1;
+  }
+
+  for (std::size_t i = 1; i < length; ++i) {
+    if (i == size || data[i] < low || data[i] > high) {
+      valid = false;
+      return i;
+    }
+    low = 0x80;
+    high = 0xBF;
+  }
+  return length;
+}
+
+}  // namespace
+
+std::size_t valid_utf8_prefix(StringView text) {
+  const auto* const data = reinterpret_cast<const unsigned char*>(text.data());
+  const std::size_t size = text.size();
+  std::size_t i = 0;
+  while (i < size) {
+    if (size - i >= block_size && is_ascii_block(text.data() + i)) {
+      i += block_size;
+      continue;
+    }
+    // Decode the characters of the block one at a time.  The last of them
+    // might extend past the block.
+    const std::size_t end = std::min(size, i + block_size);
+    while (i < end) {
+      if (data[i] < 0x80) {
+        ++i;
+        continue;
+      }
+      bool valid;
+      const std::size_t length = sequence_length(data + i, size - i, valid);
+      if (!valid) {
+        return i;
+      }
+      i += length;
+    }
+  }
+  return size;
+}
+
+std::size_t repaired_utf8_size(StringView text) {
+  const auto* const data = reinterpret_cast<const unsigned char*>(text.data());
+  std::size_t result = 0;
+  std::size_t i = 0;
+  for (;;) {
+    const std::size_t valid = valid_utf8_prefix(text.substr(i));
+    result += valid;
+    i += valid;
+    if (i == text.size()) {
+      return result;
+    }
+    bool ignored;
+    i += sequence_length(data + i, text.size() - i, ignored);
+    result += replacement.size();
+  }
+}
+
+char* repair_utf8(char* destination, StringView text) {
+  if (text.empty()) {
+    return destination;
+  }
+  const auto* const data = reinterpret_cast<const unsigned char*>(text.data());
+  std::size_t i = 0;
+  for (;;) {
+    const std::size_t valid = valid_utf8_prefix(text.substr(i));
+    std::memcpy(destination, text.data() + i, valid);
+    destination += valid;
+    i += valid;
+    if (i == text.size()) {
+      return destination;
+    }
+    bool ignored;
+    i += sequence_length(data + i, text.size() - i, ignored);
+    std::memcpy(destination, replacement.data(), replacement.size());
+    destination += replacement.size();
+  }
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,39 @@
+#pragma once
+
+// This component provides functions that validate UTF-8 and that repair text
+// that is not valid UTF-8.  The Datadog Agent rejects or mangles payloads
+// whose strings are not valid UTF-8, so the encoders of spans repair each
+// string as they write it (see `msgpack::Writer::repair_utf8`).
+//
+// Most strings in spans are ASCII.  `valid_utf8_prefix` checks 32 bytes at a
+// time for a byte that is not ASCII, with SSE2 or AVX2 on x86 and with NEON on
+// ARM, and with 64-bit words elsewhere.  Only the characters that are not
+// ASCII are decoded one at a time.
+//
+// Repairing replaces each maximal subpart of an ill-formed sequence with the
+// replacement character U+FFFD, as recommended by the Unicode Standard (see
+// "U+FFFD Substitution of Maximal Subparts" in chapter 3).
+
+#include <datadog/string_view.h>
+
+#include <cstddef>
+
+namespace datadog {
+namespace tracing {
+
+// Return the length of the longest prefix of the specified `text` that is
+// valid UTF-8.  `text` is valid UTF-8 if the result is `text.size()`.
+std::size_t valid_utf8_prefix(StringView text);
+
+// Return the size of the specified `text` once repaired by `repair_utf8`.
+// Return `text.size()` if `text` is valid UTF-8.
+std::size_t repaired_utf8_size(StringView text);
+
+// Write at the specified `destination` the specified `text` with each maximal
+// subpart of an ill-formed sequence replaced by U+FFFD, and return the end of
+// what was written.  `destination` must have room for
+// `repaired_utf8_size(text)` bytes, and must not overlap `text`.
+char* repair_utf8(char* destination, StringView text);
+
+}  // namespace tracing
+}  // namespace datadog
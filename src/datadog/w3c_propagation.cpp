@@ -11,6 +11,7 @@
 #include "hex.h"
 #include "parse_util.h"
 #include "string_util.h"
+#include "tag_propagation.h"
 #include "tags.h"
 
 namespace datadog {
@@ -124,17 +125,20 @@ handle_trace_flag:
   return nullopt;
 }
 
-// `struct PartiallyParsedTracestat` contains the separated Datadog-specific and
-// non-Datadog-specific portions of tracestate.
-struct PartiallyParsedTracestate {
+// `struct SplitTracestate` contains the separated Datadog-specific and
+// non-Datadog-specific portions of tracestate.  The non-Datadog-specific
+// portion is `before` followed by `after`.  All of the members refer to the
+// tracestate, so that nothing is copied unless it is kept.
+struct SplitTracestate {
   StringView datadog_value;
-  std::string other_entries;
+  StringView before;
+  StringView after;
 };
 
 // Return the separate Datadog-specific and non-Datadog-specific portions of the
 // specified `tracestate`. If `tracestate` does not have a Datadog-specific
 // portion, return `nullopt`.
-Optional<PartiallyParsedTracestate> parse_tracestate(StringView tracestate) {
+Optional<SplitTracestate> split_tracestate(StringView tracestate) {
   const std::size_t begin = 0;
   const std::size_t end = tracestate.size();
   std::size_t pair_begin = begin;
@@ -165,21 +169,21 @@ Optional<PartiallyParsedTracestate> parse_tracestate(StringView tracestate) {
       continue;
     }
 
-    PartiallyParsedTracestate result;
+    SplitTracestate result;
     result.datadog_value = pair.substr(kv_separator + 1);
-    // `result->other_entries` is whatever was before the "dd" entry and
-    // whatever is after the "dd" entry, but without an extra comma in the
-    // middle.
+    // The other entries are whatever was before the "dd" entry and whatever
+    // is after the "dd" entry, but without an extra comma in the middle.
+    const bool has_suffix = pair_end != StringView::npos && pair_end + 1 < end;
     if (pair_begin != 0) {
       // There's a prefix
-      append(result.other_entries, tracestate.substr(0, pair_begin - 1));
-      if (pair_end != StringView::npos && pair_end + 1 < end) {
+      result.before = tracestate.substr(0, pair_begin - 1);
+      if (has_suffix) {
         // and a suffix
-        append(result.other_entries, tracestate.substr(pair_end));
+        result.after = tracestate.substr(pair_end);
       }
-    } else if (pair_end != StringView::npos && pair_end + 1 < end) {
+    } else if (has_suffix) {
       // There's just a suffix
-      append(result.other_entries, tracestate.substr(pair_end + 1));
+      result.after = tracestate.substr(pair_end + 1);
     }
 
     return result;
@@ -187,6 +191,7 @@ Optional<PartiallyParsedTracestate> parse_tracestate(StringView tracestate) {
 
   return nullopt;
 }
+
 // Fill the specified `result` with information parsed from the specified
 // `datadog_value`. `datadog_value` is the value of the "dd" entry in the
 // "tracestate" header.
@@ -249,7 +254,10 @@ void parse_datadog_tracestate(ExtractedData& result, StringView datadog_value) {
       // The part of the key that follows "t." is the name of a trace tag,
       // except without the "_dd.p." prefix.
       const auto tag_suffix = key.substr(2);
-      std::string tag_name = "_dd.p.";
+      const StringView tag_prefix = "_dd.p.";
+      std::string tag_name;
+      tag_name.reserve(tag_prefix.size() + tag_suffix.size());
+      append(tag_name, tag_prefix);
       append(tag_name, tag_suffix);
       // The tag value was encoded with all '=' replaced by '~'.  Undo that
       // transformation.
@@ -272,41 +280,33 @@ void parse_datadog_tracestate(ExtractedData& result, StringView datadog_value) {
   }
 }
 
-// Fill the specified `result` with information parsed from the "tracestate"
-// element of the specified `headers`, if present.
-//
-// `extract_tracestate` populates the `additional_w3c_tracestate` field of
-// `ExtractedData`, in addition to those populated by
-// `parse_datadog_tracestate`.
-void extract_tracestate(ExtractedData& result, const DictReader& headers) {
-  const auto maybe_tracestate = headers.lookup("tracestate");
-  if (!maybe_tracestate || maybe_tracestate->empty()) {
+}  // namespace
+
+void parse_tracestate(ExtractedData& result, StringView tracestate) {
+  tracestate = trim(tracestate);
+  if (tracestate.empty()) {
     return;
   }
 
-  const auto tracestate = trim(*maybe_tracestate);
-  auto maybe_parsed = parse_tracestate(tracestate);
-  if (!maybe_parsed) {
+  const auto split = split_tracestate(tracestate);
+  if (!split) {
     // No "dd" entry in `tracestate`, so there's nothing to extract.
-    if (!tracestate.empty()) {
-      result.additional_w3c_tracestate = std::string{tracestate};
-    }
+    result.additional_w3c_tracestate = std::string{tracestate};
     return;
   }
 
-  auto& [datadog_value, other_entries] = *maybe_parsed;
-  if (!other_entries.empty()) {
-    result.additional_w3c_tracestate = std::move(other_entries);
+  if (!split->before.empty() || !split->after.empty()) {
+    auto& other_entries = result.additional_w3c_tracestate.emplace();
+    other_entries.reserve(split->before.size() + split->after.size());
+    append(other_entries, split->before);
+    append(other_entries, split->after);
   }
 
-  parse_datadog_tracestate(result, datadog_value);
+  parse_datadog_tracestate(result, split->datadog_value);
 }
 
-}  // namespace
-
-Expected<ExtractedData> extract_w3c(
-    const DictReader& headers,
-    std::unordered_map<std::string, std::string>& span_tags, Logger&) {
+Expected<ExtractedData> extract_w3c(const DictReader& headers,
+                                    SpanTags& span_tags, Logger&) {
   ExtractedData result;
   result.style = PropagationStyle::W3C;
 
@@ -329,7 +329,9 @@ Expected<ExtractedData> extract_w3c(
   }
 
   result.datadog_w3c_parent_id = "0000000000000000";
-  extract_tracestate(result, headers);
+  if (const auto tracestate = headers.lookup("tracestate")) {
+    parse_tracestate(result, *tracestate);
+  }
 
   return result;
 }
@@ -337,98 +339,118 @@ Expected<ExtractedData> extract_w3c(
 std::string encode_traceparent(TraceID trace_id, std::uint64_t span_id,
                                int sampling_priority) {
   std::string result;
+  append_traceparent(result, trace_id, span_id, sampling_priority);
+  return result;
+}
+
+void append_traceparent(std::string& destination, TraceID trace_id,
+                        std::uint64_t span_id, int sampling_priority) {
   // version
-  result += "00-";
+  destination += "00-";
 
   // trace ID
-  result += trace_id.hex_padded();
-  result += '-';
+  append_hex_padded(destination, trace_id.high);
+  append_hex_padded(destination, trace_id.low);
+  destination += '-';
 
   // span ID
-  result += hex_padded(span_id);
-  result += '-';
+  append_hex_padded(destination, span_id);
+  destination += '-';
 
   // flags
-  result += sampling_priority > 0 ? "01" : "00";
-
-  return result;
+  destination += sampling_priority > 0 ? "01" : "00";
 }
 
-std::string encode_datadog_tracestate(
-    uint64_t span_id, int sampling_priority,
-    const Optional<std::string>& origin,
-    const std::vector<std::pair<std::string, std::string>>& trace_tags,
+namespace {
+
+void append_datadog_tracestate(
+    std::string& destination, uint64_t span_id, int sampling_priority,
+    const Optional<std::string>& origin, TraceTagsView trace_tags,
     const Optional<std::string>& additional_datadog_w3c_tracestate) {
-  std::string result = "dd=s:";
-  result += std::to_string(sampling_priority);
-  result += ";p:";
-  result += hex_padded(span_id);
+  const std::size_t begin = destination.size();
+  destination += "dd=s:";
+  append_decimal(destination, sampling_priority);
+  destination += ";p:";
+  append_hex_padded(destination, span_id);
 
   if (origin) {
-    result += ";o:";
-    result += *origin;
-    std::replace_if(result.end() - origin->size(), result.end(),
+    destination += ";o:";
+    destination += *origin;
+    std::replace_if(destination.end() - origin->size(), destination.end(),
                     verboten(0x20, 0x7e, ",;~"), '_');
-    std::replace(result.end() - origin->size(), result.end(), '=', '~');
+    std::replace(destination.end() - origin->size(), destination.end(), '=',
+                 '~');
   }
 
-  for (const auto& [key, value] : trace_tags) {
+  trace_tags.for_each([&](StringView key, StringView value) {
     const StringView prefix = "_dd.p.";
     if (!starts_with(key, prefix) || key == tags::internal::trace_id_high) {
       // Either it's not a propagation tag, or it's one of the propagation tags
       // that need not be included in tracestate.
-      continue;
+      return;
     }
 
     // `key` is "_dd.p.<name>", but we want "t.<name>".
-    result += ";t.";
-    result.append(key, prefix.size());
-    std::replace_if(result.end() - (key.size() - prefix.size()), result.end(),
-                    verboten(0x20, 0x7e, " ,;="), '_');
-
-    result += ':';
-    result += value;
-    std::replace_if(result.end() - value.size(), result.end(),
+    destination += ";t.";
+    append(destination, key.substr(prefix.size()));
+    std::replace_if(destination.end() - (key.size() - prefix.size()),
+                    destination.end(), verboten(0x20, 0x7e, " ,;="), '_');
+
+    destination += ':';
+    append(destination, value);
+    std::replace_if(destination.end() - value.size(), destination.end(),
                     verboten(0x20, 0x7e, ",;~"), '_');
     // `value` might contain equal signs ("="), which is reserved in tracestate.
     // Replace them with tildes ("~").
-    std::replace(result.end() - value.size(), result.end(), '=', '~');
-  }
+    std::replace(destination.end() - value.size(), destination.end(), '=',
+                 '~');
+  });
 
   if (additional_datadog_w3c_tracestate) {
-    result += ';';
-    result += *additional_datadog_w3c_tracestate;
+    destination += ';';
+    destination += *additional_datadog_w3c_tracestate;
   }
 
   const std::size_t max_size = 256;
-  while (result.size() > max_size) {
-    const auto last_semicolon_index = result.rfind(';');
-    // This assumption is safe, because `result` always begins with
+  while (destination.size() - begin > max_size) {
+    const auto last_semicolon_index = destination.rfind(';');
+    // This assumption is safe, because the entry always begins with
     // "dd=s:<int>", and that's fewer than `max_size` characters for any
     // `<int>`.
-    assert(last_semicolon_index != std::string::npos);
-    result.resize(last_semicolon_index);
+    assert(last_semicolon_index != std::string::npos &&
+           last_semicolon_index > begin);
+    destination.resize(last_semicolon_index);
   }
-
-  return result;
 }
 
+}  // namespace
+
 std::string encode_tracestate(
     uint64_t span_id, int sampling_priority,
     const Optional<std::string>& origin,
     const std::vector<std::pair<std::string, std::string>>& trace_tags,
     const Optional<std::string>& additional_datadog_w3c_tracestate,
     const Optional<std::string>& additional_w3c_tracestate) {
-  std::string result =
-      encode_datadog_tracestate(span_id, sampling_priority, origin, trace_tags,
-                                additional_datadog_w3c_tracestate);
+  std::string result;
+  append_tracestate(result, span_id, sampling_priority, origin,
+                    TraceTagsView{&trace_tags},
+                    additional_datadog_w3c_tracestate,
+                    additional_w3c_tracestate);
+  return result;
+}
+
+void append_tracestate(
+    std::string& destination, uint64_t span_id, int sampling_priority,
+    const Optional<std::string>& origin, TraceTagsView trace_tags,
+    const Optional<std::string>& additional_datadog_w3c_tracestate,
+    const Optional<std::string>& additional_w3c_tracestate) {
+  append_datadog_tracestate(destination, span_id, sampling_priority, origin,
+                            trace_tags, additional_datadog_w3c_tracestate);
 
   if (additional_w3c_tracestate) {
-    result += ',';
-    result += *additional_w3c_tracestate;
+    destination += ',';
+    destination += *additional_w3c_tracestate;
   }
-
-  return result;
 }
 
 }  // namespace tracing
@@ -14,6 +14,8 @@
 #include <unordered_map>
 
 #include "extracted_data.h"
+#include "span_data.h"
+#include "tag_propagation.h"
 
 namespace datadog {
 namespace tracing {
@@ -26,9 +28,23 @@ class Logger;
 // `tags::internal::w3c_extraction_error` tag in the specified `span_tags`.
 // `extract_w3c` will not return an error; instead, it returns an empty
 // `ExtractedData` when extraction fails.
-Expected<ExtractedData> extract_w3c(
-    const DictReader& headers,
-    std::unordered_map<std::string, std::string>& span_tags, Logger&);
+Expected<ExtractedData> extract_w3c(const DictReader& headers,
+                                    SpanTags& span_tags, Logger&);
+
+// Fill the specified `result` with information parsed from the specified
+// value of the "tracestate" header.  `parse_tracestate` populates the
+// following `ExtractedData` fields:
+//
+// - `origin`
+// - `trace_tags`
+// - `sampling_priority`
+// - `datadog_w3c_parent_id`
+// - `additional_datadog_w3c_tracestate`
+// - `additional_w3c_tracestate`
+//
+// Only those fields refer to copies of parts of `tracestate`; the parsing
+// itself does not copy.
+void parse_tracestate(ExtractedData& result, StringView tracestate);
 
 // Return a value for the "traceparent" header consisting of the specified
 // `trace_id` or the optionally specified `full_w3c_trace_id_hex` as the trace
@@ -36,6 +52,10 @@ Expected<ExtractedData> extract_w3c(
 // the specified `sampling_priority`.
 std::string encode_traceparent(TraceID trace_id, std::uint64_t span_id,
                                int sampling_priority);
+// Append the "traceparent" value described above to the specified
+// `destination`.
+void append_traceparent(std::string& destination, TraceID trace_id,
+                        std::uint64_t span_id, int sampling_priority);
 
 // Return a value for the "tracestate" header containing the specified fields.
 std::string encode_tracestate(
@@ -44,6 +64,13 @@ std::string encode_tracestate(
     const std::vector<std::pair<std::string, std::string>>& trace_tags,
     const Optional<std::string>& additional_datadog_w3c_tracestate,
     const Optional<std::string>& additional_w3c_tracestate);
+// Append the "tracestate" value described above to the specified
+// `destination`.
+void append_tracestate(
+    std::string& destination, uint64_t span_id, int sampling_priority,
+    const Optional<std::string>& origin, TraceTagsView trace_tags,
+    const Optional<std::string>& additional_datadog_w3c_tracestate,
+    const Optional<std::string>& additional_w3c_tracestate);
 
 }  // namespace tracing
 }  // namespace datadog
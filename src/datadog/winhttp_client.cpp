@@ -0,0 +1,555 @@
+#include "winhttp_client.h"
+
+// clang-format off
+#include <windows.h>
+#include <winhttp.h>
+// clang-format on
+
+#include <datadog/dict_writer.h>
+#include <datadog/logger.h>
+#include <datadog/string_view.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "header_block_reader.h"
+#include "json.hpp"
+#include "parse_util.h"
+#include "string_util.h"
+
+namespace datadog {
+namespace tracing {
+namespace {
+
+// Response bytes are read in pieces of this size.
+constexpr DWORD read_size = 8192;
+
+std::wstring widen(StringView text) {
+  if (text.empty()) {
+    return std::wstring();
+  }
+  const int size = ::MultiByteToWideChar(CP_UTF8, 0, text.data(),
+                                         static_cast<int>(text.size()),
+                                         nullptr, 0);
+  std::wstring result(static_cast<std::size_t>(size), L'\0');
+  ::MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                        result.data(), size);
+  return result;
+}
+
+std::string narrow(const std::wstring& text) {
+  if (text.empty()) {
+    return std::string();
+  }
+  const int size = ::WideCharToMultiByte(CP_UTF8, 0, text.data(),
+                                         static_cast<int>(text.size()),
+                                         nullptr, 0, nullptr, nullptr);
+  std::string result(static_cast<std::size_t>(size), '\0');
+  ::WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                        result.data(), size, nullptr, nullptr);
+  return result;
+}
+
+// Return a message describing the specified WinHTTP or system `error`,
+// prefixed by the specified `what`.
+std::string error_message(StringView what, DWORD error) {
+  std::string message;
+  append(message, what);
+  message += ": ";
+  char* text = nullptr;
+  const DWORD length = ::FormatMessageA(
+      FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_HMODULE |
+          FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+      ::GetModuleHandleA("winhttp.dll"), error, 0,
+      reinterpret_cast<char*>(&text), 0, nullptr);
+  if (length == 0) {
+    message += "error ";
+    message += std::to_string(error);
+    return message;
+  }
+  message.append(text, length);
+  ::LocalFree(text);
+  while (!message.empty() &&
+         (message.back() == '\n' || message.back() == '\r')) {
+    message.pop_back();
+  }
+  return message;
+}
+
+// `HeaderWriter` appends request headers to a buffer, one line each.
+class HeaderWriter : public DictWriter {
+  std::string& headers_;
+
+ public:
+  explicit HeaderWriter(std::string& headers) : headers_(headers) {}
+
+  void set(StringView key, StringView value) override {
+    append(headers_, key);
+    headers_ += ": ";
+    append(headers_, value);
+    headers_ += "\r\n";
+  }
+};
+
+}  // namespace
+
+class WinHTTPClientImpl {
+  struct Request {
+    WinHTTPClientImpl* client;
+    HINTERNET handle = nullptr;
+    HTTPClient::BodySegments body;
+    // The index of the next body segment to write.
+    std::size_t segment = 0;
+    HTTPClient::ResponseHandler on_response;
+    HTTPClient::ErrorHandler on_error;
+    int status = -1;
+    // The response's status line and header lines.
+    std::string headers;
+    std::string response_body;
+    char buffer[read_size];
+    // Whether `handle` was closed.  Guarded by `client->mutex_`.
+    bool closed = false;
+  };
+
+  const std::shared_ptr<Logger> logger_;
+  Clock clock_;
+  HINTERNET session_;
+  std::mutex mutex_;
+  // Connection handles, by scheme and authority.  WinHTTP keeps the
+  // connections of each alive between requests.  Guarded by `mutex_`.
+  std::unordered_map<std::string, HINTERNET> connections_;
+  // Requests whose handle WinHTTP has not yet finished closing.  Guarded by
+  // `mutex_`.
+  std::unordered_set<Request*> requests_;
+  std::condition_variable no_requests_;
+  // Whether the client is being destroyed, so that callbacks other than
+  // handle closing are ignored.
+  std::atomic<bool> shutting_down_;
+  std::atomic<std::uint64_t> requests_sent_;
+
+  static void CALLBACK on_status(HINTERNET handle, DWORD_PTR context,
+                                 DWORD status, LPVOID info, DWORD length);
+  // Make progress on `request` given the specified WinHTTP `status` and its
+  // `info` and `length`.
+  void handle(Request& request, DWORD status, void* info, DWORD length);
+  // Write the next segment of the request body, or begin receiving the
+  // response if the whole body was written.
+  void write_next(Request& request);
+  // Read the next piece of the response body.
+  void read_next(Request& request);
+  // Record the status and headers of the response to `request`.
+  void read_headers(Request& request);
+  // Deliver an error for `request` describing the specified `error`, which
+  // occurred doing the specified `what`.
+  void fail(Request& request, StringView what, DWORD error);
+  // Close the handle of `request`, unless it is already closed.  WinHTTP then
+  // notifies that the handle is closing, and `request` is destroyed.
+  void close(Request& request);
+  // Return the connection handle for the endpoint of the specified `url`.
+  Expected<HINTERNET> connect(const HTTPClient::URL& url);
+
+ public:
+  WinHTTPClientImpl(const std::shared_ptr<Logger>&, const Clock&);
+  ~WinHTTPClientImpl();
+
+  Expected<void> post(const HTTPClient::URL& url,
+                      HTTPClient::HeadersSetter set_headers,
+                      HTTPClient::BodySegments body,
+                      HTTPClient::ResponseHandler on_response,
+                      HTTPClient::ErrorHandler on_error,
+                      std::chrono::steady_clock::time_point deadline);
+
+  void drain(std::chrono::steady_clock::time_point deadline);
+
+  nlohmann::json config();
+};
+
+WinHTTPClient::WinHTTPClient(const std::shared_ptr<Logger>& logger,
+                             const Clock& clock)
+    : impl_(new WinHTTPClientImpl{logger, clock}) {}
+
+WinHTTPClient::~WinHTTPClient() { delete impl_; }
+
+Expected<void> WinHTTPClient::post(
+    const URL& url, HeadersSetter set_headers, std::string body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  BodySegments segments;
+  segments.push_back(std::make_shared<const std::string>(std::move(body)));
+  return impl_->post(url, std::move(set_headers), std::move(segments),
+                     std::move(on_response), std::move(on_error), deadline);
+}
+
+Expected<void> WinHTTPClient::post_segments(
+    const URL& url, HeadersSetter set_headers, BodySegments body,
+    ResponseHandler on_response, ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  return impl_->post(url, std::move(set_headers), std::move(body),
+                     std::move(on_response), std::move(on_error), deadline);
+}
+
+void WinHTTPClient::drain(std::chrono::steady_clock::time_point deadline) {
+  impl_->drain(deadline);
+}
+
+std::string WinHTTPClient::config() const {
+  return nlohmann::json::object({{"type", "datadog::tracing::WinHTTPClient"},
+                                 {"config", impl_->config()}})
+      .dump();
+}
+
+WinHTTPClientImpl::WinHTTPClientImpl(const std::shared_ptr<Logger>& logger,
+                                     const Clock& clock)
+    : logger_(logger),
+      clock_(clock),
+      session_(nullptr),
+      shutting_down_(false),
+      requests_sent_(0) {
+  session_ = ::WinHttpOpen(L"dd-trace-cpp", WINHTTP_ACCESS_TYPE_NO_PROXY,
+                           WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS,
+                           WINHTTP_FLAG_ASYNC);
+  if (!session_) {
+    logger_->log_error(
+        Error{Error::WINHTTP_CLIENT_SETUP_FAILED,
+              error_message("Unable to open a WinHTTP session",
+                            ::GetLastError())});
+    return;
+  }
+
+  // Request handles inherit the session's callback.
+  if (::WinHttpSetStatusCallback(
+          session_, &on_status,
+          WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES,
+          0) == WINHTTP_INVALID_STATUS_CALLBACK) {
+    logger_->log_error(
+        Error{Error::WINHTTP_CLIENT_SETUP_FAILED,
+              error_message("Unable to set the WinHTTP status callback",
+                            ::GetLastError())});
+    ::WinHttpCloseHandle(session_);
+    session_ = nullptr;
+  }
+}
+
+WinHTTPClientImpl::~WinHTTPClientImpl() {
+  if (!session_) {
+    // We're not running; nothing to shut down.
+    return;
+  }
+
+  // Requests that are still outstanding are abandoned.  Close their handles,
+  // and wait until WinHTTP is finished with them.
+  shutting_down_ = true;
+  std::vector<HINTERNET> handles;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (Request* request : requests_) {
+    if (!request->closed) {
+      request->closed = true;
+      handles.push_back(request->handle);
+    }
+  }
+  lock.unlock();
+  for (HINTERNET handle : handles) {
+    ::WinHttpCloseHandle(handle);
+  }
+  lock.lock();
+  no_requests_.wait(lock, [this]() { return requests_.empty(); });
+  lock.unlock();
+
+  ::WinHttpSetStatusCallback(session_, nullptr,
+                             WINHTTP_CALLBACK_FLAG_ALL_NOTIFICATIONS, 0);
+  for (const auto& [endpoint, connection] : connections_) {
+    ::WinHttpCloseHandle(connection);
+  }
+  ::WinHttpCloseHandle(session_);
+}
+
+Expected<void> WinHTTPClientImpl::post(
+    const HTTPClient::URL& url, HTTPClient::HeadersSetter set_headers,
+    HTTPClient::BodySegments body, HTTPClient::ResponseHandler on_response,
+    HTTPClient::ErrorHandler on_error,
+    std::chrono::steady_clock::time_point deadline) {
+  if (!session_) {
+    return Error{Error::WINHTTP_CLIENT_SETUP_FAILED,
+                 "Unable to send request because the HTTP client failed to "
+                 "start."};
+  }
+  if (url.scheme != "http" && url.scheme != "https") {
+    std::string message;
+    message += "The WinHTTP client does not support the URL scheme \"";
+    message += url.scheme;
+    message += "\".  Supported schemes are \"http\" and \"https\".";
+    return Error{Error::WINHTTP_CLIENT_UNSUPPORTED_URL, std::move(message)};
+  }
+
+  auto connection = connect(url);
+  if (auto* error = connection.if_error()) {
+    return std::move(*error);
+  }
+
+  std::string object = url.path.empty() ? "/" : url.path;
+  if (!url.query.empty()) {
+    object += '?';
+    object += url.query;
+  }
+  const HINTERNET handle = ::WinHttpOpenRequest(
+      *connection, L"POST", widen(object).c_str(), nullptr, WINHTTP_NO_REFERER,
+      WINHTTP_DEFAULT_ACCEPT_TYPES,
+      url.scheme == "https" ? WINHTTP_FLAG_SECURE : 0);
+  if (!handle) {
+    return Error{Error::WINHTTP_CLIENT_REQUEST_FAILURE,
+                 error_message("Unable to create request", ::GetLastError())};
+  }
+
+  // Each stage of the request must finish before the deadline.  A request
+  // whose deadline has passed times out right away.
+  const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+      deadline - clock_().tick);
+  const int timeout = static_cast<int>(
+      (std::max)(std::int64_t(1), std::int64_t(remaining.count())));
+  ::WinHttpSetTimeouts(handle, timeout, timeout, timeout, timeout);
+
+  std::string header_lines;
+  HeaderWriter writer{header_lines};
+  set_headers(writer);
+  const std::wstring headers = widen(header_lines);
+
+  DWORD body_size = 0;
+  for (const auto& segment : body) {
+    assert(segment);
+    body_size += static_cast<DWORD>(segment->size());
+  }
+
+  auto owned = std::make_unique<Request>();
+  Request* request = owned.get();
+  request->client = this;
+  request->handle = handle;
+  request->body = std::move(body);
+  request->on_response = std::move(on_response);
+  request->on_error = std::move(on_error);
+  // Notifications for the request handle, including its closing, refer to
+  // `request`.
+  DWORD_PTR context = reinterpret_cast<DWORD_PTR>(request);
+  ::WinHttpSetOption(handle, WINHTTP_OPTION_CONTEXT_VALUE, &context,
+                     sizeof context);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.insert(owned.release());
+  }
+
+  if (!::WinHttpSendRequest(
+          handle,
+          headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+          static_cast<DWORD>(headers.size()), WINHTTP_NO_REQUEST_DATA, 0,
+          body_size, context)) {
+    const DWORD error = ::GetLastError();
+    // No handler is invoked for a request that was not sent.
+    close(*request);
+    return Error{Error::WINHTTP_CLIENT_REQUEST_FAILURE,
+                 error_message("Unable to send request", error)};
+  }
+  ++requests_sent_;
+  return nullopt;
+}
+
+void WinHTTPClientImpl::drain(std::chrono::steady_clock::time_point deadline) {
+  if (!session_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  no_requests_.wait_until(lock, deadline,
+                          [this]() { return requests_.empty(); });
+}
+
+nlohmann::json WinHTTPClientImpl::config() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nlohmann::json::object({
+      {"requests_sent", requests_sent_.load()},
+      {"endpoints", connections_.size()},
+  });
+}
+
+void CALLBACK WinHTTPClientImpl::on_status(HINTERNET, DWORD_PTR context,
+                                           DWORD status, LPVOID info,
+                                           DWORD length) {
+  // Notifications for the session and connection handles have no context.
+  auto* request = reinterpret_cast<Request*>(context);
+  if (request) {
+    request->client->handle(*request, status, info, length);
+  }
+}
+
+void WinHTTPClientImpl::handle(Request& request, DWORD status, void* info,
+                               DWORD length) {
+  if (status == WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.erase(&request);
+    delete &request;
+    if (requests_.empty()) {
+      no_requests_.notify_all();
+    }
+    return;
+  }
+  if (shutting_down_) {
+    return;
+  }
+
+  switch (status) {
+    case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+    case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE:
+      write_next(request);
+      break;
+    case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+      read_headers(request);
+      read_next(request);
+      break;
+    case WINHTTP_CALLBACK_STATUS_READ_COMPLETE: {
+      if (length == 0) {
+        // That was the end of the response.
+        HeaderBlockReader reader{request.headers};
+        request.on_response(request.status, reader,
+                            std::move(request.response_body));
+        close(request);
+        break;
+      }
+      request.response_body.append(request.buffer, length);
+      read_next(request);
+      break;
+    }
+    case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
+      const auto* result = static_cast<const WINHTTP_ASYNC_RESULT*>(info);
+      fail(request, "Request failed", result->dwError);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void WinHTTPClientImpl::write_next(Request& request) {
+  while (request.segment < request.body.size() &&
+         request.body[request.segment]->empty()) {
+    ++request.segment;
+  }
+  if (request.segment == request.body.size()) {
+    if (!::WinHttpReceiveResponse(request.handle, nullptr)) {
+      fail(request, "Unable to receive response", ::GetLastError());
+    }
+    return;
+  }
+
+  const std::string& segment = *request.body[request.segment++];
+  if (!::WinHttpWriteData(request.handle, segment.data(),
+                          static_cast<DWORD>(segment.size()), nullptr)) {
+    fail(request, "Unable to send request", ::GetLastError());
+  }
+}
+
+void WinHTTPClientImpl::read_next(Request& request) {
+  if (!::WinHttpReadData(request.handle, request.buffer, read_size, nullptr)) {
+    fail(request, "Unable to receive response", ::GetLastError());
+  }
+}
+
+void WinHTTPClientImpl::read_headers(Request& request) {
+  DWORD status = 0;
+  DWORD size = sizeof status;
+  if (::WinHttpQueryHeaders(
+          request.handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+          WINHTTP_HEADER_NAME_BY_INDEX, &status, &size,
+          WINHTTP_NO_HEADER_INDEX)) {
+    request.status = static_cast<int>(status);
+  }
+
+  // The first call obtains the size of the headers, in bytes.
+  size = 0;
+  ::WinHttpQueryHeaders(request.handle, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                        WINHTTP_HEADER_NAME_BY_INDEX, WINHTTP_NO_OUTPUT_BUFFER,
+                        &size, WINHTTP_NO_HEADER_INDEX);
+  std::wstring headers(size / sizeof(wchar_t), L'\0');
+  if (!headers.empty() &&
+      ::WinHttpQueryHeaders(request.handle, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                            WINHTTP_HEADER_NAME_BY_INDEX, headers.data(), &size,
+                            WINHTTP_NO_HEADER_INDEX)) {
+    headers.resize(size / sizeof(wchar_t));
+    request.headers = narrow(headers);
+  }
+}
+
+void WinHTTPClientImpl::fail(Request& request, StringView what, DWORD error) {
+  if (error == ERROR_WINHTTP_TIMEOUT) {
+    request.on_error(Error{Error::WINHTTP_CLIENT_DEADLINE_EXCEEDED,
+                           "Request deadline exceeded."});
+  } else {
+    request.on_error(Error{Error::WINHTTP_CLIENT_REQUEST_FAILURE,
+                           error_message(what, error)});
+  }
+  close(request);
+}
+
+void WinHTTPClientImpl::close(Request& request) {
+  HINTERNET handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (request.closed) {
+      return;
+    }
+    request.closed = true;
+    handle = request.handle;
+  }
+  // `request` might be destroyed before this returns.
+  ::WinHttpCloseHandle(handle);
+}
+
+Expected<HINTERNET> WinHTTPClientImpl::connect(const HTTPClient::URL& url) {
+  std::string endpoint = url.scheme;
+  endpoint += "://";
+  endpoint += url.authority;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto found = connections_.find(endpoint); found != connections_.end()) {
+    return found->second;
+  }
+
+  // The authority is "host", "host:port", or "[IPv6 address]:port".
+  std::string host = url.authority;
+  INTERNET_PORT port = url.scheme == "https" ? INTERNET_DEFAULT_HTTPS_PORT
+                                             : INTERNET_DEFAULT_HTTP_PORT;
+  const auto bracket = host.rfind(']');
+  const auto colon = host.rfind(':');
+  if (colon != std::string::npos &&
+      (bracket == std::string::npos || colon > bracket)) {
+    auto parsed = parse_uint64(StringView{host}.substr(colon + 1), 10);
+    if (!parsed || *parsed > 65535) {
+      return Error{Error::WINHTTP_CLIENT_UNSUPPORTED_URL,
+                   "Invalid port in URL authority: " + url.authority};
+    }
+    port = static_cast<INTERNET_PORT>(*parsed);
+    host.erase(colon);
+  }
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  const HINTERNET connection =
+      ::WinHttpConnect(session_, widen(host).c_str(), port, 0);
+  if (!connection) {
+    return Error{Error::WINHTTP_CLIENT_REQUEST_FAILURE,
+                 error_message("Unable to connect", ::GetLastError())};
+  }
+  connections_.emplace(std::move(endpoint), connection);
+  return connection;
+}
+
+}  // namespace tracing
+}  // namespace datadog
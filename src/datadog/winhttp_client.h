@@ -0,0 +1,61 @@
+#pragma once
+
+// This component provides a `class`, `WinHTTPClient`, that implements the
+// `HTTPClient` interface in terms of the asynchronous mode of Windows'
+// [WinHTTP][1], without libcurl.
+//
+// `WinHTTPClient` has no thread of its own.  Each request proceeds by
+// completion callbacks that WinHTTP invokes on the system thread pool, and the
+// request body is written from the caller's buffers, one segment at a time,
+// without being copied.  WinHTTP keeps connections alive within the client's
+// session, and reuses them for later requests to the same server.
+//
+// `WinHTTPClient` supports "http" and "https" URLs.  WinHTTP cannot connect to
+// Unix domain sockets, so "unix" and "http+unix" URLs are rejected.
+//
+// If this library was built on Windows with `DD_TRACE_TRANSPORT` set to
+// "native", then `default_http_client` returns a `WinHTTPClient`.
+//
+// [1]: https://learn.microsoft.com/en-us/windows/win32/winhttp/about-winhttp
+
+#include <datadog/clock.h>
+#include <datadog/http_client.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace datadog {
+namespace tracing {
+
+class Logger;
+class WinHTTPClientImpl;
+
+class WinHTTPClient : public HTTPClient {
+  WinHTTPClientImpl* impl_;
+
+ public:
+  WinHTTPClient(const std::shared_ptr<Logger>&, const Clock&);
+  // Cancel the requests that are still in flight, and wait until WinHTTP is
+  // finished with them.
+  ~WinHTTPClient();
+
+  WinHTTPClient(const WinHTTPClient&) = delete;
+
+  Expected<void> post(const URL& url, HeadersSetter set_headers,
+                      std::string body, ResponseHandler on_response,
+                      ErrorHandler on_error,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+  Expected<void> post_segments(
+      const URL& url, HeadersSetter set_headers, BodySegments body,
+      ResponseHandler on_response, ErrorHandler on_error,
+      std::chrono::steady_clock::time_point deadline) override;
+
+  void drain(std::chrono::steady_clock::time_point deadline) override;
+
+  std::string config() const override;
+};
+
+}  // namespace tracing
+}  // namespace datadog
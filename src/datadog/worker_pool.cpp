@@ -0,0 +1,92 @@
+#include "worker_pool.h"
+
+#include "platform_util.h"
+
+namespace datadog {
+namespace tracing {
+
+WorkerPool::WorkerPool(std::size_t thread_count,
+                       const ThreadGenerator& make_thread)
+    : owner_(get_process_id()) {
+  threads_.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    threads_.push_back(make_thread([this]() { work(); }));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  batch_started_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+std::size_t WorkerPool::size() const { return threads_.size(); }
+
+void WorkerPool::run_tasks(const std::function<void(std::size_t)>& task,
+                           std::size_t count) {
+  for (std::size_t i = next_task_.fetch_add(1, std::memory_order_relaxed);
+       i < count; i = next_task_.fetch_add(1, std::memory_order_relaxed)) {
+    task(i);
+  }
+}
+
+void WorkerPool::work() {
+  std::uint64_t last_batch = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    batch_started_.wait(lock, [&]() {
+      return shutting_down_ || (task_ && batch_ != last_batch);
+    });
+    if (shutting_down_) {
+      return;
+    }
+    last_batch = batch_;
+    const auto& task = *task_;
+    const std::size_t count = task_count_;
+    ++busy_workers_;
+    lock.unlock();
+    run_tasks(task, count);
+    lock.lock();
+    if (--busy_workers_ == 0) {
+      batch_done_.notify_all();
+    }
+  }
+}
+
+void WorkerPool::run(std::size_t count,
+                     const std::function<void(std::size_t)>& task) {
+  if (threads_.empty() || count < 2 || get_process_id() != owner_) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    task_count_ = count;
+    next_task_.store(0, std::memory_order_relaxed);
+    ++batch_;
+  }
+  batch_started_.notify_all();
+
+  run_tasks(task, count);
+
+  // Every task has been claimed.  Wait for the workers that claimed some to
+  // finish them, and keep the workers that did not join from joining late.
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = nullptr;
+  batch_done_.wait(lock, [&]() { return busy_workers_ == 0; });
+}
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,76 @@
+#pragma once
+
+// This component provides a `class`, `WorkerPool`, that runs the iterations
+// of a loop on several threads at once.
+//
+// `WorkerPool::run(count, task)` invokes `task(i)` for each `i` from zero to
+// `count`, spread across the pool's threads and the calling thread, and
+// returns once every invocation has returned.  There is one batch of tasks at
+// a time: concurrent calls to `run` are serialized.
+//
+// `DatadogAgent` uses a `WorkerPool` to encode large payloads of trace chunks
+// in parallel (see `DatadogAgentConfig::encoding_threads`).
+//
+// A process created by `fork` does not have the pool's threads, so in such a
+// process `run` invokes every task on the calling thread.
+
+#include <datadog/thread_options.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace datadog {
+namespace tracing {
+
+class WorkerPool {
+  // Serializes calls to `run`.
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable batch_started_;
+  std::condition_variable batch_done_;
+  // The current batch, if any.  Guarded by `mutex_`, except that `next_task_`
+  // is claimed without the lock.
+  const std::function<void(std::size_t)>* task_ = nullptr;
+  std::size_t task_count_ = 0;
+  std::atomic<std::size_t> next_task_{0};
+  // The number of workers that are running tasks of the current batch.
+  std::size_t busy_workers_ = 0;
+  // Incremented for each batch, so that a worker joins each batch once.
+  std::uint64_t batch_ = 0;
+  bool shutting_down_ = false;
+  // The process that created `threads_`.
+  const int owner_;
+  std::vector<std::thread> threads_;
+
+  void work();
+  // Invoke tasks of the current batch until none remain.
+  void run_tasks(const std::function<void(std::size_t)>& task,
+                 std::size_t count);
+
+ public:
+  // Create a pool of the specified `thread_count` threads, each created by
+  // the specified `make_thread`.
+  WorkerPool(std::size_t thread_count, const ThreadGenerator& make_thread);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Return the number of threads in the pool, not including the thread that
+  // calls `run`.
+  std::size_t size() const;
+
+  // Invoke the specified `task` with each integer from zero up to, but not
+  // including, the specified `count`, and return when the invocations have
+  // returned.  The invocations might happen concurrently, in any order.
+  void run(std::size_t count, const std::function<void(std::size_t)>& task);
+};
+
+}  // namespace tracing
+}  // namespace datadog
@@ -0,0 +1,99 @@
+#pragma once
+
+// This component provides a minimal reader of the Protocol Buffers wire
+// format, with which tests decode the requests of the collectors that send
+// protobuf (`OtlpExporter` and `DatadogIntake`).  A failure to decode fails
+// the test.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../test.h"
+
+namespace datadog::test::protobuf {
+
+// `Field` is a decoded protobuf field.  Varint and fixed-width values are in
+// `integer`, and length-delimited values in `bytes`.
+struct Field {
+  std::uint32_t number;
+  std::uint64_t integer = 0;
+  std::string bytes;
+};
+
+inline std::uint64_t read_varint(const std::string& input,
+                                 std::size_t& position) {
+  std::uint64_t value = 0;
+  int shift = 0;
+  while (true) {
+    REQUIRE(position < input.size());
+    const auto byte = static_cast<unsigned char>(input[position++]);
+    value |= std::uint64_t(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+    shift += 7;
+  }
+}
+
+inline std::vector<Field> decode(const std::string& message) {
+  std::vector<Field> fields;
+  std::size_t position = 0;
+  while (position < message.size()) {
+    const std::uint64_t key = read_varint(message, position);
+    Field field;
+    field.number = std::uint32_t(key >> 3);
+    switch (key & 7) {
+      case 0:
+        field.integer = read_varint(message, position);
+        break;
+      case 1:
+      case 5: {
+        const std::size_t width = (key & 7) == 1 ? 8 : 4;
+        REQUIRE(position + width <= message.size());
+        for (std::size_t i = 0; i < width; ++i) {
+          field.integer |=
+              std::uint64_t(static_cast<unsigned char>(message[position + i]))
+              << (8 * i);
+        }
+        position += width;
+        break;
+      }
+      case 2: {
+        const std::size_t size = read_varint(message, position);
+        REQUIRE(position + size <= message.size());
+        field.bytes = message.substr(position, size);
+        position += size;
+        break;
+      }
+      default:
+        FAIL("unexpected wire type " << (key & 7));
+    }
+    fields.push_back(std::move(field));
+  }
+  return fields;
+}
+
+// Return the decoded fields of the specified `message` having the specified
+// field `number`.
+inline std::vector<Field> fields(const std::string& message,
+                                 std::uint32_t number) {
+  std::vector<Field> result;
+  for (Field& field : decode(message)) {
+    if (field.number == number) {
+      result.push_back(std::move(field));
+    }
+  }
+  return result;
+}
+
+// Return the contents of the only length-delimited field of the specified
+// `message` having the specified field `number`.
+inline std::string only(const std::string& message, std::uint32_t number) {
+  auto found = fields(message, number);
+  REQUIRE(found.size() == 1);
+  return found.front().bytes;
+}
+
+}  // namespace datadog::test::protobuf
@@ -26,7 +26,17 @@ class ContainsSubset : public Catch::MatcherBase<Map> {
  public:
   ContainsSubset(const Map& subset) : subset_(&subset) {}
 
-  bool match(const Map& other) const override {
+  bool match(const Map& other) const override { return match_any(other); }
+
+  // Allow comparison with a map of a different type, e.g. `SpanTags`, which
+  // uses a different allocator.
+  template <typename Other>
+  bool match(const Other& other) const {
+    return match_any(other);
+  }
+
+  template <typename Other>
+  bool match_any(const Other& other) const {
     return std::all_of(subset_->begin(), subset_->end(), [&](const auto& item) {
       const auto& [key, value] = item;
       auto found = find(other, key);
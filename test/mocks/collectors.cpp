@@ -9,6 +9,7 @@
 
 DEFINE_CONFIG_JSON_METHOD(MockCollector)
 DEFINE_CONFIG_JSON_METHOD(MockCollectorWithResponse)
+DEFINE_CONFIG_JSON_METHOD(ChunkCollector)
 DEFINE_CONFIG_JSON_METHOD(PriorityCountingCollector)
 DEFINE_CONFIG_JSON_METHOD(PriorityCountingCollectorWithResponse)
 DEFINE_CONFIG_JSON_METHOD(FailureCollector)
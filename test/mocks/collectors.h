@@ -48,6 +48,12 @@ struct MockCollector : public Collector {
   }
 };
 
+// `SharingMockCollector` is a `MockCollector` to which spans are sent referring
+// to their shared tags rather than containing them.
+struct SharingMockCollector : public MockCollector {
+  bool accepts_shared_tags() const override { return true; }
+};
+
 struct MockCollectorWithResponse : public MockCollector {
   CollectorResponse response;
 
@@ -62,6 +68,28 @@ struct MockCollectorWithResponse : public MockCollector {
   std::string config() const override;
 };
 
+// `ChunkCollector` records the trace chunks sent to it, together with their
+// chunk-level properties.
+struct ChunkCollector : public Collector {
+  std::vector<TraceChunk> chunks;
+
+  Expected<void> send(std::vector<std::unique_ptr<SpanData>>&& spans,
+                      const std::shared_ptr<TraceSampler>&) override {
+    TraceChunk chunk;
+    chunk.spans = std::move(spans);
+    chunks.push_back(std::move(chunk));
+    return {};
+  }
+
+  Expected<void> send_chunk(TraceChunk&& chunk,
+                            const std::shared_ptr<TraceSampler>&) override {
+    chunks.push_back(std::move(chunk));
+    return {};
+  }
+
+  std::string config() const override;
+};
+
 struct PriorityCountingCollector : public Collector {
   std::map<double, std::size_t> sampling_priority_count;
 
@@ -6,6 +6,7 @@
 #include <chrono>
 #include <datadog/json.hpp>
 #include <functional>
+#include <vector>
 
 using namespace datadog::tracing;
 
@@ -13,6 +14,10 @@ struct MockEventScheduler : public EventScheduler {
   std::function<void()> event_callback;
   Optional<std::chrono::steady_clock::duration> recurrence_interval;
   bool cancelled = false;
+  // If `defer_posted_tasks` is true, then tasks passed to `post` are kept in
+  // `posted_tasks` for the test to invoke, rather than invoked immediately.
+  bool defer_posted_tasks = false;
+  std::vector<std::function<void()>> posted_tasks;
 
   Cancel schedule_recurring_event(std::chrono::steady_clock::duration interval,
                                   std::function<void()> callback) override {
@@ -21,6 +26,23 @@ struct MockEventScheduler : public EventScheduler {
     return [this]() { cancelled = true; };
   }
 
+  void post(std::function<void()> task) override {
+    if (defer_posted_tasks) {
+      posted_tasks.push_back(std::move(task));
+    } else {
+      task();
+    }
+  }
+
+  // Invoke and then remove the tasks in `posted_tasks`.
+  void run_posted_tasks() {
+    auto tasks = std::move(posted_tasks);
+    posted_tasks.clear();
+    for (auto& task : tasks) {
+      task();
+    }
+  }
+
   std::string config() const override {
     return nlohmann::json::object({{"type", "MockEventScheduler"}}).dump();
   }
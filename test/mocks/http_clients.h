@@ -40,15 +40,19 @@ struct MockHTTPClient : public HTTPClient {
   ResponseHandler on_response_;
   ErrorHandler on_error_;
   std::string request_body;
+  // The number of segments in the last segmented request body.
+  std::size_t request_segment_count = 0;
+  URL request_url;
 
   void clear() { request_body = ""; }
 
   Expected<void> post(
-      const URL&, HeadersSetter set_headers, std::string body,
+      const URL& url, HeadersSetter set_headers, std::string body,
       ResponseHandler on_response, ErrorHandler on_error,
       std::chrono::steady_clock::time_point /*deadline*/) override {
     std::lock_guard<std::mutex> lock{mutex_};
     request_body = body;
+    request_url = url;
     if (!post_error) {
       on_response_ = on_response;
       on_error_ = on_error;
@@ -57,6 +61,19 @@ struct MockHTTPClient : public HTTPClient {
     return Expected<void>(post_error);
   }
 
+  Expected<void> post_segments(
+      const URL& url, HeadersSetter set_headers, BodySegments body,
+      ResponseHandler on_response, ErrorHandler on_error,
+      std::chrono::steady_clock::time_point deadline) override {
+    const std::size_t segment_count = body.size();
+    auto result = HTTPClient::post_segments(
+        url, std::move(set_headers), std::move(body), std::move(on_response),
+        std::move(on_error), deadline);
+    std::lock_guard<std::mutex> lock{mutex_};
+    request_segment_count = segment_count;
+    return result;
+  }
+
   void drain(std::chrono::steady_clock::time_point /*deadline*/) override {
     std::lock_guard<std::mutex> lock{mutex_};
     if (response_error && on_error_) {
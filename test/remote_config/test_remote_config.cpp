@@ -27,7 +27,12 @@ struct FakeListener : public rc::Listener {
 
   rc::Capabilities get_capabilities() override { return capabilities; }
 
-  void on_revert(const Configuration&) override { ++count_on_revert; }
+  void on_revert(const Configuration& conf) override {
+    ++count_on_revert;
+    // The content of an applied configuration is not retained.
+    CHECK(conf.content.empty());
+    CHECK(!conf.path.empty());
+  }
 
   Optional<std::string> on_update(const Configuration& conf) override {
     ++count_on_update;
@@ -201,6 +206,11 @@ REMOTE_CONFIG_TEST("response processing") {
     // updated.
     CHECK(payload["client"]["state"]["targets_version"] == 0);
     CHECK(payload["client"]["state"]["backend_client_state"] == "");
+
+    // A response that failed is processed again, and fails again.
+    rc.process_response(response_json);
+    CHECK(rc.make_request_payload().contains(
+              "/client/state/has_error"_json_pointer) == true);
   }
 
   SECTION("update dispatch") {
@@ -323,14 +333,37 @@ REMOTE_CONFIG_TEST("response processing") {
     }
 
     SECTION("same config update should not trigger listeners") {
+      const auto serialized = rc.serialized_request_payload();
+      REQUIRE(serialized);
+      CHECK(*serialized == rc.make_request_payload().dump());
+
       rc.process_response(response_json);
+      // Nothing changed, so the serialized request payload is reused.
+      CHECK(rc.serialized_request_payload() == serialized);
+
       CHECK(tracing_listener->count_on_update == 1);
       CHECK(tracing_listener->count_on_revert == 0);
-      CHECK(tracing_listener->count_on_post_process == 2);
+      CHECK(tracing_listener->count_on_post_process == 1);
 
       CHECK(agent_listener->count_on_update == 2);
       CHECK(agent_listener->count_on_revert == 0);
-      CHECK(agent_listener->count_on_post_process == 2);
+      CHECK(agent_listener->count_on_post_process == 1);
+
+      // The listeners still report the state of the applied configurations.
+      const auto payload = rc.make_request_payload();
+      CHECK(payload.at("/client/state/targets_version"_json_pointer) ==
+            66204320);
+      CHECK(payload.at("/client/state/config_states"_json_pointer).size() ==
+            3);
+    }
+
+    SECTION("same config update with different client configs is processed") {
+      auto fewer_configs_json = response_json;
+      fewer_configs_json["client_configs"].erase(0);
+      rc.process_response(fewer_configs_json);
+      CHECK(tracing_listener->count_on_revert == 1);
+      CHECK(tracing_listener->count_on_post_process == 2);
+      CHECK(agent_listener->count_on_update == 2);
     }
 
     SECTION("new version of a config calls listeners") {
@@ -364,7 +397,11 @@ REMOTE_CONFIG_TEST("response processing") {
 
       REQUIRE(!new_response_json.is_discarded());
 
+      const auto serialized = rc.serialized_request_payload();
       rc.process_response(new_response_json);
+      const auto new_serialized = rc.serialized_request_payload();
+      CHECK(new_serialized != serialized);
+      CHECK(*new_serialized == rc.make_request_payload().dump());
 
       CHECK(tracing_listener->count_on_update == 2);
       CHECK(tracing_listener->count_on_revert == 0);
@@ -0,0 +1,276 @@
+// This program replays a capture recorded by a `RecordingCollector` (see
+// `recording_collector_config.h`) against a real Datadog Agent.  It reads the
+// trace payloads from the capture file, and posts each one to the agent's
+// "/v0.4/traces" endpoint, with the headers that a `DatadogAgent` sends, at
+// the time at which it was recorded, divided by a speedup factor.  It uses the
+// library's default HTTP client, as a `DatadogAgent` would.  Then it prints a
+// JSON report of the payloads, traces, and bytes sent per second, the agent's
+// responses, and how far behind schedule the payloads were sent.  See
+// `README.md`.
+
+#include <datadog/capture_file.h>
+#include <datadog/cerr_logger.h>
+#include <datadog/clock.h>
+#include <datadog/dict_writer.h>
+#include <datadog/http_client.h>
+#include <datadog/version.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "default_http_client.h"
+
+namespace dd = datadog::tracing;
+
+namespace {
+
+struct Options {
+  std::string capture_path;
+  std::string agent_url = "http://localhost:8126";
+  // How many times faster than recorded the payloads are sent, or zero to
+  // send them as fast as possible.
+  double speed = 1;
+  int loops = 1;
+  int max_in_flight = 64;
+  int timeout_milliseconds = 2000;
+};
+
+void print_usage(const char* program) {
+  // clang-format off
+  std::cout << program << "\n\n"
+            << "Usage: replay a recorded capture against a Datadog Agent\n\n"
+            << "--capture=PATH\t\t\tThe capture file (required).\n"
+            << "--agent-url=URL\t\t\tThe Datadog Agent "
+               "(http://localhost:8126).\n"
+            << "--speed=N\t\t\tSpeedup over the recorded pace, or 0 for "
+               "unpaced (1).\n"
+            << "--loops=N\t\t\tHow many times to replay the capture (1).\n"
+            << "--max-in-flight=N\t\tThe most requests in flight at once "
+               "(64).\n"
+            << "--timeout=MILLISECONDS\t\tThe timeout of each request "
+               "(2000).\n";
+  // clang-format on
+}
+
+// Parse the specified command line arguments into the specified `options`.
+// Return whether they are valid.
+bool parse(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const auto equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        equals == std::string::npos ? "" : arg.substr(equals + 1);
+    try {
+      if (name == "--capture") {
+        options.capture_path = value;
+      } else if (name == "--agent-url") {
+        options.agent_url = value;
+      } else if (name == "--speed") {
+        options.speed = std::stod(value);
+      } else if (name == "--loops") {
+        options.loops = std::stoi(value);
+      } else if (name == "--max-in-flight") {
+        options.max_in_flight = std::stoi(value);
+      } else if (name == "--timeout") {
+        options.timeout_milliseconds = std::stoi(value);
+      } else {
+        return false;
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  return !options.capture_path.empty() && options.speed >= 0 &&
+         options.loops > 0 && options.max_in_flight > 0 &&
+         options.timeout_milliseconds > 0;
+}
+
+// `Results` accumulates the outcomes of the requests, which are reported by
+// the HTTP client's thread.
+class Results {
+  std::mutex mutex_;
+  std::condition_variable done_;
+  int in_flight_ = 0;
+  std::uint64_t responses_2xx_ = 0;
+  std::uint64_t responses_other_ = 0;
+  std::uint64_t errors_ = 0;
+  std::vector<std::chrono::nanoseconds> latencies_;
+
+ public:
+  // Wait until fewer than the specified `max_in_flight` requests are in
+  // flight, and then count one more.
+  void begin(int max_in_flight) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&]() { return in_flight_ < max_in_flight; });
+    ++in_flight_;
+  }
+
+  // Count a request that was not sent.
+  void abandon() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    ++errors_;
+    done_.notify_all();
+  }
+
+  // Count a request that finished with the specified response `status`, or
+  // with an error if `status` is zero, after the specified `latency`.
+  void end(int status, std::chrono::nanoseconds latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    if (status >= 200 && status < 300) {
+      ++responses_2xx_;
+    } else if (status != 0) {
+      ++responses_other_;
+    } else {
+      ++errors_;
+    }
+    latencies_.push_back(latency);
+    done_.notify_all();
+  }
+
+  // Add the results to the specified `report`.
+  void report(nlohmann::json& report) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    report["responses_2xx"] = responses_2xx_;
+    report["responses_other"] = responses_other_;
+    report["errors"] = errors_;
+    std::sort(latencies_.begin(), latencies_.end());
+    auto percentiles = nlohmann::json::object();
+    if (!latencies_.empty()) {
+      const auto at = [&](double quantile) {
+        const auto index = std::size_t(quantile * (latencies_.size() - 1));
+        return std::chrono::duration<double, std::milli>(latencies_[index])
+            .count();
+      };
+      percentiles["p50"] = at(0.5);
+      percentiles["p90"] = at(0.9);
+      percentiles["p99"] = at(0.99);
+      percentiles["max"] = at(1);
+    }
+    report["request_latency_milliseconds"] = percentiles;
+  }
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  auto capture = dd::CaptureFile::open(options.capture_path);
+  if (auto* error = capture.if_error()) {
+    std::cerr << error->message << '\n';
+    return 1;
+  }
+  auto agent_url = dd::HTTPClient::URL::parse(options.agent_url);
+  if (auto* error = agent_url.if_error()) {
+    std::cerr << error->message << '\n';
+    return 1;
+  }
+  agent_url->path = "/v0.4/traces";
+
+  const auto logger = std::make_shared<dd::CerrLogger>();
+  auto http_client =
+      dd::default_http_client(logger, dd::default_clock, {}, nullptr);
+  if (!http_client) {
+    std::cerr << "This library was built without an HTTP client.\n";
+    return 1;
+  }
+
+  Results results;
+  std::uint64_t payloads = 0;
+  std::uint64_t traces = 0;
+  std::uint64_t bytes = 0;
+  std::chrono::nanoseconds recorded{0};
+  std::chrono::nanoseconds max_lag{0};
+  const auto timeout = std::chrono::milliseconds(options.timeout_milliseconds);
+  const auto start = std::chrono::steady_clock::now();
+  auto loop_start = start;
+  for (int loop = 0; loop < options.loops; ++loop) {
+    std::uint64_t position = 0;
+    dd::CaptureFile::Record record;
+    while ((*capture)->next(position, record)) {
+      recorded = std::max(recorded, record.offset);
+      if (options.speed != 0) {
+        const auto due =
+            loop_start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                record.offset / options.speed);
+        std::this_thread::sleep_until(due);
+        max_lag = std::max(
+            max_lag, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - due));
+      }
+
+      const std::string trace_count = std::to_string(record.trace_count);
+      auto set_headers = [&](dd::DictWriter& headers) {
+        headers.set("Content-Type", "application/msgpack");
+        headers.set("X-Datadog-Trace-Count", trace_count);
+        headers.set("Datadog-Meta-Lang", "cpp");
+        headers.set("Datadog-Meta-Tracer-Version", dd::tracer_version);
+      };
+      results.begin(options.max_in_flight);
+      const auto sent = std::chrono::steady_clock::now();
+      auto posted = http_client->post(
+          *agent_url, set_headers, std::string(record.payload),
+          [&results, sent](int status, const dd::DictReader&, std::string) {
+            results.end(status, std::chrono::steady_clock::now() - sent);
+          },
+          [&results, sent](dd::Error) {
+            results.end(0, std::chrono::steady_clock::now() - sent);
+          },
+          sent + timeout);
+      if (auto* error = posted.if_error()) {
+        std::cerr << error->message << '\n';
+        results.abandon();
+        continue;
+      }
+      ++payloads;
+      traces += record.trace_count;
+      bytes += record.payload.size();
+    }
+    // The next loop follows on from the schedule of this one.
+    if (options.speed != 0) {
+      loop_start +=
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              recorded / options.speed);
+    }
+  }
+  http_client->drain(std::chrono::steady_clock::now() + timeout);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  nlohmann::json report;
+  report["capture"] = options.capture_path;
+  report["speed"] = options.speed;
+  report["loops"] = options.loops;
+  report["recorded_seconds"] =
+      std::chrono::duration<double>(recorded).count();
+  report["duration_seconds"] = elapsed.count();
+  report["payloads"] = payloads;
+  report["traces"] = traces;
+  report["bytes"] = bytes;
+  report["payloads_per_second"] = payloads / elapsed.count();
+  report["traces_per_second"] = traces / elapsed.count();
+  report["bytes_per_second"] = bytes / elapsed.count();
+  report["max_lag_milliseconds"] =
+      std::chrono::duration<double, std::milli>(max_lag).count();
+  report["dropped_while_recording"] = (*capture)->dropped();
+  results.report(report);
+  std::cout << report.dump(2) << '\n';
+}
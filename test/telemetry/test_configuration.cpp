@@ -19,6 +19,7 @@ TELEMETRY_CONFIGURATION_TEST("defaults") {
   CHECK(cfg->enabled == true);
   CHECK(cfg->report_logs == true);
   CHECK(cfg->report_metrics == true);
+  CHECK(cfg->compression_enabled == false);
   CHECK(cfg->metrics_interval == 60s);
   CHECK(cfg->heartbeat_interval == 10s);
   CHECK(cfg->install_id.has_value() == false);
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "datadog/telemetry/distribution_sketch.h"
+#include "test.h"
+
+using namespace datadog::telemetry;
+
+#define DISTRIBUTION_SKETCH_TEST(x) TEST_CASE(x, "[distribution_sketch]")
+
+namespace {
+
+// Return the specified `q` quantile of the specified sorted `points`.
+uint64_t quantile(const std::vector<uint64_t>& points, double q) {
+  return points[std::size_t(q * double(points.size() - 1))];
+}
+
+}  // namespace
+
+DISTRIBUTION_SKETCH_TEST("few points are kept as they are") {
+  DistributionSketch sketch;
+  sketch.add(128);
+  sketch.add(0);
+  sketch.add(3000);
+  REQUIRE(sketch.count() == 3);
+  REQUIRE(sketch.points() == std::vector<uint64_t>{128, 0, 3000});
+}
+
+DISTRIBUTION_SKETCH_TEST("many points are summarized with bounded error") {
+  DistributionSketch sketch;
+  std::vector<uint64_t> added;
+  for (uint64_t i = 0; i < 100'000; ++i) {
+    const uint64_t value = (i * 7919) % 1'000'000;
+    sketch.add(value);
+    added.push_back(value);
+  }
+  sketch.add(UINT64_MAX);
+  added.push_back(UINT64_MAX);
+  std::sort(added.begin(), added.end());
+
+  REQUIRE(sketch.count() == added.size());
+  const auto points = sketch.points();
+  REQUIRE(points.size() == DistributionSketch::max_points);
+  REQUIRE(std::is_sorted(points.begin(), points.end()));
+
+  for (const double q : {0.1, 0.25, 0.5, 0.75, 0.9, 0.99}) {
+    CAPTURE(q);
+    const double expected = double(quantile(added, q));
+    const double actual = double(quantile(points, q));
+    // The relative accuracy of the buckets, plus the resolution of the
+    // returned points.
+    CHECK(std::abs(actual - expected) <= 0.02 * expected + 1000);
+  }
+}
+
+DISTRIBUTION_SKETCH_TEST("merged sketches sum their points") {
+  DistributionSketch exact;
+  exact.add(5);
+  exact.add(5);
+
+  DistributionSketch large;
+  for (std::size_t i = 0; i < 2 * DistributionSketch::max_points; ++i) {
+    large.add(1000);
+  }
+
+  DistributionSketch merged;
+  merged.merge(exact);
+  REQUIRE(merged.points() == std::vector<uint64_t>{5, 5});
+  merged.merge(large);
+  REQUIRE(merged.count() == 2 * DistributionSketch::max_points + 2);
+
+  const auto points = merged.points();
+  REQUIRE(points.size() == DistributionSketch::max_points);
+  // Two points in 2050 round to one point in 1024.
+  REQUIRE(points.front() == Approx(5).epsilon(0.02));
+  REQUIRE(points.back() == Approx(1000).epsilon(0.01));
+}
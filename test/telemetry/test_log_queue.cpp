@@ -0,0 +1,105 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "datadog/telemetry/log_queue.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace datadog::telemetry;
+
+#define LOG_QUEUE_TEST(x) TEST_CASE(x, "[log_queue]")
+
+namespace {
+
+LogMessage warning(std::string message) {
+  return LogMessage{std::move(message), LogLevel::WARNING, nullopt, 42};
+}
+
+}  // namespace
+
+LOG_QUEUE_TEST("messages are drained in order, and duplicates are merged") {
+  LogQueue queue;
+  std::vector<LogMessage> logs;
+  queue.drain(logs, 0);
+  REQUIRE(logs.empty());
+
+  for (int round = 0; round < 3; ++round) {
+    REQUIRE(queue.push(warning("first")));
+    REQUIRE(queue.push(warning("second")));
+  }
+  REQUIRE(queue.push(LogMessage{"first", LogLevel::ERROR, nullopt, 42}));
+  REQUIRE(queue.push(LogMessage{"first", LogLevel::ERROR, "stack", 42}));
+
+  queue.drain(logs, 0);
+  REQUIRE(logs.size() == 4);
+  CHECK(logs[0].message == "first");
+  CHECK(logs[0].count == 3);
+  CHECK(logs[1].message == "second");
+  CHECK(logs[1].count == 3);
+  CHECK(logs[2].level == LogLevel::ERROR);
+  CHECK(logs[2].count == 1);
+  CHECK(logs[3].stacktrace == Optional<std::string>("stack"));
+
+  // The slots are reused after draining.
+  for (std::size_t i = 0; i < 2 * LogQueue::capacity; ++i) {
+    REQUIRE(queue.push(warning("again")));
+    std::vector<LogMessage> more;
+    queue.drain(more, 0);
+    REQUIRE(more.size() == 1);
+  }
+}
+
+LOG_QUEUE_TEST("messages pushed into a full queue are dropped and counted") {
+  LogQueue queue;
+  for (std::size_t i = 0; i < LogQueue::capacity; ++i) {
+    REQUIRE(queue.push(warning(std::to_string(i))));
+  }
+  REQUIRE_FALSE(queue.push(warning("dropped")));
+  REQUIRE_FALSE(queue.push(warning("dropped")));
+
+  std::vector<LogMessage> logs;
+  queue.drain(logs, 1234);
+  REQUIRE(logs.size() == LogQueue::capacity + 1);
+  CHECK(logs.back().level == LogLevel::WARNING);
+  CHECK(logs.back().message.find("2 telemetry log messages were dropped") ==
+        0);
+  CHECK(logs.back().timestamp == 1234);
+
+  logs.clear();
+  queue.drain(logs, 0);
+  REQUIRE(logs.empty());
+}
+
+LOG_QUEUE_TEST("many threads can push at once") {
+  LogQueue queue;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&queue, i]() {
+      for (int j = 0; j < 100; ++j) {
+        queue.push(warning("thread " + std::to_string(i)));
+      }
+    });
+  }
+
+  // Drain concurrently with the producers.
+  std::vector<LogMessage> logs;
+  for (int i = 0; i < 100; ++i) {
+    queue.drain(logs, 0);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  queue.drain(logs, 0);
+
+  std::size_t total = 0;
+  for (const auto& log : logs) {
+    if (log.message.find("thread ") == 0) {
+      total += log.count;
+    } else {
+      // Messages dropped while the queue was full.
+      total += std::stoul(log.message);
+    }
+  }
+  REQUIRE(total == 400);
+}
@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "datadog/telemetry/metric_snapshot.h"
+#include "test.h"
+
+using namespace datadog::telemetry;
+
+#define METRIC_SNAPSHOT_TEST(x) TEST_CASE(x, "[metric_snapshot]")
+
+namespace {
+
+std::vector<MetricSnapshot::Point> points(const MetricSnapshot& snapshot) {
+  std::vector<MetricSnapshot::Point> result;
+  for (std::size_t i = 0; i < snapshot.size(); ++i) {
+    result.push_back(snapshot[i]);
+  }
+  return result;
+}
+
+}  // namespace
+
+METRIC_SNAPSHOT_TEST("points are kept in order until the snapshot is full") {
+  MetricSnapshot snapshot;
+  REQUIRE(snapshot.size() == 0);
+  snapshot.add(10, 3);
+  snapshot.add(20, 0);
+  snapshot.add(30, 7);
+  REQUIRE(points(snapshot) ==
+          std::vector<MetricSnapshot::Point>{{10, 3}, {20, 0}, {30, 7}});
+}
+
+METRIC_SNAPSHOT_TEST("old counter points are summed when the snapshot is full") {
+  MetricSnapshot snapshot{MetricSnapshot::Combine::sum};
+  const std::size_t count = 10 * MetricSnapshot::capacity + 3;
+  uint64_t total = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    snapshot.add(std::time_t(i), i + 1);
+    total += i + 1;
+  }
+
+  const auto kept = points(snapshot);
+  REQUIRE(kept.size() == MetricSnapshot::capacity);
+  uint64_t sum = 0;
+  for (const auto& [timestamp, value] : kept) {
+    sum += value;
+  }
+  REQUIRE(sum == total);
+  // The newest points are kept as they are, and the oldest kept point
+  // accounts for every point that came before it.
+  REQUIRE(kept.back() == MetricSnapshot::Point{std::time_t(count - 1), count});
+  REQUIRE(kept.front().first ==
+          std::time_t(count - MetricSnapshot::capacity));
+  for (std::size_t i = 1; i < kept.size(); ++i) {
+    REQUIRE(kept[i - 1].first < kept[i].first);
+  }
+}
+
+METRIC_SNAPSHOT_TEST("old rate points are averaged when the snapshot is full") {
+  MetricSnapshot snapshot{MetricSnapshot::Combine::mean};
+  for (std::size_t i = 0; i < 3 * MetricSnapshot::capacity; ++i) {
+    snapshot.add(std::time_t(i), i % 2 == 0 ? 10 : 30);
+  }
+
+  const auto kept = points(snapshot);
+  REQUIRE(kept.size() == MetricSnapshot::capacity);
+  // The oldest point combines equally many points of each value.
+  REQUIRE(kept.front().second == 20);
+  REQUIRE(kept.back().second == 30);
+}
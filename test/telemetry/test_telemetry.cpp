@@ -6,9 +6,12 @@
 #include <datadog/span_defaults.h>
 
 #include <datadog/json.hpp>
+#include <algorithm>
+#include <thread>
 #include <unordered_set>
 
 #include "../common/environment.h"
+#include "compression.h"
 #include "datadog/runtime_id.h"
 #include "datadog/telemetry/telemetry_impl.h"
 #include "mocks/http_clients.h"
@@ -302,6 +305,52 @@ TELEMETRY_IMPLEMENTATION_TEST("Tracer telemetry lifecycle") {
           telemetry3.send_configuration_change();
           CHECK(client->request_body.empty());
         }
+
+        SECTION("only changed configurations are sent") {
+          const auto changed_names = [&]() {
+            std::vector<std::string> names;
+            if (client->request_body.empty()) {
+              return names;
+            }
+            const auto message = nlohmann::json::parse(client->request_body);
+            for (const auto& conf : message["payload"]["configuration"]) {
+              names.push_back(conf["name"]);
+            }
+            std::sort(names.begin(), names.end());
+            return names;
+          };
+
+          // The service is as reported in `app-started`.
+          client->clear();
+          telemetry3.capture_configuration_change(
+              {{ConfigName::SERVICE_NAME, "foo", ConfigMetadata::Origin::CODE},
+               {ConfigName::TRACE_SAMPLING_RATE, "0.5",
+                ConfigMetadata::Origin::REMOTE_CONFIG}});
+          telemetry3.send_configuration_change();
+          CHECK(changed_names() ==
+                std::vector<std::string>{"trace_sample_rate"});
+
+          // A field that changes and then changes back before it is sent is
+          // not sent.
+          client->clear();
+          telemetry3.capture_configuration_change(
+              {{ConfigName::TRACE_SAMPLING_RATE, "1",
+                ConfigMetadata::Origin::DEFAULT}});
+          telemetry3.capture_configuration_change(
+              {{ConfigName::TRACE_SAMPLING_RATE, "0.5",
+                ConfigMetadata::Origin::REMOTE_CONFIG},
+               {ConfigName::SERVICE_NAME, "foo",
+                ConfigMetadata::Origin::REMOTE_CONFIG}});
+          telemetry3.send_configuration_change();
+          CHECK(changed_names() == std::vector<std::string>{"service"});
+
+          client->clear();
+          telemetry3.capture_configuration_change(
+              {{ConfigName::SERVICE_NAME, "foo",
+                ConfigMetadata::Origin::REMOTE_CONFIG}});
+          telemetry3.send_configuration_change();
+          CHECK(client->request_body.empty());
+        }
       }
     }
   }
@@ -452,6 +501,74 @@ TELEMETRY_IMPLEMENTATION_TEST("Tracer telemetry API") {
       CHECK(find_payload(message_batch["payload"], "app-heartbeat"));
     }
 
+    SECTION("counters incremented through handles are reported") {
+      client->clear();
+      const Counter handled{"handled_counter", "counter-test", true};
+      const auto handle = telemetry.counter_handle(handled, {"event:test"});
+      const auto same = telemetry.counter_handle(handled, {"event:test"});
+      handle.increment();
+      same.increment();
+      telemetry.increment_counter(handled, {"event:test"});
+      scheduler->trigger_metrics_capture();
+
+      // Nothing is reported for an interval without increments.
+      scheduler->trigger_metrics_capture();
+
+      handle.increment();
+      scheduler->trigger_metrics_capture();
+      scheduler->trigger_heartbeat();
+
+      auto message_batch = nlohmann::json::parse(client->request_body);
+      REQUIRE(is_valid_telemetry_payload(message_batch) == true);
+      auto generate_metrics =
+          find_payload(message_batch["payload"], "generate-metrics");
+      REQUIRE(generate_metrics.has_value());
+
+      const auto expected_metric = nlohmann::json::parse(R"(
+        {
+          "common": true,
+          "metric": "handled_counter",
+          "namespace": "counter-test",
+          "points": [
+            [ 1672484400, 3 ],
+            [ 1672484400, 1 ]
+          ],
+          "tags": [ "event:test" ],
+          "type": "count"
+        }
+      )");
+
+      bool found = false;
+      for (const auto& s : (*generate_metrics)["payload"]["series"]) {
+        if (s["metric"] == "handled_counter") {
+          CHECK(s == expected_metric);
+          found = true;
+        }
+      }
+      CHECK(found);
+
+      // A default constructed handle does nothing.
+      counter::Handle{}.increment();
+    }
+
+    SECTION("handles of counters are safe to use from many threads") {
+      counter::ShardedValue value;
+      const counter::Handle handle{&value};
+      std::vector<std::thread> threads;
+      for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+          for (int j = 0; j < 1000; ++j) {
+            handle.increment();
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      CHECK(value.exchange_zero() == 8000);
+      CHECK(value.exchange_zero() == 0);
+    }
+
     SECTION("counters can't go below zero") {
       client->clear();
       const Counter positive_counter{"positive_counter", "counter-test2", true};
@@ -803,6 +920,23 @@ TELEMETRY_IMPLEMENTATION_TEST("Tracer telemetry API") {
       CHECK(find_payload(message_batch["payload"], "app-heartbeat"));
     }
 
+    SECTION("identical logs are reported once with a count") {
+      client->clear();
+      telemetry.log_error("Flush failed");
+      telemetry.log_error("Flush failed");
+      telemetry.log_error("Flush failed");
+      scheduler->trigger_heartbeat();
+
+      auto message_batch = nlohmann::json::parse(client->request_body);
+      auto logs_message = find_payload(message_batch["payload"], "logs");
+      REQUIRE(logs_message);
+
+      auto logs_payload = (*logs_message)["payload"]["logs"];
+      REQUIRE(logs_payload.size() == 1);
+      CHECK(logs_payload[0]["message"] == "Flush failed");
+      CHECK(logs_payload[0]["count"] == 3);
+    }
+
     SECTION("dtor sends logs in `app-closing` message") {
       {
         Telemetry tmp_telemetry{*finalize_config(),
@@ -902,3 +1036,77 @@ TELEMETRY_IMPLEMENTATION_TEST("Tracer telemetry configuration") {
     CHECK(find_payload(message_batch["payload"], "app-heartbeat"));
   }
 }
+
+TELEMETRY_IMPLEMENTATION_TEST("Tracer telemetry compression") {
+  Configuration cfg;
+  cfg.compression_enabled = true;
+  auto finalized = finalize_config(cfg);
+  if (!gzip_available()) {
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::TELEMETRY_COMPRESSION_UNAVAILABLE);
+    return;
+  }
+  REQUIRE(finalized);
+
+  auto logger = std::make_shared<MockLogger>();
+  auto client = std::make_shared<MockHTTPClient>();
+  auto scheduler = std::make_shared<FakeEventScheduler>();
+  const TracerSignature tracer_signature{
+      /* runtime_id = */ RuntimeID::generate(),
+      /* service = */ "testsvc",
+      /* environment = */ "test"};
+  auto url = HTTPClient::URL::parse("http://localhost:8000");
+  Telemetry telemetry{*finalized, tracer_signature, logger,
+                      client,     scheduler,        *url};
+
+  const auto log_many = [&] {
+    for (int i = 0; i < 20; ++i) {
+      telemetry.log_error("error number " + std::to_string(i) +
+                          std::string(100, '!'));
+    }
+  };
+
+  log_many();
+  client->request_headers.items.clear();
+  scheduler->trigger_heartbeat();
+
+  const auto& body = client->request_body;
+  REQUIRE(body.size() > 2);
+  CHECK(static_cast<unsigned char>(body[0]) == 0x1f);
+  CHECK(static_cast<unsigned char>(body[1]) == 0x8b);
+  auto& headers = client->request_headers.items;
+  const auto found = headers.find("Content-Encoding");
+  REQUIRE(found != headers.end());
+  CHECK(found->second == "gzip");
+  CHECK(headers["DD-Telemetry-Request-Type"] == "message-batch");
+  CHECK(headers["Content-Length"] == std::to_string(body.size()));
+
+  SECTION("unsupported media type disables compression") {
+    client->response_status = 415;
+    client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 1);
+
+    log_many();
+    headers.clear();
+    scheduler->trigger_heartbeat();
+    CHECK(headers.count("Content-Encoding") == 0);
+    const auto message_batch = nlohmann::json::parse(client->request_body);
+    CHECK(find_payload(message_batch["payload"], "logs"));
+  }
+}
+
+TELEMETRY_IMPLEMENTATION_TEST("metric identity is computed at compile time") {
+  constexpr Counter counter{"requests", "tracers", true};
+  static_assert(counter.hash == Counter("requests", "tracers", true).hash);
+  static_assert(counter.hash != Rate("requests", "tracers", true).hash);
+  static_assert(counter.hash != Counter("requests", "tracers", false).hash);
+  static_assert(counter.hash != Counter("request", "stracers", true).hash);
+
+  // Contexts of the same metric differ by their tags.
+  const MetricContext<Counter> untagged{counter, {}};
+  const MetricContext<Counter> tagged{counter, {"endpoint:agent"}};
+  CHECK(untagged == MetricContext<Counter>{counter, {}});
+  CHECK_FALSE(untagged == tagged);
+  CHECK(tagged.hash() ==
+        MetricContext<Counter>{counter, {"endpoint:agent"}}.hash());
+}
@@ -0,0 +1,128 @@
+#include <datadog/adaptive_sampler.h>
+#include <datadog/clock.h>
+#include <datadog/error.h>
+#include <datadog/sampling_decision.h>
+#include <datadog/sampling_mechanism.h>
+#include <datadog/span_data.h>
+#include <datadog/trace_sampler.h>
+#include <datadog/trace_sampler_config.h>
+
+#include <chrono>
+#include <cmath>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define ADAPTIVE_SAMPLER_TEST(x) TEST_CASE(x, "[adaptive_sampler]")
+
+ADAPTIVE_SAMPLER_TEST("new keys are kept until their first window ends") {
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  AdaptiveSampler sampler{clock, 10};
+
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(sampler.sample_rate("service", "resource").value() == 1.0);
+  }
+
+  current_time += std::chrono::seconds(1);
+  REQUIRE(sampler.sample_rate("service", "resource").value() ==
+          Approx(10.0 / 1000));
+}
+
+ADAPTIVE_SAMPLER_TEST("the target is shared among keys by throughput") {
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  AdaptiveSampler sampler{clock, 100};
+
+  // Per second, "busy" has 1000 root spans, "quiet" has 10, and "rare" has
+  // one.  "quiet" and "rare" keep all of theirs, and "busy" gets the rest of
+  // the target.
+  double busy = 0, quiet = 0, rare = 0;
+  for (int second = 0; second < 5; ++second) {
+    for (int i = 0; i < 1000; ++i) {
+      busy = sampler.sample_rate("svc", "busy").value();
+    }
+    for (int i = 0; i < 10; ++i) {
+      quiet = sampler.sample_rate("svc", "quiet").value();
+    }
+    rare = sampler.sample_rate("other", "busy").value();
+    current_time += std::chrono::seconds(1);
+  }
+  REQUIRE(rare == 1.0);
+  REQUIRE(quiet == 1.0);
+  REQUIRE(busy == Approx(89.0 / 1000));
+
+  // When "busy" spikes, its rate follows within a few windows.
+  for (int second = 0; second < 5; ++second) {
+    for (int i = 0; i < 10'000; ++i) {
+      busy = sampler.sample_rate("svc", "busy").value();
+    }
+    current_time += std::chrono::seconds(1);
+  }
+  busy = sampler.sample_rate("svc", "busy").value();
+  REQUIRE(busy * 10'000 == Approx(100).epsilon(0.1));
+}
+
+ADAPTIVE_SAMPLER_TEST("idle keys decay and are forgotten") {
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  AdaptiveSampler sampler{clock, 10};
+
+  for (int i = 0; i < 1000; ++i) {
+    sampler.sample_rate("service", "resource");
+  }
+  current_time += std::chrono::seconds(1);
+  REQUIRE(sampler.sample_rate("service", "resource").value() < 0.1);
+
+  // After a long pause, the key is new again.
+  current_time += std::chrono::minutes(5);
+  REQUIRE(sampler.sample_rate("service", "resource").value() == 1.0);
+}
+
+ADAPTIVE_SAMPLER_TEST("trace sampler uses adaptive rates if no rule matches") {
+  TraceSamplerConfig config;
+  config.adaptive_target_per_second = 1;
+  config.max_per_second = 1000;
+  TraceSamplerConfig::Rule rule;
+  rule.service = "ruled";
+  rule.sample_rate = 1.0;
+  config.rules.push_back(rule);
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  TraceSampler sampler{*finalized, clock};
+  REQUIRE(sampler.config_json()["adaptive_target_per_second"] == 1.0);
+
+  SpanData span;
+  span.service = "testsvc";
+  span.resource = "GET /";
+  for (int i = 0; i < 100; ++i) {
+    span.trace_id.low = i;
+    sampler.decide(span);
+  }
+  current_time += std::chrono::seconds(1);
+
+  span.trace_id.low = 12345;
+  auto decision = sampler.decide(span);
+  REQUIRE(decision.mechanism == int(SamplingMechanism::RULE));
+  REQUIRE(decision.configured_rate);
+  REQUIRE(decision.configured_rate->value() == Approx(0.01));
+
+  span.service = "ruled";
+  decision = sampler.decide(span);
+  REQUIRE(decision.configured_rate);
+  REQUIRE(decision.configured_rate->value() == 1.0);
+}
+
+ADAPTIVE_SAMPLER_TEST("adaptive sampling target must be positive") {
+  TraceSamplerConfig config;
+  auto target = GENERATE(0.0, -1.0, std::nan(""));
+  config.adaptive_target_per_second = target;
+  auto finalized = finalize_config(config);
+  REQUIRE_FALSE(finalized);
+  REQUIRE(finalized.error().code ==
+          Error::ADAPTIVE_SAMPLING_TARGET_OUT_OF_RANGE);
+}
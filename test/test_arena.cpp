@@ -0,0 +1,268 @@
+#include <datadog/arena.h>
+#include <datadog/null_collector.h>
+#include <datadog/span_data.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_ARENA(x) TEST_CASE(x, "[arena]")
+
+namespace {
+
+// `CountingResource` is a memory resource that counts the bytes allocated from
+// it and not yet deallocated.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  std::size_t outstanding = 0;
+  std::size_t allocations = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    outstanding += bytes;
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* pointer, std::size_t bytes,
+                     std::size_t alignment) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+}  // namespace
+
+TEST_ARENA("Arena allocations are aligned and distinct") {
+  Arena* arena = Arena::create();
+
+  const std::size_t alignments[] = {1, 2, 4, 8, 16};
+  std::vector<char*> allocations;
+  for (int i = 0; i < 100; ++i) {
+    const std::size_t alignment = alignments[i % 5];
+    auto* pointer = static_cast<char*>(arena->allocate(24, alignment));
+    REQUIRE(reinterpret_cast<std::uintptr_t>(pointer) % alignment == 0);
+    allocations.push_back(pointer);
+  }
+
+  for (std::size_t i = 1; i < allocations.size(); ++i) {
+    REQUIRE(allocations[i] != allocations[i - 1]);
+  }
+
+  arena->release();
+}
+
+TEST_ARENA("Arena grows by whole chunks and handles oversized allocations") {
+  Arena* arena = Arena::create();
+  REQUIRE(arena->capacity() == 0);
+
+  arena->allocate(16, 8);
+  REQUIRE(arena->capacity() == Arena::chunk_size);
+
+  // Oversized allocations don't consume chunk storage.
+  void* big = arena->allocate(Arena::chunk_size * 2, 8);
+  REQUIRE(big != nullptr);
+  REQUIRE(arena->capacity() == Arena::chunk_size);
+
+  for (std::size_t i = 0; i < Arena::chunk_size / 64; ++i) {
+    arena->allocate(64, 8);
+  }
+  REQUIRE(arena->capacity() == 2 * Arena::chunk_size);
+
+  arena->release();
+}
+
+TEST_ARENA("Arena allocations made concurrently do not overlap") {
+  Arena* arena = Arena::create();
+
+  const int thread_count = 4;
+  const int allocations_per_thread = 2000;
+  const std::size_t size = 24;
+  std::vector<std::vector<char*>> allocations(thread_count);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < allocations_per_thread; ++j) {
+        auto* pointer = static_cast<char*>(arena->allocate(size, 8));
+        std::memset(pointer, i, size);
+        allocations[i].push_back(pointer);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Each allocation still holds what its thread wrote to it.
+  std::set<char*> distinct;
+  for (int i = 0; i < thread_count; ++i) {
+    for (char* pointer : allocations[i]) {
+      REQUIRE(reinterpret_cast<std::uintptr_t>(pointer) % 8 == 0);
+      REQUIRE(std::count(pointer, pointer + size, char(i)) == int(size));
+      distinct.insert(pointer);
+    }
+  }
+  REQUIRE(distinct.size() == thread_count * allocations_per_thread);
+
+  arena->release();
+}
+
+TEST_ARENA("Arena takes all of its memory from an upstream resource") {
+  CountingResource upstream;
+  Arena* arena = Arena::create(&upstream);
+  REQUIRE(upstream.outstanding >= sizeof(Arena));
+
+  arena->allocate(16, 8);
+  arena->allocate(Arena::chunk_size * 2, 8);
+  REQUIRE(upstream.outstanding >= 3 * Arena::chunk_size);
+
+  auto span = SpanData::make(arena);
+  span->tags.emplace("foo", "bar");
+  arena->release();
+  REQUIRE(upstream.outstanding > 0);
+
+  span.reset();
+  REQUIRE(upstream.outstanding == 0);
+}
+
+TEST_ARENA("ArenaAllocator") {
+  Arena* arena = Arena::create();
+
+  SECTION("allocates from the arena") {
+    std::vector<int, ArenaAllocator<int>> numbers{ArenaAllocator<int>(arena)};
+    REQUIRE(arena->capacity() == 0);
+    numbers.push_back(42);
+    REQUIRE(arena->capacity() == Arena::chunk_size);
+    REQUIRE(numbers.get_allocator().arena() == arena);
+  }
+
+  SECTION("copies use the global heap") {
+    std::vector<int, ArenaAllocator<int>> numbers{ArenaAllocator<int>(arena)};
+    numbers.push_back(42);
+    const auto copy = numbers;
+    REQUIRE(copy.get_allocator().arena() == nullptr);
+    REQUIRE(copy == numbers);
+  }
+
+  arena->release();
+}
+
+TEST_ARENA("SpanData allocated from an arena") {
+  Arena* arena = Arena::create();
+
+  auto span = SpanData::make(arena);
+  REQUIRE(span->arena() == arena);
+  REQUIRE(span->tags.get_allocator().arena() == arena);
+  REQUIRE(span->numeric_tags.get_allocator().arena() == arena);
+
+  span->tags.emplace("hello", "world");
+  span->numeric_tags.emplace("answer", 42);
+  REQUIRE(span->tags.at("hello") == "world");
+  REQUIRE(span->numeric_tags.at("answer") == 42);
+
+  // The span keeps the arena alive after the creator's reference is gone.
+  arena->release();
+  auto sibling = SpanData::make(span->arena());
+  REQUIRE(sibling->arena() == span->arena());
+  span.reset();
+  sibling->tags.emplace("still", "here");
+  REQUIRE(sibling->tags.at("still") == "here");
+}
+
+TEST_ARENA("SpanData allocated from the global heap") {
+  auto span = SpanData::make(nullptr);
+  REQUIRE(span->arena() == nullptr);
+  REQUIRE(span->tags.get_allocator().arena() == nullptr);
+
+  auto other = std::make_unique<SpanData>();
+  REQUIRE(other->arena() == nullptr);
+}
+
+TEST_ARENA("Tracer with trace_arena_enabled") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const bool enabled = GENERATE(true, false);
+  config.trace_arena_enabled = enabled;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto root = tracer.create_span();
+    root.set_tag("foo", "bar");
+    auto child = root.create_child();
+    child.set_tag("baz", "qux");
+    auto grandchild = child.create_child();
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& chunk = collector->chunks.front();
+  REQUIRE(chunk.size() == 3);
+
+  Arena* const arena = chunk.front()->arena();
+  REQUIRE((arena != nullptr) == enabled);
+  for (const auto& span_ptr : chunk) {
+    REQUIRE(span_ptr->arena() == arena);
+  }
+  REQUIRE(chunk[0]->tags.at("foo") == "bar");
+  REQUIRE(chunk[1]->tags.at("baz") == "qux");
+}
+
+TEST_ARENA("Tracer with memory_resource") {
+  CountingResource resource;
+  {
+    TracerConfig config;
+    config.service = "testsvc";
+    const auto collector = std::make_shared<MockCollector>();
+    config.collector = collector;
+    config.logger = std::make_shared<MockLogger>();
+    config.memory_resource = &resource;
+
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    REQUIRE(finalized->trace_arena_enabled);
+    Tracer tracer{*finalized};
+
+    {
+      auto root = tracer.create_span();
+      root.set_tag("foo", "bar");
+      auto child = root.create_child();
+      REQUIRE(resource.outstanding > 0);
+    }
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->chunks.front().front()->arena() != nullptr);
+    const auto allocations = resource.allocations;
+    REQUIRE(allocations > 0);
+
+    // The spans are released together with the chunk.
+    collector->chunks.clear();
+    REQUIRE(resource.outstanding == 0);
+
+    { auto another = tracer.create_span(); }
+    REQUIRE(resource.allocations > allocations);
+  }
+  REQUIRE(resource.outstanding == 0);
+}
@@ -0,0 +1,162 @@
+#include <datadog/async_logger.h>
+#include <datadog/error.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <variant>
+
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define ASYNC_LOGGER_TEST(x) TEST_CASE(x, "[async_logger]")
+
+namespace {
+
+// `BlockingLogger` is a `MockLogger` whose first `log_error` waits until
+// `release` is called, so that messages accumulate in an `AsyncLogger`'s
+// queue meanwhile.
+struct BlockingLogger : public MockLogger {
+  std::mutex gate_mutex;
+  std::condition_variable gate;
+  bool entered = false;
+  bool released = false;
+
+  using MockLogger::log_error;
+  void log_error(const LogFunc& write) override {
+    {
+      std::unique_lock<std::mutex> lock(gate_mutex);
+      if (!entered) {
+        entered = true;
+        gate.notify_all();
+        gate.wait(lock, [&]() { return released; });
+      }
+    }
+    MockLogger::log_error(write);
+  }
+
+  void wait_until_entered() {
+    std::unique_lock<std::mutex> lock(gate_mutex);
+    gate.wait(lock, [&]() { return entered; });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(gate_mutex);
+    released = true;
+    gate.notify_all();
+  }
+};
+
+std::string text_of(const MockLogger::Entry& entry) {
+  return std::get<std::string>(entry.payload);
+}
+
+}  // namespace
+
+ASYNC_LOGGER_TEST("messages are written to the destination in order") {
+  const auto destination = std::make_shared<MockLogger>();
+  AsyncLogger logger{destination};
+
+  logger.log_startup([](std::ostream& log) { log << "starting"; });
+  logger.log_error([](std::ostream& log) { log << "callback"; });
+  logger.log_error(Error{Error::OTHER, "error"});
+  logger.log_error("view");
+  logger.flush();
+
+  REQUIRE(destination->entries.size() == 4);
+  REQUIRE(destination->entries[0].kind == MockLogger::Entry::STARTUP);
+  REQUIRE(text_of(destination->entries[0]) == "starting");
+  REQUIRE(text_of(destination->entries[1]) == "callback");
+  REQUIRE(text_of(destination->entries[2]) ==
+          "[dd-trace-cpp error code 1] error");
+  REQUIRE(text_of(destination->entries[3]) == "view");
+}
+
+ASYNC_LOGGER_TEST("queued messages are written when the logger is destroyed") {
+  const auto destination = std::make_shared<MockLogger>();
+  {
+    AsyncLogger logger{destination};
+    for (int i = 0; i < 5; ++i) {
+      logger.log_error(std::to_string(i));
+    }
+  }
+  REQUIRE(destination->error_count() == 5);
+}
+
+ASYNC_LOGGER_TEST("identical queued messages are coalesced") {
+  const auto destination = std::make_shared<BlockingLogger>();
+  AsyncLogger logger{destination};
+
+  logger.log_error("first");
+  destination->wait_until_entered();
+  for (int i = 0; i < 3; ++i) {
+    logger.log_error("again");
+  }
+  destination->release();
+  logger.flush();
+
+  REQUIRE(destination->entries.size() == 2);
+  REQUIRE(text_of(destination->entries[0]) == "first");
+  REQUIRE(text_of(destination->entries[1]) == "again [repeated 2 more times]");
+}
+
+ASYNC_LOGGER_TEST("messages logged while the queue is full are dropped") {
+  const auto destination = std::make_shared<BlockingLogger>();
+  AsyncLoggerOptions options;
+  options.max_queued_messages = 2;
+  AsyncLogger logger{destination, options};
+
+  logger.log_error("first");
+  destination->wait_until_entered();
+  logger.log_error("second");
+  logger.log_error("third");
+  logger.log_error("fourth");
+  destination->release();
+  logger.flush();
+
+  REQUIRE(destination->entries.size() == 4);
+  REQUIRE(text_of(destination->entries[1]) == "second");
+  REQUIRE(text_of(destination->entries[2]) == "third");
+  const std::string notice = text_of(destination->entries[3]);
+  REQUIRE(notice.find("1 log messages were dropped") == 0);
+}
+
+ASYNC_LOGGER_TEST("messages are rate limited by their site") {
+  const auto destination = std::make_shared<MockLogger>();
+  TimePoint now;
+  AsyncLoggerOptions options;
+  options.max_messages_per_site = 2;
+  options.rate_limit_period = 10s;
+  options.clock = [&]() { return now; };
+  AsyncLogger logger{destination, options};
+
+  // Each message is logged by the same lambda expression, and so from the
+  // same site.
+  const auto log_from_site = [&](int i) {
+    logger.log_error([i](std::ostream& log) { log << "site " << i; });
+  };
+  for (int i = 0; i < 5; ++i) {
+    log_from_site(i);
+  }
+  // Another site is limited separately, and so are startup messages.
+  logger.log_error(Error{Error::OTHER, "other"});
+  for (int i = 0; i < 3; ++i) {
+    logger.log_startup([i](std::ostream& log) { log << "startup " << i; });
+  }
+  logger.flush();
+  REQUIRE(destination->error_count() == 3);
+  REQUIRE(destination->startup_count() == 3);
+  REQUIRE(text_of(destination->entries[1]) == "site 1");
+
+  now += 10s;
+  log_from_site(5);
+  logger.flush();
+  REQUIRE(text_of(destination->entries.back()) ==
+          "site 5 [3 similar messages were suppressed]");
+}
@@ -0,0 +1,86 @@
+#include <datadog/atomic_snapshot.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_ATOMIC_SNAPSHOT(x) TEST_CASE(x, "[atomic_snapshot]")
+
+TEST_ATOMIC_SNAPSHOT("load returns the most recently stored value") {
+  AtomicSnapshot<const int> snapshot{std::make_shared<const int>(1)};
+  REQUIRE(*snapshot.load() == 1);
+
+  const auto first = snapshot.load();
+  snapshot.store(std::make_shared<const int>(2));
+  REQUIRE(*snapshot.load() == 2);
+  // Values loaded earlier are unaffected.
+  REQUIRE(*first == 1);
+}
+
+TEST_ATOMIC_SNAPSHOT("replaced values are released") {
+  std::weak_ptr<const int> weak;
+  AtomicSnapshot<const int> snapshot{std::make_shared<const int>(1)};
+  {
+    const auto first = snapshot.load();
+    weak = first;
+    snapshot.store(std::make_shared<const int>(2));
+    // A reader's copy keeps the replaced value alive.
+    REQUIRE(*first == 1);
+  }
+  // The snapshot does not.
+  REQUIRE(weak.expired());
+
+  {
+    AtomicSnapshot<const int> scoped{std::make_shared<const int>(3)};
+    weak = scoped.load();
+  }
+  REQUIRE(weak.expired());
+}
+
+TEST_ATOMIC_SNAPSHOT("readers see only stored values while a writer stores") {
+  AtomicSnapshot<const int> snapshot{std::make_shared<const int>(0)};
+  const int num_values = 1000;
+  std::atomic<bool> done{false};
+
+  std::vector<std::thread> readers;
+  std::atomic<int> failures{0};
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+      int previous = 0;
+      while (!done.load()) {
+        const int value = *snapshot.load();
+        // Values are stored in increasing order.
+        if (value < previous || value > num_values) {
+          ++failures;
+        }
+        previous = value;
+      }
+    });
+  }
+
+  // Each replaced value is released once the readers are done with it, so
+  // that the snapshot does not accumulate the values stored.
+  std::vector<std::weak_ptr<const int>> stored;
+  for (int value = 1; value <= num_values; ++value) {
+    auto shared = std::make_shared<const int>(value);
+    stored.push_back(shared);
+    snapshot.store(std::move(shared));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  REQUIRE(failures == 0);
+  REQUIRE(*snapshot.load() == num_values);
+  const auto live =
+      std::count_if(stored.begin(), stored.end(),
+                    [](const auto& weak) { return !weak.expired(); });
+  REQUIRE(live == 1);
+}
@@ -300,3 +300,101 @@ BAGGAGE_TEST("accessors") {
     CHECK(bag.empty() == true);
   }
 }
+
+BAGGAGE_TEST("extracted baggage is injected as extracted") {
+  const std::string header = "team = proxy;prop, company=datadog,user=dmehala";
+  const std::unordered_map<std::string, std::string> headers{
+      {"baggage", header}};
+  MockDictReader reader(headers);
+
+  auto maybe_baggage = Baggage::extract(reader);
+  REQUIRE(maybe_baggage);
+  CHECK(maybe_baggage->get("team") == "proxy");
+
+  MockDictWriter writer;
+  REQUIRE(maybe_baggage->inject(writer));
+  CHECK(writer.items.at("baggage") == header);
+
+  SECTION("unless the header exceeds the limits") {
+    const Baggage::Options opts{
+        /*.max_bytes = */ header.size() - 1,
+        /*.max_items =*/1000,
+    };
+    MockDictWriter limited;
+    maybe_baggage->inject(limited, opts);
+    CHECK(limited.items.at("baggage").size() < header.size());
+  }
+
+  SECTION("unless it is modified") {
+    maybe_baggage->remove("company");
+    MockDictWriter modified;
+    REQUIRE(maybe_baggage->inject(modified));
+    const auto& injected = modified.items.at("baggage");
+    CHECK((injected == "team=proxy,user=dmehala" ||
+           injected == "user=dmehala,team=proxy"));
+  }
+}
+
+BAGGAGE_TEST("the first value of a repeated key is extracted") {
+  const std::unordered_map<std::string, std::string> headers{
+      {"baggage", "a=1,b=2,a=3"}};
+  MockDictReader reader(headers);
+
+  auto maybe_baggage = Baggage::extract(reader);
+  REQUIRE(maybe_baggage);
+  CHECK(maybe_baggage->size() == 2);
+  CHECK(maybe_baggage->get("a") == "1");
+
+  MockDictWriter writer;
+  REQUIRE(maybe_baggage->inject(writer));
+  CHECK(writer.items.at("baggage") == "a=1,b=2");
+}
+
+BAGGAGE_TEST("items survive many replaced values") {
+  Baggage bag;
+  for (int i = 0; i < 1000; ++i) {
+    bag.set("key", std::to_string(i));
+    bag.set("other" + std::to_string(i % 3), "value");
+  }
+  CHECK(bag.size() == 4);
+  CHECK(bag.get("key") == "999");
+  CHECK(bag.get("other1") == "value");
+}
+
+BAGGAGE_TEST("characters not allowed in keys or values are percent-encoded") {
+  Baggage bag;
+  bag.set("user id", "a,b;c d=\xc3\xa9");
+  CHECK(bag.encoded_size() == 30);
+
+  MockDictWriter writer;
+  REQUIRE(bag.inject(writer));
+  CHECK(writer.items.at("baggage") == "user%20id=a%2Cb%3Bc%20d=%C3%A9");
+
+  MockDictReader reader(writer.items);
+  auto extracted = Baggage::extract(reader);
+  REQUIRE(extracted);
+  CHECK(extracted->get("user%20id") == "a%2Cb%3Bc%20d=%C3%A9");
+}
+
+BAGGAGE_TEST("injection stops at the last item that fits") {
+  Baggage bag;
+  bag.set("a", "1");
+  bag.set("b", "22");
+  bag.set("c", "3");
+
+  SECTION("by bytes") {
+    const Baggage::Options opts{/*.max_bytes = */ 8, /*.max_items =*/10};
+    MockDictWriter writer;
+    auto injected = bag.inject(writer, opts);
+    REQUIRE(!injected);
+    CHECK(injected.error().code == Error::Code::BAGGAGE_MAXIMUM_BYTES_REACHED);
+    CHECK(writer.items.at("baggage") == "a=1,b=22");
+  }
+
+  SECTION("by items") {
+    const Baggage::Options opts{/*.max_bytes = */ 100, /*.max_items =*/3};
+    MockDictWriter writer;
+    REQUIRE(bag.inject(writer, opts));
+    CHECK(writer.items.at("baggage") == "a=1,b=22,c=3");
+  }
+}
@@ -0,0 +1,121 @@
+// These are tests for `BaggageTags`, the compiled form of
+// `TracerConfig::baggage_tag_keys`, and for how the tracer tags extracted
+// spans with the baggage items that it names.
+
+#include <datadog/error.h>
+#include <datadog/propagation_style.h>
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "baggage_tags.h"
+#include "mocks/collectors.h"
+#include "mocks/dict_readers.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_BAGGAGE_TAGS(x) TEST_CASE(x, "[baggage_tags]")
+
+namespace {
+
+Tracer make_tracer(const std::shared_ptr<MockCollector>& collector,
+                   std::vector<PropagationStyle> extraction_styles = {
+                       PropagationStyle::DATADOG, PropagationStyle::BAGGAGE}) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.extraction_styles = std::move(extraction_styles);
+  config.baggage_tag_keys = {"tenant", "region"};
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  return Tracer{*finalized};
+}
+
+}  // namespace
+
+TEST_BAGGAGE_TAGS("baggage tag names") {
+  const auto compiled = BaggageTags::compile({"tenant", "user.id"});
+  REQUIRE(compiled);
+  REQUIRE(compiled->entries().size() == 2);
+  REQUIRE(compiled->entries()[0].key == "tenant");
+  REQUIRE(compiled->entries()[0].tag == "baggage.tenant");
+  REQUIRE(compiled->entries()[1].key == "user.id");
+  REQUIRE(compiled->entries()[1].tag == "baggage.user.id");
+}
+
+TEST_BAGGAGE_TAGS("invalid baggage tag keys") {
+  std::vector<std::string> keys;
+  SECTION("empty key") { keys = {""}; }
+  SECTION("repeated key") { keys = {"tenant", "region", "tenant"}; }
+  SECTION("key not allowed by the baggage grammar") { keys = {"a key"}; }
+  SECTION("too many keys") {
+    for (int i = 0; i <= int(BaggageTags::max_keys); ++i) {
+      keys.push_back("key" + std::to_string(i));
+    }
+  }
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.baggage_tag_keys = keys;
+  auto finalized = finalize_config(config);
+  REQUIRE(!finalized);
+  REQUIRE(finalized.error().code == Error::TRACER_INVALID_BAGGAGE_TAG_KEYS);
+}
+
+TEST_BAGGAGE_TAGS("extracted spans are tagged with baggage items") {
+  const auto collector = std::make_shared<MockCollector>();
+  auto tracer = make_tracer(collector);
+
+  const bool has_context = GENERATE(false, true);
+  CAPTURE(has_context);
+  std::unordered_map<std::string, std::string> headers{
+      {"baggage",
+       "session=abc, tenant = acme;prop=1,user=bob,tenant=other,region=eu"}};
+  if (has_context) {
+    headers.emplace("x-datadog-trace-id", "123");
+    headers.emplace("x-datadog-parent-id", "456");
+  }
+  const MockDictReader reader{headers};
+  {
+    auto span = tracer.extract_or_create_span(reader);
+    REQUIRE((span.trace_id().low == 123) == has_context);
+  }
+
+  const auto& tags = collector->first_span().tags;
+  REQUIRE(tags.at("baggage.tenant") == "acme");
+  REQUIRE(tags.at("baggage.region") == "eu");
+  REQUIRE(tags.count("baggage.session") == 0);
+  REQUIRE(tags.count("baggage.user") == 0);
+}
+
+TEST_BAGGAGE_TAGS("baggage items are not tagged") {
+  const auto collector = std::make_shared<MockCollector>();
+  std::unordered_map<std::string, std::string> headers{
+      {"x-datadog-trace-id", "123"}, {"x-datadog-parent-id", "456"}};
+
+  SECTION("if the header is malformed") {
+    auto tracer = make_tracer(collector);
+    headers.emplace("baggage", "tenant=acme,region");
+    auto span = tracer.extract_span(MockDictReader{headers});
+    REQUIRE(span);
+  }
+  SECTION("if baggage is not an extraction style") {
+    auto tracer = make_tracer(collector, {PropagationStyle::DATADOG});
+    headers.emplace("baggage", "tenant=acme,region=eu");
+    auto span = tracer.extract_span(MockDictReader{headers});
+    REQUIRE(span);
+  }
+
+  const auto& tags = collector->first_span().tags;
+  REQUIRE(tags.count("baggage.tenant") == 0);
+  REQUIRE(tags.count("baggage.region") == 0);
+}
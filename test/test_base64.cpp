@@ -1,5 +1,8 @@
 #include <datadog/base64.h>
 
+#include <cstdint>
+#include <string>
+
 #include "catch.hpp"
 #include "test.h"
 
@@ -30,3 +33,79 @@ BASE64_TEST("padding") {
   CHECK(base64_decode("bGlnaHQgd28=") == "light wo");
   CHECK(base64_decode("bGlnaHQgd29y") == "light wor");
 }
+
+BASE64_TEST("final group ending in zero bits") {
+  // "A" is the digit zero, not padding.
+  CHECK(base64_decode("AAAA") == std::string(3, '\0'));
+  CHECK(base64_decode("YWIA") == std::string("ab\0", 3));
+  CHECK(base64_decode("YWAA") == std::string("a`\0", 3));
+}
+
+BASE64_TEST("padding is valid only at the end") {
+  CHECK(base64_decode("bG==aHQg") == "");
+  CHECK(base64_decode("b===") == "");
+  CHECK(base64_decode("bGl=aHQgd29y") == "");
+}
+
+BASE64_TEST("characters outside of ASCII are invalid") {
+  CHECK(base64_decode("bGln\xff\xff\xff\xff") == "");
+  CHECK(base64_decode(std::string(32, '\x80')) == "");
+}
+
+BASE64_TEST("decoding into a buffer") {
+  std::string buffer = "previous contents";
+  CHECK(base64_decode(buffer, "bGlnaHQgdw=="));
+  CHECK(buffer == "light w");
+
+  CHECK_FALSE(base64_decode(buffer, "bGlnaHQgdw"));
+  CHECK(buffer == "");
+}
+
+namespace {
+
+std::string base64_encode(const std::string& input) {
+  static const char digits[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string output;
+  for (std::size_t i = 0; i < input.size(); i += 3) {
+    const auto byte = [&](std::size_t j) -> std::uint32_t {
+      return j < input.size() ? static_cast<std::uint8_t>(input[j]) : 0;
+    };
+    const std::uint32_t bits = byte(i) << 16 | byte(i + 1) << 8 | byte(i + 2);
+    output += digits[bits >> 18 & 63];
+    output += digits[bits >> 12 & 63];
+    output += i + 1 < input.size() ? digits[bits >> 6 & 63] : '=';
+    output += i + 2 < input.size() ? digits[bits & 63] : '=';
+  }
+  return output;
+}
+
+}  // namespace
+
+BASE64_TEST("vector and portable decoding agree") {
+  // Inputs long enough to be decoded sixteen characters at a time, with and
+  // without an invalid character at each position.
+  std::string bytes;
+  for (int i = 0; i < 100; ++i) {
+    bytes += static_cast<char>(i * 37 + 11);
+    const std::string encoded = base64_encode(bytes);
+
+    std::string decoded;
+    std::string decoded_portable;
+    CHECK(base64_decode(decoded, encoded));
+    CHECK(detail::base64_decode_portable(decoded_portable, encoded));
+    CHECK(decoded == bytes);
+    CHECK(decoded_portable == bytes);
+
+    for (const char invalid : {'!', '=', '\x80', ':', '@', '[', '`', '{'}) {
+      for (std::size_t j = 0; j + 4 < encoded.size(); j += 5) {
+        std::string corrupted = encoded;
+        corrupted[j] = invalid;
+        CHECK_FALSE(base64_decode(decoded, corrupted));
+        CHECK_FALSE(
+            detail::base64_decode_portable(decoded_portable, corrupted));
+        CHECK(decoded == "");
+      }
+    }
+  }
+}
@@ -0,0 +1,121 @@
+#include <datadog/capture_file.h>
+#include <datadog/error.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define CAPTURE_FILE_TEST(x) TEST_CASE(x, "[capture_file]")
+
+namespace {
+
+// A path for a capture file that is removed when the `TemporaryPath` is
+// destroyed.
+class TemporaryPath {
+  std::filesystem::path path_;
+
+ public:
+  TemporaryPath()
+      : path_(std::filesystem::temp_directory_path() /
+              ("dd-trace-cpp-capture-file-test-" +
+               std::to_string(::getpid()))) {
+    std::filesystem::remove(path_);
+  }
+  ~TemporaryPath() { std::filesystem::remove(path_); }
+
+  std::string string() const { return path_.string(); }
+};
+
+}  // namespace
+
+CAPTURE_FILE_TEST("records are read in the order appended") {
+  const TemporaryPath path;
+  auto created = CaptureFile::create(path.string(), 1024);
+  REQUIRE(created);
+  auto& file = **created;
+  REQUIRE(file.capacity() == 1024);
+  REQUIRE(file.size() == 0);
+
+  REQUIRE(file.append(1ms, 2, {"first"}));
+  // A payload can be appended in parts.
+  REQUIRE(file.append(3ms, 1, {"sec", "", "ond"}));
+  REQUIRE(file.size() == 2);
+
+  // The records are visible to another reader of the file.
+  auto opened = CaptureFile::open(path.string());
+  REQUIRE(opened);
+  for (const CaptureFile* reader : {&file, opened->get()}) {
+    std::uint64_t position = 0;
+    CaptureFile::Record record;
+    REQUIRE(reader->next(position, record));
+    REQUIRE(record.offset == 1ms);
+    REQUIRE(record.trace_count == 2);
+    REQUIRE(record.payload == "first");
+    REQUIRE(reader->next(position, record));
+    REQUIRE(record.offset == 3ms);
+    REQUIRE(record.trace_count == 1);
+    REQUIRE(record.payload == "second");
+    REQUIRE_FALSE(reader->next(position, record));
+  }
+}
+
+CAPTURE_FILE_TEST("capture records that do not fit are dropped") {
+  const TemporaryPath path;
+  auto created = CaptureFile::create(path.string(), 64);
+  REQUIRE(created);
+  auto& file = **created;
+
+  // Each record takes sixteen bytes more than its payload, padded to eight.
+  REQUIRE(file.append(0ms, 1, {std::string(30, 'x')}));
+  REQUIRE_FALSE(file.append(0ms, 1, {std::string(9, 'y')}));
+  REQUIRE(file.append(0ms, 1, {""}));
+  REQUIRE_FALSE(file.append(0ms, 1, {"z"}));
+  REQUIRE(file.size() == 2);
+  REQUIRE(file.dropped() == 2);
+}
+
+CAPTURE_FILE_TEST("creating a capture discards the previous one") {
+  const TemporaryPath path;
+  {
+    auto created = CaptureFile::create(path.string(), 128);
+    REQUIRE(created);
+    REQUIRE((*created)->append(0ms, 1, {"old"}));
+  }
+  auto created = CaptureFile::create(path.string(), 256);
+  REQUIRE(created);
+  REQUIRE((*created)->size() == 0);
+  auto opened = CaptureFile::open(path.string());
+  REQUIRE(opened);
+  REQUIRE((*opened)->capacity() == 256);
+  REQUIRE((*opened)->size() == 0);
+}
+
+CAPTURE_FILE_TEST("CaptureFile errors") {
+  const TemporaryPath path;
+
+  SECTION("the capacity must hold a record") {
+    auto created = CaptureFile::create(path.string(), 8);
+    REQUIRE(!created);
+    REQUIRE(created.error().code == Error::CAPTURE_FILE_INVALID_CAPACITY);
+  }
+
+  SECTION("the file must exist to be opened") {
+    auto opened = CaptureFile::open(path.string());
+    REQUIRE(!opened);
+    REQUIRE(opened.error().code == Error::CAPTURE_FILE_UNAVAILABLE);
+  }
+
+  SECTION("the file must be a capture file") {
+    std::ofstream(path.string()) << std::string(4096, 'x');
+    auto opened = CaptureFile::open(path.string());
+    REQUIRE(!opened);
+    REQUIRE(opened.error().code == Error::CAPTURE_FILE_INVALID_FORMAT);
+  }
+}
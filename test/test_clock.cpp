@@ -0,0 +1,40 @@
+#include <datadog/clock.h>
+
+#include <chrono>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define CLOCK_TEST(x) TEST_CASE(x, "[clock]")
+
+CLOCK_TEST("calibrated clock follows the system and steady clocks") {
+  const auto before = default_clock();
+  const auto now = calibrated_clock();
+  const auto after = default_clock();
+
+  REQUIRE(now.tick >= before.tick);
+  REQUIRE(now.tick <= after.tick);
+  // The wall time is derived from the steady time, so allow for the system
+  // clock having been read at a slightly different moment.
+  const auto slack = std::chrono::milliseconds(100);
+  REQUIRE(now.wall >= before.wall - slack);
+  REQUIRE(now.wall <= after.wall + slack);
+}
+
+CLOCK_TEST("calibrated clock wall time advances with its steady time") {
+  const auto first = calibrated_clock();
+  TimePoint last = first;
+  for (int i = 0; i < 1000; ++i) {
+    const auto next = calibrated_clock();
+    REQUIRE(next.tick >= last.tick);
+    last = next;
+  }
+  // The wall time moved as far as the steady time, except for any adjustment
+  // of the system clock picked up by a calibration in between.
+  const auto elapsed =
+      std::chrono::duration_cast<Duration>(last.wall - first.wall);
+  const auto tolerance = std::chrono::milliseconds(100);
+  REQUIRE(elapsed >= (last - first) - tolerance);
+  REQUIRE(elapsed <= (last - first) + tolerance);
+}
@@ -0,0 +1,156 @@
+// This test covers `CompiledSpanMatchers`, defined in
+// `compiled_span_matchers.h`, by comparing its results with those of
+// `SpanMatcher::match`.
+
+#include <datadog/compiled_span_matchers.h>
+#include <datadog/span_data.h>
+#include <datadog/span_matcher.h>
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define COMPILED_SPAN_MATCHERS_TEST(x) \
+  TEST_CASE(x, "[compiled_span_matchers]")
+
+namespace {
+
+SpanMatcher matcher(std::string service, std::string name,
+                    std::string resource,
+                    std::unordered_map<std::string, std::string> tags = {}) {
+  SpanMatcher result;
+  result.service = std::move(service);
+  result.name = std::move(name);
+  result.resource = std::move(resource);
+  result.tags = std::move(tags);
+  return result;
+}
+
+// Return the index of the first of the specified `matchers` that the
+// specified `span` matches, by linear search.
+std::size_t find_linearly(const std::vector<SpanMatcher>& matchers,
+                          const SpanData& span) {
+  for (std::size_t i = 0; i < matchers.size(); ++i) {
+    if (matchers[i].match(span)) {
+      return i;
+    }
+  }
+  return CompiledSpanMatchers::npos;
+}
+
+}  // namespace
+
+COMPILED_SPAN_MATCHERS_TEST("compiled matchers agree with SpanMatcher") {
+  const std::vector<SpanMatcher> matchers{
+      matcher("checkout", "*", "GET /cart"),
+      matcher("CHECKOUT", "http.request", "*", {{"region", "eu-*"}}),
+      matcher("pay*", "*", "*"),
+      matcher("*", "db.query", "SELECT ?"),
+      matcher("checkout", "*", "*", {{"tier", "gold"}}),
+      matcher("*-worker", "*", "*"),
+      matcher("search", "http.*", "*"),
+  };
+  std::vector<const SpanMatcher*> pointers;
+  for (const auto& m : matchers) {
+    pointers.push_back(&m);
+  }
+  const CompiledSpanMatchers compiled{pointers};
+
+  const std::vector<std::string> services{"checkout", "Checkout", "payments",
+                                          "email-worker", "search", "other"};
+  const std::vector<std::string> names{"http.request", "db.query",
+                                       "http.client", "queue.pop"};
+  const std::vector<std::string> resources{"GET /cart", "get /CART",
+                                           "SELECT 1", "SELECT 12", "*"};
+  const std::vector<std::vector<std::pair<std::string, std::string>>> tag_sets{
+      {}, {{"region", "EU-west"}}, {{"tier", "gold"}}, {{"region", "us"}}};
+
+  // Match each span twice, so that the second match uses the cache.
+  for (int pass = 0; pass < 2; ++pass) {
+    for (const auto& service : services) {
+      for (const auto& name : names) {
+        for (const auto& resource : resources) {
+          for (const auto& tags : tag_sets) {
+            SpanData span;
+            span.service = service;
+            span.name = name;
+            span.resource = resource;
+            for (const auto& [key, value] : tags) {
+              span.tags.insert_or_assign(std::string(key), std::string(value));
+            }
+            CAPTURE(pass, service, name, resource, tags.size());
+            REQUIRE(compiled.find(span) == find_linearly(matchers, span));
+          }
+        }
+      }
+    }
+  }
+}
+
+COMPILED_SPAN_MATCHERS_TEST("literal patterns reject other spans") {
+  // Every service pattern is a literal, or every name pattern is.
+  const auto matcher_lists = GENERATE(values<std::vector<SpanMatcher>>({
+      {matcher("checkout", "http.request", "*"),
+       matcher("Payments", "*", "GET *")},
+      {matcher("checkout", "HTTP.Request", "*"),
+       matcher("*", "db.query", "*")},
+  }));
+  std::vector<const SpanMatcher*> pointers;
+  for (const auto& m : matcher_lists) {
+    pointers.push_back(&m);
+  }
+  const CompiledSpanMatchers compiled{pointers};
+
+  for (const auto& service : {"checkout", "PAYMENTS", "search"}) {
+    for (const auto& name : {"http.request", "db.query", "queue.pop"}) {
+      for (const auto& resource : {"GET /cart", "SELECT 1"}) {
+        SpanData span;
+        span.service = service;
+        span.name = name;
+        span.resource = resource;
+        CAPTURE(service, name, resource);
+        REQUIRE(compiled.find(span) == find_linearly(matcher_lists, span));
+      }
+    }
+  }
+}
+
+COMPILED_SPAN_MATCHERS_TEST("spans are matched once the cache is full") {
+  const std::vector<SpanMatcher> matchers{
+      matcher("checkout", "*", "GET /item/1*"),
+      matcher("*", "http.request", "*"),
+  };
+  std::vector<const SpanMatcher*> pointers;
+  for (const auto& m : matchers) {
+    pointers.push_back(&m);
+  }
+  const CompiledSpanMatchers compiled{pointers};
+
+  // Far more distinct resources than the cache holds, matched twice.  The
+  // resources are too long to be interned, so that they do not fill the
+  // process-wide pool of interned strings.
+  const std::string suffix(300, 'x');
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < 3000; ++i) {
+      SpanData span;
+      span.service = "checkout";
+      span.name = i % 3 ? "http.request" : "db.query";
+      span.resource = "GET /item/" + std::to_string(i) + suffix;
+      CAPTURE(pass, i);
+      REQUIRE(compiled.find(span) == find_linearly(matchers, span));
+    }
+  }
+}
+
+COMPILED_SPAN_MATCHERS_TEST("no compiled matchers") {
+  const CompiledSpanMatchers compiled{{}};
+  SpanData span;
+  span.service = "anything";
+  REQUIRE(compiled.find(span) == CompiledSpanMatchers::npos);
+}
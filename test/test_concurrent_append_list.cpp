@@ -0,0 +1,119 @@
+#include <datadog/concurrent_append_list.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_APPEND_LIST(x) TEST_CASE(x, "[concurrent_append_list]")
+
+TEST_APPEND_LIST("elements keep their order and addresses") {
+  ConcurrentAppendList<int, 2> list;
+  REQUIRE(list.empty());
+
+  std::vector<const int*> addresses;
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(list.push_back(i) == std::size_t(i));
+    addresses.push_back(&list[i]);
+  }
+  REQUIRE(list.size() == 100);
+
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(list[i] == i);
+    REQUIRE(&list[i] == addresses[i]);
+  }
+}
+
+TEST_APPEND_LIST("take moves out every element") {
+  ConcurrentAppendList<std::unique_ptr<int>, 4> list;
+  for (int i = 0; i < 10; ++i) {
+    list.push_back(std::make_unique<int>(i));
+  }
+
+  const auto taken = list.take();
+  REQUIRE(list.empty());
+  REQUIRE(taken.size() == 10);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(*taken[i] == i);
+  }
+
+  // The list can be reused afterward.
+  list.push_back(std::make_unique<int>(42));
+  REQUIRE(list.size() == 1);
+  REQUIRE(*list[0] == 42);
+}
+
+TEST_APPEND_LIST("concurrent appends") {
+  const int thread_count = 8;
+  const int per_thread = 1000;
+  ConcurrentAppendList<int> list;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < per_thread; ++i) {
+        list.push_back(t * per_thread + i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto values = list.take();
+  REQUIRE(values.size() == thread_count * per_thread);
+  std::sort(values.begin(), values.end());
+  for (int i = 0; i < thread_count * per_thread; ++i) {
+    REQUIRE(values[i] == i);
+  }
+}
+
+TEST_APPEND_LIST("elements can be found while others are appended") {
+  const int thread_count = 4;
+  const int per_thread = 1000;
+  ConcurrentAppendList<std::unique_ptr<int>, 2> list;
+  std::atomic<bool> done{false};
+
+  // A reader sees only elements whose appending completed, even in segments
+  // that are not allocated yet.
+  std::atomic<int> failures{0};
+  std::thread reader([&]() {
+    while (!done.load()) {
+      const std::size_t size = list.size();
+      for (std::size_t i = 0; i < size; ++i) {
+        if (const auto* element = list.find_appended(i)) {
+          if (!*element || **element < 0) {
+            ++failures;
+          }
+        }
+      }
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < per_thread; ++i) {
+        list.push_back(std::make_unique<int>(i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  reader.join();
+
+  REQUIRE(failures == 0);
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    REQUIRE(list.find_appended(i) == &list[i]);
+  }
+  list.take();
+  REQUIRE(list.find_appended(0) == nullptr);
+}
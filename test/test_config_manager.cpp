@@ -337,20 +337,24 @@ CONFIG_MANAGER_TEST("remote configuration handling") {
           {"hello", "world"}, {"foo", "bar"}};
 
       const auto old_tags = config_manager.span_defaults()->tags;
+      const auto old_version = config_manager.span_defaults_version();
 
       const auto err = config_manager.on_update(config_update);
       CHECK(!err);
 
       const auto new_tags = config_manager.span_defaults()->tags;
+      const auto new_version = config_manager.span_defaults_version();
 
       CHECK(old_tags != new_tags);
       CHECK(new_tags == expected_tags);
+      CHECK(new_version != old_version);
 
       config_manager.on_revert(config_update);
 
       const auto reverted_tags = config_manager.span_defaults()->tags;
 
       CHECK(old_tags == reverted_tags);
+      CHECK(config_manager.span_defaults_version() != new_version);
     }
   }
 
@@ -703,3 +707,158 @@ CONFIG_MANAGER_TEST("remote configuration handling") {
     }
   }
 }
+
+CONFIG_MANAGER_TEST("local configuration updates") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.environment = "test";
+  config.tags = std::unordered_map<std::string, std::string>{{"team", "apm"}};
+  config.trace_sampler.sample_rate = 0.5;
+
+  auto final_cfg = *finalize_config(config);
+  ConfigManager config_manager(final_cfg);
+
+  const auto sample_rates = [&]() {
+    std::vector<double> rates;
+    const auto sampler_cfg = config_manager.trace_sampler()->config_json();
+    for (const auto& rule : sampler_cfg["rules"]) {
+      rates.push_back(rule["sample_rate"]);
+    }
+    return rates;
+  };
+
+  SECTION("an invalid update changes nothing") {
+    const auto old_defaults = config_manager.span_defaults();
+    const auto old_sampler_cfg = config_manager.trace_sampler()->config_json();
+
+    TracerUpdate empty_service;
+    empty_service.service = "";
+    empty_service.environment = "prod";
+    auto result = config_manager.apply_local_update(empty_service);
+    REQUIRE(result.if_error());
+    CHECK(result.error().code == Error::TRACER_UPDATE_EMPTY_SERVICE);
+
+    TracerUpdate bad_rate;
+    bad_rate.environment = "prod";
+    bad_rate.trace_sample_rate = 2;
+    result = config_manager.apply_local_update(bad_rate);
+    REQUIRE(result.if_error());
+    CHECK(result.error().code == Error::RATE_OUT_OF_RANGE);
+
+    CHECK(config_manager.span_defaults() == old_defaults);
+    CHECK(config_manager.trace_sampler()->config_json() == old_sampler_cfg);
+  }
+
+  SECTION("span defaults are replaced") {
+    const auto old_version = config_manager.span_defaults_version();
+
+    TracerUpdate update;
+    update.service = "othersvc";
+    update.environment = "prod";
+    REQUIRE(config_manager.apply_local_update(update));
+
+    const auto defaults = config_manager.span_defaults();
+    CHECK(defaults->service == "othersvc");
+    CHECK(defaults->environment == "prod");
+    CHECK(defaults->tags == *config.tags);
+    CHECK(config_manager.span_defaults_version() != old_version);
+  }
+
+  SECTION("remote tags take precedence until they are reverted") {
+    rc::Listener::Configuration config_update{
+        "id", "",
+        R"({"lib_config": {"tracing_tags": ["hello:world"]}})", 1,
+        rc::product::Flag::APM_TRACING};
+    REQUIRE(!config_manager.on_update(config_update));
+
+    TracerUpdate update;
+    update.service = "othersvc";
+    update.tags = std::unordered_map<std::string, std::string>{{"team", "x"}};
+    REQUIRE(config_manager.apply_local_update(update));
+
+    const std::unordered_map<std::string, std::string> remote_tags{
+        {"hello", "world"}};
+    CHECK(config_manager.span_defaults()->service == "othersvc");
+    CHECK(config_manager.span_defaults()->tags == remote_tags);
+
+    config_manager.on_revert(config_update);
+    CHECK(config_manager.span_defaults()->service == "othersvc");
+    CHECK(config_manager.span_defaults()->tags == *update.tags);
+  }
+
+  SECTION("sampling rules are replaced beneath remote rules") {
+    TracerUpdate update;
+    TraceSamplerConfig::Rule rule;
+    rule.service = "foo";
+    rule.sample_rate = 0.1;
+    update.trace_sampling_rules.emplace({rule});
+    REQUIRE(config_manager.apply_local_update(update));
+    // The overall sample rate is kept.
+    CHECK(sample_rates() == std::vector<double>{0.1, 0.5});
+
+    rc::Listener::Configuration config_update{
+        "id", "", R"({"lib_config": {"tracing_sampling_rate": 0.25}})", 1,
+        rc::product::Flag::APM_TRACING};
+    REQUIRE(!config_manager.on_update(config_update));
+    CHECK(sample_rates() == std::vector<double>{0.1, 0.25});
+
+    update.trace_sampling_rules.reset();
+    update.trace_sample_rate = 0.75;
+    REQUIRE(config_manager.apply_local_update(update));
+    CHECK(sample_rates() == std::vector<double>{0.1, 0.25});
+
+    config_manager.on_revert(config_update);
+    CHECK(sample_rates() == std::vector<double>{0.1, 0.75});
+  }
+
+  SECTION("reporting of traces can be disabled") {
+    TracerUpdate update;
+    update.report_traces = false;
+    REQUIRE(config_manager.apply_local_update(update));
+    CHECK(!config_manager.report_traces());
+  }
+}
+
+CONFIG_MANAGER_TEST("tracers share remote configurations") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.trace_sampler.sample_rate = 0.5;
+  auto final_cfg = *finalize_config(config);
+
+  const auto sample_rate = [](ConfigManager& config_manager) {
+    const auto sampler_cfg = config_manager.trace_sampler()->config_json();
+    return sampler_cfg["rules"].back()["sample_rate"].get<double>();
+  };
+
+  const std::string content =
+      R"({"lib_config": {"tracing_sampling_rate": 0.25}})";
+  rc::Listener::Configuration config_update{"id", "", content, 1,
+                                            rc::product::Flag::APM_TRACING};
+
+  // Each of the tracers applies the configuration, and continues to when
+  // the others revert it, whether or not it was shared meanwhile.
+  for (int round = 0; round < 2; ++round) {
+    auto first = std::make_unique<ConfigManager>(final_cfg);
+    auto second = std::make_unique<ConfigManager>(final_cfg);
+    REQUIRE(!first->on_update(config_update));
+    REQUIRE(!second->on_update(config_update));
+    CHECK(sample_rate(*first) == 0.25);
+    CHECK(sample_rate(*second) == 0.25);
+
+    first->on_revert(config_update);
+    CHECK(sample_rate(*first) == 0.5);
+    CHECK(sample_rate(*second) == 0.25);
+
+    first.reset();
+    ConfigManager third(final_cfg);
+    REQUIRE(!third.on_update(config_update));
+    CHECK(sample_rate(third) == 0.25);
+  }
+
+  // A configuration that cannot be decoded is not shared.
+  config_update.content = R"({"lib_config": {"tracing_sampling_rate": 2}})";
+  ConfigManager config_manager(final_cfg);
+  CHECK(config_manager.on_update(config_update));
+  CHECK(config_manager.on_update(config_update));
+  CHECK(sample_rate(config_manager) == 0.5);
+}
@@ -0,0 +1,139 @@
+// These are tests for `ScopePromise`, which carries the scopes of a C++20
+// coroutine across its suspension points.  They are compiled only when
+// coroutines are supported.
+
+#include <datadog/coroutine.h>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <datadog/scope.h>
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+
+#include <coroutine>
+#include <memory>
+#include <thread>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_COROUTINE(x) TEST_CASE(x, "[coroutine]")
+
+namespace {
+
+// `Task` is a coroutine that starts eagerly and is destroyed by its `Task`.
+struct Task {
+  struct promise_type : ScopePromise {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    auto initial_suspend() {
+      return transform_initial_suspend(std::suspend_never{});
+    }
+    auto final_suspend() noexcept {
+      return transform_final_suspend(std::suspend_always{});
+    }
+    void return_void() {}
+    void unhandled_exception() { throw; }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  Task(const Task&) = delete;
+  ~Task() { handle.destroy(); }
+};
+
+// `ResumeOnNewThread` resumes the awaiting coroutine on a new thread, and
+// then stores that thread's innermost scope in `scope_after` once the
+// coroutine is suspended again or finishes.
+struct ResumeOnNewThread {
+  std::thread* thread;
+  Scope** scope_after;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    *thread = std::thread{[handle, scope_after = scope_after]() {
+      handle.resume();
+      *scope_after = Scope::current();
+    }};
+  }
+  void await_resume() {}
+};
+
+Tracer make_tracer() {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  return Tracer{*finalized};
+}
+
+}  // namespace
+
+TEST_COROUTINE("a coroutine's scopes move with it to other threads") {
+  auto tracer = make_tracer();
+  auto root = tracer.create_span();
+  Scope caller_scope{root};
+
+  std::thread worker;
+  Scope* worker_scope_after = &caller_scope;
+  Span* active_before = nullptr;
+  Span* active_after = nullptr;
+  Span* child_ptr = nullptr;
+  Scope* parent_after = nullptr;
+
+  auto coroutine = [&]() -> Task {
+    // The coroutine begins with its caller's active span.
+    auto child = Scope::active_span()->create_child();
+    child_ptr = &child;
+    Scope scope{child};
+    active_before = Scope::active_span();
+    co_await ResumeOnNewThread{&worker, &worker_scope_after};
+    active_after = Scope::active_span();
+    parent_after = Scope::current()->parent();
+  };
+
+  {
+    Task task = coroutine();
+    // The coroutine's scope is not left behind on this thread.
+    REQUIRE(Scope::current() == &caller_scope);
+    worker.join();
+  }
+
+  REQUIRE(active_before == child_ptr);
+  REQUIRE(active_after == child_ptr);
+  REQUIRE(parent_after == &caller_scope);
+  // The worker thread's scopes are restored when the coroutine finishes.
+  REQUIRE(worker_scope_after == nullptr);
+  REQUIRE(Scope::current() == &caller_scope);
+}
+
+TEST_COROUTINE("a coroutine that does not suspend leaves the scopes as is") {
+  auto tracer = make_tracer();
+  auto root = tracer.create_span();
+  Scope caller_scope{root};
+
+  Span* active = nullptr;
+  auto coroutine = [&]() -> Task {
+    auto child = root.create_child();
+    Scope scope{child};
+    active = Scope::active_span();
+    co_await std::suspend_never{};
+    REQUIRE(Scope::active_span() == active);
+  };
+
+  {
+    Task task = coroutine();
+    REQUIRE(active != nullptr);
+    REQUIRE(active != &root);
+    REQUIRE(Scope::current() == &caller_scope);
+  }
+}
+
+#endif
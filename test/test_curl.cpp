@@ -6,10 +6,18 @@
 #include <datadog/tracer.h>
 #include <datadog/tracer_config.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <datadog/json.hpp>
 #include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
 #include <system_error>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include "datadog/clock.h"
 #include "mocks/loggers.h"
@@ -24,6 +32,11 @@ class SingleRequestMockCurlLibrary : public CurlLibrary {
   HeaderCallback on_header_ = nullptr;
   void *user_data_on_write_ = nullptr;
   WriteCallback on_write_ = nullptr;
+  void *user_data_on_read_ = nullptr;
+  ReadCallback on_read_ = nullptr;
+  // If the request body is read via callback, then `request_body_` is what
+  // was read.
+  std::string request_body_;
   CURL *added_handle_ = nullptr;
   CURLMsg message_;
   enum class state {
@@ -79,6 +92,16 @@ class SingleRequestMockCurlLibrary : public CurlLibrary {
     return CURLE_OK;
   }
 
+  CURLcode easy_setopt_readdata(CURL *, void *data) override {
+    user_data_on_read_ = data;
+    return CURLE_OK;
+  }
+
+  CURLcode easy_setopt_readfunction(CURL *, ReadCallback on_read) override {
+    on_read_ = on_read;
+    return CURLE_OK;
+  }
+
   CURLcode easy_setopt_timeout_ms(CURL *, long) override { return CURLE_OK; }
 
   CURLMcode multi_add_handle(CURLM *, CURL *easy_handle) override {
@@ -114,6 +137,16 @@ class SingleRequestMockCurlLibrary : public CurlLibrary {
 
     // If any of these `REQUIRE`s fail, an exception will be thrown and the
     // test will abort. The runtime will print the exception first, though.
+    if (on_read_) {
+      // Read the request body in small pieces, so that reads span segments.
+      char buffer[3];
+      std::size_t length;
+      while ((length = on_read_(buffer, 1, sizeof buffer,
+                                user_data_on_read_)) != 0) {
+        request_body_.append(buffer, length);
+      }
+    }
+
     REQUIRE(on_header_);
     REQUIRE(user_data_on_header_);
     *running_handles = 1;
@@ -343,6 +376,12 @@ CURL_TEST("setopt failures") {
       }
       return CURLE_OK;
     }
+    CURLcode easy_setopt_tcp_keepalive(CURL *, long) override {
+      if (fail == CURLOPT_TCP_KEEPALIVE) {
+        return error;
+      }
+      return CURLE_OK;
+    }
     CURLcode easy_setopt_unix_socket_path(CURL *, const char *) override {
       if (fail == CURLOPT_UNIX_SOCKET_PATH) {
         return error;
@@ -382,6 +421,7 @@ CURL_TEST("setopt failures") {
                         CASE(CURLOPT_HEADERFUNCTION), CASE(CURLOPT_HTTPHEADER),
                         CASE(CURLOPT_POST), CASE(CURLOPT_POSTFIELDS),
                         CASE(CURLOPT_POSTFIELDSIZE), CASE(CURLOPT_PRIVATE),
+                        CASE(CURLOPT_TCP_KEEPALIVE),
                         CASE(CURLOPT_UNIX_SOCKET_PATH), CASE(CURLOPT_URL),
                         CASE(CURLOPT_WRITEDATA), CASE(CURLOPT_WRITEFUNCTION)}));
 
@@ -470,11 +510,353 @@ CURL_TEST("handles are always cleaned up") {
     client.reset();
   }
 
+  // Completed requests' handles are kept for reuse until the `Curl` object is
+  // destroyed.
+  client.reset();
+
   // Here are the checks relevant to this test.
   REQUIRE(library.created_handles_.size() == 1);
   REQUIRE(library.created_handles_ == library.destroyed_handles_);
 }
 
+CURL_TEST("handles are reused for requests to the same endpoint") {
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  SingleRequestMockCurlLibrary library;
+  auto client = std::make_shared<Curl>(logger, clock, library);
+
+  const auto send = [&](const HTTPClient::URL &url) {
+    int status = -1;
+    const auto dummy_deadline = clock().tick + std::chrono::seconds(10);
+    const auto result = client->post(
+        url, ignore, "whatever",
+        [&](int response_status, const DictReader &, std::string) {
+          status = response_status;
+        },
+        ignore, dummy_deadline);
+    REQUIRE(result);
+    client->drain(clock().tick + std::chrono::seconds(1));
+    REQUIRE(status == 200);
+  };
+
+  const HTTPClient::URL url = {"http", "localhost:8126", "/v0.4/traces", ""};
+  send(url);
+  send(url);
+  REQUIRE(library.created_handles_.size() == 1);
+  REQUIRE(library.destroyed_handles_.empty());
+
+  auto config = nlohmann::json::parse(client->config());
+  CHECK(config["config"]["handles_created"] == 1);
+  CHECK(config["config"]["handles_reused"] == 1);
+
+  // A different endpoint gets its own handle.
+  send({"http", "otherhost:8126", "/v0.4/traces", ""});
+  REQUIRE(library.created_handles_.size() == 2);
+
+  client.reset();
+  REQUIRE(library.created_handles_ == library.destroyed_handles_);
+}
+
+CURL_TEST("header lines are shared between requests to the same URL") {
+  class MockCurlLibrary : public SingleRequestMockCurlLibrary {
+   public:
+    // The header lines of each request, and the number of list nodes
+    // allocated.
+    std::vector<std::vector<std::string>> headers_;
+    int appended_ = 0;
+
+    CURLcode easy_setopt_httpheader(CURL *, curl_slist *list) override {
+      auto &lines = headers_.emplace_back();
+      for (; list; list = list->next) {
+        lines.emplace_back(list->data);
+      }
+      return CURLE_OK;
+    }
+
+    curl_slist *slist_append(curl_slist *list, const char *string) override {
+      ++appended_;
+      return SingleRequestMockCurlLibrary::slist_append(list, string);
+    }
+  };
+
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  MockCurlLibrary library;
+  auto client = std::make_shared<Curl>(logger, clock, library);
+
+  const auto send = [&](const HTTPClient::URL &url, int count) {
+    const auto set_headers = [&](DictWriter &headers) {
+      headers.set("A", "1");
+      headers.set("Count", std::to_string(count));
+      headers.set("B", "2");
+    };
+    const auto result =
+        client->post(url, set_headers, "whatever", ignore, ignore,
+                     clock().tick + std::chrono::seconds(10));
+    REQUIRE(result);
+    client->drain(clock().tick + std::chrono::seconds(1));
+  };
+
+  const HTTPClient::URL url = {"http", "localhost:8126", "/v0.4/traces", ""};
+  // The first request's lines are all shared.  The second request finds
+  // that "Count" changed, and so shares only "A" and "B".  The third
+  // allocates only its "Count".
+  send(url, 1);
+  REQUIRE(library.appended_ == 3);
+  send(url, 2);
+  REQUIRE(library.appended_ == 3 + 3);
+  send(url, 3);
+  REQUIRE(library.appended_ == 3 + 3 + 1);
+  // A different URL has its own lines.
+  send({"http", "localhost:8126", "/telemetry/proxy/api/v2/apmtelemetry", ""},
+       4);
+  REQUIRE(library.appended_ == 3 + 3 + 1 + 3);
+
+  REQUIRE(library.headers_.size() == 4);
+  for (int count = 1; count <= 4; ++count) {
+    auto &lines = library.headers_[count - 1];
+    std::sort(lines.begin(), lines.end());
+    const std::vector<std::string> expected{
+        "A: 1", "B: 2", "Count: " + std::to_string(count)};
+    REQUIRE(lines == expected);
+  }
+}
+
+CURL_TEST("the event loop waits until the nearest request deadline") {
+  class MockCurlLibrary : public SingleRequestMockCurlLibrary {
+   public:
+    std::mutex mutex_;
+    std::condition_variable polled_;
+    std::vector<int> poll_timeouts_;
+
+    CURLMcode multi_poll(CURLM *multi_handle, curl_waitfd extra_fds[],
+                         unsigned extra_nfds, int timeout_ms,
+                         int *numfds) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        poll_timeouts_.push_back(timeout_ms);
+      }
+      polled_.notify_all();
+      // Don't actually wait that long.
+      return SingleRequestMockCurlLibrary::multi_poll(
+          multi_handle, extra_fds, extra_nfds, std::min(timeout_ms, 10),
+          numfds);
+    }
+
+    // Wait for a poll whose timeout satisfies the specified `predicate`.
+    bool wait_for_poll(const std::function<bool(int)> &predicate) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      return polled_.wait_for(lock, std::chrono::seconds(5), [&]() {
+        return !poll_timeouts_.empty() && predicate(poll_timeouts_.back());
+      });
+    }
+  };
+
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  MockCurlLibrary library;
+  // The request is never done.
+  library.on_multi_perform = []() { return CURLM_OK; };
+  auto client = std::make_shared<Curl>(logger, clock, library);
+
+  // Without requests, the loop waits for as long as it can.
+  REQUIRE(
+      library.wait_for_poll([](int timeout) { return timeout >= 60'000; }));
+
+  const HTTPClient::URL url = {"http", "whatever", "", ""};
+  const auto result = client->post(url, ignore, "whatever", ignore, ignore,
+                                   clock().tick + std::chrono::seconds(3));
+  REQUIRE(result);
+  REQUIRE(library.wait_for_poll(
+      [](int timeout) { return timeout > 0 && timeout <= 3'000; }));
+}
+
+CURL_TEST("host names are resolved in the background") {
+  class MockCurlLibrary : public SingleRequestMockCurlLibrary {
+   public:
+    std::mutex mutex_;
+    std::vector<std::string> resolved_;
+    // The `CURLOPT_RESOLVE` entry of each request, or "" if none.
+    std::vector<std::string> resolve_entries_;
+
+    CURLcode easy_setopt_httpheader(CURL *handle,
+                                    curl_slist *headers) override {
+      resolve_entries_.emplace_back();
+      return SingleRequestMockCurlLibrary::easy_setopt_httpheader(handle,
+                                                                  headers);
+    }
+
+    CURLcode easy_setopt_resolve(CURL *, curl_slist *hosts) override {
+      REQUIRE(hosts);
+      REQUIRE(!hosts->next);
+      resolve_entries_.back() = hosts->data;
+      return CURLE_OK;
+    }
+
+    std::string resolve_host(const std::string &host,
+                             const std::string &port) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      resolved_.push_back(host + ":" + port);
+      return "10.0.0.1,[fe80::1]";
+    }
+  };
+
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  MockCurlLibrary library;
+  CurlOptions options;
+  options.dns_cache_ttl = std::chrono::hours(1);
+  auto client = std::make_shared<Curl>(
+      logger, clock, library,
+      [](std::function<void()> &&work) { return std::thread(std::move(work)); },
+      options);
+
+  const auto send = [&](const HTTPClient::URL &url) {
+    const auto result = client->post(url, ignore, "whatever", ignore, ignore,
+                                     clock().tick + std::chrono::seconds(10));
+    REQUIRE(result);
+    client->drain(clock().tick + std::chrono::seconds(1));
+    return library.resolve_entries_.back();
+  };
+
+  const HTTPClient::URL url = {"http", "agent.example:8126", "/v0.4/traces",
+                               ""};
+  // The first request waits for libcurl to resolve the host name, and later
+  // ones use the addresses resolved in the background.
+  REQUIRE(send(url) == "");
+  std::string entry;
+  for (int i = 0; i < 500 && entry.empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    entry = send(url);
+  }
+  REQUIRE(entry == "agent.example:8126:10.0.0.1,[fe80::1]");
+
+  // Addresses and "localhost" are not resolved.
+  REQUIRE(send({"http", "127.0.0.1:8126", "/v0.4/traces", ""}) == "");
+  REQUIRE(send({"http", "[::1]:8126", "/v0.4/traces", ""}) == "");
+  REQUIRE(send({"http", "localhost:8126", "/v0.4/traces", ""}) == "");
+  REQUIRE(send({"unix", "/var/run/datadog/apm.socket", "/v0.4/traces", ""}) ==
+          "");
+
+  client.reset();
+  REQUIRE(library.resolved_ == std::vector<std::string>{"agent.example:8126"});
+}
+
+CURL_TEST("request body segments are sent in order") {
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  SingleRequestMockCurlLibrary library;
+  const auto client = std::make_shared<Curl>(logger, clock, library);
+
+  HTTPClient::BodySegments body;
+  for (const char *segment : {"hello", "", ", ", "segmented", " world"}) {
+    body.push_back(std::make_shared<const std::string>(segment));
+  }
+
+  int status = -1;
+  Optional<Error> post_error;
+  const HTTPClient::URL url = {"http", "whatever", "", ""};
+  const auto result = client->post_segments(
+      url, ignore, std::move(body),
+      [&](int response_status, const DictReader &, std::string) {
+        status = response_status;
+      },
+      [&](const Error &error) { post_error = error; },
+      clock().tick + std::chrono::seconds(10));
+
+  REQUIRE(result);
+  client->drain(clock().tick + std::chrono::seconds(1));
+  REQUIRE_FALSE(post_error);
+  REQUIRE(status == 200);
+  REQUIRE(library.request_body_ == "hello, segmented world");
+}
+
+CURL_TEST("HTTP/2 option") {
+  class MockCurlLibrary : public SingleRequestMockCurlLibrary {
+   public:
+    bool http2_supported = true;
+    curl_version_info_data info{};
+    long pipelining = -1;
+    long http_version = -1;
+    long pipewait = -1;
+
+    curl_version_info_data *version_info(CURLversion) override {
+      info.features = http2_supported ? CURL_VERSION_HTTP2 : 0;
+      return &info;
+    }
+    CURLMcode multi_setopt_pipelining(CURLM *, long bitmask) override {
+      pipelining = bitmask;
+      return CURLM_OK;
+    }
+    CURLcode easy_setopt_http_version(CURL *, long version) override {
+      http_version = version;
+      return CURLE_OK;
+    }
+    CURLcode easy_setopt_pipewait(CURL *, long wait) override {
+      pipewait = wait;
+      return CURLE_OK;
+    }
+  };
+
+  const auto clock = default_clock;
+  const auto logger = std::make_shared<MockLogger>();
+  MockCurlLibrary library;
+  const auto make_thread = [](auto &&func) {
+    return std::thread(std::move(func));
+  };
+  CurlOptions options;
+  std::string scheme = "http";
+
+  SECTION("is disabled by default") {
+    options.http2 = false;
+  }
+  SECTION("uses prior knowledge for plain text") {
+    options.http2 = true;
+  }
+  SECTION("negotiates over TLS") {
+    options.http2 = true;
+    scheme = "https";
+  }
+  SECTION("falls back to HTTP/1.1 if libcurl lacks support") {
+    options.http2 = true;
+    library.http2_supported = false;
+  }
+
+  const auto client =
+      std::make_shared<Curl>(logger, clock, library, make_thread, options);
+  const bool expect_http2 = options.http2 && library.http2_supported;
+  if (options.http2 && !library.http2_supported) {
+    REQUIRE(logger->error_count() == 1);
+    REQUIRE(logger->first_error().code == Error::CURL_HTTP2_UNAVAILABLE);
+  }
+
+  int status = -1;
+  const HTTPClient::URL url = {scheme, "localhost:8126", "/v0.4/traces", ""};
+  const auto result = client->post(
+      url, ignore, "whatever",
+      [&](int response_status, const DictReader &, std::string) {
+        status = response_status;
+      },
+      ignore, clock().tick + std::chrono::seconds(10));
+  REQUIRE(result);
+  client->drain(clock().tick + std::chrono::seconds(1));
+  REQUIRE(status == 200);
+
+  const auto config = nlohmann::json::parse(client->config());
+  REQUIRE(config["config"]["http2"] == expect_http2);
+  if (expect_http2) {
+    REQUIRE(library.pipelining == CURLPIPE_MULTIPLEX);
+    REQUIRE(library.pipewait == 1);
+    const long expected_version = scheme == "https"
+                                      ? CURL_HTTP_VERSION_2TLS
+                                      : CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE;
+    REQUIRE(library.http_version == expected_version);
+  } else {
+    REQUIRE(library.pipelining == -1);
+    REQUIRE(library.http_version == -1);
+  }
+}
+
 CURL_TEST("post() deadline exceeded before request start") {
   const auto clock = default_clock;
   Curl client{std::make_shared<NullLogger>(), clock};
@@ -2,13 +2,26 @@
 #include <datadog/config_manager.h>
 #include <datadog/datadog_agent.h>
 #include <datadog/datadog_agent_config.h>
+#include <datadog/shared_trace_buffer.h>
+#include <datadog/span_data.h>
+#include <datadog/spill_file.h>
 #include <datadog/telemetry/telemetry.h>
+#include <datadog/trace_segment.h>
 #include <datadog/tracer.h>
 #include <datadog/tracer_config.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "compression.h"
 #include "mocks/event_schedulers.h"
 #include "mocks/http_clients.h"
 #include "mocks/loggers.h"
@@ -78,6 +91,22 @@ DATADOG_AGENT_TEST("CollectorResponse") {
     REQUIRE(logger->error_count() == 0);
   }
 
+  SECTION("other properties are skipped") {
+    {
+      http_client->response_status = 200;
+      http_client->response_body
+          << "{\"other\": {\"rate_by_service\": 5, \"x\": [1, {}]}, "
+          << "\"rate_by_service\": {\""
+          << CollectorResponse::key_of_default_rate
+          << "\": 1, \"service:wiggle,env:foo\": 0.25}, \"list\": [null]}";
+      Tracer tracer{*finalized};
+      auto span = tracer.create_span();
+      (void)span;
+    }
+    REQUIRE(event_scheduler->cancelled);
+    REQUIRE(logger->error_count() == 0);
+  }
+
   SECTION("HTTP success with empty body") {
     // Don't echo error messages.
     logger->echo = nullptr;
@@ -110,6 +139,9 @@ DATADOG_AGENT_TEST("CollectorResponse") {
          "{\"rate_by_service\": {\"service:foo,env:bar\": []}}"},
         {"invalid sample rate",
          "{\"rate_by_service\": {\"service:foo,env:bar\": -1.337}}"},
+        {"sample rate is a string",
+         "{\"rate_by_service\": {\"service:foo,env:bar\": \"0.5\"}}"},
+        {"trailing characters", "{\"rate_by_service\": {}} {}"},
     }));
 
     CAPTURE(test_case.name);
@@ -232,6 +264,245 @@ DATADOG_AGENT_TEST("Remote Configuration") {
   }
 }
 
+DATADOG_AGENT_TEST("Remote Configuration backs off while nothing changes") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_poll_interval_seconds = 1;
+  config.agent.remote_configuration_max_poll_interval_seconds = 4;
+  config.telemetry.enabled = false;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  const auto& agent_config =
+      std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+  const TracerSignature signature(RuntimeID::generate(), "testsvc", "test");
+  DatadogAgent agent(agent_config, config.logger, signature, {});
+
+  // The Remote Configuration poll is the last recurring event scheduled.
+  REQUIRE(event_scheduler->recurrence_interval == std::chrono::seconds(1));
+  // Return the polls, among the specified number of `ticks` of the poll
+  // interval, that sent a request.
+  const auto polls = [&](int ticks) {
+    std::vector<int> sent;
+    for (int tick = 1; tick <= ticks; ++tick) {
+      http_client->clear();
+      event_scheduler->event_callback();
+      if (!http_client->request_body.empty()) {
+        sent.push_back(tick);
+        http_client->drain(std::chrono::steady_clock::now());
+      }
+    }
+    return sent;
+  };
+
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+  // The interval doubles after each empty response, up to four ticks.
+  REQUIRE(polls(12) == std::vector<int>{1, 3, 7, 11});
+
+  // A response that is processed restores the poll interval.
+  http_client->response_body.str("");
+  http_client->response_body << R"({"targets": "bm90IGpzb24="})";
+  REQUIRE(polls(3) == std::vector<int>{3});
+  REQUIRE(polls(3) == std::vector<int>{1, 2, 3});
+  CHECK(logger->error_count() == 4);
+}
+
+DATADOG_AGENT_TEST("the flush interval adapts to the bytes buffered") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  event_scheduler->defer_posted_tasks = true;
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.flush_interval_milliseconds = 1000;
+  config.agent.flush_interval_min_milliseconds = 250;
+  config.agent.flush_interval_max_milliseconds = 4000;
+  config.agent.flush_jitter_enabled = false;
+  config.telemetry.enabled = false;
+
+  SECTION("busy") {
+    // Any buffered chunk is a quarter of the flush threshold.
+    config.agent.flush_threshold_bytes = 4;
+  }
+  SECTION("idle") {}
+  SECTION("jittered") { config.agent.flush_jitter_enabled = true; }
+  SECTION("fixed") {
+    config.agent.flush_interval_min_milliseconds = nullopt;
+    config.agent.flush_interval_max_milliseconds = nullopt;
+  }
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  const auto& agent_config =
+      std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+  const TracerSignature signature(RuntimeID::generate(), "testsvc", "test");
+  DatadogAgent agent(agent_config, config.logger, signature, {});
+
+  const auto send_span = [&]() {
+    std::vector<std::unique_ptr<SpanData>> spans;
+    spans.push_back(std::make_unique<SpanData>());
+    REQUIRE(agent.send(std::move(spans), nullptr));
+  };
+  // Return the number of periods of the flush timer until it posts a flush,
+  // and then run the flush.
+  const auto ticks_until_flush = [&]() {
+    const auto posted = event_scheduler->posted_tasks.size();
+    int ticks = 0;
+    while (event_scheduler->posted_tasks.size() == posted && ticks < 100) {
+      ++ticks;
+      event_scheduler->event_callback();
+    }
+    event_scheduler->run_posted_tasks();
+    return ticks;
+  };
+
+  if (!config.agent.flush_interval_min_milliseconds) {
+    REQUIRE(event_scheduler->recurrence_interval == std::chrono::seconds(1));
+    send_span();
+    REQUIRE(ticks_until_flush() == 1);
+    REQUIRE(ticks_until_flush() == 1);
+    return;
+  }
+
+  REQUIRE(event_scheduler->recurrence_interval ==
+          std::chrono::milliseconds(250));
+  if (*config.agent.flush_jitter_enabled) {
+    // The first flush is within the flush interval.
+    const int ticks = ticks_until_flush();
+    REQUIRE(ticks >= 1);
+    REQUIRE(ticks <= 4);
+    return;
+  }
+
+  send_span();
+  REQUIRE(ticks_until_flush() == 4);
+  if (config.agent.flush_threshold_bytes) {
+    // The interval halves while chunks are buffered quickly.
+    send_span();
+    REQUIRE(ticks_until_flush() == 2);
+    send_span();
+    REQUIRE(ticks_until_flush() == 1);
+    send_span();
+    REQUIRE(ticks_until_flush() == 1);
+    REQUIRE(ticks_until_flush() == 1);
+    REQUIRE(ticks_until_flush() == 2);
+  } else {
+    // The interval doubles while nothing is buffered, up to the maximum.
+    REQUIRE(ticks_until_flush() == 4);
+    REQUIRE(ticks_until_flush() == 8);
+    REQUIRE(ticks_until_flush() == 16);
+    send_span();
+    REQUIRE(ticks_until_flush() == 16);
+    // Any other amount buffered restores the flush interval.
+    REQUIRE(ticks_until_flush() == 4);
+  }
+  CHECK(logger->error_count() == 0);
+}
+
+DATADOG_AGENT_TEST("the Datadog Agent is asked which endpoints it supports") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.traces_api_version = TracesAPIVersion::V0_5;
+  config.agent.agent_info_refresh_interval_seconds = 300;
+  config.telemetry.enabled = false;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  const auto& agent_config =
+      std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+  const TracerSignature signature(RuntimeID::generate(), "testsvc", "test");
+  DatadogAgent agent(agent_config, config.logger, signature, {});
+
+  // The first query is at startup, and the refresh is the last recurring
+  // event scheduled.
+  REQUIRE(http_client->request_url.path == "/info");
+  REQUIRE(event_scheduler->recurrence_interval == std::chrono::minutes(5));
+  const auto traces_api_version = [&]() {
+    const auto agent_config = nlohmann::json::parse(agent.config());
+    return agent_config["config"]["traces_api_version"];
+  };
+  const auto remote_configuration_queried = [&]() {
+    http_client->request_url = HTTPClient::URL{};
+    agent.get_and_apply_remote_configuration_updates();
+    return http_client->request_url.path == "/v0.7/config";
+  };
+
+  SECTION("and uses only those") {
+    http_client->response_status = 200;
+    http_client->response_body << R"({"endpoints": ["/v0.4/traces"]})";
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 1);
+    CHECK(traces_api_version() == "v0.4");
+    CHECK(!remote_configuration_queried());
+
+    SECTION("until it reports more") {
+      http_client->response_body.str("");
+      http_client->response_body
+          << R"({"endpoints": ["/v0.4/traces", "/v0.5/traces",)"
+          << R"( "/v0.7/config"]})";
+      event_scheduler->event_callback();
+      REQUIRE(http_client->request_url.path == "/info");
+      http_client->drain(std::chrono::steady_clock::now());
+      CHECK(remote_configuration_queried());
+      // The fall back to v0.4 is not undone.
+      CHECK(traces_api_version() == "v0.4");
+    }
+  }
+
+  SECTION("or assumes everything if it does not know") {
+    http_client->response_status = 404;
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 0);
+    CHECK(traces_api_version() == "v0.5");
+    CHECK(remote_configuration_queried());
+  }
+
+  SECTION("and logs a response that it cannot parse") {
+    http_client->response_status = 200;
+    http_client->response_body << R"({"endpoints": "/v0.4/traces"})";
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 1);
+    CHECK(traces_api_version() == "v0.5");
+  }
+}
+
+DATADOG_AGENT_TEST("the Datadog Agent info refresh interval") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.agent.agent_info_refresh_interval_seconds = -1;
+  auto finalized = finalize_config(config);
+  REQUIRE(!finalized);
+  REQUIRE(finalized.error().code ==
+          Error::DATADOG_AGENT_INVALID_INFO_REFRESH_INTERVAL);
+}
+
 DATADOG_AGENT_TEST("Datadog-Client-Computed-Stats header") {
   const auto logger =
       std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
@@ -281,3 +552,1587 @@ DATADOG_AGENT_TEST("Datadog-Client-Computed-Stats header") {
               "Datadog-Client-Computed-Stats") == 0);
   }
 }
+
+DATADOG_AGENT_TEST("trace stats computed by the tracer") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TimePoint current_time = default_clock();
+  const Clock clock = [&current_time]() { return current_time; };
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.stats_computation_enabled = true;
+  config.telemetry.enabled = false;
+  config.trace_sampler.sample_rate = 0.0;
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  REQUIRE(nlohmann::json::parse(tracer.config())["collector"]["config"]
+                                                 ["stats_computation_enabled"]
+              .get<bool>());
+  {
+    auto span = tracer.create_span();
+    current_time += std::chrono::milliseconds(3);
+  }
+
+  // The dropped trace is not sent, and its stats bucket has not yet ended.
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+
+  current_time += std::chrono::seconds(10);
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_url.path == "/v0.6/stats");
+  REQUIRE(http_client->request_headers.items.at(
+              "Datadog-Client-Computed-Stats") == "yes");
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload["Service"] == "testsvc");
+  const auto& group = payload["Stats"][0]["Stats"][0];
+  REQUIRE(group["Service"] == "testsvc");
+  REQUIRE(group["Hits"] == 1);
+  REQUIRE(group["Duration"] == 3'000'000);
+
+  // A kept trace is sent, along with the count of traces dropped before it.
+  http_client->clear();
+  {
+    auto span = tracer.create_span();
+    span.trace_segment().override_sampling_priority(2);
+  }
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_url.path == "/v0.4/traces");
+  auto& headers = http_client->request_headers.items;
+  REQUIRE(headers["Datadog-Client-Dropped-P0-Traces"] == "1");
+  REQUIRE(headers["Datadog-Client-Dropped-P0-Spans"] == "1");
+}
+
+DATADOG_AGENT_TEST("stats headers are sent only while stats are computed") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.stats_computation_enabled = true;
+  config.agent.agent_info_refresh_interval_seconds = 300;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  // Return the headers of the request that sends a kept trace, after the
+  // Datadog Agent reported the specified `info`.
+  const auto trace_request_headers = [&](const std::string& info) {
+    {
+      Tracer tracer{*finalized};
+      REQUIRE(http_client->request_url.path == "/info");
+      http_client->response_status = 200;
+      http_client->response_body << info;
+      http_client->drain(std::chrono::steady_clock::now());
+      http_client->request_headers.items.clear();
+
+      auto span = tracer.create_span();
+      span.trace_segment().override_sampling_priority(2);
+    }
+    REQUIRE(http_client->request_url.path == "/v0.4/traces");
+    return http_client->request_headers.items;
+  };
+
+  SECTION("the Datadog Agent accepts stats") {
+    const auto headers = trace_request_headers(
+        R"({"endpoints": ["/v0.4/traces", "/v0.6/stats"]})");
+    CHECK(headers.at("Datadog-Client-Computed-Stats") == "yes");
+    CHECK(headers.at("Datadog-Client-Dropped-P0-Traces") == "0");
+    CHECK(headers.at("Datadog-Client-Dropped-P0-Spans") == "0");
+  }
+
+  SECTION("the Datadog Agent does not accept stats") {
+    const auto headers =
+        trace_request_headers(R"({"endpoints": ["/v0.4/traces"]})");
+    CHECK(headers.count("Datadog-Client-Computed-Stats") == 0);
+    CHECK(headers.count("Datadog-Client-Dropped-P0-Traces") == 0);
+    CHECK(headers.count("Datadog-Client-Dropped-P0-Spans") == 0);
+  }
+}
+
+DATADOG_AGENT_TEST("only span sampled spans of dropped traces are sent") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.stats_computation_enabled = true;
+  config.agent.encode_on_send = GENERATE(false, true);
+  CAPTURE(*config.agent.encode_on_send);
+  config.telemetry.enabled = false;
+  config.trace_sampler.sample_rate = 0.0;
+  SpanSamplerConfig::Rule rule;
+  rule.name = "kept";
+  config.span_sampler.rules.push_back(rule);
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  {
+    SpanConfig root_config;
+    root_config.name = "dropped";
+    auto root = tracer.create_span(root_config);
+    SpanConfig child_config;
+    child_config.name = "kept";
+    auto child = root.create_child(child_config);
+    child_config.name = "also dropped";
+    auto other_child = root.create_child(child_config);
+  }
+  event_scheduler->event_callback();
+
+  REQUIRE(http_client->request_url.path == "/v0.4/traces");
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == 1);
+  REQUIRE(payload[0].size() == 1);
+  const auto& span = payload[0][0];
+  REQUIRE(span["name"] == "kept");
+  REQUIRE(span["metrics"]["_sampling_priority_v1"] == -1);
+  auto& headers = http_client->request_headers.items;
+  REQUIRE(headers["Datadog-Client-Dropped-P0-Traces"] == "0");
+  REQUIRE(headers["Datadog-Client-Dropped-P0-Spans"] == "2");
+}
+
+DATADOG_AGENT_TEST("trace chunks encoded on send") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.telemetry.enabled = false;
+  config.agent.encode_on_send = GENERATE(false, true);
+  CAPTURE(*config.agent.encode_on_send);
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  {
+    http_client->response_status = 200;
+    http_client->response_body << "{}";
+    Tracer tracer{*finalized};
+    {
+      SpanConfig root_config;
+      root_config.name = "first";
+      auto root = tracer.create_span(root_config);
+      SpanConfig child_config;
+      child_config.name = "child";
+      auto child = root.create_child(child_config);
+    }
+    {
+      SpanConfig root_config;
+      root_config.name = "second";
+      auto root = tracer.create_span(root_config);
+    }
+  }
+
+  REQUIRE(logger->error_count() == 0);
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.is_array());
+  REQUIRE(payload.size() == 2);
+  REQUIRE(payload[0].size() == 2);
+  REQUIRE(payload[0][0]["name"] == "first");
+  REQUIRE(payload[0][1]["name"] == "child");
+  REQUIRE(payload[1].size() == 1);
+  REQUIRE(payload[1][0]["name"] == "second");
+
+  const auto header_it =
+      http_client->request_headers.items.find("X-Datadog-Trace-Count");
+  REQUIRE(header_it != http_client->request_headers.items.end());
+  REQUIRE(header_it->second == "2");
+}
+
+DATADOG_AGENT_TEST("trace chunks sent from many threads are all sent") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+  config.agent.encode_on_send = GENERATE(false, true);
+  CAPTURE(*config.agent.encode_on_send);
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  const std::size_t num_threads = 8;
+  const std::size_t chunks_per_thread = 100;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&]() {
+      for (std::size_t j = 0; j < chunks_per_thread; ++j) {
+        auto span = tracer.create_span();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const std::size_t num_chunks = num_threads * chunks_per_thread;
+  REQUIRE(tracer.runtime_stats().buffered_trace_chunks == num_chunks);
+  event_scheduler->event_callback();
+  REQUIRE(tracer.runtime_stats().buffered_trace_chunks == 0);
+  REQUIRE(tracer.runtime_stats().buffered_bytes == 0);
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == num_chunks);
+  REQUIRE(logger->error_count() == 0);
+}
+
+DATADOG_AGENT_TEST("pre-encoded trace chunks are sent as they are") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.encode_on_send = true;
+  config.agent.traces_api_version = TracesAPIVersion::V0_4;
+  config.telemetry.enabled = false;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  const auto& agent_config =
+      std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+  const TracerSignature signature(RuntimeID::generate(), "testsvc", "test");
+
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+  {
+    DatadogAgent agent(agent_config, config.logger, signature, {});
+    TraceChunk chunk;
+    chunk.spans.push_back(std::make_unique<SpanData>());
+    chunk.spans.back()->name = "encoded by the agent";
+    chunk.sampling_priority = 1;
+    // An array of one span, whose "name" differs from that of `spans`.
+    const auto encoded = nlohmann::json::to_msgpack(
+        nlohmann::json::parse(R"([{"name": "encoded by the producer"}])"));
+    chunk.encoded.assign(encoded.begin(), encoded.end());
+    REQUIRE(agent.send_chunk(std::move(chunk), nullptr));
+  }
+
+  REQUIRE(logger->error_count() == 0);
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == 1);
+  REQUIRE(payload[0][0]["name"] == "encoded by the producer");
+}
+
+DATADOG_AGENT_TEST("large payloads are encoded in parallel") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+
+  SECTION("at most 64 threads") {
+    config.agent.encoding_threads = 65;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_ENCODING_THREADS);
+  }
+
+  SECTION("chunks keep their order") {
+    config.agent.encoding_threads = 3;
+    config.agent.parallel_encoding_min_spans = GENERATE(1, 1000);
+    config.agent.encode_on_send = GENERATE(false, true);
+    CAPTURE(*config.agent.parallel_encoding_min_spans);
+    CAPTURE(*config.agent.encode_on_send);
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+
+    Tracer tracer{*finalized};
+    // Traces of different sizes, so that the parts are uneven.
+    const int trace_count = 20;
+    for (int i = 0; i < trace_count; ++i) {
+      SpanConfig root_config;
+      root_config.name = "trace-" + std::to_string(i);
+      auto root = tracer.create_span(root_config);
+      for (int j = 0; j < i % 5; ++j) {
+        root.create_child();
+      }
+    }
+    event_scheduler->event_callback();
+
+    REQUIRE(logger->error_count() == 0);
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == trace_count);
+    for (int i = 0; i < trace_count; ++i) {
+      CAPTURE(i);
+      REQUIRE(payload[i].size() == std::size_t(1 + i % 5));
+      REQUIRE(payload[i][0]["name"] == "trace-" + std::to_string(i));
+    }
+  }
+}
+
+DATADOG_AGENT_TEST("large payloads are encoded in pages") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.compression_enabled = false;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  // One trace whose spans together are larger than a page, and a small one.
+  const std::string large_value(1024, 'x');
+  const int child_count = 600;
+  {
+    auto root = tracer.create_span();
+    for (int i = 0; i < child_count; ++i) {
+      auto child = root.create_child();
+      child.set_tag("value", large_value);
+    }
+  }
+  tracer.create_span();
+  event_scheduler->event_callback();
+
+  REQUIRE(logger->error_count() == 0);
+  REQUIRE(http_client->request_segment_count > 1);
+  const auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == 2);
+  REQUIRE(payload[0].size() == std::size_t(1 + child_count));
+  for (const auto& span : payload[0]) {
+    if (span["parent_id"] != 0) {
+      REQUIRE(span["meta"]["value"] == large_value);
+    }
+  }
+  REQUIRE(payload[1].size() == 1);
+}
+
+DATADOG_AGENT_TEST("v0.5 traces API") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.traces_api_version = TracesAPIVersion::V0_5;
+  config.telemetry.enabled = false;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  {
+    SpanConfig span_config;
+    span_config.name = "first";
+    auto span = tracer.create_span(span_config);
+  }
+  // With remote configuration disabled, the only scheduled event is the
+  // flush.
+  REQUIRE(event_scheduler->event_callback);
+  event_scheduler->event_callback();
+
+  // See `test_trace_encoder_v05.cpp` for the details of the encoding.
+  CHECK(http_client->request_url.path == "/v0.5/traces");
+  CHECK(http_client->request_body.find("first") != std::string::npos);
+
+  SECTION("a 404 response falls back to v0.4") {
+    http_client->response_status = 404;
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 1);
+
+    // The rejected payload is sent again, converted to v0.4, by the next
+    // flush.
+    http_client->response_status = 200;
+    event_scheduler->event_callback();
+    CHECK(http_client->request_url.path == "/v0.4/traces");
+    const auto resent = nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(resent.size() == 1);
+    REQUIRE(resent[0].size() == 1);
+    REQUIRE(resent[0][0]["name"] == "first");
+    REQUIRE(resent[0][0]["service"] == "testsvc");
+
+    {
+      SpanConfig span_config;
+      span_config.name = "second";
+      auto span = tracer.create_span(span_config);
+    }
+    event_scheduler->event_callback();
+
+    CHECK(http_client->request_url.path == "/v0.4/traces");
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["name"] == "second");
+  }
+
+  SECTION("a compressed payload falls back to v0.4 too") {
+    if (!gzip_available()) {
+      return;
+    }
+    config.agent.compression_enabled = true;
+    config.agent.compression_min_bytes = 1;
+    auto compressing_config = finalize_config(config);
+    REQUIRE(compressing_config);
+    Tracer compressing{*compressing_config};
+    {
+      SpanConfig span_config;
+      span_config.name = "compressed";
+      auto span = compressing.create_span(span_config);
+    }
+    event_scheduler->event_callback();
+    CHECK(http_client->request_url.path == "/v0.5/traces");
+    REQUIRE(http_client->request_headers.items.count("Content-Encoding") == 1);
+
+    http_client->response_status = 404;
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 1);
+
+    // The rejected payload is decompressed, converted to v0.4, and sent
+    // again by the next flush.
+    http_client->request_headers.items.clear();
+    http_client->response_status = 200;
+    event_scheduler->event_callback();
+    CHECK(http_client->request_url.path == "/v0.4/traces");
+    CHECK(http_client->request_headers.items.count("Content-Encoding") == 0);
+    const auto resent = nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(resent.size() == 1);
+    REQUIRE(resent[0][0]["name"] == "compressed");
+  }
+
+  SECTION("a successful response keeps v0.5") {
+    http_client->response_status = 200;
+    http_client->response_body << "{}";
+    http_client->drain(std::chrono::steady_clock::now());
+    CHECK(logger->error_count() == 0);
+
+    {
+      auto span = tracer.create_span();
+    }
+    event_scheduler->event_callback();
+    CHECK(http_client->request_url.path == "/v0.5/traces");
+  }
+}
+
+DATADOG_AGENT_TEST("buffered trace chunks are bounded") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+
+  SECTION("reaching the flush threshold sends immediately") {
+    config.agent.flush_threshold_bytes = 1;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+
+    Tracer tracer{*finalized};
+    {
+      SpanConfig span_config;
+      span_config.name = "early";
+      auto span = tracer.create_span(span_config);
+    }
+    // The flush interval has not elapsed (`event_callback` was not invoked),
+    // but the chunk was sent anyway.
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["name"] == "early");
+  }
+
+  SECTION("chunks are dropped when the buffer is full") {
+    config.agent.flush_threshold_bytes = 1;
+    config.agent.max_buffered_bytes = 1;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+
+    Tracer tracer{*finalized};
+    {
+      auto span = tracer.create_span();
+    }
+    event_scheduler->event_callback();
+    CHECK(http_client->request_body.empty());
+    CHECK(tracer.runtime_stats().dropped_trace_chunks == 1);
+  }
+
+  SECTION("chunks of lower classes are dropped first") {
+    event_scheduler->defer_posted_tasks = true;
+    std::size_t chunk_bytes = 0;
+    {
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      Tracer tracer{*finalized};
+      {
+        SpanConfig span_config;
+        span_config.name = "x";
+        auto span = tracer.create_span(span_config);
+      }
+      chunk_bytes = tracer.runtime_stats().buffered_bytes;
+    }
+    REQUIRE(chunk_bytes > 0);
+    http_client->clear();
+
+    // There is room for two chunks, each a span whose name is one character
+    // long.
+    config.agent.flush_threshold_bytes = 2 * chunk_bytes;
+    config.agent.max_buffered_bytes = 2 * chunk_bytes;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+
+    Tracer tracer{*finalized};
+    const auto send_span = [&](const char* name, Optional<int> priority,
+                               bool error) {
+      SpanConfig span_config;
+      span_config.name = name;
+      auto span = tracer.create_span(span_config);
+      if (priority) {
+        span.trace_segment().override_sampling_priority(*priority);
+      }
+      span.set_error(error);
+    };
+    // sampled out
+    send_span("s", -1, false);
+    // kept
+    send_span("k", nullopt, false);
+    // kept by the user, replacing "s"
+    send_span("u", 2, false);
+    // kept, but dropped, since the buffer holds no chunk of a lower class
+    send_span("d", nullopt, false);
+    // an error, replacing "k"
+    send_span("e", nullopt, true);
+
+    const auto stats = tracer.runtime_stats();
+    REQUIRE(stats.dropped_trace_chunks == 3);
+    REQUIRE(stats.dropped_sampled_out_trace_chunks == 1);
+    REQUIRE(stats.dropped_kept_trace_chunks == 2);
+    REQUIRE(stats.dropped_protected_trace_chunks == 0);
+
+    event_scheduler->run_posted_tasks();
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 2);
+    REQUIRE(payload[0][0]["name"] == "u");
+    REQUIRE(payload[1][0]["name"] == "e");
+  }
+
+  SECTION("invalid limits") {
+    SECTION("zero flush threshold") { config.agent.flush_threshold_bytes = 0; }
+    SECTION("maximum below flush threshold") {
+      config.agent.flush_threshold_bytes = 100;
+      config.agent.max_buffered_bytes = 99;
+    }
+    SECTION("zero maximum payload size") { config.agent.max_payload_bytes = 0; }
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_BUFFER_LIMITS);
+  }
+}
+
+DATADOG_AGENT_TEST("flushes and responses are posted to the event scheduler") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  event_scheduler->defer_posted_tasks = true;
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.flush_threshold_bytes = 1;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  auto tracer = std::make_unique<Tracer>(*finalized);
+  const auto send_span = [&](const char* name) {
+    SpanConfig span_config;
+    span_config.name = name;
+    auto span = tracer->create_span(span_config);
+  };
+
+  SECTION("the flush threshold posts one flush") {
+    send_span("first");
+    send_span("second");
+    REQUIRE(http_client->request_body.empty());
+    REQUIRE(event_scheduler->posted_tasks.size() == 1);
+
+    event_scheduler->run_posted_tasks();
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 2);
+
+    // The response is parsed by another posted task.
+    http_client->drain(std::chrono::steady_clock::time_point::max());
+    REQUIRE(event_scheduler->posted_tasks.size() == 1);
+    event_scheduler->run_posted_tasks();
+  }
+
+  SECTION("the flush interval posts a flush") {
+    config.agent.flush_threshold_bytes = 1 << 20;
+    finalized = finalize_config(config);
+    REQUIRE(finalized);
+    tracer = std::make_unique<Tracer>(*finalized);
+    send_span("interval");
+    REQUIRE(event_scheduler->posted_tasks.empty());
+
+    event_scheduler->event_callback();
+    REQUIRE(http_client->request_body.empty());
+    event_scheduler->run_posted_tasks();
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["name"] == "interval");
+  }
+
+  SECTION("chunks of a posted flush are sent when the tracer is destroyed") {
+    send_span("last");
+    REQUIRE(event_scheduler->posted_tasks.size() == 1);
+    tracer.reset();
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["name"] == "last");
+
+    // The posted flush no longer refers to the destroyed agent.
+    http_client->clear();
+    event_scheduler->run_posted_tasks();
+    REQUIRE(http_client->request_body.empty());
+  }
+
+  SECTION("chunks are sent by shutdown_async, and not when destroyed") {
+    send_span("last");
+    auto done = tracer->shutdown_async(std::chrono::steady_clock::now() + 1s);
+    done.get();
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["name"] == "last");
+
+    http_client->clear();
+    send_span("after shutdown");
+    tracer->shutdown_async(std::chrono::steady_clock::now()).get();
+    tracer.reset();
+    event_scheduler->run_posted_tasks();
+    REQUIRE(http_client->request_body.empty());
+  }
+}
+
+DATADOG_AGENT_TEST("the shutdown flush sends the highest priority first") {
+  // Each request takes a second of the shutdown timeout.
+  TimePoint current_time = default_clock();
+  const Clock clock = [&current_time]() { return current_time; };
+  struct SlowHTTPClient : public MockHTTPClient {
+    TimePoint* current_time = nullptr;
+    std::vector<std::string> request_bodies;
+
+    using MockHTTPClient::post;
+    Expected<void> post(
+        const URL& url, HeadersSetter set_headers, std::string body,
+        ResponseHandler on_response, ErrorHandler on_error,
+        std::chrono::steady_clock::time_point deadline) override {
+      request_bodies.push_back(body);
+      current_time->tick += 1s;
+      return MockHTTPClient::post(url, std::move(set_headers),
+                                  std::move(body), std::move(on_response),
+                                  std::move(on_error), deadline);
+    }
+  };
+
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  event_scheduler->defer_posted_tasks = true;
+  const auto http_client = std::make_shared<SlowHTTPClient>();
+  http_client->current_time = &current_time;
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.encode_on_send = true;
+  // Send each chunk in its own payload.
+  config.agent.flush_threshold_bytes = 1;
+  config.agent.shutdown_timeout_milliseconds = 2500;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+
+  {
+    Tracer tracer{*finalized};
+    for (const char* name : {"a", "b", "c", "d", "e"}) {
+      SpanConfig span_config;
+      span_config.name = name;
+      auto span = tracer.create_span(span_config);
+      if (span_config.name == std::string("c")) {
+        span.trace_segment().override_sampling_priority(2);
+      }
+    }
+    // The flush posted at the flush threshold is not invoked.
+    REQUIRE(http_client->request_bodies.empty());
+  }
+
+  // Three payloads are sent before the deadline, the chunk with the highest
+  // priority first, and then the most recent.
+  std::vector<std::string> names;
+  for (const auto& body : http_client->request_bodies) {
+    const auto payload = nlohmann::json::from_msgpack(body);
+    REQUIRE(payload.size() == 1);
+    names.push_back(payload[0][0]["name"]);
+  }
+  REQUIRE(names == std::vector<std::string>{"c", "e", "d"});
+
+  // The others are dropped, and that is logged.
+  REQUIRE(logger->error_count() == 1);
+}
+
+DATADOG_AGENT_TEST("errors are sent without waiting for the flush interval") {
+  TimePoint current_time = default_clock();
+  const Clock clock = [&current_time]() { return current_time; };
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  event_scheduler->defer_posted_tasks = true;
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.flush_threshold_bytes = 1 << 20;
+  config.agent.max_in_flight_requests = 0;
+  config.agent.priority_flushes_per_second = 1;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  const auto send_span = [&](const char* name, bool error) {
+    SpanConfig span_config;
+    span_config.name = name;
+    auto span = tracer.create_span(span_config);
+    span.set_error(error);
+  };
+  const auto sent_names = [&]() {
+    std::vector<std::string> names;
+    if (http_client->request_body.empty()) {
+      return names;
+    }
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    for (const auto& chunk : payload) {
+      names.push_back(chunk[0]["name"]);
+    }
+    http_client->clear();
+    return names;
+  };
+
+  // Chunks without an error wait for the flush interval.
+  send_span("ok", false);
+  REQUIRE(event_scheduler->posted_tasks.empty());
+
+  // An error posts a flush of only the chunks with errors.
+  send_span("error", true);
+  REQUIRE(event_scheduler->posted_tasks.size() == 1);
+  send_span("another error", true);
+  REQUIRE(event_scheduler->posted_tasks.size() == 1);
+  event_scheduler->run_posted_tasks();
+  REQUIRE(sent_names() ==
+          std::vector<std::string>{"error", "another error"});
+
+  // Within the same second, errors wait for the flush interval too.
+  send_span("limited error", true);
+  REQUIRE(event_scheduler->posted_tasks.empty());
+
+  current_time.tick += 1s;
+  send_span("later error", true);
+  REQUIRE(event_scheduler->posted_tasks.size() == 1);
+  event_scheduler->run_posted_tasks();
+  REQUIRE(sent_names() ==
+          std::vector<std::string>{"limited error", "later error"});
+
+  event_scheduler->event_callback();
+  event_scheduler->run_posted_tasks();
+  REQUIRE(sent_names() == std::vector<std::string>{"ok"});
+}
+
+DATADOG_AGENT_TEST("in-flight trace requests are bounded") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.max_in_flight_requests = 1;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  const auto send_span = [&](const char* name) {
+    SpanConfig span_config;
+    span_config.name = name;
+    auto span = tracer.create_span(span_config);
+  };
+
+  send_span("first");
+  event_scheduler->event_callback();
+  auto payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == 1);
+  REQUIRE(payload[0][0]["name"] == "first");
+
+  // `MockHTTPClient` holds the first request's callbacks, so the request is
+  // still in flight, and the next flush is deferred.
+  http_client->clear();
+  send_span("second");
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+
+  // Once the first request completes, the deferred chunk is merged into the
+  // payload of the next flush.
+  http_client->on_response_ = nullptr;
+  http_client->on_error_ = nullptr;
+  send_span("third");
+  event_scheduler->event_callback();
+  payload = nlohmann::json::from_msgpack(http_client->request_body);
+  REQUIRE(payload.size() == 2);
+  REQUIRE(payload[0][0]["name"] == "second");
+  REQUIRE(payload[1][0]["name"] == "third");
+}
+
+DATADOG_AGENT_TEST("oversized flushes are split into concurrent payloads") {
+  // `ConcurrentHTTPClient` holds the callbacks of every request, so that each
+  // request remains in flight until `complete` is called.
+  struct ConcurrentHTTPClient : public MockHTTPClient {
+    std::vector<std::string> request_bodies;
+    std::vector<std::string> trace_counts;
+    std::vector<ResponseHandler> on_responses;
+
+    using MockHTTPClient::post;
+    Expected<void> post(
+        const URL&, HeadersSetter set_headers, std::string body,
+        ResponseHandler on_response, ErrorHandler,
+        std::chrono::steady_clock::time_point) override {
+      MockDictWriter headers;
+      set_headers(headers);
+      trace_counts.push_back(headers.items.at("X-Datadog-Trace-Count"));
+      request_bodies.push_back(std::move(body));
+      on_responses.push_back(std::move(on_response));
+      return {};
+    }
+
+    void complete() {
+      MockDictReader reader{response_headers};
+      for (const auto& on_response : on_responses) {
+        on_response(200, reader, "{}");
+      }
+      on_responses.clear();
+    }
+  };
+
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<ConcurrentHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+
+  // Measure the estimated size of a chunk having one span whose name is one
+  // character long.
+  std::size_t chunk_bytes;
+  {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      SpanConfig span_config;
+      span_config.name = "x";
+      auto span = tracer.create_span(span_config);
+    }
+    chunk_bytes = tracer.runtime_stats().buffered_bytes;
+  }
+  REQUIRE(chunk_bytes > 0);
+  http_client->complete();
+  http_client->request_bodies.clear();
+  http_client->trace_counts.clear();
+
+  config.agent.max_payload_bytes = 2 * chunk_bytes;
+  const auto names_of = [](const std::string& body) {
+    std::vector<std::string> names;
+    for (const auto& chunk : nlohmann::json::from_msgpack(body)) {
+      names.push_back(chunk[0]["name"]);
+    }
+    return names;
+  };
+  using Names = std::vector<std::string>;
+
+  SECTION("at chunk boundaries, in order") {
+    config.agent.max_in_flight_requests = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    for (const char* name : {"a", "b", "c", "d", "e"}) {
+      SpanConfig span_config;
+      span_config.name = name;
+      auto span = tracer.create_span(span_config);
+    }
+    event_scheduler->event_callback();
+
+    const auto& bodies = http_client->request_bodies;
+    REQUIRE(bodies.size() == 3);
+    REQUIRE(names_of(bodies[0]) == Names{"a", "b"});
+    REQUIRE(names_of(bodies[1]) == Names{"c", "d"});
+    REQUIRE(names_of(bodies[2]) == Names{"e"});
+    REQUIRE(http_client->trace_counts == Names{"2", "2", "1"});
+    REQUIRE(tracer.runtime_stats().in_flight_requests == 3);
+    http_client->complete();
+    REQUIRE(tracer.runtime_stats().in_flight_requests == 0);
+  }
+
+  SECTION("within the limit on in-flight requests") {
+    config.agent.max_in_flight_requests = 2;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    for (const char* name : {"a", "b", "c", "d", "e"}) {
+      SpanConfig span_config;
+      span_config.name = name;
+      auto span = tracer.create_span(span_config);
+    }
+    event_scheduler->event_callback();
+
+    auto& bodies = http_client->request_bodies;
+    REQUIRE(bodies.size() == 2);
+    REQUIRE(names_of(bodies[0]) == Names{"a", "b"});
+    REQUIRE(names_of(bodies[1]) == Names{"c", "d"});
+    // The chunk not yet sent is buffered for the next flush.
+    REQUIRE(tracer.runtime_stats().buffered_trace_chunks == 1);
+
+    http_client->complete();
+    event_scheduler->event_callback();
+    REQUIRE(bodies.size() == 3);
+    REQUIRE(names_of(bodies[2]) == Names{"e"});
+    REQUIRE(http_client->trace_counts == Names{"2", "2", "1"});
+    http_client->complete();
+  }
+}
+
+DATADOG_AGENT_TEST("runtime stats") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.max_in_flight_requests = 1;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  auto stats = tracer.runtime_stats();
+  REQUIRE(stats.live_trace_segments == 0);
+  REQUIRE(stats.buffered_trace_chunks == 0);
+  REQUIRE(stats.buffered_bytes == 0);
+  REQUIRE(stats.in_flight_requests == 0);
+  REQUIRE(stats.dropped_trace_chunks == 0);
+
+  {
+    auto span = tracer.create_span();
+    auto child = span.create_child();
+    REQUIRE(tracer.runtime_stats().live_trace_segments == 1);
+  }
+  stats = tracer.runtime_stats();
+  REQUIRE(stats.live_trace_segments == 0);
+  REQUIRE(stats.buffered_trace_chunks == 1);
+  REQUIRE(stats.buffered_bytes > 0);
+
+  // `MockHTTPClient` holds the request's callbacks, so the request is still
+  // in flight.
+  event_scheduler->event_callback();
+  stats = tracer.runtime_stats();
+  REQUIRE(stats.buffered_trace_chunks == 0);
+  REQUIRE(stats.buffered_bytes == 0);
+  REQUIRE(stats.in_flight_requests == 1);
+
+  http_client->on_response_ = nullptr;
+  http_client->on_error_ = nullptr;
+  REQUIRE(tracer.runtime_stats().in_flight_requests == 0);
+}
+
+DATADOG_AGENT_TEST("trace chunk delivery latencies") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TimePoint current_time = default_clock();
+  const Clock clock = [&current_time]() { return current_time; };
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+  config.agent.encode_on_send = GENERATE(false, true);
+  CAPTURE(config.agent.encode_on_send);
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+
+  Tracer tracer{*finalized};
+  const auto stats = [&]() { return tracer.runtime_stats(); };
+  REQUIRE(stats().finish_to_ack.count == 0);
+
+  const auto advance = [&](std::chrono::milliseconds delay) {
+    current_time.tick += delay;
+    current_time.wall += delay;
+  };
+  {
+    auto span = tracer.create_span();
+    advance(std::chrono::milliseconds(5));
+    // The chunk is sent when the span finishes, which is now.
+  }
+  advance(std::chrono::milliseconds(20));
+  event_scheduler->event_callback();
+  REQUIRE(stats().enqueue_to_encode.count == 1);
+  REQUIRE(stats().encode_to_ack.count == 0);
+
+  advance(std::chrono::milliseconds(100));
+  http_client->drain(current_time.tick);
+
+  // Each quantile is within 5% below the latency.
+  const auto near = [](std::uint64_t nanoseconds, Duration latency) {
+    const auto expected = std::uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    return nanoseconds <= expected && nanoseconds >= expected * 0.9;
+  };
+  const auto result = stats();
+  REQUIRE(result.finish_to_enqueue.count == 1);
+  REQUIRE(result.finish_to_enqueue.p99_nanoseconds == 0);
+  REQUIRE(near(result.enqueue_to_encode.p50_nanoseconds,
+               std::chrono::milliseconds(20)));
+  REQUIRE(result.encode_to_ack.count == 1);
+  REQUIRE(near(result.encode_to_ack.p90_nanoseconds,
+               std::chrono::milliseconds(100)));
+  REQUIRE(result.finish_to_ack.count == 1);
+  REQUIRE(near(result.finish_to_ack.p99_nanoseconds,
+               std::chrono::milliseconds(120)));
+}
+
+DATADOG_AGENT_TEST("failed payloads are sent again") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  TimePoint current_time = default_clock();
+  const auto clock = [&current_time]() { return current_time; };
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.max_retries = 1;
+  config.telemetry.enabled = false;
+
+  bool transient = true;
+  SECTION("after a server error") { http_client->response_status = 503; }
+  SECTION("after a rate limiting response") {
+    http_client->response_status = 429;
+  }
+  SECTION("after a network error") {
+    http_client->response_error =
+        Error{Error::CURL_REQUEST_FAILURE, "connection refused"};
+  }
+  SECTION("but not after a client error") {
+    http_client->response_status = 400;
+    transient = false;
+  }
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  {
+    auto span = tracer.create_span();
+  }
+  event_scheduler->event_callback();
+  const std::string body = http_client->request_body;
+  REQUIRE(!body.empty());
+  http_client->drain(current_time.tick);
+
+  // The payload is not sent again before its backoff elapses.
+  http_client->clear();
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+
+  current_time.tick += std::chrono::seconds(1);
+  event_scheduler->event_callback();
+  if (!transient) {
+    REQUIRE(http_client->request_body.empty());
+    return;
+  }
+  REQUIRE(http_client->request_body == body);
+
+  // The payload is sent again at most `max_retries` times.
+  http_client->drain(current_time.tick);
+  http_client->clear();
+  current_time.tick += std::chrono::hours(1);
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+}
+
+DATADOG_AGENT_TEST("payloads that are not retried are spilled to a file") {
+  // `QueueingHTTPClient` responds to each of the requests posted since the
+  // last `drain`, rather than only to the last.
+  struct QueueingHTTPClient : public MockHTTPClient {
+    struct Request {
+      ResponseHandler on_response;
+      ErrorHandler on_error;
+    };
+    std::vector<Request> pending;
+    std::vector<std::string> bodies;
+
+    using MockHTTPClient::post;
+
+    Expected<void> post(const URL& url, HeadersSetter set_headers,
+                        std::string body, ResponseHandler on_response,
+                        ErrorHandler on_error,
+                        std::chrono::steady_clock::time_point deadline)
+        override {
+      bodies.push_back(body);
+      pending.push_back(Request{on_response, on_error});
+      return MockHTTPClient::post(url, std::move(set_headers),
+                                  std::move(body), std::move(on_response),
+                                  std::move(on_error), deadline);
+    }
+
+    void drain(std::chrono::steady_clock::time_point) override {
+      auto requests = std::move(pending);
+      pending.clear();
+      for (const auto& request : requests) {
+        MockDictReader reader{response_headers};
+        request.on_response(response_status, reader, response_body.str());
+      }
+      on_response_ = nullptr;
+      on_error_ = nullptr;
+    }
+  };
+
+  const auto path = std::filesystem::temp_directory_path() /
+                    ("dd-trace-cpp-agent-spill-test-" +
+                     std::to_string(::getpid()));
+  std::filesystem::remove(path);
+  auto spill_file = SpillFile::open(path.string(), 1024 * 1024);
+  REQUIRE(spill_file);
+
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<QueueingHTTPClient>();
+  http_client->response_status = 503;
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.spill_file = *spill_file;
+  config.telemetry.enabled = false;
+
+  SECTION("and sent again in order once the agent responds") {
+    config.agent.max_retries = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    const auto flush = [&](const char* name) {
+      if (name) {
+        auto span = tracer.create_span();
+        span.set_name(name);
+      }
+      event_scheduler->event_callback();
+      http_client->drain(std::chrono::steady_clock::now());
+    };
+
+    flush("a");
+    REQUIRE(http_client->bodies.size() == 1);
+    const std::string a = http_client->bodies[0];
+    REQUIRE(!(*spill_file)->empty());
+
+    // While the agent is not responding, one spilled payload is sent per
+    // flush, to find out when it responds again.
+    flush(nullptr);
+    flush("b");
+    REQUIRE(http_client->bodies.size() == 4);
+    const std::string b = http_client->bodies[3];
+    REQUIRE(http_client->bodies[1] == a);
+    REQUIRE(http_client->bodies[2] == a);
+
+    http_client->response_status = 200;
+    flush("c");
+    flush(nullptr);
+    REQUIRE(http_client->bodies.size() == 7);
+    REQUIRE(http_client->bodies[4] == a);
+    REQUIRE(http_client->bodies[5] != b);
+    REQUIRE(http_client->bodies[6] == b);
+    REQUIRE((*spill_file)->empty());
+  }
+
+  SECTION("when the tracer shuts down") {
+    config.agent.max_retries = 3;
+    {
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      Tracer tracer{*finalized};
+      {
+        auto span = tracer.create_span();
+      }
+      event_scheduler->event_callback();
+      // The payload is kept in memory to be sent again, until shutdown.
+      http_client->drain(std::chrono::steady_clock::now());
+      REQUIRE((*spill_file)->empty());
+    }
+    REQUIRE(!(*spill_file)->empty());
+    const std::string body = http_client->bodies.front();
+
+    // Another tracer using the file, such as that of the next process, sends
+    // the payload.
+    http_client->bodies.clear();
+    http_client->response_status = 200;
+    auto reopened = SpillFile::open(path.string(), 1024 * 1024);
+    REQUIRE(reopened);
+    config.agent.spill_file = *reopened;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    event_scheduler->event_callback();
+    REQUIRE(http_client->bodies.size() == 1);
+    REQUIRE(http_client->bodies[0] == body);
+  }
+
+  std::filesystem::remove(path);
+}
+
+DATADOG_AGENT_TEST("payload compression") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.compression_enabled = true;
+  config.agent.compression_min_bytes = 1;
+  config.telemetry.enabled = false;
+
+  if (!gzip_available()) {
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_COMPRESSION_UNAVAILABLE);
+    return;
+  }
+
+  SECTION("invalid level") {
+    config.agent.compression_level = GENERATE(0, 10);
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_COMPRESSION_LEVEL);
+  }
+
+  SECTION("compressed payloads are gzip encoded") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto span = tracer.create_span();
+    }
+    event_scheduler->event_callback();
+
+    const auto& body = http_client->request_body;
+    REQUIRE(body.size() > 2);
+    CHECK(static_cast<unsigned char>(body[0]) == 0x1f);
+    CHECK(static_cast<unsigned char>(body[1]) == 0x8b);
+    const auto found =
+        http_client->request_headers.items.find("Content-Encoding");
+    REQUIRE(found != http_client->request_headers.items.end());
+    CHECK(found->second == "gzip");
+
+    SECTION("unsupported media type disables compression") {
+      http_client->response_status = 415;
+      http_client->drain(std::chrono::steady_clock::now());
+      CHECK(logger->error_count() == 1);
+
+      // The rejected payload is sent again, decompressed, by the next flush.
+      http_client->request_headers.items.clear();
+      http_client->response_status = 200;
+      event_scheduler->event_callback();
+      CHECK(http_client->request_headers.items.count("Content-Encoding") == 0);
+      const auto resent =
+          nlohmann::json::from_msgpack(http_client->request_body);
+      REQUIRE(resent.size() == 1);
+      REQUIRE(resent[0][0]["service"] == "testsvc");
+
+      http_client->request_headers.items.clear();
+      {
+        SpanConfig span_config;
+        span_config.name = "uncompressed";
+        auto span = tracer.create_span(span_config);
+      }
+      event_scheduler->event_callback();
+      CHECK(http_client->request_headers.items.count("Content-Encoding") == 0);
+      const auto payload =
+          nlohmann::json::from_msgpack(http_client->request_body);
+      REQUIRE(payload[0][0]["name"] == "uncompressed");
+    }
+  }
+
+  SECTION("small payloads are not compressed") {
+    config.agent.compression_min_bytes = 1024 * 1024;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto span = tracer.create_span();
+    }
+    event_scheduler->event_callback();
+    CHECK(http_client->request_headers.items.count("Content-Encoding") == 0);
+    REQUIRE(nlohmann::json::from_msgpack(http_client->request_body).size() ==
+            1);
+  }
+}
+
+DATADOG_AGENT_TEST("shared trace buffer") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto shared_trace_buffer = SharedTraceBuffer::create(64 * 1024);
+  REQUIRE(shared_trace_buffer);
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.shared_trace_buffer = *shared_trace_buffer;
+  config.telemetry.enabled = false;
+
+  SECTION("requires the v0.4 traces API") {
+    config.agent.traces_api_version = TracesAPIVersion::V0_5;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_SHARED_TRACE_BUFFER);
+  }
+
+  SECTION("chunks of another process are sent by the elected process") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+
+    // This process is elected, so the child only writes its chunk to the
+    // shared buffer.
+    REQUIRE((*shared_trace_buffer)->try_become_drainer());
+    const pid_t child = ::fork();
+    REQUIRE(child != -1);
+    if (child == 0) {
+      {
+        Tracer tracer{*finalized};
+        SpanConfig span_config;
+        span_config.name = "from the child";
+        auto span = tracer.create_span(span_config);
+      }
+      ::_exit(http_client->request_body.empty() ? 0 : 1);
+    }
+    int status = 0;
+    REQUIRE(::waitpid(child, &status, 0) == child);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+
+    {
+      http_client->response_status = 200;
+      http_client->response_body << "{}";
+      Tracer tracer{*finalized};
+      SpanConfig span_config;
+      span_config.name = "from the parent";
+      auto span = tracer.create_span(span_config);
+    }
+
+    REQUIRE(logger->error_count() == 0);
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 2);
+    REQUIRE(payload[0][0]["name"] == "from the child");
+    REQUIRE(payload[1][0]["name"] == "from the parent");
+  }
+}
+
+DATADOG_AGENT_TEST("trace chunks of tracers are batched together") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+
+  TracerConfig config;
+  config.logger = logger;
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+  config.agent.batch_across_tracers = GENERATE(true, false);
+  CAPTURE(*config.agent.batch_across_tracers);
+
+  config.service = "first";
+  auto first_finalized = finalize_config(config);
+  REQUIRE(first_finalized);
+  config.service = "second";
+  auto second_finalized = finalize_config(config);
+  REQUIRE(second_finalized);
+
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+  {
+    auto first = std::make_unique<Tracer>(*first_finalized);
+    Tracer second{*second_finalized};
+    second.create_span();
+    first->create_span();
+    // Destroying `first` flushes the shared batch.
+    first.reset();
+
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    if (*config.agent.batch_across_tracers) {
+      REQUIRE(payload.size() == 2);
+      REQUIRE(payload[0][0]["service"] == "second");
+      REQUIRE(payload[1][0]["service"] == "first");
+      http_client->clear();
+    } else {
+      REQUIRE(payload.size() == 1);
+      REQUIRE(payload[0][0]["service"] == "first");
+    }
+  }
+
+  REQUIRE(logger->error_count() == 0);
+  if (!*config.agent.batch_across_tracers) {
+    const auto payload =
+        nlohmann::json::from_msgpack(http_client->request_body);
+    REQUIRE(payload.size() == 1);
+    REQUIRE(payload[0][0]["service"] == "second");
+  } else {
+    // Nothing was left for `second` to send.
+    REQUIRE(http_client->request_body.empty());
+  }
+}
@@ -0,0 +1,365 @@
+#include <datadog/datadog_intake.h>
+#include <datadog/datadog_intake_config.h>
+#include <datadog/error.h>
+#include <datadog/json.hpp>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/environment.h"
+#include "common/protobuf.h"
+#include "compression.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/http_clients.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using datadog::test::EnvGuard;
+using namespace datadog::test::protobuf;
+
+#define DATADOG_INTAKE_TEST(x) TEST_CASE(x, "[datadog_intake]")
+
+namespace {
+
+TracerConfig intake_tracer_config(
+    const std::shared_ptr<MockLogger>& logger,
+    const std::shared_ptr<MockEventScheduler>& event_scheduler,
+    const std::shared_ptr<MockHTTPClient>& http_client) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.intake.enabled = true;
+  config.intake.api_key = "secret";
+  config.intake.event_scheduler = event_scheduler;
+  config.intake.http_client = http_client;
+  config.telemetry.enabled = false;
+  return config;
+}
+
+// Return the `TraceChunk` messages of the specified agentless `payload`, in
+// the order of their `TracerPayload` messages.
+std::vector<std::string> trace_chunks(const std::string& payload) {
+  std::vector<std::string> result;
+  for (const Field& tracer_payload : fields(payload, 5)) {
+    for (Field& chunk : fields(tracer_payload.bytes, 6)) {
+      result.push_back(std::move(chunk.bytes));
+    }
+  }
+  return result;
+}
+
+// Return the names of the spans of the specified `TraceChunk` message.
+std::vector<std::string> span_names(const std::string& chunk) {
+  std::vector<std::string> result;
+  for (const Field& span : fields(chunk, 3)) {
+    result.push_back(only(span.bytes, 2));
+  }
+  return result;
+}
+
+}  // namespace
+
+DATADOG_INTAKE_TEST("buffered traces are sent at shutdown") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+  config.intake.site = "datadoghq.eu";
+  config.intake.compression_enabled = false;
+  config.environment = "prod";
+  config.version = "1.2.3";
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  REQUIRE(std::holds_alternative<FinalizedDatadogIntakeConfig>(
+      finalized->collector));
+
+  {
+    http_client->response_status = 202;
+    Tracer tracer{*finalized};
+    {
+      SpanConfig root_config;
+      root_config.name = "first";
+      auto root = tracer.create_span(root_config);
+      SpanConfig child_config;
+      child_config.name = "child";
+      auto child = root.create_child(child_config);
+    }
+    {
+      SpanConfig root_config;
+      root_config.name = "second";
+      auto root = tracer.create_span(root_config);
+    }
+    // Nothing is sent until the buffer is large enough, the flush interval
+    // elapses, or the tracer is destroyed.
+    REQUIRE(http_client->request_body.empty());
+  }
+
+  REQUIRE(event_scheduler->cancelled);
+  REQUIRE(logger->error_count() == 0);
+  REQUIRE(http_client->request_url.scheme == "https");
+  REQUIRE(http_client->request_url.authority == "trace.agent.datadoghq.eu");
+  REQUIRE(http_client->request_url.path == "/api/v0.2/traces");
+
+  const auto& headers = http_client->request_headers.items;
+  REQUIRE(headers.count("DD-API-KEY") == 1);
+  REQUIRE(headers.find("DD-API-KEY")->second == "secret");
+  REQUIRE(headers.find("Content-Type")->second == "application/x-protobuf");
+  REQUIRE(headers.find("X-Datadog-Trace-Count")->second == "2");
+  REQUIRE(headers.count("Content-Encoding") == 0);
+
+  const auto tracer_payloads = fields(http_client->request_body, 5);
+  REQUIRE(tracer_payloads.size() == 1);
+  const std::string& tracer_payload = tracer_payloads.front().bytes;
+  REQUIRE(only(tracer_payload, 2) == "cpp");
+  REQUIRE(only(tracer_payload, 8) == "prod");
+  REQUIRE(only(tracer_payload, 10) == "1.2.3");
+
+  const auto chunks = trace_chunks(http_client->request_body);
+  REQUIRE(chunks.size() == 2);
+  REQUIRE(span_names(chunks[0]) ==
+          std::vector<std::string>{"first", "child"});
+  REQUIRE(span_names(chunks[1]) == std::vector<std::string>{"second"});
+  // Each chunk has the sampling priority of its local root span.
+  const auto priorities = fields(chunks[0], 1);
+  REQUIRE(priorities.size() == 1);
+  REQUIRE(priorities.front().integer == 1);
+
+  const auto spans = fields(chunks[0], 3);
+  const std::string& root = spans[0].bytes;
+  const std::string& child = spans[1].bytes;
+  REQUIRE(only(root, 1) == "testsvc");
+  REQUIRE(fields(root, 6).empty());
+  REQUIRE(fields(child, 6).front().integer == fields(root, 5).front().integer);
+  REQUIRE(fields(child, 4).front().integer == fields(root, 4).front().integer);
+  // The shared tags are among the tags of each span.
+  bool has_language = false;
+  for (const Field& entry : fields(child, 10)) {
+    if (only(entry.bytes, 1) == "language") {
+      has_language = only(entry.bytes, 2) == "cpp";
+    }
+  }
+  REQUIRE(has_language);
+}
+
+DATADOG_INTAKE_TEST("traces are sent once the batch is large enough") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+  config.intake.url = "http://localhost:8080/relay";
+  config.intake.flush_threshold_bytes = 1;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  http_client->response_status = 200;
+  event_scheduler->defer_posted_tasks = true;
+  Tracer tracer{*finalized};
+  {
+    SpanConfig root_config;
+    root_config.name = "large enough";
+    auto root = tracer.create_span(root_config);
+  }
+  // The flush is posted to the event scheduler, rather than made on the
+  // thread that finished the trace.
+  REQUIRE(http_client->request_body.empty());
+  REQUIRE(event_scheduler->posted_tasks.size() == 1);
+  {
+    // A flush is posted once until it begins.
+    auto root = tracer.create_span();
+  }
+  REQUIRE(event_scheduler->posted_tasks.size() == 1);
+  event_scheduler->run_posted_tasks();
+
+  REQUIRE(http_client->request_url.authority == "localhost:8080");
+  REQUIRE(http_client->request_url.path == "/relay");
+  const auto chunks = trace_chunks(http_client->request_body);
+  REQUIRE(chunks.size() == 2);
+  REQUIRE(span_names(chunks[0]) == std::vector<std::string>{"large enough"});
+
+  // The flush interval sends nothing if nothing is buffered.
+  http_client->clear();
+  REQUIRE(event_scheduler->event_callback);
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+}
+
+DATADOG_INTAKE_TEST("payloads that failed to reach the intake are sent again") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  logger->echo = nullptr;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  TimePoint current_time = default_clock();
+  const auto clock = [&current_time]() { return current_time; };
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+  config.intake.max_retries = 1;
+
+  bool transient = true;
+  SECTION("after a server error") { http_client->response_status = 503; }
+  SECTION("after a rate limiting response") {
+    http_client->response_status = 429;
+  }
+  SECTION("after a network error") {
+    http_client->response_error =
+        Error{Error::CURL_REQUEST_FAILURE, "connection refused"};
+  }
+  SECTION("but not after a client error") {
+    http_client->response_status = 400;
+    transient = false;
+  }
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  {
+    auto span = tracer.create_span();
+  }
+  event_scheduler->event_callback();
+  const std::string body = http_client->request_body;
+  REQUIRE(!body.empty());
+  http_client->drain(current_time.tick);
+  REQUIRE(logger->error_count() == 1);
+
+  // The payload is not sent again before its backoff elapses.
+  http_client->clear();
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+
+  current_time.tick += std::chrono::seconds(1);
+  event_scheduler->event_callback();
+  if (!transient) {
+    REQUIRE(http_client->request_body.empty());
+    return;
+  }
+  REQUIRE(http_client->request_body == body);
+
+  // The payload is sent again at most `max_retries` times.
+  http_client->drain(current_time.tick);
+  http_client->clear();
+  current_time.tick += std::chrono::hours(1);
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+}
+
+DATADOG_INTAKE_TEST("large payloads are compressed") {
+  if (!gzip_available()) {
+    // Payloads are sent uncompressed.
+    return;
+  }
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  http_client->response_status = 202;
+  {
+    Tracer tracer{*finalized};
+    for (int i = 0; i < 20; ++i) {
+      auto span = tracer.create_span();
+    }
+  }
+  REQUIRE(logger->error_count() == 0);
+  const auto& headers = http_client->request_headers.items;
+  const auto found = headers.find("Content-Encoding");
+  REQUIRE(found != headers.end());
+  REQUIRE(found->second == "gzip");
+}
+
+DATADOG_INTAKE_TEST("unsuccessful responses are logged") {
+  const auto logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  http_client->response_status = 403;
+  http_client->response_body << "Forbidden";
+  {
+    Tracer tracer{*finalized};
+    auto span = tracer.create_span();
+  }
+  REQUIRE(logger->error_count() == 1);
+}
+
+DATADOG_INTAKE_TEST("DatadogIntake environment and configuration") {
+  const auto logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = intake_tracer_config(logger, event_scheduler, http_client);
+
+  SECTION("environment variables override the API key and site") {
+    const EnvGuard api_key_guard{"DD_API_KEY", "from-env"};
+    const EnvGuard site_guard{"DD_SITE", "us3.datadoghq.com"};
+    auto finalized = finalize_config(config.intake, logger, default_clock);
+    REQUIRE(finalized);
+    REQUIRE(finalized->api_key == "from-env");
+    REQUIRE(finalized->url.authority == "trace.agent.us3.datadoghq.com");
+  }
+
+  SECTION("the agent configuration is ignored") {
+    config.agent.url = "http://agent.invalid:8126";
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    REQUIRE(std::holds_alternative<FinalizedDatadogIntakeConfig>(
+        finalized->collector));
+  }
+
+  SECTION("an API key is required") {
+    config.intake.api_key.reset();
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code == Error::DATADOG_INTAKE_MISSING_API_KEY);
+  }
+
+  SECTION("intervals must be positive") {
+    config.intake.flush_interval_milliseconds = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code == Error::DATADOG_INTAKE_INVALID_INTERVAL);
+  }
+
+  SECTION("the flush threshold must be within the buffer") {
+    config.intake.flush_threshold_bytes = 1024;
+    config.intake.max_buffered_bytes = 512;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_INTAKE_INVALID_BUFFER_LIMITS);
+  }
+
+  SECTION("the compression level must be between 1 and 9") {
+    config.intake.compression_level = 10;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_INTAKE_INVALID_COMPRESSION_LEVEL);
+  }
+
+  SECTION("the configuration does not include the API key") {
+    auto finalized = finalize_config(config.intake, logger, default_clock);
+    REQUIRE(finalized);
+    const TracerSignature signature{RuntimeID::generate(), "testsvc", "dev"};
+    DatadogIntake intake{*finalized, logger, signature};
+    const auto json = nlohmann::json::parse(intake.config());
+    REQUIRE(json["type"] == "datadog::tracing::DatadogIntake");
+    REQUIRE(json["config"]["max_retries"] == 3);
+    REQUIRE(json.dump().find("secret") == std::string::npos);
+  }
+}
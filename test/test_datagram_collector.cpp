@@ -0,0 +1,240 @@
+// These are tests for `DatagramCollector`, which sends each trace chunk as one
+// datagram over a Unix domain socket.  The tests receive the datagrams on a
+// socket of their own.
+
+#include <datadog/datagram_collector_config.h>
+#include <datadog/error.h>
+#include <datadog/json.hpp>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <variant>
+
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define DATAGRAM_COLLECTOR_TEST(x) TEST_CASE(x, "[datagram_collector]")
+
+namespace {
+
+// A non-blocking Unix domain socket of the specified type, bound to a path
+// that is removed when the `Receiver` is destroyed.
+class Receiver {
+  std::filesystem::path path_;
+  int fd_;
+
+ public:
+  explicit Receiver(int type)
+      : path_(std::filesystem::temp_directory_path() /
+              ("dd-trace-cpp-datagram-test-" + std::to_string(::getpid()))),
+        fd_(::socket(AF_UNIX, type | SOCK_NONBLOCK, 0)) {
+    std::filesystem::remove(path_);
+    REQUIRE(fd_ != -1);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    const std::string path = path_.string();
+    REQUIRE(path.size() < sizeof address.sun_path);
+    std::memcpy(address.sun_path, path.data(), path.size());
+    REQUIRE(::bind(fd_, reinterpret_cast<const sockaddr*>(&address),
+                   sizeof address) == 0);
+    if (type == SOCK_SEQPACKET) {
+      REQUIRE(::listen(fd_, 1) == 0);
+    }
+  }
+  ~Receiver() {
+    ::close(fd_);
+    std::filesystem::remove(path_);
+  }
+
+  std::string path() const { return path_.string(); }
+  int fd() const { return fd_; }
+
+  // Return the next datagram received on the specified `fd`, or an empty
+  // string if there is none.
+  static std::string receive(int fd) {
+    std::string datagram(1 << 16, '\0');
+    const auto size = ::recv(fd, datagram.data(), datagram.size(), 0);
+    datagram.resize(size < 0 ? 0 : std::size_t(size));
+    return datagram;
+  }
+};
+
+TracerConfig datagram_tracer_config(const std::shared_ptr<MockLogger>& logger,
+                                    const std::string& socket_path) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.datagram.enabled = true;
+  config.datagram.socket_path = socket_path;
+  config.telemetry.enabled = false;
+  return config;
+}
+
+}  // namespace
+
+DATAGRAM_COLLECTOR_TEST("each trace chunk is one datagram") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const Receiver receiver{SOCK_DGRAM};
+  auto config = datagram_tracer_config(logger, receiver.path());
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  REQUIRE(std::holds_alternative<FinalizedDatagramCollectorConfig>(
+      finalized->collector));
+
+  Tracer tracer{*finalized};
+  {
+    SpanConfig root_config;
+    root_config.name = "first";
+    auto root = tracer.create_span(root_config);
+    auto child = root.create_child();
+  }
+  {
+    SpanConfig root_config;
+    root_config.name = "second";
+    auto root = tracer.create_span(root_config);
+  }
+
+  REQUIRE(logger->error_count() == 0);
+  // Each datagram is a v0.4 traces payload of one chunk.
+  const auto first =
+      nlohmann::json::from_msgpack(receiver.receive(receiver.fd()));
+  REQUIRE(first.size() == 1);
+  REQUIRE(first[0].size() == 2);
+  REQUIRE(first[0][0]["name"] == "first");
+  REQUIRE(first[0][0]["service"] == "testsvc");
+  const auto second =
+      nlohmann::json::from_msgpack(receiver.receive(receiver.fd()));
+  REQUIRE(second.size() == 1);
+  REQUIRE(second[0].size() == 1);
+  REQUIRE(second[0][0]["name"] == "second");
+  REQUIRE(receiver.receive(receiver.fd()).empty());
+  REQUIRE(tracer.runtime_stats().dropped_trace_chunks == 0);
+}
+
+DATAGRAM_COLLECTOR_TEST("sequenced packet sockets") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const Receiver receiver{SOCK_SEQPACKET};
+  auto config = datagram_tracer_config(logger, receiver.path());
+  config.datagram.socket_type = DatagramSocketType::SEQPACKET;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  const int connection = ::accept(receiver.fd(), nullptr, nullptr);
+  REQUIRE(connection != -1);
+  {
+    auto root = tracer.create_span();
+  }
+  const auto payload =
+      nlohmann::json::from_msgpack(Receiver::receive(connection));
+  REQUIRE(payload.size() == 1);
+  REQUIRE(payload[0].size() == 1);
+
+  // The connection's closing is noticed, and the socket is reconnected right
+  // away.
+  ::close(connection);
+  {
+    auto root = tracer.create_span();
+  }
+  REQUIRE(logger->error_count() == 1);
+  const int reconnection = ::accept(receiver.fd(), nullptr, nullptr);
+  REQUIRE(reconnection != -1);
+  REQUIRE(!Receiver::receive(reconnection).empty());
+  ::close(reconnection);
+  REQUIRE(tracer.runtime_stats().dropped_trace_chunks == 0);
+}
+
+DATAGRAM_COLLECTOR_TEST("trace chunks are dropped rather than blocking") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+
+  SECTION("when the socket's buffer is full") {
+    const Receiver receiver{SOCK_DGRAM};
+    auto config = datagram_tracer_config(logger, receiver.path());
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    // Nothing is received, so the receiver's queue eventually fills.
+    for (int i = 0; i < 10000; ++i) {
+      auto root = tracer.create_span();
+    }
+    REQUIRE(tracer.runtime_stats().dropped_trace_chunks > 0);
+    REQUIRE(logger->error_count() == 0);
+  }
+
+  SECTION("when the chunk is larger than a datagram") {
+    const Receiver receiver{SOCK_DGRAM};
+    auto config = datagram_tracer_config(logger, receiver.path());
+    config.datagram.max_datagram_bytes = 64;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      root.set_tag("large", std::string(100, 'x'));
+    }
+    REQUIRE(receiver.receive(receiver.fd()).empty());
+    REQUIRE(tracer.runtime_stats().dropped_trace_chunks == 1);
+  }
+
+  SECTION("when there is no receiver") {
+    auto config = datagram_tracer_config(
+        logger, (std::filesystem::temp_directory_path() /
+                 "dd-trace-cpp-datagram-test-missing")
+                    .string());
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    for (int i = 0; i < 3; ++i) {
+      auto root = tracer.create_span();
+    }
+    REQUIRE(tracer.runtime_stats().dropped_trace_chunks == 3);
+    // The failure to connect is logged only once.
+    REQUIRE(logger->error_count() == 1);
+    REQUIRE(logger->first_error().code == Error::DATAGRAM_SOCKET_UNAVAILABLE);
+  }
+}
+
+DATAGRAM_COLLECTOR_TEST("DatagramCollector configuration") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  auto config = datagram_tracer_config(logger, "/tmp/ignored");
+
+  SECTION("the socket path is required") {
+    config.datagram.socket_path.reset();
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATAGRAM_COLLECTOR_MISSING_SOCKET_PATH);
+  }
+
+  SECTION("the maximum datagram size must be positive") {
+    config.datagram.max_datagram_bytes = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATAGRAM_COLLECTOR_INVALID_MAX_DATAGRAM_BYTES);
+  }
+
+  SECTION("the reconnect interval must be positive") {
+    config.datagram.reconnect_interval_milliseconds = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATAGRAM_COLLECTOR_INVALID_INTERVAL);
+  }
+}
@@ -1,5 +1,7 @@
 #include <datadog/endpoint_inferral.h>
 
+#include <random>
+#include <regex>
 #include <string>
 
 #include "test.h"
@@ -71,3 +73,66 @@ TEST_ENDPOINT("minimum length boundaries") {
   // str requires length ≥ 20 (when no special characters)
   CHECK(infer_endpoint("/x/aaaaaaaaaaaaaaaaaaa") == "/x/aaaaaaaaaaaaaaaaaaa");
 }
+
+TEST_ENDPOINT("classification agrees with the patterns") {
+  // The patterns documented in `endpoint_inferral.cpp`, in order of
+  // precedence.
+  const std::pair<std::regex, const char*> patterns[] = {
+      {std::regex("[1-9][0-9]+"), "{param:int}"},
+      {std::regex("(?=.*[0-9])[0-9._-]{3,}"), "{param:int_id}"},
+      {std::regex("(?=.*[0-9])[A-Fa-f0-9]{6,}"), "{param:hex}"},
+      {std::regex("(?=.*[0-9])[A-Fa-f0-9._-]{6,}"), "{param:hex_id}"},
+      {std::regex(".{20,}|.*[%&'()*+,:=@].*"), "{param:str}"},
+  };
+  const std::string alphabet =
+      "0123456789019abcdefABCDEFgzGZ._-%&'()*+,:=@~!$;";
+
+  std::mt19937 generator(12345);
+  std::uniform_int_distribution<std::size_t> length(1, 24);
+  std::uniform_int_distribution<std::size_t> character(0, alphabet.size() - 1);
+  for (int i = 0; i < 20000; ++i) {
+    std::string component(length(generator), ' ');
+    for (char& c : component) {
+      c = alphabet[character(generator)];
+    }
+
+    std::string expected = component;
+    for (const auto& [pattern, replacement] : patterns) {
+      if (std::regex_match(component, pattern)) {
+        expected = replacement;
+        break;
+      }
+    }
+    CAPTURE(component);
+    REQUIRE(infer_endpoint("/x/" + component) == "/x/" + expected);
+  }
+}
+
+TEST_ENDPOINT("cache evicts the least recently used path") {
+  EndpointCache cache{1, 2};
+  CHECK(cache.infer("/users/12") == "/users/{param:int}");
+  CHECK(cache.infer("/x/abcde9") == "/x/{param:hex}");
+  CHECK(cache.contains("/users/12"));
+  CHECK(cache.contains("/x/abcde9"));
+
+  // Using "/users/12" makes "/x/abcde9" the least recently used.
+  CHECK(cache.infer("/users/12") == "/users/{param:int}");
+  CHECK(cache.infer("/a/b") == "/a/b");
+  CHECK(cache.contains("/users/12"));
+  CHECK(!cache.contains("/x/abcde9"));
+  CHECK(cache.contains("/a/b"));
+}
+
+TEST_ENDPOINT("cache agrees with infer_endpoint") {
+  EndpointCache cache{EndpointCache::max_shards, 4};
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 100; ++i) {
+      const std::string path = "/v1/items/" + std::to_string(i * 17);
+      CHECK(cache.infer(path) == infer_endpoint(path));
+    }
+  }
+
+  EndpointCache nothing_cached{1, 0};
+  CHECK(nothing_cached.infer("/users/12") == "/users/{param:int}");
+  CHECK(!nothing_cached.contains("/users/12"));
+}
@@ -0,0 +1,142 @@
+#include <datadog/flat_map.h>
+#include <datadog/string_view.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_FLAT_MAP(x) TEST_CASE(x, "[flat_map]")
+
+using Map = FlatMap<std::string, std::string, 4>;
+
+TEST_FLAT_MAP("empty map") {
+  const Map map;
+  REQUIRE(map.empty());
+  REQUIRE(map.size() == 0);
+  REQUIRE(map.begin() == map.end());
+  REQUIRE(map.find("foo") == map.end());
+  REQUIRE(map.count("foo") == 0);
+  REQUIRE_THROWS_AS(map.at("foo"), std::out_of_range);
+}
+
+TEST_FLAT_MAP("insertion does not overwrite, except insert_or_assign") {
+  Map map;
+
+  auto [iter, inserted] = map.emplace("foo", "bar");
+  REQUIRE(inserted);
+  REQUIRE(iter->first == "foo");
+  REQUIRE(iter->second == "bar");
+
+  std::tie(iter, inserted) = map.emplace("foo", "baz");
+  REQUIRE_FALSE(inserted);
+  REQUIRE(map.at("foo") == "bar");
+
+  std::tie(iter, inserted) = map.insert(std::make_pair("foo", "baz"));
+  REQUIRE_FALSE(inserted);
+  REQUIRE(map.at("foo") == "bar");
+
+  std::tie(iter, inserted) = map.insert_or_assign("foo", "baz");
+  REQUIRE_FALSE(inserted);
+  REQUIRE(map.at("foo") == "baz");
+
+  std::tie(iter, inserted) = map.insert_or_assign("hello", "world");
+  REQUIRE(inserted);
+  REQUIRE(map.size() == 2);
+
+  map["foo"] = "qux";
+  map["new"];
+  REQUIRE(map.at("foo") == "qux");
+  REQUIRE(map.at("new") == "");
+  REQUIRE(map.size() == 3);
+}
+
+TEST_FLAT_MAP("lookup with other key types") {
+  Map map;
+  map.emplace("foo", "bar");
+
+  const std::string key = "foo";
+  const StringView view = key;
+  REQUIRE(map.find(key) != map.end());
+  REQUIRE(map.find(view) != map.end());
+  REQUIRE(map.find("foo") != map.end());
+  REQUIRE(map.count(StringView{"nope"}) == 0);
+}
+
+TEST_FLAT_MAP("elements are kept in insertion order") {
+  Map map;
+  const std::vector<std::pair<std::string, std::string>> items{
+      {"one", "1"}, {"two", "2"}, {"three", "3"}, {"four", "4"},
+      {"five", "5"}, {"six", "6"}};
+  map.insert(items.begin(), items.end());
+  REQUIRE(map.size() == items.size());
+  REQUIRE(std::equal(map.begin(), map.end(), items.begin(), items.end()));
+
+  REQUIRE(map.erase("two") == 1);
+  REQUIRE(map.erase("two") == 0);
+  REQUIRE(map.size() == items.size() - 1);
+  REQUIRE(map.find("two") == map.end());
+  REQUIRE(map.begin()->first == "one");
+  REQUIRE(std::next(map.begin())->first == "three");
+
+  map.clear();
+  REQUIRE(map.empty());
+}
+
+TEST_FLAT_MAP("equality ignores order") {
+  Map left;
+  left.emplace("a", "1");
+  left.emplace("b", "2");
+
+  Map right;
+  right.emplace("b", "2");
+  right.emplace("a", "1");
+  REQUIRE(left == right);
+
+  right["a"] = "changed";
+  REQUIRE(left != right);
+
+  right.erase("a");
+  REQUIRE(left != right);
+}
+
+TEST_FLAT_MAP("behaves like std::unordered_map") {
+  // Apply the same sequence of operations to both containers, and compare.
+  using Operation = std::pair<char, int>;
+  const auto operations = GENERATE(
+      std::vector<Operation>{{'+', 1}, {'+', 2}, {'-', 1}, {'=', 2}},
+      std::vector<Operation>{
+          {'+', 1}, {'+', 2}, {'+', 3}, {'+', 4}, {'+', 5}, {'-', 3}, {'=', 3}},
+      std::vector<Operation>{{'-', 1}, {'=', 1}, {'+', 1}, {'-', 1}});
+
+  FlatMap<int, int, 2> flat;
+  std::unordered_map<int, int> reference;
+  int counter = 0;
+  for (const auto& [op, key] : operations) {
+    ++counter;
+    switch (op) {
+      case '+':
+        flat.emplace(key, counter);
+        reference.emplace(key, counter);
+        break;
+      case '=':
+        flat.insert_or_assign(key, counter);
+        reference.insert_or_assign(key, counter);
+        break;
+      default:
+        REQUIRE(flat.erase(key) == reference.erase(key));
+    }
+  }
+
+  REQUIRE(flat.size() == reference.size());
+  for (const auto& [key, value] : reference) {
+    REQUIRE(flat.at(key) == value);
+  }
+}
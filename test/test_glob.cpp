@@ -4,6 +4,10 @@
 #include <datadog/glob.h>
 #include <datadog/string_view.h>
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
 #include "test.h"
 
 using namespace datadog::tracing;
@@ -57,4 +61,63 @@ TEST_CASE("glob", "[glob]") {
   CAPTURE(test_case.expected);
   REQUIRE(glob_match(test_case.pattern, test_case.subject) ==
           test_case.expected);
+  REQUIRE(GlobPattern(test_case.pattern).match(test_case.subject) ==
+          test_case.expected);
+}
+
+TEST_CASE("glob patterns that are not a literal prefix or suffix", "[glob]") {
+  struct TestCase {
+    StringView pattern;
+    StringView subject;
+    bool expected;
+  };
+
+  auto test_case = GENERATE(values<TestCase>({
+      {"FOO*", "foobar", true},
+      {"foo*", "fo", false},
+      {"*BAR", "foobar", true},
+      {"*bar", "ar", false},
+      {"**", "anything", true},
+      {"*o*", "foo", true},
+      {"f?o*", "fxoo", true},
+      {"*?", "", false},
+  }));
+
+  CAPTURE(test_case.pattern);
+  CAPTURE(test_case.subject);
+  REQUIRE(glob_match(test_case.pattern, test_case.subject) ==
+          test_case.expected);
+  REQUIRE(GlobPattern(test_case.pattern).match(test_case.subject) ==
+          test_case.expected);
+}
+
+TEST_CASE("glob patterns agree with glob_match", "[glob]") {
+  // Every pattern of up to five characters from "a", "B", "?", and "*" is
+  // matched against every subject of up to five characters from "A" and "b".
+  std::vector<std::string> patterns{""};
+  std::vector<std::string> subjects{""};
+  for (std::size_t i = 0; i < patterns.size(); ++i) {
+    if (patterns[i].size() < 5) {
+      for (const char c : {'a', 'B', '?', '*'}) {
+        patterns.push_back(patterns[i] + c);
+      }
+    }
+  }
+  for (std::size_t i = 0; i < subjects.size(); ++i) {
+    if (subjects[i].size() < 5) {
+      for (const char c : {'A', 'b'}) {
+        subjects.push_back(subjects[i] + c);
+      }
+    }
+  }
+
+  for (const auto& pattern : patterns) {
+    const GlobPattern compiled{pattern};
+    for (const auto& subject : subjects) {
+      if (compiled.match(subject) != glob_match(pattern, subject)) {
+        CAPTURE(pattern, subject);
+        REQUIRE(compiled.match(subject) == glob_match(pattern, subject));
+      }
+    }
+  }
 }
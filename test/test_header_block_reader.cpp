@@ -0,0 +1,38 @@
+#include <datadog/header_block_reader.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define HEADER_BLOCK_READER_TEST(x) TEST_CASE(x, "[header_block_reader]")
+
+HEADER_BLOCK_READER_TEST("header lines are looked up without a map") {
+  const std::string block =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type:  application/json \r\n"
+      "x-datadog-rates: first\r\n"
+      "X-Datadog-Rates: second\n"
+      "Empty:\r\n";
+  const HeaderBlockReader reader{block};
+
+  REQUIRE(reader.lookup("content-type") == "application/json");
+  REQUIRE(reader.lookup("CONTENT-TYPE") == "application/json");
+  REQUIRE(reader.lookup("X-Datadog-Rates") == "first");
+  REQUIRE(reader.lookup("empty") == "");
+  REQUIRE_FALSE(reader.lookup("content"));
+  REQUIRE_FALSE(reader.lookup("HTTP/1.1 200 OK"));
+
+  std::vector<std::pair<std::string, std::string>> visited;
+  reader.visit([&](StringView key, StringView value) {
+    visited.emplace_back(std::string(key), std::string(value));
+  });
+  const std::vector<std::pair<std::string, std::string>> expected{
+      {"content-type", "application/json"},
+      {"x-datadog-rates", "first"},
+      {"empty", ""}};
+  REQUIRE(visited == expected);
+}
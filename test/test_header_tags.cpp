@@ -0,0 +1,183 @@
+// These are tests for `HeaderTags`, the compiled form of
+// `TracerConfig::header_tags`, and for how the tracer tags spans with the
+// request and response headers that it names.
+
+#include <datadog/error.h>
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "header_tags.h"
+#include "mocks/collectors.h"
+#include "mocks/dict_readers.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "string_util.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_HEADER_TAGS(x) TEST_CASE(x, "[header_tags]")
+
+namespace {
+
+// `LookupReader` is a reader that fails if it is visited.
+struct LookupReader : public MockDictReader {
+  using MockDictReader::MockDictReader;
+  void visit(const std::function<void(StringView, StringView)>&)
+      const override {
+    FAIL("visited");
+  }
+  bool prefers_visit() const override { return false; }
+};
+
+Tracer make_tracer(const std::shared_ptr<MockCollector>& collector) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.header_tags = {{"X-Request-ID", ""},
+                        {"user-agent", "http.useragent"},
+                        {"x-datadog-origin", ""},
+                        {"Content.Type", ""}};
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  return Tracer{*finalized};
+}
+
+}  // namespace
+
+TEST_HEADER_TAGS("headers are found regardless of case") {
+  std::unordered_map<std::string, std::string> config;
+  for (int i = 0; i < int(HeaderTags::max_headers); ++i) {
+    config.emplace("X-Header-" + std::to_string(i), "");
+  }
+  auto compiled = HeaderTags::compile(config);
+  REQUIRE(compiled);
+  REQUIRE(compiled->entries().size() == HeaderTags::max_headers);
+
+  for (const auto& [header, ignored] : config) {
+    CAPTURE(header);
+    const std::size_t index = compiled->find(header);
+    REQUIRE(index != HeaderTags::npos);
+    const auto& entry = compiled->entries()[index];
+    REQUIRE(entry.header == to_lower(header));
+    REQUIRE(compiled->find(entry.header) == index);
+    REQUIRE(entry.request_tag == "http.request.headers." + entry.header);
+    REQUIRE(entry.response_tag == "http.response.headers." + entry.header);
+  }
+  REQUIRE(compiled->find("x-header-64") == HeaderTags::npos);
+  REQUIRE(compiled->find("x-header-") == HeaderTags::npos);
+  REQUIRE(compiled->find("") == HeaderTags::npos);
+
+  const auto empty = HeaderTags::compile({});
+  REQUIRE(empty);
+  REQUIRE(empty->find("x-header-1") == HeaderTags::npos);
+}
+
+TEST_HEADER_TAGS("tag names") {
+  const auto compiled =
+      HeaderTags::compile({{"Content.Type", ""}, {"x-id", "request.id"}});
+  REQUIRE(compiled);
+  const auto& content_type =
+      compiled->entries()[compiled->find("content.type")];
+  REQUIRE(content_type.request_tag == "http.request.headers.content_type");
+  REQUIRE(content_type.response_tag == "http.response.headers.content_type");
+  const auto& id = compiled->entries()[compiled->find("X-ID")];
+  REQUIRE(id.request_tag == "request.id");
+  REQUIRE(id.response_tag == "request.id");
+}
+
+TEST_HEADER_TAGS("invalid header tags") {
+  std::unordered_map<std::string, std::string> config;
+  SECTION("empty header name") { config = {{"", "tag"}}; }
+  SECTION("repeated header name") {
+    config = {{"User-Agent", ""}, {"user-agent", "ua"}};
+  }
+  SECTION("too many headers") {
+    for (int i = 0; i <= int(HeaderTags::max_headers); ++i) {
+      config.emplace("x-" + std::to_string(i), "");
+    }
+  }
+
+  TracerConfig tracer_config;
+  tracer_config.service = "testsvc";
+  tracer_config.header_tags = config;
+  auto finalized = finalize_config(tracer_config);
+  REQUIRE(!finalized);
+  REQUIRE(finalized.error().code == Error::TRACER_INVALID_HEADER_TAGS);
+}
+
+TEST_HEADER_TAGS("extracted spans are tagged with request headers") {
+  const auto collector = std::make_shared<MockCollector>();
+  auto tracer = make_tracer(collector);
+
+  const bool has_context = GENERATE(false, true);
+  const bool prefers_visit = GENERATE(false, true);
+  CAPTURE(has_context);
+  CAPTURE(prefers_visit);
+  std::unordered_map<std::string, std::string> headers{
+      {"x-request-id", "abc123"},
+      {"user-agent", "curl/8.0"},
+      {"x-datadog-origin", "synthetics"},
+      {"accept", "*/*"}};
+  if (has_context) {
+    headers.emplace("x-datadog-trace-id", "123");
+    headers.emplace("x-datadog-parent-id", "456");
+  }
+  const MockDictReader visited_reader{headers};
+  const LookupReader lookup_reader{headers};
+  const DictReader& reader =
+      prefers_visit ? static_cast<const DictReader&>(visited_reader)
+                    : lookup_reader;
+
+  {
+    auto span = tracer.extract_or_create_span(reader);
+    REQUIRE((span.trace_id().low == 123) == has_context);
+  }
+  if (has_context) {
+    auto span = tracer.extract_span(reader);
+    REQUIRE(span);
+  }
+
+  REQUIRE(collector->chunks.size() == (has_context ? 2 : 1));
+  for (const auto& chunk : collector->chunks) {
+    const auto& tags = chunk.front()->tags;
+    REQUIRE(tags.at("http.request.headers.x-request-id") == "abc123");
+    REQUIRE(tags.at("http.useragent") == "curl/8.0");
+    REQUIRE(tags.at("http.request.headers.x-datadog-origin") ==
+            "synthetics");
+    REQUIRE(tags.count("http.request.headers.accept") == 0);
+    REQUIRE(tags.count("http.request.headers.content_type") == 0);
+  }
+}
+
+TEST_HEADER_TAGS("spans are tagged with response headers") {
+  const auto collector = std::make_shared<MockCollector>();
+  auto tracer = make_tracer(collector);
+
+  const bool prefers_visit = GENERATE(false, true);
+  CAPTURE(prefers_visit);
+  const std::unordered_map<std::string, std::string> headers{
+      {"Content.Type", "text/plain"}, {"server", "nginx"}};
+  {
+    auto span = tracer.create_span();
+    if (prefers_visit) {
+      span.set_response_header_tags(MockDictReader{headers});
+    } else {
+      // `MockDictReader` looks up headers case-sensitively.
+      const std::unordered_map<std::string, std::string> lower{
+          {"content.type", "text/plain"}, {"server", "nginx"}};
+      span.set_response_header_tags(LookupReader{lower});
+    }
+  }
+
+  const auto& tags = collector->first_span().tags;
+  REQUIRE(tags.at("http.response.headers.content_type") == "text/plain");
+  REQUIRE(tags.count("http.response.headers.server") == 0);
+}
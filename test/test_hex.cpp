@@ -0,0 +1,46 @@
+#include <datadog/hex.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "catch.hpp"
+#include "test.h"
+
+#define HEX_TEST(x) TEST_CASE(x, "[hex]")
+
+using namespace datadog::tracing;
+
+HEX_TEST("padded hex matches std::to_chars") {
+  const auto value = GENERATE(
+      std::uint64_t(0), std::uint64_t(1), std::uint64_t(0xabcdef),
+      std::uint64_t(0x0123456789abcdef), std::uint64_t(0xfedcba9876543210),
+      std::numeric_limits<std::uint64_t>::max());
+  CAPTURE(value);
+
+  const std::string unpadded = hex(value);
+  const std::string expected =
+      std::string(16 - unpadded.size(), '0') + unpadded;
+  REQUIRE(hex_padded(value) == expected);
+
+  std::string appended = "prefix";
+  append_hex_padded(appended, value);
+  REQUIRE(appended == "prefix" + expected);
+
+  REQUIRE(hex_padded(std::uint8_t(value)) == expected.substr(14));
+  REQUIRE(hex_padded(std::uint32_t(value)) == expected.substr(8));
+}
+
+HEX_TEST("parse hex") {
+  REQUIRE(parse_hex("0") == std::uint64_t(0));
+  REQUIRE(parse_hex("00000000000000ff") == std::uint64_t(0xff));
+  REQUIRE(parse_hex("0123456789abcdef") == std::uint64_t(0x0123456789abcdef));
+  REQUIRE(parse_hex("FEDCBA9876543210") == std::uint64_t(0xfedcba9876543210));
+  REQUIRE(parse_hex("ffffffffffffffff") ==
+          std::numeric_limits<std::uint64_t>::max());
+
+  const auto invalid = GENERATE(as<StringView>{}, "", "0123456789abcdef0",
+                                "0x12", "12g4", " 12", "12 ", "-1", "@", "`");
+  CAPTURE(invalid);
+  REQUIRE_FALSE(parse_hex(invalid));
+}
@@ -0,0 +1,50 @@
+#include <datadog/http_client.h>
+
+#include <string>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define HTTP_CLIENT_TEST(x) TEST_CASE(x, "[http_client]")
+
+HTTP_CLIENT_TEST("URLView::split agrees with URL::parse") {
+  const char* const inputs[] = {
+      "http://localhost:8126",
+      "http://localhost:8126/",
+      "https://example.com/api/v1/users/12?x=y&z",
+      "http://example.com?query",
+      "http://example.com/path?",
+      "unix:///var/run/datadog/apm.socket",
+      "http+unix:///var/run/datadog/apm.socket",
+      "https+unix:///var/run/datadog/apm.socket",
+      "unix://relative/apm.socket",
+      "unix://",
+      "tcp://localhost:8126",
+      "/var/run/datadog/apm.socket",
+      "",
+  };
+
+  for (const char* const input : inputs) {
+    CAPTURE(input);
+    const auto parsed = HTTPClient::URL::parse(input);
+    const auto view = HTTPClient::URLView::split(input);
+    REQUIRE(parsed.has_value() == view.has_value());
+    if (!view) {
+      continue;
+    }
+    CHECK(parsed->scheme == view->scheme);
+    CHECK(parsed->authority == view->authority);
+    CHECK(parsed->path == view->path);
+    CHECK(parsed->query == view->query);
+  }
+}
+
+HTTP_CLIENT_TEST("URLView::split refers to its input") {
+  const std::string input = "https://example.com/users/12?x=y";
+  const auto view = HTTPClient::URLView::split(input);
+  REQUIRE(view);
+  CHECK(view->path == "/users/12");
+  CHECK(view->path.data() == input.data() + 19);
+  CHECK(view->query == "x=y");
+}
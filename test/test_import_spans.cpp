@@ -0,0 +1,134 @@
+// These are tests for `Tracer::import_spans`, which makes a trace of
+// operations that finished before they were traced.
+
+#include <datadog/error.h>
+#include <datadog/imported_span.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define TEST_IMPORT_SPANS(x) TEST_CASE(x, "[import_spans]")
+
+namespace {
+
+std::shared_ptr<MockCollector> collector_for(TracerConfig& config) {
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  return collector;
+}
+
+}  // namespace
+
+TEST_IMPORT_SPANS("imported spans are sent as one trace") {
+  TracerConfig config;
+  const auto collector = collector_for(config);
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  TimePoint start;
+  start.wall = std::chrono::system_clock::time_point(1'700'000'000s);
+  start.tick = std::chrono::steady_clock::now();
+  const SpanConfigView::Tag kernel_tags[] = {{"gpu.device", "0"},
+                                             {"gpu.stream", "7"}};
+
+  std::vector<ImportedSpan> spans(3);
+  spans[0].config.name = "batch";
+  spans[0].config.start = start;
+  spans[0].duration = 30ms;
+  spans[1].parent_index = 0;
+  spans[1].config.name = "kernel";
+  spans[1].config.resource = "matmul";
+  spans[1].config.start = start;
+  spans[1].config.tags = kernel_tags;
+  spans[1].duration = 10ms;
+  spans[2].parent_index = 1;
+  spans[2].config.name = "copy";
+  spans[2].config.start = start;
+  spans[2].duration = 5ms;
+  spans[2].error = true;
+
+  const auto trace_id = tracer.import_spans(spans);
+  REQUIRE(trace_id);
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& chunk = collector->chunks.front();
+  REQUIRE(chunk.size() == 3);
+  const SpanData& root = *chunk[0];
+  const SpanData& kernel = *chunk[1];
+  const SpanData& copy = *chunk[2];
+  REQUIRE(root.trace_id == *trace_id);
+  REQUIRE(root.parent_id == 0);
+  REQUIRE(root.name == "batch");
+  REQUIRE(root.service == "testsvc");
+  REQUIRE(root.start.wall == start.wall);
+  REQUIRE(root.duration == 30ms);
+  REQUIRE(root.numeric_tags.count("_sampling_priority_v1"));
+
+  REQUIRE(kernel.trace_id == *trace_id);
+  REQUIRE(kernel.parent_id == root.span_id);
+  REQUIRE(kernel.resource == "matmul");
+  REQUIRE(kernel.tags.at("gpu.stream") == "7");
+  REQUIRE(kernel.duration == 10ms);
+  REQUIRE(!kernel.error);
+
+  REQUIRE(copy.parent_id == kernel.span_id);
+  REQUIRE(copy.resource == "copy");
+  REQUIRE(copy.error);
+  REQUIRE(copy.span_id != kernel.span_id);
+}
+
+TEST_IMPORT_SPANS("imported spans are limited as any trace is") {
+  TracerConfig config;
+  const auto collector = collector_for(config);
+  config.max_spans_per_trace_segment = 3;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  std::vector<ImportedSpan> spans(10);
+  for (std::size_t i = 1; i < spans.size(); ++i) {
+    spans[i].parent_index = 0;
+  }
+  REQUIRE(tracer.import_spans(spans));
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& chunk = collector->chunks.front();
+  REQUIRE(chunk.size() == 3);
+  REQUIRE(chunk[0]->tags.at("_dd.trace.truncated") == "spans");
+}
+
+TEST_IMPORT_SPANS("invalid imported spans") {
+  TracerConfig config;
+  const auto collector = collector_for(config);
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  std::vector<ImportedSpan> spans(2);
+  SECTION("no spans") { spans.clear(); }
+  SECTION("a root with a parent") {
+    spans[0].parent_index = 0;
+    spans[1].parent_index = 0;
+  }
+  SECTION("a child without a parent") {}
+  SECTION("a parent that follows its child") { spans[1].parent_index = 1; }
+
+  const auto result = tracer.import_spans(spans);
+  REQUIRE(!result);
+  REQUIRE(result.error().code == Error::TRACER_INVALID_IMPORTED_SPANS);
+  REQUIRE(collector->chunks.empty());
+}
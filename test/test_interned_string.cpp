@@ -0,0 +1,64 @@
+#include <datadog/interned_string.h>
+
+#include <string>
+#include <utility>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define INTERNED_STRING_TEST(x) TEST_CASE(x, "[interned_string]")
+
+static_assert(sizeof(InternedString) == sizeof(void*),
+              "An InternedString is the size of a pointer.");
+
+INTERNED_STRING_TEST("equal values share one interned copy") {
+  const InternedString first = "web.request";
+  const InternedString second = std::string("web.request");
+  REQUIRE(first.interned());
+  REQUIRE(second.interned());
+  REQUIRE(first.data() == second.data());
+  REQUIRE(first == second);
+  REQUIRE(first == "web.request");
+  REQUIRE("web.request" == first);
+  REQUIRE(first != "web.response");
+
+  InternedString copy = first;
+  REQUIRE(copy.data() == first.data());
+  copy = "web.response";
+  REQUIRE(copy != first);
+  REQUIRE(copy.str() == "web.response");
+  REQUIRE(intern("web.response") == &copy.str());
+
+  const InternedString empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty == "");
+  REQUIRE(empty == InternedString(""));
+}
+
+INTERNED_STRING_TEST("long values are owned rather than interned") {
+  const std::string long_value(1000, 'x');
+  REQUIRE(intern(long_value) == nullptr);
+
+  InternedString value = long_value;
+  REQUIRE_FALSE(value.interned());
+  REQUIRE(value == long_value);
+
+  // An owned value is copied with its owner, and moved without copying.
+  const InternedString copy = value;
+  REQUIRE_FALSE(copy.interned());
+  REQUIRE(copy.data() != value.data());
+  REQUIRE(copy == value);
+
+  const char* const data = value.data();
+  const InternedString moved = std::move(value);
+  REQUIRE(moved.data() == data);
+  REQUIRE(value.empty());
+
+  // An owned value and an interned value are compared by their contents.
+  InternedString short_value = "short";
+  REQUIRE(short_value != moved);
+  short_value = moved;
+  REQUIRE_FALSE(short_value.interned());
+  REQUIRE(short_value == moved);
+}
@@ -0,0 +1,90 @@
+#include <datadog/json.hpp>
+#include <datadog/json_writer.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define JSON_WRITER_TEST(x) TEST_CASE(x, "[json_writer]")
+
+JSON_WRITER_TEST("nested objects and arrays are separated") {
+  std::string buffer = "prefix ";
+  JsonWriter json{buffer};
+  json.begin_object();
+  json.member("name", "stella");
+  json.member("enabled", true);
+  json.key("empty");
+  json.begin_object();
+  json.end_object();
+  json.key("points");
+  json.begin_array();
+  json.begin_array();
+  json.value(std::uint64_t(1));
+  json.value(-2);
+  json.end_array();
+  json.begin_array();
+  json.end_array();
+  json.null();
+  json.end_array();
+  json.key("raw");
+  json.raw(R"({"a":[1,2]})");
+  json.end_object();
+
+  REQUIRE(buffer ==
+          R"(prefix {"name":"stella","enabled":true,"empty":{},)"
+          R"("points":[[1,-2],[],null],"raw":{"a":[1,2]}})");
+}
+
+JSON_WRITER_TEST("strings are escaped") {
+  std::string text = "quote \" backslash \\ newline \n tab \t bell \a";
+  text += '\0';
+  text += "after null \x1f and UTF-8 \xc3\xa9";
+
+  std::string buffer;
+  JsonWriter json{buffer};
+  json.value(text);
+
+  REQUIRE(buffer.find('\n') == std::string::npos);
+  REQUIRE(nlohmann::json::parse(buffer) == text);
+}
+
+JSON_WRITER_TEST("numbers read back as the same value") {
+  auto number = GENERATE(0.0, 0.1, -2.5, 5.0, 1e300, 1.0 / 3,
+                         std::numeric_limits<double>::min());
+
+  std::string buffer;
+  JsonWriter json{buffer};
+  json.value(number);
+
+  const auto parsed = nlohmann::json::parse(buffer);
+  REQUIRE(parsed.is_number_float());
+  REQUIRE(parsed.get<double>() == number);
+}
+
+JSON_WRITER_TEST("integers are written exactly") {
+  std::string buffer;
+  JsonWriter json{buffer};
+  json.begin_array();
+  json.value(std::numeric_limits<std::int64_t>::min());
+  json.value(std::numeric_limits<std::uint64_t>::max());
+  json.value(char(7));
+  json.end_array();
+
+  REQUIRE(buffer == "[-9223372036854775808,18446744073709551615,7]");
+}
+
+JSON_WRITER_TEST("non-finite numbers are written as null") {
+  auto number = GENERATE(std::nan(""), std::numeric_limits<double>::infinity(),
+                         -std::numeric_limits<double>::infinity());
+
+  std::string buffer;
+  JsonWriter json{buffer};
+  json.value(number);
+
+  REQUIRE(buffer == "null");
+}
@@ -1,8 +1,11 @@
 #include <datadog/clock.h>
 #include <datadog/limiter.h>
 
+#include <atomic>
 #include <chrono>
 #include <ctime>
+#include <thread>
+#include <vector>
 
 #include "test.h"
 
@@ -141,4 +144,31 @@ TEST_CASE("limiter") {
     result = lim.allow();
     REQUIRE(!result.allowed);
   }
+
+  SECTION("is consistent when used concurrently") {
+    // The clock does not advance, so exactly `max_tokens` requests among all
+    // of the threads are allowed.
+    Limiter lim(clock, 1000, 1.0, 1);
+    std::atomic<int> allowed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+      threads.emplace_back([&]() {
+        for (int j = 0; j < 1000; ++j) {
+          if (lim.allow().allowed) {
+            ++allowed;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    REQUIRE(allowed == 1000);
+
+    // 1000 of the 8000 requests in this second were allowed.
+    const auto result = lim.allow();
+    REQUIRE(!result.allowed);
+    REQUIRE(result.effective_rate.value() ==
+            Approx((9.0 + 1000.0 / 8001.0) / 10.0));
+  }
 }
@@ -0,0 +1,172 @@
+// These are tests for `MemoryBudget`, which accounts for the memory that a
+// tracer holds in trace data, and for how the tracer degrades as that memory
+// approaches `TracerConfig::max_memory_bytes`.
+
+#include <datadog/memory_budget.h>
+#include <datadog/runtime_stats.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/span.h>
+#include <datadog/span_data.h>
+#include <datadog/tags.h>
+#include <datadog/trace_segment.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "mocks/collectors.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/http_clients.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_MEMORY_BUDGET(x) TEST_CASE(x, "[memory_budget]")
+
+TEST_MEMORY_BUDGET("pressure increases with the memory accounted for") {
+  MemoryBudget budget{1000};
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::NONE);
+  budget.charge(499);
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::NONE);
+  budget.charge(1);
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::SHED_SAMPLED_OUT);
+  budget.charge(250);
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::TRUNCATE);
+  budget.charge(250);
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::DROP);
+  REQUIRE(budget.used() == 1000);
+  budget.release(1000);
+  REQUIRE(budget.pressure() == MemoryBudget::Pressure::NONE);
+}
+
+TEST_MEMORY_BUDGET("charges are released when they are destroyed") {
+  const auto budget = std::make_shared<MemoryBudget>(1000);
+  {
+    MemoryBudget::Charge charge{budget, 100};
+    REQUIRE(budget->used() == 100);
+
+    MemoryBudget::Charge moved{std::move(charge)};
+    REQUIRE(budget->used() == 100);
+
+    MemoryBudget::Charge other{budget, 10};
+    REQUIRE(budget->used() == 110);
+    other = std::move(moved);
+    REQUIRE(budget->used() == 100);
+
+    // A charge without a budget counts nothing.
+    MemoryBudget::Charge unlimited{nullptr, 1000};
+  }
+  REQUIRE(budget->used() == 0);
+}
+
+TEST_MEMORY_BUDGET("trace segments degrade as the budget is approached") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.max_memory_bytes = 4096;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto held = tracer.create_span();
+    auto filler = tracer.create_span();
+    {
+      auto large = held.create_child();
+      large.set_tag("large", std::string(3200, 'x'));
+    }
+    // The finished child is held until its segment finishes.
+    REQUIRE(tracer.runtime_stats().memory_bytes >= 3200);
+    REQUIRE(held.trace_segment().skips_new_spans());
+    REQUIRE(collector->chunks.empty());
+
+    SECTION("chunks dropped by sampling are not sent") {
+      {
+        auto dropped = tracer.create_span();
+        dropped.trace_segment().override_sampling_priority(
+            SamplingPriority::USER_DROP);
+      }
+      REQUIRE(collector->chunks.empty());
+      { auto kept = tracer.create_span(); }
+      REQUIRE(collector->chunks.size() == 1);
+    }
+
+    SECTION("new segments are truncated") {
+      {
+        auto truncated = tracer.create_span();
+        REQUIRE(truncated.trace_segment().skips_new_spans());
+        auto child = truncated.create_child();
+      }
+      REQUIRE(collector->span_count() == 1);
+      REQUIRE(collector->first_span().tags.at(
+                  tags::internal::trace_truncated) == "memory");
+    }
+
+    SECTION("no chunks are sent at the limit") {
+      {
+        auto more = filler.create_child();
+        more.set_tag("large", std::string(1024, 'x'));
+      }
+      REQUIRE(tracer.runtime_stats().memory_bytes >= 4096);
+      {
+        auto kept = tracer.create_span();
+        kept.trace_segment().override_sampling_priority(
+            SamplingPriority::USER_KEEP);
+      }
+      REQUIRE(collector->chunks.empty());
+    }
+  }
+
+  // The held segment is sent once it finishes, and its memory is released.
+  REQUIRE(tracer.runtime_stats().memory_bytes == 0);
+  REQUIRE(!collector->chunks.empty());
+  const auto& held_root = *collector->chunks.back().front();
+  REQUIRE(held_root.tags.at(tags::internal::trace_truncated) == "memory");
+}
+
+TEST_MEMORY_BUDGET("buffered chunks and payloads count against the budget") {
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = std::make_shared<MockLogger>();
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.agent.flush_threshold_bytes = 1 << 20;
+  config.telemetry.enabled = false;
+  config.max_memory_bytes = 1 << 20;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto span = tracer.create_span();
+    span.set_tag("large", std::string(1024, 'x'));
+  }
+  auto stats = tracer.runtime_stats();
+  REQUIRE(stats.memory_bytes == stats.buffered_bytes);
+  REQUIRE(stats.memory_bytes >= 1024);
+
+  // The payload is counted until the HTTP client is done with it.
+  event_scheduler->event_callback();
+  stats = tracer.runtime_stats();
+  REQUIRE(stats.buffered_bytes == 0);
+  REQUIRE(stats.memory_bytes > 0);
+
+  // `MockHTTPClient` keeps the callbacks of its last request, which hold the
+  // payload, until they are released.
+  http_client->drain(std::chrono::steady_clock::time_point::max());
+  http_client->on_response_ = nullptr;
+  http_client->on_error_ = nullptr;
+  REQUIRE(tracer.runtime_stats().memory_bytes == 0);
+}
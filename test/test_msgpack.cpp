@@ -2,8 +2,12 @@
 #include <datadog/msgpack.h>
 
 #include <cstdint>
+#include <datadog/json.hpp>
+#include <limits>
+#include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "test.h"
 
@@ -55,6 +59,147 @@ TEST_CASE("map element fails to encode") {
   }
 }
 
+TEST_CASE("integers are encoded in their narrowest form") {
+  struct TestCase {
+    int line;
+    std::int64_t value;
+    std::size_t expected_size;
+  };
+
+  auto test_case = GENERATE(values<TestCase>({
+      {__LINE__, 0, 1},
+      {__LINE__, 127, 1},
+      {__LINE__, 128, 2},
+      {__LINE__, 255, 2},
+      {__LINE__, 256, 3},
+      {__LINE__, 65535, 3},
+      {__LINE__, 65536, 5},
+      {__LINE__, 4294967295, 5},
+      {__LINE__, 4294967296, 9},
+      {__LINE__, std::numeric_limits<std::int64_t>::max(), 9},
+      {__LINE__, -1, 1},
+      {__LINE__, -32, 1},
+      {__LINE__, -33, 2},
+      {__LINE__, -128, 2},
+      {__LINE__, -129, 3},
+      {__LINE__, -32768, 3},
+      {__LINE__, -32769, 5},
+      {__LINE__, std::numeric_limits<std::int32_t>::min(), 5},
+      {__LINE__, std::int64_t(std::numeric_limits<std::int32_t>::min()) - 1, 9},
+      {__LINE__, std::numeric_limits<std::int64_t>::min(), 9},
+  }));
+
+  CAPTURE(test_case.line);
+  CAPTURE(test_case.value);
+  std::string destination;
+  msgpack::pack_integer(destination, test_case.value);
+  REQUIRE(destination.size() == test_case.expected_size);
+  REQUIRE(nlohmann::json::from_msgpack(destination) == test_case.value);
+
+  if (test_case.value >= 0) {
+    destination.clear();
+    msgpack::pack_integer(destination, std::uint64_t(test_case.value));
+    REQUIRE(destination.size() == test_case.expected_size);
+    REQUIRE(nlohmann::json::from_msgpack(destination) ==
+            std::uint64_t(test_case.value));
+  }
+}
+
+TEST_CASE("integral numbers are encoded as integers") {
+  struct TestCase {
+    int line;
+    double value;
+    bool is_integer;
+    std::size_t expected_size;
+  };
+
+  auto test_case = GENERATE(values<TestCase>({
+      {__LINE__, 0.0, true, 1},
+      {__LINE__, 2.0, true, 1},
+      {__LINE__, -1.0, true, 1},
+      {__LINE__, 404.0, true, 3},
+      {__LINE__, 1.7e18, true, 9},
+      {__LINE__, -9223372036854775808.0, true, 9},
+      {__LINE__, 0.5, false, 9},
+      {__LINE__, -2.25, false, 9},
+      {__LINE__, 9223372036854775808.0, false, 9},
+      {__LINE__, 1e300, false, 9},
+      {__LINE__, std::numeric_limits<double>::infinity(), false, 9},
+  }));
+
+  CAPTURE(test_case.line);
+  CAPTURE(test_case.value);
+  std::string destination;
+  msgpack::pack_number(destination, test_case.value);
+  REQUIRE(destination.size() == test_case.expected_size);
+  const auto decoded = nlohmann::json::from_msgpack(destination);
+  REQUIRE(decoded.is_number_integer() == test_case.is_integer);
+  REQUIRE(decoded.get<double>() == test_case.value);
+}
+
+TEST_CASE("sizes are encoded in their narrowest form") {
+  struct TestCase {
+    int line;
+    std::size_t size;
+    std::size_t expected_string_header;
+    std::size_t expected_container_header;
+  };
+
+  auto test_case = GENERATE(values<TestCase>({
+      {__LINE__, 0, 1, 1},
+      {__LINE__, 15, 1, 1},
+      {__LINE__, 16, 1, 3},
+      {__LINE__, 31, 1, 3},
+      {__LINE__, 32, 2, 3},
+      {__LINE__, 255, 2, 3},
+      {__LINE__, 256, 3, 3},
+      {__LINE__, 65535, 3, 3},
+      {__LINE__, 65536, 5, 5},
+  }));
+
+  CAPTURE(test_case.line);
+  CAPTURE(test_case.size);
+  const std::string value(test_case.size, 'x');
+
+  std::string destination;
+  REQUIRE(msgpack::pack_string(destination, value));
+  REQUIRE(destination.size() ==
+          test_case.expected_string_header + value.size());
+  REQUIRE(nlohmann::json::from_msgpack(destination) == value);
+
+  destination.clear();
+  REQUIRE(msgpack::pack_binary(destination, value));
+  const auto binary = nlohmann::json::from_msgpack(destination);
+  REQUIRE(binary.is_binary());
+  REQUIRE(binary.get_binary().size() == value.size());
+
+  const std::vector<int> elements(test_case.size, 1);
+  destination.clear();
+  REQUIRE(msgpack::pack_array(destination, elements,
+                              [](std::string& destination, int element) {
+                                msgpack::pack_integer(destination, element);
+                                return Expected<void>{};
+                              }));
+  REQUIRE(destination.size() ==
+          test_case.expected_container_header + elements.size());
+  REQUIRE(nlohmann::json::from_msgpack(destination).size() == elements.size());
+
+  std::map<std::string, int> pairs;
+  for (std::size_t i = 0; i < test_case.size; ++i) {
+    pairs.emplace(std::to_string(i), 1);
+  }
+  destination.clear();
+  REQUIRE(msgpack::pack_map(destination, pairs,
+                            [](std::string& destination, int value) {
+                              msgpack::pack_integer(destination, value);
+                              return Expected<void>{};
+                            }));
+  REQUIRE(nlohmann::json::from_msgpack(destination).size() == pairs.size());
+  std::string header;
+  REQUIRE(msgpack::pack_map(header, pairs.size()));
+  REQUIRE(header.size() == test_case.expected_container_header);
+}
+
 // The following group of tests verify that encoding routines return an error
 // if the size of their input cannot fit in 32 bits.
 // This is impossible to do on a 32-bit system, so these tests are excluded by
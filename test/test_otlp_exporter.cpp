@@ -0,0 +1,280 @@
+// These are tests for `OtlpExporter`, which sends traces to an OpenTelemetry
+// collector as OTLP protobuf, and for the protobuf encoder that it uses.  The
+// tests decode requests with a minimal protobuf reader (see
+// `common/protobuf.h`).
+
+#include <datadog/error.h>
+#include <datadog/otlp_exporter.h>
+#include <datadog/otlp_exporter_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "common/environment.h"
+#include "common/protobuf.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/http_clients.h"
+#include "mocks/loggers.h"
+#include "protobuf.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using datadog::test::EnvGuard;
+using namespace datadog::test::protobuf;
+
+#define OTLP_EXPORTER_TEST(x) TEST_CASE(x, "[otlp_exporter]")
+
+namespace {
+
+// Return the string values of the `KeyValue` fields of the specified
+// `message` having the specified field `number`, by key.
+std::unordered_map<std::string, std::string> attributes(
+    const std::string& message, std::uint32_t number) {
+  std::unordered_map<std::string, std::string> result;
+  for (const Field& key_value : fields(message, number)) {
+    const std::string key = only(key_value.bytes, 1);
+    const auto values = decode(only(key_value.bytes, 2));
+    REQUIRE(values.size() == 1);
+    if (values.front().number == 1) {
+      result.emplace(key, values.front().bytes);
+    } else {
+      double number;
+      std::memcpy(&number, &values.front().integer, sizeof number);
+      result.emplace(key, std::to_string(number));
+    }
+  }
+  return result;
+}
+
+std::string big_endian(std::uint64_t value) {
+  std::string result;
+  for (int i = 7; i >= 0; --i) {
+    result += char((value >> (8 * i)) & 0xFF);
+  }
+  return result;
+}
+
+TracerConfig otlp_tracer_config(
+    const std::shared_ptr<MockLogger>& logger,
+    const std::shared_ptr<MockEventScheduler>& event_scheduler,
+    const std::shared_ptr<MockHTTPClient>& http_client) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.environment = "dev";
+  config.logger = logger;
+  config.otlp.enabled = true;
+  config.otlp.event_scheduler = event_scheduler;
+  config.otlp.http_client = http_client;
+  config.telemetry.enabled = false;
+  return config;
+}
+
+}  // namespace
+
+OTLP_EXPORTER_TEST("message lengths are written once the contents are known") {
+  std::string short_message;
+  auto position = protobuf::begin_message(short_message, 1);
+  protobuf::pack_string(short_message, 2, "hi");
+  protobuf::end_message(short_message, position);
+  REQUIRE(short_message == std::string("\x0A\x04\x12\x02hi", 6));
+
+  std::string long_message;
+  position = protobuf::begin_message(long_message, 15);
+  protobuf::pack_string(long_message, 1, std::string(200, 'x'));
+  protobuf::end_message(long_message, position);
+  // 15 << 3 | 2 is one byte, and 203 is two.
+  REQUIRE(long_message.size() == 1 + 2 + 203);
+  const auto decoded = decode(long_message);
+  REQUIRE(decoded.size() == 1);
+  REQUIRE(decoded.front().number == 15);
+  REQUIRE(only(decoded.front().bytes, 1) == std::string(200, 'x'));
+}
+
+OTLP_EXPORTER_TEST("spans are grouped by resource") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = otlp_tracer_config(logger, event_scheduler, http_client);
+  config.otlp.headers.emplace("Authorization", "Bearer token");
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  REQUIRE(std::holds_alternative<FinalizedOtlpExporterConfig>(
+      finalized->collector));
+
+  std::uint64_t root_id = 0;
+  std::uint64_t child_id = 0;
+  TraceID trace_id;
+  {
+    http_client->response_status = 200;
+    Tracer tracer{*finalized};
+    {
+      SpanConfig root_config;
+      root_config.name = "first";
+      root_config.resource = "GET /users";
+      auto root = tracer.create_span(root_config);
+      root_id = root.id();
+      trace_id = root.trace_id();
+      auto child = root.create_child();
+      child_id = child.id();
+    }
+    {
+      SpanConfig root_config;
+      root_config.name = "second";
+      auto root = tracer.create_span(root_config);
+    }
+    {
+      SpanConfig root_config;
+      root_config.service = "other";
+      auto root = tracer.create_span(root_config);
+    }
+    REQUIRE(http_client->request_body.empty());
+  }
+
+  REQUIRE(logger->error_count() == 0);
+  REQUIRE(http_client->request_url.scheme == "http");
+  REQUIRE(http_client->request_url.authority == "localhost:4318");
+  REQUIRE(http_client->request_url.path == "/v1/traces");
+  const auto& headers = http_client->request_headers.items;
+  REQUIRE(headers.at("Content-Type") == "application/x-protobuf");
+  REQUIRE(headers.at("Authorization") == "Bearer token");
+
+  const auto resource_spans = fields(http_client->request_body, 1);
+  REQUIRE(resource_spans.size() == 2);
+
+  const auto& testsvc = resource_spans[0].bytes;
+  auto resource = attributes(only(testsvc, 1), 1);
+  REQUIRE(resource.at("service.name") == "testsvc");
+  REQUIRE(resource.at("deployment.environment") == "dev");
+  REQUIRE(resource.at("telemetry.sdk.language") == "cpp");
+  REQUIRE(resource.count("runtime-id") == 1);
+  REQUIRE(resource.count("process_id") == 1);
+
+  const auto scope_spans = only(testsvc, 2);
+  REQUIRE(only(only(scope_spans, 1), 1) == "dd-trace-cpp");
+  const auto spans = fields(scope_spans, 2);
+  // The spans of both traces share their resource.
+  REQUIRE(spans.size() == 3);
+
+  const auto& root = spans[0].bytes;
+  REQUIRE(only(root, 1) ==
+          big_endian(trace_id.high) + big_endian(trace_id.low));
+  REQUIRE(only(root, 2) == big_endian(root_id));
+  REQUIRE(fields(root, 4).empty());
+  REQUIRE(only(root, 5) == "first");
+  const auto start = fields(root, 7);
+  const auto end = fields(root, 8);
+  REQUIRE(start.size() == 1);
+  REQUIRE(end.size() == 1);
+  REQUIRE(end.front().integer >= start.front().integer);
+  auto span_attributes = attributes(root, 9);
+  REQUIRE(span_attributes.at("resource.name") == "GET /users");
+  // The environment is an attribute of the resource only.
+  REQUIRE(span_attributes.count("env") == 0);
+  REQUIRE(span_attributes.count("runtime-id") == 0);
+  REQUIRE(fields(root, 15).empty());
+
+  const auto& child = spans[1].bytes;
+  REQUIRE(only(child, 2) == big_endian(child_id));
+  REQUIRE(only(child, 4) == big_endian(root_id));
+
+  REQUIRE(only(spans[2].bytes, 5) == "second");
+
+  const auto& other = resource_spans[1].bytes;
+  REQUIRE(attributes(only(other, 1), 1).at("service.name") == "other");
+  REQUIRE(fields(only(other, 2), 2).size() == 1);
+}
+
+OTLP_EXPORTER_TEST("span kinds and errors") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = otlp_tracer_config(logger, event_scheduler, http_client);
+  config.otlp.flush_threshold_bytes = 1;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  http_client->response_status = 200;
+  Tracer tracer{*finalized};
+  {
+    auto span = tracer.create_span();
+    span.set_tag("span.kind", "server");
+    span.set_error_message("oops");
+  }
+
+  // The batch is large enough to send immediately.
+  const auto span = only(only(only(http_client->request_body, 1), 2), 2);
+  const auto kind = fields(span, 6);
+  REQUIRE(kind.size() == 1);
+  REQUIRE(kind.front().integer == 2);
+  const auto status = only(span, 15);
+  REQUIRE(only(status, 2) == "oops");
+  const auto code = fields(status, 3);
+  REQUIRE(code.size() == 1);
+  REQUIRE(code.front().integer == 2);
+
+  // The flush interval sends nothing if nothing is buffered.
+  http_client->clear();
+  REQUIRE(event_scheduler->event_callback);
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.empty());
+}
+
+OTLP_EXPORTER_TEST("OtlpExporter configuration") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  auto config = otlp_tracer_config(logger, event_scheduler, http_client);
+
+  SECTION("the environment overrides the url") {
+    config.otlp.url = "http://ignored:4318/v1/traces";
+    EnvGuard guard{"OTEL_EXPORTER_OTLP_TRACES_ENDPOINT",
+                   "https://collector.example.com/traces"};
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    const auto& otlp =
+        std::get<FinalizedOtlpExporterConfig>(finalized->collector);
+    REQUIRE(otlp.url.scheme == "https");
+    REQUIRE(otlp.url.authority == "collector.example.com");
+    REQUIRE(otlp.url.path == "/traces");
+  }
+
+  SECTION("the intake takes precedence") {
+    config.intake.enabled = true;
+    config.intake.api_key = "secret";
+    config.intake.http_client = http_client;
+    config.intake.event_scheduler = event_scheduler;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    REQUIRE(std::holds_alternative<FinalizedDatadogIntakeConfig>(
+        finalized->collector));
+  }
+
+  SECTION("intervals must be positive") {
+    config.otlp.flush_interval_milliseconds = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::OTLP_EXPORTER_INVALID_INTERVAL);
+  }
+
+  SECTION("the flush threshold must be at most the maximum buffered bytes") {
+    config.otlp.flush_threshold_bytes = 2;
+    config.otlp.max_buffered_bytes = 1;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::OTLP_EXPORTER_INVALID_BUFFER_LIMITS);
+  }
+}
@@ -0,0 +1,149 @@
+// These are tests for `OverheadGovernor`, which keeps the CPU time that the
+// tracer spends on its own work within `TracerConfig::max_cpu_overhead`, and
+// for how `TraceSampler` drops traces to do so.
+
+#include <datadog/clock.h>
+#include <datadog/error.h>
+#include <datadog/rate.h>
+#include <datadog/runtime_stats.h>
+#include <datadog/sampling_decision.h>
+#include <datadog/sampling_mechanism.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/span_data.h>
+#include <datadog/trace_sampler.h>
+#include <datadog/trace_sampler_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include "mocks/collectors.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/loggers.h"
+#include "overhead_governor.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define TEST_OVERHEAD_GOVERNOR(x) TEST_CASE(x, "[overhead_governor]")
+
+TEST_OVERHEAD_GOVERNOR("the keep rate follows the share of CPU time") {
+  auto finalized = finalize_config(TraceSamplerConfig{});
+  REQUIRE(finalized);
+  const auto sampler =
+      std::make_shared<TraceSampler>(*finalized, default_clock);
+  MockEventScheduler event_scheduler;
+  std::chrono::nanoseconds process_cpu_time = 1s;
+
+  {
+    OverheadGovernor governor{0.1, sampler, event_scheduler,
+                              [&]() { return process_cpu_time; }};
+    REQUIRE(event_scheduler.recurrence_interval == 1s);
+    REQUIRE(sampler->overhead_keep_rate() == 1.0);
+
+    // 40% is four times the budget.
+    OverheadGovernor::add_cost(400ms);
+    process_cpu_time += 1s;
+    event_scheduler.event_callback();
+    REQUIRE(sampler->overhead_keep_rate() == Approx(0.25));
+
+    // Within the budget, but not by half, the keep rate stays.
+    OverheadGovernor::add_cost(80ms);
+    process_cpu_time += 1s;
+    event_scheduler.event_callback();
+    REQUIRE(sampler->overhead_keep_rate() == Approx(0.25));
+
+    // An idle process changes nothing.
+    event_scheduler.event_callback();
+    REQUIRE(sampler->overhead_keep_rate() == Approx(0.25));
+
+    // Well within the budget, the keep rate doubles, up to one.
+    OverheadGovernor::add_cost(10ms);
+    process_cpu_time += 1s;
+    event_scheduler.event_callback();
+    REQUIRE(sampler->overhead_keep_rate() == Approx(0.5));
+    for (int i = 0; i < 3; ++i) {
+      process_cpu_time += 1s;
+      event_scheduler.event_callback();
+    }
+    REQUIRE(sampler->overhead_keep_rate() == 1.0);
+
+    // However far over the budget, some traces are kept.
+    OverheadGovernor::add_cost(1s);
+    process_cpu_time += 1ms;
+    event_scheduler.event_callback();
+    REQUIRE(sampler->overhead_keep_rate() ==
+            Approx(OverheadGovernor::min_keep_rate));
+  }
+  REQUIRE(event_scheduler.cancelled);
+}
+
+TEST_OVERHEAD_GOVERNOR("the trace sampler keeps a share of its kept traces") {
+  TraceSamplerConfig config;
+  config.max_per_second = 1e9;
+  const bool use_rule = GENERATE(false, true);
+  if (use_rule) {
+    TraceSamplerConfig::Rule rule;
+    rule.sample_rate = 0.5;
+    config.rules.push_back(rule);
+  }
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  TraceSampler sampler{*finalized, default_clock};
+  sampler.set_overhead_keep_rate(*Rate::from(0.5));
+
+  const double rate = use_rule ? 0.25 : 0.5;
+  const int keep = use_rule ? int(SamplingPriority::USER_KEEP)
+                            : int(SamplingPriority::AUTO_KEEP);
+  const int num_traces = 10'000;
+  int kept = 0;
+  int regulated = 0;
+  SpanData span;
+  span.service = "testsvc";
+  for (int i = 1; i <= num_traces; ++i) {
+    span.trace_id.low = std::uint64_t(i);
+    const auto decision = sampler.decide(span);
+    REQUIRE(decision.configured_rate);
+    REQUIRE(decision.configured_rate->value() == Approx(rate));
+    if (decision.priority == keep) {
+      ++kept;
+    } else if (decision.overhead_regulated) {
+      // The decision keeps the mechanism of the rate that it was made by.
+      REQUIRE(decision.mechanism == int(use_rule ? SamplingMechanism::RULE
+                                                 : SamplingMechanism::DEFAULT));
+      ++regulated;
+    }
+  }
+  // Of the traces kept by their configured rate, half are dropped.
+  REQUIRE(double(kept) / num_traces == Approx(rate).margin(0.02));
+  REQUIRE(double(regulated) / num_traces == Approx(rate).margin(0.02));
+}
+
+TEST_OVERHEAD_GOVERNOR("tracer regulates its overhead if configured") {
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  config.event_scheduler = event_scheduler;
+  config.max_cpu_overhead = 0.05;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  REQUIRE(event_scheduler->event_callback);
+  REQUIRE(tracer.runtime_stats().overhead_keep_rate == 1.0);
+}
+
+TEST_OVERHEAD_GOVERNOR("invalid maximum CPU overhead") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.max_cpu_overhead = GENERATE(
+      -0.1, 1.5, std::nan(""), std::numeric_limits<double>::infinity());
+  auto finalized = finalize_config(config);
+  REQUIRE(!finalized);
+  REQUIRE(finalized.error().code == Error::TRACER_INVALID_MAX_CPU_OVERHEAD);
+}
@@ -0,0 +1,69 @@
+#include <datadog/pool_allocator.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define POOL_ALLOCATOR_TEST(x) TEST_CASE(x, "[pool_allocator]")
+
+namespace {
+
+struct Pooled {
+  std::string name;
+  std::vector<int> values;
+};
+
+}  // namespace
+
+POOL_ALLOCATOR_TEST("freed objects are reused by the same thread") {
+  PoolAllocator<Pooled> allocator;
+  Pooled* const first = allocator.allocate(1);
+  allocator.deallocate(first, 1);
+  Pooled* const second = allocator.allocate(1);
+  REQUIRE(second == first);
+  allocator.deallocate(second, 1);
+
+  // The control block of a `shared_ptr` is allocated together with the
+  // object, and is reused as well.
+  const void* address;
+  {
+    const auto object = std::allocate_shared<Pooled>(allocator);
+    address = object.get();
+  }
+  const auto object = std::allocate_shared<Pooled>(allocator);
+  REQUIRE(object.get() == address);
+}
+
+POOL_ALLOCATOR_TEST("a thread keeps a bounded number of freed objects") {
+  PoolAllocator<Pooled> allocator;
+  std::vector<Pooled*> objects;
+  for (std::size_t i = 0; i < 2 * pool_allocator_capacity; ++i) {
+    objects.push_back(allocator.allocate(1));
+  }
+  const std::set<Pooled*> allocated(objects.begin(), objects.end());
+  for (Pooled* const object : objects) {
+    allocator.deallocate(object, 1);
+  }
+
+  // Only the last `pool_allocator_capacity` objects freed were kept, and they
+  // are reused most recently freed first.
+  std::vector<Pooled*> reused;
+  for (std::size_t i = 0; i < pool_allocator_capacity; ++i) {
+    reused.push_back(allocator.allocate(1));
+  }
+  REQUIRE(reused.front() == objects[pool_allocator_capacity - 1]);
+  for (Pooled* const object : reused) {
+    REQUIRE(allocated.count(object) == 1);
+    allocator.deallocate(object, 1);
+  }
+
+  // Arrays are not pooled.
+  Pooled* const array = allocator.allocate(2);
+  REQUIRE(allocated.count(array) == 0);
+  allocator.deallocate(array, 2);
+}
@@ -0,0 +1,48 @@
+#include <datadog/process_info.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define PROCESS_INFO_TEST(x) TEST_CASE(x, "[process_info]")
+
+PROCESS_INFO_TEST("process info is discovered once per process") {
+  const ProcessInfo& info = process_info();
+  REQUIRE(&process_info() == &info);
+
+  REQUIRE(info.entrypoint_name == get_process_name());
+  REQUIRE(info.entrypoint_workdir ==
+          std::filesystem::current_path().filename().string());
+  REQUIRE(info.entrypoint_basedir);
+  REQUIRE(*info.entrypoint_basedir ==
+          get_process_path()->parent_path().filename().string());
+  const auto container_id = container::get_id();
+  REQUIRE(info.container_id.has_value() == container_id.has_value());
+  if (container_id) {
+    REQUIRE(info.container_id->value == container_id->value);
+  }
+}
+
+PROCESS_INFO_TEST("forked processes discover process info again") {
+  const ProcessInfo* parent_info = &process_info();
+
+  const pid_t child = ::fork();
+  REQUIRE(child != -1);
+  if (child == 0) {
+    const ProcessInfo& info = process_info();
+    const bool rediscovered = &info != parent_info;
+    const bool cached = &process_info() == &info;
+    ::_exit(rediscovered && cached ? 0 : 1);
+  }
+
+  int status = 0;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+  REQUIRE(&process_info() == parent_info);
+}
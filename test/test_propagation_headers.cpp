@@ -0,0 +1,101 @@
+#include <datadog/propagation_headers.h>
+
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mocks/dict_readers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define PROPAGATION_HEADERS_TEST(x) TEST_CASE(x, "[propagation_headers]")
+
+PROPAGATION_HEADERS_TEST("every propagation header name is found") {
+  for (std::size_t i = 0; i < PropagationHeaders::count; ++i) {
+    const auto name = PropagationHeaders::names[i];
+    CAPTURE(name);
+    REQUIRE(PropagationHeaders::find(name) == i);
+
+    std::string upper{name};
+    for (char& c : upper) {
+      c = char(std::toupper(static_cast<unsigned char>(c)));
+    }
+    REQUIRE(PropagationHeaders::find(upper) == i);
+  }
+
+  const auto other = GENERATE(as<StringView>{}, "", "baggage", "x-b3-parent",
+                              "x-b3-flags", "traceparenT2", "x-datadog-tag",
+                              "content-type", "x-datadog-trace-ix");
+  CAPTURE(other);
+  REQUIRE(PropagationHeaders::find(other) == PropagationHeaders::count);
+}
+
+PROPAGATION_HEADERS_TEST("propagation headers are read in one visit") {
+  const std::unordered_map<std::string, std::string> map{
+      {"X-Datadog-Trace-Id", "123"},
+      {"traceparent", "00-0000000000000000000000000000007b-01-01"},
+      {"content-type", "text/plain"}};
+  const MockDictReader underlying{map};
+  PropagationHeaders headers{underlying};
+
+  REQUIRE(headers.examined() == 0);
+  REQUIRE(headers.lookup("x-datadog-trace-id") == StringView("123"));
+  REQUIRE(headers.lookup("x-datadog-parent-id") == nullopt);
+  // Other headers are looked up in the underlying reader, and not remembered.
+  REQUIRE(headers.lookup("content-type") == StringView("text/plain"));
+  REQUIRE(headers.lookup("TraceParent") ==
+          StringView("00-0000000000000000000000000000007b-01-01"));
+
+  const std::vector<std::pair<std::string, std::string>> expected{
+      {"x-datadog-trace-id", "123"},
+      {"traceparent", "00-0000000000000000000000000000007b-01-01"}};
+  REQUIRE(headers.entries(headers.examined()) == expected);
+
+  headers.clear_examined();
+  REQUIRE(headers.entries(headers.examined()).empty());
+}
+
+PROPAGATION_HEADERS_TEST("a reader that prefers lookups is not visited") {
+  // `LookupReader` counts its lookups, and fails if it is visited.
+  struct LookupReader : public MockDictReader {
+    mutable std::vector<std::string> keys;
+
+    using MockDictReader::MockDictReader;
+    Optional<StringView> lookup(StringView key) const override {
+      keys.emplace_back(key);
+      return MockDictReader::lookup(key);
+    }
+    void visit(const std::function<void(StringView, StringView)>&)
+        const override {
+      FAIL("visited");
+    }
+    bool prefers_visit() const override { return false; }
+  };
+
+  const std::unordered_map<std::string, std::string> map{
+      {"x-datadog-trace-id", "123"}, {"content-type", "text/plain"}};
+  const LookupReader underlying{map};
+  PropagationHeaders headers{underlying};
+  REQUIRE(underlying.keys.empty());
+
+  // Each propagation header is looked up once, when first needed.
+  REQUIRE(headers.lookup("X-Datadog-Trace-Id") == StringView("123"));
+  REQUIRE(headers.lookup("x-datadog-trace-id") == StringView("123"));
+  REQUIRE(headers.lookup("x-datadog-origin") == nullopt);
+  REQUIRE(headers.lookup("x-datadog-origin") == nullopt);
+  REQUIRE(underlying.keys ==
+          std::vector<std::string>{"x-datadog-trace-id", "x-datadog-origin"});
+
+  std::vector<std::string> visited;
+  headers.visit(
+      [&](StringView key, StringView) { visited.emplace_back(key); });
+  REQUIRE(visited == std::vector<std::string>{"x-datadog-trace-id"});
+  REQUIRE(underlying.keys.size() == PropagationHeaders::count);
+
+  const std::vector<std::pair<std::string, std::string>> expected{
+      {"x-datadog-trace-id", "123"}};
+  REQUIRE(headers.entries(headers.examined()) == expected);
+}
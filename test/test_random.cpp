@@ -0,0 +1,43 @@
+#include <datadog/id_generator.h>
+#include <datadog/random.h>
+
+#include <cstdint>
+#include <set>
+#include <thread>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define RANDOM_TEST(x) TEST_CASE(x, "[random]")
+
+RANDOM_TEST("random_uint64 uses all of the bits") {
+  std::set<std::uint64_t> values;
+  std::uint64_t any_set = 0;
+  std::uint64_t all_set = ~std::uint64_t(0);
+  for (int i = 0; i < 1000; ++i) {
+    const auto value = random_uint64();
+    values.insert(value);
+    any_set |= value;
+    all_set &= value;
+  }
+  CHECK(values.size() == 1000);
+  CHECK(any_set == ~std::uint64_t(0));
+  CHECK(all_set == 0);
+}
+
+RANDOM_TEST("threads have independent sequences") {
+  std::uint64_t other_value = 0;
+  std::thread other([&]() { other_value = random_uint64(); });
+  const auto value = random_uint64();
+  other.join();
+  CHECK(value != other_value);
+}
+
+RANDOM_TEST("64-bit IDs do not use the most significant bit") {
+  const auto generator = default_id_generator(false);
+  for (int i = 0; i < 1000; ++i) {
+    CHECK(generator->span_id() >> 63 == 0);
+    CHECK(generator->trace_id(default_clock()).low >> 63 == 0);
+  }
+}
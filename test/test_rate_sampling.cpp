@@ -0,0 +1,64 @@
+// This test covers `keep_at_rate`, defined in `rate_sampling.h`.
+
+#include <datadog/rate_sampling.h>
+#include <datadog/sampling_util.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define RATE_SAMPLING_TEST(x) TEST_CASE(x, "[rate_sampling]")
+
+namespace {
+
+std::vector<std::uint64_t> make_ids(std::size_t count) {
+  std::vector<std::uint64_t> ids;
+  std::uint64_t state = 42;
+  for (std::size_t i = 0; i < count; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    ids.push_back(state);
+  }
+  return ids;
+}
+
+}  // namespace
+
+RATE_SAMPLING_TEST("batch decisions agree with the trace sampler's") {
+  const double rate = GENERATE(0.0, 0.001, 0.25, 0.5, 0.999, 1.0);
+  CAPTURE(rate);
+  const auto ids = make_ids(1000);
+  std::vector<TraceID> trace_ids;
+  for (const auto id : ids) {
+    trace_ids.emplace_back(id, ~id);
+  }
+
+  const auto keep = std::make_unique<bool[]>(ids.size());
+  const auto keep_traces = std::make_unique<bool[]>(ids.size());
+  const std::size_t kept =
+      keep_at_rate(ids.data(), ids.size(), *Rate::from(rate), keep.get());
+  REQUIRE(keep_at_rate(trace_ids.data(), trace_ids.size(), *Rate::from(rate),
+                       keep_traces.get()) == kept);
+
+  const std::uint64_t threshold = max_id_from_rate(*Rate::from(rate));
+  std::size_t expected_kept = 0;
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    const bool expected = knuth_hash(ids[i]) <= threshold;
+    expected_kept += expected;
+    REQUIRE(keep[i] == expected);
+    REQUIRE(keep_traces[i] == expected);
+  }
+  REQUIRE(kept == expected_kept);
+  if (rate == 1.0) {
+    REQUIRE(kept == ids.size());
+  }
+}
+
+RATE_SAMPLING_TEST("no trace IDs") {
+  REQUIRE(keep_at_rate(static_cast<const std::uint64_t*>(nullptr), 0,
+                       Rate::one(), nullptr) == 0);
+}
@@ -0,0 +1,225 @@
+// These are tests for `RecordingCollector`, which appends the trace payloads
+// that a `DatadogAgent` would send to a capture file.  The tests read the
+// payloads back from the file.
+
+#include <datadog/capture_file.h>
+#include <datadog/error.h>
+#include <datadog/json.hpp>
+#include <datadog/recording_collector_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "mocks/event_schedulers.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define RECORDING_COLLECTOR_TEST(x) TEST_CASE(x, "[recording_collector]")
+
+namespace {
+
+// A path for a capture file that is removed when the `TemporaryPath` is
+// destroyed.
+class TemporaryPath {
+  std::filesystem::path path_;
+
+ public:
+  TemporaryPath()
+      : path_(std::filesystem::temp_directory_path() /
+              ("dd-trace-cpp-recording-test-" + std::to_string(::getpid()))) {
+    std::filesystem::remove(path_);
+  }
+  ~TemporaryPath() { std::filesystem::remove(path_); }
+
+  std::string string() const { return path_.string(); }
+};
+
+TracerConfig recording_tracer_config(
+    const std::shared_ptr<MockLogger>& logger,
+    const std::shared_ptr<MockEventScheduler>& event_scheduler,
+    const std::string& capture_path) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = logger;
+  config.recording.enabled = true;
+  config.recording.capture_path = capture_path;
+  config.recording.event_scheduler = event_scheduler;
+  config.telemetry.enabled = false;
+  return config;
+}
+
+// Return the records of the specified capture `file`.
+std::vector<CaptureFile::Record> read_records(const CaptureFile& file) {
+  std::vector<CaptureFile::Record> records;
+  std::uint64_t position = 0;
+  CaptureFile::Record record;
+  while (file.next(position, record)) {
+    records.push_back(record);
+  }
+  return records;
+}
+
+}  // namespace
+
+RECORDING_COLLECTOR_TEST("each flush records one payload") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const TemporaryPath path;
+  auto config = recording_tracer_config(logger, event_scheduler, path.string());
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  REQUIRE(std::holds_alternative<FinalizedRecordingCollectorConfig>(
+      finalized->collector));
+
+  auto opened = CaptureFile::open(path.string());
+  REQUIRE(opened);
+  const auto& capture = **opened;
+  {
+    Tracer tracer{*finalized};
+    {
+      SpanConfig root_config;
+      root_config.name = "first";
+      auto root = tracer.create_span(root_config);
+      auto child = root.create_child();
+    }
+    {
+      SpanConfig root_config;
+      root_config.name = "second";
+      auto root = tracer.create_span(root_config);
+    }
+
+    // Nothing is recorded until the flush.
+    REQUIRE(capture.size() == 0);
+    REQUIRE(tracer.runtime_stats().buffered_trace_chunks == 2);
+    REQUIRE(event_scheduler->event_callback);
+    event_scheduler->event_callback();
+    REQUIRE(capture.size() == 1);
+    REQUIRE(tracer.runtime_stats().buffered_trace_chunks == 0);
+
+    // An empty flush records nothing.
+    event_scheduler->event_callback();
+    REQUIRE(capture.size() == 1);
+
+    // The chunks buffered when the tracer is destroyed are recorded too.
+    auto root = tracer.create_span();
+  }
+  REQUIRE(event_scheduler->cancelled);
+  REQUIRE(logger->error_count() == 0);
+
+  const auto records = read_records(capture);
+  REQUIRE(records.size() == 2);
+  REQUIRE(records[0].offset <= records[1].offset);
+
+  // Each record is a v0.4 traces payload, as a `DatadogAgent` would send.
+  REQUIRE(records[0].trace_count == 2);
+  const auto first = nlohmann::json::from_msgpack(std::string(records[0].payload));
+  REQUIRE(first.size() == 2);
+  REQUIRE(first[0].size() == 2);
+  REQUIRE(first[0][0]["name"] == "first");
+  REQUIRE(first[0][0]["service"] == "testsvc");
+  REQUIRE(first[1].size() == 1);
+  REQUIRE(first[1][0]["name"] == "second");
+
+  REQUIRE(records[1].trace_count == 1);
+  const auto second = nlohmann::json::from_msgpack(std::string(records[1].payload));
+  REQUIRE(second.size() == 1);
+  REQUIRE(second[0].size() == 1);
+}
+
+RECORDING_COLLECTOR_TEST("payloads are recorded at the flush threshold") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const TemporaryPath path;
+  auto config = recording_tracer_config(logger, event_scheduler, path.string());
+  config.recording.flush_threshold_bytes = 1;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  for (int i = 0; i < 3; ++i) {
+    auto root = tracer.create_span();
+  }
+
+  auto opened = CaptureFile::open(path.string());
+  REQUIRE(opened);
+  const auto records = read_records(**opened);
+  REQUIRE(records.size() == 3);
+  for (const auto& record : records) {
+    REQUIRE(record.trace_count == 1);
+  }
+}
+
+RECORDING_COLLECTOR_TEST("payloads that do not fit are dropped") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const TemporaryPath path;
+  auto config = recording_tracer_config(logger, event_scheduler, path.string());
+  config.recording.capture_bytes = 64;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  for (int i = 0; i < 2; ++i) {
+    {
+      auto root = tracer.create_span();
+      root.set_tag("large", std::string(100, 'x'));
+    }
+    event_scheduler->event_callback();
+  }
+
+  REQUIRE(tracer.runtime_stats().dropped_trace_chunks == 2);
+  // The full capture file is logged only once.
+  REQUIRE(logger->error_count() == 1);
+}
+
+RECORDING_COLLECTOR_TEST("RecordingCollector configuration") {
+  const auto logger =
+      std::make_shared<MockLogger>(std::cerr, MockLogger::ERRORS_ONLY);
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const TemporaryPath path;
+  auto config = recording_tracer_config(logger, event_scheduler, path.string());
+
+  SECTION("the capture path is required") {
+    config.recording.capture_path.reset();
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::RECORDING_COLLECTOR_MISSING_CAPTURE_PATH);
+  }
+
+  SECTION("the flush interval must be positive") {
+    config.recording.flush_interval_milliseconds = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::RECORDING_COLLECTOR_INVALID_INTERVAL);
+  }
+
+  SECTION("the flush threshold must be positive") {
+    config.recording.flush_threshold_bytes = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::RECORDING_COLLECTOR_INVALID_FLUSH_THRESHOLD);
+  }
+
+  SECTION("the capture file must be large enough to hold a record") {
+    config.recording.capture_bytes = 1;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::CAPTURE_FILE_INVALID_CAPACITY);
+  }
+}
@@ -0,0 +1,138 @@
+// These are tests for `ResourceLatencies`, which maintains quantiles of the
+// durations of local root spans for each service and resource.
+
+#include <datadog/resource_latencies.h>
+#include <datadog/runtime_stats.h>
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define TEST_RESOURCE_LATENCIES(x) TEST_CASE(x, "[resource_latencies]")
+
+TEST_RESOURCE_LATENCIES("sketch quantiles are within the relative accuracy") {
+  ResourceLatencies::Sketch sketch;
+  REQUIRE(sketch.quantile(0.5) == 0);
+
+  // 1, 2, ..., 100 milliseconds
+  for (std::uint64_t i = 1; i <= 100; ++i) {
+    sketch.add(i * 1'000'000);
+  }
+  REQUIRE(sketch.count() == 100);
+
+  const auto within = [](std::uint64_t actual, double expected) {
+    const double accuracy = 2 * ResourceLatencies::Sketch::relative_accuracy;
+    return actual <= expected && actual >= expected * (1 - accuracy);
+  };
+  REQUIRE(within(sketch.quantile(0.5), 50'000'000));
+  REQUIRE(within(sketch.quantile(0.99), 99'000'000));
+  REQUIRE(within(sketch.quantile(1), 100'000'000));
+  REQUIRE(within(sketch.quantile(0), 1'000'000));
+}
+
+TEST_RESOURCE_LATENCIES("sketch durations outside of its range") {
+  ResourceLatencies::Sketch sketch;
+  sketch.add(0);
+  sketch.add(ResourceLatencies::Sketch::min_nanoseconds - 1);
+  REQUIRE(sketch.quantile(1) == 0);
+
+  sketch.add(std::uint64_t(-1));
+  REQUIRE(sketch.quantile(1) > 0);
+  REQUIRE(sketch.count() == 3);
+}
+
+TEST_RESOURCE_LATENCIES("sketch counts are halved, favoring recent durations") {
+  ResourceLatencies::Sketch sketch;
+  const std::uint32_t max_count = ResourceLatencies::Sketch::max_count;
+  for (std::uint32_t i = 0; i < max_count; ++i) {
+    sketch.add(1'000'000);
+  }
+  REQUIRE(sketch.count() == max_count / 2);
+
+  // After as many slow durations as remain fast ones, the median is slow.
+  for (std::uint32_t i = 0; i <= max_count / 2; ++i) {
+    sketch.add(1'000'000'000);
+  }
+  REQUIRE(sketch.quantile(0.5) > 500'000'000);
+}
+
+TEST_RESOURCE_LATENCIES("resources are tracked separately") {
+  ResourceLatencies latencies;
+  REQUIRE(!latencies.quantile("svc", "fast", 0.5));
+
+  latencies.add("svc", "fast", 1ms);
+  latencies.add("svc", "slow", 1s);
+  latencies.add("other", "fast", 1s);
+
+  auto fast = latencies.quantile("svc", "fast", 0.5);
+  REQUIRE(fast);
+  REQUIRE(*fast <= 1'000'000);
+  REQUIRE(*fast > 900'000);
+  auto slow = latencies.quantile("svc", "slow", 0.5);
+  REQUIRE(slow);
+  REQUIRE(*slow > 900'000'000);
+  REQUIRE(latencies.quantile("other", "fast", 0.5) == slow);
+}
+
+TEST_RESOURCE_LATENCIES("the least recently added to resource is evicted") {
+  ResourceLatencies latencies;
+  for (std::size_t i = 0; i < ResourceLatencies::max_resources; ++i) {
+    latencies.add("svc", std::to_string(i), 1ms);
+  }
+  // Resource "0" is now more recent than resource "1".
+  latencies.add("svc", "0", 1ms);
+  latencies.add("svc", "new", 1ms);
+
+  REQUIRE(latencies.quantile("svc", "0", 0.5));
+  REQUIRE(!latencies.quantile("svc", "1", 0.5));
+  REQUIRE(latencies.quantile("svc", "new", 0.5));
+
+  RuntimeStats stats;
+  latencies.add_runtime_stats(stats);
+  REQUIRE(stats.resource_latencies.size() == ResourceLatencies::max_resources);
+  REQUIRE(stats.resource_latencies.front().resource == "new");
+}
+
+TEST_RESOURCE_LATENCIES("local roots are reported in the runtime stats") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  SpanConfig span_config;
+  span_config.resource = "GET /users";
+  for (const auto duration : {10ms, 20ms, 30ms}) {
+    auto root = tracer.create_span(span_config);
+    auto child = root.create_child();
+    // Only the local root's duration counts.
+    child.set_end_time(child.start_time().tick + 1h);
+    root.set_end_time(root.start_time().tick + duration);
+  }
+
+  const auto stats = tracer.runtime_stats();
+  REQUIRE(stats.resource_latencies.size() == 1);
+  const ResourceLatency& latency = stats.resource_latencies.front();
+  REQUIRE(latency.service == "testsvc");
+  REQUIRE(latency.resource == "GET /users");
+  REQUIRE(latency.count == 3);
+  REQUIRE(latency.p50_nanoseconds <= 20'000'000);
+  REQUIRE(latency.p50_nanoseconds > 18'000'000);
+  REQUIRE(latency.p99_nanoseconds <= 30'000'000);
+  REQUIRE(latency.p99_nanoseconds > 27'000'000);
+}
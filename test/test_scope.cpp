@@ -0,0 +1,146 @@
+// These are tests for `Scope`, which makes a span the active span of the
+// current thread.
+
+#include <datadog/profiling_context.h>
+#include <datadog/scope.h>
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_SCOPE(x) TEST_CASE(x, "[scope]")
+
+namespace {
+
+Tracer make_tracer() {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  return Tracer{*finalized};
+}
+
+}  // namespace
+
+TEST_SCOPE("no span is active by default") {
+  REQUIRE(Scope::current() == nullptr);
+  REQUIRE(Scope::active_span() == nullptr);
+}
+
+TEST_SCOPE("scopes nest") {
+  auto tracer = make_tracer();
+  auto root = tracer.create_span();
+  {
+    Scope outer{root};
+    REQUIRE(Scope::current() == &outer);
+    REQUIRE(Scope::active_span() == &root);
+    REQUIRE(outer.parent() == nullptr);
+
+    auto child = Scope::active_span()->create_child();
+    REQUIRE(child.parent_id() == root.id());
+    {
+      Scope inner{child};
+      REQUIRE(Scope::active_span() == &child);
+      REQUIRE(inner.parent() == &outer);
+      REQUIRE(&inner.span() == &child);
+    }
+    REQUIRE(Scope::active_span() == &root);
+  }
+  REQUIRE(Scope::active_span() == nullptr);
+}
+
+TEST_SCOPE("scopes are per thread") {
+  auto tracer = make_tracer();
+  auto root = tracer.create_span();
+  Scope scope{root};
+
+  bool other_thread_has_active_span = true;
+  std::thread other{
+      [&]() { other_thread_has_active_span = Scope::active_span() != nullptr; }};
+  other.join();
+  REQUIRE(!other_thread_has_active_span);
+  REQUIRE(Scope::active_span() == &root);
+}
+
+TEST_SCOPE("exchange_current switches between tasks' scopes") {
+  auto tracer = make_tracer();
+  auto root = tracer.create_span();
+  auto task_span = root.create_child();
+
+  Scope thread_scope{root};
+  // The "task" is resumed on this thread, with no scopes of its own yet.
+  Scope* const before_task = Scope::exchange_current(nullptr);
+  REQUIRE(before_task == &thread_scope);
+  REQUIRE(Scope::active_span() == nullptr);
+  {
+    Scope task_scope{task_span};
+    REQUIRE(Scope::active_span() == &task_span);
+
+    // The task is suspended: save its scope and restore the thread's.
+    Scope* const saved = Scope::exchange_current(before_task);
+    REQUIRE(saved == &task_scope);
+    REQUIRE(Scope::active_span() == &root);
+
+    // The task is resumed.
+    Scope::exchange_current(saved);
+    REQUIRE(Scope::active_span() == &task_span);
+  }
+  // The task finishes.
+  REQUIRE(Scope::exchange_current(before_task) == nullptr);
+  REQUIRE(Scope::active_span() == &root);
+}
+
+TEST_SCOPE("the active span is published for profilers") {
+  const auto read = []() {
+    const ProfilingContext& context = datadog_tracing_profiling_context;
+    const auto sequence = context.sequence.load();
+    REQUIRE(sequence % 2 == 0);
+    return std::vector<std::uint64_t>{
+        context.trace_id_low.load(), context.trace_id_high.load(),
+        context.span_id.load(), context.local_root_span_id.load(),
+        context.local_root_resource_hash.load()};
+  };
+  const std::vector<std::uint64_t> none(5, 0);
+  REQUIRE(read() == none);
+
+  auto tracer = make_tracer();
+  SpanConfig config;
+  config.resource = "GET /users";
+  auto root = tracer.create_span(config);
+  auto child = root.create_child();
+  // The 64-bit FNV-1a hash of "GET /users".
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : std::string("GET /users")) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  {
+    Scope outer{root};
+    REQUIRE(read() == std::vector<std::uint64_t>{root.trace_id().low,
+                                                 root.trace_id().high,
+                                                 root.id(), root.id(), hash});
+    {
+      Scope inner{child};
+      REQUIRE(read()[2] == child.id());
+      REQUIRE(read()[3] == root.id());
+
+      Scope* const saved = Scope::exchange_current(nullptr);
+      REQUIRE(read() == none);
+      Scope::exchange_current(saved);
+      REQUIRE(read()[2] == child.id());
+    }
+    REQUIRE(read()[2] == root.id());
+  }
+  REQUIRE(read() == none);
+}
@@ -0,0 +1,264 @@
+// These are tests for `SegmentRegistry`, which flushes the trace segments that
+// are still not complete after a maximum age, as when a span is leaked.
+
+#include <datadog/optional.h>
+#include <datadog/runtime_stats.h>
+#include <datadog/span.h>
+#include <datadog/span_data.h>
+#include <datadog/tags.h>
+#include <datadog/trace_segment.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mocks/collectors.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define TEST_SEGMENT_REGISTRY(x) TEST_CASE(x, "[segment_registry]")
+
+TEST_SEGMENT_REGISTRY("orphaned trace segments are flushed") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  const auto logger = std::make_shared<MockLogger>();
+  config.logger = logger;
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.orphaned_segment_max_age_seconds = 60;
+
+  TimePoint current_time = default_clock();
+  auto clock = [&current_time]() { return current_time; };
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  REQUIRE(event_scheduler->recurrence_interval == 60s);
+
+  Optional<Span> leaked = tracer.create_span();
+  leaked->create_child();
+
+  SECTION("but not before the maximum age") {
+    current_time += 59s;
+    event_scheduler->event_callback();
+    REQUIRE(collector->chunks.empty());
+    REQUIRE(tracer.runtime_stats().orphaned_trace_segments == 0);
+  }
+
+  SECTION("with their unfinished spans tagged") {
+    current_time += 60s;
+    event_scheduler->event_callback();
+
+    REQUIRE(collector->chunks.size() == 1);
+    const auto& spans = collector->chunks.front().spans;
+    REQUIRE(spans.size() == 2);
+    const SpanData& root = *spans[0];
+    const SpanData& child = *spans[1];
+    REQUIRE(root.tags.at(tags::internal::span_orphaned) == "1");
+    REQUIRE(root.duration == 60s);
+    REQUIRE(child.tags.count(tags::internal::span_orphaned) == 0);
+    REQUIRE(collector->chunks.front().sampling_priority);
+
+    const auto stats = tracer.runtime_stats();
+    REQUIRE(stats.orphaned_trace_segments == 1);
+    REQUIRE(stats.orphaned_bytes > 0);
+    REQUIRE(logger->error_count() == 1);
+
+    SECTION("only once") {
+      current_time += 60s;
+      event_scheduler->event_callback();
+      REQUIRE(collector->chunks.size() == 1);
+    }
+
+    SECTION("after which the leaked span can be used and destroyed") {
+      leaked->set_tag("foo", "bar");
+      leaked->create_child();
+      leaked.reset();
+      REQUIRE(collector->chunks.size() == 1);
+      REQUIRE(tracer.runtime_stats().live_trace_segments == 0);
+    }
+  }
+
+  SECTION("unless they completed") {
+    leaked.reset();
+    REQUIRE(collector->chunks.size() == 1);
+    current_time += 60s;
+    event_scheduler->event_callback();
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(tracer.runtime_stats().orphaned_trace_segments == 0);
+  }
+}
+
+TEST_SEGMENT_REGISTRY("segments are flushed while their spans are in use") {
+  // The segment is flushed on one thread while its spans are written, and
+  // children finish, on another, as when a sweep finds a long-running span.
+  // Under ThreadSanitizer, this checks that they don't race.
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.orphaned_segment_max_age_seconds = 60;
+
+  const TimePoint start = default_clock();
+  std::atomic<bool> aged{false};
+  auto clock = [&aged, start]() {
+    TimePoint now = start;
+    if (aged.load()) {
+      now.wall += 60s;
+      now.tick += 60s;
+    }
+    return now;
+  };
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  std::uint64_t root_id;
+  {
+    auto root = tracer.create_span();
+    root_id = root.id();
+    aged = true;
+    std::atomic<bool> flushed{false};
+    std::thread sweeper([&]() {
+      event_scheduler->event_callback();
+      flushed = true;
+    });
+    for (int i = 0; !flushed || i < 100; ++i) {
+      root.set_tag("iteration", std::to_string(i));
+      root.set_metric("iteration", i);
+      auto child = root.create_child();
+      child.set_resource_name("child");
+      child.set_error_message("oops");
+    }
+    sweeper.join();
+    root.set_tag("after", "flush");
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& spans = collector->chunks.front().spans;
+  REQUIRE(spans.front()->span_id == root_id);
+  REQUIRE(spans.front()->tags.at(tags::internal::span_orphaned) == "1");
+  REQUIRE(spans.front()->tags.count("after") == 0);
+  for (const auto& span : spans) {
+    // A child that was in use during the flush is sent as an orphan, too.
+    REQUIRE((span->span_id == root_id || span->parent_id == root_id));
+  }
+  REQUIRE(tracer.runtime_stats().orphaned_trace_segments == 1);
+  REQUIRE(tracer.runtime_stats().live_trace_segments == 0);
+}
+
+TEST_SEGMENT_REGISTRY("segments are flushed while children are created") {
+  // Children are registered on several threads while a sweep flushes their
+  // segment.  The sweep sends the children whose registration completed, and
+  // under ThreadSanitizer, this checks that it reads no others.
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.orphaned_segment_max_age_seconds = 60;
+
+  const TimePoint start = default_clock();
+  std::atomic<bool> aged{false};
+  auto clock = [&aged, start]() {
+    TimePoint now = start;
+    if (aged.load()) {
+      now.wall += 60s;
+      now.tick += 60s;
+    }
+    return now;
+  };
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto root = tracer.create_span();
+    const int thread_count = 4;
+    std::atomic<int> ready{0};
+    std::atomic<bool> flushed{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&]() {
+        ++ready;
+        // Keep the children alive, so that the segment keeps growing.
+        std::vector<Span> children;
+        for (int i = 0; !flushed || i < 100; ++i) {
+          children.push_back(root.create_child());
+        }
+      });
+    }
+    while (ready < thread_count) {
+      std::this_thread::yield();
+    }
+    aged = true;
+    event_scheduler->event_callback();
+    flushed = true;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& spans = collector->chunks.front().spans;
+  REQUIRE(!spans.empty());
+  for (const auto& span : spans) {
+    REQUIRE(span);
+  }
+  REQUIRE(tracer.runtime_stats().live_trace_segments == 0);
+}
+
+TEST_SEGMENT_REGISTRY("only the old enough segments are flushed") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.orphaned_segment_max_age_seconds = 60;
+
+  TimePoint current_time = default_clock();
+  auto clock = [&current_time]() { return current_time; };
+
+  auto finalized = finalize_config(config, clock);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  auto old_span = tracer.create_span();
+  current_time += 30s;
+  auto young_span = tracer.create_span();
+  current_time += 30s;
+  event_scheduler->event_callback();
+
+  REQUIRE(collector->chunks.size() == 1);
+  REQUIRE(collector->chunks.front().spans.front()->span_id == old_span.id());
+}
+
+TEST_SEGMENT_REGISTRY("the maximum age cannot be negative") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.orphaned_segment_max_age_seconds = -1;
+  auto finalized = finalize_config(config);
+  REQUIRE(!finalized);
+  REQUIRE(finalized.error().code == Error::ORPHANED_SEGMENT_INVALID_MAX_AGE);
+}
@@ -0,0 +1,45 @@
+// Self-profiling is compiled out of the library unless it is built with
+// `DD_TRACE_SELF_PROFILING`, so this test enables it for itself.
+#define DD_TRACE_SELF_PROFILING
+#include <datadog/self_profiling.h>
+
+#include <cstdint>
+
+#include "test.h"
+
+using namespace datadog;
+using namespace datadog::tracing;
+
+#define SELF_PROFILING_TEST(x) TEST_CASE(x, "[self_profiling]")
+
+SELF_PROFILING_TEST("one in a period of timers is measured") {
+  const telemetry::Distribution distribution{"test.ns", "tracers", false};
+  std::uint32_t calls = 0;
+
+  int active = 0;
+  for (std::uint32_t i = 0; i < 3 * SelfProfilingTimer::sample_period; ++i) {
+    const SelfProfilingTimer timer{distribution, calls};
+    if (timer.active()) {
+      REQUIRE(i % SelfProfilingTimer::sample_period == 0);
+      ++active;
+    }
+  }
+  REQUIRE(active == 3);
+}
+
+SELF_PROFILING_TEST("each use of the macro has its own sample") {
+  const telemetry::Distribution distribution{"test.ns", "tracers", false};
+  const auto profiled = [&] {
+    DD_SELF_PROFILE(distribution);
+    return dd_self_profile_timer.active();
+  };
+  const auto other = [&] {
+    DD_SELF_PROFILE(distribution);
+    return dd_self_profile_timer.active();
+  };
+
+  REQUIRE(profiled());
+  REQUIRE(other());
+  REQUIRE_FALSE(profiled());
+  REQUIRE_FALSE(other());
+}
@@ -0,0 +1,109 @@
+#include <datadog/clock.h>
+#include <datadog/collector_response.h>
+#include <datadog/sampling_decision.h>
+#include <datadog/sampling_mechanism.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/shared_sampler_state.h>
+#include <datadog/span_data.h>
+#include <datadog/tags.h>
+#include <datadog/trace_sampler.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define SHARED_SAMPLER_STATE_TEST(x) TEST_CASE(x, "[shared_sampler_state]")
+
+SHARED_SAMPLER_STATE_TEST("rates are shared with forked processes") {
+  auto created = SharedSamplerState::create();
+  REQUIRE(created);
+  auto& state = **created;
+
+  std::unordered_map<std::string, Rate> rates;
+  std::uint64_t version = 0;
+  REQUIRE(state.rates_version() == 0);
+  REQUIRE_FALSE(state.read_rates(rates, version));
+
+  const pid_t child = ::fork();
+  REQUIRE(child != -1);
+  if (child == 0) {
+    const bool published = state.publish_rates(
+        {{"service:a,env:prod", Rate::one()},
+         {CollectorResponse::key_of_default_rate, *Rate::from(0.25)}});
+    ::_exit(published ? 0 : 1);
+  }
+
+  int status = 0;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  REQUIRE(state.rates_version() == 1);
+  REQUIRE(state.read_rates(rates, version));
+  REQUIRE(version == 1);
+  REQUIRE(rates.size() == 2);
+  REQUIRE(rates.at("service:a,env:prod") == 1.0);
+  REQUIRE(rates.at(CollectorResponse::key_of_default_rate) == 0.25);
+
+  // Rates that do not fit are not published.
+  REQUIRE_FALSE(state.publish_rates(
+      {{std::string(SharedSamplerState::rates_capacity, 'x'), Rate::one()}}));
+  REQUIRE(state.rates_version() == 1);
+}
+
+SHARED_SAMPLER_STATE_TEST("trace samplers share the limiter") {
+  auto created = SharedSamplerState::create();
+  REQUIRE(created);
+
+  TraceSamplerConfig config;
+  config.sample_rate = 1.0;
+  config.max_per_second = 1;
+  config.shared_state = *created;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  config.max_per_second = 2;
+  auto other_limit = finalize_config(config);
+  REQUIRE(other_limit);
+
+  TraceSampler first{*finalized, default_clock};
+  TraceSampler second{*finalized, default_clock};
+  TraceSampler third{*other_limit, default_clock};
+  SpanData span;
+  REQUIRE(first.decide(span).priority == int(SamplingPriority::USER_KEEP));
+  REQUIRE(second.decide(span).priority == int(SamplingPriority::USER_DROP));
+  // A sampler configured with another limit has its own.
+  REQUIRE(third.decide(span).priority == int(SamplingPriority::USER_KEEP));
+}
+
+SHARED_SAMPLER_STATE_TEST("trace samplers share collector rates") {
+  auto created = SharedSamplerState::create();
+  REQUIRE(created);
+
+  TraceSamplerConfig config;
+  config.shared_state = *created;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  TraceSampler receiver{*finalized, default_clock};
+  TraceSampler other{*finalized, default_clock};
+
+  SpanData span;
+  span.service = "testsvc";
+  span.tags[tags::environment] = "dev";
+  REQUIRE(other.decide(span).mechanism == int(SamplingMechanism::DEFAULT));
+
+  CollectorResponse response;
+  response.sample_rate_by_key["service:testsvc,env:dev"] = *Rate::from(0.5);
+  receiver.handle_collector_response(response);
+
+  for (TraceSampler* sampler : {&receiver, &other}) {
+    const auto decision = sampler->decide(span);
+    REQUIRE(decision.mechanism == int(SamplingMechanism::AGENT_RATE));
+    REQUIRE(decision.configured_rate == *Rate::from(0.5));
+  }
+}
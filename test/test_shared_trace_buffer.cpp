@@ -0,0 +1,93 @@
+#include <datadog/error.h>
+#include <datadog/shared_trace_buffer.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define SHARED_TRACE_BUFFER_TEST(x) TEST_CASE(x, "[shared_trace_buffer]")
+
+SHARED_TRACE_BUFFER_TEST("records are removed in the order appended") {
+  auto created = SharedTraceBuffer::create(64);
+  REQUIRE(created);
+  auto& buffer = **created;
+  REQUIRE(buffer.capacity() == 64);
+
+  std::string record;
+  REQUIRE_FALSE(buffer.pop(record));
+
+  // Each record takes four bytes more than its size, so that the ring wraps
+  // around its end several times.
+  for (int i = 0; i < 20; ++i) {
+    const std::string first = "first " + std::to_string(i);
+    const std::string second(static_cast<std::size_t>(i), 'x');
+    REQUIRE(buffer.push(first));
+    REQUIRE(buffer.push(second));
+    REQUIRE(buffer.pop(record));
+    REQUIRE(record == first);
+    REQUIRE(buffer.pop(record));
+    REQUIRE(record == second);
+    REQUIRE_FALSE(buffer.pop(record));
+  }
+  REQUIRE(buffer.dropped() == 0);
+}
+
+SHARED_TRACE_BUFFER_TEST("records that do not fit are dropped") {
+  auto created = SharedTraceBuffer::create(32);
+  REQUIRE(created);
+  auto& buffer = **created;
+
+  REQUIRE(buffer.push(std::string(20, 'a')));
+  REQUIRE_FALSE(buffer.push(std::string(20, 'b')));
+  REQUIRE(buffer.push(std::string(4, 'c')));
+  REQUIRE(buffer.dropped() == 1);
+
+  std::string record;
+  REQUIRE(buffer.pop(record));
+  REQUIRE(record == std::string(20, 'a'));
+  REQUIRE(buffer.pop(record));
+  REQUIRE(record == std::string(4, 'c'));
+  REQUIRE_FALSE(buffer.pop(record));
+}
+
+SHARED_TRACE_BUFFER_TEST("shared trace buffer capacity must hold a record") {
+  auto created = SharedTraceBuffer::create(0);
+  REQUIRE_FALSE(created);
+  REQUIRE(created.error().code == Error::SHARED_TRACE_BUFFER_INVALID_CAPACITY);
+}
+
+SHARED_TRACE_BUFFER_TEST("records are shared with forked processes") {
+  auto created = SharedTraceBuffer::create(1024);
+  REQUIRE(created);
+  auto& buffer = **created;
+
+  const pid_t child = ::fork();
+  REQUIRE(child != -1);
+  if (child == 0) {
+    // The child is elected, and exits without resigning.
+    const bool elected = buffer.try_become_drainer();
+    const bool pushed = buffer.push("from the child");
+    ::_exit(elected && pushed ? 0 : 1);
+  }
+
+  int status = 0;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  std::string record;
+  REQUIRE(buffer.pop(record));
+  REQUIRE(record == "from the child");
+
+  // The child is no longer running, so this process can be elected.
+  REQUIRE(buffer.try_become_drainer());
+  REQUIRE(buffer.try_become_drainer());
+  buffer.resign_drainer();
+  REQUIRE(buffer.try_become_drainer());
+  buffer.resign_drainer();
+}
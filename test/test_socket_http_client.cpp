@@ -0,0 +1,398 @@
+#include <datadog/dict_reader.h>
+#include <datadog/dict_writer.h>
+#include <datadog/error.h>
+#include <datadog/json.hpp>
+#include <datadog/optional.h>
+#include <datadog/socket_http_client.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+namespace {
+
+// `UnixServer` accepts connections on a Unix domain socket in a temporary
+// directory, and answers each request received using the specified handler.
+// If the handler returns an empty string, then the request is not answered.
+class UnixServer {
+ public:
+  struct Request {
+    std::string text;
+    // The index of the connection on which the request was received.
+    int connection;
+  };
+
+  using Handler = std::function<std::string(const std::string& request)>;
+
+  explicit UnixServer(Handler handler) : handler_(std::move(handler)) {
+    char directory[] = "/tmp/dd-trace-cpp-test-XXXXXX";
+    REQUIRE(::mkdtemp(directory));
+    directory_ = directory;
+    path_ = directory_ + "/agent.sock";
+
+    listener_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(listener_ != -1);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path_.c_str());
+    REQUIRE(::bind(listener_, reinterpret_cast<sockaddr*>(&address),
+                   sizeof address) == 0);
+    REQUIRE(::listen(listener_, 8) == 0);
+
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  ~UnixServer() {
+    stop_ = true;
+    thread_.join();
+    ::close(listener_);
+    ::unlink(path_.c_str());
+    ::rmdir(directory_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+  std::vector<Request> requests() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+  }
+
+ private:
+  // Wait until `fd` is readable or the server is stopped.  Return whether
+  // `fd` is readable.
+  bool wait(int fd) const {
+    while (!stop_) {
+      pollfd arg{fd, POLLIN, 0};
+      if (::poll(&arg, 1, 10) > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run() {
+    for (int index = 0; wait(listener_); ++index) {
+      const int fd = ::accept(listener_, nullptr, nullptr);
+      if (fd == -1) {
+        continue;
+      }
+      serve(fd, index);
+      ::close(fd);
+    }
+  }
+
+  // Answer requests received on `fd` until the client closes it.
+  void serve(int fd, int index) {
+    std::string buffer;
+    char chunk[1024];
+    while (wait(fd)) {
+      const ssize_t received = ::recv(fd, chunk, sizeof chunk, 0);
+      if (received <= 0) {
+        return;
+      }
+      buffer.append(chunk, static_cast<std::size_t>(received));
+
+      while (true) {
+        const auto end_of_head = buffer.find("\r\n\r\n");
+        if (end_of_head == std::string::npos) {
+          break;
+        }
+        const auto header = buffer.find("Content-Length: ");
+        REQUIRE(header != std::string::npos);
+        const std::size_t length =
+            std::stoul(buffer.substr(header + std::strlen("Content-Length: ")));
+        const std::size_t size = end_of_head + 4 + length;
+        if (buffer.size() < size) {
+          break;
+        }
+
+        const std::string text = buffer.substr(0, size);
+        buffer.erase(0, size);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          requests_.push_back(Request{text, index});
+        }
+        const std::string response = handler_(text);
+        if (!response.empty()) {
+          REQUIRE(::send(fd, response.data(), response.size(), 0) ==
+                  ssize_t(response.size()));
+        }
+      }
+    }
+  }
+
+  Handler handler_;
+  std::string directory_;
+  std::string path_;
+  int listener_ = -1;
+  std::atomic<bool> stop_{false};
+  mutable std::mutex mutex_;
+  std::vector<Request> requests_;
+  std::thread thread_;
+};
+
+struct Result {
+  Optional<int> status;
+  Optional<std::string> content_type;
+  std::string body;
+  Optional<Error> error;
+};
+
+// Send a request having the specified `body` to the specified `url` using the
+// specified `client`, wait for it to finish, and return the result.
+Result send(HTTPClient& client, const HTTPClient::URL& url,
+            HTTPClient::BodySegments body,
+            std::chrono::steady_clock::duration timeout = 5s) {
+  Result result;
+  const auto set_headers = [](DictWriter& writer) {
+    writer.set("Content-Type", "application/msgpack");
+    writer.set("X-Datadog-Trace-Count", "2");
+  };
+  const auto on_response = [&](int status, const DictReader& headers,
+                               std::string response_body) {
+    result.status = status;
+    if (auto content_type = headers.lookup("Content-Type")) {
+      result.content_type = std::string(*content_type);
+    }
+    result.body = std::move(response_body);
+  };
+  const auto on_error = [&](Error error) { result.error = std::move(error); };
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  const auto posted = client.post_segments(url, set_headers, std::move(body),
+                                           on_response, on_error, deadline);
+  REQUIRE(posted);
+  client.drain(deadline + 1s);
+  return result;
+}
+
+HTTPClient::BodySegments segments(std::vector<std::string> parts) {
+  HTTPClient::BodySegments result;
+  for (auto& part : parts) {
+    result.push_back(std::make_shared<const std::string>(std::move(part)));
+  }
+  return result;
+}
+
+}  // namespace
+
+#define SOCKET_HTTP_CLIENT_TEST(x) TEST_CASE(x, "[socket_http_client]")
+
+SOCKET_HTTP_CLIENT_TEST("requests and responses over a Unix domain socket") {
+  UnixServer server{[](const std::string&) {
+    return "HTTP/1.1 200 OK\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: 14\r\n"
+           "\r\n"
+           "{\"rate\": 0.5}\n";
+  }};
+  const auto logger = std::make_shared<MockLogger>();
+  SocketHTTPClientOptions options;
+  options.io_uring = GENERATE(false, true);
+  CAPTURE(options.io_uring);
+  SocketHTTPClient client{logger, default_clock, options};
+
+  const HTTPClient::URL url{"unix", server.path(), "/v0.4/traces", ""};
+  const auto result = send(client, url, segments({"\x92", "abc", "", "def"}));
+
+  REQUIRE_FALSE(result.error);
+  REQUIRE(result.status == 200);
+  REQUIRE(result.content_type == "application/json");
+  REQUIRE(result.body == "{\"rate\": 0.5}\n");
+
+  const auto requests = server.requests();
+  REQUIRE(requests.size() == 1);
+  REQUIRE(requests[0].text ==
+          "POST /v0.4/traces HTTP/1.1\r\n"
+          "Host: localhost\r\n"
+          "Content-Length: 7\r\n"
+          "Content-Type: application/msgpack\r\n"
+          "X-Datadog-Trace-Count: 2\r\n"
+          "\r\n"
+          "\x92"
+          "abcdef");
+  REQUIRE(logger->error_count() == 0);
+}
+
+SOCKET_HTTP_CLIENT_TEST("chunked responses and connection reuse") {
+  UnixServer server{[](const std::string&) {
+    return "HTTP/1.1 100 Continue\r\n"
+           "\r\n"
+           "HTTP/1.1 202 Accepted\r\n"
+           "Transfer-Encoding: chunked\r\n"
+           "\r\n"
+           "4\r\nhell\r\n"
+           "1;extension=ignored\r\no\r\n"
+           "0\r\n"
+           "\r\n";
+  }};
+  const auto logger = std::make_shared<MockLogger>();
+  SocketHTTPClientOptions options;
+  options.io_uring = GENERATE(false, true);
+  CAPTURE(options.io_uring);
+  SocketHTTPClient client{logger, default_clock, options};
+
+  const HTTPClient::URL url{"http+unix", server.path(), "/info", ""};
+  for (int i = 0; i < 3; ++i) {
+    const auto result = send(client, url, segments({"{}"}));
+    REQUIRE_FALSE(result.error);
+    REQUIRE(result.status == 202);
+    REQUIRE(result.body == "hello");
+  }
+
+  // Every request was sent on the same connection.
+  const auto requests = server.requests();
+  REQUIRE(requests.size() == 3);
+  for (const auto& request : requests) {
+    REQUIRE(request.connection == 0);
+  }
+  const auto config = nlohmann::json::parse(client.config());
+  REQUIRE(config["config"]["connections_created"] == 1);
+  REQUIRE(config["config"]["connections_reused"] == 2);
+}
+
+SOCKET_HTTP_CLIENT_TEST("connections closed by the server are not reused") {
+  UnixServer server{[](const std::string&) {
+    return "HTTP/1.1 200 OK\r\n"
+           "Connection: close\r\n"
+           "Content-Length: 2\r\n"
+           "\r\n"
+           "ok";
+  }};
+  const auto logger = std::make_shared<MockLogger>();
+  SocketHTTPClientOptions options;
+  options.io_uring = GENERATE(false, true);
+  CAPTURE(options.io_uring);
+  SocketHTTPClient client{logger, default_clock, options};
+
+  const HTTPClient::URL url{"unix", server.path(), "/v0.4/traces", ""};
+  for (int i = 0; i < 2; ++i) {
+    const auto result = send(client, url, segments({"[]"}));
+    REQUIRE_FALSE(result.error);
+    REQUIRE(result.status == 200);
+    REQUIRE(result.body == "ok");
+  }
+
+  const auto requests = server.requests();
+  REQUIRE(requests.size() == 2);
+  REQUIRE(requests[0].connection == 0);
+  REQUIRE(requests[1].connection == 1);
+}
+
+SOCKET_HTTP_CLIENT_TEST("concurrent requests") {
+  // The server answers one connection at a time, so it closes each.
+  UnixServer server{[](const std::string&) {
+    return "HTTP/1.1 200 OK\r\n"
+           "Connection: close\r\n"
+           "Content-Length: 2\r\n"
+           "\r\n"
+           "ok";
+  }};
+  const auto logger = std::make_shared<MockLogger>();
+  SocketHTTPClientOptions options;
+  options.io_uring = GENERATE(false, true);
+  CAPTURE(options.io_uring);
+  SocketHTTPClient client{logger, default_clock, options};
+
+  // Without io_uring, `poll` is used.  With it, `poll` is used only if
+  // io_uring is unavailable.
+  const auto config = nlohmann::json::parse(client.config());
+  REQUIRE(config["config"]["io_uring"].is_boolean());
+  if (!options.io_uring) {
+    REQUIRE(config["config"]["io_uring"] == false);
+  }
+
+  // The requests are in flight at once, each on its own connection, and each
+  // body has more segments than are sent at once.
+  const HTTPClient::URL url{"unix", server.path(), "/v0.4/traces", ""};
+  const int num_requests = 8;
+  std::atomic<int> num_responses{0};
+  std::atomic<int> num_errors{0};
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  for (int i = 0; i < num_requests; ++i) {
+    std::vector<std::string> parts(100, "x");
+    const auto posted = client.post_segments(
+        url, [](DictWriter&) {}, segments(std::move(parts)),
+        [&](int status, const DictReader&, std::string body) {
+          if (status == 200 && body == "ok") {
+            ++num_responses;
+          }
+        },
+        [&](Error) { ++num_errors; }, deadline);
+    REQUIRE(posted);
+  }
+  client.drain(deadline + 1s);
+
+  REQUIRE(num_errors == 0);
+  REQUIRE(num_responses == num_requests);
+  const auto requests = server.requests();
+  REQUIRE(requests.size() == num_requests);
+  for (const auto& request : requests) {
+    REQUIRE(request.text.size() > 100);
+    REQUIRE(request.text.substr(request.text.size() - 100) ==
+            std::string(100, 'x'));
+  }
+  REQUIRE(logger->error_count() == 0);
+}
+
+SOCKET_HTTP_CLIENT_TEST("socket HTTP client errors") {
+  const auto logger = std::make_shared<MockLogger>();
+  SocketHTTPClientOptions options;
+  options.io_uring = GENERATE(false, true);
+  CAPTURE(options.io_uring);
+  SocketHTTPClient client{logger, default_clock, options};
+
+  SECTION("unsupported URL scheme") {
+    const HTTPClient::URL url{"https", "localhost:8126", "/v0.4/traces", ""};
+    const auto result =
+        client.post(url, [](DictWriter&) {}, "", [](auto&&...) {},
+                    [](auto&&...) {}, std::chrono::steady_clock::now() + 1s);
+    REQUIRE_FALSE(result);
+    REQUIRE(result.error().code ==
+            Error::SOCKET_HTTP_CLIENT_UNSUPPORTED_URL);
+  }
+
+  SECTION("nothing listening on the socket") {
+    const HTTPClient::URL url{"unix", "/tmp/dd-trace-cpp-test-nonexistent.sock",
+                              "/v0.4/traces", ""};
+    const auto result = send(client, url, segments({"[]"}));
+    REQUIRE(result.error);
+    REQUIRE(result.error->code == Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE);
+    REQUIRE_FALSE(result.status);
+  }
+
+  SECTION("the server does not respond before the deadline") {
+    UnixServer server{[](const std::string&) { return ""; }};
+    const HTTPClient::URL url{"unix", server.path(), "/v0.4/traces", ""};
+    const auto result = send(client, url, segments({"[]"}), 100ms);
+    REQUIRE(result.error);
+    REQUIRE(result.error->code == Error::SOCKET_HTTP_CLIENT_DEADLINE_EXCEEDED);
+    REQUIRE_FALSE(result.status);
+  }
+
+  SECTION("invalid response") {
+    UnixServer server{
+        [](const std::string&) { return "SMTP/1.0 220 hello\r\n\r\n"; }};
+    const HTTPClient::URL url{"unix", server.path(), "/v0.4/traces", ""};
+    const auto result = send(client, url, segments({"[]"}));
+    REQUIRE(result.error);
+    REQUIRE(result.error->code == Error::SOCKET_HTTP_CLIENT_REQUEST_FAILURE);
+  }
+}
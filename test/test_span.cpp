@@ -9,14 +9,22 @@
 #include <datadog/optional.h>
 #include <datadog/span.h>
 #include <datadog/span_config.h>
+#include <datadog/span_context.h>
+#include <datadog/span_event.h>
+#include <datadog/span_link.h>
+#include <datadog/string_util.h>
 #include <datadog/tag_propagation.h>
 #include <datadog/trace_segment.h>
 #include <datadog/tracer.h>
 
 #include <chrono>
 #include <cstdint>
+#include <datadog/json.hpp>
 #include <functional>
+#include <limits>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "catch.hpp"
 #include "matchers.h"
@@ -224,6 +232,151 @@ TEST_SPAN("set_metric") {
   }
 }
 
+TEST_SPAN("set_tags and set_metrics") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  {
+    auto span = tracer.create_span();
+    span.set_tag("color", "purple");
+    span.set_metric("depth", 1.0);
+    span.set_tags({{"http.method", "GET"},
+                   {"color", "a much longer color than purple"},
+                   {"component", "test"},
+                   {"component", "overwritten"}});
+    span.set_metrics({{"depth", 2.0}, {"width", 3.0}});
+    span.set_tags({});
+
+    REQUIRE(span.lookup_tag("http.method") == "GET");
+    REQUIRE(span.lookup_tag("color") == "a much longer color than purple");
+    REQUIRE(span.lookup_tag("component") == "overwritten");
+    REQUIRE(span.lookup_metric("depth") == 2.0);
+    REQUIRE(span.lookup_metric("width") == 3.0);
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& span = *collector->chunks.front().front();
+  REQUIRE(span.tags.at("component") == "overwritten");
+  REQUIRE(span.tags.count("color") == 1);
+  REQUIRE(span.numeric_tags.at("width") == 3.0);
+}
+
+TEST_SPAN("integer and boolean tags") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  auto span = tracer.create_span();
+  span.set_tag("http.status_code", 404);
+  span.set_tag("network.destination.port", std::uint16_t(443));
+  span.set_tag("size", std::numeric_limits<std::uint64_t>::max());
+  span.set_tag("offset", std::numeric_limits<std::int64_t>::min());
+  span.set_tag("cached", true);
+  span.set_tag("retried", false);
+
+  REQUIRE(span.lookup_tag("http.status_code") == "404");
+  REQUIRE(span.lookup_tag("network.destination.port") == "443");
+  REQUIRE(span.lookup_tag("size") == "18446744073709551615");
+  REQUIRE(span.lookup_tag("offset") == "-9223372036854775808");
+  REQUIRE(span.lookup_tag("cached") == "true");
+  REQUIRE(span.lookup_tag("retried") == "false");
+
+  span.set_tag("http.status_code", 200L);
+  REQUIRE(span.lookup_tag("http.status_code") == "200");
+  // String literals still set string values.
+  span.set_tag("cached", "maybe");
+  REQUIRE(span.lookup_tag("cached") == "maybe");
+}
+
+TEST_SPAN("span links and span events") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  {
+    auto producer = tracer.create_span();
+    producer.trace_segment().override_sampling_priority(
+        SamplingPriority::USER_KEEP);
+    auto consumer = tracer.create_span();
+    consumer.add_link(producer, {{"messaging.operation", "receive"}});
+
+    SpanLink extracted;
+    extracted.trace_id = TraceID(0xCAFE, 0xBEEF);
+    extracted.span_id = 42;
+    extracted.flags = 0;
+    extracted.tracestate = "dd=s:1";
+    consumer.add_link(extracted);
+
+    consumer.add_event("retry", {{"attempt", "2"}});
+    SpanEvent handled;
+    handled.name = "exception";
+    handled.time = std::chrono::system_clock::time_point(
+        std::chrono::nanoseconds(1'700'000'000'000'000'000));
+    consumer.add_event(handled);
+  }
+
+  const auto& chunks = collector->chunks;
+  REQUIRE(chunks.size() == 2);
+  REQUIRE(chunks[0].size() == 1);
+  const SpanData& consumer = *chunks[0][0];
+  const SpanData& producer = *chunks[1][0];
+  REQUIRE(consumer.links.size() == 2);
+  REQUIRE(consumer.events.size() == 2);
+
+  std::string encoded;
+  REQUIRE(msgpack_encode(encoded, consumer));
+  const auto span = nlohmann::json::from_msgpack(encoded);
+  REQUIRE(span.size() == 14);
+
+  const auto& links = span["span_links"];
+  REQUIRE(links.size() == 2);
+  REQUIRE(links[0]["trace_id"] == producer.trace_id.low);
+  REQUIRE(links[0]["span_id"] == producer.span_id);
+  REQUIRE(links[0]["attributes"] ==
+          nlohmann::json{{"messaging.operation", "receive"}});
+  // The producer's trace is kept, and the high bit marks the flags as set.
+  REQUIRE(links[0]["flags"] == 0x80000001u);
+  REQUIRE(links[1]["trace_id"] == 0xCAFE);
+  REQUIRE(links[1]["trace_id_high"] == 0xBEEF);
+  REQUIRE(links[1]["span_id"] == 42);
+  REQUIRE(links[1]["tracestate"] == "dd=s:1");
+  REQUIRE(links[1]["flags"] == 0x80000000u);
+  REQUIRE(!links[1].contains("attributes"));
+
+  const auto& events = span["span_events"];
+  REQUIRE(events.size() == 2);
+  REQUIRE(events[0]["name"] == "retry");
+  REQUIRE(events[0]["time_unix_nano"] >= span["start"]);
+  REQUIRE(events[0]["attributes"]["attempt"] ==
+          nlohmann::json{{"type", 0}, {"string_value", "2"}});
+  REQUIRE(events[1]["name"] == "exception");
+  REQUIRE(events[1]["time_unix_nano"] == 1'700'000'000'000'000'000ULL);
+  REQUIRE(!events[1].contains("attributes"));
+
+  // Spans without links or events do not encode them.
+  encoded.clear();
+  REQUIRE(msgpack_encode(encoded, producer));
+  REQUIRE(nlohmann::json::from_msgpack(encoded).size() == 12);
+}
+
 TEST_SPAN("lookup_metric") {
   TracerConfig config;
   config.service = "testsvc";
@@ -465,6 +618,252 @@ TEST_SPAN("property setters and getters") {
   }
 }
 
+TEST_SPAN("tag values and resource names are truncated to their limits") {
+  TracerConfig config;
+  config.service = "testsvc";
+  auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.max_tag_value_length = 8;
+  config.max_resource_length = 4;
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  {
+    SpanConfig span_config;
+    span_config.resource = "created";
+    span_config.tags["created"] = "0123456789";
+    auto span = tracer.create_span(span_config);
+    REQUIRE(span.resource_name() == "crea");
+    REQUIRE(span.lookup_tag("created") == "01234567");
+
+    span.set_tag("short", "01234567");
+    span.set_tag("long", "0123456789");
+    // "\xc3\xa9" is one character, which is not split.
+    span.set_tag("utf8", "1234567\xc3\xa9");
+    span.set_tags({{"many", "abcdefghij"}});
+    span.set_error_message("a long error message");
+    span.set_resource_name("resource");
+    span.set_name("a name that is not limited");
+  }
+
+  const auto& span = collector->first_span();
+  REQUIRE(span.resource == "reso");
+  REQUIRE(span.tags.at("short") == "01234567");
+  REQUIRE(span.tags.at("long") == "01234567");
+  REQUIRE(span.tags.at("utf8") == "1234567");
+  REQUIRE(span.tags.at("many") == "abcdefgh");
+  REQUIRE(span.tags.at("error.message") == "a long e");
+  REQUIRE(span.name == "a name that is not limited");
+}
+
+TEST_SPAN("span data tracks the size of its strings") {
+  TracerConfig config;
+  config.service = "testsvc";
+  auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  { auto span = tracer.create_span(); }
+  {
+    auto span = tracer.create_span();
+    // 3 + 5
+    span.set_tag("foo", "lemon");
+    // 4 - 5
+    span.set_tag("foo", "mint");
+    // 4 + 1, and then removed
+    span.set_tag("gone", "x");
+    span.remove_tag("gone");
+    // 1 + 8, twice, and then one is removed
+    span.set_metrics({{"m", 1}, {"n", 2}});
+    span.remove_metric("n");
+    // 6
+    span.set_resource_name("wobble");
+    // 4
+    span.set_name("name");
+    // 1 + 2
+    span.set_tag("i", -1);
+  }
+
+  REQUIRE(collector->chunks.size() == 2);
+  const auto& baseline = *collector->chunks[0].front();
+  const auto& changed = *collector->chunks[1].front();
+  REQUIRE(changed.byte_size - baseline.byte_size ==
+          3 + 5 + 4 - 5 + 1 + 8 + 6 + 4 + 1 + 2);
+  REQUIRE(estimated_encoded_size(changed) > changed.byte_size);
+}
+
+TEST_SPAN("child span IDs come from the tracer's ID generator") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  // Count the span IDs generated, so that each span has a different ID.
+  struct Generator : public IDGenerator {
+    mutable std::uint64_t next_id = 1;
+    TraceID trace_id(const TimePoint&) const override { return TraceID(7); }
+    std::uint64_t span_id() const override { return next_id++; }
+  };
+  Tracer tracer{*finalized_config, std::make_shared<Generator>()};
+
+  auto root = tracer.create_span();
+  auto child = root.create_child();
+  auto grandchild = child.create_child();
+  // The ID of a trace's root span is the lower part of the trace ID.
+  REQUIRE(root.id() == 7);
+  REQUIRE(child.id() == 1);
+  REQUIRE(grandchild.id() == 2);
+  REQUIRE(grandchild.parent_id() == 1);
+}
+
+TEST_SPAN("children created from a span's context") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  SECTION("are children of the span") {
+    {
+      auto root = tracer.create_span();
+      const SpanContext context = root.context();
+      REQUIRE(context.id() == root.id());
+      REQUIRE(context.trace_id() == root.trace_id());
+      REQUIRE(&context.trace_segment() == &root.trace_segment());
+
+      SpanConfig span_config;
+      span_config.name = "handoff";
+      auto child = context.create_child(span_config);
+      REQUIRE(child.parent_id() == root.id());
+      REQUIRE(child.trace_id() == root.trace_id());
+      REQUIRE(&child.trace_segment() == &root.trace_segment());
+      REQUIRE(child.name() == "handoff");
+    }
+
+    // The children are part of the same trace segment.
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 2);
+  }
+
+  SECTION("can be created on other threads") {
+    const int thread_count = 4;
+    {
+      auto root = tracer.create_span();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([context = root.context()]() {
+          auto child = context.create_child();
+          child.context().create_child();
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      REQUIRE(collector->chunks.empty());
+    }
+
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 2 * thread_count + 1);
+  }
+
+  SECTION("can be created after the span finishes") {
+    Optional<SpanContext> context;
+    std::uint64_t root_id;
+    {
+      auto root = tracer.create_span();
+      root_id = root.id();
+      context = root.context();
+    }
+    // The context keeps the trace segment from completing.
+    REQUIRE(collector->chunks.empty());
+
+    {
+      auto child = context->create_child();
+      REQUIRE(child.parent_id() == root_id);
+      child.context().create_child();
+    }
+    REQUIRE(collector->chunks.empty());
+
+    context.reset();
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 3);
+  }
+}
+
+TEST_SPAN("children created together") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  SECTION("are like children created one at a time") {
+    auto finalized_config = finalize_config(config);
+    REQUIRE(finalized_config);
+    struct Generator : public IDGenerator {
+      mutable std::uint64_t next_id = 1;
+      TraceID trace_id(const TimePoint&) const override { return TraceID(7); }
+      std::uint64_t span_id() const override { return next_id++; }
+    };
+    Tracer tracer{*finalized_config, std::make_shared<Generator>()};
+    {
+      auto root = tracer.create_span();
+      SpanConfig span_config;
+      span_config.name = "shard.query";
+      auto children = root.create_children(3, span_config);
+      REQUIRE(children.size() == 3);
+      for (std::size_t i = 0; i < children.size(); ++i) {
+        REQUIRE(children[i].id() == i + 1);
+        REQUIRE(children[i].parent_id() == root.id());
+        REQUIRE(children[i].trace_id() == root.trace_id());
+        REQUIRE(children[i].name() == "shard.query");
+        REQUIRE(children[i].start_time().tick == children[0].start_time().tick);
+      }
+      auto grandchild = children[2].create_child();
+      REQUIRE(grandchild.id() == 4);
+
+      // The segment is complete only once every child is finished.
+      children.pop_back();
+      REQUIRE(root.create_children(0).empty());
+    }
+
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 5);
+  }
+
+  SECTION("of dropped traces are not recorded") {
+    config.early_sampling_decision = true;
+    config.trace_sampler.sample_rate = 0.0;
+    auto finalized_config = finalize_config(config);
+    REQUIRE(finalized_config);
+    Tracer tracer{*finalized_config};
+    std::vector<Span> children;
+    {
+      auto root = tracer.create_span();
+      children = root.create_children(2);
+      REQUIRE(children[1].parent_id() == root.id());
+      REQUIRE(children[0].id() != children[1].id());
+    }
+    REQUIRE(collector->chunks.empty());
+    children.clear();
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 1);
+  }
+}
+
 // Trace context injection is implemented in `TraceSegment`, but it's part of
 // the interface of `Span`, so the test is here.
 TEST_SPAN("injection") {
@@ -613,6 +1012,125 @@ TEST_SPAN("injection") {
   }
 }
 
+TEST_SPAN("injecting every style repeatedly gives the same headers") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  config.injection_styles = {PropagationStyle::DATADOG, PropagationStyle::B3,
+                             PropagationStyle::W3C};
+  config.generate_128bit_trace_ids = true;
+
+  const auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  auto span = tracer.create_span();
+  span.set_source(Source::appsec);
+  const auto child = span.create_child();
+
+  MockDictWriter first;
+  child.inject(first);
+  MockDictWriter second;
+  child.inject(second);
+  REQUIRE(first.items == second.items);
+
+  const auto& headers = first.items;
+  REQUIRE(headers.at("x-datadog-trace-id") ==
+          std::to_string(child.trace_id().low));
+  REQUIRE(headers.at("x-datadog-parent-id") == std::to_string(child.id()));
+  REQUIRE(headers.at("x-b3-traceid") == child.trace_id().hex_padded());
+  REQUIRE(headers.at("x-b3-spanid") == hex_padded(child.id()));
+  REQUIRE(headers.at("traceparent") ==
+          "00-" + child.trace_id().hex_padded() + "-" + hex_padded(child.id()) +
+              "-0" + headers.at("x-b3-sampled"));
+  const std::string source{to_tag(Source::appsec)};
+  REQUIRE(headers.at("x-datadog-tags").find("_dd.p.ts=" + source) !=
+          std::string::npos);
+  REQUIRE(headers.at("tracestate").find(";t.ts:" + source) !=
+          std::string::npos);
+}
+
+TEST_SPAN("injected headers follow changes to the sampling decision") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  config.injection_styles = {PropagationStyle::DATADOG, PropagationStyle::W3C};
+  config.generate_128bit_trace_ids = false;
+
+  const auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  auto span = tracer.create_span();
+  span.trace_segment().override_sampling_priority(-1);
+  MockDictWriter dropped;
+  span.inject(dropped);
+  REQUIRE(dropped.items.at("x-datadog-sampling-priority") == "-1");
+  REQUIRE(dropped.items.count("x-datadog-tags") == 0);
+  REQUIRE(starts_with(dropped.items.at("tracestate"),
+                      "dd=s:-1;p:" + hex_padded(span.id())));
+
+  span.trace_segment().override_sampling_priority(2);
+  const auto child = span.create_child();
+  MockDictWriter kept;
+  child.inject(kept);
+  REQUIRE(kept.items.at("x-datadog-sampling-priority") == "2");
+  REQUIRE(kept.items.at("x-datadog-tags") == "_dd.p.dm=-4");
+  REQUIRE(kept.items.at("tracestate") ==
+          "dd=s:2;p:" + hex_padded(child.id()) + ";t.dm:-4");
+
+  span.set_source(Source::appsec);
+  MockDictWriter with_source;
+  child.inject(with_source);
+  const std::string source{to_tag(Source::appsec)};
+  REQUIRE(with_source.items.at("x-datadog-tags") ==
+          "_dd.p.dm=-4,_dd.p.ts=" + source);
+}
+
+TEST_SPAN("injecting many spans at once is like injecting each one") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = std::make_shared<MockCollector>();
+  config.logger = std::make_shared<MockLogger>();
+  config.injection_styles = {PropagationStyle::DATADOG, PropagationStyle::B3,
+                             PropagationStyle::W3C};
+
+  const auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  auto root = tracer.create_span();
+  auto other_root = tracer.create_span();
+  root.trace_segment().override_sampling_priority(2);
+  const auto first = root.create_child();
+  const auto second = root.create_child();
+  const auto third = other_root.create_child();
+
+  // The spans of `root`'s segment are not all consecutive.
+  MockDictWriter first_writer, second_writer, third_writer, root_writer;
+  const std::vector<std::pair<const Span*, MockDictWriter*>> injected{
+      {&first, &first_writer},
+      {&second, &second_writer},
+      {&third, &third_writer},
+      {&root, &root_writer}};
+  std::vector<Span::Injection> injections;
+  for (const auto& [span, writer] : injected) {
+    injections.push_back(Span::Injection{span, writer});
+  }
+  Span::inject_all(injections);
+
+  for (const auto& [span, writer] : injected) {
+    MockDictWriter expected;
+    span->inject(expected);
+    REQUIRE(writer->items == expected.items);
+    REQUIRE(writer->items.at("x-datadog-parent-id") ==
+            std::to_string(span->id()));
+  }
+  REQUIRE(first_writer.items.at("x-datadog-sampling-priority") == "2");
+}
+
 TEST_SPAN("injection can be disabled using the \"none\" style") {
   TracerConfig config;
   config.service = "testsvc";
@@ -0,0 +1,152 @@
+// These are tests for the recycling of `SpanData` objects after a collector is
+// done with them (see `span_recycler.h`).
+
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/http_clients.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "span_recycler.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_SPAN_RECYCLER(x) TEST_CASE(x, "[span_recycler]")
+
+namespace {
+
+// Discard the recycled spans of the calling thread and of the process-wide
+// pool, so that a test starts from none.
+void discard_recycled_spans() {
+  while (take_recycled_span()) {
+  }
+}
+
+}  // namespace
+
+TEST_SPAN_RECYCLER("recycled spans are reset and reused") {
+  discard_recycled_spans();
+
+  auto span = SpanData::make(nullptr);
+  span->span_id = 123;
+  span->name = "operation";
+  span->tags.emplace("foo", "bar");
+  span->numeric_tags.emplace("answer", 42.0);
+  span->error = true;
+  span->finished = true;
+  SpanData* const address = span.get();
+
+  std::vector<std::unique_ptr<SpanData>> spans;
+  spans.push_back(std::move(span));
+  recycle_spans(spans);
+  REQUIRE(spans.empty());
+  REQUIRE(recycled_span_count() == 1);
+
+  auto reused = SpanData::make(nullptr);
+  REQUIRE(reused.get() == address);
+  REQUIRE(recycled_span_count() == 0);
+  REQUIRE(reused->span_id == 0);
+  REQUIRE(reused->name.empty());
+  REQUIRE(reused->tags.empty());
+  REQUIRE(reused->numeric_tags.empty());
+  REQUIRE(!reused->error);
+  REQUIRE(!reused->finished);
+}
+
+TEST_SPAN_RECYCLER("spans allocated from an arena are not recycled") {
+  discard_recycled_spans();
+
+  Arena* arena = Arena::create();
+  std::vector<std::unique_ptr<SpanData>> spans;
+  spans.push_back(SpanData::make(arena));
+  arena->release();
+  recycle_spans(spans);
+  REQUIRE(spans.empty());
+  REQUIRE(recycled_span_count() == 0);
+}
+
+TEST_SPAN_RECYCLER("spans recycled by one thread are reused by another") {
+  discard_recycled_spans();
+
+  // More spans than a thread keeps, so that the rest go to the shared pool.
+  std::vector<std::unique_ptr<SpanData>> spans;
+  for (std::size_t i = 0; i < span_recycler_thread_capacity + 10; ++i) {
+    spans.push_back(SpanData::make(nullptr));
+  }
+  std::thread recycler{[&]() { recycle_spans(spans); }};
+  recycler.join();
+  REQUIRE(spans.empty());
+
+  REQUIRE(recycled_span_count() == 0);
+  auto span = take_recycled_span();
+  REQUIRE(span);
+  REQUIRE(recycled_span_count() == 9);
+}
+
+TEST_SPAN_RECYCLER("the Datadog Agent collector recycles the spans it sends") {
+  discard_recycled_spans();
+
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  const auto http_client = std::make_shared<MockHTTPClient>();
+  http_client->response_status = 200;
+  http_client->response_body << "{}";
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = std::make_shared<MockLogger>();
+  config.agent.event_scheduler = event_scheduler;
+  config.agent.http_client = http_client;
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto root = tracer.create_span();
+    auto child = root.create_child();
+  }
+  event_scheduler->event_callback();
+  REQUIRE(http_client->request_body.size() > 0);
+  REQUIRE(recycled_span_count() == 2);
+
+  { auto root = tracer.create_span(); }
+  REQUIRE(recycled_span_count() == 1);
+}
+
+TEST_SPAN_RECYCLER("Tracer::warm_up fills the pool of spans") {
+  discard_recycled_spans();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.logger = std::make_shared<MockLogger>();
+  config.agent.event_scheduler = std::make_shared<MockEventScheduler>();
+  config.agent.http_client = std::make_shared<MockHTTPClient>();
+  config.agent.remote_configuration_enabled = false;
+  config.telemetry.enabled = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  tracer.warm_up(4, 8);
+  std::size_t reserved = 0;
+  while (take_recycled_span()) {
+    ++reserved;
+  }
+  REQUIRE(reserved == 32);
+
+  // The pool is bounded.
+  tracer.warm_up(1000, 1000);
+  reserved = 0;
+  while (take_recycled_span()) {
+    ++reserved;
+  }
+  REQUIRE(reserved == span_recycler_capacity);
+}
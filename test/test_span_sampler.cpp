@@ -25,9 +25,8 @@ std::ostream& operator<<(std::ostream& stream, Optional<double> value) {
   return stream << "null";
 }
 
-std::ostream& operator<<(
-    std::ostream& stream,
-    const std::unordered_map<std::string, double>& numeric_tags) {
+std::ostream& operator<<(std::ostream& stream,
+                         const SpanNumericTags& numeric_tags) {
   stream << "{";
   auto iter = numeric_tags.begin();
   const auto end = numeric_tags.end();
@@ -0,0 +1,108 @@
+// These are tests for `SchemaTags` (see `span_schema.h`), and for how
+// `Span::set_tags` sets them on a span.
+
+#include <datadog/span.h>
+#include <datadog/span_schema.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_SPAN_SCHEMA(x) TEST_CASE(x, "[span_schema]")
+
+namespace {
+
+struct QueueSchema {
+  static constexpr StringView keys[] = {"component", "queue.name",
+                                        "queue.depth"};
+  enum Slot : std::size_t { COMPONENT, QUEUE_NAME, QUEUE_DEPTH };
+};
+
+Tracer make_tracer(const std::shared_ptr<MockCollector>& collector) {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.max_tag_value_length = 8;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  return Tracer{*finalized};
+}
+
+}  // namespace
+
+TEST_SPAN_SCHEMA("slots") {
+  SchemaTags<QueueSchema> tags;
+  REQUIRE(tags.present() == 0);
+  tags.set<QueueSchema::QUEUE_NAME>("jobs");
+  tags.set<QueueSchema::QUEUE_DEPTH>(-42);
+  REQUIRE(!tags.has<QueueSchema::COMPONENT>());
+  REQUIRE(tags.has<QueueSchema::QUEUE_NAME>());
+  REQUIRE(tags.present() == 0b110);
+  REQUIRE(tags.values()[QueueSchema::QUEUE_NAME] == "jobs");
+  REQUIRE(tags.values()[QueueSchema::QUEUE_DEPTH] == "-42");
+
+  tags.set<QueueSchema::QUEUE_DEPTH>(std::uint64_t(18446744073709551615u));
+  REQUIRE(tags.values()[QueueSchema::QUEUE_DEPTH] == "18446744073709551615");
+  tags.clear<QueueSchema::QUEUE_NAME>();
+  REQUIRE(tags.present() == 0b100);
+}
+
+TEST_SPAN_SCHEMA("schema tags are set on spans") {
+  const auto collector = std::make_shared<MockCollector>();
+  auto tracer = make_tracer(collector);
+
+  const bool has_tags = GENERATE(false, true);
+  CAPTURE(has_tags);
+  {
+    auto span = tracer.create_span();
+    if (has_tags) {
+      span.set_tag("queue.name", "old");
+      span.set_tag("other", "value");
+    }
+    SchemaTags<QueueSchema> tags;
+    tags.set<QueueSchema::COMPONENT>("queue-client");
+    tags.set<QueueSchema::QUEUE_NAME>("jobs");
+    span.set_tags(tags);
+    REQUIRE(span.lookup_tag("queue.name") == StringView("jobs"));
+    REQUIRE(!span.lookup_tag("queue.depth"));
+
+    span.set_tag("queue.name", "retries");
+  }
+
+  const auto& span = collector->first_span();
+  REQUIRE(span.tags.count("queue.name") == 1);
+  REQUIRE(span.tags.at("queue.name") == "retries");
+  // Values are truncated as `set_tag` truncates them.
+  REQUIRE(span.tags.at("component") == "queue-cl");
+  REQUIRE(span.tags.count("queue.depth") == 0);
+  REQUIRE(span.tags.count("other") == (has_tags ? 1 : 0));
+}
+
+TEST_SPAN_SCHEMA("well-known schemas") {
+  const auto collector = std::make_shared<MockCollector>();
+  auto tracer = make_tracer(collector);
+  {
+    auto span = tracer.create_span();
+    SchemaTags<HttpClientSchema> tags;
+    tags.set<HttpClientSchema::METHOD>("GET");
+    tags.set<HttpClientSchema::STATUS_CODE>(200);
+    tags.set<HttpClientSchema::PORT>(443);
+    span.set_tags(tags);
+  }
+
+  const auto& span = collector->first_span();
+  REQUIRE(span.tags.at("http.method") == "GET");
+  REQUIRE(span.tags.at("http.status_code") == "200");
+  REQUIRE(span.tags.at("network.destination.port") == "443");
+  REQUIRE(span.tags.count("http.url") == 0);
+}
@@ -0,0 +1,158 @@
+#include <datadog/error.h>
+#include <datadog/spill_file.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define SPILL_FILE_TEST(x) TEST_CASE(x, "[spill_file]")
+
+namespace {
+
+// A path for a spill file that is removed when the `TemporaryPath` is
+// destroyed.
+class TemporaryPath {
+  std::filesystem::path path_;
+
+ public:
+  TemporaryPath()
+      : path_(std::filesystem::temp_directory_path() /
+              ("dd-trace-cpp-spill-file-test-" +
+               std::to_string(::getpid()))) {
+    std::filesystem::remove(path_);
+  }
+  ~TemporaryPath() { std::filesystem::remove(path_); }
+
+  std::string string() const { return path_.string(); }
+};
+
+}  // namespace
+
+SPILL_FILE_TEST("spilled records are removed in the order appended") {
+  const TemporaryPath path;
+  auto opened = SpillFile::open(path.string(), 64);
+  REQUIRE(opened);
+  auto& file = **opened;
+  REQUIRE(file.capacity() == 64);
+  REQUIRE(file.empty());
+
+  std::string record;
+  REQUIRE_FALSE(file.pop(record));
+
+  // Each record takes four bytes more than its size, so that the ring wraps
+  // around its end several times.
+  for (int i = 0; i < 20; ++i) {
+    const std::string first = "first " + std::to_string(i);
+    const std::string second(static_cast<std::size_t>(i), 'x');
+    REQUIRE(file.push(first));
+    REQUIRE(file.push(second));
+    REQUIRE(file.pop(record));
+    REQUIRE(record == first);
+    REQUIRE(file.pop(record));
+    REQUIRE(record == second);
+    REQUIRE(file.empty());
+  }
+  REQUIRE(file.dropped() == 0);
+}
+
+SPILL_FILE_TEST("the oldest records are removed to make room") {
+  const TemporaryPath path;
+  auto opened = SpillFile::open(path.string(), 32);
+  REQUIRE(opened);
+  auto& file = **opened;
+
+  REQUIRE(file.push(std::string(8, 'a')));
+  REQUIRE(file.push(std::string(8, 'b')));
+  REQUIRE(file.push(std::string(12, 'c')));
+  REQUIRE(file.dropped() == 1);
+  // A record larger than the file is dropped, and the others are kept.
+  REQUIRE_FALSE(file.push(std::string(29, 'd')));
+  REQUIRE(file.dropped() == 2);
+
+  std::string record;
+  REQUIRE(file.pop(record));
+  REQUIRE(record == std::string(8, 'b'));
+  REQUIRE(file.pop(record));
+  REQUIRE(record == std::string(12, 'c'));
+  REQUIRE_FALSE(file.pop(record));
+}
+
+SPILL_FILE_TEST("records are kept when the file is opened again") {
+  const TemporaryPath path;
+  {
+    auto opened = SpillFile::open(path.string(), 64);
+    REQUIRE(opened);
+    REQUIRE((*opened)->push("first"));
+    REQUIRE((*opened)->push("second"));
+  }
+
+  std::string record;
+  SECTION("with the same capacity") {
+    auto opened = SpillFile::open(path.string(), 64);
+    REQUIRE(opened);
+    REQUIRE((*opened)->pop(record));
+    REQUIRE(record == "first");
+    REQUIRE((*opened)->pop(record));
+    REQUIRE(record == "second");
+    REQUIRE_FALSE((*opened)->pop(record));
+  }
+
+  SECTION("but not with a different capacity") {
+    auto opened = SpillFile::open(path.string(), 128);
+    REQUIRE(opened);
+    REQUIRE((*opened)->capacity() == 128);
+    REQUIRE((*opened)->empty());
+  }
+}
+
+SPILL_FILE_TEST("a lock left held by an earlier process is taken over") {
+  // The process that last wrote the file exited while holding its lock, and
+  // had the same process ID as this one, as can happen to a file that
+  // outlives a container.  The lock is at offset 8 of the file, and records
+  // the holder's process ID.
+  const TemporaryPath path;
+  {
+    auto opened = SpillFile::open(path.string(), 64);
+    REQUIRE(opened);
+    REQUIRE((*opened)->push("first"));
+  }
+  {
+    std::fstream file(path.string(),
+                      std::ios::in | std::ios::out | std::ios::binary);
+    REQUIRE(file);
+    const std::int32_t owner[] = {std::int32_t(::getpid()), 0};
+    file.seekp(8);
+    file.write(reinterpret_cast<const char*>(owner), sizeof owner);
+    REQUIRE(file);
+  }
+
+  auto opened = SpillFile::open(path.string(), 64);
+  REQUIRE(opened);
+  auto& file = **opened;
+  // The records that were in the file when the lock was taken over are
+  // discarded, since they might be incomplete.
+  REQUIRE(file.push("second"));
+  std::string record;
+  REQUIRE(file.pop(record));
+  REQUIRE(record == "second");
+  REQUIRE_FALSE(file.pop(record));
+}
+
+SPILL_FILE_TEST("spill file capacity must hold a record") {
+  const TemporaryPath path;
+  auto opened = SpillFile::open(path.string(), 0);
+  REQUIRE_FALSE(opened);
+  REQUIRE(opened.error().code == Error::SPILL_FILE_INVALID_CAPACITY);
+}
+
+SPILL_FILE_TEST("spill file must be in a writable place") {
+  auto opened = SpillFile::open("/nonexistent/directory/spill", 64);
+  REQUIRE_FALSE(opened);
+  REQUIRE(opened.error().code == Error::SPILL_FILE_UNAVAILABLE);
+}
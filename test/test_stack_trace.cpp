@@ -0,0 +1,102 @@
+// These are tests for the capture of call stacks and their later
+// symbolization (see `stack_trace.h`), and for how spans use them via
+// `Span::capture_error_stack`.
+
+#include <datadog/span.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "span_data.h"
+#include "stack_trace.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_STACK_TRACE(x) TEST_CASE(x, "[stack_trace]")
+
+TEST_STACK_TRACE("captured stacks are symbolized one frame per line") {
+  CapturedStack stack;
+  capture_stack(stack);
+  REQUIRE(stack.size > 0);
+  REQUIRE(stack.size <= CapturedStack::max_frames);
+
+  std::string description;
+  symbolize(description, stack);
+  REQUIRE(std::size_t(std::count(description.begin(), description.end(),
+                                 '\n')) == stack.size);
+  REQUIRE(description.rfind("#0 ", 0) == 0);
+  REQUIRE(symbol_cache_size() > 0);
+
+  // The descriptions are cached, so describing the stack again yields the
+  // same text.
+  std::string again;
+  symbolize(again, stack);
+  REQUIRE(again == description);
+}
+
+TEST_STACK_TRACE("copying a captured stack pointer copies the stack") {
+  CapturedStackPtr original;
+  REQUIRE(!original);
+  original.get_or_create().size = 1;
+  CapturedStackPtr copy{original};
+  REQUIRE(copy);
+  REQUIRE(&*copy != &*original);
+  REQUIRE(copy->size == 1);
+}
+
+TEST_STACK_TRACE("error stacks are symbolized when the span is encoded") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  SECTION("a captured stack is encoded as the error.stack tag") {
+    {
+      auto span = tracer.create_span();
+      span.capture_error_stack();
+      REQUIRE(span.error());
+    }
+    const auto& span = collector->first_span();
+    REQUIRE(span.error);
+    REQUIRE(span.tags.count("error.stack") == 0);
+    const std::string* const stack = symbolized_error_stack(span);
+    REQUIRE(stack);
+    REQUIRE(stack->rfind("#0 ", 0) == 0);
+
+    std::string encoded;
+    REQUIRE(msgpack_encode(encoded, span));
+    REQUIRE(encoded.find("error.stack") != std::string::npos);
+  }
+
+  SECTION("an explicit error stack takes precedence") {
+    {
+      auto span = tracer.create_span();
+      span.capture_error_stack();
+      span.set_error_stack("explicit");
+    }
+    const auto& span = collector->first_span();
+    REQUIRE(symbolized_error_stack(span) == nullptr);
+    REQUIRE(span.tags.at("error.stack") == "explicit");
+  }
+
+  SECTION("clearing the error discards the captured stack") {
+    {
+      auto span = tracer.create_span();
+      span.capture_error_stack();
+      span.set_error(false);
+    }
+    const auto& span = collector->first_span();
+    REQUIRE(!span.error);
+    REQUIRE(symbolized_error_stack(span) == nullptr);
+  }
+}
@@ -0,0 +1,182 @@
+#include <datadog/clock.h>
+#include <datadog/runtime_id.h>
+#include <datadog/span_data.h>
+#include <datadog/stats_concentrator.h>
+#include <datadog/tracer_signature.h>
+
+#include <chrono>
+#include <cstdint>
+#include <datadog/json.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define STATS_CONCENTRATOR_TEST(x) TEST_CASE(x, "[stats_concentrator]")
+
+namespace {
+
+// The start of a stats bucket, so that spans starting there end in it.
+const TimePoint bucket_start{
+    std::chrono::system_clock::time_point(std::chrono::hours(400'000)),
+    std::chrono::steady_clock::time_point()};
+
+std::unique_ptr<SpanData> make_span(std::uint64_t id, std::uint64_t parent_id,
+                                    std::string service, std::string name) {
+  auto span = std::make_unique<SpanData>();
+  span->span_id = id;
+  span->parent_id = parent_id;
+  span->service = std::move(service);
+  span->name = std::move(name);
+  span->resource = "resource";
+  span->start = bucket_start;
+  span->duration = 5ms;
+  return span;
+}
+
+TimePoint after(Duration offset) {
+  TimePoint time = bucket_start;
+  time += offset;
+  return time;
+}
+
+TracerSignature signature() {
+  return TracerSignature{RuntimeID::generate(), "testsvc", "test"};
+}
+
+nlohmann::json flush_one(StatsConcentrator& concentrator) {
+  auto payloads = concentrator.flush(bucket_start, true);
+  REQUIRE(payloads);
+  REQUIRE(payloads->size() == 1);
+  return nlohmann::json::from_msgpack(payloads->front());
+}
+
+}  // namespace
+
+STATS_CONCENTRATOR_TEST("top-level, measured, and client spans are counted") {
+  StatsConcentrator concentrator{signature()};
+
+  std::vector<std::unique_ptr<SpanData>> chunk;
+  chunk.push_back(make_span(1, 0, "web", "request"));
+  chunk.back()->tags["http.status_code"] = "404";
+  // Not counted: neither top-level, measured, nor of a counted kind.
+  chunk.push_back(make_span(2, 1, "web", "internal"));
+  chunk.push_back(make_span(3, 1, "web", "measured"));
+  chunk.back()->numeric_tags["_dd.measured"] = 1;
+  chunk.push_back(make_span(4, 1, "web", "call"));
+  chunk.back()->tags["span.kind"] = "client";
+  chunk.back()->error = true;
+  chunk.push_back(make_span(5, 4, "database", "query"));
+  concentrator.add(chunk);
+
+  const auto payload = flush_one(concentrator);
+  REQUIRE(payload["Service"] == "testsvc");
+  REQUIRE(payload["Lang"] == "cpp");
+  REQUIRE(payload["Sequence"] == 1);
+  REQUIRE(payload["Stats"].size() == 1);
+  const auto& bucket = payload["Stats"][0];
+  REQUIRE(bucket["Duration"] == 10'000'000'000ULL);
+  REQUIRE(bucket["Start"] ==
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              bucket_start.wall.time_since_epoch())
+              .count());
+
+  std::map<std::string, nlohmann::json> groups;
+  for (const auto& group : bucket["Stats"]) {
+    groups[group["Name"].get<std::string>()] = group;
+  }
+  REQUIRE(groups.size() == 4);
+  REQUIRE(groups.count("internal") == 0);
+
+  const auto& request = groups["request"];
+  REQUIRE(request["Hits"] == 1);
+  REQUIRE(request["TopLevelHits"] == 1);
+  REQUIRE(request["Errors"] == 0);
+  REQUIRE(request["Duration"] == 5'000'000);
+  REQUIRE(request["HTTPStatusCode"] == 404);
+  REQUIRE(request["IsTraceRoot"] == 1);
+
+  REQUIRE(groups["measured"]["TopLevelHits"] == 0);
+  REQUIRE(groups["measured"]["IsTraceRoot"] == 2);
+
+  const auto& call = groups["call"];
+  REQUIRE(call["SpanKind"] == "client");
+  REQUIRE(call["Hits"] == 1);
+  REQUIRE(call["TopLevelHits"] == 0);
+  REQUIRE(call["Errors"] == 1);
+  REQUIRE(call["ErrorSummary"].is_binary());
+
+  REQUIRE(groups["query"]["Service"] == "database");
+  REQUIRE(groups["query"]["TopLevelHits"] == 1);
+}
+
+STATS_CONCENTRATOR_TEST("buckets are flushed once they end") {
+  StatsConcentrator concentrator{signature()};
+  std::vector<std::unique_ptr<SpanData>> chunk;
+  chunk.push_back(make_span(1, 0, "web", "request"));
+  concentrator.add(chunk);
+  concentrator.add(chunk);
+
+  auto payloads = concentrator.flush(after(9s), false);
+  REQUIRE(payloads);
+  REQUIRE(payloads->empty());
+
+  payloads = concentrator.flush(after(10s), false);
+  REQUIRE(payloads);
+  REQUIRE(payloads->size() == 1);
+  const auto payload = nlohmann::json::from_msgpack(payloads->front());
+  REQUIRE(payload["Stats"][0]["Stats"][0]["Hits"] == 2);
+
+  payloads = concentrator.flush(after(20s), true);
+  REQUIRE(payloads);
+  REQUIRE(payloads->empty());
+}
+
+STATS_CONCENTRATOR_TEST("payloads are divided by environment and version") {
+  StatsConcentrator concentrator{signature()};
+  std::vector<std::unique_ptr<SpanData>> chunk;
+  chunk.push_back(make_span(1, 0, "web", "request"));
+  chunk.back()->tags["env"] = "prod";
+  chunk.back()->tags["version"] = "1.0";
+  concentrator.add(chunk);
+  chunk.back()->tags["version"] = "2.0";
+  concentrator.add(chunk);
+
+  auto payloads = concentrator.flush(bucket_start, true);
+  REQUIRE(payloads);
+  REQUIRE(payloads->size() == 2);
+  const auto first = nlohmann::json::from_msgpack((*payloads)[0]);
+  const auto second = nlohmann::json::from_msgpack((*payloads)[1]);
+  REQUIRE(first["Env"] == "prod");
+  REQUIRE(first["Version"] == "1.0");
+  REQUIRE(second["Version"] == "2.0");
+  REQUIRE(second["Sequence"] == 2);
+}
+
+STATS_CONCENTRATOR_TEST("latency sketch is a DDSketch") {
+  StatsConcentrator::LatencySketch sketch;
+  sketch.add(0);
+  sketch.add(1000);
+  sketch.add(1001);
+  sketch.add(2000);
+  REQUIRE(sketch.count() == 4);
+
+  std::string encoded;
+  sketch.encode(encoded);
+  // The mapping (field 1) is a 9 byte message holding gamma (field 1, a
+  // double), and the zero count (field 4, a double) is last.
+  REQUIRE(encoded.substr(0, 3) == std::string("\x0a\x09\x09", 3));
+  REQUIRE(encoded[encoded.size() - 9] == '\x21');
+  // The positive values (field 2) follow the mapping.
+  REQUIRE(encoded[11] == '\x12');
+
+  StatsConcentrator::LatencySketch empty;
+  encoded.clear();
+  empty.encode(encoded);
+  REQUIRE(encoded.size() == 11);
+}
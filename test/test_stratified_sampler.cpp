@@ -0,0 +1,166 @@
+#include <datadog/clock.h>
+#include <datadog/error.h>
+#include <datadog/hex.h>
+#include <datadog/sampling_decision.h>
+#include <datadog/sampling_mechanism.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/span_config.h>
+#include <datadog/span_data.h>
+#include <datadog/stratified_sampler.h>
+#include <datadog/tags.h>
+#include <datadog/trace_sampler.h>
+#include <datadog/trace_sampler_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "mocks/collectors.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define STRATIFIED_SAMPLER_TEST(x) TEST_CASE(x, "[stratified_sampler]")
+
+STRATIFIED_SAMPLER_TEST("rare pairs are kept and busy pairs share the rest") {
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  StratifiedSampler sampler{clock, 100};
+
+  // In the first window, "busy" has 1000 root spans, and each of ten rare
+  // resources has one.
+  for (int i = 0; i < 1000; ++i) {
+    sampler.sample_rate("svc", "busy");
+  }
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(sampler.sample_rate("svc", "rare" + std::to_string(i)).value() ==
+            1.0);
+  }
+  current_time += std::chrono::seconds(1);
+
+  // The eleven pairs split the 89 traces per second that remain.
+  REQUIRE(sampler.sample_rate("svc", "busy").value() == 1.0);
+  REQUIRE(sampler.sample_rate("svc", "busy").value() ==
+          Approx(89.0 / 11 / 1000));
+  REQUIRE(sampler.sample_rate("svc", "rare0").value() == 1.0);
+  REQUIRE(sampler.sample_rate("other", "busy").value() == 1.0);
+}
+
+STRATIFIED_SAMPLER_TEST("the target bounds the pairs that are kept") {
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  StratifiedSampler sampler{clock, 10};
+
+  for (int i = 0; i < 10'000; ++i) {
+    sampler.sample_rate("svc", "/users/" + std::to_string(i));
+  }
+  current_time += std::chrono::seconds(1);
+
+  // The previous window used up the target, so only the first ten pairs of
+  // this window are kept.
+  for (int i = 0; i < 20; ++i) {
+    const double rate =
+        sampler.sample_rate("svc", "/items/" + std::to_string(i)).value();
+    REQUIRE(rate == (i < 10 ? 1.0 : 0.0));
+  }
+
+  // After a pause, the whole target is available to a pair again.
+  current_time += std::chrono::seconds(5);
+  double rate = 0;
+  for (int i = 0; i < 20; ++i) {
+    rate = sampler.sample_rate("svc", "/items/0").value();
+  }
+  REQUIRE(rate == Approx(10.0 / 20));
+}
+
+STRATIFIED_SAMPLER_TEST("trace sampler uses stratified rates") {
+  TraceSamplerConfig config;
+  config.stratified_target_per_second = 1;
+  TraceSamplerConfig::Rule rule;
+  rule.service = "ruled";
+  rule.sample_rate = 1.0;
+  config.rules.push_back(rule);
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+
+  TimePoint current_time;
+  const Clock clock = [&current_time]() { return current_time; };
+  TraceSampler sampler{*finalized, clock};
+  REQUIRE(sampler.config_json()["stratified_target_per_second"] == 1.0);
+
+  SpanData span;
+  span.service = "testsvc";
+  span.resource = "GET /";
+  span.trace_id.low = 12345;
+  auto decision = sampler.decide(span);
+  REQUIRE(decision.mechanism == int(SamplingMechanism::RULE));
+  REQUIRE(decision.priority == int(SamplingPriority::USER_KEEP));
+  REQUIRE(decision.configured_rate == Rate::one());
+  REQUIRE(decision.stratum ==
+          StratifiedSampler::stratum(span.service, span.resource));
+
+  // In the next window, the target is used up by the first resource seen, so
+  // that another resource is dropped.
+  current_time += std::chrono::seconds(1);
+  REQUIRE(sampler.decide(span).priority == int(SamplingPriority::USER_KEEP));
+  span.resource = "GET /health";
+  decision = sampler.decide(span);
+  REQUIRE(decision.mechanism == int(SamplingMechanism::RULE));
+  REQUIRE(decision.priority == int(SamplingPriority::USER_DROP));
+  REQUIRE(decision.stratum ==
+          StratifiedSampler::stratum("testsvc", "GET /health"));
+
+  span.service = "ruled";
+  decision = sampler.decide(span);
+  REQUIRE(decision.mechanism == int(SamplingMechanism::RULE));
+  REQUIRE_FALSE(decision.stratum);
+}
+
+STRATIFIED_SAMPLER_TEST("stratified decisions tag the local root") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.trace_sampler.stratified_target_per_second = 1;
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    SpanConfig span_config;
+    span_config.resource = "GET /";
+    auto root = tracer.create_span(span_config);
+  }
+
+  const SpanData& root = collector->first_span();
+  REQUIRE(root.tags.at(tags::internal::decision_maker) == "-3");
+  REQUIRE(root.tags.at(tags::internal::sampling_stratum) ==
+          hex_padded(StratifiedSampler::stratum("testsvc", "GET /")));
+  REQUIRE(root.numeric_tags.at(tags::internal::rule_sample_rate) == 1.0);
+}
+
+STRATIFIED_SAMPLER_TEST("stratified sampling configuration") {
+  TraceSamplerConfig config;
+
+  SECTION("target must be positive") {
+    auto target = GENERATE(0.0, -1.0, std::nan(""));
+    config.stratified_target_per_second = target;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code ==
+            Error::STRATIFIED_SAMPLING_TARGET_OUT_OF_RANGE);
+  }
+
+  SECTION("cannot be combined with adaptive sampling") {
+    config.stratified_target_per_second = 10;
+    config.adaptive_target_per_second = 10;
+    auto finalized = finalize_config(config);
+    REQUIRE_FALSE(finalized);
+    REQUIRE(finalized.error().code == Error::ADAPTIVE_AND_STRATIFIED_SAMPLING);
+  }
+}
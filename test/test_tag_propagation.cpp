@@ -0,0 +1,58 @@
+#include <datadog/error.h>
+#include <datadog/tag_propagation.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TAG_PROPAGATION_TEST(x) TEST_CASE(x, "[tag_propagation]")
+
+TAG_PROPAGATION_TEST("decoding keeps the tags with a prefix as views") {
+  const std::string header = "foo=bar,_dd.p.a=1,_dd.p.b=x=y,_dd.pb=2,_dd.p.c=";
+  std::vector<std::pair<StringView, StringView>> tags;
+  REQUIRE(decode_tags(header, "_dd.p.", tags));
+  REQUIRE(tags.size() == 3);
+  CHECK(tags[0].first == "_dd.p.a");
+  CHECK(tags[0].second == "1");
+  CHECK(tags[1].first == "_dd.p.b");
+  CHECK(tags[1].second == "x=y");
+  CHECK(tags[2].first == "_dd.p.c");
+  CHECK(tags[2].second == "");
+  // The views refer to the header.
+  CHECK(tags[0].first.data() == header.data() + 8);
+}
+
+TAG_PROPAGATION_TEST("decoding fails if a tag is missing its equal sign") {
+  auto input = GENERATE(as<std::string>{}, "foo", "a=b,,c=d", ",a=b",
+                        "a=b,_dd.p.c");
+  CAPTURE(input);
+  std::vector<std::pair<StringView, StringView>> tags;
+  auto result = decode_tags(input, "_dd.p.", tags);
+  REQUIRE_FALSE(result);
+  REQUIRE(result.error().code == Error::MALFORMED_TRACE_TAGS);
+  REQUIRE_FALSE(decode_tags(input));
+}
+
+TAG_PROPAGATION_TEST("encoding stops copying once the maximum size is passed") {
+  const std::vector<std::pair<std::string, std::string>> tags{
+      {"_dd.p.a", "1"}, {"_dd.p.b", "22"}, {"_dd.p.c", "333"}};
+  // "_dd.p.a=1,_dd.p.b=22,_dd.p.c=333"
+  const std::size_t encoded_size = encode_tags(tags).size();
+  REQUIRE(encoded_size == 32);
+
+  std::string destination = "prefix";
+  REQUIRE(append_tags(destination, TraceTagsView{&tags}, 32) == 32);
+  REQUIRE(destination == "prefix_dd.p.a=1,_dd.p.b=22,_dd.p.c=333");
+
+  destination = "prefix";
+  REQUIRE(append_tags(destination, TraceTagsView{&tags}, 31) == 32);
+  REQUIRE(destination == "prefix");
+
+  destination.clear();
+  REQUIRE(append_tags(destination, TraceTagsView{&tags}, 0) == 32);
+  REQUIRE(destination.empty());
+}
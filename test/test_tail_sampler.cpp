@@ -0,0 +1,247 @@
+// These are tests for `TailSampler`, which makes the sampling decisions of
+// traces that are wholly within this process after they finish.
+
+#include <datadog/sampling_mechanism.h>
+#include <datadog/sampling_priority.h>
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/span_data.h>
+#include <datadog/tags.h>
+#include <datadog/trace_segment.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "mocks/collectors.h"
+#include "mocks/dict_writers.h"
+#include "mocks/event_schedulers.h"
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define TEST_TAIL_SAMPLER(x) TEST_CASE(x, "[tail_sampler]")
+
+namespace {
+
+// Finish a trace having a root span that lasted the specified `duration`, and
+// optionally that had an error or that has the specified `resource`.
+void finish_trace(Tracer& tracer, std::chrono::steady_clock::duration duration,
+                  bool error = false, const std::string& resource = "") {
+  SpanConfig span_config;
+  if (!resource.empty()) {
+    span_config.resource = resource;
+  }
+  auto root = tracer.create_span(span_config);
+  root.set_error(error);
+  root.create_child();
+  root.set_end_time(root.start_time().tick + duration);
+}
+
+int priority_of(const TraceChunk& chunk) {
+  REQUIRE(chunk.sampling_priority);
+  REQUIRE(chunk.spans.front()->numeric_tags.at(
+              tags::internal::sampling_priority) == *chunk.sampling_priority);
+  return *chunk.sampling_priority;
+}
+
+}  // namespace
+
+TEST_TAIL_SAMPLER("traces are decided when the window elapses") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.tail_sampling_enabled = true;
+  config.tail_sampling_window_milliseconds = 500;
+  config.tail_sampling_latency_percentile = 100;
+  config.tail_sampling_max_per_second = 0;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  REQUIRE(event_scheduler->recurrence_interval == 500ms);
+
+  SECTION("errors and slow traces are kept, and the rest dropped") {
+    finish_trace(tracer, 1s, true);
+    finish_trace(tracer, 2s);
+    finish_trace(tracer, 1s);
+    REQUIRE(collector->chunks.empty());
+
+    event_scheduler->event_callback();
+    REQUIRE(collector->chunks.size() == 3);
+    const auto& errored = collector->chunks[0];
+    const auto& slow = collector->chunks[1];
+    const auto& other = collector->chunks[2];
+    REQUIRE(priority_of(errored) == int(SamplingPriority::AUTO_KEEP));
+    REQUIRE(priority_of(slow) == int(SamplingPriority::AUTO_KEEP));
+    REQUIRE(priority_of(other) == int(SamplingPriority::AUTO_DROP));
+    // Both spans of each trace are sent together.
+    REQUIRE(other.spans.size() == 2);
+
+    const std::string decision_maker =
+        "-" + std::to_string(int(SamplingMechanism::RULE));
+    REQUIRE(errored.spans.front()->tags.at(tags::internal::decision_maker) ==
+            decision_maker);
+    REQUIRE(slow.spans.front()->tags.at(tags::internal::decision_maker) ==
+            decision_maker);
+    REQUIRE(other.spans.front()->tags.count(tags::internal::decision_maker) ==
+            0);
+    const auto& reason = tags::internal::tail_sampling_reason;
+    REQUIRE(errored.spans.front()->tags.at(reason) == "error");
+    REQUIRE(slow.spans.front()->tags.at(reason) == "latency");
+    REQUIRE(other.spans.front()->tags.count(reason) == 0);
+  }
+
+  SECTION("traces are slow compared to their own resource") {
+    finish_trace(tracer, 10s, false, "batch");
+    finish_trace(tracer, 1s, false, "query");
+    finish_trace(tracer, 10ms, false, "query");
+    event_scheduler->event_callback();
+
+    REQUIRE(collector->chunks.size() == 3);
+    REQUIRE(priority_of(collector->chunks[0]) ==
+            int(SamplingPriority::AUTO_KEEP));
+    // Slower than every other "query", though faster than "batch".
+    REQUIRE(priority_of(collector->chunks[1]) ==
+            int(SamplingPriority::AUTO_KEEP));
+    REQUIRE(priority_of(collector->chunks[2]) ==
+            int(SamplingPriority::AUTO_DROP));
+  }
+
+  SECTION("propagated traces are sampled as usual") {
+    {
+      auto root = tracer.create_span();
+      MockDictWriter writer;
+      root.inject(writer);
+    }
+    // The trace sampler decided the trace, so it was sent right away.
+    REQUIRE(collector->chunks.size() == 1);
+  }
+
+  SECTION("manually decided traces are sampled as usual") {
+    {
+      auto root = tracer.create_span();
+      root.trace_segment().override_sampling_priority(
+          SamplingPriority::USER_DROP);
+    }
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(priority_of(collector->chunks.front()) ==
+            int(SamplingPriority::USER_DROP));
+  }
+}
+
+TEST_TAIL_SAMPLER("the rest of the traces are limited") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.tail_sampling_enabled = true;
+  config.tail_sampling_latency_percentile = 100;
+  config.tail_sampling_max_per_second = 1;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  finish_trace(tracer, 2s);
+  finish_trace(tracer, 1s);
+  finish_trace(tracer, 1s);
+  event_scheduler->event_callback();
+
+  REQUIRE(collector->chunks.size() == 3);
+  // The slowest trace is kept regardless of the limiter, which then allows
+  // one of the others.
+  REQUIRE(priority_of(collector->chunks[0]) ==
+          int(SamplingPriority::AUTO_KEEP));
+  REQUIRE(priority_of(collector->chunks[1]) ==
+          int(SamplingPriority::AUTO_KEEP));
+  REQUIRE(priority_of(collector->chunks[2]) ==
+          int(SamplingPriority::AUTO_DROP));
+  REQUIRE(collector->chunks[1].spans.front()->tags.at(
+              tags::internal::tail_sampling_reason) == "limit");
+}
+
+TEST_TAIL_SAMPLER("a full buffer is decided before the window elapses") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.event_scheduler = std::make_shared<MockEventScheduler>();
+  config.tail_sampling_enabled = true;
+  config.tail_sampling_max_buffered_bytes = 1;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  finish_trace(tracer, 1s);
+  REQUIRE(collector->chunks.size() == 1);
+}
+
+TEST_TAIL_SAMPLER("buffered traces are decided when the tracer is destroyed") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  const auto event_scheduler = std::make_shared<MockEventScheduler>();
+  config.event_scheduler = event_scheduler;
+  config.tail_sampling_enabled = true;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  {
+    Tracer tracer{*finalized};
+    finish_trace(tracer, 1s);
+    REQUIRE(collector->chunks.empty());
+  }
+  REQUIRE(event_scheduler->cancelled);
+  REQUIRE(collector->chunks.size() == 1);
+}
+
+TEST_TAIL_SAMPLER("invalid configuration") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.tail_sampling_enabled = true;
+
+  SECTION("window") {
+    config.tail_sampling_window_milliseconds = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::TAIL_SAMPLING_INVALID_WINDOW);
+  }
+
+  SECTION("buffer limit") {
+    config.tail_sampling_max_buffered_bytes = 0;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::TAIL_SAMPLING_INVALID_BUFFER_LIMIT);
+  }
+
+  SECTION("percentile") {
+    config.tail_sampling_latency_percentile = 101;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::TAIL_SAMPLING_INVALID_PERCENTILE);
+  }
+
+  SECTION("rate") {
+    config.tail_sampling_max_per_second = -1;
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code == Error::TAIL_SAMPLING_INVALID_RATE);
+  }
+}
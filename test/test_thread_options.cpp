@@ -0,0 +1,92 @@
+#include <datadog/datadog_agent_config.h>
+#include <datadog/error.h>
+#include <datadog/thread_options.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "mocks/loggers.h"
+#include "test.h"
+#include "thread_generator.h"
+#include "threaded_event_scheduler.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace datadog::tracing;
+
+#define THREAD_OPTIONS_TEST(x) TEST_CASE(x, "[thread_options]")
+
+THREAD_OPTIONS_TEST("invalid thread options") {
+  ThreadOptions options;
+  SECTION("negative CPU") { options.cpus = {0, -1}; }
+  SECTION("nice value too low") { options.nice = -21; }
+  SECTION("nice value too high") { options.nice = 20; }
+
+  DatadogAgentConfig config;
+  config.background_threads = options;
+  const auto finalized =
+      finalize_config(config, std::make_shared<MockLogger>(), default_clock);
+  REQUIRE_FALSE(finalized);
+  REQUIRE(finalized.error().code == Error::INVALID_THREAD_OPTIONS);
+}
+
+THREAD_OPTIONS_TEST("configured background threads are not shared") {
+  ThreadOptions options;
+  REQUIRE(is_default(options));
+  const auto logger = std::make_shared<MockLogger>();
+  REQUIRE(ThreadedEventScheduler::shared_instance(options, logger) ==
+          ThreadedEventScheduler::shared_instance());
+
+  options.name_prefix = "dd-test";
+  REQUIRE_FALSE(is_default(options));
+  REQUIRE(ThreadedEventScheduler::shared_instance(options, logger) !=
+          ThreadedEventScheduler::shared_instance());
+}
+
+#ifdef __linux__
+THREAD_OPTIONS_TEST("threads apply their options") {
+  ThreadOptions options;
+  options.name_prefix = "dd-test";
+  options.cpus = {0};
+  options.scheduling_policy = ThreadSchedulingPolicy::BATCH;
+  // Increasing the nice value does not require privilege.
+  options.nice = 5;
+
+  const auto logger = std::make_shared<MockLogger>();
+  const auto make_thread = make_thread_generator(options, "sched", logger);
+
+  std::string name;
+  bool only_cpu_zero = false;
+  int policy = -1;
+  int nice = 0;
+  std::thread thread = make_thread([&]() {
+    char buffer[16] = {};
+    ::pthread_getname_np(::pthread_self(), buffer, sizeof buffer);
+    name = buffer;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    ::sched_getaffinity(0, sizeof cpus, &cpus);
+    only_cpu_zero = CPU_COUNT(&cpus) == 1 && CPU_ISSET(0, &cpus);
+    policy = ::sched_getscheduler(0);
+    nice = ::getpriority(PRIO_PROCESS,
+                         static_cast<id_t>(::syscall(SYS_gettid)));
+  });
+  thread.join();
+
+  REQUIRE(logger->error_count() == 0);
+  REQUIRE(name == "dd-test-sched");
+  REQUIRE(only_cpu_zero);
+  REQUIRE(policy == SCHED_BATCH);
+  REQUIRE(nice == 5);
+
+  // The thread that created it is unaffected.
+  REQUIRE(::sched_getscheduler(0) != SCHED_BATCH);
+}
+#endif
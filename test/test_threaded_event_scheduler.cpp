@@ -0,0 +1,153 @@
+#include <datadog/json.hpp>
+#include <datadog/threaded_event_scheduler.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define THREADED_EVENT_SCHEDULER_TEST(x) \
+  TEST_CASE(x, "[threaded_event_scheduler]")
+
+namespace {
+
+// Wait until the specified `predicate` is true, for at most five seconds.
+// Return the final value of `predicate()`.
+template <typename Predicate>
+bool eventually(Predicate&& predicate) {
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  return true;
+}
+
+}  // namespace
+
+THREADED_EVENT_SCHEDULER_TEST("events recur until cancelled") {
+  ThreadedEventScheduler scheduler{1ms};
+  std::atomic<int> count{0};
+  auto cancel = scheduler.schedule_recurring_event(2ms, [&]() { ++count; });
+
+  REQUIRE(eventually([&]() { return count >= 3; }));
+  cancel();
+  const int final_count = count;
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(count == final_count);
+  // Cancelling again has no effect.
+  cancel();
+}
+
+THREADED_EVENT_SCHEDULER_TEST("the first event can be sooner than the interval") {
+  ThreadedEventScheduler scheduler{1ms};
+  std::atomic<int> count{0};
+  auto cancel = scheduler.schedule_recurring_event_after(0ms, 24h,
+                                                         [&]() { ++count; });
+
+  REQUIRE(eventually([&]() { return count == 1; }));
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(count == 1);
+  cancel();
+}
+
+THREADED_EVENT_SCHEDULER_TEST("events beyond the first level are reached") {
+  // With a slack of one microsecond, these intervals span the first, second,
+  // and third levels of the wheel.
+  ThreadedEventScheduler scheduler{1us};
+  std::atomic<int> short_count{0};
+  std::atomic<int> medium_count{0};
+  std::atomic<int> long_count{0};
+  auto cancel_short =
+      scheduler.schedule_recurring_event(30us, [&]() { ++short_count; });
+  auto cancel_medium =
+      scheduler.schedule_recurring_event(1ms, [&]() { ++medium_count; });
+  auto cancel_long =
+      scheduler.schedule_recurring_event(5ms, [&]() { ++long_count; });
+  // This event is beyond the reach of the wheel, and is never due.
+  std::atomic<int> never_count{0};
+  auto cancel_never =
+      scheduler.schedule_recurring_event(24h, [&]() { ++never_count; });
+
+  REQUIRE(eventually([&]() { return long_count >= 2; }));
+  REQUIRE(medium_count >= 5);
+  REQUIRE(short_count >= 10);
+  REQUIRE(never_count == 0);
+
+  cancel_short();
+  cancel_medium();
+  cancel_long();
+  cancel_never();
+}
+
+THREADED_EVENT_SCHEDULER_TEST("events due within the slack run together") {
+  ThreadedEventScheduler scheduler{200ms};
+  std::mutex mutex;
+  std::vector<std::chrono::steady_clock::time_point> invoked;
+  const auto record = [&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    invoked.push_back(std::chrono::steady_clock::now());
+  };
+  const auto scheduled = std::chrono::steady_clock::now();
+  auto cancel_first = scheduler.schedule_recurring_event(10ms, record);
+  auto cancel_second = scheduler.schedule_recurring_event(90ms, record);
+
+  REQUIRE(eventually([&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return invoked.size() >= 2;
+  }));
+  cancel_first();
+  cancel_second();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // Neither event was invoked early, and both were invoked at the end of the
+  // same tick.
+  REQUIRE(invoked[0] - scheduled >= 90ms);
+  REQUIRE(invoked[1] - invoked[0] < 50ms);
+}
+
+THREADED_EVENT_SCHEDULER_TEST("posted tasks run in order on the dispatcher") {
+  ThreadedEventScheduler scheduler;
+  std::mutex mutex;
+  std::vector<int> order;
+  std::vector<std::thread::id> threads;
+  for (int i = 0; i < 3; ++i) {
+    scheduler.post([&, i]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(i);
+      threads.push_back(std::this_thread::get_id());
+    });
+  }
+
+  REQUIRE(eventually([&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return order.size() == 3;
+  }));
+  REQUIRE(order == std::vector<int>{0, 1, 2});
+  REQUIRE(threads[0] != std::this_thread::get_id());
+  REQUIRE(threads[0] == threads[1]);
+  REQUIRE(threads[1] == threads[2]);
+}
+
+THREADED_EVENT_SCHEDULER_TEST("ThreadedEventScheduler configuration") {
+  ThreadedEventScheduler scheduler{25ms};
+  const auto config = nlohmann::json::parse(scheduler.config());
+  REQUIRE(config["type"] == "datadog::tracing::ThreadedEventScheduler");
+  REQUIRE(config["config"]["slack_milliseconds"] == 25);
+}
+
+THREADED_EVENT_SCHEDULER_TEST("the shared instance is shared") {
+  auto first = ThreadedEventScheduler::shared_instance();
+  auto second = ThreadedEventScheduler::shared_instance();
+  REQUIRE(first);
+  REQUIRE(first == second);
+}
@@ -0,0 +1,87 @@
+#include <datadog/json.hpp>
+#include <datadog/timeline.h>
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "test.h"
+#include "timeline_events.h"
+
+using namespace datadog::tracing;
+
+#define TIMELINE_TEST(x) TEST_CASE(x, "[timeline]")
+
+namespace {
+
+// Return the number of events in the specified `dumped` timeline that have
+// the specified `name`.
+int count_events(const std::string& dumped, const std::string& name) {
+  const auto json = nlohmann::json::parse(dumped);
+  int count = 0;
+  for (const auto& event : json.at("traceEvents")) {
+    if (event.at("name") == name) {
+      REQUIRE(event.at("ph") == "X");
+      REQUIRE(event.at("dur").get<double>() >= 0);
+      ++count;
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+TIMELINE_TEST("scopes are recorded only while enabled") {
+  {
+    const TimelineScope scope{"test.disabled"};
+  }
+  REQUIRE(count_events(timeline::dump(), "test.disabled") == 0);
+
+  timeline::enable(true);
+  {
+    const TimelineScope scope{"test.enabled"};
+  }
+  std::thread([]() { const TimelineScope scope{"test.enabled"}; }).join();
+  timeline::enable(false);
+  {
+    const TimelineScope scope{"test.enabled"};
+  }
+
+  const auto dumped = timeline::dump();
+  REQUIRE(count_events(dumped, "test.enabled") == 2);
+  const auto json = nlohmann::json::parse(dumped);
+  REQUIRE(json.at("displayTimeUnit") == "ns");
+}
+
+TIMELINE_TEST("only lock waits are recorded") {
+  std::mutex mutex;
+  timeline::enable(true);
+  lock_recording_wait(mutex, "test.lock_wait");
+  mutex.unlock();
+  REQUIRE(count_events(timeline::dump(), "test.lock_wait") == 0);
+
+  mutex.lock();
+  std::thread waiter{[&]() {
+    lock_recording_wait(mutex, "test.lock_wait");
+    mutex.unlock();
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  mutex.unlock();
+  waiter.join();
+  timeline::enable(false);
+  REQUIRE(count_events(timeline::dump(), "test.lock_wait") == 1);
+}
+
+TIMELINE_TEST("each thread keeps its most recent events") {
+  timeline::enable(true);
+  std::thread([]() {
+    for (std::size_t i = 0; i < 2 * timeline::events_per_thread; ++i) {
+      const TimelineScope scope{"test.many"};
+    }
+  }).join();
+  timeline::enable(false);
+  REQUIRE(count_events(timeline::dump(), "test.many") ==
+          int(timeline::events_per_thread));
+}
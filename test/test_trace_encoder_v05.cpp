@@ -0,0 +1,291 @@
+#include <datadog/error.h>
+#include <datadog/shared_tags.h>
+#include <datadog/span_data.h>
+#include <datadog/trace_encoder_v05.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <datadog/json.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "msgpack.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define TEST_ENCODER_V05(x) TEST_CASE(x, "[trace_encoder_v05]")
+
+namespace {
+
+// Decode the MessagePack value at the specified `position` of the specified
+// `encoded`, and advance `position` past it.  Only the types produced by
+// `msgpack.h` are supported.  Maps are decoded as arrays of `[key, value]`
+// pairs, because the v0.5 format has maps with integer keys, which JSON does
+// not allow.
+nlohmann::json decode(const std::string& encoded, std::size_t& position) {
+  const auto read_big_endian = [&](std::size_t size) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      value = (value << 8) | static_cast<unsigned char>(encoded.at(position++));
+    }
+    return value;
+  };
+
+  const auto decode_string = [&](std::size_t size) {
+    std::string value = encoded.substr(position, size);
+    position += size;
+    return value;
+  };
+  const auto decode_array = [&](std::size_t size) {
+    auto result = nlohmann::json::array();
+    while (size--) {
+      result.push_back(decode(encoded, position));
+    }
+    return result;
+  };
+  const auto decode_map = [&](std::size_t size) {
+    auto result = nlohmann::json::array();
+    while (size--) {
+      auto key = decode(encoded, position);
+      auto value = decode(encoded, position);
+      result.push_back(nlohmann::json::array({key, value}));
+    }
+    return result;
+  };
+
+  const auto type = static_cast<unsigned char>(encoded.at(position++));
+  if (type < 0x80) {  // positive fixint
+    return type;
+  }
+  if (type >= 0xE0) {  // negative fixint
+    return static_cast<std::int8_t>(type);
+  }
+  if ((type & 0xE0) == 0xA0) {  // fixstr
+    return decode_string(type & 0x1F);
+  }
+  if ((type & 0xF0) == 0x90) {  // fixarray
+    return decode_array(type & 0x0F);
+  }
+  if ((type & 0xF0) == 0x80) {  // fixmap
+    return decode_map(type & 0x0F);
+  }
+  switch (type) {
+    case 0xCB: {  // float 64
+      const std::uint64_t bits = read_big_endian(8);
+      double value;
+      std::memcpy(&value, &bits, sizeof value);
+      return value;
+    }
+    case 0xCC:  // uint 8
+      return read_big_endian(1);
+    case 0xCD:  // uint 16
+      return read_big_endian(2);
+    case 0xCE:  // uint 32
+      return read_big_endian(4);
+    case 0xCF:  // uint 64
+      return read_big_endian(8);
+    case 0xD0:  // int 8
+      return static_cast<std::int8_t>(read_big_endian(1));
+    case 0xD1:  // int 16
+      return static_cast<std::int16_t>(read_big_endian(2));
+    case 0xD2:  // int 32
+      return static_cast<std::int32_t>(read_big_endian(4));
+    case 0xD3:  // int 64
+      return static_cast<std::int64_t>(read_big_endian(8));
+    case 0xD9:  // str 8
+      return decode_string(read_big_endian(1));
+    case 0xDA:  // str 16
+      return decode_string(read_big_endian(2));
+    case 0xDB:  // str 32
+      return decode_string(read_big_endian(4));
+    case 0xDC:  // array 16
+      return decode_array(read_big_endian(2));
+    case 0xDD:  // array 32
+      return decode_array(read_big_endian(4));
+    case 0xDE:  // map 16
+      return decode_map(read_big_endian(2));
+    case 0xDF:  // map 32
+      return decode_map(read_big_endian(4));
+  }
+  throw std::runtime_error("unsupported MessagePack type");
+}
+
+nlohmann::json decode(const std::string& encoded) {
+  std::size_t position = 0;
+  auto result = decode(encoded, position);
+  REQUIRE(position == encoded.size());
+  return result;
+}
+
+std::unique_ptr<SpanData> make_span(std::string name) {
+  auto span = std::make_unique<SpanData>();
+  span->service = "testsvc";
+  span->name = std::move(name);
+  span->resource = "resource";
+  span->trace_id = TraceID(12345);
+  span->span_id = 678;
+  span->error = true;
+  span->tags.emplace("foo", "bar");
+  span->numeric_tags.emplace("answer", 42.0);
+  return span;
+}
+
+}  // namespace
+
+TEST_ENCODER_V05("empty payload") {
+  std::string destination;
+  TraceEncoderV05 encoder;
+  REQUIRE(encoder.finish(destination));
+
+  const auto payload = decode(destination);
+  REQUIRE(payload == nlohmann::json::parse(R"([[""], []])"));
+}
+
+TEST_ENCODER_V05("strings are encoded once, as dictionary indices") {
+  std::vector<std::unique_ptr<SpanData>> first;
+  first.push_back(make_span("parent"));
+  first.push_back(make_span("child"));
+  std::vector<std::unique_ptr<SpanData>> second;
+  second.push_back(make_span("parent"));
+  const auto shared = std::make_shared<const SharedTags>(
+      SharedTags::Tags{{"language", "cpp"}},
+      SharedTags::NumericTags{{"process_id", 1.0}});
+  second[0]->shared_tags = shared;
+
+  TraceEncoderV05 encoder;
+  REQUIRE(encoder.add_chunk(first));
+  REQUIRE(encoder.add_chunk(second));
+  std::string destination;
+  REQUIRE(encoder.finish(destination));
+
+  const auto payload = decode(destination);
+  REQUIRE(payload.size() == 2);
+  const auto& strings = payload[0];
+  const auto& chunks = payload[1];
+  REQUIRE(chunks.size() == 2);
+  REQUIRE(chunks[0].size() == 2);
+  REQUIRE(chunks[1].size() == 1);
+
+  // Every string appears in the dictionary exactly once.
+  std::vector<std::string> sorted = strings;
+  std::sort(sorted.begin(), sorted.end());
+  REQUIRE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+  REQUIRE(strings[0] == "");
+
+  const auto lookup = [&](const nlohmann::json& index) {
+    return strings[index.get<std::size_t>()].get<std::string>();
+  };
+
+  const auto& span = chunks[0][1];
+  REQUIRE(span.size() == 12);
+  CHECK(lookup(span[0]) == "testsvc");
+  CHECK(lookup(span[1]) == "child");
+  CHECK(lookup(span[2]) == "resource");
+  CHECK(span[3] == 12345);
+  CHECK(span[4] == 678);
+  CHECK(span[5] == 0);
+  CHECK(span[8] == 1);
+  REQUIRE(span[9].size() == 1);
+
+  CHECK(lookup(span[9][0][0]) == "foo");
+  CHECK(lookup(span[9][0][1]) == "bar");
+  REQUIRE(span[10].size() == 1);
+  CHECK(lookup(span[10][0][0]) == "answer");
+  CHECK(span[10][0][1] == 42.0);
+  CHECK(lookup(span[11]) == "");
+  // The same string has the same index everywhere.
+  CHECK(span[0] == chunks[0][0][0]);
+
+  // Shared tags are encoded alongside the span's own tags.
+  const auto& with_shared = chunks[1][0];
+  REQUIRE(with_shared[9].size() == 2);
+  CHECK(lookup(with_shared[9][1][0]) == "language");
+  CHECK(lookup(with_shared[9][1][1]) == "cpp");
+  REQUIRE(with_shared[10].size() == 2);
+  CHECK(lookup(with_shared[10][1][0]) == "process_id");
+}
+
+TEST_ENCODER_V05("span links and span events are encoded as JSON tags") {
+  std::vector<std::unique_ptr<SpanData>> chunk;
+  chunk.push_back(make_span("consumer"));
+  auto& link = chunk[0]->links.emplace_back();
+  link.trace_id = TraceID(0xCAFE, 0xBEEF);
+  link.span_id = 42;
+  link.flags = 1;
+  link.attributes.emplace_back("messaging.operation", "receive");
+  auto& event = chunk[0]->events.emplace_back();
+  event.name = "retry";
+  event.time = std::chrono::system_clock::time_point(
+      std::chrono::nanoseconds(1'700'000'000'000'000'000));
+
+  TraceEncoderV05 encoder;
+  REQUIRE(encoder.add_chunk(chunk));
+  std::string destination;
+  REQUIRE(encoder.finish(destination));
+
+  const auto payload = decode(destination);
+  const auto& strings = payload[0];
+  const auto lookup = [&](const nlohmann::json& index) {
+    return strings[index.get<std::size_t>()].get<std::string>();
+  };
+  const auto& tags = payload[1][0][0][9];
+  REQUIRE(tags.size() == 3);
+
+  CHECK(lookup(tags[1][0]) == "_dd.span_links");
+  CHECK(nlohmann::json::parse(lookup(tags[1][1])) == nlohmann::json::parse(R"(
+    [{"trace_id": "000000000000beef000000000000cafe",
+      "span_id": "000000000000002a",
+      "attributes": {"messaging.operation": "receive"},
+      "flags": 1}]
+  )"));
+  CHECK(lookup(tags[2][0]) == "events");
+  CHECK(nlohmann::json::parse(lookup(tags[2][1])) == nlohmann::json::parse(R"(
+    [{"name": "retry", "time_unix_nano": 1700000000000000000}]
+  )"));
+}
+
+TEST_ENCODER_V05("payloads convert to v0.4") {
+  std::vector<std::unique_ptr<SpanData>> first;
+  first.push_back(make_span("parent"));
+  first.push_back(make_span("child"));
+  first[1]->trace_id = TraceID(0xFFFFFFFFFFFFFFFFULL);
+  first[1]->parent_id = 678;
+  first[1]->numeric_tags.emplace("negative", -1.5);
+  std::vector<std::unique_ptr<SpanData>> second;
+  second.push_back(make_span("other"));
+  second[0]->service_type = "web";
+
+  TraceEncoderV05 encoder;
+  REQUIRE(encoder.add_chunk(first));
+  REQUIRE(encoder.add_chunk(second));
+  std::string v05;
+  REQUIRE(encoder.finish(v05));
+
+  std::string expected;
+  REQUIRE(msgpack::pack_array(expected, 2));
+  REQUIRE(msgpack_encode(expected, first));
+  REQUIRE(msgpack_encode(expected, second));
+
+  std::string v04;
+  REQUIRE(transcode_v05_to_v04(v04, v05));
+  REQUIRE(nlohmann::json::from_msgpack(v04) ==
+          nlohmann::json::from_msgpack(expected));
+
+  SECTION("invalid payloads are rejected") {
+    auto length = GENERATE(0, 1, 10);
+    std::string truncated = v05.substr(0, v05.size() - length);
+    if (length == 0) {
+      truncated += '\0';
+    }
+    std::string destination;
+    const auto result = transcode_v05_to_v04(destination, truncated);
+    REQUIRE_FALSE(result);
+    REQUIRE(result.error().code == Error::DATADOG_AGENT_INVALID_V05_PAYLOAD);
+  }
+}
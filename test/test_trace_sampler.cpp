@@ -1,14 +1,24 @@
 #include <datadog/clock.h>
+#include <datadog/collector_response.h>
 #include <datadog/id_generator.h>
 #include <datadog/rate.h>
+#include <datadog/sampling_decision.h>
+#include <datadog/sampling_mechanism.h>
 #include <datadog/sampling_priority.h>
+#include <datadog/span_data.h>
+#include <datadog/tags.h>
+#include <datadog/trace_sampler.h>
 #include <datadog/tracer.h>
 #include <datadog/tracer_config.h>
 
+#include <atomic>
 #include <chrono>
 #include <limits>
 #include <map>
 #include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "mocks/collectors.h"
 #include "null_logger.h"
@@ -270,3 +280,97 @@ TEST_CASE("sampling rules") {
     REQUIRE(collector->count_of(SamplingPriority::USER_DROP) == 1);
   }
 }
+
+TEST_CASE("collector sample rates are refreshed for each response") {
+  // `TraceSampler` caches the collector sample rate that it resolves for a
+  // service and environment.  Verify that new collector responses and new
+  // rules are not hidden by the cache.
+  auto finalized = finalize_config(TraceSamplerConfig{});
+  REQUIRE(finalized);
+  TraceSampler sampler{*finalized, default_clock};
+
+  SpanData span;
+  span.service = "testsvc";
+  span.tags[tags::environment] = "dev";
+
+  const auto decide = [&](TraceSampler& which) {
+    const auto decision = which.decide(span);
+    REQUIRE(decision.configured_rate);
+    REQUIRE(decision.mechanism);
+    return std::make_pair(decision.configured_rate->value(),
+                          *decision.mechanism);
+  };
+
+  const int agent_rate = int(SamplingMechanism::AGENT_RATE);
+  REQUIRE(decide(sampler) ==
+          std::make_pair(1.0, int(SamplingMechanism::DEFAULT)));
+
+  CollectorResponse response;
+  response.sample_rate_by_key[CollectorResponse::key_of_default_rate] =
+      assert_rate(0.25);
+  sampler.handle_collector_response(response);
+  REQUIRE(decide(sampler) == std::make_pair(0.25, agent_rate));
+  REQUIRE(decide(sampler) == std::make_pair(0.25, agent_rate));
+
+  response.sample_rate_by_key["service:testsvc,env:dev"] = assert_rate(0.5);
+  sampler.handle_collector_response(response);
+  REQUIRE(decide(sampler) == std::make_pair(0.5, agent_rate));
+
+  // Another environment of the same service has its own rate.
+  span.tags[tags::environment] = "prod";
+  REQUIRE(decide(sampler) == std::make_pair(0.25, agent_rate));
+  span.tags[tags::environment] = "dev";
+  REQUIRE(decide(sampler) == std::make_pair(0.5, agent_rate));
+
+  // Another sampler on the same thread does not see this sampler's rates.
+  TraceSampler other{*finalized, default_clock};
+  REQUIRE(decide(other) ==
+          std::make_pair(1.0, int(SamplingMechanism::DEFAULT)));
+  REQUIRE(decide(sampler) == std::make_pair(0.5, agent_rate));
+
+  // A matching rule takes precedence over the cached collector rate.
+  TraceSamplerRule rule;
+  rule.rate = assert_rate(0.75);
+  rule.mechanism = SamplingMechanism::RULE;
+  sampler.set_rules({rule});
+  REQUIRE(decide(sampler) ==
+          std::make_pair(0.75, int(SamplingMechanism::RULE)));
+  sampler.set_rules({});
+  REQUIRE(decide(sampler) == std::make_pair(0.5, agent_rate));
+}
+
+TEST_CASE("collector sample rates are replaced while deciding") {
+  // Decisions made concurrently with collector responses see one of the
+  // published rates.
+  auto finalized = finalize_config(TraceSamplerConfig{});
+  REQUIRE(finalized);
+  TraceSampler sampler{*finalized, default_clock};
+
+  std::vector<std::thread> threads;
+  std::atomic<bool> consistent{true};
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      SpanData span;
+      span.service = "testsvc";
+      for (int j = 0; j < 10'000; ++j) {
+        const auto decision = sampler.decide(span);
+        const double rate = decision.configured_rate->value();
+        if (rate != 1.0 && rate != 0.25 && rate != 0.5) {
+          consistent = false;
+        }
+      }
+    });
+  }
+
+  CollectorResponse response;
+  for (int j = 0; j < 1'000; ++j) {
+    response.sample_rate_by_key[CollectorResponse::key_of_default_rate] =
+        assert_rate(j % 2 ? 0.25 : 0.5);
+    sampler.handle_collector_response(response);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(consistent);
+}
@@ -2,12 +2,20 @@
 #include <datadog/optional.h>
 #include <datadog/platform_util.h>
 #include <datadog/rate.h>
+#include <datadog/shared_tags.h>
+#include <datadog/span_data.h>
 #include <datadog/tags.h>
 #include <datadog/trace_segment.h>
 #include <datadog/tracer.h>
 #include <datadog/tracer_config.h>
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <regex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "matchers.h"
@@ -19,6 +27,7 @@
 #include "test.h"
 
 using namespace datadog::tracing;
+using namespace std::chrono_literals;
 
 namespace {
 
@@ -164,6 +173,45 @@ TEST_CASE("When Collector::send fails, TraceSegment logs the error.") {
   REQUIRE(logger->first_error().code == collector->failure.code);
 }
 
+TEST_CASE("TraceSegment sends chunk-level properties with the spans") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<ChunkCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<NullLogger>();
+  config.report_hostname = true;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+  {
+    const std::unordered_map<std::string, std::string> headers{
+        {"x-datadog-trace-id", "123"},
+        {"x-datadog-parent-id", "456"},
+        {"x-datadog-sampling-priority", "2"},
+        {"x-datadog-origin", "Unalaska"}};
+    MockDictReader reader{headers};
+    auto span = tracer.extract_span(reader);
+    REQUIRE(span);
+  }
+  { auto span = tracer.create_span(); }
+
+  REQUIRE(collector->chunks.size() == 2);
+  const auto& extracted = collector->chunks[0];
+  REQUIRE(extracted.spans.size() == 1);
+  REQUIRE(extracted.sampling_priority == 2);
+  REQUIRE(extracted.origin == "Unalaska");
+  REQUIRE(extracted.hostname == get_hostname());
+  REQUIRE(extracted.encoded.empty());
+
+  const auto& created = collector->chunks[1];
+  REQUIRE(created.sampling_priority);
+  REQUIRE(*created.sampling_priority ==
+          created.spans.front()->numeric_tags.at(
+              tags::internal::sampling_priority));
+  REQUIRE(!created.origin);
+}
+
 TEST_CASE("TraceSegment finalization of spans") {
   TracerConfig config;
   config.service = "testsvc";
@@ -469,8 +517,589 @@ TEST_CASE("TraceSegment finalization of spans") {
       }
     }
   }
+
+  SECTION("shared tags replace span tags having the same name") {
+    const auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto span = tracer.create_span();
+      span.set_tag(tags::internal::language, "cobol");
+      span.set_metric(tags::internal::process_id, -1);
+    }
+
+    const auto& span = collector->first_span();
+    REQUIRE(span.tags.at(tags::internal::language) == "cpp");
+    REQUIRE(span.numeric_tags.at(tags::internal::process_id) ==
+            get_process_id());
+    REQUIRE_FALSE(span.shared_tags);
+  }
+
+  SECTION("collectors that accept shared tags are sent them shared") {
+    const auto sharing = std::make_shared<SharingMockCollector>();
+    config.collector = sharing;
+    const auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      root.set_tag(tags::internal::language, "cobol");
+      auto child = root.create_child();
+    }
+
+    REQUIRE(sharing->span_count() == 2);
+    for (const auto& span : sharing->chunks.front()) {
+      // The repeated tags are shared by all of the spans rather than copied
+      // into each span's tags, and they replace span tags having the same
+      // names.
+      REQUIRE(span->shared_tags);
+      REQUIRE(span->shared_tags == sharing->first_span().shared_tags);
+      REQUIRE(span->tags.count(tags::internal::language) == 0);
+      REQUIRE(span->tags.count(tags::internal::runtime_id) == 0);
+      REQUIRE(span->numeric_tags.count(tags::internal::process_id) == 0);
+
+      const std::unordered_map<std::string, std::string> shared_tags(
+          span->shared_tags->tags().begin(), span->shared_tags->tags().end());
+      REQUIRE(shared_tags.size() == 2);
+      REQUIRE(shared_tags.at(tags::internal::language) == "cpp");
+      REQUIRE(shared_tags.count(tags::internal::runtime_id) == 1);
+
+      const auto& shared_numeric_tags = span->shared_tags->numeric_tags();
+      REQUIRE(shared_numeric_tags.size() == 1);
+      REQUIRE(shared_numeric_tags.front().first == tags::internal::process_id);
+      REQUIRE(shared_numeric_tags.front().second == get_process_id());
+    }
+  }
+
+  SECTION("segments without an origin share the tracer's shared tags") {
+    const auto sharing = std::make_shared<SharingMockCollector>();
+    config.collector = sharing;
+    const auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    { auto span = tracer.create_span(); }
+    { auto span = tracer.create_span(); }
+
+    REQUIRE(sharing->chunks.size() == 2);
+    const auto& first = sharing->chunks[0].front()->shared_tags;
+    const auto& second = sharing->chunks[1].front()->shared_tags;
+    REQUIRE(first);
+    REQUIRE(first == second);
+    REQUIRE(first->tags().size() == 2);
+  }
+
+  SECTION("segments having the same origin share their shared tags") {
+    const auto sharing = std::make_shared<SharingMockCollector>();
+    config.collector = sharing;
+    const auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    for (const char* origin : {"synthetics", "rum", "synthetics"}) {
+      std::unordered_map<std::string, std::string> headers;
+      headers["x-datadog-trace-id"] = "123";
+      headers["x-datadog-parent-id"] = "456";
+      headers["x-datadog-origin"] = origin;
+      MockDictReader reader{headers};
+      auto span = tracer.extract_span(reader);
+      REQUIRE(span);
+    }
+
+    REQUIRE(sharing->chunks.size() == 3);
+    const auto& first = sharing->chunks[0].front()->shared_tags;
+    const auto& second = sharing->chunks[1].front()->shared_tags;
+    const auto& third = sharing->chunks[2].front()->shared_tags;
+    REQUIRE(first);
+    REQUIRE(first == third);
+    REQUIRE(first != second);
+    REQUIRE(second->tags().front() ==
+            std::make_pair(std::string(tags::internal::origin),
+                           std::string("rum")));
+  }
 }  // span finalizers
 
+TEST_CASE("shared tags are encoded as span tags") {
+  SpanData shared;
+  shared.tags.emplace("foo", "bar");
+  shared.numeric_tags.emplace("two", 2);
+  shared.shared_tags = std::make_shared<const SharedTags>(
+      SharedTags::Tags{{"language", "cpp"}, {"runtime-id", "abc"}},
+      SharedTags::NumericTags{{"process_id", 42}});
+
+  // `FlatMap` preserves insertion order, so the encodings are identical.
+  SpanData copied;
+  copied.tags.emplace("foo", "bar");
+  copied.tags.emplace("language", "cpp");
+  copied.tags.emplace("runtime-id", "abc");
+  copied.numeric_tags.emplace("two", 2);
+  copied.numeric_tags.emplace("process_id", 42);
+
+  std::string shared_encoding;
+  REQUIRE(msgpack_encode(shared_encoding, shared));
+  std::string copied_encoding;
+  REQUIRE(msgpack_encode(copied_encoding, copied));
+  REQUIRE(shared_encoding == copied_encoding);
+}
+
+TEST_CASE("spans created and finished on many threads") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  const int thread_count = 8;
+  const int spans_per_thread = 100;
+  {
+    const auto root = tracer.create_span();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&]() {
+        for (int j = 0; j < spans_per_thread; ++j) {
+          auto child = root.create_child();
+          child.set_tag("iteration", std::to_string(j));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    REQUIRE(collector->chunks.empty());
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  REQUIRE(collector->span_count() == thread_count * spans_per_thread + 1);
+}
+
+TEST_CASE("TraceSegment partial flush") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.partial_flush_enabled = true;
+  config.partial_flush_min_spans = 3;
+
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  SECTION("finished spans are sent before the local root finishes") {
+    {
+      auto root = tracer.create_span();
+      root.set_tag("root", "yes");
+      {
+        auto child = root.create_child();
+        { auto grandchild = child.create_child(); }
+        REQUIRE(collector->chunks.empty());
+      }
+      // Two spans have finished.
+      REQUIRE(collector->chunks.empty());
+      { auto child = root.create_child(); }
+      // Three spans have finished.
+      REQUIRE(collector->chunks.size() == 1);
+      REQUIRE(collector->chunks[0].size() == 3);
+
+      { auto child = root.create_child(); }
+      REQUIRE(collector->chunks.size() == 1);
+    }
+
+    // The local root and the remaining child make up the final chunk.
+    REQUIRE(collector->chunks.size() == 2);
+    REQUIRE(collector->chunks[1].size() == 2);
+    REQUIRE(collector->chunks[1].front()->tags.at("root") == "yes");
+    REQUIRE(collector->span_count() == 5);
+
+    // Each chunk carries the sampling priority on its first span, and every
+    // span carries the shared tags.
+    for (const auto& chunk : collector->chunks) {
+      REQUIRE(chunk.front()->numeric_tags.count(
+                  tags::internal::sampling_priority) == 1);
+      for (const auto& span : chunk) {
+        REQUIRE(span->tags.at(tags::internal::language) == "cpp");
+        REQUIRE(span->tags.count("root") == (span == chunk.front() &&
+                                              &chunk == &collector->chunks[1]));
+      }
+    }
+    REQUIRE(collector->chunks[0].front()->numeric_tags.at(
+                tags::internal::sampling_priority) ==
+            collector->chunks[1].front()->numeric_tags.at(
+                tags::internal::sampling_priority));
+  }
+
+  SECTION("the local root alone is never partially flushed") {
+    { auto root = tracer.create_span(); }
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 1);
+  }
+}
+
+TEST_CASE("TraceSegment early sampling decision") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.early_sampling_decision = true;
+  config.trace_sampler.sample_rate = 0.0;
+
+  SECTION("children of dropped traces are not recorded") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      REQUIRE(root.trace_segment().skips_new_spans());
+      auto child = root.create_child();
+      auto grandchild = child.create_child();
+      grandchild.set_tag("ignored", "yes");
+      REQUIRE(grandchild.trace_id() == root.trace_id());
+      REQUIRE(grandchild.parent_id() == child.id());
+      REQUIRE(child.parent_id() == root.id());
+
+      MockDictWriter writer;
+      grandchild.inject(writer);
+      REQUIRE(writer.items.at("x-datadog-parent-id") ==
+              std::to_string(grandchild.id()));
+      REQUIRE(writer.items.at("x-datadog-sampling-priority") ==
+              std::to_string(int(SamplingPriority::USER_DROP)));
+    }
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 1);
+    REQUIRE(collector->first_span().numeric_tags.at(
+                tags::internal::sampling_priority) ==
+            int(SamplingPriority::USER_DROP));
+  }
+
+  SECTION("the segment waits for unrecorded children") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    Optional<Span> child;
+    {
+      auto root = tracer.create_span();
+      child.emplace(root.create_child());
+    }
+    REQUIRE(collector->chunks.empty());
+    MockDictWriter writer;
+    child->inject(writer);
+    REQUIRE(writer.items.count("x-datadog-trace-id") == 1);
+    child.reset();
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 1);
+  }
+
+  SECTION("spans created after keeping the trace are recorded") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      { auto child = root.create_child(); }
+      root.trace_segment().override_sampling_priority(
+          SamplingPriority::USER_KEEP);
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+      { auto child = root.create_child(); }
+    }
+    REQUIRE(collector->span_count() == 2);
+  }
+
+  SECTION("kept traces are recorded") {
+    config.trace_sampler.sample_rate = 1.0;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+      auto child = root.create_child();
+    }
+    REQUIRE(collector->span_count() == 2);
+  }
+
+  SECTION("spans that span sampling rules could keep are recorded") {
+    config.span_sampler.rules.emplace_back();
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+      auto child = root.create_child();
+    }
+    REQUIRE(collector->span_count() == 2);
+  }
+
+  SECTION("disabled by default") {
+    config.early_sampling_decision = nullopt;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+      auto child = root.create_child();
+    }
+    REQUIRE(collector->span_count() == 2);
+  }
+}
+
+TEST_CASE("TraceSegment when traces are not reported") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.report_traces = false;
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  {
+    auto root = tracer.create_span();
+    root.set_tag("kept", "yes");
+    REQUIRE(root.lookup_tag("kept") == StringView("yes"));
+    REQUIRE(root.trace_segment().skips_new_spans());
+
+    // Children are not recorded, but still propagate trace context.
+    auto child = root.create_child();
+    child.set_tag("ignored", "yes");
+    child.set_name("ignored");
+    REQUIRE(!child.lookup_tag("ignored"));
+    REQUIRE(child.name().empty());
+    REQUIRE(child.parent_id() == root.id());
+
+    MockDictWriter writer;
+    child.inject(writer);
+    REQUIRE(writer.items.at("x-datadog-trace-id") ==
+            std::to_string(root.trace_id().low));
+    REQUIRE(writer.items.at("x-datadog-parent-id") ==
+            std::to_string(child.id()));
+    REQUIRE(writer.items.count("x-datadog-sampling-priority") == 1);
+  }
+  REQUIRE(collector->chunks.empty());
+}
+
+TEST_CASE("TraceSegment span limits") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+
+  SECTION("spans beyond the span limit are not recorded") {
+    config.max_spans_per_trace_segment = 3;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      auto first = root.create_child();
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+      auto second = first.create_child();
+      REQUIRE(root.trace_segment().skips_new_spans());
+      auto third = second.create_child();
+      REQUIRE(third.parent_id() == second.id());
+
+      MockDictWriter writer;
+      third.inject(writer);
+      REQUIRE(writer.items.at("x-datadog-parent-id") ==
+              std::to_string(third.id()));
+    }
+    REQUIRE(collector->chunks.size() == 1);
+    REQUIRE(collector->span_count() == 3);
+    REQUIRE(collector->first_span().tags.at(tags::internal::trace_truncated) ==
+            "spans");
+  }
+
+  SECTION("spans beyond the size limit are not recorded") {
+    config.max_bytes_per_trace_segment = 1024;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      {
+        auto large = root.create_child();
+        large.set_tag("large", std::string(1024, 'x'));
+      }
+      REQUIRE(root.trace_segment().skips_new_spans());
+      auto child = root.create_child();
+    }
+    REQUIRE(collector->span_count() == 2);
+    REQUIRE(collector->first_span().tags.at(tags::internal::trace_truncated) ==
+            "bytes");
+  }
+
+  SECTION("segments within the limits are not truncated") {
+    config.max_spans_per_trace_segment = 3;
+    config.max_bytes_per_trace_segment = 1 << 20;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    Tracer tracer{*finalized};
+    {
+      auto root = tracer.create_span();
+      auto child = root.create_child();
+      REQUIRE_FALSE(root.trace_segment().skips_new_spans());
+    }
+    REQUIRE(collector->span_count() == 2);
+    REQUIRE(collector->first_span().tags.count(
+                tags::internal::trace_truncated) == 0);
+  }
+}
+
+TEST_CASE("TraceSegment span rollups") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.span_rollups = {{"cache.get", ""}, {"serialize", "json"}};
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  const TimePoint start = default_clock();
+  // Create a child of the specified `parent` having the specified `name` and
+  // `resource`, which starts after the specified `offset` from `start` and
+  // lasts for the specified `duration`.
+  const auto child = [&](const Span& parent, const char* name,
+                         const char* resource, std::chrono::milliseconds offset,
+                         std::chrono::milliseconds duration) {
+    SpanConfig span_config;
+    span_config.name = name;
+    span_config.resource = resource;
+    TimePoint child_start = start;
+    child_start.wall += offset;
+    child_start.tick += offset;
+    span_config.start = child_start;
+    Span span = parent.create_child(span_config);
+    span.set_end_time(child_start.tick + duration);
+    return span;
+  };
+
+  std::uint64_t root_id;
+  std::uint64_t other_parent_id;
+  {
+    auto root = tracer.create_span();
+    root_id = root.id();
+    child(root, "cache.get", "a", 1ms, 2ms);
+    child(root, "cache.get", "a", 10ms, 5ms).set_error(true);
+    child(root, "cache.get", "a", 5ms, 1ms);
+    child(root, "cache.get", "b", 0ms, 1ms);
+    child(root, "serialize", "json", 0ms, 1ms);
+    child(root, "serialize", "json", 0ms, 1ms);
+    child(root, "serialize", "xml", 0ms, 1ms);
+    child(root, "serialize", "xml", 0ms, 1ms);
+    auto other_parent = root.create_child();
+    other_parent_id = other_parent.id();
+    child(other_parent, "cache.get", "a", 0ms, 1ms);
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& spans = collector->chunks.front();
+  // The root, "cache.get a" and "cache.get b" and "serialize json" of the
+  // root, both "serialize xml", the other parent, and its "cache.get a".
+  REQUIRE(spans.size() == 8);
+
+  const auto find = [&](std::uint64_t parent_id, const char* name,
+                        const char* resource) -> const SpanData& {
+    const auto found = std::find_if(
+        spans.begin(), spans.end(), [&](const auto& span) {
+          return span->parent_id == parent_id && span->name == name &&
+                 span->resource == resource;
+        });
+    REQUIRE(found != spans.end());
+    return **found;
+  };
+
+  const SpanData& summary = find(root_id, "cache.get", "a");
+  REQUIRE(summary.numeric_tags.at(tags::internal::rollup_count) == 3);
+  REQUIRE(summary.numeric_tags.at(tags::internal::rollup_errors) == 1);
+  REQUIRE(summary.numeric_tags.at(tags::internal::rollup_duration_total) ==
+          8e6);
+  REQUIRE(summary.numeric_tags.at(tags::internal::rollup_duration_min) ==
+          1e6);
+  REQUIRE(summary.numeric_tags.at(tags::internal::rollup_duration_max) ==
+          5e6);
+  REQUIRE(summary.error);
+  REQUIRE(summary.start.tick == start.tick + 1ms);
+  REQUIRE(summary.duration == 14ms);
+
+  REQUIRE(find(root_id, "cache.get", "b")
+              .numeric_tags.at(tags::internal::rollup_count) == 1);
+  REQUIRE(find(root_id, "serialize", "json")
+              .numeric_tags.at(tags::internal::rollup_count) == 2);
+  REQUIRE(find(other_parent_id, "cache.get", "a")
+              .numeric_tags.at(tags::internal::rollup_count) == 1);
+  REQUIRE(find(root_id, "serialize", "xml")
+              .numeric_tags.count(tags::internal::rollup_count) == 0);
+
+  SECTION("a rollup must have a name") {
+    config.span_rollups = {{"", "resource"}};
+    auto result = finalize_config(config);
+    REQUIRE(result.if_error());
+    REQUIRE(result.error().code == Error::TRACER_INVALID_SPAN_ROLLUPS);
+  }
+}
+
+TEST_CASE("TraceSegment span rollups keep parents") {
+  TracerConfig config;
+  config.service = "testsvc";
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<MockLogger>();
+  config.span_rollups = {{"cache.get", ""}};
+  auto finalized = finalize_config(config);
+  REQUIRE(finalized);
+  Tracer tracer{*finalized};
+
+  SpanConfig span_config;
+  span_config.name = "cache.get";
+  std::uint64_t parent_id;
+  {
+    auto root = tracer.create_span();
+    { auto summary = root.create_child(span_config); }
+    {
+      auto parent = root.create_child(span_config);
+      parent_id = parent.id();
+      { auto nested = parent.create_child(); }
+    }
+    { auto folded = root.create_child(span_config); }
+  }
+
+  REQUIRE(collector->chunks.size() == 1);
+  const auto& spans = collector->chunks.front();
+  // The root, the summary, the parent of the nested span, and the nested
+  // span.
+  REQUIRE(spans.size() == 4);
+  for (const auto& span : spans) {
+    if (span->parent_id == 0) {
+      continue;
+    }
+    // Every parent is sent.
+    REQUIRE(std::any_of(spans.begin(), spans.end(), [&](const auto& other) {
+      return other->span_id == span->parent_id;
+    }));
+  }
+
+  const auto parent =
+      std::find_if(spans.begin(), spans.end(), [&](const auto& span) {
+        return span->span_id == parent_id;
+      });
+  REQUIRE(parent != spans.end());
+  REQUIRE((*parent)->numeric_tags.count(tags::internal::rollup_count) == 0);
+  const auto summary = std::find_if(
+      spans.begin(), spans.end(), [&](const auto& span) {
+        return span->numeric_tags.count(tags::internal::rollup_count) != 0;
+      });
+  REQUIRE(summary != spans.end());
+  REQUIRE((*summary)->numeric_tags.at(tags::internal::rollup_count) == 2);
+}
+
 TEST_CASE("independent of Tracer") {
   // This test verifies that a `TraceSegment` (via the `Span`s that refer to it)
   // can continue to operate even after the `Tracer` that created it is
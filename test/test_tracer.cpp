@@ -21,12 +21,14 @@
 #if defined(__linux__) || defined(__unix__)
 #include <dirent.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
 #include <chrono>
 #include <ctime>
 #include <iosfwd>
+#include <map>
 #include <stdexcept>
 #include <utility>
 
@@ -36,6 +38,7 @@
 #include "mocks/dict_writers.h"
 #include "mocks/loggers.h"
 #include "null_logger.h"
+#include "string_util.h"
 #include "test.h"
 
 namespace datadog {
@@ -315,6 +318,108 @@ TEST_TRACER("tracer span defaults") {
   }
 }
 
+// Verify that a `SpanConfigView` determines the properties of a span as the
+// equivalent `SpanConfig` does.
+TEST_TRACER("span config views") {
+  TracerConfig config;
+  config.service = "foosvc";
+  config.version = "first";
+  config.tags = {{"some.thing", "thing value"}, {"other.thing", "value"}};
+  const auto collector = std::make_shared<MockCollector>();
+  config.collector = collector;
+  config.logger = std::make_shared<NullLogger>();
+
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  SpanConfig owning;
+  owning.service = "barsvc";
+  owning.service_type = "wiggler";
+  owning.environment = "desert";
+  owning.version = "second";
+  owning.name = "test.another.thing";
+  owning.resource = "the resource";
+  owning.tags = {{"different.thing", "different"},
+                 {"some.thing", "different value"}};
+
+  const SpanConfigView::Tag view_tags[] = {
+      {"different.thing", "different"},
+      {"some.thing", "overwritten below"},
+      {"some.thing", "different value"}};
+  SpanConfigView view;
+  view.service = "barsvc";
+  view.service_type = "wiggler";
+  view.environment = "desert";
+  view.version = "second";
+  view.name = "test.another.thing";
+  view.resource = "the resource";
+  view.tags = view_tags;
+  REQUIRE(view.tags.size() == 3);
+
+  const std::unordered_map<std::string, std::string> headers{
+      {"x-datadog-trace-id", "123"}, {"x-datadog-parent-id", "456"}};
+  const MockDictReader reader{headers};
+
+  // Internal tags, such as the high bits of the trace ID, can differ between
+  // traces.
+  const auto public_tags = [](const SpanData& span) {
+    std::map<std::string, std::string> result;
+    for (const auto& [key, value] : span.tags) {
+      if (!starts_with(key, "_dd.")) {
+        result.emplace(key, value);
+      }
+    }
+    return result;
+  };
+  const auto require_same = [&](const SpanData& expected,
+                                const SpanData& actual) {
+    REQUIRE(actual.service == expected.service);
+    REQUIRE(actual.service_type == expected.service_type);
+    REQUIRE(actual.name == expected.name);
+    REQUIRE(actual.resource == expected.resource);
+    REQUIRE(public_tags(actual) == public_tags(expected));
+  };
+
+  SECTION("in a root span") {
+    tracer.create_span(owning);
+    tracer.create_span(view);
+    REQUIRE(collector->chunks.size() == 2);
+    require_same(*collector->chunks[0].front(), *collector->chunks[1].front());
+  }
+
+  SECTION("in an extracted span") {
+    REQUIRE(tracer.extract_span(reader, owning));
+    REQUIRE(tracer.extract_span(reader, view));
+    tracer.extract_or_create_span(reader, view);
+    REQUIRE(collector->chunks.size() == 3);
+    require_same(*collector->chunks[0].front(), *collector->chunks[1].front());
+    require_same(*collector->chunks[0].front(), *collector->chunks[2].front());
+  }
+
+  SECTION("in a child span") {
+    {
+      auto root = tracer.create_span();
+      root.create_child(owning);
+      root.create_child(view);
+    }
+    REQUIRE(collector->chunks.size() == 1);
+    const auto& chunk = collector->chunks.front();
+    REQUIRE(chunk.size() == 3);
+    require_same(*chunk[1], *chunk[2]);
+  }
+
+  SECTION("an empty view uses the span defaults") {
+    tracer.create_span();
+    tracer.create_span(SpanConfigView{});
+    REQUIRE(collector->chunks.size() == 2);
+    const auto& span = *collector->chunks[1].front();
+    require_same(*collector->chunks[0].front(), span);
+    REQUIRE(span.service == config.service);
+    REQUIRE(span.version() == config.version);
+  }
+}
+
 TEST_TRACER("span extraction") {
   TracerConfig config;
   config.service = "testsvc";
@@ -656,6 +761,42 @@ TEST_TRACER("span extraction") {
     REQUIRE(result.error().code == Error::NO_SPAN_TO_EXTRACT);
   }
 
+  SECTION("extraction errors describe the style and the headers examined") {
+    config.extraction_styles = {PropagationStyle::DATADOG};
+    const auto finalized_config = finalize_config(config);
+    REQUIRE(finalized_config);
+    Tracer tracer{*finalized_config};
+
+    const std::unordered_map<std::string, std::string> headers{
+        {"x-datadog-trace-id", "123"}, {"content-type", "text/plain"}};
+    MockDictReader reader{headers};
+    const auto result = tracer.extract_span(reader);
+    REQUIRE(!result);
+    REQUIRE(result.error().code == Error::MISSING_PARENT_SPAN_ID);
+    REQUIRE(result.error().message ==
+            "While extracting trace context in the Datadog propagation style "
+            "from the following headers: [x-datadog-trace-id: 123], an error "
+            "occurred: There's no parent span ID to extract, but there is a "
+            "trace ID: [hexadecimal = 0000000000000000000000000000007b, "
+            "decimal = 123]");
+
+    const std::unordered_map<std::string, std::string> malformed{
+        {"x-datadog-trace-id", "12x"}, {"x-datadog-parent-id", "456"}};
+    MockDictReader malformed_reader{malformed};
+    const auto malformed_result = tracer.extract_span(malformed_reader);
+    REQUIRE(!malformed_result);
+    REQUIRE(malformed_result.error().code == Error::INVALID_INTEGER);
+    REQUIRE(malformed_result.error().message.find(
+                "While extracting trace context in the Datadog propagation "
+                "style from the following headers: [x-datadog-trace-id: "
+                "12x], an error occurred: ") == 0);
+
+    // `extract_or_create_span` discards the errors, and creates root spans.
+    REQUIRE(tracer.extract_or_create_span(reader).parent_id() == nullopt);
+    REQUIRE(tracer.extract_or_create_span(malformed_reader).parent_id() ==
+            nullopt);
+  }
+
   SECTION("W3C traceparent extraction") {
     const std::unordered_map<std::string, std::string> datadog_headers{
         {"x-datadog-trace-id", "18"},
@@ -1218,7 +1359,7 @@ TEST_TRACER("span extraction") {
     CAPTURE(test_case.traceparent);
     CAPTURE(test_case.tracestate);
 
-    std::unordered_map<std::string, std::string> span_tags;
+    SpanTags span_tags;
     MockLogger logger;
     CAPTURE(logger.entries);
     CAPTURE(span_tags);
@@ -1797,6 +1938,96 @@ TEST_TRACER("heterogeneous extraction") {
   REQUIRE(writer.items == test_case.expected_injected_headers);
 }
 
+TEST_TRACER("trace context can be propagated without a span") {
+  const auto collector = std::make_shared<MockCollector>();
+  TracerConfig config;
+  config.service = "testsvc";
+  config.collector = collector;
+  config.logger = std::make_shared<NullLogger>();
+  config.extraction_styles = {PropagationStyle::DATADOG, PropagationStyle::W3C};
+  config.injection_styles = {PropagationStyle::DATADOG, PropagationStyle::W3C};
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  Tracer tracer{*finalized_config};
+
+  std::unordered_map<std::string, std::string> headers{
+      {"x-datadog-trace-id", "123"},
+      {"x-datadog-parent-id", "456"},
+      {"x-datadog-sampling-priority", "2"},
+      {"x-datadog-origin", "synthetics"},
+      {"x-datadog-tags", "_dd.p.dm=-4"}};
+  MockDictReader reader{headers};
+
+  SECTION("with the extracted parent ID") {
+    MockDictWriter writer;
+    auto parent_id = tracer.propagate(reader, writer);
+    REQUIRE(parent_id);
+    REQUIRE(*parent_id == 456);
+    REQUIRE(writer.items.at("x-datadog-trace-id") == "123");
+    REQUIRE(writer.items.at("x-datadog-parent-id") == "456");
+    REQUIRE(writer.items.at("x-datadog-sampling-priority") == "2");
+    REQUIRE(writer.items.at("x-datadog-origin") == "synthetics");
+    REQUIRE(writer.items.at("x-datadog-tags") == "_dd.p.dm=-4");
+    REQUIRE(writer.items.at("traceparent") ==
+            "00-000000000000000000000000000000" "7b-00000000000001c8-01");
+    REQUIRE(writer.items.at("tracestate") ==
+            "dd=s:2;p:00000000000001c8;o:synthetics;t.dm:-4");
+
+    // The same headers are written as for a span extracted and injected,
+    // except for the parent ID.
+    auto span = tracer.extract_span(reader);
+    REQUIRE(span);
+    MockDictWriter injected;
+    span->inject(injected);
+    injected.items.erase("x-datadog-parent-id");
+    injected.items.erase("traceparent");
+    injected.items.erase("tracestate");
+    writer.items.erase("x-datadog-parent-id");
+    writer.items.erase("traceparent");
+    writer.items.erase("tracestate");
+    REQUIRE(writer.items == injected.items);
+  }
+
+  SECTION("with a new parent ID") {
+    MockDictWriter writer;
+    auto parent_id = tracer.propagate(reader, writer, true);
+    REQUIRE(parent_id);
+    REQUIRE(*parent_id != 456);
+    REQUIRE(writer.items.at("x-datadog-parent-id") ==
+            std::to_string(*parent_id));
+    REQUIRE(writer.items.at("traceparent").find(hex_padded(*parent_id)) !=
+            std::string::npos);
+    // Nothing is sent for a propagated context.
+    REQUIRE(collector->chunks.empty());
+  }
+
+  SECTION("without a sampling decision") {
+    headers.erase("x-datadog-sampling-priority");
+    MockDictWriter writer;
+    REQUIRE(tracer.propagate(reader, writer));
+    REQUIRE(writer.items.count("x-datadog-trace-id") == 1);
+    REQUIRE(writer.items.count("x-datadog-sampling-priority") == 0);
+    REQUIRE(writer.items.count("traceparent") == 0);
+    REQUIRE(writer.items.count("tracestate") == 0);
+  }
+
+  SECTION("without trace context") {
+    headers.clear();
+    MockDictWriter writer;
+    auto result = tracer.propagate(reader, writer);
+    REQUIRE(result.if_error());
+    REQUIRE(result.error().code == Error::NO_SPAN_TO_EXTRACT);
+    REQUIRE(writer.items.empty());
+  }
+
+  SECTION("with invalid trace context") {
+    headers["x-datadog-trace-id"] = "nonsense";
+    MockDictWriter writer;
+    REQUIRE_FALSE(tracer.propagate(reader, writer));
+    REQUIRE(writer.items.empty());
+  }
+}
+
 TEST_TRACER("move semantics") {
   // Verify that `Tracer` can be moved.
   TracerConfig config;
@@ -2088,6 +2319,112 @@ TEST_TRACER("process discovery") {
 }
 #endif
 
+#if defined(__linux__) || defined(__unix__)
+TEST_TRACER("a tracer can be reinitialized in a forked process") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.telemetry.enabled = false;
+  config.log_on_startup = false;
+  config.logger = std::make_shared<NullLogger>();
+  // Nothing listens here, so that requests fail at once.
+  config.agent.url = "http://127.0.0.1:1";
+  config.agent.shutdown_timeout_milliseconds = 100;
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+
+  // The tracer's default HTTP client and event scheduler have threads, and so
+  // destroying the tracer in the child would wait for threads that do not
+  // exist there, unless the tracer is reinitialized.
+  Optional<Tracer> tracer;
+  tracer.emplace(*finalized_config);
+  const auto parent_config = nlohmann::json::parse(tracer->config());
+
+  const pid_t child = ::fork();
+  REQUIRE(child != -1);
+  if (child == 0) {
+    // If the child hangs, then it is killed.
+    ::alarm(10);
+    tracer->reinitialize_after_fork();
+    const auto child_config = nlohmann::json::parse(tracer->config());
+    const bool new_runtime_id =
+        child_config["runtime_id"] != parent_config["runtime_id"];
+    { auto span = tracer->create_span(); }
+    tracer.reset();
+    ::_exit(new_runtime_id ? 0 : 1);
+  }
+
+  int status = 0;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+}
+
+TEST_TRACER("a configuration finalized before a fork can be used in the child") {
+  TracerConfig config;
+  config.service = "testsvc";
+  config.telemetry.enabled = false;
+  config.log_on_startup = false;
+  config.logger = std::make_shared<NullLogger>();
+  config.agent.url = "http://127.0.0.1:1";
+  config.agent.shutdown_timeout_milliseconds = 100;
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+  // The parent's default components have threads.
+  { Tracer tracer{*finalized_config}; }
+
+  const pid_t child = ::fork();
+  REQUIRE(child != -1);
+  if (child == 0) {
+    // If the child's tracer used the parent's components, then destroying it
+    // would wait for threads that do not exist, and the child is killed.
+    ::alarm(10);
+    {
+      Tracer tracer{*finalized_config};
+      auto span = tracer.create_span();
+    }
+    ::_exit(0);
+  }
+
+  int status = 0;
+  REQUIRE(::waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+}
+#endif
+
+TEST_TRACER("a tracer can be reconfigured while it is in use") {
+  const auto collector = std::make_shared<MockCollector>();
+
+  TracerConfig config;
+  config.service = "testsvc";
+  config.environment = "test";
+  config.collector = collector;
+  config.logger = std::make_shared<NullLogger>();
+  auto finalized_config = finalize_config(config);
+  REQUIRE(finalized_config);
+
+  Tracer tracer{*finalized_config};
+  Optional<Span> before = tracer.create_span();
+
+  TracerUpdate update;
+  update.service = "othersvc";
+  update.environment = "prod";
+  REQUIRE(tracer.reconfigure(update));
+
+  { auto after = tracer.create_span(); }
+  REQUIRE(collector->chunks.size() == 1);
+  CHECK(collector->first_span().service == "othersvc");
+  CHECK(collector->first_span().environment() == "prod");
+
+  // The span created before the update is sent by the same collector.
+  before.reset();
+  CHECK(collector->chunks.size() == 2);
+
+  update = TracerUpdate{};
+  update.service = "";
+  CHECK(!tracer.reconfigure(update));
+}
+
 TEST_TRACER("_dd.p.ksr is NOT set when overriding the sampling decision") {
   const auto collector = std::make_shared<MockCollector>();
 
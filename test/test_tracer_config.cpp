@@ -403,6 +403,58 @@ TRACER_CONFIG_TEST("TracerConfig::agent") {
       REQUIRE(finalized.error().code ==
               Error::DATADOG_AGENT_INVALID_FLUSH_INTERVAL);
     }
+
+    SECTION("minimum must be positive") {
+      config.agent.flush_interval_min_milliseconds = 0;
+      auto finalized = finalize_config(config);
+      REQUIRE(!finalized);
+      REQUIRE(finalized.error().code ==
+              Error::DATADOG_AGENT_INVALID_FLUSH_INTERVAL);
+    }
+
+    SECTION("bounds are on either side of the flush interval") {
+      config.agent.flush_interval_milliseconds = 1000;
+      config.agent.flush_interval_min_milliseconds = 5000;
+      config.agent.flush_interval_max_milliseconds = 10;
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      const auto& agent =
+          std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+      REQUIRE(agent.flush_interval_min == std::chrono::seconds(1));
+      REQUIRE(agent.flush_interval_max == std::chrono::seconds(1));
+      REQUIRE(agent.flush_jitter_enabled);
+
+      config.agent.flush_interval_min_milliseconds = 250;
+      config.agent.flush_interval_max_milliseconds = 8000;
+      finalized = finalize_config(config);
+      REQUIRE(finalized);
+      const auto& adaptive =
+          std::get<FinalizedDatadogAgentConfig>(finalized->collector);
+      REQUIRE(adaptive.flush_interval_min == std::chrono::milliseconds(250));
+      REQUIRE(adaptive.flush_interval_max == std::chrono::seconds(8));
+    }
+  }
+
+  SECTION("priority flushes per second") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    REQUIRE(std::get<FinalizedDatadogAgentConfig>(finalized->collector)
+                .priority_flushes_per_second == 0);
+
+    config.agent.priority_flushes_per_second = 0.5;
+    finalized = finalize_config(config);
+    REQUIRE(finalized);
+    REQUIRE(std::get<FinalizedDatadogAgentConfig>(finalized->collector)
+                .priority_flushes_per_second == 0.5);
+
+    auto rate = GENERATE(-1.0, std::numeric_limits<double>::quiet_NaN(),
+                         std::numeric_limits<double>::infinity());
+    CAPTURE(rate);
+    config.agent.priority_flushes_per_second = rate;
+    finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_PRIORITY_FLUSH_RATE);
   }
 
   SECTION("remote configuration poll interval") {
@@ -414,6 +466,32 @@ TRACER_CONFIG_TEST("TracerConfig::agent") {
               Error::DATADOG_AGENT_INVALID_REMOTE_CONFIG_POLL_INTERVAL);
     }
 
+    SECTION("maximum cannot be negative") {
+      config.agent.remote_configuration_max_poll_interval_seconds = -1;
+      auto finalized = finalize_config(config);
+      REQUIRE(!finalized);
+      REQUIRE(finalized.error().code ==
+              Error::DATADOG_AGENT_INVALID_REMOTE_CONFIG_POLL_INTERVAL);
+    }
+
+    SECTION("maximum is at least the poll interval") {
+      config.agent.remote_configuration_max_poll_interval_seconds = 1;
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      const auto* const agent =
+          std::get_if<FinalizedDatadogAgentConfig>(&finalized->collector);
+      REQUIRE(agent);
+      REQUIRE(agent->remote_configuration_max_poll_interval ==
+              std::chrono::seconds(5));
+
+      config.agent.remote_configuration_max_poll_interval_seconds = 60;
+      finalized = finalize_config(config);
+      REQUIRE(finalized);
+      REQUIRE(std::get<FinalizedDatadogAgentConfig>(finalized->collector)
+                  .remote_configuration_max_poll_interval ==
+              std::chrono::seconds(60));
+    }
+
     SECTION("override default value") {
       SECTION("programmatically") {
         config.agent.remote_configuration_poll_interval_seconds = 42;
@@ -1463,3 +1541,112 @@ TRACER_CONFIG_TEST("baggage") {
           false);
   }
 }
+
+TRACER_CONFIG_TEST("TracerConfig partial flush") {
+  TracerConfig config;
+  config.service = "testsvc";
+
+  SECTION("disabled by default") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    CHECK(finalized->partial_flush_min_spans == 0);
+    CHECK(finalized->metadata[ConfigName::TRACE_PARTIAL_FLUSH_ENABLED].origin ==
+          ConfigMetadata::Origin::DEFAULT);
+    CHECK(
+        finalized->metadata[ConfigName::TRACE_PARTIAL_FLUSH_MIN_SPANS].value ==
+        "1000");
+  }
+
+  SECTION("enabled in code") {
+    config.partial_flush_enabled = true;
+
+    SECTION("with the default minimum") {
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      CHECK(finalized->partial_flush_min_spans == 1000);
+    }
+
+    SECTION("with a custom minimum") {
+      config.partial_flush_min_spans = 10;
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      CHECK(finalized->partial_flush_min_spans == 10);
+      CHECK(finalized->metadata[ConfigName::TRACE_PARTIAL_FLUSH_MIN_SPANS]
+                .origin == ConfigMetadata::Origin::CODE);
+    }
+
+    SECTION("a zero minimum is an error") {
+      config.partial_flush_min_spans = 0;
+      auto finalized = finalize_config(config);
+      REQUIRE(!finalized);
+      REQUIRE(finalized.error().code == Error::INVALID_PARTIAL_FLUSH_MIN_SPANS);
+    }
+  }
+
+  SECTION("overridden by environment variables") {
+    config.partial_flush_enabled = false;
+    config.partial_flush_min_spans = 10;
+    const EnvGuard enabled_guard{"DD_TRACE_PARTIAL_FLUSH_ENABLED", "true"};
+
+    SECTION("valid minimum") {
+      const EnvGuard min_spans_guard{"DD_TRACE_PARTIAL_FLUSH_MIN_SPANS", "50"};
+      auto finalized = finalize_config(config);
+      REQUIRE(finalized);
+      CHECK(finalized->partial_flush_min_spans == 50);
+      CHECK(finalized->metadata[ConfigName::TRACE_PARTIAL_FLUSH_ENABLED]
+                .origin == ConfigMetadata::Origin::ENVIRONMENT_VARIABLE);
+    }
+
+    SECTION("invalid minimum") {
+      const EnvGuard min_spans_guard{"DD_TRACE_PARTIAL_FLUSH_MIN_SPANS",
+                                     "lots"};
+      auto finalized = finalize_config(config);
+      REQUIRE(!finalized);
+      REQUIRE(finalized.error().code == Error::INVALID_INTEGER);
+    }
+  }
+}
+
+TRACER_CONFIG_TEST("TracerConfig traces API version") {
+  TracerConfig config;
+  config.service = "testsvc";
+
+  const auto api_version = [](const FinalizedTracerConfig& finalized) {
+    return std::get<FinalizedDatadogAgentConfig>(finalized.collector)
+        .traces_api_version;
+  };
+
+  SECTION("defaults to v0.4") {
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    CHECK(api_version(*finalized) == TracesAPIVersion::V0_4);
+    CHECK(finalized->metadata[ConfigName::TRACE_API_VERSION].value == "v0.4");
+  }
+
+  SECTION("set in code") {
+    config.agent.traces_api_version = TracesAPIVersion::V0_5;
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    CHECK(api_version(*finalized) == TracesAPIVersion::V0_5);
+    CHECK(finalized->metadata[ConfigName::TRACE_API_VERSION].origin ==
+          ConfigMetadata::Origin::CODE);
+  }
+
+  SECTION("overridden by the environment") {
+    config.agent.traces_api_version = TracesAPIVersion::V0_4;
+    const EnvGuard guard{"DD_TRACE_API_VERSION", "v0.5"};
+    auto finalized = finalize_config(config);
+    REQUIRE(finalized);
+    CHECK(api_version(*finalized) == TracesAPIVersion::V0_5);
+    CHECK(finalized->metadata[ConfigName::TRACE_API_VERSION].origin ==
+          ConfigMetadata::Origin::ENVIRONMENT_VARIABLE);
+  }
+
+  SECTION("unsupported version in the environment") {
+    const EnvGuard guard{"DD_TRACE_API_VERSION", "v0.7"};
+    auto finalized = finalize_config(config);
+    REQUIRE(!finalized);
+    REQUIRE(finalized.error().code ==
+            Error::DATADOG_AGENT_INVALID_TRACES_API_VERSION);
+  }
+}
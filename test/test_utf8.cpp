@@ -0,0 +1,109 @@
+// These are tests for the validation and repair of UTF-8 (see `utf8.h`), and
+// for the repair of the strings of spans as they are encoded.
+
+#include <datadog/json.hpp>
+#include <datadog/string_view.h>
+
+#include <string>
+
+#include "msgpack.h"
+#include "span_data.h"
+#include "test.h"
+#include "utf8.h"
+
+using namespace datadog::tracing;
+
+#define TEST_UTF8(x) TEST_CASE(x, "[utf8]")
+
+namespace {
+
+std::string repaired(StringView text) {
+  std::string result(repaired_utf8_size(text), '\0');
+  char* const end = repair_utf8(&result[0], text);
+  REQUIRE(end == result.data() + result.size());
+  return result;
+}
+
+}  // namespace
+
+TEST_UTF8("valid UTF-8") {
+  const std::string ascii(100, 'x');
+  auto text = GENERATE_COPY(values<std::string>({
+      "",
+      "plain ASCII",
+      ascii,
+      "caf\xC3\xA9",
+      "\xE2\x82\xAC 10",
+      "\xF0\x9F\x98\x80 smile",
+      "\xED\x9F\xBF \xEE\x80\x80 \xF4\x8F\xBF\xBF",
+      ascii + "\xE4\xB8\xAD\xE6\x96\x87" + ascii,
+  }));
+
+  CAPTURE(text);
+  REQUIRE(valid_utf8_prefix(text) == text.size());
+  REQUIRE(repaired_utf8_size(text) == text.size());
+  REQUIRE(repaired(text) == text);
+}
+
+TEST_UTF8("invalid UTF-8 is repaired") {
+  struct TestCase {
+    std::string text;
+    std::size_t valid_prefix;
+    std::string expected;
+  };
+
+  const std::string ascii(40, 'x');
+  const std::string fffd = "\xEF\xBF\xBD";
+  auto test_case = GENERATE_COPY(values<TestCase>({
+      // a lone continuation byte
+      {"a\x80z", 1, "a" + fffd + "z"},
+      // a truncated sequence is one maximal subpart
+      {"a\xE2\x82", 1, "a" + fffd},
+      {"\xF0\x9F\x98z", 0, fffd + "z"},
+      // an overlong encoding, a surrogate, and a code point beyond U+10FFFF
+      {"\xC0\xAF", 0, fffd + fffd},
+      {"\xED\xA0\x80", 0, fffd + fffd + fffd},
+      {"\xF4\x90\x80\x80", 0, fffd + fffd + fffd + fffd},
+      // bytes that never appear in UTF-8
+      {"\xFE\xFF", 0, fffd + fffd},
+      // the example in chapter 3 of the Unicode Standard
+      {"a\xF1\x80\x80\xE1\x80\xC2" "b\x80" "c\x80\xBF" "d", 1,
+       "a" + fffd + fffd + fffd + "b" + fffd + "c" + fffd + fffd + "d"},
+      // invalid bytes after and within blocks of ASCII
+      {ascii + "\xFF" + ascii, 40, ascii + fffd + ascii},
+      {ascii + "\xC3", 40, ascii + fffd},
+      {std::string(31, 'x') + "\xC3\xA9\xC3", 33,
+       std::string(31, 'x') + "\xC3\xA9" + fffd},
+  }));
+
+  CAPTURE(test_case.text);
+  REQUIRE(valid_utf8_prefix(test_case.text) == test_case.valid_prefix);
+  REQUIRE(repaired(test_case.text) == test_case.expected);
+  REQUIRE(valid_utf8_prefix(test_case.expected) == test_case.expected.size());
+}
+
+TEST_UTF8("msgpack strings are repaired") {
+  std::string buffer;
+  REQUIRE(msgpack::pack_string(buffer, "ok"));
+  REQUIRE(msgpack::pack_string(buffer, "bad \xFF"));
+  REQUIRE(buffer == "\xA2ok\xA7" "bad \xEF\xBF\xBD");
+}
+
+TEST_UTF8("spans are encoded as valid UTF-8") {
+  SpanData span;
+  span.service = "testsvc";
+  span.name = "op\xC3";
+  span.resource = "GET /caf\xC3\xA9";
+  span.tags.emplace("http.useragent", std::string(50, 'x') + "\xFF\xFE");
+  span.tags.emplace("ok", "fine");
+  span.byte_size = 0;
+
+  std::string encoded;
+  REQUIRE(msgpack_encode(encoded, span));
+  const auto decoded = nlohmann::json::from_msgpack(encoded);
+  REQUIRE(decoded["name"] == "op\xEF\xBF\xBD");
+  REQUIRE(decoded["resource"] == "GET /caf\xC3\xA9");
+  REQUIRE(decoded["meta"]["http.useragent"] ==
+          std::string(50, 'x') + "\xEF\xBF\xBD\xEF\xBF\xBD");
+  REQUIRE(decoded["meta"]["ok"] == "fine");
+}
@@ -0,0 +1,57 @@
+// These are tests for `WinHTTPClient`, the default HTTP client on Windows when
+// this library is built with `DD_TRACE_TRANSPORT` set to "native".
+
+#include <datadog/dict_writer.h>
+#include <datadog/error.h>
+#include <datadog/json.hpp>
+#include <datadog/optional.h>
+#include <datadog/winhttp_client.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "mocks/loggers.h"
+#include "test.h"
+
+using namespace datadog::tracing;
+using namespace std::chrono_literals;
+
+#define WINHTTP_CLIENT_TEST(x) TEST_CASE(x, "[winhttp_client]")
+
+WINHTTP_CLIENT_TEST("WinHTTP client errors") {
+  const auto logger = std::make_shared<MockLogger>();
+  WinHTTPClient client{logger, default_clock};
+  REQUIRE(logger->error_count() == 0);
+
+  SECTION("Unix domain sockets are not supported") {
+    const HTTPClient::URL url{"unix", "/var/run/datadog/apm.socket",
+                              "/v0.4/traces", ""};
+    const auto result =
+        client.post(url, [](DictWriter&) {}, "", [](auto&&...) {},
+                    [](auto&&...) {}, std::chrono::steady_clock::now() + 1s);
+    REQUIRE_FALSE(result);
+    REQUIRE(result.error().code == Error::WINHTTP_CLIENT_UNSUPPORTED_URL);
+  }
+
+  SECTION("nothing listening at the endpoint") {
+    // Port 1 on the loopback interface refuses connections.
+    const HTTPClient::URL url{"http", "127.0.0.1:1", "/v0.4/traces", ""};
+    Optional<Error> error;
+    Optional<int> status;
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    const auto result = client.post(
+        url, [](DictWriter& headers) { headers.set("X-Test", "yes"); }, "[]",
+        [&](int code, const auto&, std::string) { status = code; },
+        [&](Error failure) { error = std::move(failure); }, deadline);
+    REQUIRE(result);
+    client.drain(deadline + 1s);
+    REQUIRE(error);
+    REQUIRE((error->code == Error::WINHTTP_CLIENT_REQUEST_FAILURE ||
+             error->code == Error::WINHTTP_CLIENT_DEADLINE_EXCEEDED));
+    REQUIRE_FALSE(status);
+  }
+
+  const auto config = nlohmann::json::parse(client.config());
+  REQUIRE(config["type"] == "datadog::tracing::WinHTTPClient");
+}
@@ -0,0 +1,61 @@
+#include <datadog/worker_pool.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+using namespace datadog::tracing;
+
+#define WORKER_POOL_TEST(x) TEST_CASE(x, "[worker_pool]")
+
+namespace {
+
+std::thread make_thread(std::function<void()>&& run) {
+  return std::thread(std::move(run));
+}
+
+}  // namespace
+
+WORKER_POOL_TEST("every task runs once") {
+  const std::size_t thread_count = GENERATE(0, 1, 4);
+  CAPTURE(thread_count);
+  WorkerPool pool{thread_count, make_thread};
+  REQUIRE(pool.size() == thread_count);
+
+  // Several batches, so that workers join batches after the first.
+  for (int batch = 0; batch < 20; ++batch) {
+    const std::size_t count = GENERATE(0, 1, 2, 100);
+    CAPTURE(count);
+    std::vector<std::atomic<int>> runs(count);
+    pool.run(count, [&](std::size_t i) { ++runs[i]; });
+    for (std::size_t i = 0; i < count; ++i) {
+      REQUIRE(runs[i] == 1);
+    }
+  }
+}
+
+WORKER_POOL_TEST("tasks run on the pool's threads") {
+  WorkerPool pool{3, make_thread};
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  std::atomic<int> started{0};
+  // Each task waits for all four to start, so each runs on its own thread.
+  pool.run(4, [&](std::size_t) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    }
+    ++started;
+    while (started < 4) {
+      std::this_thread::yield();
+    }
+  });
+  REQUIRE(threads.size() == 4);
+  REQUIRE(threads.count(std::this_thread::get_id()) == 1);
+}
@@ -0,0 +1,242 @@
+// This program measures the tracer's sustained throughput end to end.  It
+// runs a `Tracer` that sends its traces with a `DatadogAgent` and `Curl`, as
+// in production, to an in-process `MockAgent` over TCP or a Unix domain
+// socket.  Threads create traces at a configured rate for a configured
+// duration, and then the program prints a JSON report of the spans per
+// second that the agent received, how long after they finished the traces
+// were received, the bytes sent, the process's memory use, and how many
+// traces were dropped.  See `README.md`.
+
+#include <datadog/runtime_stats.h>
+#include <datadog/span.h>
+#include <datadog/span_config.h>
+#include <datadog/tracer.h>
+#include <datadog/tracer_config.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mock_agent.h"
+
+namespace dd = datadog::tracing;
+
+namespace {
+
+struct Options {
+  // Whether the agent listens on a Unix domain socket rather than TCP.
+  bool uds = false;
+  // The traces per second created by all threads together, or zero to create
+  // them as fast as possible.
+  double traces_per_second = 1000;
+  int spans_per_trace = 10;
+  int threads = 4;
+  double duration_seconds = 10;
+  int flush_interval_milliseconds = 2000;
+};
+
+void print_usage(const char* program) {
+  // clang-format off
+  std::cout << program << "\n\n"
+            << "Usage: measure the tracer's throughput against a mock "
+               "agent\n\n"
+            << "--transport=tcp|uds\t\tHow to reach the agent (tcp).\n"
+            << "--rate=N\t\t\tTraces per second, or 0 for unpaced (1000).\n"
+            << "--spans-per-trace=N\t\tSpans in each trace (10).\n"
+            << "--threads=N\t\t\tThreads creating traces (4).\n"
+            << "--duration=SECONDS\t\tHow long to create traces (10).\n"
+            << "--flush-interval=MILLISECONDS\tThe tracer's flush interval "
+               "(2000).\n";
+  // clang-format on
+}
+
+// Parse the specified command line arguments into the specified `options`.
+// Return whether they are valid.
+bool parse(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const auto equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        equals == std::string::npos ? "" : arg.substr(equals + 1);
+    try {
+      if (name == "--transport" && (value == "tcp" || value == "uds")) {
+        options.uds = value == "uds";
+      } else if (name == "--rate") {
+        options.traces_per_second = std::stod(value);
+      } else if (name == "--spans-per-trace") {
+        options.spans_per_trace = std::stoi(value);
+      } else if (name == "--threads") {
+        options.threads = std::stoi(value);
+      } else if (name == "--duration") {
+        options.duration_seconds = std::stod(value);
+      } else if (name == "--flush-interval") {
+        options.flush_interval_milliseconds = std::stoi(value);
+      } else {
+        return false;
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  return options.traces_per_second >= 0 && options.spans_per_trace > 0 &&
+         options.threads > 0 && options.duration_seconds > 0 &&
+         options.flush_interval_milliseconds > 0;
+}
+
+// Return the value, in bytes, of the specified field (e.g. "VmRSS") of
+// "/proc/self/status", or zero if it is not available.
+std::uint64_t memory_status(const std::string& field) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, field.size() + 1, field + ":") == 0) {
+      return std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) *
+             1024;
+    }
+  }
+  return 0;
+}
+
+// Create traces of the specified `spans_per_trace` spans with the specified
+// `tracer` until `stop` is set, at most one every `period` if `period` is
+// not zero.  Add the number of spans created to `spans_created`.
+void generate_load(dd::Tracer& tracer, int spans_per_trace,
+                   std::chrono::steady_clock::duration period,
+                   const std::atomic<bool>& stop,
+                   std::atomic<std::uint64_t>& spans_created) {
+  dd::SpanConfig config;
+  config.name = "harness.request";
+  config.resource = "GET /api/v2/users/profile";
+  std::uint64_t spans = 0;
+  auto next = std::chrono::steady_clock::now();
+  while (!stop.load(std::memory_order_relaxed)) {
+    if (period != period.zero()) {
+      std::this_thread::sleep_until(next);
+      next += period;
+    }
+    auto root = tracer.create_span(config);
+    root.set_tag("http.method", "GET");
+    root.set_tag("http.url", "https://example.com/api/v2/users/profile");
+    for (int i = 1; i < spans_per_trace; ++i) {
+      auto child = root.create_child();
+      child.set_name("harness.query");
+      child.set_tag("db.statement", "SELECT * FROM users WHERE id = ?");
+    }
+    spans += spans_per_trace;
+    root.set_metric(
+        MockAgent::finish_time_tag,
+        double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count()));
+  }
+  spans_created += spans;
+}
+
+nlohmann::json percentiles(
+    const std::vector<std::chrono::nanoseconds>& sorted) {
+  auto result = nlohmann::json::object();
+  if (sorted.empty()) {
+    return result;
+  }
+  const auto at = [&](double quantile) {
+    const auto index = std::size_t(quantile * (sorted.size() - 1));
+    return std::chrono::duration<double, std::milli>(sorted[index]).count();
+  };
+  result["p50"] = at(0.5);
+  result["p90"] = at(0.9);
+  result["p99"] = at(0.99);
+  result["max"] = at(1);
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::unique_ptr<MockAgent> agent;
+  try {
+    agent = std::make_unique<MockAgent>(
+        options.uds ? "/tmp/dd-trace-cpp-throughput.socket" : "");
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+
+  dd::TracerConfig config;
+  config.service = "throughput-harness";
+  config.agent.url = agent->url();
+  config.agent.flush_interval_milliseconds =
+      options.flush_interval_milliseconds;
+  config.agent.remote_configuration_enabled = false;
+  auto finalized = dd::finalize_config(config);
+  if (auto* error = finalized.if_error()) {
+    std::cerr << "unable to configure the tracer: " << error->message << '\n';
+    return 1;
+  }
+  auto tracer = std::make_unique<dd::Tracer>(*finalized);
+
+  const auto period =
+      options.traces_per_second == 0
+          ? std::chrono::steady_clock::duration::zero()
+          : std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(options.threads /
+                                              options.traces_per_second));
+  std::atomic<bool> stop{false};
+  std::atomic<std::uint64_t> spans_created{0};
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.threads; ++i) {
+    threads.emplace_back([&]() {
+      generate_load(*tracer, options.spans_per_trace, period, stop,
+                    spans_created);
+    });
+  }
+  std::this_thread::sleep_for(
+      std::chrono::duration<double>(options.duration_seconds));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Measure before the tracer flushes what it has buffered on destruction.
+  const auto load_totals = agent->totals();
+  const dd::RuntimeStats stats = tracer->runtime_stats();
+  const auto rss = memory_status("VmRSS");
+  tracer.reset();
+  const auto totals = agent->totals();
+
+  nlohmann::json report;
+  report["transport"] = options.uds ? "uds" : "tcp";
+  report["target_traces_per_second"] = options.traces_per_second;
+  report["spans_per_trace"] = options.spans_per_trace;
+  report["threads"] = options.threads;
+  report["duration_seconds"] = elapsed.count();
+  report["spans_created"] = spans_created.load();
+  report["spans_received"] = totals.spans;
+  report["spans_per_second"] = load_totals.spans / elapsed.count();
+  report["requests"] = totals.requests;
+  report["bytes_received"] = totals.bytes;
+  report["flush_latency_milliseconds"] = percentiles(totals.latencies);
+  report["rss_bytes"] = rss;
+  report["peak_rss_bytes"] = memory_status("VmHWM");
+  report["buffered_trace_chunks"] = stats.buffered_trace_chunks;
+  report["dropped_trace_chunks"] = stats.dropped_trace_chunks;
+  report["spans_lost"] = spans_created.load() - totals.spans;
+  std::cout << report.dump(2) << '\n';
+}
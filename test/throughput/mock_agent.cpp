@@ -0,0 +1,165 @@
+#include "mock_agent.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+MockAgent::MockAgent(const std::string& socket_path)
+    : socket_path_(socket_path) {
+  server_.Post("/v0.4/traces",
+               [this](const httplib::Request& request,
+                      httplib::Response& response) {
+                 on_traces(request, response);
+               });
+  server_.Post(".*", [](const httplib::Request&, httplib::Response& response) {
+    response.set_content("{}", "application/json");
+  });
+
+  if (socket_path_.empty()) {
+    const int port = server_.bind_to_any_port("127.0.0.1");
+    if (port < 0) {
+      throw std::runtime_error("unable to listen on the loopback interface");
+    }
+    url_ = "http://127.0.0.1:" + std::to_string(port);
+  } else {
+    ::unlink(socket_path_.c_str());
+    server_.set_address_family(AF_UNIX);
+    if (!server_.bind_to_port(socket_path_, 80)) {
+      throw std::runtime_error("unable to listen on " + socket_path_);
+    }
+    url_ = "unix://" + socket_path_;
+  }
+  thread_ = std::thread([this]() { server_.listen_after_bind(); });
+}
+
+MockAgent::~MockAgent() {
+  server_.stop();
+  thread_.join();
+  if (!socket_path_.empty()) {
+    ::unlink(socket_path_.c_str());
+  }
+}
+
+const std::string& MockAgent::url() const { return url_; }
+
+MockAgent::Totals MockAgent::totals() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Totals totals = totals_;
+  std::sort(totals.latencies.begin(), totals.latencies.end());
+  return totals;
+}
+
+namespace {
+
+// `PayloadCounter` counts the traces and spans of a v0.4 trace payload as it
+// is parsed, without building a document, so that the agent's own memory use
+// is small compared to the tracer's.  It also collects the values of
+// `MockAgent::finish_time_tag`.
+class PayloadCounter : public nlohmann::json_sax<nlohmann::json> {
+  // The payload is an array (depth 1) of chunks (depth 2) of spans (depth 3),
+  // whose "metrics" are a map at depth 4.
+  int depth_ = 0;
+  bool in_metrics_ = false;
+  bool at_finish_time_ = false;
+  bool next_is_metrics_ = false;
+
+  bool value() {
+    at_finish_time_ = false;
+    return true;
+  }
+
+  bool finish_time(double nanoseconds) {
+    if (at_finish_time_) {
+      finish_times.emplace_back(std::chrono::nanoseconds(
+          static_cast<std::int64_t>(nanoseconds)));
+    }
+    return value();
+  }
+
+ public:
+  std::uint64_t traces = 0;
+  std::uint64_t spans = 0;
+  std::vector<std::chrono::steady_clock::time_point> finish_times;
+
+  bool null() override { return value(); }
+  bool boolean(bool) override { return value(); }
+  bool number_integer(number_integer_t number) override {
+    return finish_time(double(number));
+  }
+  bool number_unsigned(number_unsigned_t number) override {
+    return finish_time(double(number));
+  }
+  bool number_float(number_float_t number, const string_t&) override {
+    return finish_time(number);
+  }
+  bool string(string_t&) override { return value(); }
+  bool binary(binary_t&) override { return value(); }
+
+  bool start_object(std::size_t) override {
+    if (depth_ == 2) {
+      ++spans;
+    }
+    in_metrics_ = depth_ == 3 && next_is_metrics_;
+    ++depth_;
+    return true;
+  }
+  bool key(string_t& key) override {
+    if (depth_ == 3) {
+      next_is_metrics_ = key == "metrics";
+    } else if (depth_ == 4 && in_metrics_) {
+      at_finish_time_ = key == MockAgent::finish_time_tag;
+    }
+    return true;
+  }
+  bool end_object() override {
+    --depth_;
+    in_metrics_ = false;
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    if (depth_ == 1) {
+      ++traces;
+    }
+    ++depth_;
+    return true;
+  }
+  bool end_array() override {
+    --depth_;
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&,
+                   const nlohmann::detail::exception&) override {
+    return false;
+  }
+};
+
+}  // namespace
+
+void MockAgent::on_traces(const httplib::Request& request,
+                          httplib::Response& response) {
+  const auto received_at = std::chrono::steady_clock::now();
+  PayloadCounter counter;
+  if (!nlohmann::json::sax_parse(request.body, &counter,
+                                 nlohmann::json::input_format_t::msgpack)) {
+    response.status = 400;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++totals_.requests;
+    totals_.traces += counter.traces;
+    totals_.spans += counter.spans;
+    totals_.bytes += request.body.size();
+    for (const auto finished : counter.finish_times) {
+      totals_.latencies.push_back(received_at - finished);
+    }
+  }
+  response.set_content(R"({"rate_by_service": {"service:,env:": 1}})",
+                       "application/json");
+}
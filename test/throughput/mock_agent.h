@@ -0,0 +1,66 @@
+#pragma once
+
+// This component provides a `class`, `MockAgent`, that is an in-process
+// stand-in for the Datadog Agent, for measuring the tracer's throughput.
+//
+// `MockAgent` listens for HTTP requests on a TCP port of the loopback
+// interface or on a Unix domain socket.  It accepts trace payloads at the
+// "/v0.4/traces" endpoint, decodes them to count their spans, and responds as
+// the Datadog Agent does.  Other requests, such as telemetry, are accepted
+// and ignored.
+//
+// A span that has the numeric tag `MockAgent::finish_time_tag` is taken to
+// have finished at that `std::chrono::steady_clock` time, in nanoseconds, so
+// that the agent can measure how long after its trace finished the trace was
+// received.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "httplib.h"
+
+class MockAgent {
+ public:
+  static constexpr const char* finish_time_tag = "harness.finish_time_ns";
+
+  struct Totals {
+    std::uint64_t requests = 0;
+    std::uint64_t traces = 0;
+    std::uint64_t spans = 0;
+    // The number of bytes in the requests' bodies.
+    std::uint64_t bytes = 0;
+    // How long after they finished the traces having `finish_time_tag` were
+    // received, in ascending order.
+    std::vector<std::chrono::nanoseconds> latencies;
+  };
+
+ private:
+  httplib::Server server_;
+  std::thread thread_;
+  std::string url_;
+  std::string socket_path_;
+  mutable std::mutex mutex_;
+  Totals totals_;
+
+  void on_traces(const httplib::Request&, httplib::Response&);
+
+ public:
+  // Start listening on an unused TCP port of the loopback interface, if the
+  // specified `socket_path` is empty, or on a Unix domain socket at
+  // `socket_path` otherwise.  Throw `std::runtime_error` if the agent cannot
+  // listen.
+  explicit MockAgent(const std::string& socket_path);
+  ~MockAgent();
+
+  // Return the URL at which the agent listens, in the form expected by
+  // `DatadogAgentConfig::url`.
+  const std::string& url() const;
+
+  // Return what the agent has received so far.
+  Totals totals() const;
+};